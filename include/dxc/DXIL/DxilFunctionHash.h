@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilFunctionHash.h                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Structural hashing of DXIL functions.                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Attributes.h"
+#include <stdint.h>
+
+namespace llvm {
+class Constant;
+class Function;
+class Instruction;
+class MDNode;
+class Metadata;
+class StructType;
+class Type;
+class Value;
+} // namespace llvm
+
+namespace hlsl {
+class DxilFieldAnnotation;
+class DxilParameterAnnotation;
+class DxilSignature;
+class DxilTypeSystem;
+
+// Structural hasher for DXIL. Everything is hashed by value rather than by
+// address, so the same function loaded into two modules, or loaded again
+// after the first copy was freed, hashes the same. Globals and functions are
+// hashed by name where they are referenced.
+class DxilFunctionHasher {
+public:
+  DxilFunctionHasher(DxilTypeSystem &TypeSys) : m_typeSys(TypeSys), m_hash(0) {}
+  uint64_t GetHash() const { return m_hash; }
+
+  template <typename T> void Add(const T &V) {
+    m_hash = llvm::hash_combine(m_hash, V);
+  }
+  void AddType(llvm::Type *Ty);
+  // Struct annotations of Ty and of the structs it contains.
+  void AddTypeAnnotations(llvm::Type *Ty);
+  void AddValue(const llvm::Value *V);
+  void AddConstant(const llvm::Constant *C);
+  void AddMetadata(const llvm::Metadata *MD);
+  void AddAttributes(llvm::AttributeSet AS);
+  void AddFieldAnnotation(const DxilFieldAnnotation &FA);
+  void AddParameterAnnotation(const DxilParameterAnnotation &PA);
+  void AddSignature(const DxilSignature &Sig);
+  // Everything about F but its name: linkage, signature, attributes, body
+  // and annotations.
+  void AddFunction(llvm::Function &F);
+
+private:
+  void AddDINodeFields(const llvm::MDNode *N);
+  void AddInstruction(const llvm::Instruction &I);
+
+  DxilTypeSystem &m_typeSys;
+  llvm::hash_code m_hash;
+  // Arguments, blocks and instructions of the function, numbered in order.
+  llvm::DenseMap<const llvm::Value *, unsigned> m_localIds;
+  // Metadata already hashed, numbered in the order it was reached.
+  llvm::DenseMap<const llvm::Metadata *, unsigned> m_metadataIds;
+  llvm::SmallPtrSet<llvm::StructType *, 8> m_structStack;
+  llvm::SmallPtrSet<llvm::StructType *, 8> m_annotatedStructs;
+};
+
+// Hash of F, not including its name; see DxilFunctionHasher::AddFunction.
+// Libraries store it for every function they define, so that the linker can
+// merge identical functions compiled into different libraries.
+uint64_t ComputeFunctionBodyHash(llvm::Function &F, DxilTypeSystem &TypeSys);
+
+} // namespace hlsl
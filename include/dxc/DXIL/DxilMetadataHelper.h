@@ -102,6 +102,8 @@ public:
   static const char kDxilSubobjectsMDName[];
 
   // Source info.
+  // Contents are {name, content} pairs, or {name, "", digest} for a file
+  // kept in a source store.
   static const char kDxilSourceContentsMDName[];
   static const char kDxilSourceDefinesMDName[];
   static const char kDxilSourceMainFileNameMDName[];
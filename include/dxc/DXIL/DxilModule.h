@@ -177,7 +177,9 @@ public:
   /// Note: this method not update Metadata for ViewIdState.
   void ReEmitDxilResources();
   /// Deserialize DXIL metadata form into in-memory form.
-  void LoadDxilMetadata();
+  /// With bLazyTypeSystem, the type annotations are only deserialized on
+  /// first use, which saves the work for consumers that never need them.
+  void LoadDxilMetadata(bool bLazyTypeSystem = false);
   /// Return true if non-fatal metadata error was detected.
   bool HasMetadataErrors();
 
@@ -222,6 +224,9 @@ public:
 public:
   ShaderFlags m_ShaderFlags;
   void CollectShaderFlagsForModule(ShaderFlags &Flags);
+  // Flags of F as of the last CollectShaderFlagsForModule; collected on
+  // demand for functions it has not seen.
+  const ShaderFlags &GetShaderFlagsForFunction(const llvm::Function *F) const;
 
   // Check if DxilModule contains multi component UAV Loads.
   // This funciton must be called after unused resources are removed from DxilModule
@@ -345,6 +350,11 @@ private:
   // Keeps track of patch constant functions used by hull shaders
   std::unordered_set<const llvm::Function *>  m_PatchConstantFunctions;
 
+  // Per-function shader flags, so one instruction walk serves the module
+  // flags and the RDAT function info.
+  mutable std::unordered_map<const llvm::Function *, ShaderFlags>
+      m_FunctionShaderFlags;
+
   // Serialized ViewId state.
   std::vector<unsigned> m_SerializedState;
 
@@ -370,6 +380,10 @@ private:
   // m_bMetadataErrors is true if non-fatal metadata errors were encountered.
   // Validator will fail in this case, but should not block module load.
   bool m_bMetadataErrors;
+
+  // True while type annotations have not been loaded from metadata yet.
+  bool m_bTypeSystemPending;
+  void LoadPendingTypeSystem();
 };
 
 } // namespace hlsl
@@ -40,6 +40,11 @@ public:
   const DxilSignatureElement &GetElement(unsigned idx) const;
   const std::vector<std::unique_ptr<DxilSignatureElement> > &GetElements() const;
 
+  // Removes the elements marked in Remove, which has an entry per element,
+  // and renumbers the rest in order. Returns the new ID of every element,
+  // or -1 for those removed.
+  std::vector<int> RemoveElements(const std::vector<bool> &Remove);
+
   // Returns true if all signature elements that should be allocated are allocated
   bool IsFullyAllocated() const;
 
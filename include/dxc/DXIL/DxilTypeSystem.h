@@ -11,6 +11,7 @@
 
 #pragma once
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
 #include "dxc/DXIL/DxilCompType.h"
 #include "dxc/DXIL/DxilInterpolationMode.h"
@@ -193,6 +194,7 @@ class DxilTypeSystem {
 public:
   using StructAnnotationMap = llvm::MapVector<const llvm::StructType *, std::unique_ptr<DxilStructAnnotation> >;
   using FunctionAnnotationMap = llvm::MapVector<const llvm::Function *, std::unique_ptr<DxilFunctionAnnotation> >;
+  using LoweredUDTMap = llvm::DenseMap<const llvm::StructType *, llvm::StructType *>;
 
   DxilTypeSystem(llvm::Module *pModule);
 
@@ -210,6 +212,10 @@ public:
 
   FunctionAnnotationMap &GetFunctionAnnotationMap();
 
+  // Results of GetLoweredUDT, so that a UDT is lowered once per module rather
+  // than once per use. nullptr records a UDT that cannot be lowered.
+  LoweredUDTMap &GetLoweredUDTMap();
+
   // Utility methods to create stand-alone SNORM and UNORM.
   // We may want to move them to a more centralized place for most utilities.
   llvm::StructType *GetSNormF32Type(unsigned NumComps);
@@ -228,6 +234,7 @@ private:
   llvm::Module *m_pModule;
   StructAnnotationMap m_StructAnnotations;
   FunctionAnnotationMap m_FunctionAnnotations;
+  LoweredUDTMap m_LoweredUDTs;
 
   DXIL::LowPrecisionMode m_LowPrecisionMode;
 
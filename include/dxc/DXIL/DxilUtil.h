@@ -78,10 +78,12 @@ namespace dxilutil {
 
   void EmitErrorOnInstruction(llvm::Instruction *I, llvm::Twine Msg);
   void EmitWarningOnInstruction(llvm::Instruction *I, llvm::Twine Msg);
+  void EmitNoteOnInstruction(llvm::Instruction *I, llvm::Twine Msg);
   void EmitErrorOnFunction(llvm::Function *F, llvm::Twine Msg);
   void EmitWarningOnFunction(llvm::Function *F, llvm::Twine Msg);
   void EmitErrorOnGlobalVariable(llvm::GlobalVariable *GV, llvm::Twine Msg);
   void EmitWarningOnGlobalVariable(llvm::GlobalVariable *GV, llvm::Twine Msg);
+  void EmitNoteOnGlobalVariable(llvm::GlobalVariable *GV, llvm::Twine Msg);
 
   void EmitResMappingError(llvm::Instruction *Res);
   std::string FormatMessageAtLocation(const llvm::DebugLoc &DL, const llvm::Twine& Msg);
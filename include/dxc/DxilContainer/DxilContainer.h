@@ -16,6 +16,8 @@
 
 #include <stdint.h>
 #include <iterator>
+#include <string>
+#include <vector>
 #include "dxc/DXIL/DxilConstants.h"
 #include "dxc/Support/WinAdapter.h"
 
@@ -44,6 +46,8 @@ enum class DxilShaderHashFlags : uint32_t {
   None = 0,           // No flags defined.
   IncludesSource = 1, // This flag indicates that the shader hash was computed
                       // taking into account source information (-Zss)
+  FastHash = 2,       // The digest is ComputeFastShaderHash rather than MD5
+                      // (-Qfast_hash)
 };
 
 typedef struct DxilShaderHash {
@@ -51,6 +55,11 @@ typedef struct DxilShaderHash {
   uint8_t Digest[DxilContainerHashSize];
 } DxilShaderHash;
 
+/// Computes a 128-bit hash of the data that is much cheaper than MD5 on
+/// large programs. Not compatible with MD5; see DxilShaderHashFlags::FastHash.
+void ComputeFastShaderHash(const void *pData, size_t size,
+                           uint8_t (&Digest)[DxilContainerHashSize]);
+
 struct DxilContainerVersion {
   uint16_t Major;
   uint16_t Minor;
@@ -95,6 +104,12 @@ enum DxilFourCC {
   DFCC_PipelineStateValidation  = DXIL_FOURCC('P', 'S', 'V', '0'),
   DFCC_RuntimeData              = DXIL_FOURCC('R', 'D', 'A', 'T'),
   DFCC_ShaderHash               = DXIL_FOURCC('H', 'A', 'S', 'H'),
+  DFCC_FunctionHashes           = DXIL_FOURCC('F', 'H', 'S', 'H'),
+  DFCC_LineTable                = DXIL_FOURCC('L', 'I', 'N', 'E'),
+  DFCC_CompressedShaderDebugInfoDXIL = DXIL_FOURCC('I', 'L', 'D', 'Z'),
+  DFCC_RootSignatureRef         = DXIL_FOURCC('R', 'T', 'S', 'R'), // only in containers in a package
+  DFCC_ContainerPackage         = DXIL_FOURCC('D', 'X', 'P', 'K'),
+  DFCC_ShaderArchive            = DXIL_FOURCC('D', 'X', 'A', 'R'),
 };
 
 #undef DXIL_FOURCC
@@ -210,6 +225,110 @@ struct DxilShaderDebugName {
 };
 static const size_t MinDxilShaderDebugNameSize = sizeof(DxilShaderDebugName) + 4;
 
+// Function hash part of a library, used by the linker to merge functions
+// with identical bodies. The header is followed by FunctionCount entries and
+// then by the names they refer to, padded to a 4-byte boundary.
+struct DxilFunctionHashHeader {
+  uint32_t FunctionCount;
+};
+struct DxilFunctionHashEntry {
+  uint32_t NameOffset;  // Offset from the start of the part to the UTF-8 name.
+  uint32_t NameLength;  // Length of the name, without null terminator.
+  uint64_t Hash;        // hlsl::ComputeFunctionBodyHash of the function.
+};
+
+// Source line table, for mapping instructions to source without loading the
+// debug info part. Instructions are numbered in module order over the
+// function bodies of the program part, skipping llvm.dbg.* calls, which that
+// part does not have. Each row gives the location of the instructions from
+// its own index up to the next row's; the last row ends the table and has no
+// location. Rows are sorted by index and delta encoded as LEB128 values:
+//   uleb  index - previous row's index
+//   uleb  file index + 1, or 0 for no location
+//   uleb  line - previous row's line, zigzag encoded
+//   uleb  column
+// The file names are FileCount null-terminated UTF-8 strings.
+struct DxilLineTableHeader {
+  uint32_t FileCount;
+  uint32_t FileNamesOffset; // Offset from the start of the part.
+  uint32_t RowCount;
+  uint32_t RowsOffset;      // Offset from the start of the part.
+  uint32_t RowsSize;        // Size of the encoded rows, in bytes.
+};
+
+// A DFCC_CompressedShaderDebugInfoDXIL part holds the data of a
+// DFCC_ShaderDebugInfoDXIL part, compressed, and is written in its place.
+// Tools that do not know the part find no debug info rather than misreading
+// it. The compressed bytes follow the header and are padded to 4 bytes.
+enum class DxilCompressionType : uint32_t {
+  Zlib = 1,
+};
+
+struct DxilCompressedPartHeader {
+  uint32_t CompressionType;  // DxilCompressionType
+  uint32_t UncompressedSize; // Size of the part data once uncompressed.
+  uint32_t CompressedSize;   // Size of the compressed bytes that follow.
+};
+
+// A package of containers that stores each distinct root signature once.
+// A container in the package has its DFCC_RootSignature part replaced by a
+// DFCC_RootSignatureRef part holding the digest of the root signature, and
+// expands back to its original bytes. Containers and root signatures start
+// on 4-byte boundaries.
+struct DxilContainerPackageHeader {
+  uint32_t             HeaderFourCC;       // DFCC_ContainerPackage
+  DxilContainerVersion Version;
+  uint32_t             PackageSizeInBytes; // From start of this header
+  uint32_t             RootSignatureCount;
+  uint32_t             ContainerCount;
+  // Followed by uint32_t RootSignatureOffset[RootSignatureCount], to a
+  // DxilPackageRootSignatureHeader, and uint32_t
+  // ContainerOffset[ContainerCount], to a DxilContainerHeader; offsets are
+  // from the start of this header.
+};
+
+struct DxilPackageRootSignatureHeader {
+  DxilContainerHash Digest; // ComputeFastShaderHash of the root signature.
+  uint32_t          Size;   // Byte count of the root signature that follows.
+};
+
+// An archive of many containers with an index for looking them up by shader
+// hash or by name without reading the rest of the archive. Containers start
+// on DxilShaderArchiveAlignment boundaries, so they can be used in place
+// from a mapped file. Names and root signatures are pooled; an archived
+// container may refer to a pooled root signature with a
+// DFCC_RootSignatureRef part, as in a container package.
+static const uint32_t DxilShaderArchiveAlignment = 16;
+
+struct DxilShaderArchiveHeader {
+  uint32_t             HeaderFourCC;       // DFCC_ShaderArchive
+  DxilContainerVersion Version;
+  uint32_t             ArchiveSizeInBytes; // From start of this header
+  uint32_t             EntryCount;
+  uint32_t             EntriesOffset;      // DxilShaderArchiveEntry[EntryCount], by digest
+  uint32_t             NameIndexCount;
+  uint32_t             NameIndexOffset;    // DxilShaderArchiveName[NameIndexCount], by hash
+  uint32_t             StringPoolSize;
+  uint32_t             StringPoolOffset;   // Null-terminated UTF-8 names
+  uint32_t             RootSignatureCount;
+  uint32_t             RootSignaturesOffset; // uint32_t[RootSignatureCount] offsets
+                                             // to DxilPackageRootSignatureHeader
+  // Offsets are from the start of this header.
+};
+
+struct DxilShaderArchiveEntry {
+  DxilShaderHash ShaderHash;      // From the HASH part; zero if there is none.
+  uint32_t       NameOffset;      // Into the string pool, or UINT32_MAX.
+  uint32_t       ContainerOffset; // From the start of the archive.
+  uint32_t       ContainerSize;
+};
+
+struct DxilShaderArchiveName {
+  uint64_t NameHash;   // ComputeShaderArchiveNameHash of the name.
+  uint32_t EntryIndex;
+  uint32_t Reserved;
+};
+
 #pragma pack(pop)
 
 /// Gets a part header by index.
@@ -253,6 +372,19 @@ DxilProgramHeader *GetDxilProgramHeader(DxilContainerHeader *pHeader, DxilFourCC
 const DxilProgramHeader *
 GetDxilProgramHeader(const DxilContainerHeader *pHeader, DxilFourCC fourCC);
 
+/// Compresses the data of a DFCC_ShaderDebugInfoDXIL part into the data of a
+/// DFCC_CompressedShaderDebugInfoDXIL part. Returns false if compression is
+/// not available or does not make the part smaller.
+bool CompressDxilDebugPartData(const void *pData, uint32_t size,
+                               std::vector<char> &partData);
+
+/// Returns the DxilProgramHeader of the debug info part, uncompressing a
+/// DFCC_CompressedShaderDebugInfoDXIL part into storage if there is one.
+/// nullptr if neither part exists or is valid.
+const DxilProgramHeader *
+GetDxilDebugProgramHeader(const DxilContainerHeader *pHeader,
+                          std::vector<char> &storage);
+
 /// Initializes container with the specified values.
 void InitDxilContainer(_Out_ DxilContainerHeader *pHeader, uint32_t partCount,
                        uint32_t containerSizeInBytes);
@@ -265,6 +397,63 @@ DxilContainerHeader *IsDxilContainerLike(void *ptr, size_t length);
 /// Checks whether the DXIL container is valid and in-bounds.
 bool IsValidDxilContainer(const DxilContainerHeader *pHeader, size_t length);
 
+/// Checks whether the container package is valid and in-bounds, including
+/// the root signatures and containers in it.
+const DxilContainerPackageHeader *IsValidDxilContainerPackage(const void *ptr,
+                                                              size_t length);
+
+/// Checks whether the parts of the container follow its offset table in
+/// order, without holes, up to the end of the container.
+bool IsContiguousDxilContainer(const DxilContainerHeader *pHeader);
+
+/// Writes a contiguous copy of the container in which the part at
+/// replaceIndex has the given fourCC and data. The header, including its
+/// hash, is kept as is apart from the size, so rebuilding a contiguous
+/// container with its own part gives back the same bytes. Returns false if
+/// the result would be too large.
+bool RebuildDxilContainer(const DxilContainerHeader *pHeader,
+                          uint32_t replaceIndex, uint32_t fourCC,
+                          const void *pData, uint32_t dataSize,
+                          std::string &result);
+
+/// Adds or replaces the part with the given fourCC in a contiguous container
+/// that has room for capacity bytes. Only the bytes after a replaced part
+/// move; a new part is appended, which moves the parts over by one offset
+/// table entry. The hash is cleared since the contents change. Sets newSize
+/// to the size of the result, and returns false without changing the
+/// container if that does not fit in capacity.
+bool SetDxilContainerPartInPlace(DxilContainerHeader *pHeader,
+                                 uint32_t capacity, uint32_t fourCC,
+                                 const void *pData, uint32_t dataSize,
+                                 uint32_t &newSize);
+
+/// Checks whether the shader archive is valid and in-bounds. Only the header
+/// and index tables are checked; containers are checked as they are used.
+const DxilShaderArchiveHeader *IsValidDxilShaderArchive(const void *ptr,
+                                                        size_t length);
+
+/// Hash used to index names in a shader archive.
+uint64_t ComputeShaderArchiveNameHash(const char *pName, size_t length);
+
+/// Gets a root signature of a container package by index.
+inline const DxilPackageRootSignatureHeader *
+GetDxilPackageRootSignature(const DxilContainerPackageHeader *pHeader,
+                            uint32_t index) {
+  const uint32_t *pOffsets = reinterpret_cast<const uint32_t *>(pHeader + 1);
+  return reinterpret_cast<const DxilPackageRootSignatureHeader *>(
+      reinterpret_cast<const uint8_t *>(pHeader) + pOffsets[index]);
+}
+
+/// Gets a container of a container package by index.
+inline const DxilContainerHeader *
+GetDxilPackageContainer(const DxilContainerPackageHeader *pHeader,
+                        uint32_t index) {
+  const uint32_t *pOffsets = reinterpret_cast<const uint32_t *>(pHeader + 1) +
+                             pHeader->RootSignatureCount;
+  return reinterpret_cast<const DxilContainerHeader *>(
+      reinterpret_cast<const uint8_t *>(pHeader) + pOffsets[index]);
+}
+
 /// Use this type as a unary predicate functor.
 struct DxilPartIsType {
   uint32_t IsFourCC;
@@ -413,6 +602,10 @@ enum class SerializeDxilFlags : uint32_t {
   StripReflectionFromDxilPart = 1 << 3, // Strip Reflection info from DXIL part.
   IncludeReflectionPart       = 1 << 4, // Include reflection in STAT part.
   StripRootSignature          = 1 << 5, // Strip Root Signature from main shader container.
+  IncludeFunctionHashPart     = 1 << 6, // Include function hashes in a library container.
+  FastShaderHash              = 1 << 7, // Compute the shader hash with ComputeFastShaderHash.
+  IncludeLineTablePart        = 1 << 8, // Include the source line table part when there is debug info.
+  CompressDebugInfoPart       = 1 << 9, // Write the debug info part compressed, when compression is available.
 };
 inline SerializeDxilFlags& operator |=(SerializeDxilFlags& l, const SerializeDxilFlags& r) {
   l = static_cast<SerializeDxilFlags>(static_cast<int>(l) | static_cast<int>(r));
@@ -0,0 +1,148 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilContainerView.h                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Header-only, allocation-free view over a DXIL container for runtime       //
+// loaders that only need the PSV0 and signature parts.                      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilPipelineStateValidation.h"
+
+namespace hlsl {
+
+/// Bounds-checked view over a DXIL container in caller-owned memory.
+///
+/// Init validates the header and every part once; after that, parts are
+/// reached through the part offset table without further checks. The parts
+/// a PSO is built from are indexed during Init so that finding them is O(1).
+/// Nothing is copied or allocated, so the memory must outlive the view.
+class DxilContainerView {
+public:
+  static const uint32_t kInvalidPartIndex = UINT32_MAX;
+
+  DxilContainerView() { Clear(); }
+  DxilContainerView(const void *pData, size_t size) { Init(pData, size); }
+
+  // Returns false and leaves the view empty if the data is not a valid
+  // container.
+  bool Init(const void *pData, size_t size) {
+    Clear();
+    if (pData == nullptr || size < sizeof(DxilContainerHeader))
+      return false;
+    const DxilContainerHeader *pHeader =
+        reinterpret_cast<const DxilContainerHeader *>(pData);
+    if (pHeader->HeaderFourCC != DFCC_Container ||
+        pHeader->Version.Major != DxilContainerVersionMajor)
+      return false;
+    uint32_t containerSize = pHeader->ContainerSizeInBytes;
+    if (containerSize > size || containerSize > DxilContainerMaxSize)
+      return false;
+    if (sizeof(DxilContainerHeader) +
+            sizeof(uint32_t) * (uint64_t)pHeader->PartCount >
+        containerSize)
+      return false;
+
+    const uint32_t *pOffsets = reinterpret_cast<const uint32_t *>(pHeader + 1);
+    for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+      uint64_t offset = pOffsets[i];
+      if (offset + sizeof(DxilPartHeader) > containerSize)
+        return false;
+      const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, i);
+      if (offset + sizeof(DxilPartHeader) + pPart->PartSize > containerSize)
+        return false;
+      // Keep the first part of each kind, as GetDxilPartByType does.
+      int slot = GetKnownPartSlot(pPart->PartFourCC);
+      if (slot >= 0 && m_KnownParts[slot] == kInvalidPartIndex)
+        m_KnownParts[slot] = i;
+    }
+    m_pHeader = pHeader;
+    return true;
+  }
+
+  void Clear() {
+    m_pHeader = nullptr;
+    for (uint32_t &index : m_KnownParts)
+      index = kInvalidPartIndex;
+  }
+
+  bool IsValid() const { return m_pHeader != nullptr; }
+  const DxilContainerHeader *GetHeader() const { return m_pHeader; }
+  uint32_t GetSize() const {
+    return m_pHeader ? m_pHeader->ContainerSizeInBytes : 0;
+  }
+  uint32_t GetPartCount() const { return m_pHeader ? m_pHeader->PartCount : 0; }
+
+  uint32_t GetPartFourCC(uint32_t index) const {
+    return index < GetPartCount()
+               ? GetDxilContainerPart(m_pHeader, index)->PartFourCC
+               : 0;
+  }
+
+  bool GetPart(uint32_t index, const void **ppData, uint32_t *pSize) const {
+    if (index >= GetPartCount())
+      return false;
+    const DxilPartHeader *pPart = GetDxilContainerPart(m_pHeader, index);
+    if (ppData)
+      *ppData = GetDxilPartData(pPart);
+    if (pSize)
+      *pSize = pPart->PartSize;
+    return true;
+  }
+
+  // Returns the index of the first part of the given kind, or
+  // kInvalidPartIndex. Only kinds not indexed by Init are searched for.
+  uint32_t FindPartIndex(uint32_t fourCC) const {
+    int slot = GetKnownPartSlot(fourCC);
+    if (slot >= 0)
+      return m_KnownParts[slot];
+    for (uint32_t i = 0; i < GetPartCount(); ++i) {
+      if (GetDxilContainerPart(m_pHeader, i)->PartFourCC == fourCC)
+        return i;
+    }
+    return kInvalidPartIndex;
+  }
+
+  bool FindPart(uint32_t fourCC, const void **ppData, uint32_t *pSize) const {
+    return GetPart(FindPartIndex(fourCC), ppData, pSize);
+  }
+
+  // Initializes PSV from the container's PSV0 part. Returns false if there
+  // is no such part or it is malformed.
+  bool InitPSV(DxilPipelineStateValidation &PSV) const {
+    const void *pData = nullptr;
+    uint32_t size = 0;
+    if (!FindPart(DFCC_PipelineStateValidation, &pData, &size))
+      return false;
+    return PSV.InitFromPSV0(pData, size);
+  }
+
+private:
+  static const int kKnownPartCount = 7;
+
+  static int GetKnownPartSlot(uint32_t fourCC) {
+    switch (fourCC) {
+    case DFCC_PipelineStateValidation: return 0;
+    case DFCC_InputSignature:          return 1;
+    case DFCC_OutputSignature:         return 2;
+    case DFCC_PatchConstantSignature:  return 3;
+    case DFCC_RootSignature:           return 4;
+    case DFCC_FeatureInfo:             return 5;
+    case DFCC_ShaderHash:              return 6;
+    default:                           return -1;
+    }
+  }
+
+  const DxilContainerHeader *m_pHeader;
+  uint32_t m_KnownParts[kKnownPartCount];
+};
+
+} // namespace hlsl
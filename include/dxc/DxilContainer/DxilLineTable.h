@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilLineTable.h                                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Header-only, allocation-free reader for the source line table part, for   //
+// tools that map instructions to source without loading debug info.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "dxc/DxilContainer/DxilContainer.h"
+
+namespace hlsl {
+
+struct DxilSourceLocation {
+  const char *FileName; // Null-terminated UTF-8, inside the part data.
+  uint32_t Line;
+  uint32_t Column;
+};
+
+/// Bounds-checked view over a DFCC_LineTable part in caller-owned memory.
+///
+/// Init validates the header and the file names; rows are decoded on each
+/// lookup, and malformed rows make the lookup fail.
+class DxilLineTableReader {
+public:
+  DxilLineTableReader() { Clear(); }
+
+  // Returns false and leaves the reader empty if the data is not a valid
+  // line table.
+  bool Init(const void *pData, uint32_t size) {
+    Clear();
+    if (pData == nullptr || size < sizeof(DxilLineTableHeader))
+      return false;
+    const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(pData);
+    const DxilLineTableHeader *pHeader =
+        reinterpret_cast<const DxilLineTableHeader *>(pData);
+    if (pHeader->FileNamesOffset > size ||
+        pHeader->RowsOffset > size ||
+        pHeader->RowsSize > size - pHeader->RowsOffset)
+      return false;
+
+    // Every name must be terminated inside the part.
+    const char *pName =
+        reinterpret_cast<const char *>(pBytes + pHeader->FileNamesOffset);
+    const char *pEnd = reinterpret_cast<const char *>(pBytes + size);
+    for (uint32_t i = 0; i < pHeader->FileCount; ++i) {
+      while (pName < pEnd && *pName)
+        ++pName;
+      if (pName == pEnd)
+        return false;
+      ++pName;
+    }
+    m_pBytes = pBytes;
+    m_pHeader = pHeader;
+    return true;
+  }
+
+  void Clear() {
+    m_pBytes = nullptr;
+    m_pHeader = nullptr;
+  }
+
+  bool IsValid() const { return m_pHeader != nullptr; }
+  uint32_t GetFileCount() const { return m_pHeader ? m_pHeader->FileCount : 0; }
+  uint32_t GetRowCount() const { return m_pHeader ? m_pHeader->RowCount : 0; }
+
+  const char *GetFileName(uint32_t index) const {
+    if (index >= GetFileCount())
+      return nullptr;
+    const char *pName =
+        reinterpret_cast<const char *>(m_pBytes + m_pHeader->FileNamesOffset);
+    for (; index; --index)
+      pName += strlen(pName) + 1;
+    return pName;
+  }
+
+  // Finds the source location of the given instruction. Returns false if it
+  // has none, is past the end of the table, or the table is malformed.
+  bool Lookup(uint32_t instIndex, DxilSourceLocation &loc) const {
+    if (!m_pHeader)
+      return false;
+    const uint8_t *p = m_pBytes + m_pHeader->RowsOffset;
+    const uint8_t *pEnd = p + m_pHeader->RowsSize;
+    uint32_t start = 0, file = 0, line = 0, column = 0;
+    bool found = false;
+    for (uint32_t row = 0; row < m_pHeader->RowCount; ++row) {
+      uint32_t indexDelta, rowFile, lineDelta, rowColumn;
+      if (!ReadULEB(p, pEnd, indexDelta) || !ReadULEB(p, pEnd, rowFile) ||
+          !ReadULEB(p, pEnd, lineDelta) || !ReadULEB(p, pEnd, rowColumn))
+        return false;
+      start += indexDelta;
+      if (start > instIndex)
+        break;
+      file = rowFile;
+      line += (lineDelta >> 1) ^ (0u - (lineDelta & 1));
+      column = rowColumn;
+      found = true;
+    }
+    if (!found || file == 0)
+      return false;
+    loc.FileName = GetFileName(file - 1);
+    loc.Line = line;
+    loc.Column = column;
+    return loc.FileName != nullptr;
+  }
+
+private:
+  static bool ReadULEB(const uint8_t *&p, const uint8_t *pEnd,
+                       uint32_t &value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+      if (p == pEnd)
+        return false;
+      uint8_t byte = *p++;
+      value |= (uint32_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  const uint8_t *m_pBytes;
+  const DxilLineTableHeader *m_pHeader;
+};
+
+} // namespace hlsl
@@ -11,6 +11,7 @@
 
 #pragma once
 #include "dxc/DXIL/DxilConstants.h"
+#include <cstring>
 
 namespace hlsl {
 namespace RDAT {
@@ -29,6 +30,11 @@ namespace RDAT {
 //      byte UTF8Data[part.Size];
 //    - else if part.Type is Index:
 //      uint32_t IndexData[part.Size / 4];
+//    - else if part.Type is FunctionNameIndex:
+//      uint32_t FunctionIndices[part.Size / 4]; // sorted by function Name
+//    - else if part.Type is SubobjectExportIndex:
+//      RuntimeDataTableHeader table; // sorted by Export name, then Association
+//      RuntimeDataSubobjectExportInfo TableData[table.RecordCount];
 
 enum class RuntimeDataPartType : uint32_t {
   Invalid         = 0,
@@ -38,6 +44,8 @@ enum class RuntimeDataPartType : uint32_t {
   FunctionTable   = 4,
   RawBytes        = 5,
   SubobjectTable  = 6,
+  FunctionNameIndex = 7,
+  SubobjectExportIndex = 8,
 };
 
 enum RuntimeDataVersion {
@@ -237,6 +245,15 @@ struct RuntimeDataSubobjectInfo {
   };
 };
 
+// An export named by a SubobjectToExportsAssociation.  Associations with no
+// exports, which apply by default, have no entries.
+struct RuntimeDataSubobjectExportInfo {
+  uint32_t Export;      // string table offset for the export name
+  uint32_t Association; // subobject table row of the association
+  uint32_t Subobject;   // subobject table row of the associated subobject,
+                        // or UINT_MAX if it is not in this library
+};
+
 class ResourceTableReader;
 class FunctionTableReader;
 class SubobjectTableReader;
@@ -445,19 +462,61 @@ public:
 class FunctionTableReader {
 private:
   TableReader m_Table;
+  const uint32_t *m_NameIndex;
+  uint32_t m_NameIndexCount;
   RuntimeDataContext *m_Context;
 
+  const char *GetRowName(uint32_t i) const {
+    return m_Context->pStringTableReader->Get(
+      m_Table.Row<RuntimeDataFunctionInfo>(i)->Name);
+  }
+
 public:
-  FunctionTableReader() : m_Context(nullptr) {}
+  FunctionTableReader()
+    : m_NameIndex(nullptr), m_NameIndexCount(0), m_Context(nullptr) {}
 
   FunctionReader GetItem(uint32_t i) const {
     return FunctionReader(m_Table.Row<RuntimeDataFunctionInfo>(i), m_Context);
   }
   uint32_t GetNumFunctions() const { return m_Table.Count(); }
 
+  // Find a function by mangled name. Uses a binary search over the name
+  // index when the RDAT has one, otherwise scans the table.
+  // Returns an empty FunctionReader if not found.
+  FunctionReader FindFunction(const char *name) const {
+    uint32_t count = GetNumFunctions();
+    if (m_NameIndex && m_NameIndexCount == count) {
+      uint32_t lo = 0, hi = count;
+      while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t row = m_NameIndex[mid];
+        if (row >= count)
+          break; // Malformed index, fall back to scan
+        int cmp = strcmp(GetRowName(row), name);
+        if (cmp == 0)
+          return GetItem(row);
+        if (cmp < 0)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (lo >= hi)
+        return FunctionReader(nullptr, m_Context);
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      if (strcmp(GetRowName(i), name) == 0)
+        return GetItem(i);
+    }
+    return FunctionReader(nullptr, m_Context);
+  }
+
   void SetFunctionInfo(const char *ptr, uint32_t count, uint32_t recordStride) {
     m_Table.Init(ptr, count, recordStride);
   }
+  void SetNameIndex(const uint32_t *ptr, uint32_t count) {
+    m_NameIndex = ptr;
+    m_NameIndexCount = count;
+  }
   void SetContext(RuntimeDataContext *context) { m_Context = context; }
 };
 
@@ -572,8 +631,13 @@ public:
 class SubobjectTableReader {
 private:
   TableReader m_Table;
+  TableReader m_ExportIndex;
   RuntimeDataContext *m_Context;
 
+  const RuntimeDataSubobjectExportInfo *GetExportRow(uint32_t row) const {
+    return m_ExportIndex.Row<RuntimeDataSubobjectExportInfo>(row);
+  }
+
 public:
   SubobjectTableReader() : m_Context(nullptr) {}
 
@@ -581,11 +645,52 @@ public:
   void SetSubobjectInfo(const char *ptr, uint32_t count, uint32_t recordStride) {
     m_Table.Init(ptr, count, recordStride);
   }
+  void SetExportIndex(const char *ptr, uint32_t count, uint32_t recordStride) {
+    m_ExportIndex.Init(ptr, count, recordStride);
+  }
 
   uint32_t GetCount() const { return m_Table.Count(); }
   SubobjectReader GetItem(uint32_t i) const {
     return SubobjectReader(m_Table.Row<RuntimeDataSubobjectInfo>(i), m_Context);
   }
+
+  // Find the associations that name an export with a binary search over the
+  // export index.  Sets first and count to the export index rows for it.
+  // Returns false if the RDAT has no export index, in which case the
+  // associations must be scanned.
+  bool FindExportAssociations(const char *exportName, uint32_t &first,
+                              uint32_t &count) const {
+    first = count = 0;
+    if (m_ExportIndex.Count() == 0 || !GetExportRow(0))
+      return false;
+    uint32_t lo = 0, hi = m_ExportIndex.Count();
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (strcmp(m_Context->pStringTableReader->Get(GetExportRow(mid)->Export),
+                 exportName) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    first = lo;
+    while (lo < m_ExportIndex.Count() &&
+           strcmp(m_Context->pStringTableReader->Get(GetExportRow(lo)->Export),
+                  exportName) == 0)
+      ++lo;
+    count = lo - first;
+    return true;
+  }
+  // The association of an export index row.
+  SubobjectReader GetExportAssociation(uint32_t row) const {
+    const RuntimeDataSubobjectExportInfo *info = GetExportRow(row);
+    return GetItem(info ? info->Association : UINT_MAX);
+  }
+  // The subobject associated by an export index row, or an empty reader if
+  // the subobject is not in this library.
+  SubobjectReader GetExportAssociatedSubobject(uint32_t row) const {
+    const RuntimeDataSubobjectExportInfo *info = GetExportRow(row);
+    return GetItem(info ? info->Subobject : UINT_MAX);
+  }
 };
 
 class DxilRuntimeData {
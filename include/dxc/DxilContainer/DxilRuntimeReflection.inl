@@ -150,6 +150,12 @@ bool DxilRuntimeData::InitFromRDAT(const void *pRDAT, size_t size) {
             table.RecordCount, table.RecordStride);
           break;
         }
+        case RuntimeDataPartType::FunctionNameIndex: {
+          uint32_t count = part.Size / sizeof(uint32_t);
+          m_FunctionTableReader.SetNameIndex(
+            PR.ReadArray<uint32_t>(count), count);
+          break;
+        }
         case RuntimeDataPartType::SubobjectTable: {
           RuntimeDataTableHeader table = PR.Read<RuntimeDataTableHeader>();
           size_t tableSize = table.RecordCount * table.RecordStride;
@@ -157,6 +163,13 @@ bool DxilRuntimeData::InitFromRDAT(const void *pRDAT, size_t size) {
             table.RecordCount, table.RecordStride);
           break;
         }
+        case RuntimeDataPartType::SubobjectExportIndex: {
+          RuntimeDataTableHeader table = PR.Read<RuntimeDataTableHeader>();
+          size_t tableSize = table.RecordCount * table.RecordStride;
+          m_SubobjectTableReader.SetExportIndex(PR.ReadArray<char>(tableSize),
+            table.RecordCount, table.RecordStride);
+          break;
+        }
         default:
           continue; // Skip unrecognized parts
         }
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilDebugTraceFormat.h                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Declares the records written to the UAV by the PIX debug instrumentation. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pix_dxil {
+
+// These definitions echo those in the debugger application's
+// debugshaderrecord.h file
+enum DebugShaderModifierRecordType {
+  DebugShaderModifierRecordTypeInvocationStartMarker,
+  DebugShaderModifierRecordTypeStep,
+  DebugShaderModifierRecordTypeEvent,
+  DebugShaderModifierRecordTypeInputRegister,
+  DebugShaderModifierRecordTypeReadRegister,
+  DebugShaderModifierRecordTypeWrittenRegister,
+  DebugShaderModifierRecordTypeRegisterRelativeIndex0,
+  DebugShaderModifierRecordTypeRegisterRelativeIndex1,
+  DebugShaderModifierRecordTypeRegisterRelativeIndex2,
+  // Only written in the compact format; see DebugTraceCompact below.
+  DebugShaderModifierRecordTypeDXILCompactSteps = 250,
+  DebugShaderModifierRecordTypeDXILStepVoid = 251,
+  DebugShaderModifierRecordTypeDXILStepFloat = 252,
+  DebugShaderModifierRecordTypeDXILStepUint32 = 253,
+  DebugShaderModifierRecordTypeDXILStepUint64 = 254,
+  DebugShaderModifierRecordTypeDXILStepDouble = 255,
+};
+
+// These structs echo those in the debugger application's debugshaderrecord.h
+// file, but are recapitulated here because the originals use unnamed unions
+// which are disallowed by DXCompiler's build.
+//
+#pragma pack(push, 4)
+struct DebugShaderModifierRecordHeader {
+  union {
+    struct {
+      uint32_t SizeDwords : 4;
+      uint32_t Flags : 4;
+      uint32_t Type : 8;
+      uint32_t HeaderPayload : 16;
+    } Details;
+    uint32_t u32Header;
+  } Header;
+  uint32_t UID;
+};
+
+struct DebugShaderModifierRecordDXILStepBase {
+  union {
+    struct {
+      uint32_t SizeDwords : 4;
+      uint32_t Flags : 4;
+      uint32_t Type : 8;
+      uint32_t Opcode : 16;
+    } Details;
+    uint32_t u32Header;
+  } Header;
+  uint32_t UID;
+  uint32_t InstructionOffset;
+};
+
+template <typename ReturnType>
+struct DebugShaderModifierRecordDXILStep
+    : public DebugShaderModifierRecordDXILStepBase {
+  ReturnType ReturnValue;
+  union {
+    struct {
+      uint32_t ValueOrdinalBase : 16;
+      uint32_t ValueOrdinalIndex : 16;
+    } Details;
+    uint32_t u32ValueOrdinal;
+  } ValueOrdinal;
+};
+
+template <>
+struct DebugShaderModifierRecordDXILStep<void>
+    : public DebugShaderModifierRecordDXILStepBase {};
+#pragma pack(pop)
+
+inline uint32_t
+DebugShaderModifierRecordPayloadSizeDwords(size_t recordTotalSizeBytes) {
+  return ((recordTotalSizeBytes - sizeof(DebugShaderModifierRecordHeader)) /
+          sizeof(uint32_t));
+}
+
+// The compact format replaces the step records of one basic block with a
+// single DebugShaderModifierRecordTypeDXILCompactSteps record, reserved with
+// one atomic. Its header's HeaderPayload holds the number of dwords that
+// follow the UID and a base instruction number:
+//
+//   header, UID, base instruction number, step...
+//
+// Each step is a step header dword, the full instruction number if
+// StepFlagFullInstNum is set, the value unless the type is void or
+// StepFlagValueElided is set, and the value ordinal unless the type is void.
+// The step header holds the DXILStep* record type in its low byte, the flags
+// above it, and in its top 16 bits the signed difference between the step's
+// instruction number and the previous one's (or the base's, for the first).
+// A value is elided only for stores of a constant; the decoder reads it back
+// from the instruction.
+namespace DebugTraceCompact {
+static constexpr uint32_t MaxPayloadDwords = 256;
+static constexpr uint32_t StepTypeMask = 0xFF;
+static constexpr uint32_t StepFlagValueElided = 1u << 8;
+static constexpr uint32_t StepFlagFullInstNum = 1u << 9;
+static constexpr uint32_t StepDeltaShift = 16;
+} // namespace DebugTraceCompact
+
+} // namespace pix_dxil
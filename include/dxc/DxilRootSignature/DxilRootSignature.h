@@ -378,6 +378,21 @@ bool VerifyRootSignature(_In_ const DxilVersionedRootSignatureDesc *pDesc,
                          _In_ llvm::raw_ostream &DiagStream,
                          _In_ bool bAllowReservedRegisterSpace);
 
+// Verification of serialized root signatures. The deserialized and verified
+// root signature is kept in a process-wide cache keyed on the serialized
+// bytes, so a root signature shared by many shaders is deserialized and
+// verified once; only the shader's bindings are checked on later calls.
+// Throws if the root signature cannot be deserialized.
+bool VerifySerializedRootSignatureWithShaderPSV(
+    _In_reads_bytes_(RSSize) const void *pRSData, _In_ uint32_t RSSize,
+    _In_ DXIL::ShaderKind ShaderKind,
+    _In_reads_bytes_(PSVSize) const void *pPSVData, _In_ uint32_t PSVSize,
+    _In_ llvm::raw_ostream &DiagStream);
+bool VerifySerializedRootSignature(_In_reads_bytes_(RSSize) const void *pRSData,
+                                   _In_ uint32_t RSSize,
+                                   _In_ llvm::raw_ostream &DiagStream);
+void ClearRootSignatureCache();
+
 } // namespace hlsl
 
 #endif // __DXC_ROOTSIGNATURE__
@@ -2,6 +2,8 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -11,8 +13,39 @@ namespace llvm
   class Function;
   class Module;
   class Type;
+  class Value;
 }
 
+// Keeps the state functions that StateFunctionTransform makes for each shader,
+// so compiling a pipeline that shares shaders with an earlier one only 
+// transforms the new shaders. Entries are keyed on a hash of the shader's IR,
+// including everything it calls, and the attribute and stack sizes.
+class DxrFallbackStateFunctionCache
+{
+public:
+  struct Entry
+  {
+    std::string bitcode;      // module with just the shader's state functions
+    unsigned numStateFunctions = 0;
+    unsigned stackSize = 0;
+    // State ids refer to shaders by index into the compiled shader names, so
+    // this records the shader behind each index the state functions use.
+    std::map<int, std::string> stateIdShaders;
+  };
+
+  bool contains(const std::string& key);
+  bool lookup(const std::string& key, Entry& entry);
+  void insert(const std::string& key, Entry entry);
+  void clear();
+  // Number of lookups that found an entry.
+  unsigned getHitCount();
+
+private:
+  std::mutex m_mutex;
+  std::map<std::string, Entry> m_entries;
+  unsigned m_hitCount = 0;
+};
+
 // Combines DXIL raytracing shaders together into a compute shader.
 //
 // The incoming module should contain the following functions if the corresponding
@@ -58,6 +91,15 @@ public:
   // 3 - dump intermediate stages of SFT to file
   void setDebugOutputLevel(int val);
 
+  // Reuses and records the state functions of shaders in cache during 
+  // compile(). The cache must outlive the compiler.
+  void setStateFunctionCache(DxrFallbackStateFunctionCache* cache);
+
+  // Number of threads compile() uses to transform shaders: 1 (the default)
+  // transforms them in order on the calling thread, 0 uses one thread per
+  // core. The calling thread's DxcThreadMalloc is shared with the workers.
+  void setThreadCount(unsigned threadCount);
+
   // Returns the entry state id for each of shaderNames. The transformations 
   // are performed in place on the module.
   void compile(std::vector<int>& shaderEntryStateIds, std::vector<unsigned int> &shaderStackSizes, IntToFuncNameMap *pCachedMap);
@@ -75,9 +117,13 @@ private:
   unsigned m_maxAttributeSize = 0;
   bool m_findCalledShaders = false;
   int m_debugOutputLevel = 0;
+  unsigned m_threadCount = 1;
 
   StringToFuncMap m_shaderMap;
 
+  DxrFallbackStateFunctionCache* m_stateFunctionCache = nullptr;
+  std::map<std::string, std::string> m_shaderCacheKeys; // shader name -> key
+
   void initShaderMap(std::vector<std::string>& shaderNames);
   void linkRuntime();
   void lowerAnyHitControlFlowFuncs();
@@ -89,6 +135,12 @@ private:
   void createStateDispatch(llvm::Function* func, const IntToFuncMap& stateFunctionMap, llvm::Type* runtimeDataArgTy);
   void lowerIntrinsics();
 
+  std::string computeShaderCacheKey(llvm::Function* F, const std::vector<std::string>& shaderNames, const std::set<llvm::Value*>& resources);
+  bool linkStateFunctions(const std::string& shader, const std::vector<std::string>& shaderNames, const DxrFallbackStateFunctionCache::Entry& entry, std::vector<llvm::Function*>& stateFunctions, unsigned int& shaderStackSize);
+  bool loadCachedStateFunctions(const std::string& shader, const std::vector<std::string>& shaderNames, std::vector<llvm::Function*>& stateFunctions, unsigned int& shaderStackSize);
+  void storeStateFunctions(const std::string& shader, const DxrFallbackStateFunctionCache::Entry& entry);
+  void transformShadersInParallel(const std::vector<std::string>& shaderNames, const std::set<llvm::Value*>& resources, std::map<std::string, DxrFallbackStateFunctionCache::Entry>& results);
+
   llvm::Type* getRuntimeDataArgType();
   llvm::Function* createDispatchFunction(const IntToFuncMap &stateFunctionMap, llvm::Type* runtimeDataArgTy);
 
@@ -15,12 +15,13 @@
 #pragma once
 #include <vector>
 #include <set>
-#include <unordered_set>
 #include <string>
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/Allocator.h"
 
 namespace llvm {
 class Function;
@@ -31,14 +32,15 @@ namespace hlsl {
 namespace dxilutil {
   class ExportMap {
   public:
-    typedef std::unordered_set<std::string> StringStore;
+    // Interned strings, allocated together in slabs.
+    typedef llvm::StringSet<llvm::BumpPtrAllocator> StringStore;
     typedef std::set<llvm::StringRef> NameSet;
     typedef llvm::MapVector< llvm::Function*, NameSet > RenameMap;
     typedef llvm::StringMap< llvm::StringSet<> > ExportMapByString;
     typedef ExportMapByString::iterator iterator;
     typedef ExportMapByString::const_iterator const_iterator;
 
-    ExportMap() {}
+    ExportMap() : m_bHasDecoratedNames(false) {}
     void clear();
     bool empty() const;
 
@@ -50,6 +52,13 @@ namespace dxilutil {
 
     // Initialize export map from option strings
     bool ParseExports(const std::vector<std::string> &exportOpts, llvm::raw_ostream &errors);
+    // Initialize export map from a binary export list, as read from the file
+    // named by -exports-file.  The list is a sequence of records, each one
+    // the internal name followed by its export names, every name terminated
+    // by a null character, and the record terminated by an empty name.  A
+    // record with no export names exports the function under its own name.
+    // Names are not escaped, so they may hold any character but null.
+    bool ParseExportList(llvm::StringRef exportList, llvm::raw_ostream &errors);
     // Add one export to the export map
     void Add(llvm::StringRef exportName, llvm::StringRef internalName = llvm::StringRef());
     // Return true if export is present, or m_ExportMap is empty
@@ -82,7 +91,7 @@ namespace dxilutil {
 
     // Called after functions are processed.
     // Returns true if no name collisions or unused exports are present.
-    bool EndProcessing() const;
+    bool EndProcessing();
     const NameSet& GetNameCollisions() const { return m_NameCollisions; }
     const NameSet& GetUnusedExports() const { return m_UnusedExports; }
 
@@ -94,12 +103,17 @@ namespace dxilutil {
     ExportMapByString m_ExportMap;
     StringStore m_StringStorage;
     llvm::StringRef StoreString(llvm::StringRef str);
+    void AddUnescaped(llvm::StringRef exportName, llvm::StringRef internalName);
+    // Whether an internal name is mangled or has the entry prefix.  If none
+    // is, a decorated function name is only looked up by its plain name.
+    bool m_bHasDecoratedNames;
 
     // Renaming/Validation state
     RenameMap m_RenameMap;
-    NameSet m_ExportNames;
+    llvm::StringSet<> m_ExportNames;
     NameSet m_NameCollisions;
     NameSet m_UnusedExports;
+    llvm::DenseSet<const ExportMapByString::MapEntryTy *> m_UsedExports;
   };
 }
 
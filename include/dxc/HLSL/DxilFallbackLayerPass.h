@@ -11,10 +11,70 @@
 
 #pragma once
 
+#include "llvm/ADT/StringRef.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace llvm {
     ModulePass *createDxilUpdateMetadataPass();
     ModulePass *createDxilPatchShaderRecordBindingsPass();
 
     void initializeDxilUpdateMetadataPass(llvm::PassRegistry&);
     void initializeDxilPatchShaderRecordBindingsPass(llvm::PassRegistry&);
-}
\ No newline at end of file
+}
+
+namespace hlsl {
+// A binding DxilPatchShaderRecordBindings looked up in the local root
+// signature, and where the root signature put it.
+struct DxilShaderRecordBinding {
+  unsigned ResourceClass;   // DXIL::ResourceClass
+  unsigned ShaderRegister;
+  unsigned RegisterSpace;
+  unsigned ParameterType;   // DxilRootParameterType, UINT_MAX if not bound
+  unsigned RecordOffsetInBytes;
+  unsigned OffsetInDescriptors;
+};
+
+// Reuses the output of DxilPatchShaderRecordBindings across state objects.
+// The patched shader depends on the local root signature only through where
+// it puts the bindings the shader uses, so the first patch of a shader
+// records those bindings. A later patch looks them up in its own root
+// signature, and reuses the patched container when they land in the same
+// places with the same descriptor size and view spaces.
+class DxilShaderRecordPatchCache {
+public:
+  // The state of a patch between lookup and insert.
+  struct Request {
+    std::string Shader;     // bytecode and export name
+    std::string ViewSpaces; // view spaces before the patch
+  };
+
+  // Looks up the patch of Bytecode for pShaderInfo, a ShaderInfo. On a hit,
+  // Patched is the patched container, and the view spaces of pShaderInfo are
+  // updated as the pass would have.
+  bool lookup(llvm::StringRef Bytecode, void *pShaderInfo, Request &R,
+              std::string &Patched);
+  // Records a patch made with the "bindings" option of the pass pointing at
+  // Bindings.
+  void insert(const Request &R, const void *pShaderInfo,
+              const std::vector<DxilShaderRecordBinding> &Bindings,
+              llvm::StringRef Patched);
+  void clear();
+
+private:
+  struct ShaderEntry {
+    unsigned ID;
+    std::vector<DxilShaderRecordBinding> Bindings;
+  };
+  struct PatchEntry {
+    std::string Patched;
+    std::string ViewSpaces; // view spaces after the patch
+  };
+
+  std::mutex m_mutex;
+  std::map<std::string, ShaderEntry> m_shaders;
+  std::map<std::string, PatchEntry> m_patches;
+};
+}
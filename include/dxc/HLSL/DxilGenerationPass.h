@@ -55,7 +55,7 @@ ModulePass *createHLEmitMetadataPass();
 ModulePass *createHLEnsureMetadataPass();
 ModulePass *createDxilFinalizeModulePass();
 ModulePass *createDxilEmitMetadataPass();
-FunctionPass *createDxilExpandTrigIntrinsicsPass();
+FunctionPass *createDxilExpandTrigIntrinsicsPass(bool bReducedPrecision = false);
 ModulePass *createDxilConvergentMarkPass();
 ModulePass *createDxilConvergentClearPass();
 ModulePass *createDxilDeadFunctionEliminationPass();
@@ -69,6 +69,16 @@ ModulePass *createDxilLegalizeResources();
 ModulePass *createDxilLegalizeEvalOperationsPass();
 FunctionPass *createDxilLegalizeSampleOffsetPass();
 FunctionPass *createDxilSimpleGVNHoistPass();
+FunctionPass *createDxilCBufferLoadCoalescePass();
+FunctionPass *createDxilVectorizeBufferAccessesPass();
+FunctionPass *createDxilHoistUniformPass();
+FunctionPass *createDxilWaveAggregateAtomicsPass();
+FunctionPass *createDxilContractMadPass(bool bAcrossBlocks = true);
+FunctionPass *createDxilHoistHandlesPass(bool bReport = false);
+FunctionPass *createDxilRematerializePass(unsigned MaxLiveScalars = 32);
+FunctionPass *createDxilNarrowPrecisionPass(unsigned UNormBits = 8);
+ModulePass *createDxilPadGroupSharedPass();
+ModulePass *createDxilMinimizeMeshOutputsPass();
 ModulePass *createInvalidateUndefResourcesPass();
 FunctionPass *createSimplifyInstPass();
 ModulePass *createDxilTranslateRawBuffer();
@@ -102,6 +112,16 @@ void initializeDxilLegalizeResourcesPass(llvm::PassRegistry&);
 void initializeDxilLegalizeEvalOperationsPass(llvm::PassRegistry&);
 void initializeDxilLegalizeSampleOffsetPassPass(llvm::PassRegistry&);
 void initializeDxilSimpleGVNHoistPass(llvm::PassRegistry&);
+void initializeDxilCBufferLoadCoalescePass(llvm::PassRegistry&);
+void initializeDxilVectorizeBufferAccessesPass(llvm::PassRegistry&);
+void initializeDxilHoistUniformPass(llvm::PassRegistry&);
+void initializeDxilWaveAggregateAtomicsPass(llvm::PassRegistry&);
+void initializeDxilContractMadPass(llvm::PassRegistry&);
+void initializeDxilHoistHandlesPass(llvm::PassRegistry&);
+void initializeDxilRematerializePass(llvm::PassRegistry&);
+void initializeDxilNarrowPrecisionPass(llvm::PassRegistry&);
+void initializeDxilPadGroupSharedPass(llvm::PassRegistry&);
+void initializeDxilMinimizeMeshOutputsPass(llvm::PassRegistry&);
 void initializeInvalidateUndefResourcesPass(llvm::PassRegistry&);
 void initializeSimplifyInstPass(llvm::PassRegistry&);
 void initializeDxilTranslateRawBufferPass(llvm::PassRegistry&);
@@ -16,6 +16,9 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/StringMap.h"
 #include <memory>
+#include <string>
+#include <vector>
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/ErrorOr.h"
 #include "dxc/HLSL/DxilExportMap.h"
 
@@ -31,6 +34,43 @@ namespace hlsl {
 class DxilModule;
 class DxilResourceBase;
 
+// One entry of a multi-entry link.
+struct DxilLinkRequest {
+  std::string Entry;
+  std::string Profile;
+  // Export options, as accepted by dxilutil::ExportMap::ParseExports.
+  std::vector<std::string> Exports;
+  // Specializations, as accepted by DxilLinker::SetSpecializations.
+  std::vector<std::string> Specializations;
+};
+
+// Result of one entry of a multi-entry link. The module lives in its own
+// context, which is declared first so that it is destroyed last.
+struct DxilLinkResult {
+  std::unique_ptr<llvm::LLVMContext> Context;
+  std::unique_ptr<llvm::Module> Module;  // nullptr if the link failed
+  std::string Diagnostics;
+  bool HasErrors = false;
+};
+
+// A library function that went into a link, with a hash of everything about
+// it the linked module depends on: its body, the globals, resources and init
+// functions it uses, its properties and annotations, and the library-wide
+// metadata that is linked along with it.
+struct DxilLinkDependency {
+  std::string Lib;
+  std::string Function;
+  uint64_t Hash;
+};
+
+// Links two consecutive stages of a graphics pipeline, a vertex or domain
+// shader Producer and the pixel shader Consumer it feeds, both final DXIL.
+// Outputs with user semantics that Consumer never reads are removed from both
+// signatures, along with the code that only computed them, and the rows they
+// leave empty are closed in both. Returns false, with an error emitted on
+// Producer's context, if the stages cannot be linked.
+bool LinkPipelineStages(llvm::Module &Producer, llvm::Module &Consumer);
+
 // Linker for DxilModule.
 class DxilLinker {
 public:
@@ -38,21 +78,62 @@ public:
   static DxilLinker *CreateLinker(llvm::LLVMContext &Ctx, unsigned valMajor, unsigned valMinor);
 
   void SetValidatorVersion(unsigned valMajor, unsigned valMinor) { m_valMajor = valMajor, m_valMinor = valMinor; }
+  // Constant buffer fields to fold into the code of later links, each as
+  // field=value or cbuffer.field=value. Fields must be 32-bit scalars; bool
+  // fields also take true and false. Loads of these fields become constants
+  // before the linked module is cleaned up, so the branches they guard are
+  // removed.
+  void SetSpecializations(llvm::ArrayRef<std::string> specs) {
+    m_specializations.assign(specs.begin(), specs.end());
+  }
   virtual bool HasLibNameRegistered(llvm::StringRef name) = 0;
   virtual bool RegisterLib(llvm::StringRef name,
                            std::unique_ptr<llvm::Module> pModule,
                            std::unique_ptr<llvm::Module> pDebugModule) = 0;
+  // Detaches and drops a registered lib, so that the name can be registered
+  // again with new contents.
+  virtual bool UnregisterLib(llvm::StringRef name) = 0;
+  // Records the body hashes stored with a registered lib, keyed on function
+  // names as the lib was compiled. Functions whose hashes match are linked
+  // as one copy where the linker can prove that is safe.
+  virtual bool SetLibFunctionHashes(llvm::StringRef name,
+                                    const llvm::StringMap<uint64_t> &hashes) = 0;
   virtual bool AttachLib(llvm::StringRef name) = 0;
   virtual bool DetachLib(llvm::StringRef name) = 0;
   virtual void DetachAll() = 0;
 
   virtual std::unique_ptr<llvm::Module>
-  Link(llvm::StringRef entry, llvm::StringRef profile, dxilutil::ExportMap &exportMap) = 0;
+  Link(llvm::StringRef entry, llvm::StringRef profile,
+       dxilutil::ExportMap &exportMap) {
+    return Link(entry, profile, exportMap, nullptr);
+  }
+
+  // As above; for an entry profile, also fills pDependencies with every
+  // function the entry was linked from. Libraries are not tracked.
+  virtual std::unique_ptr<llvm::Module>
+  Link(llvm::StringRef entry, llvm::StringRef profile,
+       dxilutil::ExportMap &exportMap,
+       std::vector<DxilLinkDependency> *pDependencies) = 0;
+
+  // Returns true if linking against the attached libs would pull in the same
+  // functions, unchanged, as the link that produced Dependencies; the module
+  // from that link can then be reused as is.
+  virtual bool IsLinkCurrent(llvm::ArrayRef<DxilLinkDependency> Dependencies) = 0;
+
+  // Links every request against the attached libraries on ThreadCount
+  // threads (0 for one per hardware thread). The libraries are fully
+  // materialized and snapshotted once; each request then links in its own
+  // context from that snapshot, so requests never share LLVM state.
+  // Results[i] receives the outcome of Requests[i].
+  virtual void LinkParallel(llvm::ArrayRef<DxilLinkRequest> Requests,
+                            unsigned ThreadCount,
+                            std::vector<DxilLinkResult> &Results) = 0;
 
 protected:
   DxilLinker(llvm::LLVMContext &Ctx, unsigned valMajor, unsigned valMinor) : m_ctx(Ctx), m_valMajor(valMajor), m_valMinor(valMinor) {}
   llvm::LLVMContext &m_ctx;
   unsigned m_valMajor, m_valMinor;
+  std::vector<std::string> m_specializations;
 };
 
 } // namespace hlsl
@@ -0,0 +1,31 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderStatistics.h                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Computes static cost statistics of the entries of a DXIL module.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+namespace llvm {
+class Module;
+class raw_ostream;
+}
+
+namespace hlsl {
+
+/// Writes static statistics of each entry of the final DXIL module M to OS,
+/// as JSON. Library modules have an entry per function with a body, which
+/// does not count the functions it calls.
+///
+/// Operation counts are weighted by how often their block runs: the product
+/// of the trip counts of the loops it is in. Trip counts are only known for
+/// loops that count an induction variable from a constant to a constant;
+/// other loops count as one trip, and are reported as unknownTripLoops.
+void WriteShaderStatistics(llvm::Module &M, llvm::raw_ostream &OS);
+
+} // namespace hlsl
@@ -143,12 +143,23 @@ public:
   // Optimized packing algorithm - appended elements may affect positions of prior elements.
   unsigned PackOptimized(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows);
 
+  // Like PackOptimized, but searches for the placement of arbitrary and system value
+  // elements that uses the fewest rows, trying at most searchBudget placements.
+  // The result is deterministic, and those elements never use more rows than with PackOptimized.
+  static const unsigned kDefaultPackSearchBudget = 1 << 16;
+  unsigned PackOptimal(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows,
+                       unsigned searchBudget = kDefaultPackSearchBudget);
+
   // Pack in a prefix-stable way - appended elements do not affect positions of prior elements.
   unsigned PackPrefixStable(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows);
 
   bool UseMinPrecision() const { return m_bUseMinPrecision; }
 
 protected:
+  struct PackSearch;
+  unsigned PackOptimizedImpl(std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows,
+                             unsigned searchBudget);
+
   std::vector<PackedRegister> m_Registers;
   bool m_bIgnoreIndexing;
   bool m_bUseMinPrecision;
@@ -276,7 +276,134 @@ unsigned DxilSignatureAllocator::PackGreedy(std::vector<PackElement*> elements,
 static_assert(DXIL::kMaxClipOrCullDistanceElementCount == 2,
               "code here assumes this is 2");
 
+// Bounded depth-first search for the placement of a list of elements that
+// leaves the fewest elements unallocated, then uses the fewest rows.
+// Candidates are tried in first-fit order, so the first complete placement
+// found is the one PackGreedy makes, and the budget bounds the number of
+// placements tried, so the result is deterministic.
+struct DxilSignatureAllocator::PackSearch {
+  typedef std::pair<unsigned, unsigned> Location;
+  static const unsigned kUnallocated = (unsigned)-1;
+
+  DxilSignatureAllocator &Alloc;
+  const std::vector<PackElement*> &Elements;
+  unsigned StartRow, NumRows, Budget;
+  std::vector<unsigned> RemainingComponents; // Components in Elements[i..].
+  std::vector<std::vector<PackedRegister>> SavedRegisters;
+  std::vector<Location> Current, Best;
+  unsigned BestRows, BestUnallocated;
+
+  PackSearch(DxilSignatureAllocator &alloc, const std::vector<PackElement*> &elements,
+             unsigned startRow, unsigned numRows, unsigned budget)
+    : Alloc(alloc), Elements(elements), StartRow(startRow), NumRows(numRows),
+      Budget(budget), RemainingComponents(elements.size() + 1, 0),
+      SavedRegisters(elements.size()), Current(elements.size()),
+      BestRows(kUnallocated), BestUnallocated(kUnallocated) {
+    for (size_t i = elements.size(); i > 0; --i)
+      RemainingComponents[i - 1] = RemainingComponents[i] +
+          elements[i - 1]->GetRows() * elements[i - 1]->GetCols();
+  }
+
+  // Elements that place identically can be tried in position order only.
+  static bool IsInterchangeable(const PackElement *A, const PackElement *B) {
+    return GetElementFlags(A) == GetElementFlags(B) &&
+           A->GetInterpolationMode() == B->GetInterpolationMode() &&
+           A->GetDataBitWidth() == B->GetDataBitWidth() &&
+           A->GetRows() == B->GetRows() && A->GetCols() == B->GetCols();
+  }
+
+  unsigned CountOccupiedComponents() const {
+    unsigned count = 0;
+    for (unsigned row = StartRow; row < Alloc.m_Registers.size(); ++row) {
+      for (unsigned col = 0; col < 4; ++col)
+        count += (Alloc.m_Registers[row].Flags[col] & kEFOccupied) ? 1 : 0;
+    }
+    return count;
+  }
+
+  void Search(unsigned index, unsigned rowsUsed, unsigned components, unsigned unallocated) {
+    if (unallocated > BestUnallocated ||
+        (unallocated == BestUnallocated && rowsUsed >= BestRows))
+      return;
+    if (index == Elements.size()) {
+      Best = Current;
+      BestRows = rowsUsed;
+      BestUnallocated = unallocated;
+      return;
+    }
+    // Rows needed to hold every remaining component; only a bound when all
+    // remaining elements must be allocated to improve on the best.
+    if (BestUnallocated == 0 &&
+        StartRow + (components + RemainingComponents[index] + 3) / 4 >= BestRows)
+      return;
+
+    PackElement *SE = Elements[index];
+    unsigned rows = SE->GetRows();
+    unsigned cols = SE->GetCols();
+    unsigned minRow = StartRow, minCol = 0;
+    if (index > 0 && Current[index - 1].first != kUnallocated &&
+        IsInterchangeable(SE, Elements[index - 1])) {
+      minRow = Current[index - 1].first;
+      minCol = Current[index - 1].second;
+    }
+
+    bool placed = false;
+    for (unsigned row = minRow; rows <= NumRows && row <= StartRow + NumRows - rows; ++row) {
+      if (Alloc.DetectRowConflict(SE, row))
+        continue;
+      bool placedInRow = false;
+      for (unsigned col = (row == minRow) ? minCol : 0; col + cols <= 4; ++col) {
+        if (Alloc.DetectColConflict(SE, row, col))
+          continue;
+        if (Budget == 0)
+          return;
+        --Budget;
+        placed = placedInRow = true;
+        SavedRegisters[index] = Alloc.m_Registers;
+        Alloc.PlaceElement(SE, row, col);
+        Current[index] = Location(row, col);
+        Search(index + 1, std::max(rowsUsed, row + rows), components + rows * cols, unallocated);
+        Alloc.m_Registers.swap(SavedRegisters[index]);
+      }
+      // Every row past the ones in use is as good as the first of them.
+      if (placedInRow && row + rows > rowsUsed)
+        break;
+    }
+    if (!placed) {
+      Current[index] = Location(kUnallocated, kUnallocated);
+      Search(index + 1, rowsUsed, components, unallocated + 1);
+    }
+  }
+
+  unsigned Run(unsigned rowsUsed) {
+    Search(0, rowsUsed, CountOccupiedComponents(), 0);
+    if (BestUnallocated == kUnallocated) {
+      // Budget ran out before a complete placement was found.
+      return std::max(rowsUsed, Alloc.PackGreedy(Elements, StartRow, NumRows));
+    }
+    for (size_t i = 0; i < Elements.size(); ++i) {
+      if (Best[i].first == kUnallocated)
+        continue;
+      Alloc.PlaceElement(Elements[i], Best[i].first, Best[i].second);
+      Elements[i]->SetLocation(Best[i].first, Best[i].second);
+    }
+    return BestRows;
+  }
+};
+
 unsigned DxilSignatureAllocator::PackOptimized(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows) {
+  return PackOptimizedImpl(elements, startRow, numRows, 0);
+}
+
+unsigned DxilSignatureAllocator::PackOptimal(std::vector<PackElement*> elements, unsigned startRow, unsigned numRows,
+                                             unsigned searchBudget) {
+  return PackOptimizedImpl(elements, startRow, numRows, searchBudget);
+}
+
+// With a search budget, arbitrary and system value elements are placed by
+// PackSearch rather than greedily.
+unsigned DxilSignatureAllocator::PackOptimizedImpl(std::vector<PackElement*> &elements, unsigned startRow, unsigned numRows,
+                                                   unsigned searchBudget) {
   unsigned rowsUsed = 0;
 
   // Clip/Cull needs special handling due to limitations unique to these.
@@ -370,18 +497,27 @@ unsigned DxilSignatureAllocator::PackOptimized(std::vector<PackElement*> element
     rowsUsed = std::max(rowsUsed, PackGreedy(indexedtessElements, startRow, numRows, 3));
   }
 
-  // ==========
-  // Allocate arbitrary
-  if (!arbElements.empty()) {
-    std::sort(arbElements.begin(), arbElements.end(), CmpElementsLess);
-    rowsUsed = std::max(rowsUsed, PackGreedy(arbElements, startRow, numRows));
-  }
+  std::sort(arbElements.begin(), arbElements.end(), CmpElementsLess);
+  std::sort(svElements.begin(), svElements.end(), CmpElementsLess);
+  if (searchBudget && !(arbElements.empty() && svElements.empty())) {
+    // ==========
+    // Search for arbitrary and system value placement together
+    std::vector<PackElement*> searchElements(arbElements);
+    searchElements.insert(searchElements.end(), svElements.begin(), svElements.end());
+    PackSearch search(*this, searchElements, startRow, numRows, searchBudget);
+    rowsUsed = std::max(rowsUsed, search.Run(rowsUsed));
+  } else {
+    // ==========
+    // Allocate arbitrary
+    if (!arbElements.empty()) {
+      rowsUsed = std::max(rowsUsed, PackGreedy(arbElements, startRow, numRows));
+    }
 
-  // ==========
-  // Allocate system values
-  if (!svElements.empty()) {
-    std::sort(svElements.begin(), svElements.end(), CmpElementsLess);
-    rowsUsed = std::max(rowsUsed, PackGreedy(svElements, startRow, numRows));
+    // ==========
+    // Allocate system values
+    if (!svElements.empty()) {
+      rowsUsed = std::max(rowsUsed, PackGreedy(svElements, startRow, numRows));
+    }
   }
 
   // ==========
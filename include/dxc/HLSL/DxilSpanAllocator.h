@@ -50,15 +50,21 @@ public:
     DXASSERT_NOMSG(size);
     if (size - 1 > m_Max - m_Min)
       return false;
-    if (pos < m_FirstFree)
-      pos = m_FirstFree;
+    T_index lowest = GetFirstFitLowerBound(size);
+    bool firstFit = align == 1 && !(lowest < pos);
+    if (pos < lowest)
+      pos = lowest;
     if (!UpdatePos(pos, size, align))
       return false;
     T_index end = pos + (size - 1);
     auto next = m_Spans.lower_bound(Span(nullptr, pos, end));
-    if (next == m_Spans.end() || end < next->start)
-      return true;  // it fits here
-    return Find(size, next, pos, align);
+    if (next != m_Spans.end() && !(end < next->start)) {
+      if (!Find(size, next, pos, align))
+        return false;
+    }
+    if (firstFit)
+      m_FirstFit[size] = pos;
+    return true;
   }
 
   // Finds the farthest position at which an element could be allocated.
@@ -87,8 +93,8 @@ public:
       AdvanceFirstFree(result.first);
       return true;
     }
-    // Collision, find a gap from iterator
-    if (!Find(size, result.first, pos, align))
+    // Collision, find a gap
+    if (!Find(size, pos, align))
       return false;
     result = m_Spans.emplace(element, pos, pos + (size - 1));
     return result.second;
@@ -142,6 +148,17 @@ public:
   }
 
 private:
+  // Spans are never removed, only merged, so gaps only shrink and the first
+  // gap that fits a size never moves back. A gap that fits size also fits
+  // any smaller size, so the first fit found for a smaller size bounds it.
+  T_index GetFirstFitLowerBound(T_index size) const {
+    T_index bound = m_FirstFree;
+    auto it = m_FirstFit.upper_bound(size);
+    if (it != m_FirstFit.begin() && bound < (--it)->second)
+      bound = it->second;
+    return bound;
+  }
+
   // Find size gap starting at iterator, updating pos, and returning true if successful
   bool Find(T_index size, typename SpanSet::const_iterator it, T_index &pos, T_index align = 1) {
     pos = it->end;
@@ -195,6 +212,7 @@ private:
 
 private:
   SpanSet m_Spans;
+  std::map<T_index, T_index> m_FirstFit; // size -> position of last first fit
   T_index m_Min, m_Max, m_FirstFree;
   const T_element *m_Unbounded;
   bool m_AllocationFull;
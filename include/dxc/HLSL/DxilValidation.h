@@ -12,6 +12,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 #include "dxc/Support/Global.h"
 #include "dxc/DXIL/DxilConstants.h"
 #include "dxc/Support/WinAdapter.h"
@@ -278,8 +280,43 @@ enum class ValidationRule : unsigned {
 
 const char *GetValidationRuleText(ValidationRule value);
 void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor);
+
+// A rule broken by a module, and where.
+struct ValidationError {
+  ValidationRule Rule;
+  std::string Function;            // Function of the instruction, if any
+  unsigned InstructionIndex = ~0U; // Position of the instruction in Function
+  std::string File;                // Source location, with debug info
+  unsigned Line = 0;
+  unsigned Column = 0;
+};
+
+// Controls how much work validation does once it has found an error.
+struct ValidationOptions {
+  // Stop after this many errors; zero for no limit.
+  unsigned MaxErrors = 0;
+  // If set, errors are recorded here instead of being formatted as text.
+  std::vector<ValidationError> *pErrors = nullptr;
+};
+
+// Receives a callback around each group of rules that validation runs on
+// the current thread, so that profilers can attribute validation time.
+class ValidationObserver {
+public:
+  virtual ~ValidationObserver() {}
+  virtual void beforeRuleGroup(const char *pName) = 0;
+  virtual void afterRuleGroup(const char *pName) = 0;
+};
+
+// Installs pObserver for the current thread and returns the previously
+// installed one. Pass null to remove the observer.
+ValidationObserver *SetThreadValidationObserver(ValidationObserver *pObserver);
+
 HRESULT ValidateDxilModule(_In_ llvm::Module *pModule,
                            _In_opt_ llvm::Module *pDebugModule);
+HRESULT ValidateDxilModule(_In_ llvm::Module *pModule,
+                           _In_opt_ llvm::Module *pDebugModule,
+                           const ValidationOptions &Options);
 
 // DXIL Container Verification Functions (return false on failure)
 
@@ -308,6 +345,11 @@ HRESULT ValidateDxilContainerParts(_In_ llvm::Module *pModule,
                                    _In_opt_ llvm::Module *pDebugModule,
                                    _In_reads_bytes_(ContainerSize) const DxilContainerHeader *pContainer,
                                    _In_ uint32_t ContainerSize);
+HRESULT ValidateDxilContainerParts(_In_ llvm::Module *pModule,
+                                   _In_opt_ llvm::Module *pDebugModule,
+                                   _In_reads_bytes_(ContainerSize) const DxilContainerHeader *pContainer,
+                                   _In_ uint32_t ContainerSize,
+                                   const ValidationOptions &Options);
 
 // Loads module, validating load, but not module.
 HRESULT ValidateLoadModule(_In_reads_bytes_(ILLength) const char *pIL,
@@ -336,11 +378,19 @@ HRESULT ValidateLoadModuleFromContainerLazy(
 HRESULT ValidateDxilBitcode(_In_reads_bytes_(ILLength) const char *pIL,
                             _In_ uint32_t ILLength,
                             _In_ llvm::raw_ostream &DiagStream);
+HRESULT ValidateDxilBitcode(_In_reads_bytes_(ILLength) const char *pIL,
+                            _In_ uint32_t ILLength,
+                            _In_ llvm::raw_ostream &DiagStream,
+                            const ValidationOptions &Options);
 
 // Full container validation, including ValidateDxilModule
 HRESULT ValidateDxilContainer(_In_reads_bytes_(ContainerSize) const void *pContainer,
                               _In_ uint32_t ContainerSize,
                               _In_ llvm::raw_ostream &DiagStream);
+HRESULT ValidateDxilContainer(_In_reads_bytes_(ContainerSize) const void *pContainer,
+                              _In_ uint32_t ContainerSize,
+                              _In_ llvm::raw_ostream &DiagStream,
+                              const ValidationOptions &Options);
 
 class PrintDiagnosticContext {
 private:
@@ -62,13 +62,13 @@ struct HLOptions {
   unsigned bAllResourcesBound      : 1;
   unsigned bDisableOptimizations   : 1;
   unsigned bLegacyCBufferLoad      : 1;
-  unsigned PackingStrategy         : 2;
-  static_assert((unsigned)DXIL::PackingStrategy::Invalid < 4, "otherwise 2 bits is not enough to store PackingStrategy");
+  unsigned PackingStrategy         : 3;
+  static_assert((unsigned)DXIL::PackingStrategy::Invalid < 8, "otherwise 3 bits is not enough to store PackingStrategy");
   unsigned bUseMinPrecision        : 1;
   unsigned bDX9CompatMode          : 1;
   unsigned bFXCCompatMode          : 1;
   unsigned bLegacyResourceReservation : 1;
-  unsigned unused                  : 21;
+  unsigned unused                  : 20;
 };
 
 typedef std::unordered_map<const llvm::Function *, std::unique_ptr<DxilFunctionProps>> DxilFunctionPropsMap;
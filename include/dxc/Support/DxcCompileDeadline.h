@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcCompileDeadline.h                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a per-thread compile deadline checked by long-running passes.    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+
+struct IDxcCancellationToken;
+
+namespace hlsl {
+
+/// Installs a deadline for the compile running on the current thread, and
+/// restores the previously installed one when destroyed. A deadline may also
+/// carry a cancellation token; cancelling it ends the deadline at once.
+///
+/// Passes that can run for a long time call CheckCompileDeadline at points
+/// where stopping is safe. Once the deadline has passed, the check throws
+/// hlsl::Exception with DXC_E_COMPILE_DEADLINE_EXCEEDED, or with
+/// DXC_E_COMPILE_CANCELLED if the token was cancelled, which abandons the
+/// compile. The module being compiled may be left partly transformed, so
+/// nothing may use it afterwards.
+///
+/// A deadline installed while another is active ends no later than it does.
+/// Work handed to other threads must install the deadline there as well,
+/// through the linking constructor.
+class DxcCompileDeadline {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /// Sets a deadline Milliseconds from now, or none if zero, which also ends
+  /// when pToken is cancelled.
+  explicit DxcCompileDeadline(unsigned Milliseconds,
+                              IDxcCancellationToken *pToken = nullptr);
+  /// Installs a deadline that ends with pOther, or never if it is null.
+  explicit DxcCompileDeadline(const DxcCompileDeadline *pOther);
+  ~DxcCompileDeadline();
+
+  DxcCompileDeadline(const DxcCompileDeadline &) = delete;
+  DxcCompileDeadline &operator=(const DxcCompileDeadline &) = delete;
+
+  bool IsExpired() const { return IsCancelled() || IsTimeUp(); }
+  bool IsCancelled() const;
+  bool IsTimeUp() const;
+  unsigned GetMilliseconds() const { return m_milliseconds; }
+
+  /// Returns the deadline installed on the current thread, if any.
+  static const DxcCompileDeadline *GetCurrent();
+
+private:
+  Clock::time_point m_deadline;
+  unsigned m_milliseconds;
+  bool m_enabled;
+  IDxcCancellationToken *m_pToken;
+  const DxcCompileDeadline *m_pOuter; // ends no later than this one
+  const DxcCompileDeadline *m_pPrior; // restored on destruction
+};
+
+/// Returns true if a deadline is installed on this thread and has passed.
+bool IsCompileDeadlineExpired();
+/// Throws hlsl::Exception if a deadline is installed on this thread and has
+/// passed, with DXC_E_COMPILE_CANCELLED if it was cancelled and with
+/// DXC_E_COMPILE_DEADLINE_EXCEEDED otherwise.
+void CheckCompileDeadline();
+
+} // namespace hlsl
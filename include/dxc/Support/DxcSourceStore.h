@@ -0,0 +1,32 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcSourceStore.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the content-addressed store for sources referenced by PDBs.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace hlsl {
+
+/// Returns the name a source is stored under: the lowercase hex MD5 digest
+/// of its contents.
+std::string ComputeSourceDigest(llvm::StringRef Contents);
+
+/// Creates a store which keeps one file per source, named by its digest, in
+/// a directory. The directory is created when the first source is added, if
+/// it does not exist yet. Files whose contents do not match their name, as
+/// left by an interrupted write, are treated as missing.
+HRESULT CreateDirectorySourceStore(_In_ IMalloc *pMalloc,
+                                   _In_z_ LPCWSTR pDirectory,
+                                   _COM_Outptr_ IDxcSourceStore **ppStore);
+
+} // namespace hlsl
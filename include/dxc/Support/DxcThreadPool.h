@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcThreadPool.h                                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a work-stealing thread pool for parallel compiler work.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct IDxcTaskExecutor;
+
+namespace hlsl {
+
+/// Fixed-size pool of worker threads, each owning a task deque.
+///
+/// Tasks submitted from a worker thread go to the front of that worker's
+/// deque, so nested work stays hot in the cache; tasks submitted from other
+/// threads are distributed round-robin. Workers take from the front of their
+/// own deque and steal from the back of the others once it runs dry, which
+/// keeps every thread busy when task costs are very uneven.
+///
+/// Tasks run with no DxcThreadMalloc installed; they must install their own
+/// allocator before calling into components that use the thread malloc.
+///
+/// A task that throws does not take its thread down; the failure of the
+/// first one is kept and returned by the next Wait.
+///
+/// Tasks run under a DxcThreadCountLimit of the creator's thread count
+/// divided among the workers, so pools nested in tasks honour the limit of
+/// the thread that created this pool instead of each starting a thread per
+/// core.
+///
+/// While a host executor is set, pools start no threads of their own.
+/// Tasks are kept in one shared deque instead, and up to ThreadCount host
+/// tasks at a time drain it; Wait runs whatever is still queued on the
+/// waiting thread, so progress never depends on the host having a free
+/// thread.
+class DxcThreadPool {
+public:
+  typedef std::function<void()> Task;
+
+  /// Creates ThreadCount workers, or one per hardware thread if zero.
+  explicit DxcThreadPool(unsigned ThreadCount = 0);
+  /// Waits for all submitted tasks to complete and joins the workers.
+  ~DxcThreadPool();
+
+  DxcThreadPool(const DxcThreadPool &) = delete;
+  DxcThreadPool &operator=(const DxcThreadPool &) = delete;
+
+  /// Queues a task; it may start running before this returns.
+  void Async(Task T);
+  /// Blocks until every task submitted so far has completed. Must not be
+  /// called from a task running on this pool. Returns the HRESULT of the
+  /// first exception a task threw since the last Wait, or S_OK.
+  HRESULT Wait();
+  /// Whether the calling thread is running a task of this pool, which must
+  /// then not wait for or destroy it.
+  bool IsRunningTask() const;
+
+  unsigned GetThreadCount() const { return m_threadCount; }
+  /// One per hardware thread, limited by the maximum thread count.
+  static unsigned GetDefaultThreadCount();
+
+  /// Routes the tasks of pools created afterwards through pExecutor, or
+  /// back to threads of their own if null. The executor is AddRef'd.
+  static void SetHostExecutor(IDxcTaskExecutor *pExecutor);
+  /// Thread cap for pools created by the tasks of a pool of ThreadCount
+  /// threads: an even share of the threads the creator may use.
+  static unsigned GetTaskThreadLimit(unsigned ThreadCount);
+  /// Caps the thread count of pools created afterwards; zero removes the
+  /// cap.
+  static void SetMaxThreadCount(unsigned MaxThreadCount);
+
+private:
+  struct WorkerQueue {
+    std::mutex Lock;
+    std::deque<Task> Tasks;
+  };
+  // Shared with the host tasks, which may outlive the pool when the host
+  // runs them after Wait has already emptied the deque.
+  struct HostQueue {
+    std::mutex Lock;
+    std::deque<Task> Tasks;
+    unsigned Scheduled = 0;               // host tasks not yet drained
+    DxcThreadPool *pPool = nullptr;
+  };
+  class HostTask;
+
+  std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+  std::vector<std::thread> m_threads;
+  std::mutex m_lock;                      // guards the counters below
+  std::condition_variable m_workAvailable;
+  std::condition_variable m_allDone;
+  unsigned m_queued = 0;                  // tasks sitting in a deque
+  unsigned m_unfinished = 0;              // tasks queued or running
+  HRESULT m_firstFailure = S_OK;          // first task that threw
+  bool m_stopping = false;
+  std::atomic<unsigned> m_nextQueue;
+  unsigned m_threadCount = 0;
+  unsigned m_taskThreadLimit = 1;         // thread cap of pools tasks create
+  IDxcTaskExecutor *m_pExecutor = nullptr;
+  std::shared_ptr<HostQueue> m_pHostQueue;
+
+  bool TryTake(unsigned Index, Task &T);
+  void RunWorker(unsigned Index);
+  void AsyncOnHost(Task T);
+  static void RunHostTasks(const std::shared_ptr<HostQueue> &Q,
+                           bool bScheduled);
+  void FinishHostTask(HRESULT hr);
+  static unsigned GetMaxThreadCount();
+};
+
+/// Caps the thread count of pools created on the current thread while in
+/// scope, on top of the process-wide cap. A limit of one runs parallel
+/// stages serially, which -parallel-verify compares against.
+class DxcThreadCountLimit {
+public:
+  explicit DxcThreadCountLimit(unsigned MaxThreadCount);
+  ~DxcThreadCountLimit();
+
+  DxcThreadCountLimit(const DxcThreadCountLimit &) = delete;
+  DxcThreadCountLimit &operator=(const DxcThreadCountLimit &) = delete;
+
+private:
+  unsigned m_priorLimit;
+};
+
+} // namespace hlsl
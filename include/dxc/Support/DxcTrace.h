@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcTrace.h                                                                //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a trace-event writer for compiler events and phases.             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+namespace hlsl {
+
+/// Events are written when the DXC_TRACE_FILE environment variable names a
+/// file, which is created when the first event is traced. Each process writes
+/// a file of its own: %p in the name is replaced by the process ID, and
+/// without it the process ID goes before the extension, so DXC_TRACE_FILE=
+/// trace.json writes trace.1234.json. The file holds
+/// Chrome trace events in the JSON array format, which chrome://tracing and
+/// Perfetto open directly. Every event carries the process and operating
+/// system thread IDs, so the compiles of a batch show up on the threads that
+/// ran them.
+///
+/// Outside Windows the DxcEtw_* events are traced here as well; on Windows
+/// they go to ETW.
+bool IsTraceEnabled();
+
+/// Begins an event on the current thread. pName must stay valid until the
+/// event is written, and needs no escaping in JSON; string literals are used.
+void TraceBegin(const char *pName);
+/// Ends the event most recently begun on the current thread.
+void TraceEnd(const char *pName);
+/// Ends the event most recently begun on the current thread, recording the
+/// HRESULT Status as its result.
+void TraceEnd(const char *pName, long Status);
+
+/// Traces an event for as long as it is in scope.
+class DxcTraceSpan {
+public:
+  explicit DxcTraceSpan(const char *pName)
+      : m_pName(IsTraceEnabled() ? pName : nullptr) {
+    if (m_pName)
+      TraceBegin(m_pName);
+  }
+  ~DxcTraceSpan() {
+    if (m_pName)
+      TraceEnd(m_pName);
+  }
+
+  DxcTraceSpan(const DxcTraceSpan &) = delete;
+  DxcTraceSpan &operator=(const DxcTraceSpan &) = delete;
+
+private:
+  const char *m_pName;
+};
+
+} // namespace hlsl
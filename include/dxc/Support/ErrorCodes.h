@@ -104,3 +104,15 @@
 
 // 0X80AA0019 - Abort compilation error.
 #define DXC_E_ABORT_COMPILATION_ERROR                 DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x0019))
+
+// 0X80AA001A - Compilation did not finish before its deadline.
+#define DXC_E_COMPILE_DEADLINE_EXCEEDED               DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x001A))
+
+// 0X80AA001B - Compilation was cancelled through its cancellation token.
+#define DXC_E_COMPILE_CANCELLED                       DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x001B))
+
+// 0X80AA001C - Compilation needed more memory than its limit.
+#define DXC_E_COMPILE_MEMORY_LIMIT_EXCEEDED           DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x001C))
+
+// 0X80AA001D - Compiling with one thread and with several gave different output.
+#define DXC_E_PARALLEL_OUTPUT_MISMATCH                DXC_MAKE_HRESULT(DXC_SEVERITY_ERROR,FACILITY_DXC,(0x001D))
@@ -161,6 +161,27 @@ DxcCreateBlobFromFile(_In_opt_ IMalloc *pMalloc, LPCWSTR pFileName,
 HRESULT DxcCreateBlobFromFile(LPCWSTR pFileName, _In_opt_ UINT32 *pCodePage,
                               _COM_Outptr_ IDxcBlobEncoding **ppBlobEncoding) throw();
 
+// Maps the file read-only instead of reading it into memory; the blob is a
+// view of the mapping, which is released with the blob. The file must not
+// be truncated or rewritten while the blob is alive.
+HRESULT
+DxcCreateBlobFromFileMapped(_In_opt_ IMalloc *pMalloc, LPCWSTR pFileName,
+                            _In_opt_ UINT32 *pCodePage,
+                            _COM_Outptr_ IDxcBlobEncoding **ppBlobEncoding) throw();
+
+enum class MappedFileAccess {
+  ReadOnly,    // Writes to the view fault.
+  CopyOnWrite, // Writes to the view are private to the blob.
+  WriteBack,   // Writes to the view go to the file.
+};
+
+// Maps the file so that the blob can be edited in place, as the validator
+// does when it signs a container. ReadOnly access is not accepted here.
+HRESULT
+DxcCreateWritableBlobFromFileMapped(_In_opt_ IMalloc *pMalloc, LPCWSTR pFileName,
+                                    MappedFileAccess access,
+                                    _COM_Outptr_ IDxcBlob **ppBlob) throw();
+
 // Given a blob, creates a subrange view.
 HRESULT DxcCreateBlobFromBlob(_In_ IDxcBlob *pBlob, UINT32 offset,
                               UINT32 length,
@@ -54,6 +54,13 @@ void DxcClearThreadMalloc() throw();
 // Used to retrieve the current invocation's allocator or perform an alloc/free/realloc.
 IMalloc *DxcGetThreadMallocNoRef() throw();
 
+// Creates an allocator that carves small allocations out of large blocks
+// taken from pBacking. Freeing one of its own allocations does no work; the
+// blocks go back to pBacking together when the last reference is released.
+// Intended to be installed with DxcThreadMalloc for the duration of a single
+// compile, on a single thread.
+HRESULT DxcCreateArenaMalloc(IMalloc *pBacking, IMalloc **ppArena) throw();
+
 class DxcThreadMalloc {
 public:
   explicit DxcThreadMalloc(IMalloc *pMallocOrNull) throw();
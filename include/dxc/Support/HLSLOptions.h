@@ -116,7 +116,18 @@ public:
   llvm::StringRef OutputReflectionFile; // OPT_Fre
   llvm::StringRef OutputRootSigFile; // OPT_Frs
   llvm::StringRef OutputShaderHashFile; // OPT_Fsh
+  llvm::StringRef OutputStatisticsFile; // OPT_Fstats
   llvm::StringRef Preprocess; // OPT_P
+  llvm::StringRef PchFile; // OPT_Fp
+  llvm::StringRef PchHeader; // OPT_Yu
+  llvm::StringRef DependencyFile; // OPT_MF
+  llvm::StringRef DependencyTarget; // OPT_MT
+  llvm::StringRef BatchManifest; // OPT_batch
+  llvm::StringRef BatchReport; // OPT_batch_report
+  unsigned BatchThreads = 0; // OPT_batch_threads
+  llvm::StringRef ServerEndpoint; // OPT_server
+  llvm::StringRef SourceStore; // OPT_Qsource_store
+  llvm::StringRef ConnectEndpoint; // OPT_connect
   llvm::StringRef TargetProfile; // OPT_target_profile
   llvm::StringRef VariableName; // OPT_Vn
   llvm::StringRef PrivateSource; // OPT_setprivate
@@ -125,7 +136,9 @@ public:
   llvm::StringRef RootSignatureDefine; // OPT_rootsig_define
   llvm::StringRef FloatDenormalMode; // OPT_denorm
   std::vector<std::string> Exports; // OPT_exports
+  llvm::StringRef ExportsFile; // OPT_exports_file
   llvm::StringRef DefaultLinkage; // OPT_default_linkage
+  std::vector<std::string> Specializations; // OPT_specialize
   unsigned DefaultTextCodePage = DXC_CP_UTF8; // OPT_encoding
 
   bool AllResourcesBound = false; // OPT_all_resources_bound
@@ -152,6 +165,16 @@ public:
   unsigned long HLSLVersion = 0; // OPT_hlsl_version (2015-2018)
   bool Enable16BitTypes = false; // OPT_enable_16bit_types
   bool OptDump = false; // OPT_ODump - dump optimizer commands
+  bool TimeReport = false; // OPT_ftime_report
+  bool MemoryReport = false; // OPT_fmemory_report
+  unsigned MemoryLimit = 0; // OPT_memory_limit, in MiB
+  bool CompileArena = false; // OPT_fcompile_arena
+  unsigned CompileDeadline = 0; // OPT_compile_deadline
+  bool CompileDeadlineFallback = false; // OPT_compile_deadline_fallback
+  bool ParallelVerify = false; // OPT_parallel_verify
+  bool PchCreate = false; // OPT_Yc
+  bool DependenciesOnly = false; // OPT_M
+  bool OutputDependencies = false; // OPT_M or OPT_MD
   bool OutputWarnings = true; // OPT_no_warnings
   bool ShowHelp = false;  // OPT_help
   bool ShowHelpHidden = false; // OPT__help_hidden
@@ -163,12 +186,16 @@ public:
   bool NotUseLegacyCBufLoad = false;  // OPT_no_legacy_cbuf_layout
   bool PackPrefixStable = false;  // OPT_pack_prefix_stable
   bool PackOptimized = false;  // OPT_pack_optimized
+  bool PackOptimal = false;  // OPT_pack_optimal
   bool DisplayIncludeProcess = false; // OPT__vi
   bool RecompileFromBinary = false; // OPT _Recompile (Recompiling the DXBC binary file not .hlsl file)
   bool StripDebug = false; // OPT Qstrip_debug
   bool EmbedDebug = false; // OPT Qembed_debug
   bool StripRootSignature = false; // OPT_Qstrip_rootsignature
   bool StripPrivate = false; // OPT_Qstrip_priv
+  bool FastShaderHash = false; // OPT_Qfast_hash
+  bool LineTable = false; // OPT_Qline_table
+  bool CompressDebug = false; // OPT_Qcompress_debug
   bool StripReflection = false; // OPT_Qstrip_reflect
   bool KeepReflectionInDxil = false; // OPT_Qkeep_reflect_in_dxil
   bool StripReflectionFromDxil = false; // OPT_Qstrip_reflect_from_dxil
@@ -184,6 +211,16 @@ public:
   bool ResMayAlias = false; // OPT_res_may_alias
   unsigned long ValVerMajor = UINT_MAX, ValVerMinor = UINT_MAX; // OPT_validator_version
   unsigned ScanLimit = 0; // OPT_memdep_block_scan_limit
+  llvm::StringRef ProfileUseFile; // OPT_profile_use
+  unsigned Auto16BitPrecision = 0; // OPT_auto_16bit_precision
+  bool PadGroupShared = false; // OPT_pad_groupshared
+  bool MinimizeMeshOutputs = false; // OPT_minimize_mesh_outputs
+  bool ReportLoopHandles = false; // OPT_report_loop_handles
+  bool FastTrig = false; // OPT_fast_trig
+  bool WaveAggregateAtomics = false; // OPT_wave_aggregate_atomics
+  bool HoistUniform = false; // OPT_hoist_uniform
+  unsigned MaxLiveScalars = 0; // OPT_max_live_scalars
+  llvm::StringRef FPContract; // OPT_ffp_contract
 
   // Rewriter Options
   RewriterOpts RWOpt;
@@ -42,8 +42,13 @@ struct SpirvCodeGenOptions {
   bool debugInfoLine;
   bool debugInfoSource;
   bool debugInfoTool;
+  /// Emit at most one OpLine per source line instead of one per column
+  bool debugInfoCompact;
   bool defaultRowMajor;
   bool disableValidation;
+  /// Keep SPIRV-Tools objects for later compiles; off while the compile
+  /// allocates from its own malloc.
+  bool poolTools;
   bool enable16BitTypes;
   bool enableReflect;
   bool invertY; // Additive inverse
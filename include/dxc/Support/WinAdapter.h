@@ -211,17 +211,24 @@
 
 // Event Tracing for Windows (ETW) provides application programmers the ability
 // to start and stop event tracing sessions, instrument an application to
-// provide trace events, and consume trace events.
-#define DxcEtw_DXCompilerCreateInstance_Start()
-#define DxcEtw_DXCompilerCreateInstance_Stop(hr)
-#define DxcEtw_DXCompilerCompile_Start()
-#define DxcEtw_DXCompilerCompile_Stop(hr)
-#define DxcEtw_DXCompilerDisassemble_Start()
-#define DxcEtw_DXCompilerDisassemble_Stop(hr)
-#define DxcEtw_DXCompilerPreprocess_Start()
-#define DxcEtw_DXCompilerPreprocess_Stop(hr)
-#define DxcEtw_DxcValidation_Start()
-#define DxcEtw_DxcValidation_Stop(hr)
+// provide trace events, and consume trace events. Elsewhere the same events
+// go to the trace-event writer in DxcTrace.h.
+#ifdef __cplusplus
+namespace hlsl {
+void TraceBegin(const char *pName);
+void TraceEnd(const char *pName, long Status);
+} // namespace hlsl
+#define DxcEtw_DXCompilerCreateInstance_Start() ::hlsl::TraceBegin("DXCompilerCreateInstance")
+#define DxcEtw_DXCompilerCreateInstance_Stop(hr) ::hlsl::TraceEnd("DXCompilerCreateInstance", (hr))
+#define DxcEtw_DXCompilerCompile_Start() ::hlsl::TraceBegin("DXCompilerCompile")
+#define DxcEtw_DXCompilerCompile_Stop(hr) ::hlsl::TraceEnd("DXCompilerCompile", (hr))
+#define DxcEtw_DXCompilerDisassemble_Start() ::hlsl::TraceBegin("DXCompilerDisassemble")
+#define DxcEtw_DXCompilerDisassemble_Stop(hr) ::hlsl::TraceEnd("DXCompilerDisassemble", (hr))
+#define DxcEtw_DXCompilerPreprocess_Start() ::hlsl::TraceBegin("DXCompilerPreprocess")
+#define DxcEtw_DXCompilerPreprocess_Stop(hr) ::hlsl::TraceEnd("DXCompilerPreprocess", (hr))
+#define DxcEtw_DxcValidation_Start() ::hlsl::TraceBegin("DxcValidation")
+#define DxcEtw_DxcValidation_Stop(hr) ::hlsl::TraceEnd("DxcValidation", (hr))
+#endif // __cplusplus
 
 #define UInt32Add UIntAdd
 #define Int32ToUInt32 IntToUInt
@@ -935,16 +942,18 @@ public:
 // Convert Windows codepage value to locale string
 const char *CPToLocale(uint32_t CodePage);
 
-// The t_nBufferLength parameter is part of the published interface, but not
-// used here.
+// Strings shorter than t_nBufferLength characters are converted into an
+// inline buffer, as with ATL. ASCII strings are converted directly, without
+// switching locales.
 template <int t_nBufferLength = 128> class CW2AEX {
 public:
-  CW2AEX(LPCWSTR psz, UINT nCodePage = CP_UTF8) {
+  CW2AEX(LPCWSTR psz, UINT nCodePage = CP_UTF8) : m_psz(m_szBuffer) {
     const char *locale = CPToLocale(nCodePage);
     if (locale == nullptr) {
       // Current Implementation only supports CP_UTF8, and CP_ACP
       assert(false && "CW2AEX implementation for Linux only handles "
                       "UTF8 and ACP code pages");
+      m_psz = NULL;
       return;
     }
 
@@ -953,31 +962,52 @@ public:
       return;
     }
 
+    size_t srcLen = wcslen(psz);
+    wchar_t bits = 0;
+    for (size_t i = 0; i < srcLen; ++i)
+      bits |= psz[i];
+    if ((bits & ~0x7F) == 0) {
+      if (srcLen >= t_nBufferLength)
+        m_psz = new char[srcLen + 1];
+      for (size_t i = 0; i <= srcLen; ++i)
+        m_psz[i] = (char)psz[i];
+      return;
+    }
+
     locale = setlocale(LC_ALL, locale);
-    int len = (wcslen(psz) + 1) * 4;
-    m_psz = new char[len];
+    int len = (srcLen + 1) * 4;
+    if (len > t_nBufferLength)
+      m_psz = new char[len];
     std::wcstombs(m_psz, psz, len);
     setlocale(LC_ALL, locale);
   }
 
-  ~CW2AEX() { delete[] m_psz; }
+  ~CW2AEX() {
+    if (m_psz != m_szBuffer)
+      delete[] m_psz;
+  }
 
   operator LPSTR() const { return m_psz; }
 
   char *m_psz;
+  char m_szBuffer[t_nBufferLength];
+
+private:
+  CW2AEX(const CW2AEX &) = delete;
+  CW2AEX &operator=(const CW2AEX &) = delete;
 };
 typedef CW2AEX<> CW2A;
 
-// The t_nBufferLength parameter is part of the published interface, but not
-// used here.
+// See CW2AEX.
 template <int t_nBufferLength = 128> class CA2WEX {
 public:
-  CA2WEX(LPCSTR psz, UINT nCodePage = CP_UTF8) {
+  CA2WEX(LPCSTR psz, UINT nCodePage = CP_UTF8) : m_psz(m_szBuffer) {
     const char *locale = CPToLocale(nCodePage);
     if (locale == nullptr) {
       // Current Implementation only supports CP_UTF8, and CP_ACP
       assert(false && "CA2WEX implementation for Linux only handles "
                       "UTF8 and ACP code pages");
+      m_psz = NULL;
       return;
     }
 
@@ -986,18 +1016,36 @@ public:
       return;
     }
 
-    locale = setlocale(LC_ALL, locale);
     int len = strlen(psz) + 1;
-    m_psz = new wchar_t[len];
+    if (len > t_nBufferLength)
+      m_psz = new wchar_t[len];
+    char bits = 0;
+    for (int i = 0; i < len; ++i)
+      bits |= psz[i];
+    if ((bits & 0x80) == 0) {
+      for (int i = 0; i < len; ++i)
+        m_psz[i] = (wchar_t)psz[i];
+      return;
+    }
+
+    locale = setlocale(LC_ALL, locale);
     std::mbstowcs(m_psz, psz, len);
     setlocale(LC_ALL, locale);
   }
 
-  ~CA2WEX() { delete[] m_psz; }
+  ~CA2WEX() {
+    if (m_psz != m_szBuffer)
+      delete[] m_psz;
+  }
 
   operator LPWSTR() const { return m_psz; }
 
   wchar_t *m_psz;
+  wchar_t m_szBuffer[t_nBufferLength];
+
+private:
+  CA2WEX(const CA2WEX &) = delete;
+  CA2WEX &operator=(const CA2WEX &) = delete;
 };
 
 typedef CA2WEX<> CA2W;
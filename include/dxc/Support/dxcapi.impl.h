@@ -96,13 +96,18 @@ inline DxcOutputType DxcGetOutputType(DXC_OUT_KIND kind) {
   case DXC_OUT_DISASSEMBLY:
   case DXC_OUT_HLSL:
   case DXC_OUT_TEXT:
+  case DXC_OUT_TIME_REPORT:
+  case DXC_OUT_MEMORY_REPORT:
+  case DXC_OUT_SPIRV_REFLECTION:
+  case DXC_OUT_DEPENDENCIES:
+  case DXC_OUT_SHADER_STATISTICS:
     return DxcOutputType_Text;
   }
   return DxcOutputType_None;
 }
 
 // Update when new results are allowed
-static const unsigned kNumDxcOutputTypes = DXC_OUT_ROOT_SIGNATURE;
+static const unsigned kNumDxcOutputTypes = DXC_OUT_SHADER_STATISTICS;
 static const SIZE_T kAutoSize = (SIZE_T)-1;
 static const LPCWSTR DxcOutNoName = nullptr;
 
@@ -163,6 +163,10 @@ inline DxcDefine GetDefine(_In_ LPCWSTR name, LPCWSTR value) {
 void IFT_Data(HRESULT hr, _In_opt_ LPCWSTR data);
 
 void EnsureEnabled(DxcDllSupport &dxcSupport);
+// Caps the threads of each parallel operation inside the DLL, whose pools do
+// not see the thread limits of the calling module. Does nothing for DLLs
+// without IDxcTaskScheduling.
+void SetDllMaxThreadCount(DxcDllSupport &dxcSupport, unsigned MaxThreadCount);
 void ReadFileIntoBlob(DxcDllSupport &dxcSupport, _In_ LPCWSTR pFileName,
                       _Outptr_ IDxcBlobEncoding **ppBlobEncoding);
 void WriteBlobToConsole(_In_opt_ IDxcBlob *pBlob, DWORD streamType = STD_OUTPUT_HANDLE);
@@ -38,6 +38,8 @@ public:
   virtual void GetStdOutpuHandleStream(IStream **ppResultStream) = 0;
   virtual void WriteStdErrToStream(llvm::raw_string_ostream &s) = 0;
   virtual void EnableDisplayIncludeProcess() = 0;
+  // Loads pPchName from the include handler whenever pHeaderName is included.
+  virtual void SetPrecompiledHeader(LPCWSTR pHeaderName, LPCWSTR pPchName) = 0;
   virtual HRESULT CreateStdStreams(_In_ IMalloc *pMalloc) = 0;
   virtual HRESULT RegisterOutputStream(LPCWSTR pName, IStream *pStream) = 0;
 };
@@ -448,6 +448,42 @@ IDxcUtils : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcUtils)
 };
 
+// A shader archive opened with IDxcShaderArchiveUtils. Lookups read only the
+// index and the container found.
+struct __declspec(uuid("f98ce2d3-ed43-42e4-bef5-6db4776c98f1"))
+IDxcShaderArchive : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE GetContainerCount(_Out_ UINT32 *pResult) = 0;
+  // Gets a container by index; containers are ordered by shader hash.
+  virtual HRESULT STDMETHODCALLTYPE GetContainer(
+    UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) = 0;
+  // Returns S_FALSE and a null blob if no container matches.
+  virtual HRESULT STDMETHODCALLTYPE FindContainerByHash(
+    _In_ const DxcShaderHash *pHash, _COM_Outptr_result_maybenull_ IDxcBlob **ppResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE FindContainerByName(
+    _In_z_ LPCWSTR pName, _COM_Outptr_result_maybenull_ IDxcBlob **ppResult) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchive)
+};
+
+// Writes and opens shader archives (DxilShaderArchiveHeader): containers
+// indexed by shader hash and name, with names and root signatures pooled.
+// QueryInterface for it on IDxcUtils.
+struct __declspec(uuid("f0464fa8-13a9-4090-8d6a-2b7fca7c77ab"))
+IDxcShaderArchiveUtils : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE WriteShaderArchive(
+    _In_count_(count) IDxcBlob **ppContainers,    // Containers to archive
+    _In_opt_count_(count) LPCWSTR *pNames,        // Optional names; a null name uses the container's debug name, if any
+    UINT32 count,
+    _COM_Outptr_ IDxcBlob **ppArchive) = 0;
+  // Maps the file rather than reading it.
+  virtual HRESULT STDMETHODCALLTYPE OpenShaderArchive(
+    _In_z_ LPCWSTR pFileName, _COM_Outptr_ IDxcShaderArchive **ppResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE LoadShaderArchive(
+    _In_ IDxcBlob *pArchive, _COM_Outptr_ IDxcShaderArchive **ppResult) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchiveUtils)
+};
+
 // For use with IDxcResult::[Has|Get]Output dxcOutKind argument
 // Note: text outputs returned from version 2 APIs are UTF-8 or UTF-16 based on -encoding option
 typedef enum DXC_OUT_KIND {
@@ -461,6 +497,11 @@ typedef enum DXC_OUT_KIND {
   DXC_OUT_TEXT = 7,           // IDxcBlobUtf8 or IDxcBlobUtf16 - other text, such as -ast-dump or -Odump
   DXC_OUT_REFLECTION = 8,     // IDxcBlob - RDAT part with reflection data
   DXC_OUT_ROOT_SIGNATURE = 9, // IDxcBlob - Serialized root signature output
+  DXC_OUT_TIME_REPORT = 10,   // IDxcBlobUtf8 or IDxcBlobUtf16 - JSON phase and pass profile (-ftime-report)
+  DXC_OUT_MEMORY_REPORT = 11, // IDxcBlobUtf8 or IDxcBlobUtf16 - JSON allocation totals (-fmemory-report)
+  DXC_OUT_SPIRV_REFLECTION = 12, // IDxcBlobUtf8 or IDxcBlobUtf16 - JSON SPIR-V bindings, locations and constants (-spirv with -Fre or -fspv-reflect)
+  DXC_OUT_DEPENDENCIES = 13, // IDxcBlobUtf8 or IDxcBlobUtf16 - make dependency rule for the files the source includes (-M or -MD)
+  DXC_OUT_SHADER_STATISTICS = 14, // IDxcBlobUtf8 or IDxcBlobUtf16 - JSON static cost statistics of each entry (-Fstats)
 
   DXC_OUT_FORCE_DWORD = 0xFFFFFFFF
 } DXC_OUT_KIND;
@@ -502,6 +543,425 @@ IDxcCompiler3 : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompiler3)
 };
 
+// Storage backend for the compile result cache. Keys are digests computed by
+// the compiler and values are serialized compile results; both are opaque to
+// the store. Implementations must be safe to call from multiple threads.
+struct __declspec(uuid("4d91481f-1be0-4df0-9cfb-7354637cc67d"))
+IDxcCompileCacheStore : public IUnknown {
+  // Returns S_OK and the stored value on a hit, or S_FALSE and nullptr on a miss.
+  virtual HRESULT STDMETHODCALLTYPE Lookup(
+    _In_ const DxcBuffer *pKey,                       // Digest identifying the compile
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppValue  // Stored value, or nullptr on a miss
+  ) = 0;
+
+  // Stores a value, replacing any previous value for the same key.
+  virtual HRESULT STDMETHODCALLTYPE Store(
+    _In_ const DxcBuffer *pKey,                       // Digest identifying the compile
+    _In_ IDxcBlob *pValue                             // Value to store
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompileCacheStore)
+};
+
+// Opt-in compile result cache; QueryInterface for it on IDxcCompiler3.
+// Successful compiles are keyed on the preprocessed source, the contents of
+// every included file, the normalized arguments, and the compiler and
+// validator versions. A hit returns the stored outputs without running codegen.
+// Disassemble uses the same store, keyed on the program bytes.
+struct __declspec(uuid("6e4a37b1-a2bb-43ae-b5b2-770ec59d2aca"))
+IDxcCompileCache : public IUnknown {
+  // Sets the store used by subsequent Compile calls; nullptr disables caching.
+  virtual HRESULT STDMETHODCALLTYPE SetStore(
+    _In_opt_ IDxcCompileCacheStore *pStore) = 0;
+
+  // Creates an in-memory store which evicts the least recently used entries
+  // once the stored values exceed maxSizeInBytes.
+  virtual HRESULT STDMETHODCALLTYPE CreateMemoryStore(
+    _In_ UINT64 maxSizeInBytes,
+    _COM_Outptr_ IDxcCompileCacheStore **ppStore) = 0;
+
+  // Creates a store which keeps one file per entry in an existing directory.
+  virtual HRESULT STDMETHODCALLTYPE CreateDirectoryStore(
+    _In_z_ LPCWSTR pDirectory,
+    _COM_Outptr_ IDxcCompileCacheStore **ppStore) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompileCache)
+};
+
+// One compile in a batch; the fields match the arguments of IDxcCompiler3::Compile.
+struct DxcCompileJob {
+  const DxcBuffer *pSource;                       // Source text to compile
+  LPCWSTR *pArguments;                            // Array of pointers to arguments
+  UINT32 argCount;                                // Number of arguments
+};
+
+// Receives the results of a batch as the jobs complete.
+struct __declspec(uuid("dab20b20-e490-488f-8568-db62e7980bed"))
+IDxcCompileBatchCallback : public IUnknown {
+  // Called once per job, in completion order, from one of the batch threads.
+  // Calls are never made concurrently. A failure cancels the jobs that have
+  // not started yet and is returned from CompileBatch.
+  virtual HRESULT STDMETHODCALLTYPE OnCompileComplete(
+    _In_ UINT32 jobIndex,                         // Index of the job in pJobs
+    _In_ IDxcResult *pResult                      // Status, outputs, and errors of the job
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompileBatchCallback)
+};
+
+// Compiles many shaders at once; QueryInterface for it on IDxcCompiler3.
+// Jobs run on a pool of worker threads. Jobs with identical source buffers
+// decode the source once, and every #include is loaded from the handler
+// only once per batch.
+struct __declspec(uuid("132ce5cf-6269-4abd-b894-bc3991bab002"))
+IDxcCompilerBatch : public IUnknown {
+  // Returns once every job has completed or the batch was cancelled.
+  virtual HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_count_(jobCount) const DxcCompileJob *pJobs, // Jobs to compile
+    _In_ UINT32 jobCount,                         // Number of jobs
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional); never called concurrently
+    _In_ UINT32 threadCount,                      // Number of worker threads, or 0 for one per hardware thread
+    _In_ IDxcCompileBatchCallback *pCallback      // Receives each result
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerBatch)
+};
+
+// One entry point of a multi-entry compile.
+struct DxcEntryPoint {
+  LPCWSTR pName;                                  // Entry point name, as for -E
+  LPCWSTR pTargetProfile;                         // Shader profile, as for -T
+};
+
+// Compiles one source for many entry points; QueryInterface for it on
+// IDxcCompiler3. Each entry point runs as a job of a batch, so the source is
+// decoded once, every #include is loaded once, and the entry points compile
+// in parallel.
+struct __declspec(uuid("5b0e3b8c-2f4d-4c71-9a64-8d1f0c7e2a93"))
+IDxcCompilerMultiEntry : public IUnknown {
+  // Returns once every entry point has been compiled, with one result per
+  // entry point in the order of pEntryPoints.
+  virtual HRESULT STDMETHODCALLTYPE CompileEntryPoints(
+    _In_ const DxcBuffer *pSource,                // Source text to compile
+    _In_opt_count_(argCount) LPCWSTR *pArguments, // Arguments shared by every entry point, without -E and -T
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(entryPointCount) const DxcEntryPoint *pEntryPoints, // Entry points to compile
+    _In_ UINT32 entryPointCount,                  // Number of entry points
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional); never called concurrently
+    _In_ UINT32 threadCount,                      // Number of worker threads, or 0 for one per hardware thread
+    _Out_writes_(entryPointCount) IDxcResult **ppResults // Status, outputs, and errors of each entry point
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerMultiEntry)
+};
+
+// One permutation of a permutation compile.
+struct DxcPermutation {
+  const DxcDefine *pDefines;                      // Defines added to the shared arguments, as for -D
+  UINT32 defineCount;                             // Number of defines
+};
+
+// Compiles one source for many sets of defines; QueryInterface for it on
+// IDxcCompiler3. Each permutation runs as a job of a batch, so the source is
+// decoded once, every #include is loaded once, and the permutations compile
+// in parallel.
+struct __declspec(uuid("e1b7a3d6-0c52-4f8e-a9d4-3f6b2c81e570"))
+IDxcCompilerPermutations : public IUnknown {
+  // Returns once every permutation has been compiled, with one result per
+  // permutation in the order of pPermutations.
+  virtual HRESULT STDMETHODCALLTYPE CompilePermutations(
+    _In_ const DxcBuffer *pSource,                // Source text to compile
+    _In_opt_count_(argCount) LPCWSTR *pArguments, // Arguments shared by every permutation
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(permutationCount) const DxcPermutation *pPermutations, // Define sets to compile
+    _In_ UINT32 permutationCount,                 // Number of permutations
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional); never called concurrently
+    _In_ UINT32 threadCount,                      // Number of worker threads, or 0 for one per hardware thread
+    _Out_writes_(permutationCount) IDxcResult **ppResults // Status, outputs, and errors of each permutation
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerPermutations)
+};
+
+// Optional interface for include handlers; an include cache queries the
+// handler for it to check whether a cached file is still current.
+struct __declspec(uuid("ac74944d-80ba-474a-96e0-235965691e7c"))
+IDxcIncludeStamp : public IUnknown {
+  // Returns S_OK and a value that changes whenever the file does, such as its
+  // last write time, or S_FALSE if the handler cannot provide one.
+  virtual HRESULT STDMETHODCALLTYPE GetSourceStamp(
+    _In_z_ LPCWSTR pFilename,                     // Resolved name passed to LoadSource
+    _Out_ UINT64 *pStamp                          // Content stamp
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcIncludeStamp)
+};
+
+// Cache of loaded #include files that many compiles can share, from any
+// number of compiler objects and threads. Files are keyed on the resolved
+// path and on the stamp reported through IDxcIncludeStamp; files from handlers
+// without stamps are reused until they are invalidated.
+struct __declspec(uuid("d78257d7-cdba-4df4-91fa-994615459196"))
+IDxcIncludeCache : public IUnknown {
+  // Returns the cached file, or loads it through pHandler and caches it.
+  virtual HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_ IDxcIncludeHandler *pHandler,            // Handler used on a miss
+    _In_z_ LPCWSTR pFilename,                     // Resolved name of the file
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource
+  ) = 0;
+
+  // Drops the cached copy of pFilename, or of every file if it is nullptr.
+  virtual HRESULT STDMETHODCALLTYPE Invalidate(
+    _In_opt_z_ LPCWSTR pFilename) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcIncludeCache)
+};
+
+// Attaches an include cache to a compiler; QueryInterface for it on
+// IDxcCompiler3. Once attached, every Compile and CompileBatch call on the
+// compiler loads includes through the cache before calling the handler.
+struct __declspec(uuid("f9b4ff6f-4240-4266-bdef-23842e3d49a6"))
+IDxcCompilerIncludeCache : public IUnknown {
+  // Sets the cache used by subsequent compiles; nullptr detaches it.
+  virtual HRESULT STDMETHODCALLTYPE SetIncludeCache(
+    _In_opt_ IDxcIncludeCache *pCache) = 0;
+
+  // Creates an empty cache which can be attached to any number of compilers.
+  virtual HRESULT STDMETHODCALLTYPE CreateIncludeCache(
+    _COM_Outptr_ IDxcIncludeCache **ppCache) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerIncludeCache)
+};
+
+// Asks an in-flight compile to stop. The compile polls the token between
+// phases and passes, and stops with DXC_E_COMPILE_CANCELLED once it has been
+// cancelled. Implementations must be safe to call from multiple threads.
+struct __declspec(uuid("9e370ffb-db99-4b9e-bee2-a13989b37a2c"))
+IDxcCancellationToken : public IUnknown {
+  // Cancels every compile using this token; it stays cancelled.
+  virtual HRESULT STDMETHODCALLTYPE Cancel() = 0;
+
+  // Returns TRUE once Cancel has been called.
+  virtual BOOL STDMETHODCALLTYPE IsCancelled() = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCancellationToken)
+};
+
+// Cancellable compiles; QueryInterface for it on IDxcCompiler3.
+struct __declspec(uuid("84ef4331-2227-410c-b82c-63e0246576f1"))
+IDxcCompilerCancellation : public IUnknown {
+  // Creates a token that is not cancelled.
+  virtual HRESULT STDMETHODCALLTYPE CreateCancellationToken(
+    _COM_Outptr_ IDxcCancellationToken **ppToken) = 0;
+
+  // Compiles like IDxcCompiler3::Compile. Cancelling pToken from another
+  // thread makes the compile return soon after with a result whose status
+  // is DXC_E_COMPILE_CANCELLED.
+  virtual HRESULT STDMETHODCALLTYPE CompileCancellable(
+    _In_ const DxcBuffer *pSource,                // Source text to compile
+    _In_opt_count_(argCount) LPCWSTR *pArguments, // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _In_opt_ IDxcCancellationToken *pToken,       // Token polled by the compile (optional)
+    _In_ REFIID riid, _Out_ LPVOID *ppResult      // IDxcResult: status, buffer, and errors
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerCancellation)
+};
+
+// Work scheduled on an IDxcTaskExecutor.
+struct __declspec(uuid("04b9b959-e0af-4f85-8ada-a9b9debe0b9e"))
+IDxcTask : public IUnknown {
+  virtual void STDMETHODCALLTYPE Run() = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcTask)
+};
+
+// Host scheduler for asynchronous compiles, such as a job system.
+struct __declspec(uuid("747c08f4-ca65-4dcb-812a-b31a41ae5377"))
+IDxcTaskExecutor : public IUnknown {
+  // Runs pTask once, on any thread, and releases it afterwards. Schedule may
+  // be called from any thread. A failure means pTask will not be run.
+  // Releasing a task that was accepted but never run cancels its compile.
+  virtual HRESULT STDMETHODCALLTYPE Schedule(_In_ IDxcTask *pTask) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcTaskExecutor)
+};
+
+struct IDxcAsyncResult;
+
+// Notified when an asynchronous compile completes.
+struct __declspec(uuid("f3cc798d-ae2a-4f32-a2a9-32cd844aec75"))
+IDxcAsyncCompileCallback : public IUnknown {
+  // Called once, from the thread that completed the compile, or from
+  // AddCompletionCallback if the compile had already completed.
+  virtual void STDMETHODCALLTYPE OnCompileComplete(
+    _In_ IDxcAsyncResult *pAsync) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcAsyncCompileCallback)
+};
+
+// A compile that may still be running. All methods may be called from any
+// thread.
+struct __declspec(uuid("26f952eb-436a-4da7-afaf-500472a44b85"))
+IDxcAsyncResult : public IUnknown {
+  // Returns TRUE once the result is available.
+  virtual BOOL STDMETHODCALLTYPE IsComplete() = 0;
+
+  // Waits up to timeoutMs milliseconds, or without limit for INFINITE (0xFFFFFFFF), and
+  // returns S_OK if the compile completed or S_FALSE if it did not.
+  virtual HRESULT STDMETHODCALLTYPE Wait(_In_ UINT32 timeoutMs) = 0;
+
+  // Waits for the compile and returns its result.
+  virtual HRESULT STDMETHODCALLTYPE GetResult(
+    _In_ REFIID riid, _Out_ LPVOID *ppResult      // IDxcResult: status, buffer, and errors
+  ) = 0;
+
+  // Calls pCallback once the compile completes, before returning if it has
+  // already completed.
+  virtual HRESULT STDMETHODCALLTYPE AddCompletionCallback(
+    _In_ IDxcAsyncCompileCallback *pCallback) = 0;
+
+  // Asks the compile to stop. Its result then has the status
+  // DXC_E_COMPILE_CANCELLED, unless it completed first.
+  virtual HRESULT STDMETHODCALLTYPE Cancel() = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcAsyncResult)
+};
+
+// Asynchronous compiles; QueryInterface for it on IDxcCompiler3.
+struct __declspec(uuid("67976341-b420-4623-a5a7-e4224a09d722"))
+IDxcCompilerAsync : public IUnknown {
+  // Compiles like IDxcCompiler3::Compile without waiting for the compile.
+  // The source, arguments and include handler are copied or referenced, so
+  // the caller need not keep them. Without pExecutor the compile runs on a
+  // thread pool owned by the compiler, and releasing the compiler waits for
+  // those compiles; completion callbacks must not release its last
+  // reference.
+  virtual HRESULT STDMETHODCALLTYPE CompileAsync(
+    _In_ const DxcBuffer *pSource,                // Source text to compile
+    _In_opt_count_(argCount) LPCWSTR *pArguments, // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional); called from the compiling thread
+    _In_opt_ IDxcTaskExecutor *pExecutor,         // Runs the compile (optional)
+    _COM_Outptr_ IDxcAsyncResult **ppAsync        // The compile in flight
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerAsync)
+};
+
+// Controls the threads used for parallel work inside DXC: batch and
+// asynchronous compiles, validation, linking, optimizer variants and
+// container serialization. The settings are process-wide and apply to
+// parallel work started after they change. QueryInterface for it on
+// IDxcUtils.
+struct __declspec(uuid("22835e85-39e1-45a4-b412-1d7d75460ade"))
+IDxcTaskScheduling : public IUnknown {
+  // Dispatches all parallel work through pExecutor instead of threads owned
+  // by DXC, or restores those threads if pExecutor is null. The executor is
+  // held until it is replaced. A thread waiting on parallel work runs the
+  // tasks that have not started yet itself, so the executor does not need a
+  // free thread for DXC to make progress.
+  virtual HRESULT STDMETHODCALLTYPE SetTaskExecutor(
+    _In_opt_ IDxcTaskExecutor *pExecutor) = 0;
+
+  // Limits each parallel operation to maxThreadCount threads, or to one per
+  // hardware thread if zero. With an executor this is the number of tasks
+  // an operation keeps scheduled at once.
+  virtual HRESULT STDMETHODCALLTYPE SetMaxThreadCount(
+    _In_ UINT32 maxThreadCount) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcTaskScheduling)
+};
+
+// Content-addressed store of the sources that debug info refers to rather
+// than embeds. Each source is named by the hex MD5 digest of its contents,
+// and LoadSource takes that name, so a store also serves the includes of a
+// recompile. Implementations must be safe to call from multiple threads.
+struct __declspec(uuid("f603fd31-1bc2-43ba-9173-721e25cf1400"))
+IDxcSourceStore : public IDxcIncludeHandler {
+  // Adds a source under the digest of its contents, unless it is already
+  // stored.
+  virtual HRESULT STDMETHODCALLTYPE AddSource(
+    _In_ IDxcBlob *pSource) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcSourceStore)
+};
+
+// Opt-in source deduplication; QueryInterface for it on IDxcCompiler3 or on
+// the DIA data source. With a store set, compiles with full debug info add
+// every included file to the store and refer to it by digest instead of
+// embedding it; the main file is still embedded. DIA loads referenced files
+// from the store the first time they are read. -Qsource_store <dir> does the
+// same for a single compile with a directory store.
+struct __declspec(uuid("bea5832d-94d9-4e1a-8306-512793a12165"))
+IDxcSourceStoreSupport : public IUnknown {
+  // Sets the store used from now on; nullptr embeds sources again.
+  virtual HRESULT STDMETHODCALLTYPE SetSourceStore(
+    _In_opt_ IDxcSourceStore *pStore) = 0;
+
+  // Creates a store which keeps one file per source in a directory. The
+  // directory is created when the first source is added.
+  virtual HRESULT STDMETHODCALLTYPE CreateDirectorySourceStore(
+    _In_z_ LPCWSTR pDirectory,
+    _COM_Outptr_ IDxcSourceStore **ppStore) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcSourceStoreSupport)
+};
+
+// Reuses LLVM contexts across compiles; QueryInterface for it on
+// IDxcCompiler3. Pooling is off until a pool size is set. A context is reset
+// between compiles, so the output is the same as with a new context, and it
+// is replaced after a number of compiles since types and constants it
+// uniqued are only freed with it.
+struct __declspec(uuid("f2c5e194-b1fa-44cf-a117-d768083e635f"))
+IDxcCompilerContextPool : public IUnknown {
+  // Sets how many idle contexts are kept; 0 frees them and turns pooling off.
+  virtual HRESULT STDMETHODCALLTYPE SetContextPoolSize(
+    _In_ UINT32 MaxIdleContexts) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilerContextPool)
+};
+
+// Incremental linking; QueryInterface for it on IDxcLinker. Link remembers
+// each entry it linked successfully along with a hash of every library
+// function that went into it. Linking the same entry again with the same
+// profile, libraries and arguments returns the remembered container, already
+// validated, unless one of those functions changed.
+struct __declspec(uuid("5b0f4a6e-3e2c-4c57-9d1a-7f83b2c6e914"))
+IDxcLinkerIncremental : public IUnknown {
+  // Replaces the registered library pLibName. Entries that used none of the
+  // functions that changed keep their remembered containers.
+  virtual HRESULT STDMETHODCALLTYPE UpdateLibrary(
+    _In_ LPCWSTR pLibName,                        // Name of a registered library
+    _In_ IDxcBlob *pLib                           // New library blob
+  ) = 0;
+
+  // Forgets every remembered container.
+  virtual HRESULT STDMETHODCALLTYPE ClearLinkCache() = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcLinkerIncremental)
+};
+
+// Links consecutive pipeline stages; QueryInterface for it on IDxcLinker.
+struct __declspec(uuid("5289ed02-d7a5-4f0d-919d-19d488339095"))
+IDxcPipelineLinker : public IUnknown {
+  // Takes the containers of a vertex or domain shader and of the pixel
+  // shader it feeds. Outputs the pixel shader never reads are removed from
+  // both signatures, with the code that only computed them, and the rows
+  // they leave empty are closed. Each result holds its stage's new,
+  // validated container; if the stages cannot be linked, both hold the
+  // errors.
+  virtual HRESULT STDMETHODCALLTYPE LinkStages(
+    _In_ IDxcBlob *pProducer,                     // Vertex or domain shader
+    _In_ IDxcBlob *pConsumer,                     // Pixel shader
+    _COM_Outptr_ IDxcOperationResult **ppProducerResult,
+    _COM_Outptr_ IDxcOperationResult **ppConsumerResult
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcPipelineLinker)
+};
+
 static const UINT32 DxcValidatorFlags_Default = 0;
 static const UINT32 DxcValidatorFlags_InPlaceEdit = 1;  // Validator is allowed to update shader blob in-place.
 static const UINT32 DxcValidatorFlags_RootSignatureOnly = 2;
@@ -520,6 +980,77 @@ IDxcValidator : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcValidator)
 };
 
+// A validation rule broken by a shader. Strings are owned by the
+// IDxcValidationResult that returned the error.
+struct DxcValidationError {
+  UINT32 Rule;              // hlsl::ValidationRule value of the broken rule
+  LPCSTR pFunctionName;     // Function of the offending instruction, or null
+  UINT32 InstructionIndex;  // Position of the instruction in the function, or UINT32_MAX
+  LPCSTR pFileName;         // Source file of the instruction, or null without debug info
+  UINT32 Line;              // Source line, or 0
+  UINT32 Column;            // Source column, or 0
+};
+
+struct __declspec(uuid("ebace2cb-7198-4c7f-ad31-702ff7134cfe"))
+IDxcValidationResult : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE GetStatus(_Out_ HRESULT *pStatus) = 0;
+  // Failures that are not tied to a rule, such as a container that cannot
+  // be loaded, fail the status without adding an error.
+  virtual UINT32 STDMETHODCALLTYPE GetErrorCount() = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetError(_In_ UINT32 Index,
+                                             _Out_ DxcValidationError *pError) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcValidationResult)
+};
+
+struct __declspec(uuid("4e77a98b-62a1-44be-8ca4-ee20f7b94686"))
+IDxcStructuredValidator : public IUnknown {
+  // Validate a shader, reporting broken rules rather than formatted
+  // messages. Validation stops once MaxErrors errors are found.
+  virtual HRESULT STDMETHODCALLTYPE ValidateStructured(
+    _In_ IDxcBlob *pShader,                       // Shader to validate.
+    _In_ UINT32 Flags,                            // Validation flags; RootSignatureOnly is not supported.
+    _In_ UINT32 MaxErrors,                        // Errors to find before stopping, or 0 for all.
+    _COM_Outptr_ IDxcValidationResult **ppResult  // Validation status and errors
+    ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcStructuredValidator)
+};
+
+// Validates a container along with the in-memory module it was assembled
+// from, so the validator does not parse the container's bitcode again;
+// QueryInterface for it on IDxcValidator. This is only for compilers built
+// from the same sources as the validator: the module is only accepted when
+// BuildKey matches the validator's own build, and E_NOTIMPL is returned
+// otherwise, in which case the caller should use Validate.
+struct __declspec(uuid("a7c2e5f1-3b84-4d69-8e0a-1f5d9b6c2e47"))
+IDxcModuleValidator : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE ValidateWithModule(
+    _In_ IDxcBlob *pShader,                       // Shader to validate.
+    _In_ UINT32 Flags,                            // Validation flags; ModuleOnly and RootSignatureOnly are not supported.
+    _In_ UINT64 BuildKey,                         // Build key of the caller that created pModule.
+    _In_ void *pModule,                           // The llvm::Module the DXIL part of pShader was written from.
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
+    ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcModuleValidator)
+};
+
+// Opt-in cache of validation verdicts; QueryInterface for it on IDxcValidator
+// or IDxcContainerBuilder. Containers that pass are recorded under a digest
+// of their parts, including the shader hash, along with the validator version
+// and flags, and later validations of the same bytes pass without running the
+// validator again. Failures are not cached. Stores come from IDxcCompileCache
+// or a custom IDxcCompileCacheStore, for instance one shared between machines.
+struct __declspec(uuid("c3f0e6a2-8d1b-4b57-a9e4-5d27f18c0b63"))
+IDxcValidationCache : public IUnknown {
+  // Sets the store used by subsequent validations; nullptr disables caching.
+  virtual HRESULT STDMETHODCALLTYPE SetStore(
+    _In_opt_ IDxcCompileCacheStore *pStore) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcValidationCache)
+};
+
 struct __declspec(uuid("334b1f50-2292-4b35-99a1-25588d8c17fe"))
 IDxcContainerBuilder : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pDxilContainerHeader) = 0;                // Loads DxilContainer to the builder
@@ -530,6 +1061,51 @@ IDxcContainerBuilder : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerBuilder)
 };
 
+// A container package opened with IDxcContainerPackageBuilder::LoadPackage.
+// Containers are expanded only when they are requested.
+struct __declspec(uuid("53f926dc-340f-42b7-88c9-e35ac50713ee"))
+IDxcContainerPackage : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE GetContainerCount(_Out_ UINT32 *pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetContainer(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) = 0; // The original bytes of the container
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerPackage)
+};
+
+// Builds packages of containers that store each distinct root signature once;
+// QueryInterface for it on IDxcContainerBuilder. Containers in a package refer
+// to their root signature by digest and expand back to their original bytes,
+// so signed containers stay valid.
+struct __declspec(uuid("e27d4453-5905-446f-bb8b-658500f3df29"))
+IDxcContainerPackageBuilder : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE AddContainerToPackage(_In_ IDxcBlob *pContainer) = 0;   // Adds a container to the package being built
+  virtual HRESULT STDMETHODCALLTYPE SerializePackage(_COM_Outptr_ IDxcBlob **ppResult) = 0; // Builds a package of the containers added so far
+  virtual HRESULT STDMETHODCALLTYPE LoadPackage(_In_ IDxcBlob *pPackage,
+                                                _COM_Outptr_ IDxcContainerPackage **ppResult) = 0; // Opens a package built by SerializePackage
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerPackageBuilder)
+};
+
+// Edits containers in the caller's memory rather than building new ones;
+// QueryInterface for it on IDxcContainerBuilder. Only the bytes after the
+// part that changes are moved.
+struct __declspec(uuid("c4d18e6a-7b2f-4a95-9e31-0d6f5a8b3c72"))
+IDxcContainerInPlaceBuilder : public IUnknown {
+  // Adds or replaces a part that AddPart accepts. The container must have its
+  // parts in offset table order without gaps, as the compiler writes them. A
+  // root signature is validated against the shader, and on failure the
+  // container is restored and the validation status is returned.
+  virtual HRESULT STDMETHODCALLTYPE SetPartInPlace(
+    _Inout_updates_bytes_(capacity) void *pContainer, // Container to update
+    _In_ UINT32 capacity,                         // Bytes available at pContainer
+    _In_ UINT32 fourCC,                           // Part to add or replace
+    _In_reads_bytes_opt_(dataSize) const void *pData, // New contents of the part
+    _In_ UINT32 dataSize,                         // Size of the new contents
+    _Out_ UINT32 *pContainerSize                  // New size of the container, or the size needed if capacity is too small
+    ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerInPlaceBuilder)
+};
+
 struct __declspec(uuid("091f7a26-1c1f-4948-904b-e6e3a8a771d5"))
 IDxcAssembler : public IUnknown {
   // Assemble dxil in ll or llvm bitcode to DXIL container.
@@ -553,6 +1129,28 @@ IDxcContainerReflection : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerReflection)
 };
 
+// Reflects many containers at once; QueryInterface for it on
+// IDxcContainerReflection. Containers are reflected in parallel. The types of
+// constant buffer variables and structured buffer elements that are identical
+// across them are created once and shared by the reflections of the call,
+// which keep them alive.
+struct __declspec(uuid("8021489e-7ca2-4fe5-ac50-5f32dc9b3742"))
+IDxcContainerReflectionBatch : public IUnknown {
+  // Reflects the DXIL part of each container, as GetPartReflection does.
+  // Returns the first failure, if any; reflections that succeeded are
+  // returned either way, and the others are null.
+  virtual HRESULT STDMETHODCALLTYPE GetReflections(
+    _In_ UINT32 containerCount,                   // Number of containers
+    _In_count_(containerCount) IDxcBlob **ppContainers, // Containers to reflect
+    _In_ UINT32 threadCount,                      // Number of worker threads, or 0 for one per hardware thread
+    _In_ REFIID iid,                              // Interface of each reflection
+    _Out_writes_(containerCount) void **ppReflections, // Reflection of each container
+    _Out_writes_opt_(containerCount) HRESULT *pResults // Result of each container (optional)
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerReflectionBatch)
+};
+
 struct __declspec(uuid("AE2CD79F-CC22-453F-9B6B-B124E7A5204C"))
 IDxcOptimizerPass : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE GetOptionName(_COM_Outptr_ LPWSTR *ppResult) = 0;
@@ -576,6 +1174,63 @@ IDxcOptimizer : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer)
 };
 
+// A module loaded once and kept in memory across optimizer runs, so that
+// running several pass lists over the same program does not parse and write
+// bitcode each time.
+struct __declspec(uuid("c2a6e0a9-5d4f-4b8e-9f61-3d7b2e8a41c5"))
+IDxcOptimizerSession : public IUnknown {
+  // Runs the passes over the session's module, taking the same options as
+  // IDxcOptimizer::RunOptimizer. The module keeps the changes. If a pass
+  // fails, the module may be left partly transformed.
+  virtual HRESULT STDMETHODCALLTYPE Run(
+    _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) = 0;
+
+  // Writes the module as it currently is to bitcode.
+  virtual HRESULT STDMETHODCALLTYPE GetModule(
+    _COM_Outptr_ IDxcBlob **ppOutputModule) = 0;
+
+  // Creates a session holding a copy of the module as it currently is, so
+  // that different pass lists can be run from the same starting point. The
+  // copies share an LLVM context and must not be used concurrently.
+  virtual HRESULT STDMETHODCALLTYPE Clone(
+    _COM_Outptr_ IDxcOptimizerSession **ppClone) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOptimizerSession)
+};
+
+// One pass list for IDxcOptimizerSession2::RunVariants; the options are as
+// for IDxcOptimizer::RunOptimizer.
+struct DxcOptimizerVariant {
+  LPCWSTR *pOptions;
+  UINT32 OptionCount;
+};
+
+struct __declspec(uuid("e4b8d1f3-6a27-4c95-8e0b-51f9a3c6d27e"))
+IDxcOptimizerSession2 : public IDxcOptimizerSession {
+  // Runs each variant's passes over its own copy of the session's module, in
+  // parallel, and writes each result to bitcode. The session's module is not
+  // changed. Entry i of ppOutputModules, and of ppOutputTexts if given, is
+  // set for every variant that succeeds; the result is S_OK if all of them
+  // did, else the failure of the first one that did not.
+  virtual HRESULT STDMETHODCALLTYPE RunVariants(
+    _In_count_(variantCount) const DxcOptimizerVariant *pVariants,
+    UINT32 variantCount,
+    _Out_writes_(variantCount) IDxcBlob **ppOutputModules,
+    _Out_writes_opt_(variantCount) IDxcBlobEncoding **ppOutputTexts) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOptimizerSession2)
+};
+
+struct __declspec(uuid("7f3c1b52-98e4-4d0a-b6a7-2e5d9c4f8b13"))
+IDxcOptimizer2 : public IDxcOptimizer {
+  // Loads pBlob, either a DXIL program, bitcode or IR text, into a new session.
+  virtual HRESULT STDMETHODCALLTYPE CreateSession(
+    _In_ IDxcBlob *pBlob, _COM_Outptr_ IDxcOptimizerSession **ppSession) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer2)
+};
+
 static const UINT32 DxcVersionInfoFlags_None = 0;
 static const UINT32 DxcVersionInfoFlags_Debug = 1; // Matches VS_FF_DEBUG
 static const UINT32 DxcVersionInfoFlags_Internal = 2; // Internal Validator (non-signing)
@@ -175,7 +175,12 @@ typedef enum DxcTranslationUnitFlags
   DxcTranslationUnitFlags_IncludeBriefCommentsInCodeCompletion = 0x80,
 
   // Used to indicate that compilation should occur on the caller's thread.
-  DxcTranslationUnitFlags_UseCallerThread = 0x800
+  DxcTranslationUnitFlags_UseCallerThread = 0x800,
+
+  // Used to indicate that function bodies outside the main file should be
+  // skipped while parsing, so that reparsing after an edit to the main file
+  // does not pay for included headers' bodies again.
+  DxcTranslationUnitFlags_SkipIncludedFunctionBodies = 0x1000
 } DxcTranslationUnitFlags;
 
 typedef enum DxcCursorFormatting
@@ -603,6 +608,7 @@ struct IDxcFile;
 struct IDxcInclusion;
 struct IDxcIntelliSense;
 struct IDxcIndex;
+struct IDxcParseCallback;
 struct IDxcSourceLocation;
 struct IDxcSourceRange;
 struct IDxcToken;
@@ -719,6 +725,36 @@ IDxcIndex : public IUnknown
       _Out_ IDxcTranslationUnit** pTranslationUnit) = 0;
 };
 
+struct __declspec(uuid("2bf3f524-7f09-49de-a032-974d2cc51117"))
+IDxcParseCallback : public IUnknown
+{
+  /// <summary>Called on the index's worker thread when a parse queued with ParseTranslationUnitAsync completes.</summary>
+  /// <remarks>pTranslationUnit is null if status is a failure code. The index must not be released or waited on from within this call.</remarks>
+  virtual HRESULT STDMETHODCALLTYPE OnParseComplete(HRESULT status, _In_opt_ IDxcTranslationUnit* pTranslationUnit) = 0;
+};
+
+struct __declspec(uuid("4503624c-12df-4801-8b21-344f36a86655"))
+IDxcIndex2 : public IDxcIndex
+{
+  /// <summary>Queues a parse on the index's worker thread and returns immediately.</summary>
+  /// <remarks>
+  /// Parses run one at a time in the order they were queued. Each one produces a new
+  /// translation unit that is not modified afterwards, so queries against an earlier result
+  /// may run while a later parse of the same file is in flight. The arguments and unsaved
+  /// files are captured before this returns.
+  /// </remarks>
+  virtual HRESULT STDMETHODCALLTYPE ParseTranslationUnitAsync(
+      _In_z_ const char *source_filename,
+      _In_count_(num_command_line_args) const char * const *command_line_args,
+      int num_command_line_args,
+      _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      DxcTranslationUnitFlags options,
+      _In_ IDxcParseCallback* pCallback) = 0;
+  /// <summary>Blocks until every queued parse has completed and its callback has returned.</summary>
+  virtual HRESULT STDMETHODCALLTYPE WaitForPendingParses() = 0;
+};
+
 struct __declspec(uuid("8e7ddf1c-d7d3-4d69-b286-85fccba1e0cf"))
 IDxcSourceLocation : public IUnknown
 {
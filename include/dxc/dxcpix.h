@@ -152,6 +152,38 @@ IDxcPixDxilDebugInfo : public IUnknown
       _Out_ DWORD* StackDepth) = 0;
 };
 
+// Reads traces written by the PIX debug instrumentation; QueryInterface for
+// it on IDxcPixDxilDebugInfo.
+struct __declspec(uuid("3f1c6a0e-8b5d-4e27-9a43-c6d2f81b0e95"))
+IDxcPixDxilTraceDecoder : public IUnknown
+{
+  // Expands the records written with the instrumentation's "compact" option
+  // into ordinary step records, and copies all other records. If Capacity is
+  // too small, returns E_NOT_SUFFICIENT_BUFFER with the number of dwords
+  // needed in *pExpandedCount.
+  virtual STDMETHODIMP ExpandCompactTrace(
+      _In_reads_(DwordCount) const UINT32 *pRecords,
+      _In_ DWORD DwordCount,
+      _Out_writes_to_(Capacity, *pExpandedCount) UINT32 *pExpanded,
+      _In_ DWORD Capacity,
+      _Out_ DWORD *pExpandedCount) = 0;
+};
+
+// Maps the counters written by the hlsl-dxil-pix-block-counters pass back to
+// source; QueryInterface for it on IDxcPixDxilDebugInfo.
+struct __declspec(uuid("8e2d4b71-3c9a-4f05-b6e8-1a7d5c93f240"))
+IDxcPixDxilBlockProfile : public IUnknown
+{
+  // Returns the source location of the block starting at InstructionOffset,
+  // as reported for a counter by the pass. This is the location of the
+  // block's first instruction that has one; if none does, returns S_FALSE
+  // with an empty file name and line 0.
+  virtual STDMETHODIMP GetBlockSourceLocation(
+      _In_ DWORD InstructionOffset,
+      _Outptr_result_z_ BSTR *pFileName,
+      _Out_ DWORD *pLine) = 0;
+};
+
 struct __declspec(uuid("61b16c95-8799-4ed8-bdb0-3b6c08a141b4"))
 IDxcPixCompilationInfo : public IUnknown
 {
@@ -80,4 +80,17 @@ IDxcRewriter2 : public IDxcRewriter {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcRewriter2)
 };
 
+struct __declspec(uuid("6a3c4c2e-8a1d-4e0f-b7a2-5d9e3f1c8b40"))
+IDxcRewriter3 : public IDxcRewriter2 {
+  // Parses pSource once and removes the unused globals for each entry point,
+  // writing one result per entry point to ppResults.
+  virtual HRESULT STDMETHODCALLTYPE RemoveUnusedGlobalsForEntryPoints(_In_ IDxcBlobEncoding *pSource,
+                                                                      _In_count_(entryPointCount) LPCWSTR *pEntryPoints,
+                                                                      _In_ UINT32 entryPointCount,
+                                                                      _In_count_(defineCount) DxcDefine *pDefines,
+                                                                      _In_ UINT32 defineCount,
+                                                                      _Out_writes_(entryPointCount) IDxcOperationResult **ppResults) = 0;
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcRewriter3)
+};
+
 #endif
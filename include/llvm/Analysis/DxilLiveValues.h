@@ -0,0 +1,62 @@
+//===------ DxilLiveValues.h - Estimate of live scalars ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_DXILLIVEVALUES_H
+#define LLVM_ANALYSIS_DXILLIVEVALUES_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <vector>
+
+namespace llvm {
+
+class BasicBlock;
+class Function;
+class Loop;
+class Type;
+class Value;
+
+/// Estimates register pressure from the liveness of SSA values. A value is
+/// live from its definition to its last use, and takes a register for each
+/// 32-bit scalar of its type. Handles, pointers and aggregates take none:
+/// the scalars extracted from them are counted instead.
+class DxilLiveValues {
+public:
+  /// Computes liveness for F. The results are stale once F changes.
+  void compute(Function &F);
+
+  /// Most scalars live at once anywhere in the function.
+  unsigned getPeakLiveScalars() const { return Peak; }
+  /// Most scalars live at once in BB, or 0 if BB is unreachable.
+  unsigned getPeakLiveScalars(const BasicBlock *BB) const;
+  /// Most scalars live at once in any block of L.
+  unsigned getPeakLiveScalars(const Loop *L) const;
+  /// Scalars live through every iteration of L: values defined outside the
+  /// loop that are live into its header.
+  unsigned getLiveThroughScalars(const Loop *L) const;
+
+  /// Returns true if V is live on entry to BB. Values used by a phi of BB
+  /// are live out of the incoming block, not into BB.
+  bool isLiveIn(const Value *V, const BasicBlock *BB) const;
+
+  /// Registers a value of type Ty takes.
+  static unsigned getScalarCount(Type *Ty);
+
+private:
+  typedef SmallPtrSet<const Value *, 32> ValueSet;
+  DenseMap<const BasicBlock *, unsigned> BlockIndex;
+  std::vector<ValueSet> LiveIn;
+  std::vector<unsigned> BlockPeak;
+  unsigned Peak = 0;
+};
+
+} // end namespace llvm
+
+#endif
@@ -12,6 +12,9 @@
 
 #include "llvm/Pass.h"
 #include "llvm/IR/ValueMap.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <vector>
 
 namespace llvm {
 
@@ -23,26 +26,35 @@ struct DxilValueCache : public ImmutablePass {
   static char ID;
 
   // Special Weak Value to Weak Value map.
+  //
+  // Keys are tracked only by the map's own callback handle, which drops the
+  // entry when the key is deleted or replaced. Results are interned in a side
+  // table and entries hold an index into it, so each distinct result has one
+  // handle however many keys map to it. There are few distinct results (true,
+  // false, the sentinel and the constants values fold to), so an entry costs
+  // one handle instead of three.
   struct WeakValueMap {
-    struct ValueVH : public CallbackVH {
-      ValueVH(Value *V) : CallbackVH(V) {}
-      void allUsesReplacedWith(Value *) override { setValPtr(nullptr); }
-    };
-    struct ValueEntry {
-      WeakVH Value;
-      ValueVH Self;
-      ValueEntry() : Value(nullptr), Self(nullptr) {}
-      inline void Set(llvm::Value *Key, llvm::Value *V) { Self = Key; Value = V; }
-      inline bool IsStale() const { return Self == nullptr; }
+    struct MapConfig : public ValueMapConfig<const Value *> {
+      enum { FollowRAUW = false };
+      struct ExtraData { WeakValueMap *Owner; };
+      static void onRAUW(const ExtraData &Data, const Value *Old, const Value *) {
+        Data.Owner->Map.erase(Old);
+      }
     };
-    ValueMap<const Value *, ValueEntry> Map;
+    WeakValueMap();
+    ValueMap<const Value *, unsigned, MapConfig> Map;
+    // Index 0 is the null result, which entries cleared by ResetUnknowns use.
+    std::vector<WeakVH> Results;
+    DenseMap<const Value *, unsigned> ResultIndex;
     Value *Get(Value *V);
     void Set(Value *Key, Value *V);
     bool Seen(Value *v);
+    bool Erase(Value *V);
     void SetSentinel(Value *V);
     void ResetUnknowns();
     void dump() const;
   private:
+    unsigned InternResult(Value *V);
     Value *GetSentinel(LLVMContext &Ctx);
     std::unique_ptr<Value> Sentinel;
   };
@@ -74,6 +86,12 @@ public:
   Value *GetValue(Value *V, DominatorTree *DT=nullptr);
   Constant *GetConstValue(Value *V, DominatorTree *DT = nullptr);
   void ResetUnknowns() { ValueMap.ResetUnknowns(); }
+  // Drops what is cached for V and for everything computed from it. Value
+  // handles already cover deleted and replaced values; passes call this when
+  // they change V in place, such as the incoming values of a PHI or the
+  // successors of a branch, so later passes recompute just that region
+  // instead of reading a stale result.
+  void Invalidate(Value *V);
   bool IsAlwaysReachable(BasicBlock *BB, DominatorTree *DT=nullptr);
   bool IsUnreachable(BasicBlock *BB, DominatorTree *DT=nullptr);
 };
@@ -59,7 +59,17 @@ public:
   };
   static ScopeTrack scope_track(BitstreamCursor *BC);
   static void track(BitstreamUseTracker *BT, uint64_t begin, uint64_t end);
-  void insert(uint64_t begin, uint64_t end);
+  // Every Read lands here, so the common case of a single range being
+  // extended is kept inline.
+  void insert(uint64_t begin, uint64_t end) {
+    if (Ranges.size() == 1 && Ranges[0].first <= begin) {
+      if (Ranges[0].second < end)
+        Ranges[0].second = end;
+      return;
+    }
+    insertSlow(begin, end);
+  }
+  void insertSlow(uint64_t begin, uint64_t end);
   bool isDense(uint64_t endBitoffset) const;
 };
 // HLSL Change Ends
@@ -557,6 +567,21 @@ public:
   bool ReadBlockInfoBlock(unsigned *pCount = nullptr);
 };
 
+// HLSL Change Starts
+inline BitstreamUseTracker::ScopeTrack::~ScopeTrack() {
+  if (BitstreamUseTracker *BT = BC->getBitStreamReader()->Tracker)
+    BT->insert(begin, BC->GetCurrentBitNo());
+}
+
+inline BitstreamUseTracker::ScopeTrack
+BitstreamUseTracker::scope_track(BitstreamCursor *BC) {
+  ScopeTrack Result;
+  Result.BC = BC;
+  Result.begin = BC->GetCurrentBitNo();
+  return Result;
+}
+// HLSL Change Ends
+
 } // End llvm namespace
 
 #endif
@@ -245,6 +245,23 @@ public:
     BlockScope.pop_back();
   }
 
+  // HLSL Change Starts
+  /// EmitEncodedSubblock - Emit a block whose body was encoded by another
+  /// writer.  Body holds everything that writer produced after the block
+  /// size word, up to and including the END_BLOCK and its padding.  Blocks
+  /// start on a word boundary, so the bytes can be copied as they are.
+  void EmitEncodedSubblock(unsigned BlockID, unsigned CodeLen,
+                           StringRef Body) {
+    EmitCode(bitc::ENTER_SUBBLOCK);
+    EmitVBR(BlockID, bitc::BlockIDWidth);
+    EmitVBR(CodeLen, bitc::CodeLenWidth);
+    FlushToWord();
+    assert((Body.size() & 3) == 0 && "Not 32-bit aligned");
+    WriteWord(Body.size() / 4);
+    Out.append(Body.begin(), Body.end());
+  }
+  // HLSL Change Ends
+
   //===--------------------------------------------------------------------===//
   // Record Emission
   //===--------------------------------------------------------------------===//
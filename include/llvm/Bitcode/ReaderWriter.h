@@ -18,6 +18,7 @@
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/ErrorOr.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include <functional> // HLSL Change
 #include <memory>
 #include <string>
 
@@ -69,6 +70,22 @@ namespace llvm {
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
                           bool ShouldPreserveUseListOrder = false);
 
+  // HLSL Change Starts
+  /// Runs Task(0) ... Task(NumTasks - 1), possibly concurrently, and returns
+  /// once all of them have finished.
+  typedef std::function<void(unsigned NumTasks,
+                             const std::function<void(unsigned)> &Task)>
+      BitcodeTaskRunner;
+
+  /// Like WriteBitcodeToFile, but splits the function bodies into up to
+  /// \c NumChunks runs that are encoded as separate tasks of \c RunTasks.
+  /// The tasks only read \c M. The output is identical to the serial
+  /// writer's.
+  void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
+                          bool ShouldPreserveUseListOrder, unsigned NumChunks,
+                          const BitcodeTaskRunner &RunTasks);
+  // HLSL Change Ends
+
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
   ///
@@ -83,7 +83,8 @@ private:
   enum {
     /// Whether this function is materializable.
     IsMaterializableBit = 1 << 0,
-    HasMetadataHashEntryBit = 1 << 1
+    HasMetadataHashEntryBit = 1 << 1,
+    IsDxilOpBit = 1 << 2 // HLSL Change
   };
   void setGlobalObjectBit(unsigned Mask, bool Value) {
     setGlobalObjectSubClassData((~Mask & getGlobalObjectSubClassData()) |
@@ -166,6 +167,14 @@ public:
   /// from Value::setName() whenever the name of this function changes.
   void recalculateIntrinsicID();
 
+  // HLSL Change Begin - classify DXIL operations without comparing names.
+  /// Returns true if this function is a DXIL operation, named "dx.op.*".
+  /// Like the intrinsic ID, this is kept up to date as the name changes.
+  bool isDxilOp() const {
+    return getGlobalObjectSubClassData() & IsDxilOpBit;
+  }
+  // HLSL Change End
+
   /// getCallingConv()/setCallingConv(CC) - These method get and set the
   /// calling convention of this function.  The enum values for the known
   /// calling conventions are defined in CallingConv.h.
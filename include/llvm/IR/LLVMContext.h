@@ -44,6 +44,15 @@ public:
   LLVMContext();
   ~LLVMContext();
 
+  // HLSL Change - Begin
+  /// Prepares a context whose modules have all been destroyed for another,
+  /// unrelated use. Names of struct types, the custom metadata kinds and the
+  /// handlers are dropped, so names and kind IDs come out as they would in a
+  /// new context; uniqued types, constants and metadata strings are kept.
+  /// Returns false, changing nothing, if a module still lives in the context.
+  bool resetForReuse();
+  // HLSL Change - End
+
   // Pinned metadata names, which always have the same value.  This is a
   // compile-time performance optimization, not a correctness optimization.
   enum {
@@ -95,6 +95,22 @@ private:
   Module *M;
 };
 
+// HLSL Change Begin - per-thread pass run notifications.
+/// PassRunObserver - Receives a callback around every pass that a legacy pass
+/// manager runs on the current thread. F is null for module-level passes.
+class PassRunObserver {
+public:
+  virtual ~PassRunObserver();
+  virtual void beforePass(Pass *P, Module &M, Function *F) = 0;
+  virtual void afterPass(Pass *P, Module &M, Function *F) = 0;
+};
+
+/// Installs O as the observer for the current thread and returns the
+/// previously installed one. Pass null to remove the observer.
+PassRunObserver *setThreadPassRunObserver(PassRunObserver *O);
+PassRunObserver *getThreadPassRunObserver();
+// HLSL Change End
+
 } // End legacy namespace
 
 // Create wrappers for C Binding types (see CBindingWrapping.h).
@@ -705,7 +705,8 @@ public:
   bool HasDxilModule() const { return TheDxilModule != nullptr; }
   void SetDxilModule(hlsl::DxilModule *pValue) { TheDxilModule = pValue; }
   hlsl::DxilModule &GetDxilModule() const { return *TheDxilModule; }
-  hlsl::DxilModule &GetOrCreateDxilModule(bool skipInit = false);
+  hlsl::DxilModule &GetOrCreateDxilModule(bool skipInit = false,
+                                          bool lazyTypeSystem = false);
   ResetModuleCallback pfnResetDxilModule = nullptr;
   void ResetDxilModule() { if (pfnResetDxilModule) (*pfnResetDxilModule)(this); }
   // HLSL Change end
@@ -343,6 +343,18 @@ public:
   ///
   virtual bool runOnFunction(Function &F) = 0;
 
+  // HLSL Change Begin
+  /// isIdempotent - Return true if running this pass again on a function that
+  /// no pass has changed since its last run cannot change it. Within one
+  /// function pass manager, a later instance of the same pass is skipped on a
+  /// function when no pass run since the earlier instance reported a change;
+  /// any change, including one by an unrelated pass, makes it run again.
+  /// Only passes whose result depends on nothing but the function itself may
+  /// return true. In this tree that is InstSimplifier and CFGSimplifyPass
+  /// with the default bonus threshold and no predicate.
+  virtual bool isIdempotent() const { return false; }
+  // HLSL Change End
+
   void assignPassManager(PMStack &PMS, PassManagerType T) override;
 
   ///  Return what kind of Pass Manager can manage this pass.
@@ -130,6 +130,15 @@ public:
   hlsl::HLSLExtensionsCodegenHelper *HLSLExtensionsCodeGen = nullptr; // HLSL Change
   bool HLSLResMayAlias = false; // HLSL Change
   unsigned ScanLimit = 0; // HLSL Change
+  unsigned HLSLAuto16BitPrecision = 0; // HLSL Change
+  bool HLSLPadGroupShared = false; // HLSL Change
+  bool HLSLMinimizeMeshOutputs = false; // HLSL Change
+  bool HLSLReportLoopHandles = false; // HLSL Change
+  bool HLSLFastTrig = false; // HLSL Change
+  bool HLSLWaveAggregateAtomics = false; // HLSL Change
+  bool HLSLHoistUniform = false; // HLSL Change
+  unsigned HLSLFPContract = 0; // HLSL Change - 0 off, 1 within blocks, 2 across blocks
+  unsigned HLSLMaxLiveScalars = 0; // HLSL Change - 0 for no limit
 
 private:
   /// ExtensionList - This is list of all of the extensions that are registered.
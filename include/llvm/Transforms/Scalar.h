@@ -265,8 +265,11 @@ Pass *createLoopInstSimplifyPass();
 //
 // LoopUnroll - This pass is a simple loop unrolling pass.
 //
+// HLSL Change - MaxLiveScalars limits unrolling without a pragma to an
+// estimate of the scalars left live; 0 for no limit.
 Pass *createLoopUnrollPass(int Threshold = -1, int Count = -1,
-                           int AllowPartial = -1, int Runtime = -1);
+                           int AllowPartial = -1, int Runtime = -1,
+                           unsigned MaxLiveScalars = 0);
 // Create an unrolling pass for full unrolling only.
 Pass *createSimpleLoopUnrollPass();
 
@@ -0,0 +1,167 @@
+//===------ DxilLiveValues.cpp - Estimate of live scalars -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Computes which values are live at each block with the usual backward
+// dataflow over SSA values, then walks each block to find the most scalars
+// live at once. Unlike the LiveValues of the raytracing fallback layer, which
+// answers liveness at chosen instructions, this only keeps counts, so it is
+// cheap enough to run before deciding a transformation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/DxilLiveValues.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+unsigned DxilLiveValues::getScalarCount(Type *Ty) {
+  if (Ty->isVectorTy())
+    return Ty->getVectorNumElements() *
+           getScalarCount(Ty->getVectorElementType());
+  if (Ty->isIntegerTy())
+    return Ty->getIntegerBitWidth() > 32 ? 2 : 1;
+  if (Ty->isHalfTy() || Ty->isFloatTy())
+    return 1;
+  if (Ty->isDoubleTy())
+    return 2;
+  return 0;
+}
+
+static bool IsRegisterValue(const Value *V) {
+  return (isa<Instruction>(V) || isa<Argument>(V)) &&
+         DxilLiveValues::getScalarCount(V->getType()) != 0;
+}
+
+void DxilLiveValues::compute(Function &F) {
+  BlockIndex.clear();
+  LiveIn.clear();
+  BlockPeak.clear();
+  Peak = 0;
+
+  std::vector<BasicBlock *> PostOrder;
+  for (BasicBlock *BB : post_order(&F.getEntryBlock())) {
+    BlockIndex[BB] = PostOrder.size();
+    PostOrder.push_back(BB);
+  }
+  unsigned NumBlocks = PostOrder.size();
+
+  // Uses before definitions in each block, and values defined there. Values
+  // incoming to phis are live out of their incoming block.
+  std::vector<ValueSet> UpwardUses(NumBlocks);
+  std::vector<ValueSet> Defs(NumBlocks);
+  std::vector<ValueSet> PhiUses(NumBlocks);
+  for (unsigned Idx = 0; Idx < NumBlocks; ++Idx) {
+    for (Instruction &I : *PostOrder[Idx]) {
+      if (PHINode *Phi = dyn_cast<PHINode>(&I)) {
+        for (unsigned i = 0; i < Phi->getNumIncomingValues(); ++i) {
+          Value *V = Phi->getIncomingValue(i);
+          auto It = BlockIndex.find(Phi->getIncomingBlock(i));
+          if (IsRegisterValue(V) && It != BlockIndex.end())
+            PhiUses[It->second].insert(V);
+        }
+      } else {
+        for (Value *Op : I.operands()) {
+          if (IsRegisterValue(Op) && !Defs[Idx].count(Op))
+            UpwardUses[Idx].insert(Op);
+        }
+      }
+      Defs[Idx].insert(&I);
+    }
+  }
+
+  // Post order visits successors first, so this converges in a few rounds
+  // beyond the loop nesting depth.
+  LiveIn.resize(NumBlocks);
+  std::vector<ValueSet> LiveOut(NumBlocks);
+  bool bChanged = true;
+  while (bChanged) {
+    bChanged = false;
+    for (unsigned Idx = 0; Idx < NumBlocks; ++Idx) {
+      ValueSet &Out = LiveOut[Idx];
+      for (const Value *V : PhiUses[Idx])
+        bChanged |= Out.insert(V).second;
+      for (BasicBlock *Succ : successors(PostOrder[Idx])) {
+        for (const Value *V : LiveIn[BlockIndex[Succ]])
+          bChanged |= Out.insert(V).second;
+      }
+      ValueSet &In = LiveIn[Idx];
+      for (const Value *V : UpwardUses[Idx])
+        bChanged |= In.insert(V).second;
+      for (const Value *V : Out) {
+        if (!Defs[Idx].count(V))
+          bChanged |= In.insert(V).second;
+      }
+    }
+  }
+
+  BlockPeak.resize(NumBlocks);
+  for (unsigned Idx = 0; Idx < NumBlocks; ++Idx) {
+    ValueSet Live = LiveOut[Idx];
+    unsigned Scalars = 0;
+    for (const Value *V : Live)
+      Scalars += getScalarCount(V->getType());
+    unsigned BBPeak = Scalars;
+    BasicBlock *BB = PostOrder[Idx];
+    for (auto It = BB->rbegin(), End = BB->rend(); It != End; ++It) {
+      Instruction &I = *It;
+      // A value defined and never used still takes a register as it is
+      // written.
+      if (IsRegisterValue(&I) && Live.insert(&I).second)
+        Scalars += getScalarCount(I.getType());
+      BBPeak = std::max(BBPeak, Scalars);
+      if (Live.erase(&I))
+        Scalars -= getScalarCount(I.getType());
+      if (isa<PHINode>(I))
+        continue;
+      for (Value *Op : I.operands()) {
+        if (IsRegisterValue(Op) && Live.insert(Op).second)
+          Scalars += getScalarCount(Op->getType());
+      }
+      BBPeak = std::max(BBPeak, Scalars);
+    }
+    BlockPeak[Idx] = BBPeak;
+    Peak = std::max(Peak, BBPeak);
+  }
+}
+
+unsigned DxilLiveValues::getPeakLiveScalars(const BasicBlock *BB) const {
+  auto It = BlockIndex.find(BB);
+  return It == BlockIndex.end() ? 0 : BlockPeak[It->second];
+}
+
+unsigned DxilLiveValues::getPeakLiveScalars(const Loop *L) const {
+  unsigned LoopPeak = 0;
+  for (const BasicBlock *BB : L->getBlocks())
+    LoopPeak = std::max(LoopPeak, getPeakLiveScalars(BB));
+  return LoopPeak;
+}
+
+unsigned DxilLiveValues::getLiveThroughScalars(const Loop *L) const {
+  auto It = BlockIndex.find(L->getHeader());
+  if (It == BlockIndex.end())
+    return 0;
+  unsigned Scalars = 0;
+  for (const Value *V : LiveIn[It->second]) {
+    const Instruction *I = dyn_cast<Instruction>(V);
+    if (!I || !L->contains(I->getParent()))
+      Scalars += getScalarCount(V->getType());
+  }
+  return Scalars;
+}
+
+bool DxilLiveValues::isLiveIn(const Value *V, const BasicBlock *BB) const {
+  auto It = BlockIndex.find(BB);
+  return It != BlockIndex.end() && LiveIn[It->second].count(V);
+}
@@ -24,6 +24,7 @@
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 #include "llvm/Analysis/DxilValueCache.h"
 
@@ -278,15 +279,32 @@ Value *DxilValueCache::SimplifyAndCacheResult(Instruction *I, DominatorTree *DT)
 
 STATISTIC(StaleValuesEncountered, "Stale Values Encountered");
 
+DxilValueCache::WeakValueMap::WeakValueMap()
+    : Map(MapConfig::ExtraData{this}), Results(1) {}
+
+unsigned DxilValueCache::WeakValueMap::InternResult(Value *V) {
+  if (!V)
+    return 0;
+  // An index whose handle no longer points at V belongs to a result that was
+  // deleted or replaced, and other entries may still refer to it, so V gets
+  // a fresh index instead.
+  unsigned &Index = ResultIndex[V];
+  if (!Index || Results[Index] != V) {
+    Index = Results.size();
+    Results.emplace_back(V);
+  }
+  return Index;
+}
+
 bool DxilValueCache::WeakValueMap::Seen(Value *V) {
   auto FindIt = Map.find(V);
   if (FindIt == Map.end())
     return false;
+  return Results[FindIt->second];
+}
 
-  auto &Entry = FindIt->second;
-  if (Entry.IsStale())
-    return false;
-  return Entry.Value;
+bool DxilValueCache::WeakValueMap::Erase(Value *V) {
+  return Map.erase(V);
 }
 
 Value *DxilValueCache::WeakValueMap::Get(Value *V) {
@@ -294,11 +312,7 @@ Value *DxilValueCache::WeakValueMap::Get(Value *V) {
   if (FindIt == Map.end())
     return nullptr;
 
-  auto &Entry = FindIt->second;
-  if (Entry.IsStale())
-    return nullptr;
-
-  Value *Result = Entry.Value;
+  Value *Result = Results[FindIt->second];
   if (Result == GetSentinel(V->getContext()))
     return nullptr;
 
@@ -306,7 +320,7 @@ Value *DxilValueCache::WeakValueMap::Get(Value *V) {
 }
 
 void DxilValueCache::WeakValueMap::SetSentinel(Value *Key) {
-  Map[Key].Set(Key, GetSentinel(Key->getContext()));
+  Map[Key] = InternResult(GetSentinel(Key->getContext()));
 }
 
 Value *DxilValueCache::WeakValueMap::GetSentinel(LLVMContext &Ctx) {
@@ -320,8 +334,8 @@ void DxilValueCache::WeakValueMap::ResetUnknowns() {
   if (!Sentinel)
     return;
   for (auto it = Map.begin(); it != Map.end(); it++) {
-    if (it->second.Value == Sentinel.get())
-      it->second.Value = nullptr;
+    if (Results[it->second] == Sentinel.get())
+      it->second = 0;
   }
 }
 
@@ -329,9 +343,9 @@ LLVM_DUMP_METHOD
 void DxilValueCache::WeakValueMap::dump() const {
   for (auto It = Map.begin(), E = Map.end(); It != E; It++) {
     const Value *Key = It->first;
-    if (It->second.IsStale())
+    const Value *V = Results[It->second];
+    if (!V)
       continue;
-    const Value *V = It->second.Value;
     bool IsSentinel = Sentinel && V == Sentinel.get();
     if (const BasicBlock *BB = dyn_cast<BasicBlock>(Key)) {
       dbgs() << "[BB]" << BB->getName() << " -> ";
@@ -356,7 +370,7 @@ void DxilValueCache::WeakValueMap::dump() const {
 }
 
 void DxilValueCache::WeakValueMap::Set(Value *Key, Value *V) {
-  Map[Key].Set(Key, V);
+  Map[Key] = InternResult(V);
 }
 
 // If there's a cached value, return it. Otherwise, return
@@ -397,6 +411,42 @@ bool DxilValueCache::IsUnreachable(BasicBlock *BB, DominatorTree *DT) {
   return IsUnreachable_(BB);
 }
 
+void DxilValueCache::Invalidate(Value *V) {
+  SmallVector<Value *, 16> WorkList;
+  SmallPtrSet<Value *, 16> Visited;
+  WorkList.push_back(V);
+  while (WorkList.size()) {
+    Value *Cur = WorkList.pop_back_val();
+    if (!Visited.insert(Cur).second)
+      continue;
+    // Processing a value caches all of its operands first, so nothing was
+    // computed from a value without an entry. V itself may have lost its
+    // entry through a value handle while its users kept theirs.
+    if (!ValueMap.Erase(Cur) && Cur != V)
+      continue;
+
+    for (User *U : Cur->users()) {
+      if (Instruction *I = dyn_cast<Instruction>(U))
+        WorkList.push_back(I);
+    }
+    // Reachability flows from a block through its terminator to its
+    // successors, and from there into their PHIs.
+    if (BasicBlock *BB = dyn_cast<BasicBlock>(Cur)) {
+      if (TerminatorInst *TI = BB->getTerminator())
+        WorkList.push_back(TI);
+      for (Instruction &I : *BB) {
+        if (!isa<PHINode>(I))
+          break;
+        WorkList.push_back(&I);
+      }
+    }
+    else if (TerminatorInst *TI = dyn_cast<TerminatorInst>(Cur)) {
+      for (unsigned i = 0; i < TI->getNumSuccessors(); i++)
+        WorkList.push_back(TI->getSuccessor(i));
+    }
+  }
+}
+
 LLVM_DUMP_METHOD
 void DxilValueCache::dump() const {
   ValueMap.dump();
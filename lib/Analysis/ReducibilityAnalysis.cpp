@@ -37,9 +37,18 @@ using std::unordered_set;
 //===----------------------------------------------------------------------===//
 //                    Reducibility Analysis Pass
 //
-// The pass implements T1-T2 graph reducibility test.
-// The algorithm can be found in "Engineering a Compiler" text by 
-// Keith Cooper and Linda Torczon.
+// The pass tests reducibility with one depth-first search, as described by
+// Tarjan in "Testing flow graph reducibility". Each block is numbered in
+// preorder along with the last number of its subtree, so that an interval
+// test tells whether one block is a DFS ancestor of another. Loops are
+// collapsed innermost first with union-find, and the graph is irreducible
+// iff a loop is entered from outside the subtree of its header. This is
+// near linear, where the T1-T2 test takes many rounds on the large switches
+// of converted shaders.
+//
+// Functions with unreachable blocks still use the T1-T2 graph reducibility
+// test, which can be found in "Engineering a Compiler" text by Keith Cooper
+// and Linda Torczon, so that their unreachable parts are judged as before.
 //
 //===----------------------------------------------------------------------===//
 namespace ReducibilityAnalysisNS {
@@ -94,11 +103,103 @@ static bool IsEntryNode(size_t NodeIdx) {
   return NodeIdx == 0;
 }
 
-bool ReducibilityAnalysis::runOnFunction(Function &F) {
-  m_bReducible = true;
-  if (F.empty()) return false;
-  IFTBOOL(F.size() < UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+// Returns false if F has unreachable blocks, which the DFS can't judge.
+static bool IsReducibleDFS(Function &F, bool &bReducible) {
+  const unsigned NumBlocks = F.size();
+  unordered_map<BasicBlock*, unsigned> Number;
+  vector<BasicBlock*> Blocks;     // By preorder number.
+  vector<unsigned> Last;          // Last preorder number in each subtree.
+  Number.reserve(NumBlocks);
+  Blocks.reserve(NumBlocks);
+  Last.resize(NumBlocks);
+
+  // Iterative DFS; each stack entry is a block and its next successor.
+  vector<std::pair<BasicBlock*, succ_iterator>> Stack;
+  BasicBlock *pEntry = &F.getEntryBlock();
+  Number[pEntry] = 0;
+  Blocks.push_back(pEntry);
+  Stack.emplace_back(pEntry, succ_begin(pEntry));
+  while (!Stack.empty()) {
+    BasicBlock *pBB = Stack.back().first;
+    succ_iterator &itSucc = Stack.back().second;
+    if (itSucc == succ_end(pBB)) {
+      Last[Number[pBB]] = Blocks.size() - 1;
+      Stack.pop_back();
+      continue;
+    }
+    BasicBlock *pSuccBB = *itSucc++;
+    if (Number.insert(std::make_pair(pSuccBB, (unsigned)Blocks.size())).second) {
+      Blocks.push_back(pSuccBB);
+      Stack.emplace_back(pSuccBB, succ_begin(pSuccBB));
+    }
+  }
+  if (Blocks.size() != NumBlocks)
+    return false;
+
+  auto IsAncestor = [&Last](unsigned A, unsigned D) {
+    return A <= D && D <= Last[A];
+  };
+
+  // Union-find of the loops collapsed so far, to their headers.
+  vector<unsigned> Header(NumBlocks);
+  for (unsigned i = 0; i < NumBlocks; i++)
+    Header[i] = i;
+  auto Find = [&Header](unsigned N) {
+    unsigned Root = N;
+    while (Header[Root] != Root)
+      Root = Header[Root];
+    while (Header[N] != Root) {
+      unsigned Next = Header[N];
+      Header[N] = Root;
+      N = Next;
+    }
+    return Root;
+  };
+
+  // Headers are visited in reverse preorder, so that inner loops are
+  // collapsed before the loops around them.
+  vector<unsigned> Body;
+  vector<unsigned> InBody(NumBlocks, UINT32_MAX);
+  for (unsigned W = NumBlocks; W-- > 0;) {
+    Body.clear();
+    for (BasicBlock *pPredBB : predecessors(Blocks[W])) {
+      unsigned V = Number[pPredBB];
+      if (V == W || !IsAncestor(W, V))
+        continue;
+      V = Find(V);
+      if (InBody[V] != W) {
+        InBody[V] = W;
+        Body.push_back(V);
+      }
+    }
+    for (size_t i = 0; i < Body.size(); i++) {
+      unsigned X = Body[i];
+      for (BasicBlock *pPredBB : predecessors(Blocks[X])) {
+        unsigned Y = Number[pPredBB];
+        // Edges back to X belong to loops already collapsed into X.
+        if (IsAncestor(X, Y))
+          continue;
+        Y = Find(Y);
+        if (!IsAncestor(W, Y)) {
+          // The loop of W is entered other than through W.
+          bReducible = false;
+          return true;
+        }
+        if (Y != W && InBody[Y] != W) {
+          InBody[Y] = W;
+          Body.push_back(Y);
+        }
+      }
+    }
+    for (unsigned X : Body)
+      Header[X] = W;
+  }
 
+  bReducible = true;
+  return true;
+}
+
+static bool IsReducibleT1T2(Function &F) {
   vector<Node> Nodes(F.size());
   unordered_map<BasicBlock*, unsigned> BasicBlockToNodeIdxMap;
 
@@ -195,13 +296,23 @@ bool ReducibilityAnalysis::runOnFunction(Function &F) {
     }
 
     if (!bChanged) {
-      m_bReducible = false;
-      break;
+      return false;
     }
 
     std::swap(pReady, pWaiting);
   }
 
+  return true;
+}
+
+bool ReducibilityAnalysis::runOnFunction(Function &F) {
+  m_bReducible = true;
+  if (F.empty()) return false;
+  IFTBOOL(F.size() < UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+
+  if (!IsReducibleDFS(F, m_bReducible))
+    m_bReducible = IsReducibleT1T2(F);
+
   if (!IsReducible()) {
     switch (m_Action) {
     case IrreducibilityAction::ThrowException:
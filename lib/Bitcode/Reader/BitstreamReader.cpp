@@ -393,16 +393,16 @@ bool BitstreamUseTracker::isDense(uint64_t endBitoffset) const {
 bool BitstreamUseTracker::considerMergeRight(size_t idx) {
   bool changed = false;
   while (idx < Ranges.size() - 1) {
-    if (Ranges[idx].second >= Ranges[idx + 1].first) {
-      Ranges[idx].second = Ranges[idx + 1].second;
-      Ranges.erase(&Ranges[idx + 1]);
-      changed = true;
-    }
+    if (Ranges[idx].second < Ranges[idx + 1].first)
+      break;
+    Ranges[idx].second = std::max(Ranges[idx].second, Ranges[idx + 1].second);
+    Ranges.erase(&Ranges[idx + 1]);
+    changed = true;
   }
   return changed;
 }
 
-void BitstreamUseTracker::insert(uint64_t begin, uint64_t end) {
+void BitstreamUseTracker::insertSlow(uint64_t begin, uint64_t end) {
   UseRange IR(begin, end);
   for (size_t i = 0; i < Ranges.size(); ++i) {
     ExtendResult ER = extendRange(Ranges[i], IR);
@@ -437,17 +437,4 @@ void BitstreamUseTracker::insert(uint64_t begin, uint64_t end) {
   Ranges.push_back(IR);
 }
 
-BitstreamUseTracker::ScopeTrack::~ScopeTrack() {
-  if (BC->getBitStreamReader()->Tracker != nullptr)
-    BC->getBitStreamReader()->Tracker->insert(begin, BC->GetCurrentBitNo());
-}
-
-BitstreamUseTracker::ScopeTrack
-BitstreamUseTracker::scope_track(BitstreamCursor *BC) {
-  ScopeTrack Result;
-  Result.BC = BC;
-  Result.begin = BC->GetCurrentBitNo();
-  return Result;
-}
-
 // HLSL Change Ends
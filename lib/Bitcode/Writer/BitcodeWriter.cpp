@@ -2118,10 +2118,13 @@ static void WriteUseListBlock(const Function *F, ValueEnumerator &VE,
   Stream.ExitBlock();
 }
 
-/// WriteFunction - Emit a function body to the module stream.
-static void WriteFunction(const Function &F, ValueEnumerator &VE,
-                          BitstreamWriter &Stream) {
-  Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
+// HLSL Change - Begin
+static const unsigned FunctionBlockCodeLen = 4;
+
+/// WriteFunctionBody - Emit the contents of a function block.
+static void WriteFunctionBody(const Function &F, ValueEnumerator &VE,
+                              BitstreamWriter &Stream) {
+// HLSL Change - End
   VE.incorporateFunction(F);
 
   SmallVector<unsigned, 64> Vals;
@@ -2188,8 +2191,17 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
   if (VE.shouldPreserveUseListOrder())
     WriteUseListBlock(&F, VE, Stream);
   VE.purgeFunction();
+}
+
+// HLSL Change - Begin
+/// WriteFunction - Emit a function body to the module stream.
+static void WriteFunction(const Function &F, ValueEnumerator &VE,
+                          BitstreamWriter &Stream) {
+  Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, FunctionBlockCodeLen);
+  WriteFunctionBody(F, VE, Stream);
   Stream.ExitBlock();
 }
+// HLSL Change - End
 
 // Emit blockinfo, which defines the standard abbreviations etc.
 static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
@@ -2366,9 +2378,94 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
+// HLSL Change - Begin
+namespace {
+/// Function blocks encoded apart from the module stream.
+struct EncodedFunctionBlocks {
+  SmallVector<char, 0> Buffer;
+  /// Byte range in Buffer of each block's body, in function order.
+  SmallVector<std::pair<size_t, size_t>, 8> Bodies;
+};
+} // namespace
+
+/// Encode the blocks for Functions, a run of the module's function bodies,
+/// exactly as WriteFunction would write them in the module stream. The
+/// enumerator is back in its module-level state after every function, and
+/// block bodies start on a word boundary, so only their position differs.
+static void
+EncodeFunctionBlocks(const Module &M, ArrayRef<const Function *> Functions,
+                     const DenseMap<const Function *, unsigned> &FunctionOrder,
+                     bool ShouldPreserveUseListOrder,
+                     EncodedFunctionBlocks &Blocks) {
+  ValueEnumerator VE(M, ShouldPreserveUseListOrder);
+  BitstreamWriter Stream(Blocks.Buffer);
+
+  // Registers the abbreviations the function blocks use.
+  WriteBlockInfo(VE, Stream);
+
+  for (const Function *F : Functions) {
+    // Use-list orders are stacked with the module's first, then each
+    // function's in order; drop those written by other tasks.
+    if (VE.shouldPreserveUseListOrder()) {
+      unsigned Order = FunctionOrder.lookup(F);
+      while (!VE.UseListOrders.empty()) {
+        const Function *Owner = VE.UseListOrders.back().F;
+        if (Owner && FunctionOrder.lookup(Owner) >= Order)
+          break;
+        VE.UseListOrders.pop_back();
+      }
+    }
+
+    Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, FunctionBlockCodeLen);
+    size_t Begin = Blocks.Buffer.size();
+    WriteFunctionBody(*F, VE, Stream);
+    Stream.ExitBlock();
+    Blocks.Bodies.push_back(std::make_pair(Begin, Blocks.Buffer.size()));
+  }
+}
+
+/// WriteFunctionsInChunks - Emit the function bodies of M, encoding runs of
+/// them as separate tasks.
+static void WriteFunctionsInChunks(const Module *M, BitstreamWriter &Stream,
+                                   bool ShouldPreserveUseListOrder,
+                                   unsigned NumChunks,
+                                   const BitcodeTaskRunner &RunTasks) {
+  SmallVector<const Function *, 64> Functions;
+  DenseMap<const Function *, unsigned> FunctionOrder;
+  for (const Function &F : *M) {
+    if (F.isDeclaration())
+      continue;
+    FunctionOrder[&F] = Functions.size();
+    Functions.push_back(&F);
+  }
+  if (NumChunks > Functions.size())
+    NumChunks = Functions.size();
+  if (NumChunks == 0)
+    return;
+
+  std::vector<EncodedFunctionBlocks> Chunks(NumChunks);
+  RunTasks(NumChunks, [&](unsigned i) {
+    size_t Begin = Functions.size() * i / NumChunks;
+    size_t End = Functions.size() * (i + 1) / NumChunks;
+    EncodeFunctionBlocks(*M, makeArrayRef(Functions).slice(Begin, End - Begin),
+                         FunctionOrder, ShouldPreserveUseListOrder, Chunks[i]);
+  });
+
+  for (const EncodedFunctionBlocks &Chunk : Chunks) {
+    for (const auto &Body : Chunk.Bodies)
+      Stream.EmitEncodedSubblock(
+          bitc::FUNCTION_BLOCK_ID, FunctionBlockCodeLen,
+          StringRef(Chunk.Buffer.data() + Body.first,
+                    Body.second - Body.first));
+  }
+}
+// HLSL Change - End
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream,
-                        bool ShouldPreserveUseListOrder) {
+                        bool ShouldPreserveUseListOrder,
+                        unsigned NumChunks = 0, // HLSL Change
+                        const BitcodeTaskRunner *RunTasks = nullptr) { // HLSL Change
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
   SmallVector<unsigned, 1> Vals;
@@ -2414,6 +2511,14 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
     WriteUseListBlock(nullptr, VE, Stream);
 
   // Emit function bodies.
+  // HLSL Change Begin - optionally encode them as separate tasks.
+  if (RunTasks) {
+    WriteFunctionsInChunks(M, Stream, ShouldPreserveUseListOrder, NumChunks,
+                           *RunTasks);
+    Stream.ExitBlock();
+    return;
+  }
+  // HLSL Change End
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
     if (!F->isDeclaration())
       WriteFunction(*F, VE, Stream);
@@ -2491,10 +2596,21 @@ static void EmitDarwinBCHeaderAndTrailer(SmallVectorImpl<char> &Buffer,
     Buffer.push_back(0);
 }
 
+// HLSL Change - Begin
 /// WriteBitcodeToFile - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
                               bool ShouldPreserveUseListOrder) {
+  WriteBitcodeToFile(M, Out, ShouldPreserveUseListOrder, 0, nullptr);
+}
+
+/// WriteBitcodeToFile - Write the specified module to the specified output
+/// stream, encoding function bodies through RunTasks if it is set.
+void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
+                              bool ShouldPreserveUseListOrder,
+                              unsigned NumChunks,
+                              const BitcodeTaskRunner &RunTasks) {
+// HLSL Change - End
   SmallVector<char, 0> Buffer;
   Buffer.reserve(256*1024);
 
@@ -2517,7 +2633,8 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
     Stream.Emit(0xD, 4);
 
     // Emit the module.
-    WriteModule(M, Stream, ShouldPreserveUseListOrder);
+    WriteModule(M, Stream, ShouldPreserveUseListOrder, NumChunks,
+                RunTasks ? &RunTasks : nullptr); // HLSL Change
   }
 
   if (TT.isOSDarwin())
@@ -0,0 +1,396 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilFunctionHash.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Structural hashing of DXIL functions.                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/DXIL/DxilFunctionHash.h"
+#include "dxc/DXIL/DxilSignature.h"
+#include "dxc/DXIL/DxilSignatureElement.h"
+#include "dxc/DXIL/DxilTypeSystem.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Loading a module again renames its structs with a numeric suffix.
+static StringRef RemoveNameSuffix(StringRef Name) {
+  size_t DotPos = Name.rfind('.');
+  if (DotPos != StringRef::npos && Name.back() != '.' &&
+      isdigit(static_cast<unsigned char>(Name[DotPos + 1])))
+    Name = Name.substr(0, DotPos);
+  return Name;
+}
+
+void DxilFunctionHasher::AddType(Type *Ty) {
+  Add((unsigned)Ty->getTypeID());
+  switch (Ty->getTypeID()) {
+  case Type::IntegerTyID:
+    Add(Ty->getIntegerBitWidth());
+    break;
+  case Type::PointerTyID:
+    Add(Ty->getPointerAddressSpace());
+    AddType(Ty->getPointerElementType());
+    break;
+  case Type::ArrayTyID:
+    Add(Ty->getArrayNumElements());
+    AddType(Ty->getArrayElementType());
+    break;
+  case Type::VectorTyID:
+    Add(Ty->getVectorNumElements());
+    AddType(Ty->getVectorElementType());
+    break;
+  case Type::FunctionTyID: {
+    FunctionType *FT = cast<FunctionType>(Ty);
+    Add(FT->isVarArg());
+    AddType(FT->getReturnType());
+    for (Type *ParamTy : FT->params())
+      AddType(ParamTy);
+    break;
+  }
+  case Type::StructTyID: {
+    StructType *ST = cast<StructType>(Ty);
+    if (ST->hasName())
+      Add(RemoveNameSuffix(ST->getName()));
+    Add(ST->isPacked());
+    Add(ST->isOpaque());
+    if (!m_structStack.insert(ST).second)
+      break;
+    Add(ST->getNumElements());
+    for (Type *EltTy : ST->elements())
+      AddType(EltTy);
+    m_structStack.erase(ST);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void DxilFunctionHasher::AddTypeAnnotations(Type *Ty) {
+  while (Ty->isPointerTy() || Ty->isArrayTy()) {
+    Ty = Ty->isPointerTy() ? Ty->getPointerElementType()
+                           : Ty->getArrayElementType();
+  }
+  StructType *ST = dyn_cast<StructType>(Ty);
+  if (!ST || !m_annotatedStructs.insert(ST).second)
+    return;
+  if (const DxilStructAnnotation *SA = m_typeSys.GetStructAnnotation(ST)) {
+    Add(SA->GetCBufferSize());
+    for (unsigned i = 0; i < SA->GetNumFields(); ++i)
+      AddFieldAnnotation(SA->GetFieldAnnotation(i));
+    for (unsigned i = 0; i < SA->GetNumTemplateArgs(); ++i) {
+      const DxilTemplateArgAnnotation &TA = SA->GetTemplateArgAnnotation(i);
+      Add(TA.IsType());
+      if (TA.IsType())
+        AddType(const_cast<Type *>(TA.GetType()));
+      else if (TA.IsIntegral())
+        Add(TA.GetIntegral());
+    }
+  }
+  for (Type *EltTy : ST->elements())
+    AddTypeAnnotations(EltTy);
+}
+
+void DxilFunctionHasher::AddValue(const Value *V) {
+  auto it = m_localIds.find(V);
+  if (it != m_localIds.end()) {
+    Add(~1u);
+    Add(it->second);
+  } else if (const Constant *C = dyn_cast<Constant>(V)) {
+    AddConstant(C);
+  } else if (const MetadataAsValue *MV = dyn_cast<MetadataAsValue>(V)) {
+    AddMetadata(MV->getMetadata());
+  } else {
+    Add(V->getValueID());
+  }
+}
+
+void DxilFunctionHasher::AddConstant(const Constant *C) {
+  Add(C->getValueID());
+  AddType(C->getType());
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    // The contents are hashed as used globals or as dependencies.
+    Add(GV->getName());
+  } else if (const ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+    Add(CI->getValue());
+  } else if (const ConstantFP *CFP = dyn_cast<ConstantFP>(C)) {
+    Add(CFP->getValueAPF().bitcastToAPInt());
+  } else if (const ConstantDataSequential *CDS =
+                 dyn_cast<ConstantDataSequential>(C)) {
+    Add(CDS->getRawDataValues());
+  } else {
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+      Add(CE->getOpcode());
+      Add(CE->getRawSubclassOptionalData());
+      if (CE->isCompare())
+        Add(CE->getPredicate());
+      if (CE->hasIndices())
+        for (unsigned Idx : CE->getIndices())
+          Add(Idx);
+    }
+    for (const Use &U : C->operands())
+      AddValue(U.get());
+  }
+}
+
+void DxilFunctionHasher::AddMetadata(const Metadata *MD) {
+  if (!MD) {
+    Add(0u);
+    return;
+  }
+  auto Ins = m_metadataIds.insert(
+      std::make_pair(MD, (unsigned)m_metadataIds.size()));
+  if (!Ins.second) {
+    // Reached before; its number stands in for it, which also ends cycles.
+    Add(~0u);
+    Add(Ins.first->second);
+    return;
+  }
+  Add(MD->getMetadataID());
+  if (const MDString *S = dyn_cast<MDString>(MD)) {
+    Add(S->getString());
+  } else if (const ValueAsMetadata *VM = dyn_cast<ValueAsMetadata>(MD)) {
+    AddValue(VM->getValue());
+  } else if (const MDNode *N = dyn_cast<MDNode>(MD)) {
+    Add(N->isDistinct());
+    AddDINodeFields(N);
+    Add(N->getNumOperands());
+    for (const MDOperand &Op : N->operands())
+      AddMetadata(Op.get());
+  }
+}
+
+// Debug info nodes keep lines, sizes and flags outside their operands.
+void DxilFunctionHasher::AddDINodeFields(const MDNode *N) {
+  if (const DILocation *Loc = dyn_cast<DILocation>(N)) {
+    Add(Loc->getLine());
+    Add(Loc->getColumn());
+    return;
+  }
+  if (const DIExpression *Expr = dyn_cast<DIExpression>(N)) {
+    for (uint64_t Elt : Expr->getElements())
+      Add(Elt);
+    return;
+  }
+  const DINode *DN = dyn_cast<DINode>(N);
+  if (!DN)
+    return;
+  Add(DN->getTag());
+  if (const DISubrange *SR = dyn_cast<DISubrange>(DN)) {
+    Add(SR->getCount());
+    Add(SR->getLowerBound());
+  } else if (const DIEnumerator *E = dyn_cast<DIEnumerator>(DN)) {
+    Add(E->getValue());
+  } else if (const DIType *T = dyn_cast<DIType>(DN)) {
+    Add(T->getLine());
+    Add(T->getSizeInBits());
+    Add(T->getAlignInBits());
+    Add(T->getOffsetInBits());
+    Add(T->getFlags());
+    if (const DIBasicType *BT = dyn_cast<DIBasicType>(T))
+      Add(BT->getEncoding());
+    else if (const DICompositeTypeBase *CT = dyn_cast<DICompositeTypeBase>(T))
+      Add(CT->getRuntimeLang());
+  } else if (const DISubprogram *SP = dyn_cast<DISubprogram>(DN)) {
+    Add(SP->getLine());
+    Add(SP->getScopeLine());
+    Add(SP->getVirtuality());
+    Add(SP->getVirtualIndex());
+    Add(SP->getFlags());
+    Add(SP->isLocalToUnit());
+    Add(SP->isDefinition());
+    Add(SP->isOptimized());
+  } else if (const DILexicalBlock *LB = dyn_cast<DILexicalBlock>(DN)) {
+    Add(LB->getLine());
+    Add(LB->getColumn());
+  } else if (const DILexicalBlockFile *LBF = dyn_cast<DILexicalBlockFile>(DN)) {
+    Add(LBF->getDiscriminator());
+  } else if (const DICompileUnit *CU = dyn_cast<DICompileUnit>(DN)) {
+    Add(CU->getSourceLanguage());
+    Add(CU->isOptimized());
+    Add(CU->getRuntimeVersion());
+    Add(CU->getEmissionKind());
+    Add(CU->getDWOId());
+  } else if (const DINamespace *NS = dyn_cast<DINamespace>(DN)) {
+    Add(NS->getLine());
+  } else if (const DIGlobalVariable *GV = dyn_cast<DIGlobalVariable>(DN)) {
+    Add(GV->getLine());
+    Add(GV->isLocalToUnit());
+    Add(GV->isDefinition());
+  } else if (const DILocalVariable *LV = dyn_cast<DILocalVariable>(DN)) {
+    Add(LV->getLine());
+    Add(LV->getArg());
+    Add(LV->getFlags());
+  } else if (const DIImportedEntity *IE = dyn_cast<DIImportedEntity>(DN)) {
+    Add(IE->getLine());
+  } else if (const DIObjCProperty *OP = dyn_cast<DIObjCProperty>(DN)) {
+    Add(OP->getLine());
+    Add(OP->getAttributes());
+  }
+}
+
+void DxilFunctionHasher::AddAttributes(AttributeSet AS) {
+  Add(AS.getNumSlots());
+  for (unsigned i = 0; i < AS.getNumSlots(); ++i) {
+    unsigned Index = AS.getSlotIndex(i);
+    Add(Index);
+    Add(AS.getAsString(Index));
+  }
+}
+
+void DxilFunctionHasher::AddFieldAnnotation(const DxilFieldAnnotation &FA) {
+  Add(FA.IsPrecise());
+  Add(FA.IsCBVarUsed());
+  if (FA.HasMatrixAnnotation()) {
+    const DxilMatrixAnnotation &MA = FA.GetMatrixAnnotation();
+    Add(MA.Rows);
+    Add(MA.Cols);
+    Add((unsigned)MA.Orientation);
+  }
+  if (FA.HasResourceAttribute())
+    AddMetadata(FA.GetResourceAttribute());
+  if (FA.HasCBufferOffset())
+    Add(FA.GetCBufferOffset());
+  if (FA.HasCompType())
+    Add((unsigned)FA.GetCompType().GetKind());
+  if (FA.HasSemanticString())
+    Add(FA.GetSemanticString());
+  if (FA.HasInterpolationMode())
+    Add((unsigned)FA.GetInterpolationMode().GetKind());
+  if (FA.HasFieldName())
+    Add(FA.GetFieldName());
+}
+
+void DxilFunctionHasher::AddParameterAnnotation(const DxilParameterAnnotation &PA) {
+  AddFieldAnnotation(PA);
+  Add((unsigned)PA.GetParamInputQual());
+  for (unsigned Idx : PA.GetSemanticIndexVec())
+    Add(Idx);
+}
+
+void DxilFunctionHasher::AddSignature(const DxilSignature &Sig) {
+  Add(Sig.GetElements().size());
+  for (const std::unique_ptr<DxilSignatureElement> &E : Sig.GetElements()) {
+    Add(E->GetID());
+    Add((unsigned)E->GetSigPointKind());
+    Add(StringRef(E->GetName()));
+    Add((unsigned)E->GetKind());
+    Add((unsigned)E->GetCompType().GetKind());
+    Add((unsigned)E->GetInterpolationMode()->GetKind());
+    Add((unsigned)E->GetInterpretation());
+    Add(E->GetRows());
+    Add(E->GetCols());
+    Add(E->GetStartRow());
+    Add(E->GetStartCol());
+    Add(E->GetOutputStream());
+    Add(E->GetDynIdxCompMask());
+    Add(E->GetUsageMask());
+    for (unsigned Idx : E->GetSemanticIndexVec())
+      Add(Idx);
+  }
+}
+
+void DxilFunctionHasher::AddInstruction(const Instruction &I) {
+  Add(I.getOpcode());
+  AddType(I.getType());
+  Add(I.getRawSubclassOptionalData());
+  Add(I.getNumOperands());
+  for (const Use &U : I.operands())
+    AddValue(U.get());
+
+  if (const CmpInst *Cmp = dyn_cast<CmpInst>(&I)) {
+    Add((unsigned)Cmp->getPredicate());
+  } else if (const LoadInst *LI = dyn_cast<LoadInst>(&I)) {
+    Add(LI->getAlignment());
+    Add(LI->isVolatile());
+    Add((unsigned)LI->getOrdering());
+  } else if (const StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+    Add(SI->getAlignment());
+    Add(SI->isVolatile());
+    Add((unsigned)SI->getOrdering());
+  } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+    Add(AI->getAlignment());
+    AddType(AI->getAllocatedType());
+  } else if (const CallInst *CI = dyn_cast<CallInst>(&I)) {
+    Add(CI->isTailCall());
+    Add(CI->getCallingConv());
+    AddAttributes(CI->getAttributes());
+  } else if (const PHINode *PN = dyn_cast<PHINode>(&I)) {
+    for (unsigned i = 0; i < PN->getNumIncomingValues(); ++i)
+      AddValue(PN->getIncomingBlock(i));
+  } else if (const ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(&I)) {
+    for (unsigned Idx : EVI->indices())
+      Add(Idx);
+  } else if (const InsertValueInst *IVI = dyn_cast<InsertValueInst>(&I)) {
+    for (unsigned Idx : IVI->indices())
+      Add(Idx);
+  } else if (const AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(&I)) {
+    Add((unsigned)RMW->getOperation());
+    Add((unsigned)RMW->getOrdering());
+    Add(RMW->isVolatile());
+  } else if (const AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(&I)) {
+    Add((unsigned)CX->getSuccessOrdering());
+    Add((unsigned)CX->getFailureOrdering());
+    Add(CX->isVolatile());
+    Add(CX->isWeak());
+  } else if (const FenceInst *FI = dyn_cast<FenceInst>(&I)) {
+    Add((unsigned)FI->getOrdering());
+  }
+
+  // Includes the debug location.
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  I.getAllMetadata(MDs);
+  for (auto &MD : MDs) {
+    Add(MD.first);
+    AddMetadata(MD.second);
+  }
+}
+
+void DxilFunctionHasher::AddFunction(Function &F) {
+  Add((unsigned)F.getLinkage());
+  Add(F.getCallingConv());
+  AddType(F.getFunctionType());
+  AddAttributes(F.getAttributes());
+
+  m_localIds.clear();
+  unsigned id = 0;
+  for (Argument &Arg : F.args())
+    m_localIds[&Arg] = id++;
+  for (BasicBlock &BB : F) {
+    m_localIds[&BB] = id++;
+    for (Instruction &I : BB)
+      m_localIds[&I] = id++;
+  }
+  for (BasicBlock &BB : F) {
+    Add(BB.size());
+    for (Instruction &I : BB)
+      AddInstruction(I);
+  }
+  m_localIds.clear();
+
+  if (const DxilFunctionAnnotation *FA = m_typeSys.GetFunctionAnnotation(&F)) {
+    Add(FA->GetNumParameters());
+    for (unsigned i = 0; i < FA->GetNumParameters(); ++i)
+      AddParameterAnnotation(FA->GetParameterAnnotation(i));
+    AddParameterAnnotation(FA->GetRetTypeAnnotation());
+  }
+  for (Type *ParamTy : F.getFunctionType()->params())
+    AddTypeAnnotations(ParamTy);
+}
+
+uint64_t hlsl::ComputeFunctionBodyHash(Function &F, DxilTypeSystem &TypeSys) {
+  DxilFunctionHasher H(TypeSys);
+  H.AddFunction(F);
+  return H.GetHash();
+}
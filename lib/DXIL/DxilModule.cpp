@@ -117,6 +117,7 @@ DxilModule::DxilModule(Module *pModule)
 , m_AutoBindingSpace(UINT_MAX)
 , m_pSubobjects(nullptr)
 , m_bMetadataErrors(false)
+, m_bTypeSystemPending(false)
 {
 
   DXASSERT_NOMSG(m_pModule != nullptr);
@@ -296,6 +297,7 @@ unsigned DxilModule::GetGlobalFlags() const {
 void DxilModule::CollectShaderFlagsForModule(ShaderFlags &Flags) {
   for (Function &F : GetModule()->functions()) {
     ShaderFlags funcFlags = ShaderFlags::CollectShaderFlags(&F, this);
+    m_FunctionShaderFlags[&F] = funcFlags;
     Flags.CombineShaderFlags(funcFlags);
   };
 
@@ -343,6 +345,13 @@ void DxilModule::CollectShaderFlagsForModule(ShaderFlags &Flags) {
   Flags.SetCSRawAndStructuredViaShader4X(hasCSRawAndStructuredViaShader4X);
 }
 
+const ShaderFlags &DxilModule::GetShaderFlagsForFunction(const Function *F) const {
+  auto it = m_FunctionShaderFlags.find(F);
+  if (it != m_FunctionShaderFlags.end())
+    return it->second;
+  return m_FunctionShaderFlags[F] = ShaderFlags::CollectShaderFlags(F, this);
+}
+
 void DxilModule::CollectShaderFlagsForModule() {
   CollectShaderFlagsForModule(m_ShaderFlags);
 
@@ -938,6 +947,8 @@ static void ConvertUsedResource(std::unordered_set<unsigned> &immResID,
 void DxilModule::RemoveFunction(llvm::Function *F) {
   DXASSERT_NOMSG(F != nullptr);
   m_DxilEntryPropsMap.erase(F);
+  m_FunctionShaderFlags.erase(F);
+  LoadPendingTypeSystem();
   if (m_pTypeSystem.get()->GetFunctionAnnotation(F))
     m_pTypeSystem.get()->EraseFunctionAnnotation(F);
   m_pOP->RemoveFunction(F);
@@ -1209,6 +1220,7 @@ void DxilModule::ResetSerializedRootSignature(std::vector<uint8_t> &Value) {
 }
 
 DxilTypeSystem &DxilModule::GetTypeSystem() {
+  LoadPendingTypeSystem();
   return *m_pTypeSystem;
 }
 
@@ -1220,6 +1232,7 @@ const std::vector<unsigned> &DxilModule::GetSerializedViewIdState() const {
 }
 
 void DxilModule::ResetTypeSystem(DxilTypeSystem *pValue) {
+  m_bTypeSystemPending = false;
   m_pTypeSystem.reset(pValue);
 }
 
@@ -1291,6 +1304,10 @@ void DxilModule::ClearDxilMetadata(Module &M) {
   // root signature, function properties.
   // Other cases for libs pending.
   // LLVM used is a global variable - handle separately.
+  // Deserialize anything still pending before its metadata goes away.
+  if (M.HasDxilModule())
+    M.GetDxilModule().LoadPendingTypeSystem();
+
   SmallVector<NamedMDNode*, 8> nodes;
   for (NamedMDNode &b : M.named_metadata()) {
     StringRef name = b.getName();
@@ -1314,6 +1331,7 @@ void DxilModule::ClearDxilMetadata(Module &M) {
 }
 
 void DxilModule::EmitDxilMetadata() {
+  LoadPendingTypeSystem();
   m_pMDHelper->EmitDxilVersion(m_DxilMajor, m_DxilMinor);
   m_pMDHelper->EmitValidatorVersion(m_ValMajor, m_ValMinor);
   m_pMDHelper->EmitDxilShaderModel(m_pSM);
@@ -1393,10 +1411,29 @@ bool DxilModule::IsKnownNamedMetaData(llvm::NamedMDNode &Node) {
 }
 
 bool DxilModule::HasMetadataErrors() {
+  LoadPendingTypeSystem();
   return m_bMetadataErrors;
 }
 
-void DxilModule::LoadDxilMetadata() {
+void DxilModule::LoadPendingTypeSystem() {
+  if (!m_bTypeSystemPending)
+    return;
+  m_bTypeSystemPending = false;
+
+  // Type system is not required for consumption of dxil.
+  try {
+    m_pMDHelper->LoadDxilTypeSystem(*m_pTypeSystem.get());
+  } catch (hlsl::Exception &) {
+    m_bMetadataErrors = true;
+#ifdef DBG
+    throw;
+#endif
+    m_pTypeSystem->GetStructAnnotationMap().clear();
+    m_pTypeSystem->GetFunctionAnnotationMap().clear();
+  }
+}
+
+void DxilModule::LoadDxilMetadata(bool bLazyTypeSystem) {
   m_bMetadataErrors = false;
   m_pMDHelper->LoadDxilVersion(m_DxilMajor, m_DxilMinor);
   m_pMDHelper->LoadValidatorVersion(m_ValMajor, m_ValMinor);
@@ -1488,17 +1525,9 @@ void DxilModule::LoadDxilMetadata() {
 
   LoadDxilResources(*pEntryResources);
 
-  // Type system is not required for consumption of dxil.
-  try {
-    m_pMDHelper->LoadDxilTypeSystem(*m_pTypeSystem.get());
-  } catch (hlsl::Exception &) {
-    m_bMetadataErrors = true;
-#ifdef DBG
-    throw;
-#endif
-    m_pTypeSystem->GetStructAnnotationMap().clear();
-    m_pTypeSystem->GetFunctionAnnotationMap().clear();
-  }
+  m_bTypeSystemPending = true;
+  if (!bLazyTypeSystem)
+    LoadPendingTypeSystem();
 
   m_pMDHelper->LoadRootSignature(m_SerializedRootSignature);
 
@@ -1598,6 +1627,7 @@ static bool ResourceTypeRequiresTranslation(const StructType * Ty, SmallStructSe
 }
 
 bool DxilModule::StripReflection() {
+  LoadPendingTypeSystem();
   bool bChanged = false;
   bool bIsLib = GetShaderModel()->IsLib();
 
@@ -1840,12 +1870,13 @@ bool DxilModule::IsPrecise(const Instruction *inst) const {
 } // namespace hlsl
 
 namespace llvm {
-hlsl::DxilModule &Module::GetOrCreateDxilModule(bool skipInit) {
+hlsl::DxilModule &Module::GetOrCreateDxilModule(bool skipInit,
+                                                bool lazyTypeSystem) {
   std::unique_ptr<hlsl::DxilModule> M;
   if (!HasDxilModule()) {
     M = llvm::make_unique<hlsl::DxilModule>(this);
     if (!skipInit) {
-      M->LoadDxilMetadata();
+      M->LoadDxilMetadata(lazyTypeSystem);
     }
     SetDxilModule(M.release());
   }
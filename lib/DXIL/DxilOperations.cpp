@@ -16,6 +16,8 @@
 
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
@@ -511,9 +513,8 @@ bool OP::IsDxilOpFuncName(StringRef name) {
 
 bool OP::IsDxilOpFunc(const llvm::Function *F) {
   // Test for null to allow IsDxilOpFunc(Call.getCalledFunc()) to be resilient to indirect calls
-  if (F == nullptr || !F->hasName())
-    return false;
-  return IsDxilOpFuncName(F->getName());
+  // The name is classified when it is set, so this is a bit test.
+  return F != nullptr && F->isDxilOp();
 }
 
 bool OP::IsDxilOpTypeName(StringRef name) {
@@ -926,12 +927,12 @@ Function *OP::GetOpFunc(OpCode opCode, Type *pOverloadType) {
   DXASSERT(IsOverloadLegal(opCode, pOverloadType), "otherwise the caller requested illegal operation overload (eg HLSL function with unsupported types for mapped intrinsic function)");
   OpCodeClass opClass = m_OpCodeProps[(unsigned)opCode].opCodeClass;
   Function *&F = m_OpCodeClassCache[(unsigned)opClass].pOverloads[pOverloadType];
-  if (F != nullptr) {
-    UpdateCache(opClass, pOverloadType, F);
+  // Every cached function was recorded by UpdateCache, so a hit needs no
+  // further bookkeeping.
+  if (F != nullptr)
     return F;
-  }
 
-  vector<Type*> ArgTypes;      // RetType is ArgTypes[0]
+  SmallVector<Type*, 16> ArgTypes; // RetType is ArgTypes[0]
   Type *pETy = pOverloadType;
   Type *pRes = GetHandleType();
   Type *pDim = GetDimensionsType();
@@ -955,12 +956,14 @@ Function *OP::GetOpFunc(OpCode opCode, Type *pOverloadType) {
   Type *obj = pOverloadType;
   Type *resProperty = GetResourcePropertiesType();
 
-  std::string funcName = (Twine(OP::m_NamePrefix) + Twine(GetOpCodeClassName(opCode))).str();
+  SmallString<64> funcName(OP::m_NamePrefix);
+  funcName += GetOpCodeClassName(opCode);
   // Add ret type to the name.
   if (pOverloadType != pV) {
     std::string typeName;
-    funcName = Twine(funcName).concat(".").concat(GetTypeName(pOverloadType, typeName)).str();
-  } 
+    funcName += ".";
+    funcName += GetTypeName(pOverloadType, typeName);
+  }
   // Try to find exist function with the same name in the module.
   if (Function *existF = m_pModule->getFunction(funcName)) {
     F = existF;
@@ -1330,7 +1333,9 @@ Function *OP::GetOpFunc(OpCode opCode, Type *pOverloadType) {
   DXASSERT(ArgTypes.size() > 1, "otherwise forgot to initialize arguments");
   pFT = FunctionType::get(ArgTypes[0], ArrayRef<Type*>(&ArgTypes[1], ArgTypes.size()-1), false);
 
-  F = cast<Function>(m_pModule->getOrInsertFunction(funcName, pFT));
+  // The lookup above missed, so there is nothing to reuse or bitcast.
+  F = Function::Create(pFT, GlobalValue::ExternalLinkage, funcName.str(),
+                       m_pModule);
 
   UpdateCache(opClass, pOverloadType, F);
   F->setCallingConv(CallingConv::C);
@@ -74,6 +74,23 @@ unsigned DxilSignature::AppendElement(std::unique_ptr<DxilSignatureElement> pSE,
   return Id;
 }
 
+std::vector<int> DxilSignature::RemoveElements(const std::vector<bool> &Remove) {
+  DXASSERT_NOMSG(Remove.size() == m_Elements.size());
+  std::vector<int> NewIDs(m_Elements.size(), -1);
+  unsigned Count = 0;
+  for (unsigned i = 0; i < m_Elements.size(); ++i) {
+    if (Remove[i])
+      continue;
+    NewIDs[i] = Count;
+    m_Elements[i]->SetID(Count);
+    if (Count != i)
+      m_Elements[Count] = std::move(m_Elements[i]);
+    ++Count;
+  }
+  m_Elements.resize(Count);
+  return NewIDs;
+}
+
 DxilSignatureElement &DxilSignature::GetElement(unsigned idx) {
   return *m_Elements[idx];
 }
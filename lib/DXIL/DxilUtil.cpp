@@ -318,6 +318,16 @@ void EmitWarningOnInstruction(Instruction *I, Twine Msg) {
   EmitWarningOrErrorOnInstruction(I, Msg, /*bWarning*/true);
 }
 
+void EmitNoteOnInstruction(Instruction *I, Twine Msg) {
+  const DebugLoc &DL = I->getDebugLoc();
+  if (DL.get()) {
+    I->getContext().diagnose(
+        DiagnosticInfoInlineAsm(FormatMessageAtLocation(DL, Msg), DS_Note));
+    return;
+  }
+  I->getContext().diagnose(DiagnosticInfoInlineAsm(Msg, DS_Note));
+}
+
 static void EmitWarningOrErrorOnFunction(Function *F, Twine Msg,
                                          bool bWarning) {
   DISubprogram *DISP = getDISubprogram(F);
@@ -370,6 +380,17 @@ void EmitWarningOnGlobalVariable(GlobalVariable *GV, Twine Msg) {
   EmitWarningOrErrorOnGlobalVariable(GV, Msg, /*bWarning*/true);
 }
 
+void EmitNoteOnGlobalVariable(GlobalVariable *GV, Twine Msg) {
+  DIVariable *DIV = FindGlobalVariableDebugInfo(
+      GV, GV->getParent()->GetDxilModule().GetOrCreateDebugInfoFinder());
+  if (DIV) {
+    GV->getContext().diagnose(
+        DiagnosticInfoInlineAsm(FormatMessageInVariable(DIV, Msg), DS_Note));
+    return;
+  }
+  GV->getContext().diagnose(DiagnosticInfoInlineAsm(Msg, DS_Note));
+}
+
 
 const char *kResourceMapErrorMsg =
     "local resource not guaranteed to map to unique global resource.";
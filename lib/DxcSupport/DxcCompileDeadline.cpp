@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcCompileDeadline.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a per-thread compile deadline checked by long-running passes.    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/DxcCompileDeadline.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "llvm/Support/Compiler.h"
+
+using namespace hlsl;
+
+static LLVM_THREAD_LOCAL const DxcCompileDeadline *t_pDeadline = nullptr;
+
+DxcCompileDeadline::DxcCompileDeadline(unsigned Milliseconds,
+                                       IDxcCancellationToken *pToken)
+    : m_milliseconds(Milliseconds), m_enabled(Milliseconds != 0),
+      m_pToken(pToken), m_pOuter(t_pDeadline), m_pPrior(t_pDeadline) {
+  if (m_enabled)
+    m_deadline = Clock::now() + std::chrono::milliseconds(Milliseconds);
+  t_pDeadline = this;
+}
+
+DxcCompileDeadline::DxcCompileDeadline(const DxcCompileDeadline *pOther)
+    : m_milliseconds(0), m_enabled(false), m_pToken(nullptr),
+      m_pOuter(pOther), m_pPrior(t_pDeadline) {
+  t_pDeadline = this;
+}
+
+DxcCompileDeadline::~DxcCompileDeadline() {
+  DXASSERT(t_pDeadline == this, "else deadlines were not destroyed in order");
+  t_pDeadline = m_pPrior;
+}
+
+bool DxcCompileDeadline::IsCancelled() const {
+  return (m_pToken && m_pToken->IsCancelled()) ||
+         (m_pOuter && m_pOuter->IsCancelled());
+}
+
+bool DxcCompileDeadline::IsTimeUp() const {
+  return (m_enabled && Clock::now() >= m_deadline) ||
+         (m_pOuter && m_pOuter->IsTimeUp());
+}
+
+const DxcCompileDeadline *DxcCompileDeadline::GetCurrent() {
+  return t_pDeadline;
+}
+
+bool hlsl::IsCompileDeadlineExpired() {
+  return t_pDeadline && t_pDeadline->IsExpired();
+}
+
+void hlsl::CheckCompileDeadline() {
+  if (!t_pDeadline)
+    return;
+  if (t_pDeadline->IsCancelled())
+    throw hlsl::Exception(DXC_E_COMPILE_CANCELLED, "Compilation was cancelled.");
+  if (!t_pDeadline->IsTimeUp())
+    return;
+  std::string msg = "Compilation did not finish within its deadline";
+  if (t_pDeadline->GetMilliseconds())
+    msg += " of " + std::to_string(t_pDeadline->GetMilliseconds()) + " ms";
+  msg += ".";
+  throw hlsl::Exception(DXC_E_COMPILE_DEADLINE_EXCEEDED, msg);
+}
@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcSourceStore.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the content-addressed store for sources referenced by PDBs.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/DxcSourceStore.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MD5.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+using namespace llvm;
+
+namespace hlsl {
+
+std::string ComputeSourceDigest(StringRef Contents) {
+  MD5 Hasher;
+  Hasher.update(Contents);
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Digest;
+  MD5::stringifyResult(Result, Digest);
+  return Digest.str();
+}
+
+namespace {
+
+// Keeps one file per source, named after its digest. Sources are only ever
+// added, never replaced, so a file that matches its name is complete.
+class DxcDirectorySourceStore : public IDxcSourceStore {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::wstring m_directory;
+
+  std::wstring GetSourcePath(StringRef Digest) {
+    std::wstring path = m_directory;
+    if (!path.empty() && path.back() != L'/' && path.back() != L'\\')
+      path.push_back(L'/');
+    path.append(Digest.begin(), Digest.end());
+    return path;
+  }
+
+  // Creates the store directory and any missing parents. Failures are left
+  // for the write that follows to report.
+  void MakeStoreDirectory() {
+    for (size_t i = 1; i <= m_directory.size(); ++i) {
+      if (i != m_directory.size() && m_directory[i] != L'/' &&
+          m_directory[i] != L'\\')
+        continue;
+      std::wstring prefix = m_directory.substr(0, i);
+#ifdef _WIN32
+      CreateDirectoryW(prefix.c_str(), nullptr);
+#else
+      std::string utf8;
+      if (Unicode::UTF16ToUTF8String(prefix.c_str(), &utf8))
+        mkdir(utf8.c_str(), 0777);
+#endif
+    }
+  }
+
+  // Loads the stored file for Digest, or returns nullptr if there is none or
+  // its contents do not match.
+  HRESULT LoadVerified(StringRef Digest, IDxcBlobEncoding **ppSource) {
+    *ppSource = nullptr;
+    std::wstring path = GetSourcePath(Digest);
+    CComPtr<IDxcBlobEncoding> pBlob;
+    if (FAILED(DxcCreateBlobFromFile(m_pMalloc, path.c_str(), nullptr, &pBlob)))
+      return S_FALSE;
+    StringRef Contents((const char *)pBlob->GetBufferPointer(),
+                       pBlob->GetBufferSize());
+    if (ComputeSourceDigest(Contents) != Digest)
+      return S_FALSE;
+    *ppSource = pBlob.Detach();
+    return S_OK;
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcDirectorySourceStore)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcSourceStore, IDxcIncludeHandler>(
+        this, iid, ppvObject);
+  }
+
+  void Init(LPCWSTR pDirectory) { m_directory = pDirectory; }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(
+      _In_z_ LPCWSTR pFilename,
+      _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource) override {
+    if (pFilename == nullptr || ppIncludeSource == nullptr)
+      return E_INVALIDARG;
+    *ppIncludeSource = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      std::string Digest;
+      for (const wchar_t *p = pFilename; *p; ++p) {
+        if (!iswxdigit(*p))
+          return E_INVALIDARG;
+        Digest.push_back((char)towlower(*p));
+      }
+      CComPtr<IDxcBlobEncoding> pSource;
+      IFR(LoadVerified(Digest, &pSource));
+      if (!pSource)
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+      *ppIncludeSource = pSource.Detach();
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT STDMETHODCALLTYPE AddSource(_In_ IDxcBlob *pSource) override {
+    if (pSource == nullptr)
+      return E_INVALIDARG;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      StringRef Contents((const char *)pSource->GetBufferPointer(),
+                         pSource->GetBufferSize());
+      std::string Digest = ComputeSourceDigest(Contents);
+      CComPtr<IDxcBlobEncoding> pExisting;
+      IFR(LoadVerified(Digest, &pExisting));
+      if (pExisting)
+        return S_OK;
+      std::wstring path = GetSourcePath(Digest);
+      try {
+        WriteBinaryFile(path.c_str(), Contents.data(), (DWORD)Contents.size());
+      } catch (hlsl::Exception &) {
+        // Another compile may be writing the same source, or the directory
+        // may not exist yet.
+        IFR(LoadVerified(Digest, &pExisting));
+        if (!pExisting) {
+          MakeStoreDirectory();
+          WriteBinaryFile(path.c_str(), Contents.data(),
+                          (DWORD)Contents.size());
+        }
+      }
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+} // namespace
+
+HRESULT CreateDirectorySourceStore(IMalloc *pMalloc, LPCWSTR pDirectory,
+                                   IDxcSourceStore **ppStore) {
+  if (pDirectory == nullptr || ppStore == nullptr)
+    return E_INVALIDARG;
+  *ppStore = nullptr;
+  try {
+    CComPtr<DxcDirectorySourceStore> pStore =
+        DxcDirectorySourceStore::Alloc(pMalloc);
+    IFROOM(pStore.p);
+    pStore->Init(pDirectory);
+    *ppStore = pStore.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+} // namespace hlsl
@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcThreadPool.cpp                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a work-stealing thread pool for parallel compiler work.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/dxcapi.h"
+#include "llvm/Support/Compiler.h"
+
+#include <algorithm>
+
+using namespace hlsl;
+
+// Identifies the pool and queue of the current thread when it is a worker,
+// so nested submissions can go to the local deque. Host tasks set the pool
+// too, while they run a task.
+static LLVM_THREAD_LOCAL DxcThreadPool *t_pCurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned t_CurrentQueue = 0;
+
+// Process-wide settings, read when a pool is created.
+static std::mutex g_HostExecutorLock;
+static IDxcTaskExecutor *g_pHostExecutor = nullptr;
+static std::atomic<unsigned> g_MaxThreadCount(0);
+static LLVM_THREAD_LOCAL unsigned t_MaxThreadCount = 0;
+
+// Drains the host queue of a pool for as long as it has tasks.
+class DxcThreadPool::HostTask : public IDxcTask {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::shared_ptr<HostQueue> m_pQueue;
+  bool m_bRan = false;
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  explicit HostTask(std::shared_ptr<HostQueue> pQueue)
+      : m_pQueue(std::move(pQueue)) {}
+  ~HostTask() {
+    // A task the host dropped no longer counts against the limit; Wait runs
+    // whatever it would have.
+    if (!m_bRan) {
+      std::unique_lock<std::mutex> L(m_pQueue->Lock);
+      --m_pQueue->Scheduled;
+    }
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcTask>(this, iid, ppvObject);
+  }
+
+  void STDMETHODCALLTYPE Run() override {
+    if (m_bRan)
+      return;
+    m_bRan = true;
+    RunHostTasks(m_pQueue, true);
+  }
+};
+
+unsigned DxcThreadPool::GetMaxThreadCount() {
+  unsigned maxCount = g_MaxThreadCount;
+  if (t_MaxThreadCount && (!maxCount || t_MaxThreadCount < maxCount))
+    maxCount = t_MaxThreadCount;
+  return maxCount;
+}
+
+unsigned DxcThreadPool::GetDefaultThreadCount() {
+  unsigned count = std::thread::hardware_concurrency();
+  unsigned maxCount = GetMaxThreadCount();
+  if (maxCount && count > maxCount)
+    count = maxCount;
+  return count ? count : 1;
+}
+
+unsigned DxcThreadPool::GetTaskThreadLimit(unsigned ThreadCount) {
+  return std::max(1u, GetDefaultThreadCount() / std::max(1u, ThreadCount));
+}
+
+void DxcThreadPool::SetHostExecutor(IDxcTaskExecutor *pExecutor) {
+  if (pExecutor)
+    pExecutor->AddRef();
+  IDxcTaskExecutor *pPrior;
+  {
+    std::unique_lock<std::mutex> L(g_HostExecutorLock);
+    pPrior = g_pHostExecutor;
+    g_pHostExecutor = pExecutor;
+  }
+  if (pPrior)
+    pPrior->Release();
+}
+
+void DxcThreadPool::SetMaxThreadCount(unsigned MaxThreadCount) {
+  g_MaxThreadCount = MaxThreadCount;
+}
+
+DxcThreadCountLimit::DxcThreadCountLimit(unsigned MaxThreadCount)
+    : m_priorLimit(t_MaxThreadCount) {
+  t_MaxThreadCount = MaxThreadCount;
+}
+
+DxcThreadCountLimit::~DxcThreadCountLimit() { t_MaxThreadCount = m_priorLimit; }
+
+DxcThreadPool::DxcThreadPool(unsigned ThreadCount) : m_nextQueue(0) {
+  unsigned maxCount = GetMaxThreadCount();
+  if (ThreadCount == 0)
+    ThreadCount = GetDefaultThreadCount();
+  else if (maxCount && ThreadCount > maxCount)
+    ThreadCount = maxCount;
+  m_threadCount = ThreadCount;
+  // Work nested in a task shares the threads of its creator with the other
+  // tasks, so pools created by a task get an even share of them. Otherwise a
+  // pool per job in a batch would each start a thread per core.
+  m_taskThreadLimit = GetTaskThreadLimit(ThreadCount);
+
+  {
+    std::unique_lock<std::mutex> L(g_HostExecutorLock);
+    m_pExecutor = g_pHostExecutor;
+    if (m_pExecutor)
+      m_pExecutor->AddRef();
+  }
+  if (m_pExecutor) {
+    m_pHostQueue = std::make_shared<HostQueue>();
+    m_pHostQueue->pPool = this;
+    return;
+  }
+
+  m_queues.reserve(ThreadCount);
+  for (unsigned i = 0; i < ThreadCount; ++i)
+    m_queues.emplace_back(new WorkerQueue());
+  m_threads.reserve(ThreadCount);
+  for (unsigned i = 0; i < ThreadCount; ++i)
+    m_threads.emplace_back([this, i]() { RunWorker(i); });
+}
+
+DxcThreadPool::~DxcThreadPool() {
+  Wait();
+  {
+    std::unique_lock<std::mutex> L(m_lock);
+    m_stopping = true;
+  }
+  m_workAvailable.notify_all();
+  for (std::thread &T : m_threads)
+    T.join();
+  if (m_pExecutor) {
+    {
+      std::unique_lock<std::mutex> L(m_pHostQueue->Lock);
+      m_pHostQueue->pPool = nullptr;
+    }
+    m_pExecutor->Release();
+  }
+}
+
+void DxcThreadPool::Async(Task T) {
+  if (m_pExecutor) {
+    AsyncOnHost(std::move(T));
+    return;
+  }
+  unsigned index;
+  bool isLocal = t_pCurrentPool == this;
+  if (isLocal)
+    index = t_CurrentQueue;
+  else
+    index = m_nextQueue++ % m_queues.size();
+  {
+    WorkerQueue &Q = *m_queues[index];
+    std::unique_lock<std::mutex> L(Q.Lock);
+    if (isLocal)
+      Q.Tasks.emplace_front(std::move(T));
+    else
+      Q.Tasks.emplace_back(std::move(T));
+  }
+  {
+    std::unique_lock<std::mutex> L(m_lock);
+    ++m_queued;
+    ++m_unfinished;
+  }
+  m_workAvailable.notify_one();
+}
+
+bool DxcThreadPool::IsRunningTask() const { return t_pCurrentPool == this; }
+
+HRESULT DxcThreadPool::Wait() {
+  DXASSERT(t_pCurrentPool != this, "else waiting from a worker would deadlock");
+  if (m_pHostQueue)
+    RunHostTasks(m_pHostQueue, false);
+  std::unique_lock<std::mutex> L(m_lock);
+  m_allDone.wait(L, [this]() { return m_unfinished == 0; });
+  HRESULT hr = m_firstFailure;
+  m_firstFailure = S_OK;
+  return hr;
+}
+
+bool DxcThreadPool::TryTake(unsigned Index, Task &T) {
+  // Own queue first, from the front; then steal from the back of the others.
+  unsigned count = (unsigned)m_queues.size();
+  for (unsigned i = 0; i < count; ++i) {
+    WorkerQueue &Q = *m_queues[(Index + i) % count];
+    std::unique_lock<std::mutex> L(Q.Lock);
+    if (Q.Tasks.empty())
+      continue;
+    if (i == 0) {
+      T = std::move(Q.Tasks.front());
+      Q.Tasks.pop_front();
+    } else {
+      T = std::move(Q.Tasks.back());
+      Q.Tasks.pop_back();
+    }
+    return true;
+  }
+  return false;
+}
+
+void DxcThreadPool::RunWorker(unsigned Index) {
+  t_pCurrentPool = this;
+  t_CurrentQueue = Index;
+  DxcThreadCountLimit Limit(m_taskThreadLimit);
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> L(m_lock);
+      m_workAvailable.wait(L, [this]() { return m_stopping || m_queued > 0; });
+      if (m_queued == 0)
+        break; // stopping with no work left
+      --m_queued;
+    }
+
+    // Tasks are pushed before m_queued is incremented and only reserved
+    // workers take them, so a reservation always finds a task.
+    Task T;
+    bool found = TryTake(Index, T);
+    DXASSERT_LOCALVAR(found, found, "else reserved a task that was not queued");
+
+    // An escaping exception must not take the worker down with it; Wait
+    // reports it instead.
+    HRESULT hr = S_OK;
+    try {
+      T();
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    bool done;
+    {
+      std::unique_lock<std::mutex> L(m_lock);
+      if (FAILED(hr) && SUCCEEDED(m_firstFailure))
+        m_firstFailure = hr;
+      done = --m_unfinished == 0;
+    }
+    if (done)
+      m_allDone.notify_all();
+  }
+  t_pCurrentPool = nullptr;
+}
+
+void DxcThreadPool::AsyncOnHost(Task T) {
+  // Counted first, so a host task that finishes it right away cannot take
+  // the count below zero.
+  {
+    std::unique_lock<std::mutex> L(m_lock);
+    ++m_unfinished;
+  }
+  bool schedule;
+  {
+    std::unique_lock<std::mutex> L(m_pHostQueue->Lock);
+    m_pHostQueue->Tasks.emplace_back(std::move(T));
+    schedule = m_pHostQueue->Scheduled < m_threadCount;
+    if (schedule)
+      ++m_pHostQueue->Scheduled;
+  }
+  if (!schedule)
+    return;
+
+  IDxcTask *pTask = new (std::nothrow) HostTask(m_pHostQueue);
+  HRESULT hr = E_OUTOFMEMORY;
+  if (pTask) {
+    pTask->AddRef();
+    hr = m_pExecutor->Schedule(pTask);
+    pTask->Release();
+  } else {
+    std::unique_lock<std::mutex> L(m_pHostQueue->Lock);
+    --m_pHostQueue->Scheduled;
+  }
+  // Without a host task the queued work would wait for Wait, which some
+  // owners only call on destruction, so run it here instead.
+  if (FAILED(hr))
+    RunHostTasks(m_pHostQueue, false);
+}
+
+void DxcThreadPool::RunHostTasks(const std::shared_ptr<HostQueue> &Q,
+                                 bool bScheduled) {
+  for (;;) {
+    Task T;
+    DxcThreadPool *pPool;
+    {
+      std::unique_lock<std::mutex> L(Q->Lock);
+      if (Q->Tasks.empty()) {
+        if (bScheduled)
+          --Q->Scheduled;
+        return;
+      }
+      T = std::move(Q->Tasks.front());
+      Q->Tasks.pop_front();
+      // The pool waits for this task, so it stays alive until it finishes.
+      pPool = Q->pPool;
+    }
+
+    DxcThreadPool *pPriorPool = t_pCurrentPool;
+    t_pCurrentPool = pPool;
+    HRESULT hr = S_OK;
+    try {
+      DxcThreadCountLimit Limit(pPool->m_taskThreadLimit);
+      T();
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    t_pCurrentPool = pPriorPool;
+    pPool->FinishHostTask(hr);
+  }
+}
+
+void DxcThreadPool::FinishHostTask(HRESULT hr) {
+  // Notified under the lock: once the count reaches zero the pool may be
+  // destroyed as soon as the lock is released.
+  std::unique_lock<std::mutex> L(m_lock);
+  if (FAILED(hr) && SUCCEEDED(m_firstFailure))
+    m_firstFailure = hr;
+  if (--m_unfinished == 0)
+    m_allDone.notify_all();
+}
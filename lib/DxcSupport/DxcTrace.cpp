@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcTrace.cpp                                                              //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a trace-event writer for compiler events and phases.             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/DxcTrace.h"
+#include "dxc/Support/WinIncludes.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+using namespace hlsl;
+
+namespace {
+// Writes events to the trace file as they come. The file is written through
+// the C runtime rather than llvm::sys::fs, which the compiler redirects per
+// thread. The closing bracket of the array is optional, so a trace is still
+// readable when the process ends without running static destructors.
+class TraceWriter {
+public:
+  TraceWriter() : m_pFile(nullptr), m_bFirst(true) {
+    llvm::Optional<std::string> Path =
+        llvm::sys::Process::GetEnv("DXC_TRACE_FILE");
+    if (!Path || Path->empty())
+      return;
+    m_pFile = fopen(GetProcessPath(*Path).c_str(), "w");
+    if (!m_pFile)
+      return;
+    m_start = std::chrono::steady_clock::now();
+    fputs("[\n", m_pFile);
+  }
+  ~TraceWriter() {
+    if (!m_pFile)
+      return;
+    fputs("\n]\n", m_pFile);
+    fclose(m_pFile);
+  }
+
+  bool IsEnabled() const { return m_pFile != nullptr; }
+
+  void Write(const char *pName, char Phase, const long *pStatus) {
+    uint64_t Micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - m_start)
+                          .count();
+    uint64_t ThreadId = GetThreadId();
+    std::lock_guard<std::mutex> Lock(m_mutex);
+    fprintf(m_pFile,
+            "%s{\"name\":\"%s\",\"cat\":\"dxc\",\"ph\":\"%c\",\"ts\":%" PRIu64
+            ",\"pid\":%u,\"tid\":%" PRIu64,
+            m_bFirst ? "" : ",\n", pName, Phase, Micros, GetProcessId(),
+            ThreadId);
+    if (pStatus)
+      fprintf(m_pFile, ",\"args\":{\"hr\":\"0x%08x\"}", (unsigned)*pStatus);
+    fputc('}', m_pFile);
+    m_bFirst = false;
+    // Keep the file current, so a trace survives a crash in the compiler.
+    fflush(m_pFile);
+  }
+
+private:
+  // Each process gets a file of its own, so that one compiler process does
+  // not truncate the trace of another. %p in Path is replaced by the process
+  // ID; without it, the process ID goes before the extension.
+  static std::string GetProcessPath(llvm::StringRef Path) {
+    std::string Pid = std::to_string(GetProcessId());
+    size_t Pos = Path.find("%p");
+    if (Pos != llvm::StringRef::npos)
+      return (Path.substr(0, Pos) + Pid + Path.substr(Pos + 2)).str();
+    llvm::SmallString<128> Result(Path);
+    llvm::StringRef Ext = llvm::sys::path::extension(Path);
+    llvm::sys::path::replace_extension(Result, Pid + Ext.str());
+    return Result.str();
+  }
+
+  static unsigned GetProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return (unsigned)getpid();
+#endif
+  }
+
+  static uint64_t GetThreadId() {
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#elif defined(__linux__)
+    return (uint64_t)syscall(SYS_gettid);
+#else
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+  }
+
+  FILE *m_pFile;
+  bool m_bFirst;
+  std::chrono::steady_clock::time_point m_start;
+  std::mutex m_mutex;
+};
+
+TraceWriter &GetTraceWriter() {
+  static TraceWriter Writer;
+  return Writer;
+}
+} // namespace
+
+bool hlsl::IsTraceEnabled() { return GetTraceWriter().IsEnabled(); }
+
+void hlsl::TraceBegin(const char *pName) {
+  TraceWriter &Writer = GetTraceWriter();
+  if (Writer.IsEnabled())
+    Writer.Write(pName, 'B', nullptr);
+}
+
+void hlsl::TraceEnd(const char *pName) {
+  TraceWriter &Writer = GetTraceWriter();
+  if (Writer.IsEnabled())
+    Writer.Write(pName, 'E', nullptr);
+}
+
+void hlsl::TraceEnd(const char *pName, long Status) {
+  TraceWriter &Writer = GetTraceWriter();
+  if (Writer.IsEnabled())
+    Writer.Write(pName, 'E', &Status);
+}
@@ -19,9 +19,12 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 
 #ifdef _WIN32
 #include <intsafe.h>
+#else
+#include <sys/mman.h>
 #endif
 
 #define CP_UTF16 1200
@@ -757,6 +760,126 @@ HRESULT DxcCreateBlobFromFile(LPCWSTR pFileName, UINT32 *pCodePage,
   return DxcCreateBlobFromFile(DxcGetThreadMallocNoRef(), pFileName, pCodePage, ppBlobEncoding);
 }
 
+namespace {
+// View of a whole file. Text and container blobs created over it reference
+// the view directly rather than a copy. Writable views are either shared with
+// the file or private copies of the pages written to.
+class MappedFileBlob : public IDxcBlob {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  void *m_pView = nullptr;
+  SIZE_T m_size = 0;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(MappedFileBlob)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcBlob>(this, iid, ppvObject);
+  }
+
+  ~MappedFileBlob() {
+    if (m_pView != nullptr) {
+#ifdef _WIN32
+      UnmapViewOfFile(m_pView);
+#else
+      munmap(m_pView, m_size);
+#endif
+    }
+  }
+
+  HRESULT Map(LPCWSTR pFileName, MappedFileAccess access) {
+    bool bWriteBack = access == MappedFileAccess::WriteBack;
+    DWORD desiredAccess = bWriteBack ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    HANDLE hFile = CreateFileW(pFileName, desiredAccess, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+      return HRESULT_FROM_WIN32(GetLastError());
+    CHandle h(hFile);
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(hFile, &FileSize))
+      return HRESULT_FROM_WIN32(GetLastError());
+    if (FileSize.u.HighPart != 0)
+      return DXC_E_INPUT_FILE_TOO_LARGE;
+    // Empty files cannot be mapped, and need no storage anyway.
+    if (FileSize.u.LowPart == 0)
+      return S_OK;
+
+#ifdef _WIN32
+    static const DWORD protect[] = {PAGE_READONLY, PAGE_WRITECOPY,
+                                    PAGE_READWRITE};
+    static const DWORD viewAccess[] = {FILE_MAP_READ, FILE_MAP_COPY,
+                                       FILE_MAP_WRITE};
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, protect[(int)access],
+                                         0, 0, nullptr);
+    if (hMapping == nullptr)
+      return HRESULT_FROM_WIN32(GetLastError());
+    CHandle hm(hMapping);
+    // The view keeps the mapping alive after its handle is closed.
+    m_pView = MapViewOfFile(hMapping, viewAccess[(int)access], 0, 0, 0);
+    if (m_pView == nullptr)
+      return HRESULT_FROM_WIN32(GetLastError());
+#else
+    int prot = access == MappedFileAccess::ReadOnly ? PROT_READ
+                                                    : PROT_READ | PROT_WRITE;
+    void *pView = mmap(nullptr, FileSize.u.LowPart, prot,
+                       bWriteBack ? MAP_SHARED : MAP_PRIVATE,
+                       (int)(size_t)hFile, 0);
+    if (pView == MAP_FAILED)
+      return HRESULT_FROM_WIN32(GetLastError());
+    m_pView = pView;
+#endif
+    m_size = FileSize.u.LowPart;
+    return S_OK;
+  }
+
+  LPVOID STDMETHODCALLTYPE GetBufferPointer(void) override { return m_pView; }
+  SIZE_T STDMETHODCALLTYPE GetBufferSize(void) override { return m_size; }
+};
+} // namespace
+
+_Use_decl_annotations_
+HRESULT
+DxcCreateBlobFromFileMapped(IMalloc *pMalloc, LPCWSTR pFileName,
+                            UINT32 *pCodePage,
+                            IDxcBlobEncoding **ppBlobEncoding) throw() {
+  if (pFileName == nullptr || ppBlobEncoding == nullptr) {
+    return E_POINTER;
+  }
+  *ppBlobEncoding = nullptr;
+  if (!pMalloc)
+    pMalloc = DxcGetThreadMallocNoRef();
+
+  CComPtr<MappedFileBlob> pMapped = MappedFileBlob::Alloc(pMalloc);
+  IFROOM(pMapped.p);
+  IFR(pMapped->Map(pFileName, MappedFileAccess::ReadOnly));
+
+  bool known = (pCodePage != nullptr);
+  UINT32 codePage = (pCodePage != nullptr) ? *pCodePage : 0;
+  return DxcCreateBlobEncodingFromBlob(pMapped, 0, 0, known, codePage, pMalloc,
+                                       ppBlobEncoding);
+}
+
+_Use_decl_annotations_
+HRESULT DxcCreateWritableBlobFromFileMapped(IMalloc *pMalloc, LPCWSTR pFileName,
+                                            MappedFileAccess access,
+                                            IDxcBlob **ppBlob) throw() {
+  if (pFileName == nullptr || ppBlob == nullptr) {
+    return E_POINTER;
+  }
+  *ppBlob = nullptr;
+  if (access == MappedFileAccess::ReadOnly)
+    return E_INVALIDARG;
+  if (!pMalloc)
+    pMalloc = DxcGetThreadMallocNoRef();
+
+  CComPtr<MappedFileBlob> pMapped = MappedFileBlob::Alloc(pMalloc);
+  IFROOM(pMapped.p);
+  IFR(pMapped->Map(pFileName, access));
+  *ppBlob = pMapped.Detach();
+  return S_OK;
+}
+
 _Use_decl_annotations_
 HRESULT
 DxcCreateBlobWithEncodingSet(IMalloc *pMalloc, IDxcBlob *pBlob, UINT32 codePage,
@@ -996,13 +1119,135 @@ bool IsBlobNullOrEmpty(_In_opt_ IDxcBlob *pBlob) throw() {
 ///////////////////////////////////////////////////////////////////////////////
 // Stream implementations.
 
+// Writes past the end of the buffer go to chunks chained after it rather
+// than reallocating it, so large outputs are not copied each time they grow.
+// The contents are made contiguous, in a buffer allocated once, only when a
+// pointer to them is needed: by the writer through GetPtr, or when the stream
+// is handed out as a blob. Blobs may be read from several threads, so
+// GetBufferPointer never linearizes. Streams whose final size is known up
+// front can Reserve it and never chain a chunk.
 class MemoryStream : public AbstractMemoryStream, public IDxcBlob {
 private:
+  // Chunks are allocated with a header; the data follows it.
+  struct Chunk {
+    Chunk *pNext;
+    ULONG Size;
+    ULONG Capacity;
+    LPBYTE Data() { return (LPBYTE)(this + 1); }
+  };
+  static const ULONG kMinChunkSize = 64 * 1024;
+
   DXC_MICROCOM_TM_REF_FIELDS()
   LPBYTE m_pMemory = nullptr;
   ULONG m_offset = 0;
   ULONG m_size = 0;
   ULONG m_allocSize = 0;
+  // While there are chunks, the buffer is full and every chunk but the
+  // last is full.
+  Chunk *m_pFirstChunk = nullptr;
+  Chunk *m_pLastChunk = nullptr;
+  // Serializes the linearization done when the stream is handed out.
+  std::mutex m_linearizeLock;
+
+  // Calls Fn on the contiguous pieces of [offset, offset + cb), which must
+  // be within the stream.
+  template <typename TFn> void ForEachPiece(ULONG offset, ULONG cb, TFn Fn) {
+    ULONG pieceStart = 0;
+    LPBYTE pPiece = m_pMemory;
+    ULONG pieceSize = m_pFirstChunk ? m_allocSize : m_size;
+    Chunk *pNext = m_pFirstChunk;
+    while (cb > 0) {
+      if (offset < pieceStart + pieceSize) {
+        ULONG n = std::min(cb, pieceStart + pieceSize - offset);
+        Fn(pPiece + (offset - pieceStart), n);
+        offset += n;
+        cb -= n;
+      }
+      pieceStart += pieceSize;
+      if (pNext == nullptr)
+        break;
+      pPiece = pNext->Data();
+      pieceSize = pNext->Size;
+      pNext = pNext->pNext;
+    }
+  }
+
+  void FreeChunks() {
+    for (Chunk *pChunk = m_pFirstChunk; pChunk != nullptr;) {
+      Chunk *pNext = pChunk->pNext;
+      m_pMalloc->Free(pChunk);
+      pChunk = pNext;
+    }
+    m_pFirstChunk = m_pLastChunk = nullptr;
+  }
+
+  // Copies the contents into one buffer of at least targetSize bytes.
+  HRESULT Linearize(ULONG targetSize) throw() {
+    if (m_pFirstChunk == nullptr)
+      return S_OK;
+    targetSize = std::max(targetSize, m_size);
+    LPBYTE pMemory = (LPBYTE)m_pMalloc->Alloc(targetSize);
+    if (pMemory == nullptr)
+      return E_OUTOFMEMORY;
+    LPBYTE pOut = pMemory;
+    ForEachPiece(0, m_size, [&](LPBYTE p, ULONG n) {
+      memcpy(pOut, p, n);
+      pOut += n;
+    });
+    FreeChunks();
+    m_pMalloc->Free(m_pMemory);
+    m_pMemory = pMemory;
+    m_allocSize = targetSize;
+    return S_OK;
+  }
+
+  // Appends cb bytes at the end of the stream, in new chunks as needed.
+  HRESULT Append(const BYTE *pData, ULONG cb) throw() {
+    if (m_pFirstChunk == nullptr && m_size < m_allocSize) {
+      ULONG n = std::min(cb, m_allocSize - m_size);
+      memcpy(m_pMemory + m_size, pData, n);
+      m_size += n;
+      pData += n;
+      cb -= n;
+    } else if (m_pLastChunk && m_pLastChunk->Size < m_pLastChunk->Capacity) {
+      ULONG n = std::min(cb, m_pLastChunk->Capacity - m_pLastChunk->Size);
+      memcpy(m_pLastChunk->Data() + m_pLastChunk->Size, pData, n);
+      m_pLastChunk->Size += n;
+      m_size += n;
+      pData += n;
+      cb -= n;
+    }
+    if (cb == 0)
+      return S_OK;
+    if (m_pMemory == nullptr) {
+      // The first write sizes the buffer, as a Reserve would.
+      HRESULT hr = Reserve(cb);
+      if (FAILED(hr))
+        return hr;
+      memcpy(m_pMemory, pData, cb);
+      m_size = cb;
+      return S_OK;
+    }
+    // Each chunk at least doubles the capacity, as reallocating did.
+    ULONG capacity = std::max(cb, m_size);
+    if (capacity < kMinChunkSize)
+      capacity = kMinChunkSize;
+    Chunk *pChunk = (Chunk *)m_pMalloc->Alloc(sizeof(Chunk) + capacity);
+    if (pChunk == nullptr)
+      return E_OUTOFMEMORY;
+    pChunk->pNext = nullptr;
+    pChunk->Size = cb;
+    pChunk->Capacity = capacity;
+    memcpy(pChunk->Data(), pData, cb);
+    if (m_pLastChunk)
+      m_pLastChunk->pNext = pChunk;
+    else
+      m_pFirstChunk = pChunk;
+    m_pLastChunk = pChunk;
+    m_size += cb;
+    return S_OK;
+  }
+
 public:
   DXC_MICROCOM_ADDREF_IMPL(m_dwRef)
   ULONG STDMETHODCALLTYPE Release() override {
@@ -1020,6 +1265,13 @@ public:
   DXC_MICROCOM_TM_CTOR(MemoryStream)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    if (IsEqualIID(iid, __uuidof(IDxcBlob))) {
+      // Once the stream is a blob its buffer must stay put for readers.
+      std::lock_guard<std::mutex> lock(m_linearizeLock);
+      HRESULT hr = Linearize(0);
+      if (FAILED(hr))
+        return hr;
+    }
     return DoBasicQueryInterface<IStream, ISequentialStream, IDxcBlob>(this, iid, ppvObject);
   }
 
@@ -1036,6 +1288,7 @@ public:
   }
 
   void Reset() {
+    FreeChunks();
     if (m_pMemory != nullptr) {
       m_pMalloc->Free(m_pMemory);
     }
@@ -1047,7 +1300,8 @@ public:
 
   // AbstractMemoryStream implementation.
   LPBYTE GetPtr() throw() override {
-    return m_pMemory;
+    std::lock_guard<std::mutex> lock(m_linearizeLock);
+    return SUCCEEDED(Linearize(0)) ? m_pMemory : nullptr;
   }
 
   ULONG GetPtrSize() throw() override {
@@ -1055,6 +1309,9 @@ public:
   }
 
   LPBYTE Detach() throw() override {
+    std::lock_guard<std::mutex> lock(m_linearizeLock);
+    if (FAILED(Linearize(0)))
+      return nullptr;
     LPBYTE result = m_pMemory;
     m_pMemory = nullptr;
     Reset();
@@ -1066,6 +1323,9 @@ public:
   }
 
   HRESULT Reserve(ULONG targetSize) throw() override {
+    if (m_pFirstChunk != nullptr) {
+      return Linearize(targetSize);
+    }
     if (m_pMemory == nullptr) {
       m_pMemory = (LPBYTE)m_pMalloc->Alloc(targetSize);
       if (m_pMemory == nullptr) {
@@ -1085,7 +1345,8 @@ public:
     return S_OK;
   }
 
-  // IDxcBlob implementation. Requires no further writes.
+  // IDxcBlob implementation. Requires no further writes. The stream was
+  // linearized when it was queried for IDxcBlob, so this has no side effects.
   LPVOID STDMETHODCALLTYPE GetBufferPointer(void) override {
     return m_pMemory;
   }
@@ -1103,25 +1364,44 @@ public:
     }
     ULONG cbLeft = m_size - m_offset;
     *pcbRead = std::min(cb, cbLeft);
-    memcpy(pv, m_pMemory + m_offset, *pcbRead);
+    LPBYTE pOut = (LPBYTE)pv;
+    ForEachPiece(m_offset, *pcbRead, [&](LPBYTE p, ULONG n) {
+      memcpy(pOut, p, n);
+      pOut += n;
+    });
     m_offset += *pcbRead;
     return (*pcbRead == cb) ? S_OK : S_FALSE;
   }
 
   HRESULT STDMETHODCALLTYPE Write(void const* pv, ULONG cb, ULONG* pcbWritten) override {
     if (!pv || !pcbWritten) return E_POINTER;
-    if (cb + m_offset > m_allocSize) {
-      HRESULT hr = Grow(cb + m_offset);
+    if (m_offset > m_size && m_pFirstChunk != nullptr) {
+      // Writing past the end is rare; extend contiguously as below.
+      HRESULT hr = Linearize(0);
       if (FAILED(hr)) return hr;
-      // Implicitly extend as needed with zeroes.
-      if (m_offset > m_size) {
-        memset(m_pMemory + m_size, 0, m_offset - m_size);
+    }
+    if (m_offset > m_size) {
+      if (cb + m_offset > m_allocSize) {
+        HRESULT hr = Grow(cb + m_offset);
+        if (FAILED(hr)) return hr;
       }
+      // Implicitly extend as needed with zeroes.
+      memset(m_pMemory + m_size, 0, m_offset - m_size);
+      m_size = m_offset;
+    }
+    // Overwrite what is there, then append the rest.
+    const BYTE *pIn = (const BYTE *)pv;
+    ULONG cbOverwrite = std::min(cb, m_size - m_offset);
+    ForEachPiece(m_offset, cbOverwrite, [&](LPBYTE p, ULONG n) {
+      memcpy(p, pIn, n);
+      pIn += n;
+    });
+    if (cbOverwrite < cb) {
+      HRESULT hr = Append(pIn, cb - cbOverwrite);
+      if (FAILED(hr)) return hr;
     }
     *pcbWritten = cb;
-    memcpy(m_pMemory + m_offset, pv, cb);
     m_offset += cb;
-    m_size = std::max(m_size, m_offset);
     return S_OK;
   }
 
@@ -1130,6 +1410,10 @@ public:
     if (val.u.HighPart != 0) {
       return E_OUTOFMEMORY;
     }
+    HRESULT hr = Linearize(0);
+    if (FAILED(hr)) {
+      return hr;
+    }
     if (val.u.LowPart > m_allocSize) {
       return Grow(m_allocSize);
     }
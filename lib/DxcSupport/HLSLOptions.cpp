@@ -404,6 +404,9 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     if (Args.getLastArg(OPT_exports)) {
       errors << "library profile required when using -exports option";
       return 1;
+    } else if (Args.getLastArg(OPT_exports_file)) {
+      errors << "library profile required when using -exports-file option";
+      return 1;
     } else if (Args.hasFlag(OPT_export_shaders_only, OPT_INVALID, false)) {
       errors << "library profile required when using -export-shaders-only option";
       return 1;
@@ -464,12 +467,25 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.OutputReflectionFile = Args.getLastArgValue(OPT_Fre);
   opts.OutputRootSigFile = Args.getLastArgValue(OPT_Frs);
   opts.OutputShaderHashFile = Args.getLastArgValue(OPT_Fsh);
+  opts.OutputStatisticsFile = Args.getLastArgValue(OPT_Fstats);
   opts.ShowOptionNames = Args.hasFlag(OPT_fdiagnostics_show_option, OPT_fno_diagnostics_show_option, true);
   opts.UseColor = Args.hasFlag(OPT_Cc, OPT_INVALID, false);
   opts.UseInstructionNumbers = Args.hasFlag(OPT_Ni, OPT_INVALID, false);
   opts.UseInstructionByteOffsets = Args.hasFlag(OPT_No, OPT_INVALID, false);
   opts.UseHexLiterals = Args.hasFlag(OPT_Lx, OPT_INVALID, false);
   opts.Preprocess = Args.getLastArgValue(OPT_P);
+  opts.PchFile = Args.getLastArgValue(OPT_Fp);
+  opts.PchHeader = Args.getLastArgValue(OPT_Yu);
+  opts.PchCreate = Args.hasFlag(OPT_Yc, OPT_INVALID, false);
+  opts.DependenciesOnly = Args.hasFlag(OPT_M, OPT_INVALID, false);
+  opts.OutputDependencies =
+      opts.DependenciesOnly || Args.hasFlag(OPT_MD, OPT_INVALID, false);
+  opts.DependencyFile = Args.getLastArgValue(OPT_MF);
+  opts.DependencyTarget = Args.getLastArgValue(OPT_MT);
+  opts.BatchManifest = Args.getLastArgValue(OPT_batch);
+  opts.BatchReport = Args.getLastArgValue(OPT_batch_report);
+  opts.ServerEndpoint = Args.getLastArgValue(OPT_server);
+  opts.ConnectEndpoint = Args.getLastArgValue(OPT_connect);
   opts.AstDump = Args.hasFlag(OPT_ast_dump, OPT_INVALID, false);
   opts.CodeGenHighLevel = Args.hasFlag(OPT_fcgl, OPT_INVALID, false);
   opts.DebugInfo = Args.hasFlag(OPT__SLASH_Zi, OPT_INVALID, false);
@@ -488,6 +504,45 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   llvm::StringRef limit = Args.getLastArgValue(OPT_memdep_block_scan_limit);
   if (!limit.empty())
     opts.ScanLimit = std::stoul(std::string(limit));
+  opts.ProfileUseFile = Args.getLastArgValue(OPT_profile_use);
+  opts.PadGroupShared = Args.hasFlag(OPT_pad_groupshared, OPT_INVALID, false);
+  opts.MinimizeMeshOutputs = Args.hasFlag(OPT_minimize_mesh_outputs, OPT_INVALID, false);
+  opts.ReportLoopHandles = Args.hasFlag(OPT_report_loop_handles, OPT_INVALID, false);
+  opts.FastTrig = Args.hasFlag(OPT_fast_trig, OPT_INVALID, false);
+  opts.WaveAggregateAtomics = Args.hasFlag(OPT_wave_aggregate_atomics, OPT_INVALID, false);
+  opts.HoistUniform = Args.hasFlag(OPT_hoist_uniform, OPT_INVALID, false);
+  opts.FPContract = Args.getLastArgValue(OPT_ffp_contract);
+  if (!opts.FPContract.empty() && opts.FPContract != "fast" &&
+      opts.FPContract != "on" && opts.FPContract != "off") {
+    errors << "Unsupported value '" << opts.FPContract
+           << "' for -ffp-contract; use fast, on or off.";
+    return 1;
+  }
+  llvm::StringRef maxLiveScalars = Args.getLastArgValue(OPT_max_live_scalars);
+  if (!maxLiveScalars.empty() &&
+      (maxLiveScalars.getAsInteger(10, opts.MaxLiveScalars) ||
+       opts.MaxLiveScalars == 0)) {
+    errors << "max-live-scalars takes a positive number of scalars.";
+    return 1;
+  }
+  llvm::StringRef auto16BitPrecision = Args.getLastArgValue(OPT_auto_16bit_precision);
+  if (!auto16BitPrecision.empty() &&
+      (auto16BitPrecision.getAsInteger(10, opts.Auto16BitPrecision) ||
+       opts.Auto16BitPrecision == 0 || opts.Auto16BitPrecision > 10)) {
+    errors << "auto-16bit-precision takes a number of bits from 1 to 10.";
+    return 1;
+  }
+
+  llvm::StringRef batchThreads = Args.getLastArgValue(OPT_batch_threads);
+  if (!batchThreads.empty() && batchThreads.getAsInteger(10, opts.BatchThreads)) {
+    errors << "Invalid thread count '" << batchThreads << "' for -batch-threads.";
+    return 1;
+  }
+  if (opts.BatchManifest.empty() &&
+      (!batchThreads.empty() || !opts.BatchReport.empty())) {
+    errors << "-batch-threads and -batch-report must be used with -batch.";
+    return 1;
+  }
 
   if (!opts.ForceRootSigVer.empty() && opts.ForceRootSigVer != "rootsig_1_0" &&
       opts.ForceRootSigVer != "rootsig_1_1") {
@@ -521,6 +576,8 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   }
 
   opts.Exports = Args.getAllArgValues(OPT_exports);
+  opts.ExportsFile = Args.getLastArgValue(OPT_exports_file);
+  opts.Specializations = Args.getAllArgValues(OPT_specialize);
 
   opts.DefaultLinkage = Args.getLastArgValue(OPT_default_linkage);
   if (!opts.DefaultLinkage.empty()) {
@@ -557,6 +614,10 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
       return 1;
     }
   }
+  if (opts.Auto16BitPrecision && !opts.Enable16BitTypes) {
+    errors << "auto-16bit-precision requires enable-16bit-types.";
+    return 1;
+  }
 
   opts.DisableOptimizations = false;
   if (Arg *A = Args.getLastArg(OPT_O0, OPT_O1, OPT_O2, OPT_O3, OPT_Od)) {
@@ -576,6 +637,28 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   else
     opts.OptLevel = 3;
   opts.OptDump = Args.hasFlag(OPT_Odump, OPT_INVALID, false);
+  opts.TimeReport = Args.hasFlag(OPT_ftime_report, OPT_INVALID, false);
+  opts.MemoryReport = Args.hasFlag(OPT_fmemory_report, OPT_INVALID, false);
+  llvm::StringRef memoryLimit = Args.getLastArgValue(OPT_memory_limit);
+  if (!memoryLimit.empty() && memoryLimit.getAsInteger(10, opts.MemoryLimit)) {
+    errors << "Invalid MiB '" << memoryLimit << "' for -memory-limit.";
+    return 1;
+  }
+  opts.CompileArena = Args.hasFlag(OPT_fcompile_arena, OPT_INVALID, false);
+  llvm::StringRef compileDeadline = Args.getLastArgValue(OPT_compile_deadline);
+  if (!compileDeadline.empty() &&
+      compileDeadline.getAsInteger(10, opts.CompileDeadline)) {
+    errors << "Invalid milliseconds '" << compileDeadline
+           << "' for -compile-deadline.";
+    return 1;
+  }
+  opts.CompileDeadlineFallback =
+      Args.hasFlag(OPT_compile_deadline_fallback, OPT_INVALID, false);
+  if (opts.CompileDeadlineFallback && opts.CompileDeadline == 0) {
+    errors << "-compile-deadline-fallback requires -compile-deadline.";
+    return 1;
+  }
+  opts.ParallelVerify = Args.hasFlag(OPT_parallel_verify, OPT_INVALID, false);
 
   opts.DisableValidation = Args.hasFlag(OPT_VD, OPT_INVALID, false);
 
@@ -591,6 +674,8 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.PackPrefixStable = Args.hasFlag(OPT_pack_prefix_stable_, OPT_INVALID, opts.PackPrefixStable);
   opts.PackOptimized = Args.hasFlag(OPT_pack_optimized, OPT_INVALID, false);
   opts.PackOptimized = Args.hasFlag(OPT_pack_optimized_, OPT_INVALID, opts.PackOptimized);
+  opts.PackOptimal = Args.hasFlag(OPT_pack_optimal, OPT_INVALID, false);
+  opts.PackOptimal = Args.hasFlag(OPT_pack_optimal_, OPT_INVALID, opts.PackOptimal);
   opts.DisplayIncludeProcess = Args.hasFlag(OPT_H, OPT_INVALID, false);
   opts.WarningAsError = Args.hasFlag(OPT__SLASH_WX, OPT_INVALID, false);
   opts.AvoidFlowControl = Args.hasFlag(OPT_Gfa, OPT_INVALID, false);
@@ -600,6 +685,10 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.EmbedDebug = Args.hasFlag(OPT_Qembed_debug, OPT_INVALID, false);
   opts.StripRootSignature = Args.hasFlag(OPT_Qstrip_rootsignature, OPT_INVALID, false);
   opts.StripPrivate = Args.hasFlag(OPT_Qstrip_priv, OPT_INVALID, false);
+  opts.FastShaderHash = Args.hasFlag(OPT_Qfast_hash, OPT_INVALID, false);
+  opts.LineTable = Args.hasFlag(OPT_Qline_table, OPT_INVALID, false);
+  opts.CompressDebug = Args.hasFlag(OPT_Qcompress_debug, OPT_INVALID, false);
+  opts.SourceStore = Args.getLastArgValue(OPT_Qsource_store);
   opts.StripReflection = Args.hasFlag(OPT_Qstrip_reflect, OPT_INVALID, false);
   opts.KeepReflectionInDxil = Args.hasFlag(OPT_Qkeep_reflect_in_dxil, OPT_INVALID, false);
   opts.StripReflectionFromDxil = Args.hasFlag(OPT_Qstrip_reflect_from_dxil, OPT_INVALID, false);
@@ -626,6 +715,10 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     errors << "Cannot specify /pack_prefix_stable and /pack_optimized together, use /? to get usage information";
     return 1;
   }
+  if (opts.PackOptimal && (opts.PackPrefixStable || opts.PackOptimized)) {
+    errors << "Cannot specify /pack_optimal with /pack_prefix_stable or /pack_optimized, use /? to get usage information";
+    return 1;
+  }
   // TODO: more fxc option check.
   // ERR_RES_MAY_ALIAS_ONLY_IN_CS_5
   // ERR_NOT_ABLE_TO_FLATTEN on if that contain side effects
@@ -636,7 +729,32 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // ERR_TEMPLATE_VAR_CONFLICT
   // ERR_ATTRIBUTE_PARAM_SIDE_EFFECT
 
-  if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty()) {
+  // Each line of a batch manifest carries its own input and options.
+  if ((flagsToInclude & hlsl::options::DriverOption) &&
+      !opts.BatchManifest.empty() &&
+      (!opts.InputFile.empty() || !opts.TargetProfile.empty())) {
+    errors << "Cannot specify an input file or target profile with -batch; "
+              "give them on each line of the manifest.";
+    return 1;
+  }
+  // A server takes its inputs and options from the requests it receives.
+  if ((flagsToInclude & hlsl::options::DriverOption) &&
+      !opts.ServerEndpoint.empty() &&
+      (!opts.InputFile.empty() || !opts.TargetProfile.empty() ||
+       !opts.BatchManifest.empty() || !opts.ConnectEndpoint.empty())) {
+    errors << "Cannot specify an input file, target profile, -batch or "
+              "-connect with -server.";
+    return 1;
+  }
+  if (!opts.ConnectEndpoint.empty() &&
+      (!opts.BatchManifest.empty() || !opts.Preprocess.empty() ||
+       opts.DumpBin || opts.RecompileFromBinary)) {
+    errors << "Only compiles can be sent to a server with -connect.";
+    return 1;
+  }
+
+  if ((flagsToInclude & hlsl::options::DriverOption) && opts.InputFile.empty() &&
+      opts.BatchManifest.empty() && opts.ServerEndpoint.empty()) {
     // Input file is required in arguments only for drivers; APIs take this through an argument.
     errors << "Required input file argument is missing. use -help to get more information.";
     return 1;
@@ -646,12 +764,47 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     return 1;
   }
 
+  if (opts.PchCreate && !opts.PchHeader.empty()) {
+    errors << "Cannot specify both -Yc and -Yu.";
+    return 1;
+  }
+  if (!opts.PchHeader.empty() && opts.PchFile.empty()) {
+    errors << "-Yu requires a precompiled header file given by -Fp.";
+    return 1;
+  }
+  // A precompiled header is the preprocessed header, so -Yc preprocesses to
+  // the -Fp file.
+  if (opts.PchCreate && opts.Preprocess.empty()) {
+    if (opts.PchFile.empty()) {
+      errors << "-Yc requires a precompiled header file given by -Fp.";
+      return 1;
+    }
+    opts.Preprocess = opts.PchFile;
+  }
+
+  if (opts.OutputDependencies &&
+      (!opts.Preprocess.empty() || opts.DumpBin || opts.RecompileFromBinary ||
+       opts.AstDump || opts.OptDump)) {
+    errors << "Cannot output dependencies with -P, -dumpbin, -recompile, "
+              "-ast-dump or -Odump.";
+    return 1;
+  }
+  // Without -M the rule goes alongside the compile outputs, so it needs a
+  // file of its own.
+  if ((flagsToInclude & hlsl::options::DriverOption) &&
+      opts.OutputDependencies && !opts.DependenciesOnly &&
+      opts.DependencyFile.empty()) {
+    errors << "-MD requires a dependency file given by -MF.";
+    return 1;
+  }
+
   if (!opts.Preprocess.empty() &&
       (!opts.OutputHeader.empty() || !opts.OutputObject.empty() ||
        !opts.OutputWarnings || !opts.OutputWarningsFile.empty() ||
        !opts.OutputReflectionFile.empty() ||
        !opts.OutputRootSigFile.empty() ||
-       !opts.OutputShaderHashFile.empty())) {
+       !opts.OutputShaderHashFile.empty() ||
+       !opts.OutputStatisticsFile.empty())) {
     opts.OutputHeader = "";
     opts.OutputObject = "";
     opts.OutputWarnings = true;
@@ -659,6 +812,7 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     opts.OutputReflectionFile = "";
     opts.OutputRootSigFile = "";
     opts.OutputShaderHashFile = "";
+    opts.OutputStatisticsFile = "";
     errors << "Warning: compiler options ignored with Preprocess.";
   }
 
@@ -681,8 +835,9 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // XXX TODO: Sort this out, since it's required for new API, but a separate argument for old APIs.
   if ((flagsToInclude & hlsl::options::DriverOption) &&
       !(flagsToInclude & hlsl::options::RewriteOption) &&
-      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary
-      ) {
+      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary &&
+      !opts.DependenciesOnly &&
+      opts.BatchManifest.empty() && opts.ServerEndpoint.empty()) {
     // Target profile is required in arguments only for drivers when compiling;
     // APIs take this through an argument.
     errors << "Target profile argument is missing";
@@ -788,6 +943,7 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
 
   opts.SpirvOptions.debugInfoFile = opts.SpirvOptions.debugInfoSource = false;
   opts.SpirvOptions.debugInfoLine = opts.SpirvOptions.debugInfoTool = false;
+  opts.SpirvOptions.debugInfoCompact = false;
   if (Args.hasArg(OPT_fspv_debug_EQ)) {
     opts.DebugInfo = true;
     for (const Arg *A : Args.filtered(OPT_fspv_debug_EQ)) {
@@ -803,6 +959,10 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
         opts.SpirvOptions.debugInfoLine = true;
       } else if (v == "tool") {
         opts.SpirvOptions.debugInfoTool = true;
+      } else if (v == "compact") {
+        opts.SpirvOptions.debugInfoFile = true;
+        opts.SpirvOptions.debugInfoLine = true;
+        opts.SpirvOptions.debugInfoCompact = true;
       } else {
         errors << "unknown SPIR-V debug info control parameter: " << v;
         return 1;
@@ -19,6 +19,23 @@
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/WinIncludes.h"
 
+// Returns true if every character is below 0x80, in which case UTF-8 and
+// UTF-16 conversions are a plain widening or narrowing copy.
+template <typename TChar>
+static bool IsASCII(const TChar *p, size_t count) {
+  // Accumulate without an early exit so the loop can be vectorized.
+  uint32_t bits = 0;
+  for (size_t i = 0; i < count; ++i)
+    bits |= (uint32_t)p[i];
+  return (bits & ~0x7Fu) == 0;
+}
+
+template <typename TFrom, typename TTo>
+static void CopyASCII(const TFrom *pFrom, size_t count, TTo *pTo) {
+  for (size_t i = 0; i < count; ++i)
+    pTo[i] = (TTo)pFrom[i];
+}
+
 #ifndef _WIN32
 // MultiByteToWideChar which is a Windows-specific method.
 // This is a very simplistic implementation for non-Windows platforms. This
@@ -50,6 +67,17 @@ int MultiByteToWideChar(uint32_t CodePage, uint32_t /*dwFlags*/,
     return 0;
   }
 
+  // ASCII converts the same in every supported code page, so skip the
+  // locale switch and temporary copy.
+  if (IsASCII(lpMultiByteStr, cbMultiByte)) {
+    if (lpWideCharStr) {
+      CopyASCII(lpMultiByteStr, cbMultiByte, lpWideCharStr);
+      if (cchWideChar > cbMultiByte)
+        lpWideCharStr[cbMultiByte] = L'\0';
+    }
+    return cbMultiByte;
+  }
+
   size_t rv;
   const char *locale = CPToLocale(CodePage);
   locale = setlocale(LC_ALL, locale);
@@ -99,6 +127,15 @@ int WideCharToMultiByte(uint32_t CodePage, uint32_t /*dwFlags*/,
     return 0;
   }
 
+  if (IsASCII(lpWideCharStr, cchWideChar)) {
+    if (lpMultiByteStr) {
+      CopyASCII(lpWideCharStr, cchWideChar, lpMultiByteStr);
+      if (cbMultiByte > cchWideChar)
+        lpMultiByteStr[cchWideChar] = '\0';
+    }
+    return cchWideChar;
+  }
+
   size_t rv;
   const char *locale = CPToLocale(CodePage);
   locale = setlocale(LC_ALL, locale);
@@ -132,6 +169,13 @@ bool UTF16ToEncodedString(_In_z_ const wchar_t* text, size_t cUTF16, DWORD cp, D
     return true;
   }
 
+  // ASCII is unchanged in UTF-8; convert in one pass instead of two.
+  if (cp == CP_UTF8 && IsASCII(text, cUTF16)) {
+    pValue->resize(cUTF16);
+    CopyASCII(text, cUTF16, &(*pValue)[0]);
+    return true;
+  }
+
   int cbUTF8 = ::WideCharToMultiByte(cp, flags, text, cUTF16, nullptr, 0, nullptr, pUsedDefaultChar);
   if (cbUTF8 == 0)
     return false;
@@ -163,6 +207,12 @@ bool UTF8ToUTF16String(const char *pUTF8, size_t cbUTF8, std::wstring *pUTF16) {
     return true;
   }
 
+  if (IsASCII(pUTF8, cbUTF8)) {
+    pUTF16->resize(cbUTF8);
+    CopyASCII(pUTF8, cbUTF8, &(*pUTF16)[0]);
+    return true;
+  }
+
   int cUTF16 = ::MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pUTF8,
                                      cbUTF8, nullptr, 0);
   if (cUTF16 == 0)
@@ -268,6 +318,18 @@ bool UTF8BufferToUTF16Buffer(const char *pUTF8, int cbUTF8, wchar_t **ppUTF16, s
     return true;
   }
 
+  size_t cbASCII = cbUTF8 == -1 ? strlen(pUTF8) : (size_t)cbUTF8;
+  if (IsASCII(pUTF8, cbASCII)) {
+    wchar_t *p = new (std::nothrow) wchar_t[cbASCII + 1];
+    if (p == nullptr)
+      return false;
+    CopyASCII(pUTF8, cbASCII, p);
+    p[cbASCII] = L'\0';
+    *ppUTF16 = p;
+    *pcUTF16 = cbASCII + 1;
+    return true;
+  }
+
   int c = ::MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pUTF8, cbUTF8, nullptr, 0);
   if (c == 0)
     return false;
@@ -308,6 +370,18 @@ bool UTF16BufferToUTF8Buffer(const wchar_t *pUTF16, int cUTF16, char **ppUTF8, s
     return true;
   }
 
+  size_t cASCII = cUTF16 == -1 ? wcslen(pUTF16) : (size_t)cUTF16;
+  if (IsASCII(pUTF16, cASCII)) {
+    char *p = new (std::nothrow) char[cASCII + 1];
+    if (p == nullptr)
+      return false;
+    CopyASCII(pUTF16, cASCII, p);
+    p[cASCII] = '\0';
+    *ppUTF8 = p;
+    *pcUTF8 = cASCII + 1;
+    return true;
+  }
+
   int c1 = ::WideCharToMultiByte(CP_UTF8, // code page
                                  0,       // flags
                                  pUTF16,  // string to convert
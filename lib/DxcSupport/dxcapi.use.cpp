@@ -70,6 +70,14 @@ void EnsureEnabled(DxcDllSupport &dxcSupport) {
   }
 }
 
+void SetDllMaxThreadCount(DxcDllSupport &dxcSupport, unsigned MaxThreadCount) {
+  CComPtr<IDxcUtils> pUtils;
+  CComPtr<IDxcTaskScheduling> pScheduling;
+  if (SUCCEEDED(dxcSupport.CreateInstance(CLSID_DxcUtils, &pUtils)) &&
+      SUCCEEDED(pUtils.QueryInterface(&pScheduling)))
+    pScheduling->SetMaxThreadCount(MaxThreadCount);
+}
+
 void ReadFileIntoBlob(DxcDllSupport &dxcSupport, _In_ LPCWSTR pFileName,
                       _COM_Outptr_ IDxcBlobEncoding **ppBlobEncoding) {
   CComPtr<IDxcLibrary> library;
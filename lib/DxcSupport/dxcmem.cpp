@@ -16,8 +16,11 @@
 
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/WinFunctions.h"
+#include "dxc/Support/microcom.h"
 #include "llvm/Support/ThreadLocal.h"
+#include <algorithm>
 #include <memory>
+#include <mutex>
 
 static llvm::sys::ThreadLocal<IMalloc> *g_ThreadMallocTls;
 static IMalloc *g_pDefaultMalloc;
@@ -88,3 +91,191 @@ DxcThreadMalloc::DxcThreadMalloc(IMalloc *pMallocOrNull) throw() {
 DxcThreadMalloc::~DxcThreadMalloc() {
     DxcSwapThreadMalloc(pPrior, nullptr);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// Arena allocator.
+
+namespace {
+// The arena is installed as the thread malloc of every worker a parallel
+// phase starts, so all of its state is guarded by one lock.
+class DxcArenaMalloc : public IMalloc {
+private:
+  // Blocks are chained newest first; allocations are carved from the newest.
+  struct Block {
+    Block *pNext;
+    char *pEnd;
+    // Allocations from this block that have not been freed yet.
+    SIZE_T LiveCount;
+  };
+  // Every allocation is preceded by its size, which keeps Realloc and
+  // GetSize cheap and the returned pointers 16-byte aligned.
+  struct alignas(16) Header {
+    SIZE_T Size;
+  };
+  static const SIZE_T kMinBlockSize = 64 * 1024;
+  static const SIZE_T kMaxBlockSize = 4 * 1024 * 1024;
+  // Larger requests go straight to the backing allocator, so a few big
+  // buffers don't leave most of a block unused.
+  static const SIZE_T kMaxArenaAllocation = 256 * 1024;
+
+  DXC_MICROCOM_TM_REF_FIELDS()
+  Block *m_pBlocks = nullptr;
+  char *m_pNext = nullptr;
+  char *m_pEnd = nullptr;
+  SIZE_T m_nextBlockSize = kMinBlockSize;
+  std::mutex m_lock;
+
+  static SIZE_T RoundUp(SIZE_T cb) {
+    return (cb + sizeof(Header) - 1) & ~(sizeof(Header) - 1);
+  }
+  static char *BlockBegin(Block *pBlock) {
+    return (char *)pBlock + RoundUp(sizeof(Block));
+  }
+  static Header *HeaderOf(void *pv) { return (Header *)pv - 1; }
+
+  Block *FindBlock(const void *pv) const {
+    for (Block *pBlock = m_pBlocks; pBlock; pBlock = pBlock->pNext) {
+      if (pv > BlockBegin(pBlock) && pv < pBlock->pEnd)
+        return pBlock;
+    }
+    return nullptr;
+  }
+
+  bool NewBlock(SIZE_T cb) {
+    SIZE_T blockSize = m_nextBlockSize;
+    while (blockSize < RoundUp(sizeof(Block)) + cb)
+      blockSize *= 2;
+    Block *pBlock = (Block *)m_pMalloc->Alloc(blockSize);
+    if (!pBlock)
+      return false;
+    pBlock->pNext = m_pBlocks;
+    pBlock->pEnd = (char *)pBlock + blockSize;
+    pBlock->LiveCount = 0;
+    m_pBlocks = pBlock;
+    m_pNext = BlockBegin(pBlock);
+    m_pEnd = pBlock->pEnd;
+    if (m_nextBlockSize < kMaxBlockSize)
+      m_nextBlockSize *= 2;
+    return true;
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_ALLOC(DxcArenaMalloc)
+  DxcArenaMalloc(IMalloc *pMalloc) : m_dwRef(0), m_pMalloc(pMalloc) {}
+  ~DxcArenaMalloc() {
+    // A block with allocations left is still pointed into by something that
+    // outlived the compile, so only that block is kept.
+    while (m_pBlocks) {
+      Block *pNext = m_pBlocks->pNext;
+      if (m_pBlocks->LiveCount == 0)
+        m_pMalloc->Free(m_pBlocks);
+      m_pBlocks = pNext;
+    }
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+
+  void *STDMETHODCALLTYPE Alloc(_In_ SIZE_T cb) override {
+    if (cb > kMaxArenaAllocation)
+      return m_pMalloc->Alloc(cb);
+    std::lock_guard<std::mutex> lock(m_lock);
+    return AllocLocked(cb);
+  }
+
+  void *AllocLocked(SIZE_T cb) {
+    SIZE_T needed = sizeof(Header) + RoundUp(cb);
+    if ((SIZE_T)(m_pEnd - m_pNext) < needed && !NewBlock(needed))
+      return nullptr;
+    Header *pHeader = (Header *)m_pNext;
+    pHeader->Size = cb;
+    m_pNext += needed;
+    ++m_pBlocks->LiveCount;
+    return pHeader + 1;
+  }
+
+  void *STDMETHODCALLTYPE Realloc(_In_opt_ void *pv, _In_ SIZE_T cb) override {
+    if (!pv)
+      return Alloc(cb);
+    std::unique_lock<std::mutex> lock(m_lock);
+    Block *pBlock = FindBlock(pv);
+    if (!pBlock) {
+      lock.unlock();
+      return m_pMalloc->Realloc(pv, cb);
+    }
+    Header *pHeader = HeaderOf(pv);
+    // The newest allocation can grow or shrink in place.
+    char *pOldEnd = (char *)pv + RoundUp(pHeader->Size);
+    if (pOldEnd == m_pNext && cb <= kMaxArenaAllocation &&
+        (SIZE_T)(m_pEnd - (char *)pv) >= RoundUp(cb)) {
+      pHeader->Size = cb;
+      m_pNext = (char *)pv + RoundUp(cb);
+      return pv;
+    }
+    void *pNew = cb > kMaxArenaAllocation ? m_pMalloc->Alloc(cb)
+                                          : AllocLocked(cb);
+    if (!pNew)
+      return nullptr;
+    memcpy(pNew, pv, std::min(cb, pHeader->Size));
+    FreeLocked(pBlock, pv);
+    return pNew;
+  }
+
+  void STDMETHODCALLTYPE Free(_In_opt_ void *pv) override {
+    if (!pv)
+      return;
+    std::unique_lock<std::mutex> lock(m_lock);
+    Block *pBlock = FindBlock(pv);
+    if (!pBlock) {
+      // Large allocations, and anything allocated before the arena was
+      // installed, belong to the backing allocator.
+      lock.unlock();
+      m_pMalloc->Free(pv);
+      return;
+    }
+    FreeLocked(pBlock, pv);
+  }
+
+  void FreeLocked(Block *pBlock, void *pv) {
+    // Give the space back only when it is the newest allocation, which is
+    // common for short-lived temporaries.
+    Header *pHeader = HeaderOf(pv);
+    if ((char *)pv + RoundUp(pHeader->Size) == m_pNext)
+      m_pNext = (char *)pHeader;
+    --pBlock->LiveCount;
+  }
+
+#ifdef _WIN32
+  SIZE_T STDMETHODCALLTYPE GetSize(_In_opt_ void *pv) override {
+    if (!pv)
+      return 0;
+    std::unique_lock<std::mutex> lock(m_lock);
+    if (FindBlock(pv))
+      return HeaderOf(pv)->Size;
+    lock.unlock();
+    return m_pMalloc->GetSize(pv);
+  }
+  int STDMETHODCALLTYPE DidAlloc(_In_opt_ void *pv) override {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (FindBlock(pv))
+        return 1;
+    }
+    return m_pMalloc->DidAlloc(pv);
+  }
+  void STDMETHODCALLTYPE HeapMinimize(void) override {}
+#endif
+};
+} // namespace
+
+HRESULT DxcCreateArenaMalloc(IMalloc *pBacking, IMalloc **ppArena) throw() {
+  if (pBacking == nullptr || ppArena == nullptr)
+    return E_INVALIDARG;
+  CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pBacking);
+  if (pArena == nullptr)
+    return E_OUTOFMEMORY;
+  *ppArena = pArena.Detach();
+  return S_OK;
+}
@@ -10,7 +10,11 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
 #include <algorithm>
+#include <string.h>
 
 namespace hlsl {
 
@@ -88,6 +92,221 @@ bool IsValidDxilContainer(const DxilContainerHeader *pHeader, size_t length) {
   return true;
 }
 
+bool IsContiguousDxilContainer(const DxilContainerHeader *pHeader) {
+  uint64_t offset =
+      sizeof(DxilContainerHeader) + GetOffsetTableSize(pHeader->PartCount);
+  const uint32_t *pPartOffsets =
+      reinterpret_cast<const uint32_t *>(pHeader + 1);
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    if (pPartOffsets[i] != offset)
+      return false;
+    offset += sizeof(DxilPartHeader) + GetDxilContainerPart(pHeader, i)->PartSize;
+  }
+  return offset == pHeader->ContainerSizeInBytes;
+}
+
+bool RebuildDxilContainer(const DxilContainerHeader *pHeader,
+                          uint32_t replaceIndex, uint32_t fourCC,
+                          const void *pData, uint32_t dataSize,
+                          std::string &result) {
+  const DxilPartHeader *pReplaced = GetDxilContainerPart(pHeader, replaceIndex);
+  uint64_t size = (uint64_t)pHeader->ContainerSizeInBytes -
+                  pReplaced->PartSize + dataSize;
+  if (size > DxilContainerMaxSize)
+    return false;
+
+  result.clear();
+  result.reserve((size_t)size);
+  DxilContainerHeader header = *pHeader;
+  header.ContainerSizeInBytes = (uint32_t)size;
+  result.append((const char *)&header, sizeof(header));
+
+  uint32_t offset = (uint32_t)(sizeof(DxilContainerHeader) +
+                               GetOffsetTableSize(pHeader->PartCount));
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    result.append((const char *)&offset, sizeof(offset));
+    const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, i);
+    offset += sizeof(DxilPartHeader) +
+              (i == replaceIndex ? dataSize : pPart->PartSize);
+  }
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, i);
+    if (i == replaceIndex) {
+      DxilPartHeader partHeader = { fourCC, dataSize };
+      result.append((const char *)&partHeader, sizeof(partHeader));
+      result.append((const char *)pData, dataSize);
+    } else {
+      result.append((const char *)pPart,
+                    sizeof(DxilPartHeader) + pPart->PartSize);
+    }
+  }
+  return true;
+}
+
+bool SetDxilContainerPartInPlace(DxilContainerHeader *pHeader,
+                                 uint32_t capacity, uint32_t fourCC,
+                                 const void *pData, uint32_t dataSize,
+                                 uint32_t &newSize) {
+  char *pBase = (char *)pHeader;
+  uint32_t *pPartOffsets = reinterpret_cast<uint32_t *>(pHeader + 1);
+  uint32_t oldSize = pHeader->ContainerSizeInBytes;
+  uint32_t index = 0;
+  while (index < pHeader->PartCount &&
+         GetDxilContainerPart(pHeader, index)->PartFourCC != fourCC)
+    ++index;
+
+  uint64_t size;
+  if (index < pHeader->PartCount)
+    size = (uint64_t)oldSize - GetDxilContainerPart(pHeader, index)->PartSize +
+           dataSize;
+  else
+    size = (uint64_t)oldSize + sizeof(uint32_t) + sizeof(DxilPartHeader) +
+           dataSize;
+  newSize = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+  if (size > capacity || size > DxilContainerMaxSize)
+    return false;
+
+  if (index < pHeader->PartCount) {
+    DxilPartHeader *pPart = GetDxilContainerPart(pHeader, index);
+    char *pPartData = GetDxilPartData(pPart);
+    char *pTail = pPartData + pPart->PartSize;
+    memmove(pPartData + dataSize, pTail, pBase + oldSize - pTail);
+    for (uint32_t i = index + 1; i < pHeader->PartCount; ++i)
+      pPartOffsets[i] = pPartOffsets[i] - pPart->PartSize + dataSize;
+    pPart->PartSize = dataSize;
+    memcpy(pPartData, pData, dataSize);
+  } else {
+    char *pParts = (char *)(pPartOffsets + pHeader->PartCount);
+    memmove(pParts + sizeof(uint32_t), pParts, pBase + oldSize - pParts);
+    for (uint32_t i = 0; i < pHeader->PartCount; ++i)
+      pPartOffsets[i] += sizeof(uint32_t);
+    uint32_t partOffset = oldSize + sizeof(uint32_t);
+    pPartOffsets[pHeader->PartCount++] = partOffset;
+    DxilPartHeader partHeader = { fourCC, dataSize };
+    memcpy(pBase + partOffset, &partHeader, sizeof(partHeader));
+    memcpy(pBase + partOffset + sizeof(partHeader), pData, dataSize);
+  }
+  pHeader->ContainerSizeInBytes = (uint32_t)size;
+  memset(&pHeader->Hash, 0, sizeof(pHeader->Hash));
+  return true;
+}
+
+const DxilShaderArchiveHeader *IsValidDxilShaderArchive(const void *ptr,
+                                                        size_t length) {
+  if (ptr == nullptr || length < sizeof(DxilShaderArchiveHeader))
+    return nullptr;
+  const DxilShaderArchiveHeader *pHeader =
+      reinterpret_cast<const DxilShaderArchiveHeader *>(ptr);
+  if (pHeader->HeaderFourCC != DFCC_ShaderArchive) return nullptr;
+  if (pHeader->Version.Major != DxilContainerVersionMajor) return nullptr;
+  if (pHeader->ArchiveSizeInBytes > length) return nullptr;
+
+  auto fits = [&](uint32_t offset, uint64_t size) {
+    return offset >= sizeof(DxilShaderArchiveHeader) &&
+           (uint64_t)offset + size <= pHeader->ArchiveSizeInBytes;
+  };
+  if (!fits(pHeader->EntriesOffset,
+            sizeof(DxilShaderArchiveEntry) * (uint64_t)pHeader->EntryCount) ||
+      !fits(pHeader->NameIndexOffset,
+            sizeof(DxilShaderArchiveName) * (uint64_t)pHeader->NameIndexCount) ||
+      !fits(pHeader->StringPoolOffset, pHeader->StringPoolSize) ||
+      !fits(pHeader->RootSignaturesOffset,
+            sizeof(uint32_t) * (uint64_t)pHeader->RootSignatureCount))
+    return nullptr;
+  // The string pool ends with a null terminator, so names cannot overrun it.
+  const char *pStrings =
+      reinterpret_cast<const char *>(ptr) + pHeader->StringPoolOffset;
+  if (pHeader->StringPoolSize && pStrings[pHeader->StringPoolSize - 1] != '\0')
+    return nullptr;
+
+  const DxilShaderArchiveEntry *pEntries =
+      reinterpret_cast<const DxilShaderArchiveEntry *>(
+          reinterpret_cast<const uint8_t *>(ptr) + pHeader->EntriesOffset);
+  for (uint32_t i = 0; i < pHeader->EntryCount; ++i) {
+    if (!fits(pEntries[i].ContainerOffset, pEntries[i].ContainerSize))
+      return nullptr;
+    if (pEntries[i].NameOffset != UINT32_MAX &&
+        pEntries[i].NameOffset >= pHeader->StringPoolSize)
+      return nullptr;
+  }
+  const DxilShaderArchiveName *pNames =
+      reinterpret_cast<const DxilShaderArchiveName *>(
+          reinterpret_cast<const uint8_t *>(ptr) + pHeader->NameIndexOffset);
+  for (uint32_t i = 0; i < pHeader->NameIndexCount; ++i) {
+    if (pNames[i].EntryIndex >= pHeader->EntryCount)
+      return nullptr;
+  }
+  const uint32_t *pRSOffsets = reinterpret_cast<const uint32_t *>(
+      reinterpret_cast<const uint8_t *>(ptr) + pHeader->RootSignaturesOffset);
+  for (uint32_t i = 0; i < pHeader->RootSignatureCount; ++i) {
+    if (!fits(pRSOffsets[i], sizeof(DxilPackageRootSignatureHeader)))
+      return nullptr;
+    const DxilPackageRootSignatureHeader *pRS =
+        reinterpret_cast<const DxilPackageRootSignatureHeader *>(
+            reinterpret_cast<const uint8_t *>(ptr) + pRSOffsets[i]);
+    if (!fits(pRSOffsets[i], sizeof(DxilPackageRootSignatureHeader) + (uint64_t)pRS->Size))
+      return nullptr;
+  }
+
+  return pHeader;
+}
+
+uint64_t ComputeShaderArchiveNameHash(const char *pName, size_t length) {
+  // 64-bit FNV-1a; the value is stored in archives, so it must not change.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= (uint8_t)pName[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+const DxilContainerPackageHeader *IsValidDxilContainerPackage(const void *ptr,
+                                                              size_t length) {
+  if (ptr == nullptr || length < sizeof(DxilContainerPackageHeader))
+    return nullptr;
+  const DxilContainerPackageHeader *pHeader =
+      reinterpret_cast<const DxilContainerPackageHeader *>(ptr);
+  if (pHeader->HeaderFourCC != DFCC_ContainerPackage) return nullptr;
+  if (pHeader->Version.Major != DxilContainerVersionMajor) return nullptr;
+  if (pHeader->PackageSizeInBytes > length) return nullptr;
+
+  // Make sure that the offset tables fit.
+  uint64_t tableBytes = sizeof(uint32_t) * ((uint64_t)pHeader->RootSignatureCount +
+                                            pHeader->ContainerCount);
+  if (tableBytes + sizeof(DxilContainerPackageHeader) >
+      pHeader->PackageSizeInBytes)
+    return nullptr;
+
+  const uint8_t *pLinearPackage = reinterpret_cast<const uint8_t *>(ptr);
+  for (uint32_t i = 0; i < pHeader->RootSignatureCount; ++i) {
+    const uint32_t offset =
+        reinterpret_cast<const uint32_t *>(pHeader + 1)[i];
+    if (offset > pHeader->PackageSizeInBytes -
+                     sizeof(DxilPackageRootSignatureHeader))
+      return nullptr;
+    const DxilPackageRootSignatureHeader *pRS =
+        reinterpret_cast<const DxilPackageRootSignatureHeader *>(
+            pLinearPackage + offset);
+    if ((uint64_t)offset + sizeof(DxilPackageRootSignatureHeader) + pRS->Size >
+        pHeader->PackageSizeInBytes)
+      return nullptr;
+  }
+  for (uint32_t i = 0; i < pHeader->ContainerCount; ++i) {
+    const uint32_t offset = reinterpret_cast<const uint32_t *>(pHeader + 1)
+        [pHeader->RootSignatureCount + i];
+    if (offset > pHeader->PackageSizeInBytes - sizeof(DxilContainerHeader))
+      return nullptr;
+    if (!IsValidDxilContainer(
+            reinterpret_cast<const DxilContainerHeader *>(pLinearPackage +
+                                                          offset),
+            pHeader->PackageSizeInBytes - offset))
+      return nullptr;
+  }
+
+  return pHeader;
+}
+
 const DxilPartHeader *GetDxilPartByType(const DxilContainerHeader *pHeader, DxilFourCC fourCC) {
   if (!IsDxilContainerLike(pHeader, pHeader->ContainerSizeInBytes)) {
     return nullptr;
@@ -127,4 +346,139 @@ DxilProgramHeader *GetDxilProgramHeader(DxilContainerHeader *pHeader, DxilFourCC
       GetDxilProgramHeader(static_cast<const DxilContainerHeader *>(pHeader), fourCC));
 }
 
+bool CompressDxilDebugPartData(const void *pData, uint32_t size,
+                               std::vector<char> &partData) {
+  if (!llvm::zlib::isAvailable())
+    return false;
+  // Debug info is written on every /Zi compile, so favor speed over size.
+  llvm::SmallVector<char, 0> compressed;
+  if (llvm::zlib::compress(
+          llvm::StringRef(static_cast<const char *>(pData), size), compressed,
+          llvm::zlib::BestSpeedCompression) != llvm::zlib::StatusOK)
+    return false;
+  uint32_t paddedSize = (uint32_t)((compressed.size() + 3) & ~(size_t)3);
+  if (sizeof(DxilCompressedPartHeader) + paddedSize >= size)
+    return false;
+
+  DxilCompressedPartHeader header;
+  header.CompressionType = (uint32_t)DxilCompressionType::Zlib;
+  header.UncompressedSize = size;
+  header.CompressedSize = (uint32_t)compressed.size();
+  partData.assign(sizeof(header) + paddedSize, 0);
+  memcpy(partData.data(), &header, sizeof(header));
+  memcpy(partData.data() + sizeof(header), compressed.data(),
+         compressed.size());
+  return true;
+}
+
+const DxilProgramHeader *
+GetDxilDebugProgramHeader(const DxilContainerHeader *pHeader,
+                          std::vector<char> &storage) {
+  if (const DxilProgramHeader *pProgramHeader =
+          GetDxilProgramHeader(pHeader, DFCC_ShaderDebugInfoDXIL))
+    return pProgramHeader;
+  const DxilPartHeader *pPart =
+      GetDxilPartByType(pHeader, DFCC_CompressedShaderDebugInfoDXIL);
+  if (!pPart || pPart->PartSize < sizeof(DxilCompressedPartHeader))
+    return nullptr;
+  const DxilCompressedPartHeader *pCompressed =
+      reinterpret_cast<const DxilCompressedPartHeader *>(GetDxilPartData(pPart));
+  if (pCompressed->CompressionType != (uint32_t)DxilCompressionType::Zlib ||
+      pCompressed->CompressedSize >
+          pPart->PartSize - sizeof(DxilCompressedPartHeader) ||
+      pCompressed->UncompressedSize < sizeof(DxilProgramHeader))
+    return nullptr;
+
+  llvm::SmallVector<char, 0> uncompressed;
+  if (llvm::zlib::uncompress(
+          llvm::StringRef(reinterpret_cast<const char *>(pCompressed + 1),
+                          pCompressed->CompressedSize),
+          uncompressed, pCompressed->UncompressedSize) != llvm::zlib::StatusOK ||
+      uncompressed.size() != pCompressed->UncompressedSize)
+    return nullptr;
+  storage.assign(uncompressed.begin(), uncompressed.end());
+  const DxilProgramHeader *pProgramHeader =
+      reinterpret_cast<const DxilProgramHeader *>(storage.data());
+  return IsValidDxilProgramHeader(pProgramHeader, (uint32_t)storage.size())
+             ? pProgramHeader
+             : nullptr;
+}
+
+// The fast shader hash follows the structure of xxHash64: four independent
+// multiply-rotate lanes over 32-byte stripes, so the main loop keeps several
+// multiplies in flight, then a tail and avalanche step. Two differently
+// mixed merges of the lanes give the 128 bits.
+static const uint64_t kFastHashPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kFastHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kFastHashPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kFastHashPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kFastHashPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t FastHashRotl(uint64_t v, unsigned r) {
+  return (v << r) | (v >> (64 - r));
+}
+
+static inline uint64_t FastHashRead64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t FastHashRound(uint64_t acc, uint64_t input) {
+  acc += input * kFastHashPrime2;
+  acc = FastHashRotl(acc, 31);
+  return acc * kFastHashPrime1;
+}
+
+static inline uint64_t FastHashAvalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= kFastHashPrime2;
+  h ^= h >> 29;
+  h *= kFastHashPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+void ComputeFastShaderHash(const void *pData, size_t size,
+                           uint8_t (&Digest)[DxilContainerHashSize]) {
+  const uint8_t *p = static_cast<const uint8_t *>(pData);
+  const uint8_t *pEnd = p + size;
+  uint64_t v0 = kFastHashPrime1 + kFastHashPrime2;
+  uint64_t v1 = kFastHashPrime2;
+  uint64_t v2 = 0;
+  uint64_t v3 = 0 - kFastHashPrime1;
+  while (pEnd - p >= 32) {
+    v0 = FastHashRound(v0, FastHashRead64(p));
+    v1 = FastHashRound(v1, FastHashRead64(p + 8));
+    v2 = FastHashRound(v2, FastHashRead64(p + 16));
+    v3 = FastHashRound(v3, FastHashRead64(p + 24));
+    p += 32;
+  }
+
+  uint64_t lo = FastHashRotl(v0, 1) + FastHashRotl(v1, 7) +
+                FastHashRotl(v2, 12) + FastHashRotl(v3, 18);
+  uint64_t hi = FastHashRotl(v0, 18) + FastHashRotl(v1, 12) +
+                FastHashRotl(v2, 7) + FastHashRotl(v3, 1);
+  lo += (uint64_t)size;
+  hi ^= (uint64_t)size * kFastHashPrime5;
+
+  while (pEnd - p >= 8) {
+    uint64_t k = FastHashRound(0, FastHashRead64(p));
+    lo = FastHashRotl(lo ^ k, 27) * kFastHashPrime1 + kFastHashPrime4;
+    hi = FastHashRotl(hi ^ FastHashRotl(k, 31), 29) * kFastHashPrime2 +
+         kFastHashPrime3;
+    p += 8;
+  }
+  while (p < pEnd) {
+    lo = FastHashRotl(lo ^ (*p * kFastHashPrime5), 11) * kFastHashPrime1;
+    hi = FastHashRotl(hi ^ (*p * kFastHashPrime1), 13) * kFastHashPrime5;
+    ++p;
+  }
+
+  lo = FastHashAvalanche(lo);
+  hi = FastHashAvalanche(hi ^ lo);
+  memcpy(Digest, &lo, sizeof(lo));
+  memcpy(Digest + sizeof(lo), &hi, sizeof(hi));
+}
+
 } // namespace hlsl
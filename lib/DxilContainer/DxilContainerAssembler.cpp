@@ -11,6 +11,7 @@
 
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/Instructions.h"
@@ -24,6 +25,7 @@
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include "dxc/DxilContainer/DxilContainerAssembler.h"
 #include "dxc/DXIL/DxilUtil.h"
+#include "dxc/DXIL/DxilFunctionHash.h"
 #include "dxc/DXIL/DxilFunctionProps.h"
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilInstructions.h"
@@ -32,10 +34,13 @@
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include "dxc/DxilContainer/DxilPipelineStateValidation.h"
 #include "dxc/DxilContainer/DxilRuntimeReflection.h"
 #include <algorithm>
+#include <exception>
 #include <functional>
+#include <mutex>
 
 using namespace llvm;
 using namespace hlsl;
@@ -408,6 +413,7 @@ private:
   uint32_t m_PSVBufferSize;
   SmallVector<char, 512> m_PSVBuffer;
   SmallVector<char, 256> m_StringBuffer;
+  StringMap<uint32_t> m_StringMap;  // Offsets of names already in m_StringBuffer
   SmallVector<uint32_t, 8> m_SemanticIndexBuffer;
   std::vector<PSVSignatureElement0> m_SigInputElements;
   std::vector<PSVSignatureElement0> m_SigOutputElements;
@@ -416,10 +422,21 @@ private:
   void SetPSVSigElement(PSVSignatureElement0 &E, const DxilSignatureElement &SE) {
     memset(&E, 0, sizeof(PSVSignatureElement0));
     if (SE.GetKind() == DXIL::SemanticKind::Arbitrary && strlen(SE.GetName()) > 0) {
-      E.SemanticName = (uint32_t)m_StringBuffer.size();
       StringRef Name(SE.GetName());
-      m_StringBuffer.append(Name.size()+1, '\0');
-      memcpy(m_StringBuffer.data() + E.SemanticName, Name.data(), Name.size());
+      // Share one copy of each name between elements. Older validators
+      // write a copy per element, so only do this when theirs won't be
+      // compared against ours.
+      bool bShareNames = DXIL::CompareVersions(m_ValMajor, m_ValMinor, 1, 6) >= 0;
+      auto found = bShareNames ? m_StringMap.find(Name) : m_StringMap.end();
+      if (found != m_StringMap.end()) {
+        E.SemanticName = found->second;
+      } else {
+        E.SemanticName = (uint32_t)m_StringBuffer.size();
+        m_StringBuffer.append(Name.size()+1, '\0');
+        memcpy(m_StringBuffer.data() + E.SemanticName, Name.data(), Name.size());
+        if (bShareNames)
+          m_StringMap[Name] = E.SemanticName;
+      }
     } else {
       // m_StringBuffer always starts with '\0' so offset 0 is empty string:
       E.SemanticName = 0;
@@ -891,6 +908,8 @@ public:
     m_rows.push_back(data);
   }
 
+  uint32_t GetRowCount() const { return (uint32_t)m_rows.size(); }
+
   void Write(void *ptr) {
     char *pCur = (char*)ptr;
     RuntimeDataTableHeader &header = *reinterpret_cast<RuntimeDataTableHeader*>(pCur);
@@ -1030,6 +1049,62 @@ public:
   RuntimeDataPartType GetType() const { return RuntimeDataPartType::SubobjectTable; }
 };
 
+// Function table row indices sorted by mangled name, so readers can find a
+// function with a binary search instead of comparing every name.
+class FunctionNameIndexPart : public RDATPart {
+private:
+  std::vector<std::pair<std::string, uint32_t>> m_Entries;
+public:
+  void Insert(StringRef name, uint32_t row) {
+    m_Entries.emplace_back(name.str(), row);
+  }
+  RuntimeDataPartType GetType() const { return RuntimeDataPartType::FunctionNameIndex; }
+  uint32_t GetPartSize() const { return sizeof(uint32_t) * m_Entries.size(); }
+  void Write(void *ptr) {
+    // Sort here rather than on insert; std::string compares bytes as
+    // unsigned char, matching strcmp in the reader.
+    std::sort(m_Entries.begin(), m_Entries.end());
+    uint32_t *pIndices = (uint32_t*)ptr;
+    for (auto &entry : m_Entries)
+      *pIndices++ = entry.second;
+  }
+};
+
+// Exports named by subobject associations, sorted by name, so readers can
+// find the subobjects associated with an export with a binary search instead
+// of scanning every association.
+class SubobjectExportIndexPart : public RDATPart {
+private:
+  typedef std::pair<std::string, RuntimeDataSubobjectExportInfo> Entry;
+  std::vector<Entry> m_Entries;
+public:
+  void Insert(StringRef name, const RuntimeDataSubobjectExportInfo &info) {
+    m_Entries.emplace_back(name.str(), info);
+  }
+  RuntimeDataPartType GetType() const { return RuntimeDataPartType::SubobjectExportIndex; }
+  uint32_t GetPartSize() const {
+    if (m_Entries.empty())
+      return 0;
+    return sizeof(RuntimeDataTableHeader) +
+           m_Entries.size() * sizeof(RuntimeDataSubobjectExportInfo);
+  }
+  void Write(void *ptr) {
+    // Entries are inserted in association order, so a stable sort keeps the
+    // associations of each export in table order.
+    std::stable_sort(m_Entries.begin(), m_Entries.end(),
+                     [](const Entry &a, const Entry &b) {
+                       return a.first < b.first;
+                     });
+    RuntimeDataTableHeader &header = *reinterpret_cast<RuntimeDataTableHeader*>(ptr);
+    header.RecordCount = m_Entries.size();
+    header.RecordStride = sizeof(RuntimeDataSubobjectExportInfo);
+    RuntimeDataSubobjectExportInfo *pRows =
+        reinterpret_cast<RuntimeDataSubobjectExportInfo*>(&header + 1);
+    for (auto &entry : m_Entries)
+      *pRows++ = entry.second;
+  }
+};
+
 using namespace DXIL;
 
 class DxilRDATWriter : public DxilPartWriter {
@@ -1220,7 +1295,7 @@ private:
           }
           shaderKind = (uint32_t)props.shaderKind;
         }
-        ShaderFlags flags = ShaderFlags::CollectShaderFlags(&function, &DM);
+        const ShaderFlags &flags = DM.GetShaderFlagsForFunction(&function);
         RuntimeDataFunctionInfo info = {};
         info.Name = mangledIndex;
         info.UnmangledName = unmangledIndex;
@@ -1259,6 +1334,10 @@ private:
           info.ShaderStageFlag &= compatInfo.mask;
         }
         info.MinShaderTarget = EncodeVersion((DXIL::ShaderKind)shaderKind, minMajor, minMinor);
+        // Older validators don't emit the name index, so their RDAT would
+        // not match ours.
+        if (DXIL::CompareVersions(m_ValMajor, m_ValMinor, 1, 6) >= 0)
+          m_pFunctionNameIndexPart->Insert(mangled, m_pFunctionTable->GetRowCount());
         m_pFunctionTable->Insert(info);
       }
     }
@@ -1267,8 +1346,13 @@ private:
   void UpdateSubobjectInfo(const DxilModule &DM) {
     if (!DM.GetSubobjects())
       return;
+    // Rows of subobjects by name, and associations with their rows, to
+    // resolve the export index once every subobject has a row.
+    StringMap<uint32_t> subobjectRows;
+    std::vector<std::pair<const DxilSubobject *, uint32_t>> associations;
     for (auto &it : DM.GetSubobjects()->GetSubobjects()) {
       auto &obj = *it.second;
+      subobjectRows[obj.GetName()] = m_pSubobjectTable->GetRowCount();
       RuntimeDataSubobjectInfo info = {};
       info.Name = m_pStringBufferPart->Insert(obj.GetName());
       info.Kind = (uint32_t)obj.GetKind();
@@ -1302,6 +1386,7 @@ private:
         info.SubobjectToExportsAssociation.Exports =
           m_pIndexArraysPart->AddIndex(
             ExportIndices.begin(), ExportIndices.end());
+        associations.emplace_back(&obj, m_pSubobjectTable->GetRowCount());
         break;
       }
       case DXIL::SubobjectKind::RaytracingShaderConfig:
@@ -1334,6 +1419,27 @@ private:
       }
       m_pSubobjectTable->Insert(info);
     }
+
+    // Older validators don't emit the export index, so their RDAT would not
+    // match ours.
+    if (DXIL::CompareVersions(m_ValMajor, m_ValMinor, 1, 6) < 0)
+      return;
+    for (auto &association : associations) {
+      llvm::StringRef Subobject;
+      const char * const * Exports;
+      uint32_t NumExports;
+      association.first->GetSubobjectToExportsAssociation(Subobject, Exports,
+                                                          NumExports);
+      auto itRow = subobjectRows.find(Subobject);
+      RuntimeDataSubobjectExportInfo info = {};
+      info.Association = association.second;
+      info.Subobject =
+          itRow != subobjectRows.end() ? itRow->second : UINT_MAX;
+      for (unsigned i = 0; i < NumExports; ++i) {
+        info.Export = m_pStringBufferPart->Insert(Exports[i]);
+        m_pSubobjectExportIndexPart->Insert(Exports[i], info);
+      }
+    }
   }
 
   void CreateParts() {
@@ -1346,6 +1452,8 @@ private:
     ADD_PART(IndexArraysPart);
     ADD_PART(RawBytesPart);
     ADD_PART(SubobjectTable);
+    ADD_PART(FunctionNameIndexPart);
+    ADD_PART(SubobjectExportIndexPart);
 #undef ADD_PART
   }
 
@@ -1355,6 +1463,8 @@ private:
   FunctionTable *m_pFunctionTable;
   ResourceTable *m_pResourceTable;
   SubobjectTable *m_pSubobjectTable;
+  FunctionNameIndexPart *m_pFunctionNameIndexPart;
+  SubobjectExportIndexPart *m_pSubobjectExportIndexPart;
 
 public:
   DxilRDATWriter(const DxilModule &mod, uint32_t InfoVersion = 0)
@@ -1491,6 +1601,50 @@ static bool HasDebugInfo(const Module &M) {
   return false;
 }
 
+// Modules with at least this many function bodies have them encoded on
+// several threads when serialized; below it the threads cost more than
+// they save.
+static const unsigned kMinFunctionsForParallelBitcode = 64;
+
+static void WriteModuleBitcode(const Module *M, raw_ostream &OS,
+                               bool ShouldPreserveUseListOrder) {
+  unsigned bodyCount = 0;
+  for (const Function &F : *M)
+    if (!F.isDeclaration())
+      ++bodyCount;
+  unsigned threadCount = DxcThreadPool::GetDefaultThreadCount();
+  if (bodyCount < kMinFunctionsForParallelBitcode || threadCount < 2) {
+    WriteBitcodeToFile(M, OS, ShouldPreserveUseListOrder);
+    return;
+  }
+
+  // The writer produces the same bytes either way, so the shader hash does
+  // not depend on how the work was split.
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  DxcThreadPool pool(threadCount);
+  std::mutex errorLock;
+  std::exception_ptr error;
+  WriteBitcodeToFile(
+      M, OS, ShouldPreserveUseListOrder, threadCount,
+      [&](unsigned taskCount, const std::function<void(unsigned)> &task) {
+        for (unsigned i = 0; i < taskCount; ++i) {
+          pool.Async([&, i]() {
+            DxcThreadMalloc TM(pMalloc);
+            try {
+              task(i);
+            } catch (...) {
+              std::lock_guard<std::mutex> L(errorLock);
+              if (!error)
+                error = std::current_exception();
+            }
+          });
+        }
+        pool.Wait();
+        if (error)
+          std::rethrow_exception(error);
+      });
+}
+
 static void GetPaddedProgramPartSize(AbstractMemoryStream *pStream,
                                      uint32_t &bitcodeInUInt32,
                                      uint32_t &bitcodePaddingBytes) {
@@ -1527,6 +1681,135 @@ static void WriteProgramPart(const ShaderModel *pModel,
 
 namespace {
 
+class DxilFunctionHashWriter : public DxilPartWriter {
+private:
+  std::vector<DxilFunctionHashEntry> m_Entries;
+  std::string m_Names;
+
+public:
+  DxilFunctionHashWriter(DxilModule &DM) {
+    for (Function &F : DM.GetModule()->functions()) {
+      if (F.isDeclaration())
+        continue;
+      DxilFunctionHashEntry Entry;
+      Entry.NameOffset = m_Names.size();
+      Entry.NameLength = F.getName().size();
+      Entry.Hash = ComputeFunctionBodyHash(F, DM.GetTypeSystem());
+      m_Entries.push_back(Entry);
+      m_Names += F.getName();
+      m_Names += '\0';
+    }
+    uint32_t NamesStart = sizeof(DxilFunctionHashHeader) +
+                          m_Entries.size() * sizeof(DxilFunctionHashEntry);
+    for (DxilFunctionHashEntry &Entry : m_Entries)
+      Entry.NameOffset += NamesStart;
+    m_Names.resize(PSVALIGN4(m_Names.size()), '\0');
+  }
+  uint32_t size() const {
+    return sizeof(DxilFunctionHashHeader) +
+           m_Entries.size() * sizeof(DxilFunctionHashEntry) + m_Names.size();
+  }
+  void write(AbstractMemoryStream *pStream) {
+    ULONG cbWritten;
+    DxilFunctionHashHeader Header;
+    Header.FunctionCount = m_Entries.size();
+    IFT(WriteStreamValue(pStream, Header));
+    for (const DxilFunctionHashEntry &Entry : m_Entries)
+      IFT(WriteStreamValue(pStream, Entry));
+    IFT(pStream->Write(m_Names.data(), m_Names.size(), &cbWritten));
+  }
+};
+
+class DxilLineTableWriter : public DxilPartWriter {
+private:
+  std::string m_FileNames;
+  std::vector<uint8_t> m_Rows;
+  uint32_t m_FileCount = 0;
+  uint32_t m_RowCount = 0;
+
+  void WriteULEB(uint32_t Value) {
+    do {
+      uint8_t Byte = Value & 0x7f;
+      Value >>= 7;
+      if (Value)
+        Byte |= 0x80;
+      m_Rows.push_back(Byte);
+    } while (Value);
+  }
+
+public:
+  // Must run before debug info is stripped; see DxilLineTableHeader for the
+  // instruction numbering.
+  DxilLineTableWriter(const Module &M) {
+    StringMap<uint32_t> FileIndices;
+    uint32_t InstIndex = 0, RowIndex = 0, Line = 0;
+    uint32_t CurFile = 0, CurColumn = 0;
+    auto AddRow = [&](uint32_t File, uint32_t NewLine, uint32_t Column) {
+      int32_t LineDelta = (int32_t)(NewLine - Line);
+      WriteULEB(InstIndex - RowIndex);
+      WriteULEB(File);
+      WriteULEB(((uint32_t)LineDelta << 1) ^ (uint32_t)(LineDelta >> 31));
+      WriteULEB(Column);
+      ++m_RowCount;
+      RowIndex = InstIndex;
+      CurFile = File;
+      Line = NewLine;
+      CurColumn = Column;
+    };
+
+    for (const Function &F : M) {
+      for (const BasicBlock &BB : F) {
+        for (const Instruction &I : BB) {
+          if (const CallInst *CI = dyn_cast<CallInst>(&I)) {
+            const Function *Callee = CI->getCalledFunction();
+            if (Callee && Callee->getName().startswith("llvm.dbg."))
+              continue;
+          }
+          // Instructions without a location keep the previous line, so
+          // that their row costs no line delta.
+          uint32_t File = 0, NewLine = Line, Column = 0;
+          if (const DILocation *DL = I.getDebugLoc()) {
+            auto It = FileIndices.insert(
+                std::make_pair(DL->getFilename(), m_FileCount));
+            if (It.second) {
+              m_FileNames += DL->getFilename();
+              m_FileNames += '\0';
+              ++m_FileCount;
+            }
+            File = It.first->second + 1;
+            NewLine = DL->getLine();
+            Column = DL->getColumn();
+          }
+          if (m_RowCount == 0 || File != CurFile || NewLine != Line ||
+              Column != CurColumn)
+            AddRow(File, NewLine, Column);
+          ++InstIndex;
+        }
+      }
+    }
+    // End the last run.
+    AddRow(0, Line, 0);
+
+    m_FileNames.resize(PSVALIGN4(m_FileNames.size()), '\0');
+    m_Rows.resize(PSVALIGN4(m_Rows.size()), 0);
+  }
+  uint32_t size() const {
+    return sizeof(DxilLineTableHeader) + m_FileNames.size() + m_Rows.size();
+  }
+  void write(AbstractMemoryStream *pStream) {
+    ULONG cbWritten;
+    DxilLineTableHeader Header;
+    Header.FileCount = m_FileCount;
+    Header.FileNamesOffset = sizeof(DxilLineTableHeader);
+    Header.RowCount = m_RowCount;
+    Header.RowsOffset = Header.FileNamesOffset + m_FileNames.size();
+    Header.RowsSize = m_Rows.size();
+    IFT(WriteStreamValue(pStream, Header));
+    IFT(pStream->Write(m_FileNames.data(), m_FileNames.size(), &cbWritten));
+    IFT(pStream->Write(m_Rows.data(), m_Rows.size(), &cbWritten));
+  }
+};
+
 class RootSignatureWriter : public DxilPartWriter {
 private:
   std::vector<uint8_t> m_Sig;
@@ -1616,6 +1899,8 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
   }
   std::unique_ptr<DxilRDATWriter> pRDATWriter = nullptr;
   std::unique_ptr<DxilPSVWriter> pPSVWriter = nullptr;
+  std::unique_ptr<DxilFunctionHashWriter> pFunctionHashWriter = nullptr;
+  std::unique_ptr<DxilLineTableWriter> pLineTableWriter = nullptr;
   unsigned int major, minor;
   pModule->GetDxilVersion(major, minor);
   RootSignatureWriter rootSigWriter(std::move(pModule->GetSerializedRootSignature())); // Grab RS here
@@ -1630,6 +1915,15 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     writer.AddPart(
         DFCC_RuntimeData, pRDATWriter->size(),
         [&](AbstractMemoryStream *pStream) { pRDATWriter->write(pStream); });
+    // Hash before debug info is stripped; the linker loads the debug module
+    // when there is one.
+    if (Flags & SerializeDxilFlags::IncludeFunctionHashPart) {
+      pFunctionHashWriter = llvm::make_unique<DxilFunctionHashWriter>(*pModule);
+      writer.AddPart(DFCC_FunctionHashes, pFunctionHashWriter->size(),
+                     [&](AbstractMemoryStream *pStream) {
+                       pFunctionHashWriter->write(pStream);
+                     });
+    }
     bMetadataStripped |= pModule->StripSubobjectsFromMetadata();
     pModule->ResetSubobjects(nullptr);
   } else {
@@ -1659,27 +1953,70 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     }
   }
 
-  // If metadata was stripped, re-serialize the input module.
+  // Streams the module is re-serialized into; stripping never makes the
+  // bitcode larger, so the input size is enough to avoid regrowing them.
+  const uint32_t bitcodeSizeBound = pModuleBitcode->GetPtrSize();
+
+  // If metadata was stripped, re-serialize the input module. Only the debug
+  // part uses it when debug info is present, since the program is then
+  // re-serialized after stripping anyway.
+  bool bHasDebugInfo = HasDebugInfo(*pModule->GetModule());
   CComPtr<AbstractMemoryStream> pInputProgramStream = pModuleBitcode;
-  if (bMetadataStripped) {
+  if (bMetadataStripped &&
+      (!bHasDebugInfo || (Flags & SerializeDxilFlags::IncludeDebugInfoPart))) {
     pInputProgramStream.Release();
     IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pInputProgramStream));
+    IFT(pInputProgramStream->Reserve(bitcodeSizeBound));
     raw_stream_ostream outStream(pInputProgramStream.p);
-    WriteBitcodeToFile(pModule->GetModule(), outStream, true);
+    WriteModuleBitcode(pModule->GetModule(), outStream, true);
   }
 
   // If we have debug information present, serialize it to a debug part, then use the stripped version as the canonical program version.
   CComPtr<AbstractMemoryStream> pProgramStream = pInputProgramStream;
+  std::vector<char> compressedDebugPart;
   bool bModuleStripped = false;
-  bool bHasDebugInfo = HasDebugInfo(*pModule->GetModule());
   if (bHasDebugInfo) {
     uint32_t debugInUInt32, debugPaddingBytes;
     GetPaddedProgramPartSize(pInputProgramStream, debugInUInt32, debugPaddingBytes);
-    if (Flags & SerializeDxilFlags::IncludeDebugInfoPart) {
-      writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
+    uint32_t debugPartSize =
+        debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader);
+    if ((Flags & SerializeDxilFlags::CompressDebugInfoPart) &&
+        (Flags & SerializeDxilFlags::IncludeDebugInfoPart)) {
+      // The part size is needed up front, so compress it now. The shader
+      // hash is computed from the module, not this part, so it is the same
+      // either way.
+      CComPtr<AbstractMemoryStream> pDebugPartStream;
+      IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pDebugPartStream));
+      IFT(pDebugPartStream->Reserve(debugPartSize));
+      WriteProgramPart(pModule->GetShaderModel(), pInputProgramStream,
+                       pDebugPartStream);
+      if (CompressDxilDebugPartData(pDebugPartStream->GetPtr(),
+                                    pDebugPartStream->GetPtrSize(),
+                                    compressedDebugPart)) {
+        writer.AddPart(DFCC_CompressedShaderDebugInfoDXIL,
+                       (uint32_t)compressedDebugPart.size(),
+                       [&](AbstractMemoryStream *pStream) {
+                         ULONG cbWritten;
+                         IFT(pStream->Write(compressedDebugPart.data(),
+                                            compressedDebugPart.size(),
+                                            &cbWritten));
+                       });
+      }
+    }
+    if ((Flags & SerializeDxilFlags::IncludeDebugInfoPart) &&
+        compressedDebugPart.empty()) {
+      writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugPartSize, [&](AbstractMemoryStream *pStream) {
         WriteProgramPart(pModule->GetShaderModel(), pInputProgramStream, pStream);
       });
     }
+    if (Flags & SerializeDxilFlags::IncludeLineTablePart) {
+      pLineTableWriter =
+          llvm::make_unique<DxilLineTableWriter>(*pModule->GetModule());
+      writer.AddPart(DFCC_LineTable, pLineTableWriter->size(),
+                     [&](AbstractMemoryStream *pStream) {
+                       pLineTableWriter->write(pStream);
+                     });
+    }
 
     llvm::StripDebugInfo(*pModule->GetModule());
     pModule->StripDebugRelatedCode();
@@ -1720,8 +2057,9 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
   if (bEmitReflection)
   {
     IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pReflectionBitcodeStream));
+    IFT(pReflectionBitcodeStream->Reserve(bitcodeSizeBound));
     raw_stream_ostream outStream(pReflectionBitcodeStream.p);
-    WriteBitcodeToFile(reflectionModule.get(), outStream, false);
+    WriteModuleBitcode(reflectionModule.get(), outStream, false);
     outStream.flush();
     uint32_t reflectInUInt32 = 0, reflectPaddingBytes = 0;
     GetPaddedProgramPartSize(pReflectionBitcodeStream, reflectInUInt32, reflectPaddingBytes);
@@ -1729,6 +2067,11 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
   }
 
   if (pReflectionStreamOut) {
+    uint32_t reflectionOutSize = sizeof(DxilPartHeader) + reflectPartSizeInBytes;
+    if (pModule->GetShaderModel()->IsLib())
+      reflectionOutSize += sizeof(DxilPartHeader) + pRDATWriter->size();
+    IFT(pReflectionStreamOut->Reserve(pReflectionStreamOut->GetPtrSize() +
+                                      reflectionOutSize));
     DxilPartHeader partSTAT;
     partSTAT.PartFourCC = DFCC_ShaderStatistics;
     partSTAT.PartSize = reflectPartSizeInBytes;
@@ -1760,8 +2103,9 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
   if (bModuleStripped) {
     pProgramStream.Release();
     IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pProgramStream));
+    IFT(pProgramStream->Reserve(bitcodeSizeBound));
     raw_stream_ostream outStream(pProgramStream.p);
-    WriteBitcodeToFile(pModule->GetModule(), outStream, false);
+    WriteModuleBitcode(pModule->GetModule(), outStream, false);
   }
 
   // Compute hash if needed.
@@ -1774,16 +2118,23 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     // If the debug name should be specific to the sources, base the name on the debug
     // bitcode, which will include the source references, line numbers, etc. Otherwise,
     // do it exclusively on the target shader bitcode.
-    llvm::MD5 md5;
+    AbstractMemoryStream *pHashedStream = pProgramStream;
+    HashContent.Flags = (uint32_t)DxilShaderHashFlags::None;
     if (Flags & SerializeDxilFlags::DebugNameDependOnSource) {
-      md5.update(ArrayRef<uint8_t>(pModuleBitcode->GetPtr(), pModuleBitcode->GetPtrSize()));
+      pHashedStream = pModuleBitcode;
       HashContent.Flags = (uint32_t)DxilShaderHashFlags::IncludesSource;
+    }
+    if (Flags & SerializeDxilFlags::FastShaderHash) {
+      ComputeFastShaderHash(pHashedStream->GetPtr(),
+                            pHashedStream->GetPtrSize(), HashContent.Digest);
+      HashContent.Flags |= (uint32_t)DxilShaderHashFlags::FastHash;
     } else {
-      md5.update(ArrayRef<uint8_t>(pProgramStream->GetPtr(), pProgramStream->GetPtrSize()));
-      HashContent.Flags = (uint32_t)DxilShaderHashFlags::None;
+      llvm::MD5 md5;
+      md5.update(ArrayRef<uint8_t>(pHashedStream->GetPtr(),
+                                   pHashedStream->GetPtrSize()));
+      md5.final(HashContent.Digest);
     }
-    md5.final(HashContent.Digest);
-    md5.stringifyResult(HashContent.Digest, HashStr);
+    llvm::MD5::stringifyResult(HashContent.Digest, HashStr);
   }
 
   // Serialize debug name if requested.
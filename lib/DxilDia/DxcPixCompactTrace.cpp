@@ -0,0 +1,207 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcPixCompactTrace.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Expands compact PIX debug traces into ordinary step records.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/DxilPIXPasses/DxilDebugTraceFormat.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+
+#include "DxcPixCompactTrace.h"
+
+using namespace pix_dxil;
+
+// Appends the value that the compact format left out of a step, which is
+// the constant stored by pInst.
+static bool AppendElidedValue(
+    const llvm::Instruction *pInst,
+    unsigned ValueDwords,
+    std::vector<std::uint32_t> &Expanded)
+{
+  auto *St = llvm::dyn_cast_or_null<llvm::StoreInst>(pInst);
+  if (St == nullptr)
+  {
+    return false;
+  }
+
+  const llvm::Value *V = St->getValueOperand();
+  std::uint64_t Bits;
+  if (auto *CI = llvm::dyn_cast<llvm::ConstantInt>(V))
+  {
+    Bits = CI->getZExtValue();
+  }
+  else if (auto *CF = llvm::dyn_cast<llvm::ConstantFP>(V))
+  {
+    // Halves are traced as floats.
+    llvm::APFloat F = CF->getValueAPF();
+    if (CF->getType()->isHalfTy())
+    {
+      bool LosesInfo;
+      F.convert(llvm::APFloat::IEEEsingle,
+                llvm::APFloat::rmNearestTiesToEven, &LosesInfo);
+    }
+    Bits = F.bitcastToAPInt().getZExtValue();
+  }
+  else
+  {
+    return false;
+  }
+
+  Expanded.push_back(static_cast<std::uint32_t>(Bits));
+  if (ValueDwords == 2)
+  {
+    Expanded.push_back(static_cast<std::uint32_t>(Bits >> 32));
+  }
+  return true;
+}
+
+// Expands one compact record, whose payload is [pStep, pEnd).
+static HRESULT ExpandCompactSteps(
+    const dxil_debug_info::InstructionLookup &FindInstruction,
+    std::uint32_t UID,
+    std::uint32_t InstNum,
+    const std::uint32_t *pStep,
+    const std::uint32_t *pEnd,
+    std::vector<std::uint32_t> &Expanded)
+{
+  using namespace DebugTraceCompact;
+
+  while (pStep < pEnd)
+  {
+    const std::uint32_t StepHeader = *pStep++;
+    const std::uint32_t Type = StepHeader & StepTypeMask;
+
+    if (StepHeader & StepFlagFullInstNum)
+    {
+      if (pStep == pEnd)
+      {
+        return E_INVALIDARG;
+      }
+      InstNum = *pStep++;
+    }
+    else
+    {
+      const std::int16_t Delta =
+          static_cast<std::int16_t>(StepHeader >> StepDeltaShift);
+      InstNum = static_cast<std::uint32_t>(
+          static_cast<std::int64_t>(InstNum) + Delta);
+    }
+
+    unsigned ValueDwords;
+    switch (Type)
+    {
+    case DebugShaderModifierRecordTypeDXILStepVoid:
+      ValueDwords = 0;
+      break;
+    case DebugShaderModifierRecordTypeDXILStepFloat:
+    case DebugShaderModifierRecordTypeDXILStepUint32:
+      ValueDwords = 1;
+      break;
+    case DebugShaderModifierRecordTypeDXILStepUint64:
+    case DebugShaderModifierRecordTypeDXILStepDouble:
+      ValueDwords = 2;
+      break;
+    default:
+      return E_INVALIDARG;
+    }
+
+    // Same layout as DebugShaderModifierRecordDXILStep<ReturnType>.
+    DebugShaderModifierRecordDXILStepBase Step = {};
+    Step.Header.Details.SizeDwords =
+        1 + (ValueDwords != 0 ? ValueDwords + 1 : 0);
+    Step.Header.Details.Type = Type;
+    Expanded.push_back(Step.Header.u32Header);
+    Expanded.push_back(UID);
+    Expanded.push_back(InstNum);
+
+    if (ValueDwords == 0)
+    {
+      continue;
+    }
+
+    if (StepHeader & StepFlagValueElided)
+    {
+      if (!AppendElidedValue(FindInstruction(InstNum), ValueDwords, Expanded))
+      {
+        return E_INVALIDARG;
+      }
+    }
+    else
+    {
+      if (static_cast<size_t>(pEnd - pStep) < ValueDwords)
+      {
+        return E_INVALIDARG;
+      }
+      Expanded.insert(Expanded.end(), pStep, pStep + ValueDwords);
+      pStep += ValueDwords;
+    }
+
+    // Value ordinal.
+    if (pStep == pEnd)
+    {
+      return E_INVALIDARG;
+    }
+    Expanded.push_back(*pStep++);
+  }
+
+  return S_OK;
+}
+
+HRESULT dxil_debug_info::ExpandCompactTraceRecords(
+    const InstructionLookup &FindInstruction,
+    const std::uint32_t *pRecords,
+    size_t DwordCount,
+    std::vector<std::uint32_t> &Expanded)
+{
+  size_t Pos = 0;
+  while (Pos < DwordCount)
+  {
+    DebugShaderModifierRecordHeader Record = {};
+    Record.Header.u32Header = pRecords[Pos];
+    const size_t Remaining = DwordCount - Pos;
+
+    if (Record.Header.Details.Type !=
+        DebugShaderModifierRecordTypeDXILCompactSteps)
+    {
+      const size_t RecordDwords =
+          sizeof(DebugShaderModifierRecordHeader) / sizeof(std::uint32_t) +
+          Record.Header.Details.SizeDwords;
+      if (RecordDwords > Remaining)
+      {
+        return E_INVALIDARG;
+      }
+      Expanded.insert(Expanded.end(), pRecords + Pos,
+                      pRecords + Pos + RecordDwords);
+      Pos += RecordDwords;
+      continue;
+    }
+
+    // Header, UID and base instruction number, then the steps.
+    const size_t PrefixDwords = 3;
+    const size_t PayloadDwords = Record.Header.Details.HeaderPayload;
+    if (Remaining < PrefixDwords || PayloadDwords > Remaining - PrefixDwords)
+    {
+      return E_INVALIDARG;
+    }
+    const std::uint32_t *pPayload = pRecords + Pos + PrefixDwords;
+    HRESULT hr = ExpandCompactSteps(FindInstruction, pRecords[Pos + 1],
+                                    pRecords[Pos + 2], pPayload,
+                                    pPayload + PayloadDwords, Expanded);
+    if (FAILED(hr))
+    {
+      return hr;
+    }
+    Pos += PrefixDwords + PayloadDwords;
+  }
+
+  return S_OK;
+}
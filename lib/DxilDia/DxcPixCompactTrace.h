@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcPixCompactTrace.h                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Expands compact PIX debug traces into ordinary step records.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace llvm
+{
+class Instruction;
+}  // namespace llvm
+
+namespace dxil_debug_info
+{
+
+// Returns the instrumented module's instruction with the given
+// pix-dxil-inst-num, or nullptr.
+using InstructionLookup =
+    std::function<const llvm::Instruction *(std::uint32_t InstNum)>;
+
+// Appends the records in pRecords to Expanded, replacing each compact
+// record written by DxilDebugInstrumentation with the step records it
+// stands for. Values the compact format leaves out are read back from the
+// store instructions that FindInstruction returns. Fails with E_INVALIDARG
+// if the records are malformed.
+HRESULT ExpandCompactTraceRecords(
+    const InstructionLookup &FindInstruction,
+    const std::uint32_t *pRecords,
+    size_t DwordCount,
+    std::vector<std::uint32_t> &Expanded);
+
+}  // namespace dxil_debug_info
@@ -106,12 +106,8 @@ CompilationInfo::CompilationInfo(IMalloc *pMalloc, dxil_dia::Session *pSession)
     m_arguments = Module->getNamedMetadata("llvm.dbg.args");
 }
 
-static void MDStringOperandToBSTR(llvm::MDOperand const &mdOperand,
-                                  BSTR *pBStr) {
-  llvm::StringRef MetadataAsStringRef =
-      llvm::dyn_cast<llvm::MDString>(mdOperand)->getString();
-  std::string StringWithTerminator(MetadataAsStringRef.begin(),
-                                   MetadataAsStringRef.size());
+static void StringRefToTerminatedBSTR(llvm::StringRef Value, BSTR *pBStr) {
+  std::string StringWithTerminator(Value.begin(), Value.size());
   CA2W cv(StringWithTerminator.c_str(), CP_UTF8);
   CComBSTR BStr;
   BStr.Append(cv);
@@ -119,6 +115,12 @@ static void MDStringOperandToBSTR(llvm::MDOperand const &mdOperand,
   *pBStr = BStr.Detach();
 }
 
+static void MDStringOperandToBSTR(llvm::MDOperand const &mdOperand,
+                                  BSTR *pBStr) {
+  StringRefToTerminatedBSTR(
+      llvm::dyn_cast<llvm::MDString>(mdOperand)->getString(), pBStr);
+}
+
 STDMETHODIMP
 CompilationInfo::GetSourceFile(_In_ DWORD SourceFileOrdinal,
                                _Outptr_result_z_ BSTR *pSourceName,
@@ -134,7 +136,8 @@ CompilationInfo::GetSourceFile(_In_ DWORD SourceFileOrdinal,
       llvm::cast<llvm::MDTuple>(m_contents->getOperand(SourceFileOrdinal));
 
   MDStringOperandToBSTR(FileTuple->getOperand(0), pSourceName);
-  MDStringOperandToBSTR(FileTuple->getOperand(1), pSourceContents);
+  StringRefToTerminatedBSTR(m_pSession->SourceContent(SourceFileOrdinal),
+                            pSourceContents);
 
   return S_OK;
 }
@@ -16,9 +16,12 @@
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 
+#include "DxcPixCompactTrace.h"
 #include "DxcPixLiveVariables.h"
 #include "DxcPixDxilDebugInfo.h"
 
+#include <algorithm>
+
 STDMETHODIMP dxil_debug_info::DxcPixDxilDebugInfo::GetLiveVariablesAt(
   _In_ DWORD InstructionOffset,
   _COM_Outptr_ IDxcPixDxilLiveVariables **ppLiveVariables)
@@ -95,6 +98,58 @@ dxil_debug_info::DxcPixDxilDebugInfo::DxcPixDxilDebugInfo(
 
 dxil_debug_info::DxcPixDxilDebugInfo::~DxcPixDxilDebugInfo() = default;
 
+STDMETHODIMP dxil_debug_info::DxcPixDxilDebugInfo::ExpandCompactTrace(
+    _In_reads_(DwordCount) const UINT32 *pRecords,
+    _In_ DWORD DwordCount,
+    _Out_writes_to_(Capacity, *pExpandedCount) UINT32 *pExpanded,
+    _In_ DWORD Capacity,
+    _Out_ DWORD *pExpandedCount)
+{
+  const auto &Instructions = m_pSession->InstructionsRef();
+  auto FindInstruction =
+      [&Instructions](std::uint32_t InstNum) -> const llvm::Instruction *
+  {
+    auto it = Instructions.find(InstNum);
+    return it == Instructions.end() ? nullptr : it->second;
+  };
+
+  std::vector<std::uint32_t> Expanded;
+  IFR(ExpandCompactTraceRecords(FindInstruction, pRecords, DwordCount,
+                                Expanded));
+
+  *pExpandedCount = static_cast<DWORD>(Expanded.size());
+  if (Expanded.size() > Capacity)
+  {
+    return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+  }
+  std::copy(Expanded.begin(), Expanded.end(), pExpanded);
+  return S_OK;
+}
+
+STDMETHODIMP dxil_debug_info::DxcPixDxilDebugInfo::GetBlockSourceLocation(
+    _In_ DWORD InstructionOffset,
+    _Outptr_result_z_ BSTR *pFileName,
+    _Out_ DWORD *pLine)
+{
+  llvm::Instruction *IP = FindInstruction(InstructionOffset);
+
+  for (auto It = IP->getIterator(), End = IP->getParent()->end(); It != End;
+       ++It)
+  {
+    if (const llvm::DebugLoc &DL = It->getDebugLoc())
+    {
+      auto *Scope = llvm::cast<llvm::DIScope>(DL.getScope());
+      *pFileName = CComBSTR(CA2W(Scope->getFilename().str().c_str())).Detach();
+      *pLine = DL.getLine();
+      return S_OK;
+    }
+  }
+
+  *pFileName = CComBSTR(L"").Detach();
+  *pLine = 0;
+  return S_FALSE;
+}
+
 llvm::Module* dxil_debug_info::DxcPixDxilDebugInfo::GetModuleRef()
 {
   return &m_pSession->ModuleRef();
@@ -104,7 +159,7 @@ llvm::Instruction* dxil_debug_info::DxcPixDxilDebugInfo::FindInstruction(
     DWORD InstructionOffset
 ) const
 {
-  const auto Instructions = m_pSession->InstructionsRef();
+  const auto &Instructions = m_pSession->InstructionsRef();
   auto it = Instructions.find(InstructionOffset);
   if (it == Instructions.end())
   {
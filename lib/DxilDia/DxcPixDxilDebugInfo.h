@@ -35,7 +35,9 @@ namespace dxil_debug_info
 {
 class LiveVariables;
 
-class DxcPixDxilDebugInfo : public IDxcPixDxilDebugInfo
+class DxcPixDxilDebugInfo : public IDxcPixDxilDebugInfo,
+                            public IDxcPixDxilTraceDecoder,
+                            public IDxcPixDxilBlockProfile
 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
@@ -57,7 +59,10 @@ public:
   DXC_MICROCOM_TM_ALLOC(DxcPixDxilDebugInfo)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcPixDxilDebugInfo>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcPixDxilDebugInfo,
+                                 IDxcPixDxilTraceDecoder,
+                                 IDxcPixDxilBlockProfile>(this, iid,
+                                                          ppvObject);
   }
 
   STDMETHODIMP GetLiveVariablesAt(
@@ -76,6 +81,18 @@ public:
       _In_ DWORD InstructionOffset,
       _Outptr_ DWORD *StackDepth) override;
 
+  STDMETHODIMP ExpandCompactTrace(
+      _In_reads_(DwordCount) const UINT32 *pRecords,
+      _In_ DWORD DwordCount,
+      _Out_writes_to_(Capacity, *pExpandedCount) UINT32 *pExpanded,
+      _In_ DWORD Capacity,
+      _Out_ DWORD *pExpandedCount) override;
+
+  STDMETHODIMP GetBlockSourceLocation(
+      _In_ DWORD InstructionOffset,
+      _Outptr_result_z_ BSTR *pFileName,
+      _Out_ DWORD *pLine) override;
+
   llvm::Module *GetModuleRef();
 
   IMalloc *GetMallocNoRef()
@@ -721,6 +721,36 @@ struct IDxcPixDxilDebugInfoEntrypoint : public Entrypoint<IDxcPixDxilDebugInfo>
 };
 DEFINE_ENTRYPOINT_WRAPPER_TRAIT(IDxcPixDxilDebugInfo);
 
+struct IDxcPixDxilTraceDecoderEntrypoint : public Entrypoint<IDxcPixDxilTraceDecoder>
+{
+  DEFINE_ENTRYPOINT_BOILERPLATE(IDxcPixDxilTraceDecoderEntrypoint);
+
+  STDMETHODIMP ExpandCompactTrace(
+      _In_reads_(DwordCount) const UINT32 *pRecords,
+      _In_ DWORD DwordCount,
+      _Out_writes_to_(Capacity, *pExpandedCount) UINT32 *pExpanded,
+      _In_ DWORD Capacity,
+      _Out_ DWORD *pExpandedCount) override
+  {
+    return InvokeOnReal(&IInterface::ExpandCompactTrace, CheckNotNull(InParam(pRecords)), DwordCount, CheckNotNull(OutParam(pExpanded)), Capacity, CheckNotNull(OutParam(pExpandedCount)));
+  }
+};
+DEFINE_ENTRYPOINT_WRAPPER_TRAIT(IDxcPixDxilTraceDecoder);
+
+struct IDxcPixDxilBlockProfileEntrypoint : public Entrypoint<IDxcPixDxilBlockProfile>
+{
+  DEFINE_ENTRYPOINT_BOILERPLATE(IDxcPixDxilBlockProfileEntrypoint);
+
+  STDMETHODIMP GetBlockSourceLocation(
+      _In_ DWORD InstructionOffset,
+      _Outptr_result_z_ BSTR *pFileName,
+      _Out_ DWORD *pLine) override
+  {
+    return InvokeOnReal(&IInterface::GetBlockSourceLocation, InstructionOffset, CheckNotNull(OutParam(pFileName)), CheckNotNull(OutParam(pLine)));
+  }
+};
+DEFINE_ENTRYPOINT_WRAPPER_TRAIT(IDxcPixDxilBlockProfile);
+
 
 struct IDxcPixCompilationInfoEntrypoint
     : public Entrypoint<IDxcPixCompilationInfo>
@@ -797,6 +827,8 @@ HRESULT CreateEntrypointWrapper(
   HANDLE_INTERFACE(IDxcPixVariable);
   HANDLE_INTERFACE(IDxcPixDxilLiveVariables);
   HANDLE_INTERFACE(IDxcPixDxilDebugInfo);
+  HANDLE_INTERFACE(IDxcPixDxilTraceDecoder);
+  HANDLE_INTERFACE(IDxcPixDxilBlockProfile);
   HANDLE_INTERFACE(IDxcPixCompilationInfo);
 
   return E_FAIL;
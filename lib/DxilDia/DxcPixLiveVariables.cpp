@@ -26,6 +26,10 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 // ValidateDbgDeclare ensures that all of the bits in
@@ -62,10 +66,30 @@ struct dxil_debug_info::LiveVariables::Impl
   using LiveVarsMap =
       std::unordered_map<llvm::DIScope*, VariableInfoMap>;
 
+  // The variables declared in each scope, sorted by the line that declares
+  // them, so that those declared by a given line are a prefix.
+  using ScopeVarsMap =
+      std::unordered_map<llvm::DIScope*, std::vector<const VariableInfo *>>;
+
+  // The results of the most recent queries. A result depends only on the
+  // scope and line of the instruction, so stepping through a loop or a
+  // straight run of code on one line hits this. Everything else is only
+  // read after Init, so only the cache is locked.
+  struct CachedResult
+  {
+    llvm::DIScope *m_Scope;
+    unsigned m_Line;
+    std::vector<const VariableInfo *> m_LiveVars;
+  };
+  static constexpr size_t kMaxCachedResults = 16;
+
   IMalloc *m_pMalloc;
   DxcPixDxilDebugInfo *m_pDxilDebugInfo;
   llvm::Module *m_pModule;
   LiveVarsMap m_LiveVarsDbgDeclare;
+  ScopeVarsMap m_ScopeVarsByLine;
+  std::mutex m_CachedResultsLock;
+  std::list<CachedResult> m_CachedResults; // most recently used first
 
   void Init(
       IMalloc *pMalloc,
@@ -74,6 +98,12 @@ struct dxil_debug_info::LiveVariables::Impl
 
   void Init_DbgDeclare(llvm::DbgDeclareInst *DbgDeclare);
 
+  void Init_ScopeVarsByLine();
+
+  std::vector<const VariableInfo *> GetLiveVariables(
+      llvm::DIScope *S,
+      unsigned Line);
+
   VariableInfo *AssignValueToOffset(
       VariableInfoMap *VarInfoMap,
       llvm::DIVariable *Var,
@@ -91,19 +121,106 @@ void dxil_debug_info::LiveVariables::Impl::Init(
   m_pDxilDebugInfo = pDxilDebugInfo;
   m_pModule = pModule;
 
-  llvm::Function* DbgDeclareFn = llvm::Intrinsic::getDeclaration(
-      m_pModule,
-      llvm::Intrinsic::dbg_declare);
+  // Looked up rather than declared, so that creating debug info objects for
+  // a session, possibly on several threads, never changes its module.
+  llvm::Function* DbgDeclareFn = m_pModule->getFunction(
+      llvm::Intrinsic::getName(llvm::Intrinsic::dbg_declare));
+
+  if (DbgDeclareFn != nullptr)
+  {
+    for (llvm::User* U : DbgDeclareFn->users())
+    {
+      if (auto* DbgDeclare = llvm::dyn_cast<llvm::DbgDeclareInst>(U))
+      {
+        Init_DbgDeclare(DbgDeclare);
+      }
+    }
+  }
+
+  Init_ScopeVarsByLine();
+}
 
-  for (llvm::User* U : DbgDeclareFn->users())
+void dxil_debug_info::LiveVariables::Impl::Init_ScopeVarsByLine()
+{
+  for (const auto &ScopeAndVars : m_LiveVarsDbgDeclare)
   {
-    if (auto* DbgDeclare = llvm::dyn_cast<llvm::DbgDeclareInst>(U))
+    auto &Vars = m_ScopeVarsByLine[ScopeAndVars.first];
+    for (const auto &VarAndInfo : ScopeAndVars.second)
     {
-      Init_DbgDeclare(DbgDeclare);
+      if (VarAndInfo.first->getName().empty())
+      {
+        // No name?...
+        continue;
+      }
+      Vars.emplace_back(VarAndInfo.second.get());
     }
+    std::stable_sort(
+        Vars.begin(), Vars.end(),
+        [](const VariableInfo *A, const VariableInfo *B)
+        {
+          return A->m_Variable->getLine() < B->m_Variable->getLine();
+        });
   }
 }
 
+std::vector<const dxil_debug_info::VariableInfo *>
+dxil_debug_info::LiveVariables::Impl::GetLiveVariables(
+    llvm::DIScope *S,
+    unsigned Line
+)
+{
+  std::unique_lock<std::mutex> lock(m_CachedResultsLock);
+  for (auto it = m_CachedResults.begin(); it != m_CachedResults.end(); ++it)
+  {
+    if (it->m_Scope == S && it->m_Line == Line)
+    {
+      m_CachedResults.splice(m_CachedResults.begin(), m_CachedResults, it);
+      return m_CachedResults.front().m_LiveVars;
+    }
+  }
+  lock.unlock();
+
+  std::vector<const VariableInfo *> LiveVars;
+  std::set<llvm::StringRef> LiveVarsName;
+
+  const llvm::DITypeIdentifierMap EmptyMap;
+  for (llvm::DIScope *Scope = S; Scope != nullptr;
+       Scope = Scope->getScope().resolve(EmptyMap))
+  {
+    auto it = m_ScopeVarsByLine.find(Scope);
+    if (it == m_ScopeVarsByLine.end())
+    {
+      continue;
+    }
+    const auto &Vars = it->second;
+    // Variables declared later in the HLSL source are not live yet.
+    auto End = std::upper_bound(
+        Vars.begin(), Vars.end(), Line,
+        [](unsigned Line, const VariableInfo *VarInfo)
+        {
+          return Line < VarInfo->m_Variable->getLine();
+        });
+    for (auto VarIt = Vars.begin(); VarIt != End; ++VarIt)
+    {
+      if (!LiveVarsName.insert((*VarIt)->m_Variable->getName()).second)
+      {
+        // There's a variable with the same name; use the
+        // previous one instead.
+        continue;
+      }
+      LiveVars.emplace_back(*VarIt);
+    }
+  }
+
+  lock.lock();
+  if (m_CachedResults.size() == kMaxCachedResults)
+  {
+    m_CachedResults.pop_back();
+  }
+  m_CachedResults.push_front({S, Line, LiveVars});
+  return LiveVars;
+}
+
 void dxil_debug_info::LiveVariables::Impl::Init_DbgDeclare(
     llvm::DbgDeclareInst *DbgDeclare
 )
@@ -212,9 +329,6 @@ HRESULT dxil_debug_info::LiveVariables::GetLiveVariablesAtInstruction(
   DXASSERT(IP != nullptr, "else IP should not be nullptr");
   DXASSERT(ppResult != nullptr, "else Result should not be nullptr");
 
-  std::vector<const VariableInfo *> LiveVars;
-  std::set<std::string> LiveVarsName;
-
   const llvm::DebugLoc &DL = IP->getDebugLoc();
 
   if (!DL)
@@ -228,38 +342,8 @@ HRESULT dxil_debug_info::LiveVariables::GetLiveVariablesAtInstruction(
     return E_FAIL;
   }
 
-  const llvm::DITypeIdentifierMap EmptyMap;
-  while (S != nullptr)
-  {
-    auto it = m_pImpl->m_LiveVarsDbgDeclare.find(S);
-    if (it != m_pImpl->m_LiveVarsDbgDeclare.end())
-    {
-      for (const auto &VarAndInfo :  it->second)
-      {
-        auto *Var = VarAndInfo.first;
-        llvm::StringRef VarName = Var->getName();
-        if (Var->getLine() > DL.getLine())
-        {
-          // Defined later in the HLSL source.
-          continue;
-        }
-        if (VarName.empty())
-        {
-          // No name?...
-          continue;
-        }
-        if (!LiveVarsName.insert(VarName).second)
-        {
-          // There's a variable with the same name; use the
-          // previous one instead.
-          continue;
-        }
-
-        LiveVars.emplace_back(VarAndInfo.second.get());
-      }
-    }
-    S = S->getScope().resolve(EmptyMap);
-  }
+  std::vector<const VariableInfo *> LiveVars =
+      m_pImpl->GetLiveVariables(S, DL.getLine());
 
   return CreateDxilLiveVariables(
       m_pImpl->m_pDxilDebugInfo,
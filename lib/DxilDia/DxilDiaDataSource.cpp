@@ -14,6 +14,8 @@
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/DXIL/DxilPDB.h"
+#include "dxc/DxilPIXPasses/DxilPIXPasses.h"
+#include "dxc/Support/DxcSourceStore.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
 
@@ -23,8 +25,11 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/PassRegistry.h"
 
+#include "DxilDiaModuleCache.h"
 #include "DxilDiaSession.h"
 
 dxil_dia::DataSource::DataSource(IMalloc *pMalloc) : m_pMalloc(pMalloc) {
@@ -86,25 +91,36 @@ STDMETHODIMP dxil_dia::DataSource::loadDataFromIStream(_In_ IStream *pInputIStre
 
     CComPtr<IStream> pIStream = pInputIStream;
     CComPtr<IDxcBlob> pContainer;
+    hlsl::DxilShaderHash ShaderHash = {};
     if (SUCCEEDED(hlsl::pdb::LoadDataFromStream(m_pMalloc, pInputIStream, &pContainer))) {
       const hlsl::DxilContainerHeader *pContainerHeader = 
         hlsl::IsDxilContainerLike(pContainer->GetBufferPointer(), pContainer->GetBufferSize());
       if (!hlsl::IsValidDxilContainer(pContainerHeader, pContainer->GetBufferSize()))
         return E_FAIL;
-      const hlsl::DxilPartHeader *PartHeader =
-        hlsl::GetDxilPartByType(pContainerHeader, hlsl::DFCC_ShaderDebugInfoDXIL);
-      if (!PartHeader)
+      // The debug part may be compressed, in which case it is read from
+      // an uncompressed copy.
+      std::vector<char> DebugPartStorage;
+      const hlsl::DxilProgramHeader *pProgramHeader =
+        hlsl::GetDxilDebugProgramHeader(pContainerHeader, DebugPartStorage);
+      if (!pProgramHeader)
         return E_FAIL;
-      CComPtr<IDxcBlobEncoding> pPinnedBlob;
-      IFR(hlsl::DxcCreateBlobWithEncodingFromPinned(PartHeader+1, PartHeader->PartSize, CP_ACP, &pPinnedBlob));
+      const hlsl::DxilPartHeader *pHashPart =
+        hlsl::GetDxilPartByType(pContainerHeader, hlsl::DFCC_ShaderHash);
+      if (pHashPart && pHashPart->PartSize == sizeof(ShaderHash))
+        memcpy(&ShaderHash, hlsl::GetDxilPartData(pHashPart), sizeof(ShaderHash));
+      CComPtr<IDxcBlobEncoding> pPartBlob;
+      UINT32 uPartSize = pProgramHeader->SizeInUint32 * sizeof(UINT32);
+      if (DebugPartStorage.empty())
+        IFR(hlsl::DxcCreateBlobWithEncodingFromPinned(pProgramHeader, uPartSize, CP_ACP, &pPartBlob));
+      else
+        IFR(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(pProgramHeader, uPartSize, CP_ACP, &pPartBlob));
       pIStream.Release();
-      IFR(hlsl::CreateReadOnlyBlobStream(pPinnedBlob, &pIStream));
+      IFR(hlsl::CreateReadOnlyBlobStream(pPartBlob, &pIStream));
     }
 
     m_context.reset();
     m_finder.reset();
 
-    m_context = std::make_shared<llvm::LLVMContext>();
     llvm::MemoryBuffer *pBitcodeBuffer;
     std::unique_ptr<llvm::MemoryBuffer> pEmbeddedBuffer;
     std::unique_ptr<llvm::MemoryBuffer> pBuffer =
@@ -138,6 +154,17 @@ STDMETHODIMP dxil_dia::DataSource::loadDataFromIStream(_In_ IStream *pInputIStre
       pBitcodeBuffer = pEmbeddedBuffer.get();
     }
 
+    // Another data source may already have loaded this module.
+    DebugModuleCache &Cache = DebugModuleCache::Get();
+    DebugModule Cached;
+    if (Cache.Lookup(ShaderHash, pBitcodeBuffer->getBuffer(), &Cached)) {
+      m_context = Cached.Context;
+      m_module = Cached.Module;
+      m_finder = Cached.Finder;
+      return S_OK;
+    }
+
+    m_context = std::make_shared<llvm::LLVMContext>();
     std::string DiagStr;
     std::unique_ptr<llvm::Module> pModule = hlsl::dxilutil::LoadModuleFromBitcode(
       pBitcodeBuffer, *m_context.get(), DiagStr);
@@ -145,7 +172,19 @@ STDMETHODIMP dxil_dia::DataSource::loadDataFromIStream(_In_ IStream *pInputIStre
       return E_FAIL;
     m_finder = std::make_shared<llvm::DebugInfoFinder>();
     m_finder->processModule(*pModule.get());
+
+    // Number the instructions once here rather than in each session, so that
+    // the module is not changed after it is shared.
+    llvm::legacy::PassManager PM;
+    llvm::initializeDxilDbgValueToDbgDeclarePass(*llvm::PassRegistry::getPassRegistry());
+    llvm::initializeDxilAnnotateWithVirtualRegisterPass(*llvm::PassRegistry::getPassRegistry());
+    PM.add(llvm::createDxilDbgValueToDbgDeclarePass());
+    PM.add(llvm::createDxilAnnotateWithVirtualRegisterPass());
+    PM.run(*pModule);
+
     m_module.reset(pModule.release());
+    Cache.Insert(ShaderHash, pBitcodeBuffer->getBuffer(),
+                 { m_context, m_module, m_finder });
   }
   CATCH_CPP_RETURN_HRESULT();
   return S_OK;
@@ -159,10 +198,16 @@ STDMETHODIMP dxil_dia::DataSource::openSession(_COM_Outptr_ IDiaSession **ppSess
   CComPtr<Session> pSession = Session::Alloc(DxcGetThreadMallocNoRef());
   IFROOM(pSession.p);
   pSession->Init(m_context, m_module, m_finder);
+  pSession->SetSourceStore(m_pSourceStore);
   *ppSession = pSession.Detach();
   return S_OK;
 }
 
+STDMETHODIMP dxil_dia::DataSource::CreateDirectorySourceStore(
+    _In_z_ LPCWSTR pDirectory, _COM_Outptr_ IDxcSourceStore **ppStore) {
+  DxcThreadMalloc TM(m_pMalloc);
+  return hlsl::CreateDirectorySourceStore(m_pMalloc, pDirectory, ppStore);
+}
 
 HRESULT CreateDxcDiaDataSource(_In_ REFIID riid, _Out_ LPVOID* ppv) {
   CComPtr<dxil_dia::DataSource> result = CreateOnMalloc<dxil_dia::DataSource>(DxcGetThreadMallocNoRef());
@@ -19,6 +19,7 @@
 
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/Support/Global.h"
+#include "dxc/dxcapi.h"
 
 #include "DxilDia.h"
 #include "DxilDiaTable.h"
@@ -26,18 +27,20 @@
 namespace dxil_dia {
 class Session;
 
-class DataSource : public IDiaDataSource {
+class DataSource : public IDiaDataSource, public IDxcSourceStoreSupport {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   std::shared_ptr<llvm::Module> m_module;
   std::shared_ptr<llvm::LLVMContext> m_context;
   std::shared_ptr<llvm::DebugInfoFinder> m_finder;
+  CComPtr<IDxcSourceStore> m_pSourceStore;
 
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
 
   STDMETHODIMP QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDiaDataSource>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDiaDataSource, IDxcSourceStoreSupport>(
+        this, iid, ppvObject);
   }
 
   DataSource(IMalloc *pMalloc);
@@ -79,6 +82,16 @@ public:
     _In_ DWORD cbMiscInfo,
     _In_ BYTE *pbMiscInfo,
     _In_ IUnknown *pCallback) override { return ENotImpl(); }
+
+  // IDxcSourceStoreSupport. The store applies to sessions opened afterwards.
+  STDMETHODIMP SetSourceStore(_In_opt_ IDxcSourceStore *pStore) override {
+    m_pSourceStore = pStore;
+    return S_OK;
+  }
+
+  STDMETHODIMP CreateDirectorySourceStore(
+    _In_z_ LPCWSTR pDirectory,
+    _COM_Outptr_ IDxcSourceStore **ppStore) override;
 };
 
 }  // namespace dxil_dia
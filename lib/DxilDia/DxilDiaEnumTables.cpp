@@ -38,14 +38,18 @@ STDMETHODIMP dxil_dia::EnumTables::Item(
   if (indexVal > (unsigned)Table::LastKind) {
     return E_INVALIDARG;
   }
-  HRESULT hr = S_OK;
-  if (!m_tables[indexVal]) {
+  return GetTable(indexVal, table);
+}
+
+HRESULT dxil_dia::EnumTables::GetTable(unsigned kind, IDiaTable **ppTable) {
+  std::lock_guard<std::mutex> lock(m_tablesLock);
+  if (!m_tables[kind]) {
     DxcThreadMalloc TM(m_pMalloc);
-    hr = Table::Create(m_pSession, (Table::Kind)indexVal, &m_tables[indexVal]);
+    IFR(Table::Create(m_pSession, (Table::Kind)kind, &m_tables[kind]));
   }
-  m_tables[indexVal].p->AddRef();
-  *table = m_tables[indexVal];
-  return hr;
+  m_tables[kind].p->AddRef();
+  *ppTable = m_tables[kind];
+  return S_OK;
 }
 
 STDMETHODIMP dxil_dia::EnumTables::Next(
@@ -55,16 +59,10 @@ STDMETHODIMP dxil_dia::EnumTables::Next(
   DxcThreadMalloc TM(m_pMalloc);
   ULONG fetched = 0;
   while (fetched < celt && m_next <= (unsigned)Table::LastKind) {
-    HRESULT hr = S_OK;
-    if (!m_tables[m_next]) {
-      DxcThreadMalloc TM(m_pMalloc);
-      hr = Table::Create(m_pSession, (Table::Kind)m_next, &m_tables[m_next]);
-      if (FAILED(hr)) {
-        return hr; // TODO: this leaks prior tables.
-      }
+    HRESULT hr = GetTable(m_next, &rgelt[fetched]);
+    if (FAILED(hr)) {
+      return hr; // TODO: this leaks prior tables.
     }
-    m_tables[m_next].p->AddRef();
-    rgelt[fetched] = m_tables[m_next];
     ++m_next, ++fetched;
   }
   if (pceltFetched != nullptr)
@@ -14,6 +14,7 @@
 #include "dxc/Support/WinIncludes.h"
 
 #include <array>
+#include <mutex>
 
 #include "dia2.h"
 
@@ -70,6 +71,12 @@ public:
   static HRESULT Create(Session *pSession,
                         IDiaEnumTables **ppEnumTables);
 private:
+  // Creates the table of the given kind on first use.
+  HRESULT GetTable(unsigned kind, IDiaTable **ppTable);
+
+  // The session shares this object among its callers, so tables are created
+  // under a lock.
+  std::mutex m_tablesLock;
   std::array<CComPtr<IDiaTable>, (int)Table::LastKind+1> m_tables;
 };
 
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilDiaModuleCache.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Shares parsed debug modules between DIA data sources.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DxilDiaModuleCache.h"
+
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+dxil_dia::DebugModuleCache &dxil_dia::DebugModuleCache::Get() {
+  static DebugModuleCache s_cache;
+  return s_cache;
+}
+
+std::string
+dxil_dia::DebugModuleCache::MakeKey(const hlsl::DxilShaderHash &ShaderHash,
+                                    llvm::StringRef DebugBitcode) {
+  uint8_t DebugDigest[hlsl::DxilContainerHashSize];
+  hlsl::ComputeFastShaderHash(DebugBitcode.data(), DebugBitcode.size(),
+                              DebugDigest);
+  uint64_t DebugSize = DebugBitcode.size();
+
+  std::string Key;
+  Key.append((const char *)&ShaderHash, sizeof(ShaderHash));
+  Key.append((const char *)DebugDigest, sizeof(DebugDigest));
+  Key.append((const char *)&DebugSize, sizeof(DebugSize));
+  return Key;
+}
+
+bool dxil_dia::DebugModuleCache::Lookup(const hlsl::DxilShaderHash &ShaderHash,
+                                        llvm::StringRef DebugBitcode,
+                                        DebugModule *pModule) {
+  std::string Key = MakeKey(ShaderHash, DebugBitcode);
+  std::lock_guard<std::mutex> Lock(m_mutex);
+  auto It = m_index.find(Key);
+  if (It == m_index.end())
+    return false;
+
+  Entry &E = *It->second;
+  // Once only the cache holds a module, new references to it are made here,
+  // under the lock; so a stale count can only make this miss.
+  bool InUse = E.Module.Module.use_count() > 1;
+  std::thread::id ThisThread = std::this_thread::get_id();
+  if (InUse && E.Owner != ThisThread)
+    return false;
+
+  E.Owner = ThisThread;
+  m_entries.splice(m_entries.begin(), m_entries, It->second);
+  *pModule = E.Module;
+  return true;
+}
+
+void dxil_dia::DebugModuleCache::Insert(const hlsl::DxilShaderHash &ShaderHash,
+                                        llvm::StringRef DebugBitcode,
+                                        const DebugModule &Module) {
+  size_t Size = DebugBitcode.size();
+  std::string Key = MakeKey(ShaderHash, DebugBitcode);
+  std::lock_guard<std::mutex> Lock(m_mutex);
+  if (Size > m_maxBytes || m_index.count(Key))
+    return;
+
+  m_entries.push_front({Key, Module, Size, std::this_thread::get_id()});
+  m_index[Key] = m_entries.begin();
+  m_totalBytes += Size;
+  EvictToFit();
+}
+
+void dxil_dia::DebugModuleCache::SetMaxBytes(size_t MaxBytes) {
+  std::lock_guard<std::mutex> Lock(m_mutex);
+  m_maxBytes = MaxBytes;
+  EvictToFit();
+}
+
+void dxil_dia::DebugModuleCache::Clear() {
+  std::lock_guard<std::mutex> Lock(m_mutex);
+  m_index.clear();
+  m_entries.clear();
+  m_totalBytes = 0;
+}
+
+void dxil_dia::DebugModuleCache::EvictToFit() {
+  while (m_totalBytes > m_maxBytes && !m_entries.empty()) {
+    Entry &E = m_entries.back();
+    m_totalBytes -= E.Size;
+    m_index.erase(E.Key);
+    m_entries.pop_back();
+  }
+}
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilDiaModuleCache.h                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Shares parsed debug modules between DIA data sources.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class DebugInfoFinder;
+class LLVMContext;
+class Module;
+} // namespace llvm
+
+namespace dxil_dia {
+
+// A debug module as loaded for DIA: parsed, annotated with instruction
+// numbers, and scanned for debug info. Nothing may change it once it is in
+// the cache.
+struct DebugModule {
+  std::shared_ptr<llvm::LLVMContext> Context;
+  std::shared_ptr<llvm::Module> Module;
+  std::shared_ptr<llvm::DebugInfoFinder> Finder;
+};
+
+// Process-wide cache of debug modules, keyed on the container's shader hash
+// and a digest of the debug bitcode itself. The shader hash alone does not
+// cover the debug info unless it was computed with source, so both are used.
+//
+// Each holder of a module (data source, session) keeps shared_ptrs to it, so
+// dropping an entry never frees a module that is still open. The cache stays
+// under a cap on the total size of the cached bitcode by dropping the least
+// recently used entries.
+//
+// An LLVMContext is not thread-safe, so a module is handed out again only
+// to the thread already using it, or to any thread once no one else has it
+// open.
+class DebugModuleCache {
+public:
+  static constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+
+  static DebugModuleCache &Get();
+
+  // Returns true and sets *pModule if a module for the key can be shared
+  // with the calling thread.
+  bool Lookup(const hlsl::DxilShaderHash &ShaderHash,
+              llvm::StringRef DebugBitcode, DebugModule *pModule);
+  void Insert(const hlsl::DxilShaderHash &ShaderHash,
+              llvm::StringRef DebugBitcode, const DebugModule &Module);
+
+  void SetMaxBytes(size_t MaxBytes);
+  void Clear();
+
+private:
+  struct Entry {
+    std::string Key;
+    DebugModule Module;
+    size_t Size;
+    std::thread::id Owner;
+  };
+  typedef std::list<Entry> EntryList;
+
+  static std::string MakeKey(const hlsl::DxilShaderHash &ShaderHash,
+                             llvm::StringRef DebugBitcode);
+  void EvictToFit();
+
+  std::mutex m_mutex;
+  EntryList m_entries; // most recently used first
+  llvm::StringMap<EntryList::iterator> m_index;
+  size_t m_totalBytes = 0;
+  size_t m_maxBytes = kDefaultMaxBytes;
+};
+
+} // namespace dxil_dia
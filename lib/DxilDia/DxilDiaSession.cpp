@@ -11,17 +11,17 @@
 
 #include "DxilDiaSession.h"
 
-#include "dxc/DxilPIXPasses/DxilPIXPasses.h"
+#include <algorithm>
+
 #include "dxc/DxilPIXPasses/DxilPIXVirtualRegisters.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/LegacyPassManager.h"
-#include "llvm/PassRegistry.h"
 
 #include "DxilDia.h"
 #include "DxilDiaEnumTables.h"
@@ -41,13 +41,6 @@ void dxil_dia::Session::Init(
   m_finder = finder;
   m_dxilModule = llvm::make_unique<hlsl::DxilModule>(mod.get());
 
-  llvm::legacy::PassManager PM;
-  llvm::initializeDxilDbgValueToDbgDeclarePass(*llvm::PassRegistry::getPassRegistry());
-  llvm::initializeDxilAnnotateWithVirtualRegisterPass(*llvm::PassRegistry::getPassRegistry());
-  PM.add(llvm::createDxilDbgValueToDbgDeclarePass());
-  PM.add(llvm::createDxilAnnotateWithVirtualRegisterPass());
-  PM.run(*m_module);
-
   // Extract HLSL metadata.
   m_dxilModule->LoadDxilMetadata();
 
@@ -71,6 +64,17 @@ void dxil_dia::Session::Init(
     m_module->getNamedMetadata(hlsl::DxilMDHelper::kDxilSourceArgsMDName);
   if (!m_arguments)
     m_arguments = m_module->getNamedMetadata("llvm.dbg.args");
+}
+
+// Each index is checked once without the lock, so that queries on a built
+// session don't contend, and again under it, since another thread may have
+// built it in between. The flag is set only once the index is complete.
+void dxil_dia::Session::BuildInstructionMaps() {
+  if (m_instructionMapsBuilt.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::recursive_mutex> lock(m_buildLock);
+  if (m_instructionMapsBuilt.load(std::memory_order_relaxed))
+    return;
 
   // Build up a linear list of instructions. The index will be used as the
   // RVA.
@@ -99,33 +103,113 @@ void dxil_dia::Session::Init(
     DXASSERT(m_rvaMap.find(It->second) != m_rvaMap.end(), "instruction not mapped to rva");
     DXASSERT(m_rvaMap[It->second] == It->first, "instruction mapped to wrong rva");
   }
+  m_instructionMapsBuilt.store(true, std::memory_order_release);
+}
+
+void dxil_dia::Session::BuildSourceLineIndex() {
+  if (m_sourceLineIndexBuilt.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::recursive_mutex> lock(m_buildLock);
+  if (m_sourceLineIndexBuilt.load(std::memory_order_relaxed))
+    return;
+
+  for (const llvm::Instruction *inst : InstructionLinesRef()) {
+    const llvm::DebugLoc &DL = inst->getDebugLoc();
+    llvm::DIFile *pFile = nullptr;
+    llvm::MDNode *pScope = DL.getScope();
+    if (auto *pBlock = llvm::dyn_cast_or_null<llvm::DILexicalBlock>(pScope))
+      pFile = pBlock->getFile();
+    else if (auto *pSubProgram = llvm::dyn_cast_or_null<llvm::DISubprogram>(pScope))
+      pFile = pSubProgram->getFile();
+    DWORD fileId;
+    if (pFile == nullptr ||
+        getSourceFileIdByName(pFile->getFilename(), &fileId) != S_OK) {
+      continue;
+    }
+    m_sourceLineIndex.push_back({ fileId, DL.getLine(), inst });
+  }
+
+  // Stable, so that the instructions of each line stay in RVA order.
+  std::stable_sort(m_sourceLineIndex.begin(), m_sourceLineIndex.end(),
+                   [](const SourceLineEntry &a, const SourceLineEntry &b) {
+                     return std::make_pair(a.FileId, a.Line) <
+                            std::make_pair(b.FileId, b.Line);
+                   });
+  m_sourceLineIndexBuilt.store(true, std::memory_order_release);
+}
 
-  // Initialize symbols
+const dxil_dia::SymbolManager &dxil_dia::Session::SymMgr() {
+  if (m_symsMgrBuilt.load(std::memory_order_acquire))
+    return m_symsMgr;
+  std::lock_guard<std::recursive_mutex> lock(m_buildLock);
+  // Building the symbols may look them up through the session, on this
+  // thread, and gets the symbols built so far.
+  if (m_symsMgrBuilt.load(std::memory_order_relaxed) || m_symsMgrBuilding)
+    return m_symsMgr;
+  m_symsMgrBuilding = true;
   try {
       m_symsMgr.Init(this);
   } catch (const hlsl::Exception &) {
       m_symsMgr = std::move(dxil_dia::SymbolManager());
   }
+  m_symsMgrBuilding = false;
+  m_symsMgrBuilt.store(true, std::memory_order_release);
+  return m_symsMgr;
 }
 
-HRESULT dxil_dia::Session::getSourceFileIdByName(
-    llvm::StringRef fileName,
-    DWORD *pRetVal) {
+void dxil_dia::Session::BuildFileNameToId() {
+  if (m_fileNameToIdBuilt.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::recursive_mutex> lock(m_buildLock);
+  if (m_fileNameToIdBuilt.load(std::memory_order_relaxed))
+    return;
   if (Contents() != nullptr) {
     for (unsigned i = 0; i < Contents()->getNumOperands(); ++i) {
       llvm::StringRef fn =
         llvm::dyn_cast<llvm::MDString>(Contents()->getOperand(i)->getOperand(0))
         ->getString();
-      if (fn.equals(fileName)) {
-        *pRetVal = i;
-        return S_OK;
-      }
+      // Keep the first file of each name.
+      m_fileNameToId.insert(std::make_pair(fn, i));
     }
   }
+  m_fileNameToIdBuilt.store(true, std::memory_order_release);
+}
+
+HRESULT dxil_dia::Session::getSourceFileIdByName(
+    llvm::StringRef fileName,
+    DWORD *pRetVal) {
+  BuildFileNameToId();
+  auto It = m_fileNameToId.find(fileName);
+  if (It != m_fileNameToId.end()) {
+    *pRetVal = It->second;
+    return S_OK;
+  }
   *pRetVal = 0;
   return S_FALSE;
 }
 
+llvm::StringRef dxil_dia::Session::SourceContent(unsigned index) {
+  llvm::MDNode *node = Contents()->getOperand(index);
+  llvm::StringRef text =
+      llvm::cast<llvm::MDString>(node->getOperand(1))->getString();
+  // Included files may be stored by digest as {name, "", digest}.
+  if (node->getNumOperands() < 3 || !m_pSourceStore)
+    return text;
+  // A loaded blob stays in the map for the life of the session, so the text
+  // can be used after the lock is released.
+  std::lock_guard<std::mutex> lock(m_loadedSourcesLock);
+  CComPtr<IDxcBlob> &pBlob = m_loadedSources[index];
+  if (!pBlob) {
+    std::string digest =
+        llvm::cast<llvm::MDString>(node->getOperand(2))->getString();
+    CA2W digestW(digest.c_str(), CP_UTF8);
+    if (FAILED(m_pSourceStore->LoadSource(digestW, &pBlob)) || !pBlob)
+      return text;
+  }
+  return llvm::StringRef((const char *)pBlob->GetBufferPointer(),
+                         pBlob->GetBufferSize());
+}
+
 STDMETHODIMP dxil_dia::Session::get_loadAddress(
     /* [retval][out] */ ULONGLONG *pRetVal) {
   *pRetVal = 0;
@@ -142,13 +226,14 @@ STDMETHODIMP dxil_dia::Session::get_globalScope(
   *pRetVal = nullptr;
 
   Symbol *ret;
-  IFR(m_symsMgr.GetGlobalScope(&ret));
+  IFR(SymMgr().GetGlobalScope(&ret));
   *pRetVal = ret;
   return S_OK;
 }
 
 STDMETHODIMP dxil_dia::Session::getEnumTables(
     /* [out] */ _COM_Outptr_ IDiaEnumTables **ppEnumTables) {
+  std::lock_guard<std::mutex> lock(m_enumTablesLock);
   if (!m_pEnumTables) {
     DxcThreadMalloc TM(m_pMalloc);
     IFR(EnumTables::Create(this, &m_pEnumTables));
@@ -158,17 +243,23 @@ STDMETHODIMP dxil_dia::Session::getEnumTables(
   return S_OK;
 }
 
+CComPtr<IDiaEnumTables> dxil_dia::Session::EnumTablesIfCreated() {
+  std::lock_guard<std::mutex> lock(m_enumTablesLock);
+  return m_pEnumTables;
+}
+
 STDMETHODIMP dxil_dia::Session::findFileById(
     /* [in] */ DWORD uniqueId,
     /* [out] */ IDiaSourceFile **ppResult) {
-  if (!m_pEnumTables) {
+  CComPtr<IDiaEnumTables> pEnumTables = EnumTablesIfCreated();
+  if (!pEnumTables) {
     return E_INVALIDARG;
   }
   CComPtr<IDiaTable> pTable;
   VARIANT vtIndex;
   vtIndex.vt = VT_UI4;
   vtIndex.uintVal = (int)Table::Kind::SourceFiles;
-  IFR(m_pEnumTables->Item(vtIndex, &pTable));
+  IFR(pEnumTables->Item(vtIndex, &pTable));
   CComPtr<IUnknown> pElt;
   IFR(pTable->Item(uniqueId, &pElt));
   return pElt->QueryInterface(ppResult);
@@ -179,7 +270,8 @@ STDMETHODIMP dxil_dia::Session::findFile(
     /* [in] */ LPCOLESTR name,
     /* [in] */ DWORD compareFlags,
     /* [out] */ IDiaEnumSourceFiles **ppResult) {
-    if (!m_pEnumTables) {
+    CComPtr<IDiaEnumTables> pEnumTables = EnumTablesIfCreated();
+    if (!pEnumTables) {
         return E_INVALIDARG;
     }
     
@@ -194,7 +286,7 @@ STDMETHODIMP dxil_dia::Session::findFile(
     VARIANT vtIndex;
     vtIndex.vt = VT_UI4;
     vtIndex.uintVal = (int)Table::Kind::SourceFiles;
-    IFR(m_pEnumTables->Item(vtIndex, &pTable));
+    IFR(pEnumTables->Item(vtIndex, &pTable));
 
     CComPtr<IDiaEnumSourceFiles> pSourceTable;
     IFR(pTable->QueryInterface(&pSourceTable));
@@ -293,49 +385,30 @@ STDMETHODIMP dxil_dia::Session::findLinesByLinenum(
   /* [in] */ DWORD linenum,
   /* [in] */ DWORD column,
   /* [out] */ IDiaEnumLineNumbers **ppResult) {
-    if (!m_pEnumTables) {
+    if (file == nullptr || ppResult == nullptr) {
         return E_INVALIDARG;
     }
     *ppResult = nullptr;
 
     DxcThreadMalloc TM(m_pMalloc);
-    CComPtr<IDiaTable> pTable;
-    VARIANT vtIndex;
-    vtIndex.vt = VT_UI4;
-    vtIndex.uintVal = (int)Table::Kind::LineNumbers;
-    IFR(m_pEnumTables->Item(vtIndex, &pTable));
+    DWORD fileId;
+    IFR(file->get_uniqueId(&fileId));
 
-    CComPtr<IDiaEnumLineNumbers> pLineTable;
-    IFR(pTable->QueryInterface(&pLineTable));
-    HRESULT hr;
-    CComPtr<IDiaLineNumber> line;
-    ULONG cnt;
+    // Line entries span a single line and column, so a column never falls
+    // strictly inside one.
     std::vector<const llvm::Instruction *> lines;
-
-    std::function<bool(DWORD, DWORD)>column_matches = [column](DWORD colStart, DWORD colEnd) -> bool {
-        return true;
-    };
-
-    if (column != 0) {
-        column_matches = [column](DWORD colStart, DWORD colEnd) -> bool {
-            return colStart < column && column < colEnd;
-        };
-    }
-
-    pLineTable->Reset();
-    while (SUCCEEDED(hr = pLineTable->Next(1, &line, &cnt)) && hr == S_OK && cnt == 1) {
-        CComPtr<IDiaSourceFile> f;
-        DWORD ln, lnEnd, cn, cnEnd;
-        IFR(line->get_lineNumber(&ln));
-        IFR(line->get_lineNumberEnd(&lnEnd));
-        IFR(line->get_columnNumber(&cn));
-        IFR(line->get_columnNumberEnd(&cnEnd));
-        IFR(line->get_sourceFile(&f));
-        
-        if (file == f && (ln <= linenum && linenum <= lnEnd) && column_matches(cn, cnEnd)) {
-            lines.emplace_back(reinterpret_cast<LineNumber*>(line.p)->Inst());
+    if (column == 0) {
+        BuildSourceLineIndex();
+        SourceLineEntry key = { fileId, linenum, nullptr };
+        auto range = std::equal_range(
+            m_sourceLineIndex.begin(), m_sourceLineIndex.end(), key,
+            [](const SourceLineEntry &a, const SourceLineEntry &b) {
+                return std::make_pair(a.FileId, a.Line) <
+                       std::make_pair(b.FileId, b.Line);
+            });
+        for (auto It = range.first; It != range.second; ++It) {
+            lines.emplace_back(It->Inst);
         }
-        line.Release();
     }
 
     HRESULT result = lines.empty() ? S_FALSE : S_OK;
@@ -388,7 +461,7 @@ STDMETHODIMP dxil_dia::Session::findInlineFramesByAddr(
 
   HRESULT hr;
   SymbolChildrenEnumerator *ChildrenEnum;
-  IFR(hr = m_symsMgr.DbgScopeOf(It->second, &ChildrenEnum));
+  IFR(hr = SymMgr().DbgScopeOf(It->second, &ChildrenEnum));
 
   *ppResult = ChildrenEnum;
   return hr;
@@ -13,15 +13,19 @@
 
 #include "dxc/Support/WinIncludes.h"
 
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
 #include "dia2.h"
 
+#include "dxc/dxcapi.h"
 #include "dxc/dxcpix.h"
 #include "dxc/DXIL/DxilModule.h"
+#include "llvm/ADT/StringMap.h"
 
 #include "dxc/Support/Global.h"
 #include "dxc/Support/microcom.h"
@@ -55,19 +59,29 @@ public:
   void Init(std::shared_ptr<llvm::LLVMContext> context,
             std::shared_ptr<llvm::Module> mod,
             std::shared_ptr<llvm::DebugInfoFinder> finder);
+  void SetSourceStore(IDxcSourceStore *pSourceStore) {
+    m_pSourceStore = pSourceStore;
+  }
 
   llvm::NamedMDNode *Contents() { return m_contents; }
+  // The text of source file index. Files stored by digest are loaded from
+  // the source store on first use; without one their text is empty.
+  llvm::StringRef SourceContent(unsigned index);
   llvm::NamedMDNode *Defines() { return m_defines; }
   llvm::NamedMDNode *MainFileName() { return m_mainFileName; }
   llvm::NamedMDNode *Arguments() { return m_arguments; }
   hlsl::DxilModule &DxilModuleRef() { return *m_dxilModule.get(); }
   llvm::Module &ModuleRef() { return *m_module.get(); }
   llvm::DebugInfoFinder &InfoRef() { return *m_finder.get(); }
-  const SymbolManager &SymMgr() const { return m_symsMgr; }
-  const RVAMap &InstructionsRef() const { return m_instructions; }
-  const std::vector<const llvm::Instruction *> &InstructionLinesRef() const { return m_instructionLines; }
-  const std::unordered_map<const llvm::Instruction *, RVA> &RvaMapRef() const { return m_rvaMap; }
-  const LineToInfoMap &LineToColumnStartMapRef() const { return m_lineToInfoMap; }
+  // The instruction maps, the source line index and the symbols are built on
+  // first use rather than in Init, so that opening a session stays cheap.
+  // Each is published once built, so a session may be queried from several
+  // threads at once.
+  const SymbolManager &SymMgr();
+  const RVAMap &InstructionsRef() { BuildInstructionMaps(); return m_instructions; }
+  const std::vector<const llvm::Instruction *> &InstructionLinesRef() { BuildInstructionMaps(); return m_instructionLines; }
+  const std::unordered_map<const llvm::Instruction *, RVA> &RvaMapRef() { BuildInstructionMaps(); return m_rvaMap; }
+  const LineToInfoMap &LineToColumnStartMapRef() { BuildInstructionMaps(); return m_lineToInfoMap; }
 
   HRESULT getSourceFileIdByName(llvm::StringRef fileName, DWORD *pRetVal);
 
@@ -383,6 +397,18 @@ public:
       _COM_Outptr_ IDxcPixCompilationInfo **ppCompilationInfo) override;
 
 private:
+  // Instruction with line info, keyed by the id of its source file.
+  struct SourceLineEntry {
+    DWORD FileId;
+    std::uint32_t Line;
+    const llvm::Instruction *Inst;
+  };
+
+  void BuildInstructionMaps();
+  void BuildSourceLineIndex();
+  void BuildFileNameToId();
+  CComPtr<IDiaEnumTables> EnumTablesIfCreated();
+
   DXC_MICROCOM_TM_REF_FIELDS()
   std::shared_ptr<llvm::LLVMContext> m_context;
   std::shared_ptr<llvm::Module> m_module;
@@ -396,9 +422,24 @@ private:
   std::vector<const llvm::Instruction *> m_instructionLines; // Instructions with line info.
   std::unordered_map<const llvm::Instruction *, RVA> m_rvaMap; // Map instruction to its RVA.
   LineToInfoMap m_lineToInfoMap;
+  // Held while building any of the indexes below; recursive because building
+  // one uses the others.
+  std::recursive_mutex m_buildLock;
+  std::atomic<bool> m_instructionMapsBuilt{false};
+  // Sorted by file id and line, then by RVA.
+  std::vector<SourceLineEntry> m_sourceLineIndex;
+  std::atomic<bool> m_sourceLineIndexBuilt{false};
+  llvm::StringMap<DWORD> m_fileNameToId;
+  std::atomic<bool> m_fileNameToIdBuilt{false};
   SymbolManager m_symsMgr;
+  std::atomic<bool> m_symsMgrBuilt{false};
+  bool m_symsMgrBuilding = false; // Guarded by m_buildLock.
+  CComPtr<IDxcSourceStore> m_pSourceStore;
+  std::mutex m_loadedSourcesLock;
+  std::unordered_map<unsigned, CComPtr<IDxcBlob>> m_loadedSources;
 
 private:
+  std::mutex m_enumTablesLock;
   CComPtr<IDiaEnumTables> m_pEnumTables;
 };
 }  // namespace dxil_dia
@@ -54,6 +54,7 @@ dxil_dia::SourceFilesTable::SourceFilesTable(
 }
 
 HRESULT dxil_dia::SourceFilesTable::GetItem(DWORD index, IDiaSourceFile **ppItem) {
+  std::lock_guard<std::mutex> lock(m_itemsLock);
   if (!m_items[index]) {
     m_items[index] = CreateOnMalloc<SourceFile>(m_pMalloc, m_pSession, index);
     if (m_items[index] == nullptr)
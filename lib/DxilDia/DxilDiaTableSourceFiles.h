@@ -13,6 +13,7 @@
 
 #include "dxc/Support/WinIncludes.h"
 
+#include <mutex>
 #include <vector>
 
 #include "dia2.h"
@@ -75,6 +76,8 @@ public:
   HRESULT GetItem(DWORD index, IDiaSourceFile **ppItem) override;
 
 private:
+  // Items are created on first use, and the session's table is shared.
+  std::mutex m_itemsLock;
   std::vector<CComPtr<IDiaSourceFile>> m_items;
 };
 
@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilBlockCounters.cpp                                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a pass to count how often each basic block runs. Used by PIX.    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilUtil.h"
+#include "dxc/DxilPIXPasses/DxilPIXPasses.h"
+#include "dxc/DxilPIXPasses/DxilPIXVirtualRegisters.h"
+#include "dxc/HLSL/DxilGenerationPass.h"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Each basic block of the entry function gets a uint32 counter in an added
+// UAV, at byte offset 4 * (counter index). When a block starts, the first
+// active lane of the wave adds the number of active lanes to the block's
+// counter, so there is one atomic per wave rather than one per lane.
+//
+// The pass reports the counters with OSOverride as
+//   BlockCounters=<counter index>:<instruction number>;...
+// where the instruction number is that of the block's first instruction, as
+// annotated by hlsl-dxil-annotate-with-virtual-regs, which must run first.
+// IDxcPixDxilBlockProfile maps these instruction numbers back to source.
+
+class DxilBlockCounters : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilBlockCounters() : ModulePass(ID) {}
+  const char *getPassName() const override {
+    return "DXIL basic block counters";
+  }
+  bool runOnModule(Module &M) override;
+
+private:
+  CallInst *addUAV(DxilModule &DM, IRBuilder<> &Builder);
+  void addCounter(DxilModule &DM, BasicBlock &BB, unsigned CounterIndex);
+
+  CallInst *m_HandleForUAV = nullptr;
+};
+
+CallInst *DxilBlockCounters::addUAV(DxilModule &DM, IRBuilder<> &Builder) {
+  LLVMContext &Ctx = DM.GetCtx();
+  OP *HlslOP = DM.GetOP();
+
+  // Set up a UAV with structure of a single int
+  unsigned int UAVResourceHandle =
+      static_cast<unsigned int>(DM.GetUAVs().size());
+  SmallVector<llvm::Type *, 1> Elements{Type::getInt32Ty(Ctx)};
+  llvm::StructType *UAVStructTy =
+      llvm::StructType::create(Elements, "PIX_BlockCountersUAV_Type");
+  std::unique_ptr<DxilResource> pUAV = llvm::make_unique<DxilResource>();
+  pUAV->SetGlobalName("PIX_BlockCountersUAVName");
+  pUAV->SetGlobalSymbol(UndefValue::get(UAVStructTy->getPointerTo()));
+  pUAV->SetID(UAVResourceHandle);
+  pUAV->SetSpaceID(
+      (unsigned int)-2); // This is the reserved-for-tools register space
+  pUAV->SetSampleCount(1);
+  pUAV->SetGloballyCoherent(false);
+  pUAV->SetHasCounter(false);
+  pUAV->SetCompType(CompType::getI32());
+  pUAV->SetLowerBound(0);
+  pUAV->SetRangeSize(1);
+  pUAV->SetKind(DXIL::ResourceKind::RawBuffer);
+  pUAV->SetRW(true);
+
+  auto ID = DM.AddUAV(std::move(pUAV));
+  assert(ID == UAVResourceHandle);
+
+  DM.m_ShaderFlags.SetEnableRawAndStructuredBuffers(true);
+
+  // Create handle for the newly-added UAV
+  Function *CreateHandleOpFunc =
+      HlslOP->GetOpFunc(DXIL::OpCode::CreateHandle, Type::getVoidTy(Ctx));
+  Constant *CreateHandleOpcodeArg =
+      HlslOP->GetU32Const((unsigned)DXIL::OpCode::CreateHandle);
+  Constant *UAVVArg = HlslOP->GetI8Const(
+      static_cast<std::underlying_type<DxilResourceBase::Class>::type>(
+          DXIL::ResourceClass::UAV));
+  Constant *MetaDataArg = HlslOP->GetU32Const(
+      ID); // position of the metadata record in the corresponding metadata list
+  Constant *IndexArg = HlslOP->GetU32Const(0); //
+  Constant *FalseArg =
+      HlslOP->GetI1Const(0); // non-uniform resource index: false
+  return Builder.CreateCall(
+      CreateHandleOpFunc,
+      {CreateHandleOpcodeArg, UAVVArg, MetaDataArg, IndexArg, FalseArg},
+      "PIX_BlockCountersUAV_Handle");
+}
+
+void DxilBlockCounters::addCounter(DxilModule &DM, BasicBlock &BB,
+                                   unsigned CounterIndex) {
+  LLVMContext &Ctx = DM.GetCtx();
+  OP *HlslOP = DM.GetOP();
+
+  Instruction *InsertPt = BB.getFirstInsertionPt();
+  if (&BB == &BB.getParent()->getEntryBlock()) {
+    // Count after the UAV handle has been created.
+    InsertPt = m_HandleForUAV->getNextNode();
+  }
+  IRBuilder<> Builder(InsertPt);
+
+  Function *BitCountFunc =
+      HlslOP->GetOpFunc(OP::OpCode::WaveAllBitCount, Type::getVoidTy(Ctx));
+  Constant *BitCountOpcode =
+      HlslOP->GetU32Const((unsigned)OP::OpCode::WaveAllBitCount);
+  auto ActiveLanes = Builder.CreateCall(
+      BitCountFunc, {BitCountOpcode, HlslOP->GetI1Const(1)}, "ActiveLanes");
+
+  Function *IsFirstLaneFunc =
+      HlslOP->GetOpFunc(OP::OpCode::WaveIsFirstLane, Type::getVoidTy(Ctx));
+  Constant *IsFirstLaneOpcode =
+      HlslOP->GetU32Const((unsigned)OP::OpCode::WaveIsFirstLane);
+  auto IsFirstLane =
+      Builder.CreateCall(IsFirstLaneFunc, {IsFirstLaneOpcode}, "IsFirstLane");
+
+  TerminatorInst *Then =
+      SplitBlockAndInsertIfThen(IsFirstLane, InsertPt, false);
+  Builder.SetInsertPoint(Then);
+
+  Function *AtomicOpFunc =
+      HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(Ctx));
+  Constant *AtomicBinOpcode =
+      HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
+  Constant *AtomicAdd = HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add);
+  Constant *OffsetArg =
+      HlslOP->GetU32Const(CounterIndex * static_cast<unsigned>(sizeof(uint32_t)));
+  UndefValue *UndefArg = UndefValue::get(Type::getInt32Ty(Ctx));
+
+  (void)Builder.CreateCall(
+      AtomicOpFunc,
+      {
+          AtomicBinOpcode, // i32, ; opcode
+          m_HandleForUAV,  // %dx.types.Handle, ; resource handle
+          AtomicAdd,   // i32, ; binary operation code : EXCHANGE, IADD, AND,
+                       // OR, XOR, IMIN, IMAX, UMIN, UMAX
+          OffsetArg,   // i32, ; coordinate c0: index in bytes
+          UndefArg,    // i32, ; coordinate c1 (unused)
+          UndefArg,    // i32, ; coordinate c2 (unused)
+          ActiveLanes, // i32); increment value
+      },
+      "BlockCount");
+}
+
+bool DxilBlockCounters::runOnModule(Module &M) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  Function *EntryFunction = DM.GetEntryFunction();
+  if (EntryFunction == nullptr) {
+    return false;
+  }
+
+  // Find each block's first instruction number before the blocks are split.
+  struct BlockAndInstNum {
+    BasicBlock *BB;
+    std::uint32_t InstNum;
+  };
+  std::vector<BlockAndInstNum> Blocks;
+  for (BasicBlock &BB : *EntryFunction) {
+    std::uint32_t InstNum = UINT32_MAX;
+    for (Instruction &I : BB) {
+      if (pix_dxil::PixDxilInstNum::FromInst(&I, &InstNum)) {
+        break;
+      }
+    }
+    Blocks.push_back({&BB, InstNum});
+  }
+
+  IRBuilder<> Builder(dxilutil::FirstNonAllocaInsertionPt(EntryFunction));
+  m_HandleForUAV = addUAV(DM, Builder);
+
+  for (unsigned CounterIndex = 0; CounterIndex < Blocks.size();
+       ++CounterIndex) {
+    addCounter(DM, *Blocks[CounterIndex].BB, CounterIndex);
+  }
+
+  DM.m_ShaderFlags.SetWaveOps(true);
+  DM.ReEmitDxilResources();
+
+  if (OSOverride != nullptr) {
+    formatted_raw_ostream FOS(*OSOverride);
+    FOS << "BlockCounters=";
+    for (unsigned CounterIndex = 0; CounterIndex < Blocks.size();
+         ++CounterIndex) {
+      FOS << CounterIndex << ':' << Blocks[CounterIndex].InstNum << ';';
+    }
+    FOS << ".";
+  }
+
+  return true;
+}
+
+char DxilBlockCounters::ID = 0;
+
+ModulePass *llvm::createDxilBlockCountersPass() {
+  return new DxilBlockCounters();
+}
+
+INITIALIZE_PASS(DxilBlockCounters, "hlsl-dxil-pix-block-counters",
+                "DXIL basic block counters for PIX", false, false)
@@ -12,11 +12,15 @@
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilUtil.h"
+#include "dxc/DxilPIXPasses/DxilDebugTraceFormat.h"
 #include "dxc/DxilPIXPasses/DxilPIXPasses.h"
 #include "dxc/DxilPIXPasses/DxilPIXVirtualRegisters.h"
 #include "dxc/HLSL/DxilGenerationPass.h"
 
+#include "PixPassHelpers.h"
+
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstIterator.h"
@@ -24,6 +28,7 @@
 
 using namespace llvm;
 using namespace hlsl;
+using namespace pix_dxil;
 
 // Overview of instrumentation:
 //
@@ -83,86 +88,25 @@ using namespace hlsl;
 // overwritten, the debug session is deemed to have overflowed the UAV. The
 // caller will than allocate a UAV that is twice the size and try again, up to a
 // predefined maximum.
+//
+// With the "compact" option, the steps of each basic block are written as one
+// record instead (see DxilDebugTraceFormat.h). The space for the whole block
+// is reserved with a single atomic where the block starts executing, the
+// invocation id is written once per block rather than once per step, the
+// instruction numbers are delta-encoded and constant values stored to
+// registers are left out. The debugger application expands these records
+// back into ordinary step records with the decoder in lib/DxilDia.
+//
+// With a non-zero "sampleRate" option, the parameters are ignored and roughly
+// one in sampleRate invocations is treated as being of interest, chosen by
+// hashing the same system values. Each sampled invocation gets its own
+// instance identifier as usual, so this gives representative execution counts
+// across a whole draw or dispatch for a bounded amount of UAV traffic.
 
 // Keep this in sync with the same-named value in the debugger application's
 // WinPixShaderUtils.h
 constexpr uint64_t DebugBufferDumpingGroundSize = 64 * 1024;
 
-// These definitions echo those in the debugger application's
-// debugshaderrecord.h file
-enum DebugShaderModifierRecordType {
-  DebugShaderModifierRecordTypeInvocationStartMarker,
-  DebugShaderModifierRecordTypeStep,
-  DebugShaderModifierRecordTypeEvent,
-  DebugShaderModifierRecordTypeInputRegister,
-  DebugShaderModifierRecordTypeReadRegister,
-  DebugShaderModifierRecordTypeWrittenRegister,
-  DebugShaderModifierRecordTypeRegisterRelativeIndex0,
-  DebugShaderModifierRecordTypeRegisterRelativeIndex1,
-  DebugShaderModifierRecordTypeRegisterRelativeIndex2,
-  DebugShaderModifierRecordTypeDXILStepVoid = 251,
-  DebugShaderModifierRecordTypeDXILStepFloat = 252,
-  DebugShaderModifierRecordTypeDXILStepUint32 = 253,
-  DebugShaderModifierRecordTypeDXILStepUint64 = 254,
-  DebugShaderModifierRecordTypeDXILStepDouble = 255,
-};
-
-// These structs echo those in the debugger application's debugshaderrecord.h
-// file, but are recapitulated here because the originals use unnamed unions
-// which are disallowed by DXCompiler's build.
-//
-#pragma pack(push, 4)
-struct DebugShaderModifierRecordHeader {
-  union {
-    struct {
-      uint32_t SizeDwords : 4;
-      uint32_t Flags : 4;
-      uint32_t Type : 8;
-      uint32_t HeaderPayload : 16;
-    } Details;
-    uint32_t u32Header;
-  } Header;
-  uint32_t UID;
-};
-
-struct DebugShaderModifierRecordDXILStepBase {
-  union {
-    struct {
-      uint32_t SizeDwords : 4;
-      uint32_t Flags : 4;
-      uint32_t Type : 8;
-      uint32_t Opcode : 16;
-    } Details;
-    uint32_t u32Header;
-  } Header;
-  uint32_t UID;
-  uint32_t InstructionOffset;
-};
-
-template <typename ReturnType>
-struct DebugShaderModifierRecordDXILStep
-    : public DebugShaderModifierRecordDXILStepBase {
-  ReturnType ReturnValue;
-  union {
-    struct {
-      uint32_t ValueOrdinalBase : 16;
-      uint32_t ValueOrdinalIndex : 16;
-    } Details;
-    uint32_t u32ValueOrdinal;
-  } ValueOrdinal;
-};
-
-template <>
-struct DebugShaderModifierRecordDXILStep<void>
-    : public DebugShaderModifierRecordDXILStepBase {};
-#pragma pack(pop)
-
-uint32_t
-DebugShaderModifierRecordPayloadSizeDwords(size_t recordTotalSizeBytes) {
-  return ((recordTotalSizeBytes - sizeof(DebugShaderModifierRecordHeader)) /
-          sizeof(uint32_t));
-}
-
 class DxilDebugInstrumentation : public ModulePass {
 
 private:
@@ -233,6 +177,22 @@ private:
   uint32_t m_RemainingReservedSpaceInBytes = 0;
   Value *m_CurrentIndex = nullptr;
 
+  bool m_Compact = false;
+
+  // If non-zero, the parameters are ignored and one in this many invocations
+  // is instrumented instead.
+  unsigned m_SampleRate = 0;
+
+  // One instrumented step, with where its record has to be written.
+  struct StepInfo {
+    Instruction *InsertBefore; // null to append to the builder's block
+    std::uint32_t InstNum;
+    Value *V;
+    std::uint32_t ValueOrdinal;
+    Value *ValueOrdinalIndex;
+    bool IsStore;
+  };
+
 public:
   static char ID; // Pass identification, replacement for typeid
   explicit DxilDebugInstrumentation() : ModulePass(ID) {}
@@ -256,11 +216,14 @@ private:
   void addDebugEntryValue(BuilderContext &BC, Value *TheValue);
   void addInvocationStartMarker(BuilderContext &BC);
   void reserveDebugEntrySpace(BuilderContext &BC, uint32_t SpaceInDwords);
-  void addStoreStepDebugEntry(BuilderContext &BC, StoreInst *Inst);
+  bool getStepInfo(Instruction *Inst, StepInfo &Step);
   void addStepDebugEntry(BuilderContext &BC, Instruction *Inst);
+  void addCompactSteps(BuilderContext &BC, ArrayRef<StepInfo> Steps);
   void addStepDebugEntryValue(BuilderContext &BC, std::uint32_t InstNum,
                               Value *V, std::uint32_t ValueOrdinal,
                               Value *ValueOrdinalIndex);
+  Value *encodeValueOrdinal(BuilderContext &BC, std::uint32_t ValueOrdinal,
+                            Value *ValueOrdinalIndex);
   uint32_t UAVDumpingGroundOffset();
   template <typename ReturnType>
   void addStepEntryForType(DebugShaderModifierRecordType RecordType,
@@ -274,6 +237,8 @@ void DxilDebugInstrumentation::applyOptions(PassOptions O) {
   GetPassOptionUnsigned(O, "parameter1", &m_Parameters.Parameters[1], 0);
   GetPassOptionUnsigned(O, "parameter2", &m_Parameters.Parameters[2], 0);
   GetPassOptionUInt64(O, "UAVSize", &m_UAVSize, 1024 * 1024);
+  GetPassOptionBool(O, "compact", &m_Compact, false);
+  GetPassOptionUnsigned(O, "sampleRate", &m_SampleRate, 0);
 }
 
 uint32_t DxilDebugInstrumentation::UAVDumpingGroundOffset() {
@@ -399,6 +364,12 @@ Value *DxilDebugInstrumentation::addDispatchedShaderProlog(BuilderContext &BC) {
   auto ThreadIdZ =
       BC.Builder.CreateCall(ThreadIdFunc, {Opcode, Two32Arg}, "ThreadIdZ");
 
+  if (m_SampleRate != 0) {
+    return PIXPassHelpers::EmitSampleSelection(
+        BC.Builder, BC.HlslOP, {ThreadIdX, ThreadIdY, ThreadIdZ},
+        m_SampleRate);
+  }
+
   // Compare to expected thread ID
   auto CompareToX = BC.Builder.CreateICmpEQ(
       ThreadIdX, BC.HlslOP->GetU32Const(m_Parameters.ComputeShader.ThreadIdX),
@@ -446,6 +417,11 @@ DxilDebugInstrumentation::addVertexShaderProlog(BuilderContext &BC,
                              Zero8Arg /*column*/, UndefArg},
                             "InstanceId");
 
+  if (m_SampleRate != 0) {
+    return PIXPassHelpers::EmitSampleSelection(
+        BC.Builder, BC.HlslOP, {VertId, InstanceId}, m_SampleRate);
+  }
+
   // Compare to expected vertex ID and instance ID
   auto CompareToVert = BC.Builder.CreateICmpEQ(
       VertId, BC.HlslOP->GetU32Const(m_Parameters.VertexShader.VertexId),
@@ -469,6 +445,11 @@ Value *DxilDebugInstrumentation::addGeometryShaderProlog(
   auto PrimId =
       BC.Builder.CreateCall(PrimitiveIdOpFunc, {PrimitiveIdOpcode}, "PrimId");
 
+  if (m_SampleRate != 0 && BC.DM.GetGSInstanceCount() <= 1) {
+    return PIXPassHelpers::EmitSampleSelection(BC.Builder, BC.HlslOP, {PrimId},
+                                               m_SampleRate);
+  }
+
   auto CompareToPrim = BC.Builder.CreateICmpEQ(
       PrimId, BC.HlslOP->GetU32Const(m_Parameters.GeometryShader.PrimitiveId),
       "CompareToPrimId");
@@ -484,6 +465,11 @@ Value *DxilDebugInstrumentation::addGeometryShaderProlog(
   auto GSInstanceId = BC.Builder.CreateCall(
       GSInstanceIdOpFunc, {GSInstanceIdOpcode}, "GSInstanceId");
 
+  if (m_SampleRate != 0) {
+    return PIXPassHelpers::EmitSampleSelection(
+        BC.Builder, BC.HlslOP, {PrimId, GSInstanceId}, m_SampleRate);
+  }
+
   // Compare to expected vertex ID and instance ID
   auto CompareToInstance = BC.Builder.CreateICmpEQ(
       GSInstanceId,
@@ -530,6 +516,11 @@ DxilDebugInstrumentation::addPixelShaderProlog(BuilderContext &BC,
                                    Type::getInt32Ty(BC.Ctx), "YIndex");
   }
 
+  if (m_SampleRate != 0) {
+    return PIXPassHelpers::EmitSampleSelection(BC.Builder, BC.HlslOP,
+                                               {XAsInt, YAsInt}, m_SampleRate);
+  }
+
   // Compare to expected pixel position and primitive ID
   auto CompareToX = BC.Builder.CreateICmpEQ(
       XAsInt, BC.HlslOP->GetU32Const(m_Parameters.PixelShader.X), "CompareToX");
@@ -745,8 +736,8 @@ void DxilDebugInstrumentation::addDebugEntryValue(BuilderContext &BC,
                      UndefArg, // unused values
                      WriteMask_X});
 
+    assert(m_RemainingReservedSpaceInBytes >= 4); // check for underflow
     m_RemainingReservedSpaceInBytes -= 4;
-    assert(m_RemainingReservedSpaceInBytes < 1024); // check for underflow
 
     if (m_RemainingReservedSpaceInBytes != 0) {
       m_CurrentIndex =
@@ -788,103 +779,89 @@ void DxilDebugInstrumentation::addStepEntryForType(
 
   if (RecordType != DebugShaderModifierRecordTypeDXILStepVoid) {
     addDebugEntryValue(BC, V);
-
-    IRBuilder<> &B = BC.Builder;
-
-    Value *VO = BC.HlslOP->GetU32Const(ValueOrdinal << 16);
-    Value *VOI = B.CreateAnd(ValueOrdinalIndex, BC.HlslOP->GetU32Const(0xFFFF),
-                             "ValueOrdinalIndex");
-    Value *EncodedValueOrdinalAndIndex =
-        BC.Builder.CreateOr(VO, VOI, "ValueOrdinal");
-    addDebugEntryValue(BC, EncodedValueOrdinalAndIndex);
+    addDebugEntryValue(BC,
+                       encodeValueOrdinal(BC, ValueOrdinal, ValueOrdinalIndex));
   }
 }
 
-void DxilDebugInstrumentation::addStoreStepDebugEntry(BuilderContext &BC,
-                                                      StoreInst *Inst) {
-  std::uint32_t ValueOrdinalBase;
-  std::uint32_t UnusedValueOrdinalSize;
-  llvm::Value *ValueOrdinalIndex;
-  if (!pix_dxil::PixAllocaRegWrite::FromInst(Inst, &ValueOrdinalBase,
-                                             &UnusedValueOrdinalSize,
-                                             &ValueOrdinalIndex)) {
-    return;
-  }
-
-  std::uint32_t InstNum;
-  if (!pix_dxil::PixDxilInstNum::FromInst(Inst, &InstNum)) {
-    return;
-  }
+Value *DxilDebugInstrumentation::encodeValueOrdinal(BuilderContext &BC,
+                                                    std::uint32_t ValueOrdinal,
+                                                    Value *ValueOrdinalIndex) {
+  IRBuilder<> &B = BC.Builder;
 
-  addStepDebugEntryValue(BC, InstNum, Inst->getValueOperand(), ValueOrdinalBase,
-                         ValueOrdinalIndex);
+  Value *VO = BC.HlslOP->GetU32Const(ValueOrdinal << 16);
+  Value *VOI = B.CreateAnd(ValueOrdinalIndex, BC.HlslOP->GetU32Const(0xFFFF),
+                           "ValueOrdinalIndex");
+  return BC.Builder.CreateOr(VO, VOI, "ValueOrdinal");
 }
 
-void DxilDebugInstrumentation::addStepDebugEntry(BuilderContext &BC,
-                                                 Instruction *Inst) {
+bool DxilDebugInstrumentation::getStepInfo(Instruction *Inst,
+                                           StepInfo &Step) {
   if (Inst->getOpcode() == Instruction::OtherOps::PHI) {
-    return;
+    return false;
   }
 
+  Step.InsertBefore = Inst->isTerminator() ? Inst : Inst->getNextNode();
+
   if (auto *St = llvm::dyn_cast<llvm::StoreInst>(Inst)) {
-    addStoreStepDebugEntry(BC, St);
-    return;
+    std::uint32_t UnusedValueOrdinalSize;
+    if (!pix_dxil::PixAllocaRegWrite::FromInst(St, &Step.ValueOrdinal,
+                                               &UnusedValueOrdinalSize,
+                                               &Step.ValueOrdinalIndex)) {
+      return false;
+    }
+    Step.V = St->getValueOperand();
+    Step.IsStore = true;
+  } else {
+    if (!pix_dxil::PixDxilReg::FromInst(Inst, &Step.ValueOrdinal)) {
+      return false;
+    }
+    Step.V = Inst;
+    Step.ValueOrdinalIndex = nullptr;
+    Step.IsStore = false;
   }
 
-  std::uint32_t RegNum;
-  if (!pix_dxil::PixDxilReg::FromInst(Inst, &RegNum)) {
-    return;
-  }
+  return pix_dxil::PixDxilInstNum::FromInst(Inst, &Step.InstNum);
+}
 
-  std::uint32_t InstNum;
-  if (!pix_dxil::PixDxilInstNum::FromInst(Inst, &InstNum)) {
+void DxilDebugInstrumentation::addStepDebugEntry(BuilderContext &BC,
+                                                 Instruction *Inst) {
+  StepInfo Step;
+  if (!getStepInfo(Inst, Step)) {
     return;
   }
 
-  addStepDebugEntryValue(BC, InstNum, Inst, RegNum, BC.Builder.getInt32(0));
+  addStepDebugEntryValue(BC, Step.InstNum, Step.V, Step.ValueOrdinal,
+                         Step.ValueOrdinalIndex ? Step.ValueOrdinalIndex
+                                                : BC.Builder.getInt32(0));
 }
 
-void DxilDebugInstrumentation::addStepDebugEntryValue(
-    BuilderContext &BC, std::uint32_t InstNum, Value *V,
-    std::uint32_t ValueOrdinal, Value *ValueOrdinalIndex) {
-  const Type::TypeID ID = V->getType()->getTypeID();
-
-  switch (ID) {
+// Returns false for values that are not traced.
+static bool GetStepRecordType(Type *Ty, DebugShaderModifierRecordType *pType) {
+  switch (Ty->getTypeID()) {
   case Type::TypeID::StructTyID:
   case Type::TypeID::VoidTyID:
-    addStepEntryForType<void>(DebugShaderModifierRecordTypeDXILStepVoid, BC,
-                              InstNum, V, ValueOrdinal, ValueOrdinalIndex);
-    break;
+    *pType = DebugShaderModifierRecordTypeDXILStepVoid;
+    return true;
   case Type::TypeID::FloatTyID:
-    addStepEntryForType<float>(DebugShaderModifierRecordTypeDXILStepFloat, BC,
-                               InstNum, V, ValueOrdinal, ValueOrdinalIndex);
-    break;
+  case Type::TypeID::HalfTyID:
+    *pType = DebugShaderModifierRecordTypeDXILStepFloat;
+    return true;
   case Type::TypeID::IntegerTyID:
-    if (V->getType()->getIntegerBitWidth() == 64) {
-      addStepEntryForType<uint64_t>(DebugShaderModifierRecordTypeDXILStepUint64,
-                                    BC, InstNum, V, ValueOrdinal,
-                                    ValueOrdinalIndex);
-    } else {
-      addStepEntryForType<uint32_t>(DebugShaderModifierRecordTypeDXILStepUint32,
-                                    BC, InstNum, V, ValueOrdinal,
-                                    ValueOrdinalIndex);
-    }
-    break;
+    *pType = Ty->getIntegerBitWidth() == 64
+                 ? DebugShaderModifierRecordTypeDXILStepUint64
+                 : DebugShaderModifierRecordTypeDXILStepUint32;
+    return true;
   case Type::TypeID::DoubleTyID:
-    addStepEntryForType<double>(DebugShaderModifierRecordTypeDXILStepDouble, BC,
-                                InstNum, V, ValueOrdinal, ValueOrdinalIndex);
-    break;
-  case Type::TypeID::HalfTyID:
-    addStepEntryForType<float>(DebugShaderModifierRecordTypeDXILStepFloat, BC,
-                               InstNum, V, ValueOrdinal, ValueOrdinalIndex);
-    break;
+    *pType = DebugShaderModifierRecordTypeDXILStepDouble;
+    return true;
   case Type::TypeID::PointerTyID:
     // Skip pointer calculation instructions. They aren't particularly
     // meaningful to the user (being a mere implementation detail for lookup
     // tables, etc.), and their type is problematic from a UI point of view. The
     // subsequent instructions that dereference the pointer will be properly
     // instrumented and show the (meaningful) retrieved value.
-    break;
+    return false;
   case Type::TypeID::FP128TyID:
   case Type::TypeID::LabelTyID:
   case Type::TypeID::MetadataTyID:
@@ -896,6 +873,141 @@ void DxilDebugInstrumentation::addStepDebugEntryValue(
   case Type::TypeID::PPC_FP128TyID:
     assert(false);
   }
+  return false;
+}
+
+void DxilDebugInstrumentation::addStepDebugEntryValue(
+    BuilderContext &BC, std::uint32_t InstNum, Value *V,
+    std::uint32_t ValueOrdinal, Value *ValueOrdinalIndex) {
+  DebugShaderModifierRecordType RecordType;
+  if (!GetStepRecordType(V->getType(), &RecordType)) {
+    return;
+  }
+
+  switch (RecordType) {
+  case DebugShaderModifierRecordTypeDXILStepVoid:
+    addStepEntryForType<void>(RecordType, BC, InstNum, V, ValueOrdinal,
+                              ValueOrdinalIndex);
+    break;
+  case DebugShaderModifierRecordTypeDXILStepFloat:
+    addStepEntryForType<float>(RecordType, BC, InstNum, V, ValueOrdinal,
+                               ValueOrdinalIndex);
+    break;
+  case DebugShaderModifierRecordTypeDXILStepUint32:
+    addStepEntryForType<uint32_t>(RecordType, BC, InstNum, V, ValueOrdinal,
+                                  ValueOrdinalIndex);
+    break;
+  case DebugShaderModifierRecordTypeDXILStepUint64:
+    addStepEntryForType<uint64_t>(RecordType, BC, InstNum, V, ValueOrdinal,
+                                  ValueOrdinalIndex);
+    break;
+  case DebugShaderModifierRecordTypeDXILStepDouble:
+    addStepEntryForType<double>(RecordType, BC, InstNum, V, ValueOrdinal,
+                                ValueOrdinalIndex);
+    break;
+  default:
+    assert(false);
+  }
+}
+
+void DxilDebugInstrumentation::addCompactSteps(BuilderContext &BC,
+                                               ArrayRef<StepInfo> Steps) {
+  using namespace DebugTraceCompact;
+
+  // The record is reserved before its first step runs, so every step's
+  // encoding and size has to be known up front.
+  struct EncodedStep {
+    const StepInfo *Step;
+    DebugShaderModifierRecordType Type;
+    std::uint32_t Header;
+    std::uint32_t SizeDwords;
+  };
+  SmallVector<EncodedStep, 16> Encoded;
+  for (const StepInfo &Step : Steps) {
+    DebugShaderModifierRecordType Type;
+    if (!GetStepRecordType(Step.V->getType(), &Type)) {
+      continue;
+    }
+    EncodedStep E = {&Step, Type, static_cast<std::uint32_t>(Type), 1};
+    if (Type != DebugShaderModifierRecordTypeDXILStepVoid) {
+      if (Step.IsStore &&
+          (isa<ConstantInt>(Step.V) || isa<ConstantFP>(Step.V))) {
+        E.Header |= StepFlagValueElided;
+      } else if (Type == DebugShaderModifierRecordTypeDXILStepUint64 ||
+                 Type == DebugShaderModifierRecordTypeDXILStepDouble) {
+        E.SizeDwords += 2;
+      } else {
+        E.SizeDwords += 1;
+      }
+      E.SizeDwords += 1; // value ordinal
+    }
+    Encoded.push_back(E);
+  }
+
+  auto PositionBuilder = [&BC](const StepInfo &Step) {
+    if (Step.InsertBefore) {
+      BC.Builder.SetInsertPoint(Step.InsertBefore);
+    }
+  };
+
+  size_t First = 0;
+  while (First < Encoded.size()) {
+    // Take as many steps as fit in one record.
+    const std::uint32_t BaseInstNum = Encoded[First].Step->InstNum;
+    std::uint32_t PrevInstNum = BaseInstNum;
+    std::uint32_t PayloadDwords = 0;
+    size_t End = First;
+    for (; End < Encoded.size(); ++End) {
+      EncodedStep &E = Encoded[End];
+      std::uint32_t Header = E.Header;
+      std::uint32_t SizeDwords = E.SizeDwords;
+      int64_t Delta = (int64_t)E.Step->InstNum - (int64_t)PrevInstNum;
+      if (Delta < INT16_MIN || Delta > INT16_MAX) {
+        Header |= StepFlagFullInstNum;
+        ++SizeDwords;
+        Delta = 0;
+      }
+      Header |= ((std::uint32_t)Delta & 0xFFFF) << StepDeltaShift;
+      if (End > First && PayloadDwords + SizeDwords > MaxPayloadDwords) {
+        break;
+      }
+      E.Header = Header;
+      E.SizeDwords = SizeDwords;
+      PayloadDwords += SizeDwords;
+      PrevInstNum = E.Step->InstNum;
+    }
+
+    PositionBuilder(*Encoded[First].Step);
+    DebugShaderModifierRecordHeader Record{{{0, 0, 0, 0}}, 0};
+    Record.Header.Details.Type = DebugShaderModifierRecordTypeDXILCompactSteps;
+    Record.Header.Details.HeaderPayload = PayloadDwords;
+    reserveDebugEntrySpace(BC, sizeof(Record) + sizeof(uint32_t) +
+                                   PayloadDwords * sizeof(uint32_t));
+    addDebugEntryValue(BC, BC.HlslOP->GetU32Const(Record.Header.u32Header));
+    addDebugEntryValue(BC, m_InvocationId);
+    addDebugEntryValue(BC, BC.HlslOP->GetU32Const(BaseInstNum));
+
+    for (size_t i = First; i < End; ++i) {
+      const EncodedStep &E = Encoded[i];
+      PositionBuilder(*E.Step);
+      addDebugEntryValue(BC, BC.HlslOP->GetU32Const(E.Header));
+      if (E.Header & StepFlagFullInstNum) {
+        addDebugEntryValue(BC, BC.HlslOP->GetU32Const(E.Step->InstNum));
+      }
+      if (E.Type != DebugShaderModifierRecordTypeDXILStepVoid) {
+        if (!(E.Header & StepFlagValueElided)) {
+          addDebugEntryValue(BC, E.Step->V);
+        }
+        Value *Index = E.Step->ValueOrdinalIndex ? E.Step->ValueOrdinalIndex
+                                                 : BC.Builder.getInt32(0);
+        addDebugEntryValue(
+            BC, encodeValueOrdinal(BC, E.Step->ValueOrdinal, Index));
+      }
+    }
+    assert(m_CurrentIndex == nullptr && "else record size was miscounted");
+
+    First = End;
+  }
 }
 
 bool DxilDebugInstrumentation::runOnModule(Module &M) {
@@ -995,6 +1107,7 @@ bool DxilDebugInstrumentation::runOnModule(Module &M) {
       }
 
       // Modify the Phis and add debug instrumentation
+      std::vector<StepInfo> EdgeSteps;
       for (auto &ValueNPhi : InsertableEdge.second) {
         // Modify the phi to refer to the new block:
         ValueNPhi.Phi->setIncomingBlock(ValueNPhi.Index, NewBlock);
@@ -1010,29 +1123,66 @@ bool DxilDebugInstrumentation::runOnModule(Module &M) {
           continue;
         }
 
+        if (m_Compact) {
+          EdgeSteps.push_back(
+              {nullptr, InstNum, ValueNPhi.Val, RegNum, nullptr, false});
+          continue;
+        }
+
         BuilderContext BC{M, DM, Ctx, HlslOP, Builder};
         addStepDebugEntryValue(BC, InstNum, ValueNPhi.Val, RegNum,
                                BC.Builder.getInt32(0));
       }
 
+      if (!EdgeSteps.empty()) {
+        BuilderContext BC{M, DM, Ctx, HlslOP, Builder};
+        addCompactSteps(BC, EdgeSteps);
+      }
+
       // Add a branch to the new block to point to the current block
       Builder.CreateBr(&CurrentBlock);
     }
   }
 
   // Instrument original instructions:
-  for (auto &Inst : AllInstructions) {
-    // Instrumentation goes after the instruction if it is not a terminator.
-    // Otherwise, Instrumentation goes prior to the instruction.
-    if (!Inst->isTerminator()) {
-      IRBuilder<> Builder(Inst->getNextNode());
-      BuilderContext BC2{BC.M, BC.DM, BC.Ctx, BC.HlslOP, Builder};
-      addStepDebugEntry(BC2, Inst);
-    } else {
-      // Insert before this instruction
-      IRBuilder<> Builder(Inst);
+  if (m_Compact) {
+    // One record per run of instructions from the same block.
+    std::vector<StepInfo> BlockSteps;
+    BasicBlock *CurrentBlock = nullptr;
+    for (auto &Inst : AllInstructions) {
+      if (Inst->getParent() != CurrentBlock) {
+        if (!BlockSteps.empty()) {
+          IRBuilder<> Builder(Ctx);
+          BuilderContext BC2{BC.M, BC.DM, BC.Ctx, BC.HlslOP, Builder};
+          addCompactSteps(BC2, BlockSteps);
+          BlockSteps.clear();
+        }
+        CurrentBlock = Inst->getParent();
+      }
+      StepInfo Step;
+      if (getStepInfo(Inst, Step)) {
+        BlockSteps.push_back(Step);
+      }
+    }
+    if (!BlockSteps.empty()) {
+      IRBuilder<> Builder(Ctx);
       BuilderContext BC2{BC.M, BC.DM, BC.Ctx, BC.HlslOP, Builder};
-      addStepDebugEntry(BC2, Inst);
+      addCompactSteps(BC2, BlockSteps);
+    }
+  } else {
+    for (auto &Inst : AllInstructions) {
+      // Instrumentation goes after the instruction if it is not a terminator.
+      // Otherwise, Instrumentation goes prior to the instruction.
+      if (!Inst->isTerminator()) {
+        IRBuilder<> Builder(Inst->getNextNode());
+        BuilderContext BC2{BC.M, BC.DM, BC.Ctx, BC.HlslOP, Builder};
+        addStepDebugEntry(BC2, Inst);
+      } else {
+        // Insert before this instruction
+        IRBuilder<> Builder(Inst);
+        BuilderContext BC2{BC.M, BC.DM, BC.Ctx, BC.HlslOP, Builder};
+        addStepDebugEntry(BC2, Inst);
+      }
     }
   }
 
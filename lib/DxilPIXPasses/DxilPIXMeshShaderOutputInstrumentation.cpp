@@ -19,6 +19,8 @@
 #include "dxc/HLSL/DxilGenerationPass.h"
 #include "dxc/HLSL/DxilSpanAllocator.h"
 
+#include "PixPassHelpers.h"
+
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -61,6 +63,11 @@ private:
 
   uint64_t m_UAVSize = 1024 * 1024;
 
+  // If non-zero, only one in this many thread groups is instrumented. The
+  // others write to the dumping ground.
+  unsigned m_SampleRate = 0;
+  Value *m_IsSampled = nullptr;
+
   struct BuilderContext {
     Module &M;
     DxilModule &DM;
@@ -82,6 +89,7 @@ private:
 void DxilPIXMeshShaderOutputInstrumentation::applyOptions(PassOptions O) 
 {
   GetPassOptionUInt64(O, "UAVSize", &m_UAVSize, 1024 * 1024);
+  GetPassOptionUnsigned(O, "sampleRate", &m_SampleRate, 0);
 }
 
 uint32_t DxilPIXMeshShaderOutputInstrumentation::UAVDumpingGroundOffset() 
@@ -192,7 +200,11 @@ Value *DxilPIXMeshShaderOutputInstrumentation::reserveDebugEntrySpace(
       BC.HlslOP->GetU32Const(UAVDumpingGroundOffset() + MaxSizePerRecord);
   UndefValue *UndefArg = UndefValue::get(Type::getInt32Ty(BC.Ctx));
 
-  Constant *Increment = BC.HlslOP->GetU32Const(SpaceInBytes);
+  Value *Increment = BC.HlslOP->GetU32Const(SpaceInBytes);
+  if (m_IsSampled != nullptr) {
+    Increment = BC.Builder.CreateSelect(m_IsSampled, Increment,
+                                        BC.HlslOP->GetU32Const(0));
+  }
 
   auto *PreviousValue = BC.Builder.CreateCall(
       AtomicOpFunc,
@@ -208,7 +220,14 @@ Value *DxilPIXMeshShaderOutputInstrumentation::reserveDebugEntrySpace(
       },
       "UAVIncResult");
 
-  return BC.Builder.CreateAnd(PreviousValue, m_OffsetMask, "MaskedForUAVLimit");
+  Value *Offset =
+      BC.Builder.CreateAnd(PreviousValue, m_OffsetMask, "MaskedForUAVLimit");
+  if (m_IsSampled != nullptr) {
+    Offset = BC.Builder.CreateSelect(
+        m_IsSampled, Offset, BC.HlslOP->GetU32Const(UAVDumpingGroundOffset()),
+        "SampledOffset");
+  }
+  return Offset;
 }
 
 Value *DxilPIXMeshShaderOutputInstrumentation::writeDwordAndReturnNewOffset(
@@ -277,6 +296,12 @@ bool DxilPIXMeshShaderOutputInstrumentation::runOnModule(Module &M)
   auto GroupIdXandY = insertInstructionsToCalculateFlattenedGroupIdXandY(BC);
   auto GroupIdZ = insertInstructionsToCalculateGroupIdZ(BC);
 
+  // Whole groups are sampled so that each sampled group's output is complete.
+  if (m_SampleRate != 0) {
+    m_IsSampled = PIXPassHelpers::EmitSampleSelection(
+        BC.Builder, BC.HlslOP, {GroupIdXandY, GroupIdZ}, m_SampleRate);
+  }
+
   auto F = HlslOP->GetOpFunc(DXIL::OpCode::EmitIndices, Type::getVoidTy(Ctx));
   auto FunctionUses = F->uses();
   for (auto FI = FunctionUses.begin(); FI != FunctionUses.end();)
@@ -31,6 +31,7 @@ HRESULT SetupRegistryPassForPIX() {
     // INIT-PASSES:BEGIN
     initializeDxilAddPixelHitInstrumentationPass(Registry);
     initializeDxilAnnotateWithVirtualRegisterPass(Registry);
+    initializeDxilBlockCountersPass(Registry);
     initializeDxilDbgValueToDbgDeclarePass(Registry);
     initializeDxilDebugInstrumentationPass(Registry);
     initializeDxilForceEarlyZPass(Registry);
@@ -20,6 +20,7 @@
 
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include <deque>
 
@@ -168,6 +169,7 @@ private:
 
 private:
   bool m_CheckForDynamicIndexing = false;
+  bool m_WaveAggregate = false;
   std::map<RegisterTypeAndSpace, SlotRange> m_slotAssignments;
   std::map<llvm::Function *, CallInst *> m_FunctionToUAVHandle;
   std::set<RSRegisterIdentifier> m_DynamicallyIndexedBindPoints;
@@ -234,6 +236,8 @@ void DxilShaderAccessTracking::applyOptions(PassOptions O) {
   GetPassOptionInt(O, "checkForDynamicIndexing", &checkForDynamic, 0);
   m_CheckForDynamicIndexing = checkForDynamic != 0;
 
+  GetPassOptionBool(O, "waveAggregate", &m_WaveAggregate, false);
+
   StringRef configOption;
   if (GetPassOption(O, "config", &configOption)) {
     std::deque<char> config;
@@ -277,6 +281,31 @@ void DxilShaderAccessTracking::EmitAccess(LLVMContext &Ctx, OP *HlslOP,
   auto OffsetByteIndex = Builder.CreateAdd(
       ByteIndex, HlslOP->GetU32Const(OffsetForAccessType), "OffsetByteIndex");
 
+  if (m_WaveAggregate) {
+    // Every lane writes the same value, so when the whole wave hits the same
+    // slot one lane's store is enough. Lanes of a wave that hit different
+    // slots (dynamic indexing) all still write.
+    Function *IsFirstLaneFunc =
+        HlslOP->GetOpFunc(OP::OpCode::WaveIsFirstLane, Type::getVoidTy(Ctx));
+    Constant *IsFirstLaneOpcode =
+        HlslOP->GetU32Const((unsigned)OP::OpCode::WaveIsFirstLane);
+    Value *ShouldWrite = Builder.CreateCall(IsFirstLaneFunc, {IsFirstLaneOpcode},
+                                            "IsFirstLane");
+    if (!isa<Constant>(OffsetByteIndex)) {
+      Function *AllEqualFunc = HlslOP->GetOpFunc(
+          OP::OpCode::WaveActiveAllEqual, Type::getInt32Ty(Ctx));
+      Constant *AllEqualOpcode =
+          HlslOP->GetU32Const((unsigned)OP::OpCode::WaveActiveAllEqual);
+      auto AllEqual = Builder.CreateCall(
+          AllEqualFunc, {AllEqualOpcode, OffsetByteIndex}, "SlotIsUniform");
+      ShouldWrite = Builder.CreateOr(ShouldWrite, Builder.CreateNot(AllEqual),
+                                     "ShouldWrite");
+    }
+    TerminatorInst *Then = SplitBlockAndInsertIfThen(
+        ShouldWrite, &*Builder.GetInsertPoint(), false);
+    Builder.SetInsertPoint(Then);
+  }
+
   UndefValue *UndefIntArg = UndefValue::get(Type::getInt32Ty(Ctx));
   Constant *LiteralOne = HlslOP->GetU32Const(1);
   Constant *ElementMask = HlslOP->GetI8Const(1);
@@ -415,6 +444,12 @@ bool DxilShaderAccessTracking::runOnModule(Module &M) {
 
   bool Modified = false;
 
+  // Wave intrinsics need shader model 6.0; fall back to per-lane stores
+  // otherwise.
+  if (m_WaveAggregate && !DM.GetShaderModel()->IsSM60Plus()) {
+    m_WaveAggregate = false;
+  }
+
   if (m_CheckForDynamicIndexing) {
 
     bool FoundDynamicIndexing = false;
@@ -509,6 +544,9 @@ bool DxilShaderAccessTracking::runOnModule(Module &M) {
               "PIX_CountUAV_Handle");
         }
       }
+      if (m_WaveAggregate) {
+        DM.m_ShaderFlags.SetWaveOps(true);
+      }
       DM.ReEmitDxilResources();
     }
 
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// PixPassHelpers.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Helpers shared by the PIX instrumentation passes.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PixPassHelpers.h"
+
+#include "dxc/DXIL/DxilOperations.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace PIXPassHelpers {
+
+Value *EmitSampleSelection(IRBuilder<> &Builder, OP *HlslOP,
+                           ArrayRef<Value *> Ids, unsigned SampleRate) {
+  assert(SampleRate != 0);
+
+  // FNV-1a over the ids, then a final avalanche so that neighbouring ids
+  // (adjacent pixels or threads) don't fall into the same residue classes.
+  Value *Hash = HlslOP->GetU32Const(2166136261u);
+  for (Value *Id : Ids) {
+    Hash = Builder.CreateXor(Hash, Id, "SampleHash");
+    Hash = Builder.CreateMul(Hash, HlslOP->GetU32Const(16777619u),
+                             "SampleHash");
+  }
+  Hash = Builder.CreateXor(Hash, Builder.CreateLShr(Hash, 16), "SampleHash");
+  Hash = Builder.CreateMul(Hash, HlslOP->GetU32Const(0x45d9f3bu),
+                           "SampleHash");
+  Hash = Builder.CreateXor(Hash, Builder.CreateLShr(Hash, 16), "SampleHash");
+
+  Value *Residue;
+  if ((SampleRate & (SampleRate - 1)) == 0) {
+    Residue =
+        Builder.CreateAnd(Hash, HlslOP->GetU32Const(SampleRate - 1), "Residue");
+  } else {
+    Residue = Builder.CreateURem(Hash, HlslOP->GetU32Const(SampleRate),
+                                 "Residue");
+  }
+  return Builder.CreateICmpEQ(Residue, HlslOP->GetU32Const(0), "IsSampled");
+}
+
+} // namespace PIXPassHelpers
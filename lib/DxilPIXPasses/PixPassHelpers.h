@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// PixPassHelpers.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Helpers shared by the PIX instrumentation passes.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/IRBuilder.h"
+
+namespace hlsl {
+class OP;
+}
+
+namespace PIXPassHelpers {
+// Returns an i1 that is true for roughly one in SampleRate invocations, picked
+// by hashing the i32 values in Ids that identify the invocation (its thread
+// id, pixel position and so on). The same ids always give the same result,
+// so replaying a capture samples the same invocations.
+llvm::Value *EmitSampleSelection(llvm::IRBuilder<> &Builder, hlsl::OP *HlslOP,
+                                 llvm::ArrayRef<llvm::Value *> Ids,
+                                 unsigned SampleRate);
+} // namespace PIXPassHelpers
@@ -23,6 +23,9 @@
 
 #include <string>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <set>
@@ -44,7 +47,7 @@ class CIntervalCollection {
 private:
   std::set<T> m_set;
 public:
-  const T* FindIntersectingInterval(const T &I) {
+  const T* FindIntersectingInterval(const T &I) const {
     auto it = m_set.find(I);
     if (it != m_set.end())
       return &*it;
@@ -84,10 +87,12 @@ public:
   void VerifyRootSignature(const DxilVersionedRootSignatureDesc *pRootSignature,
                            DiagnosticPrinter &DiagPrinter);
 
+  // Only reads the accumulated state, so verifiers shared through the root
+  // signature cache may check shaders on several threads at once.
   void VerifyShader(DxilShaderVisibility VisType,
                     const void *pPSVData,
                     uint32_t PSVSize,
-                    DiagnosticPrinter &DiagPrinter);
+                    DiagnosticPrinter &DiagPrinter) const;
 
   typedef enum NODE_TYPE {
     DESCRIPTOR_TABLE_ENTRY,
@@ -139,12 +144,16 @@ private:
                                             DxilShaderVisibility VisType,
                                             unsigned Num,
                                             unsigned LB,
-                                            unsigned Space);
+                                            unsigned Space) const;
 
   RegisterRanges &
   GetRanges(DxilShaderVisibility VisType, DxilDescriptorRangeType DescType) {
     return RangeKinds[(unsigned)VisType][(unsigned)DescType];
   }
+  const RegisterRanges &
+  GetRanges(DxilShaderVisibility VisType, DxilDescriptorRangeType DescType) const {
+    return RangeKinds[(unsigned)VisType][(unsigned)DescType];
+  }
 
   RegisterRanges RangeKinds[kMaxVisType + 1][kMaxDescType + 1];
   bool m_bAllowReservedRegisterSpace;
@@ -376,7 +385,7 @@ RootSignatureVerifier::FindCoveringInterval(DxilDescriptorRangeType RangeType,
                                             DxilShaderVisibility VisType,
                                             unsigned Num,
                                             unsigned LB,
-                                            unsigned Space) {
+                                            unsigned Space) const {
   RegisterRange RR;
   RR.space = Space;
   RR.lb = LB;
@@ -571,7 +580,7 @@ void RootSignatureVerifier::VerifyRootSignature(
 void RootSignatureVerifier::VerifyShader(DxilShaderVisibility VisType,
                                          const void *pPSVData,
                                          uint32_t PSVSize,
-                                         DiagnosticPrinter &DiagPrinter) {
+                                         DiagnosticPrinter &DiagPrinter) const {
   DxilPipelineStateValidation PSV;
   IFTBOOL(PSV.InitFromPSV0(pPSVData, PSVSize), E_INVALIDARG);
 
@@ -865,4 +874,156 @@ bool VerifyRootSignature(_In_ const DxilVersionedRootSignatureDesc *pDesc,
   return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Root signature cache.
+
+namespace {
+
+// Cache entries outlive the compile that verified them, and may be released
+// by another one, so they are allocated, constructed and destroyed under the
+// default allocator instead of whichever one the compile installed.
+template <typename T> struct ProcessAllocator {
+  typedef T value_type;
+  ProcessAllocator() {}
+  template <typename U> ProcessAllocator(const ProcessAllocator<U> &) {}
+  T *allocate(size_t N) {
+    DxcThreadMalloc TM(nullptr);
+    return static_cast<T *>(::operator new(N * sizeof(T)));
+  }
+  void deallocate(T *P, size_t) {
+    DxcThreadMalloc TM(nullptr);
+    ::operator delete(P);
+  }
+  template <typename U, typename... Args> void construct(U *P, Args &&...A) {
+    DxcThreadMalloc TM(nullptr);
+    ::new ((void *)P) U(std::forward<Args>(A)...);
+  }
+  template <typename U> void destroy(U *P) {
+    DxcThreadMalloc TM(nullptr);
+    P->~U();
+  }
+};
+template <typename T, typename U>
+bool operator==(const ProcessAllocator<T> &, const ProcessAllocator<U> &) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const ProcessAllocator<T> &, const ProcessAllocator<U> &) {
+  return false;
+}
+
+// A serialized root signature after deserialization and verification. Only
+// the verifier is kept for a valid root signature: it holds everything that
+// checking a shader against the root signature needs. For an invalid one the
+// diagnostics are kept so they can be reported again.
+struct VerifiedRootSignature {
+  std::unique_ptr<RootSignatureVerifier> Verifier;
+  std::string Diagnostics;
+};
+
+class RootSignatureCache {
+public:
+  // Root signatures are small and few distinct ones are used by a build, so
+  // the cache is simply emptied if it ever fills up.
+  static const size_t kMaxEntries = 256;
+
+  // Throws if the root signature cannot be deserialized, or if verifying it
+  // fails for a reason other than the root signature being invalid; neither
+  // is cached.
+  std::shared_ptr<const VerifiedRootSignature> Get(const void *pData,
+                                                   uint32_t Size) {
+    DxcThreadMalloc TM(nullptr);
+    std::string Key((const char *)pData, Size);
+    {
+      std::lock_guard<std::mutex> Lock(m_mutex);
+      auto It = m_entries.find(Key);
+      if (It != m_entries.end())
+        return It->second;
+    }
+
+    RootSignatureHandle RSH;
+    RSH.LoadSerialized((const uint8_t *)pData, Size);
+    RSH.Deserialize();
+
+    auto pEntry = std::allocate_shared<VerifiedRootSignature>(
+        ProcessAllocator<VerifiedRootSignature>());
+    std::unique_ptr<RootSignatureVerifier> pRSV(new RootSignatureVerifier());
+    raw_string_ostream DiagStream(pEntry->Diagnostics);
+    try {
+      DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+      pRSV->VerifyRootSignature(RSH.GetDesc(), DiagPrinter);
+      pEntry->Verifier = std::move(pRSV);
+    } catch (const hlsl::Exception &E) {
+      // The verifier reports an invalid root signature with E_FAIL.
+      if (E.hr != E_FAIL)
+        throw;
+    }
+    DiagStream.flush();
+
+    std::lock_guard<std::mutex> Lock(m_mutex);
+    if (m_entries.size() >= kMaxEntries)
+      m_entries.clear();
+    return m_entries.emplace(std::move(Key), pEntry).first->second;
+  }
+
+  void Clear() {
+    DxcThreadMalloc TM(nullptr);
+    std::lock_guard<std::mutex> Lock(m_mutex);
+    m_entries.clear();
+  }
+
+  static RootSignatureCache &Instance() {
+    static RootSignatureCache s_cache;
+    return s_cache;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::string,
+                     std::shared_ptr<const VerifiedRootSignature>> m_entries;
+};
+
+} // namespace
+
+_Use_decl_annotations_
+bool VerifySerializedRootSignatureWithShaderPSV(const void *pRSData,
+                                                uint32_t RSSize,
+                                                DXIL::ShaderKind ShaderKind,
+                                                const void *pPSVData,
+                                                uint32_t PSVSize,
+                                                llvm::raw_ostream &DiagStream) {
+  std::shared_ptr<const VerifiedRootSignature> pRS =
+      RootSignatureCache::Instance().Get(pRSData, RSSize);
+  if (!pRS->Verifier) {
+    DiagStream << pRS->Diagnostics;
+    return false;
+  }
+
+  try {
+    DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+    pRS->Verifier->VerifyShader(GetVisibilityType(ShaderKind), pPSVData,
+                                PSVSize, DiagPrinter);
+  } catch (...) {
+    return false;
+  }
+
+  return true;
+}
+
+_Use_decl_annotations_
+bool VerifySerializedRootSignature(const void *pRSData, uint32_t RSSize,
+                                   llvm::raw_ostream &DiagStream) {
+  std::shared_ptr<const VerifiedRootSignature> pRS =
+      RootSignatureCache::Instance().Get(pRSData, RSSize);
+  if (!pRS->Verifier) {
+    DiagStream << pRS->Diagnostics;
+    return false;
+  }
+  return true;
+}
+
+void ClearRootSignatureCache() {
+  RootSignatureCache::Instance().Clear();
+}
+
 } // namespace hlsl
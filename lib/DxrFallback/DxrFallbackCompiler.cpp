@@ -1,5 +1,6 @@
 #include "dxc/DxrFallback/DxrFallbackCompiler.h"
 
+#include "dxc/Support/DxcThreadPool.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/WinIncludes.h"
@@ -14,13 +15,18 @@
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilInstructions.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -30,6 +36,8 @@
 #include "runtime.h"
 #include "StateFunctionTransform.h"
 
+#include <algorithm>
+#include <atomic>
 #include <queue>
 
 using namespace hlsl;
@@ -121,6 +129,47 @@ V get(std::map<K, V>& theMap, const K& key, V defaultVal = static_cast<V>(nullpt
 }
 
 
+static bool isShader(Function* F);
+static void collectResources(DxilModule& DM, std::set<Value*>& resources);
+static bool makeStateFunctionEntry(Module* mod, const std::vector<Function*>& stateFunctions, const std::vector<std::string>& shaderNames, unsigned int shaderStackSize, DxrFallbackStateFunctionCache::Entry& entry);
+
+
+bool DxrFallbackStateFunctionCache::contains(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.count(key) != 0;
+}
+
+bool DxrFallbackStateFunctionCache::lookup(const std::string& key, Entry& entry)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(key);
+  if (it == m_entries.end())
+    return false;
+  entry = it->second;
+  ++m_hitCount;
+  return true;
+}
+
+void DxrFallbackStateFunctionCache::insert(const std::string& key, Entry entry)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries[key] = std::move(entry);
+}
+
+void DxrFallbackStateFunctionCache::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+}
+
+unsigned DxrFallbackStateFunctionCache::getHitCount()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hitCount;
+}
+
+
 DxrFallbackCompiler::DxrFallbackCompiler(llvm::Module* mod, const std::vector<std::string>& shaderNames, unsigned maxAttributeSize, unsigned stackSizeInBytes, bool findCalledShaders /*= false*/)
   : m_module(mod)
   , m_entryShaderNames(shaderNames)
@@ -134,6 +183,19 @@ void DxrFallbackCompiler::compile(std::vector<int>& shaderEntryStateIds, std::ve
   std::vector<std::string> shaderNames = m_entryShaderNames;
   initShaderMap(shaderNames);
 
+  // Cache keys must be computed from the shaders as they came in, before the
+  // runtime is linked and the intrinsics are lowered.
+  if (m_stateFunctionCache)
+  {
+    std::set<Value*> resources;
+    collectResources(m_module->GetOrCreateDxilModule(), resources);
+    for (auto& name : shaderNames)
+    {
+      if (Function* F = m_shaderMap[name])
+        m_shaderCacheKeys[name] = computeShaderCacheKey(F, shaderNames, resources);
+    }
+  }
+
   // Bring in runtime so we can get the runtime data type
   linkRuntime();
   Type* runtimeDataArgTy = getRuntimeDataArgType();
@@ -203,6 +265,16 @@ void DxrFallbackCompiler::setDebugOutputLevel(int val)
   m_debugOutputLevel = val;
 }
 
+void DxrFallbackCompiler::setStateFunctionCache(DxrFallbackStateFunctionCache* cache)
+{
+  m_stateFunctionCache = cache;
+}
+
+void DxrFallbackCompiler::setThreadCount(unsigned threadCount)
+{
+  m_threadCount = threadCount;
+}
+
 static bool isShader(Function* F)
 {
   if (F->hasFnAttribute("exp-shader"))
@@ -304,10 +376,9 @@ void DxrFallbackCompiler::linkRuntime()
 {
   Linker linker(m_module);
   std::unique_ptr<Module> runtimeModule = loadModuleFromAsmString(m_module->getContext(), getRuntimeString());
-  bool linkErr = linker.linkInModule(runtimeModule.get());
-  assert(!linkErr && "Error linking runtime");
-  UNREFERENCED_PARAMETER(linkErr);
-
+  // Nothing can be compiled without the runtime, so fail the compile.
+  if (linker.linkInModule(runtimeModule.get()))
+    throw hlsl::Exception(DXC_E_GENERAL_INTERNAL_ERROR, "error linking the fallback runtime");
 }
 
 static void inlineFuncAndAddRet(CallInst* call, Function*F)
@@ -516,6 +587,9 @@ void DxrFallbackCompiler::createStateFunctions(
   std::set<Value*> resources;
   collectResources(DM, resources);
 
+  std::map<std::string, DxrFallbackStateFunctionCache::Entry> transformed;
+  transformShadersInParallel(shaderNames, resources, transformed);
+
   shaderEntryStateIds.clear();
   shaderStackSizes.clear();
   int stateId = baseStateId;
@@ -523,19 +597,35 @@ void DxrFallbackCompiler::createStateFunctions(
   {
     std::vector<Function*> stateFunctions;
     Function* F = m_shaderMap[shader];
-    StateFunctionTransform sft(F, shaderNames, runtimeDataArgTy);
-    if (m_debugOutputLevel >= 2)
-      sft.setVerbose(true);
-    if (m_debugOutputLevel >= 3)
-      sft.setDumpFilename("dump.ll");
-    if (shader == "Fallback_TraceRay")
-      sft.setAttributeSize(m_maxAttributeSize);
-    DXIL::ShaderKind shaderKind = getRayShaderKind(F);
-    if (shaderKind != DXIL::ShaderKind::Invalid)
-      sft.setParameterInfo(getParameterTypes(F, shaderKind), shaderKind == DXIL::ShaderKind::ClosestHit);
-    sft.setResourceGlobals(resources);
     UINT shaderStackSize = 0;
-    sft.run(stateFunctions, shaderStackSize);
+    bool reused = loadCachedStateFunctions(shader, shaderNames, stateFunctions, shaderStackSize);
+    if (!reused)
+    {
+      auto it = transformed.find(shader);
+      if (it != transformed.end() && linkStateFunctions(shader, shaderNames, it->second, stateFunctions, shaderStackSize))
+      {
+        storeStateFunctions(shader, it->second);
+        reused = true;
+      }
+    }
+    if (!reused)
+    {
+      StateFunctionTransform sft(F, shaderNames, runtimeDataArgTy);
+      if (m_debugOutputLevel >= 2)
+        sft.setVerbose(true);
+      if (m_debugOutputLevel >= 3)
+        sft.setDumpFilename("dump.ll");
+      if (shader == "Fallback_TraceRay")
+        sft.setAttributeSize(m_maxAttributeSize);
+      DXIL::ShaderKind shaderKind = getRayShaderKind(F);
+      if (shaderKind != DXIL::ShaderKind::Invalid)
+        sft.setParameterInfo(getParameterTypes(F, shaderKind), shaderKind == DXIL::ShaderKind::ClosestHit);
+      sft.setResourceGlobals(resources);
+      sft.run(stateFunctions, shaderStackSize);
+      DxrFallbackStateFunctionCache::Entry entry;
+      if (m_stateFunctionCache && makeStateFunctionEntry(m_module, stateFunctions, shaderNames, shaderStackSize, entry))
+        storeStateFunctions(shader, entry);
+    }
 
     shaderEntryStateIds.push_back(stateId);
     shaderStackSizes.push_back(shaderStackSize);
@@ -546,11 +636,380 @@ void DxrFallbackCompiler::createStateFunctions(
         DM.CloneDxilEntryProps(F, stateF);
       }
     }
+
+    // The transform consumes the shader; do the same when it ran elsewhere.
+    if (reused && F->use_empty())
+      F->eraseFromParent();
   }
 
   StateFunctionTransform::finalizeStateIds(m_module, shaderEntryStateIds);
 }
 
+// Declares in newMod the globals that V refers to, so cloned code that uses
+// them links against the definitions in whatever module it is loaded into.
+// Returns false if V refers to something with local linkage, which cannot be
+// linked that way.
+static bool declareReferencedGlobals(Module* newMod, Value* V, ValueToValueMapTy& VMap, std::set<Constant*>& visited)
+{
+  if (GlobalValue* GV = dyn_cast<GlobalValue>(V))
+  {
+    if (VMap.count(GV))
+      return true;
+    if (GV->hasLocalLinkage())
+      return false;
+    if (Function* F = dyn_cast<Function>(GV))
+    {
+      Function* decl = Function::Create(F->getFunctionType(), GlobalValue::ExternalLinkage, F->getName(), newMod);
+      decl->copyAttributesFrom(F);
+      VMap[F] = decl;
+    }
+    else if (GlobalVariable* G = dyn_cast<GlobalVariable>(GV))
+    {
+      VMap[G] = new GlobalVariable(*newMod, G->getType()->getElementType(), G->isConstant(), GlobalValue::ExternalLinkage,
+        nullptr, G->getName(), nullptr, G->getThreadLocalMode(), G->getType()->getAddressSpace());
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+
+  Constant* C = dyn_cast<Constant>(V);
+  if (!C || !visited.insert(C).second)
+    return true;
+  for (Value* op : C->operands())
+  {
+    if (!declareReferencedGlobals(newMod, op, VMap, visited))
+      return false;
+  }
+  return true;
+}
+
+// Copies functions into a module of their own, with declarations for 
+// everything they reference. Returns null if that cannot be done.
+static std::unique_ptr<Module> extractFunctions(Module* mod, const std::vector<Function*>& functions)
+{
+  std::unique_ptr<Module> newMod(new Module(mod->getModuleIdentifier(), mod->getContext()));
+  newMod->setDataLayout(mod->getDataLayout());
+  newMod->setTargetTriple(mod->getTargetTriple());
+
+  ValueToValueMapTy VMap;
+  for (Function* F : functions)
+  {
+    Function* newF = Function::Create(F->getFunctionType(), F->getLinkage(), F->getName(), newMod.get());
+    newF->copyAttributesFrom(F);
+    VMap[F] = newF;
+  }
+
+  std::set<Constant*> visited;
+  for (Function* F : functions)
+  {
+    for (auto& I : inst_range(F))
+    {
+      for (Value* op : I.operands())
+      {
+        if (!declareReferencedGlobals(newMod.get(), op, VMap, visited))
+          return nullptr;
+      }
+    }
+  }
+
+  for (Function* F : functions)
+  {
+    Function* newF = cast<Function>(VMap[F]);
+    for (auto SI = F->arg_begin(), SE = F->arg_end(), DI = newF->arg_begin(); SI != SE; ++SI, ++DI)
+    {
+      DI->setName(SI->getName());
+      VMap[SI] = DI;
+    }
+    SmallVector<ReturnInst*, 4> returns;
+    CloneFunctionInto(newF, F, VMap, true, returns);
+  }
+  return newMod;
+}
+
+std::string DxrFallbackCompiler::computeShaderCacheKey(Function* F, const std::vector<std::string>& shaderNames, const std::set<Value*>& resources)
+{
+  // The transform depends on the shader, the helpers it calls, the globals
+  // they use and which of those are resources, which shaders are being 
+  // compiled with it, and the sizes it was given.
+  std::string text;
+  raw_string_ostream OS(text);
+  OS << m_maxAttributeSize << ' ' << m_stackSizeInBytes << ' ' << (int)getRayShaderKind(F) << '\n';
+
+  std::set<Function*> visitedFuncs;
+  SmallPtrSet<GlobalVariable*, 8> globalSet;
+  std::vector<GlobalVariable*> globals;
+  std::vector<Function*> worklist = { F };
+  while (!worklist.empty())
+  {
+    Function* cur = worklist.back();
+    worklist.pop_back();
+    if (!visitedFuncs.insert(cur).second)
+      continue;
+    cur->print(OS);
+
+    for (auto& I : inst_range(cur))
+    {
+      for (Value* op : I.operands())
+      {
+        Value* V = op->stripPointerCasts();
+        if (GlobalVariable* GV = dyn_cast<GlobalVariable>(V))
+        {
+          if (globalSet.insert(GV).second)
+            globals.push_back(GV);
+        }
+        Function* callee = dyn_cast<Function>(V);
+        if (!callee || callee->isDeclaration())
+          continue;
+        if (!isShader(callee))
+        {
+          worklist.push_back(callee);
+          continue;
+        }
+        std::string calleeName = cleanName(callee->getName());
+        bool isCandidate = std::find(shaderNames.begin(), shaderNames.end(), calleeName) != shaderNames.end();
+        OS << "shader " << calleeName << ' ' << isCandidate << '\n';
+      }
+    }
+  }
+  // Printed by name, as pointer order differs between contexts and runs.
+  std::sort(globals.begin(), globals.end(), [](GlobalVariable* A, GlobalVariable* B) { return A->getName() < B->getName(); });
+  for (GlobalVariable* GV : globals)
+  {
+    GV->print(OS);
+    OS << ' ' << (resources.count(GV) != 0) << '\n';
+  }
+  OS.flush();
+
+  MD5 hash;
+  hash.update(text);
+  MD5::MD5Result result;
+  hash.final(result);
+  SmallString<32> digest;
+  MD5::stringifyResult(result, digest);
+  return cleanName(F->getName()) + ":" + digest.str().str();
+}
+
+// Packages the state functions of one shader, as made in mod, so that they
+// can be linked into another module, possibly in another context.
+static bool makeStateFunctionEntry(Module* mod, const std::vector<Function*>& stateFunctions, const std::vector<std::string>& shaderNames, unsigned int shaderStackSize, DxrFallbackStateFunctionCache::Entry& entry)
+{
+  std::unique_ptr<Module> extracted = extractFunctions(mod, stateFunctions);
+  if (!extracted)
+    return false;
+
+  if (Function* stateIdFunc = extracted->getFunction("dummyStateId"))
+  {
+    for (User* U : stateIdFunc->users())
+    {
+      int functionIdx = (int)cast<ConstantInt>(cast<CallInst>(U)->getArgOperand(0))->getSExtValue();
+      entry.stateIdShaders[functionIdx] = shaderNames[functionIdx];
+    }
+  }
+
+  raw_string_ostream OS(entry.bitcode);
+  WriteBitcodeToFile(extracted.get(), OS);
+  OS.flush();
+  entry.numStateFunctions = (unsigned)stateFunctions.size();
+  entry.stackSize = shaderStackSize;
+  return true;
+}
+
+bool DxrFallbackCompiler::linkStateFunctions(const std::string& shader, const std::vector<std::string>& shaderNames, const DxrFallbackStateFunctionCache::Entry& entry, std::vector<Function*>& stateFunctions, unsigned int& shaderStackSize)
+{
+  std::map<int, int> functionIdxMap; // index in entry -> index in shaderNames
+  for (auto& kv : entry.stateIdShaders)
+  {
+    auto it = std::find(shaderNames.begin(), shaderNames.end(), kv.second);
+    if (it == shaderNames.end())
+      return false;
+    functionIdxMap[kv.first] = (int)(it - shaderNames.begin());
+  }
+
+  LLVMContext& context = m_module->getContext();
+  ErrorOr<std::unique_ptr<Module>> entryOrErr = parseBitcodeFile(MemoryBufferRef(entry.bitcode, shader), context);
+  if (!entryOrErr)
+    return false;
+  std::unique_ptr<Module> entryModule = std::move(entryOrErr.get());
+
+  if (Function* stateIdFunc = entryModule->getFunction("dummyStateId"))
+  {
+    for (User* U : stateIdFunc->users())
+    {
+      CallInst* call = cast<CallInst>(U);
+      int functionIdx = (int)cast<ConstantInt>(call->getArgOperand(0))->getSExtValue();
+      call->setArgOperand(0, makeInt32(functionIdxMap[functionIdx], context));
+    }
+  }
+
+  // On failure, remove what was linked so the caller can run the transform
+  // instead, which creates the state functions under the same names.
+  Linker linker(m_module);
+  bool linkErr = linker.linkInModule(entryModule.get());
+  std::vector<Function*> linked;
+  for (unsigned i = 0; i < entry.numStateFunctions; ++i)
+  {
+    Function* stateF = m_module->getFunction(shader + ".ss_" + std::to_string(i));
+    if (stateF && !stateF->isDeclaration())
+      linked.push_back(stateF);
+  }
+  if (linkErr || linked.size() != entry.numStateFunctions)
+  {
+    for (Function* stateF : linked)
+      stateF->dropAllReferences();
+    for (Function* stateF : linked)
+    {
+      stateF->replaceAllUsesWith(UndefValue::get(stateF->getType()));
+      stateF->eraseFromParent();
+    }
+    return false;
+  }
+
+  stateFunctions.insert(stateFunctions.end(), linked.begin(), linked.end());
+  shaderStackSize = entry.stackSize;
+  return true;
+}
+
+bool DxrFallbackCompiler::loadCachedStateFunctions(const std::string& shader, const std::vector<std::string>& shaderNames, std::vector<Function*>& stateFunctions, unsigned int& shaderStackSize)
+{
+  if (!m_stateFunctionCache)
+    return false;
+  auto keyIt = m_shaderCacheKeys.find(shader);
+  if (keyIt == m_shaderCacheKeys.end())
+    return false;
+  DxrFallbackStateFunctionCache::Entry entry;
+  if (!m_stateFunctionCache->lookup(keyIt->second, entry))
+    return false;
+  return linkStateFunctions(shader, shaderNames, entry, stateFunctions, shaderStackSize);
+}
+
+void DxrFallbackCompiler::storeStateFunctions(const std::string& shader, const DxrFallbackStateFunctionCache::Entry& entry)
+{
+  if (!m_stateFunctionCache)
+    return;
+  auto keyIt = m_shaderCacheKeys.find(shader);
+  if (keyIt != m_shaderCacheKeys.end())
+    m_stateFunctionCache->insert(keyIt->second, entry);
+}
+
+void DxrFallbackCompiler::transformShadersInParallel(const std::vector<std::string>& shaderNames, const std::set<Value*>& resources, std::map<std::string, DxrFallbackStateFunctionCache::Entry>& results)
+{
+  // Verbose transforms print and dump as they go, which only makes sense
+  // one shader at a time.
+  if (m_threadCount == 1 || m_debugOutputLevel >= 2)
+    return;
+
+  struct ShaderJob
+  {
+    std::string name;
+    std::string functionName;
+    DXIL::ShaderKind kind;
+    std::vector<StateFunctionTransform::ParameterSemanticType> paramTypes;
+    bool done = false;
+    DxrFallbackStateFunctionCache::Entry entry;
+  };
+  std::vector<ShaderJob> jobs;
+  for (auto& shader : shaderNames)
+  {
+    Function* F = m_shaderMap[shader];
+    if (!F)
+      continue;
+    auto keyIt = m_shaderCacheKeys.find(shader);
+    if (m_stateFunctionCache && keyIt != m_shaderCacheKeys.end() && m_stateFunctionCache->contains(keyIt->second))
+      continue;
+    ShaderJob job;
+    job.name = shader;
+    job.functionName = F->getName();
+    job.kind = getRayShaderKind(F);
+    if (job.kind != DXIL::ShaderKind::Invalid)
+      job.paramTypes = getParameterTypes(F, job.kind);
+    jobs.push_back(std::move(job));
+  }
+
+  unsigned threadCount = m_threadCount ? m_threadCount : DxcThreadPool::GetDefaultThreadCount();
+  if (threadCount > jobs.size())
+    threadCount = (unsigned)jobs.size();
+  if (threadCount < 2)
+    return;
+
+  // An LLVMContext can only be used by one thread at a time, so each worker
+  // loads its own copy of the module and transforms shaders in it, as the
+  // serial path does in this one. The transform of one shader does not look
+  // at the others.
+  std::string bitcode;
+  {
+    raw_string_ostream OS(bitcode);
+    WriteBitcodeToFile(m_module, OS);
+  }
+  std::vector<std::string> resourceNames;
+  for (Value* r : resources)
+  {
+    if (r && r->hasName())
+      resourceNames.push_back(r->getName());
+  }
+
+  IMalloc* pMalloc = DxcGetThreadMallocNoRef();
+  std::atomic<size_t> nextJob(0);
+  {
+    DxcThreadPool pool(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+      pool.Async([&]()
+      {
+        DxcThreadMalloc TM(pMalloc);
+        try
+        {
+          LLVMContext context;
+          ErrorOr<std::unique_ptr<Module>> modOrErr = parseBitcodeFile(MemoryBufferRef(bitcode, "fallback"), context);
+          if (!modOrErr)
+            return;
+          Module* mod = modOrErr.get().get();
+          Type* runtimeDataArgTy = mod->getFunction("stackIntPtr")->arg_begin()->getType();
+          std::set<Value*> modResources;
+          for (auto& name : resourceNames)
+          {
+            if (GlobalValue* GV = mod->getNamedValue(name))
+              modResources.insert(GV);
+          }
+
+          for (;;)
+          {
+            size_t i = nextJob++;
+            if (i >= jobs.size())
+              return;
+            ShaderJob& job = jobs[i];
+            Function* F = mod->getFunction(job.functionName);
+            if (!F)
+              return;
+            StateFunctionTransform sft(F, shaderNames, runtimeDataArgTy);
+            if (job.name == "Fallback_TraceRay")
+              sft.setAttributeSize(m_maxAttributeSize);
+            if (job.kind != DXIL::ShaderKind::Invalid)
+              sft.setParameterInfo(job.paramTypes, job.kind == DXIL::ShaderKind::ClosestHit);
+            sft.setResourceGlobals(modResources);
+            std::vector<Function*> stateFunctions;
+            UINT shaderStackSize = 0;
+            sft.run(stateFunctions, shaderStackSize);
+            job.done = makeStateFunctionEntry(mod, stateFunctions, shaderNames, shaderStackSize, job.entry);
+          }
+        }
+        catch (...)
+        {
+          // Shaders this worker did not finish are transformed serially.
+        }
+      });
+    }
+  }
+
+  for (ShaderJob& job : jobs)
+  {
+    if (job.done)
+      results[job.name] = std::move(job.entry);
+  }
+}
+
 void DxrFallbackCompiler::createLaunchParams(Function* func)
 {
   Module* mod = func->getParent();
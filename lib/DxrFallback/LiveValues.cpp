@@ -1,8 +1,14 @@
 #include "LiveValues.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
 
 using namespace llvm;
 
@@ -335,3 +341,143 @@ bool LiveValues::getLiveAtIndex(const Value* value, unsigned int index) const
     return false;
   return (it->second.count(index) != 0);
 }
+
+
+typedef SmallPtrSet<BasicBlock*, 16> BlockPtrSet;
+
+// Collects the blocks in which the memory of alloc is accessed. Returns false
+// if its address escapes, in which case it may be accessed anywhere.
+static bool getAccessBlocks(AllocaInst* alloc, BlockPtrSet& blocks)
+{
+  SmallVector<Value*, 8> ptrs = { alloc };
+  SmallPtrSet<Value*, 8> visited;
+  while (!ptrs.empty())
+  {
+    Value* ptr = ptrs.pop_back_val();
+    if (!visited.insert(ptr).second)
+      continue;
+    for (User* U : ptr->users())
+    {
+      Instruction* I = cast<Instruction>(U);
+      if (isa<GetElementPtrInst>(I) || isa<BitCastInst>(I))
+        ptrs.push_back(I);
+      else if (isa<LoadInst>(I))
+        blocks.insert(I->getParent());
+      else if (StoreInst* SI = dyn_cast<StoreInst>(I))
+      {
+        if (SI->getValueOperand() == ptr)
+          return false;
+        blocks.insert(I->getParent());
+      }
+      else if (IntrinsicInst* II = dyn_cast<IntrinsicInst>(I))
+      {
+        if (II->getIntrinsicID() != Intrinsic::lifetime_start && II->getIntrinsicID() != Intrinsic::lifetime_end)
+          return false;
+      }
+      else
+        return false;
+    }
+  }
+  return true;
+}
+
+// Blocks reachable from (forward) or reaching (backward) the given blocks,
+// including the blocks themselves.
+static void getReachable(const BlockPtrSet& from, bool forward, BlockPtrSet& reached)
+{
+  SmallVector<BasicBlock*, 16> worklist(from.begin(), from.end());
+  while (!worklist.empty())
+  {
+    BasicBlock* BB = worklist.pop_back_val();
+    if (!reached.insert(BB).second)
+      continue;
+    if (forward)
+      worklist.append(succ_begin(BB), succ_end(BB));
+    else
+      worklist.append(pred_begin(BB), pred_end(BB));
+  }
+}
+
+uint64_t assignAllocaStackSlots(ArrayRef<AllocaInst*> allocas, const DataLayout& DL, uint64_t baseOffset, DenseMap<AllocaInst*, uint64_t>& offsets)
+{
+  struct Slot
+  {
+    AllocaInst* alloc;
+    uint64_t size;
+    unsigned alignment;
+    bool escapes;
+    BlockPtrSet region;
+    uint64_t offset;
+  };
+  std::vector<Slot> slots(allocas.size());
+  for (size_t i = 0; i < allocas.size(); ++i)
+  {
+    Slot& S = slots[i];
+    S.alloc = allocas[i];
+    S.size = DL.getTypeAllocSize(S.alloc->getAllocatedType());
+    S.alignment = S.alloc->getAlignment();
+    if (S.alignment == 0)
+      S.alignment = DL.getPrefTypeAlignment(S.alloc->getType());
+    S.offset = 0;
+
+    BlockPtrSet accessBlocks;
+    S.escapes = !getAccessBlocks(S.alloc, accessBlocks);
+    if (!S.escapes)
+    {
+      BlockPtrSet after, before;
+      getReachable(accessBlocks, true, after);
+      getReachable(accessBlocks, false, before);
+      for (BasicBlock* BB : after)
+      {
+        if (before.count(BB))
+          S.region.insert(BB);
+      }
+    }
+  }
+
+  auto interferes = [](const Slot& A, const Slot& B)
+  {
+    if (A.escapes || B.escapes)
+      return true;
+    const Slot& smaller = A.region.size() < B.region.size() ? A : B;
+    const Slot& larger = &smaller == &A ? B : A;
+    for (BasicBlock* BB : smaller.region)
+    {
+      if (larger.region.count(BB))
+        return true;
+    }
+    return false;
+  };
+
+  // Place the largest allocas first, each at the lowest offset that does not
+  // overlap an interfering alloca already placed.
+  std::vector<Slot*> order;
+  for (Slot& S : slots)
+    order.push_back(&S);
+  std::stable_sort(order.begin(), order.end(), [](const Slot* A, const Slot* B) { return A->size > B->size; });
+
+  uint64_t endOffset = baseOffset;
+  std::vector<Slot*> placed;
+  for (Slot* S : order)
+  {
+    uint64_t offset = RoundUpToAlignment(baseOffset, S->alignment);
+    bool moved = true;
+    while (moved)
+    {
+      moved = false;
+      for (Slot* P : placed)
+      {
+        if (offset < P->offset + P->size && P->offset < offset + S->size && interferes(*S, *P))
+        {
+          offset = RoundUpToAlignment(P->offset + P->size, S->alignment);
+          moved = true;
+        }
+      }
+    }
+    S->offset = offset;
+    placed.push_back(S);
+    offsets[S->alloc] = offset;
+    endOffset = std::max(endOffset, offset + S->size);
+  }
+  return endOffset;
+}
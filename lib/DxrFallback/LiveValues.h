@@ -13,6 +13,7 @@ namespace llvm
 {
   class AllocaInst;
   class BasicBlock;
+  class DataLayout;
   class Function;
   class Instruction;
   class Use;
@@ -79,3 +80,12 @@ private:
   void markLiveRange(llvm::Instruction* value, llvm::BasicBlock::iterator begin, llvm::BasicBlock::iterator end);
   void upAndMark(llvm::Instruction* v, llvm::Use& use, BlockSet& scanned);
 };
+
+
+// Assigns offsets, starting at baseOffset, to allocas that are moved to the
+// stack frame. Allocas whose contents are never needed at the same time share
+// bytes: an alloca's contents can only matter in blocks that are both
+// reachable from and can reach one of its accesses, and two allocas interfere
+// if those regions share a block. Allocas whose address escapes get bytes of
+// their own. Returns the offset just past the last slot.
+uint64_t assignAllocaStackSlots(llvm::ArrayRef<llvm::AllocaInst*> allocas, const llvm::DataLayout& DL, uint64_t baseOffset, llvm::DenseMap<llvm::AllocaInst*, uint64_t>& offsets);
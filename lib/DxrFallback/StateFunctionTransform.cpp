@@ -915,21 +915,23 @@ void StateFunctionTransform::preserveLiveValuesAcrossCallsites(_Out_ unsigned in
   // ... live allocas. 
   Module* mod = m_function->getParent();
   DataLayout DL(mod);
-  DenseMap<Instruction*, Instruction*> allocaToStack;
-  Instruction* insertBefore = getInstructionAfter(m_stackFrameOffset);
+  // Allocas whose contents are not needed at the same time share slots.
+  std::vector<AllocaInst*> liveAllocas;
   for (Instruction* inst : lv.getAllLiveValues())
   {
-    AllocaInst* alloc = dyn_cast<AllocaInst>(inst);
-    if (!alloc)
-      continue;
+    if (AllocaInst* alloc = dyn_cast<AllocaInst>(inst))
+      liveAllocas.push_back(alloc);
+  }
+  DenseMap<AllocaInst*, uint64_t> allocaOffsets;
+  offsetInBytes = assignAllocaStackSlots(liveAllocas, DL, offsetInBytes, allocaOffsets);
 
-    // Allocate a slot in the stack frame for the alloca
-    offsetInBytes = align(offsetInBytes, inst, DL);
-    Instruction* stackAlloca = createStackPtr(m_stackFrameOffset, alloc, offsetInBytes, insertBefore);
+  DenseMap<Instruction*, Instruction*> allocaToStack;
+  Instruction* insertBefore = getInstructionAfter(m_stackFrameOffset);
+  for (AllocaInst* alloc : liveAllocas)
+  {
+    Instruction* stackAlloca = createStackPtr(m_stackFrameOffset, alloc, (int)allocaOffsets[alloc], insertBefore);
     alloc->replaceAllUsesWith(stackAlloca);
-    allocaToStack[inst] = stackAlloca;
-
-    offsetInBytes += DL.getTypeAllocSize(alloc->getAllocatedType());
+    allocaToStack[alloc] = stackAlloca;
   }
   lv.remapLiveValues(allocaToStack); // replace old allocas with stackAllocas
   for (auto& kv : allocaToStack)
@@ -15,6 +15,8 @@
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilInstructions.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Function.h"
@@ -97,15 +99,36 @@ private:
   // Information per entry point.
   using FunctionSetType = std::unordered_set<llvm::Function *>;
   using InstructionSetType = std::unordered_set<llvm::Instruction *>;
+  // Bits index EntryInfo::Sources.
+  using SourceSetType = llvm::BitVector;
+  // An instruction reached while walking back from the outputs.
+  struct NodeInfo {
+    llvm::Instruction *pInst;
+    unsigned LowLink;
+    bool bOnStack = true;
+    bool bDone = false;
+    // Nodes this node depends on.
+    llvm::SmallVector<unsigned, 4> Succs;
+    // Sources contributing to this node, valid once bDone.
+    SourceSetType Sources;
+    NodeInfo(llvm::Instruction *pInst, unsigned Index)
+        : pInst(pInst), LowLink(Index) {}
+  };
   struct EntryInfo {
     llvm::Function *pEntryFunc = nullptr;
     // Sets of functions that may be reachable from an entry.
     FunctionSetType Functions;
     // Outputs to analyze.
     InstructionSetType Outputs;
-    // Contributing instructions per output.
-    std::unordered_map<unsigned, InstructionSetType>
-        ContributingInstructions[kNumStreams];
+    // Contributing sources per output.
+    std::unordered_map<unsigned, SourceSetType>
+        ContributingSources[kNumStreams];
+    // Instructions that can make an output depend on ViewID or an input:
+    // the ViewID and input loads.
+    std::vector<llvm::Instruction *> Sources;
+    // Dependence graph shared by all outputs, numbered in visit order.
+    std::vector<NodeInfo> Nodes;
+    llvm::DenseMap<llvm::Instruction *, unsigned> NodeIndex;
 
     void Clear();
   };
@@ -139,12 +162,15 @@ private:
                                     FunctionSetType &FuncSet);
   void AnalyzeFunctions(EntryInfo &Entry);
   void CollectValuesContributingToOutputs(EntryInfo &Entry);
-  void CollectValuesContributingToOutputRec(
-      EntryInfo &Entry, llvm::Value *pContributingValue,
-      InstructionSetType &ContributingInstructions);
-  void CollectPhiCFValuesContributingToOutputRec(
-      llvm::PHINode *pPhi, EntryInfo &Entry,
-      InstructionSetType &ContributingInstructions);
+  void CollectSourcesContributingToValue(EntryInfo &Entry,
+                                         llvm::Value *pContributingValue,
+                                         SourceSetType &ContributingSources);
+  unsigned AddNode(EntryInfo &Entry, llvm::Instruction *pInst,
+                   std::vector<unsigned> &NodeStack);
+  void CollectDependencies(EntryInfo &Entry, llvm::Instruction *pInst,
+                           llvm::SmallVectorImpl<llvm::Value *> &Deps);
+  void CollectPhiCFDependencies(llvm::PHINode *pPhi, EntryInfo &Entry,
+                                llvm::SmallVectorImpl<llvm::Value *> &Deps);
   const ValueSetType &CollectReachingDecls(llvm::Value *pValue);
   void CollectReachingDeclsRec(llvm::Value *pValue, ValueSetType &ReachingDecls,
                                ValueSetType &Visited);
@@ -153,8 +179,9 @@ private:
                         ValueSetType &Visited);
   void UpdateDynamicIndexUsageState() const;
   void
-  CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType>
-                       &ContributingInstructions,
+  CreateViewIdSets(const EntryInfo &Entry,
+                   const std::unordered_map<unsigned, SourceSetType>
+                       &ContributingSources,
                    OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                    InputsContributingToOutputType &InputsContributingToOutputs,
                    bool bPC);
@@ -203,17 +230,17 @@ void DxilViewIdStateBuilder::Compute() {
 
   // 5. Construct dependency sets.
   for (unsigned StreamId = 0; StreamId < (pSM->IsGS() ? kNumStreams : 1u); StreamId++) {
-    CreateViewIdSets(m_Entry.ContributingInstructions[StreamId],
+    CreateViewIdSets(m_Entry, m_Entry.ContributingSources[StreamId],
                      m_OutputsDependentOnViewId[StreamId],
                      m_InputsContributingToOutputs[StreamId], false);
   }
   if (pSM->IsHS() || pSM->IsMS()) {
-    CreateViewIdSets(m_PCEntry.ContributingInstructions[0],
+    CreateViewIdSets(m_PCEntry, m_PCEntry.ContributingSources[0],
                      m_PCOrPrimOutputsDependentOnViewId,
                      m_InputsContributingToPCOrPrimOutputs, true);
   } else if (pSM->IsDS()) {
     OutputsDependentOnViewIdType OutputsDependentOnViewId;
-    CreateViewIdSets(m_Entry.ContributingInstructions[0],
+    CreateViewIdSets(m_Entry, m_Entry.ContributingSources[0],
                      OutputsDependentOnViewId,
                      m_PCInputsContributingToOutputs, true);
     DXASSERT_NOMSG(OutputsDependentOnViewId == m_OutputsDependentOnViewId[0]);
@@ -253,7 +280,10 @@ void DxilViewIdStateBuilder::EntryInfo::Clear() {
   Functions.clear();
   Outputs.clear();
   for (unsigned i = 0; i < kNumStreams; i++)
-    ContributingInstructions[i].clear();
+    ContributingSources[i].clear();
+  Sources.clear();
+  Nodes.clear();
+  NodeIndex.clear();
 }
 
 void DxilViewIdStateBuilder::FuncInfo::Clear() {
@@ -463,15 +493,15 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(EntryInfo &Entry
       endRow = SigElem.GetRows() - 1;
     }
 
-    InstructionSetType ContributingInstructionsAllRows;
-    InstructionSetType *pContributingInstructions = &ContributingInstructionsAllRows;
+    SourceSetType ContributingSourcesAllRows;
+    SourceSetType *pContributingSources = &ContributingSourcesAllRows;
     if (startRow == endRow) {
       // Scalar or indexable with known index.
       unsigned index = GetLinearIndex(SigElem, startRow, col);
-      pContributingInstructions = &Entry.ContributingInstructions[StreamId][index];
+      pContributingSources = &Entry.ContributingSources[StreamId][index];
     }
 
-    CollectValuesContributingToOutputRec(Entry, pContributingValue, *pContributingInstructions);
+    CollectSourcesContributingToValue(Entry, pContributingValue, *pContributingSources);
 
     // Handle control dependence of this instruction BB.
     BasicBlock *pBB = CI->getParent();
@@ -479,22 +509,32 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(EntryInfo &Entry
     FuncInfo *pFuncInfo = m_FuncInfo[F].get();
     const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
     for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), *pContributingInstructions);
+      CollectSourcesContributingToValue(Entry, B->getTerminator(), *pContributingSources);
     }
 
-    if (pContributingInstructions == &ContributingInstructionsAllRows) {
+    if (pContributingSources == &ContributingSourcesAllRows) {
       // Write dynamically indexed output contributions to all rows.
       for (int row = startRow; row <= endRow; row++) {
         unsigned index = GetLinearIndex(SigElem, row, col);
-        Entry.ContributingInstructions[StreamId][index].insert(ContributingInstructionsAllRows.begin(), ContributingInstructionsAllRows.end());
+        Entry.ContributingSources[StreamId][index] |= ContributingSourcesAllRows;
       }
     }
   }
 }
 
-void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Entry,
-                                                           Value *pContributingValue,
-                                                           InstructionSetType &ContributingInstructions) {
+static bool IsViewIdStateSource(Instruction *pInst) {
+  return DxilInst_ViewID(pInst) || DxilInst_LoadInput(pInst) ||
+         DxilInst_LoadOutputControlPoint(pInst) ||
+         DxilInst_LoadPatchConstant(pInst);
+}
+
+// Adds to ContributingSources every source that pContributingValue depends
+// on. The dependence graph of the entry is walked once, shared by all outputs:
+// the sources reaching each node are computed per strongly connected
+// component (Tarjan), so a node's set is final as soon as its component is.
+void DxilViewIdStateBuilder::CollectSourcesContributingToValue(EntryInfo &Entry,
+                                                        Value *pContributingValue,
+                                                        SourceSetType &ContributingSources) {
   if (dyn_cast<Argument>(pContributingValue)) {
     // This must be a leftover signature argument of an entry function.
     DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
@@ -509,13 +549,109 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
     return;
   }
 
-  auto itInst = ContributingInstructions.emplace(pContributingInst);
-  // Already visited instruction.
-  if (!itInst.second) return;
+  auto itNode = Entry.NodeIndex.find(pContributingInst);
+  if (itNode != Entry.NodeIndex.end()) {
+    // Nodes not done yet are only reachable from nodes on the stack.
+    DXASSERT_NOMSG(Entry.Nodes[itNode->second].bDone);
+    ContributingSources |= Entry.Nodes[itNode->second].Sources;
+    return;
+  }
+
+  std::vector<unsigned> NodeStack;
+  // Pending dependencies of the nodes being visited, with the node they
+  // belong to.
+  SmallVector<std::pair<unsigned, SmallVector<Value *, 8>>, 16> VisitStack;
+  unsigned RootIdx = AddNode(Entry, pContributingInst, NodeStack);
+  VisitStack.emplace_back(RootIdx, SmallVector<Value *, 8>());
+  CollectDependencies(Entry, pContributingInst, VisitStack.back().second);
+
+  while (!VisitStack.empty()) {
+    unsigned Idx = VisitStack.back().first;
+    SmallVectorImpl<Value *> &Deps = VisitStack.back().second;
+    if (!Deps.empty()) {
+      Value *pDep = Deps.pop_back_val();
+      if (dyn_cast<Argument>(pDep)) {
+        DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
+                       Entry.pEntryFunc == m_pModule->GetPatchConstantFunction());
+        continue;
+      }
+      Instruction *pDepInst = dyn_cast<Instruction>(pDep);
+      if (pDepInst == nullptr) {
+        DXASSERT_NOMSG(isa<Constant>(pDep) || isa<BasicBlock>(pDep));
+        continue;
+      }
+
+      auto itDep = Entry.NodeIndex.find(pDepInst);
+      if (itDep == Entry.NodeIndex.end()) {
+        unsigned DepIdx = AddNode(Entry, pDepInst, NodeStack);
+        Entry.Nodes[Idx].Succs.push_back(DepIdx);
+        VisitStack.emplace_back(DepIdx, SmallVector<Value *, 8>());
+        CollectDependencies(Entry, pDepInst, VisitStack.back().second);
+        continue;
+      }
+
+      unsigned DepIdx = itDep->second;
+      NodeInfo &DepNode = Entry.Nodes[DepIdx];
+      if (DepNode.bOnStack)
+        Entry.Nodes[Idx].LowLink = std::min(Entry.Nodes[Idx].LowLink, DepIdx);
+      Entry.Nodes[Idx].Succs.push_back(DepIdx);
+      continue;
+    }
+
+    VisitStack.pop_back();
+    if (!VisitStack.empty()) {
+      NodeInfo &Parent = Entry.Nodes[VisitStack.back().first];
+      Parent.LowLink = std::min(Parent.LowLink, Entry.Nodes[Idx].LowLink);
+    }
+    if (Entry.Nodes[Idx].LowLink != Idx)
+      continue;
+
+    // Idx is the root of a component; its members are on top of NodeStack.
+    auto itFirst = std::find(NodeStack.rbegin(), NodeStack.rend(), Idx).base() - 1;
+    SourceSetType Sources;
+    for (auto it = itFirst; it != NodeStack.end(); ++it) {
+      NodeInfo &Member = Entry.Nodes[*it];
+      if (IsViewIdStateSource(Member.pInst)) {
+        unsigned SourceIdx = Entry.Sources.size();
+        Entry.Sources.push_back(Member.pInst);
+        Sources.resize(SourceIdx + 1);
+        Sources.set(SourceIdx);
+      }
+      for (unsigned Succ : Member.Succs) {
+        if (Entry.Nodes[Succ].bDone)
+          Sources |= Entry.Nodes[Succ].Sources;
+      }
+    }
+    for (auto it = itFirst; it != NodeStack.end(); ++it) {
+      NodeInfo &Member = Entry.Nodes[*it];
+      Member.Sources = Sources;
+      Member.bOnStack = false;
+      Member.bDone = true;
+      Member.Succs.clear();
+    }
+    NodeStack.erase(itFirst, NodeStack.end());
+  }
+
+  DXASSERT_NOMSG(NodeStack.empty());
+  ContributingSources |= Entry.Nodes[RootIdx].Sources;
+}
+
+unsigned DxilViewIdStateBuilder::AddNode(EntryInfo &Entry, Instruction *pInst,
+                                         std::vector<unsigned> &NodeStack) {
+  unsigned Idx = Entry.Nodes.size();
+  Entry.Nodes.emplace_back(pInst, Idx);
+  Entry.NodeIndex[pInst] = Idx;
+  NodeStack.push_back(Idx);
+  return Idx;
+}
 
+// Collects the values pContributingInst directly depends on.
+void DxilViewIdStateBuilder::CollectDependencies(EntryInfo &Entry,
+                                                 Instruction *pContributingInst,
+                                                 SmallVectorImpl<Value *> &Deps) {
   // Handle special cases.
   if (PHINode *phi = dyn_cast<PHINode>(pContributingInst)) {
-    CollectPhiCFValuesContributingToOutputRec(phi, Entry, ContributingInstructions);
+    CollectPhiCFDependencies(phi, Entry, Deps);
   } else if (isa<LoadInst>(pContributingInst) || 
              isa<AtomicCmpXchgInst>(pContributingInst) ||
              isa<AtomicRMWInst>(pContributingInst)) {
@@ -525,9 +661,7 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
     DXASSERT_NOMSG(ReachingDecls.size() > 0);
     for (Value *pDeclValue : ReachingDecls) {
       const ValueSetType &Stores = CollectStores(pDeclValue);
-      for (Value *V : Stores) {
-        CollectValuesContributingToOutputRec(Entry, V, ContributingInstructions);
-      }
+      Deps.append(Stores.begin(), Stores.end());
     }
   } else if (CallInst *CI = dyn_cast<CallInst>(pContributingInst)) {
     if (!hlsl::OP::IsDxilOpFuncCallInst(CI)) {
@@ -536,20 +670,14 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
         // Return value of a user function.
         if (Entry.Functions.find(F) != Entry.Functions.end()) {
           const FuncInfo &FI = *m_FuncInfo[F];
-          for (ReturnInst *pRetInst : FI.Returns) {
-            CollectValuesContributingToOutputRec(Entry, pRetInst, ContributingInstructions);
-          }
+          Deps.append(FI.Returns.begin(), FI.Returns.end());
         }
       }
     }
   }
 
   // Handle instruction inputs.
-  unsigned NumOps = pContributingInst->getNumOperands();
-  for (unsigned i = 0; i < NumOps; i++) {
-    Value *O = pContributingInst->getOperand(i);
-    CollectValuesContributingToOutputRec(Entry, O, ContributingInstructions);
-  }
+  Deps.append(pContributingInst->op_begin(), pContributingInst->op_end());
 
   // Handle control dependence of this instruction BB.
   BasicBlock *pBB = pContributingInst->getParent();
@@ -557,7 +685,7 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
   for (BasicBlock *B : CtrlDepSet) {
-    CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+    Deps.push_back(B->getTerminator());
   }
 }
 
@@ -566,9 +694,9 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
 // However, this may be too conservative and, as such, pick up extra control dependent BBs.
 // A better "definition" point is the highest dominator where it is still legal to "insert" constant assignment.
 // In this context, "legal" means that only one value "leaves" the dominator and reaches Phi.
-void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(PHINode *pPhi,
-                                                                EntryInfo &Entry,
-                                                                InstructionSetType &ContributingInstructions) {
+void DxilViewIdStateBuilder::CollectPhiCFDependencies(PHINode *pPhi,
+                                                      EntryInfo &Entry,
+                                                      SmallVectorImpl<Value *> &Deps) {
   Function *F = pPhi->getParent()->getParent();
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   unordered_map<DomTreeNodeBase<BasicBlock> *, Value *> DomTreeMarkers;
@@ -643,7 +771,7 @@ void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(PHINode *
     pBB = pDefDomNode->getBlock();
     const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
     for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+      Deps.push_back(B->getTerminator());
     }
   }
 }
@@ -747,15 +875,19 @@ void DxilViewIdStateBuilder::CollectStoresRec(llvm::Value *pValue, ValueSetType
   }
 }
 
-void DxilViewIdStateBuilder::CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType> &ContributingInstructions, 
+void DxilViewIdStateBuilder::CreateViewIdSets(const EntryInfo &Entry,
+                                       const std::unordered_map<unsigned, SourceSetType> &ContributingSources,
                                        OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                                        InputsContributingToOutputType &InputsContributingToOutputs,
                                        bool bPC) {
   const ShaderModel *pSM = m_pModule->GetShaderModel();
 
-  for (auto &itOut : ContributingInstructions) {
+  for (auto &itOut : ContributingSources) {
     unsigned outIdx = itOut.first;
-    for (Instruction *pInst : itOut.second) {
+    const SourceSetType &Sources = itOut.second;
+    for (int SourceIdx = Sources.find_first(); SourceIdx != -1;
+         SourceIdx = Sources.find_next(SourceIdx)) {
+      Instruction *pInst = Entry.Sources[SourceIdx];
       // Set output dependence on ViewId.
       if (DxilInst_ViewID VID = DxilInst_ViewID(pInst)) {
         DXASSERT(m_bUsesViewId, "otherwise, DxilModule flag not set properly");
@@ -23,6 +23,7 @@
 #include "llvm/Analysis/DxilValueCache.h"
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/DxcThreadPool.h"
 
 #include "llvm/Pass.h"
 #include "llvm/PassInfo.h"
@@ -37,9 +38,11 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/Analysis/CFGPrinter.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #include <algorithm>
 #include <list>   // should change this for string_table
+#include <memory>
 #include <vector>
 
 #include "llvm/PassPrinters/PassPrinters.h"
@@ -86,9 +89,11 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDSEPass(Registry);
     initializeDeadInstEliminationPass(Registry);
     initializeDxilAllocateResourcesForLibPass(Registry);
+    initializeDxilCBufferLoadCoalescePass(Registry);
     initializeDxilCleanupAddrSpaceCastPass(Registry);
     initializeDxilCondenseResourcesPass(Registry);
     initializeDxilConditionalMem2RegPass(Registry);
+    initializeDxilContractMadPass(Registry);
     initializeDxilConvergentClearPass(Registry);
     initializeDxilConvergentMarkPass(Registry);
     initializeDxilDeadFunctionEliminationPass(Registry);
@@ -101,6 +106,8 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDxilFinalizePreservesPass(Registry);
     initializeDxilFixConstArrayInitializerPass(Registry);
     initializeDxilGenerationPassPass(Registry);
+    initializeDxilHoistHandlesPass(Registry);
+    initializeDxilHoistUniformPass(Registry);
     initializeDxilInsertPreservesPass(Registry);
     initializeDxilLegalizeEvalOperationsPass(Registry);
     initializeDxilLegalizeResourcesPass(Registry);
@@ -108,16 +115,22 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDxilLoadMetadataPass(Registry);
     initializeDxilLoopUnrollPass(Registry);
     initializeDxilLowerCreateHandleForLibPass(Registry);
+    initializeDxilMinimizeMeshOutputsPass(Registry);
+    initializeDxilNarrowPrecisionPass(Registry);
+    initializeDxilPadGroupSharedPass(Registry);
     initializeDxilPrecisePropagatePassPass(Registry);
     initializeDxilPreserveAllOutputsPass(Registry);
     initializeDxilPreserveToSelectPass(Registry);
     initializeDxilPromoteLocalResourcesPass(Registry);
     initializeDxilPromoteStaticResourcesPass(Registry);
+    initializeDxilRematerializePass(Registry);
     initializeDxilRemoveDeadBlocksPass(Registry);
     initializeDxilSimpleGVNHoistPass(Registry);
     initializeDxilTranslateRawBufferPass(Registry);
     initializeDxilValidateWaveSensitivityPass(Registry);
     initializeDxilValueCachePass(Registry);
+    initializeDxilVectorizeBufferAccessesPass(Registry);
+    initializeDxilWaveAggregateAtomicsPass(Registry);
     initializeDynamicIndexingVectorToArrayPass(Registry);
     initializeEarlyCSELegacyPassPass(Registry);
     initializeEliminateAvailableExternallyPass(Registry);
@@ -201,11 +214,11 @@ static ArrayRef<LPCSTR> GetPassArgNames(LPCSTR passName) {
   static const LPCSTR CFGSimplifyPassArgs[] = { "Threshold", "Ftor", "bonus-inst-threshold" };
   static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "force-early-z", "add-pixel-cost", "rt-width", "sv-position-index", "num-pixels" };
   static const LPCSTR DxilConditionalMem2RegArgs[] = { "NoOpt" };
-  static const LPCSTR DxilDebugInstrumentationArgs[] = { "UAVSize", "parameter0", "parameter1", "parameter2" };
+  static const LPCSTR DxilDebugInstrumentationArgs[] = { "UAVSize", "parameter0", "parameter1", "parameter2", "compact", "sampleRate" };
   static const LPCSTR DxilGenerationPassArgs[] = { "NotOptimized" };
   static const LPCSTR DxilOutputColorBecomesConstantArgs[] = { "mod-mode", "constant-red", "constant-green", "constant-blue", "constant-alpha" };
-  static const LPCSTR DxilPIXMeshShaderOutputInstrumentationArgs[] = { "UAVSize" };
-  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "config", "checkForDynamicIndexing" };
+  static const LPCSTR DxilPIXMeshShaderOutputInstrumentationArgs[] = { "UAVSize", "sampleRate" };
+  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "config", "checkForDynamicIndexing", "waveAggregate" };
   static const LPCSTR DynamicIndexingVectorToArrayArgs[] = { "ReplaceAllVectors" };
   static const LPCSTR Float2IntArgs[] = { "float2int-max-integer-bw" };
   static const LPCSTR GVNArgs[] = { "noloads", "enable-pre", "enable-load-pre", "max-recurse-depth" };
@@ -278,11 +291,11 @@ static ArrayRef<LPCSTR> GetPassArgDescriptions(LPCSTR passName) {
   static const LPCSTR CFGSimplifyPassArgs[] = { "None", "None", "Control the number of bonus instructions (default = 1)" };
   static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "None", "None", "None", "None", "None" };
   static const LPCSTR DxilConditionalMem2RegArgs[] = { "None" };
-  static const LPCSTR DxilDebugInstrumentationArgs[] = { "None", "None", "None", "None" };
+  static const LPCSTR DxilDebugInstrumentationArgs[] = { "None", "None", "None", "None", "Write the compact trace format, which the PIX trace decoder expands", "If non-zero, ignore the parameters and instrument one in this many invocations" };
   static const LPCSTR DxilGenerationPassArgs[] = { "None" };
   static const LPCSTR DxilOutputColorBecomesConstantArgs[] = { "None", "None", "None", "None", "None" };
-  static const LPCSTR DxilPIXMeshShaderOutputInstrumentationArgs[] = { "None" };
-  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "None", "None" };
+  static const LPCSTR DxilPIXMeshShaderOutputInstrumentationArgs[] = { "None", "If non-zero, instrument one in this many thread groups" };
+  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "None", "None", "Write each access once per wave when all lanes hit the same slot" };
   static const LPCSTR DynamicIndexingVectorToArrayArgs[] = { "None" };
   static const LPCSTR Float2IntArgs[] = { "Max integer bitwidth to consider in float2int" };
   static const LPCSTR GVNArgs[] = { "None", "None", "None", "Max recurse depth" };
@@ -374,6 +387,7 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("add-pixel-cost")
     ||  S.equals("bonus-inst-threshold")
     ||  S.equals("checkForDynamicIndexing")
+    ||  S.equals("compact")
     ||  S.equals("config")
     ||  S.equals("constant-alpha")
     ||  S.equals("constant-blue")
@@ -411,6 +425,7 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("rt-width")
     ||  S.equals("sample-profile-file")
     ||  S.equals("sample-profile-max-propagate-iterations")
+    ||  S.equals("sampleRate")
     ||  S.equals("sroa-random-shuffle-slices")
     ||  S.equals("sroa-strict-inbounds")
     ||  S.equals("sv-position-index")
@@ -423,7 +438,8 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("unroll-runtime")
     ||  S.equals("unroll-threshold")
     ||  S.equals("vector-library")
-    ||  S.equals("verify-debug-info");
+    ||  S.equals("verify-debug-info")
+    ||  S.equals("waveAggregate");
   // ISPASSOPTIONNAME:END
 }
 
@@ -502,7 +518,7 @@ public:
   }
 };
 
-class DxcOptimizer : public IDxcOptimizer {
+class DxcOptimizer : public IDxcOptimizer2 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   PassRegistry *m_registry;
@@ -512,7 +528,8 @@ public:
   DXC_MICROCOM_TM_CTOR(DxcOptimizer)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcOptimizer>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcOptimizer, IDxcOptimizer2>(this, iid,
+                                                                ppvObject);
   }
 
   HRESULT Initialize();
@@ -526,6 +543,87 @@ public:
     _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
     _COM_Outptr_ IDxcBlob **ppOutputModule,
     _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) override;
+  HRESULT STDMETHODCALLTYPE CreateSession(
+    _In_ IDxcBlob *pBlob, _COM_Outptr_ IDxcOptimizerSession **ppSession) override;
+
+  HRESULT LoadModule(IDxcBlob *pBlob, LLVMContext &Context,
+                     std::unique_ptr<Module> &M);
+  HRESULT RunPasses(Module *M, _In_count_(optionCount) LPCWSTR *ppOptions,
+                    UINT32 optionCount,
+                    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText);
+  HRESULT WriteModule(Module *M, _COM_Outptr_ IDxcBlob **ppOutputModule);
+};
+
+// Keeps a module alive between runs; see IDxcOptimizerSession.
+class DxcOptimizerSession : public IDxcOptimizerSession2 {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<DxcOptimizer> m_pOptimizer;
+  // Shared with clones; declared first so the module is destroyed before it.
+  std::shared_ptr<LLVMContext> m_pContext;
+  std::unique_ptr<Module> m_pModule;
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR_ONLY(DxcOptimizerSession)
+  DXC_MICROCOM_TM_ALLOC(DxcOptimizerSession)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcOptimizerSession, IDxcOptimizerSession2>(
+        this, iid, ppvObject);
+  }
+
+  HRESULT Initialize(DxcOptimizer *pOptimizer,
+                     std::shared_ptr<LLVMContext> pContext,
+                     std::unique_ptr<Module> pModule) {
+    m_pOptimizer = pOptimizer;
+    m_pContext = std::move(pContext);
+    m_pModule = std::move(pModule);
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE Run(
+      _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+      _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) override {
+    AssignToOutOpt(nullptr, ppOutputText);
+    if (optionCount > 0 && ppOptions == nullptr)
+      return E_POINTER;
+    DxcThreadMalloc TM(m_pMalloc);
+    return m_pOptimizer->RunPasses(m_pModule.get(), ppOptions, optionCount,
+                                   ppOutputText);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetModule(
+      _COM_Outptr_ IDxcBlob **ppOutputModule) override {
+    if (ppOutputModule == nullptr)
+      return E_POINTER;
+    *ppOutputModule = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    return m_pOptimizer->WriteModule(m_pModule.get(), ppOutputModule);
+  }
+
+  HRESULT STDMETHODCALLTYPE Clone(
+      _COM_Outptr_ IDxcOptimizerSession **ppClone) override {
+    if (ppClone == nullptr)
+      return E_POINTER;
+    *ppClone = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      std::unique_ptr<Module> M(llvm::CloneModule(m_pModule.get()));
+      CComPtr<DxcOptimizerSession> pClone =
+          DxcOptimizerSession::Alloc(m_pMalloc);
+      IFROOM(pClone.p);
+      IFT(pClone->Initialize(m_pOptimizer, m_pContext, std::move(M)));
+      *ppClone = pClone.Detach();
+    }
+    CATCH_CPP_RETURN_HRESULT();
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE RunVariants(
+      _In_count_(variantCount) const DxcOptimizerVariant *pVariants,
+      UINT32 variantCount,
+      _Out_writes_(variantCount) IDxcBlob **ppOutputModules,
+      _Out_writes_opt_(variantCount) IDxcBlobEncoding **ppOutputTexts) override;
 };
 
 class CapturePassManager : public llvm::legacy::PassManagerBase {
@@ -601,6 +699,100 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
 
   DxcThreadMalloc TM(m_pMalloc);
 
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+  IFR(LoadModule(pBlob, Context, M));
+  IFR(RunPasses(M.get(), ppOptions, optionCount, ppOutputText));
+  if (ppOutputModule != nullptr) {
+    IFR(WriteModule(M.get(), ppOutputModule));
+  }
+
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcOptimizer::CreateSession(
+    _In_ IDxcBlob *pBlob, _COM_Outptr_ IDxcOptimizerSession **ppSession) {
+  if (ppSession == nullptr)
+    return E_POINTER;
+  *ppSession = nullptr;
+  if (pBlob == nullptr)
+    return E_POINTER;
+
+  DxcThreadMalloc TM(m_pMalloc);
+
+  try {
+    std::shared_ptr<LLVMContext> pContext = std::make_shared<LLVMContext>();
+    std::unique_ptr<Module> M;
+    IFR(LoadModule(pBlob, *pContext, M));
+    CComPtr<DxcOptimizerSession> pSession =
+        DxcOptimizerSession::Alloc(m_pMalloc);
+    IFROOM(pSession.p);
+    IFT(pSession->Initialize(this, std::move(pContext), std::move(M)));
+    *ppSession = pSession.Detach();
+  }
+  CATCH_CPP_RETURN_HRESULT();
+
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcOptimizerSession::RunVariants(
+    _In_count_(variantCount) const DxcOptimizerVariant *pVariants,
+    UINT32 variantCount, _Out_writes_(variantCount) IDxcBlob **ppOutputModules,
+    _Out_writes_opt_(variantCount) IDxcBlobEncoding **ppOutputTexts) {
+  if (ppOutputModules == nullptr)
+    return E_POINTER;
+  for (UINT32 i = 0; i < variantCount; ++i) {
+    ppOutputModules[i] = nullptr;
+    if (ppOutputTexts != nullptr)
+      ppOutputTexts[i] = nullptr;
+  }
+  if (variantCount > 0 && pVariants == nullptr)
+    return E_POINTER;
+  for (UINT32 i = 0; i < variantCount; ++i) {
+    if (pVariants[i].OptionCount > 0 && pVariants[i].pOptions == nullptr)
+      return E_POINTER;
+  }
+  if (variantCount == 0)
+    return S_OK;
+
+  DxcThreadMalloc TM(m_pMalloc);
+
+  try {
+    // An LLVMContext cannot be shared between threads, so rather than clone
+    // the module each variant reads a bitcode snapshot of it into a context
+    // of its own. The session's module was parsed once already; reading
+    // bitcode is the cheap part, and it happens on the workers.
+    CComPtr<IDxcBlob> pSnapshot;
+    IFT(m_pOptimizer->WriteModule(m_pModule.get(), &pSnapshot));
+
+    std::vector<HRESULT> Statuses(variantCount, S_OK);
+    unsigned ThreadCount = DxcThreadPool::GetDefaultThreadCount();
+    if (ThreadCount > variantCount)
+      ThreadCount = variantCount;
+    DxcThreadPool Pool(ThreadCount);
+    for (UINT32 i = 0; i < variantCount; ++i) {
+      Pool.Async([&, i]() {
+        // RunOptimizer installs the optimizer's allocator itself.
+        Statuses[i] = m_pOptimizer->RunOptimizer(
+            pSnapshot, pVariants[i].pOptions, pVariants[i].OptionCount,
+            &ppOutputModules[i],
+            ppOutputTexts ? &ppOutputTexts[i] : nullptr);
+      });
+    }
+    Pool.Wait();
+
+    for (HRESULT hr : Statuses) {
+      if (FAILED(hr))
+        return hr;
+    }
+  }
+  CATCH_CPP_RETURN_HRESULT();
+
+  return S_OK;
+}
+
+HRESULT DxcOptimizer::LoadModule(IDxcBlob *pBlob, LLVMContext &Context,
+                                 std::unique_ptr<Module> &M) {
   // Setup input buffer.
   //
   // The ir parsing requires the buffer to be null terminated. We deal with
@@ -609,10 +801,8 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
   //
   // If we have the beginning of a DXIL program header, skip to the bitcode.
   //
-  LLVMContext Context;
   SMDiagnostic Err;
   std::unique_ptr<MemoryBuffer> memBuf;
-  std::unique_ptr<Module> M;
   const char * pBlobContent = reinterpret_cast<const char *>(pBlob->GetBufferPointer());
   unsigned blobSize = pBlob->GetBufferSize();
   const DxilProgramHeader *pProgramHeader =
@@ -632,9 +822,15 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
   if (M == nullptr) {
     return DXC_E_IR_VERIFICATION_FAILED;
   }
+  return S_OK;
+}
 
+HRESULT DxcOptimizer::RunPasses(Module *M,
+                                _In_count_(optionCount) LPCWSTR *ppOptions,
+                                UINT32 optionCount,
+                                _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) {
   legacy::PassManager ModulePasses;
-  legacy::FunctionPassManager FunctionPasses(M.get());
+  legacy::FunctionPassManager FunctionPasses(M);
   legacy::PassManagerBase *pPassManager = &ModulePasses;
 
   try {
@@ -809,26 +1005,33 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
       ScopedFatalErrorHandler errHandler(FatalErrorHandlerStreamWrite, err_ostream);
 
       FunctionPasses.doInitialization();
-      for (Function &F : *M.get())
+      for (Function &F : *M)
         if (!F.isDeclaration())
           FunctionPasses.run(F);
       FunctionPasses.doFinalization();
-      ModulePasses.run(*M.get());
+      ModulePasses.run(*M);
     }
 
     outStream.flush();
     if (ppOutputText != nullptr) {
       IFT(DxcCreateBlobWithEncodingSet(pOutputBlob, CP_UTF8, ppOutputText));
     }
-    if (ppOutputModule != nullptr) {
-      CComPtr<AbstractMemoryStream> pProgramStream;
-      IFT(CreateMemoryStream(m_pMalloc, &pProgramStream));
-      {
-        raw_stream_ostream outStream(pProgramStream.p);
-        WriteBitcodeToFile(M.get(), outStream, true);
-      }
-      IFT(pProgramStream.QueryInterface(ppOutputModule));
+  }
+  CATCH_CPP_RETURN_HRESULT();
+
+  return S_OK;
+}
+
+HRESULT DxcOptimizer::WriteModule(Module *M,
+                                  _COM_Outptr_ IDxcBlob **ppOutputModule) {
+  try {
+    CComPtr<AbstractMemoryStream> pProgramStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pProgramStream));
+    {
+      raw_stream_ostream outStream(pProgramStream.p);
+      WriteBitcodeToFile(M, outStream, true);
     }
+    IFT(pProgramStream.QueryInterface(ppOutputModule));
   }
   CATCH_CPP_RETURN_HRESULT();
 
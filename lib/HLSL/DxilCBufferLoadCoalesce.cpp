@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCBufferLoadCoalesce.cpp                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Coalesces legacy constant buffer row loads across blocks.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include <map>
+#include <tuple>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Constant buffers do not change while a shader runs, so every load of a row
+// can be replaced with one load that dominates them all. GVN only merges a
+// load with one that dominates it, which leaves a row loaded once in each
+// branch of an if, or in each block after a branch, like this:
+// if (a) {
+//   r = cb.x;
+// } else {
+//   r = cb.y;     // same row as cb.x
+// }
+class DxilCBufferLoadCoalesce : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilCBufferLoadCoalesce() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL coalesce constant buffer loads";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool CoalesceRow(ArrayRef<CallInst *> Loads, DominatorTree &DT,
+                   LoopInfo &LI);
+};
+
+char DxilCBufferLoadCoalesce::ID = 0;
+
+// Each block that uses a constant buffer creates its own handle to it, so
+// loads are matched on the buffer behind the handle.
+Value *GetBuffer(Value *Handle) {
+  CallInst *CI = dyn_cast<CallInst>(Handle);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandleForLib))
+    return Handle;
+  DxilInst_CreateHandleForLib CreateHandle(CI);
+  LoadInst *LI = dyn_cast<LoadInst>(CreateHandle.get_Resource());
+  if (!LI || !isa<GlobalVariable>(LI->getPointerOperand()))
+    return Handle;
+  return LI->getPointerOperand();
+}
+
+bool IsAvailableIn(Value *V, BasicBlock *BB, DominatorTree &DT) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  return !I || DT.dominates(I->getParent(), BB);
+}
+
+bool DxilCBufferLoadCoalesce::CoalesceRow(ArrayRef<CallInst *> Loads,
+                                          DominatorTree &DT, LoopInfo &LI) {
+  DxilInst_CBufferLoadLegacy First(Loads.front());
+  Value *Buffer = GetBuffer(First.get_handle());
+  Value *Row = First.get_regIndex();
+
+  BasicBlock *Dom = Loads.front()->getParent();
+  for (CallInst *Load : Loads)
+    Dom = DT.findNearestCommonDominator(Dom, Load->getParent());
+  // Do not move the load into a loop that some of the loads are outside of.
+  while (Loop *L = LI.getLoopFor(Dom)) {
+    bool bAllInLoop = true;
+    for (CallInst *Load : Loads)
+      bAllInLoop &= L->contains(Load->getParent());
+    if (bAllInLoop)
+      break;
+    BasicBlock *Outside = DT.getNode(L->getHeader())->getIDom()->getBlock();
+    if (!IsAvailableIn(Row, Outside, DT) ||
+        !IsAvailableIn(Buffer, Outside, DT))
+      return false;
+    Dom = Outside;
+  }
+
+  // Keep the first load in Dom if there is one, or else move one there.
+  SmallPtrSet<CallInst *, 8> LoadSet(Loads.begin(), Loads.end());
+  CallInst *Leader = nullptr;
+  for (Instruction &I : *Dom) {
+    CallInst *CI = dyn_cast<CallInst>(&I);
+    if (CI && LoadSet.count(CI)) {
+      Leader = CI;
+      break;
+    }
+  }
+  if (!Leader) {
+    Instruction *InsertPt = Dom->getTerminator();
+    Leader = Loads.front();
+    Leader->moveBefore(InsertPt);
+    // The handle the load used is in a block that Dom does not reach, so
+    // create another one from the buffer.
+    Instruction *HandleI =
+        dyn_cast<Instruction>(DxilInst_CBufferLoadLegacy(Leader).get_handle());
+    if (HandleI && !DT.dominates(HandleI, Leader)) {
+      Instruction *Res = cast<Instruction>(
+          DxilInst_CreateHandleForLib(HandleI).get_Resource());
+      Instruction *NewRes = Res->clone();
+      NewRes->insertBefore(Leader);
+      Instruction *NewHandle = HandleI->clone();
+      NewHandle->setOperand(DxilInst_CreateHandleForLib::arg_Resource, NewRes);
+      NewHandle->insertBefore(Leader);
+      Leader->setOperand(DxilInst_CBufferLoadLegacy::arg_handle, NewHandle);
+    }
+  }
+
+  for (CallInst *Load : Loads) {
+    if (Load == Leader)
+      continue;
+    Load->replaceAllUsesWith(Leader);
+    Load->eraseFromParent();
+  }
+
+  // Extract each component once, next to the load.
+  std::map<unsigned, ExtractValueInst *> Components;
+  for (auto UI = Leader->user_begin(); UI != Leader->user_end();) {
+    ExtractValueInst *EV = dyn_cast<ExtractValueInst>(*(UI++));
+    if (!EV || EV->getNumIndices() != 1)
+      continue;
+    ExtractValueInst *&Component = Components[*EV->idx_begin()];
+    if (!Component) {
+      Component = EV;
+      EV->moveBefore(Leader->getNextNode());
+      continue;
+    }
+    EV->replaceAllUsesWith(Component);
+    EV->eraseFromParent();
+  }
+  return true;
+}
+
+bool DxilCBufferLoadCoalesce::runOnFunction(Function &F) {
+  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+
+  // Loads of the same row of the same buffer, with the same overload, in the
+  // order they are first seen.
+  typedef std::tuple<Value *, Value *, Function *> RowKey;
+  std::map<RowKey, unsigned> RowIndex;
+  std::vector<SmallVector<CallInst *, 4>> Rows;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (!OP::IsDxilOpFuncCallInst(&I, DXIL::OpCode::CBufferLoadLegacy))
+        continue;
+      CallInst *CI = cast<CallInst>(&I);
+      DxilInst_CBufferLoadLegacy Load(CI);
+      RowKey Key(GetBuffer(Load.get_handle()), Load.get_regIndex(),
+                 CI->getCalledFunction());
+      auto It = RowIndex.insert(std::make_pair(Key, (unsigned)Rows.size()));
+      if (It.second)
+        Rows.emplace_back();
+      Rows[It.first->second].push_back(CI);
+    }
+  }
+
+  bool bUpdated = false;
+  for (auto &Loads : Rows) {
+    if (Loads.size() > 1)
+      bUpdated |= CoalesceRow(Loads, DT, LI);
+  }
+  return bUpdated;
+}
+
+}
+
+FunctionPass *llvm::createDxilCBufferLoadCoalescePass() {
+  return new DxilCBufferLoadCoalesce();
+}
+
+INITIALIZE_PASS_BEGIN(DxilCBufferLoadCoalesce, "dxil-cbuffer-load-coalesce",
+                      "DXIL coalesce constant buffer loads", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilCBufferLoadCoalesce, "dxil-cbuffer-load-coalesce",
+                    "DXIL coalesce constant buffer loads", false, false)
@@ -286,10 +286,14 @@ public:
     // Remove unused resources.
     DM.RemoveUnusedResources();
 
+    // Collect the createHandle calls once for the rewrite and the patching.
+    std::vector<CallInst *> createHandles;
+    CollectCreateHandles(DM, createHandles);
+
     // Make sure all resource types are dense; build a map of rewrites.
     if (BuildRewriteMap(m_rewrites, DM)) {
       // Rewrite all instructions that refer to resources in the map.
-      ApplyRewriteMap(DM);
+      ApplyRewriteMap(DM, createHandles);
     }
 
     bool hasResource = DM.GetCBuffers().size() ||
@@ -298,7 +302,7 @@ public:
     if (hasResource) {
       if (!DM.GetShaderModel()->IsLib()) {
         ResourceRegisterAllocator.AllocateRegisters(DM);
-        PatchCreateHandle(DM);
+        PatchCreateHandle(DM, createHandles);
       }
     }
     return true;
@@ -310,37 +314,46 @@ public:
   }
 
 private:
-  void ApplyRewriteMap(DxilModule &DM);
+  void CollectCreateHandles(DxilModule &DM,
+                            std::vector<CallInst *> &createHandles);
+  void ApplyRewriteMap(DxilModule &DM,
+                       const std::vector<CallInst *> &createHandles);
   // Add lowbound to create handle range index.
-  void PatchCreateHandle(DxilModule &DM);
+  void PatchCreateHandle(DxilModule &DM,
+                         const std::vector<CallInst *> &createHandles);
 };
 
-void DxilCondenseResources::ApplyRewriteMap(DxilModule &DM) {
-  for (Function &F : DM.GetModule()->functions()) {
-    if (F.isDeclaration()) {
+void DxilCondenseResources::CollectCreateHandles(
+    DxilModule &DM, std::vector<CallInst *> &createHandles) {
+  // Walk the users of the createHandle declarations rather than every
+  // instruction of every function.
+  for (auto &it : DM.GetOP()->GetOpFuncList(DXIL::OpCode::CreateHandle)) {
+    Function *F = it.second;
+    if (!F)
       continue;
-    }
-
-    for (inst_iterator iter = inst_begin(F), E = inst_end(F); iter != E; ++iter) {
-      llvm::Instruction &I = *iter;
-      DxilInst_CreateHandle CH(&I);
-      if (!CH)
-        continue;
-
-      ResourceID RId;
-      RId.Class = (DXIL::ResourceClass)CH.get_resourceClass_val();
-      RId.ID = (unsigned)llvm::dyn_cast<llvm::ConstantInt>(CH.get_rangeId())
-                   ->getZExtValue();
-      RemapEntryCollection::iterator it = m_rewrites.find(RId);
-      if (it == m_rewrites.end()) {
-        continue;
-      }
+    for (User *U : F->users())
+      createHandles.push_back(cast<CallInst>(U));
+  }
+}
 
-      CallInst *CI = cast<CallInst>(&I);
-      Value *newRangeID = DM.GetOP()->GetU32Const(it->second.Index);
-      CI->setArgOperand(DXIL::OperandIndex::kCreateHandleResIDOpIdx,
-                        newRangeID);
+void DxilCondenseResources::ApplyRewriteMap(
+    DxilModule &DM, const std::vector<CallInst *> &createHandles) {
+  for (CallInst *CI : createHandles) {
+    DxilInst_CreateHandle CH(CI);
+    DXASSERT_NOMSG(CH);
+
+    ResourceID RId;
+    RId.Class = (DXIL::ResourceClass)CH.get_resourceClass_val();
+    RId.ID = (unsigned)llvm::dyn_cast<llvm::ConstantInt>(CH.get_rangeId())
+                 ->getZExtValue();
+    RemapEntryCollection::iterator it = m_rewrites.find(RId);
+    if (it == m_rewrites.end()) {
+      continue;
     }
+
+    Value *newRangeID = DM.GetOP()->GetU32Const(it->second.Index);
+    CI->setArgOperand(DXIL::OperandIndex::kCreateHandleResIDOpIdx,
+                      newRangeID);
   }
 
   ApplyRewriteMapOnResTable(m_rewrites, DM);
@@ -398,12 +411,10 @@ void PatchLowerBoundOfCreateHandle(CallInst *handle, DxilModule &DM) {
 
 }
 
-void DxilCondenseResources::PatchCreateHandle(DxilModule &DM) {
-  Function *createHandle = DM.GetOP()->GetOpFunc(DXIL::OpCode::CreateHandle,
-                                                 Type::getVoidTy(DM.GetCtx()));
-
-  for (User *U : createHandle->users()) {
-    PatchLowerBoundOfCreateHandle(cast<CallInst>(U), DM);
+void DxilCondenseResources::PatchCreateHandle(
+    DxilModule &DM, const std::vector<CallInst *> &createHandles) {
+  for (CallInst *CI : createHandles) {
+    PatchLowerBoundOfCreateHandle(CI, DM);
   }
 }
 
@@ -25,13 +25,17 @@
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include "dxc/DXIL/DxilFunctionProps.h"
 #include "dxc/DXIL/DxilPDB.h"
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/HLSL/HLMatrixType.h"
 
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 #include "llvm/ADT/SetVector.h"
+#include "llvm/Support/StringSaver.h"
 
 #include "dxc/dxcapi.h"
 
@@ -56,18 +60,52 @@ using namespace llvm;
 using namespace hlsl;
 using namespace hlsl::DXIL;
 
-class DxilContainerReflection : public IDxcContainerReflection {
+class CShaderReflectionType;
+
+// Types shared by every reflection of a batch. Once the type of a variable
+// is final, its tree of types is looked up by contents: a tree seen in an
+// earlier shader replaces it, and a new tree moves here with copies of its
+// member names, so that it no longer refers to the module it came from.
+class DxilReflectionTypeTable {
+private:
+  std::mutex m_lock;
+  std::unordered_map<std::string, CShaderReflectionType *> m_trees;
+  std::vector<std::unique_ptr<CShaderReflectionType>> m_types;
+  BumpPtrAllocator m_nameAlloc;
+  BumpPtrStringSaver m_names;
+
+public:
+  DxilReflectionTypeTable() : m_names(m_nameAlloc) {}
+  ~DxilReflectionTypeTable();
+  // Takes the tree rooted at allTypes[first], which runs to the end of
+  // allTypes, and returns the tree to use instead.
+  CShaderReflectionType *
+  Intern(std::vector<std::unique_ptr<CShaderReflectionType>> &allTypes,
+         size_t first);
+};
+
+class DxilContainerReflection : public IDxcContainerReflection,
+                                public IDxcContainerReflectionBatch {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   CComPtr<IDxcBlob> m_container;
   const DxilContainerHeader *m_pHeader = nullptr;
   uint32_t m_headerLen = 0;
   bool IsLoaded() const { return m_pHeader != nullptr; }
+  HRESULT CreatePartReflection(
+      UINT32 idx, const std::shared_ptr<DxilReflectionTypeTable> &pTypeTable,
+      REFIID iid, void **ppvObject);
+  HRESULT ReflectContainer(
+      IDxcBlob *pContainer,
+      const std::shared_ptr<DxilReflectionTypeTable> &pTypeTable, REFIID iid,
+      void **ppvObject);
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxilContainerReflection)
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcContainerReflection>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcContainerReflection,
+                                 IDxcContainerReflectionBatch>(this, iid,
+                                                               ppvObject);
   }
 
   HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pContainer) override;
@@ -76,6 +114,11 @@ public:
   HRESULT STDMETHODCALLTYPE GetPartContent(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) override;
   HRESULT STDMETHODCALLTYPE FindFirstPartKind(UINT32 kind, _Out_ UINT32 *pResult) override;
   HRESULT STDMETHODCALLTYPE GetPartReflection(UINT32 idx, REFIID iid, _COM_Outptr_ void **ppvObject) override;
+
+  // IDxcContainerReflectionBatch
+  HRESULT STDMETHODCALLTYPE GetReflections(
+      UINT32 containerCount, IDxcBlob **ppContainers, UINT32 threadCount,
+      REFIID iid, void **ppReflections, HRESULT *pResults) override;
 };
 
 class CShaderReflectionConstantBuffer;
@@ -93,6 +136,8 @@ public:
   std::vector<std::unique_ptr<CShaderReflectionConstantBuffer>>    m_CBs;
   std::vector<D3D12_SHADER_INPUT_BIND_DESC>       m_Resources;
   std::vector<std::unique_ptr<CShaderReflectionType>> m_Types;
+  // Types shared with the other reflections of a batch, if any.
+  std::shared_ptr<DxilReflectionTypeTable> m_pTypeTable;
   void CreateReflectionObjects();
   void CreateReflectionObjectForResource(DxilResourceBase *R);
 
@@ -228,29 +273,44 @@ public:
   STDMETHOD_(ID3D12FunctionReflection *, GetFunctionByIndex)(THIS_ _In_ INT FunctionIndex);
 };
 
-namespace hlsl {
-HRESULT CreateDxilShaderReflection(const DxilPartHeader *pModulePart, const DxilPartHeader *pRDATPart, REFIID iid, void **ppvObject) {
+static HRESULT CreateShaderReflection(
+    const DxilPartHeader *pModulePart, const DxilPartHeader *pRDATPart,
+    const std::shared_ptr<DxilReflectionTypeTable> &pTypeTable, REFIID iid,
+    void **ppvObject) {
   if (!ppvObject)
     return E_INVALIDARG;
   CComPtr<DxilShaderReflection> pReflection = DxilShaderReflection::Alloc(DxcGetThreadMallocNoRef());
   IFROOM(pReflection.p);
   PublicAPI api = DxilShaderReflection::IIDToAPI(iid);
   pReflection->SetPublicAPI(api);
+  pReflection->m_pTypeTable = pTypeTable;
   // pRDATPart to be used for transition.
   IFR(pReflection->Load(pModulePart, pRDATPart));
   IFR(pReflection.p->QueryInterface(iid, ppvObject));
   return S_OK;
 }
-HRESULT CreateDxilLibraryReflection(const DxilPartHeader *pModulePart, const DxilPartHeader *pRDATPart, REFIID iid, void **ppvObject) {
+static HRESULT CreateLibraryReflection(
+    const DxilPartHeader *pModulePart, const DxilPartHeader *pRDATPart,
+    const std::shared_ptr<DxilReflectionTypeTable> &pTypeTable, REFIID iid,
+    void **ppvObject) {
   if (!ppvObject)
     return E_INVALIDARG;
   CComPtr<DxilLibraryReflection> pReflection = DxilLibraryReflection::Alloc(DxcGetThreadMallocNoRef());
   IFROOM(pReflection.p);
+  pReflection->m_pTypeTable = pTypeTable;
   // pRDATPart used for resource usage per-function.
   IFR(pReflection->Load(pModulePart, pRDATPart));
   IFR(pReflection.p->QueryInterface(iid, ppvObject));
   return S_OK;
 }
+
+namespace hlsl {
+HRESULT CreateDxilShaderReflection(const DxilPartHeader *pModulePart, const DxilPartHeader *pRDATPart, REFIID iid, void **ppvObject) {
+  return CreateShaderReflection(pModulePart, pRDATPart, nullptr, iid, ppvObject);
+}
+HRESULT CreateDxilLibraryReflection(const DxilPartHeader *pModulePart, const DxilPartHeader *pRDATPart, REFIID iid, void **ppvObject) {
+  return CreateLibraryReflection(pModulePart, pRDATPart, nullptr, iid, ppvObject);
+}
 }
 
 _Use_decl_annotations_
@@ -335,6 +395,12 @@ HRESULT DxilContainerReflection::FindFirstPartKind(UINT32 kind, _Out_ UINT32 *pR
 
 _Use_decl_annotations_
 HRESULT DxilContainerReflection::GetPartReflection(UINT32 idx, REFIID iid, void **ppvObject) {
+  return CreatePartReflection(idx, nullptr, iid, ppvObject);
+}
+
+HRESULT DxilContainerReflection::CreatePartReflection(
+    UINT32 idx, const std::shared_ptr<DxilReflectionTypeTable> &pTypeTable,
+    REFIID iid, void **ppvObject) {
   if (ppvObject == nullptr) return E_POINTER;
   *ppvObject = nullptr;
   if (!IsLoaded()) return E_NOT_VALID_STATE;
@@ -376,15 +442,75 @@ HRESULT DxilContainerReflection::GetPartReflection(UINT32 idx, REFIID iid, void
 
   DXIL::ShaderKind SK = GetVersionShaderType(pProgramHeader->ProgramVersion);
   if (SK == DXIL::ShaderKind::Library) {
-    IFC(hlsl::CreateDxilLibraryReflection(pPart, pRDATPart, iid, ppvObject));
+    IFC(CreateLibraryReflection(pPart, pRDATPart, pTypeTable, iid, ppvObject));
   } else {
-    IFC(hlsl::CreateDxilShaderReflection(pPart, pRDATPart, iid, ppvObject));
+    IFC(CreateShaderReflection(pPart, pRDATPart, pTypeTable, iid, ppvObject));
   }
 
 Cleanup:
   return hr;
 }
 
+HRESULT DxilContainerReflection::ReflectContainer(
+    IDxcBlob *pContainer,
+    const std::shared_ptr<DxilReflectionTypeTable> &pTypeTable, REFIID iid,
+    void **ppvObject) {
+  CComPtr<DxilContainerReflection> pReflection =
+      DxilContainerReflection::Alloc(m_pMalloc);
+  IFROOM(pReflection.p);
+  IFR(pReflection->Load(pContainer));
+  UINT32 idx;
+  IFR(pReflection->FindFirstPartKind(DFCC_DXIL, &idx));
+  return pReflection->CreatePartReflection(idx, pTypeTable, iid, ppvObject);
+}
+
+_Use_decl_annotations_
+HRESULT DxilContainerReflection::GetReflections(
+    UINT32 containerCount, IDxcBlob **ppContainers, UINT32 threadCount,
+    REFIID iid, void **ppReflections, HRESULT *pResults) {
+  if (ppReflections == nullptr || (containerCount && ppContainers == nullptr))
+    return E_POINTER;
+  for (UINT32 i = 0; i < containerCount; ++i)
+    ppReflections[i] = nullptr;
+
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    std::shared_ptr<DxilReflectionTypeTable> pTypeTable =
+        std::make_shared<DxilReflectionTypeTable>();
+    std::vector<HRESULT> results(containerCount, S_OK);
+
+    if (threadCount == 0)
+      threadCount = DxcThreadPool::GetDefaultThreadCount();
+    if (threadCount > containerCount)
+      threadCount = containerCount;
+    if (threadCount > 0) {
+      DxcThreadPool Pool(threadCount);
+      for (UINT32 i = 0; i < containerCount; ++i) {
+        Pool.Async([&, i]() {
+          DxcThreadMalloc TM(m_pMalloc);
+          HRESULT hr = S_OK;
+          try {
+            hr = ReflectContainer(ppContainers[i], pTypeTable, iid,
+                                  &ppReflections[i]);
+          }
+          CATCH_CPP_ASSIGN_HRESULT();
+          results[i] = hr;
+        });
+      }
+    }
+
+    HRESULT hr = S_OK;
+    for (UINT32 i = 0; i < containerCount; ++i) {
+      if (pResults)
+        pResults[i] = results[i];
+      if (FAILED(results[i]) && SUCCEEDED(hr))
+        hr = results[i];
+    }
+    return hr;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 void hlsl::CreateDxcContainerReflection(IDxcContainerReflection **ppResult) {
   CComPtr<DxilContainerReflection> pReflection = DxilContainerReflection::Alloc(DxcGetThreadMallocNoRef());
   *ppResult = pReflection.Detach();
@@ -402,6 +528,7 @@ struct D3D11_INTERNALSHADER_RESOURCE_DEF;
 class CShaderReflectionType : public ID3D12ShaderReflectionType
 {
   friend class CShaderReflectionConstantBuffer;
+  friend class DxilReflectionTypeTable;
 protected:
   D3D12_SHADER_TYPE_DESC              m_Desc;
   UINT                                m_SizeInCBuffer;
@@ -443,6 +570,10 @@ public:
     return m_Identity == pOther->m_Identity;
   }
 
+  // Writes everything the interface reports about this type and its
+  // members; types with equal keys can't be told apart.
+  void WriteKey(raw_ostream &OS);
+
   UINT GetCBufferSize() { return m_SizeInCBuffer; }
 };
 
@@ -488,10 +619,12 @@ public:
   void Initialize(DxilModule &M,
                   DxilCBuffer &CB,
                   std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes,
+                  DxilReflectionTypeTable *pTypeTable,
                   bool bUsageInMetadata);
   void InitializeStructuredBuffer(DxilModule &M,
                                   DxilResource &R,
-                                  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+                                  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes,
+                                  DxilReflectionTypeTable *pTypeTable);
   LPCSTR GetName() { return m_Desc.Name; }
 
   // ID3D12ShaderReflectionConstantBuffer
@@ -501,6 +634,38 @@ public:
   STDMETHOD_(ID3D12ShaderReflectionVariable*, GetVariableByName)(LPCSTR Name);
 };
 
+DxilReflectionTypeTable::~DxilReflectionTypeTable() {}
+
+CShaderReflectionType *DxilReflectionTypeTable::Intern(
+    std::vector<std::unique_ptr<CShaderReflectionType>> &allTypes,
+    size_t first) {
+  CShaderReflectionType *pRoot = allTypes[first].get();
+  std::string key;
+  raw_string_ostream OS(key);
+  pRoot->WriteKey(OS);
+  OS.flush();
+
+  CShaderReflectionType *pInterned;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_trees.find(key);
+    if (it != m_trees.end()) {
+      pInterned = it->second;
+    } else {
+      for (size_t i = first; i < allTypes.size(); ++i) {
+        for (StringRef &name : allTypes[i]->m_MemberNames)
+          name = m_names.save(name);
+        m_types.push_back(std::move(allTypes[i]));
+      }
+      m_trees.emplace(std::move(key), pRoot);
+      pInterned = pRoot;
+    }
+  }
+  // Deletes the tree if an identical one was already here.
+  allTypes.resize(first);
+  return pInterned;
+}
+
 // Invalid type sentinel definitions
 class CInvalidSRType;
 class CInvalidSRVariable;
@@ -796,6 +961,18 @@ static bool IsObjectType(
   return TryToDetectObjectType(structType, &ignored);
 }
 
+void CShaderReflectionType::WriteKey(raw_ostream &OS) {
+  OS << (unsigned)m_Desc.Class << ',' << (unsigned)m_Desc.Type << ','
+     << m_Desc.Rows << ',' << m_Desc.Columns << ',' << m_Desc.Elements << ','
+     << m_Desc.Offset << ',' << m_SizeInCBuffer << ',' << m_Name << '{';
+  for (size_t i = 0; i < m_MemberTypes.size(); ++i) {
+    OS << m_MemberNames[i] << ':';
+    m_MemberTypes[i]->WriteKey(OS);
+    OS << ';';
+  }
+  OS << '}';
+}
+
 HRESULT CShaderReflectionType::InitializeEmpty()
 {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
@@ -1175,6 +1352,7 @@ void CShaderReflectionConstantBuffer::Initialize(
   DxilModule &M,
   DxilCBuffer &CB,
   std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes,
+  DxilReflectionTypeTable *pTypeTable,
   bool bUsageInMetadata) {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
   m_Desc.Name = CB.GetGlobalName().c_str();
@@ -1213,6 +1391,7 @@ void CShaderReflectionConstantBuffer::Initialize(
     VarDesc.uFlags = (bAllUsed || fieldAnnotation.IsCBVarUsed()) ? D3D_SVF_USED : 0;
     CShaderReflectionVariable Var;
     //Create reflection type.
+    size_t firstType = allTypes.size();
     CShaderReflectionType *pVarType = new CShaderReflectionType();
     allTypes.push_back(std::unique_ptr<CShaderReflectionType>(pVarType));
     pVarType->Initialize(M, ST->getContainedType(i), fieldAnnotation, fieldAnnotation.GetCBufferOffset(), allTypes, true);
@@ -1222,6 +1401,8 @@ void CShaderReflectionConstantBuffer::Initialize(
       DXASSERT(pVarType->m_Desc.Elements == 0, "otherwise, assumption is wrong");
       pVarType->m_Desc.Elements = 1;
     }
+    if (pTypeTable)
+      pVarType = pTypeTable->Intern(allTypes, firstType);
 
     BYTE *pDefaultValue = nullptr;
 
@@ -1274,7 +1455,8 @@ static unsigned CalcResTypeSize(DxilModule &M, DxilResource &R) {
 void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   DxilModule &M,
   DxilResource &R,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes) {
+  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes,
+  DxilReflectionTypeTable *pTypeTable) {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
   m_ReflectionName = R.GetGlobalName();
   m_Desc.Type = D3D11_CT_RESOURCE_BIND_INFO;
@@ -1314,6 +1496,7 @@ void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   if(annotation)
   {
     // Actually create the reflection type.
+    size_t firstType = allTypes.size();
     pVarType = new CShaderReflectionType();
     allTypes.push_back(std::unique_ptr<CShaderReflectionType>(pVarType));
 
@@ -1322,6 +1505,8 @@ void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
     DxilFieldAnnotation &fieldAnnotation = annotation->GetFieldAnnotation(0);
 
     pVarType->Initialize(M, fieldType, fieldAnnotation, 0, allTypes, false);
+    if (pTypeTable)
+      pVarType = pTypeTable->Intern(allTypes, firstType);
   }
 
   BYTE *pDefaultValue = nullptr;
@@ -1710,7 +1895,8 @@ void DxilModuleReflection::CreateReflectionObjects() {
   // Create constant buffers, resources and signatures.
   for (auto && cb : m_pDxilModule->GetCBuffers()) {
     std::unique_ptr<CShaderReflectionConstantBuffer> rcb(new CShaderReflectionConstantBuffer());
-    rcb->Initialize(*m_pDxilModule, *(cb.get()), m_Types, m_bUsageInMetadata);
+    rcb->Initialize(*m_pDxilModule, *(cb.get()), m_Types, m_pTypeTable.get(),
+                    m_bUsageInMetadata);
     m_CBs.emplace_back(std::move(rcb));
   }
 
@@ -1720,7 +1906,8 @@ void DxilModuleReflection::CreateReflectionObjects() {
       continue;
     }
     std::unique_ptr<CShaderReflectionConstantBuffer> rcb(new CShaderReflectionConstantBuffer());
-    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(uav.get()), m_Types);
+    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(uav.get()), m_Types,
+                                    m_pTypeTable.get());
     m_CBs.emplace_back(std::move(rcb));
   }
   for (auto && srv : m_pDxilModule->GetSRVs()) {
@@ -1728,7 +1915,8 @@ void DxilModuleReflection::CreateReflectionObjects() {
       continue;
     }
     std::unique_ptr<CShaderReflectionConstantBuffer> rcb(new CShaderReflectionConstantBuffer());
-    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(srv.get()), m_Types);
+    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(srv.get()), m_Types,
+                                    m_pTypeTable.get());
     m_CBs.emplace_back(std::move(rcb));
   }
 
@@ -1943,22 +2131,25 @@ HRESULT DxilModuleReflection::LoadModule(const DxilPartHeader *pShaderPart) {
     auto errorHandler = [&bBitcodeLoadError](const DiagnosticInfo &diagInfo) {
         bBitcodeLoadError |= diagInfo.getSeverity() == DS_Error;
       };
-#if 0 // We materialize eagerly, because we'll need to walk instructions to look for usage information.
+    // Function bodies are only read when usage information has to be
+    // recovered from instructions; from validator 1.5 on, it is in metadata.
     ErrorOr<std::unique_ptr<Module>> mod =
         getLazyBitcodeModule(std::move(pMemBuffer), Context, errorHandler);
-#else
-    ErrorOr<std::unique_ptr<Module>> mod =
-      parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, errorHandler);
-#endif
     if (!mod || bBitcodeLoadError) {
       return E_INVALIDARG;
     }
     std::swap(m_pModule, mod.get());
-    m_pDxilModule = &m_pModule->GetOrCreateDxilModule();
+    // Type annotations are only needed for constant buffer layouts.
+    m_pDxilModule = &m_pModule->GetOrCreateDxilModule(
+        /*skipInit*/ false, /*lazyTypeSystem*/ true);
 
     unsigned ValMajor, ValMinor;
     m_pDxilModule->GetValidatorVersion(ValMajor, ValMinor);
     m_bUsageInMetadata = hlsl::DXIL::CompareVersions(ValMajor, ValMinor, 1, 5) >= 0;
+    if (!m_bUsageInMetadata) {
+      if (m_pModule->materializeAll() || bBitcodeLoadError)
+        return E_INVALIDARG;
+    }
 
     CreateReflectionObjects();
     return S_OK;
@@ -2579,6 +2770,7 @@ void hlsl::CreateDxcContainerReflection(IDxcContainerReflection **ppResult) {
 }
 
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerReflection)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerReflectionBatch)
 
 #endif // LLVM_ON_WIN32
 
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilContractMad.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Contracts multiplies and the adds that use them into mad.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Replaces a + b * c, and a - b * c and b * c - a, with FMad when neither the
+// multiply nor the add is precise. Drivers may contract these themselves,
+// but only within what they see as one expression; sums of products, as in
+// hand-written dot products, come out as one mad chain here:
+//
+//   x0 * y0 + x1 * y1 + x2 * y2  ->  mad(x2, y2, mad(x0, y0, x1 * y1))
+//
+// A multiply with other uses is left alone, so no multiply is computed
+// twice. Unless created to contract across blocks, the pass only takes a
+// multiply from the block of the add.
+class DxilContractMad : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilContractMad(bool bAcrossBlocks = true)
+      : FunctionPass(ID), m_bAcrossBlocks(bAcrossBlocks) {}
+
+  const char *getPassName() const override {
+    return "DXIL contract multiplies and adds into mad";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  BinaryOperator *GetContractableMul(Value *V, BinaryOperator *Add,
+                                     DxilModule &DM) const;
+  bool Contract(BinaryOperator *Add, DxilModule &DM);
+
+  bool m_bAcrossBlocks;
+};
+
+char DxilContractMad::ID = 0;
+
+BinaryOperator *DxilContractMad::GetContractableMul(Value *V,
+                                                    BinaryOperator *Add,
+                                                    DxilModule &DM) const {
+  BinaryOperator *Mul = dyn_cast<BinaryOperator>(V);
+  if (!Mul || Mul->getOpcode() != Instruction::FMul || !Mul->hasOneUse())
+    return nullptr;
+  if (!m_bAcrossBlocks && Mul->getParent() != Add->getParent())
+    return nullptr;
+  if (DM.IsPrecise(Mul))
+    return nullptr;
+  return Mul;
+}
+
+bool DxilContractMad::Contract(BinaryOperator *Add, DxilModule &DM) {
+  // FMad has half, float and double overloads; vectors are scalarized by
+  // now.
+  Type *Ty = Add->getType();
+  if (!Ty->isHalfTy() && !Ty->isFloatTy() && !Ty->isDoubleTy())
+    return false;
+  if (DM.IsPrecise(Add))
+    return false;
+
+  bool bSub = Add->getOpcode() == Instruction::FSub;
+  Value *Addend = nullptr;
+  bool bNegateMul = false;
+  BinaryOperator *Mul = GetContractableMul(Add->getOperand(0), Add, DM);
+  if (Mul) {
+    Addend = Add->getOperand(1);
+  } else {
+    Mul = GetContractableMul(Add->getOperand(1), Add, DM);
+    if (!Mul)
+      return false;
+    Addend = Add->getOperand(0);
+    bNegateMul = bSub;
+  }
+
+  IRBuilder<> Builder(Add);
+  Builder.SetFastMathFlags(Add->getFastMathFlags());
+  Value *X = Mul->getOperand(0);
+  if (bNegateMul)
+    X = Builder.CreateFNeg(X);
+  else if (bSub)
+    Addend = Builder.CreateFNeg(Addend);
+
+  OP *HlslOP = DM.GetOP();
+  Function *MadFunc = HlslOP->GetOpFunc(DXIL::OpCode::FMad, Ty);
+  Value *Mad = Builder.CreateCall(
+      MadFunc, {HlslOP->GetU32Const((unsigned)DXIL::OpCode::FMad), X,
+                Mul->getOperand(1), Addend});
+  Mad->takeName(Add);
+  Add->replaceAllUsesWith(Mad);
+  Add->eraseFromParent();
+  Mul->eraseFromParent();
+  return true;
+}
+
+bool DxilContractMad::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+
+  // The adds of a chain come in order, so each mad is the addend of the
+  // next one before that is contracted.
+  std::vector<BinaryOperator *> Adds;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (I.getOpcode() == Instruction::FAdd ||
+          I.getOpcode() == Instruction::FSub)
+        Adds.push_back(cast<BinaryOperator>(&I));
+    }
+  }
+  bool bChanged = false;
+  for (BinaryOperator *Add : Adds)
+    bChanged |= Contract(Add, DM);
+  return bChanged;
+}
+
+}
+
+FunctionPass *llvm::createDxilContractMadPass(bool bAcrossBlocks) {
+  return new DxilContractMad(bAcrossBlocks);
+}
+
+INITIALIZE_PASS(DxilContractMad, "dxil-contract-mad",
+                "DXIL contract multiplies and adds into mad", false, false)
@@ -21,6 +21,9 @@
 #include "llvm/Pass.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/Analysis/ValueTracking.h"
+
+#include <algorithm>
 
 using namespace llvm;
 using namespace hlsl;
@@ -59,13 +62,25 @@ public:
   }
 
 private:
+  // The stores to one column of a signature element.
+  struct ColumnStores {
+    std::vector<CallInst *> Stores;
+    bool bDynamic = false;
+  };
+
   bool EliminateDynamicOutput(hlsl::OP *hlslOP, DXIL::OpCode opcode, DxilSignature &outputSig, Function *Entry);
-  void ReplaceDynamicOutput(ArrayRef<Value *> tmpSigElts, Value * sigID, Value *zero, Function *F);
-  void StoreTmpSigToOutput(ArrayRef<Value *> tmpSigElts, unsigned row,
-                           Value *opcode, Value *sigID, Function *StoreOutput,
-                           Function *Entry);
+  void StoreRowsBySwitch(CallInst *CI, unsigned lo, unsigned hi);
+  void ReplaceDynamicOutput(Value *tmpCol, unsigned lo, unsigned hi,
+                            ArrayRef<CallInst *> stores, Value *zero);
+  void StoreTmpColToOutput(Value *tmpCol, unsigned lo, unsigned hi,
+                           unsigned col, Value *opcode, Value *sigID,
+                           Function *StoreOutput, Function *Entry);
 };
 
+// Dynamic indexes known to fall in this few rows are stored through a
+// switch of constant-indexed stores instead of a temp array.
+static const unsigned kMaxSwitchRows = 4;
+
 // Wrapper for StoreOutput and StorePachConstant which has same signature.
 // void (opcode, sigId, rowIndex, colIndex, value);
 class DxilOutputStore {
@@ -96,13 +111,29 @@ public:
   }
 };
 
+// Narrows [lo, hi] to the rows the known bits of row allow.
+void GetRowRange(Value *row, const DataLayout &DL, unsigned &lo,
+                 unsigned &hi) {
+  unsigned BitWidth = row->getType()->getIntegerBitWidth();
+  APInt KnownZero(BitWidth, 0), KnownOne(BitWidth, 0);
+  computeKnownBits(row, KnownZero, KnownOne, DL);
+  uint64_t Min = KnownOne.getLimitedValue();
+  uint64_t Max = (~KnownZero).getLimitedValue();
+  if (Min > lo)
+    lo = (unsigned)std::min<uint64_t>(Min, hi);
+  if (Max < hi)
+    hi = (unsigned)std::max<uint64_t>(Max, lo);
+}
+
 bool DxilEliminateOutputDynamicIndexing::EliminateDynamicOutput(
     hlsl::OP *hlslOP, DXIL::OpCode opcode, DxilSignature &outputSig,
     Function *Entry) {
   auto &storeOutputs =
       hlslOP->GetOpFuncList(opcode);
 
-  MapVector<Value *, Type *> dynamicSigSet;
+  // Stores by column of each dynamically indexed sigID.
+  MapVector<Value *, std::vector<ColumnStores>> dynamicSigSet;
+  std::vector<CallInst *> allStores;
   for (auto it : storeOutputs) {
     Function *F = it.second;
     // Skip overload not used.
@@ -114,83 +145,152 @@ bool DxilEliminateOutputDynamicIndexing::EliminateDynamicOutput(
       // Save dynamic indeed sigID.
       if (!isa<ConstantInt>(store.get_rowIndex())) {
         Value *sigID = store.get_outputSigId();
-        dynamicSigSet[sigID] = store.get_value()->getType();
+        dynamicSigSet[sigID];
       }
+      allStores.push_back(CI);
     }
   }
 
   if (dynamicSigSet.empty())
     return false;
 
+  for (CallInst *CI : allStores) {
+    DxilOutputStore store(CI);
+    auto it = dynamicSigSet.find(store.get_outputSigId());
+    if (it == dynamicSigSet.end())
+      continue;
+    std::vector<ColumnStores> &columns = it->second;
+    unsigned col = store.get_colIndex();
+    if (columns.size() <= col)
+      columns.resize(col + 1);
+    columns[col].Stores.push_back(CI);
+    columns[col].bDynamic |= !isa<ConstantInt>(store.get_rowIndex());
+  }
+
   IRBuilder<> AllocaBuilder(dxilutil::FindAllocaInsertionPt(Entry));
 
   Value *opcodeV = AllocaBuilder.getInt32(static_cast<unsigned>(opcode));
   Value *zero = AllocaBuilder.getInt32(0);
+  const DataLayout &DL = Entry->getParent()->getDataLayout();
 
-  for (auto sig : dynamicSigSet) {
+  for (auto &sig : dynamicSigSet) {
     Value *sigID = sig.first;
-    Type *EltTy = sig.second;
     unsigned ID = cast<ConstantInt>(sigID)->getLimitedValue();
     DxilSignatureElement &sigElt = outputSig.GetElement(ID);
-    unsigned row = sigElt.GetRows();
-    unsigned col = sigElt.GetCols();
-    Type *AT = ArrayType::get(EltTy, row);
-
-    std::vector<Value *> tmpSigElts(col);
-    for (unsigned c = 0; c < col; c++) {
-      Value *newCol = AllocaBuilder.CreateAlloca(AT);
-      tmpSigElts[c] = newCol;
-    }
+    unsigned rows = sigElt.GetRows();
+
+    for (unsigned c = 0; c < sig.second.size(); c++) {
+      ColumnStores &column = sig.second[c];
+      // Columns only written at constant rows keep their stores.
+      if (!column.bDynamic)
+        continue;
 
-    Function *F = hlslOP->GetOpFunc(opcode, EltTy);
-    // Change store output to store tmpSigElts.
-    ReplaceDynamicOutput(tmpSigElts, sigID, zero, F);
-    // Store tmpSigElts to Output before return.
-    StoreTmpSigToOutput(tmpSigElts, row, opcodeV, sigID, F, Entry);
+      // Only the rows a dynamic index may reach are shadowed.
+      unsigned lo = rows - 1, hi = 0;
+      for (CallInst *CI : column.Stores) {
+        Value *r = DxilOutputStore(CI).get_rowIndex();
+        if (isa<ConstantInt>(r))
+          continue;
+        unsigned rLo = 0, rHi = rows - 1;
+        GetRowRange(r, DL, rLo, rHi);
+        lo = std::min(lo, rLo);
+        hi = std::max(hi, rHi);
+      }
+
+      // A switch only pays off when the index is known to miss some rows.
+      if (hi - lo < kMaxSwitchRows && hi - lo + 1 < rows) {
+        for (CallInst *CI : column.Stores) {
+          if (!isa<ConstantInt>(DxilOutputStore(CI).get_rowIndex()))
+            StoreRowsBySwitch(CI, lo, hi);
+        }
+        continue;
+      }
+
+      Type *EltTy = DxilOutputStore(column.Stores[0]).get_value()->getType();
+      Value *tmpCol =
+          AllocaBuilder.CreateAlloca(ArrayType::get(EltTy, hi - lo + 1));
+      Function *F = hlslOP->GetOpFunc(opcode, EltTy);
+      // Change store output to store tmpCol.
+      ReplaceDynamicOutput(tmpCol, lo, hi, column.Stores, zero);
+      // Store tmpCol to Output before return.
+      StoreTmpColToOutput(tmpCol, lo, hi, c, opcodeV, sigID, F, Entry);
+    }
   }
   return true;
 }
 
+// Replaces a store to a dynamic row in [lo, hi] with a store to each
+// constant row, chosen by a switch. Rows out of range are not stored.
+void DxilEliminateOutputDynamicIndexing::StoreRowsBySwitch(CallInst *CI,
+                                                           unsigned lo,
+                                                           unsigned hi) {
+  const unsigned rowIdx = DXIL::OperandIndex::kStoreOutputRowOpIdx;
+  Value *r = CI->getOperand(rowIdx);
+  if (lo == hi) {
+    CI->setOperand(rowIdx, ConstantInt::get(r->getType(), lo));
+    return;
+  }
+
+  BasicBlock *BB = CI->getParent();
+  BasicBlock *EndBB = BB->splitBasicBlock(CI, BB->getName() + ".output.end");
+  BB->getTerminator()->eraseFromParent();
+  SwitchInst *Switch =
+      SwitchInst::Create(r, EndBB, hi - lo + 1, BB);
+  for (unsigned row = lo; row <= hi; row++) {
+    BasicBlock *CaseBB = BasicBlock::Create(
+        CI->getContext(), BB->getName() + ".output.row", BB->getParent(),
+        EndBB);
+    Instruction *NewCI = CI->clone();
+    NewCI->setOperand(rowIdx, ConstantInt::get(r->getType(), row));
+    CaseBB->getInstList().push_back(NewCI);
+    BranchInst::Create(EndBB, CaseBB);
+    Switch->addCase(cast<ConstantInt>(ConstantInt::get(r->getType(), row)),
+                    CaseBB);
+  }
+  CI->eraseFromParent();
+}
+
 void DxilEliminateOutputDynamicIndexing::ReplaceDynamicOutput(
-    ArrayRef<Value *> tmpSigElts, Value *sigID, Value *zero, Function *F) {
-  for (auto it = F->user_begin(); it != F->user_end();) {
-    CallInst *CI = cast<CallInst>(*(it++));
+    Value *tmpCol, unsigned lo, unsigned hi, ArrayRef<CallInst *> stores,
+    Value *zero) {
+  for (CallInst *CI : stores) {
     DxilOutputStore store(CI);
-    if (sigID == store.get_outputSigId()) {
-      uint64_t col = store.get_colIndex();
-      Value *tmpSigElt = tmpSigElts[col];
-      IRBuilder<> Builder(CI);
-      Value *r = store.get_rowIndex();
-      // Store to tmpSigElt.
-      Value *GEP = Builder.CreateInBoundsGEP(tmpSigElt, {zero, r});
-      Builder.CreateStore(store.get_value(), GEP);
-      // Remove store output.
-      CI->eraseFromParent();
+    Value *r = store.get_rowIndex();
+    if (ConstantInt *constRow = dyn_cast<ConstantInt>(r)) {
+      // Rows no dynamic index reaches are stored directly.
+      uint64_t row = constRow->getLimitedValue();
+      if (row < lo || row > hi)
+        continue;
     }
+    IRBuilder<> Builder(CI);
+    if (lo != 0)
+      r = Builder.CreateSub(r, Builder.getInt32(lo));
+    // Store to tmpCol.
+    Value *GEP = Builder.CreateInBoundsGEP(tmpCol, {zero, r});
+    Builder.CreateStore(store.get_value(), GEP);
+    // Remove store output.
+    CI->eraseFromParent();
   }
 }
 
-void DxilEliminateOutputDynamicIndexing::StoreTmpSigToOutput(
-    ArrayRef<Value *> tmpSigElts, unsigned row, Value *opcode, Value *sigID,
-    Function *StoreOutput, Function *Entry) {
+void DxilEliminateOutputDynamicIndexing::StoreTmpColToOutput(
+    Value *tmpCol, unsigned lo, unsigned hi, unsigned col, Value *opcode,
+    Value *sigID, Function *StoreOutput, Function *Entry) {
   Value *args[] = {opcode, sigID, /*row*/ nullptr, /*col*/ nullptr,
                    /*val*/ nullptr};
-  // Store the tmpSigElts to Output before every return.
+  // Store the tmpCol to Output before every return.
   for (auto &BB : Entry->getBasicBlockList()) {
     if (ReturnInst *RI = dyn_cast<ReturnInst>(BB.getTerminator())) {
       IRBuilder<> Builder(RI);
       Value *zero = Builder.getInt32(0);
-      for (unsigned c = 0; c<tmpSigElts.size(); c++) {
-        Value *col = tmpSigElts[c];
-        args[DXIL::OperandIndex::kStoreOutputColOpIdx] = Builder.getInt8(c);
-        for (unsigned r = 0; r < row; r++) {
-          Value *GEP =
-              Builder.CreateInBoundsGEP(col, {zero, Builder.getInt32(r)});
-          Value *V = Builder.CreateLoad(GEP);
-          args[DXIL::OperandIndex::kStoreOutputRowOpIdx] = Builder.getInt32(r);
-          args[DXIL::OperandIndex::kStoreOutputValOpIdx] = V;
-          Builder.CreateCall(StoreOutput, args);
-        }
+      args[DXIL::OperandIndex::kStoreOutputColOpIdx] = Builder.getInt8(col);
+      for (unsigned r = lo; r <= hi; r++) {
+        Value *GEP =
+            Builder.CreateInBoundsGEP(tmpCol, {zero, Builder.getInt32(r - lo)});
+        Value *V = Builder.CreateLoad(GEP);
+        args[DXIL::OperandIndex::kStoreOutputRowOpIdx] = Builder.getInt32(r);
+        args[DXIL::OperandIndex::kStoreOutputValOpIdx] = V;
+        Builder.CreateCall(StoreOutput, args);
       }
     }
   }
@@ -38,6 +38,17 @@
 // The approximation functions mostly come from [ADC]. The approximations
 // are also referenced in [HMF], but they give original credit to [ADC].
 // 
+// Reduced precision
+// ---------------------------------------------------------------------------
+// When created for reduced precision, the pass only expands acos, asin and
+// atan, which hardware usually builds from several instructions, and uses
+// shorter polynomials for them. The maximum absolute errors are
+//
+//     acos, asin     9.0e-3 radians
+//     atan, atan2    3.8e-3 radians
+//
+// Calls marked precise are left to the driver.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dxc/HLSL/DxilGenerationPass.h"
@@ -65,7 +76,8 @@ private:
 
 public:
   static char ID; // Pass identification, replacement for typeid
-  explicit DxilExpandTrigIntrinsics() : FunctionPass(ID) {}
+  explicit DxilExpandTrigIntrinsics(bool bReducedPrecision = false)
+      : FunctionPass(ID), m_bReducedPrecision(bReducedPrecision) {}
 
   const char *getPassName() const override {
     return "DXIL expand trig intrinsics";
@@ -90,6 +102,11 @@ private:
   Value *expandHSin(IRBuilder<> &builder, DxilInst_Hsin hsin, DxilModule &DM);
   Value *expandHTan(IRBuilder<> &builder, DxilInst_Htan htan, DxilModule &DM);
   Value *expandTan(IRBuilder<> &builder, DxilInst_Tan tan, DxilModule &DM);
+  Value *expandACosReduced(IRBuilder<> &builder, DxilInst_Acos acos, DxilModule &DM);
+  Value *expandASinReduced(IRBuilder<> &builder, DxilInst_Asin asin, DxilModule &DM);
+  Value *expandATanReduced(IRBuilder<> &builder, DxilInst_Atan atan, DxilModule &DM);
+
+  bool m_bReducedPrecision;
 };
 
 // Math constants.
@@ -98,6 +115,7 @@ private:
 namespace math {
   constexpr double PI    = 3.14159265358979323846;
   constexpr double PI_2  = 1.57079632679489661923;
+  constexpr double PI_4  = 0.78539816339744830962;
   constexpr double LOG2E = 1.44269504088896340736;
 }
 
@@ -112,6 +130,19 @@ bool DxilExpandTrigIntrinsics::runOnFunction(Function &F) {
 }
 
 CallInst *DxilExpandTrigIntrinsics::isExpandableTrigIntrinsicCall(Instruction *I) {
+    if (m_bReducedPrecision) {
+      if (!OP::IsDxilOpFuncCallInst(I) ||
+          I->getModule()->GetOrCreateDxilModule().IsPrecise(I))
+        return nullptr;
+      switch (OP::GetDxilOpFuncCallInst(I)) {
+      case OP::OpCode::Acos:
+      case OP::OpCode::Asin:
+      case OP::OpCode::Atan:
+        return cast<CallInst>(I);
+      default: break;
+      }
+      return nullptr;
+    }
     if (OP::IsDxilOpFuncCallInst(I)) {
       switch (OP::GetDxilOpFuncCallInst(I)) {
       case OP::OpCode::Acos:
@@ -163,7 +194,16 @@ bool DxilExpandTrigIntrinsics::expandTrigIntrinsics(DxilModule &DM, const Intrin
     prepareBuilderToExpandIntrinsic(builder, intrinsic);
     
     OP::OpCode opcode = OP::GetDxilOpFuncCallInst(intrinsic);
-    switch (opcode) {
+    if (m_bReducedPrecision) {
+      switch (opcode) {
+      case OP::OpCode::Acos: expansion = expandACosReduced(builder, intrinsic, DM); break;
+      case OP::OpCode::Asin: expansion = expandASinReduced(builder, intrinsic, DM); break;
+      case OP::OpCode::Atan: expansion = expandATanReduced(builder, intrinsic, DM); break;
+      default:
+        assert(false && "unexpected intrinsic");
+        break;
+      }
+    } else switch (opcode) {
     case OP::OpCode::Acos: expansion = expandACos(builder, intrinsic, DM); break;
     case OP::OpCode::Asin: expansion = expandASin(builder, intrinsic, DM); break;
     case OP::OpCode::Atan: expansion = expandATan(builder, intrinsic, DM); break;
@@ -532,10 +572,100 @@ Value *DxilExpandTrigIntrinsics::expandTan(IRBuilder<> &builder,
   return r;
 }
 
+// Reduced precision acos and asin
+// ----------------------------------------------------------------------------
+// The same identities as acos and asin above, with a first order psi*(x)
+//
+//    psi*(x) = pi/2 + a1x
+//      a1 = -0.156583
+//
+// which keeps the error within 9.0e-3.
+//
+static Value *emitSqrt1mXtimesPsiXReduced(IRBuilder<> &builder, Value *X, OP *dxOp, StringRef name) {
+  Value *One = ConstantFP::get(X->getType(), 1.0);
+  Value *a0 = ConstantFP::get(X->getType(), math::PI_2);
+  Value *a1 = ConstantFP::get(X->getType(), -0.156583);
+
+  Value *r1 = builder.CreateFSub(One, X, name);
+  Value *r2 = emitSqrt(builder, r1, dxOp, name);
+  Value *r3 = builder.CreateFMul(X, a1, name);
+         r3 = builder.CreateFAdd(r3, a0, name);
+  return builder.CreateFMul(r2, r3, name);
+}
+
+Value *DxilExpandTrigIntrinsics::expandASinReduced(IRBuilder<> &builder, DxilInst_Asin asin, DxilModule &DM) {
+  assert(asin);
+  StringRef name = "asin.x";
+  Value *X = asin.get_value();
+  Value *PI_2 = ConstantFP::get(X->getType(), math::PI_2);
+  Value *Zero = ConstantFP::get(X->getType(), 0.0);
+
+  Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
+  Value *psiX = emitSqrt1mXtimesPsiXReduced(builder, absX, DM.GetOP(), name);
+  Value *asinX = builder.CreateFSub(PI_2, psiX, name);
+  Value *asinmX = builder.CreateFSub(Zero, asinX, name);
+
+  Value *lt0 = builder.CreateFCmp(CmpInst::FCMP_ULT, X, Zero, name);
+  return builder.CreateSelect(lt0, asinmX, asinX, name);
+}
+
+Value *DxilExpandTrigIntrinsics::expandACosReduced(IRBuilder<> &builder, DxilInst_Acos acos, DxilModule &DM) {
+  assert(acos);
+  StringRef name = "acos.x";
+  Value *X = acos.get_value();
+  Value *PI = ConstantFP::get(X->getType(), math::PI);
+  Value *Zero = ConstantFP::get(X->getType(), 0.0);
+
+  Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
+  Value *acosX = emitSqrt1mXtimesPsiXReduced(builder, absX, DM.GetOP(), name);
+  Value *acosmX = builder.CreateFSub(PI, acosX, name);
+
+  Value *lt0 = builder.CreateFCmp(CmpInst::FCMP_ULT, X, Zero, name);
+  return builder.CreateSelect(lt0, acosmX, acosX, name);
+}
+
+// Reduced precision atan
+// ----------------------------------------------------------------------------
+// The same range reduction as atan above, with
+//
+//    arctan*(x) = x(pi/4 + c(1 - x))
+//      c = 0.273
+//
+// on [0, 1], which keeps the error within 3.8e-3. atan2 is lowered to atan
+// with a quadrant correction, so it has the same error.
+//
+Value *DxilExpandTrigIntrinsics::expandATanReduced(IRBuilder<> &builder, DxilInst_Atan atan, DxilModule &DM) {
+  assert(atan);
+  StringRef name = "atan.x";
+  Value *X = atan.get_value();
+  Value *PI_2 = ConstantFP::get(X->getType(), math::PI_2);
+  Value *PI_4 = ConstantFP::get(X->getType(), math::PI_4);
+  Value *One  = ConstantFP::get(X->getType(), 1.0);
+  Value *Zero = ConstantFP::get(X->getType(), 0.0);
+  Value *c    = ConstantFP::get(X->getType(), 0.273);
+
+  Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
+  Value *gt1 = builder.CreateFCmp(CmpInst::FCMP_UGT, absX, One, name);
+  Value *r1 = builder.CreateFDiv(One, absX, name);
+  Value *r2 = builder.CreateSelect(gt1, r1, absX, name);
+
+  Value *r3 = builder.CreateFSub(One, r2, name);
+         r3 = builder.CreateFMul(r3, c, name);
+         r3 = builder.CreateFAdd(r3, PI_4, name);
+         r3 = builder.CreateFMul(r2, r3, name);
+
+  Value *r4 = builder.CreateFSub(PI_2, r3, name);
+  Value *r5 = builder.CreateSelect(gt1, r4, r3, name);
+
+  Value *r6 = builder.CreateFSub(Zero, r5, name);
+  Value *lt0 = builder.CreateFCmp(CmpInst::FCMP_ULT, X, Zero, name);
+  return builder.CreateSelect(lt0, r6, r5, name);
+}
+
 char DxilExpandTrigIntrinsics::ID = 0;
 
-FunctionPass *llvm::createDxilExpandTrigIntrinsicsPass() {
-  return new DxilExpandTrigIntrinsics();
+FunctionPass *llvm::createDxilExpandTrigIntrinsicsPass(bool bReducedPrecision) {
+  return new DxilExpandTrigIntrinsics(bReducedPrecision);
 }
 
 INITIALIZE_PASS(DxilExpandTrigIntrinsics,
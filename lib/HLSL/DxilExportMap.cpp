@@ -32,6 +32,7 @@ namespace dxilutil {
 
 void ExportMap::clear() {
   m_ExportMap.clear();
+  m_bHasDecoratedNames = false;
 }
 bool ExportMap::empty() const {
   return m_ExportMap.empty();
@@ -80,6 +81,44 @@ bool ExportMap::ParseExports(const std::vector<std::string> &exportOpts, llvm::r
   return true;
 }
 
+bool ExportMap::ParseExportList(llvm::StringRef exportList, llvm::raw_ostream &errors) {
+  if (!exportList.empty() && exportList.back() != '\0') {
+    errors << "Export list must end with a null character.";
+    return false;
+  }
+  llvm::StringRef list = exportList;
+  while (!list.empty()) {
+    // internal\0[export1\0[export2\0...]]\0
+    size_t end = list.find('\0');
+    llvm::StringRef internalName = list.substr(0, end);
+    list = list.substr(end + 1);
+    if (internalName.empty()) {
+      errors << "Export list holds an empty internal name.";
+      return false;
+    }
+    if (list.empty()) {
+      errors << "Export list record for '" << internalName
+             << "' is not terminated.";
+      return false;
+    }
+    if (list.front() == '\0') {
+      AddUnescaped(internalName, internalName);
+    }
+    while (list.front() != '\0') {
+      end = list.find('\0');
+      AddUnescaped(list.substr(0, end), internalName);
+      list = list.substr(end + 1);
+      if (list.empty()) {
+        errors << "Export list record for '" << internalName
+               << "' is not terminated.";
+        return false;
+      }
+    }
+    list = list.substr(1);
+  }
+  return true;
+}
+
 void ExportMap::Add(llvm::StringRef exportName, llvm::StringRef internalName) {
   // Incoming strings may be escaped (because they originally come from arguments)
   // Unescape them here, if necessary
@@ -98,22 +137,35 @@ void ExportMap::Add(llvm::StringRef exportName, llvm::StringRef internalName) {
 
   if (internalName.empty())
     internalName = exportName;
+  AddUnescaped(exportName, internalName);
+}
+
+void ExportMap::AddUnescaped(llvm::StringRef exportName, llvm::StringRef internalName) {
   exportName = DemangleFunctionName(exportName);
   m_ExportMap[internalName].insert(exportName);
+  if (internalName.startswith(ManglingPrefix) ||
+      internalName.startswith(EntryPrefix))
+    m_bHasDecoratedNames = true;
 }
 
 ExportMap::const_iterator ExportMap::GetExportsByName(llvm::StringRef Name) const {
-  ExportMap::const_iterator it = m_ExportMap.find(Name);
-  StringRef unmangled = DemangleFunctionName(Name);
-  if (it == end()) {
-    if (Name.startswith(ManglingPrefix)) {
-      it = m_ExportMap.find(unmangled);
-    }
-    else if (Name.startswith(EntryPrefix)) {
+  // Internal names are almost always plain, so the plain name of a decorated
+  // function is looked up without first trying the decorated one.
+  if (Name.startswith(ManglingPrefix)) {
+    ExportMap::const_iterator it =
+        m_bHasDecoratedNames ? m_ExportMap.find(Name) : end();
+    if (it == end())
+      it = m_ExportMap.find(DemangleFunctionName(Name));
+    return it;
+  }
+  if (Name.startswith(EntryPrefix)) {
+    ExportMap::const_iterator it =
+        m_bHasDecoratedNames ? m_ExportMap.find(Name) : end();
+    if (it == end())
       it = m_ExportMap.find(Name.substr(strlen(EntryPrefix)));
-    }
+    return it;
   }
-  return it;
+  return m_ExportMap.find(Name);
 }
 
 bool ExportMap::IsExported(llvm::StringRef original) const {
@@ -126,9 +178,7 @@ void ExportMap::BeginProcessing() {
   m_ExportNames.clear();
   m_NameCollisions.clear();
   m_UnusedExports.clear();
-  for (auto &it : m_ExportMap) {
-    m_UnusedExports.emplace(it.getKey());
-  }
+  m_UsedExports.clear();
 }
 
 bool ExportMap::ProcessFunction(llvm::Function *F, bool collisionAvoidanceRenaming) {
@@ -159,7 +209,7 @@ bool ExportMap::ProcessFunction(llvm::Function *F, bool collisionAvoidanceRenami
   llvm::StringRef internalName = it->getKey();
 
   // mark export used
-  UseExport(internalName);
+  m_UsedExports.insert(&*it);
 
   // Add identity first
   auto itIdentity = exportRenames.find(unmangled);
@@ -197,24 +247,33 @@ void ExportMap::RegisterExportedFunction(llvm::Function *F) {
 }
 
 void ExportMap::UseExport(llvm::StringRef internalName) {
-  auto it = m_UnusedExports.find(internalName);
-  if (it != m_UnusedExports.end())
-    m_UnusedExports.erase(it);
+  auto it = m_ExportMap.find(internalName);
+  if (it != m_ExportMap.end())
+    m_UsedExports.insert(&*it);
 }
 void ExportMap::ExportName(llvm::StringRef exportName) {
   auto result = m_ExportNames.insert(exportName);
   if (!result.second) {
     // Already present, report collision
-    m_NameCollisions.insert(exportName);
+    m_NameCollisions.insert(result.first->getKey());
   }
 }
 
-bool ExportMap::EndProcessing() const {
+bool ExportMap::EndProcessing() {
+  // Unused exports are only gathered when there are some, and are sorted so
+  // they are reported in a stable order.
+  m_UnusedExports.clear();
+  if (m_UsedExports.size() != m_ExportMap.size()) {
+    for (auto &it : m_ExportMap) {
+      if (!m_UsedExports.count(&it))
+        m_UnusedExports.insert(it.getKey());
+    }
+  }
   return m_UnusedExports.empty() && m_NameCollisions.empty();
 }
 
 llvm::StringRef ExportMap::StoreString(llvm::StringRef str) {
-  return *m_StringStorage.insert(str).first;
+  return m_StringStorage.insert(str).first->getKey();
 }
 
 } // dxilutil
@@ -0,0 +1,305 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilHoistHandles.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Hoists loop-invariant resource handles and merges duplicate ones.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <map>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Handles are created where each resource is used, so a loop that uses a
+// resource creates its handle every iteration, and each block that uses it
+// creates another one. Creating a handle reads no memory the shader can
+// write, but createHandle is marked readonly, so GVN and LICM keep every one
+// behind the stores to UAVs around it. This pass moves handles with
+// loop-invariant operands to the loop preheader, then replaces each handle
+// with an identical one that dominates it.
+//
+// Bindless shaders index one large resource array from several branches,
+// where no handle dominates the others. When a uniform index is available
+// in the block that dominates all of them, the first handle moves there
+// and the others reuse it. A branch may be what keeps the index in bounds,
+// as in if (i < count) bufs[i], so a handle whose index is not a constant
+// only moves to a block from which every path reaches the group. Handles
+// with a non-uniform index are not moved out of their branch, since
+// creating one may loop over the distinct indices of the wave. With
+// bReport, each handle still created on every iteration of a loop gets a
+// note.
+class DxilHoistHandles : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilHoistHandles(bool bReport = false)
+      : FunctionPass(ID), m_bReport(bReport) {}
+
+  const char *getPassName() const override {
+    return "DXIL hoist resource handles";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool m_bReport;
+};
+
+char DxilHoistHandles::ID = 0;
+
+bool IsHandleCreation(Instruction *I) {
+  return OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::CreateHandle) ||
+         OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::CreateHandleForLib) ||
+         OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::CreateHandleFromHeap) ||
+         OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::AnnotateHandle);
+}
+
+// The resource of createHandleForLib is loaded from a global that is never
+// stored to, so the load goes with the handle and is matched by the global.
+LoadInst *GetResourceLoad(CallInst *CI) {
+  if (!OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandleForLib))
+    return nullptr;
+  LoadInst *LI =
+      dyn_cast<LoadInst>(DxilInst_CreateHandleForLib(CI).get_Resource());
+  if (!LI || !LI->hasOneUse() ||
+      !isa<GlobalVariable>(LI->getPointerOperand()))
+    return nullptr;
+  return LI;
+}
+
+Value *GetKeyOperand(CallInst *CI, unsigned i) {
+  Value *V = CI->getArgOperand(i);
+  if (i == DxilInst_CreateHandleForLib::arg_Resource) {
+    if (LoadInst *LI = GetResourceLoad(CI))
+      return LI->getPointerOperand();
+  }
+  return V;
+}
+
+bool IsNonUniform(CallInst *CI) {
+  Value *NonUniform = nullptr;
+  if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandle))
+    NonUniform = DxilInst_CreateHandle(CI).get_nonUniformIndex();
+  else if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandleFromHeap))
+    NonUniform = DxilInst_CreateHandleFromHeap(CI).get_nonUniformIndex();
+  else if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::AnnotateHandle)) {
+    CallInst *Handle =
+        dyn_cast<CallInst>(DxilInst_AnnotateHandle(CI).get_res());
+    return Handle && IsNonUniform(Handle);
+  }
+  ConstantInt *C = dyn_cast_or_null<ConstantInt>(NonUniform);
+  return NonUniform && (!C || !C->isZero());
+}
+
+bool IsInvariantIn(CallInst *CI, Loop *L) {
+  for (unsigned i = 0; i < CI->getNumArgOperands(); ++i) {
+    Instruction *I = dyn_cast<Instruction>(GetKeyOperand(CI, i));
+    if (I && L->contains(I->getParent()))
+      return false;
+  }
+  return true;
+}
+
+// Moves CI to the preheader of the outermost loop it does not depend on.
+bool HoistFromLoops(CallInst *CI, LoopInfo &LI) {
+  bool bChanged = false;
+  while (Loop *L = LI.getLoopFor(CI->getParent())) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (!Preheader || !IsInvariantIn(CI, L))
+      break;
+    Instruction *InsertPt = Preheader->getTerminator();
+    if (LoadInst *Load = GetResourceLoad(CI))
+      Load->moveBefore(InsertPt);
+    CI->moveBefore(InsertPt);
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+// Returns true if CI cannot be created with an index outside its range: the
+// index is a constant, which the front end checks, or there is no index.
+bool IsIndexInBounds(CallInst *CI) {
+  if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandle))
+    return isa<ConstantInt>(DxilInst_CreateHandle(CI).get_index());
+  if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandleFromHeap))
+    return isa<ConstantInt>(DxilInst_CreateHandleFromHeap(CI).get_index());
+  // The handle of annotateHandle was already created, and createHandleForLib
+  // takes the resource loaded by the caller.
+  return true;
+}
+
+// Returns true if every path from the end of Dom reaches a handle of Group.
+bool IsGroupReachedFrom(BasicBlock *Dom, ArrayRef<CallInst *> Group) {
+  SmallPtrSet<BasicBlock *, 8> GroupBlocks;
+  for (CallInst *CI : Group)
+    GroupBlocks.insert(CI->getParent());
+  if (GroupBlocks.count(Dom))
+    return true;
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  SmallVector<BasicBlock *, 16> Worklist(succ_begin(Dom), succ_end(Dom));
+  if (Worklist.empty())
+    return false;
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (GroupBlocks.count(BB) || !Visited.insert(BB).second)
+      continue;
+    if (succ_begin(BB) == succ_end(BB))
+      return false;
+    Worklist.append(succ_begin(BB), succ_end(BB));
+  }
+  return true;
+}
+
+// Moves CI to the end of Dom, which dominates all of Group, if its operands
+// are available there and creating it there cannot use an index the group
+// would not have.
+bool HoistToDominator(CallInst *CI, ArrayRef<CallInst *> Group,
+                      BasicBlock *Dom, DominatorTree &DT) {
+  if (CI->getParent() == Dom)
+    return false;
+  if (!IsIndexInBounds(CI) && !IsGroupReachedFrom(Dom, Group))
+    return false;
+  Instruction *InsertPt = Dom->getTerminator();
+  for (unsigned i = 0; i < CI->getNumArgOperands(); ++i) {
+    Instruction *I = dyn_cast<Instruction>(GetKeyOperand(CI, i));
+    if (I && !DT.dominates(I, InsertPt))
+      return false;
+  }
+  if (LoadInst *Load = GetResourceLoad(CI))
+    Load->moveBefore(InsertPt);
+  CI->moveBefore(InsertPt);
+  return true;
+}
+
+bool DxilHoistHandles::runOnFunction(Function &F) {
+  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+
+  // Operands reach handles before they are used in reverse post order, so
+  // an annotateHandle sees its handle already merged.
+  std::vector<CallInst *> Handles;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    for (Instruction &I : *BB) {
+      if (IsHandleCreation(&I))
+        Handles.push_back(cast<CallInst>(&I));
+    }
+  }
+
+  bool bChanged = false;
+  for (CallInst *CI : Handles)
+    bChanged |= HoistFromLoops(CI, LI);
+
+  // Handles that will be merged share a key. A handle that takes another
+  // handle is keyed by the first handle of that one's group.
+  typedef std::vector<Value *> HandleKey;
+  DenseMap<CallInst *, CallInst *> GroupFirst;
+  std::map<HandleKey, SmallVector<CallInst *, 4>> Groups;
+  auto GetKey = [&](CallInst *CI) {
+    HandleKey Key;
+    Key.push_back(CI->getCalledFunction());
+    for (unsigned i = 0; i < CI->getNumArgOperands(); ++i) {
+      Value *V = GetKeyOperand(CI, i);
+      CallInst *OpCI = dyn_cast<CallInst>(V);
+      auto It = OpCI ? GroupFirst.find(OpCI) : GroupFirst.end();
+      Key.push_back(It != GroupFirst.end() ? It->second : V);
+    }
+    return Key;
+  };
+  for (CallInst *CI : Handles) {
+    SmallVector<CallInst *, 4> &Group = Groups[GetKey(CI)];
+    Group.push_back(CI);
+    GroupFirst[CI] = Group.front();
+  }
+
+  // Moves the first handle of each group with uniform operands to the block
+  // that dominates the whole group, in the order handles were collected, so
+  // a handle taken by another one moves first.
+  for (CallInst *CI : Handles) {
+    if (GroupFirst[CI] != CI || IsNonUniform(CI))
+      continue;
+    SmallVector<CallInst *, 4> &Group = Groups[GetKey(CI)];
+    BasicBlock *Dom = CI->getParent();
+    for (CallInst *Other : Group)
+      Dom = DT.findNearestCommonDominator(Dom, Other->getParent());
+    bChanged |= HoistToDominator(CI, Group, Dom, DT);
+  }
+
+  std::map<HandleKey, SmallVector<CallInst *, 4>> Leaders;
+  for (CallInst *CI : Handles) {
+    HandleKey Key;
+    Key.push_back(CI->getCalledFunction());
+    for (unsigned i = 0; i < CI->getNumArgOperands(); ++i)
+      Key.push_back(GetKeyOperand(CI, i));
+
+    SmallVector<CallInst *, 4> &Candidates = Leaders[Key];
+    CallInst *Leader = nullptr;
+    for (CallInst *Candidate : Candidates) {
+      if (DT.dominates(Candidate, CI)) {
+        Leader = Candidate;
+        break;
+      }
+    }
+    if (!Leader) {
+      Candidates.push_back(CI);
+      Loop *L = LI.getLoopFor(CI->getParent());
+      if (m_bReport && L && !IsInvariantIn(CI, L) &&
+          !OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::AnnotateHandle)) {
+        dxilutil::EmitNoteOnInstruction(
+            CI, IsNonUniform(CI)
+                    ? "resource handle with a non-uniform index that changes "
+                      "in the loop is created on every iteration."
+                    : "resource handle with an index that changes in the "
+                      "loop is created on every iteration.");
+      }
+      continue;
+    }
+    LoadInst *Load = GetResourceLoad(CI);
+    CI->replaceAllUsesWith(Leader);
+    CI->eraseFromParent();
+    if (Load)
+      Load->eraseFromParent();
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+}
+
+FunctionPass *llvm::createDxilHoistHandlesPass(bool bReport) {
+  return new DxilHoistHandles(bReport);
+}
+
+INITIALIZE_PASS_BEGIN(DxilHoistHandles, "dxil-hoist-handles",
+                      "DXIL hoist resource handles", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilHoistHandles, "dxil-hoist-handles",
+                    "DXIL hoist resource handles", false, false)
@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilHoistUniform.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Hoists dispatch-uniform computations and marks uniform branches.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "DxilUniformValues.h"
+#include "dxc/DXIL/DxilMetadataHelper.h"
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Uniform values, as DxilUniformValues finds them, are kept in scalar
+// registers by most hardware, so computing them early costs little, while
+// computing them in a loop or under a divergent branch repeats them per
+// iteration or per lane group.
+//
+// This pass moves uniform computations out of the loops they do not depend
+// on and to the top of regions under a divergent branch, and marks branches
+// on uniform conditions with the branch hint so they are not flattened.
+class DxilHoistUniform : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilHoistUniform() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL hoist uniform values";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool IsUniform(Value *V) const { return m_Uniform.IsUniform(V); }
+  bool IsHoistable(Instruction *I) const;
+  bool HoistFromLoop(Loop *L, ArrayRef<BasicBlock *> RPO);
+  bool HoistFromDivergentRegions(ArrayRef<BasicBlock *> RPO);
+  bool MarkUniformBranches(Function &F);
+
+  DxilUniformValues m_Uniform;
+  DominatorTree *m_pDT = nullptr;
+  LoopInfo *m_pLI = nullptr;
+};
+
+char DxilHoistUniform::ID = 0;
+
+bool DxilHoistUniform::IsHoistable(Instruction *I) const {
+  if (!IsUniform(I))
+    return false;
+  // Uniform operations do not write memory and cannot fault.
+  if (isa<CallInst>(I))
+    return true;
+  return isSafeToSpeculativelyExecute(I);
+}
+
+bool DxilHoistUniform::HoistFromLoop(Loop *L, ArrayRef<BasicBlock *> RPO) {
+  bool bChanged = false;
+  for (Loop *SubLoop : *L)
+    bChanged |= HoistFromLoop(SubLoop, RPO);
+
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return bChanged;
+  Instruction *InsertPt = Preheader->getTerminator();
+  for (BasicBlock *BB : RPO) {
+    if (!L->contains(BB))
+      continue;
+    for (auto It = BB->begin(); It != BB->end();) {
+      Instruction *I = &*(It++);
+      if (!IsHoistable(I))
+        continue;
+      bool bInvariant = true;
+      for (Value *Op : I->operands()) {
+        Instruction *OpI = dyn_cast<Instruction>(Op);
+        if (OpI && L->contains(OpI->getParent())) {
+          bInvariant = false;
+          break;
+        }
+      }
+      if (bInvariant) {
+        I->moveBefore(InsertPt);
+        bChanged = true;
+      }
+    }
+  }
+  return bChanged;
+}
+
+bool DxilHoistUniform::HoistFromDivergentRegions(ArrayRef<BasicBlock *> RPO) {
+  bool bChanged = false;
+  for (BasicBlock *BB : RPO) {
+    BasicBlock *Pred = BB->getSinglePredecessor();
+    if (!Pred)
+      continue;
+    BranchInst *Br = dyn_cast<BranchInst>(Pred->getTerminator());
+    if (!Br || !Br->isConditional() || IsUniform(Br->getCondition()))
+      continue;
+    // Stay in the loop the region is in; HoistFromLoop has taken out what
+    // could leave it.
+    if (m_pLI->getLoopFor(Pred) != m_pLI->getLoopFor(BB))
+      continue;
+    for (auto It = BB->begin(); It != BB->end();) {
+      Instruction *I = &*(It++);
+      if (!IsHoistable(I))
+        continue;
+      bool bAvailable = true;
+      for (Value *Op : I->operands()) {
+        Instruction *OpI = dyn_cast<Instruction>(Op);
+        if (OpI && !m_pDT->dominates(OpI, Br)) {
+          bAvailable = false;
+          break;
+        }
+      }
+      if (bAvailable) {
+        I->moveBefore(Br);
+        bChanged = true;
+      }
+    }
+  }
+  return bChanged;
+}
+
+bool DxilHoistUniform::MarkUniformBranches(Function &F) {
+  bool bChanged = false;
+  for (BasicBlock &BB : F) {
+    BranchInst *Br = dyn_cast<BranchInst>(BB.getTerminator());
+    if (!Br || !Br->isConditional() || !IsUniform(Br->getCondition()))
+      continue;
+    // Leave hints written in the source, and loop control, alone.
+    if (Br->getMetadata(DxilMDHelper::kDxilControlFlowHintMDName))
+      continue;
+    if (Loop *L = m_pLI->getLoopFor(&BB)) {
+      if (L->isLoopExiting(&BB) || Br->getSuccessor(0) == L->getHeader() ||
+          Br->getSuccessor(1) == L->getHeader())
+        continue;
+    }
+    std::vector<DXIL::ControlFlowHint> Hints = {DXIL::ControlFlowHint::Branch};
+    Br->setMetadata(DxilMDHelper::kDxilControlFlowHintMDName,
+                    DxilMDHelper::EmitControlFlowHints(F.getContext(), Hints));
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+bool DxilHoistUniform::runOnFunction(Function &F) {
+  m_pDT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  m_pLI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  std::vector<BasicBlock *> RPO(RPOT.begin(), RPOT.end());
+  m_Uniform.Compute(RPO);
+
+  bool bChanged = false;
+  for (Loop *L : *m_pLI)
+    bChanged |= HoistFromLoop(L, RPO);
+  bChanged |= HoistFromDivergentRegions(RPO);
+  bChanged |= MarkUniformBranches(F);
+  return bChanged;
+}
+
+}
+
+FunctionPass *llvm::createDxilHoistUniformPass() {
+  return new DxilHoistUniform();
+}
+
+INITIALIZE_PASS_BEGIN(DxilHoistUniform, "dxil-hoist-uniform",
+                      "DXIL hoist uniform values", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilHoistUniform, "dxil-hoist-uniform",
+                    "DXIL hoist uniform values", false, false)
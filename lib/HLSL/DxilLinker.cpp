@@ -11,26 +11,34 @@
 #include "dxc/DXIL/DxilCBuffer.h"
 #include "dxc/DXIL/DxilFunctionProps.h"
 #include "dxc/DXIL/DxilEntryProps.h"
+#include "dxc/DXIL/DxilFunctionHash.h"
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
 #include "dxc/DXIL/DxilResource.h"
 #include "dxc/DXIL/DxilSampler.h"
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/Support/Global.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
 #include <memory>
+#include <tuple>
 #include <vector>
 
 #include "dxc/DxilContainer/DxilContainer.h"
@@ -45,6 +53,10 @@
 
 #include "dxc/HLSL/DxilExportMap.h"
 #include "dxc/HLSL/ComputeViewIdState.h"
+#include "dxc/HLSL/DxilValidation.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 using namespace llvm;
 using namespace hlsl;
@@ -63,6 +75,32 @@ void CollectUsedFunctions(Constant *C,
   }
 }
 
+bool UsesLocalGlobal(Constant *C) {
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(C))
+    return GV->hasLocalLinkage();
+  for (Value *Op : C->operands()) {
+    if (Constant *OpC = dyn_cast<Constant>(Op))
+      if (UsesLocalGlobal(OpC))
+        return true;
+  }
+  return false;
+}
+
+// StringMap iterates in an order that depends on how the map was filled
+// and emptied, which differs between a linker and the jobs LinkParallel
+// rebuilds from a snapshot. Walking the names in sorted order instead keeps
+// the functions, and with them the globals, resources and metadata, of a
+// linked module in the same order however it was linked.
+template <typename T>
+std::vector<StringRef> GetSortedKeys(const StringMap<T> &Map) {
+  std::vector<StringRef> Keys;
+  Keys.reserve(Map.size());
+  for (auto &it : Map)
+    Keys.push_back(it.getKey());
+  std::sort(Keys.begin(), Keys.end());
+  return Keys;
+}
+
 template <class T>
 void AddResourceMap(
     const std::vector<std::unique_ptr<T>> &resTab, DXIL::ResourceClass resClass,
@@ -90,10 +128,20 @@ void CloneFunction(Function *F, Function *NewF, ValueToValueMapTy &vmap,
     TypeSys->CopyFunctionAnnotation(NewF, F, *SrcTypeSys);
   }
 
-  // Remove params from vmap.
+  // Remove params, blocks and instructions from vmap. Each entry holds two
+  // value handles, and the link clones every function through one map, so
+  // keeping them would hold handles for every instruction of the linked
+  // module until the link is done. Blocks whose address is taken stay, as
+  // blockaddress constants in other functions are mapped through them.
   for (Argument &param : F->args()) {
     vmap.erase(&param);
   }
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB)
+      vmap.erase(&I);
+    if (!BB.hasAddressTaken())
+      vmap.erase(&BB);
+  }
 }
 
 } // namespace
@@ -123,12 +171,25 @@ public:
   DxilResourceBase *GetResource(const llvm::Constant *GV);
 
   DxilModule &GetDxilModule() { return m_DM; }
+  const std::string &GetName() const {
+    return m_pModule->getModuleIdentifier();
+  }
   void LazyLoadFunction(Function *F);
   void BuildGlobalUsage();
   void CollectUsedInitFunctions(SetVector<StringRef> &addedFunctionSet,
                                 SmallVector<StringRef, 4> &workList);
+  // Hash of F as it goes into a link. F must have been loaded before the
+  // last BuildGlobalUsage.
+  uint64_t GetFunctionHash(llvm::Function *F);
+  // Body hashes stored with the lib when it was compiled, keyed on function
+  // names as they were compiled.
+  void SetBodyHashes(const llvm::StringMap<uint64_t> &hashes);
+  // As above, keyed on the names the functions have in this lib.
+  void GetBodyHashes(llvm::StringMap<uint64_t> &hashes);
+  bool GetBodyHash(llvm::Function *F, uint64_t &hash);
 
 private:
+  uint64_t GetLibHash();
   std::unique_ptr<llvm::Module> m_pModule;
   DxilModule &m_DM;
   // Map from name to Link info for extern functions.
@@ -137,6 +198,11 @@ private:
   llvm::MapVector<const llvm::Constant *, DxilResourceBase *> m_resourceMap;
   // Set of initialize functions for global variable. SetVector for deterministic iteration.
   llvm::SetVector<llvm::Function *> m_initFuncSet;
+  // Function hashes; the lib never changes once registered.
+  llvm::DenseMap<llvm::Function *, uint64_t> m_functionHashMap;
+  uint64_t m_libHash = 0;
+  bool m_bLibHashed = false;
+  llvm::DenseMap<llvm::Function *, uint64_t> m_bodyHashMap;
 };
 
 struct DxilLinkJob;
@@ -148,26 +214,59 @@ public:
   bool HasLibNameRegistered(StringRef name) override;
   bool RegisterLib(StringRef name, std::unique_ptr<llvm::Module> pModule,
                    std::unique_ptr<llvm::Module> pDebugModule) override;
+  bool UnregisterLib(StringRef name) override;
+  bool SetLibFunctionHashes(StringRef name,
+                            const StringMap<uint64_t> &hashes) override;
   bool AttachLib(StringRef name) override;
   bool DetachLib(StringRef name) override;
   void DetachAll() override;
 
+  using DxilLinker::Link;
   std::unique_ptr<llvm::Module>
-  Link(StringRef entry, StringRef profile, dxilutil::ExportMap &exportMap) override;
+  Link(StringRef entry, StringRef profile, dxilutil::ExportMap &exportMap,
+       std::vector<DxilLinkDependency> *pDependencies) override;
+  bool IsLinkCurrent(ArrayRef<DxilLinkDependency> Dependencies) override;
+  void LinkParallel(ArrayRef<DxilLinkRequest> Requests, unsigned ThreadCount,
+                    std::vector<DxilLinkResult> &Results) override;
 
 private:
+  struct LibSnapshot {
+    std::string Name;
+    SmallVector<char, 0> Bitcode;
+    StringMap<uint64_t> BodyHashes;
+  };
+  void LinkFromSnapshot(ArrayRef<LibSnapshot> Snapshot,
+                        const DxilLinkRequest &Request,
+                        DxilLinkResult &Result);
   bool AttachLib(DxilLib *lib);
   bool DetachLib(DxilLib *lib);
   bool AddFunctions(SmallVector<StringRef, 4> &workList,
                     SetVector<DxilLib *> &libSet, SetVector<StringRef> &addedFunctionSet,
                     DxilLinkJob &linkJob, bool bLazyLoadDone,
                     bool bAllowFuncionDecls);
+  // Name of the function that name is linked as: an identical function
+  // already seen in this link, or name itself.
+  StringRef GetMergedName(StringRef name);
+  bool IsMergeable(DxilFunctionLinkInfo *linkInfo, DxilLib *pLib);
+  bool IsSameFunction(DxilFunctionLinkInfo *linkInfo,
+                      DxilFunctionLinkInfo *otherLinkInfo);
+  bool IsSameBody(Function *F, Function *OtherF);
+  bool IsSameOperand(Value *V, Value *OtherV,
+                     DenseMap<Value *, Value *> &valueMap);
   // Attached libs to link.
   std::unordered_set<DxilLib *> m_attachedLibs;
   // Owner of all DxilLib.
   StringMap<std::unique_ptr<DxilLib>> m_LibMap;
   llvm::StringMap<std::pair<DxilFunctionLinkInfo *, DxilLib *>>
       m_functionNameMap;
+  // Functions examined for merging in the current link, and what they merge
+  // into.
+  llvm::StringMap<StringRef> m_mergedNames;
+  // Functions other functions may merge into, by body hash.
+  llvm::DenseMap<uint64_t, SmallVector<StringRef, 1>> m_mergeCandidates;
+  // External functions only merge when linking an entry; a lib must keep
+  // every export.
+  bool m_bMergeExternal = false;
 };
 
 } // namespace
@@ -318,6 +417,34 @@ bool DxilLib::HasFunction(std::string &name) {
 }
 
 bool DxilLib::IsInitFunc(llvm::Function *F) { return m_initFuncSet.count(F); }
+
+void DxilLib::SetBodyHashes(const StringMap<uint64_t> &hashes) {
+  Module &M = *m_pModule;
+  const std::string &MID = M.getModuleIdentifier();
+  m_bodyHashMap.clear();
+  for (auto &it : hashes) {
+    Function *F = M.getFunction(it.getKey());
+    // Internal functions were renamed with the lib prefix.
+    if (!F || !m_functionNameMap.count(F->getName()))
+      F = M.getFunction(MID + it.getKey().str());
+    if (!F || !m_functionNameMap.count(F->getName()))
+      continue;
+    m_bodyHashMap[F] = it.getValue();
+  }
+}
+
+void DxilLib::GetBodyHashes(StringMap<uint64_t> &hashes) {
+  for (auto &it : m_bodyHashMap)
+    hashes[it.first->getName()] = it.second;
+}
+
+bool DxilLib::GetBodyHash(Function *F, uint64_t &hash) {
+  auto it = m_bodyHashMap.find(F);
+  if (it == m_bodyHashMap.end())
+    return false;
+  hash = it->second;
+  return true;
+}
 bool DxilLib::IsResourceGlobal(const llvm::Constant *GV) {
   return m_resourceMap.count(GV);
 }
@@ -342,8 +469,13 @@ struct DxilLinkJob {
   std::unique_ptr<llvm::Module> LinkToLib(const ShaderModel *pSM);
   void StripDeadDebugInfo(llvm::Module &M);
   void RunPreparePass(llvm::Module &M);
+  void SetSpecializations(ArrayRef<std::string> specs) {
+    m_specializations = specs;
+  }
   void AddFunction(std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair);
   void AddFunction(llvm::Function *F);
+  // Links calls to name as calls to the identical function mergedName.
+  void AddMergedFunction(StringRef name, StringRef mergedName);
 
 private:
   void LinkNamedMDNodes(Module *pM, ValueToValueMapTy &vmap);
@@ -353,10 +485,14 @@ private:
   void AddFunctions(DxilModule &DM, ValueToValueMapTy &vmap);
   bool AddResource(DxilResourceBase *res, llvm::GlobalVariable *GV);
   void AddResourceToDM(DxilModule &DM);
+  bool Specialize(DxilModule &DM);
+  bool SpecializeField(DxilModule &DM, StringRef spec);
   llvm::MapVector<DxilFunctionLinkInfo *, DxilLib *> m_functionDefs;
   llvm::StringMap<llvm::Function *> m_functionDecls;
   // New created functions.
   llvm::StringMap<llvm::Function *> m_newFunctions;
+  // Functions not linked, replaced by the identical function they map to.
+  llvm::StringMap<std::string> m_mergedFunctions;
   // New created globals.
   llvm::StringMap<llvm::GlobalVariable *> m_newGlobals;
   // Map for resource.
@@ -365,6 +501,8 @@ private:
   LLVMContext &m_ctx;
   dxilutil::ExportMap &m_exportMap;
   unsigned m_valMajor, m_valMinor;
+  ArrayRef<std::string> m_specializations;
+  bool m_bSpecialized = false;
 };
 } // namespace
 
@@ -384,6 +522,12 @@ const char kInvalidValidatorVersion[] = "Validator version does not support targ
 const char kExportNameCollision[] = "Export name collides with another export: ";
 const char kExportFunctionMissing[] = "Could not find target for export: ";
 const char kNoFunctionsToExport[] = "Library has no functions to export";
+const char kInvalidSpecialization[] = "Invalid specialization, expected field=value: ";
+const char kSpecializationNotFound[] =
+    "Cannot find 32-bit scalar constant buffer field to specialize: ";
+const char kSpecializationAmbiguous[] =
+    "Constant buffer field to specialize is ambiguous, qualify it with the constant buffer name: ";
+const char kInvalidSpecializationValue[] = "Invalid value for specialized field ";
 } // namespace
 //------------------------------------------------------------------------------
 //
@@ -650,9 +794,12 @@ void DxilLinkJob::CloneFunctions(ValueToValueMapTy &vmap) {
     for (Function *UsedF : linkInfo->usedFunctions) {
       if (!vmap.count(UsedF)) {
         // Extern function need match by name
-        DXASSERT(m_newFunctions.count(UsedF->getName()),
-                 "Must have new function.");
-        vmap[UsedF] = m_newFunctions[UsedF->getName()];
+        StringRef usedName = UsedF->getName();
+        auto mergedIt = m_mergedFunctions.find(usedName);
+        if (mergedIt != m_mergedFunctions.end())
+          usedName = mergedIt->second;
+        DXASSERT(m_newFunctions.count(usedName), "Must have new function.");
+        vmap[UsedF] = m_newFunctions[usedName];
       }
     }
 
@@ -789,6 +936,9 @@ DxilLinkJob::Link(std::pair<DxilFunctionLinkInfo *, DxilLib *> &entryLinkPair,
   // Link metadata like debug info.
   LinkNamedMDNodes(pM.get(), vmap);
 
+  if (!Specialize(DM))
+    return nullptr;
+
   RunPreparePass(*pM);
 
   return pM;
@@ -859,6 +1009,9 @@ DxilLinkJob::LinkToLib(const ShaderModel *pSM) {
   // Link metadata like debug info.
   LinkNamedMDNodes(pM.get(), vmap);
 
+  if (!Specialize(DM))
+    return nullptr;
+
   RunPreparePass(*pM);
 
   if (!m_exportMap.empty()) {
@@ -937,6 +1090,10 @@ void DxilLinkJob::AddFunction(llvm::Function *F) {
   m_functionDecls[F->getName()] = F;
 }
 
+void DxilLinkJob::AddMergedFunction(StringRef name, StringRef mergedName) {
+  m_mergedFunctions[name] = mergedName;
+}
+
 // Clone of StripDeadDebugInfo::runOnModule.
 // Also remove function which not not in current Module.
 void DxilLinkJob::StripDeadDebugInfo(Module &M) {
@@ -1015,6 +1172,125 @@ void DxilLinkJob::StripDeadDebugInfo(Module &M) {
   }
 }
 
+bool DxilLinkJob::Specialize(DxilModule &DM) {
+  bool bSuccess = true;
+  for (const std::string &spec : m_specializations)
+    bSuccess &= SpecializeField(DM, spec);
+  return bSuccess;
+}
+
+bool DxilLinkJob::SpecializeField(DxilModule &DM, StringRef spec) {
+  StringRef name, value;
+  std::tie(name, value) = spec.split('=');
+  if (name.empty() || value.empty()) {
+    m_ctx.emitError(Twine(kInvalidSpecialization) + spec);
+    return false;
+  }
+  StringRef cbName, fieldName;
+  std::tie(cbName, fieldName) = name.rsplit('.');
+  if (fieldName.empty())
+    std::swap(cbName, fieldName);
+
+  // Find the field. Only top-level 32-bit scalars are supported, which
+  // covers bool, int, uint and float switches.
+  DxilTypeSystem &typeSys = DM.GetTypeSystem();
+  GlobalVariable *CBGV = nullptr;
+  Type *FieldTy = nullptr;
+  unsigned offset = 0;
+  for (auto &CB : DM.GetCBuffers()) {
+    if (!cbName.empty() && CB->GetGlobalName() != cbName)
+      continue;
+    GlobalVariable *GV = dyn_cast<GlobalVariable>(CB->GetGlobalSymbol());
+    if (!GV)
+      continue;
+    StructType *ST = dyn_cast<StructType>(GV->getType()->getElementType());
+    DxilStructAnnotation *SA = ST ? typeSys.GetStructAnnotation(ST) : nullptr;
+    if (!SA)
+      continue;
+    for (unsigned i = 0; i < SA->GetNumFields() && i < ST->getNumElements(); ++i) {
+      DxilFieldAnnotation &FA = SA->GetFieldAnnotation(i);
+      Type *Ty = ST->getElementType(i);
+      if (FA.GetFieldName() != fieldName ||
+          !(Ty->isIntegerTy(32) || Ty->isFloatTy()))
+        continue;
+      if (CBGV) {
+        m_ctx.emitError(Twine(kSpecializationAmbiguous) + name);
+        return false;
+      }
+      CBGV = GV;
+      FieldTy = Ty;
+      offset = FA.GetCBufferOffset();
+    }
+  }
+  if (!CBGV) {
+    m_ctx.emitError(Twine(kSpecializationNotFound) + name);
+    return false;
+  }
+
+  uint32_t bits = 0;
+  if (FieldTy->isFloatTy()) {
+    std::string str = value.str();
+    char *end = nullptr;
+    double d = strtod(str.c_str(), &end);
+    if (*end != '\0') {
+      m_ctx.emitError(Twine(kInvalidSpecializationValue) + name + ": " + value);
+      return false;
+    }
+    bits = FloatToBits((float)d);
+  } else if (value == "true") {
+    bits = 1;
+  } else if (value == "false") {
+    bits = 0;
+  } else {
+    long long v = 0;
+    if (value.getAsInteger(0, v) || v < INT32_MIN || v > UINT32_MAX) {
+      m_ctx.emitError(Twine(kInvalidSpecializationValue) + name + ": " + value);
+      return false;
+    }
+    bits = (uint32_t)v;
+  }
+
+  // Replace the field in every legacy load of its row. The load itself is
+  // left for DCE once all of its fields are constants.
+  unsigned row = offset / 16;
+  unsigned comp = (offset % 16) / 4;
+  for (User *U : CBGV->users()) {
+    LoadInst *LI = dyn_cast<LoadInst>(U);
+    if (!LI)
+      continue;
+    for (User *LU : LI->users()) {
+      DxilInst_CreateHandleForLib createHandle(cast<Instruction>(LU));
+      if (!createHandle)
+        continue;
+      for (User *HU : createHandle.Instr->users()) {
+        DxilInst_CBufferLoadLegacy load(cast<Instruction>(HU));
+        if (!load || load.get_handle() != createHandle.Instr)
+          continue;
+        ConstantInt *regIndex = dyn_cast<ConstantInt>(load.get_regIndex());
+        if (!regIndex || regIndex->getLimitedValue() != row)
+          continue;
+        for (auto it = load.Instr->user_begin(); it != load.Instr->user_end();) {
+          ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(*(it++));
+          if (!EVI || EVI->getIndices()[0] != comp)
+            continue;
+          Type *Ty = EVI->getType();
+          Constant *C = nullptr;
+          if (Ty->isFloatTy())
+            C = ConstantFP::get(Ty, BitsToFloat(bits));
+          else if (Ty->isIntegerTy(32))
+            C = ConstantInt::get(Ty, bits);
+          else
+            continue;
+          EVI->replaceAllUsesWith(C);
+          EVI->eraseFromParent();
+          m_bSpecialized = true;
+        }
+      }
+    }
+  }
+  return true;
+}
+
 void DxilLinkJob::RunPreparePass(Module &M) {
   StripDeadDebugInfo(M);
   legacy::PassManager PM;
@@ -1041,6 +1317,9 @@ void DxilLinkJob::RunPreparePass(Module &M) {
 
   PM.add(createSimplifyInstPass());
   PM.add(createCFGSimplificationPass());
+  // Specialized fields leave branches on constants behind.
+  if (m_bSpecialized)
+    PM.add(createDxilRemoveDeadBlocksPass());
 
   PM.add(createDeadCodeEliminationPass());
   PM.add(createGlobalDCEPass());
@@ -1056,6 +1335,126 @@ void DxilLinkJob::RunPreparePass(Module &M) {
   PM.run(M);
 }
 
+//------------------------------------------------------------------------------
+//
+// DxilLib hashing.
+//
+
+uint64_t DxilLib::GetLibHash() {
+  if (m_bLibHashed)
+    return m_libHash;
+  // Linked along with any function of the lib; see DxilLinkJob::Link and
+  // LinkNamedMDNodes.
+  DxilFunctionHasher H(m_DM.GetTypeSystem());
+  H.Add(m_pModule->getTargetTriple());
+  H.Add(m_DM.GetUseMinPrecision());
+  for (const NamedMDNode &NMD : m_pModule->named_metadata()) {
+    if (DxilMDHelper::IsKnownNamedMetaData(NMD))
+      continue;
+    H.Add(NMD.getName());
+    for (const MDNode *Op : NMD.operands())
+      H.AddMetadata(Op);
+  }
+  m_libHash = H.GetHash();
+  m_bLibHashed = true;
+  return m_libHash;
+}
+
+uint64_t DxilLib::GetFunctionHash(Function *F) {
+  auto it = m_functionHashMap.find(F);
+  if (it != m_functionHashMap.end())
+    return it->second;
+
+  DXASSERT(m_functionNameMap.count(F->getName()), "else invalid Function");
+  DxilFunctionLinkInfo *linkInfo = m_functionNameMap[F->getName()].get();
+  DxilTypeSystem &typeSys = m_DM.GetTypeSystem();
+  DxilFunctionHasher H(typeSys);
+  H.Add(GetLibHash());
+  H.Add(F->getName());
+  H.AddFunction(*F);
+  H.Add(IsInitFunc(F));
+
+  if (m_DM.HasDxilFunctionProps(F)) {
+    DxilFunctionProps props = m_DM.GetDxilFunctionProps(F);
+    H.Add((unsigned)props.shaderKind);
+    // Hash the pointers in the props by what they point to.
+    if (props.IsHS()) {
+      H.Add(props.ShaderProps.HS.patchConstantFunc->getName());
+      props.ShaderProps.HS.patchConstantFunc = nullptr;
+    } else if (props.IsVS()) {
+      for (Constant *&clipPlane : props.ShaderProps.VS.clipPlanes) {
+        if (clipPlane)
+          H.AddConstant(clipPlane);
+        clipPlane = nullptr;
+      }
+    }
+    H.Add(StringRef((const char *)&props.ShaderProps,
+                    sizeof(props.ShaderProps)));
+  }
+  if (m_DM.HasDxilEntryProps(F)) {
+    DxilEntrySignature &sig = m_DM.GetDxilEntryProps(F).sig;
+    H.AddSignature(sig.InputSignature);
+    H.AddSignature(sig.OutputSignature);
+    H.AddSignature(sig.PatchConstOrPrimSignature);
+  }
+
+  for (GlobalVariable *GV : linkInfo->usedGVs) {
+    H.Add(GV->getName());
+    H.AddType(GV->getType());
+    H.AddTypeAnnotations(GV->getType());
+    H.Add((unsigned)GV->getLinkage());
+    H.Add(GV->isConstant());
+    H.Add((unsigned)GV->getThreadLocalMode());
+    H.Add(GV->isExternallyInitialized());
+    H.Add(GV->hasInitializer());
+    if (GV->hasInitializer())
+      H.AddConstant(GV->getInitializer());
+
+    if (DxilResourceBase *res = GetResource(GV)) {
+      H.Add((unsigned)res->GetClass());
+      H.Add((unsigned)res->GetKind());
+      H.Add(res->GetID());
+      H.Add(res->GetSpaceID());
+      H.Add(res->GetLowerBound());
+      H.Add(res->GetRangeSize());
+      H.Add(res->GetGlobalName());
+      switch (res->GetClass()) {
+      case DXIL::ResourceClass::SRV:
+      case DXIL::ResourceClass::UAV: {
+        DxilResource *R = static_cast<DxilResource *>(res);
+        H.Add((unsigned)R->GetCompType().GetKind());
+        H.Add(R->GetSampleCount());
+        H.Add(R->GetElementStride());
+        H.Add((unsigned)R->GetSamplerFeedbackType());
+        H.Add(R->IsGloballyCoherent());
+        H.Add(R->HasCounter());
+        H.Add(R->IsROV());
+        break;
+      }
+      case DXIL::ResourceClass::CBuffer:
+        H.Add(static_cast<DxilCBuffer *>(res)->GetSize());
+        break;
+      case DXIL::ResourceClass::Sampler:
+        H.Add((unsigned)static_cast<DxilSampler *>(res)->GetSamplerKind());
+        break;
+      default:
+        break;
+      }
+    }
+
+    // Init functions are pulled in by the globals they initialize.
+    for (Function *Ctor : m_initFuncSet) {
+      if (Ctor != F &&
+          m_functionNameMap[Ctor->getName()]->usedGVs.count(GV))
+        H.Add(Ctor->getName());
+    }
+  }
+
+  uint64_t hash = H.GetHash();
+  m_functionHashMap[F] = hash;
+  return hash;
+}
+
 //------------------------------------------------------------------------------
 //
 // DxilLinkerImpl methods.
@@ -1084,6 +1483,26 @@ bool DxilLinkerImpl::RegisterLib(StringRef name,
   return true;
 }
 
+bool DxilLinkerImpl::UnregisterLib(StringRef name) {
+  auto iter = m_LibMap.find(name);
+  if (iter == m_LibMap.end()) {
+    return false;
+  }
+  DetachLib(iter->second.get());
+  m_LibMap.erase(iter);
+  return true;
+}
+
+bool DxilLinkerImpl::SetLibFunctionHashes(StringRef name,
+                                          const StringMap<uint64_t> &hashes) {
+  auto iter = m_LibMap.find(name);
+  if (iter == m_LibMap.end()) {
+    return false;
+  }
+  iter->second->SetBodyHashes(hashes);
+  return true;
+}
+
 bool DxilLinkerImpl::AttachLib(StringRef name) {
   auto iter = m_LibMap.find(name);
   if (iter == m_LibMap.end()) {
@@ -1169,6 +1588,175 @@ bool DxilLinkerImpl::DetachLib(DxilLib *lib) {
   return true;
 }
 
+bool DxilLinkerImpl::IsMergeable(DxilFunctionLinkInfo *linkInfo,
+                                 DxilLib *pLib) {
+  Function *F = linkInfo->func;
+  uint64_t hash;
+  if (!pLib->GetBodyHash(F, hash))
+    return false;
+  if (!m_bMergeExternal && !F->hasLocalLinkage())
+    return false;
+  // Entries, patch constant functions and anything referenced other than by
+  // a call, such as init functions in llvm.global_ctors, keep their
+  // identity.
+  DxilModule &DM = pLib->GetDxilModule();
+  if (DM.HasDxilFunctionProps(F) || DM.IsPatchConstantShader(F) ||
+      F->hasAddressTaken())
+    return false;
+  pLib->LazyLoadFunction(F);
+  // The hash covers the names of the globals used, but internal globals are
+  // private to each lib even when their names match.
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB) {
+      for (Value *Op : I.operands()) {
+        if (Constant *C = dyn_cast<Constant>(Op))
+          if (UsesLocalGlobal(C))
+            return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool DxilLinkerImpl::IsSameFunction(DxilFunctionLinkInfo *linkInfo,
+                                    DxilFunctionLinkInfo *otherLinkInfo) {
+  Function *F = linkInfo->func;
+  Function *OtherF = otherLinkInfo->func;
+  // Types are compared by identity; the same struct from two libs is two
+  // types, which a merged call could not be remapped across.
+  if (F->getFunctionType() != OtherF->getFunctionType())
+    return false;
+  if (F->getAttributes() != OtherF->getAttributes())
+    return false;
+  // The stored hash comes from the library and only picks candidates; the
+  // bodies themselves must match.
+  return IsSameBody(F, OtherF);
+}
+
+// Compares two loaded bodies instruction by instruction. Values defined in
+// the functions must correspond in order.
+bool DxilLinkerImpl::IsSameBody(Function *F, Function *OtherF) {
+  if (F->size() != OtherF->size())
+    return false;
+  DenseMap<Value *, Value *> valueMap;
+  for (auto ArgIt = F->arg_begin(), OtherArgIt = OtherF->arg_begin();
+       ArgIt != F->arg_end(); ++ArgIt, ++OtherArgIt)
+    valueMap[&*ArgIt] = &*OtherArgIt;
+  // Everything a body defines is mapped first, since operands may refer to
+  // later blocks and instructions.
+  for (auto BBIt = F->begin(), OtherBBIt = OtherF->begin(); BBIt != F->end();
+       ++BBIt, ++OtherBBIt) {
+    if (BBIt->size() != OtherBBIt->size())
+      return false;
+    valueMap[&*BBIt] = &*OtherBBIt;
+    for (auto It = BBIt->begin(), OtherIt = OtherBBIt->begin();
+         It != BBIt->end(); ++It, ++OtherIt) {
+      // Opcode, types, flags, alignment, predicates and call attributes.
+      if (!It->isSameOperationAs(&*OtherIt))
+        return false;
+      valueMap[&*It] = &*OtherIt;
+    }
+  }
+  for (auto BBIt = F->begin(), OtherBBIt = OtherF->begin(); BBIt != F->end();
+       ++BBIt, ++OtherBBIt) {
+    for (auto It = BBIt->begin(), OtherIt = OtherBBIt->begin();
+         It != BBIt->end(); ++It, ++OtherIt) {
+      for (unsigned i = 0; i < It->getNumOperands(); ++i) {
+        if (!IsSameOperand(It->getOperand(i), OtherIt->getOperand(i),
+                           valueMap))
+          return false;
+      }
+      if (PHINode *Phi = dyn_cast<PHINode>(&*It)) {
+        PHINode *OtherPhi = cast<PHINode>(&*OtherIt);
+        for (unsigned i = 0; i < Phi->getNumIncomingValues(); ++i) {
+          if (valueMap[Phi->getIncomingBlock(i)] !=
+              OtherPhi->getIncomingBlock(i))
+            return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool DxilLinkerImpl::IsSameOperand(Value *V, Value *OtherV,
+                                   DenseMap<Value *, Value *> &valueMap) {
+  auto it = valueMap.find(V);
+  if (it != valueMap.end())
+    return it->second == OtherV;
+  if (V == OtherV)
+    return true;
+  if (V->getType() != OtherV->getType())
+    return false;
+  // Callees match when they merge into the same function; internal callees
+  // of the same name in two libs may still differ.
+  if (Function *Callee = dyn_cast<Function>(V)) {
+    Function *OtherCallee = dyn_cast<Function>(OtherV);
+    if (!OtherCallee)
+      return false;
+    if (Callee->isDeclaration() || OtherCallee->isDeclaration())
+      return Callee->getName() == OtherCallee->getName();
+    return GetMergedName(Callee->getName()) ==
+           GetMergedName(OtherCallee->getName());
+  }
+  // Each lib has its own copy of an external global, linked by name.
+  // Mergeable functions use no internal globals.
+  if (GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+    GlobalValue *OtherGV = dyn_cast<GlobalValue>(OtherV);
+    return OtherGV && !GV->hasLocalLinkage() &&
+           GV->getName() == OtherGV->getName();
+  }
+  // Other constants are uniqued in the shared context, except expressions
+  // on the globals above.
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+    ConstantExpr *OtherCE = dyn_cast<ConstantExpr>(OtherV);
+    if (!OtherCE || CE->getOpcode() != OtherCE->getOpcode() ||
+        CE->getNumOperands() != OtherCE->getNumOperands() ||
+        CE->getRawSubclassOptionalData() !=
+            OtherCE->getRawSubclassOptionalData())
+      return false;
+    if (CE->isCompare() && CE->getPredicate() != OtherCE->getPredicate())
+      return false;
+    if (CE->hasIndices() && CE->getIndices() != OtherCE->getIndices())
+      return false;
+    for (unsigned i = 0; i < CE->getNumOperands(); ++i) {
+      if (!IsSameOperand(CE->getOperand(i), OtherCE->getOperand(i), valueMap))
+        return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+StringRef DxilLinkerImpl::GetMergedName(StringRef name) {
+  auto mergedIt = m_mergedNames.find(name);
+  if (mergedIt != m_mergedNames.end())
+    return mergedIt->second;
+  auto it = m_functionNameMap.find(name);
+  if (it == m_functionNameMap.end())
+    return name;
+  // Stable for the whole link, unlike name.
+  StringRef key = it->getKey();
+  // Recorded first, so that recursion through callees stops here.
+  m_mergedNames[key] = key;
+
+  DxilFunctionLinkInfo *linkInfo = it->second.first;
+  DxilLib *pLib = it->second.second;
+  if (!IsMergeable(linkInfo, pLib))
+    return key;
+  uint64_t hash;
+  pLib->GetBodyHash(linkInfo->func, hash);
+  SmallVector<StringRef, 1> candidates = m_mergeCandidates[hash];
+  for (StringRef candidate : candidates) {
+    if (IsSameFunction(linkInfo, m_functionNameMap[candidate].first)) {
+      m_mergedNames[key] = candidate;
+      return candidate;
+    }
+  }
+  m_mergeCandidates[hash].emplace_back(key);
+  return key;
+}
+
 bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
                                   SetVector<DxilLib *> &libSet,
                                   SetVector<StringRef> &addedFunctionSet,
@@ -1176,6 +1764,12 @@ bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
                                   bool bAllowFuncionDecls) {
   while (!workList.empty()) {
     StringRef name = workList.pop_back_val();
+    // Link an identical function in its place, if there is one.
+    StringRef mergedName = GetMergedName(name);
+    if (mergedName != name) {
+      linkJob.AddMergedFunction(name, mergedName);
+      name = mergedName;
+    }
     // Ignore added function.
     if (addedFunctionSet.count(name))
       continue;
@@ -1216,7 +1810,9 @@ bool DxilLinkerImpl::AddFunctions(SmallVector<StringRef, 4> &workList,
 }
 
 std::unique_ptr<llvm::Module>
-DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &exportMap) {
+DxilLinkerImpl::Link(StringRef entry, StringRef profile,
+                     dxilutil::ExportMap &exportMap,
+                     std::vector<DxilLinkDependency> *pDependencies) {
   const ShaderModel *pSM = ShaderModel::GetByName(profile.data());
   DXIL::ShaderKind kind = pSM->GetKind();
   if (kind == DXIL::ShaderKind::Invalid ||
@@ -1242,11 +1838,15 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
   }
 
   DxilLinkJob linkJob(m_ctx, exportMap, m_valMajor, m_valMinor);
+  linkJob.SetSpecializations(m_specializations);
 
   SetVector<DxilLib *> libSet;
   SetVector<StringRef> addedFunctionSet;
 
   bool bIsLib = pSM->IsLib();
+  m_mergedNames.clear();
+  m_mergeCandidates.clear();
+  m_bMergeExternal = !bIsLib;
   if (!bIsLib) {
     SmallVector<StringRef, 4> workList;
     workList.emplace_back(entry);
@@ -1259,18 +1859,23 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
   } else {
     if (exportMap.empty()) {
       // Add every function for lib profile.
-      for (auto &it : m_functionNameMap) {
-        StringRef name = it.getKey();
-        std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair = it.second;
+      for (StringRef name : GetSortedKeys(m_functionNameMap)) {
+        std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair =
+            m_functionNameMap[name];
         DxilFunctionLinkInfo *linkInfo = linkPair.first;
         DxilLib *pLib = linkPair.second;
 
         Function *F = linkInfo->func;
         pLib->LazyLoadFunction(F);
+        libSet.insert(pLib);
 
-        linkJob.AddFunction(linkPair);
+        StringRef mergedName = GetMergedName(name);
+        if (mergedName != name) {
+          linkJob.AddMergedFunction(name, mergedName);
+          continue;
+        }
 
-        libSet.insert(pLib);
+        linkJob.AddFunction(linkPair);
 
         addedFunctionSet.insert(name);
       }
@@ -1291,8 +1896,7 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
       SmallVector<StringRef, 4> workList;
 
       // Only add exported functions.
-      for (auto &it : m_functionNameMap) {
-        StringRef name = it.getKey();
+      for (StringRef name : GetSortedKeys(m_functionNameMap)) {
         // Only add names exist in exportMap.
         if (exportMap.IsExported(name))
           workList.emplace_back(name);
@@ -1326,6 +1930,27 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
     return nullptr;
 
   if (!bIsLib) {
+    if (pDependencies) {
+      pDependencies->clear();
+      // Functions merged away, or examined and kept, decide the link too.
+      SetVector<StringRef> dependencySet(addedFunctionSet.begin(),
+                                         addedFunctionSet.end());
+      for (auto &it : m_mergedNames) {
+        if (dependencySet.insert(it.getKey()) &&
+            libSet.insert(m_functionNameMap[it.getKey()].second))
+          libSet.back()->BuildGlobalUsage();
+      }
+      for (StringRef name : dependencySet) {
+        std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair =
+            m_functionNameMap[name];
+        DxilLinkDependency Dep;
+        Dep.Lib = linkPair.second->GetName();
+        Dep.Function = name;
+        Dep.Hash = linkPair.second->GetFunctionHash(linkPair.first->func);
+        pDependencies->emplace_back(std::move(Dep));
+      }
+    }
+
     std::pair<DxilFunctionLinkInfo *, DxilLib *> &entryLinkPair =
         m_functionNameMap[entry];
 
@@ -1335,8 +1960,330 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
   }
 }
 
+bool DxilLinkerImpl::IsLinkCurrent(ArrayRef<DxilLinkDependency> Dependencies) {
+  if (Dependencies.empty())
+    return false;
+  // Each function must still come from the same lib. Should every hash then
+  // match, the link walks the same closure, since the usedFunctions, usedGVs
+  // and init functions that drive it are all part of the hashes.
+  SetVector<DxilLib *> libSet;
+  for (const DxilLinkDependency &Dep : Dependencies) {
+    auto it = m_functionNameMap.find(Dep.Function);
+    if (it == m_functionNameMap.end())
+      return false;
+    std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair = it->second;
+    if (linkPair.second->GetName() != Dep.Lib)
+      return false;
+    linkPair.second->LazyLoadFunction(linkPair.first->func);
+    libSet.insert(linkPair.second);
+  }
+
+  for (auto &pLib : libSet) {
+    pLib->BuildGlobalUsage();
+  }
+
+  for (const DxilLinkDependency &Dep : Dependencies) {
+    std::pair<DxilFunctionLinkInfo *, DxilLib *> &linkPair =
+        m_functionNameMap[Dep.Function];
+    if (linkPair.second->GetFunctionHash(linkPair.first->func) != Dep.Hash)
+      return false;
+  }
+  return true;
+}
+
+void DxilLinkerImpl::LinkParallel(ArrayRef<DxilLinkRequest> Requests,
+                                  unsigned ThreadCount,
+                                  std::vector<DxilLinkResult> &Results) {
+  Results.clear();
+  Results.resize(Requests.size());
+  if (Requests.empty())
+    return;
+
+  // Materialize every attached lib once and write it out as the read-only
+  // snapshot jobs load from. Walk m_LibMap rather than m_attachedLibs for a
+  // deterministic order.
+  std::vector<LibSnapshot> Snapshot;
+  std::vector<Module *> SnapshotModules;
+  for (auto &it : m_LibMap) {
+    DxilLib *pLib = it.second.get();
+    if (!m_attachedLibs.count(pLib))
+      continue;
+    // Materializing creates types and constants in the shared context, so
+    // it has to happen here, one lib at a time.
+    Module *pM = pLib->GetDxilModule().GetModule();
+    std::error_code EC = pM->materializeAllPermanently();
+    DXASSERT_LOCALVAR(EC, !EC, "else fail to materialize");
+    Snapshot.emplace_back();
+    Snapshot.back().Name = it.getKey();
+    pLib->GetBodyHashes(Snapshot.back().BodyHashes);
+    SnapshotModules.push_back(pM);
+  }
+
+  // Jobs allocate through the caller's allocator.
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  if (ThreadCount == 0)
+    ThreadCount = DxcThreadPool::GetDefaultThreadCount();
+  size_t MaxTasks = std::max(Requests.size(), SnapshotModules.size());
+  if (ThreadCount > MaxTasks)
+    ThreadCount = MaxTasks;
+  DxcThreadPool Pool(ThreadCount);
+
+  // Writing only reads the fully materialized modules, so the libs can be
+  // serialized concurrently.
+  for (size_t i = 0; i < SnapshotModules.size(); ++i) {
+    Pool.Async([&, i]() {
+      DxcThreadMalloc TM(pMalloc);
+      raw_svector_ostream OS(Snapshot[i].Bitcode);
+      WriteBitcodeToFile(SnapshotModules[i], OS);
+      OS.flush();
+    });
+  }
+  Pool.Wait();
+
+  for (size_t i = 0; i < Requests.size(); ++i) {
+    Pool.Async([&, i]() {
+      DxcThreadMalloc TM(pMalloc);
+      LinkFromSnapshot(Snapshot, Requests[i], Results[i]);
+    });
+  }
+  Pool.Wait();
+}
+
+void DxilLinkerImpl::LinkFromSnapshot(ArrayRef<LibSnapshot> Snapshot,
+                                      const DxilLinkRequest &Request,
+                                      DxilLinkResult &Result) {
+  Result.Context = llvm::make_unique<LLVMContext>();
+  LLVMContext &Ctx = *Result.Context;
+  raw_string_ostream DiagStream(Result.Diagnostics);
+  DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+  PrintDiagnosticContext DiagContext(DiagPrinter);
+  Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
+                           &DiagContext, true);
+
+  {
+    DxilLinkerImpl JobLinker(Ctx, m_valMajor, m_valMinor);
+    JobLinker.SetSpecializations(Request.Specializations);
+    bool bSuccess = true;
+    for (const LibSnapshot &Lib : Snapshot) {
+      // Internal names in the snapshot already carry the lib prefix, so the
+      // module keeps an empty identifier until DxilLib has been built.
+      StringRef Bitcode(Lib.Bitcode.data(), Lib.Bitcode.size());
+      ErrorOr<std::unique_ptr<Module>> M = getLazyBitcodeModule(
+          MemoryBuffer::getMemBuffer(Bitcode, "", false), Ctx);
+      if (std::error_code EC = M.getError()) {
+        Ctx.emitError(Twine("Cannot load library ") + Lib.Name + ": " +
+                      EC.message());
+        bSuccess = false;
+        break;
+      }
+      std::unique_ptr<DxilLib> pLib = llvm::make_unique<DxilLib>(std::move(*M));
+      pLib->GetDxilModule().GetModule()->setModuleIdentifier(Lib.Name);
+      pLib->SetBodyHashes(Lib.BodyHashes);
+      DxilLib *pLibPtr = pLib.get();
+      JobLinker.m_LibMap[Lib.Name] = std::move(pLib);
+      bSuccess &= JobLinker.AttachLib(pLibPtr);
+    }
+
+    if (bSuccess) {
+      dxilutil::ExportMap exportMap;
+      if (exportMap.ParseExports(Request.Exports, DiagStream))
+        Result.Module = JobLinker.Link(Request.Entry, Request.Profile, exportMap);
+    }
+    // The linked module is a clone; the libs can go before the context does.
+  }
+
+  DiagStream.flush();
+  Result.HasErrors = DiagContext.HasErrors() || !Result.Module;
+}
+
+//------------------------------------------------------------------------------
+//
+// Pipeline stage linking.
+//
+
+namespace {
+const char kStagesNotLinkable[] =
+    "Only a vertex or domain shader followed by a pixel shader can be linked as pipeline stages";
+const char kStagesMismatch[] =
+    "Pixel shader input is not placed like the output it reads: ";
+
+// The element ID follows the opcode in every op that accesses a signature
+// element.
+const unsigned kSigElementIdOpIdx = 1;
+
+// Calls in F that write output elements if bOutput, or else that read input
+// elements.
+void CollectSigElementCalls(Function *F, bool bOutput,
+                            std::vector<CallInst *> &Calls) {
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    if (!OP::IsDxilOpFuncCallInst(&*I))
+      continue;
+    switch (OP::GetDxilOpFuncCallInst(&*I)) {
+    case DXIL::OpCode::StoreOutput:
+      if (bOutput)
+        Calls.push_back(cast<CallInst>(&*I));
+      break;
+    case DXIL::OpCode::LoadInput:
+    case DXIL::OpCode::EvalSnapped:
+    case DXIL::OpCode::EvalSampleIndex:
+    case DXIL::OpCode::EvalCentroid:
+    case DXIL::OpCode::AttributeAtVertex:
+      if (!bOutput)
+        Calls.push_back(cast<CallInst>(&*I));
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+unsigned GetSigElementId(CallInst *CI) {
+  return (unsigned)cast<ConstantInt>(CI->getArgOperand(kSigElementIdOpIdx))
+      ->getLimitedValue();
+}
+
+void SetSigElementIds(ArrayRef<CallInst *> Calls, ArrayRef<int> NewIDs) {
+  for (CallInst *CI : Calls) {
+    int NewID = NewIDs[GetSigElementId(CI)];
+    DXASSERT_NOMSG(NewID >= 0);
+    CI->setArgOperand(kSigElementIdOpIdx,
+                      ConstantInt::get(CI->getArgOperand(kSigElementIdOpIdx)->getType(), NewID));
+  }
+}
+
+bool SemanticsOverlap(const DxilSignatureElement &A,
+                      const DxilSignatureElement &B) {
+  if (!A.GetSemanticName().equals_lower(B.GetSemanticName()))
+    return false;
+  unsigned AStart = A.GetSemanticStartIndex();
+  unsigned BStart = B.GetSemanticStartIndex();
+  return AStart < BStart + B.GetRows() && BStart < AStart + A.GetRows();
+}
+
+// Inputs of the linked stage must sit where the outputs they read were
+// written.
+bool IsPlacedAlike(const DxilSignatureElement &Out,
+                   const DxilSignatureElement &In) {
+  if (Out.IsAllocated() != In.IsAllocated())
+    return false;
+  if (!Out.IsAllocated())
+    return true;
+  int RowDelta = (int)In.GetSemanticStartIndex() - (int)Out.GetSemanticStartIndex();
+  return In.GetStartRow() - Out.GetStartRow() == RowDelta &&
+         In.GetStartCol() == Out.GetStartCol();
+}
+} // namespace
+
 namespace hlsl {
 
+bool LinkPipelineStages(Module &Producer, Module &Consumer) {
+  DxilModule &PDM = Producer.GetOrCreateDxilModule();
+  DxilModule &CDM = Consumer.GetOrCreateDxilModule();
+  const ShaderModel *pProducerSM = PDM.GetShaderModel();
+  if (!(pProducerSM->IsVS() || pProducerSM->IsDS()) ||
+      !CDM.GetShaderModel()->IsPS()) {
+    Producer.getContext().emitError(Twine(kStagesNotLinkable));
+    return false;
+  }
+
+  DxilSignature &Outputs = PDM.GetOutputSignature();
+  DxilSignature &Inputs = CDM.GetInputSignature();
+  unsigned NumOutputs = Outputs.GetElements().size();
+  unsigned NumInputs = Inputs.GetElements().size();
+
+  std::vector<CallInst *> Stores, Reads;
+  CollectSigElementCalls(PDM.GetEntryFunction(), /*bOutput*/ true, Stores);
+  CollectSigElementCalls(CDM.GetEntryFunction(), /*bOutput*/ false, Reads);
+  std::vector<bool> InputRead(NumInputs);
+  for (CallInst *CI : Reads)
+    InputRead[GetSigElementId(CI)] = true;
+
+  // An output with a user semantic goes when no input over it is read, and
+  // the inputs over it go too. System values stay; the rasterizer may use
+  // them.
+  std::vector<bool> RemoveOutput(NumOutputs), RemoveInput(NumInputs);
+  for (unsigned o = 0; o < NumOutputs; ++o) {
+    const DxilSignatureElement &Out = Outputs.GetElement(o);
+    bool bRead = false;
+    for (unsigned i = 0; i < NumInputs; ++i) {
+      const DxilSignatureElement &In = Inputs.GetElement(i);
+      if (!SemanticsOverlap(Out, In))
+        continue;
+      if (!IsPlacedAlike(Out, In)) {
+        Producer.getContext().emitError(Twine(kStagesMismatch) +
+                                        In.GetSemanticName());
+        return false;
+      }
+      bRead |= InputRead[i];
+    }
+    if (bRead || !Out.IsArbitrary())
+      continue;
+    RemoveOutput[o] = true;
+    for (unsigned i = 0; i < NumInputs; ++i) {
+      if (SemanticsOverlap(Out, Inputs.GetElement(i)))
+        RemoveInput[i] = true;
+    }
+  }
+
+  std::vector<int> NewOutputIDs = Outputs.RemoveElements(RemoveOutput);
+  std::vector<int> NewInputIDs = Inputs.RemoveElements(RemoveInput);
+  std::vector<CallInst *> KeptStores;
+  for (CallInst *CI : Stores) {
+    if (NewOutputIDs[GetSigElementId(CI)] < 0)
+      CI->eraseFromParent();
+    else
+      KeptStores.push_back(CI);
+  }
+  SetSigElementIds(KeptStores, NewOutputIDs);
+  SetSigElementIds(Reads, NewInputIDs);
+
+  // Close the rows left empty. Elements keep their order and columns, so
+  // the rows they shared are still shared and the signatures still agree.
+  int RowCount = 0;
+  for (DxilSignature *pSig : {&Outputs, &Inputs}) {
+    for (auto &E : pSig->GetElements()) {
+      if (E->IsAllocated())
+        RowCount = std::max(RowCount, E->GetStartRow() + (int)E->GetRows());
+    }
+  }
+  std::vector<int> RowMap(RowCount, -1);
+  for (DxilSignature *pSig : {&Outputs, &Inputs}) {
+    for (auto &E : pSig->GetElements()) {
+      if (!E->IsAllocated())
+        continue;
+      for (unsigned r = 0; r < E->GetRows(); ++r)
+        RowMap[E->GetStartRow() + r] = 0;
+    }
+  }
+  int NextRow = 0;
+  for (int &Row : RowMap) {
+    if (Row == 0)
+      Row = NextRow++;
+  }
+  for (DxilSignature *pSig : {&Outputs, &Inputs}) {
+    for (auto &E : pSig->GetElements()) {
+      if (E->IsAllocated())
+        E->SetStartRow(RowMap[E->GetStartRow()]);
+    }
+  }
+
+  // Remove what only fed the removed outputs, then refresh the ViewID
+  // dependencies, which are indexed by signature location.
+  legacy::PassManager ProducerPM;
+  ProducerPM.add(createDeadCodeEliminationPass());
+  ProducerPM.add(createCFGSimplificationPass());
+  ProducerPM.add(createDeadCodeEliminationPass());
+  ProducerPM.add(createComputeViewIdStatePass());
+  ProducerPM.add(createDxilEmitMetadataPass());
+  ProducerPM.run(Producer);
+
+  legacy::PassManager ConsumerPM;
+  ConsumerPM.add(createComputeViewIdStatePass());
+  ConsumerPM.add(createDxilEmitMetadataPass());
+  ConsumerPM.run(Consumer);
+  return true;
+}
+
 DxilLinker *DxilLinker::CreateLinker(LLVMContext &Ctx, unsigned valMajor, unsigned valMinor) {
   return new DxilLinkerImpl(Ctx, valMajor, valMinor);
 }
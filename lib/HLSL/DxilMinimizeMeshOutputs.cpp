@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilMinimizeMeshOutputs.cpp                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Lowers the maximum output counts of a mesh shader to what it can write.   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilShaderModel.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// The output arrays of a mesh shader are sized by the vertices and primitives
+// it declares, and the runtime reserves on-chip memory for all of them, even
+// when SetMeshOutputCounts always asks for fewer. Shaders written for several
+// meshlet sizes often declare the largest one.
+//
+// This pass finds the largest value each count passed to SetMeshOutputCounts
+// can have, and the largest vertex and primitive index each output store and
+// EmitIndices can use, and lowers the declared maximums to them. Bounds come
+// from constants, from the thread group size for thread ids, and from known
+// bits. The maximums are only lowered, and only when every count and index
+// has a bound, so nothing the shader writes falls outside the outputs.
+//
+// The payload layout and the output signatures are left alone: the
+// amplification shader that writes the payload and the pixel shader that
+// reads the primitive attributes are compiled separately.
+class DxilMinimizeMeshOutputs : public ModulePass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilMinimizeMeshOutputs() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL minimize mesh outputs";
+  }
+
+  bool runOnModule(Module &M) override;
+};
+
+char DxilMinimizeMeshOutputs::ID = 0;
+
+const uint64_t kUnbounded = UINT64_MAX;
+
+// Returns the largest unsigned value V can have, or kUnbounded.
+uint64_t GetUpperBound(Value *V, DxilModule &DM,
+                       SmallPtrSetImpl<Value *> &Visiting) {
+  if (ConstantInt *C = dyn_cast<ConstantInt>(V))
+    return C->getZExtValue();
+  if (!Visiting.insert(V).second)
+    return kUnbounded;
+
+  uint64_t Bound = kUnbounded;
+  if (CallInst *CI = dyn_cast<CallInst>(V)) {
+    if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::FlattenedThreadIdInGroup)) {
+      Bound = (uint64_t)DM.GetNumThreads(0) * DM.GetNumThreads(1) *
+                  DM.GetNumThreads(2) - 1;
+    } else if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::ThreadIdInGroup)) {
+      DxilInst_ThreadIdInGroup ThreadId(CI);
+      ConstantInt *Comp = dyn_cast<ConstantInt>(ThreadId.get_component());
+      if (Comp && Comp->getZExtValue() < 3)
+        Bound = DM.GetNumThreads(Comp->getZExtValue()) - 1;
+    }
+  } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(V)) {
+    uint64_t LHS = GetUpperBound(BO->getOperand(0), DM, Visiting);
+    ConstantInt *RHSC = dyn_cast<ConstantInt>(BO->getOperand(1));
+    switch (BO->getOpcode()) {
+    case Instruction::UDiv:
+      if (RHSC && !RHSC->isZero() && LHS != kUnbounded)
+        Bound = LHS / RHSC->getZExtValue();
+      break;
+    case Instruction::LShr:
+      if (RHSC && RHSC->getZExtValue() < 64 && LHS != kUnbounded)
+        Bound = LHS >> RHSC->getZExtValue();
+      break;
+    case Instruction::URem:
+      if (RHSC && !RHSC->isZero())
+        Bound = std::min(LHS, RHSC->getZExtValue() - 1);
+      break;
+    case Instruction::And:
+      Bound = std::min(LHS, GetUpperBound(BO->getOperand(1), DM, Visiting));
+      break;
+    case Instruction::Add: {
+      uint64_t RHS = GetUpperBound(BO->getOperand(1), DM, Visiting);
+      if (LHS <= UINT32_MAX && RHS <= UINT32_MAX)
+        Bound = LHS + RHS;
+      break;
+    }
+    case Instruction::Mul: {
+      uint64_t RHS = GetUpperBound(BO->getOperand(1), DM, Visiting);
+      if (LHS <= UINT32_MAX && RHS <= UINT32_MAX)
+        Bound = LHS * RHS;
+      break;
+    }
+    default:
+      break;
+    }
+  } else if (ZExtInst *ZE = dyn_cast<ZExtInst>(V)) {
+    Bound = GetUpperBound(ZE->getOperand(0), DM, Visiting);
+  } else if (SelectInst *SI = dyn_cast<SelectInst>(V)) {
+    Bound = std::max(GetUpperBound(SI->getTrueValue(), DM, Visiting),
+                     GetUpperBound(SI->getFalseValue(), DM, Visiting));
+  } else if (PHINode *Phi = dyn_cast<PHINode>(V)) {
+    // A phi in a cycle reaches itself, which has no bound, so only known
+    // bits can bound it below.
+    Bound = 0;
+    for (Value *Incoming : Phi->incoming_values())
+      Bound = std::max(Bound, GetUpperBound(Incoming, DM, Visiting));
+  }
+  Visiting.erase(V);
+
+  // Known bits give a bound for masked and shifted values the cases above
+  // do not follow.
+  IntegerType *Ty = dyn_cast<IntegerType>(V->getType());
+  if (Ty && Ty->getBitWidth() <= 64) {
+    APInt KnownZero(Ty->getBitWidth(), 0), KnownOne(Ty->getBitWidth(), 0);
+    computeKnownBits(V, KnownZero, KnownOne, DM.GetModule()->getDataLayout());
+    Bound = std::min(Bound, (~KnownZero).getZExtValue());
+  }
+  return Bound;
+}
+
+// Raises Count to hold one more than the bound of Index.
+void AddIndex(Value *Index, uint64_t &Count, DxilModule &DM) {
+  SmallPtrSet<Value *, 8> Visiting;
+  uint64_t Bound = GetUpperBound(Index, DM, Visiting);
+  Count = Bound == kUnbounded ? kUnbounded : std::max(Count, Bound + 1);
+}
+
+// Raises Count to hold the bound of a count passed to SetMeshOutputCounts.
+void AddCount(Value *V, uint64_t &Count, DxilModule &DM) {
+  SmallPtrSet<Value *, 8> Visiting;
+  Count = std::max(Count, GetUpperBound(V, DM, Visiting));
+}
+
+bool DxilMinimizeMeshOutputs::runOnModule(Module &M) {
+  if (!M.HasDxilModule())
+    return false;
+  DxilModule &DM = M.GetDxilModule();
+  if (!DM.GetShaderModel()->IsMS())
+    return false;
+
+  uint64_t NumVertices = 0;
+  uint64_t NumPrimitives = 0;
+  bool bFoundCounts = false;
+  for (Function &F : M.functions()) {
+    if (!OP::IsDxilOpFunc(&F))
+      continue;
+    for (User *U : F.users()) {
+      CallInst *CI = dyn_cast<CallInst>(U);
+      if (!CI)
+        continue;
+      switch (OP::GetDxilOpFuncCallInst(CI)) {
+      case DXIL::OpCode::SetMeshOutputCounts: {
+        DxilInst_SetMeshOutputCounts Counts(CI);
+        AddCount(Counts.get_numVertices(), NumVertices, DM);
+        AddCount(Counts.get_numPrimitives(), NumPrimitives, DM);
+        bFoundCounts = true;
+        break;
+      }
+      case DXIL::OpCode::StoreVertexOutput:
+        AddIndex(DxilInst_StoreVertexOutput(CI).get_vertexIndex(), NumVertices,
+                 DM);
+        break;
+      case DXIL::OpCode::StorePrimitiveOutput:
+        AddIndex(DxilInst_StorePrimitiveOutput(CI).get_primitiveIndex(),
+                 NumPrimitives, DM);
+        break;
+      case DXIL::OpCode::EmitIndices: {
+        DxilInst_EmitIndices Indices(CI);
+        AddIndex(Indices.get_PrimitiveIndex(), NumPrimitives, DM);
+        AddIndex(Indices.get_VertexIndex0(), NumVertices, DM);
+        AddIndex(Indices.get_VertexIndex1(), NumVertices, DM);
+        AddIndex(Indices.get_VertexIndex2(), NumVertices, DM);
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+  // The validator reports a shader without SetMeshOutputCounts.
+  if (!bFoundCounts)
+    return false;
+
+  bool bChanged = false;
+  // A count of zero is valid, but keep one of each so the shader still
+  // declares outputs it has arrays for.
+  NumVertices = std::max<uint64_t>(NumVertices, 1);
+  NumPrimitives = std::max<uint64_t>(NumPrimitives, 1);
+  if (NumVertices < DM.GetMaxOutputVertices()) {
+    DM.SetMaxOutputVertices(NumVertices);
+    bChanged = true;
+  }
+  if (NumPrimitives < DM.GetMaxOutputPrimitives()) {
+    DM.SetMaxOutputPrimitives(NumPrimitives);
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+}
+
+ModulePass *llvm::createDxilMinimizeMeshOutputsPass() {
+  return new DxilMinimizeMeshOutputs();
+}
+
+INITIALIZE_PASS(DxilMinimizeMeshOutputs, "dxil-minimize-mesh-outputs",
+                "DXIL minimize mesh outputs", false, false)
@@ -0,0 +1,389 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilNarrowPrecision.cpp                                                   //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Computes pixel shader outputs in 16-bit floats where the error is bounded.//
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilSignature.h"
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Render targets with 8-bit UNORM channels keep far less precision than the
+// 32-bit floats the color is computed in. Where every value in a chain that
+// ends at an SV_Target output has a known range, the error a 16-bit float
+// adds at each step has a known bound too, so the chain can be computed in
+// 16-bit floats when the bound at the output stays within half a step of a
+// UNORM channel with the number of bits asked for.
+//
+// Ranges come from literals and from saturate; a saturate of any value is in
+// [0, 1], and rounding its operand to a 16-bit float first changes the result
+// by at most half an ulp of 1. Values with an unknown range stay 32-bit.
+class DxilNarrowPrecision : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilNarrowPrecision(unsigned UNormBits = 8)
+      : FunctionPass(ID), UNormBits(UNormBits) {}
+
+  const char *getPassName() const override {
+    return "DXIL narrow precision";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // The range of a value and the most its 16-bit version can differ by.
+  struct Bound {
+    double Lo, Hi, Err;
+    double Mag() const { return std::max(std::fabs(Lo), std::fabs(Hi)); }
+  };
+
+  bool GetBound(Value *V, Bound &B) const;
+  bool ComputeBound(Instruction *I, Bound &B) const;
+  Value *GetNarrowOperand(Value *V, IRBuilder<> &Builder);
+  Value *CreateNarrow(Instruction *I, IRBuilder<> &Builder, OP *hlslOP);
+
+  unsigned UNormBits;
+  DenseMap<Value *, Bound> m_Bounds;
+  DenseMap<Value *, Value *> m_Narrowed;
+};
+
+char DxilNarrowPrecision::ID = 0;
+
+const double kHalfMax = 65504.0;
+
+// Half an ulp of a 16-bit float of magnitude Mag, or of the smallest
+// subnormal.
+double RoundingError(double Mag) {
+  return std::max(Mag * std::ldexp(1.0, -11), std::ldexp(1.0, -25));
+}
+
+bool IsNarrowableOp(Instruction *I) {
+  if (!I->getType()->isFloatTy())
+    return false;
+  switch (I->getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub:
+  case Instruction::FMul:
+    // Precise operations keep their precision.
+    return I->hasUnsafeAlgebra();
+  case Instruction::Select:
+    return true;
+  case Instruction::Call:
+    if (!OP::IsDxilOpFuncCallInst(I))
+      return false;
+    switch (OP::GetDxilOpFuncCallInst(I)) {
+    case DXIL::OpCode::Saturate:
+    case DXIL::OpCode::FMax:
+    case DXIL::OpCode::FMin:
+    case DXIL::OpCode::FMad:
+      return true;
+    default:
+      return false;
+    }
+  default:
+    return false;
+  }
+}
+
+bool DxilNarrowPrecision::GetBound(Value *V, Bound &B) const {
+  if (ConstantFP *C = dyn_cast<ConstantFP>(V)) {
+    APFloat Half = C->getValueAPF();
+    bool bLosesInfo = false;
+    Half.convert(APFloat::IEEEhalf, APFloat::rmNearestTiesToEven, &bLosesInfo);
+    if (Half.isInfinity() || Half.isNaN())
+      return false;
+    double D = C->getValueAPF().convertToFloat();
+    bool bUnused = false;
+    Half.convert(APFloat::IEEEdouble, APFloat::rmNearestTiesToEven, &bUnused);
+    B.Lo = B.Hi = D;
+    B.Err = std::fabs(D - Half.convertToDouble());
+    return true;
+  }
+  auto It = m_Bounds.find(V);
+  if (It == m_Bounds.end())
+    return false;
+  B = It->second;
+  return true;
+}
+
+bool DxilNarrowPrecision::ComputeBound(Instruction *I, Bound &B) const {
+  Bound X, Y, Z;
+  switch (I->getOpcode()) {
+  case Instruction::FAdd:
+  case Instruction::FSub: {
+    if (!GetBound(I->getOperand(0), X) || !GetBound(I->getOperand(1), Y))
+      return false;
+    if (I->getOpcode() == Instruction::FSub)
+      Y = {-Y.Hi, -Y.Lo, Y.Err};
+    B.Lo = X.Lo + Y.Lo;
+    B.Hi = X.Hi + Y.Hi;
+    B.Err = X.Err + Y.Err + RoundingError(B.Mag());
+    break;
+  }
+  case Instruction::FMul: {
+    if (!GetBound(I->getOperand(0), X) || !GetBound(I->getOperand(1), Y))
+      return false;
+    double P[] = {X.Lo * Y.Lo, X.Lo * Y.Hi, X.Hi * Y.Lo, X.Hi * Y.Hi};
+    B.Lo = *std::min_element(P, P + 4);
+    B.Hi = *std::max_element(P, P + 4);
+    B.Err = X.Mag() * Y.Err + Y.Mag() * X.Err + X.Err * Y.Err +
+            RoundingError(B.Mag());
+    break;
+  }
+  case Instruction::Select: {
+    if (!GetBound(I->getOperand(1), X) || !GetBound(I->getOperand(2), Y))
+      return false;
+    B.Lo = std::min(X.Lo, Y.Lo);
+    B.Hi = std::max(X.Hi, Y.Hi);
+    B.Err = std::max(X.Err, Y.Err);
+    break;
+  }
+  case Instruction::Call: {
+    CallInst *CI = cast<CallInst>(I);
+    switch (OP::GetDxilOpFuncCallInst(CI)) {
+    case DXIL::OpCode::Saturate:
+      if (GetBound(CI->getArgOperand(1), X)) {
+        B.Lo = std::min(std::max(X.Lo, 0.0), 1.0);
+        B.Hi = std::min(std::max(X.Hi, 0.0), 1.0);
+        B.Err = std::min(X.Err, 1.0);
+      } else {
+        B = {0.0, 1.0, RoundingError(1.0)};
+      }
+      break;
+    case DXIL::OpCode::FMax:
+    case DXIL::OpCode::FMin: {
+      if (!GetBound(CI->getArgOperand(1), X) ||
+          !GetBound(CI->getArgOperand(2), Y))
+        return false;
+      bool bMax = OP::GetDxilOpFuncCallInst(CI) == DXIL::OpCode::FMax;
+      B.Lo = bMax ? std::max(X.Lo, Y.Lo) : std::min(X.Lo, Y.Lo);
+      B.Hi = bMax ? std::max(X.Hi, Y.Hi) : std::min(X.Hi, Y.Hi);
+      B.Err = std::max(X.Err, Y.Err);
+      break;
+    }
+    case DXIL::OpCode::FMad: {
+      if (!GetBound(CI->getArgOperand(1), X) ||
+          !GetBound(CI->getArgOperand(2), Y) ||
+          !GetBound(CI->getArgOperand(3), Z))
+        return false;
+      double P[] = {X.Lo * Y.Lo, X.Lo * Y.Hi, X.Hi * Y.Lo, X.Hi * Y.Hi};
+      double PLo = *std::min_element(P, P + 4);
+      double PHi = *std::max_element(P, P + 4);
+      double PMag = std::max(std::fabs(PLo), std::fabs(PHi));
+      if (PMag > kHalfMax)
+        return false;
+      B.Lo = PLo + Z.Lo;
+      B.Hi = PHi + Z.Hi;
+      // Hardware may or may not round the product, so count it.
+      B.Err = X.Mag() * Y.Err + Y.Mag() * X.Err + X.Err * Y.Err +
+              RoundingError(PMag) + Z.Err + RoundingError(B.Mag());
+      break;
+    }
+    default:
+      return false;
+    }
+    break;
+  }
+  default:
+    return false;
+  }
+  return B.Mag() + B.Err <= kHalfMax;
+}
+
+Value *DxilNarrowPrecision::GetNarrowOperand(Value *V,
+                                             IRBuilder<> &Builder) {
+  auto It = m_Narrowed.find(V);
+  if (It != m_Narrowed.end())
+    return It->second;
+  return Builder.CreateFPTrunc(V, Builder.getHalfTy());
+}
+
+Value *DxilNarrowPrecision::CreateNarrow(Instruction *I,
+                                         IRBuilder<> &Builder, OP *hlslOP) {
+  Builder.SetInsertPoint(I);
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(I)) {
+    Value *A = GetNarrowOperand(BO->getOperand(0), Builder);
+    Value *B = GetNarrowOperand(BO->getOperand(1), Builder);
+    Value *Result = Builder.CreateBinOp(BO->getOpcode(), A, B, BO->getName());
+    if (Instruction *ResultI = dyn_cast<Instruction>(Result))
+      ResultI->copyFastMathFlags(BO);
+    return Result;
+  }
+  if (SelectInst *SI = dyn_cast<SelectInst>(I)) {
+    Value *A = GetNarrowOperand(SI->getTrueValue(), Builder);
+    Value *B = GetNarrowOperand(SI->getFalseValue(), Builder);
+    return Builder.CreateSelect(SI->getCondition(), A, B, SI->getName());
+  }
+  CallInst *CI = cast<CallInst>(I);
+  DXIL::OpCode Opcode = OP::GetDxilOpFuncCallInst(CI);
+  SmallVector<Value *, 4> Args;
+  Args.push_back(CI->getArgOperand(0));
+  for (unsigned i = 1; i < CI->getNumArgOperands(); ++i)
+    Args.push_back(GetNarrowOperand(CI->getArgOperand(i), Builder));
+  Function *HalfF = hlslOP->GetOpFunc(Opcode, Builder.getHalfTy());
+  return Builder.CreateCall(HalfF, Args, CI->getName());
+}
+
+bool DxilNarrowPrecision::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+  if (!DM.GetShaderModel()->IsPS() || DM.GetUseMinPrecision() ||
+      DM.GetEntryFunction() != &F)
+    return false;
+
+  // Bounds follow operands in reverse post order. Phis are not narrowed, so
+  // nothing needs a bound from a later block.
+  m_Bounds.clear();
+  m_Narrowed.clear();
+  std::vector<Instruction *> Candidates;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    for (Instruction &I : *BB) {
+      Bound B;
+      if (IsNarrowableOp(&I) && ComputeBound(&I, B)) {
+        m_Bounds[&I] = B;
+        Candidates.push_back(&I);
+      }
+    }
+  }
+
+  // Outputs to render targets that stay within tolerance.
+  const double Tolerance = std::ldexp(1.0, -(int)(UNormBits + 1));
+  DxilSignature &OutputSig = DM.GetOutputSignature();
+  SmallPtrSet<Instruction *, 16> Sinks;
+  SmallPtrSet<Instruction *, 32> Narrow;
+  std::vector<Instruction *> Worklist;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      DxilInst_StoreOutput Store(&I);
+      if (!Store)
+        continue;
+      ConstantInt *SigId = dyn_cast<ConstantInt>(Store.get_outputSigId());
+      if (!SigId || OutputSig.GetElement(SigId->getLimitedValue())
+                            .GetSemantic()->GetKind() !=
+                        DXIL::SemanticKind::Target)
+        continue;
+      Instruction *V = dyn_cast<Instruction>(Store.get_value());
+      if (!V || !m_Bounds.count(V) || m_Bounds[V].Err > Tolerance)
+        continue;
+      Sinks.insert(&I);
+      Worklist.push_back(V);
+    }
+  }
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.back();
+    Worklist.pop_back();
+    if (!Narrow.insert(I).second)
+      continue;
+    for (Value *Op : I->operands()) {
+      Instruction *OpI = dyn_cast<Instruction>(Op);
+      if (OpI && m_Bounds.count(OpI))
+        Worklist.push_back(OpI);
+    }
+  }
+
+  // A value used as a 32-bit float elsewhere would pass on its error, so it
+  // stays 32-bit, and so in turn do the values it is computed from. Keeping
+  // an operand 32-bit only lowers the error of its users.
+  bool bRemoved = true;
+  while (bRemoved) {
+    bRemoved = false;
+    for (Instruction *I : Candidates) {
+      if (!Narrow.count(I))
+        continue;
+      for (User *U : I->users()) {
+        Instruction *UI = cast<Instruction>(U);
+        if (!Narrow.count(UI) && !Sinks.count(UI)) {
+          Narrow.erase(I);
+          bRemoved = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // Only narrow when the 16-bit operations outnumber the conversions.
+  unsigned NumOps = 0, NumConversions = 0;
+  SmallPtrSet<Value *, 16> Truncated;
+  for (Instruction *I : Candidates) {
+    if (!Narrow.count(I))
+      continue;
+    ++NumOps;
+    for (Value *Op : I->operands()) {
+      if (!Op->getType()->isFloatTy() || isa<Constant>(Op))
+        continue;
+      Instruction *OpI = dyn_cast<Instruction>(Op);
+      if ((!OpI || !Narrow.count(OpI)) && Truncated.insert(Op).second)
+        ++NumConversions;
+    }
+  }
+  for (Instruction *Sink : Sinks) {
+    if (Narrow.count(cast<Instruction>(DxilInst_StoreOutput(Sink).get_value())))
+      ++NumConversions;
+  }
+  if (NumOps <= NumConversions)
+    return false;
+
+  IRBuilder<> Builder(F.getContext());
+  OP *hlslOP = DM.GetOP();
+  std::vector<Instruction *> Dead;
+  for (Instruction *I : Candidates) {
+    if (!Narrow.count(I))
+      continue;
+    m_Narrowed[I] = CreateNarrow(I, Builder, hlslOP);
+    Dead.push_back(I);
+  }
+  for (Instruction *Sink : Sinks) {
+    DxilInst_StoreOutput Store(Sink);
+    auto It = m_Narrowed.find(Store.get_value());
+    if (It == m_Narrowed.end())
+      continue;
+    Builder.SetInsertPoint(Sink);
+    Store.set_value(Builder.CreateFPExt(It->second, Builder.getFloatTy()));
+  }
+  for (auto It = Dead.rbegin(); It != Dead.rend(); ++It)
+    (*It)->eraseFromParent();
+  return true;
+}
+
+}
+
+FunctionPass *llvm::createDxilNarrowPrecisionPass(unsigned UNormBits) {
+  return new DxilNarrowPrecision(UNormBits);
+}
+
+INITIALIZE_PASS(DxilNarrowPrecision, "dxil-narrow-precision",
+                "DXIL narrow precision", false, false)
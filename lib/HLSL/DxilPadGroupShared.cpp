@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPadGroupShared.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Pads groupshared arrays that are accessed with a stride of a bank count.  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilConstants.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilShaderModel.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Groupshared memory is split into banks of 32-bit words, and threads that
+// access different words in one bank at the same time take turns. A thread
+// group that reads a column of a tile whose rows are a multiple of the bank
+// count long, as a transpose does, or that reads array[tid * 32], as a tree
+// reduction does, has every thread in the same bank.
+//
+// This pass adds one word to each row of such a two-dimensional array, and
+// one word after every bank count words of such a one-dimensional array, so
+// the same accesses spread over the banks. Every access is rewritten, so the
+// values the shader sees are unchanged. Arrays whose address escapes, and
+// padding that would go over the groupshared size limit, are left alone.
+// Arrays of structures are already split into an array per field by SROA.
+class DxilPadGroupShared : public ModulePass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilPadGroupShared() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL pad groupshared arrays";
+  }
+
+  bool runOnModule(Module &M) override;
+};
+
+char DxilPadGroupShared::ID = 0;
+
+const unsigned kBankCount = 32;
+
+bool IsWord(Type *Ty) {
+  return Ty->isIntegerTy(32) || Ty->isFloatTy();
+}
+
+// Collects the element addresses of GV, or returns false if the array is
+// used in any other way.
+bool CollectAccesses(GlobalVariable *GV, unsigned NumIndices,
+                     std::vector<GEPOperator *> &GEPs) {
+  for (User *U : GV->users()) {
+    GEPOperator *GEP = dyn_cast<GEPOperator>(U);
+    if (!GEP || GEP->getPointerOperand() != GV ||
+        GEP->getNumIndices() != NumIndices)
+      return false;
+    ConstantInt *First = dyn_cast<ConstantInt>(GEP->getOperand(1));
+    if (!First || !First->isZero())
+      return false;
+    for (User *GEPU : GEP->users()) {
+      if (isa<LoadInst>(GEPU))
+        continue;
+      if (StoreInst *SI = dyn_cast<StoreInst>(GEPU)) {
+        if (SI->getValueOperand() == GEP)
+          return false;
+      } else if (AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(GEPU)) {
+        if (RMW->getPointerOperand() != GEP)
+          return false;
+      } else if (AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(GEPU)) {
+        if (CX->getPointerOperand() != GEP)
+          return false;
+      } else {
+        return false;
+      }
+    }
+    GEPs.push_back(GEP);
+  }
+  return !GEPs.empty();
+}
+
+// Whether Index steps by a multiple of the bank count as the thread changes.
+bool IsBankStrided(Value *Index, unsigned Depth = 0) {
+  BinaryOperator *BO = dyn_cast<BinaryOperator>(Index);
+  if (!BO || Depth > 4)
+    return false;
+  ConstantInt *C = dyn_cast<ConstantInt>(BO->getOperand(1));
+  switch (BO->getOpcode()) {
+  case Instruction::Mul:
+    return C && C->getZExtValue() % kBankCount == 0;
+  case Instruction::Shl:
+    return C && C->getZExtValue() >= Log2_32(kBankCount);
+  case Instruction::Add:
+  case Instruction::Or:
+    return IsBankStrided(BO->getOperand(0), Depth + 1) ||
+           IsBankStrided(BO->getOperand(1), Depth + 1);
+  default:
+    return false;
+  }
+}
+
+// The index of element Index in a one-dimensional array padded after every
+// bank count elements.
+Value *GetPaddedIndex(Value *Index, IRBuilder<> *Builder) {
+  if (ConstantInt *C = dyn_cast<ConstantInt>(Index)) {
+    uint64_t I = C->getZExtValue();
+    return ConstantInt::get(C->getType(), I + I / kBankCount);
+  }
+  Value *Pad = Builder->CreateLShr(Index, Log2_32(kBankCount));
+  return Builder->CreateAdd(Index, Pad);
+}
+
+// Replaces each access with the matching one in NewGV, with the last index
+// rewritten for a one-dimensional array.
+void RewriteAccesses(GlobalVariable *NewGV,
+                     std::vector<GEPOperator *> &GEPs, bool bRemapIndex) {
+  for (GEPOperator *GEP : GEPs) {
+    if (GetElementPtrInst *GEPI = dyn_cast<GetElementPtrInst>(GEP)) {
+      IRBuilder<> Builder(GEPI);
+      SmallVector<Value *, 4> Indices(GEPI->idx_begin(), GEPI->idx_end());
+      if (bRemapIndex)
+        Indices.back() = GetPaddedIndex(Indices.back(), &Builder);
+      Value *NewGEP = Builder.CreateInBoundsGEP(NewGV, Indices, GEPI->getName());
+      GEPI->replaceAllUsesWith(NewGEP);
+      GEPI->eraseFromParent();
+      continue;
+    }
+    ConstantExpr *CE = cast<ConstantExpr>(GEP);
+    SmallVector<Constant *, 4> Indices;
+    for (auto It = GEP->idx_begin(); It != GEP->idx_end(); ++It)
+      Indices.push_back(cast<Constant>(*It));
+    if (bRemapIndex)
+      Indices.back() = cast<Constant>(GetPaddedIndex(Indices.back(), nullptr));
+    Constant *NewGEP = ConstantExpr::getInBoundsGetElementPtr(
+        NewGV->getType()->getElementType(), NewGV, Indices);
+    CE->replaceAllUsesWith(NewGEP);
+    CE->destroyConstant();
+  }
+}
+
+bool DxilPadGroupShared::runOnModule(Module &M) {
+  if (!M.HasDxilModule())
+    return false;
+  DxilModule &DM = M.GetDxilModule();
+  const DataLayout &DL = M.getDataLayout();
+  unsigned SizeLimit =
+      DM.GetShaderModel()->IsMS() ? DXIL::kMaxMSSMSize : DXIL::kMaxTGSMSize;
+
+  std::vector<GlobalVariable *> SharedGVs;
+  uint64_t TotalSize = 0;
+  for (GlobalVariable &GV : M.globals()) {
+    if (GV.getType()->getAddressSpace() != DXIL::kTGSMAddrSpace)
+      continue;
+    SharedGVs.push_back(&GV);
+    TotalSize += DL.getTypeAllocSize(GV.getType()->getElementType());
+  }
+
+  bool bChanged = false;
+  for (GlobalVariable *GV : SharedGVs) {
+    ArrayType *AT = dyn_cast<ArrayType>(GV->getType()->getElementType());
+    if (!AT)
+      continue;
+    ArrayType *RowTy = dyn_cast<ArrayType>(AT->getElementType());
+    std::vector<GEPOperator *> GEPs;
+    Type *NewTy = nullptr;
+    bool bRemapIndex = false;
+    if (RowTy && IsWord(RowTy->getElementType()) &&
+        RowTy->getNumElements() % kBankCount == 0) {
+      // Rows are read across threads when the row index is not constant.
+      if (!CollectAccesses(GV, 3, GEPs))
+        continue;
+      bool bColumnAccess = false;
+      for (GEPOperator *GEP : GEPs)
+        bColumnAccess |= !isa<Constant>(GEP->getOperand(2));
+      if (!bColumnAccess)
+        continue;
+      NewTy = ArrayType::get(
+          ArrayType::get(RowTy->getElementType(), RowTy->getNumElements() + 1),
+          AT->getNumElements());
+    } else if (IsWord(AT->getElementType()) &&
+               AT->getNumElements() > kBankCount) {
+      if (!CollectAccesses(GV, 2, GEPs))
+        continue;
+      bool bStrided = false;
+      for (GEPOperator *GEP : GEPs)
+        bStrided |= IsBankStrided(GEP->getOperand(2));
+      if (!bStrided)
+        continue;
+      uint64_t N = AT->getNumElements();
+      NewTy = ArrayType::get(AT->getElementType(), N + (N - 1) / kBankCount);
+      bRemapIndex = true;
+    } else {
+      continue;
+    }
+
+    uint64_t OldSize = DL.getTypeAllocSize(AT);
+    uint64_t NewSize = DL.getTypeAllocSize(NewTy);
+    if (TotalSize - OldSize + NewSize > SizeLimit)
+      continue;
+    TotalSize += NewSize - OldSize;
+
+    GlobalVariable *NewGV = new GlobalVariable(
+        M, NewTy, GV->isConstant(), GV->getLinkage(), UndefValue::get(NewTy),
+        GV->getName(), GV, GV->getThreadLocalMode(), DXIL::kTGSMAddrSpace);
+    NewGV->setAlignment(GV->getAlignment());
+    RewriteAccesses(NewGV, GEPs, bRemapIndex);
+    dxilutil::EmitNoteOnGlobalVariable(
+        GV, Twine("groupshared ") + GV->getName() + " padded from " +
+                Twine(OldSize) + " to " + Twine(NewSize) +
+                " bytes to avoid bank conflicts.");
+    NewGV->takeName(GV);
+    GV->eraseFromParent();
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+}
+
+ModulePass *llvm::createDxilPadGroupSharedPass() {
+  return new DxilPadGroupShared();
+}
+
+INITIALIZE_PASS(DxilPadGroupShared, "dxil-pad-groupshared",
+                "DXIL pad groupshared arrays", false, false)
@@ -104,6 +104,8 @@ public:
   void applyOptions(PassOptions O) override;
   bool runOnModule(Module &M) override;
 
+  static ShaderRecordEntry FindRootSignatureDescriptor(const DxilVersionedRootSignatureDesc &rootSignatureDescriptor, unsigned int ShaderRecordIdentifierSizeInBytes, DXIL::ResourceClass resourceClass, unsigned int baseRegisterIndex, unsigned int registerSpace);
+
 private:
   void ValidateParameters();
   void AddInputBinding(Module &M);
@@ -152,7 +154,6 @@ private:
   // Unlike the LLVM version of this function, this does not requires the InstructionToReplace and the ValueToReplaceWith to be the same instruction type
   static void ReplaceUsesOfWith(llvm::Instruction *InstructionToReplace, llvm::Value *ValueToReplaceWith);
 
-  static ShaderRecordEntry FindRootSignatureDescriptor(const DxilVersionedRootSignatureDesc &rootSignatureDescriptor, unsigned int ShaderRecordIdentifierSizeInBytes, DXIL::ResourceClass resourceClass, unsigned int baseRegisterIndex, unsigned int registerSpace);
 
   // TODO: I would like to see these prefixed with m_
   llvm::Value *ShaderTableHandle = nullptr;
@@ -177,6 +178,8 @@ private:
 
   ShaderInfo *pInputShaderInfo;
   const DxilVersionedRootSignatureDesc *pRootSignatureDesc;
+  // Bindings looked up in the root signature, for DxilShaderRecordPatchCache
+  std::vector<DxilShaderRecordBinding> *pBindings = nullptr;
   DXIL::ShaderKind ShaderKind;
 };
 
@@ -223,6 +226,9 @@ void DxilPatchShaderRecordBindings::applyOptions(PassOptions O) {
       unsigned int cHexRadix = 16;
       pInputShaderInfo = (ShaderInfo*)strtoull(option.second.data(), nullptr, cHexRadix);
       pRootSignatureDesc = (const DxilVersionedRootSignatureDesc*)pInputShaderInfo->pRootSignatureDesc;
+    } else if (0 == option.first.compare("bindings")) {
+      unsigned int cHexRadix = 16;
+      pBindings = (std::vector<DxilShaderRecordBinding>*)strtoull(option.second.data(), nullptr, cHexRadix);
     }
   }
 }
@@ -868,6 +874,12 @@ void DxilPatchShaderRecordBindings::PatchShaderBindings(Module &M) {
           resourceClass,
           registerIndex,
           registerSpace);
+        if (pBindings) {
+          pBindings->push_back({ (unsigned)resourceClass, registerIndex, registerSpace,
+                                 (unsigned)shaderRecord.ParameterType,
+                                 shaderRecord.RecordOffsetInBytes,
+                                 shaderRecord.OffsetInDescriptors });
+        }
 
         const bool IsBindingSpecifiedInLocalRootSignature = !shaderRecord.IsInvalid();
         if (IsBindingSpecifiedInLocalRootSignature) {
@@ -1143,6 +1155,102 @@ ShaderRecordEntry DxilPatchShaderRecordBindings::FindRootSignatureDescriptor(
   }
 }
 
+// The view spaces of the shader info, as a count and the keys for SRVs, then
+// for UAVs.
+static std::string GetViewSpaces(const ShaderInfo &info) {
+  std::string spaces;
+  unsigned int numSRVSpaces = *info.pNumSRVSpaces;
+  unsigned int numUAVSpaces = *info.pNumUAVSpaces;
+  spaces.append((const char *)&numSRVSpaces, sizeof(numSRVSpaces));
+  spaces.append((const char *)info.pSRVRegisterSpaceArray, numSRVSpaces * sizeof(ViewKey));
+  spaces.append((const char *)&numUAVSpaces, sizeof(numUAVSpaces));
+  spaces.append((const char *)info.pUAVRegisterSpaceArray, numUAVSpaces * sizeof(ViewKey));
+  return spaces;
+}
 
+static void SetViewSpaces(ShaderInfo &info, StringRef spaces) {
+  const char *pData = spaces.data();
+  memcpy(info.pNumSRVSpaces, pData, sizeof(unsigned int));
+  pData += sizeof(unsigned int);
+  memcpy(info.pSRVRegisterSpaceArray, pData, *info.pNumSRVSpaces * sizeof(ViewKey));
+  pData += *info.pNumSRVSpaces * sizeof(ViewKey);
+  memcpy(info.pNumUAVSpaces, pData, sizeof(unsigned int));
+  pData += sizeof(unsigned int);
+  memcpy(info.pUAVRegisterSpaceArray, pData, *info.pNumUAVSpaces * sizeof(ViewKey));
+}
 
+// Everything about a patch of the shader with the given ID that its output
+// depends on: where the bindings are, the descriptor size and the view
+// spaces before the patch.
+static std::string GetPatchKey(unsigned int shaderID, const ShaderInfo &info,
+                               const std::vector<DxilShaderRecordBinding> &bindings,
+                               StringRef viewSpaces) {
+  std::string key;
+  key.append((const char *)&shaderID, sizeof(shaderID));
+  key.append((const char *)&info.SrvCbvUavDescriptorSizeInBytes, sizeof(unsigned int));
+  for (const DxilShaderRecordBinding &binding : bindings) {
+    key.append((const char *)&binding.ParameterType, sizeof(unsigned int));
+    key.append((const char *)&binding.RecordOffsetInBytes, sizeof(unsigned int));
+    key.append((const char *)&binding.OffsetInDescriptors, sizeof(unsigned int));
+  }
+  key.append(viewSpaces.data(), viewSpaces.size());
+  return key;
+}
+
+bool DxilShaderRecordPatchCache::lookup(StringRef Bytecode, void *pShaderInfo,
+                                        Request &R, std::string &Patched) {
+  ShaderInfo &info = *(ShaderInfo *)pShaderInfo;
+  R.Shader = Bytecode;
+  R.Shader.push_back('\0');
+  if (info.ExportName)
+    R.Shader += Unicode::UTF16ToUTF8StringOrThrow(info.ExportName);
+  R.ViewSpaces = GetViewSpaces(info);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto shaderIt = m_shaders.find(R.Shader);
+  if (shaderIt == m_shaders.end())
+    return false;
 
+  // Look the bindings up where this root signature puts them.
+  const DxilVersionedRootSignatureDesc &rootSignature =
+      *(const DxilVersionedRootSignatureDesc *)info.pRootSignatureDesc;
+  std::vector<DxilShaderRecordBinding> bindings = shaderIt->second.Bindings;
+  for (DxilShaderRecordBinding &binding : bindings) {
+    ShaderRecordEntry entry = DxilPatchShaderRecordBindings::FindRootSignatureDescriptor(
+        rootSignature, info.ShaderRecordIdentifierSizeInBytes,
+        (DXIL::ResourceClass)binding.ResourceClass, binding.ShaderRegister,
+        binding.RegisterSpace);
+    binding.ParameterType = (unsigned)entry.ParameterType;
+    binding.RecordOffsetInBytes = entry.RecordOffsetInBytes;
+    binding.OffsetInDescriptors = entry.OffsetInDescriptors;
+  }
+
+  auto patchIt = m_patches.find(
+      GetPatchKey(shaderIt->second.ID, info, bindings, R.ViewSpaces));
+  if (patchIt == m_patches.end())
+    return false;
+  Patched = patchIt->second.Patched;
+  SetViewSpaces(info, patchIt->second.ViewSpaces);
+  return true;
+}
+
+void DxilShaderRecordPatchCache::insert(
+    const Request &R, const void *pShaderInfo,
+    const std::vector<DxilShaderRecordBinding> &Bindings, StringRef Patched) {
+  const ShaderInfo &info = *(const ShaderInfo *)pShaderInfo;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto shaderIt = m_shaders.find(R.Shader);
+  if (shaderIt == m_shaders.end()) {
+    ShaderEntry entry = { (unsigned int)m_shaders.size(), Bindings };
+    shaderIt = m_shaders.insert(std::make_pair(R.Shader, std::move(entry))).first;
+  }
+  PatchEntry &entry = m_patches[GetPatchKey(shaderIt->second.ID, info, Bindings, R.ViewSpaces)];
+  entry.Patched = Patched;
+  entry.ViewSpaces = GetViewSpaces(info);
+}
+
+void DxilShaderRecordPatchCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_shaders.clear();
+  m_patches.clear();
+}
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilRematerialize.cpp                                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Recomputes cheap values where they are used, instead of keeping them live //
+// across code with high register pressure.                                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/DxilLiveValues.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Values read from cbuffers are computed once where the source reads them,
+// and GVN and the hoisting passes move them further up, so a value used at
+// the end of a shader is often held in a register through everything in
+// between. Reading the cbuffer again next to the use costs a load that
+// is uniform and cached, which is cheaper than losing occupancy.
+//
+// This pass finds scalars extracted from cbuffer loads, whose handle and
+// offset are constant, that are live into a block where the estimated live
+// scalars exceed the limit. Each block that uses such a value outside its
+// own block gets a copy of the handle creation, the load and the extract
+// before its first use. Values live only within one block are left alone.
+class DxilRematerialize : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilRematerialize(unsigned MaxLiveScalars = 32)
+      : FunctionPass(ID), m_MaxLiveScalars(MaxLiveScalars) {}
+
+  const char *getPassName() const override {
+    return "DXIL rematerialize cheap values";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  unsigned m_MaxLiveScalars;
+};
+
+char DxilRematerialize::ID = 0;
+
+// Returns true if V can be computed again anywhere from constants alone.
+bool IsRematerializable(Value *V) {
+  if (isa<Constant>(V))
+    return true;
+  if (ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(V))
+    return IsRematerializable(EVI->getAggregateOperand());
+  CallInst *CI = dyn_cast<CallInst>(V);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI))
+    return false;
+  switch (OP::GetDxilOpFuncCallInst(CI)) {
+  case DXIL::OpCode::CreateHandle:
+  case DXIL::OpCode::CreateHandleFromHeap:
+  case DXIL::OpCode::AnnotateHandle:
+  case DXIL::OpCode::CBufferLoad:
+  case DXIL::OpCode::CBufferLoadLegacy:
+    break;
+  default:
+    return false;
+  }
+  for (Value *Arg : CI->arg_operands()) {
+    if (!IsRematerializable(Arg))
+      return false;
+  }
+  return true;
+}
+
+typedef DenseMap<std::pair<Value *, BasicBlock *>, Value *> CloneMap;
+
+// Copies V, and the instructions it is computed from, before InsertPt. The
+// copies made for a block are shared by all its uses.
+Value *Rematerialize(Value *V, Instruction *InsertPt, CloneMap &Clones) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I)
+    return V;
+  std::pair<Value *, BasicBlock *> Key(V, InsertPt->getParent());
+  auto It = Clones.find(Key);
+  if (It != Clones.end())
+    return It->second;
+  Instruction *NewI = I->clone();
+  for (unsigned i = 0; i < NewI->getNumOperands(); ++i)
+    NewI->setOperand(i, Rematerialize(I->getOperand(i), InsertPt, Clones));
+  NewI->insertBefore(InsertPt);
+  NewI->setName(I->getName());
+  Clones[Key] = NewI;
+  return NewI;
+}
+
+BasicBlock *GetUseBlock(Use &U) {
+  if (PHINode *Phi = dyn_cast<PHINode>(U.getUser()))
+    return Phi->getIncomingBlock(U);
+  return cast<Instruction>(U.getUser())->getParent();
+}
+
+bool DxilRematerialize::runOnFunction(Function &F) {
+  DxilLiveValues LiveValues;
+  LiveValues.compute(F);
+  std::vector<BasicBlock *> HighPressureBlocks;
+  for (BasicBlock &BB : F) {
+    if (LiveValues.getPeakLiveScalars(&BB) > m_MaxLiveScalars)
+      HighPressureBlocks.push_back(&BB);
+  }
+  if (HighPressureBlocks.empty())
+    return false;
+
+  // Uses to rewrite, by the block that gets the copy.
+  std::vector<Instruction *> Candidates;
+  MapVector<BasicBlock *, std::vector<Use *>> UsesByBlock;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (!isa<ExtractValueInst>(I) || !IsRematerializable(&I))
+        continue;
+      bool bLiveAcrossPressure = false;
+      for (BasicBlock *HighBB : HighPressureBlocks) {
+        if (HighBB != &BB && LiveValues.isLiveIn(&I, HighBB)) {
+          bLiveAcrossPressure = true;
+          break;
+        }
+      }
+      if (!bLiveAcrossPressure)
+        continue;
+      Candidates.push_back(&I);
+      for (Use &U : I.uses()) {
+        BasicBlock *UseBB = GetUseBlock(U);
+        if (UseBB != &BB)
+          UsesByBlock[UseBB].push_back(&U);
+      }
+    }
+  }
+  if (Candidates.empty())
+    return false;
+
+  CloneMap Clones;
+  for (auto &It : UsesByBlock) {
+    BasicBlock *UseBB = It.first;
+    // Copies go before the first user in the block, so they are available
+    // to every use there. A value incoming to a phi is used at the end of
+    // the incoming block.
+    SmallPtrSet<Instruction *, 8> Users;
+    for (Use *U : It.second) {
+      Instruction *User = cast<Instruction>(U->getUser());
+      Users.insert(isa<PHINode>(User) ? UseBB->getTerminator() : User);
+    }
+    Instruction *InsertPt = nullptr;
+    for (Instruction &I : *UseBB) {
+      if (Users.count(&I)) {
+        InsertPt = &I;
+        break;
+      }
+    }
+    for (Use *U : It.second)
+      U->set(Rematerialize(U->get(), InsertPt, Clones));
+  }
+
+  for (Instruction *I : Candidates)
+    RecursivelyDeleteTriviallyDeadInstructions(I);
+  return true;
+}
+
+}
+
+FunctionPass *llvm::createDxilRematerializePass(unsigned MaxLiveScalars) {
+  return new DxilRematerialize(MaxLiveScalars);
+}
+
+INITIALIZE_PASS(DxilRematerialize, "dxil-rematerialize",
+                "DXIL rematerialize cheap values", false, false)
@@ -0,0 +1,384 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderStatistics.cpp                                                  //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Computes static cost statistics of the entries of a DXIL module.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilShaderStatistics.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/DxilLiveValues.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+// Loops that would take longer than this to count are taken as unknown.
+const unsigned kMaxTripCount = 4096;
+
+struct EntryStatistics {
+  uint64_t Alu = 0;
+  uint64_t Transcendental = 0;
+  uint64_t Texture = 0;
+  uint64_t Memory = 0;
+  uint64_t Other = 0;
+  unsigned Instructions = 0;
+  unsigned Loops = 0;
+  unsigned UnknownTripLoops = 0;
+  unsigned PeakLiveScalars = 0;
+  uint64_t GroupSharedBytes = 0;
+  unsigned IndexableArrays = 0;
+  uint64_t IndexableArrayScalars = 0;
+};
+
+enum class CostKind { Alu, Transcendental, Texture, Memory, Other };
+
+uint64_t SaturatingMul(uint64_t A, uint64_t B) {
+  if (A != 0 && B > UINT64_MAX / A)
+    return UINT64_MAX;
+  return A * B;
+}
+
+uint64_t SaturatingAdd(uint64_t A, uint64_t B) {
+  return A > UINT64_MAX - B ? UINT64_MAX : A + B;
+}
+
+CostKind GetDxilOpCostKind(DXIL::OpCode Opcode) {
+  switch (Opcode) {
+  case DXIL::OpCode::Sin:
+  case DXIL::OpCode::Cos:
+  case DXIL::OpCode::Tan:
+  case DXIL::OpCode::Asin:
+  case DXIL::OpCode::Acos:
+  case DXIL::OpCode::Atan:
+  case DXIL::OpCode::Hsin:
+  case DXIL::OpCode::Hcos:
+  case DXIL::OpCode::Htan:
+  case DXIL::OpCode::Exp:
+  case DXIL::OpCode::Log:
+  case DXIL::OpCode::Sqrt:
+  case DXIL::OpCode::Rsqrt:
+    return CostKind::Transcendental;
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::TextureGather:
+  case DXIL::OpCode::TextureGatherCmp:
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::CalculateLOD:
+    return CostKind::Texture;
+  case DXIL::OpCode::BufferLoad:
+  case DXIL::OpCode::BufferStore:
+  case DXIL::OpCode::BufferUpdateCounter:
+  case DXIL::OpCode::RawBufferLoad:
+  case DXIL::OpCode::RawBufferStore:
+  case DXIL::OpCode::TextureStore:
+  case DXIL::OpCode::CBufferLoad:
+  case DXIL::OpCode::CBufferLoadLegacy:
+  case DXIL::OpCode::AtomicBinOp:
+  case DXIL::OpCode::AtomicCompareExchange:
+    return CostKind::Memory;
+  default:
+    break;
+  }
+
+  switch (OP::GetOpCodeClass(Opcode)) {
+  case DXIL::OpCodeClass::Unary:
+  case DXIL::OpCodeClass::UnaryBits:
+  case DXIL::OpCodeClass::Binary:
+  case DXIL::OpCodeClass::BinaryWithCarryOrBorrow:
+  case DXIL::OpCodeClass::BinaryWithTwoOuts:
+  case DXIL::OpCodeClass::Tertiary:
+  case DXIL::OpCodeClass::Quaternary:
+  case DXIL::OpCodeClass::Dot2:
+  case DXIL::OpCodeClass::Dot3:
+  case DXIL::OpCodeClass::Dot4:
+  case DXIL::OpCodeClass::Dot2AddHalf:
+  case DXIL::OpCodeClass::Dot4AddPacked:
+  case DXIL::OpCodeClass::IsSpecialFloat:
+  case DXIL::OpCodeClass::LegacyF16ToF32:
+  case DXIL::OpCodeClass::LegacyF32ToF16:
+  case DXIL::OpCodeClass::LegacyDoubleToFloat:
+  case DXIL::OpCodeClass::LegacyDoubleToSInt32:
+  case DXIL::OpCodeClass::LegacyDoubleToUInt32:
+  case DXIL::OpCodeClass::MakeDouble:
+  case DXIL::OpCodeClass::SplitDouble:
+    return CostKind::Alu;
+  default:
+    return CostKind::Other;
+  }
+}
+
+CostKind GetCostKind(Instruction &I) {
+  if (OP::IsDxilOpFuncCallInst(&I))
+    return GetDxilOpCostKind(OP::GetDxilOpFuncCallInst(&I));
+  if (isa<BinaryOperator>(I) || isa<CmpInst>(I) || isa<CastInst>(I) ||
+      isa<SelectInst>(I))
+    return CostKind::Alu;
+  if (isa<LoadInst>(I) || isa<StoreInst>(I) || isa<AtomicRMWInst>(I) ||
+      isa<AtomicCmpXchgInst>(I))
+    return CostKind::Memory;
+  return CostKind::Other;
+}
+
+uint64_t GetFlattenedScalarCount(Type *Ty) {
+  if (ArrayType *AT = dyn_cast<ArrayType>(Ty))
+    return AT->getNumElements() * GetFlattenedScalarCount(AT->getElementType());
+  if (StructType *ST = dyn_cast<StructType>(Ty)) {
+    uint64_t Count = 0;
+    for (Type *EltTy : ST->elements())
+      Count += GetFlattenedScalarCount(EltTy);
+    return Count;
+  }
+  return DxilLiveValues::getScalarCount(Ty);
+}
+
+// Returns the number of times the header of L runs each time the loop is
+// entered, or 0 if it is not known. Only loops exited from the header or
+// latch by comparing an induction variable, counting by a constant from a
+// constant, with a constant are counted.
+unsigned GetTripCount(Loop *L) {
+  BasicBlock *Exiting = L->getExitingBlock();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Exiting || !Latch || !Preheader ||
+      (Exiting != L->getHeader() && Exiting != Latch))
+    return 0;
+  BranchInst *BI = dyn_cast<BranchInst>(Exiting->getTerminator());
+  if (!BI || !BI->isConditional())
+    return 0;
+  ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp)
+    return 0;
+  ConstantInt *Limit = dyn_cast<ConstantInt>(Cmp->getOperand(1));
+  Value *Counted = Cmp->getOperand(0);
+  ICmpInst::Predicate Pred = Cmp->getPredicate();
+  if (!Limit) {
+    Limit = dyn_cast<ConstantInt>(Cmp->getOperand(0));
+    Counted = Cmp->getOperand(1);
+    Pred = Cmp->getSwappedPredicate();
+  }
+  if (!Limit)
+    return 0;
+
+  // Counted is the induction variable, or its next value.
+  PHINode *IV = dyn_cast<PHINode>(Counted);
+  bool bComparesNext = false;
+  if (!IV) {
+    BinaryOperator *Step = dyn_cast<BinaryOperator>(Counted);
+    if (!Step || Step->getOpcode() != Instruction::Add)
+      return 0;
+    IV = dyn_cast<PHINode>(Step->getOperand(0));
+    bComparesNext = true;
+  }
+  if (!IV || IV->getParent() != L->getHeader() ||
+      IV->getNumIncomingValues() != 2)
+    return 0;
+  ConstantInt *Start =
+      dyn_cast<ConstantInt>(IV->getIncomingValueForBlock(Preheader));
+  BinaryOperator *Next =
+      dyn_cast<BinaryOperator>(IV->getIncomingValueForBlock(Latch));
+  if (!Start || !Next || Next->getOpcode() != Instruction::Add ||
+      Next->getOperand(0) != IV || (bComparesNext && Next != Counted))
+    return 0;
+  ConstantInt *Step = dyn_cast<ConstantInt>(Next->getOperand(1));
+  if (!Step || Step->isZero() || Limit->getType() != Start->getType())
+    return 0;
+
+  bool bExitOnTrue = !L->contains(BI->getSuccessor(0));
+  APInt Current = Start->getValue();
+  for (unsigned Trips = 1; Trips <= kMaxTripCount; ++Trips) {
+    APInt NextValue = Current + Step->getValue();
+    Constant *Compared =
+        ConstantInt::get(Limit->getType(), bComparesNext ? NextValue : Current);
+    Constant *Result = ConstantExpr::getICmp(Pred, Compared, Limit);
+    if (Result->isOneValue() == bExitOnTrue)
+      return Trips;
+    Current = NextValue;
+  }
+  return 0;
+}
+
+bool IsUsedInFunction(Value *V, Function *F) {
+  for (User *U : V->users()) {
+    if (Instruction *I = dyn_cast<Instruction>(U)) {
+      if (I->getParent()->getParent() == F)
+        return true;
+    } else if (isa<ConstantExpr>(U) && IsUsedInFunction(U, F)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HasDynamicIndexInFunction(Value *Ptr, Function *F) {
+  for (User *U : Ptr->users()) {
+    GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U);
+    if (!GEP || GEP->getParent()->getParent() != F)
+      continue;
+    if (!GEP->hasAllConstantIndices())
+      return true;
+  }
+  return false;
+}
+
+EntryStatistics ComputeStatistics(Function &F) {
+  EntryStatistics Stats;
+  DominatorTree DT;
+  DT.recalculate(F);
+  LoopInfo LI;
+  LI.Analyze(DT);
+
+  DenseMap<Loop *, unsigned> TripCounts;
+  SmallVector<Loop *, 8> Worklist(LI.begin(), LI.end());
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    Worklist.append(L->begin(), L->end());
+    unsigned Trips = GetTripCount(L);
+    TripCounts[L] = Trips;
+    Stats.Loops++;
+    if (Trips == 0)
+      Stats.UnknownTripLoops++;
+  }
+
+  for (BasicBlock &BB : F) {
+    uint64_t Weight = 1;
+    for (Loop *L = LI.getLoopFor(&BB); L; L = L->getParentLoop()) {
+      unsigned Trips = TripCounts[L];
+      Weight = SaturatingMul(Weight, Trips ? Trips : 1);
+    }
+    for (Instruction &I : BB) {
+      if (isa<DbgInfoIntrinsic>(I))
+        continue;
+      Stats.Instructions++;
+      uint64_t *Count = nullptr;
+      switch (GetCostKind(I)) {
+      case CostKind::Alu:            Count = &Stats.Alu; break;
+      case CostKind::Transcendental: Count = &Stats.Transcendental; break;
+      case CostKind::Texture:        Count = &Stats.Texture; break;
+      case CostKind::Memory:         Count = &Stats.Memory; break;
+      case CostKind::Other:          Count = &Stats.Other; break;
+      }
+      *Count = SaturatingAdd(*Count, Weight);
+    }
+
+    for (Instruction &I : BB) {
+      AllocaInst *AI = dyn_cast<AllocaInst>(&I);
+      if (AI && AI->getAllocatedType()->isArrayTy() &&
+          HasDynamicIndexInFunction(AI, &F)) {
+        Stats.IndexableArrays++;
+        Stats.IndexableArrayScalars +=
+            GetFlattenedScalarCount(AI->getAllocatedType());
+      }
+    }
+  }
+
+  DxilLiveValues LiveValues;
+  LiveValues.compute(F);
+  Stats.PeakLiveScalars = LiveValues.getPeakLiveScalars();
+
+  Module &M = *F.getParent();
+  const DataLayout &DL = M.getDataLayout();
+  for (GlobalVariable &GV : M.globals()) {
+    Type *Ty = GV.getType()->getElementType();
+    if (GV.getType()->getAddressSpace() == DXIL::kTGSMAddrSpace) {
+      if (IsUsedInFunction(&GV, &F))
+        Stats.GroupSharedBytes += DL.getTypeAllocSize(Ty);
+    } else if (dxilutil::IsStaticGlobal(&GV) && Ty->isArrayTy() &&
+               HasDynamicIndexInFunction(&GV, &F)) {
+      Stats.IndexableArrays++;
+      Stats.IndexableArrayScalars += GetFlattenedScalarCount(Ty);
+    }
+  }
+  return Stats;
+}
+
+void WriteJsonString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char c : Str) {
+    if (c == '"' || c == '\\')
+      OS << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      OS << format("\\u%04x", (unsigned)c);
+    else
+      OS << c;
+  }
+  OS << '"';
+}
+
+void WriteEntryStatistics(raw_ostream &OS, StringRef Name,
+                          const EntryStatistics &S) {
+  OS << "    {\"name\": ";
+  WriteJsonString(OS, Name);
+  OS << ", \"alu\": " << S.Alu
+     << ", \"transcendental\": " << S.Transcendental
+     << ", \"texture\": " << S.Texture
+     << ", \"memory\": " << S.Memory
+     << ", \"other\": " << S.Other
+     << ", \"instructions\": " << S.Instructions
+     << ", \"loops\": " << S.Loops
+     << ", \"unknownTripLoops\": " << S.UnknownTripLoops
+     << ", \"peakLiveScalars\": " << S.PeakLiveScalars
+     << ", \"groupsharedBytes\": " << S.GroupSharedBytes
+     << ", \"indexableArrays\": " << S.IndexableArrays
+     << ", \"indexableArrayScalars\": " << S.IndexableArrayScalars << '}';
+}
+
+} // namespace
+
+namespace hlsl {
+
+void WriteShaderStatistics(Module &M, raw_ostream &OS) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  std::vector<Function *> Entries;
+  if (DM.GetShaderModel()->IsLib()) {
+    for (Function &F : M) {
+      if (!F.isDeclaration() && !F.hasLocalLinkage())
+        Entries.push_back(&F);
+    }
+  } else {
+    if (Function *F = DM.GetEntryFunction())
+      Entries.push_back(F);
+    if (DM.GetShaderModel()->IsHS()) {
+      if (Function *F = DM.GetPatchConstantFunction())
+        Entries.push_back(F);
+    }
+  }
+
+  OS << "{\n  \"version\": 1,\n  \"shaderModel\": ";
+  WriteJsonString(OS, DM.GetShaderModel()->GetName());
+  OS << ",\n  \"entries\": [";
+  bool first = true;
+  for (Function *F : Entries) {
+    OS << (first ? "\n" : ",\n");
+    first = false;
+    WriteEntryStatistics(OS, F->getName(), ComputeStatistics(*F));
+  }
+  OS << "\n  ]\n}\n";
+}
+
+} // namespace hlsl
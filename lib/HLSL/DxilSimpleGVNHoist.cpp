@@ -21,6 +21,8 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/CFG.h"
 
+#include <algorithm>
+
 using namespace llvm;
 using namespace hlsl;
 
@@ -245,39 +247,43 @@ void ValueTable::add(Value *V, uint32_t num) {
     valueNumbering.insert(std::make_pair(V, num));
 }
 
-uint32_t ValueTable::lookupOrAddCall(CallInst *C) {
+// Returns true if calls to the same function with the same operands compute
+// the same value, wherever they are.
+bool IsSafeToNumberCall(CallInst *C) {
   Function *F = C->getCalledFunction();
-  bool bSafe = false;
-  if (F->hasFnAttribute(Attribute::ReadNone)) {
-    bSafe = true;
-  } else if (F->hasFnAttribute(Attribute::ReadOnly)) {
-    if (hlsl::OP::IsDxilOpFunc(F)) {
-      DXIL::OpCode Opcode = hlsl::OP::GetDxilOpFuncCallInst(C);
-      switch (Opcode) {
-      default:
-        break;
-        // TODO: make buffer/texture load on srv safe.
-      case DXIL::OpCode::CreateHandleForLib:
-      case DXIL::OpCode::CBufferLoad:
-      case DXIL::OpCode::CBufferLoadLegacy:
-      case DXIL::OpCode::Sample:
-      case DXIL::OpCode::SampleBias:
-      case DXIL::OpCode::SampleCmp:
-      case DXIL::OpCode::SampleCmpLevelZero:
-      case DXIL::OpCode::SampleGrad:
-      case DXIL::OpCode::CheckAccessFullyMapped:
-      case DXIL::OpCode::GetDimensions:
-      case DXIL::OpCode::TextureGather:
-      case DXIL::OpCode::TextureGatherCmp:
-      case DXIL::OpCode::Texture2DMSGetSamplePosition:
-      case DXIL::OpCode::RenderTargetGetSampleCount:
-      case DXIL::OpCode::RenderTargetGetSamplePosition:
-      case DXIL::OpCode::CalculateLOD:
-        bSafe = true;
-        break;
-      }
-    }
+  if (!F)
+    return false;
+  if (F->hasFnAttribute(Attribute::ReadNone))
+    return true;
+  if (!F->hasFnAttribute(Attribute::ReadOnly) || !hlsl::OP::IsDxilOpFunc(F))
+    return false;
+  DXIL::OpCode Opcode = hlsl::OP::GetDxilOpFuncCallInst(C);
+  switch (Opcode) {
+  default:
+    return false;
+    // TODO: make buffer/texture load on srv safe.
+  case DXIL::OpCode::CreateHandleForLib:
+  case DXIL::OpCode::CBufferLoad:
+  case DXIL::OpCode::CBufferLoadLegacy:
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::CheckAccessFullyMapped:
+  case DXIL::OpCode::GetDimensions:
+  case DXIL::OpCode::TextureGather:
+  case DXIL::OpCode::TextureGatherCmp:
+  case DXIL::OpCode::Texture2DMSGetSamplePosition:
+  case DXIL::OpCode::RenderTargetGetSampleCount:
+  case DXIL::OpCode::RenderTargetGetSamplePosition:
+  case DXIL::OpCode::CalculateLOD:
+    return true;
   }
+}
+
+uint32_t ValueTable::lookupOrAddCall(CallInst *C) {
+  bool bSafe = IsSafeToNumberCall(C);
   if (bSafe) {
     Expression exp = createExpr(C);
     uint32_t e = assignExpNewValueNum(exp).first;
@@ -440,6 +446,23 @@ namespace {
 //  else
 //    r = tex.Sample(ss, uv) + 3;
 // }
+//
+// Instructions found in every arm of a branch or switch are hoisted to the
+// block that branches. Blocks are visited in post order, so what nested
+// regions hoist into the head of an arm can be hoisted again from there.
+//
+// Then common tails are sunk into merge blocks:
+// if (a.x > 0)
+//   r = tex.Sample(ss, uv * 2);
+// else
+//   r = tex.Sample(ss, uv + 1);
+// keeps one Sample after the merge, with its coordinates merged by phis.
+//
+// Both only move an instruction to a block that runs whenever the arms did
+// and at the same loop level, so operations with implicit derivatives run
+// with at least the lanes of their quad they had before. This never makes a
+// derivative less defined, and removes texture operations from divergent
+// code.
 class DxilSimpleGVNHoist : public FunctionPass {
 
 public:
@@ -453,40 +476,36 @@ public:
   bool runOnFunction(Function &F) override;
 
 private:
-  bool tryToHoist(BasicBlock *BB, BasicBlock *Succ0, BasicBlock *Succ1);
+  bool tryToHoist(BasicBlock *BB, ArrayRef<BasicBlock *> Succs);
+  bool tryToSink(BasicBlock *BB,
+                 const DenseMap<BasicBlock *, unsigned> &PONumber);
 };
 
 char DxilSimpleGVNHoist::ID = 0;
 
-bool HasOnePred(BasicBlock *BB) {
-  if (pred_empty(BB))
-    return false;
-
-  auto pred = pred_begin(BB);
-  pred++;
-  if (pred != pred_end(BB))
-    return false;
-  return true;
-}
-
-bool DxilSimpleGVNHoist::tryToHoist(BasicBlock *BB, BasicBlock *Succ0,
-                                    BasicBlock *Succ1) {
-  // ValueNumber Succ0 and Succ1.
+bool DxilSimpleGVNHoist::tryToHoist(BasicBlock *BB,
+                                    ArrayRef<BasicBlock *> Succs) {
+  // ValueNumber all successors. Only value numbers found in every successor
+  // are candidates.
   ValueTable VT;
   DenseMap<uint32_t, SmallVector<Instruction *, 2>> VNtoInsts;
-  for (Instruction &I : *Succ0) {
-    uint32_t V = VT.lookupOrAdd(&I);
-    VNtoInsts[V].emplace_back(&I);
-  }
+  DenseMap<uint32_t, unsigned> VNtoSuccCount;
 
   std::vector<uint32_t> HoistCandidateVN;
 
-  for (Instruction &I : *Succ1) {
-    uint32_t V = VT.lookupOrAdd(&I);
-    if (!VNtoInsts.count(V))
-      continue;
-    VNtoInsts[V].emplace_back(&I);
-    HoistCandidateVN.emplace_back(V);
+  for (unsigned i = 0; i < Succs.size(); i++) {
+    bool bLastSucc = i + 1 == Succs.size();
+    for (Instruction &I : *Succs[i]) {
+      uint32_t V = VT.lookupOrAdd(&I);
+      unsigned &SuccCount = VNtoSuccCount[V];
+      // Missing from an earlier successor.
+      if (SuccCount < i)
+        continue;
+      SuccCount = i + 1;
+      VNtoInsts[V].emplace_back(&I);
+      if (bLastSucc)
+        HoistCandidateVN.emplace_back(V);
+    }
   }
 
   if (HoistCandidateVN.empty()) {
@@ -505,42 +524,34 @@ bool DxilSimpleGVNHoist::tryToHoist(BasicBlock *BB, BasicBlock *Succ0,
     auto &Insts = VNtoInsts[VN];
     if (Insts.size() == 1)
       continue;
-    bool bHoist = false;
-    for (Instruction *I : Insts) {
-      if (I->getParent() == Succ1) {
-        bHoist = true;
-        break;
-      }
-    }
 
+    // Operands are the same once the operands they depend on were hoisted,
+    // since the copies in later arms were replaced with the hoisted one.
     Instruction *FirstI = Insts.front();
-    if (bHoist) {
-      // When operand is different, need to hoist operand.
-      auto it = Insts.begin();
-      it++;
-      bool bHasDifferentOperand = false;
-      unsigned NumOps = FirstI->getNumOperands();
-      for (; it != Insts.end(); it++) {
-        Instruction *I = *it;
-        assert(NumOps == I->getNumOperands());
-        for (unsigned i = 0; i < NumOps; i++) {
-          if (FirstI->getOperand(i) != I->getOperand(i)) {
-            bHasDifferentOperand = true;
-            break;
-          }
-        }
-        if (bHasDifferentOperand)
+    auto it = Insts.begin();
+    it++;
+    bool bHasDifferentOperand = false;
+    unsigned NumOps = FirstI->getNumOperands();
+    for (; it != Insts.end(); it++) {
+      Instruction *I = *it;
+      assert(NumOps == I->getNumOperands());
+      for (unsigned i = 0; i < NumOps; i++) {
+        if (FirstI->getOperand(i) != I->getOperand(i)) {
+          bHasDifferentOperand = true;
           break;
+        }
       }
-      // TODO: hoist operands.
       if (bHasDifferentOperand)
-        continue;
-      // Move FirstI to BB.
-      FirstI->removeFromParent();
-      FirstI->insertBefore(TI);
+        break;
     }
+    if (bHasDifferentOperand)
+      continue;
+    // Move FirstI to BB.
+    FirstI->removeFromParent();
+    FirstI->insertBefore(TI);
+
     // Replace all insts with same value number with firstI.
-    auto it = Insts.begin();
+    it = Insts.begin();
     it++;
     for (; it != Insts.end(); it++) {
       Instruction *I = *it;
@@ -552,27 +563,274 @@ bool DxilSimpleGVNHoist::tryToHoist(BasicBlock *BB, BasicBlock *Succ0,
   return true;
 }
 
-bool DxilSimpleGVNHoist::runOnFunction(Function &F) {
-  BasicBlock &Entry = F.getEntryBlock();
-  bool bUpdated = false;
-  for (auto it = po_begin(&Entry); it != po_end(&Entry); it++) {
-    BasicBlock *BB = *it;
-    TerminatorInst *TI = BB->getTerminator();
-    if (TI->getNumSuccessors() != 2)
+bool IsSinkableOperation(Instruction *I) {
+  if (isa<BinaryOperator>(I) || isa<CastInst>(I) || isa<CmpInst>(I) ||
+      isa<SelectInst>(I) || isa<ExtractElementInst>(I) ||
+      isa<InsertElementInst>(I) || isa<ExtractValueInst>(I) ||
+      isa<InsertValueInst>(I))
+    return true;
+  if (CallInst *CI = dyn_cast<CallInst>(I))
+    return hlsl::OP::IsDxilOpFuncCallInst(CI) && IsSafeToNumberCall(CI);
+  return false;
+}
+
+// Phis of handles, pointers and aggregates are not valid DXIL.
+bool CanMergeWithPhi(Type *Ty) {
+  if (Ty->isVectorTy())
+    Ty = Ty->getVectorElementType();
+  return Ty->isIntegerTy() || Ty->isFloatingPointTy();
+}
+
+// The same operation at the same distance from the end of each predecessor
+// of a merge block, in the order of the predecessors.
+typedef SmallVector<Instruction *, 4> SinkTuple;
+
+struct SinkCandidates {
+  std::vector<SinkTuple> Tuples;
+  std::vector<bool> Sunk;
+  // Tuple index of each instruction in a tuple.
+  DenseMap<Instruction *, unsigned> TupleOf;
+
+  // Returns the index of the tuple that has Vals at each position, if it
+  // is sunk.
+  bool isSunkTuple(ArrayRef<Value *> Vals, unsigned &Idx) const {
+    Instruction *I = dyn_cast<Instruction>(Vals[0]);
+    if (!I)
+      return false;
+    auto It = TupleOf.find(I);
+    if (It == TupleOf.end() || !Sunk[It->second])
+      return false;
+    Idx = It->second;
+    const SinkTuple &T = Tuples[Idx];
+    for (unsigned j = 0; j < Vals.size(); j++) {
+      if (T[j] != Vals[j])
+        return false;
+    }
+    return true;
+  }
+
+  bool isInSunkTuple(Value *V) const {
+    Instruction *I = dyn_cast<Instruction>(V);
+    if (!I)
+      return false;
+    auto It = TupleOf.find(I);
+    return It != TupleOf.end() && Sunk[It->second];
+  }
+};
+
+void GetOperandValues(const SinkTuple &T, unsigned OpIdx,
+                      SmallVectorImpl<Value *> &Vals) {
+  Vals.clear();
+  for (Instruction *I : T)
+    Vals.emplace_back(I->getOperand(OpIdx));
+}
+
+bool AllSame(ArrayRef<Value *> Vals) {
+  for (Value *V : Vals) {
+    if (V != Vals[0])
+      return false;
+  }
+  return true;
+}
+
+// Returns true if the tuple can move into BB given the other tuples that are
+// sunk: every use is a phi of BB merging exactly this tuple, or an
+// instruction that is sunk too, and operands that differ can be merged.
+bool CanSinkTuple(unsigned Idx, const SinkCandidates &C, BasicBlock *BB,
+                  ArrayRef<BasicBlock *> Preds) {
+  const SinkTuple &T = C.Tuples[Idx];
+  for (Instruction *I : T) {
+    for (User *U : I->users()) {
+      if (PHINode *Phi = dyn_cast<PHINode>(U)) {
+        if (Phi->getParent() != BB)
+          return false;
+        for (unsigned j = 0; j < Preds.size(); j++) {
+          if (Phi->getIncomingValueForBlock(Preds[j]) != T[j])
+            return false;
+        }
+      } else if (!C.isInSunkTuple(U)) {
+        return false;
+      }
+    }
+  }
+
+  SmallVector<Value *, 4> Vals;
+  for (unsigned i = 0; i < T[0]->getNumOperands(); i++) {
+    GetOperandValues(T, i, Vals);
+    unsigned OpTuple;
+    if (AllSame(Vals) || C.isSunkTuple(Vals, OpTuple))
       continue;
-    BasicBlock *Succ0 = TI->getSuccessor(0);
-    BasicBlock *Succ1 = TI->getSuccessor(1);
-    if (BB == Succ0)
+    // A phi is needed, so the values have to stay in the predecessors.
+    bool bAllConstant = true;
+    for (Value *V : Vals) {
+      if (C.isInSunkTuple(V))
+        return false;
+      bAllConstant &= isa<Constant>(V);
+    }
+    if (!CanMergeWithPhi(Vals[0]->getType()))
+      return false;
+    // DXIL operations take immediate arguments, like the opcode and texel
+    // offsets, which cannot be phis.
+    if (isa<CallInst>(T[0]) && bAllConstant)
+      return false;
+  }
+  return true;
+}
+
+PHINode *GetOrCreateMergePhi(BasicBlock *BB, ArrayRef<BasicBlock *> Preds,
+                             ArrayRef<Value *> Vals) {
+  for (Instruction &I : *BB) {
+    PHINode *Phi = dyn_cast<PHINode>(&I);
+    if (!Phi)
+      break;
+    if (Phi->getType() != Vals[0]->getType())
       continue;
-    if (BB == Succ1)
+    bool bMatch = true;
+    for (unsigned j = 0; j < Preds.size() && bMatch; j++)
+      bMatch = Phi->getIncomingValueForBlock(Preds[j]) == Vals[j];
+    if (bMatch)
+      return Phi;
+  }
+  PHINode *Phi = PHINode::Create(Vals[0]->getType(), Preds.size(),
+                                 Vals[0]->getName(), &BB->front());
+  for (unsigned j = 0; j < Preds.size(); j++)
+    Phi->addIncoming(Vals[j], Preds[j]);
+  return Phi;
+}
+
+bool DxilSimpleGVNHoist::tryToSink(
+    BasicBlock *BB, const DenseMap<BasicBlock *, unsigned> &PONumber) {
+  unsigned BBNumber = PONumber.lookup(BB);
+  SmallVector<BasicBlock *, 4> Preds;
+  for (BasicBlock *Pred : predecessors(BB)) {
+    // A predecessor before BB in post order reaches it with a back edge, so
+    // BB would be a loop header.
+    auto It = PONumber.find(Pred);
+    if (It == PONumber.end() || It->second <= BBNumber)
+      return false;
+    if (Pred->getTerminator()->getNumSuccessors() != 1)
+      return false;
+    Preds.emplace_back(Pred);
+  }
+  if (Preds.size() < 2)
+    return false;
+
+  // Walk back from the end of all predecessors together while they do the
+  // same operations.
+  SinkCandidates C;
+  SinkTuple Cursor;
+  for (BasicBlock *Pred : Preds)
+    Cursor.emplace_back(Pred->getTerminator());
+  for (;;) {
+    SinkTuple T;
+    for (Instruction *I : Cursor) {
+      Instruction *Prev = I->getPrevNode();
+      if (!Prev)
+        break;
+      T.emplace_back(Prev);
+    }
+    if (T.size() != Preds.size())
+      break;
+    if (!IsSinkableOperation(T[0]))
+      break;
+    bool bSame = true;
+    for (Instruction *I : T)
+      bSame &= I->isSameOperationAs(T[0]);
+    if (!bSame)
+      break;
+    for (Instruction *I : T)
+      C.TupleOf[I] = C.Tuples.size();
+    C.Tuples.emplace_back(T);
+    Cursor = T;
+  }
+  if (C.Tuples.empty())
+    return false;
+
+  // Drop tuples that cannot move until the rest agree.
+  C.Sunk.assign(C.Tuples.size(), true);
+  bool bChanged = true;
+  while (bChanged) {
+    bChanged = false;
+    for (unsigned Idx = 0; Idx < C.Tuples.size(); Idx++) {
+      if (C.Sunk[Idx] && !CanSinkTuple(Idx, C, BB, Preds)) {
+        C.Sunk[Idx] = false;
+        bChanged = true;
+      }
+    }
+  }
+
+  // Sink in program order, so operands are sunk before their users.
+  bool bUpdated = false;
+  Instruction *InsertPt = BB->getFirstNonPHI();
+  SmallVector<Value *, 4> Vals;
+  for (unsigned Idx = C.Tuples.size(); Idx-- > 0;) {
+    if (!C.Sunk[Idx])
       continue;
+    const SinkTuple &T = C.Tuples[Idx];
+    Instruction *NewI = T[0];
+    for (unsigned i = 0; i < NewI->getNumOperands(); i++) {
+      GetOperandValues(T, i, Vals);
+      unsigned OpTuple;
+      // Operands from a sunk tuple already are the one that was kept.
+      if (AllSame(Vals) || C.isSunkTuple(Vals, OpTuple))
+        continue;
+      NewI->setOperand(i, GetOrCreateMergePhi(BB, Preds, Vals));
+    }
+    NewI->moveBefore(InsertPt);
 
-    if (!HasOnePred(Succ0))
+    SmallVector<PHINode *, 2> MergedPhis;
+    for (User *U : NewI->users()) {
+      PHINode *Phi = dyn_cast<PHINode>(U);
+      if (Phi && Phi->getParent() == BB)
+        MergedPhis.emplace_back(Phi);
+    }
+    for (PHINode *Phi : MergedPhis) {
+      Phi->replaceAllUsesWith(NewI);
+      Phi->eraseFromParent();
+    }
+    // What is left uses the others in tuples that are sunk later, which are
+    // erased then.
+    for (unsigned j = 1; j < T.size(); j++) {
+      T[j]->replaceAllUsesWith(NewI);
+      T[j]->eraseFromParent();
+    }
+    bUpdated = true;
+  }
+  return bUpdated;
+}
+
+bool DxilSimpleGVNHoist::runOnFunction(Function &F) {
+  BasicBlock &Entry = F.getEntryBlock();
+  bool bUpdated = false;
+  std::vector<BasicBlock *> PostOrder(po_begin(&Entry), po_end(&Entry));
+  for (BasicBlock *BB : PostOrder) {
+    TerminatorInst *TI = BB->getTerminator();
+    if (TI->getNumSuccessors() < 2)
       continue;
-    if (!HasOnePred(Succ1))
+    // Every arm is only reached from BB. A switch may reach an arm from
+    // several cases.
+    SmallVector<BasicBlock *, 4> Succs;
+    bool bSimpleArms = true;
+    for (BasicBlock *Succ : successors(BB)) {
+      if (Succ == BB || Succ->getUniquePredecessor() != BB) {
+        bSimpleArms = false;
+        break;
+      }
+      if (std::find(Succs.begin(), Succs.end(), Succ) == Succs.end())
+        Succs.emplace_back(Succ);
+    }
+    if (!bSimpleArms || Succs.size() < 2)
       continue;
-    bUpdated |= tryToHoist(BB, Succ0, Succ1);
+    bUpdated |= tryToHoist(BB, Succs);
   }
+
+  // Sink in reverse post order, so tails sunk into an inner merge block can
+  // be sunk again into the merge block after it.
+  DenseMap<BasicBlock *, unsigned> PONumber;
+  for (unsigned i = 0; i < PostOrder.size(); i++)
+    PONumber[PostOrder[i]] = i;
+  for (auto it = PostOrder.rbegin(); it != PostOrder.rend(); it++)
+    bUpdated |= tryToSink(*it, PONumber);
   return bUpdated;
 }
 
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilUniformValues.cpp                                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Finds the values of a function that are the same in every thread.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DxilUniformValues.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+// Whether a call to a DXIL operation returns the same value for the same
+// uniform arguments in every thread, and can run where it was not called.
+bool IsUniformOperation(CallInst *CI) {
+  if (!OP::IsDxilOpFuncCallInst(CI))
+    return false;
+  DXIL::OpCode Opcode = OP::GetDxilOpFuncCallInst(CI);
+  switch (Opcode) {
+  // Derivatives share the Unary class, but read other lanes.
+  case DXIL::OpCode::DerivCoarseX:
+  case DXIL::OpCode::DerivCoarseY:
+  case DXIL::OpCode::DerivFineX:
+  case DXIL::OpCode::DerivFineY:
+    return false;
+  default:
+    break;
+  }
+  // Many system values are also read with operations that access no
+  // memory, so those are not enough; only math on the arguments is taken.
+  switch (OP::GetOpCodeClass(Opcode)) {
+  case DXIL::OpCodeClass::CBufferLoad:
+  case DXIL::OpCodeClass::CBufferLoadLegacy:
+  case DXIL::OpCodeClass::CreateHandle:
+  case DXIL::OpCodeClass::CreateHandleForLib:
+  case DXIL::OpCodeClass::CreateHandleFromHeap:
+  case DXIL::OpCodeClass::AnnotateHandle:
+  case DXIL::OpCodeClass::GroupId:
+  case DXIL::OpCodeClass::Unary:
+  case DXIL::OpCodeClass::UnaryBits:
+  case DXIL::OpCodeClass::IsSpecialFloat:
+  case DXIL::OpCodeClass::Binary:
+  case DXIL::OpCodeClass::BinaryWithCarryOrBorrow:
+  case DXIL::OpCodeClass::BinaryWithTwoOuts:
+  case DXIL::OpCodeClass::Tertiary:
+  case DXIL::OpCodeClass::Quaternary:
+  case DXIL::OpCodeClass::Dot2:
+  case DXIL::OpCodeClass::Dot3:
+  case DXIL::OpCodeClass::Dot4:
+  case DXIL::OpCodeClass::Dot2AddHalf:
+  case DXIL::OpCodeClass::Dot4AddPacked:
+  case DXIL::OpCodeClass::LegacyF16ToF32:
+  case DXIL::OpCodeClass::LegacyF32ToF16:
+  case DXIL::OpCodeClass::LegacyDoubleToFloat:
+  case DXIL::OpCodeClass::LegacyDoubleToSInt32:
+  case DXIL::OpCodeClass::LegacyDoubleToUInt32:
+  case DXIL::OpCodeClass::MakeDouble:
+  case DXIL::OpCodeClass::SplitDouble:
+  case DXIL::OpCodeClass::BitcastF16toI16:
+  case DXIL::OpCodeClass::BitcastF32toI32:
+  case DXIL::OpCodeClass::BitcastF64toI64:
+  case DXIL::OpCodeClass::BitcastI16toF16:
+  case DXIL::OpCodeClass::BitcastI32toF32:
+  case DXIL::OpCodeClass::BitcastI64toF64:
+    return true;
+  default:
+    return false;
+  }
+}
+} // namespace
+
+bool DxilUniformValues::IsUniform(Value *V) const {
+  if (isa<Constant>(V))
+    return true;
+  Instruction *I = dyn_cast<Instruction>(V);
+  return I && m_Uniform.count(I);
+}
+
+void DxilUniformValues::Compute(ArrayRef<BasicBlock *> RPO) {
+  m_Uniform.clear();
+  // Operands other than those of phis are seen before their users in reverse
+  // post order.
+  for (BasicBlock *BB : RPO) {
+    for (Instruction &I : *BB) {
+      if (isa<PHINode>(I) || isa<TerminatorInst>(I) || isa<AllocaInst>(I) ||
+          isa<StoreInst>(I))
+        continue;
+      if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+        if (!IsUniformOperation(CI))
+          continue;
+      } else if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
+        // Only constant globals and resources are the same in every thread.
+        GlobalVariable *GV = dyn_cast<GlobalVariable>(
+            GetUnderlyingObject(LI->getPointerOperand(),
+                                BB->getModule()->getDataLayout()));
+        if (!GV || !(GV->isConstant() ||
+                     dxilutil::IsHLSLObjectType(GV->getType()->getElementType())))
+          continue;
+      } else if (I.mayReadOrWriteMemory()) {
+        // Atomics return what other threads left behind.
+        continue;
+      }
+      bool bUniform = true;
+      for (Value *Op : I.operands()) {
+        if (!IsUniform(Op) && !isa<Function>(Op)) {
+          bUniform = false;
+          break;
+        }
+      }
+      if (bUniform)
+        m_Uniform.insert(&I);
+    }
+  }
+}
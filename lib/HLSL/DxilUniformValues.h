@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilUniformValues.h                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Finds the values of a function that are the same in every thread.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+namespace llvm {
+class BasicBlock;
+class Instruction;
+class Value;
+}
+
+namespace hlsl {
+
+/// A value is uniform when every thread of a dispatch, or of a thread group,
+/// computes the same one: literals, constant buffers, resource handles and
+/// group IDs, and what is computed from only those. Phis take the value of
+/// the path each thread came by, so they are never uniform, and no control
+/// dependence is needed to stay conservative.
+class DxilUniformValues {
+public:
+  /// Finds the uniform values of the blocks in RPO, which must be the blocks
+  /// of one function in reverse post order.
+  void Compute(llvm::ArrayRef<llvm::BasicBlock *> RPO);
+  bool IsUniform(llvm::Value *V) const;
+
+private:
+  llvm::SmallPtrSet<llvm::Instruction *, 32> m_Uniform;
+};
+
+} // namespace hlsl
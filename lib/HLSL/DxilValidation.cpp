@@ -38,12 +38,15 @@
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include <unordered_set>
 #include "llvm/Analysis/LoopInfo.h"
@@ -53,8 +56,12 @@
 #include "dxc/HLSL/DxilSignatureAllocator.h"
 #include "dxc/HLSL/DxilPackSignatureElement.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
+#include "dxc/Support/DxcCompileDeadline.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include <algorithm>
+#include <atomic>
 #include <deque>
+#include <exception>
 
 using namespace llvm;
 using namespace std;
@@ -396,6 +403,9 @@ struct EntryStatus {
 
 struct ValidationContext {
   bool Failed = false;
+  unsigned ErrorCount = 0;
+  unsigned MaxErrors;
+  std::vector<ValidationError> *pErrors;
   Module &M;
   Module *pDebugModule;
   DxilModule &DxilMod;
@@ -421,8 +431,10 @@ struct ValidationContext {
 
   ValidationContext(Module &llvmModule, Module *DebugModule,
                     DxilModule &dxilModule,
-                    DiagnosticPrinterRawOStream &DiagPrn)
-      : M(llvmModule), pDebugModule(DebugModule), DxilMod(dxilModule),
+                    DiagnosticPrinterRawOStream &DiagPrn,
+                    const ValidationOptions &Options = ValidationOptions())
+      : MaxErrors(Options.MaxErrors), pErrors(Options.pErrors),
+        M(llvmModule), pDebugModule(DebugModule), DxilMod(dxilModule),
         DL(llvmModule.getDataLayout()), DiagPrinter(DiagPrn),
         LastRuleEmit((ValidationRule)-1),
         kDxilControlFlowHintMDKind(llvmModule.getContext().getMDKindID(
@@ -470,6 +482,31 @@ struct ValidationContext {
     }
   }
 
+  // Creates a context for validating function bodies on another thread. The
+  // resource maps are copied from Parent and diagnostics go to DiagPrn (or
+  // WorkerErrors, if Parent records errors), so nothing mutable is shared;
+  // entry status is not available.
+  ValidationContext(const ValidationContext &Parent,
+                    DiagnosticPrinterRawOStream &DiagPrn,
+                    std::vector<ValidationError> &WorkerErrors)
+      : MaxErrors(Parent.MaxErrors),
+        pErrors(Parent.pErrors ? &WorkerErrors : nullptr),
+        M(Parent.M), pDebugModule(Parent.pDebugModule),
+        DxilMod(Parent.DxilMod), DL(Parent.DL), DiagPrinter(DiagPrn),
+        LastRuleEmit((ValidationRule)-1),
+        entryFuncCallSet(Parent.entryFuncCallSet),
+        patchConstFuncCallSet(Parent.patchConstFuncCallSet),
+        HandleResIndexMap(Parent.HandleResIndexMap),
+        ResPropMap(Parent.ResPropMap),
+        PatchConstantFuncMap(Parent.PatchConstantFuncMap),
+        isLibProfile(Parent.isLibProfile),
+        kDxilControlFlowHintMDKind(Parent.kDxilControlFlowHintMDKind),
+        kDxilPreciseMDKind(Parent.kDxilPreciseMDKind),
+        kDxilNonUniformMDKind(Parent.kDxilNonUniformMDKind),
+        kLLVMLoopMDKind(Parent.kLLVMLoopMDKind),
+        m_DxilMajor(Parent.m_DxilMajor), m_DxilMinor(Parent.m_DxilMinor),
+        slotTracker(&Parent.M, true) {}
+
   void PropagateResMap(Value *V, DxilResourceBase *Res) {
     auto it = ResPropMap.find(V);
     if (it != ResPropMap.end()) {
@@ -656,12 +693,53 @@ struct ValidationContext {
     return p->DiagStream();
   }
 
+  bool ErrorLimitReached() const {
+    return MaxErrors != 0 && ErrorCount >= MaxErrors;
+  }
+
+  // Counts an error against the limit and, when errors are recorded rather
+  // than printed, records it. Returns true if the caller should print it.
+  bool BeginError(ValidationRule rule, Instruction *I = nullptr) {
+    if (ErrorLimitReached())
+      return false;
+    ++ErrorCount;
+    Failed = true;
+    if (pErrors) {
+      RecordError(rule, I);
+      return false;
+    }
+    return true;
+  }
+
+  void RecordError(ValidationRule rule, Instruction *I) {
+    ValidationError Error;
+    Error.Rule = rule;
+    if (I) {
+      Function *F = I->getParent()->getParent();
+      Error.Function = F->getName();
+      unsigned Index = 0;
+      for (inst_iterator it = inst_begin(F), E = inst_end(F); it != E; ++it) {
+        if (&*it == I)
+          break;
+        ++Index;
+      }
+      Error.InstructionIndex = Index;
+      if (DILocation *Loc = GetDebugLoc(I)) {
+        Error.File = Loc->getFilename();
+        Error.Line = Loc->getLine();
+        Error.Column = Loc->getColumn();
+      }
+    }
+    pErrors->emplace_back(std::move(Error));
+  }
+
   void EmitGlobalValueError(GlobalValue *GV, ValidationRule rule) {
     EmitFormatError(rule, { GV->getName() });
   }
 
   // This is the least desirable mechanism, as it has no context.
   void EmitError(ValidationRule rule) {
+    if (!BeginError(rule)) return;
     DiagPrinter << GetValidationRuleText(rule) << '\n';
     Failed = true;
   }
@@ -692,6 +770,7 @@ struct ValidationContext {
   }
 
   void EmitFormatError(ValidationRule rule, ArrayRef<StringRef> args) {
+    if (!BeginError(rule)) return;
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
     DiagPrinter << ruleText << '\n';
@@ -699,6 +778,7 @@ struct ValidationContext {
   }
 
   void EmitMetaError(Metadata *Meta, ValidationRule rule) {
+    if (!BeginError(rule)) return;
     DiagPrinter << GetValidationRuleText(rule);
     Meta->print(DiagStream(), &M);
     DiagPrinter << '\n';
@@ -706,6 +786,7 @@ struct ValidationContext {
   }
 
   void EmitResourceError(const hlsl::DxilResourceBase *Res, ValidationRule rule) {
+    if (!BeginError(rule)) return;
     DiagPrinter << GetValidationRuleText(rule);
     DiagPrinter << '\'' << Res->GetGlobalName() << '\'';
     DiagPrinter << '\n';
@@ -715,6 +796,7 @@ struct ValidationContext {
   void EmitResourceFormatError(const hlsl::DxilResourceBase *Res,
                                ValidationRule rule,
                                ArrayRef<StringRef> args) {
+    if (!BeginError(rule)) return;
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
     DiagPrinter << ruleText;
@@ -761,6 +843,8 @@ struct ValidationContext {
       LastRuleEmit = Rule;
       LastDebugLocEmit = L;
     }
+    if (!BeginError(Rule, I))
+      return false;
 
     // Print the error header matched by IDE regexes
     DiagPrinter << "error: ";
@@ -3248,6 +3332,8 @@ static void ValidateFunctionBody(Function *F, ValidationContext &ValCtx) {
   CallInst *getMeshPayload = nullptr;
   CallInst *dispatchMesh = nullptr;
   for (auto b = F->begin(), bend = F->end(); b != bend; ++b) {
+    if (ValCtx.ErrorLimitReached())
+      return;
     for (auto i = b->begin(), iend = b->end(); i != iend; ++i) {
       llvm::Instruction &I = *i;
 
@@ -3643,6 +3729,126 @@ static void ValidateFunction(Function &F, ValidationContext &ValCtx) {
   }
 }
 
+// Modules with fewer defined functions than this are validated serially.
+static const unsigned kParallelValidationMinFunctions = 64;
+
+// Does the lazy work that LLVM would otherwise do on first use of a type or
+// function, so that threads validating different functions only read them.
+static void PrepareForParallelValidation(Module &M, const DataLayout &DL) {
+  TypeFinder Types;
+  Types.run(M, /*onlyNamed*/ false);
+  for (StructType *ST : Types) {
+    // isSized caches its answer on the type; getStructLayout caches the
+    // layout on the data layout.
+    if (!ST->isOpaque() && ST->isSized())
+      DL.getStructLayout(ST);
+  }
+  for (Function &F : M.functions()) {
+    // Builds lazy arguments.
+    (void)F.arg_begin();
+  }
+}
+
+static void ValidateFunctions(ValidationContext &ValCtx) {
+  std::vector<Function *> Definitions;
+  for (Function &F : ValCtx.M.functions()) {
+    if (!F.isDeclaration())
+      Definitions.push_back(&F);
+  }
+
+  // An error limit keeps validation serial, since the errors kept must be
+  // the first ones in module order.
+  unsigned ThreadCount = DxcThreadPool::GetDefaultThreadCount();
+  if (Definitions.size() < kParallelValidationMinFunctions || ThreadCount < 2 ||
+      ValCtx.MaxErrors != 0) {
+    for (Function &F : ValCtx.M.functions()) {
+      if (ValCtx.ErrorLimitReached())
+        return;
+      CheckCompileDeadline();
+      ValidateFunction(F, ValCtx);
+    }
+    return;
+  }
+
+  // Declarations are validated through their call sites, which update the
+  // entry status and counter state shared by all functions, so they stay
+  // serial. They have no bodies, so this is cheap.
+  for (Function &F : ValCtx.M.functions()) {
+    if (F.isDeclaration())
+      ValidateFunction(F, ValCtx);
+  }
+
+  PrepareForParallelValidation(ValCtx.M, ValCtx.DL);
+
+  // Each definition gets its own diagnostics, appended below in module order
+  // so the output does not depend on scheduling.
+  struct FunctionDiagnostics {
+    std::string Text;
+    std::vector<ValidationError> Errors;
+    unsigned ErrorCount = 0;
+    bool Failed = false;
+  };
+  std::vector<FunctionDiagnostics> Results(Definitions.size());
+  std::atomic<unsigned> NextFunction(0);
+  std::exception_ptr FirstException;
+  sys::Mutex ExceptionLock;
+
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  const DxcCompileDeadline *pDeadline = DxcCompileDeadline::GetCurrent();
+  if (ThreadCount > Definitions.size())
+    ThreadCount = Definitions.size();
+  {
+    DxcThreadPool Pool(ThreadCount);
+    for (unsigned t = 0; t < ThreadCount; ++t) {
+      Pool.Async([&]() {
+        DxcThreadMalloc TM(pMalloc);
+        DxcCompileDeadline Deadline(pDeadline);
+        try {
+          std::string DiagStr;
+          raw_string_ostream DiagStream(DiagStr);
+          DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+          std::vector<ValidationError> WorkerErrors;
+          ValidationContext WorkerCtx(ValCtx, DiagPrinter, WorkerErrors);
+          for (unsigned i = NextFunction++; i < Definitions.size();
+               i = NextFunction++) {
+            // Redundant diagnostics are only suppressed within a function.
+            WorkerCtx.Failed = false;
+            WorkerCtx.ErrorCount = 0;
+            WorkerCtx.LastRuleEmit = (ValidationRule)-1;
+            WorkerCtx.LastDebugLocEmit = DebugLoc();
+            CheckCompileDeadline();
+            ValidateFunction(*Definitions[i], WorkerCtx);
+            DiagStream.flush();
+            Results[i].Text.swap(DiagStr);
+            DiagStr.clear();
+            Results[i].Errors.swap(WorkerErrors);
+            WorkerErrors.clear();
+            Results[i].ErrorCount = WorkerCtx.ErrorCount;
+            Results[i].Failed = WorkerCtx.Failed;
+          }
+        } catch (...) {
+          sys::ScopedLock L(ExceptionLock);
+          if (!FirstException)
+            FirstException = std::current_exception();
+          NextFunction = Definitions.size();
+        }
+      });
+    }
+  }
+  if (FirstException)
+    std::rethrow_exception(FirstException);
+
+  for (FunctionDiagnostics &Result : Results) {
+    ValCtx.DiagStream() << Result.Text;
+    if (ValCtx.pErrors) {
+      for (ValidationError &Error : Result.Errors)
+        ValCtx.pErrors->emplace_back(std::move(Error));
+    }
+    ValCtx.ErrorCount += Result.ErrorCount;
+    ValCtx.Failed |= Result.Failed;
+  }
+}
+
 static void ValidateGlobalVariable(GlobalVariable &GV,
                                    ValidationContext &ValCtx) {
   bool isInternalGV =
@@ -5606,8 +5812,41 @@ void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor) {
   // VALRULE-TEXT:END
 }
 
+static LLVM_THREAD_LOCAL ValidationObserver *TheValidationObserver = nullptr;
+
+ValidationObserver *SetThreadValidationObserver(ValidationObserver *pObserver) {
+  ValidationObserver *pPrior = TheValidationObserver;
+  TheValidationObserver = pObserver;
+  return pPrior;
+}
+
+namespace {
+// Notifies the thread's observer, if any, around one group of rules.
+class RuleGroupNotification {
+  ValidationObserver *m_pObserver;
+  const char *m_pName;
+
+public:
+  RuleGroupNotification(const char *pName)
+      : m_pObserver(TheValidationObserver), m_pName(pName) {
+    if (m_pObserver)
+      m_pObserver->beforeRuleGroup(m_pName);
+  }
+  ~RuleGroupNotification() {
+    if (m_pObserver)
+      m_pObserver->afterRuleGroup(m_pName);
+  }
+};
+}
+
 _Use_decl_annotations_ HRESULT
 ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
+  return ValidateDxilModule(pModule, pDebugModule, ValidationOptions());
+}
+
+_Use_decl_annotations_ HRESULT
+ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule,
+                   const ValidationOptions &Options) {
   std::string diagStr;
   raw_string_ostream diagStream(diagStr);
   DiagnosticPrinterRawOStream DiagPrinter(diagStream);
@@ -5621,35 +5860,40 @@ ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
     return DXC_E_IR_VERIFICATION_FAILED;
   }
 
-  ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule, DiagPrinter);
-
-  ValidateBitcode(ValCtx);
-
-  ValidateMetadata(ValCtx);
-
-  ValidateShaderState(ValCtx);
-
-  ValidateGlobalVariables(ValCtx);
+  ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule, DiagPrinter,
+                           Options);
 
-  ValidateResources(ValCtx);
-
-  // Validate control flow and collect function call info.
-  // If has recursive call, call info collection will not finish.
-  ValidateFlowControl(ValCtx);
-
-  // Validate functions.
-  for (Function &F : pModule->functions()) {
-    ValidateFunction(F, ValCtx);
+  struct ValidationPhase {
+    const char *Name;
+    void (*Run)(ValidationContext &);
+  };
+  static const ValidationPhase Phases[] = {
+    { "bitcode", ValidateBitcode },
+    { "metadata", ValidateMetadata },
+    { "shader state", ValidateShaderState },
+    { "global variables", ValidateGlobalVariables },
+    { "resources", ValidateResources },
+    // Validate control flow and collect function call info.
+    // If has recursive call, call info collection will not finish.
+    { "flow control", ValidateFlowControl },
+    // Validate functions.
+    { "functions", ValidateFunctions },
+    { "shader flags", ValidateShaderFlags },
+    { "entry signatures", ValidateEntrySignatures },
+    { "uninitialized output", ValidateUninitializedOutput },
+  };
+  for (const ValidationPhase &Phase : Phases) {
+    if (ValCtx.ErrorLimitReached())
+      break;
+    CheckCompileDeadline();
+    RuleGroupNotification Notification(Phase.Name);
+    Phase.Run(ValCtx);
   }
 
-  ValidateShaderFlags(ValCtx);
-
-  ValidateEntrySignatures(ValCtx);
-
-  ValidateUninitializedOutput(ValCtx);
   // Ensure error messages are flushed out on error.
   if (ValCtx.Failed) {
-    emitDxilDiag(pModule->getContext(), diagStream.str().c_str());
+    if (!Options.pErrors)
+      emitDxilDiag(pModule->getContext(), diagStream.str().c_str());
     return DXC_E_IR_VERIFICATION_FAILED;
   }
   return S_OK;
@@ -5776,6 +6020,38 @@ static void VerifyFeatureInfoMatches(_In_ ValidationContext &ValCtx,
 }
 
 
+// Hashes are not recomputed, since they cover debug info that may have been
+// stripped from the module; only the layout and the names are checked.
+static void VerifyFunctionHashes(_In_ ValidationContext &ValCtx,
+                                 _In_reads_bytes_(PartSize) const char *pData,
+                                 _In_ uint32_t PartSize) {
+  const char *PartName = "FHSH";
+  const DxilFunctionHashHeader *pHeader =
+      reinterpret_cast<const DxilFunctionHashHeader *>(pData);
+  if (PartSize < sizeof(DxilFunctionHashHeader) ||
+      (PartSize - sizeof(DxilFunctionHashHeader)) /
+              sizeof(DxilFunctionHashEntry) < pHeader->FunctionCount) {
+    ValCtx.EmitFormatError(ValidationRule::ContainerPartInvalid, { PartName });
+    return;
+  }
+  const DxilFunctionHashEntry *pEntries =
+      reinterpret_cast<const DxilFunctionHashEntry *>(pHeader + 1);
+  for (uint32_t i = 0; i < pHeader->FunctionCount; ++i) {
+    const DxilFunctionHashEntry &Entry = pEntries[i];
+    if (Entry.NameOffset > PartSize ||
+        Entry.NameLength > PartSize - Entry.NameOffset) {
+      ValCtx.EmitFormatError(ValidationRule::ContainerPartInvalid, { PartName });
+      return;
+    }
+    StringRef Name(pData + Entry.NameOffset, Entry.NameLength);
+    Function *F = ValCtx.M.getFunction(Name);
+    if (!F || F->isDeclaration()) {
+      ValCtx.EmitFormatError(ValidationRule::ContainerPartMatches, { PartName });
+      return;
+    }
+  }
+}
+
 static void VerifyRDATMatches(_In_ ValidationContext &ValCtx,
                               _In_reads_bytes_(RDATSize) const void *pRDATData,
                               _In_ uint32_t RDATSize) {
@@ -5840,6 +6116,16 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
                                    llvm::Module *pDebugModule,
                                    const DxilContainerHeader *pContainer,
                                    uint32_t ContainerSize) {
+  return ValidateDxilContainerParts(pModule, pDebugModule, pContainer,
+                                    ContainerSize, ValidationOptions());
+}
+
+_Use_decl_annotations_
+HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
+                                   llvm::Module *pDebugModule,
+                                   const DxilContainerHeader *pContainer,
+                                   uint32_t ContainerSize,
+                                   const ValidationOptions &Options) {
 
   DXASSERT_NOMSG(pModule);
   if (!pContainer || !IsValidDxilContainer(pContainer, ContainerSize)) {
@@ -5854,7 +6140,9 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
   std::string diagStr;
   raw_string_ostream DiagStream(diagStr);
   DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
-  ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule, DiagPrinter);
+  ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule, DiagPrinter,
+                           Options);
+  RuleGroupNotification Notification("container parts");
 
   DXIL::ShaderKind ShaderKind = pDxilModule->GetShaderModel()->GetKind();
   bool bTessOrMesh = ShaderKind == DXIL::ShaderKind::Hull ||
@@ -5928,7 +6216,9 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
     case DFCC_PrivateData:
     case DFCC_DXIL:
     case DFCC_ShaderDebugInfoDXIL:
+    case DFCC_CompressedShaderDebugInfoDXIL:
     case DFCC_ShaderDebugName:
+    case DFCC_LineTable:
       continue;
 
     case DFCC_ShaderHash:
@@ -5937,6 +6227,14 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
       }
       break;
 
+    case DFCC_FunctionHashes:
+      if (ValCtx.isLibProfile) {
+        VerifyFunctionHashes(ValCtx, GetDxilPartData(pPart), pPart->PartSize);
+      } else {
+        ValCtx.EmitFormatError(ValidationRule::ContainerPartInvalid, { szFourCC });
+      }
+      break;
+
     // Runtime Data (RDAT) for libraries
     case DFCC_RuntimeData:
       if (ValCtx.isLibProfile) {
@@ -5979,13 +6277,11 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
     if (pPSVPart) {
       if (pRootSignaturePart) {
         try {
-          RootSignatureHandle RS;
-          RS.LoadSerialized((const uint8_t*)GetDxilPartData(pRootSignaturePart), pRootSignaturePart->PartSize);
-          RS.Deserialize();
-          IFTBOOL(VerifyRootSignatureWithShaderPSV(RS.GetDesc(),
-                                                   pDxilModule->GetShaderModel()->GetKind(),
-                                                   GetDxilPartData(pPSVPart), pPSVPart->PartSize,
-                                                   DiagStream),
+          IFTBOOL(VerifySerializedRootSignatureWithShaderPSV(
+                      GetDxilPartData(pRootSignaturePart), pRootSignaturePart->PartSize,
+                      pDxilModule->GetShaderModel()->GetKind(),
+                      GetDxilPartData(pPSVPart), pPSVPart->PartSize,
+                      DiagStream),
                   DXC_E_INCORRECT_ROOT_SIGNATURE);
         } catch (...) {
           ValCtx.EmitError(ValidationRule::ContainerRootSignatureIncompatible);
@@ -5997,7 +6293,8 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
   }
 
   if (ValCtx.Failed) {
-    emitDxilDiag(pModule->getContext(), DiagStream.str().c_str());
+    if (!Options.pErrors)
+      emitDxilDiag(pModule->getContext(), DiagStream.str().c_str());
     return DXC_E_MALFORMED_CONTAINER;
   }
   return S_OK;
@@ -6068,6 +6365,14 @@ HRESULT ValidateDxilBitcode(
   _In_reads_bytes_(ILLength) const char *pIL,
   _In_ uint32_t ILLength,
   _In_ llvm::raw_ostream &DiagStream) {
+  return ValidateDxilBitcode(pIL, ILLength, DiagStream, ValidationOptions());
+}
+
+HRESULT ValidateDxilBitcode(
+  _In_reads_bytes_(ILLength) const char *pIL,
+  _In_ uint32_t ILLength,
+  _In_ llvm::raw_ostream &DiagStream,
+  const ValidationOptions &Options) {
 
   LLVMContext Ctx;
   std::unique_ptr<llvm::Module> pModule;
@@ -6082,7 +6387,7 @@ HRESULT ValidateDxilBitcode(
                                      /*bLazyLoad*/ false)))
     return hr;
 
-  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr)))
+  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr, Options)))
     return hr;
 
   DxilModule &dxilModule = pModule->GetDxilModule();
@@ -6095,15 +6400,11 @@ HRESULT ValidateDxilBitcode(
     pOutputStream->Reserve(pWriter->size());
     pWriter->write(pOutputStream);
     try {
-      const DxilVersionedRootSignatureDesc* pDesc = nullptr;
-      DeserializeRootSignature(SerializedRootSig.data(), SerializedRootSig.size(), &pDesc);
-      if (!pDesc) {
-        return DXC_E_INCORRECT_ROOT_SIGNATURE;
-      }
-      IFTBOOL(VerifyRootSignatureWithShaderPSV(pDesc,
-                                               dxilModule.GetShaderModel()->GetKind(),
-                                               pOutputStream->GetPtr(), pWriter->size(),
-                                               DiagStream), DXC_E_INCORRECT_ROOT_SIGNATURE);
+      IFTBOOL(VerifySerializedRootSignatureWithShaderPSV(
+                  SerializedRootSig.data(), SerializedRootSig.size(),
+                  dxilModule.GetShaderModel()->GetKind(),
+                  pOutputStream->GetPtr(), pWriter->size(),
+                  DiagStream), DXC_E_INCORRECT_ROOT_SIGNATURE);
     } catch (...) {
       return DXC_E_INCORRECT_ROOT_SIGNATURE;
     }
@@ -6185,6 +6486,15 @@ _Use_decl_annotations_
 HRESULT ValidateDxilContainer(const void *pContainer,
                               uint32_t ContainerSize,
                               llvm::raw_ostream &DiagStream) {
+  return ValidateDxilContainer(pContainer, ContainerSize, DiagStream,
+                               ValidationOptions());
+}
+
+_Use_decl_annotations_
+HRESULT ValidateDxilContainer(const void *pContainer,
+                              uint32_t ContainerSize,
+                              llvm::raw_ostream &DiagStream,
+                              const ValidationOptions &Options) {
   LLVMContext Ctx, DbgCtx;
   std::unique_ptr<llvm::Module> pModule, pDebugModule;
 
@@ -6199,14 +6509,14 @@ HRESULT ValidateDxilContainer(const void *pContainer,
       Ctx, DbgCtx, DiagStream));
 
   // Validate DXIL Module
-  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get()));
+  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get(), Options));
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
     return DXC_E_IR_VERIFICATION_FAILED;
   }
 
   return ValidateDxilContainerParts(pModule.get(), pDebugModule.get(),
-    IsDxilContainerLike(pContainer, ContainerSize), ContainerSize);
+    IsDxilContainerLike(pContainer, ContainerSize), ContainerSize, Options);
 }
 
 } // namespace hlsl
@@ -0,0 +1,386 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilVectorizeBufferAccesses.cpp                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Merges adjacent raw and structured buffer accesses into wider ones.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// Only 32-bit components are merged; a merged access reads or writes at most
+// four of them.
+const int64_t kComponentSize = 4;
+const unsigned kMaxComponents = 4;
+
+// A rawBufferLoad or rawBufferStore, split into what has to match for two
+// accesses to be merged, and the byte offset that places it.
+struct BufferAccess {
+  CallInst *CI;
+  unsigned Order;     // Position in its block.
+  Value *Handle;
+  Value *Base;        // Index of a structured buffer element, or what the
+                      // byte offset of a raw buffer access adds to; null
+                      // when the raw offset is constant.
+  bool bStructured;
+  Function *F;        // Overload.
+  Value *Alignment;
+  int64_t Offset;     // Bytes from Base.
+  unsigned Width;     // Components, from x.
+
+  int64_t End() const { return Offset + Width * kComponentSize; }
+  bool IsMergeableWith(const BufferAccess &Other) const {
+    return Handle == Other.Handle && Base == Other.Base &&
+           bStructured == Other.bStructured && F == Other.F &&
+           Alignment == Other.Alignment;
+  }
+};
+
+class DxilVectorizeBufferAccesses : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilVectorizeBufferAccesses() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL vectorize buffer accesses";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool GetBufferAccess(CallInst *CI, unsigned Order, bool bStore,
+                       BufferAccess &Access);
+  bool MergeLoads(std::vector<BufferAccess> &Loads);
+  bool MergeStores(std::vector<BufferAccess> &Stores);
+  void MergeLoadRun(ArrayRef<BufferAccess> Run);
+  void MergeStoreRun(ArrayRef<BufferAccess> Run);
+
+  const DataLayout *DL = nullptr;
+  DominatorTree *DT = nullptr;
+};
+
+char DxilVectorizeBufferAccesses::ID = 0;
+
+// Operands after the opcode that loads and stores share.
+const unsigned kHandleOpIdx = DxilInst_RawBufferLoad::arg_srv;
+const unsigned kIndexOpIdx = DxilInst_RawBufferLoad::arg_index;
+const unsigned kElementOffsetOpIdx = DxilInst_RawBufferLoad::arg_elementOffset;
+
+bool DxilVectorizeBufferAccesses::GetBufferAccess(CallInst *CI, unsigned Order,
+                                                  bool bStore,
+                                                  BufferAccess &Access) {
+  Type *ETy =
+      bStore ? CI->getArgOperand(DxilInst_RawBufferStore::arg_value0)->getType()
+             : CI->getType()->getStructElementType(0);
+  if (!ETy->isFloatTy() && !ETy->isIntegerTy(32))
+    return false;
+  ConstantInt *Mask = dyn_cast<ConstantInt>(CI->getArgOperand(
+      bStore ? DxilInst_RawBufferStore::arg_mask
+             : DxilInst_RawBufferLoad::arg_mask));
+  if (!Mask)
+    return false;
+  uint64_t MaskVal = Mask->getZExtValue();
+  // Components must start at x and have no gaps.
+  if (MaskVal == 0 || (MaskVal & (MaskVal + 1)) != 0)
+    return false;
+  // The status component of a load cannot be merged.
+  if (!bStore) {
+    for (User *U : CI->users()) {
+      ExtractValueInst *EV = dyn_cast<ExtractValueInst>(U);
+      if (!EV || EV->getNumIndices() != 1 ||
+          *EV->idx_begin() >= kMaxComponents)
+        return false;
+    }
+  }
+
+  Access.CI = CI;
+  Access.Order = Order;
+  Access.Handle = CI->getArgOperand(kHandleOpIdx);
+  Access.F = CI->getCalledFunction();
+  Access.Alignment = CI->getArgOperand(
+      bStore ? DxilInst_RawBufferStore::arg_alignment
+             : DxilInst_RawBufferLoad::arg_alignment);
+  Access.Width = countPopulation(MaskVal);
+
+  Value *Index = CI->getArgOperand(kIndexOpIdx);
+  Value *ElementOffset = CI->getArgOperand(kElementOffsetOpIdx);
+  if (!isa<UndefValue>(ElementOffset)) {
+    ConstantInt *C = dyn_cast<ConstantInt>(ElementOffset);
+    if (!C)
+      return false;
+    Access.bStructured = true;
+    Access.Base = Index;
+    Access.Offset = C->getSExtValue();
+    return true;
+  }
+
+  Access.bStructured = false;
+  Access.Base = Index;
+  Access.Offset = 0;
+  if (ConstantInt *C = dyn_cast<ConstantInt>(Index)) {
+    Access.Base = nullptr;
+    Access.Offset = C->getSExtValue();
+  } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(Index)) {
+    // Offsets from an aligned base are often an or rather than an add.
+    ConstantInt *C = dyn_cast<ConstantInt>(BO->getOperand(1));
+    if (C && (BO->getOpcode() == Instruction::Add ||
+              (BO->getOpcode() == Instruction::Or &&
+               haveNoCommonBitsSet(BO->getOperand(0), C, *DL)))) {
+      Access.Base = BO->getOperand(0);
+      Access.Offset = C->getSExtValue();
+    }
+  }
+  return true;
+}
+
+// Calls Merge on each run of accesses in Accesses, which all match, that
+// cover adjacent bytes in at most kMaxComponents components.
+template <typename MergeFn>
+bool ForEachRun(std::vector<BufferAccess> &Accesses, MergeFn Merge) {
+  std::stable_sort(Accesses.begin(), Accesses.end(),
+                   [](const BufferAccess &A, const BufferAccess &B) {
+                     return A.Offset < B.Offset;
+                   });
+  bool bUpdated = false;
+  for (size_t i = 0; i < Accesses.size();) {
+    size_t j = i + 1;
+    unsigned Width = Accesses[i].Width;
+    while (j < Accesses.size() && Accesses[j].Offset == Accesses[j - 1].End() &&
+           Width + Accesses[j].Width <= kMaxComponents) {
+      Width += Accesses[j].Width;
+      ++j;
+    }
+    if (j - i > 1)
+      bUpdated |= Merge(ArrayRef<BufferAccess>(Accesses).slice(i, j - i));
+    i = j;
+  }
+  return bUpdated;
+}
+
+// Loads are merged at the first of them, which no store comes between.
+void DxilVectorizeBufferAccesses::MergeLoadRun(ArrayRef<BufferAccess> Run) {
+  const BufferAccess &Lowest = Run.front();
+  const BufferAccess *First = &Lowest;
+  unsigned Width = 0;
+  for (const BufferAccess &Access : Run) {
+    if (Access.Order < First->Order)
+      First = &Access;
+    Width += Access.Width;
+  }
+
+  SmallVector<Value *, 6> Args(Lowest.CI->arg_operands());
+  Args[DxilInst_RawBufferLoad::arg_mask] =
+      ConstantInt::get(Args[DxilInst_RawBufferLoad::arg_mask]->getType(),
+                       (1 << Width) - 1);
+  IRBuilder<> Builder(First->CI);
+  CallInst *Load = Builder.CreateCall(Lowest.F, Args);
+
+  for (const BufferAccess &Access : Run) {
+    unsigned Shift = (Access.Offset - Lowest.Offset) / kComponentSize;
+    SmallVector<User *, 4> Users(Access.CI->user_begin(),
+                                 Access.CI->user_end());
+    for (User *U : Users) {
+      ExtractValueInst *EV = cast<ExtractValueInst>(U);
+      Builder.SetInsertPoint(EV);
+      Value *Component =
+          Builder.CreateExtractValue(Load, *EV->idx_begin() + Shift);
+      EV->replaceAllUsesWith(Component);
+      EV->eraseFromParent();
+    }
+    Access.CI->eraseFromParent();
+  }
+}
+
+bool DxilVectorizeBufferAccesses::MergeLoads(std::vector<BufferAccess> &Loads) {
+  // Group the loads that match, in the order they are first seen.
+  std::vector<std::vector<BufferAccess>> Groups;
+  for (const BufferAccess &Load : Loads) {
+    auto It = std::find_if(Groups.begin(), Groups.end(),
+                           [&](const std::vector<BufferAccess> &Group) {
+                             return Group.front().IsMergeableWith(Load);
+                           });
+    if (It == Groups.end())
+      Groups.emplace_back(1, Load);
+    else
+      It->push_back(Load);
+  }
+  Loads.clear();
+
+  bool bUpdated = false;
+  for (auto &Group : Groups) {
+    bUpdated |= ForEachRun(Group, [&](ArrayRef<BufferAccess> Run) {
+      // The merged load takes its index from the lowest one.
+      const BufferAccess *First = &Run.front();
+      for (const BufferAccess &Access : Run) {
+        if (Access.Order < First->Order)
+          First = &Access;
+      }
+      Instruction *Index =
+          dyn_cast<Instruction>(Run.front().CI->getArgOperand(kIndexOpIdx));
+      if (Index && !DT->dominates(Index, First->CI))
+        return false;
+      MergeLoadRun(Run);
+      return true;
+    });
+  }
+  return bUpdated;
+}
+
+// Stores are merged at the last of them, which no load comes between.
+void DxilVectorizeBufferAccesses::MergeStoreRun(ArrayRef<BufferAccess> Run) {
+  const BufferAccess &Lowest = Run.front();
+  const BufferAccess *Last = &Lowest;
+  for (const BufferAccess &Access : Run) {
+    if (Access.Order > Last->Order)
+      Last = &Access;
+  }
+
+  SmallVector<Value *, 10> Args(Lowest.CI->arg_operands());
+  unsigned Width = 0;
+  for (const BufferAccess &Access : Run) {
+    for (unsigned i = 0; i < Access.Width; ++i)
+      Args[DxilInst_RawBufferStore::arg_value0 + Width + i] =
+          Access.CI->getArgOperand(DxilInst_RawBufferStore::arg_value0 + i);
+    Width += Access.Width;
+  }
+  Args[DxilInst_RawBufferStore::arg_mask] =
+      ConstantInt::get(Args[DxilInst_RawBufferStore::arg_mask]->getType(),
+                       (1 << Width) - 1);
+  IRBuilder<> Builder(Last->CI);
+  Builder.CreateCall(Lowest.F, Args);
+
+  for (const BufferAccess &Access : Run)
+    Access.CI->eraseFromParent();
+}
+
+bool DxilVectorizeBufferAccesses::MergeStores(
+    std::vector<BufferAccess> &Stores) {
+  // Every store here matches; keep the order to check for overlaps.
+  std::vector<BufferAccess> InOrder = Stores;
+  Stores.clear();
+  std::vector<BufferAccess> Sorted = InOrder;
+  return ForEachRun(Sorted, [&](ArrayRef<BufferAccess> Run) {
+    unsigned FirstOrder = Run.front().Order, LastOrder = Run.front().Order;
+    for (const BufferAccess &Access : Run) {
+      FirstOrder = std::min(FirstOrder, Access.Order);
+      LastOrder = std::max(LastOrder, Access.Order);
+    }
+    // Moving a store down past another one to the same bytes would change
+    // which of them is left in memory.
+    int64_t Begin = Run.front().Offset, End = Run.back().End();
+    for (const BufferAccess &Other : InOrder) {
+      if (Other.Order <= FirstOrder || Other.Order >= LastOrder)
+        continue;
+      bool bInRun = std::any_of(Run.begin(), Run.end(),
+                                [&](const BufferAccess &Access) {
+                                  return Access.CI == Other.CI;
+                                });
+      if (!bInRun && Other.Offset < End && Begin < Other.End())
+        return false;
+    }
+    MergeStoreRun(Run);
+    return true;
+  });
+}
+
+bool DxilVectorizeBufferAccesses::runOnFunction(Function &F) {
+  DL = &F.getParent()->getDataLayout();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+
+  bool bUpdated = false;
+  for (BasicBlock &BB : F) {
+    // Loads since the last write to memory, and stores that all match since
+    // the last other access to memory. The accesses are only collected here
+    // and merged at the end of the block.
+    std::vector<std::vector<BufferAccess>> LoadSets, StoreSets;
+    std::vector<BufferAccess> Loads, Stores;
+    auto FlushLoads = [&]() {
+      if (Loads.size() > 1)
+        LoadSets.emplace_back(std::move(Loads));
+      Loads.clear();
+    };
+    auto FlushStores = [&]() {
+      if (Stores.size() > 1)
+        StoreSets.emplace_back(std::move(Stores));
+      Stores.clear();
+    };
+
+    unsigned Order = 0;
+    for (Instruction &I : BB) {
+      ++Order;
+      BufferAccess Access;
+      if (OP::IsDxilOpFuncCallInst(&I, DXIL::OpCode::RawBufferLoad)) {
+        FlushStores();
+        if (GetBufferAccess(cast<CallInst>(&I), Order, /*bStore*/ false,
+                            Access))
+          Loads.push_back(Access);
+        continue;
+      }
+      if (OP::IsDxilOpFuncCallInst(&I, DXIL::OpCode::RawBufferStore)) {
+        FlushLoads();
+        bool bAccess = GetBufferAccess(cast<CallInst>(&I), Order,
+                                       /*bStore*/ true, Access);
+        if (!bAccess || (!Stores.empty() &&
+                         !Stores.front().IsMergeableWith(Access)))
+          FlushStores();
+        if (bAccess)
+          Stores.push_back(Access);
+        continue;
+      }
+      if (I.mayWriteToMemory())
+        FlushLoads();
+      if (I.mayReadOrWriteMemory())
+        FlushStores();
+    }
+    FlushLoads();
+    FlushStores();
+
+    for (auto &Set : LoadSets)
+      bUpdated |= MergeLoads(Set);
+    for (auto &Set : StoreSets)
+      bUpdated |= MergeStores(Set);
+  }
+  return bUpdated;
+}
+
+}
+
+FunctionPass *llvm::createDxilVectorizeBufferAccessesPass() {
+  return new DxilVectorizeBufferAccesses();
+}
+
+INITIALIZE_PASS_BEGIN(DxilVectorizeBufferAccesses,
+                      "dxil-vectorize-buffer-accesses",
+                      "DXIL vectorize buffer accesses", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_END(DxilVectorizeBufferAccesses,
+                    "dxil-vectorize-buffer-accesses",
+                    "DXIL vectorize buffer accesses", false, false)
@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilWaveAggregateAtomics.cpp                                              //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Combines the atomics a wave makes to one address into one atomic.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "DxilUniformValues.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilShaderModel.h"
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+// An atomic on an address that is the same in every lane, like
+//   InterlockedAdd(counter[0], 1, prev);
+// makes every lane of a wave contend for one location. When the address is
+// uniform, this pass has the wave combine the lanes' values first, with
+// WaveActiveSum, WaveActiveBitOr and the like, and only the first lane
+// makes the atomic, with the combined value:
+//
+//   sum = WaveActiveSum(v);
+//   if (WaveIsFirstLane())
+//     first = InterlockedAdd(addr, sum);
+//   prev = WaveReadLaneFirst(first) + WavePrefixSum(v);
+//
+// A lane's original value is only rebuilt for adds, where WavePrefixSum
+// orders the lanes as if they had made their atomics one after the other.
+// The other operations are combined only when their result is not used.
+// Exchanges and compare exchanges are left alone.
+//
+// Wave operations need shader model 6.0, so earlier models are skipped.
+class DxilWaveAggregateAtomics : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilWaveAggregateAtomics() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL wave aggregate atomics";
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool IsAggregatable(Instruction *I) const;
+  void Aggregate(Instruction *I, OP *HlslOP);
+
+  DxilUniformValues m_Uniform;
+};
+
+char DxilWaveAggregateAtomics::ID = 0;
+
+// How an atomic's values are combined across the wave.
+struct WaveCombine {
+  DXIL::OpCode Opcode;       // WaveActiveOp or WaveActiveBit
+  unsigned Kind;             // WaveOpKind or WaveBitOpKind
+  DXIL::SignedOpKind Signed;
+};
+
+bool GetWaveCombine(DXIL::AtomicBinOpCode AtomicOp, WaveCombine &Combine) {
+  switch (AtomicOp) {
+  case DXIL::AtomicBinOpCode::Add:
+    Combine = {DXIL::OpCode::WaveActiveOp, (unsigned)DXIL::WaveOpKind::Sum,
+               DXIL::SignedOpKind::Unsigned};
+    return true;
+  case DXIL::AtomicBinOpCode::And:
+    Combine = {DXIL::OpCode::WaveActiveBit,
+               (unsigned)DXIL::WaveBitOpKind::And, DXIL::SignedOpKind::Unsigned};
+    return true;
+  case DXIL::AtomicBinOpCode::Or:
+    Combine = {DXIL::OpCode::WaveActiveBit, (unsigned)DXIL::WaveBitOpKind::Or,
+               DXIL::SignedOpKind::Unsigned};
+    return true;
+  case DXIL::AtomicBinOpCode::Xor:
+    Combine = {DXIL::OpCode::WaveActiveBit,
+               (unsigned)DXIL::WaveBitOpKind::Xor, DXIL::SignedOpKind::Unsigned};
+    return true;
+  case DXIL::AtomicBinOpCode::IMin:
+    Combine = {DXIL::OpCode::WaveActiveOp, (unsigned)DXIL::WaveOpKind::Min,
+               DXIL::SignedOpKind::Signed};
+    return true;
+  case DXIL::AtomicBinOpCode::IMax:
+    Combine = {DXIL::OpCode::WaveActiveOp, (unsigned)DXIL::WaveOpKind::Max,
+               DXIL::SignedOpKind::Signed};
+    return true;
+  case DXIL::AtomicBinOpCode::UMin:
+    Combine = {DXIL::OpCode::WaveActiveOp, (unsigned)DXIL::WaveOpKind::Min,
+               DXIL::SignedOpKind::Unsigned};
+    return true;
+  case DXIL::AtomicBinOpCode::UMax:
+    Combine = {DXIL::OpCode::WaveActiveOp, (unsigned)DXIL::WaveOpKind::Max,
+               DXIL::SignedOpKind::Unsigned};
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Groupshared atomics are atomicrmw instructions rather than DXIL operations.
+bool GetAtomicBinOpCode(AtomicRMWInst::BinOp Op,
+                        DXIL::AtomicBinOpCode &AtomicOp) {
+  switch (Op) {
+  case AtomicRMWInst::Add:  AtomicOp = DXIL::AtomicBinOpCode::Add;  return true;
+  case AtomicRMWInst::And:  AtomicOp = DXIL::AtomicBinOpCode::And;  return true;
+  case AtomicRMWInst::Or:   AtomicOp = DXIL::AtomicBinOpCode::Or;   return true;
+  case AtomicRMWInst::Xor:  AtomicOp = DXIL::AtomicBinOpCode::Xor;  return true;
+  case AtomicRMWInst::Min:  AtomicOp = DXIL::AtomicBinOpCode::IMin; return true;
+  case AtomicRMWInst::Max:  AtomicOp = DXIL::AtomicBinOpCode::IMax; return true;
+  case AtomicRMWInst::UMin: AtomicOp = DXIL::AtomicBinOpCode::UMin; return true;
+  case AtomicRMWInst::UMax: AtomicOp = DXIL::AtomicBinOpCode::UMax; return true;
+  default:
+    return false;
+  }
+}
+
+// Finds the operation, and the operand index of the value, of an atomic this
+// pass can combine.
+bool GetAtomic(Instruction *I, DXIL::AtomicBinOpCode &AtomicOp,
+               unsigned &ValueIdx) {
+  if (AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(I)) {
+    ValueIdx = 1;
+    return GetAtomicBinOpCode(RMW->getOperation(), AtomicOp);
+  }
+  if (!OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::AtomicBinOp))
+    return false;
+  DxilInst_AtomicBinOp Atomic(I);
+  ConstantInt *Op = dyn_cast<ConstantInt>(Atomic.get_atomicOp());
+  if (!Op)
+    return false;
+  AtomicOp = (DXIL::AtomicBinOpCode)Op->getLimitedValue();
+  ValueIdx = DxilInst_AtomicBinOp::arg_newValue;
+  return true;
+}
+
+bool DxilWaveAggregateAtomics::IsAggregatable(Instruction *I) const {
+  DXIL::AtomicBinOpCode AtomicOp;
+  unsigned ValueIdx;
+  WaveCombine Combine;
+  if (!GetAtomic(I, AtomicOp, ValueIdx) || !GetWaveCombine(AtomicOp, Combine))
+    return false;
+  if (!I->use_empty() && AtomicOp != DXIL::AtomicBinOpCode::Add)
+    return false;
+  // Every operand but the value makes up the address.
+  for (unsigned i = 0; i < I->getNumOperands(); ++i) {
+    Value *Op = I->getOperand(i);
+    if (i != ValueIdx && !isa<Function>(Op) && !m_Uniform.IsUniform(Op))
+      return false;
+  }
+  return true;
+}
+
+void DxilWaveAggregateAtomics::Aggregate(Instruction *I, OP *HlslOP) {
+  DXIL::AtomicBinOpCode AtomicOp;
+  unsigned ValueIdx;
+  WaveCombine Combine;
+  GetAtomic(I, AtomicOp, ValueIdx);
+  GetWaveCombine(AtomicOp, Combine);
+  Value *V = I->getOperand(ValueIdx);
+  Type *Ty = V->getType();
+  LLVMContext &Ctx = I->getContext();
+  IRBuilder<> Builder(I);
+
+  // A uniform add is that value times the number of lanes; counting lanes
+  // is cheaper than summing values.
+  bool bCountLanes =
+      AtomicOp == DXIL::AtomicBinOpCode::Add && m_Uniform.IsUniform(V);
+  auto CountLanes = [&](DXIL::OpCode Opcode) -> Value * {
+    Function *CountFunc = HlslOP->GetOpFunc(Opcode, Type::getVoidTy(Ctx));
+    Value *Count = Builder.CreateCall(
+        CountFunc, {HlslOP->GetU32Const((unsigned)Opcode), HlslOP->GetI1Const(1)});
+    return Builder.CreateMul(V, Builder.CreateZExtOrTrunc(Count, Ty));
+  };
+
+  Value *Combined = nullptr;
+  if (bCountLanes) {
+    Combined = CountLanes(DXIL::OpCode::WaveAllBitCount);
+  } else {
+    Function *CombineFunc = HlslOP->GetOpFunc(Combine.Opcode, Ty);
+    SmallVector<Value *, 4> Args = {
+        HlslOP->GetU32Const((unsigned)Combine.Opcode), V,
+        HlslOP->GetI8Const(Combine.Kind)};
+    if (Combine.Opcode == DXIL::OpCode::WaveActiveOp)
+      Args.push_back(HlslOP->GetI8Const((unsigned)Combine.Signed));
+    Combined = Builder.CreateCall(CombineFunc, Args);
+  }
+
+  // The lanes before this one in the order WavePrefixSum gives them.
+  Value *Prefix = nullptr;
+  if (!I->use_empty()) {
+    if (bCountLanes) {
+      Prefix = CountLanes(DXIL::OpCode::WavePrefixBitCount);
+    } else {
+      Function *PrefixFunc =
+          HlslOP->GetOpFunc(DXIL::OpCode::WavePrefixOp, Ty);
+      Prefix = Builder.CreateCall(
+          PrefixFunc,
+          {HlslOP->GetU32Const((unsigned)DXIL::OpCode::WavePrefixOp), V,
+           HlslOP->GetI8Const((unsigned)DXIL::WaveOpKind::Sum),
+           HlslOP->GetI8Const((unsigned)DXIL::SignedOpKind::Unsigned)});
+    }
+  }
+
+  Function *IsFirstLaneFunc = HlslOP->GetOpFunc(DXIL::OpCode::WaveIsFirstLane,
+                                                Type::getVoidTy(Ctx));
+  Value *IsFirstLane = Builder.CreateCall(
+      IsFirstLaneFunc,
+      {HlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveIsFirstLane)});
+  TerminatorInst *Then = SplitBlockAndInsertIfThen(IsFirstLane, I, false);
+  BasicBlock *Head = Then->getParent()->getSinglePredecessor();
+  BasicBlock *Tail = I->getParent();
+  I->moveBefore(Then);
+  I->setOperand(ValueIdx, Combined);
+
+  if (!Prefix)
+    return;
+  // The lanes that made the atomic together are together again in Tail, so
+  // the first lane there is the one that made it.
+  Builder.SetInsertPoint(Tail->getFirstNonPHI());
+  PHINode *Phi = Builder.CreatePHI(Ty, 2);
+  std::vector<Use *> Uses;
+  for (Use &U : I->uses())
+    Uses.push_back(&U);
+  Phi->addIncoming(I, Then->getParent());
+  Phi->addIncoming(UndefValue::get(Ty), Head);
+  Function *ReadFirstFunc =
+      HlslOP->GetOpFunc(DXIL::OpCode::WaveReadLaneFirst, Ty);
+  Value *Original = Builder.CreateCall(
+      ReadFirstFunc,
+      {HlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveReadLaneFirst), Phi});
+  Value *Result = Builder.CreateAdd(Original, Prefix);
+  for (Use *U : Uses)
+    U->set(Result);
+}
+
+bool DxilWaveAggregateAtomics::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+  if (!DM.GetShaderModel()->IsSM60Plus())
+    return false;
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  std::vector<BasicBlock *> RPO(RPOT.begin(), RPOT.end());
+  m_Uniform.Compute(RPO);
+
+  std::vector<Instruction *> Atomics;
+  for (BasicBlock *BB : RPO) {
+    for (Instruction &I : *BB) {
+      if (IsAggregatable(&I))
+        Atomics.push_back(&I);
+    }
+  }
+  for (Instruction *I : Atomics)
+    Aggregate(I, DM.GetOP());
+  return !Atomics.empty();
+}
+
+}
+
+FunctionPass *llvm::createDxilWaveAggregateAtomicsPass() {
+  return new DxilWaveAggregateAtomics();
+}
+
+INITIALIZE_PASS(DxilWaveAggregateAtomics, "dxil-wave-aggregate-atomics",
+                "DXIL wave aggregate atomics", false, false)
@@ -51,10 +51,14 @@ static Value *callHLFunction(llvm::Module &Module, HLOpcodeGroup OpcodeGroup, un
 }
 
 
+static StructType *GetLoweredUDTCached(StructType *structTy,
+                                       DxilTypeSystem::LoweredUDTMap *pCache);
+
 // Lowered UDT is the same layout, but with vectors and matrices translated to
 // arrays.
 // Returns nullptr for failure due to embedded HLSL object type.
-StructType *hlsl::GetLoweredUDT(StructType *structTy, DxilTypeSystem *pTypeSys) {
+static StructType *LowerUDT(StructType *structTy,
+                            DxilTypeSystem::LoweredUDTMap *pCache) {
   bool changed = false;
   SmallVector<Type*, 8> NewElTys(structTy->getNumContainedTypes());
 
@@ -81,7 +85,7 @@ StructType *hlsl::GetLoweredUDT(StructType *structTy, DxilTypeSystem *pTypeSys)
       // We cannot lower a structure with an embedded object type
       return nullptr;
     } else if (StructType *ST = dyn_cast<StructType>(EltTy)) {
-      NewTy = GetLoweredUDT(ST);
+      NewTy = GetLoweredUDTCached(ST, pCache);
       if (nullptr == NewTy)
         return nullptr; // Propagate failure back to root
     } else if (EltTy->isIntegerTy(1)) {
@@ -106,21 +110,44 @@ StructType *hlsl::GetLoweredUDT(StructType *structTy, DxilTypeSystem *pTypeSys)
   }
 
   if (changed) {
-    StructType *newStructTy = StructType::create(
+    return StructType::create(
       structTy->getContext(), NewElTys, structTy->getStructName());
+  }
+
+  return structTy;
+}
+
+static StructType *GetLoweredUDTCached(StructType *structTy,
+                                       DxilTypeSystem::LoweredUDTMap *pCache) {
+  if (!pCache)
+    return LowerUDT(structTy, nullptr);
+  auto it = pCache->find(structTy);
+  if (it != pCache->end())
+    return it->second;
+  StructType *NewTy = LowerUDT(structTy, pCache);
+  (*pCache)[structTy] = NewTy;
+  return NewTy;
+}
+
+// With a type system, the lowered type is built once per module and shared
+// by every caller; without one, a new type is built on each call.
+StructType *hlsl::GetLoweredUDT(StructType *structTy, DxilTypeSystem *pTypeSys) {
+  StructType *newStructTy = GetLoweredUDTCached(
+      structTy, pTypeSys ? &pTypeSys->GetLoweredUDTMap() : nullptr);
+
+  if (newStructTy && newStructTy != structTy) {
     if (DxilStructAnnotation *pSA = pTypeSys ?
           pTypeSys->GetStructAnnotation(structTy) : nullptr) {
       if (!pTypeSys->GetStructAnnotation(newStructTy)) {
         DxilStructAnnotation &NewSA = *pTypeSys->AddStructAnnotation(newStructTy);
-        for (unsigned iField = 0; iField < NewElTys.size(); ++iField) {
+        for (unsigned iField = 0; iField < newStructTy->getNumElements(); ++iField) {
           NewSA.GetFieldAnnotation(iField) = pSA->GetFieldAnnotation(iField);
         }
       }
     }
-    return newStructTy;
   }
 
-  return structTy;
+  return newStructTy;
 }
 
 Constant *hlsl::TranslateInitForLoweredUDT(
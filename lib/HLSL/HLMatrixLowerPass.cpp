@@ -16,6 +16,7 @@
 #include "dxc/HLSL/HLModule.h"
 #include "dxc/HlslIntrinsicOp.h"
 #include "dxc/Support/Global.h"
+#include "dxc/Support/DxcCompileDeadline.h"
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilTypeSystem.h"
 #include "dxc/DXIL/DxilModule.h"
@@ -29,6 +30,8 @@
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include <unordered_set>
 #include <vector>
 
@@ -62,6 +65,9 @@ public:
   bool contains(FunctionType *Ty) const { return Funcs.count(Ty) != 0; }
   bool contains(Function *Func) const;
   void clear();
+  // Forgets the stubs without checking that they are unused, for when the
+  // module is being abandoned.
+  void abandon() { Funcs.clear(); }
 
 private:
   llvm::Module &Module;
@@ -181,6 +187,82 @@ private:
 
   std::vector<Instruction *> m_deadInsts;
 };
+
+// Finds the functions that can hold matrix values, from the types of the
+// functions they call, the globals they use, their signature and their
+// allocas. Every matrix value in a function body is derived from one of
+// those, so the rest of the module can be skipped without visiting each of
+// its instructions.
+class MatrixUseFinder {
+public:
+  void findFunctions(Module &M, SmallPtrSetImpl<Function *> &MatFuncs) {
+    for (GlobalVariable &Global : M.globals()) {
+      if (containsMatrix(Global.getType()))
+        addUserFunctions(&Global, MatFuncs);
+    }
+    for (Function &F : M.functions()) {
+      if (!containsMatrix(F.getFunctionType()))
+        continue;
+      addUserFunctions(&F, MatFuncs);
+      if (!F.isDeclaration())
+        MatFuncs.insert(&F);
+    }
+    for (Function &F : M.functions()) {
+      if (F.isDeclaration() || MatFuncs.count(&F))
+        continue;
+      // Allocas are all in the entry block at this point, as SROA_HLSL also
+      // assumes.
+      for (Instruction &I : F.getEntryBlock()) {
+        AllocaInst *Alloca = dyn_cast<AllocaInst>(&I);
+        if (Alloca && containsMatrix(Alloca->getType())) {
+          MatFuncs.insert(&F);
+          break;
+        }
+      }
+    }
+  }
+
+private:
+  bool containsMatrix(Type *Ty) {
+    auto It = m_Cache.find(Ty);
+    if (It != m_Cache.end())
+      return It->second;
+    // Guard against recursive struct types.
+    m_Cache[Ty] = false;
+
+    bool Result = false;
+    if (HLMatrixType::isa(Ty)) {
+      Result = true;
+    } else if (Ty->isPointerTy()) {
+      Result = containsMatrix(Ty->getPointerElementType());
+    } else if (Ty->isArrayTy()) {
+      Result = containsMatrix(Ty->getArrayElementType());
+    } else if (StructType *ST = dyn_cast<StructType>(Ty)) {
+      for (Type *EltTy : ST->elements()) {
+        if (containsMatrix(EltTy)) {
+          Result = true;
+          break;
+        }
+      }
+    } else if (FunctionType *FT = dyn_cast<FunctionType>(Ty)) {
+      Result = containsMatrix(FT->getReturnType());
+      for (unsigned i = 0; !Result && i < FT->getNumParams(); ++i)
+        Result = containsMatrix(FT->getParamType(i));
+    }
+    return m_Cache[Ty] = Result;
+  }
+
+  static void addUserFunctions(Value *V, SmallPtrSetImpl<Function *> &MatFuncs) {
+    for (User *U : V->users()) {
+      if (Instruction *I = dyn_cast<Instruction>(U))
+        MatFuncs.insert(I->getParent()->getParent());
+      else if (isa<Constant>(U))
+        addUserFunctions(U, MatFuncs);
+    }
+  }
+
+  DenseMap<Type *, bool> m_Cache;
+};
 }
 
 char HLMatrixLowerPass::ID = 0;
@@ -201,6 +283,10 @@ bool HLMatrixLowerPass::runOnModule(Module &M) {
   m_matToVecStubs = &matToVecStubs;
   m_vecToMatStubs = &vecToMatStubs;
 
+  // Find the functions to visit before lowering globals replaces their uses.
+  SmallPtrSet<Function *, 32> MatFuncs;
+  MatrixUseFinder().findFunctions(M, MatFuncs);
+
   // First, lower static global variables.
   // We need to accumulate them locally because we'll be creating new ones as we lower them.
   std::vector<GlobalVariable*> Globals;
@@ -215,7 +301,14 @@ bool HLMatrixLowerPass::runOnModule(Module &M) {
     lowerGlobal(Global);
 
   for (Function &F : M.functions()) {
-    if (F.isDeclaration()) continue;
+    if (F.isDeclaration() || !MatFuncs.count(&F)) continue;
+    // Stubs may still be in use between functions; the module goes away
+    // with the compile, so they are left in it.
+    if (hlsl::IsCompileDeadlineExpired()) {
+      matToVecStubs.abandon();
+      vecToMatStubs.abandon();
+      hlsl::CheckCompileDeadline();
+    }
     runOnFunction(F);
   }
 
@@ -33,6 +33,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/DenseMap.h"
 
 using namespace llvm;
 using namespace hlsl;
@@ -88,6 +89,11 @@ private:
   // A global resource Texture2D T2 will be created for Texture2D T.
   // CBPtrToResourceMap[T] will return T2.
   std::unordered_map<Value *, Value *> CBPtrToResourceMap;
+  // Decoded properties of annotated handles, keyed on the properties
+  // constant and the packed class and kind. Constants are uniqued, so every
+  // handle annotated with the same resource shares one entry.
+  DenseMap<std::pair<Constant *, unsigned>, DxilResourceProperties>
+      AnnotatedPropsMap;
 
 public:
   HLObjectOperationLowerHelper(HLModule &HLM,
@@ -180,15 +186,22 @@ public:
             ->getLimitedValue();
     Constant *Props = cast<Constant>(Anno->getArgOperand(
         HLOperandIndex::kAnnotateHandleResourcePropertiesOpIdx));
+    auto Key = std::make_pair(Props, ((unsigned)RC << 8) | (unsigned)RK);
+    auto It = AnnotatedPropsMap.find(Key);
+    if (It != AnnotatedPropsMap.end())
+      return It->second;
     DxilResourceProperties RP = resource_helper::loadFromConstant(
         *Props, RC, RK);
+    AnnotatedPropsMap[Key] = RP;
     return RP;
   }
 
 private:
   ResAttribute &FindCreateHandleResourceBase(Value *Handle) {
-    if (HandleMetaMap.count(Handle))
-      return HandleMetaMap[Handle];
+    // Called for every object intrinsic, so look the handle up only once.
+    auto It = HandleMetaMap.find(Handle);
+    if (It != HandleMetaMap.end())
+      return It->second;
 
     // Add invalid first to avoid dead loop.
     HandleMetaMap[Handle] = {DXIL::ResourceClass::Invalid,
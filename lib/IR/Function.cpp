@@ -256,6 +256,7 @@ Function::Function(FunctionType *Ty, LinkageTypes Linkage, const Twine &name,
   assert(FunctionType::isValidReturnType(getReturnType()) &&
          "invalid return type");
   setGlobalObjectSubClassData(0);
+  setGlobalObjectBit(IsDxilOpBit, getName().startswith("dx.op.")); // HLSL Change
   SymTab.reset(new ValueSymbolTable()); // HLSL Change: use unique_ptr
 
   // If the function has arguments, mark them as lazily built.
@@ -469,6 +470,7 @@ static Intrinsic::ID lookupIntrinsicID(const ValueName *ValName) {
 }
 
 void Function::recalculateIntrinsicID() {
+  setGlobalObjectBit(IsDxilOpBit, getName().startswith("dx.op.")); // HLSL Change
   const ValueName *ValName = this->getValueName();
   if (!ValName || !isIntrinsic()) {
     IntID = Intrinsic::not_intrinsic;
@@ -110,6 +110,42 @@ LLVMContext::LLVMContext() : pImpl(new LLVMContextImpl(*this)) {
 }
 LLVMContext::~LLVMContext() { delete pImpl; }
 
+// HLSL Change - Begin
+bool LLVMContext::resetForReuse() {
+  if (!pImpl->OwnedModules.empty())
+    return false;
+
+  // Types can't be deleted, but taking their names frees the names for the
+  // next user and keeps collisions from being renamed differently.
+  std::vector<StructType *> NamedTypes;
+  NamedTypes.reserve(pImpl->NamedStructTypes.size());
+  for (auto &Entry : pImpl->NamedStructTypes)
+    NamedTypes.push_back(Entry.getValue());
+  for (StructType *ST : NamedTypes)
+    ST->setName("");
+  pImpl->NamedStructTypesUniqueID = 0;
+
+  // The bitcode writer emits every registered kind, so only the fixed ones
+  // may remain.
+  std::vector<StringRef> CustomKinds;
+  for (auto &Entry : pImpl->CustomMDKindNames) {
+    if (Entry.getValue() > MD_dereferenceable_or_null)
+      CustomKinds.push_back(Entry.getKey());
+  }
+  for (StringRef Kind : CustomKinds)
+    pImpl->CustomMDKindNames.erase(Kind);
+
+  pImpl->InlineAsmDiagHandler = nullptr;
+  pImpl->InlineAsmDiagContext = nullptr;
+  pImpl->DiagnosticHandler = nullptr;
+  pImpl->DiagnosticContext = nullptr;
+  pImpl->RespectDiagnosticFilters = false;
+  pImpl->YieldCallback = nullptr;
+  pImpl->YieldOpaqueHandle = nullptr;
+  return true;
+}
+// HLSL Change - End
+
 void LLVMContext::addModule(Module *M) {
   pImpl->OwnedModules.insert(M);
 }
@@ -497,6 +497,43 @@ public:
 
 static TimingInfo *TheTimeInfo;
 
+// HLSL Change Begin - per-thread pass run notifications.
+static LLVM_THREAD_LOCAL PassRunObserver *ThePassRunObserver = nullptr;
+
+PassRunObserver::~PassRunObserver() {}
+
+PassRunObserver *llvm::legacy::setThreadPassRunObserver(PassRunObserver *O) {
+  PassRunObserver *Prior = ThePassRunObserver;
+  ThePassRunObserver = O;
+  return Prior;
+}
+
+PassRunObserver *llvm::legacy::getThreadPassRunObserver() {
+  return ThePassRunObserver;
+}
+
+namespace {
+/// Notifies the thread's observer, if any, around a single pass run.
+class PassRunNotification {
+  PassRunObserver *O;
+  Pass *P;
+  Module &M;
+  Function *F;
+
+public:
+  PassRunNotification(Pass *P, Module &M, Function *F)
+      : O(ThePassRunObserver), P(P), M(M), F(F) {
+    if (O)
+      O->beforePass(P, M, F);
+  }
+  ~PassRunNotification() {
+    if (O)
+      O->afterPass(P, M, F);
+  }
+};
+} // End of anon namespace
+// HLSL Change End
+
 //===----------------------------------------------------------------------===//
 // PMTopLevelManager implementation
 
@@ -1532,10 +1569,29 @@ bool FPPassManager::runOnFunction(Function &F) {
   // Collect inherited analysis from Module level pass manager.
   populateInheritedAnalysis(TPM->activeStack);
 
+  // HLSL Change Begin - skip idempotent passes on unchanged functions; see
+  // FunctionPass::isIdempotent for which passes qualify.
+  // Position (index + 1) of the last pass that changed F, and of the last
+  // run of each idempotent pass.
+  unsigned LastChangedPos = 0;
+  SmallDenseMap<AnalysisID, unsigned, 4> LastIdempotentPos;
+  // HLSL Change End
+
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
     FunctionPass *FP = getContainedPass(Index);
     bool LocalChanged = false;
 
+    // HLSL Change Begin
+    if (FP->isIdempotent()) {
+      unsigned &LastPos = LastIdempotentPos[FP->getPassID()];
+      if (LastPos != 0 && LastChangedPos <= LastPos) {
+        removeDeadPasses(FP, F.getName(), ON_FUNCTION_MSG);
+        continue;
+      }
+      LastPos = Index + 1;
+    }
+    // HLSL Change End
+
     dumpPassInfo(FP, EXECUTION_MSG, ON_FUNCTION_MSG, F.getName());
     dumpRequiredSet(FP);
 
@@ -1544,13 +1600,16 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      PassRunNotification Notify(FP, *F.getParent(), &F); // HLSL Change
 
       LocalChanged |= FP->runOnFunction(F);
     }
 
     Changed |= LocalChanged;
-    if (LocalChanged)
+    if (LocalChanged) {
+      LastChangedPos = Index + 1; // HLSL Change
       dumpPassInfo(FP, MODIFICATION_MSG, ON_FUNCTION_MSG, F.getName());
+    }
     dumpPreservedSet(FP);
 
     verifyPreservedAnalysis(FP);
@@ -1620,6 +1679,7 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      PassRunNotification Notify(MP, M, nullptr); // HLSL Change
 
       LocalChanged |= MP->runOnModule(M);
     }
@@ -282,7 +282,13 @@ void Value::takeName(Value *V) {
   // Now we know that this has no name.
 
   // If V has no name either, we're done.
-  if (!V->hasName()) return;
+  if (!V->hasName()) {
+    // HLSL Change Begin - this may have lost a name.
+    if (Function *F = dyn_cast<Function>(this))
+      F->recalculateIntrinsicID();
+    // HLSL Change End
+    return;
+  }
 
   // Get this's symtab if we didn't before.
   if (!ST) {
@@ -305,20 +311,26 @@ void Value::takeName(Value *V) {
     setValueName(V->getValueName());
     V->setValueName(nullptr);
     getValueName()->setValue(this);
-    return;
-  }
+  } else {
+    // Otherwise, things are slightly more complex.  Remove V's name from VST
+    // and then reinsert it into ST.
 
-  // Otherwise, things are slightly more complex.  Remove V's name from VST and
-  // then reinsert it into ST.
+    if (VST)
+      VST->removeValueName(V->getValueName());
+    setValueName(V->getValueName());
+    V->setValueName(nullptr);
+    getValueName()->setValue(this);
 
-  if (VST)
-    VST->removeValueName(V->getValueName());
-  setValueName(V->getValueName());
-  V->setValueName(nullptr);
-  getValueName()->setValue(this);
+    if (ST)
+      ST->reinsertValue(this);
+  }
 
-  if (ST)
-    ST->reinsertValue(this);
+  // HLSL Change Begin - keep what functions know from their names current.
+  if (Function *F = dyn_cast<Function>(this))
+    F->recalculateIntrinsicID();
+  if (Function *F = dyn_cast<Function>(V))
+    F->recalculateIntrinsicID();
+  // HLSL Change End
 }
 
 #ifndef NDEBUG
@@ -207,7 +207,7 @@ void PassManagerBuilder::populateFunctionPassManager(
 }
 
 // HLSL Change Starts
-static void addHLSLPasses(bool HLSLHighLevel, unsigned OptLevel, hlsl::HLSLExtensionsCodegenHelper *ExtHelper, legacy::PassManagerBase &MPM) {
+static void addHLSLPasses(bool HLSLHighLevel, unsigned OptLevel, hlsl::HLSLExtensionsCodegenHelper *ExtHelper, unsigned MaxLiveScalars, legacy::PassManagerBase &MPM) {
 
   // Don't do any lowering if we're targeting high-level.
   if (HLSLHighLevel) {
@@ -282,7 +282,7 @@ static void addHLSLPasses(bool HLSLHighLevel, unsigned OptLevel, hlsl::HLSLExten
   // Default unroll pass. This is purely for optimizing loops without
   // attributes.
   if (OptLevel > 2) {
-    MPM.add(createLoopUnrollPass());
+    MPM.add(createLoopUnrollPass(-1, -1, -1, -1, MaxLiveScalars));
   }
 
   MPM.add(createDxilPromoteLocalResources());
@@ -316,6 +316,38 @@ static void addHLSLPasses(bool HLSLHighLevel, unsigned OptLevel, hlsl::HLSLExten
     MPM.add(createDxilFixConstArrayInitializerPass());
   }
 }
+
+// Passes that turn optimized DXIL into its final form. Shared by the -O1 and
+// the full pipelines.
+static void addDxilFinalizePasses(legacy::PassManagerBase &MPM,
+                                  unsigned MaxLiveScalars = 0,
+                                  bool ReportLoopHandles = false) {
+  MPM.add(createDxilEraseDeadRegionPass());
+
+  MPM.add(createDxilConvergentClearPass());
+  MPM.add(createDeadCodeEliminationPass()); // DCE needed after clearing convergence
+                                            // annotations before CreateHandleForLib
+                                            // so no unused resources get re-added to
+                                            // DxilModule.
+  MPM.add(createMultiDimArrayToOneDimArrayPass());
+  MPM.add(createDxilRemoveDeadBlocksPass());
+  MPM.add(createDxilLowerCreateHandleForLibPass());
+  MPM.add(createDxilTranslateRawBuffer());
+  MPM.add(createDxilHoistHandlesPass(ReportLoopHandles)); // HLSL Change - one handle per resource and index.
+  // After handles are merged, so rematerialized ones stay where they are.
+  if (MaxLiveScalars)
+    MPM.add(createDxilRematerializePass(MaxLiveScalars));
+  MPM.add(createDeadCodeEliminationPass());
+  // Always try to legalize sample offsets as loop unrolling
+  // is not guaranteed for higher opt levels.
+  MPM.add(createDxilLegalizeSampleOffsetPass());
+  MPM.add(createDxilFinalizeModulePass());
+  MPM.add(createComputeViewIdStatePass());
+  MPM.add(createDxilDeadFunctionEliminationPass());
+  MPM.add(createNoPausePassesPass());
+  MPM.add(createDxilValidateWaveSensitivityPass());
+  MPM.add(createDxilEmitMetadataPass());
+}
 // HLSL Change Ends
 
 void PassManagerBuilder::populateModulePassManager(
@@ -351,7 +383,7 @@ void PassManagerBuilder::populateModulePassManager(
     addExtensionsToPM(EP_EnabledOnOptLevel0, MPM);
 
     // HLSL Change Begins.
-    addHLSLPasses(HLSLHighLevel, OptLevel, HLSLExtensionsCodeGen, MPM);
+    addHLSLPasses(HLSLHighLevel, OptLevel, HLSLExtensionsCodeGen, HLSLMaxLiveScalars, MPM);
     if (!HLSLHighLevel) {
       MPM.add(createDxilConvergentClearPass());
       MPM.add(createMultiDimArrayToOneDimArrayPass());
@@ -380,9 +412,28 @@ void PassManagerBuilder::populateModulePassManager(
     delete Inliner;
     Inliner = nullptr;
   }
-  addHLSLPasses(HLSLHighLevel, OptLevel, HLSLExtensionsCodeGen, MPM); // HLSL Change
+  addHLSLPasses(HLSLHighLevel, OptLevel, HLSLExtensionsCodeGen, HLSLMaxLiveScalars, MPM); // HLSL Change
   // HLSL Change Ends
 
+  // HLSL Change Begins.
+  // -O1 is the fast tier: the HLSL lowering above, with mem2reg and
+  // SROA_HLSL promotion, then a single round of cleanup over the DXIL
+  // before finalization. The LLVM scalar and loop pipeline below is
+  // skipped.
+  if (OptLevel == 1 && !HLSLHighLevel) {
+    if (LibraryInfo)
+      MPM.add(new TargetLibraryInfoWrapperPass(*LibraryInfo));
+    MPM.add(createInstructionCombiningPass());
+    addExtensionsToPM(EP_Peephole, MPM);
+    MPM.add(createCFGSimplificationPass());
+    MPM.add(createAggressiveDCEPass());
+    MPM.add(createGlobalDCEPass());
+    addDxilFinalizePasses(MPM, 0, HLSLReportLoopHandles);
+    addExtensionsToPM(EP_OptimizerLast, MPM);
+    return;
+  }
+  // HLSL Change Ends.
+
   // Add LibraryInfo if we have some.
   if (LibraryInfo)
     MPM.add(new TargetLibraryInfoWrapperPass(*LibraryInfo));
@@ -450,7 +501,7 @@ void PassManagerBuilder::populateModulePassManager(
     MPM.add(createCFGSimplificationPass());
   }
   if (!DisableUnrollLoops)
-    MPM.add(createSimpleLoopUnrollPass());    // Unroll small loops
+    MPM.add(createLoopUnrollPass(-1, -1, 0, 0, HLSLMaxLiveScalars)); // HLSL Change - Unroll small loops
   addExtensionsToPM(EP_LoopOptimizerEnd, MPM);
 
   if (OptLevel > 1) {
@@ -459,6 +510,8 @@ void PassManagerBuilder::populateModulePassManager(
     MPM.add(createGVNPass(DisableGVNLoadPRE));  // Remove redundancies
     if (!HLSLResMayAlias)
       MPM.add(createDxilSimpleGVNHoistPass()); // HLSL Change - GVN hoist for code size.
+    MPM.add(createDxilCBufferLoadCoalescePass()); // HLSL Change - merge cbuffer row loads.
+    MPM.add(createDxilVectorizeBufferAccessesPass()); // HLSL Change - widen buffer accesses.
   }
   // HLSL Change Begins.
   // HLSL don't allow memcpy and memset.
@@ -590,7 +643,7 @@ void PassManagerBuilder::populateModulePassManager(
   MPM.add(createInstructionCombiningPass());
 
   if (!DisableUnrollLoops) {
-    MPM.add(createLoopUnrollPass());    // Unroll small loops
+    MPM.add(createLoopUnrollPass(-1, -1, -1, -1, HLSLMaxLiveScalars)); // HLSL Change - Unroll small loops
 
     // LoopUnroll may generate some redundency to cleanup.
     MPM.add(createInstructionCombiningPass());
@@ -635,28 +688,22 @@ void PassManagerBuilder::populateModulePassManager(
 
   // HLSL Change Begins.
   if (!HLSLHighLevel) {
-    if (OptLevel > 0)
-      MPM.add(createDxilEraseDeadRegionPass());
-
-    MPM.add(createDxilConvergentClearPass());
-    MPM.add(createDeadCodeEliminationPass()); // DCE needed after clearing convergence
-                                              // annotations before CreateHandleForLib
-                                              // so no unused resources get re-added to
-                                              // DxilModule.
-    MPM.add(createMultiDimArrayToOneDimArrayPass());
-    MPM.add(createDxilRemoveDeadBlocksPass());
-    MPM.add(createDxilLowerCreateHandleForLibPass());
-    MPM.add(createDxilTranslateRawBuffer());
-    MPM.add(createDeadCodeEliminationPass());
-    // Always try to legalize sample offsets as loop unrolling
-    // is not guaranteed for higher opt levels.
-    MPM.add(createDxilLegalizeSampleOffsetPass());
-    MPM.add(createDxilFinalizeModulePass());
-    MPM.add(createComputeViewIdStatePass());
-    MPM.add(createDxilDeadFunctionEliminationPass());
-    MPM.add(createNoPausePassesPass());
-    MPM.add(createDxilValidateWaveSensitivityPass());
-    MPM.add(createDxilEmitMetadataPass());
+    if (HLSLAuto16BitPrecision)
+      MPM.add(createDxilNarrowPrecisionPass(HLSLAuto16BitPrecision));
+    if (HLSLPadGroupShared)
+      MPM.add(createDxilPadGroupSharedPass());
+    if (HLSLMinimizeMeshOutputs)
+      MPM.add(createDxilMinimizeMeshOutputsPass());
+    if (HLSLFastTrig)
+      MPM.add(createDxilExpandTrigIntrinsicsPass(/*bReducedPrecision*/true));
+    if (HLSLWaveAggregateAtomics)
+      MPM.add(createDxilWaveAggregateAtomicsPass());
+    if (HLSLFPContract)
+      MPM.add(createDxilContractMadPass(/*bAcrossBlocks*/HLSLFPContract == 2));
+    // Hoist uniform values once flattening has picked which branches remain.
+    if (HLSLHoistUniform)
+      MPM.add(createDxilHoistUniformPass());
+    addDxilFinalizePasses(MPM, HLSLMaxLiveScalars, HLSLReportLoopHandles);
   }
   // HLSL Change Ends.
   addExtensionsToPM(EP_OptimizerLast, MPM);
@@ -48,17 +48,33 @@ static bool ContainsFloatingPointType(Type *Ty) {
 static bool Mem2Reg(Function &F, DominatorTree &DT, AssumptionCache &AC) {
   BasicBlock &BB = F.getEntryBlock();  // Get the entry node for the function
   bool Changed  = false;
+
+  // Collect the candidates once. Promotion never creates allocas, so later
+  // rounds only need to revisit the ones left over, not the whole entry
+  // block. Precise allocas with floating point data are never candidates.
+  std::vector<AllocaInst*> Candidates;
+  for (BasicBlock::iterator I = BB.begin(), E = --BB.end(); I != E; ++I)
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(I))       // Is it an alloca?
+      if (!HLModule::HasPreciseAttributeWithMetadata(AI) || !ContainsFloatingPointType(AI->getAllocatedType()))
+        Candidates.push_back(AI);
+
+  // PromoteMemToReg builds SSA for the whole batch with one dominance
+  // frontier computation, and handles single-store and single-block allocas
+  // without it.
   std::vector<AllocaInst*> Allocas;
   while (1) {
     Allocas.clear();
 
-    // Find allocas that are safe to promote, by looking at all instructions in
-    // the entry node
-    for (BasicBlock::iterator I = BB.begin(), E = --BB.end(); I != E; ++I)
-      if (AllocaInst *AI = dyn_cast<AllocaInst>(I))       // Is it an alloca?
-        if (isAllocaPromotable(AI) &&
-          (!HLModule::HasPreciseAttributeWithMetadata(AI) || !ContainsFloatingPointType(AI->getAllocatedType())))
-          Allocas.push_back(AI);
+    // Find allocas that are safe to promote. Keep the rest for the next
+    // round, in their original order.
+    unsigned NumRemaining = 0;
+    for (AllocaInst *AI : Candidates) {
+      if (isAllocaPromotable(AI))
+        Allocas.push_back(AI);
+      else
+        Candidates[NumRemaining++] = AI;
+    }
+    Candidates.resize(NumRemaining);
 
     if (Allocas.empty()) break;
 
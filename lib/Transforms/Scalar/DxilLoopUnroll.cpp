@@ -61,6 +61,7 @@
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -81,6 +82,7 @@
 
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/HLSL/HLModule.h"
+#include "dxc/Support/DxcCompileDeadline.h"
 #include "llvm/Analysis/DxilValueCache.h"
 
 using namespace llvm;
@@ -114,10 +116,15 @@ public:
 
   std::unordered_set<Function *> CleanedUpAlloca;
   const unsigned MaxIterationAttempt;
+  // Limit on the instructions the unrolled copies may add, so a large body
+  // cannot be cloned up to MaxIterationAttempt times.
+  const unsigned MaxUnrolledInstructions;
 
-  DxilLoopUnroll(unsigned MaxIterationAttempt = 1024) :
+  DxilLoopUnroll(unsigned MaxIterationAttempt = 1024,
+                 unsigned MaxUnrolledInstructions = 1 << 20) :
     LoopPass(ID),
-    MaxIterationAttempt(MaxIterationAttempt)
+    MaxIterationAttempt(MaxIterationAttempt),
+    MaxUnrolledInstructions(MaxUnrolledInstructions)
   {
     initializeDxilLoopUnrollPass(*PassRegistry::getPassRegistry());
   }
@@ -610,6 +617,93 @@ static bool BreakUpArrayAllocas(bool AllowOOBIndex, IteratorT ItBegin, IteratorT
   return Success;
 }
 
+namespace {
+// Folds the latch condition of a loop one iteration at a time, starting from
+// the values the header PHIs take on entry. Only arithmetic, compares, casts
+// and selects inside the loop are followed; values from outside the loop
+// come from DxilValueCache.
+class LoopExitEvaluator {
+public:
+  enum class Result { Unknown, Exits, NeverExits };
+
+  LoopExitEvaluator(Loop *L, DxilValueCache *DVC, const DataLayout &DL)
+      : L(L), DVC(DVC), DL(DL) {}
+
+  // On Exits, *pTripCount is the iteration whose latch leaves the loop.
+  Result Evaluate(ArrayRef<PHINode *> PHIs, BasicBlock *Predecessor,
+                  BasicBlock *Latch, unsigned MaxAttempt,
+                  unsigned *pTripCount) {
+    BranchInst *LatchBr = cast<BranchInst>(Latch->getTerminator());
+    for (PHINode *PN : PHIs)
+      Values[PN] = Get(PN->getIncomingValueForBlock(Predecessor));
+
+    SmallVector<Constant *, 16> NextValues;
+    for (unsigned IterationI = 0; IterationI < MaxAttempt; IterationI++) {
+      bool Cond = false;
+      Constant *C = Get(LatchBr->getCondition());
+      if (!C || !GetConstantI1(C, &Cond))
+        return Result::Unknown;
+      if (LatchBr->getSuccessor(Cond ? 0 : 1) != L->getHeader()) {
+        *pTripCount = IterationI + 1;
+        return Result::Exits;
+      }
+
+      NextValues.clear();
+      for (PHINode *PN : PHIs)
+        NextValues.push_back(Get(PN->getIncomingValueForBlock(Latch)));
+      Values.clear();
+      for (unsigned i = 0; i < PHIs.size(); i++)
+        Values[PHIs[i]] = NextValues[i];
+    }
+    return Result::NeverExits;
+  }
+
+private:
+  Constant *Get(Value *V) {
+    if (Constant *C = dyn_cast<Constant>(V))
+      return C;
+    auto It = Values.find(V);
+    if (It != Values.end())
+      return It->second;
+
+    Instruction *I = dyn_cast<Instruction>(V);
+    if (!I || !L->contains(I)) {
+      auto InvIt = Invariants.find(V);
+      if (InvIt != Invariants.end())
+        return InvIt->second;
+      return Invariants[V] = DVC->GetConstValue(V);
+    }
+
+    Constant *Result = nullptr;
+    if (isa<BinaryOperator>(I) || isa<CastInst>(I) || isa<CmpInst>(I) ||
+        isa<SelectInst>(I)) {
+      SmallVector<Constant *, 3> Ops;
+      for (Value *Op : I->operands()) {
+        Constant *OpC = Get(Op);
+        if (!OpC)
+          break;
+        Ops.push_back(OpC);
+      }
+      if (Ops.size() == I->getNumOperands()) {
+        if (CmpInst *Cmp = dyn_cast<CmpInst>(I))
+          Result = ConstantFoldCompareInstOperands(Cmp->getPredicate(), Ops[0],
+                                                   Ops[1], DL);
+        else
+          Result = ConstantFoldInstOperands(I->getOpcode(), I->getType(), Ops,
+                                            DL);
+      }
+    }
+    return Values[I] = Result;
+  }
+
+  Loop *L;
+  DxilValueCache *DVC;
+  const DataLayout &DL;
+  DenseMap<Value *, Constant *> Values;     // For the current iteration
+  DenseMap<Value *, Constant *> Invariants; // Defined outside the loop
+};
+} // namespace
+
 static void RecursivelyRemoveLoopFromQueue(LPPassManager &LPM, Loop *L) {
   // Copy the sub loops into a separate list because
   // the original list may change.
@@ -789,6 +883,27 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   bool Succeeded = false;
 
   unsigned MaxAttempt = this->MaxIterationAttempt;
+
+  // SCEV only handles simple induction variables. Before falling back to
+  // cloning the body until the exit condition folds, try folding it without
+  // cloning. This also fails a loop that provably never exits in time
+  // without cloning it MaxAttempt times first.
+  if (TripCount == 0 && !HasExplicitLoopCount) {
+    LoopExitEvaluator Evaluator(L, DVC, DL);
+    unsigned EvaluatedTripCount = 0;
+    switch (Evaluator.Evaluate(PHIs, Predecessor, Latch, MaxAttempt,
+                               &EvaluatedTripCount)) {
+    case LoopExitEvaluator::Result::Exits:
+      TripCount = EvaluatedTripCount;
+      break;
+    case LoopExitEvaluator::Result::NeverExits:
+      MaxAttempt = 0;
+      break;
+    case LoopExitEvaluator::Result::Unknown:
+      break;
+    }
+  }
+
   // If we were able to figure out the definitive trip count,
   // just unroll that many times.
   if (TripCount != 0) {
@@ -798,8 +913,22 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     MaxAttempt = ExplicitUnrollCount;
   }
 
+  unsigned BodySize = 0;
+  for (BasicBlock *BB : ToBeCloned)
+    BodySize += BB->size();
+  bool TooLarge = false;
+
   for (unsigned IterationI = 0; IterationI < MaxAttempt; IterationI++) {
 
+    // Each attempt clones the whole body, so this is where an unbounded
+    // loop spends its time.
+    hlsl::CheckCompileDeadline();
+
+    if ((uint64_t)(IterationI + 1) * BodySize > MaxUnrolledInstructions) {
+      TooLarge = true;
+      break;
+    }
+
     LoopIteration *PrevIteration = nullptr;
     if (Iterations.size())
       PrevIteration = Iterations.back().get();
@@ -1022,6 +1151,8 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   // If we were unsuccessful in unrolling the loop
   else {
     const char *Msg =
+        TooLarge ?
+        "Could not unroll loop. The unrolled loop would be too large." :
         "Could not unroll loop. Loop bound could not be deduced at compile time. "
         "Use [unroll(n)] to give an explicit count.";
     if (FxcCompatMode) {
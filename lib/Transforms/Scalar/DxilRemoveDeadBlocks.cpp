@@ -100,6 +100,8 @@ static bool EraseDeadBlocks(Function &F, DxilValueCache *DVC) {
       BranchInst *NewBr = BranchInst::Create(Other, Br);
       hlsl::DxilMDHelper::CopyMetadata(*NewBr, *Br);
       Br->eraseFromParent();
+      // Other may now have a single predecessor.
+      DVC->Invalidate(Other);
     }
 
     // Fix phi nodes in successors
@@ -108,8 +110,14 @@ static bool EraseDeadBlocks(Function &F, DxilValueCache *DVC) {
       if (!Seen.count(SuccBB)) continue;
       for (auto inst_it = SuccBB->begin(); inst_it != SuccBB->end();) {
         Instruction *I = &*(inst_it++);
-        if (PHINode *PN = dyn_cast<PHINode>(I))
+        if (PHINode *PN = dyn_cast<PHINode>(I)) {
+          // Fewer incoming values may resolve what could not be before. A
+          // PHI deleted once empty is seen by the value handles instead.
+          bool bErased = PN->getNumIncomingValues() == 1;
           PN->removeIncomingValue(BB, true);
+          if (!bErased)
+            DVC->Invalidate(PN);
+        }
         else
           break;
       }
@@ -26,6 +26,10 @@
 // non-constant values are written. The uninitialized values will be hoisted 
 // as undef values.
 //
+// Arrays of arrays are hoisted too, so that a multi-dimensional lookup table
+// does not stay in local memory when it is indexed dynamically. Elements are
+// tracked by their position in the flattened array.
+//
 // Improvements:
 // Currently we do not merge arrays that have the same constant values. We
 // create the global variables with `unnamed_addr` set which means they
@@ -124,6 +128,7 @@ namespace {
   private:
     AllocaInst *m_Alloca;
     ArrayType *m_ArrayType;
+    Type *m_ElementType;
     std::vector<Constant *> m_Values;
     bool m_IsConstArray;
 
@@ -135,6 +140,7 @@ namespace {
     bool AllArrayUsersAreGEP(std::vector<GEPOperator *> &geps);
     bool AllGEPUsersAreValid(GEPOperator *gep);
     UndefValue *UndefElement();
+    Constant *GetInitializer(Type *Ty, size_t &index) const;
   };
 }
 
@@ -144,8 +150,25 @@ static ArrayType *getAllocaArrayType(AllocaInst *allocaInst) {
   return dyn_cast<ArrayType>(allocaInst->getType()->getPointerElementType());
 }
 
+// Returns the primitive type at the bottom of a (possibly nested) array type.
+static Type *getArrayElementType(Type *Ty) {
+  while (ArrayType *AT = dyn_cast<ArrayType>(Ty))
+    Ty = AT->getElementType();
+  return Ty;
+}
+
+// Returns the number of primitive elements in Ty.
+static uint64_t getFlatElementCount(Type *Ty) {
+  uint64_t count = 1;
+  while (ArrayType *AT = dyn_cast<ArrayType>(Ty)) {
+    count *= AT->getNumElements();
+    Ty = AT->getElementType();
+  }
+  return count;
+}
+
 // Check if the instruction is an alloca that we should consider for hoisting.
-// The alloca must allocate and array of primitive types.
+// The alloca must allocate and array, or array of arrays, of primitive types.
 static AllocaInst *isHoistableArrayAlloca(Instruction *I) {
   AllocaInst *allocaInst = dyn_cast<AllocaInst>(I);
   if (!allocaInst)
@@ -155,7 +178,7 @@ static AllocaInst *isHoistableArrayAlloca(Instruction *I) {
   if (!arrayTy)
     return nullptr;
 
-  if (!arrayTy->getElementType()->isSingleValueType())
+  if (!getArrayElementType(arrayTy)->isSingleValueType())
     return nullptr;
 
   return allocaInst;
@@ -173,13 +196,26 @@ CandidateArray::CandidateArray(AllocaInst *AI)
 {
   assert(isHoistableArrayAlloca(AI));
   m_ArrayType = getAllocaArrayType(AI);
+  m_ElementType = getArrayElementType(m_ArrayType);
+}
+
+// Build the initializer for Ty from the flattened values, starting at index.
+Constant *CandidateArray::GetInitializer(Type *Ty, size_t &index) const {
+  ArrayType *AT = dyn_cast<ArrayType>(Ty);
+  if (!AT)
+    return m_Values[index++];
+  std::vector<Constant *> elements;
+  for (uint64_t i = 0; i < AT->getNumElements(); ++i)
+    elements.push_back(GetInitializer(AT->getElementType(), index));
+  return ConstantArray::get(AT, elements);
 }
 
 // Get the global variable with a constant initializer for the array.
 // Only valid to call if the array has been analyzed as a constant array.
 GlobalVariable *CandidateArray::GetGlobalArray() const {
   assert(IsConstArray());
-  Constant *initializer = ConstantArray::get(m_ArrayType, m_Values);
+  size_t index = 0;
+  Constant *initializer = GetInitializer(m_ArrayType, index);
   Module *M = m_Alloca->getModule();
   GlobalVariable *GV = new GlobalVariable(*M, m_ArrayType, true, GlobalVariable::LinkageTypes::InternalLinkage, initializer, Twine(m_Alloca->getName()) + ".hca");
   GV->setUnnamedAddr(true);
@@ -271,9 +307,11 @@ void CandidateArray::AnalyzeUses() {
 // Analyze a store to see if it is a valid constant store.
 // A valid store will write a constant value to a known (constant) location.
 bool CandidateArray::AnalyzeStore(StoreInst *SI) {
-  if (!isa<Constant>(SI->getValueOperand()))
+  if (!isa<Constant>(SI->getValueOperand()) ||
+      SI->getValueOperand()->getType() != m_ElementType)
     return false;
   // Walk up the ladder of GetElementPtr instructions to accumulate the index
+  // into the flattened array.
   int64_t index = 0;
   for (auto iter = SI->getPointerOperand(); iter != m_Alloca;) {
     GEPOperator *gep = cast<GEPOperator>(iter);
@@ -282,20 +320,24 @@ bool CandidateArray::AnalyzeStore(StoreInst *SI) {
 
     // Deal with the 'extra 0' index from what might have been a global pointer
     // https://www.llvm.org/docs/GetElementPtr.html#why-is-the-extra-0-index-required
-    if ((gep->getNumIndices() == 2) && (gep->getPointerOperand() == m_Alloca)) {
-      // Non-zero offset is unexpected, but could occur in the wild. Bail out if
-      // we see it.
-      ConstantInt *ptrOffset = cast<ConstantInt>(gep->getOperand(1));
-      if (!ptrOffset->isZero())
-        return false;
-    }
-    else if (gep->getNumIndices() != 1) {
+    // Non-zero offset is unexpected, but could occur in the wild. Bail out if
+    // we see it.
+    if (gep->getPointerOperand() == m_Alloca &&
+        !cast<ConstantInt>(gep->getOperand(1))->isZero())
       return false;
-    }
 
-    // Accumulate the index
-    ConstantInt *c = cast<ConstantInt>(gep->getOperand(gep->getNumIndices()));
-    index += c->getSExtValue();
+    // Accumulate the index, scaled by the number of elements each index steps
+    // over.
+    Type *Ty = gep->getSourceElementType();
+    auto idx = gep->idx_begin();
+    index += cast<ConstantInt>(*idx)->getSExtValue() * getFlatElementCount(Ty);
+    for (++idx; idx != gep->idx_end(); ++idx) {
+      ArrayType *AT = dyn_cast<ArrayType>(Ty);
+      if (!AT)
+        return false;
+      Ty = AT->getElementType();
+      index += cast<ConstantInt>(*idx)->getSExtValue() * getFlatElementCount(Ty);
+    }
 
     iter = gep->getPointerOperand();
   }
@@ -310,7 +352,7 @@ bool CandidateArray::AnalyzeStore(StoreInst *SI) {
 bool CandidateArray::StoreConstant(int64_t index, Constant *value) {
   EnsureSize();
   size_t i = static_cast<size_t>(index);
-  if (i >= m_Values.size())
+  if (index < 0 || i >= m_Values.size())
     return false;
   if (m_Values[i] == UndefElement())
     m_Values[i] = value;
@@ -323,14 +365,14 @@ bool CandidateArray::StoreConstant(int64_t index, Constant *value) {
 // for obviously non-constant arrays.
 void CandidateArray::EnsureSize() {
   if (m_Values.size() == 0) {
-    m_Values.resize(m_ArrayType->getNumElements(), UndefElement());
+    m_Values.resize(getFlatElementCount(m_ArrayType), UndefElement());
   }
-  assert(m_Values.size() == m_ArrayType->getNumElements());
+  assert(m_Values.size() == getFlatElementCount(m_ArrayType));
 }
 
 // Get an undef value of the correct type for the array.
 UndefValue *CandidateArray::UndefElement() {
-  return UndefValue::get(m_ArrayType->getElementType());
+  return UndefValue::get(m_ElementType);
 }
 
 
@@ -16,6 +16,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CodeMetrics.h"
+#include "llvm/Analysis/DxilLiveValues.h" // HLSL Change
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/ScalarEvolution.h"
@@ -26,6 +27,7 @@
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/InstVisitor.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -100,7 +102,9 @@ namespace {
   class LoopUnroll : public LoopPass {
   public:
     static char ID; // Pass ID, replacement for typeid
-    LoopUnroll(int T = -1, int C = -1, int P = -1, int R = -1) : LoopPass(ID) {
+    LoopUnroll(int T = -1, int C = -1, int P = -1, int R = -1,
+               unsigned MaxLiveScalars = 0) // HLSL Change
+        : LoopPass(ID), MaxLiveScalars(MaxLiveScalars) { // HLSL Change
       CurrentThreshold = (T == -1) ? unsigned(UnrollThreshold) : unsigned(T);
       CurrentPercentDynamicCostSavedThreshold =
           UnrollPercentDynamicCostSavedThreshold;
@@ -150,6 +154,11 @@ namespace {
     bool UserAllowPartial;
     bool UserRuntime;
 
+    // HLSL Change Begin - most scalars unrolling may leave live; 0 for no
+    // limit.
+    unsigned MaxLiveScalars;
+    // HLSL Change End
+
     bool runOnLoop(Loop *L, LPPassManager &LPM) override;
 
     /// This transformation requires natural loop information & requires that
@@ -262,8 +271,10 @@ INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
 INITIALIZE_PASS_END(LoopUnroll, "loop-unroll", "Unroll loops", false, false)
 
 Pass *llvm::createLoopUnrollPass(int Threshold, int Count, int AllowPartial,
-                                 int Runtime) {
-  return new LoopUnroll(Threshold, Count, AllowPartial, Runtime);
+                                 int Runtime,
+                                 unsigned MaxLiveScalars) { // HLSL Change
+  return new LoopUnroll(Threshold, Count, AllowPartial, Runtime,
+                        MaxLiveScalars); // HLSL Change
 }
 
 Pass *llvm::createSimpleLoopUnrollPass() {
@@ -757,6 +768,63 @@ unsigned LoopUnroll::selectUnrollCount(
   return Count;
 }
 
+// HLSL Change Begin - skip cold loops.
+// Returns true if branch weights from an execution profile show that the loop
+// is never entered. Walks up from the preheader to the conditional branch
+// that decides whether the loop runs.
+static bool IsLoopColdByProfile(const Loop *L) {
+  const BasicBlock *BB = L->getLoopPreheader();
+  if (!BB)
+    return false;
+  for (unsigned Depth = 0; Depth < 8; ++Depth) {
+    const BasicBlock *Pred = BB->getSinglePredecessor();
+    if (!Pred)
+      return false;
+    const TerminatorInst *TI = Pred->getTerminator();
+    if (TI->getNumSuccessors() == 1) {
+      BB = Pred;
+      continue;
+    }
+    MDNode *WeightsNode = TI->getMetadata(LLVMContext::MD_prof);
+    if (!WeightsNode ||
+        WeightsNode->getNumOperands() != TI->getNumSuccessors() + 1)
+      return false;
+    MDString *Name = dyn_cast<MDString>(WeightsNode->getOperand(0));
+    if (!Name || !Name->getString().equals("branch_weights"))
+      return false;
+    uint64_t TotalWeight = 0, EnterWeight = 0;
+    for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i) {
+      ConstantInt *Weight =
+          mdconst::dyn_extract<ConstantInt>(WeightsNode->getOperand(i + 1));
+      if (!Weight)
+        return false;
+      TotalWeight += Weight->getZExtValue();
+      if (TI->getSuccessor(i) == BB)
+        EnterWeight += Weight->getZExtValue();
+    }
+    return TotalWeight != 0 && EnterWeight == 0;
+  }
+  return false;
+}
+
+// Returns the largest unroll count that keeps the estimated live scalars of
+// L within MaxLiveScalars. Unrolled copies of the body are scheduled
+// together, so each copy is taken to keep its own values live at once, on
+// top of the values live through the loop.
+static unsigned GetMaxCountForPressure(Loop *L, unsigned MaxLiveScalars) {
+  DxilLiveValues LiveValues;
+  LiveValues.compute(*L->getHeader()->getParent());
+  unsigned LiveThrough = LiveValues.getLiveThroughScalars(L);
+  unsigned LoopPeak = LiveValues.getPeakLiveScalars(L);
+  if (LoopPeak >= MaxLiveScalars)
+    return 1;
+  unsigned PerIteration = LoopPeak - std::min(LoopPeak, LiveThrough);
+  if (PerIteration == 0)
+    return UINT_MAX;
+  return std::max(1u, (MaxLiveScalars - LiveThrough) / PerIteration);
+}
+// HLSL Change End
+
 bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   if (skipOptnoneFunction(L))
     return false;
@@ -780,6 +848,13 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   unsigned PragmaCount = UnrollCountPragmaValue(L);
   bool HasPragma = PragmaFullUnroll || PragmaCount > 0;
 
+  // HLSL Change Begin - don't grow code the profile never runs.
+  if (!HasPragma && IsLoopColdByProfile(L)) {
+    DEBUG(dbgs() << "  Not unrolling loop that the profile never enters.\n");
+    return false;
+  }
+  // HLSL Change End
+
   TargetTransformInfo::UnrollingPreferences UP;
   getUnrollingPreferences(L, TTI, UP);
 
@@ -896,6 +971,27 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     DEBUG(dbgs() << "  partially unrolling with count: " << Count << "\n");
   }
 
+  // HLSL Change Begin - don't unroll past the register pressure limit.
+  // Unrolling that would lose occupancy is usually slower than the loop.
+  if (!HasPragma && MaxLiveScalars != 0 && Count > 1) {
+    unsigned MaxCount = GetMaxCountForPressure(L, MaxLiveScalars);
+    if (Count > MaxCount) {
+      DEBUG(dbgs() << "  limiting unroll count to " << MaxCount
+                   << " for register pressure.\n");
+      if (Unrolling == Full)
+        return false;
+      if (Unrolling == Partial) {
+        Count = MaxCount;
+        while (Count != 0 && TripCount % Count != 0)
+          Count--;
+      } else {
+        while (Count > MaxCount)
+          Count >>= 1;
+      }
+    }
+  }
+  // HLSL Change End
+
   if (HasPragma) {
     if (PragmaCount != 0)
       // If loop has an unroll count pragma mark loop as unrolled to prevent
@@ -14,6 +14,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
@@ -59,6 +60,7 @@
 #include "dxc/HLSL/HLMatrixType.h"
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/HLSL/HLLowerUDT.h"
+#include "dxc/Support/DxcCompileDeadline.h"
 #include <deque>
 #include <unordered_map>
 #include <unordered_set>
@@ -74,6 +76,30 @@ STATISTIC(NumAdjusted, "Number of scalar allocas adjusted to allow promotion");
 
 namespace {
 
+// PostDominatorTree for one function at a time, built on first use.
+// LowerMemcpy needs one for each value stored by a single memcpy, so without
+// this it is rebuilt for every such alloca or global. Whoever changes the CFG
+// must call invalidate().
+class PostDomTreeCache {
+public:
+  PostDominatorTree &get(Function &F) {
+    if (!PDT || CachedF != &F) {
+      PDT.reset(new PostDominatorTree());
+      PDT->runOnFunction(F);
+      CachedF = &F;
+    }
+    return *PDT;
+  }
+  void invalidate() {
+    PDT.reset();
+    CachedF = nullptr;
+  }
+
+private:
+  Function *CachedF = nullptr;
+  std::unique_ptr<PostDominatorTree> PDT;
+};
+
 class SROA_Helper {
 public:
   // Split V into AllocaInsts with Builder and save the new AllocaInsts into Elts.
@@ -83,7 +109,8 @@ public:
                                   IRBuilder<> &Builder, bool bFlatVector,
                                   bool hasPrecise, DxilTypeSystem &typeSys,
                                   const DataLayout &DL,
-                                  SmallVector<Value *, 32> &DeadInsts);
+                                  SmallVector<Value *, 32> &DeadInsts,
+                                  PostDomTreeCache *PDTCache = nullptr);
 
   static bool DoScalarReplacement(GlobalVariable *GV, std::vector<Value *> &Elts,
                                   IRBuilder<> &Builder, bool bFlatVector,
@@ -93,17 +120,20 @@ public:
   static unsigned GetEltAlign(unsigned ValueAlign, const DataLayout &DL,
                               Type *EltTy, unsigned Offset);
   // Lower memcpy related to V.
+  // PDTCache, if given, is reused for the post dominance checks.
   static bool LowerMemcpy(Value *V, DxilFieldAnnotation *annotation,
                           DxilTypeSystem &typeSys, const DataLayout &DL,
-                          bool bAllowReplace);
+                          bool bAllowReplace,
+                          PostDomTreeCache *PDTCache = nullptr);
   static void MarkEmptyStructUsers(Value *V,
                                    SmallVector<Value *, 32> &DeadInsts);
   static bool IsEmptyStructType(Type *Ty, DxilTypeSystem &typeSys);
 private:
   SROA_Helper(Value *V, ArrayRef<Value *> Elts,
               SmallVector<Value *, 32> &DeadInsts, DxilTypeSystem &ts,
-              const DataLayout &dl)
-      : OldVal(V), NewElts(Elts), DeadInsts(DeadInsts), typeSys(ts), DL(dl) {}
+              const DataLayout &dl, PostDomTreeCache *pdtCache = nullptr)
+      : OldVal(V), NewElts(Elts), DeadInsts(DeadInsts), typeSys(ts), DL(dl),
+        PDTCache(pdtCache) {}
   void RewriteForScalarRepl(Value *V, IRBuilder<> &Builder);
 
 private:
@@ -114,6 +144,7 @@ private:
   SmallVector<Value *, 32> &DeadInsts;
   DxilTypeSystem  &typeSys;
   const DataLayout &DL;
+  PostDomTreeCache *PDTCache;
 
   void RewriteForConstExpr(ConstantExpr *user, IRBuilder<> &Builder);
   void RewriteForGEP(GEPOperator *GEP, IRBuilder<> &Builder);
@@ -1104,16 +1135,30 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
   // alloca. Big alloca will be split to smaller piece first, when process the
   // alloca, it will be alloca flattened from big alloca instead of a GEP of big
   // alloca.
-  auto size_cmp = [&DL](const AllocaInst *a0, const AllocaInst *a1) -> bool {
-    Type* a0ty = a0->getAllocatedType();
-    Type* a1ty = a1->getAllocatedType();
-    bool isUnitSzStruct0 = a0ty->isStructTy() && a0ty->getStructNumElements() == 1;
-    bool isUnitSzStruct1 = a1ty->isStructTy() && a1ty->getStructNumElements() == 1;
-    auto sz0 = DL.getTypeAllocSize(a0ty);
-    auto sz1 = DL.getTypeAllocSize(a1ty);
-    if (sz0 == sz1 && (isUnitSzStruct0 || isUnitSzStruct1))
-      return getNestedLevelInStruct(a0ty) < getNestedLevelInStruct(a1ty);
-    return sz0 < sz1;
+  // The queue compares the same few types over and over, so keep the size
+  // and struct nesting level of each type.
+  struct SortKey {
+    uint64_t Size;
+    unsigned NestedLevel;
+    bool IsUnitSzStruct;
+  };
+  DenseMap<Type *, SortKey> SortKeys;
+  auto getSortKey = [&DL, &SortKeys](Type *Ty) -> SortKey {
+    auto It = SortKeys.find(Ty);
+    if (It != SortKeys.end())
+      return It->second;
+    SortKey Key = {DL.getTypeAllocSize(Ty), getNestedLevelInStruct(Ty),
+                   Ty->isStructTy() && Ty->getStructNumElements() == 1};
+    SortKeys[Ty] = Key;
+    return Key;
+  };
+  auto size_cmp = [&getSortKey](const AllocaInst *a0,
+                                const AllocaInst *a1) -> bool {
+    SortKey Key0 = getSortKey(a0->getAllocatedType());
+    SortKey Key1 = getSortKey(a1->getAllocatedType());
+    if (Key0.Size == Key1.Size && (Key0.IsUnitSzStruct || Key1.IsUnitSzStruct))
+      return Key0.NestedLevel < Key1.NestedLevel;
+    return Key0.Size < Key1.Size;
   };
   std::priority_queue<AllocaInst *, std::vector<AllocaInst *>,
                       std::function<bool(AllocaInst *, AllocaInst *)>>
@@ -1130,10 +1175,14 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
     }
 
   DIBuilder DIB(*F.getParent(), /*AllowUnresolved*/ false);
+  // Nothing below changes the CFG, so one post dominator tree serves every
+  // alloca.
+  PostDomTreeCache PDTCache;
 
   // Process the worklist
   bool Changed = false;
   while (!WorkList.empty()) {
+    hlsl::CheckCompileDeadline();
     AllocaInst *AI = WorkList.top();
     WorkList.pop();
 
@@ -1146,7 +1195,7 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
     }
     const bool bAllowReplace = true;
     if (SROA_Helper::LowerMemcpy(AI, /*annotation*/ nullptr, typeSys, DL,
-                                 bAllowReplace)) {
+                                 bAllowReplace, &PDTCache)) {
       Changed = true;
       continue;
     }
@@ -1195,7 +1244,7 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
       uint64_t NumInstances = 1;
       bool SROAed = SROA_Helper::DoScalarReplacement(
         AI, Elts, BrokenUpTy, NumInstances, Builder,
-        /*bFlatVector*/ true, hasPrecise, typeSys, DL, DeadInsts);
+        /*bFlatVector*/ true, hasPrecise, typeSys, DL, DeadInsts, &PDTCache);
 
       if (SROAed) {
         Type *Ty = AI->getAllocatedType();
@@ -2268,8 +2317,9 @@ void SROA_Helper::RewriteForGEP(GEPOperator *GEP, IRBuilder<> &Builder) {
         NewGEPs.emplace_back(NewGEP);
       }
       const bool bAllowReplace = isa<AllocaInst>(OldVal);
-      if (!SROA_Helper::LowerMemcpy(GEP, /*annoation*/ nullptr, typeSys, DL, bAllowReplace)) {
-        SROA_Helper helper(GEP, NewGEPs, DeadInsts, typeSys, DL);
+      if (!SROA_Helper::LowerMemcpy(GEP, /*annoation*/ nullptr, typeSys, DL,
+                                    bAllowReplace, PDTCache)) {
+        SROA_Helper helper(GEP, NewGEPs, DeadInsts, typeSys, DL, PDTCache);
         helper.RewriteForScalarRepl(GEP, Builder);
         for (Value *NewGEP : NewGEPs) {
           if (NewGEP->user_empty() && isa<Instruction>(NewGEP)) {
@@ -3026,7 +3076,8 @@ bool SROA_Helper::DoScalarReplacement(Value *V, std::vector<Value *> &Elts,
                                       IRBuilder<> &Builder, bool bFlatVector,
                                       bool hasPrecise, DxilTypeSystem &typeSys,
                                       const DataLayout &DL,
-                                      SmallVector<Value *, 32> &DeadInsts) {
+                                      SmallVector<Value *, 32> &DeadInsts,
+                                      PostDomTreeCache *PDTCache) {
   DEBUG(dbgs() << "Found inst to SROA: " << *V << '\n');
   Type *Ty = V->getType();
   // Skip none pointer types.
@@ -3156,7 +3207,7 @@ bool SROA_Helper::DoScalarReplacement(Value *V, std::vector<Value *> &Elts,
   
   // Now that we have created the new alloca instructions, rewrite all the
   // uses of the old alloca.
-  SROA_Helper helper(V, Elts, DeadInsts, typeSys, DL);
+  SROA_Helper helper(V, Elts, DeadInsts, typeSys, DL, PDTCache);
   helper.RewriteForScalarRepl(V, Builder);
 
   return true;
@@ -3834,15 +3885,21 @@ static bool ReplaceUseOfZeroInitPostDom(Instruction *I, Value *V,
 }
 // When zero initialized GV has only one define, all uses before the def should
 // use zero.
-static bool ReplaceUseOfZeroInitBeforeDef(Instruction *I, GlobalVariable *GV) {
+static bool ReplaceUseOfZeroInitBeforeDef(Instruction *I, GlobalVariable *GV,
+                                          PostDomTreeCache *PDTCache) {
   BasicBlock *BB = I->getParent();
   Function *F = I->getParent()->getParent();
   // Make sure I is the last inst for BB.
-  if (I != BB->getTerminator())
+  if (I != BB->getTerminator()) {
     BB->splitBasicBlock(I->getNextNode());
+    if (PDTCache)
+      PDTCache->invalidate();
+  }
 
   if (&F->getEntryBlock() == I->getParent()) {
     return ReplaceUseOfZeroInitEntry(I, GV);
+  } else if (PDTCache) {
+    return ReplaceUseOfZeroInitPostDom(I, GV, PDTCache->get(*F));
   } else {
     // Post dominator tree.
     PostDominatorTree PDT;
@@ -3874,13 +3931,17 @@ static bool DominateAllUsersPostDom(Instruction *I, Value *V,
 }
 
 // Determine if `I` dominates all the users of `V`
-static bool DominateAllUsers(Instruction *I, Value *V) {
+static bool DominateAllUsers(Instruction *I, Value *V,
+                             PostDomTreeCache *PDTCache) {
   Function *F = I->getParent()->getParent();
 
   // The Entry Block dominates everything, trivially true
   if (&F->getEntryBlock() == I->getParent())
     return true;
 
+  if (PDTCache)
+    return DominateAllUsersPostDom(I, V, PDTCache->get(*F));
+
   // Post dominator tree.
   PostDominatorTree PDT;
   PDT.runOnFunction(*F);
@@ -3890,7 +3951,7 @@ static bool DominateAllUsers(Instruction *I, Value *V) {
 
 bool SROA_Helper::LowerMemcpy(Value *V, DxilFieldAnnotation *annotation,
                               DxilTypeSystem &typeSys, const DataLayout &DL,
-                              bool bAllowReplace) {
+                              bool bAllowReplace, PostDomTreeCache *PDTCache) {
   Type *Ty = V->getType();
   if (!Ty->isPointerTy()) {
     return false;
@@ -3919,7 +3980,7 @@ bool SROA_Helper::LowerMemcpy(Value *V, DxilFieldAnnotation *annotation,
         // call set inside entry function then use a2.
         if (isa<ConstantAggregateZero>(GV->getInitializer())) {
           Instruction * Memcpy = PS.StoringMemcpy;
-          if (!ReplaceUseOfZeroInitBeforeDef(Memcpy, GV)) {
+          if (!ReplaceUseOfZeroInitBeforeDef(Memcpy, GV, PDTCache)) {
             PS.storedType = PointerStatus::StoredType::Stored;
           }
         }
@@ -3932,7 +3993,7 @@ bool SROA_Helper::LowerMemcpy(Value *V, DxilFieldAnnotation *annotation,
     // full replacement isn't possible without complicated PHI insertion
     // This will likely replace with ld/st which will be replaced in mem2reg
     Instruction *Memcpy = PS.StoringMemcpy;
-    if (!DominateAllUsers(Memcpy, V)) {
+    if (!DominateAllUsers(Memcpy, V, PDTCache)) {
       PS.storedType = PointerStatus::StoredType::Stored;
       // Replacing a memcpy with a memcpy with the same signature will just bring us back here
       bEltMemcpy = false;
@@ -4004,7 +4065,8 @@ bool SROA_Helper::LowerMemcpy(Value *V, DxilFieldAnnotation *annotation,
             ReplaceMemcpy(Dest, V, MC, annotation, typeSys, DL);
             // V still need to be flatten.
             // Lower memcpy come from Dest.
-            return LowerMemcpy(V, annotation, typeSys, DL, bAllowReplace);
+            return LowerMemcpy(V, annotation, typeSys, DL, bAllowReplace,
+                               PDTCache);
           }
         }
       }
@@ -4414,6 +4476,7 @@ void SROA_Parameter_HLSL::flattenGlobal(GlobalVariable *GV) {
   const DataLayout &DL = GV->getParent()->getDataLayout();
   unsigned debugOffset = 0;
   std::unordered_map<Value*, StringRef> EltNameMap;
+  PostDomTreeCache PDTCache;
   // Process the worklist
   while (!WorkList.empty()) {
     GlobalVariable *EltGV = cast<GlobalVariable>(WorkList.front());
@@ -4421,7 +4484,7 @@ void SROA_Parameter_HLSL::flattenGlobal(GlobalVariable *GV) {
 
     const bool bAllowReplace = true;
     if (SROA_Helper::LowerMemcpy(EltGV, /*annoation*/ nullptr, dxilTypeSys, DL,
-                                 bAllowReplace)) {
+                                 bAllowReplace, &PDTCache)) {
       continue;
     }
 
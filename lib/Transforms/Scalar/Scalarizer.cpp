@@ -290,17 +290,21 @@ bool Scalarizer::doInitialization(Module &M) {
 }
 
 bool Scalarizer::runOnFunction(Function &F) {
+  bool Changed = false; // HLSL Change
   for (Function::iterator BBI = F.begin(), BBE = F.end(); BBI != BBE; ++BBI) {
     BasicBlock *BB = BBI;
     for (BasicBlock::iterator II = BB->begin(), IE = BB->end(); II != IE;) {
       Instruction *I = II;
       bool Done = visit(I);
       ++II;
-      if (Done && I->getType()->isVoidTy())
+      if (Done && I->getType()->isVoidTy()) {
         I->eraseFromParent();
+        Changed = true; // HLSL Change
+      }
     }
   }
-  return finish();
+  // HLSL Change - scalarized stores are not gathered, so report them too.
+  return finish() || Changed;
 }
 
 // Return a scattered form of V that can be accessed by Point.  V must be a
@@ -316,7 +320,7 @@ Scatterer Scalarizer::scatter(Instruction *Point, Value *V) {
     auto InsertPoint = BB->begin();
     while (InsertPoint != BB->end() && isa<DbgInfoIntrinsic>(InsertPoint))
       InsertPoint++;
-    Scatterer(BB, InsertPoint, V, AllowFolding, &Scattered[V]);
+    return Scatterer(BB, InsertPoint, V, AllowFolding, &Scattered[V]);
     // HLSL Change - End
   }
   if (Instruction *VOp = dyn_cast<Instruction>(V)) {
@@ -333,9 +337,10 @@ Scatterer Scalarizer::scatter(Instruction *Point, Value *V) {
   }
   // HLSL Change - Begin
   // Allow constant folding for Constant cases, so we don't
-  // put an instruction before a PHI node.
-  if (Constant *C = dyn_cast<Constant>(V)) {
-    if (isa<PHINode>(Point)) {
+  // put an instruction before a PHI node.  When folding is allowed anyway,
+  // the components are constants too, so share them across the function.
+  if (isa<Constant>(V)) {
+    if (isa<PHINode>(Point) || AllowFolding) {
       return Scatterer(Point->getParent(), Point,
                     V, /* allowFolding */ true, &Scattered[V]);
     }
@@ -783,10 +788,10 @@ bool Scalarizer::finish() {
           Value *Elt = CV[immIdx];
           // Try to find a map for Elt,if it's in EltMap.
           while (Instruction *EltI = dyn_cast<Instruction>(Elt)) {
-            if (EltMap.count(EltI)) {
-              Elt = EltMap[EltI];
-            } else
+            auto EltIt = EltMap.find(EltI);
+            if (EltIt == EltMap.end())
               break;
+            Elt = EltIt->second;
           }
 
           EEI->replaceAllUsesWith(Elt);
@@ -222,6 +222,12 @@ struct CFGSimplifyPass : public FunctionPass {
     AU.addRequired<AssumptionCacheTracker>();
     AU.addRequired<TargetTransformInfoWrapperPass>();
   }
+
+  // HLSL Change Begin - reruns are only equivalent with the same settings.
+  bool isIdempotent() const override {
+    return !PredicateFtor && BonusInstThreshold == UserBonusInstThreshold;
+  }
+  // HLSL Change End
 };
 }
 
@@ -1450,6 +1450,34 @@ static Value *isSafeToSpeculateStore(Instruction *I, BasicBlock *BrBB,
   return nullptr;
 }
 
+// HLSL Change Begins.
+/// Returns true if an execution profile shows that \p BI almost always goes
+/// the same way. Flattening such a branch makes every lane pay for the side
+/// that rarely runs, so it is better left as control flow.
+static bool IsPredictableByProfile(const TerminatorInst *BI) {
+  if (!BI || BI->getNumSuccessors() != 2)
+    return false;
+  MDNode *WeightsNode = BI->getMetadata(LLVMContext::MD_prof);
+  if (!WeightsNode || WeightsNode->getNumOperands() != 3)
+    return false;
+  MDString *Name = dyn_cast<MDString>(WeightsNode->getOperand(0));
+  if (!Name || !Name->getString().equals("branch_weights"))
+    return false;
+  ConstantInt *TrueWeight =
+      mdconst::dyn_extract<ConstantInt>(WeightsNode->getOperand(1));
+  ConstantInt *FalseWeight =
+      mdconst::dyn_extract<ConstantInt>(WeightsNode->getOperand(2));
+  if (!TrueWeight || !FalseWeight)
+    return false;
+  uint64_t Taken = TrueWeight->getZExtValue();
+  uint64_t NotTaken = FalseWeight->getZExtValue();
+  uint64_t Total = Taken + NotTaken;
+  if (Total == 0)
+    return false;
+  return std::max(Taken, NotTaken) * 100 >= Total * 99;
+}
+// HLSL Change Ends.
+
 /// \brief Speculate a conditional basic block flattening the CFG.
 ///
 /// Note that this is a very risky transform currently. Speculating
@@ -1494,6 +1522,10 @@ static bool SpeculativelyExecuteBB(BranchInst *BI, BasicBlock *ThenBB,
   if (hlsl::DxilMDHelper::HasControlFlowHintToPreventFlatten(BI)) {
     return false;
   }
+  // Keep branches that an execution profile shows to be one-sided.
+  if (IsPredictableByProfile(BI)) {
+    return false;
+  }
   // HLSL Change Ends.
 
   // Be conservative for now. FP select instruction can often be expensive.
@@ -1917,6 +1949,10 @@ static bool FoldTwoEntryPHINode(PHINode *PN, const TargetTransformInfo &TTI,
   if (hlsl::DxilMDHelper::HasControlFlowHintToPreventFlatten(InsertPt)) {
     return false;
   }
+  // Keep branches that an execution profile shows to be one-sided.
+  if (IsPredictableByProfile(dyn_cast<TerminatorInst>(InsertPt))) {
+    return false;
+  }
   // HLSL Change Ends.
   IRBuilder<true, NoFolder> Builder(InsertPt);
 
@@ -46,6 +46,9 @@ namespace {
       AU.addRequired<TargetLibraryInfoWrapperPass>();
     }
 
+    // HLSL Change - runOnFunction iterates to a fixed point.
+    bool isIdempotent() const override { return true; }
+
     /// runOnFunction - Remove instructions that simplify.
     bool runOnFunction(Function &F) override {
       const DominatorTreeWrapperPass *DTWP =
@@ -19,6 +19,8 @@
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/ADT/DenseMap.h"     // HLSL Change
+#include "llvm/ADT/SmallPtrSet.h"  // HLSL Change
 using namespace llvm;
 
 // Out of line method to get vtable etc for class.
@@ -155,20 +157,119 @@ static Metadata *mapToSelf(ValueToValueMapTy &VM, const Metadata *MD) {
   return mapToMetadata(VM, MD, const_cast<Metadata *>(MD));
 }
 
+// HLSL Change Begin
+namespace {
+/// Finds uniqued nodes that map to themselves without cloning them, which is
+/// how mapUniquedNode finds out. A uniqued node maps to itself when all of
+/// its operands do, and distinct nodes are always cloned. Debug types, TBAA
+/// and most DXIL metadata map to themselves, so a module-level clone would
+/// otherwise create and throw away a temporary for each of their nodes.
+///
+/// Nodes found to map to themselves are entered in the map. In a cycle, a
+/// node that depends on a node still being visited is only known to map to
+/// itself once that node is. One finder is shared by a whole MapMetadata
+/// call, so nodes already found to change are not walked again.
+class UnchangedMetadataFinder {
+  ValueToValueMapTy &VM;
+  RemapFlags Flags;
+  ValueMapTypeRemapper *TypeMapper;
+  ValueMaterializer *Materializer;
+  DenseMap<const MDNode *, unsigned> Visiting; // node to depth
+  SmallPtrSet<const MDNode *, 8> Changed;
+  SmallVector<const MDNode *, 8> Pending;
+
+public:
+  UnchangedMetadataFinder(ValueToValueMapTy &VM, RemapFlags Flags,
+                          ValueMapTypeRemapper *TypeMapper,
+                          ValueMaterializer *Materializer)
+      : VM(VM), Flags(Flags), TypeMapper(TypeMapper),
+        Materializer(Materializer) {}
+
+  bool mapsToSelf(const MDNode *Node) {
+    unsigned Low = 0;
+    return !visit(Node, 0, Low);
+  }
+
+private:
+  // Returns whether MD changes. Low is lowered to the depth of any node
+  // still being visited that the result depends on.
+  bool visitOp(const Metadata *MD, unsigned Depth, unsigned &Low) {
+    if (!MD)
+      return false;
+    if (Metadata *NewMD = VM.MD().lookup(MD).get())
+      return NewMD != MD;
+    if (isa<MDString>(MD))
+      return false;
+    if (const auto *VMD = dyn_cast<ValueAsMetadata>(MD)) {
+      Value *MappedV =
+          MapValue(VMD->getValue(), VM, Flags, TypeMapper, Materializer);
+      return !(VMD->getValue() == MappedV ||
+               (!MappedV && (Flags & RF_IgnoreMissingEntries)));
+    }
+    const MDNode *Node = cast<MDNode>(MD);
+    if (!Node->isUniqued())
+      return true;
+    auto It = Visiting.find(Node);
+    if (It != Visiting.end()) {
+      Low = std::min(Low, It->second);
+      return false;
+    }
+    if (Changed.count(Node))
+      return true;
+    return visit(Node, Depth + 1, Low);
+  }
+
+  bool visit(const MDNode *Node, unsigned Depth, unsigned &Low) {
+    Visiting[Node] = Depth;
+    size_t PendingStart = Pending.size();
+    unsigned NodeLow = Depth;
+    bool NodeChanged = false;
+    for (const MDOperand &Op : Node->operands()) {
+      if (visitOp(Op, Depth, NodeLow)) {
+        NodeChanged = true;
+        break;
+      }
+    }
+    Visiting.erase(Node);
+
+    if (NodeChanged) {
+      Changed.insert(Node);
+      Pending.resize(PendingStart);
+      return true;
+    }
+    if (NodeLow < Depth) {
+      Low = std::min(Low, NodeLow);
+      Pending.push_back(Node);
+      return false;
+    }
+    // Nothing below maps elsewhere, including the nodes waiting on this one.
+    for (size_t i = PendingStart; i < Pending.size(); ++i)
+      mapToSelf(VM, Pending[i]);
+    Pending.resize(PendingStart);
+    mapToSelf(VM, Node);
+    return false;
+  }
+};
+} // namespace
+// HLSL Change End
+
 static Metadata *MapMetadataImpl(const Metadata *MD,
                                  SmallVectorImpl<MDNode *> &Cycles,
+                                 UnchangedMetadataFinder &Finder, // HLSL Change
                                  ValueToValueMapTy &VM, RemapFlags Flags,
                                  ValueMapTypeRemapper *TypeMapper,
                                  ValueMaterializer *Materializer);
 
 static Metadata *mapMetadataOp(Metadata *Op, SmallVectorImpl<MDNode *> &Cycles,
+                               UnchangedMetadataFinder &Finder, // HLSL Change
                                ValueToValueMapTy &VM, RemapFlags Flags,
                                ValueMapTypeRemapper *TypeMapper,
                                ValueMaterializer *Materializer) {
   if (!Op)
     return nullptr;
   if (Metadata *MappedOp =
-          MapMetadataImpl(Op, Cycles, VM, Flags, TypeMapper, Materializer))
+          MapMetadataImpl(Op, Cycles, Finder, VM, Flags, TypeMapper,
+                          Materializer)) // HLSL Change
     return MappedOp;
   // Use identity map if MappedOp is null and we can ignore missing entries.
   if (Flags & RF_IgnoreMissingEntries)
@@ -189,7 +290,9 @@ static Metadata *mapMetadataOp(Metadata *Op, SmallVectorImpl<MDNode *> &Cycles,
 ///
 /// \pre \c NewNode is a clone of \c OldNode.
 static bool remap(const MDNode *OldNode, MDNode *NewNode,
-                  SmallVectorImpl<MDNode *> &Cycles, ValueToValueMapTy &VM,
+                  SmallVectorImpl<MDNode *> &Cycles,
+                  UnchangedMetadataFinder &Finder, // HLSL Change
+                  ValueToValueMapTy &VM,
                   RemapFlags Flags, ValueMapTypeRemapper *TypeMapper,
                   ValueMaterializer *Materializer) {
   assert(OldNode->getNumOperands() == NewNode->getNumOperands() &&
@@ -205,8 +308,9 @@ static bool remap(const MDNode *OldNode, MDNode *NewNode,
     assert(NewNode->getOperand(I) == Old &&
            "Expected old operands to already be in place");
 
-    Metadata *New = mapMetadataOp(OldNode->getOperand(I), Cycles, VM, Flags,
-                                  TypeMapper, Materializer);
+    Metadata *New = mapMetadataOp(OldNode->getOperand(I), Cycles,
+                                  Finder, // HLSL Change
+                                  VM, Flags, TypeMapper, Materializer);
     if (Old != New) {
       AnyChanged = true;
       NewNode->replaceOperandWith(I, New);
@@ -221,13 +325,15 @@ static bool remap(const MDNode *OldNode, MDNode *NewNode,
 /// Distinct nodes are not uniqued, so they must always recreated.
 static Metadata *mapDistinctNode(const MDNode *Node,
                                  SmallVectorImpl<MDNode *> &Cycles,
+                                 UnchangedMetadataFinder &Finder, // HLSL Change
                                  ValueToValueMapTy &VM, RemapFlags Flags,
                                  ValueMapTypeRemapper *TypeMapper,
                                  ValueMaterializer *Materializer) {
   assert(Node->isDistinct() && "Expected distinct node");
 
   MDNode *NewMD = MDNode::replaceWithDistinct(Node->clone());
-  remap(Node, NewMD, Cycles, VM, Flags, TypeMapper, Materializer);
+  remap(Node, NewMD, Cycles, Finder, VM, Flags, TypeMapper,
+        Materializer); // HLSL Change
 
   // Track any cycles beneath this node.
   for (Metadata *Op : NewMD->operands())
@@ -243,6 +349,7 @@ static Metadata *mapDistinctNode(const MDNode *Node,
 /// Uniqued nodes may not need to be recreated (they may map to themselves).
 static Metadata *mapUniquedNode(const MDNode *Node,
                                 SmallVectorImpl<MDNode *> &Cycles,
+                                UnchangedMetadataFinder &Finder, // HLSL Change
                                 ValueToValueMapTy &VM, RemapFlags Flags,
                                 ValueMapTypeRemapper *TypeMapper,
                                 ValueMaterializer *Materializer) {
@@ -250,7 +357,8 @@ static Metadata *mapUniquedNode(const MDNode *Node,
 
   // Create a temporary node upfront in case we have a metadata cycle.
   auto ClonedMD = Node->clone();
-  if (!remap(Node, ClonedMD.get(), Cycles, VM, Flags, TypeMapper, Materializer))
+  if (!remap(Node, ClonedMD.get(), Cycles, Finder, VM, Flags, TypeMapper,
+             Materializer)) // HLSL Change
     // No operands changed, so use the identity mapping.
     return mapToSelf(VM, Node);
 
@@ -261,6 +369,7 @@ static Metadata *mapUniquedNode(const MDNode *Node,
 
 static Metadata *MapMetadataImpl(const Metadata *MD,
                                  SmallVectorImpl<MDNode *> &Cycles,
+                                 UnchangedMetadataFinder &Finder, // HLSL Change
                                  ValueToValueMapTy &VM, RemapFlags Flags,
                                  ValueMapTypeRemapper *TypeMapper,
                                  ValueMaterializer *Materializer) {
@@ -304,18 +413,27 @@ static Metadata *MapMetadataImpl(const Metadata *MD,
   // Require resolved nodes whenever metadata might be remapped.
   assert(Node->isResolved() && "Unexpected unresolved node");
 
+  // HLSL Change Begin - skip the temporary clone when nothing changes.
+  if (Node->isUniqued() && Finder.mapsToSelf(Node))
+    return const_cast<MDNode *>(Node);
+  // HLSL Change End
+
   if (Node->isDistinct())
-    return mapDistinctNode(Node, Cycles, VM, Flags, TypeMapper, Materializer);
+    return mapDistinctNode(Node, Cycles, Finder, VM, Flags, TypeMapper,
+                           Materializer); // HLSL Change
 
-  return mapUniquedNode(Node, Cycles, VM, Flags, TypeMapper, Materializer);
+  return mapUniquedNode(Node, Cycles, Finder, VM, Flags, TypeMapper,
+                        Materializer); // HLSL Change
 }
 
 Metadata *llvm::MapMetadata(const Metadata *MD, ValueToValueMapTy &VM,
                             RemapFlags Flags, ValueMapTypeRemapper *TypeMapper,
                             ValueMaterializer *Materializer) {
   SmallVector<MDNode *, 8> Cycles;
-  Metadata *NewMD =
-      MapMetadataImpl(MD, Cycles, VM, Flags, TypeMapper, Materializer);
+  UnchangedMetadataFinder Finder(VM, Flags, TypeMapper,
+                                 Materializer); // HLSL Change
+  Metadata *NewMD = MapMetadataImpl(MD, Cycles, Finder, VM, Flags, TypeMapper,
+                                    Materializer); // HLSL Change
 
   // Resolve cycles underneath MD.
   if (NewMD && NewMD != MD) {
@@ -57,6 +57,44 @@ IDxbcConverter : public IUnknown {
     _Outptr_result_maybenull_z_ LPWSTR *ppDiag) = 0;
 };
 
+/// One conversion in a batch; the fields match the arguments of
+/// IDxbcConverter::Convert.
+struct DxbcConvertJob {
+  LPCVOID pDxbc;                                  // DXBC container to convert
+  UINT32 DxbcSize;                                // Size of pDxbc in bytes
+  LPCWSTR pExtraOptions;                          // Options as for Convert (optional)
+};
+
+/// Receives the results of a batch.
+struct __declspec(uuid("D8E1DEA8-03AB-4F4A-9062-48E3041FC44A"))
+IDxbcConvertBatchCallback : public IUnknown {
+  /// Called once per job from one of the batch threads, never concurrently.
+  /// The callee owns pDxil and pDiag and frees them as for Convert. A failure
+  /// cancels the jobs that have not started yet and is returned from
+  /// ConvertBatch.
+  virtual HRESULT STDMETHODCALLTYPE OnConvertComplete(
+    _In_ UINT32 JobIndex,
+    _In_ HRESULT Status,
+    _In_opt_ LPVOID pDxil,
+    _In_ UINT32 DxilSize,
+    _In_opt_z_ LPWSTR pDiag) = 0;
+};
+
+/// Converts many shaders at once; QueryInterface for it on IDxbcConverter.
+struct __declspec(uuid("0F512402-52C4-47F3-BA7D-6DAE785D6178"))
+IDxbcConverterBatch : public IUnknown {
+  /// Runs the jobs on ThreadCount worker threads, or one per hardware thread
+  /// if zero. With InOrder set, results are passed to the callback in job
+  /// order; otherwise as each job completes. Returns once every job has
+  /// completed or the batch was cancelled.
+  virtual HRESULT STDMETHODCALLTYPE ConvertBatch(
+    _In_count_(JobCount) const DxbcConvertJob *pJobs,
+    _In_ UINT32 JobCount,
+    _In_ UINT32 ThreadCount,
+    _In_ BOOL InOrder,
+    _In_ IDxbcConvertBatchCallback *pCallback) = 0;
+};
+
 __declspec(selectany)
 extern const CLSID CLSID_DxbcConverter = { /* 4900391E-B752-4EDD-A885-6FB76E25ADDB */
   0x4900391e,
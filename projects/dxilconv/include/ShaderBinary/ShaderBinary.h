@@ -11,6 +11,8 @@
 
 #pragma once
 
+#include <vector> // HLSL Change - for the decoded instruction cache
+
 //has dependencies on D3D10TokenizedProgramFormat.hpp! make sure to include that too!
 
 typedef UINT CShaderToken;
@@ -2548,14 +2550,18 @@ public:
     CShaderCodeParser():
         m_pCurrentToken(NULL),
         m_pShaderCode(NULL),
-        m_pShaderEndToken(NULL)
+        m_pShaderEndToken(NULL),
+        m_bCacheInstructions(FALSE),
+        m_NextEntry(0)
     {
         InitInstructionInfo();
     }
     CShaderCodeParser(CONST CShaderToken* pBuffer):
         m_pCurrentToken(NULL),
         m_pShaderCode(NULL),
-        m_pShaderEndToken(NULL)
+        m_pShaderEndToken(NULL),
+        m_bCacheInstructions(FALSE),
+        m_NextEntry(0)
     {
         InitInstructionInfo();
         SetShader(pBuffer);
@@ -2573,6 +2579,12 @@ public:
     UINT CurrentTokenOffset();
     UINT CurrentTokenOffsetInBytes() { return CurrentTokenOffset() * sizeof(CShaderToken); }
     void SetCurrentTokenOffset(UINT Offset);
+    // HLSL Change Begin - decoded instruction cache
+    // When enabled, each instruction is decoded once; parsing it again, after
+    // rewinding with SetShader or SetCurrentTokenOffset, copies the decoded
+    // record instead. Instructions that own allocations are always decoded.
+    void EnableInstructionCache(BOOL bEnable = TRUE);
+    // HLSL Change End
 
     CONST CShaderToken* ParseOperandAt(COperandBase* pOperand,
                                        CONST CShaderToken* pBuffer,
@@ -2599,6 +2611,24 @@ protected:
     CShaderToken*   m_pShaderCode;
     // Points to the last token of the current shader
     CShaderToken*   m_pShaderEndToken;
+
+    // HLSL Change Begin - decoded instruction cache
+    void DecodeInstruction(CInstruction* pInstruction);
+
+    static const UINT NO_CACHED_INSTRUCTION = UINT(-1);
+    struct CDecodedInstructionEntry
+    {
+        UINT StartOffset;      // token offset of the instruction
+        UINT EndOffset;        // token offset of the next instruction
+        UINT InstructionIndex; // into m_DecodedInstructions, or NO_CACHED_INSTRUCTION
+    };
+    BOOL m_bCacheInstructions;
+    // Sorted by StartOffset; the stream is walked in order, so entries are
+    // almost always appended and the next lookup is at m_NextEntry.
+    std::vector<CDecodedInstructionEntry> m_DecodedEntries;
+    std::vector<CInstruction> m_DecodedInstructions;
+    size_t m_NextEntry;
+    // HLSL Change End
 };
 
 }; // name space D3D10ShaderBinary
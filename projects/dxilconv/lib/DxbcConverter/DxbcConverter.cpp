@@ -15,6 +15,9 @@
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/DxilContainer/DxilContainerAssembler.h"
 #include "dxc/DxilContainer/DxilContainerReader.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include "llvm/Support/Mutex.h"
+#include <atomic>
 
 #define DXBCCONV_DBG   0
 
@@ -28,9 +31,6 @@ __override HRESULT STDMETHODCALLTYPE DxbcConverter::Convert(_In_reads_bytes_(Dxb
                                                _Out_ UINT32 *pDxilSize,
                                                _Outptr_result_maybenull_z_ LPWSTR *ppDiag) {
     DxcThreadMalloc TM(m_pMalloc);
-    LARGE_INTEGER start, end;
-    QueryPerformanceCounter(&start);
-    DxcRuntimeEtw_DxcTranslate_Start();
     HRESULT hr = S_OK;
     try {
       sys::fs::MSFileSystem *pFSPtr;
@@ -39,6 +39,23 @@ __override HRESULT STDMETHODCALLTYPE DxbcConverter::Convert(_In_reads_bytes_(Dxb
       sys::fs::AutoPerThreadSystem pTS(pFS.get());
       IFTLLVM(pTS.error_code());
 
+      hr = ConvertOnThisThread(pDxbc, DxbcSize, pExtraOptions, ppDxil, pDxilSize, ppDiag);
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+    return hr;
+}
+
+HRESULT DxbcConverter::ConvertOnThisThread(_In_reads_bytes_(DxbcSize) LPCVOID pDxbc,
+                                           _In_ UINT32 DxbcSize,
+                                           _In_opt_z_ LPCWSTR pExtraOptions,
+                                           _Outptr_result_bytebuffer_maybenull_(*pDxilSize) LPVOID *ppDxil,
+                                           _Out_ UINT32 *pDxilSize,
+                                           _Outptr_result_maybenull_z_ LPWSTR *ppDiag) {
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    DxcRuntimeEtw_DxcTranslate_Start();
+    HRESULT hr = S_OK;
+    try {
       struct StdErrFlusher {
         ~StdErrFlusher() { dbgs().flush(); }
       } S;
@@ -55,6 +72,132 @@ __override HRESULT STDMETHODCALLTYPE DxbcConverter::Convert(_In_reads_bytes_(Dxb
     return hr;
 }
 
+__override HRESULT STDMETHODCALLTYPE DxbcConverter::ConvertBatch(_In_count_(JobCount) const DxbcConvertJob *pJobs,
+                                                    _In_ UINT32 JobCount,
+                                                    _In_ UINT32 ThreadCount,
+                                                    _In_ BOOL InOrder,
+                                                    _In_ IDxbcConvertBatchCallback *pCallback) {
+    if ((pJobs == nullptr && JobCount != 0) || pCallback == nullptr)
+      return E_INVALIDARG;
+
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      if (JobCount == 0)
+        return S_OK;
+
+      // The result of one job, held back in in-order mode until every job
+      // before it has been delivered.
+      struct JobResult {
+        bool Done = false;
+        HRESULT Status = S_OK;
+        LPVOID pDxil = nullptr;
+        UINT32 DxilSize = 0;
+        LPWSTR pDiag = nullptr;
+      };
+      std::vector<JobResult> Pending(InOrder ? JobCount : 0);
+      UINT32 NextToDeliver = 0;
+
+      sys::Mutex CallbackLock;
+      std::atomic<bool> Cancelled(false);
+      std::atomic<UINT32> NextJob(0);
+      HRESULT BatchResult = S_OK;
+
+      // Called with CallbackLock held. Takes ownership of the job's outputs,
+      // which pass to the callback or are freed once the batch is cancelled.
+      auto Deliver = [&](UINT32 JobIndex, JobResult &R) {
+        if (!Cancelled) {
+          HRESULT hr = pCallback->OnConvertComplete(JobIndex, R.Status, R.pDxil,
+                                                    R.DxilSize, R.pDiag);
+          R.pDxil = nullptr;
+          R.pDiag = nullptr;
+          if (FAILED(hr)) {
+            BatchResult = hr;
+            Cancelled = true;
+          }
+        }
+        CoTaskMemFree(R.pDxil);
+        CoTaskMemFree(R.pDiag);
+        R.pDxil = nullptr;
+        R.pDiag = nullptr;
+      };
+
+      if (ThreadCount == 0)
+        ThreadCount = DxcThreadPool::GetDefaultThreadCount();
+      if (ThreadCount > JobCount)
+        ThreadCount = JobCount;
+
+      {
+        DxcThreadPool Pool(ThreadCount);
+        for (UINT32 t = 0; t < ThreadCount; ++t) {
+          // Each worker sets up its allocator and file system once and then
+          // takes jobs until none are left. The converter itself holds the
+          // state of one conversion, so every job gets a new one.
+          Pool.Async([&]() {
+            DxcThreadMalloc TM(m_pMalloc);
+            sys::fs::MSFileSystem *pFSPtr;
+            HRESULT fsHR = CreateMSFileSystemForDisk(&pFSPtr);
+            unique_ptr<sys::fs::MSFileSystem> pFS(SUCCEEDED(fsHR) ? pFSPtr : nullptr);
+            sys::fs::AutoPerThreadSystem pTS(pFS.get());
+            if (SUCCEEDED(fsHR) && pTS.error_code())
+              fsHR = E_FAIL;
+
+            for (;;) {
+              if (Cancelled)
+                return;
+              UINT32 i = NextJob++;
+              if (i >= JobCount)
+                return;
+
+              // A job that fails, even by throwing, is still delivered, so
+              // in-order delivery never waits on it.
+              JobResult R;
+              HRESULT hr = fsHR;
+              if (SUCCEEDED(hr)) {
+                try {
+                  CComPtr<DxbcConverter> pConverter = NewBatchConverter();
+                  if (pConverter == nullptr)
+                    hr = E_OUTOFMEMORY;
+                  else
+                    hr = pConverter->ConvertOnThisThread(
+                        pJobs[i].pDxbc, pJobs[i].DxbcSize,
+                        pJobs[i].pExtraOptions, &R.pDxil, &R.DxilSize,
+                        &R.pDiag);
+                }
+                CATCH_CPP_ASSIGN_HRESULT();
+              }
+              R.Status = hr;
+              R.Done = true;
+
+              sys::ScopedLock L(CallbackLock);
+              if (!InOrder) {
+                Deliver(i, R);
+                continue;
+              }
+              Pending[i] = R;
+              while (NextToDeliver < JobCount && Pending[NextToDeliver].Done) {
+                Deliver(NextToDeliver, Pending[NextToDeliver]);
+                ++NextToDeliver;
+              }
+            }
+          });
+        }
+        // A worker that threw outside a job may have left jobs unconverted.
+        HRESULT PoolResult = Pool.Wait();
+        if (SUCCEEDED(BatchResult))
+          BatchResult = PoolResult;
+      }
+
+      // Free whatever a cancelled in-order batch left undelivered.
+      for (JobResult &R : Pending) {
+        CoTaskMemFree(R.pDxil);
+        CoTaskMemFree(R.pDiag);
+      }
+
+      return BatchResult;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+}
+
 __override HRESULT STDMETHODCALLTYPE DxbcConverter::ConvertInDriver(_In_reads_bytes_(8) const UINT32 *pBytecode,
                                                        _In_opt_z_ LPCVOID pInputSignature,
                                                        _In_ UINT32 NumInputSignatureElements,
@@ -121,6 +264,7 @@ DxbcConverter::DxbcConverter()
 , m_pIcbGV(nullptr)
 , m_bDisableHashCheck(false)
 , m_bRunDxilCleanup(true)
+, m_OptLevel(0)
 , m_bLegacyCBufferLoad(true)
 , m_TGSMCount(0)
 , m_DepthRegType(D3D10_SB_OPERAND_TYPE_NULL)
@@ -203,6 +347,8 @@ void DxbcConverter::ConvertImpl(_In_reads_bytes_(DxbcSize) LPCVOID pDxbc,
 
   // Parse DXBC container.
   D3D10ShaderBinary::CShaderCodeParser Parser;
+  // Analysis, conversion, and lookahead each walk the instruction stream.
+  Parser.EnableInstructionCache();
 
   // 1. Collect information about the shader.
   Parser.SetShader(pByteCode);
@@ -370,6 +516,8 @@ void DxbcConverter::ConvertInDriverImpl(_In_reads_bytes_(8) const UINT32 *pByteC
 
   // Parse DXBC bytecode.
   D3D10ShaderBinary::CShaderCodeParser Parser;
+  // Analysis, conversion, and lookahead each walk the instruction stream.
+  Parser.EnableInstructionCache();
 
   // 1. Collect information about the shader.
   Parser.SetShader(pByteCode);
@@ -434,6 +582,16 @@ void DxbcConverter::ParseExtraOptions(const wchar_t *pExtraOptions) {
   // Opt out from DXIL cleanup pass.
   if (Str.find(L"-no-dxil-cleanup") != wstring::npos)
     m_bRunDxilCleanup = false;
+
+  // Optimization level for the converted code, -O0 (default) through -O3.
+  // -O3 runs the same passes as -O2; it is accepted so that the usual
+  // compiler levels can be passed through unchanged.
+  for (size_t Pos = Str.find(L"-O"); Pos != wstring::npos; Pos = Str.find(L"-O", Pos + 2)) {
+    bool bStartsWord = Pos == 0 || iswspace(Str[Pos - 1]);
+    bool bEndsWord = Pos + 3 == Str.size() || (Pos + 3 < Str.size() && iswspace(Str[Pos + 3]));
+    if (bStartsWord && bEndsWord && Str[Pos + 2] >= L'0' && Str[Pos + 2] <= L'3')
+      m_OptLevel = Str[Pos + 2] - L'0';
+  }
 }
 
 void DxbcConverter::SetShaderGlobalFlags(unsigned GlobalFlags) {
@@ -7111,6 +7269,9 @@ void DxbcConverter::Optimize() {
 
   if (m_bRunDxilCleanup) {
     PassManager.add(createDxilCleanupPass());
+    // The optimizations expect the SSA form the cleanup builds for r-registers.
+    if (m_OptLevel > 0)
+      AddOptimizationPasses(PassManager, m_OptLevel);
     PassManager.run(*m_pModule);
   }
 
@@ -7120,10 +7281,17 @@ void DxbcConverter::Optimize() {
 }
 
 void DxbcConverter::AddOptimizationPasses(PassManagerBase &PassManager, unsigned OptLevel) {
-  PassManagerBuilder Builder;
-  Builder.OptLevel = OptLevel;
-  Builder.SizeLevel = 0;
-  Builder.populateModulePassManager(PassManager);
+  // The standard pipeline expects a high-level module, so only a few function
+  // passes are used. SROA and mem2reg promote the allocas made for
+  // x-registers where they are only indexed by constants; CSE and GVN remove
+  // the redundant loads and recomputed values the DXBC register file leaves.
+  PassManager.add(createSROAPass());
+  PassManager.add(createPromoteMemoryToRegisterPass());
+  if (OptLevel > 1) {
+    PassManager.add(createEarlyCSEPass());
+    PassManager.add(createGVNPass());
+  }
+  PassManager.add(createDeadCodeEliminationPass());
 }
 
 void DxbcConverter::CreateBranchIfNeeded(BasicBlock *pBB, BasicBlock *pTargetBB) {
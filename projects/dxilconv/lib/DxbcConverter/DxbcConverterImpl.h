@@ -267,14 +267,14 @@ public:
 
 
 /// Use this class to implement the IDxbcConverter inteface for DXBC to DXIL translation.
-class DxbcConverter : public IDxbcConverter {
+class DxbcConverter : public IDxbcConverter, public IDxbcConverterBatch {
 protected:
   DXC_MICROCOM_TM_REF_FIELDS();
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL();
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) {
-    return DoBasicQueryInterface<IDxbcConverter>(this, iid, ppv);
+    return DoBasicQueryInterface<IDxbcConverter, IDxbcConverterBatch>(this, iid, ppv);
   }
 
   DxbcConverter();
@@ -301,6 +301,26 @@ public:
                                                        _Out_ IDxcBlob **ppDxilModule,
                                                        _Outptr_result_maybenull_z_ LPWSTR *ppDiag);
 
+  __override HRESULT STDMETHODCALLTYPE ConvertBatch(_In_count_(JobCount) const DxbcConvertJob *pJobs,
+                                                    _In_ UINT32 JobCount,
+                                                    _In_ UINT32 ThreadCount,
+                                                    _In_ BOOL InOrder,
+                                                    _In_ IDxbcConvertBatchCallback *pCallback);
+
+protected:
+  /// Convert, for a thread that has already set up the file system.
+  HRESULT ConvertOnThisThread(_In_reads_bytes_(DxbcSize) LPCVOID pDxbc,
+                              _In_ UINT32 DxbcSize,
+                              _In_opt_z_ LPCWSTR pExtraOptions,
+                              _Outptr_result_bytebuffer_maybenull_(*pDxilSize) LPVOID *ppDxil,
+                              _Out_ UINT32 *pDxilSize,
+                              _Outptr_result_maybenull_z_ LPWSTR *ppDiag);
+
+  /// Creates the converter for one job of a batch. A converter holds the state
+  /// of one conversion, so each job gets a new one; derived converters
+  /// override this so that batch jobs run their hooks too.
+  virtual DxbcConverter *NewBatchConverter() { return DxbcConverter::Alloc(m_pMalloc); }
+
 protected:
   LLVMContext m_Ctx;
   DxilModule *m_pPR;
@@ -314,6 +334,7 @@ protected:
   
   bool m_bDisableHashCheck;
   bool m_bRunDxilCleanup;
+  unsigned m_OptLevel;
 
   bool m_bLegacyCBufferLoad;
 
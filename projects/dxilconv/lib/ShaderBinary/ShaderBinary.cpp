@@ -297,6 +297,14 @@ void InitInstructionInfo()
 
 void CShaderCodeParser::SetShader(CONST CShaderToken* pBuffer)
 {
+    // HLSL Change Begin - decoded instruction cache
+    if (pBuffer != m_pShaderCode)
+    {
+        m_DecodedEntries.clear();
+        m_DecodedInstructions.clear();
+    }
+    m_NextEntry = 0;
+    // HLSL Change End
     m_pShaderCode = (CShaderToken*)pBuffer;
     m_pShaderEndToken = (CShaderToken*)pBuffer + pBuffer[1];
     // First OpCode token
@@ -479,7 +487,74 @@ void CShaderCodeParser::ParseOperand(COperandBase* pOperand)
     }
 }
 
+// HLSL Change Begin - decoded instruction cache
+void CShaderCodeParser::EnableInstructionCache(BOOL bEnable)
+{
+    m_bCacheInstructions = bEnable;
+    if (!bEnable)
+    {
+        m_DecodedEntries.clear();
+        m_DecodedInstructions.clear();
+        m_NextEntry = 0;
+    }
+}
+
 void CShaderCodeParser::ParseInstruction(CInstruction* pInstruction)
+{
+    if (!m_bCacheInstructions)
+    {
+        DecodeInstruction(pInstruction);
+        return;
+    }
+
+    UINT Offset = CurrentTokenOffset();
+    size_t Entry = m_NextEntry;
+    if (Entry >= m_DecodedEntries.size() || m_DecodedEntries[Entry].StartOffset != Offset)
+    {
+        CDecodedInstructionEntry Key = { Offset, 0, 0 };
+        Entry = std::lower_bound(m_DecodedEntries.begin(), m_DecodedEntries.end(), Key,
+                                 [](const CDecodedInstructionEntry &L, const CDecodedInstructionEntry &R)
+                                 { return L.StartOffset < R.StartOffset; }) - m_DecodedEntries.begin();
+    }
+
+    if (Entry < m_DecodedEntries.size() && m_DecodedEntries[Entry].StartOffset == Offset)
+    {
+        const CDecodedInstructionEntry &E = m_DecodedEntries[Entry];
+        if (E.InstructionIndex != NO_CACHED_INSTRUCTION)
+        {
+            // The cached record owns no allocations, so a plain copy is safe.
+            pInstruction->Clear(true);
+            *pInstruction = m_DecodedInstructions[E.InstructionIndex];
+            m_pCurrentToken = m_pShaderCode + E.EndOffset;
+        }
+        else
+        {
+            DecodeInstruction(pInstruction);
+        }
+        m_NextEntry = Entry + 1;
+        return;
+    }
+
+    DecodeInstruction(pInstruction);
+
+    CDecodedInstructionEntry E = { Offset, CurrentTokenOffset(), NO_CACHED_INSTRUCTION };
+    switch (pInstruction->m_OpCode)
+    {
+    case D3D10_SB_OPCODE_CUSTOMDATA:
+    case D3D11_SB_OPCODE_DCL_FUNCTION_TABLE:
+    case D3D11_SB_OPCODE_DCL_INTERFACE:
+        break;
+    default:
+        E.InstructionIndex = (UINT)m_DecodedInstructions.size();
+        m_DecodedInstructions.push_back(*pInstruction);
+        break;
+    }
+    m_DecodedEntries.insert(m_DecodedEntries.begin() + Entry, E);
+    m_NextEntry = Entry + 1;
+}
+// HLSL Change End
+
+void CShaderCodeParser::DecodeInstruction(CInstruction* pInstruction) // HLSL Change - was ParseInstruction
 {
     pInstruction->Clear(true);
     CShaderToken* pStart = m_pCurrentToken;
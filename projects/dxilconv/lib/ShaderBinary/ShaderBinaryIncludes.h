@@ -11,6 +11,7 @@
 #include "windows.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <float.h>
 #include <strsafe.h>
 #include <intsafe.h>
@@ -0,0 +1,29 @@
+// RUN: %fxc /T ps_5_0 %s /Fo %t.dxbc
+// RUN: %dxbc2dxil %t.dxbc /O1 /emit-llvm | %FileCheck %s -check-prefixes=CHECK,O1
+// RUN: %dxbc2dxil %t.dxbc /O3 /emit-llvm | %FileCheck %s -check-prefixes=CHECK,O3
+
+// The DXBC reads input B twice. -O1 only promotes allocas and removes dead
+// code, so both reads stay; -O3, like -O2, also merges them.
+
+// CHECK: define void @main()
+// CHECK: alloca [24 x i32]
+// CHECK: call i32 @dx.op.loadInput.i32(i32 4, i32 1, i32 0, i8 0
+// O1: call i32 @dx.op.loadInput.i32(i32 4, i32 1, i32 0, i8 0
+// O3-NOT: call i32 @dx.op.loadInput.i32(i32 4, i32 1, i32 0, i8 0
+// CHECK: call void @dx.op.storeOutput.f32
+// CHECK: ret void
+
+float g1[6], g2[8];
+
+float main(float4 a : A, int b : B, int c : C) : SV_TARGET
+{
+  float x1[6];
+  x1[0] = g1[b];
+  x1[1] = g2[b];
+  x1[2] = g1[b+2];
+  x1[3] = g1[b+3];
+  x1[4] = g1[b+4];
+  x1[5] = g1[b+5];
+
+  return x1[c + b];
+}
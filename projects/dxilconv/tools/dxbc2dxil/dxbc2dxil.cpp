@@ -90,6 +90,7 @@ void Converter::PrintUsage() {
   wprintf(L"   /disasm-dxbc                 print DXBC disassembly and exit\n");
   wprintf(L"   /emit-llvm                   print DXIL disassembly and exit\n");
   wprintf(L"   /emit-bc                     emit LLVM bitcode rather than DXIL container\n");
+  wprintf(L"   /O0, /O1, /O2, /O3           optimization level (default /O0; /O3 is the same as /O2)\n");
   wprintf(L"\n");
 }
 
@@ -140,6 +141,11 @@ void Converter::ParseCommandLine(int NumArgs, _In_z_count_(NumArgs + 1) wchar_t
       else if (CheckOption(ppArgs[iArg], L"no-dxil-cleanup")) {
         m_ExtraOptions += L" -no-dxil-cleanup";
       }
+      else if (CheckOption(ppArgs[iArg], L"O0") || CheckOption(ppArgs[iArg], L"O1") ||
+               CheckOption(ppArgs[iArg], L"O2") || CheckOption(ppArgs[iArg], L"O3")) {
+        m_ExtraOptions += L" -O";
+        m_ExtraOptions += ppArgs[iArg][2];
+      }
       else if (ppArgs[iArg] && (ppArgs[iArg][0] == L'-' || ppArgs[iArg][0] == L'/')) {
         CmdLineError(L"unrecognized option: %s", ppArgs[iArg]);
       }
@@ -47,8 +47,113 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringSwitch.h"
 
+#include "DxbcConverter.h"
+
+#include <mutex>
+#include <set>
+
 using namespace std;
 
+namespace {
+// Collects what a batch delivers, failing the delivery numbered FailAt.
+class BatchCollector : public IDxbcConvertBatchCallback {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+
+public:
+  struct Result {
+    HRESULT Status = E_PENDING;
+    std::vector<char> Dxil;
+  };
+  std::vector<Result> Results;
+  std::vector<UINT32> Order;
+  size_t FailAt = SIZE_MAX;
+
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  BatchCollector(UINT32 JobCount) : m_dwRef(0), Results(JobCount) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxbcConvertBatchCallback>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE OnConvertComplete(UINT32 JobIndex, HRESULT Status,
+                                              LPVOID pDxil, UINT32 DxilSize,
+                                              LPWSTR pDiag) override {
+    Order.push_back(JobIndex);
+    if (JobIndex < Results.size()) {
+      Results[JobIndex].Status = Status;
+      if (pDxil)
+        Results[JobIndex].Dxil.assign((char *)pDxil, (char *)pDxil + DxilSize);
+    }
+    CoTaskMemFree(pDxil);
+    CoTaskMemFree(pDiag);
+    return Order.size() == FailAt ? E_ABORT : S_OK;
+  }
+};
+
+// Tracks the blocks allocated by CoTaskMemAlloc while it is registered, so
+// that a test can tell whether any are left.
+class TaskMemSpy : public IMallocSpy {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::mutex m_lock;
+  std::set<void *> m_blocks;
+
+  void Add(void *p) {
+    std::lock_guard<std::mutex> L(m_lock);
+    m_blocks.insert(p);
+  }
+  void Remove(void *p) {
+    std::lock_guard<std::mutex> L(m_lock);
+    m_blocks.erase(p);
+  }
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TaskMemSpy() : m_dwRef(0) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMallocSpy>(this, iid, ppvObject);
+  }
+
+  size_t GetOutstandingCount() {
+    std::lock_guard<std::mutex> L(m_lock);
+    return m_blocks.size();
+  }
+
+  SIZE_T STDMETHODCALLTYPE PreAlloc(SIZE_T cbRequest) override { return cbRequest; }
+  void *STDMETHODCALLTYPE PostAlloc(void *pActual) override {
+    if (pActual)
+      Add(pActual);
+    return pActual;
+  }
+  void *STDMETHODCALLTYPE PreFree(void *pRequest, BOOL fSpyed) override {
+    if (fSpyed)
+      Remove(pRequest);
+    return pRequest;
+  }
+  void STDMETHODCALLTYPE PostFree(BOOL) override {}
+  SIZE_T STDMETHODCALLTYPE PreRealloc(void *pRequest, SIZE_T cbRequest,
+                                      void **ppNewRequest, BOOL fSpyed) override {
+    if (fSpyed)
+      Remove(pRequest);
+    *ppNewRequest = pRequest;
+    return cbRequest;
+  }
+  void *STDMETHODCALLTYPE PostRealloc(void *pActual, BOOL fSpyed) override {
+    if (fSpyed && pActual)
+      Add(pActual);
+    return pActual;
+  }
+  void *STDMETHODCALLTYPE PreGetSize(void *pRequest, BOOL) override { return pRequest; }
+  SIZE_T STDMETHODCALLTYPE PostGetSize(SIZE_T cbActual, BOOL) override { return cbActual; }
+  void *STDMETHODCALLTYPE PreDidAlloc(void *pRequest, BOOL) override { return pRequest; }
+  int STDMETHODCALLTYPE PostDidAlloc(void *, BOOL, int fActual) override { return fActual; }
+  void STDMETHODCALLTYPE PreHeapMinimize() override {}
+  void STDMETHODCALLTYPE PostHeapMinimize() override {}
+};
+}
+
 class DxilConvTest {
 public:
   BEGIN_TEST_CLASS(DxilConvTest)
@@ -64,6 +169,13 @@ public:
   TEST_METHOD(BatchNormalizeDxil);
   TEST_METHOD(BatchScopeNestIterator);
   TEST_METHOD(RegressionTests);
+  TEST_METHOD(BatchConvertInOrder);
+  TEST_METHOD(BatchConvertCancel);
+  TEST_METHOD(ConvertWhenOptimizedThenValidates);
+  // Counts every task memory block in the process, so it runs alone.
+  BEGIN_TEST_METHOD(BatchConvertFreesUndelivered)
+    TEST_METHOD_PROPERTY(L"Parallel", L"false")
+  END_TEST_METHOD()
 
   BEGIN_TEST_METHOD(ManualFileCheckTest)
     TEST_METHOD_PROPERTY(L"Ignore", L"true")
@@ -71,8 +183,42 @@ public:
 
 private:
   dxc::DxcDllSupport m_dllSupport;
+  dxc::DxcDllSupport m_dxilConvSupport;
   PluginToolsPaths m_TestToolPaths;
 
+  // Jobs for every assembled shader in dxbc2dxil-asm, Rounds times over,
+  // with one job that is not DXBC at index 3.
+  void CreateBatchJobs(unsigned Rounds, std::vector<std::vector<char>> &Dxbc,
+                       std::vector<DxbcConvertJob> &Jobs) {
+    LPCWSTR Names[] = { L"call2", L"cs3", L"cyclecounter", L"hs3",
+                        L"indexabletemp4", L"indexabletemp6" };
+    for (LPCWSTR Name : Names) {
+      std::wstring Path = hlsl_test::GetPathToHlslDataFile(
+          (std::wstring(L"dxbc2dxil-asm\\") + Name + L".dxbc").c_str());
+      std::ifstream File(Path, std::ios::binary);
+      VERIFY_IS_TRUE(File.good());
+      Dxbc.emplace_back((std::istreambuf_iterator<char>(File)),
+                        std::istreambuf_iterator<char>());
+    }
+    static const char NotDxbc[] = "not a DXBC container";
+    for (unsigned r = 0; r < Rounds; ++r) {
+      for (const std::vector<char> &Shader : Dxbc) {
+        if (Jobs.size() == 3)
+          Jobs.push_back({ NotDxbc, (UINT32)sizeof(NotDxbc), nullptr });
+        Jobs.push_back({ Shader.data(), (UINT32)Shader.size(), nullptr });
+      }
+    }
+  }
+
+  void CreateConverter(IDxbcConverter **ppConverter) {
+    if (!m_dxilConvSupport.IsEnabled()) {
+      VERIFY_SUCCEEDED(m_dxilConvSupport.InitializeForDll(L"dxilconv.dll",
+                                                          "DxcCreateInstance"));
+    }
+    VERIFY_SUCCEEDED(
+        m_dxilConvSupport.CreateInstance(CLSID_DxbcConverter, ppConverter));
+  }
+
   void DxilConvTestCheckFile(LPCWSTR path) {
     FileRunTestResult t = FileRunTestResult::RunFromFileCommands(path, m_dllSupport, &m_TestToolPaths);
     if (t.RunResult != 0) {
@@ -305,3 +451,152 @@ TEST_F(DxilConvTest, BatchScopeNestIterator) {
 TEST_F(DxilConvTest, RegressionTests) {
   DxilConvTestCheckBatchDir(L"regression_tests", ".hlsl");
 }
+
+TEST_F(DxilConvTest, BatchConvertInOrder) {
+  std::vector<std::vector<char>> Dxbc;
+  std::vector<DxbcConvertJob> Jobs;
+  CreateBatchJobs(2, Dxbc, Jobs);
+  CComPtr<IDxbcConverter> pConverter;
+  CreateConverter(&pConverter);
+  CComPtr<IDxbcConverterBatch> pBatch;
+  VERIFY_SUCCEEDED(pConverter.QueryInterface(&pBatch));
+
+  CComPtr<BatchCollector> pCollector = new BatchCollector((UINT32)Jobs.size());
+  VERIFY_SUCCEEDED(pBatch->ConvertBatch(Jobs.data(), (UINT32)Jobs.size(), 3,
+                                        /*InOrder*/ TRUE, pCollector));
+
+  // Every job is delivered once, in order, with what Convert gives for it;
+  // the failing job does not hold up the ones after it.
+  VERIFY_ARE_EQUAL(Jobs.size(), pCollector->Order.size());
+  for (UINT32 i = 0; i < (UINT32)Jobs.size(); ++i) {
+    VERIFY_ARE_EQUAL(i, pCollector->Order[i]);
+    LPVOID pDxil = nullptr;
+    UINT32 DxilSize = 0;
+    LPWSTR pDiag = nullptr;
+    HRESULT hr = pConverter->Convert(Jobs[i].pDxbc, Jobs[i].DxbcSize, nullptr,
+                                     &pDxil, &DxilSize, &pDiag);
+    const BatchCollector::Result &R = pCollector->Results[i];
+    VERIFY_ARE_EQUAL(hr, R.Status);
+    VERIFY_ARE_EQUAL(i == 3, FAILED(R.Status));
+    VERIFY_IS_TRUE(std::vector<char>((char *)pDxil, (char *)pDxil + DxilSize) ==
+                   R.Dxil);
+    CoTaskMemFree(pDxil);
+    CoTaskMemFree(pDiag);
+  }
+}
+
+TEST_F(DxilConvTest, BatchConvertCancel) {
+  std::vector<std::vector<char>> Dxbc;
+  std::vector<DxbcConvertJob> Jobs;
+  CreateBatchJobs(4, Dxbc, Jobs);
+  CComPtr<IDxbcConverter> pConverter;
+  CreateConverter(&pConverter);
+  CComPtr<IDxbcConverterBatch> pBatch;
+  VERIFY_SUCCEEDED(pConverter.QueryInterface(&pBatch));
+
+  // A failing callback ends the batch with its error and gets nothing more.
+  for (BOOL InOrder : { FALSE, TRUE }) {
+    CComPtr<BatchCollector> pCollector = new BatchCollector((UINT32)Jobs.size());
+    pCollector->FailAt = 2;
+    VERIFY_ARE_EQUAL(E_ABORT,
+                     pBatch->ConvertBatch(Jobs.data(), (UINT32)Jobs.size(), 4,
+                                          InOrder, pCollector));
+    VERIFY_ARE_EQUAL(2u, (unsigned)pCollector->Order.size());
+    if (InOrder) {
+      VERIFY_ARE_EQUAL(0u, pCollector->Order[0]);
+      VERIFY_ARE_EQUAL(1u, pCollector->Order[1]);
+    }
+  }
+
+  // The callback is required.
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pBatch->ConvertBatch(Jobs.data(), (UINT32)Jobs.size(), 1,
+                                        TRUE, nullptr));
+}
+
+TEST_F(DxilConvTest, ConvertWhenOptimizedThenValidates) {
+  std::vector<std::vector<char>> Dxbc;
+  std::vector<DxbcConvertJob> Jobs;
+  CreateBatchJobs(1, Dxbc, Jobs);
+  CComPtr<IDxbcConverter> pConverter;
+  CreateConverter(&pConverter);
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcValidator> pValidator;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+
+  auto Convert = [&](const std::vector<char> &Shader, LPCWSTR pOptions) {
+    LPVOID pDxil = nullptr;
+    UINT32 DxilSize = 0;
+    LPWSTR pDiag = nullptr;
+    VERIFY_SUCCEEDED(pConverter->Convert(Shader.data(), (UINT32)Shader.size(),
+                                         pOptions, &pDxil, &DxilSize, &pDiag));
+    std::vector<char> Dxil((char *)pDxil, (char *)pDxil + DxilSize);
+    CoTaskMemFree(pDxil);
+    CoTaskMemFree(pDiag);
+    return Dxil;
+  };
+
+  for (const std::vector<char> &Shader : Dxbc) {
+    for (LPCWSTR pOptions : { L"-O1", L"-O3" }) {
+      std::vector<char> Dxil = Convert(Shader, pOptions);
+      CComPtr<IDxcBlobEncoding> pBlob;
+      VERIFY_SUCCEEDED(pLibrary->CreateBlobWithEncodingFromPinned(
+          Dxil.data(), (UINT32)Dxil.size(), CP_ACP, &pBlob));
+      CComPtr<IDxcOperationResult> pResult;
+      VERIFY_SUCCEEDED(pValidator->Validate(pBlob, DxcValidatorFlags_Default,
+                                            &pResult));
+      HRESULT Status;
+      VERIFY_SUCCEEDED(pResult->GetStatus(&Status));
+      if (FAILED(Status)) {
+        CComPtr<IDxcBlobEncoding> pErrors;
+        VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+        CA2W ErrorsW(BlobToUtf8(pErrors).c_str(), CP_UTF8);
+        WEX::Logging::Log::Comment(ErrorsW);
+      }
+      VERIFY_SUCCEEDED(Status);
+    }
+    // -O3 runs the same passes as -O2.
+    VERIFY_IS_TRUE(Convert(Shader, L"-O2") == Convert(Shader, L"-O3"));
+  }
+}
+
+TEST_F(DxilConvTest, BatchConvertFreesUndelivered) {
+  std::vector<std::vector<char>> Dxbc;
+  std::vector<DxbcConvertJob> Jobs;
+  CreateBatchJobs(4, Dxbc, Jobs);
+  CComPtr<IDxbcConverter> pConverter;
+  CreateConverter(&pConverter);
+  CComPtr<IDxbcConverterBatch> pBatch;
+  VERIFY_SUCCEEDED(pConverter.QueryInterface(&pBatch));
+
+  // Convert everything once first, so that one-time allocations made by the
+  // converter are not counted.
+  {
+    CComPtr<BatchCollector> pCollector = new BatchCollector((UINT32)Jobs.size());
+    VERIFY_SUCCEEDED(pBatch->ConvertBatch(Jobs.data(), (UINT32)Jobs.size(), 4,
+                                          TRUE, pCollector));
+  }
+
+  // Cancelling at the first result leaves the jobs converted meanwhile
+  // undelivered: held back for in-order delivery, or finished after the
+  // cancel. The batch has to free them; the callback frees what it gets.
+  HRESULT hrResults[2];
+  size_t Outstanding[2];
+  CComPtr<TaskMemSpy> pSpy = new TaskMemSpy();
+  VERIFY_SUCCEEDED(CoRegisterMallocSpy(pSpy));
+  for (int InOrder = 0; InOrder < 2; ++InOrder) {
+    CComPtr<BatchCollector> pCollector = new BatchCollector((UINT32)Jobs.size());
+    pCollector->FailAt = 1;
+    hrResults[InOrder] = pBatch->ConvertBatch(
+        Jobs.data(), (UINT32)Jobs.size(), 4, InOrder, pCollector);
+    pCollector.Release();
+    Outstanding[InOrder] = pSpy->GetOutstandingCount();
+  }
+  VERIFY_SUCCEEDED(CoRevokeMallocSpy());
+
+  for (int InOrder = 0; InOrder < 2; ++InOrder) {
+    VERIFY_ARE_EQUAL(E_ABORT, hrResults[InOrder]);
+    VERIFY_ARE_EQUAL(0u, (unsigned)Outstanding[InOrder]);
+  }
+}
@@ -0,0 +1,23 @@
+; RUN: opt -scalarizer -S < %s | FileCheck %s
+
+; Check that the components of a vector argument are extracted once, in the
+; entry block, and reused by every scalarized user.
+define <2 x float> @func(<2 x float> %a, i1 %c) {
+; CHECK-LABEL: @func(
+; CHECK: entry:
+; CHECK: %a.i0 = extractelement <2 x float> %a, i32 0
+; CHECK: %a.i1 = extractelement <2 x float> %a, i32 1
+; CHECK-NOT: extractelement <2 x float> %a
+; CHECK: ret
+entry:
+  %x = fadd <2 x float> %a, %a
+  br i1 %c, label %then, label %exit
+
+then:
+  %y = fmul <2 x float> %a, %x
+  br label %exit
+
+exit:
+  %r = phi <2 x float> [ %x, %entry ], [ %y, %then ]
+  ret <2 x float> %r
+}
@@ -28,6 +28,11 @@ private:
   llvm::Module *LinkModule;
   llvm::LLVMContext *VMContext;
   bool OwnsVMContext;
+  // HLSL Change Starts - run the backend after the AST is freed.
+  bool DeferBackendOutput = false;
+  bool BackendOutputPending = false;
+  std::string DeferredInFile;
+  // HLSL Change Ends
 
 protected:
   /// Create a new code generation action.  If the optional \p _VMContext
@@ -59,6 +64,18 @@ public:
   /// Take the LLVM context used by this action.
   llvm::LLVMContext *takeLLVMContext();
 
+  // HLSL Change Starts
+  /// Stop after IR generation when the translation unit is complete, so
+  /// that EndSourceFile frees the AST and Sema before the LLVM passes run.
+  /// The caller then runs them with EmitDeferredBackendOutput.
+  void setDeferBackendOutput(bool Defer) { DeferBackendOutput = Defer; }
+
+  /// Run the LLVM passes and write the output of a deferred action, after
+  /// EndSourceFile. Diagnostics are reported through CI, which only needs
+  /// its diagnostics engine, source manager and options at this point.
+  void EmitDeferredBackendOutput(CompilerInstance &CI);
+  // HLSL Change Ends
+
   BackendConsumer *BEConsumer;
 };
 
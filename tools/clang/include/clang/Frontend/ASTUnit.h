@@ -863,7 +863,8 @@ public:
       bool AllowPCHWithCompilerErrors = false, bool SkipFunctionBodies = false,
       bool UserFilesAreVolatile = false, bool ForSerialization = false,
       std::unique_ptr<ASTUnit> *ErrAST = nullptr,
-      hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions = nullptr); // HLSL Change
+      hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions = nullptr, // HLSL Change
+      bool SkipIncludedFunctionBodies = false); // HLSL Change
 
   /// \brief Reparse the source files using the same command-line options that
   /// were originally used to produce this translation unit.
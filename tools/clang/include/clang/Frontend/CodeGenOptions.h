@@ -207,6 +207,8 @@ public:
   unsigned HLSLDefaultSpace = UINT_MAX;
   /// HLSLLibraryExports specifies desired exports, with optional renaming
   std::vector<std::string> HLSLLibraryExports;
+  /// HLSLLibraryExportsFile names a binary export list to add to the exports
+  std::string HLSLLibraryExportsFile;
   /// ExportShadersOnly limits library export functions to shaders
   bool ExportShadersOnly = false;
   /// DefaultLinkage Internal, External, or Default.  If Default, default
@@ -216,6 +218,30 @@ public:
   bool HLSLResMayAlias = false;
   /// Lookback scan limit for memory dependencies
   unsigned ScanLimit = 0;
+  /// Bits of UNORM precision pixel shader outputs computed in 16-bit floats
+  /// must keep; 0 turns the narrowing off.
+  unsigned HLSLAuto16BitPrecision = 0;
+  /// Pad groupshared arrays that are accessed with a bank-count stride.
+  bool HLSLPadGroupShared = false;
+  /// Lower the maximum output counts of a mesh shader to what it writes.
+  bool HLSLMinimizeMeshOutputs = false;
+  /// Report resource handles created on every iteration of a loop.
+  bool HLSLReportLoopHandles = false;
+  /// Expand inverse trig functions into reduced precision approximations.
+  bool HLSLFastTrig = false;
+  /// Combine the atomics of a wave to a uniform address into one.
+  bool HLSLWaveAggregateAtomics = false;
+  /// Hoist wave-uniform values out of branches and mark uniform branches.
+  bool HLSLHoistUniform = false;
+  /// Where to contract multiplies and adds into mad: nowhere, within blocks
+  /// or across them. Unlike FPContractMode, off by default.
+  FPContractModeKind HLSLFPContract = FPC_Off;
+  /// Estimated live scalars that unrolling loops without attributes may not
+  /// exceed, and above which cheap values are rematerialized; 0 for no limit.
+  unsigned HLSLMaxLiveScalars = 0;
+  /// Refer to included files in debug info by content digest rather than
+  /// embedding them; the files are kept in a source store.
+  bool HLSLSourceReferences = false;
   // HLSL Change Ends
 
   // SPIRV Change Starts
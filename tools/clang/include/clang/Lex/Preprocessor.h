@@ -1123,6 +1123,14 @@ public:
     MacroExpansionInDirectivesOverride = true;
   }
 
+  // HLSL Change Starts
+  /// Expands macros everywhere again, after SetMacroExpansionOnlyInDirectives.
+  void ResetMacroExpansionOnlyInDirectives() {
+    DisableMacroExpansion = false;
+    MacroExpansionInDirectivesOverride = false;
+  }
+  // HLSL Change Ends
+
   /// \brief Peeks ahead N tokens and returns that token without consuming any
   /// tokens.
   ///
@@ -41,8 +41,12 @@ namespace clang {
 
   /// \brief Parse the main file known to the preprocessor, producing an 
   /// abstract syntax tree.
+  ///
+  /// \param SkipIncludedFunctionBodies If set, only the bodies of functions
+  /// outside the main file are skipped.
   void ParseAST(Sema &S, bool PrintStats = false,
-                bool SkipFunctionBodies = false);
+                bool SkipFunctionBodies = false,
+                bool SkipIncludedFunctionBodies = false); // HLSL Change
   
 }  // end namespace clang
 
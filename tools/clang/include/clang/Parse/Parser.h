@@ -239,9 +239,19 @@ class Parser : public CodeCompletionHandler {
   bool ParsingInObjCContainer;
 
   bool SkipFunctionBodies;
+  bool SkipOnlyIncludedFunctionBodies; // HLSL Change
+
+  // HLSL Change - when only included bodies are skipped, main file bodies
+  // are still parsed.
+  bool shouldSkipFunctionBody(SourceLocation LBraceLoc) const {
+    return SkipFunctionBodies &&
+           (!SkipOnlyIncludedFunctionBodies ||
+            !PP.getSourceManager().isInMainFile(LBraceLoc));
+  }
 
 public:
-  Parser(Preprocessor &PP, Sema &Actions, bool SkipFunctionBodies);
+  Parser(Preprocessor &PP, Sema &Actions, bool SkipFunctionBodies,
+         bool SkipIncludedFunctionBodies = false); // HLSL Change
   ~Parser() override;
 
   const LangOptions &getLangOpts() const { return PP.getLangOpts(); }
@@ -15,11 +15,17 @@ namespace clang {
 
 class EmitSpirvAction : public ASTFrontendAction {
 public:
-  EmitSpirvAction() {}
+  /// If Reflection is not nullptr, the JSON reflection data of the emitted
+  /// module is written to it.
+  explicit EmitSpirvAction(std::string *Reflection = nullptr)
+      : Reflection(Reflection) {}
 
 protected:
   std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
                                                  StringRef InFile) override;
+
+private:
+  std::string *Reflection;
 };
 
 } // end namespace clang
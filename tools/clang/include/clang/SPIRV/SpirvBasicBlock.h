@@ -90,6 +90,10 @@ public:
   /// Returns the list of successors of this basic block.
   llvm::ArrayRef<SpirvBasicBlock *> getSuccessors() const { return successors; }
 
+  /// Frees the instruction list and successors of this basic block. The
+  /// instructions themselves live in the SpirvContext and are not affected.
+  void releaseInstructions();
+
 private:
   uint32_t labelId;      ///< The label's <result-id>
   std::string labelName; ///< The label's debug name
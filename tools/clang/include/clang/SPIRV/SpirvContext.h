@@ -110,6 +110,16 @@ struct FunctionTypeMapInfo {
   }
 };
 
+/// The alignment, size, and array/matrix stride of a type under a layout rule,
+/// as computed by the alignment and size calculator. hasStride is false for
+/// types that do not write a stride.
+struct SpirvTypeLayout {
+  uint32_t alignment;
+  uint32_t size;
+  uint32_t stride;
+  bool hasStride;
+};
+
 /// The class owning various SPIR-V entities allocated in memory during CodeGen.
 ///
 /// All entities should be allocated from an object of this class using
@@ -202,6 +212,14 @@ public:
 
   const HybridPointerType *getPointerType(QualType pointee, spv::StorageClass);
 
+  /// Returns the type layouts memoized for this context. The key is the
+  /// QualType (including sugar, which may carry majorness attributes) and an
+  /// encoding of the layout rule and majorness the layout was computed with.
+  using TypeLayoutKey = std::pair<void *, unsigned>;
+  llvm::DenseMap<TypeLayoutKey, SpirvTypeLayout> &getTypeLayouts() {
+    return typeLayouts;
+  }
+
   /// Functions to get/set current entry point ShaderModelKind.
   ShaderModelKind getCurrentShaderModelKind() { return curShaderModelKind; }
   void setCurrentShaderModelKind(ShaderModelKind smk) {
@@ -274,6 +292,9 @@ private:
   llvm::DenseSet<FunctionType *, FunctionTypeMapInfo> functionTypes;
   const AccelerationStructureTypeNV *accelerationStructureTypeNV;
 
+  // Layouts computed for QualTypes, shared by all alignment calculators.
+  llvm::DenseMap<TypeLayoutKey, SpirvTypeLayout> typeLayouts;
+
   // Current ShaderModelKind for entry point.
   ShaderModelKind curShaderModelKind;
   // Major/Minor hlsl profile version.
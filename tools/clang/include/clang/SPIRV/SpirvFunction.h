@@ -40,6 +40,11 @@ public:
   // Handle SPIR-V function visitors.
   bool invokeVisitor(Visitor *, bool reverseOrder = false);
 
+  // Frees the memory held by the body of this function outside the
+  // SpirvContext, leaving a function with no variables and no basic blocks.
+  // Only to be used once the function has been emitted.
+  void releaseBody();
+
   uint32_t getResultId() const { return functionId; }
   void setResultId(uint32_t id) { functionId = id; }
 
@@ -29,9 +29,26 @@ public:
     Done, //< After finishing the visit of the given construct
   };
 
+  /// How a visitor depends on the visitors that run before it on the same
+  /// module. Consecutive visitors that walk the module in the same order are
+  /// run in one shared traversal when each of them after the first only
+  /// depends on what was visited so far.
+  enum class Dependency {
+    /// The visitor may need the earlier visitors to have finished the whole
+    /// module before it starts.
+    WholeModule,
+    /// The visitor only reads what the earlier visitors did to the construct
+    /// being visited and to the constructs visited before it, and changes
+    /// nothing that the earlier visitors read.
+    VisitedSoFar,
+  };
+
   // Virtual destructor
   virtual ~Visitor() = default;
 
+  /// Returns how this visitor depends on the visitors that run before it.
+  virtual Dependency getDependency() const { return Dependency::WholeModule; }
+
   // Forbid copy construction and assignment
   Visitor(const Visitor &) = delete;
   Visitor &operator=(const Visitor &) = delete;
@@ -52,70 +69,9 @@ public:
   /// regardless of their polymorphism.
   virtual bool visitInstruction(SpirvInstruction *) { return true; }
 
-#define DEFINE_VISIT_METHOD(cls)                                               \
+#define VISITED_INSTRUCTION(cls)                                               \
   virtual bool visit(cls *i) { return visitInstruction(i); }
-
-  DEFINE_VISIT_METHOD(SpirvCapability)
-  DEFINE_VISIT_METHOD(SpirvExtension)
-  DEFINE_VISIT_METHOD(SpirvExtInstImport)
-  DEFINE_VISIT_METHOD(SpirvMemoryModel)
-  DEFINE_VISIT_METHOD(SpirvEntryPoint)
-  DEFINE_VISIT_METHOD(SpirvExecutionMode)
-  DEFINE_VISIT_METHOD(SpirvString)
-  DEFINE_VISIT_METHOD(SpirvSource)
-  DEFINE_VISIT_METHOD(SpirvModuleProcessed)
-  DEFINE_VISIT_METHOD(SpirvDecoration)
-  DEFINE_VISIT_METHOD(SpirvVariable)
-
-  DEFINE_VISIT_METHOD(SpirvFunctionParameter)
-  DEFINE_VISIT_METHOD(SpirvLoopMerge)
-  DEFINE_VISIT_METHOD(SpirvSelectionMerge)
-  DEFINE_VISIT_METHOD(SpirvBranching)
-  DEFINE_VISIT_METHOD(SpirvBranch)
-  DEFINE_VISIT_METHOD(SpirvBranchConditional)
-  DEFINE_VISIT_METHOD(SpirvKill)
-  DEFINE_VISIT_METHOD(SpirvReturn)
-  DEFINE_VISIT_METHOD(SpirvSwitch)
-  DEFINE_VISIT_METHOD(SpirvUnreachable)
-
-  DEFINE_VISIT_METHOD(SpirvAccessChain)
-  DEFINE_VISIT_METHOD(SpirvAtomic)
-  DEFINE_VISIT_METHOD(SpirvBarrier)
-  DEFINE_VISIT_METHOD(SpirvBinaryOp)
-  DEFINE_VISIT_METHOD(SpirvBitFieldExtract)
-  DEFINE_VISIT_METHOD(SpirvBitFieldInsert)
-  DEFINE_VISIT_METHOD(SpirvConstantBoolean)
-  DEFINE_VISIT_METHOD(SpirvConstantInteger)
-  DEFINE_VISIT_METHOD(SpirvConstantFloat)
-  DEFINE_VISIT_METHOD(SpirvConstantComposite)
-  DEFINE_VISIT_METHOD(SpirvConstantNull)
-  DEFINE_VISIT_METHOD(SpirvCompositeConstruct)
-  DEFINE_VISIT_METHOD(SpirvCompositeExtract)
-  DEFINE_VISIT_METHOD(SpirvCompositeInsert)
-  DEFINE_VISIT_METHOD(SpirvEmitVertex)
-  DEFINE_VISIT_METHOD(SpirvEndPrimitive)
-  DEFINE_VISIT_METHOD(SpirvExtInst)
-  DEFINE_VISIT_METHOD(SpirvFunctionCall)
-  DEFINE_VISIT_METHOD(SpirvNonUniformBinaryOp)
-  DEFINE_VISIT_METHOD(SpirvNonUniformElect)
-  DEFINE_VISIT_METHOD(SpirvNonUniformUnaryOp)
-  DEFINE_VISIT_METHOD(SpirvImageOp)
-  DEFINE_VISIT_METHOD(SpirvImageQuery)
-  DEFINE_VISIT_METHOD(SpirvImageSparseTexelsResident)
-  DEFINE_VISIT_METHOD(SpirvImageTexelPointer)
-  DEFINE_VISIT_METHOD(SpirvLoad)
-  DEFINE_VISIT_METHOD(SpirvSampledImage)
-  DEFINE_VISIT_METHOD(SpirvSelect)
-  DEFINE_VISIT_METHOD(SpirvSpecConstantBinaryOp)
-  DEFINE_VISIT_METHOD(SpirvSpecConstantUnaryOp)
-  DEFINE_VISIT_METHOD(SpirvStore)
-  DEFINE_VISIT_METHOD(SpirvUnaryOp)
-  DEFINE_VISIT_METHOD(SpirvVectorShuffle)
-  DEFINE_VISIT_METHOD(SpirvArrayLength)
-  DEFINE_VISIT_METHOD(SpirvRayTracingOpNV)
-  DEFINE_VISIT_METHOD(SpirvDemoteToHelperInvocationEXT)
-
-#undef DEFINE_VISIT_METHOD
+#include "clang/SPIRV/SpirvVisitedInstructions.def"
 
 protected:
   explicit Visitor(const SpirvCodeGenOptions &opts, SpirvContext &ctx)
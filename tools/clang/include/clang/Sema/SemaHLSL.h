@@ -68,6 +68,13 @@ void DiagnoseControlFlowConditionForHLSL(clang::Sema *self,
                                          clang::Expr *condExpr,
                                          llvm::StringRef StmtName);
 
+/// <summary>Declares the built-in object type named Name, if there is one
+/// and it is not declared yet, ahead of a lookup into the translation
+/// unit.</summary>
+void DeclareObjectTypeForLookup(
+  clang::Sema &self,
+  clang::DeclarationName Name);
+
 void DiagnosePackingOffset(
   clang::Sema* self,
   clang::SourceLocation loc,
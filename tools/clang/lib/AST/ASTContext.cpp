@@ -8505,8 +8505,16 @@ bool ASTContext::DeclMustBeEmitted(const Decl *D) {
       return false;
     // HLSL Change Starts
     // Don't just return true because of visibility, unless building a library
-    return FD->getName() == getLangOpts().HLSLEntryFunction ||
-           IsPatchConstantFunctionDecl(FD) || getLangOpts().IsHLSLLibrary;
+    if (getLangOpts().IsHLSLLibrary ||
+        FD->getName() == getLangOpts().HLSLEntryFunction)
+      return true;
+    // Hull shaders name their patch constant function in an attribute rather
+    // than calling it, so keep anything that could be one; other targets
+    // reach every function they need through calls from the entry.
+    StringRef Profile = getLangOpts().HLSLProfile;
+    if (!Profile.empty() && !Profile.startswith("hs_"))
+      return false;
+    return IsPatchConstantFunctionDecl(FD);
     // HLSL Change Ends
   }
   
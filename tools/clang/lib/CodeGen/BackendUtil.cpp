@@ -326,6 +326,15 @@ void EmitAssemblyHelper::CreatePasses() {
   PMBuilder.HLSLExtensionsCodeGen = CodeGenOpts.HLSLExtensionsCodegen.get(); // HLSL Change
   PMBuilder.HLSLResMayAlias = CodeGenOpts.HLSLResMayAlias; // HLSL Change
   PMBuilder.ScanLimit = CodeGenOpts.ScanLimit; // HLSL Change
+  PMBuilder.HLSLAuto16BitPrecision = CodeGenOpts.HLSLAuto16BitPrecision; // HLSL Change
+  PMBuilder.HLSLPadGroupShared = CodeGenOpts.HLSLPadGroupShared; // HLSL Change
+  PMBuilder.HLSLMinimizeMeshOutputs = CodeGenOpts.HLSLMinimizeMeshOutputs; // HLSL Change
+  PMBuilder.HLSLReportLoopHandles = CodeGenOpts.HLSLReportLoopHandles; // HLSL Change
+  PMBuilder.HLSLFastTrig = CodeGenOpts.HLSLFastTrig; // HLSL Change
+  PMBuilder.HLSLWaveAggregateAtomics = CodeGenOpts.HLSLWaveAggregateAtomics; // HLSL Change
+  PMBuilder.HLSLHoistUniform = CodeGenOpts.HLSLHoistUniform; // HLSL Change
+  PMBuilder.HLSLFPContract = CodeGenOpts.HLSLFPContract; // HLSL Change
+  PMBuilder.HLSLMaxLiveScalars = CodeGenOpts.HLSLMaxLiveScalars; // HLSL Change
 
   PMBuilder.DisableUnitAtATime = !CodeGenOpts.UnitAtATime;
   PMBuilder.DisableUnrollLoops = !CodeGenOpts.UnrollLoops;
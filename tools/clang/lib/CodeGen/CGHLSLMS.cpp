@@ -34,6 +34,7 @@
 #include "llvm/IR/GetElementPtrTypeIterator.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
@@ -411,6 +412,25 @@ CGMSHLSLRuntime::CGMSHLSLRuntime(CodeGenModule &CGM)
     unsigned DiagID = Diags.getCustomDiagID(DiagnosticsEngine::Error, "Error parsing -exports options: %0");
     Diags.Report(DiagID) << os.str();
   }
+  const std::string &exportsFile = CGM.getCodeGenOpts().HLSLLibraryExportsFile;
+  if (!exportsFile.empty()) {
+    DiagnosticsEngine &Diags = CGM.getDiags();
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> exportList =
+        llvm::MemoryBuffer::getFile(exportsFile, -1,
+                                    /*RequiresNullTerminator*/ false);
+    std::string listErrors;
+    llvm::raw_string_ostream listOS(listErrors);
+    if (!exportList) {
+      unsigned DiagID = Diags.getCustomDiagID(
+          DiagnosticsEngine::Error, "Cannot read -exports-file '%0': %1");
+      Diags.Report(DiagID) << exportsFile << exportList.getError().message();
+    } else if (!m_ExportMap.ParseExportList((*exportList)->getBuffer(),
+                                            listOS)) {
+      unsigned DiagID = Diags.getCustomDiagID(
+          DiagnosticsEngine::Error, "Error parsing -exports-file '%0': %1");
+      Diags.Report(DiagID) << exportsFile << listOS.str();
+    }
+  }
 }
 
 
@@ -3954,9 +3974,53 @@ bool CGMSHLSLRuntime::IsTrivalInitListExpr(CodeGenFunction &CGF,
   return result;
 }
 
+// Returns true if every element of the init list, after conversions, is a
+// numeric literal.
+static bool IsLiteralInitList(const InitListExpr *E) {
+  for (const Expr *Init : E->inits()) {
+    Init = Init->IgnoreParenCasts();
+    if (const UnaryOperator *UO = dyn_cast<UnaryOperator>(Init)) {
+      if (UO->getOpcode() == UO_Minus || UO->getOpcode() == UO_Plus)
+        Init = UO->getSubExpr()->IgnoreParenCasts();
+    }
+    if (const InitListExpr *SubList = dyn_cast<InitListExpr>(Init)) {
+      if (!IsLiteralInitList(SubList))
+        return false;
+    } else if (!isa<IntegerLiteral>(Init) && !isa<FloatingLiteral>(Init) &&
+               !isa<CXXBoolLiteralExpr>(Init)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Arrays initialized from at least this many bytes of literals are copied
+// from a constant global rather than stored element by element.
+static const unsigned kMinLiteralInitListCopySize = 1024;
+
 Value *CGMSHLSLRuntime::EmitHLSLInitListExpr(CodeGenFunction &CGF, InitListExpr *E,
       // The destPtr when emiting aggregate init, for normal case, it will be null.
       Value *DestPtr) {
+  // Large tables of literals become a single constant. The memcpy from it is
+  // folded away by SROA when the destination is not written again, which
+  // leaves loads from the global instead of a store per element.
+  if (DestPtr && E->getType()->isConstantArrayType()) {
+    llvm::Type *DestTy = DestPtr->getType()->getPointerElementType();
+    if (TheModule.getDataLayout().getTypeAllocSize(DestTy) >=
+            kMinLiteralInitListCopySize &&
+        IsLiteralInitList(E)) {
+      Constant *Init = EmitHLSLConstInitListExpr(CGF.CGM, E);
+      if (Init && Init->getType() == DestTy) {
+        GlobalVariable *GV = new GlobalVariable(
+            TheModule, DestTy, /*isConstant*/ true,
+            GlobalValue::InternalLinkage, Init, DestPtr->getName() + ".init");
+        GV->setUnnamedAddr(true);
+        EmitHLSLAggregateCopy(CGF, GV, DestPtr, E->getType());
+        return nullptr;
+      }
+    }
+  }
+
   if (DestPtr && E->getNumInits() == 1) {
     llvm::Type *ExpTy = CGF.ConvertType(E->getType());
     llvm::Type *TargetTy = CGF.ConvertType(E->getInit(0)->getType());
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "CoverageMappingGen.h"
+#include "dxc/Support/DxcTrace.h" // HLSL Change
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/DeclCXX.h"
@@ -55,6 +56,8 @@ namespace clang {
 
     std::unique_ptr<llvm::Module> TheModule, LinkModule;
 
+    bool DeferBackendOutput = false; // HLSL Change
+
   public:
     BackendConsumer(BackendAction Action, DiagnosticsEngine &Diags,
                     const HeaderSearchOptions &HeaderSearchOpts,
@@ -84,6 +87,7 @@ namespace clang {
 
     std::unique_ptr<llvm::Module> takeModule() { return std::move(TheModule); }
     llvm::Module *takeLinkModule() { return LinkModule.release(); }
+    void setDeferBackendOutput(bool Defer) { DeferBackendOutput = Defer; } // HLSL Change
 
     void HandleCXXStaticMemberVarInstantiation(VarDecl *VD) override {
       Gen->HandleCXXStaticMemberVarInstantiation(VD);
@@ -140,6 +144,7 @@ namespace clang {
     void HandleTranslationUnit(ASTContext &C) override {
       {
         PrettyStackTraceString CrashInfo("Per-file LLVM IR generation");
+        hlsl::DxcTraceSpan CodeGenSpan("codegen"); // HLSL Change
         if (llvm::TimePassesIsEnabled)
           LLVMIRGeneration.startTimer();
 
@@ -174,6 +179,11 @@ namespace clang {
           return;
       }
 
+      // HLSL Change Starts - the action runs the backend after the AST is gone.
+      if (DeferBackendOutput)
+        return;
+      // HLSL Change Ends
+
       // Install an inline asm handler so that diagnostics get printed through
       // our diagnostics hooks.
       LLVMContext &Ctx = TheModule->getContext();
@@ -187,9 +197,12 @@ namespace clang {
       void *OldDiagnosticContext = Ctx.getDiagnosticContext();
       Ctx.setDiagnosticHandler(DiagnosticHandler, this);
 
-      EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
-                        C.getTargetInfo().getTargetDescription(),
-                        TheModule.get(), Action, AsmOutStream);
+      {
+        hlsl::DxcTraceSpan PassSpan("pass-pipeline"); // HLSL Change
+        EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                          C.getTargetInfo().getTargetDescription(),
+                          TheModule.get(), Action, AsmOutStream);
+      }
 
       Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
 
@@ -583,6 +596,40 @@ void BackendConsumer::DiagnosticHandlerImpl(const DiagnosticInfo &DI) {
   FullSourceLoc Loc;
   Diags.Report(Loc, DiagID).AddString(MsgStorage);
 }
+
+// HLSL Change Starts
+/// Reports diagnostics of a deferred backend. The AST is gone, so there are
+/// no declarations to locate them at; messages that carry their location in
+/// the text, like DXIL errors, are reported as they are.
+static void DeferredBackendDiagnosticHandler(const DiagnosticInfo &DI,
+                                             void *Context) {
+  DiagnosticsEngine &Diags = *static_cast<DiagnosticsEngine *>(Context);
+  unsigned DiagID;
+  llvm::DiagnosticSeverity Severity = DI.getSeverity();
+  switch (DI.getKind()) {
+  case llvm::DK_InlineAsm:
+    ComputeDiagID(Severity, inline_asm, DiagID);
+    break;
+  case llvm::DK_OptimizationRemark:
+  case llvm::DK_OptimizationRemarkMissed:
+  case llvm::DK_OptimizationRemarkAnalysis:
+    // Remarks are only enabled by -Rpass, which HLSL does not support.
+    return;
+  default:
+    ComputeDiagRemarkID(Severity, backend_plugin, DiagID);
+    break;
+  }
+  std::string MsgStorage;
+  if (const auto *IA = dyn_cast<DiagnosticInfoInlineAsm>(&DI)) {
+    MsgStorage = IA->getMsgStr().str();
+  } else {
+    raw_string_ostream Stream(MsgStorage);
+    DiagnosticPrinterRawOStream DP(Stream);
+    DI.print(DP);
+  }
+  Diags.Report(FullSourceLoc(), DiagID).AddString(MsgStorage);
+}
+// HLSL Change Ends
 #undef ComputeDiagID
 
 CodeGenAction::CodeGenAction(unsigned _Act, LLVMContext *_VMContext)
@@ -609,6 +656,7 @@ void CodeGenAction::EndSourceFileAction() {
 
   // Steal the module from the consumer.
   TheModule = BEConsumer->takeModule();
+  BackendOutputPending = DeferBackendOutput && TheModule; // HLSL Change
 }
 
 std::unique_ptr<llvm::Module> CodeGenAction::takeModule() {
@@ -642,12 +690,51 @@ GetOutputStream(CompilerInstance &CI, StringRef InFile, BackendAction Action) {
   llvm_unreachable("Invalid action!");
 }
 
+// HLSL Change Starts
+void CodeGenAction::EmitDeferredBackendOutput(CompilerInstance &CI) {
+  if (!BackendOutputPending)
+    return;
+  BackendOutputPending = false;
+
+  BackendAction BA = static_cast<BackendAction>(Act);
+  raw_pwrite_stream *OS = GetOutputStream(CI, DeferredInFile, BA);
+  if (BA != Backend_EmitNothing && !OS)
+    return;
+
+  LLVMContext &Ctx = TheModule->getContext();
+  LLVMContext::DiagnosticHandlerTy OldDiagnosticHandler =
+      Ctx.getDiagnosticHandler();
+  void *OldDiagnosticContext = Ctx.getDiagnosticContext();
+  Ctx.setDiagnosticHandler(DeferredBackendDiagnosticHandler,
+                           &CI.getDiagnostics());
+  {
+    hlsl::DxcTraceSpan PassSpan("pass-pipeline");
+    EmitBackendOutput(CI.getDiagnostics(), CI.getCodeGenOpts(),
+                      CI.getTargetOpts(), CI.getLangOpts(),
+                      CI.getTarget().getTargetDescription(), TheModule.get(),
+                      BA, OS);
+  }
+  Ctx.setDiagnosticHandler(OldDiagnosticHandler, OldDiagnosticContext);
+
+  // EndSourceFile already closed the outputs it opened.
+  CI.clearOutputFiles(
+      /*EraseFiles=*/CI.getDiagnostics().hasErrorOccurred());
+}
+// HLSL Change Ends
+
 std::unique_ptr<ASTConsumer>
 CodeGenAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
   BackendAction BA = static_cast<BackendAction>(Act);
-  raw_pwrite_stream *OS = GetOutputStream(CI, InFile, BA);
-  if (BA != Backend_EmitNothing && !OS)
-    return nullptr;
+  // HLSL Change Starts - a deferred backend opens its output when it runs.
+  raw_pwrite_stream *OS = nullptr;
+  if (DeferBackendOutput) {
+    DeferredInFile = InFile;
+  } else {
+    OS = GetOutputStream(CI, InFile, BA);
+    if (BA != Backend_EmitNothing && !OS)
+      return nullptr;
+  }
+  // HLSL Change Ends
 
   llvm::Module *LinkModuleToUse = LinkModule;
 
@@ -684,6 +771,7 @@ CodeGenAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
       CI.getPreprocessorOpts(), CI.getCodeGenOpts(), CI.getTargetOpts(),
       CI.getLangOpts(), CI.getFrontendOpts().ShowTimers, InFile,
       LinkModuleToUse, OS, *VMContext, CoverageInfo));
+  Result->setDeferBackendOutput(DeferBackendOutput); // HLSL Change
   BEConsumer = Result.get();
   return std::move(Result);
 }
@@ -26,6 +26,7 @@
 #include "llvm/IR/Module.h"
 #include <memory>
 #include "dxc/DXIL/DxilMetadataHelper.h" // HLSL Change - dx source info
+#include "dxc/Support/DxcSourceStore.h" // HLSL Change - dx source references
 using namespace clang;
 
 namespace {
@@ -228,6 +229,25 @@ namespace {
               llvm::MDString::get(LLVMCtx, content) });
           pContents->addOperand(pFileInfo);
         };
+        // Included files may be referred to by digest, with empty contents,
+        // and kept in a source store instead.
+        auto AddIncludedFile = [&](StringRef name, StringRef content) {
+          if (!CodeGenOpts.HLSLSourceReferences) {
+            AddFile(name, content);
+            return;
+          }
+          if (pContents == nullptr) {
+            pContents = M->getOrInsertNamedMetadata(
+              hlsl::DxilMDHelper::kDxilSourceContentsMDName);
+          }
+          llvm::MDTuple *pFileInfo = llvm::MDNode::get(
+            LLVMCtx,
+            { llvm::MDString::get(LLVMCtx, name),
+              llvm::MDString::get(LLVMCtx, ""),
+              llvm::MDString::get(LLVMCtx,
+                                  hlsl::ComputeSourceDigest(content)) });
+          pContents->addOperand(pFileInfo);
+        };
         std::map<StringRef, StringRef> filesMap;
         bool bFoundMainFile = false;
         for (SourceManager::fileinfo_iterator
@@ -249,7 +269,7 @@ namespace {
         assert(bFoundMainFile && "otherwise, no file found matches main filename");
         // Emit the rest of the files in sorted order.
         for (auto it : filesMap) {
-          AddFile(it.first, it.second);
+          AddIncludedFile(it.first, it.second);
         }
 
         // Add Defines to Debug Info
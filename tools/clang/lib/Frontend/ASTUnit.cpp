@@ -1975,7 +1975,8 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
     bool AllowPCHWithCompilerErrors, bool SkipFunctionBodies,
     bool UserFilesAreVolatile, bool ForSerialization,
     std::unique_ptr<ASTUnit> *ErrAST,
-    hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions) { // HLSL Change
+    hlsl::DxcLangExtensionsHelperApply *HlslLangExtensions, // HLSL Change
+    bool SkipIncludedFunctionBodies) { // HLSL Change
   assert(Diags.get() && "no DiagnosticsEngine was provided");
 
   SmallVector<StoredDiagnostic, 4> StoredDiagnostics;
@@ -2033,6 +2034,7 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
   CI->getHeaderSearchOpts().ResourceDir = ResourceFilesPath;
 
   CI->getFrontendOpts().SkipFunctionBodies = SkipFunctionBodies;
+  CI->getFrontendOpts().SkipIncludedFunctionBodies = SkipIncludedFunctionBodies; // HLSL Change
 
   // Create the AST unit.
   std::unique_ptr<ASTUnit> AST;
@@ -713,6 +713,9 @@ void HLSLRootSignatureAction::ExecuteAction() {
   Preprocessor &PP = CI.getPreprocessor();
   // Ignore unknown pragmas.
   PP.IgnorePragmas();
+  // Only the directives matter to find the macro's final definition; the
+  // shader code in between is not expanded.
+  PP.SetMacroExpansionOnlyInDirectives();
 
   // Scans and ignores all tokens in the files.
   PP.EnterMainSourceFile();
@@ -720,6 +723,7 @@ void HLSLRootSignatureAction::ExecuteAction() {
   Token Tok;
   do PP.Lex(Tok);
   while (Tok.isNot(tok::eof));
+  PP.ResetMacroExpansionOnlyInDirectives();
 
   hlsl::DxilRootSignatureVersion  rootSigVer;
   if (rootSigMinor == 0) {
@@ -1961,6 +1961,89 @@ bool Lexer::LexCharConstant(Token &Result, const char *CurPtr,
   return true;
 }
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#elif __ALTIVEC__
+#include <altivec.h>
+#undef bool
+#elif defined(__ARM_NEON) // HLSL Change Begin
+#include <arm_neon.h>
+#endif // HLSL Change End
+
+// HLSL Change Starts - Scan runs of whitespace and line comments 16 bytes at a
+// time; generated shaders and their headers are full of both.
+
+/// Return the first character at or after CurPtr that is not horizontal
+/// whitespace.
+static const char *SkipHorizontalWhitespaceRun(const char *CurPtr,
+                                               const char *BufferEnd) {
+#if defined(__SSE2__)
+  const __m128i Spaces = _mm_set1_epi8(' ');
+  const __m128i Tabs = _mm_set1_epi8('\t');
+  while (CurPtr + 16 <= BufferEnd) {
+    __m128i V = _mm_loadu_si128((const __m128i *)CurPtr);
+    unsigned Mask = (unsigned)_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(V, Spaces), _mm_cmpeq_epi8(V, Tabs)));
+    if (Mask != 0xFFFF) {
+      CurPtr += llvm::countTrailingZeros<unsigned>(~Mask);
+      break;
+    }
+    CurPtr += 16;
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t Spaces = vdupq_n_u8(' ');
+  const uint8x16_t Tabs = vdupq_n_u8('\t');
+  while (CurPtr + 16 <= BufferEnd) {
+    uint8x16_t V = vld1q_u8((const uint8_t *)CurPtr);
+    uint64x2_t Mask = vreinterpretq_u64_u8(
+        vorrq_u8(vceqq_u8(V, Spaces), vceqq_u8(V, Tabs)));
+    if ((vgetq_lane_u64(Mask, 0) & vgetq_lane_u64(Mask, 1)) != ~0ULL)
+      break;
+    CurPtr += 16;
+  }
+#endif
+  // Form feeds and vertical tabs are rare enough to leave to this loop.
+  while (isHorizontalWhitespace(*CurPtr))
+    ++CurPtr;
+  return CurPtr;
+}
+
+/// Return the first newline or nul character at or after CurPtr.
+static const char *FindLineCommentEnd(const char *CurPtr,
+                                      const char *BufferEnd) {
+#if defined(__SSE2__)
+  const __m128i Newlines = _mm_set1_epi8('\n');
+  const __m128i Returns = _mm_set1_epi8('\r');
+  const __m128i Zeros = _mm_setzero_si128();
+  while (CurPtr + 16 <= BufferEnd) {
+    __m128i V = _mm_loadu_si128((const __m128i *)CurPtr);
+    unsigned Mask = (unsigned)_mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(V, Newlines),
+                                  _mm_cmpeq_epi8(V, Returns)),
+                     _mm_cmpeq_epi8(V, Zeros)));
+    if (Mask != 0)
+      return CurPtr + llvm::countTrailingZeros<unsigned>(Mask);
+    CurPtr += 16;
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t Newlines = vdupq_n_u8('\n');
+  const uint8x16_t Returns = vdupq_n_u8('\r');
+  while (CurPtr + 16 <= BufferEnd) {
+    uint8x16_t V = vld1q_u8((const uint8_t *)CurPtr);
+    uint64x2_t Mask = vreinterpretq_u64_u8(
+        vorrq_u8(vorrq_u8(vceqq_u8(V, Newlines), vceqq_u8(V, Returns)),
+                 vceqq_u8(V, vdupq_n_u8(0))));
+    if ((vgetq_lane_u64(Mask, 0) | vgetq_lane_u64(Mask, 1)) != 0)
+      break;
+    CurPtr += 16;
+  }
+#endif
+  while (*CurPtr != 0 && *CurPtr != '\n' && *CurPtr != '\r')
+    ++CurPtr;
+  return CurPtr;
+}
+// HLSL Change Ends
+
 /// SkipWhitespace - Efficiently skip over a series of whitespace characters.
 /// Update BufferPtr to point to the next non-whitespace character and return.
 ///
@@ -1976,8 +2059,12 @@ bool Lexer::SkipWhitespace(Token &Result, const char *CurPtr,
   // Skip consecutive spaces efficiently.
   while (1) {
     // Skip horizontal whitespace very aggressively.
-    while (isHorizontalWhitespace(Char))
-      Char = *++CurPtr;
+    // HLSL Change Begin - Skip long runs, such as indentation, in blocks.
+    if (isHorizontalWhitespace(Char)) {
+      CurPtr = SkipHorizontalWhitespaceRun(CurPtr + 1, BufferEnd);
+      Char = *CurPtr;
+    }
+    // HLSL Change End
 
     // Otherwise if we have something other than whitespace, we're done.
     if (!isVerticalWhitespace(Char))
@@ -2050,11 +2137,12 @@ bool Lexer::SkipLineComment(Token &Result, const char *CurPtr,
   // them.  As such, optimize for this case with the inner loop.
   char C;
   do {
-    C = *CurPtr;
     // Skip over characters in the fast loop.
-    while (C != 0 &&                // Potentially EOF.
-           C != '\n' && C != '\r')  // Newline or DOS-style newline.
-      C = *++CurPtr;
+    // HLSL Change Begin - Scan for the end of the line in blocks.
+    // Stop at EOF, a newline or a DOS-style newline.
+    CurPtr = FindLineCommentEnd(CurPtr, BufferEnd);
+    C = *CurPtr;
+    // HLSL Change End
 
     const char *NextLine = CurPtr;
     if (C != 0) {
@@ -2255,13 +2343,6 @@ static bool isEndOfBlockCommentWithEscapedNewLine(const char *CurPtr,
   return true;
 }
 
-#ifdef __SSE2__
-#include <emmintrin.h>
-#elif __ALTIVEC__
-#include <altivec.h>
-#undef bool
-#endif
-
 /// We have just read from input the / and * characters that started a comment.
 /// Read until we find the * and / characters that terminate the comment.
 /// Note that we don't bother decoding trigraphs or escaped newlines in block
@@ -23,6 +23,8 @@
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/SemaConsumer.h"
 #include "clang/Sema/SemaHLSL.h" // HLSL Change
+#include "dxc/Support/DxcCompileDeadline.h" // HLSL Change
+#include "dxc/Support/DxcTrace.h" // HLSL Change
 #include "llvm/Support/CrashRecoveryContext.h"
 #include <cstdio>
 #include <memory>
@@ -97,7 +99,8 @@ void clang::ParseAST(Preprocessor &PP, ASTConsumer *Consumer,
   ParseAST(*S.get(), PrintStats, SkipFunctionBodies);
 }
 
-void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
+void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies,
+                     bool SkipIncludedFunctionBodies) { // HLSL Change
   // Collect global stats on Decls/Stmts (until we have a module streamer).
   if (PrintStats) {
     Decl::EnableStatistics();
@@ -111,7 +114,8 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
   ASTConsumer *Consumer = &S.getASTConsumer();
 
   std::unique_ptr<Parser> ParseOP(
-      new Parser(S.getPreprocessor(), S, SkipFunctionBodies));
+      new Parser(S.getPreprocessor(), S, SkipFunctionBodies,
+                 SkipIncludedFunctionBodies)); // HLSL Change
   Parser &P = *ParseOP.get();
 
   PrettyStackTraceParserEntry CrashInfo(P);
@@ -133,6 +137,9 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
     External->StartTranslationUnit(Consumer);
 
   if (!S.getDiagnostics().hasUnrecoverableErrorOccurred()) {  // HLSL Change: Skip if fatal error already occurred
+    // HLSL Change: Sema and the IR generation of each declaration run as it
+    // is parsed, so they are traced as part of parsing.
+    hlsl::DxcTraceSpan ParseSpan("parse"); // HLSL Change
     if (P.ParseTopLevelDecl(ADecl)) {
       if (!External && !S.getLangOpts().CPlusPlus)
         P.Diag(diag::ext_empty_translation_unit);
@@ -143,6 +150,7 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
         // skipping something.
         if (ADecl && !Consumer->HandleTopLevelDecl(ADecl.get()))
           return;
+        hlsl::CheckCompileDeadline(); // HLSL Change
       } while (!P.ParseTopLevelDecl(ADecl));
     }
   } // HLSL Change: Skip if fatal error already occurred
@@ -155,7 +163,12 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
   // Provide the opportunity to generate translation-unit level validation
   // errors in the front-end, without relying on code generation being
   // available.
-  hlsl::DiagnoseTranslationUnit(&S);
+  {
+    hlsl::DxcTraceSpan SemaSpan("sema");
+    hlsl::DiagnoseTranslationUnit(&S);
+  }
+  // Stop before code generation if the compile was cancelled during Sema.
+  hlsl::CheckCompileDeadline();
   // HLSL Change Ends
   Consumer->HandleTranslationUnit(S.getASTContext());
 
@@ -68,12 +68,18 @@ IdentifierInfo *Parser::getSEHExceptKeyword() {
   return Ident__except;
 }
 
-Parser::Parser(Preprocessor &pp, Sema &actions, bool skipFunctionBodies)
+Parser::Parser(Preprocessor &pp, Sema &actions, bool skipFunctionBodies,
+               bool skipIncludedFunctionBodies) // HLSL Change
   : PP(pp), Actions(actions), Diags(PP.getDiagnostics()),
     GreaterThanIsOperator(true), ColonIsSacred(false), 
     InMessageExpression(false), TemplateParameterDepth(0),
     ParsingInObjCContainer(false) {
   SkipFunctionBodies = pp.isCodeCompletionEnabled() || skipFunctionBodies;
+  // HLSL Change Starts - skipping all bodies takes precedence
+  SkipOnlyIncludedFunctionBodies = !SkipFunctionBodies &&
+                                   skipIncludedFunctionBodies;
+  SkipFunctionBodies = SkipFunctionBodies || skipIncludedFunctionBodies;
+  // HLSL Change Ends
   Tok.startToken();
   Tok.setKind(tok::eof);
   Actions.CurScope = nullptr;
@@ -66,6 +66,39 @@ void AlignmentSizeCalculator::alignUsingHLSLRelaxedLayout(
 std::pair<uint32_t, uint32_t> AlignmentSizeCalculator::getAlignmentAndSize(
     QualType type, SpirvLayoutRule rule, llvm::Optional<bool> isRowMajor,
     uint32_t *stride) {
+  const unsigned majorness =
+      isRowMajor.hasValue() ? (isRowMajor.getValue() ? 2 : 1) : 0;
+  const SpirvContext::TypeLayoutKey key = {
+      type.getAsOpaquePtr(), static_cast<unsigned>(rule) * 3 + majorness};
+
+  auto &typeLayouts = spvContext.getTypeLayouts();
+  auto found = typeLayouts.find(key);
+  if (found != typeLayouts.end()) {
+    const SpirvTypeLayout &layout = found->second;
+    if (layout.hasStride && stride)
+      *stride = layout.stride;
+    return {layout.alignment, layout.size};
+  }
+
+  // Only the strides of arrays and matrices are written, so start from a
+  // value that no layout produces to find out whether one was.
+  const uint32_t kNoStride = ~0u;
+  uint32_t newStride = kNoStride;
+  const auto result =
+      computeAlignmentAndSize(type, rule, isRowMajor, &newStride);
+  const bool hasStride = newStride != kNoStride;
+  if (hasStride && stride)
+    *stride = newStride;
+
+  // Errors are not memoized, so each use of the type still reports them.
+  if (result.first != 0)
+    typeLayouts[key] = {result.first, result.second, newStride, hasStride};
+  return result;
+}
+
+std::pair<uint32_t, uint32_t> AlignmentSizeCalculator::computeAlignmentAndSize(
+    QualType type, SpirvLayoutRule rule, llvm::Optional<bool> isRowMajor,
+    uint32_t *stride) {
   // std140 layout rules:
 
   // 1. If the member is a scalar consuming N basic machine units, the base
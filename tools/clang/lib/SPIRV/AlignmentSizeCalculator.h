@@ -12,6 +12,7 @@
 
 #include "dxc/Support/SPIRVOptions.h"
 #include "clang/AST/ASTContext.h"
+#include "clang/SPIRV/SpirvContext.h"
 
 namespace clang {
 namespace spirv {
@@ -19,8 +20,9 @@ namespace spirv {
 /// The class responsible to translate Clang frontend types into SPIR-V types.
 class AlignmentSizeCalculator {
 public:
-  AlignmentSizeCalculator(ASTContext &astCtx, const SpirvCodeGenOptions &opts)
-      : astContext(astCtx), spvOptions(opts) {}
+  AlignmentSizeCalculator(ASTContext &astCtx, SpirvContext &spvCtx,
+                          const SpirvCodeGenOptions &opts)
+      : astContext(astCtx), spvContext(spvCtx), spvOptions(opts) {}
 
   /// \brief Returns the alignment and size in bytes for the given type
   /// according to the given LayoutRule. If the caller has information about
@@ -35,6 +37,9 @@ public:
   /// will occupy in memory; rather it is used in conjunction with alignment
   /// to get the next available location (alignment + size), which means
   /// size contains post-paddings required by the given type.
+  ///
+  /// Results are memoized in the SpirvContext, so a type laid out once is not
+  /// walked again by this or any other calculator sharing the context.
   std::pair<uint32_t, uint32_t>
   getAlignmentAndSize(QualType type, SpirvLayoutRule rule,
                       llvm::Optional<bool> isRowMajor, uint32_t *stride);
@@ -49,6 +54,12 @@ public:
                                    uint32_t *currentOffset);
 
 private:
+  /// Computes the alignment and size of the given type without looking up the
+  /// memoized layouts; the parameters are those of getAlignmentAndSize.
+  std::pair<uint32_t, uint32_t>
+  computeAlignmentAndSize(QualType type, SpirvLayoutRule rule,
+                          llvm::Optional<bool> isRowMajor, uint32_t *stride);
+
   /// Emits error to the diagnostic engine associated with this visitor.
   template <unsigned N>
   DiagnosticBuilder emitError(const char (&message)[N],
@@ -60,6 +71,7 @@ private:
 
 private:
   ASTContext &astContext;                /// AST context
+  SpirvContext &spvContext;              /// SPIR-V context
   const SpirvCodeGenOptions &spvOptions; /// SPIR-V options
 };
 
@@ -26,6 +26,11 @@ public:
       : Visitor(opts, spvCtx), spvBuilder(builder),
         featureManager(astCtx.getDiagnostics(), opts) {}
 
+  /// Capabilities only depend on the lowered type of the instruction being
+  /// visited and on the entry points, which are visited before anything that
+  /// needs them.
+  Dependency getDependency() const { return Dependency::VisitedSoFar; }
+
   bool visit(SpirvDecoration *decor);
   bool visit(SpirvEntryPoint *);
   bool visit(SpirvExecutionMode *);
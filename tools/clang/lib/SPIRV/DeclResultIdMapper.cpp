@@ -13,6 +13,7 @@
 
 #include "dxc/DXIL/DxilConstants.h"
 #include "dxc/DXIL/DxilTypeSystem.h"
+#include "dxc/HLSL/DxilSpanAllocator.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/HlslTypes.h"
 #include "clang/SPIRV/AstTypeProbe.h"
@@ -913,6 +914,7 @@ SpirvVariable *DeclResultIdMapper::createPushConstant(const VarDecl *decl) {
 
   // Register the VarDecl
   astDecls[decl] = DeclSpirvInfo(var);
+  pushConstantDecls.push_back(decl);
 
   // Do not push this variable into resourceVars since it does not need
   // descriptor set.
@@ -933,6 +935,7 @@ DeclResultIdMapper::createShaderRecordBufferNV(const VarDecl *decl) {
 
   // Register the VarDecl
   astDecls[decl] = DeclSpirvInfo(var);
+  pushConstantDecls.push_back(decl);
 
   // Do not push this variable into resourceVars since it does not need
   // descriptor set.
@@ -1072,6 +1075,7 @@ void DeclResultIdMapper::registerSpecConstant(const VarDecl *decl,
                                               SpirvInstruction *specConstant) {
   specConstant->setRValue();
   astDecls[decl] = DeclSpirvInfo(specConstant);
+  specConstantDecls.push_back(decl);
 }
 
 void DeclResultIdMapper::createCounterVar(
@@ -1224,65 +1228,54 @@ private:
 
 /// A class for managing resource bindings to avoid duplicate uses of the same
 /// set and binding number.
+///
+/// The used binding numbers of each set are kept as spans, so an array of
+/// resources takes one entry however many bindings it uses, and finding room
+/// for the next resource does not walk every binding used before it.
 class BindingSet {
 public:
-  /// Uses the given set and binding number. Returns false if the binding number
-  /// was already occupied in the set, and returns true otherwise.
-  bool useBinding(uint32_t binding, uint32_t set) {
-    bool inserted = false;
-    std::tie(std::ignore, inserted) = usedBindings[set].insert(binding);
-    return inserted;
-  }
-
-  /// Uses the next avaiable binding number in |set|. If more than one binding
-  /// number is to be occupied, it finds the next available chunk that can fit
-  /// |numBindingsToUse| in the |set|.
-  uint32_t useNextBinding(uint32_t set, uint32_t numBindingsToUse = 1) {
-    uint32_t bindingNoStart = getNextBindingChunk(set, numBindingsToUse);
-    auto &binding = usedBindings[set];
-    for (uint32_t i = 0; i < numBindingsToUse; ++i)
-      binding.insert(bindingNoStart + i);
-    return bindingNoStart;
+  /// Uses |count| binding numbers from the given binding number in the given
+  /// set for |var|. Returns false if any of them was already occupied in the
+  /// set, and returns true otherwise.
+  bool useBinding(const ResourceVar &var, uint32_t binding, uint32_t set,
+                  uint32_t count = 1) {
+    if (count == 0)
+      return true;
+    const uint32_t last = count - 1 > UINT_MAX - binding ? UINT_MAX
+                                                         : binding + count - 1;
+    Allocator &allocator = getAllocator(set);
+    if (!allocator.Insert(&var, binding, last))
+      return true;
+    // Overlaps are kept, since the optimizer may still remove one of the
+    // resources.
+    allocator.ForceInsertAndClobber(&var, binding, last);
+    return false;
   }
 
-  /// Returns the first available binding number in the |set| for which |n|
-  /// consecutive binding numbers are unused.
-  uint32_t getNextBindingChunk(uint32_t set, uint32_t n) {
-    auto &existingBindings = usedBindings[set];
-
-    // There were no bindings in this set. Can start at binding zero.
-    if (existingBindings.empty())
-      return 0;
-
-    // Check whether the chunk of |n| binding numbers can be fitted at the
-    // very beginning of the list (start at binding 0 in the current set).
-    uint32_t curBinding = *existingBindings.begin();
-    if (curBinding >= n)
+  /// Uses the next avaiable binding number in |set| for |var|. If more than
+  /// one binding number is to be occupied, it finds the first available chunk
+  /// that can fit |numBindingsToUse| in the |set|.
+  uint32_t useNextBinding(const ResourceVar &var, uint32_t set,
+                          uint32_t numBindingsToUse = 1) {
+    if (numBindingsToUse == 0)
       return 0;
+    uint32_t bindingNoStart = 0;
+    getAllocator(set).Allocate(&var, numBindingsToUse, bindingNoStart);
+    return bindingNoStart;
+  }
 
-    auto iter = std::next(existingBindings.begin());
-    while (iter != existingBindings.end()) {
-      // There exists a next binding number that is used. Check to see if the
-      // gap between current binding number and next binding number is large
-      // enough to accommodate |n|.
-      uint32_t nextBinding = *iter;
-      if (n <= nextBinding - curBinding - 1)
-        return curBinding + 1;
-
-      curBinding = nextBinding;
-
-      // Peek at the next binding that has already been used (if any).
-      ++iter;
-    }
+private:
+  using Allocator = hlsl::SpanAllocator<uint32_t, ResourceVar>;
 
-    // |curBinding| was the last binding that was used in this set. The next
-    // chunk of |n| bindings can start at |curBinding|+1.
-    return curBinding + 1;
+  Allocator &getAllocator(uint32_t set) {
+    auto found = usedBindings.find(set);
+    if (found == usedBindings.end())
+      found = usedBindings.emplace(set, Allocator(0, UINT_MAX)).first;
+    return found->second;
   }
 
-private:
-  ///< set number -> set of used binding number
-  llvm::DenseMap<uint32_t, std::set<uint32_t>> usedBindings;
+  ///< set number -> spans of used binding numbers
+  std::map<uint32_t, Allocator> usedBindings;
 };
 } // namespace
 
@@ -1370,7 +1363,7 @@ bool DeclResultIdMapper::finalizeStageIOLocations(bool forInput) {
       }
       locSet.useLoc(loc, idx);
 
-      spvBuilder.decorateLocation(var.getSpirvInstr(), loc);
+      decorateLocation(var, loc);
       if (var.getIndexAttr())
         spvBuilder.decorateIndex(var.getSpirvInstr(), idx,
                                  var.getSemanticInfo().loc);
@@ -1401,7 +1394,7 @@ bool DeclResultIdMapper::finalizeStageIOLocations(bool forInput) {
     // We should special rules for SV_Target: the location number comes from the
     // semantic string index.
     if (semaInfo.isTarget()) {
-      spvBuilder.decorateLocation(var.getSpirvInstr(), semaInfo.index);
+      decorateLocation(var, semaInfo.index);
       locSet.useLoc(semaInfo.index);
     } else {
       vars.push_back(&var);
@@ -1423,8 +1416,7 @@ bool DeclResultIdMapper::finalizeStageIOLocations(bool forInput) {
   }
 
   for (const auto *var : vars)
-    spvBuilder.decorateLocation(var->getSpirvInstr(),
-                                locSet.useNextLocs(var->getLocationCount()));
+    decorateLocation(*var, locSet.useNextLocs(var->getLocationCount()));
 
   return true;
 }
@@ -1584,11 +1576,10 @@ bool DeclResultIdMapper::decorateResourceBindings() {
                       var.getSourceLocation());
             return false;
           }
-          spvBuilder.decorateDSetBinding(var.getSpirvInstr(), setNo, bindNo);
+          decorateDSetBinding(var, setNo, bindNo);
         }
       } else if (bindGlobals && var.isGlobalsBuffer()) {
-        spvBuilder.decorateDSetBinding(var.getSpirvInstr(), globalsSetNo,
-                                       globalsBindNo);
+        decorateDSetBinding(var, globalsSetNo, globalsBindNo);
       } else {
         emitError(
             "-fvk-bind-register requires register annotations on all resources",
@@ -1614,17 +1605,16 @@ bool DeclResultIdMapper::decorateResourceBindings() {
     if (spirvOptions.flattenResourceArrays)
       numBindingsToUse = var.getArraySize();
 
-    for (uint32_t i = 0; i < numBindingsToUse; ++i) {
-      bool success = bindingSet.useBinding(bindingNo + i, setNo);
-      // We will not emit an error if we find a set/binding overlap because it
-      // is possible that the optimizer optimizes away a resource which resolves
-      // the overlap.
-      (void)success;
-    }
+    bool success =
+        bindingSet.useBinding(var, bindingNo, setNo, numBindingsToUse);
+    // We will not emit an error if we find a set/binding overlap because it
+    // is possible that the optimizer optimizes away a resource which resolves
+    // the overlap.
+    (void)success;
 
     // No need to decorate multiple binding numbers for arrays. It will be done
     // by legalization/optimization.
-    spvBuilder.decorateDSetBinding(var.getSpirvInstr(), setNo, bindingNo);
+    decorateDSetBinding(var, setNo, bindingNo);
   };
 
   for (const auto &var : resourceVars) {
@@ -1704,17 +1694,15 @@ bool DeclResultIdMapper::decorateResourceBindings() {
         else if (const auto *reg = var.getRegister())
           set = reg->RegisterSpace.getValueOr(defaultSpace);
 
-        spvBuilder.decorateDSetBinding(
-            var.getSpirvInstr(), set,
-            bindingSet.useNextBinding(set, numBindingsToUse));
+        decorateDSetBinding(
+            var, set, bindingSet.useNextBinding(var, set, numBindingsToUse));
       }
     } else if (!var.getBinding()) {
       const auto *reg = var.getRegister();
       if (reg && reg->isSpaceOnly()) {
         const uint32_t set = reg->RegisterSpace.getValueOr(defaultSpace);
-        spvBuilder.decorateDSetBinding(
-            var.getSpirvInstr(), set,
-            bindingSet.useNextBinding(set, numBindingsToUse));
+        decorateDSetBinding(
+            var, set, bindingSet.useNextBinding(var, set, numBindingsToUse));
       } else if (!reg) {
         // Process m3 (no 'vk::binding' and no ':register' assignment)
 
@@ -1722,14 +1710,13 @@ bool DeclResultIdMapper::decorateResourceBindings() {
         // doesn't have either 'vk::binding' or ':register', but the user may
         // ask for a specific binding for it via command line options.
         if (bindGlobals && var.isGlobalsBuffer()) {
-          spvBuilder.decorateDSetBinding(var.getSpirvInstr(), globalsSetNo,
-                                         globalsBindNo);
+          decorateDSetBinding(var, globalsSetNo, globalsBindNo);
         }
         // The normal case
         else {
-          spvBuilder.decorateDSetBinding(
-              var.getSpirvInstr(), defaultSpace,
-              bindingSet.useNextBinding(defaultSpace, numBindingsToUse));
+          decorateDSetBinding(var, defaultSpace,
+                              bindingSet.useNextBinding(var, defaultSpace,
+                                                        numBindingsToUse));
         }
       }
     }
@@ -1738,6 +1725,74 @@ bool DeclResultIdMapper::decorateResourceBindings() {
   return true;
 }
 
+void DeclResultIdMapper::decorateDSetBinding(const ResourceVar &var,
+                                             uint32_t setNo,
+                                             uint32_t bindingNo) {
+  spvBuilder.decorateDSetBinding(var.getSpirvInstr(), setNo, bindingNo);
+  reflectedBindings.push_back({var.getSpirvInstr()->getDebugName(), setNo,
+                               bindingNo, var.getArraySize()});
+}
+
+void DeclResultIdMapper::decorateLocation(const StageVar &var,
+                                          uint32_t location) {
+  spvBuilder.decorateLocation(var.getSpirvInstr(), location);
+  reflectedLocations.push_back(
+      {var.getSemanticStr(), isInputStorageClass(var), location});
+}
+
+namespace {
+void writeJsonString(llvm::raw_ostream &os, llvm::StringRef str) {
+  os << '"';
+  os.write_escaped(str);
+  os << '"';
+}
+} // namespace
+
+void DeclResultIdMapper::writeReflection(llvm::raw_ostream &os) const {
+  os << "{\n  \"bindings\": [";
+  const char *sep = "\n";
+  for (const auto &binding : reflectedBindings) {
+    os << sep << "    {\"name\": ";
+    writeJsonString(os, binding.name);
+    os << ", \"set\": " << binding.setNo << ", \"binding\": "
+       << binding.bindingNo << ", \"count\": " << binding.count << "}";
+    sep = ",\n";
+  }
+
+  os << "\n  ],\n  \"pushConstants\": [";
+  sep = "\n";
+  for (const auto *decl : pushConstantDecls) {
+    os << sep << "    {\"name\": ";
+    writeJsonString(os, decl->getName());
+    os << "}";
+    sep = ",\n";
+  }
+
+  for (bool isInput : {true, false}) {
+    os << "\n  ],\n  \"" << (isInput ? "inputs" : "outputs") << "\": [";
+    sep = "\n";
+    for (const auto &location : reflectedLocations) {
+      if (location.isInput != isInput)
+        continue;
+      os << sep << "    {\"semantic\": ";
+      writeJsonString(os, location.semantic);
+      os << ", \"location\": " << location.location << "}";
+      sep = ",\n";
+    }
+  }
+
+  os << "\n  ],\n  \"specConstants\": [";
+  sep = "\n";
+  for (const auto *decl : specConstantDecls) {
+    os << sep << "    {\"name\": ";
+    writeJsonString(os, decl->getName());
+    os << ", \"id\": " << decl->getAttr<VKConstantIdAttr>()->getSpecConstId()
+       << "}";
+    sep = ",\n";
+  }
+  os << "\n  ]\n}\n";
+}
+
 bool DeclResultIdMapper::createStageVars(
     const hlsl::SigPoint *sigPoint, const NamedDecl *decl, bool asInput,
     QualType type, uint32_t arraySize, const llvm::StringRef namePrefix,
@@ -2370,7 +2425,7 @@ bool DeclResultIdMapper::createPayloadStageVars(
   // and we need to load/store these individual member variables.
   const auto *structDecl = type->getAs<RecordType>()->getDecl();
   llvm::SmallVector<SpirvInstruction *, 4> subValues;
-  AlignmentSizeCalculator alignmentCalc(astContext, spirvOptions);
+  AlignmentSizeCalculator alignmentCalc(astContext, spvContext, spirvOptions);
   uint32_t nextMemberOffset = 0;
 
   for (const auto *field : structDecl->fields()) {
@@ -507,6 +507,14 @@ public:
   /// module under construction.
   bool decorateResourceBindings();
 
+  /// \brief Writes the descriptor set and binding numbers, push constants,
+  /// stage input and output locations, and specialization constant IDs
+  /// assigned in this module as JSON, so loaders need not parse the SPIR-V.
+  ///
+  /// Resources are listed as declared; ones the optimizer removes for being
+  /// unused are still listed.
+  void writeReflection(llvm::raw_ostream &os) const;
+
   bool requiresLegalization() const { return needsLegalization; }
  
   /// \brief Returns the given decl's HLSL semantic information.
@@ -682,6 +690,15 @@ private:
   /// Returns true if the given SPIR-V stage variable has Input storage class.
   inline bool isInputStorageClass(const StageVar &v);
 
+  /// Decorates the given resource variable with the given set and binding
+  /// number, and records them for reflection.
+  void decorateDSetBinding(const ResourceVar &var, uint32_t setNo,
+                           uint32_t bindingNo);
+
+  /// Decorates the given stage variable with the given location, and records
+  /// it for reflection.
+  void decorateLocation(const StageVar &var, uint32_t location);
+
 private:
   SpirvBuilder &spvBuilder;
   SpirvEmitter &theEmitter;
@@ -705,6 +722,23 @@ private:
   llvm::DenseMap<const ValueDecl *, SpirvVariable *> stageVarInstructions;
   /// Vector of all defined resource variables.
   llvm::SmallVector<ResourceVar, 8> resourceVars;
+
+  /// Assignments recorded for writeReflection().
+  struct ReflectedBinding {
+    std::string name;
+    uint32_t setNo;
+    uint32_t bindingNo;
+    uint32_t count;
+  };
+  struct ReflectedLocation {
+    std::string semantic;
+    bool isInput;
+    uint32_t location;
+  };
+  std::vector<ReflectedBinding> reflectedBindings;
+  std::vector<ReflectedLocation> reflectedLocations;
+  llvm::SmallVector<const VarDecl *, 2> pushConstantDecls;
+  llvm::SmallVector<const VarDecl *, 4> specConstantDecls;
   /// Mapping from {RW|Append|Consume}StructuredBuffers to their
   /// counter variables' (instr-ptr, is-alias-or-not) pairs
   ///
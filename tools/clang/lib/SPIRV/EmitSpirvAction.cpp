@@ -18,6 +18,6 @@ namespace clang {
 
 std::unique_ptr<ASTConsumer>
 EmitSpirvAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
-  return llvm::make_unique<spirv::SpirvEmitter>(CI);
+  return llvm::make_unique<spirv::SpirvEmitter>(CI, Reflection);
 }
 } // end namespace clang
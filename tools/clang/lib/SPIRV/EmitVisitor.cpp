@@ -111,14 +111,12 @@ EmitVisitor::Header::Header(uint32_t bound_, uint32_t version_)
       generator((kGeneratorNumber << 16) | kToolVersion), bound(bound_),
       reserved(0) {}
 
-std::vector<uint32_t> EmitVisitor::Header::takeBinary() {
-  std::vector<uint32_t> words;
-  words.push_back(magicNumber);
-  words.push_back(version);
-  words.push_back(generator);
-  words.push_back(bound);
-  words.push_back(reserved);
-  return words;
+void EmitVisitor::Header::takeBinary(std::vector<uint32_t> *binary) {
+  binary->push_back(magicNumber);
+  binary->push_back(version);
+  binary->push_back(generator);
+  binary->push_back(bound);
+  binary->push_back(reserved);
 }
 
 void EmitVisitor::emitDebugNameForInstruction(uint32_t resultId,
@@ -180,7 +178,9 @@ void EmitVisitor::emitDebugLine(spv::Op op, const SourceLocation &loc) {
   if (!line || !column)
     return;
 
-  if (line == debugLine && column == debugColumn)
+  // In compact mode a new column on the same line is not worth an OpLine.
+  if (line == debugLine &&
+      (column == debugColumn || spvOptions.debugInfoCompact))
     return;
 
   // We must update these two values to emit the next Opline.
@@ -289,19 +289,26 @@ void EmitVisitor::finalizeInstruction() {
 }
 
 std::vector<uint32_t> EmitVisitor::takeBinary() {
+  // Size the result once so that each section is copied exactly once.
   std::vector<uint32_t> result;
+  result.reserve(Header::kWordCount + preambleBinary.size() +
+                 debugFileBinary.size() + debugVariableBinary.size() +
+                 annotationsBinary.size() + typeConstantBinary.size() +
+                 mainBinary.size());
   Header header(takeNextId(), getHeaderVersion(spvOptions.targetEnv));
-  auto headerBinary = header.takeBinary();
-  result.insert(result.end(), headerBinary.begin(), headerBinary.end());
-  result.insert(result.end(), preambleBinary.begin(), preambleBinary.end());
-  result.insert(result.end(), debugFileBinary.begin(), debugFileBinary.end());
-  result.insert(result.end(), debugVariableBinary.begin(),
-                debugVariableBinary.end());
-  result.insert(result.end(), annotationsBinary.begin(),
-                annotationsBinary.end());
-  result.insert(result.end(), typeConstantBinary.begin(),
-                typeConstantBinary.end());
-  result.insert(result.end(), mainBinary.begin(), mainBinary.end());
+  header.takeBinary(&result);
+  // Free each section as soon as it has been copied, so that the binary is not
+  // held twice over while it is assembled.
+  const auto append = [&result](std::vector<uint32_t> &section) {
+    result.insert(result.end(), section.begin(), section.end());
+    std::vector<uint32_t>().swap(section);
+  };
+  append(preambleBinary);
+  append(debugFileBinary);
+  append(debugVariableBinary);
+  append(annotationsBinary);
+  append(typeConstantBinary);
+  append(mainBinary);
   return result;
 }
 
@@ -344,6 +351,10 @@ bool EmitVisitor::visit(SpirvFunction *fn, Phase phase) {
     // Emit OpFunctionEnd
     initInstruction(spv::Op::OpFunctionEnd, /* SourceLocation */ {});
     finalizeInstruction();
+
+    // Nothing reads the body once it has been emitted, so free it now rather
+    // than keeping every function alive next to the growing binary.
+    fn->releaseBody();
   }
 
   return true;
@@ -1197,15 +1208,13 @@ uint32_t EmitTypeHandler::getOrCreateConstantBool(SpirvConstantBoolean *inst) {
 }
 
 uint32_t EmitTypeHandler::getOrCreateConstantNull(SpirvConstantNull *inst) {
-  auto found =
-      std::find_if(emittedConstantNulls.begin(), emittedConstantNulls.end(),
-                   [inst](SpirvConstantNull *cachedConstant) {
-                     return *cachedConstant == *inst;
-                   });
+  const auto key = std::make_pair(inst->getResultType(),
+                                  inst->getAstResultType().getAsOpaquePtr());
+  auto found = emittedConstantNulls.find(key);
 
   if (found != emittedConstantNulls.end()) {
     // We have already emitted this constant. Reuse.
-    inst->setResultId((*found)->getResultId());
+    inst->setResultId(found->second);
   } else {
     // Constant wasn't emitted in the past.
     const uint32_t typeId = emitType(inst->getResultType());
@@ -1214,7 +1223,7 @@ uint32_t EmitTypeHandler::getOrCreateConstantNull(SpirvConstantNull *inst) {
     curTypeInst.push_back(getOrAssignResultId<SpirvInstruction>(inst));
     finalizeTypeInstruction();
     // Remember this constant for the future
-    emittedConstantNulls.push_back(inst);
+    emittedConstantNulls[key] = inst->getResultId();
   }
 
   return inst->getResultId();
@@ -1395,27 +1404,11 @@ EmitTypeHandler::getOrCreateConstantComposite(SpirvConstantComposite *inst) {
   // SpecConstant instructions are not unique, so we should not re-use existing
   // spec constants.
   const bool isSpecConst = inst->isSpecConstant();
-  SpirvConstantComposite **found = nullptr;
-
-  if (!isSpecConst) {
-    found = std::find_if(
-        emittedConstantComposites.begin(), emittedConstantComposites.end(),
-        [inst](SpirvConstantComposite *cachedConstant) {
-          if (inst->getopcode() != cachedConstant->getopcode())
-            return false;
-          auto instConstituents = inst->getConstituents();
-          auto cachedConstituents = cachedConstant->getConstituents();
-          if (instConstituents.size() != cachedConstituents.size())
-            return false;
-          for (size_t i = 0; i < instConstituents.size(); ++i)
-            if (instConstituents[i]->getResultId() !=
-                cachedConstituents[i]->getResultId())
-              return false;
-          return true;
-        });
-  }
+  auto found = emittedConstantComposites.end();
+  if (!isSpecConst)
+    found = emittedConstantComposites.find(inst);
 
-  if (!isSpecConst && found != emittedConstantComposites.end()) {
+  if (found != emittedConstantComposites.end()) {
     // We have already emitted this constant. Reuse.
     inst->setResultId((*found)->getResultId());
   } else {
@@ -1430,12 +1423,42 @@ EmitTypeHandler::getOrCreateConstantComposite(SpirvConstantComposite *inst) {
 
     // Remember this constant for the future (if not a spec constant)
     if (!isSpecConst)
-      emittedConstantComposites.push_back(inst);
+      emittedConstantComposites.insert(inst);
   }
 
   return inst->getResultId();
 }
 
+unsigned EmitTypeHandler::ConstantCompositeInfo::getHashValue(
+    const SpirvConstantComposite *inst) {
+  llvm::hash_code hash = llvm::hash_combine(
+      static_cast<uint32_t>(inst->getopcode()), inst->getResultType());
+  for (auto *constituent : inst->getConstituents())
+    hash = llvm::hash_combine(hash, constituent->getResultId());
+  return static_cast<unsigned>(hash);
+}
+
+bool EmitTypeHandler::ConstantCompositeInfo::isEqual(
+    const SpirvConstantComposite *lhs, const SpirvConstantComposite *rhs) {
+  if (lhs == rhs)
+    return true;
+  if (lhs == getEmptyKey() || lhs == getTombstoneKey() ||
+      rhs == getEmptyKey() || rhs == getTombstoneKey())
+    return false;
+  if (lhs->getopcode() != rhs->getopcode() ||
+      lhs->getResultType() != rhs->getResultType())
+    return false;
+  auto lhsConstituents = lhs->getConstituents();
+  auto rhsConstituents = rhs->getConstituents();
+  if (lhsConstituents.size() != rhsConstituents.size())
+    return false;
+  for (size_t i = 0; i < lhsConstituents.size(); ++i)
+    if (lhsConstituents[i]->getResultId() !=
+        rhsConstituents[i]->getResultId())
+      return false;
+  return true;
+}
+
 uint32_t EmitTypeHandler::emitType(const SpirvType *type) {
   // First get the decorations that would apply to this type.
   bool alreadyExists = false;
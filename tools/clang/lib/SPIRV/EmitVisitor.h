@@ -11,6 +11,7 @@
 #include "clang/SPIRV/SpirvContext.h"
 #include "clang/SPIRV/SpirvVisitor.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringMap.h"
 
 #include <functional>
@@ -23,6 +24,21 @@ class SpirvBasicBlock;
 class SpirvType;
 
 class EmitTypeHandler {
+  /// DenseSet traits that consider two constant composites the same if they
+  /// have the same opcode, result type and constituent result-ids. The
+  /// constituents must have been emitted before a composite is looked up.
+  struct ConstantCompositeInfo {
+    static SpirvConstantComposite *getEmptyKey() {
+      return llvm::DenseMapInfo<SpirvConstantComposite *>::getEmptyKey();
+    }
+    static SpirvConstantComposite *getTombstoneKey() {
+      return llvm::DenseMapInfo<SpirvConstantComposite *>::getTombstoneKey();
+    }
+    static unsigned getHashValue(const SpirvConstantComposite *inst);
+    static bool isEqual(const SpirvConstantComposite *lhs,
+                        const SpirvConstantComposite *rhs);
+  };
+
 public:
   struct DecorationInfo {
     DecorationInfo(spv::Decoration decor, llvm::ArrayRef<uint32_t> params = {},
@@ -54,7 +70,7 @@ public:
         debugVariableBinary(debugVec), annotationsBinary(decVec),
         typeConstantBinary(typesVec), takeNextIdFunction(takeNextIdFn),
         emittedConstantInts({}), emittedConstantFloats({}),
-        emittedConstantComposites({}), emittedConstantNulls({}),
+        emittedConstantComposites(), emittedConstantNulls(),
         emittedConstantBools() {
     assert(decVec);
     assert(typesVec);
@@ -160,8 +176,12 @@ private:
       emittedConstantInts;
   llvm::DenseMap<std::pair<uint64_t, const SpirvType *>, uint32_t>
       emittedConstantFloats;
-  llvm::SmallVector<SpirvConstantComposite *, 8> emittedConstantComposites;
-  llvm::SmallVector<SpirvConstantNull *, 8> emittedConstantNulls;
+  // Composite and null constants are hashed on their contents so that modules
+  // with large constant tables do not search every constant emitted so far.
+  llvm::DenseSet<SpirvConstantComposite *, ConstantCompositeInfo>
+      emittedConstantComposites;
+  llvm::DenseMap<std::pair<const SpirvType *, void *>, uint32_t>
+      emittedConstantNulls;
   SpirvConstantBoolean *emittedConstantBools[2];
 
   // emittedTypes is a map that caches the result-id of types in order to avoid
@@ -178,8 +198,12 @@ public:
     /// \brief Default constructs a SPIR-V module header with id bound 0.
     Header(uint32_t bound, uint32_t version);
 
-    /// \brief Feeds the consumer with all the SPIR-V words for this header.
-    std::vector<uint32_t> takeBinary();
+    /// \brief Appends all the SPIR-V words for this header to the given
+    /// binary.
+    void takeBinary(std::vector<uint32_t> *binary);
+
+    /// \brief The number of SPIR-V words in a module header.
+    static const uint32_t kWordCount = 5;
 
     const uint32_t magicNumber;
     uint32_t version;
@@ -345,7 +369,8 @@ private:
   // avoid emitting many OpLine instructions with identical line and column
   // numbers, we record the last line and column number that was used by OpLine,
   // and only emit a new OpLine when a new line/column in the source is
-  // discovered. The last debug line number information emitted by OpLine.
+  // discovered. With compact debug info, only a new line is considered. The
+  // last debug line number information emitted by OpLine.
   uint32_t debugLine;
   // The last debug column number information emitted by OpLine.
   uint32_t debugColumn;
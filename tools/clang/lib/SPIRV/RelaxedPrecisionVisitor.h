@@ -21,6 +21,10 @@ public:
   RelaxedPrecisionVisitor(SpirvContext &spvCtx, const SpirvCodeGenOptions &opts)
       : Visitor(opts, spvCtx) {}
 
+  /// RelaxedPrecision is propagated from the AST types and from operands,
+  /// which are visited before their users.
+  Dependency getDependency() const { return Dependency::VisitedSoFar; }
+
   bool visit(SpirvFunction *, Phase);
 
   bool visit(SpirvVariable *);
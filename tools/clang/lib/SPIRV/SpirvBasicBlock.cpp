@@ -65,5 +65,10 @@ void SpirvBasicBlock::addSuccessor(SpirvBasicBlock *bb) {
   successors.push_back(bb);
 }
 
+void SpirvBasicBlock::releaseInstructions() {
+  instructions.clear();
+  llvm::SmallVector<SpirvBasicBlock *, 2>().swap(successors);
+}
+
 } // end namespace spirv
 } // end namespace clang
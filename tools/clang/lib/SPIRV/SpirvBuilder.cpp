@@ -15,6 +15,7 @@
 #include "PreciseVisitor.h"
 #include "RelaxedPrecisionVisitor.h"
 #include "RemoveBufferBlockVisitor.h"
+#include "VisitorPipeline.h"
 #include "clang/SPIRV/AstTypeProbe.h"
 
 namespace clang {
@@ -1046,26 +1047,33 @@ std::vector<uint32_t> SpirvBuilder::takeModule() {
   RemoveBufferBlockVisitor removeBufferBlockVisitor(context, spirvOptions);
   EmitVisitor emitVisitor(astContext, context, spirvOptions);
 
-  mod->invokeVisitor(&literalTypeVisitor, true);
+  // Visitors that declare they only depend on what was visited so far share
+  // the traversal of the visitor before them.
+  VisitorPipeline pipeline(context, spirvOptions);
+
+  pipeline.add(&literalTypeVisitor, true);
 
   // Lower types
-  mod->invokeVisitor(&lowerTypeVisitor);
+  pipeline.add(&lowerTypeVisitor);
 
   // Add necessary capabilities and extensions
-  mod->invokeVisitor(&capabilityVisitor);
+  pipeline.add(&capabilityVisitor);
 
   // Propagate RelaxedPrecision decorations
-  mod->invokeVisitor(&relaxedPrecisionVisitor);
+  pipeline.add(&relaxedPrecisionVisitor);
 
   // Propagate NoContraction decorations
-  mod->invokeVisitor(&preciseVisitor, true);
+  pipeline.add(&preciseVisitor, true);
 
   // Remove BufferBlock decoration if necessary (this decoration is deprecated
-  // after SPIR-V 1.3).
-  mod->invokeVisitor(&removeBufferBlockVisitor);
+  // after SPIR-V 1.3). This rewrites the storage class of access chain bases,
+  // which type lowering reads, so it keeps a traversal of its own.
+  pipeline.add(&removeBufferBlockVisitor);
 
   // Emit SPIR-V
-  mod->invokeVisitor(&emitVisitor);
+  pipeline.add(&emitVisitor);
+
+  pipeline.run(mod);
 
   return emitVisitor.takeBinary();
 }
@@ -16,13 +16,21 @@
 #include "AlignmentSizeCalculator.h"
 #include "RawBufferMethods.h"
 #include "dxc/HlslIntrinsicOp.h"
+#include "dxc/Support/Global.h"
 #include "spirv-tools/optimizer.hpp"
+#include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/SPIRV/AstTypeProbe.h"
 #include "clang/Sema/Sema.h"
 #include "llvm/ADT/StringExtras.h"
 
 #include "InitListHandler.h"
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
 #include "clang/Basic/Version.h"
 #else
@@ -142,67 +150,213 @@ bool isReferencingNonAliasStructuredOrByteBuffer(const Expr *expr) {
   return false;
 }
 
-bool spirvToolsLegalize(spv_target_env env, std::vector<uint32_t> *mod,
-                        std::string *messages) {
-  spvtools::Optimizer optimizer(env);
+/// Keeps SPIRV-Tools objects alive after a compile so that the next compile
+/// asking for the same target environment and recipe can reuse them instead of
+/// rebuilding their grammar tables and pass lists. An entry is only used by
+/// one compile at a time; concurrent compiles each get their own.
+///
+/// Pooled entries outlive the compile that created them, so they are created
+/// and deleted under the default allocator. A compile running under its own
+/// allocator gets an entry that is not pooled instead, created under that
+/// allocator and deleted when the compile is done with it.
+template <typename Tools> class SpirvToolsPool {
+public:
+  struct Entry {
+    explicit Entry(spv_target_env env) : tools(env), messages(nullptr) {
+      tools.SetMessageConsumer(
+          [this](spv_message_level_t /*level*/, const char * /*source*/,
+                 const spv_position_t & /*position*/, const char *message) {
+            if (messages)
+              *messages += message;
+          });
+    }
+
+    Tools tools;
+    /// Where messages go for the compile currently using this entry.
+    std::string *messages;
+  };
 
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
+  /// Deletes an entry under the allocator it was created under.
+  struct EntryDeleter {
+    bool pooled;
+    void operator()(Entry *entry) const {
+      if (pooled) {
+        DxcThreadMalloc TM(nullptr);
+        delete entry;
+      } else {
+        delete entry;
+      }
+    }
+  };
+  using EntryPtr = std::unique_ptr<Entry, EntryDeleter>;
+
+  ~SpirvToolsPool() {
+    for (auto &idleEntry : idle)
+      delete idleEntry.second.release();
+  }
+
+  /// Returns an idle entry for the given key if pooled is true and there is
+  /// one; otherwise a new entry.
+  EntryPtr take(const std::string &key, spv_target_env env, bool pooled,
+                bool *isNewEntry) {
+    *isNewEntry = false;
+    if (pooled) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto iter = idle.find(key);
+      if (iter != idle.end()) {
+        EntryPtr entry = std::move(iter->second);
+        idle.erase(iter);
+        return entry;
+      }
+    }
+    *isNewEntry = true;
+    if (!pooled)
+      return EntryPtr(new Entry(env), EntryDeleter{false});
+    DxcThreadMalloc TM(nullptr);
+    return EntryPtr(new Entry(env), EntryDeleter{true});
+  }
+
+  /// Makes the given entry available to later compiles using the same key,
+  /// unless it is not pooled or the pool is full, in which case it is
+  /// deleted.
+  void give(const std::string &key, EntryPtr entry) {
+    entry->messages = nullptr;
+    if (!entry.get_deleter().pooled)
+      return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() < kMaxIdleEntries)
+      idle.emplace(key, std::move(entry));
+  }
+
+private:
+  /// Enough for each worker of a parallel batch to find one, without keeping
+  /// every recipe a long-running process has seen.
+  static const size_t kMaxIdleEntries = 16;
+
+  std::mutex mutex;
+  std::multimap<std::string, EntryPtr> idle;
+};
+
+/// Modules of at least this many words are validated on another thread while
+/// they are written out; below it, starting the thread costs more than the
+/// write it overlaps.
+const size_t kMinWordsToValidateConcurrently = 256 * 1024;
+
+using OptimizerPool = SpirvToolsPool<spvtools::Optimizer>;
+using ValidatorPool = SpirvToolsPool<spvtools::SpirvTools>;
+
+OptimizerPool &getOptimizerPool() {
+  static OptimizerPool pool;
+  return pool;
+}
+
+ValidatorPool &getValidatorPool() {
+  static ValidatorPool pool;
+  return pool;
+}
+
+/// Runs an optimizer for the given recipe on the module. recipe must uniquely
+/// identify the passes registered by registerPasses, which is only called when
+/// no pooled optimizer for the same target environment and recipe is idle.
+/// With pooled false, a new optimizer is used and not kept.
+bool runPooledOptimizer(
+    spv_target_env env, const std::string &recipe, bool pooled,
+    const std::function<bool(spvtools::Optimizer &)> &registerPasses,
+    std::vector<uint32_t> *mod, std::string *messages) {
+  OptimizerPool &pool = getOptimizerPool();
+  const std::string key = std::to_string(static_cast<int>(env)) + ":" + recipe;
+
+  bool isNewEntry;
+  OptimizerPool::EntryPtr entry = pool.take(key, env, pooled, &isNewEntry);
+  entry->messages = messages;
+  if (isNewEntry) {
+    // The passes live as long as the optimizer.
+    DxcThreadMalloc TM(pooled ? nullptr : DxcGetThreadMallocNoRef());
+    if (!registerPasses(entry->tools))
+      return false;
+  }
 
   spvtools::OptimizerOptions options;
   options.set_run_validator(false);
 
-  optimizer.RegisterLegalizationPasses();
-
-  optimizer.RegisterPass(spvtools::CreateReplaceInvalidOpcodePass());
-
-  optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
+  // Only keep optimizers that finished cleanly for reuse.
+  if (!entry->tools.Run(mod->data(), mod->size(), mod, options))
+    return false;
+  pool.give(key, std::move(entry));
+  return true;
+}
 
-  return optimizer.Run(mod->data(), mod->size(), mod, options);
+bool spirvToolsLegalize(spv_target_env env, bool pooled,
+                        std::vector<uint32_t> *mod, std::string *messages) {
+  return runPooledOptimizer(env, "legalize", pooled,
+                            [](spvtools::Optimizer &optimizer) {
+                              optimizer.RegisterLegalizationPasses();
+                              optimizer.RegisterPass(
+                                  spvtools::CreateReplaceInvalidOpcodePass());
+                              optimizer.RegisterPass(
+                                  spvtools::CreateCompactIdsPass());
+                              return true;
+                            },
+                            mod, messages);
+}
+
+bool spirvToolsReplaceInvalidOpcodes(spv_target_env env, bool pooled,
+                                     std::vector<uint32_t> *mod,
+                                     std::string *messages) {
+  return runPooledOptimizer(env, "replace-invalid-opcode", pooled,
+                            [](spvtools::Optimizer &optimizer) {
+                              optimizer.RegisterPass(
+                                  spvtools::CreateReplaceInvalidOpcodePass());
+                              return true;
+                            },
+                            mod, messages);
 }
 
 bool spirvToolsOptimize(spv_target_env env, std::vector<uint32_t> *mod,
                         clang::spirv::SpirvCodeGenOptions &spirvOptions,
                         std::string *messages) {
-  spvtools::Optimizer optimizer(env);
-
-  optimizer.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
-
-  spvtools::OptimizerOptions options;
-  options.set_run_validator(false);
-
   if (spirvOptions.optConfig.empty()) {
-    optimizer.RegisterPerformancePasses();
-    if (spirvOptions.flattenResourceArrays)
-      optimizer.RegisterPass(spvtools::CreateDescriptorScalarReplacementPass());
-    optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
-  } else {
-    // Command line options use llvm::SmallVector and llvm::StringRef, whereas
-    // SPIR-V optimizer uses std::vector and std::string.
-    std::vector<std::string> stdFlags;
-    for (const auto &f : spirvOptions.optConfig)
-      stdFlags.push_back(f.str());
-    if (!optimizer.RegisterPassesFromFlags(stdFlags))
-      return false;
-  }
-
-  return optimizer.Run(mod->data(), mod->size(), mod, options);
+    const bool flattenResourceArrays = spirvOptions.flattenResourceArrays;
+    return runPooledOptimizer(
+        env, flattenResourceArrays ? "performance,flatten" : "performance",
+        spirvOptions.poolTools, [flattenResourceArrays](spvtools::Optimizer &optimizer) {
+          optimizer.RegisterPerformancePasses();
+          if (flattenResourceArrays)
+            optimizer.RegisterPass(
+                spvtools::CreateDescriptorScalarReplacementPass());
+          optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
+          return true;
+        },
+        mod, messages);
+  }
+
+  // Command line options use llvm::SmallVector and llvm::StringRef, whereas
+  // SPIR-V optimizer uses std::vector and std::string.
+  std::vector<std::string> stdFlags;
+  std::string recipe = "flags";
+  for (const auto &f : spirvOptions.optConfig) {
+    stdFlags.push_back(f.str());
+    recipe += '\n';
+    recipe += stdFlags.back();
+  }
+  return runPooledOptimizer(env, recipe, spirvOptions.poolTools,
+                            [&stdFlags](spvtools::Optimizer &optimizer) {
+                              return optimizer.RegisterPassesFromFlags(
+                                  stdFlags);
+                            },
+                            mod, messages);
 }
 
 bool spirvToolsValidate(spv_target_env env, const SpirvCodeGenOptions &opts,
                         bool beforeHlslLegalization, std::vector<uint32_t> *mod,
                         std::string *messages) {
-  spvtools::SpirvTools tools(env);
+  ValidatorPool &pool = getValidatorPool();
+  const std::string key = std::to_string(static_cast<int>(env));
 
-  tools.SetMessageConsumer(
-      [messages](spv_message_level_t /*level*/, const char * /*source*/,
-                 const spv_position_t & /*position*/,
-                 const char *message) { *messages += message; });
+  bool isNewEntry;
+  ValidatorPool::EntryPtr entry =
+      pool.take(key, env, opts.poolTools, &isNewEntry);
+  entry->messages = messages;
 
   spvtools::ValidatorOptions options;
   options.SetBeforeHlslLegalization(beforeHlslLegalization);
@@ -217,7 +371,9 @@ bool spirvToolsValidate(spv_target_env env, const SpirvCodeGenOptions &opts,
     options.SetRelaxBlockLayout(true);
   }
 
-  return tools.Validate(mod->data(), mod->size(), options);
+  const bool isValid = entry->tools.Validate(mod->data(), mod->size(), options);
+  pool.give(key, std::move(entry));
+  return isValid;
 }
 
 /// Translates atomic HLSL opcodes into the equivalent SPIR-V opcode.
@@ -476,9 +632,65 @@ std::string getFnName(const FunctionDecl *fn) {
   return getNamespacePrefix(fn) + classOrStructName + fn->getName().str();
 }
 
+/// Returns true if the given VarDecl is a file scope variable that takes no
+/// descriptor binding, so leaving it out when it is not used changes nothing
+/// else in the module.
+bool isPrunableFileVar(const VarDecl *var) {
+  if (!var->getDeclContext()->isFileContext() || var->hasLocalStorage() ||
+      getCTBufferContext(var))
+    return false;
+  return !isExternalVar(var) || var->hasAttr<HLSLGroupSharedAttr>();
+}
+
+/// Collects the file scope variables used by the functions added to it, the
+/// functions those call, and the initializers of the variables they use.
+class FileVarReferenceCollector
+    : public RecursiveASTVisitor<FileVarReferenceCollector> {
+public:
+  explicit FileVarReferenceCollector(llvm::DenseSet<const VarDecl *> *vars)
+      : referencedVars(vars) {}
+
+  void addFunction(const FunctionDecl *fn) {
+    if (const FunctionDecl *definition = fn->getDefinition())
+      fn = definition;
+    if (visitedFunctions.insert(fn).second)
+      worklist.push_back(fn);
+  }
+
+  void run() {
+    while (!worklist.empty())
+      TraverseDecl(const_cast<Decl *>(worklist.pop_back_val()));
+  }
+
+  bool VisitDeclRefExpr(DeclRefExpr *expr) {
+    addDecl(expr->getDecl());
+    return true;
+  }
+
+  bool VisitMemberExpr(MemberExpr *expr) {
+    addDecl(expr->getMemberDecl());
+    return true;
+  }
+
+private:
+  void addDecl(const ValueDecl *decl) {
+    if (const auto *fn = dyn_cast<FunctionDecl>(decl)) {
+      addFunction(fn);
+    } else if (const auto *var = dyn_cast<VarDecl>(decl)) {
+      if (!var->hasLocalStorage() && referencedVars->insert(var).second &&
+          var->getInit())
+        worklist.push_back(var);
+    }
+  }
+
+  llvm::DenseSet<const VarDecl *> *referencedVars;
+  llvm::DenseSet<const FunctionDecl *> visitedFunctions;
+  llvm::SmallVector<const Decl *, 16> worklist;
+};
+
 } // namespace
 
-SpirvEmitter::SpirvEmitter(CompilerInstance &ci)
+SpirvEmitter::SpirvEmitter(CompilerInstance &ci, std::string *reflection)
     : theCompilerInstance(ci), astContext(ci.getASTContext()),
       diags(ci.getDiagnostics()),
       spirvOptions(ci.getCodeGenOpts().SpirvOptions),
@@ -489,7 +701,9 @@ SpirvEmitter::SpirvEmitter(CompilerInstance &ci)
                    spirvOptions),
       entryFunction(nullptr), curFunction(nullptr), curThis(nullptr),
       seenPushConstantAt(), isSpecConstantMode(false), needsLegalization(false),
-      beforeHlslLegalization(false), mainSourceFile(nullptr) {
+      needsInvalidOpcodeReplacement(false), beforeHlslLegalization(false),
+      pruneFileVars(false), mainSourceFile(nullptr),
+      reflectionOutput(reflection) {
 
   // Get ShaderModel from command line hlsl profile option.
   const hlsl::ShaderModel *shaderModel =
@@ -579,7 +793,9 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
   TranslationUnitDecl *tu = context.getTranslationUnitDecl();
   uint32_t numEntryPoints = 0;
 
-  // The entry function is the seed of the queue.
+  // The entry function is the seed of the queue. Other declarations are
+  // translated once all entry functions are known.
+  llvm::SmallVector<Decl *, 64> otherDecls;
   for (auto *decl : tu->decls()) {
     if (auto *funcDecl = dyn_cast<FunctionDecl>(decl)) {
       if (spvContext.isLib()) {
@@ -598,9 +814,33 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
         }
       }
     } else {
-      doDecl(decl);
+      otherDecls.push_back(decl);
     }
+  }
 
+  // File scope variables that nothing reachable from an entry function uses
+  // would only be removed again by SPIRV-Tools, so they are not translated
+  // when the module is optimized.
+  pruneFileVars = !spirvOptions.codeGenHighLevel &&
+                  theCompilerInstance.getCodeGenOpts().OptimizationLevel > 0;
+  if (pruneFileVars) {
+    FileVarReferenceCollector collector(&referencedFileVars);
+    for (const FunctionInfo *entryInfo : workQueue) {
+      collector.addFunction(entryInfo->funcDecl);
+      // The patch constant function is named by an attribute rather than
+      // called.
+      if (const auto *pcf =
+              entryInfo->funcDecl->getAttr<HLSLPatchConstantFuncAttr>())
+        for (auto *decl : tu->decls())
+          if (auto *funcDecl = dyn_cast<FunctionDecl>(decl))
+            if (funcDecl->getName() == pcf->getFunctionName())
+              collector.addFunction(funcDecl);
+    }
+    collector.run();
+  }
+
+  for (auto *decl : otherDecls) {
+    doDecl(decl);
     if (context.getDiagnostics().hasErrorOccurred())
       return;
   }
@@ -627,6 +867,12 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
   // 'shader' attribute, and must therefore be entry functions.
   assert(numEntryPoints <= workQueue.size());
 
+  // Every entry point currently gets the same interface, so collect it once
+  // rather than once per entry point of a library.
+  std::vector<SpirvVariable *> stageVars;
+  if (targetEnv != SPV_ENV_VULKAN_1_2)
+    stageVars = declIdMapper.collectStageVars();
+
   for (uint32_t i = 0; i < numEntryPoints; ++i) {
     // TODO: assign specific StageVars w.r.t. to entry point
     const FunctionInfo *entryInfo = workQueue[i];
@@ -636,7 +882,7 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
         entryInfo->entryFunction, entryInfo->funcDecl->getName(),
         targetEnv == SPV_ENV_VULKAN_1_2
             ? spvBuilder.getModule()->getVariables()
-            : llvm::ArrayRef<SpirvVariable *>(declIdMapper.collectStageVars()));
+            : llvm::ArrayRef<SpirvVariable *>(stageVars));
   }
 
   // Add Location decorations to stage input/output variables.
@@ -655,10 +901,17 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
     // we should run legalization before optimization.
     needsLegalization = needsLegalization || spirvOptions.flattenResourceArrays;
 
-    // Run legalization passes
-    if (needsLegalization || declIdMapper.requiresLegalization()) {
+    // Run legalization passes. If nothing but opcodes that are invalid for
+    // the shader stage needs fixing, replacing them is all that is needed.
+    const bool needsFullLegalization =
+        needsLegalization || declIdMapper.requiresLegalization();
+    if (needsFullLegalization || needsInvalidOpcodeReplacement) {
       std::string messages;
-      if (!spirvToolsLegalize(targetEnv, &m, &messages)) {
+      if (!(needsFullLegalization
+                ? spirvToolsLegalize(targetEnv, spirvOptions.poolTools, &m,
+                                     &messages)
+                : spirvToolsReplaceInvalidOpcodes(
+                      targetEnv, spirvOptions.poolTools, &m, &messages))) {
         emitFatalError("failed to legalize SPIR-V: %0", {}) << messages;
         emitNote("please file a bug report on "
                  "https://github.com/Microsoft/DirectXShaderCompiler/issues "
@@ -684,24 +937,55 @@ void SpirvEmitter::HandleTranslationUnit(ASTContext &context) {
     }
   }
 
-  // Validate the generated SPIR-V code
-  if (!spirvOptions.disableValidation) {
-    std::string messages;
-    if (!spirvToolsValidate(targetEnv, spirvOptions,
-                            needsLegalization ||
-                                declIdMapper.requiresLegalization(),
-                            &m, &messages)) {
-      emitFatalError("generated SPIR-V is invalid: %0", {}) << messages;
-      emitNote("please file a bug report on "
-               "https://github.com/Microsoft/DirectXShaderCompiler/issues "
-               "with source code if possible",
-               {});
-      return;
+  // Validate the generated SPIR-V code. A large module is validated on
+  // another thread while it is written out; if it turns out to be invalid,
+  // the compile still fails.
+  const auto writeModule = [this, &m]() {
+    theCompilerInstance.getOutStream()->write(
+        reinterpret_cast<const char *>(m.data()), m.size() * 4);
+    if (reflectionOutput) {
+      llvm::raw_string_ostream os(*reflectionOutput);
+      declIdMapper.writeReflection(os);
     }
+  };
+  if (spirvOptions.disableValidation) {
+    writeModule();
+    return;
+  }
+
+  const bool validateBeforeLegalization = needsLegalization ||
+                                          needsInvalidOpcodeReplacement ||
+                                          declIdMapper.requiresLegalization();
+  std::string messages;
+  bool isValid = false;
+  if (m.size() < kMinWordsToValidateConcurrently) {
+    isValid = spirvToolsValidate(targetEnv, spirvOptions,
+                                 validateBeforeLegalization, &m, &messages);
+    if (isValid)
+      writeModule();
+  } else {
+    IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+    std::thread validator([&]() {
+      DxcThreadMalloc TM(pMalloc);
+      try {
+        isValid = spirvToolsValidate(targetEnv, spirvOptions,
+                                     validateBeforeLegalization, &m,
+                                     &messages);
+      } catch (...) {
+        messages = "validation did not complete";
+      }
+    });
+    writeModule();
+    validator.join();
   }
 
-  theCompilerInstance.getOutStream()->write(
-      reinterpret_cast<const char *>(m.data()), m.size() * 4);
+  if (!isValid) {
+    emitFatalError("generated SPIR-V is invalid: %0", {}) << messages;
+    emitNote("please file a bug report on "
+             "https://github.com/Microsoft/DirectXShaderCompiler/issues "
+             "with source code if possible",
+             {});
+  }
 }
 
 void SpirvEmitter::doDecl(const Decl *decl) {
@@ -714,6 +998,10 @@ void SpirvEmitter::doDecl(const Decl *decl) {
   }
 
   if (const auto *varDecl = dyn_cast<VarDecl>(decl)) {
+    if (pruneFileVars && isPrunableFileVar(varDecl) &&
+        !referencedFileVars.count(varDecl))
+      return;
+
     // We can have VarDecls inside cbuffer/tbuffer. For those VarDecls, we need
     // to emit their cbuffer/tbuffer as a whole and access each individual one
     // using access chains.
@@ -2820,7 +3108,7 @@ SpirvEmitter::processByteAddressBufferStructuredBufferGetDimensions(
   if (isStructuredBuf) {
     // For (RW)StructuredBuffer, the stride of the runtime array (which is the
     // size of the struct) must also be written to the second argument.
-    AlignmentSizeCalculator alignmentCalc(astContext, spirvOptions);
+    AlignmentSizeCalculator alignmentCalc(astContext, spvContext, spirvOptions);
     uint32_t size = 0, stride = 0;
     std::tie(std::ignore, size) =
         alignmentCalc.getAlignmentAndSize(type, spirvOptions.sBufferLayoutRule,
@@ -4124,7 +4412,7 @@ SpirvInstruction *SpirvEmitter::createImageSample(
 
   // Implicit-lod instructions are only allowed in pixel shader.
   if (!spvContext.isPS() && !isExplicit)
-    needsLegalization = true;
+    needsInvalidOpcodeReplacement = true;
 
   auto *retVal = spvBuilder.createImageSample(
       texelType, imageType, image, sampler, coordinate, compareVal, bias, lod,
@@ -9250,10 +9538,10 @@ SpirvInstruction *SpirvEmitter::processIntrinsicUsingSpirvInst(
     case spv::Op::OpFwidth:
     case spv::Op::OpFwidthFine:
     case spv::Op::OpFwidthCoarse:
-      needsLegalization = true;
+      needsInvalidOpcodeReplacement = true;
       break;
     default:
-      // Only the given opcodes need legalization. Anything else should preserve
+      // Only the given opcodes need replacing. Anything else should preserve
       // previous.
       break;
     }
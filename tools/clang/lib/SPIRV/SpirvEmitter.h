@@ -31,6 +31,7 @@
 #include "clang/SPIRV/FeatureManager.h"
 #include "clang/SPIRV/SpirvBuilder.h"
 #include "clang/SPIRV/SpirvContext.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
 
 #include "DeclResultIdMapper.h"
@@ -44,12 +45,15 @@ namespace spirv {
 /// through the AST is done manually instead of using ASTConsumer's harness.
 class SpirvEmitter : public ASTConsumer {
 public:
-  SpirvEmitter(CompilerInstance &ci);
+  /// If reflection is not nullptr, the JSON reflection data of the module is
+  /// written to it once the module is emitted.
+  SpirvEmitter(CompilerInstance &ci, std::string *reflection = nullptr);
 
   void HandleTranslationUnit(ASTContext &context) override;
 
   ASTContext &getASTContext() { return astContext; }
   SpirvBuilder &getSpirvBuilder() { return spvBuilder; }
+  SpirvContext &getSpirvContext() { return spvContext; }
   DiagnosticsEngine &getDiagnosticsEngine() { return diags; }
   CompilerInstance &getCompilerInstance() { return theCompilerInstance; }
   SpirvCodeGenOptions &getSpirvOptions() { return spirvOptions; }
@@ -1090,6 +1094,14 @@ private:
   /// Note: legalization specific code
   bool needsLegalization;
 
+  /// Whether the translated SPIR-V binary uses opcodes that are only valid in
+  /// pixel shaders (derivatives and implicit-lod sampling) from another stage.
+  ///
+  /// Such a module only needs SPIRV-Tools to replace those opcodes, so if
+  /// needsLegalization is false the full legalization recipe is skipped and
+  /// only the invalid opcode replacement pass is run.
+  bool needsInvalidOpcodeReplacement;
+
   /// Whether the translated SPIR-V binary passes --before-hlsl-legalization
   /// option to spirv-val because of illegal function parameter scope.
   bool beforeHlslLegalization;
@@ -1105,6 +1117,11 @@ private:
   /// Note: legalization specific code
   llvm::DenseMap<const CXXMethodDecl *, const ImplicitParamDecl *> thisDecls;
 
+  /// Whether file scope variables that no entry function uses are left out of
+  /// the translation, and the ones that are used.
+  bool pruneFileVars;
+  llvm::DenseSet<const VarDecl *> referencedFileVars;
+
   /// Global variables that should be initialized once at the begining of the
   /// entry function.
   llvm::SmallVector<const VarDecl *, 4> toInitGloalVars;
@@ -1156,6 +1173,9 @@ private:
 
   /// The <result-id> of the OpString containing the main source file's path.
   SpirvString *mainSourceFile;
+
+  /// Where to write the reflection data of the module, or nullptr.
+  std::string *reflectionOutput;
 };
 
 void SpirvEmitter::doDeclStmt(const DeclStmt *declStmt) {
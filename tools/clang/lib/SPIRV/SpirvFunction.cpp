@@ -67,6 +67,13 @@ bool SpirvFunction::invokeVisitor(Visitor *visitor, bool reverseOrder) {
   return true;
 }
 
+void SpirvFunction::releaseBody() {
+  for (auto *bb : basicBlocks)
+    bb->releaseInstructions();
+  std::vector<SpirvBasicBlock *>().swap(basicBlocks);
+  std::vector<SpirvVariable *>().swap(variables);
+}
+
 void SpirvFunction::addParameter(SpirvFunctionParameter *param) {
   assert(param && "cannot add null function parameter");
   parameters.push_back(param);
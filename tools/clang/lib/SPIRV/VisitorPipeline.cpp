@@ -0,0 +1,95 @@
+//===--- VisitorPipeline.cpp - Fused SPIR-V visitor pipeline -----*- C++ -*-==//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "VisitorPipeline.h"
+#include "clang/SPIRV/SpirvModule.h"
+
+namespace clang {
+namespace spirv {
+
+namespace {
+
+/// A visitor that forwards every construct to each of a list of visitors, in
+/// the order they are listed. A visitor that returns false is not visited
+/// again, the same as if it had run its own traversal and stopped it; the
+/// shared traversal stops once every visitor has stopped.
+class FusedVisitor : public Visitor {
+public:
+  FusedVisitor(SpirvContext &spvCtx, const SpirvCodeGenOptions &opts,
+               llvm::ArrayRef<Visitor *> subVisitors)
+      : Visitor(opts, spvCtx), visitors(subVisitors.begin(), subVisitors.end()),
+        stopped(subVisitors.size(), false) {}
+
+  bool visit(SpirvModule *mod, Phase phase) {
+    return forEachVisitor([=](Visitor *v) { return v->visit(mod, phase); });
+  }
+  bool visit(SpirvFunction *fn, Phase phase) {
+    return forEachVisitor([=](Visitor *v) { return v->visit(fn, phase); });
+  }
+  bool visit(SpirvBasicBlock *bb, Phase phase) {
+    return forEachVisitor([=](Visitor *v) { return v->visit(bb, phase); });
+  }
+
+#define VISITED_INSTRUCTION(cls)                                               \
+  bool visit(cls *i) {                                                         \
+    return forEachVisitor([=](Visitor *v) { return v->visit(i); });            \
+  }
+#include "clang/SPIRV/SpirvVisitedInstructions.def"
+
+private:
+  /// Calls visitFn on every visitor that has not stopped yet, and returns
+  /// false once all of them have.
+  template <typename Fn> bool forEachVisitor(Fn visitFn) {
+    bool anyActive = false;
+    for (size_t i = 0; i < visitors.size(); ++i) {
+      if (stopped[i])
+        continue;
+      if (visitFn(visitors[i]))
+        anyActive = true;
+      else
+        stopped[i] = true;
+    }
+    return anyActive;
+  }
+
+  llvm::SmallVector<Visitor *, 4> visitors;
+  llvm::SmallVector<bool, 4> stopped;
+};
+
+} // end anonymous namespace
+
+void VisitorPipeline::add(Visitor *visitor, bool reverseOrder) {
+  assert(visitor);
+  if (!stages.empty() && stages.back().reverseOrder == reverseOrder &&
+      visitor->getDependency() == Visitor::Dependency::VisitedSoFar) {
+    stages.back().visitors.push_back(visitor);
+    return;
+  }
+
+  Stage stage;
+  stage.visitors.push_back(visitor);
+  stage.reverseOrder = reverseOrder;
+  stages.push_back(stage);
+}
+
+void VisitorPipeline::run(SpirvModule *mod) {
+  for (auto &stage : stages) {
+    if (stage.visitors.size() == 1) {
+      mod->invokeVisitor(stage.visitors.front(), stage.reverseOrder);
+      continue;
+    }
+
+    FusedVisitor fused(spvContext, spvOptions, stage.visitors);
+    mod->invokeVisitor(&fused, stage.reverseOrder);
+  }
+  stages.clear();
+}
+
+} // end namespace spirv
+} // end namespace clang
@@ -0,0 +1,56 @@
+//===--- VisitorPipeline.h - Fused SPIR-V visitor pipeline -------*- C++ -*-==//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_LIB_SPIRV_VISITORPIPELINE_H
+#define LLVM_CLANG_LIB_SPIRV_VISITORPIPELINE_H
+
+#include "clang/SPIRV/SpirvVisitor.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace clang {
+namespace spirv {
+
+class SpirvModule;
+
+/// \brief Runs a sequence of visitors over a SPIR-V module.
+///
+/// Visitors run in the order they are added. A visitor that walks the module
+/// in the same order as the one added before it, and whose getDependency()
+/// returns Dependency::VisitedSoFar, joins that visitor's traversal instead of
+/// starting a new one. Within a shared traversal every construct is handed to
+/// each visitor in turn before moving on to the next construct.
+class VisitorPipeline {
+public:
+  VisitorPipeline(SpirvContext &spvCtx, const SpirvCodeGenOptions &opts)
+      : spvContext(spvCtx), spvOptions(opts) {}
+
+  /// Appends the given visitor to the pipeline. The visitor is not owned by
+  /// the pipeline and must outlive the call to run().
+  void add(Visitor *visitor, bool reverseOrder = false);
+
+  /// Runs all visitors added so far on the given module, with one traversal
+  /// for each group of visitors that could be merged.
+  void run(SpirvModule *mod);
+
+private:
+  /// A group of visitors that share one traversal of the module.
+  struct Stage {
+    llvm::SmallVector<Visitor *, 4> visitors;
+    bool reverseOrder;
+  };
+
+  SpirvContext &spvContext;
+  const SpirvCodeGenOptions &spvOptions;
+  llvm::SmallVector<Stage, 8> stages;
+};
+
+} // end namespace spirv
+} // end namespace clang
+
+#endif // LLVM_CLANG_LIB_SPIRV_VISITORPIPELINE_H
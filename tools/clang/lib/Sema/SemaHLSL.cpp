@@ -12,6 +12,9 @@
 
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
 #include "clang/AST/DeclCXX.h"
@@ -39,6 +42,8 @@
 #include "dxc/HLSL/HLOperations.h"
 #include "dxc/DXIL/DxilShaderModel.h"
 #include <array>
+#include <unordered_map>
+#include <unordered_set>
 #include <float.h>
 
 enum ArBasicKind {
@@ -1924,6 +1929,15 @@ public:
     return compare(other) < 0;
   }
 
+  size_t hash() const
+  {
+    llvm::hash_code result = llvm::hash_value(m_intrinsicSource);
+    for (size_t i = 0; i < m_argLength; i++) {
+      result = llvm::hash_combine(result, m_args[i].getAsOpaquePtr());
+    }
+    return result;
+  }
+
 private:
   QualType m_args[g_MaxIntrinsicParamCount+1];
   size_t m_argLength;
@@ -2075,10 +2089,69 @@ static bool CombineBasicTypes(ArBasicKind LeftKind,
   return true;
 }
 
-class UsedIntrinsicStore : public std::set<UsedIntrinsic>
+struct UsedIntrinsicHash
+{
+  size_t operator()(const UsedIntrinsic& value) const { return value.hash(); }
+};
+
+class UsedIntrinsicStore : public std::unordered_set<UsedIntrinsic, UsedIntrinsicHash>
 {
 };
 
+// The callee and argument types of a call to an intrinsic function or method.
+// The callee is the identifier of a function, or the template of a method on a
+// specialized object type. Calls with the same signature resolve to the same
+// overload, so the overload found for one is reused for the others without
+// matching the intrinsic tables again.
+class IntrinsicCallSignature
+{
+public:
+  IntrinsicCallSignature() : m_callee(nullptr) {}
+  IntrinsicCallSignature(const void* callee, ArrayRef<Expr*> args)
+    : m_callee(callee)
+  {
+    for (Expr* arg : args) {
+      m_argTypes.push_back(arg->getType().getAsOpaquePtr());
+    }
+  }
+
+  bool operator==(const IntrinsicCallSignature& other) const
+  {
+    return m_callee == other.m_callee && m_argTypes == other.m_argTypes;
+  }
+
+  size_t hash() const
+  {
+    return llvm::hash_combine(
+      m_callee, llvm::hash_combine_range(m_argTypes.begin(), m_argTypes.end()));
+  }
+
+private:
+  const void* m_callee;
+  SmallVector<void*, 4> m_argTypes;
+};
+
+struct IntrinsicCallSignatureHash
+{
+  size_t operator()(const IntrinsicCallSignature& value) const { return value.hash(); }
+};
+
+typedef std::unordered_map<IntrinsicCallSignature, FunctionDecl*, IntrinsicCallSignatureHash>
+  IntrinsicCallCache;
+
+// Whether MatchArguments may report a diagnostic for a call that does not match
+// this intrinsic, in which case a later call must not skip the matching.
+static bool IntrinsicMayDiagnoseArguments(const HLSL_INTRINSIC* pIntrinsic)
+{
+  for (UINT i = 1; i < pIntrinsic->uNumArgs; i++) {
+    UINT8 legalTypes = pIntrinsic->pArgs[i].uLegalComponentTypes;
+    if (legalTypes == LICOMPTYPE_RAYDESC || legalTypes == LICOMPTYPE_USER_DEFINED_TYPE) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static
 void GetIntrinsicMethods(ArBasicKind kind, _Outptr_result_buffer_(*intrinsicCount) const HLSL_INTRINSIC** intrinsics, _Out_ size_t* intrinsicCount)
 {
@@ -2220,6 +2293,130 @@ void GetIntrinsicMethods(ArBasicKind kind, _Outptr_result_buffer_(*intrinsicCoun
   }
 }
 
+/// <summary>
+/// Hash index over the built-in intrinsic tables, mapping a table, name and
+/// argument count to the first entry in the table with that name and count.
+/// </summary>
+/// <remarks>
+/// The built-in tables are constant, so a single index is built on first use
+/// and shared by every compile in the process. It lives in static storage
+/// rather than in memory from the allocator of whichever compile built it.
+/// </remarks>
+class BuiltinIntrinsicIndex
+{
+private:
+  struct Slot {
+    const HLSL_INTRINSIC* Table;  // null for an empty slot
+    const HLSL_INTRINSIC* First;
+  };
+  struct IndexedTable {
+    const HLSL_INTRINSIC* Table;
+    size_t Count;
+  };
+
+  // Open addressing with linear probing; kept at most half full.
+  static const unsigned kSlotCount = 4096;
+  static const unsigned kMaxTables = AR_BASIC_MAXIMUM_COUNT + 1;
+  Slot m_slots[kSlotCount];
+  IndexedTable m_tables[kMaxTables];
+  unsigned m_slotsUsed;
+  unsigned m_tableCount;
+
+  static unsigned Hash(const HLSL_INTRINSIC* table, StringRef name, unsigned numArgs)
+  {
+    return (unsigned)llvm::hash_combine(table, name, numArgs);
+  }
+
+  static bool SlotMatches(const Slot& slot, const HLSL_INTRINSIC* table, StringRef name, unsigned numArgs)
+  {
+    return slot.Table == table && slot.First->uNumArgs == numArgs &&
+           name.equals(slot.First->pArgs[0].pName);
+  }
+
+  void AddTable(const HLSL_INTRINSIC* table, size_t count)
+  {
+    for (unsigned i = 0; i < m_tableCount; ++i) {
+      if (m_tables[i].Table == table) {
+        return;
+      }
+    }
+
+    // Tables that do not fit are left out and looked up by linear scan.
+    if (m_tableCount == kMaxTables || m_slotsUsed + count > kSlotCount / 2) {
+      return;
+    }
+    m_tables[m_tableCount++] = { table, count };
+
+    for (size_t i = 0; i < count; ++i) {
+      const HLSL_INTRINSIC* pIntrinsic = &table[i];
+      StringRef name(pIntrinsic->pArgs[0].pName);
+      unsigned slot = Hash(table, name, pIntrinsic->uNumArgs) & (kSlotCount - 1);
+      while (m_slots[slot].Table != nullptr &&
+             !SlotMatches(m_slots[slot], table, name, pIntrinsic->uNumArgs)) {
+        slot = (slot + 1) & (kSlotCount - 1);
+      }
+      // Only the first entry for a name and count is recorded; the rest of
+      // its overloads follow it in the table.
+      if (m_slots[slot].Table == nullptr) {
+        m_slots[slot].Table = table;
+        m_slots[slot].First = pIntrinsic;
+        ++m_slotsUsed;
+      }
+    }
+  }
+
+  BuiltinIntrinsicIndex() : m_slots(), m_tables(), m_slotsUsed(0), m_tableCount(0)
+  {
+    AddTable(g_Intrinsics, _countof(g_Intrinsics));
+    for (unsigned kind = 0; kind < AR_BASIC_MAXIMUM_COUNT; ++kind) {
+      const HLSL_INTRINSIC* intrinsics;
+      size_t intrinsicCount;
+      GetIntrinsicMethods((ArBasicKind)kind, &intrinsics, &intrinsicCount);
+      if (intrinsics != nullptr) {
+        AddTable(intrinsics, intrinsicCount);
+      }
+    }
+  }
+
+public:
+  static const BuiltinIntrinsicIndex& Get()
+  {
+    static const BuiltinIntrinsicIndex index;
+    return index;
+  }
+
+  /// <summary>Finds the first entry in table with the given name and number of arguments.</summary>
+  /// <returns>false if the table is not indexed; otherwise true, with *ppFirst set to the entry or to the end of the table.</returns>
+  bool Find(
+    _In_ const HLSL_INTRINSIC* table,
+    StringRef name,
+    unsigned numArgs,
+    _Out_ const HLSL_INTRINSIC** ppFirst) const
+  {
+    const IndexedTable* pIndexed = nullptr;
+    for (unsigned i = 0; i < m_tableCount; ++i) {
+      if (m_tables[i].Table == table) {
+        pIndexed = &m_tables[i];
+        break;
+      }
+    }
+    if (pIndexed == nullptr) {
+      return false;
+    }
+
+    unsigned slot = Hash(table, name, numArgs) & (kSlotCount - 1);
+    while (m_slots[slot].Table != nullptr) {
+      if (SlotMatches(m_slots[slot], table, name, numArgs)) {
+        *ppFirst = m_slots[slot].First;
+        return true;
+      }
+      slot = (slot + 1) & (kSlotCount - 1);
+    }
+    *ppFirst = table + pIndexed->Count;
+    return true;
+  }
+};
+
 static
 bool IsRowOrColumnVariable(size_t value)
 {
@@ -2288,79 +2485,66 @@ bool TemplateHasDefaultType(ArBasicKind kind)
   }
 }
 
+/// <summary>
+/// An intrinsic returned by an external intrinsic table, along with the index of that table.
+/// </summary>
+struct ExtensionIntrinsic
+{
+  unsigned TableIndex;
+  const HLSL_INTRINSIC* Intrinsic;
+};
+
 /// <summary>
 /// Use this class to iterate over intrinsic definitions that come from an external source.
 /// </summary>
 class IntrinsicTableDefIter
 {
 private:
-  StringRef _typeName;
-  StringRef _functionName;
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& _tables;
-  const HLSL_INTRINSIC* _tableIntrinsic;
-  UINT64 _tableLookupCookie;
+  ArrayRef<ExtensionIntrinsic> _entries;
+  size_t _entryIndex;
   unsigned _tableIndex;
   unsigned _argCount;
   bool _firstChecked;
 
   IntrinsicTableDefIter(
     llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables,
-    StringRef typeName,
-    StringRef functionName,
+    ArrayRef<ExtensionIntrinsic> entries,
     unsigned argCount) :
-    _typeName(typeName), _functionName(functionName), _tables(tables),
-    _tableIntrinsic(nullptr), _tableLookupCookie(0), _tableIndex(0),
+    _tables(tables), _entries(entries), _entryIndex(0), _tableIndex(0),
     _argCount(argCount), _firstChecked(false)
   {
   }
 
-  void CheckForIntrinsic() {
-    if (_tableIndex >= _tables.size()) {
-      return;
+  void MoveToNext() {
+    if (_firstChecked) {
+      _entryIndex++;
     }
-
     _firstChecked = true;
 
-    // TODO: review this - this will allocate at least once per string
-    CA2WEX<> typeName(_typeName.str().c_str(), CP_UTF8);
-    CA2WEX<> functionName(_functionName.str().c_str(), CP_UTF8);
-
-    if (FAILED(_tables[_tableIndex]->LookupIntrinsic(
-            typeName, functionName, &_tableIntrinsic, &_tableLookupCookie))) {
-      _tableLookupCookie = 0;
-      _tableIntrinsic = nullptr;
-    }
-  }
-
-  void MoveToNext() {
-    for (;;) {
-      // If we don't have an intrinsic, try the following table.
-      if (_firstChecked && _tableIntrinsic == nullptr) {
-        _tableIndex++;
-      }
-
-      CheckForIntrinsic();
-      if (_tableIndex == _tables.size() ||
-          (_tableIntrinsic != nullptr &&
-           _tableIntrinsic->uNumArgs ==
-               (_argCount + 1))) // uNumArgs includes return
-        break;
+    // uNumArgs includes return
+    while (_entryIndex < _entries.size() &&
+           _entries[_entryIndex].Intrinsic->uNumArgs != (_argCount + 1)) {
+      _entryIndex++;
     }
+    _tableIndex = _entryIndex < _entries.size()
+                      ? _entries[_entryIndex].TableIndex
+                      : _tables.size();
   }
 
 public:
+  /// <summary>Creates an iterator over entries, as returned by the tables for a given type and function name.</summary>
   static IntrinsicTableDefIter CreateStart(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables,
-    StringRef typeName,
-    StringRef functionName,
+    ArrayRef<ExtensionIntrinsic> entries,
     unsigned argCount)
   {
-    IntrinsicTableDefIter result(tables, typeName, functionName, argCount);
+    IntrinsicTableDefIter result(tables, entries, argCount);
     return result;
   }
 
   static IntrinsicTableDefIter CreateEnd(llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& tables)
   {
-    IntrinsicTableDefIter result(tables, StringRef(), StringRef(), 0);
+    IntrinsicTableDefIter result(tables, ArrayRef<ExtensionIntrinsic>(), 0);
     result._tableIndex = tables.size();
     return result;
   }
@@ -2376,7 +2560,7 @@ public:
   const HLSL_INTRINSIC* operator*()
   {
     DXASSERT(_firstChecked, "otherwise deref without comparing to end");
-    return _tableIntrinsic;
+    return _entryIndex < _entries.size() ? _entries[_entryIndex].Intrinsic : nullptr;
   }
 
   LPCSTR GetTableName()
@@ -2391,7 +2575,7 @@ public:
   LPCSTR GetLoweringStrategy()
   {
     LPCSTR lowering = nullptr;
-    if (FAILED(_tables[_tableIndex]->GetLoweringStrategy(_tableIntrinsic->Op, &lowering))) {
+    if (FAILED(_tables[_tableIndex]->GetLoweringStrategy(_entries[_entryIndex].Intrinsic->Op, &lowering))) {
       return nullptr;
     }
     return lowering;
@@ -2827,6 +3011,53 @@ TypedefDecl *CreateGlobalTypedef(ASTContext* context, const char* ident, QualTyp
   return decl;
 }
 
+/// <summary>Returns true if the object type at the given index of
+/// g_ArBasicKindsAsTypes is declared under its g_ArBasicTypeNames name and so
+/// can be faulted in by name lookup.</summary>
+static bool IsObjectTypeDeclaredByName(unsigned index) {
+  switch (g_ArBasicKindsAsTypes[index]) {
+  case AR_OBJECT_WAVE:          // unused
+  case AR_OBJECT_LEGACY_EFFECT: // declared up front with its aliases
+  case AR_OBJECT_RESOURCE:      // declared as .Resource, not user-visible
+    return false;
+  default:
+    return true;
+  }
+}
+
+/// <summary>Finds the index in g_ArBasicKindsAsTypes of the object type
+/// declared with the given name, or -1.</summary>
+/// <remarks>
+/// The names never change, so the sorted index is built once per process and
+/// shared by every compile. It lives in a static array rather than a heap
+/// container so it never holds memory from a compile's allocator.
+/// </remarks>
+static int FindObjectTypeIndexByName(StringRef name) {
+  typedef std::array<uint8_t, _countof(g_ArBasicKindsAsTypes)> NameIndex;
+  static_assert(_countof(g_ArBasicKindsAsTypes) <= UINT8_MAX, "index must fit uint8_t");
+  auto nameOf = [](uint8_t i) {
+    return StringRef(g_ArBasicTypeNames[g_ArBasicKindsAsTypes[i]]);
+  };
+  static const NameIndex sortedIndex = [&nameOf]() {
+    NameIndex result;
+    for (unsigned i = 0; i < result.size(); ++i)
+      result[i] = (uint8_t)i;
+    std::sort(result.begin(), result.end(), [&nameOf](uint8_t a, uint8_t b) {
+      return nameOf(a) < nameOf(b);
+    });
+    return result;
+  }();
+
+  auto it = std::lower_bound(sortedIndex.begin(), sortedIndex.end(), name,
+                             [&nameOf](uint8_t i, StringRef n) {
+                               return nameOf(i) < n;
+                             });
+  if (it == sortedIndex.end() || nameOf(*it) != name ||
+      !IsObjectTypeDeclaredByName(*it))
+    return -1;
+  return *it;
+}
+
 class HLSLExternalSource : public ExternalSemaSource {
 private:
   // Inner types.
@@ -2855,6 +3086,9 @@ private:
   // Intrinsic tables available externally.
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2> m_intrinsicTables;
 
+  // Entries returned by the external tables, keyed by "type.function".
+  llvm::StringMap<std::vector<ExtensionIntrinsic> > m_extensionIntrinsics;
+
   // Scalar types indexed by HLSLScalarType.
   QualType m_scalarTypes[HLSLScalarTypeCount];
 
@@ -2879,14 +3113,16 @@ private:
   TypedefDecl* m_hlslStringTypedef;
 
   // Built-in object types declarations, indexed by basic kind constant.
+  // Declared on first use; see GetOrCreateObjectTypeDecl.
   CXXRecordDecl* m_objectTypeDecls[_countof(g_ArBasicKindsAsTypes)];
-  // Map from object decl to the object index.
-  using ObjectTypeDeclMapType = std::array<std::pair<CXXRecordDecl*,unsigned>, _countof(g_ArBasicKindsAsTypes)+_countof(g_DeprecatedEffectObjectNames)>;
+  // Map from object decl to the object index, sorted by decl.
+  using ObjectTypeDeclMapType = std::vector<std::pair<CXXRecordDecl*,unsigned>>;
   ObjectTypeDeclMapType m_objectTypeDeclsMap;
   // Mask for object which not has methods created.
   uint64_t m_objectTypeLazyInitMask;
 
   UsedIntrinsicStore m_usedIntrinsics;
+  IntrinsicCallCache m_intrinsicCallCache;
 
   /// <summary>Add all base QualTypes for each hlsl scalar types.</summary>
   void AddBaseTypes();
@@ -3271,88 +3507,129 @@ private:
   }
 
   // Adds all built-in HLSL object types.
+  void AddObjectTypeDeclToMap(CXXRecordDecl *recordDecl, unsigned index) {
+    auto val = std::make_pair(recordDecl, index);
+    auto pos = std::lower_bound(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(),
+                                val, ObjectTypeDeclMapTypeCmp);
+    m_objectTypeDeclsMap.insert(pos, val);
+  }
+
+  // Declares the object type at the given index of g_ArBasicKindsAsTypes the
+  // first time it is needed. Tiny shaders only touch a handful of the object
+  // types, so declaring them on demand keeps most of them off the startup path.
+  CXXRecordDecl *GetOrCreateObjectTypeDecl(unsigned i)
+  {
+    DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
+    DXASSERT_NOMSG(i < _countof(g_ArBasicKindsAsTypes));
+    if (m_objectTypeDecls[i] != nullptr)
+      return m_objectTypeDecls[i];
+
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    DXASSERT(kind != AR_OBJECT_WAVE, "wave objects are currently unused");
+
+    DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
+    _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
+    const char* typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    CXXRecordDecl* recordDecl = nullptr;
+    if (kind == AR_OBJECT_RAY_DESC) {
+      QualType float3Ty = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 3);
+      recordDecl = CreateRayDescStruct(*m_context, float3Ty);
+    } else if (kind == AR_OBJECT_TRIANGLE_INTERSECTION_ATTRIBUTES) {
+      QualType float2Type = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 2);
+      recordDecl = AddBuiltInTriangleIntersectionAttributes(*m_context, float2Type);
+    } else if (IsSubobjectBasicKind(kind)) {
+      switch (kind) {
+      case AR_OBJECT_STATE_OBJECT_CONFIG:
+        recordDecl = CreateSubobjectStateObjectConfig(*m_context);
+        break;
+      case AR_OBJECT_GLOBAL_ROOT_SIGNATURE:
+        recordDecl = CreateSubobjectRootSignature(*m_context, true);
+        break;
+      case AR_OBJECT_LOCAL_ROOT_SIGNATURE:
+        recordDecl = CreateSubobjectRootSignature(*m_context, false);
+        break;
+      case AR_OBJECT_SUBOBJECT_TO_EXPORTS_ASSOC:
+        recordDecl = CreateSubobjectSubobjectToExportsAssoc(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_SHADER_CONFIG:
+        recordDecl = CreateSubobjectRaytracingShaderConfig(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG:
+        recordDecl = CreateSubobjectRaytracingPipelineConfig(*m_context);
+        break;
+      case AR_OBJECT_TRIANGLE_HIT_GROUP:
+        recordDecl = CreateSubobjectTriangleHitGroup(*m_context);
+        break;
+      case AR_OBJECT_PROCEDURAL_PRIMITIVE_HIT_GROUP:
+        recordDecl = CreateSubobjectProceduralPrimitiveHitGroup(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG1:
+        recordDecl = CreateSubobjectRaytracingPipelineConfig1(*m_context);
+        break;
+      }
+    } else if (kind == AR_OBJECT_RAY_QUERY) {
+      recordDecl = DeclareRayQueryType(*m_context);
+    } else if (kind == AR_OBJECT_RESOURCE) {
+      recordDecl = DeclareResourceType(*m_context);
+    }
+    else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D) {
+      recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2D", "kind");
+    }
+    else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D_ARRAY) {
+      recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2DArray", "kind");
+    }
+    else if (templateArgCount == 0) {
+      recordDecl = DeclareRecordTypeWithHandle(*m_context, typeName);
+    }
+    else
+    {
+      DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
+
+      TypeSourceInfo* typeDefault = nullptr;
+      if (TemplateHasDefaultType(kind)) {
+        QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
+        typeDefault = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
+      }
+      recordDecl = DeclareTemplateTypeWithHandle(*m_context, typeName, templateArgCount, typeDefault);
+    }
+    m_objectTypeDecls[i] = recordDecl;
+    AddObjectTypeDeclToMap(recordDecl, i);
+    m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+
+    // Extension methods go on at declaration time, ahead of the built-in
+    // methods which AddHLSLObjectMethodsIfNotReady adds on first use.
+    for (auto && intrinsic : m_intrinsicTables) {
+      AddIntrinsicTableMethods(intrinsic, i);
+    }
+    return recordDecl;
+  }
+
   void AddObjectTypes()
   {
     DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
 
-    QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
-    TypeSourceInfo *float4TypeSourceInfo = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
     m_objectTypeLazyInitMask = 0;
+    m_objectTypeDeclsMap.reserve(_countof(g_ArBasicKindsAsTypes) + _countof(g_DeprecatedEffectObjectNames));
+
+    // Object types are declared on demand by lookups into the translation
+    // unit; intern their names now so typo correction can still offer them.
     unsigned effectKindIndex = 0;
     for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++)
     {
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
-        continue;
-      }
-      if (kind == AR_OBJECT_LEGACY_EFFECT)
+      if (g_ArBasicKindsAsTypes[i] == AR_OBJECT_LEGACY_EFFECT)
         effectKindIndex = i;
+      if (IsObjectTypeDeclaredByName(i))
+        m_context->Idents.get(StringRef(g_ArBasicTypeNames[g_ArBasicKindsAsTypes[i]]), tok::TokenKind::identifier);
+    }
+    GetOrCreateObjectTypeDecl(effectKindIndex);
 
-      DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
-      _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
-      const char* typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      CXXRecordDecl* recordDecl = nullptr;
-      if (kind == AR_OBJECT_RAY_DESC) {
-        QualType float3Ty = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 3);
-        recordDecl = CreateRayDescStruct(*m_context, float3Ty);
-      } else if (kind == AR_OBJECT_TRIANGLE_INTERSECTION_ATTRIBUTES) {
-        QualType float2Type = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 2);
-        recordDecl = AddBuiltInTriangleIntersectionAttributes(*m_context, float2Type);
-      } else if (IsSubobjectBasicKind(kind)) {
-        switch (kind) {
-        case AR_OBJECT_STATE_OBJECT_CONFIG:
-          recordDecl = CreateSubobjectStateObjectConfig(*m_context);
-          break;
-        case AR_OBJECT_GLOBAL_ROOT_SIGNATURE:
-          recordDecl = CreateSubobjectRootSignature(*m_context, true);
-          break;
-        case AR_OBJECT_LOCAL_ROOT_SIGNATURE:
-          recordDecl = CreateSubobjectRootSignature(*m_context, false);
-          break;
-        case AR_OBJECT_SUBOBJECT_TO_EXPORTS_ASSOC:
-          recordDecl = CreateSubobjectSubobjectToExportsAssoc(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_SHADER_CONFIG:
-          recordDecl = CreateSubobjectRaytracingShaderConfig(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG:
-          recordDecl = CreateSubobjectRaytracingPipelineConfig(*m_context);
-          break;
-        case AR_OBJECT_TRIANGLE_HIT_GROUP:
-          recordDecl = CreateSubobjectTriangleHitGroup(*m_context);
-          break;
-        case AR_OBJECT_PROCEDURAL_PRIMITIVE_HIT_GROUP:
-          recordDecl = CreateSubobjectProceduralPrimitiveHitGroup(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG1:
-          recordDecl = CreateSubobjectRaytracingPipelineConfig1(*m_context);
-          break;
-        }
-      } else if (kind == AR_OBJECT_RAY_QUERY) {
-        recordDecl = DeclareRayQueryType(*m_context);
-      } else if (kind == AR_OBJECT_RESOURCE) {
-        recordDecl = DeclareResourceType(*m_context);
-      }
-      else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D) {
-        recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2D", "kind");
-      }
-      else if (kind == AR_OBJECT_FEEDBACKTEXTURE2D_ARRAY) {
-        recordDecl = DeclareUIntTemplatedTypeWithHandle(*m_context, "FeedbackTexture2DArray", "kind");
-      }
-      else if (templateArgCount == 0) {
-        recordDecl = DeclareRecordTypeWithHandle(*m_context, typeName);
-      }
-      else
-      {
-        DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
-
-        TypeSourceInfo* typeDefault = TemplateHasDefaultType(kind) ? float4TypeSourceInfo : nullptr;
-        recordDecl = DeclareTemplateTypeWithHandle(*m_context, typeName, templateArgCount, typeDefault);
+    // Code completion only offers what is already declared.
+    if (m_sema->CodeCompleter != nullptr) {
+      for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+        if (g_ArBasicKindsAsTypes[i] != AR_OBJECT_WAVE)
+          GetOrCreateObjectTypeDecl(i);
       }
-      m_objectTypeDecls[i] = recordDecl;
-      m_objectTypeDeclsMap[i] = std::make_pair(recordDecl, i);
-      m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
     }
 
     // Create an alias for SamplerState. 'sampler' is very commonly used.
@@ -3365,7 +3642,6 @@ private:
       samplerDecl->setImplicit(true);
 
       // Create decls for each deprecated effect object type:
-      unsigned effectObjBase = _countof(g_ArBasicKindsAsTypes);
       // TypeSourceInfo* effectObjTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_LEGACY_EFFECT));
       for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++) {
         IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
@@ -3373,12 +3649,9 @@ private:
         CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
         currentDeclContext->addDecl(effectObjDecl);
         effectObjDecl->setImplicit(true);
-        m_objectTypeDeclsMap[i+effectObjBase] = std::make_pair(effectObjDecl, effectKindIndex);
+        AddObjectTypeDeclToMap(effectObjDecl, effectKindIndex);
       }
     }
-
-    // Make sure it's in order.
-    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
   }
 
   FunctionDecl* AddSubscriptSpecialization(
@@ -3432,7 +3705,8 @@ public:
     m_vectorTemplateDecl(nullptr),
     m_context(nullptr),
     m_sema(nullptr),
-    m_hlslStringTypedef(nullptr)
+    m_hlslStringTypedef(nullptr),
+    m_objectTypeLazyInitMask(0)
   {
     memset(m_matrixTypes, 0, sizeof(m_matrixTypes));
     memset(m_matrixShorthandTypes, 0, sizeof(m_matrixShorthandTypes));
@@ -3441,6 +3715,7 @@ public:
     memset(m_scalarTypes, 0, sizeof(m_scalarTypes));
     memset(m_scalarTypeDefs, 0, sizeof(m_scalarTypeDefs));
     memset(m_baseTypes, 0, sizeof(m_baseTypes));
+    memset(m_objectTypeDecls, 0, sizeof(m_objectTypeDecls));
   }
 
   ~HLSLExternalSource() { }
@@ -3463,9 +3738,6 @@ public:
 
     AddObjectTypes();
     AddStdIsEqualImplementation(S.getASTContext(), S);
-    for (auto && intrinsic : m_intrinsicTables) {
-      AddIntrinsicTableMethods(intrinsic);
-    }
   }
 
   void ForgetSema() override
@@ -3647,9 +3919,29 @@ public:
       TypedefDecl *strDecl = GetStringTypedef();
       R.addDecl(strDecl);
     }
+    // Built-in object types are declared by DeclareObjectTypeForLookup, and
+    // found by the lookup itself.
     return false;
   }
 
+  // Declares the object type named Name before a lookup into the translation
+  // unit, so the lookup sees it in the translation unit like any other decl.
+  void DeclareObjectTypeForLookup(DeclarationName Name)
+  {
+    IdentifierInfo* idInfo = Name.getAsIdentifierInfo();
+    if (idInfo == nullptr) {
+      return;
+    }
+    // As in LookupUnqualified, no faulting-in types after a fatal error.
+    if (m_sema == nullptr || m_sema->Diags.hasFatalErrorOccurred()) {
+      return;
+    }
+    int objectIndex = FindObjectTypeIndexByName(idInfo->getName());
+    if (objectIndex != -1) {
+      GetOrCreateObjectTypeDecl(objectIndex);
+    }
+  }
+
   /// <summary>
   /// Determines whether the specify record type is a matrix, another HLSL object, or a user-defined structure.
   /// </sumary>
@@ -3877,44 +4169,49 @@ public:
     return AR_BASIC_UNKNOWN;
   }
 
+  // Adds the template methods of an extension table to one declared object type.
+  void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table, unsigned i) {
+    DXASSERT_NOMSG(table != nullptr);
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    const char *typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    DXASSERT(templateArgCount <= 2, "otherwise a new case has been added");
+    int startDepth = (templateArgCount == 0) ? 0 : 1;
+    CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
+    DXASSERT_NOMSG(recordDecl != nullptr);
+
+    // This is a variation of AddObjectMethods using the new table.
+    const HLSL_INTRINSIC *pIntrinsic = nullptr;
+    const HLSL_INTRINSIC *pPrior = nullptr;
+    UINT64 lookupCookie = 0;
+    CA2W wideTypeName(typeName, CP_UTF8);
+    HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    while (pIntrinsic != nullptr && SUCCEEDED(found)) {
+      if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
+        AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
+        // NOTE: this only works with the current implementation because
+        // intrinsics are alive as long as the table is alive.
+        pPrior = pIntrinsic;
+      }
+      found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    }
+  }
+
   void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table) {
     DXASSERT_NOMSG(table != nullptr);
 
     // Function intrinsics are added on-demand, objects get template methods.
+    // Object types declared later pick up every table when they are declared.
     for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
-      // Grab information already processed by AddObjectTypes.
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      const char *typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      DXASSERT(templateArgCount <= 2, "otherwise a new case has been added");
-      int startDepth = (templateArgCount == 0) ? 0 : 1;
-      CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
-      if (recordDecl == nullptr) {
-        DXASSERT(kind == AR_OBJECT_WAVE, "else objects other than reserved not initialized");
-        continue;
-      }
-
-      // This is a variation of AddObjectMethods using the new table.
-      const HLSL_INTRINSIC *pIntrinsic = nullptr;
-      const HLSL_INTRINSIC *pPrior = nullptr;
-      UINT64 lookupCookie = 0;
-      CA2W wideTypeName(typeName, CP_UTF8);
-      HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
-      while (pIntrinsic != nullptr && SUCCEEDED(found)) {
-        if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
-          AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
-          // NOTE: this only works with the current implementation because
-          // intrinsics are alive as long as the table is alive.
-          pPrior = pIntrinsic;
-        }
-        found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
-      }
+      if (m_objectTypeDecls[i] != nullptr)
+        AddIntrinsicTableMethods(table, i);
     }
   }
 
   void RegisterIntrinsicTable(_In_ IDxcIntrinsicTable *table) {
     DXASSERT_NOMSG(table != nullptr);
     m_intrinsicTables.push_back(table);
+    m_extensionIntrinsics.clear();
     // If already initialized, add methods immediately.
     if (m_sema != nullptr) {
       AddIntrinsicTableMethods(table);
@@ -4031,7 +4328,7 @@ public:
         const ArBasicKind* match = std::find(g_ArBasicKindsAsTypes, &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], kind);
         DXASSERT(match != &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], "otherwise can't find constant in basic kinds");
         size_t index = match - g_ArBasicKindsAsTypes;
-        return m_context->getTagDeclType(this->m_objectTypeDecls[index]);
+        return m_context->getTagDeclType(GetOrCreateObjectTypeDecl(index));
     }
 
     case AR_OBJECT_SAMPLER1D:
@@ -4156,31 +4453,72 @@ public:
     StringRef nameIdentifier,
     size_t argumentCount)
   {
-    // This is implemented by a linear scan for now.
-    // We tested binary search on tables, and there was no performance gain on
-    // samples probably for the following reasons.
-    // 1. The tables are not big enough to make noticable difference
-    // 2. The user of this function assumes that it returns the first entry in
-    // the table that matches name and argument count. So even in the binary
-    // search, we have to scan backwards until the entry does not match the name
-    // or arg count. For linear search this is not a problem
-    for (unsigned int i = 0; i < tableSize; i++) {
-      const HLSL_INTRINSIC* pIntrinsic = &table[i];
+    IntrinsicTableDefIter tableIter = IntrinsicTableDefIter::CreateStart(
+      m_intrinsicTables, LookupExtensionIntrinsics(typeName, nameIdentifier),
+      argumentCount);
+
+    // The user of this function assumes that it returns the first entry in
+    // the table that matches name and argument count; the overloads that
+    // follow it are walked by the iterator. The built-in tables are hash
+    // indexed for this, and anything else is scanned.
+    const HLSL_INTRINSIC* pFirst = table + tableSize;
+    if (table != nullptr &&
+        !BuiltinIntrinsicIndex::Get().Find(table, nameIdentifier, 1 + argumentCount, &pFirst)) {
+      for (unsigned int i = 0; i < tableSize; i++) {
+        const HLSL_INTRINSIC* pIntrinsic = &table[i];
+
+        // Do some quick checks to verify size and name.
+        if (pIntrinsic->uNumArgs != 1 + argumentCount) {
+          continue;
+        }
+        if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
+          continue;
+        }
 
-      // Do some quick checks to verify size and name.
-      if (pIntrinsic->uNumArgs != 1 + argumentCount) {
-        continue;
-      }
-      if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
-        continue;
+        pFirst = pIntrinsic;
+        break;
       }
+    }
+
+    return IntrinsicDefIter::CreateStart(table, tableSize, pFirst, tableIter);
+  }
 
-      return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
-        IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
+  // Returns every entry the external tables have for a function of a type
+  // (or a global function, if typeName is empty). Results are kept for the
+  // life of the source, so each name is converted and looked up only once.
+  ArrayRef<ExtensionIntrinsic> LookupExtensionIntrinsics(
+    StringRef typeName,
+    StringRef functionName)
+  {
+    if (m_intrinsicTables.empty()) {
+      return ArrayRef<ExtensionIntrinsic>();
     }
 
-    return IntrinsicDefIter::CreateStart(table, tableSize, table + tableSize,
-      IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
+    SmallString<128> key(typeName);
+    key.push_back('.');
+    key.append(functionName);
+    auto inserted = m_extensionIntrinsics.insert(
+      std::make_pair(key.str(), std::vector<ExtensionIntrinsic>()));
+    std::vector<ExtensionIntrinsic>& entries = inserted.first->getValue();
+    if (!inserted.second) {
+      return entries;
+    }
+
+    CA2WEX<> typeNameW(typeName.str().c_str(), CP_UTF8);
+    CA2WEX<> functionNameW(functionName.str().c_str(), CP_UTF8);
+    for (unsigned i = 0; i < m_intrinsicTables.size(); ++i) {
+      UINT64 lookupCookie = 0;
+      for (;;) {
+        const HLSL_INTRINSIC* pIntrinsic = nullptr;
+        if (FAILED(m_intrinsicTables[i]->LookupIntrinsic(
+                typeNameW, functionNameW, &pIntrinsic, &lookupCookie)) ||
+            pIntrinsic == nullptr) {
+          break;
+        }
+        entries.push_back({ i, pIntrinsic });
+      }
+    }
+    return entries;
   }
 
   bool AddOverloadedCallCandidates(
@@ -4204,6 +4542,20 @@ public:
       return false;
     }
 
+    bool cacheable = IsIntrinsicCallCacheable(Args);
+    IntrinsicCallSignature signature;
+    if (cacheable) {
+      signature = IntrinsicCallSignature(idInfo, Args);
+      IntrinsicCallCache::iterator found = m_intrinsicCallCache.find(signature);
+      if (found != m_intrinsicCallCache.end()) {
+        OverloadCandidate& candidate = CandidateSet.addCandidate();
+        candidate.Function = found->second;
+        candidate.FoundDecl.setDecl(found->second);
+        candidate.Viable = true;
+        return true;
+      }
+    }
+
     StringRef nameIdentifier = idInfo->getName();
 
     IntrinsicDefIter cursor = FindIntrinsicByNameAndArgCount(
@@ -4224,6 +4576,8 @@ public:
       size_t functionArgTypeCount = 0;
       if (!MatchArguments(pIntrinsic, QualType(), QualType(), Args, functionArgTypes, &functionArgTypeCount))
       {
+        // A call that was diagnosed must be matched again to report it again.
+        cacheable = cacheable && !IntrinsicMayDiagnoseArguments(pIntrinsic);
         ++cursor;
         continue;
       }
@@ -4243,6 +4597,9 @@ public:
       {
         intrinsicFuncDecl = (*insertResult.first).getFunctionDecl();
       }
+      if (cacheable) {
+        m_intrinsicCallCache[signature] = intrinsicFuncDecl;
+      }
 
       OverloadCandidate& candidate = CandidateSet.addCandidate();
       candidate.Function = intrinsicFuncDecl;
@@ -4696,6 +5053,17 @@ public:
   /// </remarks>
   ImplicitConversionSequence TrySubscriptIndexInitialization(_In_ clang::Expr* SrcExpr, clang::QualType DestType);
 
+  // Whether the overload for a call may be looked up in m_intrinsicCallCache;
+  // the overload for a literal argument depends on its value.
+  bool IsIntrinsicCallCacheable(ArrayRef<Expr*> Args) {
+    for (Expr* arg : Args) {
+      ArBasicKind kind = GetTypeElementKind(arg->getType());
+      if (kind == AR_BASIC_LITERAL_INT || kind == AR_BASIC_LITERAL_FLOAT)
+        return false;
+    }
+    return true;
+  }
+
   void AddHLSLObjectMethodsIfNotReady(QualType qt) {
     static_assert((sizeof(uint64_t)*8) >= _countof(g_ArBasicKindsAsTypes), "Bitmask size is too small");
     // Everything is ready.
@@ -9213,6 +9581,20 @@ Sema::TemplateDeductionResult HLSLExternalSource::DeduceTemplateArgumentsForHLSL
     "otherwise FindIntrinsicTable failed to lookup a valid object, "
     "or the parser let a user-defined template object through");
 
+  // Method templates belong to a specialized object type, so the template and
+  // the argument types decide the overload.
+  bool cacheable = (ExplicitTemplateArgs == nullptr || ExplicitTemplateArgs->size() == 0) &&
+    IsIntrinsicCallCacheable(Args);
+  IntrinsicCallSignature signature;
+  if (cacheable) {
+    signature = IntrinsicCallSignature(FunctionTemplate->getCanonicalDecl(), Args);
+    IntrinsicCallCache::iterator found = m_intrinsicCallCache.find(signature);
+    if (found != m_intrinsicCallCache.end()) {
+      Specialization = found->second;
+      return Sema::TemplateDeductionResult::TDK_Success;
+    }
+  }
+
   // Look for an intrinsic for which we can match arguments.
   size_t argCount;
   QualType argTypes[g_MaxIntrinsicParamCount + 1];
@@ -9224,6 +9606,7 @@ Sema::TemplateDeductionResult HLSLExternalSource::DeduceTemplateArgumentsForHLSL
   {
     if (!MatchArguments(*cursor, objectElement, functionTemplateTypeArg, Args, argTypes, &argCount))
     {
+      cacheable = cacheable && !IntrinsicMayDiagnoseArguments(*cursor);
       ++cursor;
       continue;
     }
@@ -9283,6 +9666,8 @@ Sema::TemplateDeductionResult HLSLExternalSource::DeduceTemplateArgumentsForHLSL
     if (!IsValidateObjectElement(*cursor, objectElement)) {
       m_sema->Diag(Args[0]->getExprLoc(), diag::err_hlsl_invalid_resource_type_on_intrinsic) <<
           nameIdentifier << g_ArBasicTypeNames[GetTypeElementKind(objectElement)];
+    } else if (cacheable) {
+      m_intrinsicCallCache[signature] = Specialization;
     }
     return Sema::TemplateDeductionResult::TDK_Success;
   }
@@ -9589,6 +9974,17 @@ QualType hlsl::CheckUnaryOpForHLSL(Sema& self,
   return hlsl->CheckUnaryOpForHLSL(OpLoc, Opc, InputExpr, VK, OK);
 }
 
+void hlsl::DeclareObjectTypeForLookup(Sema &self, DeclarationName Name)
+{
+  ExternalSemaSource* externalSource = self.getExternalSource();
+  if (externalSource == nullptr) {
+    return;
+  }
+
+  HLSLExternalSource* hlsl = reinterpret_cast<HLSLExternalSource*>(externalSource);
+  hlsl->DeclareObjectTypeForLookup(Name);
+}
+
 /// <summary>Performs HLSL-specific processing for binary operators.</summary>
 void hlsl::CheckBinOpForHLSL(Sema& self,
   SourceLocation OpLoc,
@@ -10537,6 +10933,18 @@ bool FlattenedTypeIterator::pushTrackerForType(QualType type, MultiExprArg::iter
   }
 }
 
+/// <summary>Returns true if expr is a numeric literal, possibly negated.</summary>
+static bool IsLiteralExpr(const Expr* expr)
+{
+  expr = expr->IgnoreParens();
+  if (const UnaryOperator* unary = dyn_cast<UnaryOperator>(expr)) {
+    if (unary->getOpcode() == UO_Minus || unary->getOpcode() == UO_Plus)
+      expr = unary->getSubExpr()->IgnoreParens();
+  }
+  return isa<IntegerLiteral>(expr) || isa<FloatingLiteral>(expr) ||
+         isa<CXXBoolLiteralExpr>(expr);
+}
+
 FlattenedTypeIterator::ComparisonResult
 FlattenedTypeIterator::CompareIterators(
   HLSLExternalSource& source,
@@ -10550,14 +10958,27 @@ FlattenedTypeIterator::CompareIterators(
   result.AreElementsEqual = true; // Until proven otherwise.
   result.CanConvertElements = true; // Until proven otherwise.
 
+  // Converting a literal depends only on its type, so the conversion found for
+  // one literal is reused for the following ones of the same type. This keeps
+  // long initializer lists of constants from checking every element.
+  QualType literalSourceType;
+  QualType literalTargetType;
+  StandardConversionSequence literalStandard;
+
   while (leftIter.hasCurrentElement() && rightIter.hasCurrentElement())
   {
     Expr* actualExpr = rightIter.getExprOrNull();
     bool hasExpr = actualExpr != nullptr;
+    bool isLiteral = hasExpr && IsLiteralExpr(actualExpr);
     StmtExpr scratchExpr(nullptr, rightIter.getCurrentElement(), NoLoc, NoLoc);
     StandardConversionSequence standard;
     ExprResult convertedExpr;
-    if (!source.CanConvert(loc,
+    if (isLiteral && !literalSourceType.isNull() &&
+        actualExpr->getType() == literalSourceType &&
+        leftIter.getCurrentElement() == literalTargetType) {
+      standard = literalStandard;
+    }
+    else if (!source.CanConvert(loc,
                            hasExpr ? actualExpr : &scratchExpr, 
                            leftIter.getCurrentElement(), 
                            ExplicitConversionFalse, 
@@ -10567,7 +10988,13 @@ FlattenedTypeIterator::CompareIterators(
       result.CanConvertElements = false;
       break;
     }
-    else if (hasExpr && (standard.First != ICK_Identity || !standard.isIdentityConversion()))
+    else if (isLiteral) {
+      literalSourceType = actualExpr->getType();
+      literalTargetType = leftIter.getCurrentElement();
+      literalStandard = standard;
+    }
+
+    if (hasExpr && (standard.First != ICK_Identity || !standard.isIdentityConversion()))
     {
       convertedExpr = source.getSema()->PerformImplicitConversion(actualExpr, 
                                                    leftIter.getCurrentElement(), 
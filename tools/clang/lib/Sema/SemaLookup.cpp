@@ -34,6 +34,7 @@
 #include "clang/Sema/Scope.h"
 #include "clang/Sema/ScopeInfo.h"
 #include "clang/Sema/Sema.h"
+#include "clang/Sema/SemaHLSL.h" // HLSL Change
 #include "clang/Sema/SemaInternal.h"
 #include "clang/Sema/TemplateDeduction.h"
 #include "clang/Sema/TypoCorrection.h"
@@ -677,6 +678,12 @@ static bool LookupDirect(Sema &S, LookupResult &R, const DeclContext *DC) {
   if (S.getLangOpts().CPlusPlus)
     DeclareImplicitMemberFunctionsWithName(S, R.getLookupName(), DC);
 
+  // HLSL Change Begin - Lazily declare built-in object types, so qualified,
+  // unqualified and redeclaration lookups find them as if declared up front.
+  if (S.getLangOpts().HLSL && DC->isTranslationUnit())
+    hlsl::DeclareObjectTypeForLookup(S, R.getLookupName());
+  // HLSL Change End
+
   // Perform lookup into this declaration context.
   DeclContext::lookup_result DR = DC->lookup(R.getLookupName());
   for (DeclContext::lookup_iterator I = DR.begin(), E = DR.end(); I != E;
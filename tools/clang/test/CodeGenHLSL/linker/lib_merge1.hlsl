@@ -0,0 +1,7 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// CHECK: define float @"\01?add_one@@YAMM@Z"(float
+
+export float add_one(float a) {
+  return a + 1.0;
+}
@@ -0,0 +1,15 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// CHECK: call float @"\01?add_one@@YAMM@Z"
+// CHECK: call float @"\01?plus_one@@YAMM@Z"
+
+float add_one(float a);
+float plus_one(float a);
+
+RWStructuredBuffer<float> buf;
+
+[shader("compute")]
+[numthreads(1, 1, 1)]
+void main() {
+  buf[0] = add_one(buf[1]) * plus_one(buf[2]);
+}
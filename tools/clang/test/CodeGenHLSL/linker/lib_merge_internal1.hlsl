@@ -0,0 +1,13 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// CHECK: define internal float @"\01?scale_impl@@YAMM@Z"(float
+// CHECK: define float @"\01?scale_a@@YAMM@Z"(float
+
+[noinline]
+float scale_impl(float a) {
+  return a * 3.0;
+}
+
+export float scale_a(float a) {
+  return scale_impl(a);
+}
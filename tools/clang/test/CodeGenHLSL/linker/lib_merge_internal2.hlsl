@@ -0,0 +1,14 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// CHECK: define internal float @"\01?triple_impl@@YAMM@Z"(float
+// CHECK: define float @"\01?scale_b@@YAMM@Z"(float
+
+// The same body as scale_impl in lib_merge_internal1.
+[noinline]
+float triple_impl(float a) {
+  return a * 3.0;
+}
+
+export float scale_b(float a) {
+  return triple_impl(a);
+}
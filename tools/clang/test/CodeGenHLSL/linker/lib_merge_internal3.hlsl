@@ -0,0 +1,14 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// CHECK: define internal float @"\01?quadruple_impl@@YAMM@Z"(float
+// CHECK: define float @"\01?scale_c@@YAMM@Z"(float
+
+// The same shape as scale_impl in lib_merge_internal1, with another constant.
+[noinline]
+float quadruple_impl(float a) {
+  return a * 4.0;
+}
+
+export float scale_c(float a) {
+  return quadruple_impl(a);
+}
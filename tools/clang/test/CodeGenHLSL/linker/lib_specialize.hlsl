@@ -0,0 +1,22 @@
+// RUN: %dxc -T lib_6_3 %s | FileCheck %s
+
+// The switches stay constant buffer loads until specialized at link time.
+// CHECK: @dx.op.cbufferLoadLegacy
+// CHECK: @dx.op.unary.f32(i32 24
+
+bool UseScale;
+uint Mode;
+float Scale;
+
+RWStructuredBuffer<float> buf;
+
+[shader("compute")]
+[numthreads(1, 1, 1)]
+void main() {
+  float v = buf[0];
+  if (UseScale)
+    v *= Scale;
+  if (Mode == 2)
+    v = sqrt(v);
+  buf[1] = v;
+}
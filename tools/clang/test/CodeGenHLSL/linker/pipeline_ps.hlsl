@@ -0,0 +1,12 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// CHECK: ; COLOR                    0
+// CHECK: ; TEXCOORD                 0
+
+Texture2D<float4> tex;
+SamplerState samp;
+
+float4 main(float4 pos : SV_Position, float4 color : COLOR0,
+            float2 uv : TEXCOORD0) : SV_Target {
+  return tex.Sample(samp, uv);
+}
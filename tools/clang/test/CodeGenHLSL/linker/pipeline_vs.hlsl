@@ -0,0 +1,20 @@
+// RUN: %dxc -E main -T vs_6_0 %s | FileCheck %s
+
+// COLOR is written, with a sin only it uses, until linked with
+// pipeline_ps.hlsl, which never reads it.
+// CHECK: ; COLOR                    0
+// CHECK: @dx.op.unary.f32(i32 13
+
+struct VSOut {
+  float4 pos : SV_Position;
+  float4 color : COLOR0;
+  float2 uv : TEXCOORD0;
+};
+
+VSOut main(float4 pos : POSITION, float2 uv : TEXCOORD0) {
+  VSOut o;
+  o.pos = pos;
+  o.color = sin(pos);
+  o.uv = uv;
+  return o;
+}
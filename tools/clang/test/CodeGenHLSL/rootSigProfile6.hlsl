@@ -0,0 +1,16 @@
+// RUN: %dxilver 1.5 | %dxc -E RS -T rootsig_1_0 %s
+// Test that macros are expanded in directives but not in shader code when
+// only compiling a root signature.
+
+#define USE_TABLE 1
+#define PASS(x) x
+
+#if PASS(USE_TABLE)
+#define RS "DescriptorTable(SRV(t0))"
+#else
+#define RS "DescriptorTable(garbage)"
+#endif
+
+float4 main() : SV_Target {
+  return PASS(1;
+}
@@ -0,0 +1,22 @@
+// Run: %dxc -T ps_6_1 -E main -fspv-target-env=vulkan1.1 -fspv-debug=compact
+
+// Have file path
+// CHECK:      [[file:%\d+]] = OpString
+// CHECK-SAME: spirv.debug.ctrl.compact.hlsl
+// CHECK:      OpSource HLSL 610 [[file]]
+// No source code
+// CHECK-NOT:  reversebits
+// No tool
+// CHECK-NOT:  OpModuleProcessed
+
+// Note that preprocessor prepends a "#line 1 ..." line to the whole file,
+// the compliation sees line numbers incremented by 1.
+
+float4 main(uint val : A) : SV_Target {
+// One OpLine for all the columns of a line
+// CHECK:      OpLine [[file]] 21
+// CHECK-NOT:  OpLine [[file]] 21
+// CHECK:      OpLine [[file]] 22
+  uint a = reversebits(val); uint b = a + 1;
+  return b;
+}
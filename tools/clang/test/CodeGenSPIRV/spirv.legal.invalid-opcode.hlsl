@@ -0,0 +1,11 @@
+// Run: %dxc -T vs_6_0 -E main
+
+// Derivatives are only valid in pixel shaders. Using one from a vertex shader
+// only needs the invalid opcode replacement pass, not the whole legalization
+// recipe.
+
+// CHECK:     OpEntryPoint Vertex %main "main"
+// CHECK-NOT: OpDPdx
+float4 main(float4 pos : POSITION) : SV_Position {
+  return ddx(pos);
+}
@@ -0,0 +1,32 @@
+// Run: %dxc -T cs_6_0 -E main -O3
+
+// File scope variables that the entry function does not reach are not
+// translated. The ones it reaches through calls, methods, and the
+// initializers of other variables are.
+
+// CHECK-NOT: %float_5
+
+// CHECK:      [[scale:%\d+]] = OpLoad %float
+// CHECK:        [[mul:%\d+]] = OpFMul %float [[scale]] %float_3
+// CHECK:                       OpStore {{%\d+}} [[mul]]
+
+float gScale;
+RWStructuredBuffer<float> gOut;
+
+static float unused = gScale * 5.0;
+static float base = gScale;
+static float derived = base * 3.0;
+
+struct S {
+  float get() { return derived; }
+};
+
+float helper() {
+  S s;
+  return s.get();
+}
+
+[numthreads(1, 1, 1)]
+void main() {
+  gOut[0] = helper();
+}
@@ -0,0 +1,29 @@
+// RUN: %clang_cc1 -Wno-unused-value -fsyntax-only -ffreestanding -verify -verify-ignore-unexpected=note %s
+
+// Built-in object types are declared in the translation unit the first time a
+// lookup asks for them; they must be found exactly as if declared up front.
+
+// Redeclaring a built-in type conflicts with it, whether or not it was used
+// before.
+struct Texture2D {};                      // expected-error {{redefinition of 'Texture2D'}}
+struct ByteAddressBuffer {};              // expected-error {{redefinition of 'ByteAddressBuffer'}}
+RWByteAddressBuffer rwbab;
+struct RWByteAddressBuffer {};            // expected-error {{redefinition of 'RWByteAddressBuffer'}}
+typedef float4 Texture3D;                 // expected-error {{redefinition of 'Texture3D'}}
+
+// Qualified lookup finds the built-in types, including templates.
+::Texture2DArray<float4> tex_array;
+::RWStructuredBuffer<uint> rwsb;
+::SamplerState samp;
+::TextureCube<float4> tex_cube;
+
+struct S { float4 a; };
+::StructuredBuffer<S> sb;
+::Buffer<float4> buf;
+
+float4 main(uint i : I, float2 uv : UV) : SV_Target {
+  rwsb[i] = i;
+  uint u = rwbab.Load(i);
+  return tex_array.Sample(samp, float3(uv, 0)) + tex_cube.Sample(samp, float3(uv, 1)) +
+         sb[i].a + buf[i] + u;
+}
@@ -0,0 +1,23 @@
+// RUN: %dxc -E main -T ps_6_0 -O1 %s | FileCheck %s
+
+// -O1 promotes locals and folds the struct copy away without running the
+// full LLVM scalar pipeline.
+
+// CHECK-NOT: alloca
+// CHECK: call float @dx.op.loadInput.f32
+// CHECK: fmul fast float
+// CHECK-NOT: fmul
+// CHECK: call void @dx.op.storeOutput.f32
+
+struct S {
+  float a;
+  float b;
+};
+
+float main(float x : X) : SV_Target {
+  S s;
+  s.a = x;
+  s.b = 3;
+  S t = s;
+  return t.a * t.b;
+}
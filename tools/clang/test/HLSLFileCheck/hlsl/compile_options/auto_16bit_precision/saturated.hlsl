@@ -0,0 +1,18 @@
+// RUN: %dxc -E main -T ps_6_2 -enable-16bit-types -auto-16bit-precision 8 %s | FileCheck %s
+
+// The saturated sample is in [0, 1], so the scale and bias after it are done
+// in 16-bit floats, and only the result is widened for the output.
+// CHECK: fptrunc float %{{.*}} to half
+// CHECK: call half @dx.op.unary.f16(i32 7, half
+// CHECK: fmul fast half
+// CHECK: fadd fast half
+// CHECK: fpext half %{{.*}} to float
+// CHECK: call void @dx.op.storeOutput.f32(i32 5
+
+Texture2D<float4> tex;
+SamplerState s;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target
+{
+    return saturate(tex.Sample(s, uv)) * 0.5 + 0.25;
+}
@@ -0,0 +1,14 @@
+// RUN: %dxc -E main -T ps_6_2 -enable-16bit-types -auto-16bit-precision 8 %s | FileCheck %s
+
+// Nothing bounds the sample, so the math stays 32-bit.
+// CHECK-NOT: half
+// CHECK: fmul fast float
+// CHECK: call void @dx.op.storeOutput.f32(i32 5
+
+Texture2D<float4> tex;
+SamplerState s;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target
+{
+    return tex.Sample(s, uv) * 0.5 + 0.25;
+}
@@ -0,0 +1,33 @@
+// RUN: %dxc -E main -T ms_6_5 -minimize-mesh-outputs %s | FileCheck %s
+
+// Outputs are declared for 128 vertices and 64 primitives, but the counts
+// and every index the shader writes stay below 64 vertices and 32 primitives.
+// CHECK: dx.op.setMeshOutputCounts(i32 168, i32 64, i32 32)
+// CHECK: !{!{{[0-9]+}}, i32 64, i32 32, i32 2, i32 0}
+
+struct MeshPerVertex {
+  float4 position : SV_Position;
+};
+
+struct MeshPerPrimitive {
+  float normal : NORMAL;
+};
+
+[numthreads(64, 1, 1)]
+[outputtopology("triangle")]
+void main(out indices uint3 primIndices[64],
+          out vertices MeshPerVertex verts[128],
+          out primitives MeshPerPrimitive prims[64],
+          in uint tig : SV_GroupIndex) {
+  SetMeshOutputCounts(64, 32);
+  MeshPerVertex v;
+  v.position = float4(tig, 0, 0, 1);
+  verts[tig] = v;
+  if (tig % 2 == 0) {
+    uint base = tig % 62;
+    primIndices[tig / 2] = uint3(base, base + 1, base + 2);
+    MeshPerPrimitive p;
+    p.normal = tig;
+    prims[tig / 2] = p;
+  }
+}
@@ -0,0 +1,26 @@
+// RUN: %dxc -E main -T ms_6_5 -minimize-mesh-outputs %s | FileCheck %s
+
+// The vertex count comes from a buffer, so the vertex maximum is kept, while
+// the primitive maximum still drops to the constant count.
+// CHECK: !{!{{[0-9]+}}, i32 128, i32 16, i32 2, i32 0}
+
+struct MeshPerVertex {
+  float4 position : SV_Position;
+};
+
+Buffer<uint> counts;
+
+[numthreads(32, 1, 1)]
+[outputtopology("triangle")]
+void main(out indices uint3 primIndices[64],
+          out vertices MeshPerVertex verts[128],
+          in uint tig : SV_GroupIndex) {
+  uint numVerts = counts[0];
+  SetMeshOutputCounts(numVerts, 16);
+  if (tig < numVerts) {
+    MeshPerVertex v;
+    v.position = float4(tig, 0, 0, 1);
+    verts[tig] = v;
+  }
+  primIndices[tig % 16] = uint3(0, 1, 2);
+}
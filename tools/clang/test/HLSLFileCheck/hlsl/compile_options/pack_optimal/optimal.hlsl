@@ -0,0 +1,31 @@
+// RUN: %dxc -E main -T vs_6_0 -pack_optimal %s | FileCheck %s
+// RUN: %dxc -E main -T vs_6_0 -pack_optimized %s | FileCheck %s -check-prefix=GREEDY
+
+// Greedy packing places B beside A and leaves no room for D until row 5;
+// the search moves B to the w column so that D fits beside A.
+
+// CHECK:      ; Output signature:
+// CHECK-DAG:  ; SV_Position              0   xyzw        0      POS   float   xyzw
+// CHECK-DAG:  ; A                        0   xy          1     NONE   float   xy
+// CHECK-DAG:  ; D                        0     zw        1     NONE   float     zw
+// CHECK-DAG:  ; A                        1   xy          2     NONE   float   xy
+// CHECK-DAG:  ; B                        0      w        2     NONE   float      w
+// CHECK-DAG:  ; A                        2   xy          3     NONE   float   xy
+// CHECK-DAG:  ; B                        1      w        3     NONE   float      w
+// CHECK-DAG:  ; B                        2      w        4     NONE   float      w
+// CHECK-DAG:  ; C                        0   xyz         4     NONE   float   xyz
+
+// GREEDY:     ; Output signature:
+// GREEDY:     ; D                        0   xy          5     NONE   float   xy
+
+struct VS_OUT {
+  float4 pos : SV_Position;
+  float b[3] : B;
+  float3 c : C;
+  float2 a[3] : A;
+  float2 d : D;
+};
+
+VS_OUT main() {
+  return (VS_OUT)1.0F;
+}
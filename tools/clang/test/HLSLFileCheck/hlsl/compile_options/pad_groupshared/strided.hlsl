@@ -0,0 +1,23 @@
+// RUN: %dxc -E main -T cs_6_0 -pad-groupshared %s | FileCheck %s
+
+// A word is added after every 32, and each index is moved past the padding
+// before it.
+// CHECK-DAG: note: groupshared data padded from 4096 to 4220 bytes to avoid bank conflicts.
+// CHECK-DAG: @data = addrspace(3) global [1055 x i32] undef
+// CHECK: lshr i32 %{{.*}}, 5
+// CHECK: getelementptr inbounds [1055 x i32], [1055 x i32] addrspace(3)* @data
+
+RWByteAddressBuffer buf;
+groupshared uint data[1024];
+
+[numthreads(32, 1, 1)]
+void main(uint tid : SV_GroupIndex)
+{
+    for (uint i = 0; i < 32; ++i)
+        data[tid * 32 + i] = buf.Load((tid * 32 + i) * 4);
+    GroupMemoryBarrierWithGroupSync();
+    uint sum = 0;
+    for (uint j = 0; j < 32; ++j)
+        sum += data[tid * 32 + j];
+    buf.Store(tid * 4, sum);
+}
@@ -0,0 +1,19 @@
+// RUN: %dxc -E main -T cs_6_0 -pad-groupshared %s | FileCheck %s
+
+// Each row of the tile gets one more word, so reading a column touches a
+// different bank in each thread.
+// CHECK-DAG: note: groupshared tile padded from 4096 to 4224 bytes to avoid bank conflicts.
+// CHECK-DAG: @tile = addrspace(3) global [32 x [33 x float]] undef
+
+RWStructuredBuffer<float> buf;
+groupshared float tile[32][32];
+
+[numthreads(32, 1, 1)]
+void main(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID)
+{
+    for (uint i = 0; i < 32; ++i)
+        tile[i][tid.x] = buf[(gid.x * 32 + i) * 32 + tid.x];
+    GroupMemoryBarrierWithGroupSync();
+    for (uint j = 0; j < 32; ++j)
+        buf[(gid.x * 32 + j) * 32 + tid.x] = tile[tid.x][j];
+}
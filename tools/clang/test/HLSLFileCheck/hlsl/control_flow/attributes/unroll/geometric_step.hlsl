@@ -0,0 +1,22 @@
+// RUN: %dxc -Od -E main -T ps_6_0 %s | FileCheck %s
+// CHECK: @main
+// CHECK: @dx.op.unary.f32(i32 13
+// CHECK: @dx.op.unary.f32(i32 13
+// CHECK: @dx.op.unary.f32(i32 13
+// CHECK: @dx.op.unary.f32(i32 13
+// CHECK: @dx.op.unary.f32(i32 13
+// CHECK-NOT: @dx.op.unary.f32(i32 13
+
+// Confirm that a loop whose counter SCEV cannot compute a trip count for
+// (i = 1, 3, 9, 27, 81) is unrolled exactly that many times.
+
+[RootSignature("")]
+float main(float y : Y) : SV_Target {
+  float x = 0;
+
+  [unroll]
+  for (uint i = 1; i < 100; i *= 3) {
+    x = sin(x * x + y);
+  }
+  return x;
+}
@@ -0,0 +1,18 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s -check-prefix=FLAT
+// RUN: %dxc -E main -T ps_6_0 -profile-use %S/profile_branch.prof %s | FileCheck %s -check-prefix=PROF
+
+// Without a profile the if is flattened. The profile shows that it is never
+// taken, so it is kept as a branch.
+// FLAT-NOT: br i1
+// FLAT: select
+// PROF: br i1
+// PROF-NOT: select
+// PROF: fmul
+
+float c;
+float main(float2 a:A) : SV_Target {
+    float x = a.x;
+    if (c > 2)
+      x = x * 3;
+    return x;
+}
@@ -0,0 +1,23 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s -check-prefix=UNROLL
+// RUN: %dxc -E main -T ps_6_0 -profile-use %S/profile_loop.prof %s | FileCheck %s -check-prefix=PROF
+
+// Without a profile the loop is fully unrolled. The profile shows that it is
+// never entered, so it is left as a loop.
+// UNROLL-NOT: phi i32
+// UNROLL: fmul
+// UNROLL: fmul
+// UNROLL: fmul
+// UNROLL: fmul
+// PROF: phi i32
+// PROF: fmul
+// PROF-NOT: fmul
+
+uint n;
+float main(float a : A) : SV_Target {
+  float r = a;
+  if (n > 100) {
+    for (uint i = 0; i < 4; i++)
+      r = r * a + i;
+  }
+  return r;
+}
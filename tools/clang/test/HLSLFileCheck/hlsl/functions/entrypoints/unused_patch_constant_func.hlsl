@@ -0,0 +1,26 @@
+// RUN: %dxc -T ps_6_0 -E main -fcgl %s | FileCheck %s
+
+// Make sure functions shaped like patch constant functions are not generated
+// for targets other than hull shaders.
+
+// CHECK-NOT: unused_pc
+// CHECK: define {{.*}}@main
+// CHECK-NOT: unused_pc
+
+struct PCOut {
+  float edges[3] : SV_TessFactor;
+  float inside : SV_InsideTessFactor;
+};
+
+PCOut unused_pc_ret() {
+  PCOut o = (PCOut)0;
+  return o;
+}
+
+void unused_pc_out(out PCOut o) {
+  o = (PCOut)0;
+}
+
+float4 main() : SV_Target {
+  return 1;
+}
@@ -0,0 +1,26 @@
+// RUN: %dxc -T ps_6_0 -E main -ast-dump %s | FileCheck %s
+
+// Calls with the same callee and argument types share an overload; make sure
+// calls that differ only in the object type or argument types do not.
+
+Texture2D<float4> tex4;
+Texture2D<float> tex1;
+SamplerState samp;
+
+float4 main(float2 uv : TEXCOORD, int i : I, float f : F) : SV_Target
+{
+  // CHECK: CXXMemberCallExpr {{.*}} 'vector<float, 4>'
+  // CHECK: CXXMemberCallExpr {{.*}} 'vector<float, 4>'
+  // CHECK: CXXMemberCallExpr {{.*}} 'float'
+  // CHECK: CXXMemberCallExpr {{.*}} 'float'
+  float4 r = tex4.Sample(samp, uv) + tex4.Sample(samp, uv);
+  r.x += tex1.Sample(samp, uv) + tex1.Sample(samp, uv);
+
+  // CHECK: CallExpr {{.*}} 'int'
+  // CHECK: CallExpr {{.*}} 'int'
+  // CHECK: CallExpr {{.*}} 'float'
+  // CHECK: CallExpr {{.*}} 'float'
+  r.y += abs(i) + abs(i);
+  r.z += abs(f) + abs(f);
+  return r;
+}
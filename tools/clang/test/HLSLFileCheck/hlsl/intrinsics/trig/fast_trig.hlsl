@@ -0,0 +1,16 @@
+// RUN: %dxc -E main -T ps_6_0 -fast-trig %s | FileCheck %s
+
+// Make sure atan2 and asin use the reduced precision polynomials, and that
+// the precise acos is left to the driver.
+
+// CHECK-DAG: fmul fast float %{{.*}}, 0x3FD178D500000000
+// CHECK-DAG: fmul fast float %{{.*}}, 0xBFC40AE960000000
+// CHECK-DAG: call float @dx.op.unary.f32(i32 15
+// CHECK-NOT: call float @dx.op.unary.f32(i32 16
+// CHECK-NOT: call float @dx.op.unary.f32(i32 17
+
+float main(float2 v : A, float a : B, float b : C) : SV_Target
+{
+    precise float c = acos(b);
+    return atan2(v.y, v.x) + asin(a) + c;
+}
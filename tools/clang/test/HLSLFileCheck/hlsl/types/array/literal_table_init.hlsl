@@ -0,0 +1,79 @@
+// RUN: %dxc -E main -T ps_6_0 -fcgl %s | FileCheck %s
+
+// Large local tables of literals are copied from a constant global instead
+// of being stored element by element.
+
+// CHECK: @[[TABLE:.*]] = internal unnamed_addr constant [64 x <4 x float>]
+// CHECK-LABEL: define
+// CHECK-NOT: store <4 x float>
+// CHECK: call void @llvm.memcpy{{.*}}@[[TABLE]]
+
+float4 main(uint i : I) : SV_Target {
+  float4 table[64] = {
+  { 0.0, 0.5, -0.0, 0 },
+  { 1.0, 1.5, -1.0, 1 },
+  { 2.0, 2.5, -2.0, 2 },
+  { 3.0, 3.5, -3.0, 3 },
+  { 4.0, 4.5, -4.0, 4 },
+  { 5.0, 5.5, -5.0, 5 },
+  { 6.0, 6.5, -6.0, 6 },
+  { 7.0, 7.5, -7.0, 7 },
+  { 8.0, 8.5, -8.0, 8 },
+  { 9.0, 9.5, -9.0, 9 },
+  { 10.0, 10.5, -10.0, 10 },
+  { 11.0, 11.5, -11.0, 11 },
+  { 12.0, 12.5, -12.0, 12 },
+  { 13.0, 13.5, -13.0, 13 },
+  { 14.0, 14.5, -14.0, 14 },
+  { 15.0, 15.5, -15.0, 15 },
+  { 16.0, 16.5, -16.0, 16 },
+  { 17.0, 17.5, -17.0, 17 },
+  { 18.0, 18.5, -18.0, 18 },
+  { 19.0, 19.5, -19.0, 19 },
+  { 20.0, 20.5, -20.0, 20 },
+  { 21.0, 21.5, -21.0, 21 },
+  { 22.0, 22.5, -22.0, 22 },
+  { 23.0, 23.5, -23.0, 23 },
+  { 24.0, 24.5, -24.0, 24 },
+  { 25.0, 25.5, -25.0, 25 },
+  { 26.0, 26.5, -26.0, 26 },
+  { 27.0, 27.5, -27.0, 27 },
+  { 28.0, 28.5, -28.0, 28 },
+  { 29.0, 29.5, -29.0, 29 },
+  { 30.0, 30.5, -30.0, 30 },
+  { 31.0, 31.5, -31.0, 31 },
+  { 32.0, 32.5, -32.0, 32 },
+  { 33.0, 33.5, -33.0, 33 },
+  { 34.0, 34.5, -34.0, 34 },
+  { 35.0, 35.5, -35.0, 35 },
+  { 36.0, 36.5, -36.0, 36 },
+  { 37.0, 37.5, -37.0, 37 },
+  { 38.0, 38.5, -38.0, 38 },
+  { 39.0, 39.5, -39.0, 39 },
+  { 40.0, 40.5, -40.0, 40 },
+  { 41.0, 41.5, -41.0, 41 },
+  { 42.0, 42.5, -42.0, 42 },
+  { 43.0, 43.5, -43.0, 43 },
+  { 44.0, 44.5, -44.0, 44 },
+  { 45.0, 45.5, -45.0, 45 },
+  { 46.0, 46.5, -46.0, 46 },
+  { 47.0, 47.5, -47.0, 47 },
+  { 48.0, 48.5, -48.0, 48 },
+  { 49.0, 49.5, -49.0, 49 },
+  { 50.0, 50.5, -50.0, 50 },
+  { 51.0, 51.5, -51.0, 51 },
+  { 52.0, 52.5, -52.0, 52 },
+  { 53.0, 53.5, -53.0, 53 },
+  { 54.0, 54.5, -54.0, 54 },
+  { 55.0, 55.5, -55.0, 55 },
+  { 56.0, 56.5, -56.0, 56 },
+  { 57.0, 57.5, -57.0, 57 },
+  { 58.0, 58.5, -58.0, 58 },
+  { 59.0, 59.5, -59.0, 59 },
+  { 60.0, 60.5, -60.0, 60 },
+  { 61.0, 61.5, -61.0, 61 },
+  { 62.0, 62.5, -62.0, 62 },
+  { 63.0, 63.5, -63.0, 63 },
+  };
+  return table[i];
+}
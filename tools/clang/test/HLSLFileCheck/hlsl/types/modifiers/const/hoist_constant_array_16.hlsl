@@ -0,0 +1,17 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %FileCheck %s
+// Multi-dimensional arrays are hoisted, then flattened with other globals.
+// CHECK:     internal unnamed_addr constant [6 x float] [float 1.000000e+00, float 2.000000e+00, float 3.000000e+00, float 4.000000e+00, float 5.000000e+00, float 6.000000e+00]
+// CHECK-NOT: alloca
+
+float foo(int i, int j) {
+    float A[2][3] = {
+        { 1, 2, 3 },
+        { 4, 5, 6 }
+    };
+    return A[i][j];
+}
+
+float main(int i : I, int j : J) : SV_Target {
+
+    return foo(i, j);
+}
@@ -0,0 +1,25 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+
+// Make sure the row v is in is loaded once, before the branch, for both
+// sides of it.
+// CHECK: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK: br i1
+// CHECK-NOT: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK: ret void
+
+cbuffer cb
+{
+    float4 v;
+    uint c;
+};
+
+RWStructuredBuffer<float> buf;
+
+[numthreads(8, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    if (id > c)
+        buf[id] = v.x * 2;
+    else
+        buf[id + 1] = v.y + 3;
+}
@@ -0,0 +1,16 @@
+// RUN: %dxc -E main -T ps_6_0 -ffp-contract=fast %s | FileCheck %s
+
+// Make sure the sum of products becomes a mad chain, and that the precise
+// multiply and add stay as they are.
+
+// CHECK: fmul float
+// CHECK: fadd float
+// CHECK: [[M:%.*]] = fmul fast float
+// CHECK: [[A:%.*]] = call float @dx.op.tertiary.f32(i32 46, float %{{.*}}, float %{{.*}}, float [[M]])
+// CHECK: call float @dx.op.tertiary.f32(i32 46, float %{{.*}}, float %{{.*}}, float [[A]])
+
+float main(float4 a : A, float4 b : B) : SV_Target
+{
+    precise float p = a.w * b.w + a.x;
+    return a.x * b.x + a.y * b.y + a.z * b.z + p;
+}
@@ -0,0 +1,20 @@
+// RUN: %dxc -Emain -Tvs_6_0 %s | %opt -S -hlsl-dxil-eliminate-output-dynamic | %FileCheck %s
+
+// The index is either 0 or 1, so the store becomes a switch of constant
+// indexed stores, and nothing is shadowed.
+// CHECK-NOT: alloca
+// CHECK: switch i32
+// CHECK: storeOutput.f32(i32 5, i32 1, i32 0, i8 0
+// CHECK: storeOutput.f32(i32 5, i32 1, i32 1, i8 0
+// CHECK: storeOutput.f32(i32 5, i32 1, i32 7, i8 0
+// CHECK-NOT: storeOutput.f32(i32 5, i32 1, i32 2, i8 0
+
+uint idx;
+
+float4 main(out float o[8] : I, float4 pos: POS) : SV_POSITION {
+
+    o[idx & 1] = pos.x;
+    o[7] = pos.y;
+
+    return pos;
+}
@@ -0,0 +1,19 @@
+// RUN: %dxc -Emain -Tvs_6_0 %s | %opt -S -hlsl-dxil-eliminate-output-dynamic | %FileCheck %s
+
+// Only rows 8 to 15 can be dynamically indexed, so only they are shadowed.
+// The store to row 0 stays in place.
+// CHECK: alloca [8 x float]
+// CHECK: storeOutput.f32(i32 5, i32 1, i32 0, i8 0
+// CHECK-NOT: storeOutput.f32(i32 5, i32 1, i32 7, i8 0
+// CHECK: storeOutput.f32(i32 5, i32 1, i32 8, i8 0
+// CHECK: storeOutput.f32(i32 5, i32 1, i32 15, i8 0
+
+uint idx;
+
+float4 main(out float o[16] : I, float4 pos: POS) : SV_POSITION {
+
+    o[0] = pos.y;
+    o[(idx & 7) | 8] = pos.x;
+
+    return pos;
+}
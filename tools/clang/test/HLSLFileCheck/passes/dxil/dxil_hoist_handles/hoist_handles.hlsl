@@ -0,0 +1,22 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+
+// Make sure the handle of each buffer is created once, before the loop, even
+// though the loop stores to one of them.
+// CHECK: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0
+// CHECK-NOT: @dx.op.createHandle(i32 57, i8 1, i32 0
+// CHECK: br label
+// CHECK-NOT: @dx.op.createHandle(
+// CHECK: ret void
+
+RWByteAddressBuffer buf;
+ByteAddressBuffer src;
+
+[numthreads(8, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    for (uint i = 0; i < id; ++i) {
+        buf.Store(i * 4, src.Load(i * 4));
+        if (src.Load(i * 4 + 4) > 3)
+            buf.Store(i * 4 + 4, i);
+    }
+}
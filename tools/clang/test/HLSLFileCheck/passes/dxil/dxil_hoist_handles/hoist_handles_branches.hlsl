@@ -0,0 +1,29 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+
+// Make sure the handle of an unbounded array element indexed by a uniform
+// value is created once, before the branches that each use it. Every path
+// uses it, so the index is one the shader would use anyway.
+// CHECK: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 false)
+// CHECK: {{br i1|switch}}
+// CHECK-NOT: @dx.op.createHandle(i32 57, i8 0, i32 0
+// CHECK: ret void
+
+Buffer<float4> bufs[] : register(t0);
+RWBuffer<float4> output : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint gid : SV_GroupID, uint tid : SV_GroupIndex)
+{
+    float4 r = 0;
+    [branch]
+    if (tid == 1) {
+        r = bufs[gid][tid];
+    } else {
+        [branch]
+        if (tid == 2)
+            r = bufs[gid][tid + 8] * 2;
+        else
+            r = bufs[gid][tid + 16] * 3;
+    }
+    output[tid] = r;
+}
@@ -0,0 +1,34 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+
+// Make sure a handle whose index is checked against a bound is not created
+// above the check, even though a uniform index is available there: the
+// shader never creates it with an index out of bounds.
+// CHECK: define void @main()
+// CHECK-NOT: @dx.op.createHandle(i32 57, i8 0, i32 0
+// CHECK: br i1
+// CHECK-NOT: @dx.op.createHandle(i32 57, i8 0, i32 0
+// CHECK: br i1
+// CHECK: @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 false)
+// CHECK: @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 false)
+// CHECK: ret void
+
+Buffer<float4> bufs[] : register(t0);
+RWBuffer<float4> output : register(u0);
+uint count;
+
+[numthreads(64, 1, 1)]
+void main(uint gid : SV_GroupID, uint tid : SV_GroupIndex)
+{
+    float4 r = 0;
+    [branch]
+    if (tid == 1) {
+        [branch]
+        if (gid < count)
+            r = bufs[gid][tid];
+    } else {
+        [branch]
+        if (gid < count)
+            r = bufs[gid][tid + 8] * 2;
+    }
+    output[tid] = r;
+}
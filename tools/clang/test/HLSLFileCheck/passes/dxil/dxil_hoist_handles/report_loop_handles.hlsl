@@ -0,0 +1,19 @@
+// RUN: %dxc -E main -T cs_6_0 -report-loop-handles %s | FileCheck %s
+
+// The handle indexed by the loop counter is created every iteration and is
+// reported. The one indexed by the group id moves out of the loop.
+// CHECK: note: resource handle with a non-uniform index that changes in the loop is created on every iteration.
+
+Buffer<float4> bufs[] : register(t0);
+RWBuffer<float4> output : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint gid : SV_GroupID, uint tid : SV_GroupIndex)
+{
+    float4 r = 0;
+    for (uint i = 0; i < tid; ++i) {
+        r += bufs[NonUniformResourceIndex(i * 4 + tid)][gid];
+        r += bufs[gid][i];
+    }
+    output[tid] = r;
+}
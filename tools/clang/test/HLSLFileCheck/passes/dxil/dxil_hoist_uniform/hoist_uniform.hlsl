@@ -0,0 +1,27 @@
+// RUN: %dxc -E main -T cs_6_0 -hoist-uniform %s | FileCheck %s
+
+// Make sure the branch on a constant buffer value is marked as a branch, and
+// the branch on the thread id is not.
+// CHECK: icmp ugt i32 %{{.*}}, 3
+// CHECK: br i1 %{{.*}}, label %{{.*}}, label %{{.*}}, !dx.controlflow.hints
+// CHECK: br i1 %{{.*}}, label %{{.*}}, label %{{.*}}{{$}}
+// CHECK: !"dx.controlflow.hints", i32 1
+
+cbuffer cb
+{
+    uint c;
+    float f;
+};
+
+RWStructuredBuffer<float> buf;
+
+[numthreads(8, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    if (c > 3) {
+        buf[id] = f;
+    }
+    if (id > 3) {
+        buf[id + 8] = f;
+    }
+}
@@ -0,0 +1,24 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+
+// Make sure branches are only marked with -hoist-uniform.
+// CHECK: icmp ugt i32 %{{.*}}, 3
+// CHECK-NOT: dx.controlflow.hints
+
+cbuffer cb
+{
+    uint c;
+    float f;
+};
+
+RWStructuredBuffer<float> buf;
+
+[numthreads(8, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    if (c > 3) {
+        buf[id] = f;
+    }
+    if (id > 3) {
+        buf[id + 8] = f;
+    }
+}
@@ -0,0 +1,40 @@
+; RUN: %opt %s -dxil-rematerialize -S | FileCheck %s
+
+; The cbuffer value is live through %heavy, where the 40 scalars of %v are
+; live, so it is read again in %exit instead of being kept from %entry.
+
+; CHECK-LABEL: entry:
+; CHECK-NOT: @dx.op.cbufferLoadLegacy
+; CHECK-LABEL: heavy:
+; CHECK-NOT: @dx.op.cbufferLoadLegacy
+; CHECK-LABEL: exit:
+; CHECK: %[[H:.+]] = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 2, i32 0, i32 0, i1 false)
+; CHECK: %[[CB:.+]] = call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %[[H]], i32 0)
+; CHECK: %[[X:.+]] = extractvalue %dx.types.CBufRet.f32 %[[CB]], 0
+; CHECK: fadd fast float %p, %[[X]]
+
+%dx.types.Handle = type { i8* }
+%dx.types.CBufRet.f32 = type { float, float, float, float }
+
+define float @main(<40 x float> %v, i1 %c) {
+entry:
+  %h = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 2, i32 0, i32 0, i1 false)
+  %cb = call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %h, i32 0)
+  %x = extractvalue %dx.types.CBufRet.f32 %cb, 0
+  br i1 %c, label %heavy, label %exit
+
+heavy:
+  %s = call float @sum(<40 x float> %v)
+  br label %exit
+
+exit:
+  %p = phi float [ %s, %heavy ], [ 0.000000e+00, %entry ]
+  %r = fadd fast float %p, %x
+  ret float %r
+}
+
+declare float @sum(<40 x float>)
+declare %dx.types.Handle @dx.op.createHandle(i32, i8, i32, i32, i1) #0
+declare %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32, %dx.types.Handle, i32) #0
+
+attributes #0 = { nounwind readonly }
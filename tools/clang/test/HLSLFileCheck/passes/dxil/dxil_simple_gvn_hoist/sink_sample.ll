@@ -0,0 +1,116 @@
+; RUN: %opt %s -dxil-gvn-hoist -S | FileCheck %s
+
+; The arms sample with different coordinates. One sample is left in the merge
+; block, with its coordinates merged by phis.
+
+; CHECK-LABEL: then:
+; CHECK-NOT: @dx.op.sample
+; CHECK-LABEL: else:
+; CHECK-NOT: @dx.op.sample
+; CHECK-LABEL: exit:
+; CHECK-DAG: %[[U:.+]] = phi float [ %u0, %then ], [ %u1, %else ]
+; CHECK-DAG: %[[V:.+]] = phi float [ %v0, %then ], [ %v1, %else ]
+; CHECK: %[[S:.+]] = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %[[U]], float %[[V]], float undef, float undef, i32 0, i32 0, i32 undef, float undef)
+; CHECK: %[[X:.+]] = extractvalue %dx.types.ResRet.f32 %[[S]], 0
+; CHECK: %[[Y:.+]] = extractvalue %dx.types.ResRet.f32 %[[S]], 1
+; CHECK: fadd fast float %[[X]], %[[Y]]
+
+%dx.types.Handle = type { i8* }
+%dx.types.ResRet.f32 = type { float, float, float, float, i32 }
+
+define float @sink(%dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %u0 = fmul fast float %u, 2.000000e+00
+  %v0 = fmul fast float %v, 2.000000e+00
+  %s0 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u0, float %v0, float undef, float undef, i32 0, i32 0, i32 undef, float undef)
+  %x0 = extractvalue %dx.types.ResRet.f32 %s0, 0
+  %y0 = extractvalue %dx.types.ResRet.f32 %s0, 1
+  br label %exit
+
+else:
+  %u1 = fadd fast float %u, 1.000000e+00
+  %v1 = fadd fast float %v, 1.000000e+00
+  %s1 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u1, float %v1, float undef, float undef, i32 0, i32 0, i32 undef, float undef)
+  %x1 = extractvalue %dx.types.ResRet.f32 %s1, 0
+  %y1 = extractvalue %dx.types.ResRet.f32 %s1, 1
+  br label %exit
+
+exit:
+  %x = phi float [ %x0, %then ], [ %x1, %else ]
+  %y = phi float [ %y0, %then ], [ %y1, %else ]
+  %r = fadd fast float %x, %y
+  ret float %r
+}
+
+; Texel offsets are immediate, so samples that only differ there stay apart.
+
+; CHECK-LABEL: @offsets
+; CHECK-LABEL: then:
+; CHECK: @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 1, i32 0, i32 undef, float undef)
+; CHECK-LABEL: else:
+; CHECK: @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 -1, i32 0, i32 undef, float undef)
+
+define float @offsets(%dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %s0 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 1, i32 0, i32 undef, float undef)
+  %x0 = extractvalue %dx.types.ResRet.f32 %s0, 0
+  br label %exit
+
+else:
+  %s1 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 -1, i32 0, i32 undef, float undef)
+  %x1 = extractvalue %dx.types.ResRet.f32 %s1, 0
+  br label %exit
+
+exit:
+  %x = phi float [ %x0, %then ], [ %x1, %else ]
+  ret float %x
+}
+
+; The same sample in every case of a switch is hoisted above it.
+
+; CHECK-LABEL: @switch
+; CHECK-LABEL: entry:
+; CHECK: @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v
+; CHECK: switch
+; CHECK-NOT: @dx.op.sample
+; CHECK: ret float
+
+define float @switch(%dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, i32 %k) {
+entry:
+  switch i32 %k, label %c2 [
+    i32 0, label %c0
+    i32 1, label %c1
+    i32 3, label %c1
+  ]
+
+c0:
+  %s0 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 0, i32 0, i32 undef, float undef)
+  %x0 = extractvalue %dx.types.ResRet.f32 %s0, 0
+  %r0 = fadd fast float %x0, 1.000000e+00
+  br label %exit
+
+c1:
+  %s1 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 0, i32 0, i32 undef, float undef)
+  %x1 = extractvalue %dx.types.ResRet.f32 %s1, 0
+  %r1 = fmul fast float %x1, 3.000000e+00
+  br label %exit
+
+c2:
+  %s2 = call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60, %dx.types.Handle %tex, %dx.types.Handle %ss, float %u, float %v, float undef, float undef, i32 0, i32 0, i32 undef, float undef)
+  %x2 = extractvalue %dx.types.ResRet.f32 %s2, 0
+  br label %exit
+
+exit:
+  %r = phi float [ %r0, %c0 ], [ %r1, %c1 ], [ %x2, %c2 ]
+  ret float %r
+}
+
+declare %dx.types.ResRet.f32 @dx.op.sample.f32(i32, %dx.types.Handle, %dx.types.Handle, float, float, float, float, i32, i32, i32, float) #0
+
+attributes #0 = { nounwind readonly }
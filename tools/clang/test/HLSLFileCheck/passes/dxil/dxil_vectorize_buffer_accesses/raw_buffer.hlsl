@@ -0,0 +1,21 @@
+// RUN: %dxc -E main -T cs_6_2 %s | FileCheck %s
+
+// Make sure the three loads become one of xyz, and the two stores one of xy.
+// CHECK: call %dx.types.ResRet.i32 @dx.op.rawBufferLoad.i32(i32 139, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 undef, i8 7, i32 4)
+// CHECK-NOT: @dx.op.rawBufferLoad.i32(i32 139
+// CHECK: call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 undef, i32 %{{.*}}, i32 %{{.*}}, i32 undef, i32 undef, i8 3, i32 4)
+// CHECK-NOT: @dx.op.rawBufferStore.i32(i32 140
+
+ByteAddressBuffer In;
+RWByteAddressBuffer Out;
+
+[numthreads(8, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    uint base = id * 16;
+    uint a = In.Load(base);
+    uint b = In.Load(base + 4);
+    uint c = In.Load(base + 8);
+    Out.Store(base, a + b);
+    Out.Store(base + 4, b * c);
+}
@@ -0,0 +1,27 @@
+// RUN: %dxc -E main -T cs_6_2 %s | FileCheck %s
+
+// Make sure the fields read one by one are loaded together, and the ones
+// written one by one are stored together.
+// CHECK: call %dx.types.ResRet.f32 @dx.op.rawBufferLoad.f32(i32 139, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 4, i8 3, i32 4)
+// CHECK-NOT: @dx.op.rawBufferLoad.f32(i32 139
+// CHECK: call void @dx.op.rawBufferStore.f32(i32 140, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 0, float %{{.*}}, float %{{.*}}, float undef, float undef, i8 3, i32 4)
+// CHECK-NOT: @dx.op.rawBufferStore.f32(i32 140
+
+struct Particle
+{
+    float mass;
+    float x;
+    float y;
+};
+
+StructuredBuffer<Particle> In;
+RWStructuredBuffer<Particle> Out;
+
+[numthreads(8, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    float x = In[id].x;
+    float y = In[id].y;
+    Out[id].mass = x * y;
+    Out[id].x = x + y;
+}
@@ -0,0 +1,37 @@
+// RUN: %dxc -E main -T cs_6_0 -wave-aggregate-atomics %s | FileCheck %s
+
+// Make sure atomics on uniform addresses are made once per wave with the
+// combined value, that the counter's original value is rebuilt per lane, and
+// that the atomic on a per-lane address is left alone.
+
+// CHECK: call i32 @dx.op.waveAllOp(i32 135, i1 true)
+// CHECK: call i32 @dx.op.wavePrefixOp(i32 136, i1 true)
+// CHECK: call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %{{.*}}, i32 0,
+// CHECK: call i32 @dx.op.waveReadLaneFirst.i32(i32 118
+
+// CHECK: call i32 @dx.op.waveActiveBit.i32(i32 120, i32 %{{.*}}, i8 1)
+// CHECK: call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %{{.*}}, i32 2,
+
+// CHECK: call i32 @dx.op.waveActiveOp.i32(i32 119, i32 %{{.*}}, i8 0, i8 1)
+// CHECK: call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: atomicrmw add i32 addrspace(3)*
+
+// CHECK-NOT: @dx.op.waveIsFirstLane
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %{{.*}}, i32 7,
+
+RWStructuredBuffer<uint> counters;
+RWByteAddressBuffer buf;
+groupshared uint total;
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+    uint prev;
+    InterlockedAdd(counters[0], 1, prev);
+    buf.InterlockedOr(4, id);
+    InterlockedAdd(total, id);
+    buf.InterlockedMax(id * 4 + 8, id);
+    buf.Store(id * 4 + 512, prev);
+}
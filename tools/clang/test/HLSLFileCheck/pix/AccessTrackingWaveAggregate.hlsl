@@ -0,0 +1,26 @@
+// RUN: %dxc -ECSMain -Tcs_6_0 %s | %opt -S -hlsl-dxil-pix-shader-access-instrumentation,config=S0:1:1i1;U0:2:10i0;..,waveAggregate=1 | %FileCheck %s
+
+// Check we added the UAV:
+// CHECK:  %PIX_CountUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 1, i32 0, i1 false)
+
+// The dynamically-indexed write is made by every lane unless the whole wave
+// hits the same slot, in which case only the first lane makes it:
+// CHECK: slotIndex = mul i32
+// CHECK: %IsFirstLane{{[0-9]*}} = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: %SlotIsUniform = call i1 @dx.op.waveActiveAllEqual.i32(i32 115
+// CHECK: %ShouldWrite = or i1 %IsFirstLane
+// CHECK: br i1 %ShouldWrite
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_CountUAV_Handle
+
+ByteAddressBuffer inBuffer : register(t0);
+RWByteAddressBuffer bufferArray[] : register(u0);
+
+[numthreads(1, 1, 1)]
+void CSMain()
+{
+  // Simple read
+  uint dynamicBufferIndex = inBuffer.Load(0);
+
+  // Dynamically indexed write
+  bufferArray[dynamicBufferIndex].Store(0, 1);
+}
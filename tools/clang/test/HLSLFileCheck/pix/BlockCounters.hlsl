@@ -0,0 +1,20 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -dxil-annotate-with-virtual-regs -hlsl-dxil-pix-block-counters | %FileCheck %s
+
+// Check that each block adds its wave's active lane count to its own counter,
+// from the first lane only.
+
+// CHECK: %PIX_BlockCountersUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+// CHECK: %ActiveLanes = call i32 @dx.op.waveAllOp(i32 135, i1 true)
+// CHECK: %IsFirstLane = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: br i1 %IsFirstLane
+// CHECK: %BlockCount = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_BlockCountersUAV_Handle, i32 0, i32 0, i32 undef, i32 undef, i32 %ActiveLanes)
+// CHECK: %ActiveLanes{{[0-9]+}} = call i32 @dx.op.waveAllOp(i32 135, i1 true)
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_BlockCountersUAV_Handle, i32 0, i32 4,
+
+float4 main(float4 pos : SV_Position) : SV_Target {
+  [branch]
+  if (pos.x > 10) {
+    return pos * 2;
+  }
+  return pos;
+}
@@ -0,0 +1,16 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -dxil-annotate-with-virtual-regs -hlsl-dxil-debug-instrumentation,compact=1 | %FileCheck %s
+
+// Check that the compact format reserves space once for the invocation start
+// marker and once for the whole (single) block, rather than once per step,
+// and that the block's record starts with its header and the invocation id.
+
+// CHECK: %UAVIncResult = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_DebugUAV_Handle
+// CHECK: %UAVIncResult{{[0-9]+}} = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_DebugUAV_Handle
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_DebugUAV_Handle, i32 %AddedForInterest{{[0-9]+}}, i32 undef, i32 {{[0-9]+}},
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_DebugUAV_Handle, i32 %{{.*}}, i32 undef, i32 %UAVIncResult,
+// CHECK-NOT: call i32 @dx.op.atomicBinOp.i32(
+// CHECK: ret void
+
+float4 main(float4 pos : SV_Position) : SV_Target {
+  return pos * 2;
+}
@@ -0,0 +1,19 @@
+// RUN: %dxc -Emain -Tcs_6_0 %s | %opt -S -hlsl-dxil-debug-instrumentation,parameter0=10,parameter1=20,parameter2=30,sampleRate=8 | %FileCheck %s
+
+// Check that with sampling the thread IDs are hashed instead of being
+// compared with the parameters.
+
+// CHECK: %PIX_DebugUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)
+// CHECK: %ThreadIdX = call i32 @dx.op.threadId.i32(i32 93, i32 0)
+// CHECK: %ThreadIdY = call i32 @dx.op.threadId.i32(i32 93, i32 1)
+// CHECK: %ThreadIdZ = call i32 @dx.op.threadId.i32(i32 93, i32 2)
+// CHECK-NOT: %CompareToThreadIdX
+// CHECK: %SampleHash = xor i32 %ThreadIdX, -2128831035
+// CHECK: %Residue = and i32 %SampleHash{{[0-9]+}}, 7
+// CHECK: %IsSampled = icmp eq i32 %Residue, 0
+// CHECK: %OffsetMultiplicand = zext i1 %IsSampled to i32
+
+[RootSignature("")]
+[numthreads(4, 4, 4)]
+void main() {
+}
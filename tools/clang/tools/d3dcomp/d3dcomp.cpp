@@ -15,6 +15,9 @@
 #include "dxc/dxcapi.h"
 
 #include <d3dcompiler.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
@@ -34,6 +37,135 @@ HRESULT CreateContainerReflection(IDxcContainerReflection **ppReflection) {
                            (void **)ppReflection);
 }
 
+// Process-wide cache of compile results, for titles that compile the same
+// shaders at every level load. It is enabled by setting the environment
+// variable D3DCOMPILER_DXC_BRIDGE_CACHE_MB to the number of megabytes it may
+// hold.
+//
+// Compiles without an include handler depend only on their arguments, so
+// their outputs are kept here and returned without calling the compiler.
+// Compiles that include files go through the compiler's own cache instead,
+// which preprocesses the source and keys on the contents of every include.
+class BridgeCompileCache {
+private:
+  struct Entry {
+    std::string Key;
+    CComPtr<IDxcBlob> pCode;
+  };
+  std::mutex m_lock;
+  std::list<Entry> m_entries; // Most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+  UINT64 m_size = 0;
+  UINT64 m_maxSize = 0;
+  CComPtr<IDxcCompileCacheStore> m_pStore;
+
+  static UINT64 GetEntrySize(const Entry &E) {
+    return E.Key.size() + E.pCode->GetBufferSize();
+  }
+
+public:
+  BridgeCompileCache() {
+    char value[32];
+    DWORD length = GetEnvironmentVariableA("D3DCOMPILER_DXC_BRIDGE_CACHE_MB",
+                                           value, _countof(value));
+    if (length != 0 && length < _countof(value))
+      m_maxSize = strtoull(value, nullptr, 10) << 20;
+  }
+
+  bool IsEnabled() const { return m_maxSize != 0; }
+
+  // Copies out the code stored for Key, so callers are free to change it.
+  bool Lookup(const std::string &Key, IDxcLibrary *pLibrary, ID3DBlob **ppCode) {
+    CComPtr<IDxcBlob> pCode;
+    {
+      std::lock_guard<std::mutex> L(m_lock);
+      auto it = m_index.find(Key);
+      if (it == m_index.end())
+        return false;
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      pCode = it->second->pCode;
+    }
+    CComPtr<IDxcBlobEncoding> pCodeCopy;
+    if (FAILED(pLibrary->CreateBlobWithEncodingOnHeapCopy(
+            pCode->GetBufferPointer(), (UINT32)pCode->GetBufferSize(), 0,
+            &pCodeCopy)))
+      return false;
+    *ppCode = (ID3DBlob *)pCodeCopy.Detach();
+    return true;
+  }
+
+  // Stores a copy of pCode, since the caller gets pCode itself and is free
+  // to change it.
+  void Store(const std::string &Key, IDxcLibrary *pLibrary, IDxcBlob *pCode) {
+    Entry E;
+    E.Key = Key;
+    CComPtr<IDxcBlobEncoding> pCodeCopy;
+    if (FAILED(pLibrary->CreateBlobWithEncodingOnHeapCopy(
+            pCode->GetBufferPointer(), (UINT32)pCode->GetBufferSize(), 0,
+            &pCodeCopy)))
+      return;
+    E.pCode = pCodeCopy;
+    UINT64 size = GetEntrySize(E);
+    if (size > m_maxSize)
+      return;
+    std::lock_guard<std::mutex> L(m_lock);
+    if (m_index.count(Key))
+      return;
+    while (m_size + size > m_maxSize) {
+      m_size -= GetEntrySize(m_entries.back());
+      m_index.erase(m_entries.back().Key);
+      m_entries.pop_back();
+    }
+    m_entries.push_front(std::move(E));
+    m_index[Key] = m_entries.begin();
+    m_size += size;
+  }
+
+  // Shares one in-memory store among the compilers the bridge creates.
+  void AttachStore(IDxcCompiler *pCompiler) {
+    CComPtr<IDxcCompileCache> pCache;
+    if (FAILED(pCompiler->QueryInterface(&pCache)))
+      return;
+    std::lock_guard<std::mutex> L(m_lock);
+    if (!m_pStore && FAILED(pCache->CreateMemoryStore(m_maxSize, &m_pStore)))
+      return;
+    pCache->SetStore(m_pStore);
+  }
+};
+
+static BridgeCompileCache &GetCompileCache() {
+  static BridgeCompileCache cache;
+  return cache;
+}
+
+// Everything a compile without includes depends on, each part prefixed with
+// its length so that no two argument lists give the same key.
+static std::string GetCompileCacheKey(IDxcBlob *pSource, LPCWSTR pSourceName,
+                                      const D3D_SHADER_MACRO *pDefines,
+                                      LPCSTR pEntrypoint, LPCSTR pTarget,
+                                      UINT Flags1, UINT Flags2) {
+  std::string key;
+  auto append = [&key](const void *pData, size_t size) {
+    key.append((const char *)&size, sizeof(size));
+    key.append((const char *)pData, size);
+  };
+  auto appendStr = [&append](LPCSTR pStr) {
+    append(pStr, pStr ? strlen(pStr) : 0);
+  };
+  UINT flags[2] = {Flags1, Flags2};
+  append(flags, sizeof(flags));
+  appendStr(pEntrypoint);
+  appendStr(pTarget);
+  append(pSourceName, pSourceName ? wcslen(pSourceName) * sizeof(wchar_t) : 0);
+  for (const D3D_SHADER_MACRO *pCursor = pDefines; pCursor && pCursor->Name;
+       ++pCursor) {
+    appendStr(pCursor->Name);
+    appendStr(pCursor->Definition);
+  }
+  append(pSource->GetBufferPointer(), pSource->GetBufferSize());
+  return key;
+}
+
 HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
                         const D3D_SHADER_MACRO *pDefines, IDxcIncludeHandler *pInclude,
                         LPCSTR pEntrypoint, LPCSTR pTarget, UINT Flags1,
@@ -41,8 +173,24 @@ HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
                         ID3DBlob **ppErrorMsgs) {
   CComPtr<IDxcCompiler> compiler;
   CComPtr<IDxcOperationResult> operationResult;
+  CComPtr<IDxcLibrary> library;
+  BridgeCompileCache &cache = GetCompileCache();
+  bool bUseCache = cache.IsEnabled() && pInclude == nullptr;
+  std::string cacheKey;
   HRESULT hr;
 
+  if (bUseCache) {
+    try {
+      cacheKey = GetCompileCacheKey(pSource, pSourceName, pDefines,
+                                    pEntrypoint, pTarget, Flags1, Flags2);
+    } catch (const std::bad_alloc &) {
+      return E_OUTOFMEMORY;
+    }
+    IFR(CreateLibrary(&library));
+    if (cache.Lookup(cacheKey, library, ppCode))
+      return S_OK;
+  }
+
   // Upconvert legacy targets
   char Target[7] = "?s_6_0";
   Target[6] = 0;
@@ -108,6 +256,8 @@ HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
     arguments.push_back(L"2016");
 
     IFR(CreateCompiler(&compiler));
+    if (cache.IsEnabled() && pInclude != nullptr)
+      cache.AttachStore(compiler);
     IFR(compiler->Compile(pSource, pSourceName, pEntrypointW, pTargetProfileW,
                           arguments.data(), (UINT)arguments.size(),
                           defines.data(), (UINT)defines.size(), pInclude,
@@ -120,6 +270,16 @@ HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
 
   operationResult->GetStatus(&hr);
   if (SUCCEEDED(hr)) {
+    if (bUseCache) {
+      CComPtr<IDxcBlob> pCode;
+      if (SUCCEEDED(operationResult->GetResult(&pCode)) && pCode) {
+        try {
+          cache.Store(cacheKey, library, pCode);
+        } catch (const std::bad_alloc &) {
+          // The result is still good without the cache.
+        }
+      }
+    }
     return operationResult->GetResult((IDxcBlob **)ppCode);
   } else {
     if (ppErrorMsgs)
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcFuzzer.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the libFuzzer target that compiles and validates one input.     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// Each input is compiled with IDxcCompiler3, which validates what it
+// produces, or with DXC_FUZZ_MODE=container is handed to IDxcValidator as
+// a container. Crashes are found by libFuzzer as usual. Inputs that compile
+// too slowly or use too much memory are findings as well, so that inputs
+// that make a pass go exponential or quadratic are caught before they
+// reach a timeout.
+//
+// The environment configures the target:
+//   DXC_FUZZ_ARGS          compiler arguments, "-T lib_6_3" by default
+//   DXC_FUZZ_MODE          "compile" (the default) or "container"
+//   DXC_FUZZ_TIME_BUDGET   milliseconds an input may take, 0 for no budget
+//   DXC_FUZZ_MEMORY_BUDGET MiB a compile may have live at its peak, 0 for
+//                          no budget
+//   DXC_FUZZ_SLOW_ACTION   "record" (the default) writes each slow unit to
+//                          slow-unit-<md5>; "abort" also aborts, so
+//                          libFuzzer stops and reports it like a crash
+//   DXC_FUZZ_STATS         file that gets one line per input: the MD5 of
+//                          the input, its size, the milliseconds it took,
+//                          the peak MiB live (-1 if not measured) and the
+//                          HRESULT
+//   DXC_FUZZ_ARTIFACT_PREFIX
+//                          prefix of the slow unit files
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+StringRef GetEnv(const char *pName) {
+  const char *pValue = getenv(pName);
+  return pValue ? StringRef(pValue) : StringRef();
+}
+
+uint64_t GetEnvUInt(const char *pName) {
+  uint64_t Value = 0;
+  if (GetEnv(pName).getAsInteger(10, Value))
+    return 0;
+  return Value;
+}
+
+struct FuzzConfig {
+  std::vector<std::wstring> Args;
+  bool ContainerMode = false;
+  uint64_t TimeBudgetMs = 0;
+  uint64_t MemoryBudgetBytes = 0;
+  bool AbortWhenSlow = false;
+  std::string ArtifactPrefix;
+  FILE *pStats = nullptr;
+
+  FuzzConfig() {
+    StringRef ArgText = GetEnv("DXC_FUZZ_ARGS");
+    if (ArgText.empty())
+      ArgText = "-T lib_6_3";
+    SmallVector<StringRef, 8> Parts;
+    ArgText.split(Parts, " ", -1, false);
+    for (StringRef Part : Parts)
+      Args.emplace_back(Part.begin(), Part.end());
+    ContainerMode = GetEnv("DXC_FUZZ_MODE") == "container";
+    TimeBudgetMs = GetEnvUInt("DXC_FUZZ_TIME_BUDGET");
+    MemoryBudgetBytes = GetEnvUInt("DXC_FUZZ_MEMORY_BUDGET") << 20;
+    // The live bytes are only tracked when the compiler reports them.
+    if (MemoryBudgetBytes)
+      Args.emplace_back(L"-fmemory-report");
+    AbortWhenSlow = GetEnv("DXC_FUZZ_SLOW_ACTION") == "abort";
+    ArtifactPrefix = GetEnv("DXC_FUZZ_ARTIFACT_PREFIX");
+    StringRef StatsFile = GetEnv("DXC_FUZZ_STATS");
+    if (!StatsFile.empty())
+      pStats = fopen(StatsFile.str().c_str(), "a");
+  }
+};
+
+FuzzConfig &GetConfig() {
+  static FuzzConfig Config;
+  return Config;
+}
+
+std::string GetUnitHash(const uint8_t *Data, size_t Size) {
+  MD5 Hash;
+  Hash.update(ArrayRef<uint8_t>(Data, Size));
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Hex;
+  MD5::stringifyResult(Result, Hex);
+  return Hex.str();
+}
+
+// Reads the peak live bytes out of the -fmemory-report output, or returns
+// -1 if there is none.
+int64_t GetPeakBytes(IDxcResult *pResult) {
+  CComPtr<IDxcBlobUtf8> pReport;
+  if (FAILED(pResult->GetOutput(DXC_OUT_MEMORY_REPORT, IID_PPV_ARGS(&pReport),
+                                nullptr)) ||
+      !pReport)
+    return -1;
+  StringRef Report(pReport->GetStringPointer(), pReport->GetStringLength());
+  const char Key[] = "\"peakBytes\": ";
+  size_t Pos = Report.find(Key);
+  if (Pos == StringRef::npos)
+    return -1;
+  StringRef Value = Report.drop_front(Pos + sizeof(Key) - 1);
+  Value = Value.substr(0, Value.find_first_not_of("0123456789"));
+  int64_t Peak = -1;
+  if (Value.getAsInteger(10, Peak))
+    return -1;
+  return Peak;
+}
+
+HRESULT CompileUnit(const FuzzConfig &Config, const uint8_t *Data, size_t Size,
+                    int64_t &PeakBytes) {
+  CComPtr<IDxcCompiler3> pCompiler;
+  IFR(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&pCompiler)));
+  std::vector<LPCWSTR> Args;
+  for (const std::wstring &Arg : Config.Args)
+    Args.push_back(Arg.c_str());
+  DxcBuffer Source = { Data, Size, DXC_CP_UTF8 };
+  CComPtr<IDxcResult> pResult;
+  IFR(pCompiler->Compile(&Source, Args.data(), (UINT32)Args.size(), nullptr,
+                         IID_PPV_ARGS(&pResult)));
+  PeakBytes = GetPeakBytes(pResult);
+  HRESULT Status = S_OK;
+  IFR(pResult->GetStatus(&Status));
+  return Status;
+}
+
+HRESULT ValidateUnit(const uint8_t *Data, size_t Size) {
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcLibrary> pLibrary;
+  IFR(DxcCreateInstance(CLSID_DxcValidator, IID_PPV_ARGS(&pValidator)));
+  IFR(DxcCreateInstance(CLSID_DxcLibrary, IID_PPV_ARGS(&pLibrary)));
+  CComPtr<IDxcBlobEncoding> pContainer;
+  IFR(pLibrary->CreateBlobWithEncodingFromPinned(Data, (UINT32)Size, CP_ACP,
+                                                 &pContainer));
+  CComPtr<IDxcOperationResult> pResult;
+  IFR(pValidator->Validate(pContainer, DxcValidatorFlags_Default,
+                           &pResult));
+  HRESULT Status = S_OK;
+  IFR(pResult->GetStatus(&Status));
+  return Status;
+}
+
+void RecordSlowUnit(const FuzzConfig &Config, const uint8_t *Data, size_t Size,
+                    const std::string &Hash, const char *pReason) {
+  std::string Path = Config.ArtifactPrefix + "slow-unit-" + Hash;
+  fprintf(stderr, "==dxc-fuzzer== slow unit: %s; writing it to %s\n", pReason,
+          Path.c_str());
+  if (FILE *pFile = fopen(Path.c_str(), "wb")) {
+    fwrite(Data, 1, Size, pFile);
+    fclose(pFile);
+  }
+  if (Config.AbortWhenSlow)
+    abort();
+}
+
+} // namespace
+
+extern "C" void LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  const FuzzConfig &Config = GetConfig();
+  int64_t PeakBytes = -1;
+  auto Start = std::chrono::steady_clock::now();
+  HRESULT Status = Config.ContainerMode ? ValidateUnit(Data, Size)
+                                        : CompileUnit(Config, Data, Size,
+                                                      PeakBytes);
+  uint64_t ElapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - Start)
+                           .count();
+
+  if (!Config.pStats && !Config.TimeBudgetMs && !Config.MemoryBudgetBytes)
+    return;
+  std::string Hash = GetUnitHash(Data, Size);
+  if (Config.pStats) {
+    fprintf(Config.pStats, "%s %u %u %d 0x%08x\n", Hash.c_str(),
+            (unsigned)Size, (unsigned)ElapsedMs,
+            PeakBytes < 0 ? -1 : (int)(PeakBytes >> 20), (unsigned)Status);
+    fflush(Config.pStats);
+  }
+
+  char Reason[128];
+  if (Config.TimeBudgetMs && ElapsedMs > Config.TimeBudgetMs) {
+    snprintf(Reason, sizeof(Reason), "took %u ms, over the budget of %u ms",
+             (unsigned)ElapsedMs, (unsigned)Config.TimeBudgetMs);
+    RecordSlowUnit(Config, Data, Size, Hash, Reason);
+  } else if (Config.MemoryBudgetBytes && PeakBytes >= 0 &&
+             (uint64_t)PeakBytes > Config.MemoryBudgetBytes) {
+    snprintf(Reason, sizeof(Reason),
+             "peaked at %u MiB, over the budget of %u MiB",
+             (unsigned)(PeakBytes >> 20),
+             (unsigned)(Config.MemoryBudgetBytes >> 20));
+    RecordSlowUnit(Config, Data, Size, Hash, Reason);
+  }
+}
@@ -0,0 +1,608 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbench.cpp                                                              //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the dxc-bench compile and validation         //
+// throughput benchmark.                                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace llvm;
+using namespace dxc;
+
+static cl::opt<bool> Help("h", cl::desc("Alias for -help"), cl::Hidden);
+
+static cl::opt<std::string>
+    CorpusFile(cl::Positional, cl::desc("<corpus file>"), cl::init(""));
+
+static cl::opt<std::string>
+    RootDir("root", cl::desc("Directory corpus paths are relative to"),
+            cl::value_desc("directory"), cl::init("."));
+
+static cl::opt<std::string> OutputFilename("o",
+                                           cl::desc("Write results as JSON"),
+                                           cl::value_desc("filename"));
+
+static cl::opt<std::string>
+    BaselineFilename("baseline", cl::desc("Compare against earlier results"),
+                     cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+    Iterations("n", cl::desc("Timed compiles per shader and configuration"),
+               cl::init(3));
+
+static cl::opt<bool> Spirv("spirv", cl::desc("Also benchmark SPIR-V code generation"));
+
+static cl::opt<bool>
+    Validate("validate",
+             cl::desc("Benchmark validation of each shader's -O3 container "
+                      "instead of its compiles"));
+
+static cl::opt<double>
+    Threshold("threshold",
+              cl::desc("Percentage increase reported as a regression"),
+              cl::init(10.0));
+
+static cl::opt<unsigned>
+    MinDeltaUs("min-delta-us",
+               cl::desc("Ignore time changes smaller than this many microseconds"),
+               cl::init(1000));
+
+namespace {
+
+struct BenchConfig {
+  const char *Name;
+  const wchar_t *OptLevel;
+  bool Spirv;
+};
+
+const BenchConfig kConfigs[] = {
+  { "dxil-Od", L"-Od", false },
+  { "dxil-O3", L"-O3", false },
+  { "spirv-Od", L"-Od", true },
+  { "spirv-O3", L"-O3", true },
+};
+
+const BenchConfig kValidateConfig = { "validate", L"-O3", false };
+
+struct CorpusEntry {
+  std::string Path;
+  std::vector<std::wstring> Args;
+};
+
+struct PhaseTime {
+  std::string Name;
+  uint64_t WallUs;
+  uint64_t AllocBytes;
+};
+
+struct BenchResult {
+  std::string File;
+  std::string Config;
+  bool Succeeded = false;
+  uint64_t WallUs = 0;      // fastest of the timed compiles or validations
+  uint64_t OutputBytes = 0;
+  uint64_t AllocBytes = 0;  // from the profiled compile
+  int64_t PeakBytes = -1;   // only reported where the allocator tracks it
+  std::vector<PhaseTime> Phases;
+};
+
+uint64_t GetPeakProcessMemory() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (uint64_t)usage.ru_maxrss;
+#else
+  return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void WriteJsonString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char c : Str) {
+    if (c == '"' || c == '\\')
+      OS << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      OS << format("\\u%04x", (unsigned)c);
+    else
+      OS << c;
+  }
+  OS << '"';
+}
+
+// JSON is read through the YAML parser, which accepts it as flow style.
+StringRef GetScalar(yaml::Node *pNode, SmallVectorImpl<char> &Storage) {
+  if (yaml::ScalarNode *pScalar = dyn_cast_or_null<yaml::ScalarNode>(pNode))
+    return pScalar->getValue(Storage);
+  return StringRef();
+}
+
+uint64_t GetUInt(yaml::Node *pNode) {
+  SmallString<32> Storage;
+  uint64_t value = 0;
+  if (GetScalar(pNode, Storage).getAsInteger(10, value))
+    return 0;
+  return value;
+}
+
+int64_t GetInt(yaml::Node *pNode) {
+  SmallString<32> Storage;
+  int64_t value = 0;
+  if (GetScalar(pNode, Storage).getAsInteger(10, value))
+    return 0;
+  return value;
+}
+
+// Calls Fn(key, value) for each entry of a mapping node.
+template <typename TFn> void ForEachKey(yaml::Node *pNode, TFn Fn) {
+  yaml::MappingNode *pMap = dyn_cast_or_null<yaml::MappingNode>(pNode);
+  if (!pMap)
+    return;
+  for (yaml::KeyValueNode &KV : *pMap) {
+    SmallString<32> KeyStorage;
+    StringRef Key = GetScalar(KV.getKey(), KeyStorage);
+    Fn(Key, KV.getValue());
+  }
+}
+
+template <typename TFn> void ForEachItem(yaml::Node *pNode, TFn Fn) {
+  yaml::SequenceNode *pSeq = dyn_cast_or_null<yaml::SequenceNode>(pNode);
+  if (!pSeq)
+    return;
+  for (yaml::Node &Item : *pSeq)
+    Fn(&Item);
+}
+
+// Reads the records of one kind out of a -ftime-report profile: compile
+// phases, or the rule groups of the validation run by the compile.
+void ReadProfile(StringRef Json, StringRef RecordKind, BenchResult &Result) {
+  SourceMgr SM;
+  yaml::Stream Stream(Json, SM);
+  yaml::document_iterator Doc = Stream.begin();
+  if (Doc == Stream.end())
+    return;
+  ForEachKey(Doc->getRoot(), [&](StringRef Key, yaml::Node *pValue) {
+    if (Key != "records")
+      return;
+    ForEachItem(pValue, [&](yaml::Node *pRecord) {
+      std::string Name, Kind;
+      uint64_t WallUs = 0, AllocBytes = 0;
+      int64_t PeakBytes = -1;
+      ForEachKey(pRecord, [&](StringRef Field, yaml::Node *pField) {
+        SmallString<32> Storage;
+        if (Field == "name")
+          Name = GetScalar(pField, Storage);
+        else if (Field == "kind")
+          Kind = GetScalar(pField, Storage);
+        else if (Field == "wallUs")
+          WallUs = GetUInt(pField);
+        else if (Field == "allocBytes")
+          AllocBytes = GetUInt(pField);
+        else if (Field == "peakBytes")
+          PeakBytes = GetInt(pField);
+      });
+      if (Kind != RecordKind)
+        return;
+      Result.Phases.push_back({ Name, WallUs, AllocBytes });
+      Result.AllocBytes += AllocBytes;
+      Result.PeakBytes = std::max(Result.PeakBytes, PeakBytes);
+    });
+  });
+}
+
+// Each corpus line is a path followed by the arguments it is compiled with,
+// less the optimization level. Blank lines and lines starting with '#' are
+// skipped.
+bool ReadCorpus(StringRef FileName, std::vector<CorpusEntry> &Corpus) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFile(FileName);
+  if (!Buffer) {
+    errs() << "cannot read corpus file " << FileName << "\n";
+    return false;
+  }
+  SmallVector<StringRef, 64> Lines;
+  (*Buffer)->getBuffer().split(Lines, "\n", -1, false);
+  for (StringRef Line : Lines) {
+    Line = Line.trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+    SmallVector<StringRef, 8> Tokens;
+    Line.split(Tokens, " ", -1, false);
+    CorpusEntry Entry;
+    Entry.Path = Tokens[0];
+    for (size_t i = 1; i < Tokens.size(); ++i)
+      Entry.Args.push_back(Unicode::UTF8ToUTF16StringOrThrow(Tokens[i].str().c_str()));
+    Corpus.push_back(std::move(Entry));
+  }
+  return true;
+}
+
+bool ReadResults(StringRef FileName, std::vector<BenchResult> &Results) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFile(FileName);
+  if (!Buffer) {
+    errs() << "cannot read baseline file " << FileName << "\n";
+    return false;
+  }
+  SourceMgr SM;
+  yaml::Stream Stream((*Buffer)->getBuffer(), SM);
+  yaml::document_iterator Doc = Stream.begin();
+  if (Doc == Stream.end())
+    return false;
+  ForEachKey(Doc->getRoot(), [&](StringRef Key, yaml::Node *pValue) {
+    if (Key != "results")
+      return;
+    ForEachItem(pValue, [&](yaml::Node *pItem) {
+      BenchResult Result;
+      ForEachKey(pItem, [&](StringRef Field, yaml::Node *pField) {
+        SmallString<64> Storage;
+        if (Field == "file")
+          Result.File = GetScalar(pField, Storage);
+        else if (Field == "config")
+          Result.Config = GetScalar(pField, Storage);
+        else if (Field == "status")
+          Result.Succeeded = GetScalar(pField, Storage) == "ok";
+        else if (Field == "wallUs")
+          Result.WallUs = GetUInt(pField);
+        else if (Field == "outputBytes")
+          Result.OutputBytes = GetUInt(pField);
+      });
+      Results.push_back(std::move(Result));
+    });
+  });
+  return !Stream.failed();
+}
+
+void WriteResults(raw_ostream &OS, const std::vector<BenchResult> &Results) {
+  OS << "{\n  \"version\": 1,\n  \"iterations\": " << Iterations
+     << ",\n  \"peakProcessBytes\": " << GetPeakProcessMemory()
+     << ",\n  \"results\": [";
+  bool first = true;
+  for (const BenchResult &R : Results) {
+    OS << (first ? "\n" : ",\n") << "    {\"file\": ";
+    first = false;
+    WriteJsonString(OS, R.File);
+    OS << ", \"config\": \"" << R.Config << "\", \"status\": \""
+       << (R.Succeeded ? "ok" : "failed") << '"';
+    if (R.Succeeded) {
+      OS << ", \"wallUs\": " << R.WallUs << ", \"outputBytes\": "
+         << R.OutputBytes << ", \"allocBytes\": " << R.AllocBytes;
+      if (R.PeakBytes >= 0)
+        OS << ", \"peakBytes\": " << R.PeakBytes;
+      OS << ", \"phases\": [";
+      for (size_t i = 0; i < R.Phases.size(); ++i) {
+        OS << (i ? ", " : "") << "{\"name\": ";
+        WriteJsonString(OS, R.Phases[i].Name);
+        OS << ", \"wallUs\": " << R.Phases[i].WallUs << ", \"allocBytes\": "
+           << R.Phases[i].AllocBytes << '}';
+      }
+      OS << ']';
+    }
+    OS << '}';
+  }
+  OS << "\n  ]\n}\n";
+}
+
+class BenchContext {
+private:
+  DxcDllSupport &m_dxcSupport;
+  CComPtr<IDxcCompiler3> m_pCompiler;
+  CComPtr<IDxcValidator> m_pValidator;
+  CComPtr<IDxcUtils> m_pUtils;
+
+  HRESULT Compile(const CorpusEntry &Entry, const std::wstring &Path,
+                  const BenchConfig &Config, IDxcBlobEncoding *pSource,
+                  bool Profile, IDxcResult **ppResult);
+
+public:
+  BenchContext(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {}
+
+  void Run(const std::vector<CorpusEntry> &Corpus,
+           std::vector<BenchResult> &Results);
+  void RunValidation(const std::vector<CorpusEntry> &Corpus,
+                     std::vector<BenchResult> &Results);
+};
+
+HRESULT BenchContext::Compile(const CorpusEntry &Entry,
+                              const std::wstring &Path,
+                              const BenchConfig &Config,
+                              IDxcBlobEncoding *pSource, bool Profile,
+                              IDxcResult **ppResult) {
+  std::vector<LPCWSTR> Args;
+  Args.push_back(Path.c_str());
+  for (const std::wstring &Arg : Entry.Args)
+    Args.push_back(Arg.c_str());
+  Args.push_back(Config.OptLevel);
+  if (Config.Spirv)
+    Args.push_back(L"-spirv");
+  if (Profile)
+    Args.push_back(L"-ftime-report");
+
+  // Includes are resolved relative to the shader, as the lit tests do.
+  CComPtr<IDxcIncludeHandler> pIncludeHandler;
+  IFR(m_pUtils->CreateDefaultIncludeHandler(&pIncludeHandler));
+
+  DxcBuffer Source;
+  Source.Ptr = pSource->GetBufferPointer();
+  Source.Size = pSource->GetBufferSize();
+  Source.Encoding = DXC_CP_ACP;
+  IFR(m_pCompiler->Compile(&Source, Args.data(), (UINT32)Args.size(),
+                           pIncludeHandler, IID_PPV_ARGS(ppResult)));
+  HRESULT status;
+  IFR((*ppResult)->GetStatus(&status));
+  return status;
+}
+
+void BenchContext::Run(const std::vector<CorpusEntry> &Corpus,
+                       std::vector<BenchResult> &Results) {
+  typedef std::chrono::steady_clock Clock;
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &m_pCompiler));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcUtils, &m_pUtils));
+
+  for (const CorpusEntry &Entry : Corpus) {
+    SmallString<256> FullPath(RootDir);
+    sys::path::append(FullPath, Entry.Path);
+    std::wstring Path = Unicode::UTF8ToUTF16StringOrThrow(FullPath.c_str());
+    CComPtr<IDxcBlobEncoding> pSource;
+    ReadFileIntoBlob(m_dxcSupport, Path.c_str(), &pSource);
+
+    for (const BenchConfig &Config : kConfigs) {
+      if (Config.Spirv && !Spirv)
+        continue;
+      BenchResult Result;
+      Result.File = Entry.Path;
+      Result.Config = Config.Name;
+
+      // The profiled compile also serves to warm up the timed ones.
+      CComPtr<IDxcResult> pResult;
+      HRESULT hr = Compile(Entry, Path, Config, pSource, true, &pResult);
+      if (SUCCEEDED(hr)) {
+        CComPtr<IDxcBlob> pObject;
+        if (SUCCEEDED(pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObject), nullptr)) && pObject)
+          Result.OutputBytes = pObject->GetBufferSize();
+        CComPtr<IDxcBlobUtf8> pReport;
+        if (pResult->HasOutput(DXC_OUT_TIME_REPORT) &&
+            SUCCEEDED(pResult->GetOutput(DXC_OUT_TIME_REPORT, IID_PPV_ARGS(&pReport), nullptr)))
+          ReadProfile(StringRef(pReport->GetStringPointer(), pReport->GetStringLength()),
+                      "phase", Result);
+      }
+
+      uint64_t Fastest = UINT64_MAX;
+      for (unsigned i = 0; SUCCEEDED(hr) && i < Iterations; ++i) {
+        CComPtr<IDxcResult> pTimedResult;
+        Clock::time_point Start = Clock::now();
+        hr = Compile(Entry, Path, Config, pSource, false, &pTimedResult);
+        uint64_t Us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - Start).count();
+        Fastest = std::min(Fastest, Us);
+      }
+      Result.Succeeded = SUCCEEDED(hr);
+      Result.WallUs = Result.Succeeded ? Fastest : 0;
+
+      outs() << format("%-10s %10.2f ms %8u bytes  ", Config.Name,
+                       Result.WallUs / 1000.0, (unsigned)Result.OutputBytes)
+             << Entry.Path << (Result.Succeeded ? "" : "  (failed)") << "\n";
+      Results.push_back(std::move(Result));
+    }
+  }
+}
+
+// Validates the container of each shader, which the compile has already
+// validated once. Rule group times and allocations come from the profile of
+// that compile, so they are only reported when the compiler validates with
+// its own validator rather than with dxil.dll.
+void BenchContext::RunValidation(const std::vector<CorpusEntry> &Corpus,
+                                 std::vector<BenchResult> &Results) {
+  typedef std::chrono::steady_clock Clock;
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &m_pCompiler));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &m_pValidator));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcUtils, &m_pUtils));
+
+  for (const CorpusEntry &Entry : Corpus) {
+    SmallString<256> FullPath(RootDir);
+    sys::path::append(FullPath, Entry.Path);
+    std::wstring Path = Unicode::UTF8ToUTF16StringOrThrow(FullPath.c_str());
+    CComPtr<IDxcBlobEncoding> pSource;
+    ReadFileIntoBlob(m_dxcSupport, Path.c_str(), &pSource);
+
+    BenchResult Result;
+    Result.File = Entry.Path;
+    Result.Config = kValidateConfig.Name;
+
+    CComPtr<IDxcResult> pResult;
+    CComPtr<IDxcBlob> pObject;
+    HRESULT hr = Compile(Entry, Path, kValidateConfig, pSource, true, &pResult);
+    if (SUCCEEDED(hr))
+      hr = pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&pObject), nullptr);
+    if (SUCCEEDED(hr) && !pObject)
+      hr = E_FAIL;
+    if (SUCCEEDED(hr)) {
+      Result.OutputBytes = pObject->GetBufferSize();
+      CComPtr<IDxcBlobUtf8> pReport;
+      if (pResult->HasOutput(DXC_OUT_TIME_REPORT) &&
+          SUCCEEDED(pResult->GetOutput(DXC_OUT_TIME_REPORT, IID_PPV_ARGS(&pReport), nullptr)))
+        ReadProfile(StringRef(pReport->GetStringPointer(), pReport->GetStringLength()),
+                    "rules", Result);
+    }
+
+    uint64_t Fastest = UINT64_MAX;
+    for (unsigned i = 0; SUCCEEDED(hr) && i < Iterations; ++i) {
+      CComPtr<IDxcOperationResult> pValResult;
+      Clock::time_point Start = Clock::now();
+      hr = m_pValidator->Validate(pObject, DxcValidatorFlags_Default, &pValResult);
+      uint64_t Us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+          Clock::now() - Start).count();
+      if (SUCCEEDED(hr))
+        IFT(pValResult->GetStatus(&hr));
+      Fastest = std::min(Fastest, Us);
+    }
+    Result.Succeeded = SUCCEEDED(hr);
+    Result.WallUs = Result.Succeeded ? Fastest : 0;
+
+    outs() << format("%-10s %10.2f ms %8u bytes  ", kValidateConfig.Name,
+                     Result.WallUs / 1000.0, (unsigned)Result.OutputBytes)
+           << Entry.Path << (Result.Succeeded ? "" : "  (failed)") << "\n";
+    Results.push_back(std::move(Result));
+  }
+}
+
+double PercentChange(uint64_t Before, uint64_t After) {
+  return Before ? ((double)After - (double)Before) * 100.0 / Before : 0.0;
+}
+
+// Prints the differences from the baseline and returns the number of
+// regressions past the threshold.
+unsigned CompareResults(const std::vector<BenchResult> &Baseline,
+                        const std::vector<BenchResult> &Results) {
+  StringMap<const BenchResult *> BaselineIndex;
+  for (const BenchResult &R : Baseline)
+    BaselineIndex[R.File + "|" + R.Config] = &R;
+
+  unsigned Regressions = 0;
+  uint64_t BaseTotal = 0, NewTotal = 0;
+  for (const BenchResult &R : Results) {
+    auto It = BaselineIndex.find(R.File + "|" + R.Config);
+    if (It == BaselineIndex.end() || !It->second->Succeeded || !R.Succeeded)
+      continue;
+    const BenchResult &B = *It->second;
+    BaseTotal += B.WallUs;
+    NewTotal += R.WallUs;
+    double TimeChange = PercentChange(B.WallUs, R.WallUs);
+    double SizeChange = PercentChange(B.OutputBytes, R.OutputBytes);
+    bool SlowerBy = TimeChange > Threshold &&
+                    R.WallUs - B.WallUs >= MinDeltaUs;
+    bool LargerBy = SizeChange > Threshold;
+    if (SlowerBy || LargerBy) {
+      ++Regressions;
+      outs() << "regression: " << R.File << " [" << R.Config << "]"
+             << format(" time %+.1f%%, size %+.1f%%\n", TimeChange, SizeChange);
+    }
+  }
+  outs() << format("total time %+.1f%% against baseline, %u regression(s)\n",
+                   PercentChange(BaseTotal, NewTotal), Regressions);
+  return Regressions;
+}
+
+} // namespace
+
+int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
+  const char *pStage = "Operation";
+  int retVal = 0;
+  if (llvm::sys::fs::SetupPerThreadFileSystem())
+    return 1;
+  llvm::sys::fs::AutoCleanupPerThreadFileSystem auto_cleanup_fs;
+  if (FAILED(DxcInitThreadMalloc())) return 1;
+  DxcSetThreadMallocToDefault();
+  try {
+    llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    pStage = "Argument processing";
+    cl::ParseCommandLineOptions(argc, argv, "dxc compile and validation throughput benchmark\n");
+
+    if (CorpusFile == "" || Help) {
+      cl::PrintHelpMessage();
+      return 2;
+    }
+
+    std::vector<CorpusEntry> Corpus;
+    if (!ReadCorpus(CorpusFile, Corpus))
+      return 1;
+    std::vector<BenchResult> Baseline;
+    if (!BaselineFilename.empty() && !ReadResults(BaselineFilename, Baseline))
+      return 1;
+
+    DxcDllSupport dxcSupport;
+    dxc::EnsureEnabled(dxcSupport);
+    BenchContext context(dxcSupport);
+
+    pStage = "Benchmarking";
+    std::vector<BenchResult> Results;
+    if (Validate)
+      context.RunValidation(Corpus, Results);
+    else
+      context.Run(Corpus, Results);
+
+    if (!OutputFilename.empty()) {
+      std::error_code EC;
+      raw_fd_ostream OS(OutputFilename, EC, sys::fs::F_Text);
+      if (EC) {
+        errs() << "cannot write " << OutputFilename << ": " << EC.message() << "\n";
+        return 1;
+      }
+      WriteResults(OS, Results);
+    }
+
+    if (!BaselineFilename.empty() && CompareResults(Baseline, Results) != 0)
+      retVal = 1;
+  } catch (const ::hlsl::Exception &hlslException) {
+    try {
+      const char *msg = hlslException.what();
+      Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
+                                          // UTF-8 because we use ASCII only errors
+                                          // only
+      if (msg == nullptr || *msg == '\0') {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "%s failed - error code 0x%08x.", pStage, hlslException.hr);
+        msg = printBuffer;
+      }
+      printf("%s\n", msg);
+    } catch (...) {
+      printf("%s failed - unable to retrieve error message.\n", pStage);
+    }
+
+    return 1;
+  } catch (std::bad_alloc &) {
+    printf("%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    printf("%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+
+  return retVal;
+}
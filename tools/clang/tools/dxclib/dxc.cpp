@@ -42,6 +42,7 @@
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/WinFunctions.h"
 #include "dxc.h"
+#include "dxcserver.h"
 #include <vector>
 #include <string>
 
@@ -54,17 +55,25 @@
 #include "dxc/DXIL/DxilShaderModel.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include "dxc/Support/microcom.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Option/ArgList.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/Format.h"
 #ifdef _WIN32
 #include <dia2.h>
 #include <comdef.h>
 #endif
 #include <algorithm>
 #include <unordered_map>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #pragma comment(lib, "version.lib")
 
@@ -115,6 +124,8 @@ using namespace dxc;
 using namespace llvm::opt;
 using namespace hlsl::options;
 
+class DxcInjectedSourceCache;
+
 class DxcContext {
 
 private:
@@ -125,6 +136,7 @@ private:
   int ActOnBlob(IDxcBlob *pBlob, IDxcBlob *pDebugBlob, LPCWSTR pDebugBlobName);
   void UpdatePart(IDxcBlob *pBlob, IDxcBlob **ppResult);
   bool UpdatePartRequired();
+  bool StripReflectionRequired();
   void WriteHeader(IDxcBlobEncoding *pDisassembly, IDxcBlob *pCode,
                    llvm::Twine &pVariableName, LPCWSTR pPath);
   HRESULT ReadFileIntoPartContent(hlsl::DxilFourCC fourCC, LPCWSTR fileName, IDxcBlob **ppResult);
@@ -150,10 +162,14 @@ public:
   }
 
   int  Compile();
+  int  CompileOnServer();
+  void WriteCompileOutputs(IDxcOperationResult *pCompileResult,
+                           IDxcBlob *pDebugBlob, LPCWSTR pDebugBlobName);
   void Recompile(IDxcBlob *pSource, IDxcLibrary *pLibrary,
                  IDxcCompiler *pCompiler, std::vector<LPCWSTR> &args,
                  std::wstring &outputPDBPath, CComPtr<IDxcBlob> &pDebugBlob,
-                 IDxcOperationResult **pCompileResult);
+                 IDxcOperationResult **pCompileResult,
+                 DxcInjectedSourceCache *pSourceCache = nullptr);
   int DumpBinary();
   void Preprocess();
   void GetCompilerVersionInfo(llvm::raw_string_ostream &OS);
@@ -173,12 +189,25 @@ static void WritePartToFile(IDxcBlob *pBlob, hlsl::DxilFourCC CC,
   hlsl::DxilPartIsType pred(CC);
   hlsl::DxilPartIterator it =
       std::find_if(hlsl::begin(pContainer), hlsl::end(pContainer), pred);
-  if (it == hlsl::end(pContainer)) {
+  const char *pData = nullptr;
+  DWORD dataLen = 0;
+  std::vector<char> DebugPart;
+  if (it != hlsl::end(pContainer)) {
+    pData = hlsl::GetDxilPartData(*it);
+    dataLen = (*it)->PartSize;
+  } else if (CC == hlsl::DFCC_ShaderDebugInfoDXIL) {
+    // Write the debug part uncompressed if it was compressed.
+    const hlsl::DxilProgramHeader *pHeader =
+        hlsl::GetDxilDebugProgramHeader(pContainer, DebugPart);
+    if (pHeader) {
+      pData = reinterpret_cast<const char *>(pHeader);
+      dataLen = pHeader->SizeInUint32 * sizeof(uint32_t);
+    }
+  }
+  if (!pData) {
     throw hlsl::Exception(E_FAIL, "Unable to find required part in blob");
   }
 
-  const char *pData = hlsl::GetDxilPartData(*it);
-  DWORD dataLen = (*it)->PartSize;
   StringRefUtf16 WideName(FName);
   CHandle file(CreateFileW(WideName, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
@@ -214,6 +243,12 @@ int DxcContext::ActOnBlob(IDxcBlob *pBlob, IDxcBlob *pDebugBlob, LPCWSTR pDebugB
     WriteBlobToConsole(pBlob);
     return retVal;
   }
+  // With -MF the dependency rule is written with the other outputs.
+  if (m_Opts.DependenciesOnly) {
+    if (m_Opts.DependencyFile.empty())
+      WriteBlobToConsole(pBlob);
+    return retVal;
+  }
 
   // Write the output blob.
   if (!m_Opts.OutputObject.empty()) {
@@ -341,7 +376,11 @@ void DxcContext::UpdatePart(IDxcBlob *pSource, IDxcBlob **ppResult) {
 
   // Update parts based on dxc options
   if (m_Opts.StripDebug) {
-    IFT(pContainerBuilder->RemovePart(hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL));
+    // The debug part is compressed when built with -Qcompress_debug.
+    HRESULT hr = pContainerBuilder->RemovePart(hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL);
+    if (hr == DXC_E_MISSING_PART)
+      hr = pContainerBuilder->RemovePart(hlsl::DxilFourCC::DFCC_CompressedShaderDebugInfoDXIL);
+    IFT(hr);
   }
   if (m_Opts.StripPrivate) {
     IFT(pContainerBuilder->RemovePart(hlsl::DxilFourCC::DFCC_PrivateData));
@@ -349,6 +388,13 @@ void DxcContext::UpdatePart(IDxcBlob *pSource, IDxcBlob **ppResult) {
   if (m_Opts.StripRootSignature) {
     IFT(pContainerBuilder->RemovePart(hlsl::DxilFourCC::DFCC_RootSignature));
   }
+  if (StripReflectionRequired()) {
+    // Reflection lives in its own part, so the program is left untouched.
+    // Reflection kept in the DXIL part with -Qkeep_reflect_in_dxil stays.
+    HRESULT hr = pContainerBuilder->RemovePart(hlsl::DxilFourCC::DFCC_ShaderStatistics);
+    if (hr != DXC_E_MISSING_PART)
+      IFT(hr);
+  }
   if (!m_Opts.PrivateSource.empty()) {
     CComPtr<IDxcBlob> privateBlob;
     IFT(ReadFileIntoPartContent(hlsl::DxilFourCC::DFCC_PrivateData,
@@ -395,8 +441,14 @@ void DxcContext::UpdatePart(IDxcBlob *pSource, IDxcBlob **ppResult) {
 
 bool DxcContext::UpdatePartRequired() {
   return m_Opts.StripDebug || m_Opts.StripPrivate ||
-    m_Opts.StripRootSignature || !m_Opts.PrivateSource.empty() ||
-    !m_Opts.RootSignatureSource.empty();
+    m_Opts.StripRootSignature || StripReflectionRequired() ||
+    !m_Opts.PrivateSource.empty() || !m_Opts.RootSignatureSource.empty();
+}
+
+// Compiles already leave reflection out with -Qstrip_reflect; only a loaded
+// container may still have it.
+bool DxcContext::StripReflectionRequired() {
+  return m_Opts.StripReflection && m_Opts.DumpBin;
 }
 
 // This function reads the file from input file and constructs a blob with fourCC parts
@@ -520,6 +572,47 @@ int DxcContext::VerifyRootSignature() {
   }
 }
 
+// Sources injected into the PDBs of a -batch recompile, shared by every job
+// so that a header embedded in many PDBs is held only once. Sources match on
+// both name and contents, since PDBs built at different times may embed
+// different versions of a file under the same name.
+class DxcInjectedSourceCache {
+private:
+  struct Entry {
+    std::wstring Name;
+    CComPtr<IDxcBlobEncoding> Blob;
+  };
+  std::mutex m_lock;
+  std::unordered_multimap<size_t, Entry> m_entries;
+
+public:
+  // Replaces pBlob with the cached source of the same name and contents,
+  // or adds pBlob to the cache if there is none.
+  void Intern(LPCWSTR pFileName, CComPtr<IDxcBlobEncoding> &pBlob) {
+    llvm::StringRef Contents((const char *)pBlob->GetBufferPointer(),
+                             pBlob->GetBufferSize());
+    size_t NameLen = wcslen(pFileName);
+    size_t Hash = llvm::hash_combine(
+        llvm::hash_combine_range(pFileName, pFileName + NameLen),
+        llvm::hash_value(Contents));
+    std::lock_guard<std::mutex> L(m_lock);
+    auto Range = m_entries.equal_range(Hash);
+    for (auto it = Range.first; it != Range.second; ++it) {
+      IDxcBlobEncoding *pCached = it->second.Blob;
+      if (it->second.Name == pFileName &&
+          llvm::StringRef((const char *)pCached->GetBufferPointer(),
+                          pCached->GetBufferSize()) == Contents) {
+        pBlob = pCached;
+        return;
+      }
+    }
+    Entry E;
+    E.Name = pFileName;
+    E.Blob = pBlob;
+    m_entries.emplace(Hash, std::move(E));
+  }
+};
+
 class DxcIncludeHandlerForInjectedSources : public IDxcIncludeHandler {
 private:
   DXC_MICROCOM_REF_FIELD(m_dwRef)
@@ -565,7 +658,8 @@ void DxcContext::Recompile(IDxcBlob *pSource, IDxcLibrary *pLibrary,
                            IDxcCompiler *pCompiler, std::vector<LPCWSTR> &args,
                            std::wstring &outputPDBPath,
                            CComPtr<IDxcBlob> &pDebugBlob,
-                           IDxcOperationResult **ppCompileResult) {
+                           IDxcOperationResult **ppCompileResult,
+                           DxcInjectedSourceCache *pSourceCache) {
 // Recompile currently only supported on Windows
 #ifdef _WIN32
   CComPtr<IDxcBlob> pTargetBlob;
@@ -696,6 +790,8 @@ void DxcContext::Recompile(IDxcBlob *pSource, IDxcLibrary *pLibrary,
 
     CComPtr<IDxcBlobEncoding> pBlobEncoding;
     IFT(pLibrary->CreateBlobWithEncodingOnMalloc(heapCopy.Detach(), pIMalloc, dataLen, CP_UTF8, &pBlobEncoding));
+    if (pSourceCache)
+      pSourceCache->Intern(pFileName, pBlobEncoding);
     IFT(pIncludeHandler->insertIncludeFile(pFileName, pBlobEncoding, dataLen));
     // Check if this file is the main file or included file
     if (wcscmp(pFileName, pMainFileName) == 0) {
@@ -827,26 +923,45 @@ int DxcContext::Compile() {
   HRESULT status;
   IFT(pCompileResult->GetStatus(&status));
   if (SUCCEEDED(status) || m_Opts.AstDump || m_Opts.OptDump) {
-    CComPtr<IDxcBlob> pProgram;
-    IFT(pCompileResult->GetResult(&pProgram));
-    if (pProgram.p != nullptr) {
-      ActOnBlob(pProgram.p, pDebugBlob, outputPDBPath.c_str());
-
-      // Now write out extra parts
-      CComPtr<IDxcResult> pResult;
-      if (SUCCEEDED(pCompileResult->QueryInterface(&pResult))) {
-        WriteDxcOutputToFile(DXC_OUT_ROOT_SIGNATURE, pResult, m_Opts.DefaultTextCodePage);
-        WriteDxcOutputToFile(DXC_OUT_SHADER_HASH, pResult, m_Opts.DefaultTextCodePage);
-        WriteDxcOutputToFile(DXC_OUT_REFLECTION, pResult, m_Opts.DefaultTextCodePage);
-      }
-    }
+    WriteCompileOutputs(pCompileResult, pDebugBlob, outputPDBPath.c_str());
   }
   return status;
 }
 
+void DxcContext::WriteCompileOutputs(IDxcOperationResult *pCompileResult,
+                                     IDxcBlob *pDebugBlob,
+                                     LPCWSTR pDebugBlobName) {
+  CComPtr<IDxcBlob> pProgram;
+  IFT(pCompileResult->GetResult(&pProgram));
+  if (pProgram.p != nullptr) {
+    ActOnBlob(pProgram.p, pDebugBlob, pDebugBlobName);
+
+    // Now write out extra parts
+    CComPtr<IDxcResult> pResult;
+    if (SUCCEEDED(pCompileResult->QueryInterface(&pResult))) {
+      WriteDxcOutputToFile(DXC_OUT_ROOT_SIGNATURE, pResult, m_Opts.DefaultTextCodePage);
+      WriteDxcOutputToFile(DXC_OUT_SHADER_HASH, pResult, m_Opts.DefaultTextCodePage);
+      WriteDxcOutputToFile(DXC_OUT_REFLECTION, pResult, m_Opts.DefaultTextCodePage);
+      WriteDxcOutputToFile(DXC_OUT_SPIRV_REFLECTION, pResult, m_Opts.DefaultTextCodePage);
+      WriteDxcOutputToFile(DXC_OUT_DEPENDENCIES, pResult, m_Opts.DefaultTextCodePage);
+      WriteDxcOutputToFile(DXC_OUT_SHADER_STATISTICS, pResult, m_Opts.DefaultTextCodePage);
+    }
+  }
+}
+
 int DxcContext::DumpBinary() {
   CComPtr<IDxcBlobEncoding> pSource;
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
+  // Containers are only read, so map them rather than copying them into
+  // memory, unless -Fo is about to overwrite the input.
+  if (m_Opts.OutputObject == m_Opts.InputFile) {
+    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
+  } else {
+    CComPtr<IMalloc> pMalloc;
+    IFT(CoGetMalloc(1, &pMalloc));
+    IFT_Data(hlsl::DxcCreateBlobFromFileMapped(
+                 pMalloc, StringRefUtf16(m_Opts.InputFile), nullptr, &pSource),
+             StringRefUtf16(m_Opts.InputFile));
+  }
   return ActOnBlob(pSource.p);
 }
 
@@ -865,6 +980,8 @@ void DxcContext::Preprocess() {
   // Carry forward the options that control preprocessor
   if (m_Opts.LegacyMacroExpansion)
     args.push_back(L"-flegacy-macro-expansion");
+  if (m_Opts.PchCreate)
+    args.push_back(L"-Yc");
 
   std::vector<std::wstring> includePath;
   for (const llvm::opt::Arg *A : m_Opts.Args.filtered(hlsl::options::OPT_I))
@@ -975,6 +1092,18 @@ HRESULT DxcContext::FindModuleBlob(hlsl::DxilFourCC fourCC, IDxcBlob *pSource, I
   if (hlsl::IsValidDxilContainer((hlsl::DxilContainerHeader*)pSource->GetBufferPointer(), pSource->GetBufferSize())) {
     hlsl::DxilContainerHeader *pDxilContainerHeader = (hlsl::DxilContainerHeader*)pSource->GetBufferPointer();
     pDxilPartHeader = hlsl::GetDxilPartByType(pDxilContainerHeader, fourCC);
+    if (!pDxilPartHeader && fourCC == hlsl::DFCC_ShaderDebugInfoDXIL) {
+      // The debug part may have been written compressed.
+      std::vector<char> DebugPart;
+      const hlsl::DxilProgramHeader *pDxilProgramHeader =
+          hlsl::GetDxilDebugProgramHeader(pDxilContainerHeader, DebugPart);
+      IFTBOOL(pDxilProgramHeader != nullptr, DXC_E_CONTAINER_MISSING_DEBUG);
+      UINT32 pBlobSize;
+      hlsl::GetDxilProgramBitcode(pDxilProgramHeader, &pBitcode, &pBlobSize);
+      CComPtr<IDxcBlobEncoding> pBitcodeBlob;
+      IFR(pLibrary->CreateBlobWithEncodingOnHeapCopy(pBitcode, pBlobSize, CP_ACP, &pBitcodeBlob));
+      return pBitcodeBlob.QueryInterface(ppTargetBlob);
+    }
     IFTBOOL(pDxilPartHeader != nullptr, DXC_E_CONTAINER_MISSING_DEBUG);
   }
   if (fourCC == pDxilPartHeader->PartFourCC) {
@@ -999,6 +1128,15 @@ HRESULT DxcContext::GetDxcDiaTable(IDxcLibrary *pLibrary, IDxcBlob *pTargetBlob,
   CComPtr<IDiaSession> pSession;
   CComPtr<IDiaEnumTables> pEnumTables;
   IFT(CreateInstance(CLSID_DxcDiaDataSource, &pDataSource));
+  if (!m_Opts.SourceStore.empty()) {
+    // Included files may be stored by digest rather than in the PDB.
+    CComPtr<IDxcSourceStoreSupport> pStoreSupport;
+    CComPtr<IDxcSourceStore> pStore;
+    IFT(pDataSource.QueryInterface(&pStoreSupport));
+    IFT(pStoreSupport->CreateDirectorySourceStore(
+        StringRefUtf16(m_Opts.SourceStore), &pStore));
+    IFT(pStoreSupport->SetSourceStore(pStore));
+  }
   IFT(pLibrary->CreateStreamFromBlobReadOnly(pTargetBlob, &pSourceStream));
   IFT(pDataSource->loadDataFromIStream(pSourceStream));
   IFT(pDataSource->openSession(&pSession));
@@ -1179,6 +1317,441 @@ void DxcContext::GetCompilerVersionInfo(llvm::raw_string_ostream &OS) {
 #define VERSION_STRING_SUFFIX ""
 #endif
 
+// Builds the IDxcCompiler3 arguments of a driver compile, which carry the
+// entry point, profile and input as well as the core options.
+static void GetCompiler3Args(const DxcOpts &opts,
+                             std::vector<std::wstring> &argStrings) {
+  CopyArgsToWStrings(opts.Args, CoreOption, argStrings);
+  if (!opts.Args.hasArg(OPT_entrypoint)) {
+    argStrings.emplace_back(L"-E");
+    argStrings.emplace_back(L"main");
+  }
+  if (opts.AstDump)
+    argStrings.emplace_back(L"-ast-dump");
+  // Upgrade profile to 6.0 version from minimum recognized shader model
+  const hlsl::ShaderModel *SM =
+      hlsl::ShaderModel::GetByName(opts.TargetProfile.str().c_str());
+  if (SM->IsValid() && SM->GetMajor() < 6) {
+    argStrings.emplace_back(L"-T");
+    argStrings.emplace_back(Unicode::UTF8ToUTF16StringOrThrow(
+        hlsl::ShaderModel::Get(SM->GetKind(), 6, 0)->GetName()));
+    if (!SM->IsSM51Plus())
+      argStrings.emplace_back(L"-flegacy-resource-reservation");
+  }
+  argStrings.emplace_back(
+      Unicode::UTF8ToUTF16StringOrThrow(opts.InputFile.str().c_str()));
+}
+
+// Returns the PDB of an IDxcCompiler3 result and the path /Fd asks for it
+// to be written to.
+static void GetDebugOutput(DxcOpts &opts, IDxcResult *pResult,
+                           IDxcBlob **ppDebugBlob, std::wstring &outputPDBPath) {
+  if (opts.DebugFile.empty())
+    return;
+  Unicode::UTF8ToUTF16String(opts.DebugFile.str().c_str(), &outputPDBPath);
+  if (pResult->HasOutput(DXC_OUT_PDB)) {
+    CComPtr<IDxcBlobUtf16> pDebugName;
+    IFT(pResult->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(ppDebugBlob), &pDebugName));
+    if (pDebugName && opts.DebugFileIsDirectory())
+      outputPDBPath += pDebugName->GetStringPointer();
+  }
+}
+
+int DxcContext::CompileOnServer() {
+  std::vector<std::wstring> argStrings;
+  GetCompiler3Args(m_Opts, argStrings);
+  std::vector<LPCWSTR> args;
+  for (const std::wstring &a : argStrings)
+    args.push_back(a.c_str());
+
+  CComPtr<IDxcBlobEncoding> pSource;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
+  IFTARG(pSource->GetBufferSize() >= 4);
+  BOOL known = FALSE;
+  UINT32 codePage = 0;
+  IFT(pSource->GetEncoding(&known, &codePage));
+  DxcBuffer source;
+  source.Ptr = pSource->GetBufferPointer();
+  source.Size = pSource->GetBufferSize();
+  source.Encoding = known ? codePage : 0;
+
+  CComPtr<IDxcResult> pResult;
+  dxc::CompileOnServer(m_Opts.ConnectEndpoint, args, source, &pResult);
+
+  // When compiling we don't embed debug info if options don't ask for it.
+  if (!m_Opts.EmbedDebugInfo()) {
+    m_Opts.StripDebug = false;
+  }
+
+  if (!m_Opts.OutputWarningsFile.empty()) {
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    WriteBlobToFile(pErrors, m_Opts.OutputWarningsFile, m_Opts.DefaultTextCodePage);
+  }
+  else {
+    WriteOperationErrorsToConsole(pResult, m_Opts.OutputWarnings);
+  }
+
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  if (SUCCEEDED(status) || m_Opts.AstDump || m_Opts.OptDump) {
+    CComPtr<IDxcBlob> pDebugBlob;
+    std::wstring outputPDBPath;
+    GetDebugOutput(m_Opts, pResult, &pDebugBlob, outputPDBPath);
+    WriteCompileOutputs(pResult, pDebugBlob, outputPDBPath.c_str());
+  }
+  return status;
+}
+
+// Runs the jobs of a -batch manifest. Each line that is not empty or a
+// '#' comment is the dxc command line of one compile. Jobs are compiled
+// concurrently through IDxcCompilerBatch, their outputs are written as they
+// complete, and the status and diagnostics of every job are reported as JSON.
+// Lines with -recompile rebuild a PDB from its embedded sources; these run
+// on a pool of their own and share one cache of the injected sources.
+class DxcBatchContext : public IDxcCompileBatchCallback {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+
+  struct BatchJob {
+    unsigned Line = 0;
+    MainArgs Args;           // Must stay put; Opts refers into it
+    DxcOpts Opts;
+    std::vector<std::wstring> ArgStrings;
+    std::vector<LPCWSTR> ArgPtrs;
+    CComPtr<IDxcBlobEncoding> Input;
+    DxcBuffer Source = {};
+    HRESULT Status = E_ABORT;
+    std::string Diagnostics;
+  };
+
+  DxcOpts &m_Opts;
+  DxcDllSupport &m_dxcSupport;
+  IMalloc *m_pMalloc;
+  std::vector<std::unique_ptr<BatchJob>> m_jobs;
+  std::vector<unsigned> m_submitted; // Batch index to job index
+  std::map<std::string, CComPtr<IDxcBlobEncoding>> m_sources;
+  std::vector<unsigned> m_recompiles; // Job indices of -recompile jobs
+
+  void ReadManifest();
+  void PrepareJob(BatchJob &job, const OptTable *optionTable);
+  void FinishJob(BatchJob &job, IDxcOperationResult *pResult,
+                 IDxcBlob *pDebugBlob, LPCWSTR pDebugBlobName);
+  void RunRecompiles();
+  void WriteReport(llvm::raw_ostream &OS);
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DxcBatchContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
+      : m_dwRef(0), m_Opts(Opts), m_dxcSupport(dxcSupport),
+        m_pMalloc(DxcGetThreadMallocNoRef()) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileBatchCallback>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE OnCompileComplete(UINT32 jobIndex,
+                                              IDxcResult *pResult) override;
+
+  int Run();
+};
+
+static void WriteJsonString(llvm::raw_ostream &OS, llvm::StringRef Str) {
+  OS << '"';
+  for (char c : Str) {
+    if (c == '"' || c == '\\')
+      OS << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      OS << llvm::format("\\u%04x", (unsigned)c);
+    else
+      OS << c;
+  }
+  OS << '"';
+}
+
+static std::string GetExceptionMessage(const ::hlsl::Exception &e) {
+  if (!e.msg.empty())
+    return e.msg;
+  std::string msg;
+  llvm::raw_string_ostream OS(msg);
+  OS << "error code " << llvm::format("0x%08x", (unsigned)e.hr);
+  return OS.str();
+}
+
+void DxcBatchContext::ReadManifest() {
+  CComPtr<IDxcBlobEncoding> pManifest;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.BatchManifest), &pManifest);
+  llvm::StringRef Text((const char *)pManifest->GetBufferPointer(),
+                       pManifest->GetBufferSize());
+  if (Text.startswith("\xEF\xBB\xBF"))
+    Text = Text.drop_front(3);
+
+  llvm::BumpPtrAllocator Alloc;
+  llvm::BumpPtrStringSaver Saver(Alloc);
+  unsigned lineNumber = 0;
+  while (!Text.empty()) {
+    std::pair<llvm::StringRef, llvm::StringRef> Split = Text.split('\n');
+    Text = Split.second;
+    ++lineNumber;
+    llvm::StringRef Line = Split.first.trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+
+    // Lines are split like a command line on this platform, so paths
+    // with backslashes work on Windows.
+    llvm::SmallVector<const char *, 16> Tokens;
+#ifdef _WIN32
+    llvm::cl::TokenizeWindowsCommandLine(Line, Saver, Tokens);
+#else
+    llvm::cl::TokenizeGNUCommandLine(Line, Saver, Tokens);
+#endif
+    std::vector<llvm::StringRef> TokenRefs(Tokens.begin(), Tokens.end());
+    std::unique_ptr<BatchJob> job(new BatchJob());
+    job->Line = lineNumber;
+    job->Args = MainArgs(TokenRefs);
+    m_jobs.emplace_back(std::move(job));
+  }
+}
+
+void DxcBatchContext::PrepareJob(BatchJob &job, const OptTable *optionTable) {
+  std::string errorString;
+  llvm::raw_string_ostream errorStream(errorString);
+  int optResult = ReadDxcOpts(optionTable, DxcFlags, job.Args, job.Opts,
+                              errorStream);
+  job.Diagnostics = errorStream.str();
+  if (optResult != 0) {
+    job.Status = E_INVALIDARG;
+    return;
+  }
+  DxcOpts &opts = job.Opts;
+  if (!opts.BatchManifest.empty() || !opts.Preprocess.empty() ||
+      opts.DumpBin || opts.AstDump || opts.OptDump || opts.ShowHelp) {
+    job.Diagnostics += "Only compiles and recompiles can be run in a batch.";
+    job.Status = E_INVALIDARG;
+    return;
+  }
+#ifndef _WIN32
+  if (opts.RecompileFromBinary) {
+    job.Diagnostics += "Recompile is currently only supported on Windows.";
+    job.Status = E_NOTIMPL;
+    return;
+  }
+#endif // _WIN32
+
+  // Jobs that compile the same file share its source buffer, which the
+  // batch then decodes only once.
+  CComPtr<IDxcBlobEncoding> &pSource = m_sources[opts.InputFile.str()];
+  if (!pSource) {
+    try {
+      ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(opts.InputFile), &pSource);
+    } catch (const ::hlsl::Exception &e) {
+      job.Diagnostics += GetExceptionMessage(e);
+      job.Status = e.hr;
+      return;
+    }
+  }
+  job.Input = pSource;
+  if (opts.RecompileFromBinary) {
+    job.Status = S_OK;
+    return;
+  }
+
+  GetCompiler3Args(opts, job.ArgStrings);
+  for (const std::wstring &a : job.ArgStrings)
+    job.ArgPtrs.push_back(a.c_str());
+  BOOL known = FALSE;
+  UINT32 codePage = 0;
+  IFT(pSource->GetEncoding(&known, &codePage));
+  job.Source.Ptr = pSource->GetBufferPointer();
+  job.Source.Size = pSource->GetBufferSize();
+  job.Source.Encoding = known ? codePage : 0;
+  job.Status = S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE
+DxcBatchContext::OnCompileComplete(UINT32 jobIndex, IDxcResult *pResult) {
+  // Called on a batch thread, which may not have the driver's allocator.
+  DxcThreadMalloc TM(m_pMalloc);
+  if (jobIndex >= m_submitted.size())
+    return E_INVALIDARG;
+  BatchJob &job = *m_jobs[m_submitted[jobIndex]];
+  CComPtr<IDxcBlob> pDebugBlob;
+  std::wstring outputPDBPath;
+  try {
+    GetDebugOutput(job.Opts, pResult, &pDebugBlob, outputPDBPath);
+  } catch (const ::hlsl::Exception &e) {
+    job.Diagnostics += GetExceptionMessage(e);
+    job.Status = e.hr;
+    return S_OK;
+  }
+  FinishJob(job, pResult, pDebugBlob, outputPDBPath.c_str());
+  // Failures belong to the job; the rest of the batch keeps going.
+  return S_OK;
+}
+
+void DxcBatchContext::FinishJob(BatchJob &job, IDxcOperationResult *pResult,
+                                IDxcBlob *pDebugBlob, LPCWSTR pDebugBlobName) {
+  DxcOpts &opts = job.Opts;
+  try {
+    IFT(pResult->GetStatus(&job.Status));
+    CComPtr<IDxcBlobEncoding> pErrorBuffer;
+    IFT(pResult->GetErrorBuffer(&pErrorBuffer));
+    if (pErrorBuffer && opts.OutputWarnings) {
+      job.Diagnostics.append((const char *)pErrorBuffer->GetBufferPointer(),
+                             pErrorBuffer->GetBufferSize());
+    }
+    if (!opts.OutputWarningsFile.empty()) {
+      WriteBlobToFile(pErrorBuffer, opts.OutputWarningsFile,
+                      opts.DefaultTextCodePage);
+    }
+    if (SUCCEEDED(job.Status)) {
+      // When compiling we don't embed debug info if options don't ask for it.
+      if (!opts.EmbedDebugInfo())
+        opts.StripDebug = false;
+      DxcContext context(opts, m_dxcSupport);
+      context.WriteCompileOutputs(pResult, pDebugBlob, pDebugBlobName);
+    }
+  } catch (const ::hlsl::Exception &e) {
+    job.Diagnostics += GetExceptionMessage(e);
+    job.Status = FAILED(job.Status) ? job.Status : e.hr;
+  } catch (std::bad_alloc &) {
+    job.Status = E_OUTOFMEMORY;
+  }
+}
+
+void DxcBatchContext::RunRecompiles() {
+  if (m_recompiles.empty())
+    return;
+  unsigned threadCount = m_Opts.BatchThreads;
+  if (threadCount == 0)
+    threadCount = hlsl::DxcThreadPool::GetDefaultThreadCount();
+  if (threadCount > m_recompiles.size())
+    threadCount = (unsigned)m_recompiles.size();
+
+  CComPtr<IDxcLibrary> pLibrary;
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  DxcInjectedSourceCache SourceCache;
+  std::mutex OutputLock;
+  // Pools inside the DLL do not see this pool's limits, so cap them to an
+  // even share of the threads to keep nested work from oversubscribing.
+  SetDllMaxThreadCount(m_dxcSupport,
+                       hlsl::DxcThreadPool::GetTaskThreadLimit(threadCount));
+  hlsl::DxcThreadPool Pool(threadCount);
+  for (unsigned index : m_recompiles) {
+    Pool.Async([&, index]() {
+      BatchJob &job = *m_jobs[index];
+      DxcThreadMalloc TM(m_pMalloc);
+      CComPtr<IDxcOperationResult> pResult;
+      CComPtr<IDxcBlob> pDebugBlob;
+      std::wstring outputPDBPath;
+      try {
+        CComPtr<IDxcCompiler> pCompiler;
+        IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+        std::vector<std::wstring> argStrings;
+        CopyArgsToWStrings(job.Opts.Args, CoreOption, argStrings);
+        std::vector<LPCWSTR> args;
+        for (const std::wstring &a : argStrings)
+          args.push_back(a.c_str());
+        DxcContext context(job.Opts, m_dxcSupport);
+        context.Recompile(job.Input, pLibrary, pCompiler, args, outputPDBPath,
+                          pDebugBlob, &pResult, &SourceCache);
+      } catch (const ::hlsl::Exception &e) {
+        job.Diagnostics += GetExceptionMessage(e);
+        job.Status = e.hr;
+        return;
+      } catch (std::bad_alloc &) {
+        job.Status = E_OUTOFMEMORY;
+        return;
+      }
+      // Outputs are written one job at a time, as with IDxcCompilerBatch.
+      std::lock_guard<std::mutex> L(OutputLock);
+      FinishJob(job, pResult, pDebugBlob, outputPDBPath.c_str());
+    });
+  }
+  Pool.Wait();
+}
+
+void DxcBatchContext::WriteReport(llvm::raw_ostream &OS) {
+  unsigned failed = 0;
+  OS << "{\n  \"jobs\": [";
+  for (size_t i = 0; i < m_jobs.size(); ++i) {
+    const BatchJob &job = *m_jobs[i];
+    if (FAILED(job.Status))
+      ++failed;
+    OS << (i ? ",\n" : "\n") << "    {\"line\": " << job.Line << ", \"input\": ";
+    WriteJsonString(OS, job.Opts.InputFile);
+    OS << ", \"output\": ";
+    WriteJsonString(OS, job.Opts.OutputObject);
+    OS << ", \"status\": \"" << (SUCCEEDED(job.Status) ? "succeeded" : "failed")
+       << "\", \"hr\": \"" << llvm::format("0x%08x", (unsigned)job.Status)
+       << "\", \"diagnostics\": ";
+    WriteJsonString(OS, job.Diagnostics);
+    OS << '}';
+  }
+  OS << "\n  ],\n  \"succeeded\": " << (unsigned)m_jobs.size() - failed
+     << ",\n  \"failed\": " << failed << "\n}\n";
+}
+
+int DxcBatchContext::Run() {
+  ReadManifest();
+
+  const OptTable *optionTable = getHlslOptTable();
+  std::vector<DxcCompileJob> batchJobs;
+  for (unsigned i = 0; i < m_jobs.size(); ++i) {
+    BatchJob &job = *m_jobs[i];
+    PrepareJob(job, optionTable);
+    if (FAILED(job.Status))
+      continue;
+    if (job.Opts.RecompileFromBinary) {
+      m_recompiles.push_back(i);
+      job.Status = E_ABORT;
+      continue;
+    }
+    DxcCompileJob batchJob;
+    batchJob.pSource = &job.Source;
+    batchJob.pArguments = job.ArgPtrs.data();
+    batchJob.argCount = (UINT32)job.ArgPtrs.size();
+    batchJobs.push_back(batchJob);
+    m_submitted.push_back(i);
+    // Jobs that never report back keep E_ABORT.
+    job.Status = E_ABORT;
+  }
+
+  if (!batchJobs.empty()) {
+    CComPtr<IDxcCompiler3> pCompiler;
+    CComPtr<IDxcCompilerBatch> pBatch;
+    CComPtr<IDxcLibrary> pLibrary;
+    CComPtr<IDxcIncludeHandler> pIncludeHandler;
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    IFTMSG(pCompiler.QueryInterface(&pBatch),
+           "the compiler does not support batch compiles");
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+    IFT(pLibrary->CreateIncludeHandler(&pIncludeHandler));
+    IFT(pBatch->CompileBatch(batchJobs.data(), (UINT32)batchJobs.size(),
+                             pIncludeHandler, m_Opts.BatchThreads, this));
+  }
+  RunRecompiles();
+
+  std::string report;
+  llvm::raw_string_ostream reportStream(report);
+  WriteReport(reportStream);
+  reportStream.flush();
+  if (m_Opts.BatchReport.empty()) {
+    WriteUtf8ToConsoleSizeT(report.data(), report.size());
+  } else {
+    CComPtr<IDxcBlobEncoding> pReport;
+    IFT(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(report.data(), report.size(),
+                                                  CP_UTF8, &pReport));
+    WriteBlobToFile(pReport, m_Opts.BatchReport, DXC_CP_UTF8);
+  }
+
+  for (const std::unique_ptr<BatchJob> &job : m_jobs) {
+    if (FAILED(job->Status))
+      return 1;
+  }
+  return 0;
+}
+
 #ifdef _WIN32
 int dxc::main(int argc, const wchar_t **argv_) {
 #else
@@ -1257,6 +1830,19 @@ int dxc::main(int argc, const char **argv_) {
       pStage = "Dumping existing binary";
       retVal = context.DumpBinary();
     }
+    else if (!dxcOpts.ServerEndpoint.empty()) {
+      pStage = "Compile server";
+      RunCompileServer(dxcOpts.ServerEndpoint, dxcSupport);
+    }
+    else if (!dxcOpts.ConnectEndpoint.empty()) {
+      pStage = "Compilation on server";
+      retVal = context.CompileOnServer();
+    }
+    else if (!dxcOpts.BatchManifest.empty()) {
+      pStage = "Batch compilation";
+      CComPtr<DxcBatchContext> pBatch = new DxcBatchContext(dxcOpts, dxcSupport);
+      retVal = pBatch->Run();
+    }
     else {
       pStage = "Compilation";
       retVal = context.Compile();
@@ -0,0 +1,627 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcserver.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the compile server and client used by dxc -server and -connect.//
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "dxcserver.h"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sddl.h>
+#else
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace dxc;
+
+// Messages are sequences of native-endian UINT32 values and size-prefixed
+// byte strings; both ends always run on the same machine.
+//
+// Request:  'DXCQ', version, directory, argCount, { arg }, sourceEncoding,
+//           source
+// Response: 'DXCR', status, primaryKind, outputCount,
+//           { kind, codePage, name, data }
+//
+// The directory is the client's working directory, which relative paths in
+// the compile are resolved against. Text outputs carry the code page of their
+// data and binary outputs carry 0. A connection may carry any number of
+// requests, each answered in turn.
+//
+// Only the user running the server can connect, but a request is still
+// checked against the limits below before the server allocates for it.
+static const UINT32 kRequestMagic = 0x51435844;  // 'DXCQ'
+static const UINT32 kResponseMagic = 0x52435844; // 'DXCR'
+static const UINT32 kProtocolVersion = 1;
+static const UINT32 kMaxMessageString = 0x7fffffff;
+static const UINT32 kMaxRequestArgs = 4096;
+static const UINT32 kMaxRequestString = 64 * 1024;      // directory and args
+static const UINT32 kMaxRequestSource = 256 * 1024 * 1024;
+
+namespace {
+
+// One end of a connection between the compile server and a client.
+class DxcServerConnection {
+public:
+#ifdef _WIN32
+  typedef HANDLE NativeHandle;
+#else
+  typedef int NativeHandle;
+#endif
+
+  DxcServerConnection(NativeHandle Handle, bool IsServer)
+      : m_handle(Handle), m_isServer(IsServer) {}
+  ~DxcServerConnection();
+  DxcServerConnection(const DxcServerConnection &) = delete;
+  DxcServerConnection &operator=(const DxcServerConnection &) = delete;
+
+  // Returns false if the peer closed the connection before any byte was read;
+  // a connection closed part way through a read throws.
+  bool Read(void *pData, size_t size);
+  void Write(const void *pData, size_t size);
+
+  bool ReadU32(UINT32 &value) { return Read(&value, sizeof(value)); }
+  // Throws if the string is longer than maxSize.
+  void ReadString(std::string &value, UINT32 maxSize = kMaxMessageString);
+
+private:
+  NativeHandle m_handle;
+  bool m_isServer;
+};
+
+DxcServerConnection::~DxcServerConnection() {
+#ifdef _WIN32
+  if (m_isServer) {
+    FlushFileBuffers(m_handle);
+    DisconnectNamedPipe(m_handle);
+  }
+  CloseHandle(m_handle);
+#else
+  close(m_handle);
+#endif
+}
+
+bool DxcServerConnection::Read(void *pData, size_t size) {
+  char *pBytes = (char *)pData;
+  size_t total = 0;
+  while (total < size) {
+#ifdef _WIN32
+    DWORD chunk = (DWORD)std::min<size_t>(size - total, 0x40000000);
+    DWORD received = 0;
+    if (!ReadFile(m_handle, pBytes + total, chunk, &received, nullptr)) {
+      DWORD err = GetLastError();
+      if (err == ERROR_BROKEN_PIPE && total == 0)
+        return false;
+      IFT(HRESULT_FROM_WIN32(err));
+    }
+#else
+    ssize_t received = recv(m_handle, pBytes + total, size - total, 0);
+    if (received < 0) {
+      if (errno == EINTR)
+        continue;
+      IFT(HRESULT_FROM_WIN32(errno));
+    }
+#endif
+    if (received == 0) {
+      if (total == 0)
+        return false;
+      IFTMSG(E_FAIL, "connection closed in the middle of a message");
+    }
+    total += received;
+  }
+  return true;
+}
+
+void DxcServerConnection::Write(const void *pData, size_t size) {
+  const char *pBytes = (const char *)pData;
+  size_t total = 0;
+  while (total < size) {
+#ifdef _WIN32
+    DWORD chunk = (DWORD)std::min<size_t>(size - total, 0x40000000);
+    DWORD sent = 0;
+    if (!WriteFile(m_handle, pBytes + total, chunk, &sent, nullptr))
+      IFT(HRESULT_FROM_WIN32(GetLastError()));
+#else
+#ifdef MSG_NOSIGNAL
+    // A client that goes away must not take the server down with SIGPIPE.
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    ssize_t sent = send(m_handle, pBytes + total, size - total, flags);
+    if (sent < 0) {
+      if (errno == EINTR)
+        continue;
+      IFT(HRESULT_FROM_WIN32(errno));
+    }
+#endif
+    total += sent;
+  }
+}
+
+void DxcServerConnection::ReadString(std::string &value, UINT32 maxSize) {
+  UINT32 size;
+  IFTBOOLMSG(ReadU32(size), E_FAIL, "connection closed in the middle of a message");
+  IFTBOOLMSG(size <= maxSize, E_INVALIDARG, "message string is too large");
+  // Grown as the data arrives, so a size the peer never sends costs nothing.
+  const size_t kChunk = 1 << 20;
+  value.clear();
+  while (value.size() < size) {
+    size_t offset = value.size();
+    size_t chunk = std::min<size_t>(size - offset, kChunk);
+    value.resize(offset + chunk);
+    IFTBOOLMSG(Read(&value[offset], chunk), E_FAIL,
+               "connection closed in the middle of a message");
+  }
+}
+
+static void AppendU32(std::string &message, UINT32 value) {
+  message.append((const char *)&value, sizeof(value));
+}
+
+static void AppendString(std::string &message, const void *pData, size_t size) {
+  IFTBOOLMSG(size <= kMaxMessageString, E_INVALIDARG, "message string is too large");
+  AppendU32(message, (UINT32)size);
+  message.append((const char *)pData, size);
+}
+
+#ifdef _WIN32
+static std::wstring GetPipeName(llvm::StringRef Endpoint) {
+  std::wstring name;
+  if (!Endpoint.startswith("\\\\.\\pipe\\"))
+    name = L"\\\\.\\pipe\\";
+  name += Unicode::UTF8ToUTF16StringOrThrow(Endpoint.str().c_str());
+  return name;
+}
+
+// Security descriptor that gives the current user, and no one else, access
+// to the server's pipe.
+class DxcPipeSecurity {
+public:
+  DxcPipeSecurity() {
+    HANDLE hToken;
+    IFTBOOL(OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken),
+            HRESULT_FROM_WIN32(GetLastError()));
+    DWORD size = 0;
+    GetTokenInformation(hToken, TokenUser, nullptr, 0, &size);
+    std::vector<char> user(size ? size : 1);
+    BOOL gotUser = GetTokenInformation(hToken, TokenUser, user.data(), size,
+                                       &size);
+    HRESULT hr = gotUser ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+    CloseHandle(hToken);
+    IFT(hr);
+    LPWSTR pSid;
+    IFTBOOL(ConvertSidToStringSidW(((TOKEN_USER *)user.data())->User.Sid,
+                                   &pSid),
+            HRESULT_FROM_WIN32(GetLastError()));
+    std::wstring sddl = std::wstring(L"D:P(A;;GA;;;") + pSid + L")";
+    LocalFree(pSid);
+    IFTBOOL(ConvertStringSecurityDescriptorToSecurityDescriptorW(
+                sddl.c_str(), SDDL_REVISION_1, &m_pDescriptor, nullptr),
+            HRESULT_FROM_WIN32(GetLastError()));
+    m_attributes.nLength = sizeof(m_attributes);
+    m_attributes.lpSecurityDescriptor = m_pDescriptor;
+    m_attributes.bInheritHandle = FALSE;
+  }
+  ~DxcPipeSecurity() { LocalFree(m_pDescriptor); }
+  DxcPipeSecurity(const DxcPipeSecurity &) = delete;
+  DxcPipeSecurity &operator=(const DxcPipeSecurity &) = delete;
+
+  SECURITY_ATTRIBUTES *GetAttributes() { return &m_attributes; }
+
+private:
+  PSECURITY_DESCRIPTOR m_pDescriptor = nullptr;
+  SECURITY_ATTRIBUTES m_attributes;
+};
+#else
+static sockaddr_un GetSocketAddress(llvm::StringRef Endpoint) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  IFTBOOLMSG(Endpoint.size() < sizeof(address.sun_path), E_INVALIDARG,
+             "server socket path is too long");
+  memcpy(address.sun_path, Endpoint.data(), Endpoint.size());
+  return address;
+}
+#endif
+
+// Forwards to the default include handler and stamps each file with its size
+// and last write time, so the server's include cache notices edits.
+class DxcStampedIncludeHandler : public IDxcIncludeHandler,
+                                 public IDxcIncludeStamp {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeHandler> m_pInner;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcStampedIncludeHandler)
+
+  void Init(IDxcIncludeHandler *pInner) { m_pInner = pInner; }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler, IDxcIncludeStamp>(
+        this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    return m_pInner->LoadSource(pFilename, ppIncludeSource);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetSourceStamp(LPCWSTR pFilename,
+                                           UINT64 *pStamp) override {
+    if (pFilename == nullptr || pStamp == nullptr)
+      return E_INVALIDARG;
+    try {
+#ifdef _WIN32
+      struct _stat64 st;
+      if (_wstat64(pFilename, &st) != 0)
+        return S_FALSE;
+#else
+      std::string name;
+      IFTBOOL(Unicode::UTF16ToUTF8String(pFilename, &name), E_INVALIDARG);
+      struct stat st;
+      if (stat(name.c_str(), &st) != 0)
+        return S_FALSE;
+#endif
+      *pStamp = ((UINT64)st.st_mtime << 32) ^ (UINT64)st.st_size;
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+static bool IsAbsolutePath(LPCWSTR pPath) {
+#ifdef _WIN32
+  return pPath[0] == L'\\' || pPath[0] == L'/' ||
+         (pPath[0] && pPath[1] == L':');
+#else
+  return pPath[0] == L'/';
+#endif
+}
+
+// Include handler for the compiles of one connection. Relative names are
+// resolved against the client's working directory, so the cache shared by
+// all clients is always keyed on absolute paths.
+class DxcServerIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeHandler> m_pFileHandler;
+  CComPtr<IDxcIncludeCache> m_pCache;
+  std::wstring m_directory;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcServerIncludeHandler)
+
+  void Init(IDxcIncludeHandler *pFileHandler, IDxcIncludeCache *pCache) {
+    m_pFileHandler = pFileHandler;
+    m_pCache = pCache;
+  }
+  void SetDirectory(const std::wstring &directory) { m_directory = directory; }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    if (pFilename == nullptr || ppIncludeSource == nullptr)
+      return E_INVALIDARG;
+    try {
+      std::wstring path;
+      if (!IsAbsolutePath(pFilename) && !m_directory.empty()) {
+        path = m_directory;
+        if (path.back() != L'/' && path.back() != L'\\')
+          path += L'/';
+      }
+      path += pFilename;
+      if (m_pCache)
+        return m_pCache->LoadSource(m_pFileHandler, path.c_str(), ppIncludeSource);
+      return m_pFileHandler->LoadSource(path.c_str(), ppIncludeSource);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+class DxcCompileServer {
+public:
+  explicit DxcCompileServer(DxcDllSupport &DxcSupport)
+      : m_dxcSupport(DxcSupport), m_pMalloc(DxcGetThreadMallocNoRef()) {}
+
+  void Init();
+  void Serve(DxcServerConnection::NativeHandle Handle);
+
+private:
+  DxcDllSupport &m_dxcSupport;
+  IMalloc *m_pMalloc;
+  CComPtr<IDxcCompiler3> m_pCompiler;
+  CComPtr<IDxcLibrary> m_pLibrary;
+  CComPtr<IDxcIncludeCache> m_pIncludeCache;
+
+  void HandleRequest(DxcServerConnection &Connection,
+                     DxcServerIncludeHandler *pIncludeHandler);
+};
+
+void DxcCompileServer::Init() {
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &m_pCompiler));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &m_pLibrary));
+
+  // Headers loaded by any client are reused by all of them.
+  CComPtr<IDxcCompilerIncludeCache> pCacheSupport;
+  if (SUCCEEDED(m_pCompiler.QueryInterface(&pCacheSupport)))
+    IFT(pCacheSupport->CreateIncludeCache(&m_pIncludeCache));
+
+  // Compile once up front so the first client does not pay for loading the
+  // compiler and validator.
+  static const char kWarmupSource[] = "float4 main() : SV_Target { return 0; }";
+  LPCWSTR warmupArgs[] = { L"-T", L"ps_6_0", L"-E", L"main" };
+  DxcBuffer warmup = { kWarmupSource, sizeof(kWarmupSource) - 1, CP_UTF8 };
+  CComPtr<IDxcResult> pResult;
+  IFT(m_pCompiler->Compile(&warmup, warmupArgs, _countof(warmupArgs), nullptr,
+                           IID_PPV_ARGS(&pResult)));
+}
+
+void DxcCompileServer::Serve(DxcServerConnection::NativeHandle Handle) {
+  DxcThreadMalloc TM(m_pMalloc);
+  DxcServerConnection Connection(Handle, true);
+  try {
+    CComPtr<IDxcIncludeHandler> pDefaultHandler;
+    IFT(m_pLibrary->CreateIncludeHandler(&pDefaultHandler));
+    CComPtr<DxcStampedIncludeHandler> pFileHandler =
+        DxcStampedIncludeHandler::Alloc(m_pMalloc);
+    IFTOOM(pFileHandler.p);
+    pFileHandler->Init(pDefaultHandler);
+    CComPtr<DxcServerIncludeHandler> pIncludeHandler =
+        DxcServerIncludeHandler::Alloc(m_pMalloc);
+    IFTOOM(pIncludeHandler.p);
+    pIncludeHandler->Init(pFileHandler, m_pIncludeCache);
+
+    UINT32 magic;
+    while (Connection.ReadU32(magic)) {
+      IFTBOOLMSG(magic == kRequestMagic, E_INVALIDARG, "invalid compile request");
+      HandleRequest(Connection, pIncludeHandler);
+    }
+  } catch (...) {
+    // The connection is dropped; the client reports the failure.
+  }
+}
+
+void DxcCompileServer::HandleRequest(DxcServerConnection &Connection,
+                                     DxcServerIncludeHandler *pIncludeHandler) {
+  const char *kTruncated = "connection closed in the middle of a message";
+  UINT32 version, argCount, encoding;
+  IFTBOOLMSG(Connection.ReadU32(version), E_FAIL, kTruncated);
+  IFTBOOLMSG(version == kProtocolVersion, E_INVALIDARG,
+             "unsupported compile request version");
+  std::string text;
+  std::wstring directory;
+  Connection.ReadString(text, kMaxRequestString);
+  IFTBOOL(Unicode::UTF8ToUTF16String(text.c_str(), &directory), E_INVALIDARG);
+  pIncludeHandler->SetDirectory(directory);
+  IFTBOOLMSG(Connection.ReadU32(argCount), E_FAIL, kTruncated);
+  IFTBOOLMSG(argCount <= kMaxRequestArgs, E_INVALIDARG,
+             "compile request has too many arguments");
+  std::vector<std::wstring> argStrings(argCount);
+  for (std::wstring &arg : argStrings) {
+    Connection.ReadString(text, kMaxRequestString);
+    IFTBOOL(Unicode::UTF8ToUTF16String(text.c_str(), &arg), E_INVALIDARG);
+  }
+  std::vector<LPCWSTR> args;
+  for (const std::wstring &arg : argStrings)
+    args.push_back(arg.c_str());
+  IFTBOOLMSG(Connection.ReadU32(encoding), E_FAIL, kTruncated);
+  std::string source;
+  Connection.ReadString(source, kMaxRequestSource);
+
+  DxcBuffer buffer = { source.data(), source.size(), encoding };
+  CComPtr<IDxcResult> pResult;
+  HRESULT hr = m_pCompiler->Compile(&buffer, args.data(), (UINT32)args.size(),
+                                    pIncludeHandler, IID_PPV_ARGS(&pResult));
+  if (FAILED(hr)) {
+    // Report the failure as the status of the compile.
+    pResult.Release();
+    IFT(DxcResult::Create(hr, DXC_OUT_NONE, nullptr, 0, &pResult));
+  }
+
+  HRESULT status;
+  IFT(pResult->GetStatus(&status));
+  std::string response;
+  AppendU32(response, kResponseMagic);
+  AppendU32(response, (UINT32)status);
+  AppendU32(response, (UINT32)pResult->PrimaryOutput());
+  UINT32 outputCount = pResult->GetNumOutputs();
+  AppendU32(response, outputCount);
+  for (UINT32 i = 0; i < outputCount; ++i) {
+    DXC_OUT_KIND kind = pResult->GetOutputByIndex(i);
+    CComPtr<IDxcBlob> pData;
+    CComPtr<IDxcBlobUtf16> pName;
+    IFT(pResult->GetOutput(kind, IID_PPV_ARGS(&pData), &pName));
+    UINT32 codePage = 0;
+    CComPtr<IDxcBlobEncoding> pEncoding;
+    BOOL known = FALSE;
+    if (DxcGetOutputType(kind) == DxcOutputType_Text &&
+        SUCCEEDED(pData.QueryInterface(&pEncoding)) &&
+        SUCCEEDED(pEncoding->GetEncoding(&known, &codePage)) && !known)
+      codePage = 0;
+    std::string name;
+    if (pName)
+      IFTBOOL(Unicode::UTF16ToUTF8String(pName->GetStringPointer(), &name),
+              E_INVALIDARG);
+    AppendU32(response, (UINT32)kind);
+    AppendU32(response, codePage);
+    AppendString(response, name.data(), name.size());
+    AppendString(response, pData->GetBufferPointer(), pData->GetBufferSize());
+  }
+  Connection.Write(response.data(), response.size());
+}
+
+} // namespace
+
+void dxc::RunCompileServer(llvm::StringRef Endpoint, DxcDllSupport &DxcSupport) {
+  DxcCompileServer Server(DxcSupport);
+  Server.Init();
+
+  // Each connection gets its own thread; compiles share the compiler object.
+#ifdef _WIN32
+  std::wstring pipeName = GetPipeName(Endpoint);
+  DxcPipeSecurity security;
+  // The first instance must be new, so the server never shares a name with
+  // a pipe another process created.
+  DWORD firstInstance = FILE_FLAG_FIRST_PIPE_INSTANCE;
+  for (;;) {
+    HANDLE hPipe = CreateNamedPipeW(
+        pipeName.c_str(), PIPE_ACCESS_DUPLEX | firstInstance,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+            PIPE_REJECT_REMOTE_CLIENTS,
+        PIPE_UNLIMITED_INSTANCES, 1 << 16, 1 << 16, 0,
+        security.GetAttributes());
+    if (hPipe == INVALID_HANDLE_VALUE)
+      IFT_Data(HRESULT_FROM_WIN32(GetLastError()), pipeName.c_str());
+    firstInstance = 0;
+    if (!ConnectNamedPipe(hPipe, nullptr) &&
+        GetLastError() != ERROR_PIPE_CONNECTED) {
+      CloseHandle(hPipe);
+      continue;
+    }
+    std::thread(&DxcCompileServer::Serve, &Server, hPipe).detach();
+  }
+#else
+  sockaddr_un address = GetSocketAddress(Endpoint);
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    IFT(HRESULT_FROM_WIN32(errno));
+  // Replace the socket left behind by a server that did not shut down, but
+  // nothing else.
+  struct stat st;
+  if (lstat(address.sun_path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode) || st.st_uid != geteuid()) {
+      close(listener);
+      IFTMSG(E_INVALIDARG, Endpoint.str() +
+                               " exists and is not a socket of this user");
+    }
+    unlink(address.sun_path);
+  }
+  // Only this user may connect. Some systems ignore the mode of a socket;
+  // the endpoint should then be in a directory only this user can enter.
+  mode_t priorMask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+  int bound = bind(listener, (const sockaddr *)&address, sizeof(address));
+  umask(priorMask);
+  if (bound != 0 || listen(listener, SOMAXCONN) != 0) {
+    HRESULT hr = HRESULT_FROM_WIN32(errno);
+    close(listener);
+    IFTMSG(hr, "unable to listen on " + Endpoint.str());
+  }
+  for (;;) {
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    std::thread(&DxcCompileServer::Serve, &Server, client).detach();
+  }
+#endif
+}
+
+void dxc::CompileOnServer(llvm::StringRef Endpoint,
+                          llvm::ArrayRef<LPCWSTR> Args,
+                          const DxcBuffer &Source, IDxcResult **ppResult) {
+#ifdef _WIN32
+  std::wstring pipeName = GetPipeName(Endpoint);
+  HANDLE hPipe;
+  for (;;) {
+    hPipe = CreateFileW(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                        nullptr, OPEN_EXISTING, 0, nullptr);
+    if (hPipe != INVALID_HANDLE_VALUE)
+      break;
+    // Every instance is busy; wait for the server to create another.
+    if (GetLastError() != ERROR_PIPE_BUSY ||
+        !WaitNamedPipeW(pipeName.c_str(), NMPWAIT_WAIT_FOREVER))
+      IFT_Data(HRESULT_FROM_WIN32(GetLastError()), pipeName.c_str());
+  }
+  DxcServerConnection Connection(hPipe, false);
+#else
+  sockaddr_un address = GetSocketAddress(Endpoint);
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0)
+    IFT(HRESULT_FROM_WIN32(errno));
+  DxcServerConnection Connection(server, false);
+  if (connect(server, (const sockaddr *)&address, sizeof(address)) != 0)
+    IFTMSG(HRESULT_FROM_WIN32(errno), "unable to connect to " + Endpoint.str());
+#endif
+
+  std::string request;
+  AppendU32(request, kRequestMagic);
+  AppendU32(request, kProtocolVersion);
+  std::string text;
+#ifdef _WIN32
+  wchar_t directory[MAX_PATH];
+  DWORD length = GetCurrentDirectoryW(_countof(directory), directory);
+  IFTBOOL(length > 0 && length < _countof(directory),
+          HRESULT_FROM_WIN32(GetLastError()));
+  IFTBOOL(Unicode::UTF16ToUTF8String(directory, &text), E_INVALIDARG);
+#else
+  char directory[PATH_MAX];
+  if (getcwd(directory, sizeof(directory)) == nullptr)
+    IFT(HRESULT_FROM_WIN32(errno));
+  text = directory;
+#endif
+  AppendString(request, text.data(), text.size());
+  AppendU32(request, (UINT32)Args.size());
+  for (LPCWSTR arg : Args) {
+    IFTBOOL(Unicode::UTF16ToUTF8String(arg, &text), E_INVALIDARG);
+    AppendString(request, text.data(), text.size());
+  }
+  AppendU32(request, Source.Encoding);
+  AppendString(request, Source.Ptr, Source.Size);
+  Connection.Write(request.data(), request.size());
+
+  const char *kTruncated = "compile server closed the connection";
+  UINT32 magic, status, primaryKind, outputCount;
+  IFTBOOLMSG(Connection.ReadU32(magic), E_FAIL, kTruncated);
+  IFTBOOLMSG(magic == kResponseMagic, E_FAIL, "invalid compile server response");
+  IFTBOOLMSG(Connection.ReadU32(status), E_FAIL, kTruncated);
+  IFTBOOLMSG(Connection.ReadU32(primaryKind), E_FAIL, kTruncated);
+  IFTBOOLMSG(Connection.ReadU32(outputCount), E_FAIL, kTruncated);
+
+  std::vector<DxcOutputObject> outputs(outputCount);
+  std::string name, data;
+  for (DxcOutputObject &output : outputs) {
+    UINT32 kind, codePage;
+    IFTBOOLMSG(Connection.ReadU32(kind), E_FAIL, kTruncated);
+    IFTBOOLMSG(Connection.ReadU32(codePage), E_FAIL, kTruncated);
+    Connection.ReadString(name);
+    Connection.ReadString(data);
+    if (codePage) {
+      CComPtr<IDxcBlobEncoding> pText;
+      IFT(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(data.data(), data.size(),
+                                                    codePage, &pText));
+      output = DxcOutputObject::DataOutput((DXC_OUT_KIND)kind, 0, pText,
+                                           llvm::StringRef(name));
+    } else {
+      output = DxcOutputObject::DataOutput((DXC_OUT_KIND)kind, data.data(),
+                                           data.size(), llvm::StringRef(name));
+    }
+  }
+  IFT(DxcResult::Create((HRESULT)status, (DXC_OUT_KIND)primaryKind, outputs,
+                        ppResult));
+}
@@ -0,0 +1,32 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcserver.h                                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the compile server and client used by dxc -server and -connect.  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace dxc {
+class DxcDllSupport;
+
+// Accepts connections on Endpoint, a named pipe on Windows and a Unix domain
+// socket path elsewhere, and compiles each request with one IDxcCompiler3 and
+// one include cache shared by every client. Runs until the process is
+// terminated.
+void RunCompileServer(llvm::StringRef Endpoint, DxcDllSupport &DxcSupport);
+
+// Sends one compile to the server on Endpoint. The arguments and source are
+// those of IDxcCompiler3::Compile, and the result carries every output the
+// server produced, with the same kinds and names.
+void CompileOnServer(llvm::StringRef Endpoint, llvm::ArrayRef<LPCWSTR> Args,
+                     const DxcBuffer &Source, IDxcResult **ppResult);
+}
@@ -38,19 +38,54 @@ DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompiler2)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcVersionInfo)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcVersionInfo2)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcValidator)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcModuleValidator)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcValidationResult)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcStructuredValidator)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcValidationCache)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerBuilder)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerPackage)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerPackageBuilder)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerInPlaceBuilder)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizerPass)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer2)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizerSession)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizerSession2)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcRewriter)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcRewriter2)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcRewriter3)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcIntelliSense)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLinker)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcBlobUtf16)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcBlobUtf8)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerArgs)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcUtils)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchive)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchiveUtils)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcResult)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompiler3)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompileCache)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompileCacheStore)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompileBatchCallback)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerBatch)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerMultiEntry)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerPermutations)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcIncludeStamp)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcIncludeCache)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerIncludeCache)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCancellationToken)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerCancellation)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcTask)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcTaskExecutor)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcAsyncCompileCallback)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcAsyncResult)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerAsync)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcTaskScheduling)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcSourceStore)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcSourceStoreSupport)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilerContextPool)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLinkerIncremental)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcPipelineLinker)
 
 HRESULT CreateDxcCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcDiaDataSource(_In_ REFIID riid, _Out_ LPVOID *ppv);
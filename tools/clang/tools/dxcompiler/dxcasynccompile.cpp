@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcasynccompile.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the asynchronous compile support used by DxcCompiler.          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxcasynccompile.h"
+#include "dxccancellation.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include "dxc/Support/ErrorCodes.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/Support/dxcapi.impl.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace hlsl;
+
+namespace dxcutil {
+
+namespace {
+
+const UINT32 kWaitInfinite = 0xFFFFFFFF;
+
+// A compile in flight. It owns copies of everything the compile reads, so
+// the caller's buffers may go away as soon as CompileAsync returns.
+class DxcAsyncCompile : public IDxcAsyncResult {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::mutex m_lock;                      // guards the completion state below
+  std::condition_variable m_completed;
+  bool m_bComplete = false;
+  HRESULT m_hr = S_OK;
+  CComPtr<IDxcResult> m_pResult;
+  std::vector<CComPtr<IDxcAsyncCompileCallback>> m_callbacks;
+
+  CComPtr<IDxcCancellationToken> m_pToken;
+  std::vector<char> m_source;
+  UINT32 m_encoding = 0;
+  std::vector<std::wstring> m_arguments;
+  CComPtr<IDxcIncludeHandler> m_pIncludeHandler;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcAsyncCompile)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcAsyncResult>(this, iid, ppvObject);
+  }
+
+  void Init(const DxcBuffer *pSource, LPCWSTR *pArguments, UINT32 argCount,
+            IDxcIncludeHandler *pIncludeHandler) {
+    IFT(CreateCancellationToken(m_pMalloc, &m_pToken));
+    const char *pBytes = (const char *)pSource->Ptr;
+    m_source.assign(pBytes, pBytes + pSource->Size);
+    m_encoding = pSource->Encoding;
+    m_arguments.assign(pArguments, pArguments + argCount);
+    m_pIncludeHandler = pIncludeHandler;
+  }
+
+  // Compiles with pCompiler on the calling thread and completes.
+  void Run(IDxcCompilerCancellation *pCompiler) {
+    DxcThreadMalloc TM(m_pMalloc);
+    CComPtr<IDxcResult> pResult;
+    HRESULT hr;
+    try {
+      std::vector<LPCWSTR> Args;
+      for (const std::wstring &Arg : m_arguments)
+        Args.push_back(Arg.c_str());
+      DxcBuffer Source = { m_source.data(), m_source.size(), m_encoding };
+      hr = pCompiler->CompileCancellable(&Source, Args.data(),
+                                         (UINT32)Args.size(), m_pIncludeHandler,
+                                         m_pToken, IID_PPV_ARGS(&pResult));
+    } catch (...) {
+      hr = E_OUTOFMEMORY;
+    }
+    Complete(hr, pResult);
+  }
+
+  // Completes without compiling, with hr as the status.
+  void Abandon(HRESULT hr) {
+    DxcThreadMalloc TM(m_pMalloc);
+    Complete(hr, nullptr);
+  }
+
+  BOOL STDMETHODCALLTYPE IsComplete() override {
+    std::lock_guard<std::mutex> Lock(m_lock);
+    return m_bComplete;
+  }
+
+  HRESULT STDMETHODCALLTYPE Wait(UINT32 timeoutMs) override {
+    std::unique_lock<std::mutex> Lock(m_lock);
+    if (timeoutMs == kWaitInfinite) {
+      m_completed.wait(Lock, [this]() { return m_bComplete; });
+      return S_OK;
+    }
+    return m_completed.wait_for(Lock, std::chrono::milliseconds(timeoutMs),
+                                [this]() { return m_bComplete; })
+               ? S_OK
+               : S_FALSE;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetResult(REFIID riid, LPVOID *ppResult) override {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    Wait(kWaitInfinite);
+    std::lock_guard<std::mutex> Lock(m_lock);
+    if (!m_pResult)
+      return m_hr;
+    return m_pResult->QueryInterface(riid, ppResult);
+  }
+
+  HRESULT STDMETHODCALLTYPE AddCompletionCallback(
+      IDxcAsyncCompileCallback *pCallback) override {
+    if (pCallback == nullptr)
+      return E_INVALIDARG;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      {
+        std::lock_guard<std::mutex> Lock(m_lock);
+        if (!m_bComplete) {
+          m_callbacks.emplace_back(pCallback);
+          return S_OK;
+        }
+      }
+      pCallback->OnCompileComplete(this);
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT STDMETHODCALLTYPE Cancel() override {
+    return m_pToken->Cancel();
+  }
+
+private:
+  void Complete(HRESULT hr, IDxcResult *pResult) {
+    CComPtr<IDxcResult> pFinal = pResult;
+    if (FAILED(hr) || !pFinal) {
+      // Report the failure as the status of the compile.
+      pFinal.Release();
+      if (SUCCEEDED(hr))
+        hr = E_FAIL;
+      HRESULT hrCreate =
+        DxcResult::Create(hr, DXC_OUT_NONE, nullptr, 0, &pFinal);
+      if (FAILED(hrCreate))
+        hr = hrCreate;
+    }
+
+    // Callbacks run without the lock, so they may call back into this object.
+    std::vector<CComPtr<IDxcAsyncCompileCallback>> Callbacks;
+    {
+      std::lock_guard<std::mutex> Lock(m_lock);
+      m_hr = hr;
+      m_pResult = pFinal;
+      m_bComplete = true;
+      Callbacks.swap(m_callbacks);
+    }
+    m_completed.notify_all();
+    for (IDxcAsyncCompileCallback *pCallback : Callbacks)
+      pCallback->OnCompileComplete(this);
+  }
+};
+
+// Runs a compile on a host executor. The task keeps the compiler alive until
+// it has run, and cancels the compile if the executor drops it instead.
+class DxcAsyncCompileTask : public IDxcTask {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<DxcAsyncCompile> m_pAsync;
+  CComPtr<IDxcCompilerCancellation> m_pCompiler;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcAsyncCompileTask)
+
+  ~DxcAsyncCompileTask() {
+    if (m_pAsync)
+      m_pAsync->Abandon(DXC_E_COMPILE_CANCELLED);
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcTask>(this, iid, ppvObject);
+  }
+
+  void Init(DxcAsyncCompile *pAsync, IDxcCompilerCancellation *pCompiler) {
+    m_pAsync = pAsync;
+    m_pCompiler = pCompiler;
+  }
+
+  // Tasks that were never scheduled complete nothing when released.
+  void Disarm() { m_pAsync.Release(); }
+
+  void STDMETHODCALLTYPE Run() override {
+    CComPtr<DxcAsyncCompile> pAsync;
+    pAsync.Attach(m_pAsync.Detach());
+    if (!pAsync)
+      return;
+    pAsync->Run(m_pCompiler);
+    m_pCompiler.Release();
+  }
+};
+
+} // namespace
+
+HRESULT StartCompileAsync(IMalloc *pMalloc, IDxcCompilerCancellation *pCompiler,
+                          const DxcBuffer *pSource, LPCWSTR *pArguments,
+                          UINT32 argCount, IDxcIncludeHandler *pIncludeHandler,
+                          IDxcTaskExecutor *pExecutor, DxcThreadPool *pPool,
+                          IDxcAsyncResult **ppAsync) {
+  if (ppAsync == nullptr)
+    return E_INVALIDARG;
+  *ppAsync = nullptr;
+  if (pExecutor == nullptr && pPool == nullptr)
+    return E_INVALIDARG;
+
+  DxcThreadMalloc TM(pMalloc);
+  try {
+    CComPtr<DxcAsyncCompile> pAsync = DxcAsyncCompile::Alloc(pMalloc);
+    IFROOM(pAsync.p);
+    pAsync->Init(pSource, pArguments, argCount, pIncludeHandler);
+
+    if (pExecutor) {
+      CComPtr<DxcAsyncCompileTask> pTask = DxcAsyncCompileTask::Alloc(pMalloc);
+      IFROOM(pTask.p);
+      pTask->Init(pAsync, pCompiler);
+      HRESULT hr = pExecutor->Schedule(pTask);
+      if (FAILED(hr)) {
+        pTask->Disarm();
+        return hr;
+      }
+    } else {
+      // As on an executor, the task keeps the compiler alive until it has
+      // run. A completion callback may drop every other reference, so the
+      // task can release the last one, on a thread of the compiler's pool.
+      DxcAsyncCompile *pRaw = pAsync;
+      pRaw->AddRef();
+      pCompiler->AddRef();
+      try {
+        pPool->Async([pRaw, pCompiler]() {
+          pRaw->Run(pCompiler);
+          pRaw->Release();
+          pCompiler->Release();
+        });
+      } catch (...) {
+        pRaw->Release();
+        pCompiler->Release();
+        throw;
+      }
+    }
+
+    *ppAsync = pAsync.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+} // namespace dxcutil
@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcasynccompile.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the asynchronous compile support used by DxcCompiler.            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/Global.h"
+
+namespace hlsl {
+class DxcThreadPool;
+}
+
+namespace dxcutil {
+
+// Starts compiling pSource with pCompiler and returns the compile in flight.
+// The source, arguments and include handler are captured before returning.
+// The compile is scheduled on pExecutor if given, and otherwise on pPool,
+// which must outlive the compile; pPool waits for it when destroyed, so only
+// a compile scheduled on pExecutor holds a reference to pCompiler.
+HRESULT StartCompileAsync(_In_ IMalloc *pMalloc,
+                          _In_ IDxcCompilerCancellation *pCompiler,
+                          _In_ const DxcBuffer *pSource,
+                          _In_opt_count_(argCount) LPCWSTR *pArguments,
+                          UINT32 argCount,
+                          _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                          _In_opt_ IDxcTaskExecutor *pExecutor,
+                          _In_opt_ hlsl::DxcThreadPool *pPool,
+                          _COM_Outptr_ IDxcAsyncResult **ppAsync);
+
+} // namespace dxcutil
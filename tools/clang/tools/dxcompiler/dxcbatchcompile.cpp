@@ -0,0 +1,284 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbatchcompile.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the batch compile support used by DxcCompiler.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxcbatchcompile.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/dxcapi.impl.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace dxcutil {
+
+///////////////////////////////////////////////////////////////////////////////
+// DxcSharedIncludeHandler
+
+HRESULT STDMETHODCALLTYPE DxcSharedIncludeHandler::LoadSource(
+    LPCWSTR pFilename, IDxcBlob **ppIncludeSource) {
+  if (pFilename == nullptr || ppIncludeSource == nullptr)
+    return E_INVALIDARG;
+  *ppIncludeSource = nullptr;
+
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    sys::ScopedLock L(m_lock);
+    auto it = m_files.find(pFilename);
+    if (it != m_files.end())
+      return it->second.CopyTo(ppIncludeSource);
+    if (!m_pInner)
+      return E_FAIL;
+
+    // Failed loads are not remembered, so each job reports its own error.
+    CComPtr<IDxcBlob> pBlob;
+    IFR(m_pInner->LoadSource(pFilename, &pBlob));
+    if (!pBlob)
+      return S_OK;
+    m_files[pFilename] = pBlob;
+    *ppIncludeSource = pBlob.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Batch compile
+
+// Decodes each distinct source buffer once. Jobs that point at the same
+// buffer with the same encoding get the same UTF-8 blob, so the compiles
+// themselves never need to convert.
+static void DecodeBatchSources(IMalloc *pMalloc, const DxcCompileJob *pJobs,
+                               UINT32 jobCount,
+                               std::vector<CComPtr<IDxcBlobUtf8>> &Decoded,
+                               std::vector<DxcBuffer> &Sources) {
+  typedef std::tuple<LPCVOID, SIZE_T, UINT> SourceKey;
+  std::map<SourceKey, unsigned> DecodedIndex;
+  Sources.resize(jobCount);
+  for (UINT32 i = 0; i < jobCount; ++i) {
+    const DxcBuffer *pSource = pJobs[i].pSource;
+    SourceKey key(pSource->Ptr, pSource->Size, pSource->Encoding);
+    auto it = DecodedIndex.find(key);
+    if (it == DecodedIndex.end()) {
+      CComPtr<IDxcBlobEncoding> pSourceEncoding;
+      CComPtr<IDxcBlobUtf8> pUtf8;
+      IFT(hlsl::DxcCreateBlob(pSource->Ptr, pSource->Size,
+        true, false, pSource->Encoding != 0, pSource->Encoding,
+        nullptr, &pSourceEncoding));
+      IFT(hlsl::DxcGetBlobAsUtf8(pSourceEncoding, pMalloc, &pUtf8));
+      it = DecodedIndex.insert(std::make_pair(key, (unsigned)Decoded.size())).first;
+      Decoded.emplace_back(pUtf8);
+    }
+    IDxcBlobUtf8 *pUtf8 = Decoded[it->second];
+    Sources[i].Ptr = pUtf8->GetStringPointer();
+    Sources[i].Size = pUtf8->GetStringLength();
+    Sources[i].Encoding = CP_UTF8;
+  }
+}
+
+HRESULT RunCompileBatch(IMalloc *pMalloc, IDxcCompiler3 *pCompiler,
+                        const DxcCompileJob *pJobs, UINT32 jobCount,
+                        IDxcIncludeHandler *pIncludeHandler,
+                        UINT32 threadCount,
+                        IDxcCompileBatchCallback *pCallback) {
+  DxcThreadMalloc TM(pMalloc);
+  try {
+    if (jobCount == 0)
+      return S_OK;
+
+    // The decoded blobs must outlive the pool, which waits in its destructor.
+    std::vector<CComPtr<IDxcBlobUtf8>> Decoded;
+    std::vector<DxcBuffer> Sources;
+    DecodeBatchSources(pMalloc, pJobs, jobCount, Decoded, Sources);
+
+    CComPtr<DxcSharedIncludeHandler> pShared =
+      DxcSharedIncludeHandler::Alloc(pMalloc);
+    IFROOM(pShared.p);
+    pShared->Init(pIncludeHandler);
+    IDxcIncludeHandler *pJobIncludeHandler =
+      pIncludeHandler ? pShared.p : nullptr;
+
+    sys::Mutex CallbackLock;
+    std::atomic<bool> Cancelled(false);
+    HRESULT BatchResult = S_OK;
+
+    if (threadCount == 0)
+      threadCount = DxcThreadPool::GetDefaultThreadCount();
+    if (threadCount > jobCount)
+      threadCount = jobCount;
+
+    {
+      DxcThreadPool Pool(threadCount);
+      for (UINT32 i = 0; i < jobCount; ++i) {
+        Pool.Async([&, i]() {
+          if (Cancelled)
+            return;
+          DxcThreadMalloc TM(pMalloc);
+          CComPtr<IDxcResult> pResult;
+          HRESULT hr;
+          try {
+            hr = pCompiler->Compile(&Sources[i], pJobs[i].pArguments,
+                                    pJobs[i].argCount, pJobIncludeHandler,
+                                    IID_PPV_ARGS(&pResult));
+          }
+          CATCH_CPP_ASSIGN_HRESULT();
+          if (FAILED(hr)) {
+            // Report the failure as the status of the job.
+            pResult.Release();
+            hr = DxcResult::Create(hr, DXC_OUT_NONE, nullptr, 0, &pResult);
+          }
+
+          sys::ScopedLock L(CallbackLock);
+          if (Cancelled)
+            return;
+          if (SUCCEEDED(hr))
+            hr = pCallback->OnCompileComplete(i, pResult);
+          if (FAILED(hr)) {
+            BatchResult = hr;
+            Cancelled = true;
+          }
+        });
+      }
+      // A job that threw past the above was never delivered.
+      HRESULT PoolResult = Pool.Wait();
+      if (SUCCEEDED(BatchResult))
+        BatchResult = PoolResult;
+    }
+
+    return BatchResult;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Multi-entry and permutation compiles
+
+// Keeps the result of each job by index.
+class DxcCollectBatchResults : public IDxcCompileBatchCallback {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcCollectBatchResults)
+
+  std::vector<CComPtr<IDxcResult>> Results;
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileBatchCallback>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE OnCompileComplete(UINT32 jobIndex,
+                                              IDxcResult *pResult) override {
+    Results[jobIndex] = pResult;
+    return S_OK;
+  }
+};
+
+// Compiles pSource once per argument list and returns the results in order.
+static HRESULT RunCollectedBatch(IMalloc *pMalloc, IDxcCompiler3 *pCompiler,
+                                 const DxcBuffer *pSource,
+                                 std::vector<std::vector<LPCWSTR>> &Args,
+                                 IDxcIncludeHandler *pIncludeHandler,
+                                 UINT32 threadCount, IDxcResult **ppResults) {
+  UINT32 jobCount = (UINT32)Args.size();
+  std::vector<DxcCompileJob> Jobs(jobCount);
+  for (UINT32 i = 0; i < jobCount; ++i) {
+    Jobs[i].pSource = pSource;
+    Jobs[i].pArguments = Args[i].data();
+    Jobs[i].argCount = (UINT32)Args[i].size();
+  }
+
+  CComPtr<DxcCollectBatchResults> pCollect =
+    DxcCollectBatchResults::Alloc(pMalloc);
+  IFROOM(pCollect.p);
+  pCollect->Results.resize(jobCount);
+  IFR(RunCompileBatch(pMalloc, pCompiler, Jobs.data(), jobCount,
+                      pIncludeHandler, threadCount, pCollect));
+  for (UINT32 i = 0; i < jobCount; ++i)
+    ppResults[i] = pCollect->Results[i].Detach();
+  return S_OK;
+}
+
+HRESULT RunCompileEntryPoints(IMalloc *pMalloc, IDxcCompiler3 *pCompiler,
+                              const DxcBuffer *pSource,
+                              LPCWSTR *pArguments, UINT32 argCount,
+                              const DxcEntryPoint *pEntryPoints,
+                              UINT32 entryPointCount,
+                              IDxcIncludeHandler *pIncludeHandler,
+                              UINT32 threadCount,
+                              IDxcResult **ppResults) {
+  DxcThreadMalloc TM(pMalloc);
+  try {
+    for (UINT32 i = 0; i < entryPointCount; ++i)
+      ppResults[i] = nullptr;
+
+    std::vector<std::vector<LPCWSTR>> Args(entryPointCount);
+    for (UINT32 i = 0; i < entryPointCount; ++i) {
+      Args[i].assign(pArguments, pArguments + argCount);
+      Args[i].push_back(L"-E");
+      Args[i].push_back(pEntryPoints[i].pName);
+      Args[i].push_back(L"-T");
+      Args[i].push_back(pEntryPoints[i].pTargetProfile);
+    }
+    return RunCollectedBatch(pMalloc, pCompiler, pSource, Args,
+                             pIncludeHandler, threadCount, ppResults);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT RunCompilePermutations(IMalloc *pMalloc, IDxcCompiler3 *pCompiler,
+                               const DxcBuffer *pSource,
+                               LPCWSTR *pArguments, UINT32 argCount,
+                               const DxcPermutation *pPermutations,
+                               UINT32 permutationCount,
+                               IDxcIncludeHandler *pIncludeHandler,
+                               UINT32 threadCount,
+                               IDxcResult **ppResults) {
+  DxcThreadMalloc TM(pMalloc);
+  try {
+    for (UINT32 i = 0; i < permutationCount; ++i)
+      ppResults[i] = nullptr;
+
+    // Defines go after the base arguments, so a permutation overrides a
+    // define of the same name in the base set.
+    std::vector<std::vector<std::wstring>> Defines(permutationCount);
+    std::vector<std::vector<LPCWSTR>> Args(permutationCount);
+    for (UINT32 i = 0; i < permutationCount; ++i) {
+      const DxcPermutation &Permutation = pPermutations[i];
+      for (UINT32 d = 0; d < Permutation.defineCount; ++d) {
+        const DxcDefine &Define = Permutation.pDefines[d];
+        std::wstring Text = Define.Name;
+        if (Define.Value) {
+          Text += L'=';
+          Text += Define.Value;
+        }
+        Defines[i].push_back(std::move(Text));
+      }
+      Args[i].assign(pArguments, pArguments + argCount);
+      for (const std::wstring &Text : Defines[i]) {
+        Args[i].push_back(L"-D");
+        Args[i].push_back(Text.c_str());
+      }
+    }
+    return RunCollectedBatch(pMalloc, pCompiler, pSource, Args,
+                             pIncludeHandler, threadCount, ppResults);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+} // namespace dxcutil
@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcbatchcompile.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the batch compile support used by DxcCompiler.                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/Support/Mutex.h"
+#include <string>
+#include <unordered_map>
+
+namespace dxcutil {
+
+// Include handler shared by every job of a batch. Each file is loaded from
+// the user handler once and then served from memory; the user handler is
+// only ever called under a lock, so it does not need to be thread-safe.
+class DxcSharedIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeHandler> m_pInner;
+  llvm::sys::Mutex m_lock;
+  std::unordered_map<std::wstring, CComPtr<IDxcBlob>> m_files;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcSharedIncludeHandler)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  void Init(_In_opt_ IDxcIncludeHandler *pInner) { m_pInner = pInner; }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_z_ LPCWSTR pFilename,
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource) override;
+};
+
+// Runs every job of a batch through pCompiler on a pool of threadCount
+// workers and reports each result to pCallback.
+HRESULT RunCompileBatch(_In_ IMalloc *pMalloc, _In_ IDxcCompiler3 *pCompiler,
+                        _In_count_(jobCount) const DxcCompileJob *pJobs,
+                        UINT32 jobCount,
+                        _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                        UINT32 threadCount,
+                        _In_ IDxcCompileBatchCallback *pCallback);
+
+// Compiles pSource once per entry point as jobs of a batch, appending -E and
+// -T for each entry point to the shared arguments.
+HRESULT RunCompileEntryPoints(_In_ IMalloc *pMalloc, _In_ IDxcCompiler3 *pCompiler,
+                              _In_ const DxcBuffer *pSource,
+                              _In_opt_count_(argCount) LPCWSTR *pArguments,
+                              UINT32 argCount,
+                              _In_count_(entryPointCount) const DxcEntryPoint *pEntryPoints,
+                              UINT32 entryPointCount,
+                              _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                              UINT32 threadCount,
+                              _Out_writes_(entryPointCount) IDxcResult **ppResults);
+
+// Compiles pSource once per permutation as jobs of a batch, appending a -D
+// for each define of the permutation to the shared arguments.
+HRESULT RunCompilePermutations(_In_ IMalloc *pMalloc, _In_ IDxcCompiler3 *pCompiler,
+                               _In_ const DxcBuffer *pSource,
+                               _In_opt_count_(argCount) LPCWSTR *pArguments,
+                               UINT32 argCount,
+                               _In_count_(permutationCount) const DxcPermutation *pPermutations,
+                               UINT32 permutationCount,
+                               _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                               UINT32 threadCount,
+                               _Out_writes_(permutationCount) IDxcResult **ppResults);
+
+} // namespace dxcutil
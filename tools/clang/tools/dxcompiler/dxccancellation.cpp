@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccancellation.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements compile cancellation tokens and the pass boundary check.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxccancellation.h"
+#include "dxc/Support/DxcCompileDeadline.h"
+#include "dxc/Support/microcom.h"
+
+#include <atomic>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace dxcutil {
+
+namespace {
+
+class DxcCancellationToken : public IDxcCancellationToken {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::atomic<bool> m_cancelled;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_ALLOC(DxcCancellationToken)
+  DxcCancellationToken(IMalloc *pMalloc)
+      : m_dwRef(0), m_pMalloc(pMalloc), m_cancelled(false) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcCancellationToken>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE Cancel() override {
+    m_cancelled.store(true, std::memory_order_relaxed);
+    return S_OK;
+  }
+
+  BOOL STDMETHODCALLTYPE IsCancelled() override {
+    return m_cancelled.load(std::memory_order_relaxed) ? TRUE : FALSE;
+  }
+};
+
+} // namespace
+
+HRESULT CreateCancellationToken(_In_ IMalloc *pMalloc,
+                                _COM_Outptr_ IDxcCancellationToken **ppToken) {
+  if (ppToken == nullptr)
+    return E_INVALIDARG;
+  *ppToken = nullptr;
+  CComPtr<DxcCancellationToken> pToken = DxcCancellationToken::Alloc(pMalloc);
+  IFROOM(pToken.p);
+  *ppToken = pToken.Detach();
+  return S_OK;
+}
+
+DxcDeadlinePassObserver::DxcDeadlinePassObserver() {
+  m_pPriorObserver = legacy::setThreadPassRunObserver(this);
+}
+
+DxcDeadlinePassObserver::~DxcDeadlinePassObserver() {
+  legacy::setThreadPassRunObserver(m_pPriorObserver);
+}
+
+void DxcDeadlinePassObserver::beforePass(Pass *P, Module &M, Function *F) {
+  // Throwing here keeps the prior observer from seeing a pass that never
+  // starts, so its before and after calls stay paired.
+  CheckCompileDeadline();
+  if (m_pPriorObserver)
+    m_pPriorObserver->beforePass(P, M, F);
+}
+
+void DxcDeadlinePassObserver::afterPass(Pass *P, Module &M, Function *F) {
+  if (m_pPriorObserver)
+    m_pPriorObserver->afterPass(P, M, F);
+}
+
+} // namespace dxcutil
@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccancellation.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides compile cancellation tokens and the pass boundary check.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/Global.h"
+#include "llvm/IR/LegacyPassManager.h"
+
+namespace dxcutil {
+
+HRESULT CreateCancellationToken(_In_ IMalloc *pMalloc,
+                                _COM_Outptr_ IDxcCancellationToken **ppToken);
+
+// Checks the thread's compile deadline before every pass run on this thread,
+// so a cancelled or expired compile stops at the next pass boundary. Other
+// observers installed earlier keep receiving every pass.
+class DxcDeadlinePassObserver : public llvm::legacy::PassRunObserver {
+public:
+  DxcDeadlinePassObserver();
+  ~DxcDeadlinePassObserver() override;
+
+  void beforePass(llvm::Pass *P, llvm::Module &M, llvm::Function *F) override;
+  void afterPass(llvm::Pass *P, llvm::Module &M, llvm::Function *F) override;
+
+private:
+  llvm::legacy::PassRunObserver *m_pPriorObserver;
+};
+
+} // namespace dxcutil
@@ -0,0 +1,559 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the compile result cache used by DxcCompiler.                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxccompilecache.h"
+#include "dxc/DXIL/DxilConstants.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/dxcapi.impl.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Option/Arg.h"
+#include "llvm/Support/Mutex.h"
+
+#include <atomic>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+#include "clang/Basic/Version.h"
+#endif // SUPPORT_QUERY_GIT_COMMIT_INFO
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace dxcutil {
+
+///////////////////////////////////////////////////////////////////////////////
+// DxcRecordingIncludeHandler
+
+HRESULT STDMETHODCALLTYPE DxcRecordingIncludeHandler::LoadSource(
+    LPCWSTR pFilename, IDxcBlob **ppIncludeSource) {
+  if (pFilename == nullptr || ppIncludeSource == nullptr)
+    return E_INVALIDARG;
+  *ppIncludeSource = nullptr;
+  for (IncludedFile &file : m_files) {
+    if (file.Name == pFilename)
+      return file.Blob.CopyTo(ppIncludeSource);
+  }
+  if (!m_pInner)
+    return E_FAIL;
+
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    CComPtr<IDxcBlob> pBlob;
+    IFR(m_pInner->LoadSource(pFilename, &pBlob));
+    if (!pBlob)
+      return S_OK;
+    IncludedFile file;
+    file.Name = pFilename;
+    file.Blob = pBlob;
+    m_files.emplace_back(std::move(file));
+    *ppIncludeSource = pBlob.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+void DxcRecordingIncludeHandler::HashIncludes(MD5 &Hasher) const {
+  for (const IncludedFile &file : m_files) {
+    uint64_t nameSize = file.Name.size() * sizeof(wchar_t);
+    uint64_t dataSize = file.Blob->GetBufferSize();
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&nameSize, sizeof(nameSize)));
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)file.Name.data(), nameSize));
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&dataSize, sizeof(dataSize)));
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)file.Blob->GetBufferPointer(), dataSize));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Cache key
+
+// Bump whenever the key inputs or the serialized result layout change.
+static const uint32_t kCompileCacheFormatVersion = 1;
+
+static void HashString(MD5 &Hasher, StringRef Str) {
+  uint64_t size = Str.size();
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&size, sizeof(size)));
+  Hasher.update(Str);
+}
+
+void ComputeCompileCacheKey(const hlsl::options::DxcOpts &opts,
+                            unsigned ValMajor, unsigned ValMinor,
+                            const DxcBuffer *pSource,
+                            IDxcBlob *pPreprocessed,
+                            const DxcRecordingIncludeHandler &Includes,
+                            CompileCacheKey &Key) {
+  MD5 Hasher;
+  uint32_t versions[] = { kCompileCacheFormatVersion,
+                          DXIL::kDxilMajor, DXIL::kDxilMinor,
+                          ValMajor, ValMinor };
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)versions, sizeof(versions)));
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+  HashString(Hasher, clang::getGitCommitHash());
+#endif // SUPPORT_QUERY_GIT_COMMIT_INFO
+
+  // Render each parsed argument in its canonical spelling, so that
+  // equivalent command lines ('/T ps_6_0', '-Tps_6_0') share an entry.
+  for (const llvm::opt::Arg *A : opts.Args)
+    HashString(Hasher, A->getAsString(opts.Args));
+
+  HashString(Hasher, StringRef((const char *)pSource->Ptr, pSource->Size));
+  HashString(Hasher, StringRef((const char *)pPreprocessed->GetBufferPointer(),
+                               pPreprocessed->GetBufferSize()));
+  Includes.HashIncludes(Hasher);
+  Hasher.final(Key);
+}
+
+void ComputeDisassemblyCacheKey(const DxcBuffer *pObject,
+                                CompileCacheKey &Key) {
+  MD5 Hasher;
+  // Keeps disassembly keys apart from compile keys in a shared store.
+  HashString(Hasher, "disassembly");
+  uint32_t version = kCompileCacheFormatVersion;
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&version, sizeof(version)));
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+  HashString(Hasher, clang::getGitCommitHash());
+#endif // SUPPORT_QUERY_GIT_COMMIT_INFO
+  HashString(Hasher, StringRef((const char *)pObject->Ptr, pObject->Size));
+  Hasher.final(Key);
+}
+
+void ComputeValidationCacheKey(IDxcBlob *pShader, UINT32 Flags,
+                               unsigned ValMajor, unsigned ValMinor,
+                               CompileCacheKey &Key) {
+  MD5 Hasher;
+  HashString(Hasher, "validation");
+  uint32_t versions[] = { kCompileCacheFormatVersion, ValMajor, ValMinor,
+                          Flags };
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)versions, sizeof(versions)));
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+  HashString(Hasher, clang::getGitCommitHash());
+#endif // SUPPORT_QUERY_GIT_COMMIT_INFO
+
+  const char *pData = (const char *)pShader->GetBufferPointer();
+  size_t size = pShader->GetBufferSize();
+  uint64_t totalSize = size;
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&totalSize, sizeof(totalSize)));
+  const DxilContainerHeader *pHeader = IsDxilContainerLike(pData, size);
+  if (!pHeader || !IsValidDxilContainer(pHeader, size)) {
+    HashString(Hasher, StringRef(pData, size));
+    Hasher.final(Key);
+    return;
+  }
+  Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&pHeader->Version,
+                                  sizeof(pHeader->Version)));
+  for (DxilPartIterator it = begin(pHeader), itEnd = end(pHeader);
+       it != itEnd; ++it) {
+    const DxilPartHeader *pPart = *it;
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)&pPart->PartFourCC,
+                                    sizeof(pPart->PartFourCC)));
+    HashString(Hasher, StringRef(GetDxilPartData(pPart), pPart->PartSize));
+  }
+  Hasher.final(Key);
+}
+
+// The value stored for a passing verdict.
+static const char kValidationVerdictPass[] = "pass";
+
+bool LookupValidationVerdict(IDxcCompileCacheStore *pStore,
+                             const CompileCacheKey &Key) {
+  DxcBuffer keyBuffer = { Key, sizeof(Key), 0 };
+  CComPtr<IDxcBlob> pValue;
+  if (pStore->Lookup(&keyBuffer, &pValue) != S_OK || !pValue)
+    return false;
+  return pValue->GetBufferSize() == sizeof(kValidationVerdictPass) &&
+         0 == memcmp(pValue->GetBufferPointer(), kValidationVerdictPass,
+                     sizeof(kValidationVerdictPass));
+}
+
+void StoreValidationVerdict(IDxcCompileCacheStore *pStore,
+                            const CompileCacheKey &Key) {
+  DxcBuffer keyBuffer = { Key, sizeof(Key), 0 };
+  CComPtr<IDxcBlob> pValue;
+  // Failing to store only costs a later miss, so errors are ignored.
+  if (SUCCEEDED(DxcCreateBlobOnHeapCopy(kValidationVerdictPass,
+                                        sizeof(kValidationVerdictPass),
+                                        &pValue)))
+    pStore->Store(&keyBuffer, pValue);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Result serialization
+//
+// The layout is a header followed by one record per output:
+//   uint32 kind, uint32 codePage, uint32 nameSize, uint32 dataSize,
+//   name (UTF-16, nameSize bytes), data (dataSize bytes).
+
+static const uint32_t kCompileCacheMagic = 0x43435844; // 'DXCC'
+
+struct CompileCacheHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t Status;
+  uint32_t PrimaryKind;
+  uint32_t OutputCount;
+};
+
+struct CompileCacheOutputHeader {
+  uint32_t Kind;
+  uint32_t CodePage;
+  uint32_t NameSize;
+  uint32_t DataSize;
+};
+
+HRESULT SerializeCompileResult(IDxcResult *pResult, IDxcBlob **ppValue) {
+  if (pResult == nullptr || ppValue == nullptr)
+    return E_INVALIDARG;
+  *ppValue = nullptr;
+  try {
+    CComPtr<AbstractMemoryStream> pStream;
+    IFR(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pStream));
+
+    HRESULT status;
+    IFR(pResult->GetStatus(&status));
+    CompileCacheHeader header = {};
+    header.Magic = kCompileCacheMagic;
+    header.Version = kCompileCacheFormatVersion;
+    header.Status = (uint32_t)status;
+    header.PrimaryKind = (uint32_t)pResult->PrimaryOutput();
+    header.OutputCount = pResult->GetNumOutputs();
+    IFR(WriteStreamValue(pStream, header));
+
+    ULONG cbWritten;
+    for (unsigned i = DXC_OUT_NONE + 1; i <= kNumDxcOutputTypes; ++i) {
+      DXC_OUT_KIND kind = (DXC_OUT_KIND)i;
+      if (!pResult->HasOutput(kind))
+        continue;
+      CComPtr<IDxcBlob> pBlob;
+      CComPtr<IDxcBlobUtf16> pName;
+      IFR(pResult->GetOutput(kind, IID_PPV_ARGS(&pBlob), &pName));
+
+      CompileCacheOutputHeader output = {};
+      output.Kind = (uint32_t)kind;
+      CComPtr<IDxcBlobEncoding> pEncoding;
+      if (SUCCEEDED(pBlob.QueryInterface(&pEncoding))) {
+        BOOL known = FALSE;
+        UINT32 codePage = DXC_CP_ACP;
+        IFR(pEncoding->GetEncoding(&known, &codePage));
+        output.CodePage = known ? codePage : DXC_CP_ACP;
+      }
+      output.NameSize = pName ? (uint32_t)pName->GetBufferSize() : 0;
+      output.DataSize = (uint32_t)pBlob->GetBufferSize();
+      IFR(WriteStreamValue(pStream, output));
+      if (output.NameSize)
+        IFR(pStream->Write(pName->GetBufferPointer(), output.NameSize, &cbWritten));
+      if (output.DataSize)
+        IFR(pStream->Write(pBlob->GetBufferPointer(), output.DataSize, &cbWritten));
+    }
+    return pStream.QueryInterface(ppValue);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT DeserializeCompileResult(IDxcBlob *pValue, IDxcResult **ppResult) {
+  if (pValue == nullptr || ppResult == nullptr)
+    return E_INVALIDARG;
+  *ppResult = nullptr;
+  try {
+    const uint8_t *pCur = (const uint8_t *)pValue->GetBufferPointer();
+    const uint8_t *pEnd = pCur + pValue->GetBufferSize();
+
+    CompileCacheHeader header;
+    IFRBOOL(pEnd - pCur >= (ptrdiff_t)sizeof(header), E_FAIL);
+    memcpy(&header, pCur, sizeof(header));
+    pCur += sizeof(header);
+    IFRBOOL(header.Magic == kCompileCacheMagic &&
+            header.Version == kCompileCacheFormatVersion &&
+            header.PrimaryKind <= kNumDxcOutputTypes, E_FAIL);
+
+    CComPtr<DxcResult> pResult = DxcResult::Alloc(DxcGetThreadMallocNoRef());
+    IFROOM(pResult.p);
+    for (uint32_t i = 0; i < header.OutputCount; ++i) {
+      CompileCacheOutputHeader output;
+      IFRBOOL(pEnd - pCur >= (ptrdiff_t)sizeof(output), E_FAIL);
+      memcpy(&output, pCur, sizeof(output));
+      pCur += sizeof(output);
+      IFRBOOL((uint64_t)(pEnd - pCur) >=
+              (uint64_t)output.NameSize + output.DataSize, E_FAIL);
+
+      DxcOutputObject object;
+      object.kind = (DXC_OUT_KIND)output.Kind;
+      CComPtr<IDxcBlobEncoding> pData;
+      IFR(DxcCreateBlob(pCur + output.NameSize, output.DataSize, false, true,
+                        output.CodePage != DXC_CP_ACP, output.CodePage,
+                        DxcGetThreadMallocNoRef(), &pData));
+      object.object = pData;
+      if (output.NameSize) {
+        CComPtr<IDxcBlobEncoding> pNameEncoding;
+        IFR(DxcCreateBlobWithEncodingOnHeapCopy(pCur, output.NameSize,
+                                                DXC_CP_UTF16, &pNameEncoding));
+        IFR(pNameEncoding.QueryInterface(&object.name));
+      }
+      pCur += output.NameSize + output.DataSize;
+      IFR(pResult->SetOutput(object));
+    }
+    IFR(pResult->SetStatusAndPrimaryResult((HRESULT)header.Status,
+                                           (DXC_OUT_KIND)header.PrimaryKind));
+    *ppResult = pResult.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores
+
+static std::string KeyToString(const DxcBuffer *pKey) {
+  static const char Hex[] = "0123456789abcdef";
+  std::string result;
+  result.reserve(pKey->Size * 2);
+  const uint8_t *pBytes = (const uint8_t *)pKey->Ptr;
+  for (size_t i = 0; i < pKey->Size; ++i) {
+    result.push_back(Hex[pBytes[i] >> 4]);
+    result.push_back(Hex[pBytes[i] & 0xf]);
+  }
+  return result;
+}
+
+// Keeps values in memory, evicting the least recently used entries once the
+// total size of the stored values exceeds the budget.
+class DxcMemoryCompileCacheStore : public IDxcCompileCacheStore {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  struct Entry {
+    std::string Key;
+    CComPtr<IDxcBlob> Value;
+  };
+  typedef std::list<Entry> EntryList;
+  EntryList m_entries; // most recently used first
+  std::unordered_map<std::string, EntryList::iterator> m_index;
+  UINT64 m_maxSize = 0;
+  UINT64 m_size = 0;
+  llvm::sys::Mutex m_lock;
+
+  void EvictToBudget() {
+    while (m_size > m_maxSize && !m_entries.empty()) {
+      Entry &last = m_entries.back();
+      m_size -= last.Value->GetBufferSize();
+      m_index.erase(last.Key);
+      m_entries.pop_back();
+    }
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcMemoryCompileCacheStore)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileCacheStore>(this, iid, ppvObject);
+  }
+
+  void Init(UINT64 maxSizeInBytes) { m_maxSize = maxSizeInBytes; }
+
+  HRESULT STDMETHODCALLTYPE Lookup(const DxcBuffer *pKey,
+                                   IDxcBlob **ppValue) override {
+    if (pKey == nullptr || ppValue == nullptr)
+      return E_INVALIDARG;
+    *ppValue = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      std::string key((const char *)pKey->Ptr, pKey->Size);
+      llvm::sys::ScopedLock Lock(m_lock);
+      auto it = m_index.find(key);
+      if (it == m_index.end())
+        return S_FALSE;
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      return it->second->Value.CopyTo(ppValue);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT STDMETHODCALLTYPE Store(const DxcBuffer *pKey,
+                                  IDxcBlob *pValue) override {
+    if (pKey == nullptr || pValue == nullptr)
+      return E_INVALIDARG;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      std::string key((const char *)pKey->Ptr, pKey->Size);
+      llvm::sys::ScopedLock Lock(m_lock);
+      auto it = m_index.find(key);
+      if (it != m_index.end()) {
+        m_size -= it->second->Value->GetBufferSize();
+        m_entries.erase(it->second);
+        m_index.erase(it);
+      }
+      if (pValue->GetBufferSize() > m_maxSize)
+        return S_FALSE;
+      Entry entry;
+      entry.Key = key;
+      entry.Value = pValue;
+      m_entries.emplace_front(std::move(entry));
+      m_index[key] = m_entries.begin();
+      m_size += pValue->GetBufferSize();
+      EvictToBudget();
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+// Keeps one file per entry, named after the hex digest of the key. Entries
+// are written to a temporary file and renamed into place, so readers never
+// see a partial entry; foreign files are rejected by DeserializeCompileResult.
+class DxcDirectoryCompileCacheStore : public IDxcCompileCacheStore {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::wstring m_directory;
+  std::atomic<unsigned> m_tempCounter;
+
+  std::wstring GetEntryPath(const DxcBuffer *pKey) {
+    std::string name = KeyToString(pKey);
+    std::wstring path = m_directory;
+    if (!path.empty() && path.back() != L'/' && path.back() != L'\\')
+      path.push_back(L'/');
+    path.append(name.begin(), name.end());
+    path.append(L".dxcc");
+    return path;
+  }
+
+  static unsigned GetProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return (unsigned)getpid();
+#endif
+  }
+
+  // Replaces any existing file at newPath.
+  static bool RenameFile(const std::wstring &oldPath,
+                         const std::wstring &newPath) {
+#ifdef _WIN32
+    return MoveFileExW(oldPath.c_str(), newPath.c_str(),
+                       MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+    std::string oldUtf8 = Unicode::UTF16ToUTF8StringOrThrow(oldPath.c_str());
+    std::string newUtf8 = Unicode::UTF16ToUTF8StringOrThrow(newPath.c_str());
+    return rename(oldUtf8.c_str(), newUtf8.c_str()) == 0;
+#endif
+  }
+
+  static void DeleteTempFile(const std::wstring &path) {
+#ifdef _WIN32
+    DeleteFileW(path.c_str());
+#else
+    std::string utf8;
+    if (Unicode::UTF16ToUTF8String(path.c_str(), &utf8))
+      unlink(utf8.c_str());
+#endif
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcDirectoryCompileCacheStore)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileCacheStore>(this, iid, ppvObject);
+  }
+
+  void Init(LPCWSTR pDirectory) {
+    m_directory = pDirectory;
+    m_tempCounter = 0;
+  }
+
+  HRESULT STDMETHODCALLTYPE Lookup(const DxcBuffer *pKey,
+                                   IDxcBlob **ppValue) override {
+    if (pKey == nullptr || ppValue == nullptr)
+      return E_INVALIDARG;
+    *ppValue = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      std::wstring path = GetEntryPath(pKey);
+      CComPtr<IDxcBlobEncoding> pBlob;
+      if (FAILED(DxcCreateBlobFromFile(m_pMalloc, path.c_str(), nullptr, &pBlob)))
+        return S_FALSE;
+      *ppValue = pBlob.Detach();
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT STDMETHODCALLTYPE Store(const DxcBuffer *pKey,
+                                  IDxcBlob *pValue) override {
+    if (pKey == nullptr || pValue == nullptr)
+      return E_INVALIDARG;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      // Write a file no one else reads, then rename it over the entry, so a
+      // concurrent Lookup sees either the old entry or the whole new one.
+      std::wstring path = GetEntryPath(pKey);
+      std::wstring tempPath = path;
+      tempPath.append(L".");
+      tempPath.append(std::to_wstring(GetProcessId()));
+      tempPath.append(L".");
+      tempPath.append(std::to_wstring(++m_tempCounter));
+      tempPath.append(L".tmp");
+      try {
+        WriteBinaryFile(tempPath.c_str(), pValue->GetBufferPointer(),
+                        (DWORD)pValue->GetBufferSize());
+      } catch (...) {
+        DeleteTempFile(tempPath);
+        throw;
+      }
+      if (!RenameFile(tempPath, path)) {
+        DeleteTempFile(tempPath);
+        return E_FAIL;
+      }
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+HRESULT CreateMemoryCompileCacheStore(IMalloc *pMalloc, UINT64 maxSizeInBytes,
+                                      IDxcCompileCacheStore **ppStore) {
+  if (ppStore == nullptr)
+    return E_INVALIDARG;
+  *ppStore = nullptr;
+  CComPtr<DxcMemoryCompileCacheStore> pStore =
+      DxcMemoryCompileCacheStore::Alloc(pMalloc);
+  IFROOM(pStore.p);
+  pStore->Init(maxSizeInBytes);
+  *ppStore = pStore.Detach();
+  return S_OK;
+}
+
+HRESULT CreateDirectoryCompileCacheStore(IMalloc *pMalloc, LPCWSTR pDirectory,
+                                         IDxcCompileCacheStore **ppStore) {
+  if (pDirectory == nullptr || ppStore == nullptr)
+    return E_INVALIDARG;
+  *ppStore = nullptr;
+  try {
+    CComPtr<DxcDirectoryCompileCacheStore> pStore =
+        DxcDirectoryCompileCacheStore::Alloc(pMalloc);
+    IFROOM(pStore.p);
+    pStore->Init(pDirectory);
+    *ppStore = pStore.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+} // namespace dxcutil
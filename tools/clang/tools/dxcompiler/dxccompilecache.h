@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccompilecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the compile result cache used by DxcCompiler.                    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MD5.h"
+#include <string>
+
+namespace hlsl {
+namespace options {
+class DxcOpts;
+} // namespace options
+} // namespace hlsl
+
+namespace dxcutil {
+
+// Include handler which forwards to an optional user handler and remembers
+// every file it served. Compiling twice with the same recorder (once to
+// preprocess for the cache key, once for real) only queries the user handler
+// once per file, and the recorded contents become part of the cache key.
+class DxcRecordingIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeHandler> m_pInner;
+  struct IncludedFile {
+    std::wstring Name;
+    CComPtr<IDxcBlob> Blob;
+  };
+  llvm::SmallVector<IncludedFile, 4> m_files;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcRecordingIncludeHandler)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  void Init(_In_opt_ IDxcIncludeHandler *pInner) { m_pInner = pInner; }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_z_ LPCWSTR pFilename,
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource) override;
+
+  // Adds the name and contents of every served file, in load order.
+  void HashIncludes(llvm::MD5 &Hasher) const;
+};
+
+typedef llvm::MD5::MD5Result CompileCacheKey;
+
+// Computes the key for a compile from the main and preprocessed source, the
+// included files, the normalized options and the compiler and validator
+// versions. The raw sources are covered as well as the preprocessed text
+// because comments and whitespace end up in debug info.
+void ComputeCompileCacheKey(const hlsl::options::DxcOpts &opts,
+                            unsigned ValMajor, unsigned ValMinor,
+                            _In_ const DxcBuffer *pSource,
+                            _In_ IDxcBlob *pPreprocessed,
+                            const DxcRecordingIncludeHandler &Includes,
+                            CompileCacheKey &Key);
+
+// Computes the key for the disassembly of a program from its bytes and the
+// compiler version. The shader hash alone is not enough, since the
+// disassembly also prints parts it does not cover, like the debug name.
+void ComputeDisassemblyCacheKey(_In_ const DxcBuffer *pObject,
+                                CompileCacheKey &Key);
+
+// Computes the key for the verdict of validating pShader with Flags. Each
+// part of a container is covered, but not the container digest, so signing
+// a container again does not change its key.
+void ComputeValidationCacheKey(_In_ IDxcBlob *pShader, UINT32 Flags,
+                               unsigned ValMajor, unsigned ValMinor,
+                               CompileCacheKey &Key);
+// Returns true if the store records that the shader for Key passed.
+bool LookupValidationVerdict(_In_ IDxcCompileCacheStore *pStore,
+                             const CompileCacheKey &Key);
+// Records that the shader for Key passed validation.
+void StoreValidationVerdict(_In_ IDxcCompileCacheStore *pStore,
+                            const CompileCacheKey &Key);
+
+// Flattens the status and outputs of a result into a single blob.
+HRESULT SerializeCompileResult(_In_ IDxcResult *pResult,
+                               _COM_Outptr_ IDxcBlob **ppValue);
+// Recreates a result from a blob produced by SerializeCompileResult. Fails
+// on blobs that are truncated or were written by a different format version.
+HRESULT DeserializeCompileResult(_In_ IDxcBlob *pValue,
+                                 _COM_Outptr_ IDxcResult **ppResult);
+
+HRESULT CreateMemoryCompileCacheStore(_In_ IMalloc *pMalloc,
+                                      UINT64 maxSizeInBytes,
+                                      _COM_Outptr_ IDxcCompileCacheStore **ppStore);
+HRESULT CreateDirectoryCompileCacheStore(_In_ IMalloc *pMalloc,
+                                         _In_z_ LPCWSTR pDirectory,
+                                         _COM_Outptr_ IDxcCompileCacheStore **ppStore);
+
+} // namespace dxcutil
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccontextpool.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the pool of LLVM contexts reused across compiles.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxccontextpool.h"
+#include "llvm/ADT/STLExtras.h"
+
+using namespace llvm;
+
+namespace dxcutil {
+
+// Types and constants uniqued by a compile stay in the context until it is
+// deleted, so a context is only used this many times.
+static const unsigned kMaxContextUses = 32;
+
+DxcContextPool::Lease::~Lease() {
+  if (m_pPool)
+    m_pPool->Release(std::move(m_pContext), m_uses);
+}
+
+void DxcContextPool::SetSize(unsigned maxIdleContexts) {
+  std::vector<IdleContext> freed;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_maxIdle = maxIdleContexts;
+    while (m_idle.size() > m_maxIdle) {
+      freed.push_back(std::move(m_idle.back()));
+      m_idle.pop_back();
+    }
+  }
+  // Contexts are deleted outside the lock.
+}
+
+DxcContextPool::Lease DxcContextPool::Acquire(bool bPooled) {
+  if (!bPooled)
+    return Lease(nullptr, llvm::make_unique<LLVMContext>(), 1);
+  bool pooling;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_idle.empty()) {
+      IdleContext idle = std::move(m_idle.back());
+      m_idle.pop_back();
+      return Lease(this, std::move(idle.Context), idle.Uses + 1);
+    }
+    pooling = m_maxIdle != 0;
+  }
+  // Without pooling the lease simply deletes the context.
+  return Lease(pooling ? this : nullptr, llvm::make_unique<LLVMContext>(), 1);
+}
+
+void DxcContextPool::Release(std::unique_ptr<LLVMContext> pContext,
+                             unsigned uses) {
+  // A context that still has a module can't be reset, and is not reused.
+  if (uses >= kMaxContextUses || !pContext->resetForReuse())
+    return;
+  // A context the pool has no room for is deleted with the parameter, after
+  // the lock is released.
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (m_idle.size() < m_maxIdle)
+    m_idle.push_back({std::move(pContext), uses});
+}
+
+} // namespace dxcutil
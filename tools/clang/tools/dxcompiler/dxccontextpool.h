@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxccontextpool.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a pool of LLVM contexts reused across compiles.                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/IR/LLVMContext.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dxcutil {
+
+// Keeps contexts left by finished compiles, so that the next compile starts
+// with the types, constants and metadata strings they already uniqued. With
+// a size of 0, every compile gets a new context.
+class DxcContextPool {
+public:
+  // A context in use by one compile. The context goes back to the pool when
+  // the lease is destroyed, which must be after every module in it.
+  class Lease {
+  public:
+    Lease(Lease &&Other)
+        : m_pPool(Other.m_pPool), m_pContext(std::move(Other.m_pContext)),
+          m_uses(Other.m_uses) {
+      Other.m_pPool = nullptr;
+    }
+    ~Lease();
+    llvm::LLVMContext &get() { return *m_pContext; }
+
+  private:
+    friend class DxcContextPool;
+    Lease(DxcContextPool *pPool, std::unique_ptr<llvm::LLVMContext> pContext,
+          unsigned uses)
+        : m_pPool(pPool), m_pContext(std::move(pContext)), m_uses(uses) {}
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    DxcContextPool *m_pPool;
+    std::unique_ptr<llvm::LLVMContext> m_pContext;
+    unsigned m_uses;
+  };
+
+  void SetSize(unsigned maxIdleContexts);
+  // Contexts outlive the compile that used them, so a compile that
+  // allocates from its own malloc (an arena, or a counting malloc for a
+  // memory report or limit) must pass bPooled = false to get a context that
+  // neither comes from the pool nor returns to it.
+  Lease Acquire(bool bPooled = true);
+
+private:
+  struct IdleContext {
+    std::unique_ptr<llvm::LLVMContext> Context;
+    unsigned Uses;
+  };
+
+  void Release(std::unique_ptr<llvm::LLVMContext> pContext, unsigned uses);
+
+  std::mutex m_lock;
+  std::vector<IdleContext> m_idle;
+  unsigned m_maxIdle = 0;
+};
+
+} // namespace dxcutil
@@ -1807,6 +1807,8 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
         Stream << format("%.2x", pHashContent->Digest[i]);
       if (pHashContent->Flags & (uint32_t)DxilShaderHashFlags::IncludesSource)
         Stream << " (includes source)";
+      if (pHashContent->Flags & (uint32_t)DxilShaderHashFlags::FastHash)
+        Stream << " (fast hash)";
       Stream << "\n";
     }
 
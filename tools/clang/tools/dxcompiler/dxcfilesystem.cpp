@@ -14,6 +14,8 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/dxcapi.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/raw_ostream.h"
 #include "dxcutil.h"
 
@@ -229,15 +231,27 @@ private:
   CComPtr<IDxcIncludeHandler> m_includeLoader;
   std::vector<std::wstring> m_searchEntries;
   bool m_bDisplayIncludeProcess;
+  std::wstring m_pchHeader; // normalized -Yu header name
+  std::wstring m_pchFile;
 
   // Some constraints of the current design: opening the same file twice
   // will return the same handle/structure, and thus the same file pointer.
+  // A file is found by its normalized name, so the different relative paths
+  // that reach a header open it once. Files with the same contents share an
+  // ID, which clang uses for #pragma once and include guards.
   struct IncludedFile {
     CComPtr<IDxcBlobUtf8> Blob;
     CComPtr<IStream> BlobStream;
     std::wstring Name;
+    std::wstring NormalizedName;
+    size_t ContentHash;
+    size_t FileId;
     IncludedFile(std::wstring &&name, IDxcBlobUtf8 *pBlob, IStream *pStream)
-      : Blob(pBlob), BlobStream(pStream), Name(name) { }
+      : Blob(pBlob), BlobStream(pStream), Name(name),
+        NormalizedName(NormalizePath(Name.c_str())),
+        ContentHash(llvm::hash_value(
+            llvm::StringRef(pBlob->GetStringPointer(), pBlob->GetStringLength()))),
+        FileId(0) { }
   };
   llvm::SmallVector<IncludedFile, 4> m_includedFiles;
 
@@ -262,9 +276,12 @@ private:
 
   HANDLE TryFindDirHandle(LPCWSTR lpDir) const {
     size_t dirLen = wcslen(lpDir);
+    std::wstring normalizedDir = NormalizePath(lpDir);
     for (size_t i = 0; i < m_includedFiles.size(); ++i) {
       const std::wstring &fileName = m_includedFiles[i].Name;
-      if (IsDirOf(lpDir, dirLen, fileName)) {
+      if (IsDirOf(lpDir, dirLen, fileName) ||
+          IsDirOf(normalizedDir.c_str(), normalizedDir.size(),
+                  m_includedFiles[i].NormalizedName)) {
         return DxcArgsHandle(HandleKind::FileDir, i, dirLen).Handle;
       }
     }
@@ -275,9 +292,80 @@ private:
     }
     return INVALID_HANDLE_VALUE;
   }
+  static void NormalizeSeparators(std::wstring &path) {
+    for (wchar_t &c : path) {
+      if (c == L'\\')
+        c = L'/';
+    }
+  }
+
+  // Unifies separators and resolves "." and ".." components. A root such as
+  // "/", "//server" or "c:/" is kept as it is, as are leading ".." components
+  // of a relative path.
+  static std::wstring NormalizePath(LPCWSTR lpPath) {
+    std::wstring path(lpPath);
+    NormalizeSeparators(path);
+    size_t rootLen = 0;
+    if (path.size() >= 2 && path[1] == L':')
+      rootLen = 2;
+    while (rootLen < path.size() && path[rootLen] == L'/')
+      ++rootLen;
+    std::wstring result(path, 0, rootLen);
+    llvm::SmallVector<std::wstring, 8> parts;
+    size_t pos = rootLen;
+    while (pos < path.size()) {
+      size_t next = path.find(L'/', pos);
+      if (next == std::wstring::npos)
+        next = path.size();
+      std::wstring part(path, pos, next - pos);
+      if (part == L".." && !parts.empty() && parts.back() != L"..")
+        parts.pop_back();
+      else if (!part.empty() && part != L".")
+        parts.push_back(std::move(part));
+      pos = next + 1;
+    }
+    for (size_t i = 0; i < parts.size(); ++i) {
+      if (i != 0)
+        result += L'/';
+      result += parts[i];
+    }
+    return result;
+  }
+
+  // Returns the ID of the first file with the same contents as the last one.
+  size_t FindFileId() const {
+    const IncludedFile &file = m_includedFiles.back();
+    for (size_t i = 0; i + 1 < m_includedFiles.size(); ++i) {
+      const IncludedFile &other = m_includedFiles[i];
+      if (other.ContentHash == file.ContentHash &&
+          other.Blob->GetStringLength() == file.Blob->GetStringLength() &&
+          0 == memcmp(other.Blob->GetStringPointer(),
+                      file.Blob->GetStringPointer(),
+                      file.Blob->GetStringLength()))
+        return other.FileId;
+    }
+    return m_includedFiles.size() - 1;
+  }
+
+  // Matches any path that names the precompiled header, either exactly or
+  // as its trailing path components, wherever the search found it.
+  bool IsPrecompiledHeader(LPCWSTR lpFileName) const {
+    if (m_pchHeader.empty())
+      return false;
+    std::wstring path(lpFileName);
+    NormalizeSeparators(path);
+    if (path == m_pchHeader)
+      return true;
+    return path.size() > m_pchHeader.size() &&
+           path[path.size() - m_pchHeader.size() - 1] == L'/' &&
+           0 == path.compare(path.size() - m_pchHeader.size(),
+                             m_pchHeader.size(), m_pchHeader);
+  }
+
   DWORD TryFindOrOpen(LPCWSTR lpFileName, size_t &index) {
+    std::wstring normalizedName = NormalizePath(lpFileName);
     for (size_t i = 0; i < m_includedFiles.size(); ++i) {
-      if (0 == wcscmp(lpFileName, m_includedFiles[i].Name.data())) {
+      if (normalizedName == m_includedFiles[i].NormalizedName) {
         index = i;
         return ERROR_SUCCESS;
       }
@@ -289,7 +377,11 @@ private:
       }
 
       CComPtr<::IDxcBlob> fileBlob;
-      HRESULT hr = m_includeLoader->LoadSource(lpFileName, &fileBlob);
+      // The precompiled header stands in for the header itself; it keeps the
+      // header's name so diagnostics and #line markers still refer to it.
+      LPCWSTR lpLoadName =
+          IsPrecompiledHeader(lpFileName) ? m_pchFile.c_str() : lpFileName;
+      HRESULT hr = m_includeLoader->LoadSource(lpLoadName, &fileBlob);
       if (FAILED(hr)) {
         return ERROR_UNHANDLED_EXCEPTION;
       }
@@ -304,6 +396,7 @@ private:
         }
         m_includedFiles.emplace_back(std::wstring(lpFileName), fileBlobUtf8, fileStream);
         index = m_includedFiles.size() - 1;
+        m_includedFiles.back().FileId = FindFileId();
 
         if (m_bDisplayIncludeProcess) {
           std::string openFileStr;
@@ -344,6 +437,15 @@ public:
   void EnableDisplayIncludeProcess() override {
     m_bDisplayIncludeProcess = true;
   }
+  void SetPrecompiledHeader(LPCWSTR pHeaderName, LPCWSTR pPchName) override {
+    m_pchHeader = pHeaderName;
+    NormalizeSeparators(m_pchHeader);
+    while (m_pchHeader.compare(0, 2, L"./") == 0)
+      m_pchHeader.erase(0, 2);
+    std::wstring pchStorage;
+    MakeAbsoluteOrCurDirRelativeW(pPchName, pchStorage);
+    m_pchFile = pPchName;
+  }
   void WriteStdErrToStream(raw_string_ostream &s) override {
     s.write((char*)m_pStdErrStream->GetPtr(), m_pStdErrStream->GetPtrSize());
     s.flush();
@@ -480,6 +582,8 @@ public:
     lpFileInformation->nFileIndexLow = (DWORD)(uintptr_t)hFile;
     if (argsHandle.IsFileKind()) {
       IncludedFile &file = HandleToIncludedFile(hFile);
+      lpFileInformation->nFileIndexLow =
+          (DWORD)(uintptr_t)IncludedFileIndexToHandle(file.FileId);
       lpFileInformation->dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
       lpFileInformation->nFileSizeLow = file.Blob->GetStringLength();
       return TRUE;
@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincludecache.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the include cache shared between compiles.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxcincludecache.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "llvm/Support/RWMutex.h"
+
+#include <string>
+#include <unordered_map>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace dxcutil {
+
+namespace {
+
+// Stores files already converted to UTF-8, so the compiler's file system
+// does not need to convert them again on every compile. Handlers are called
+// outside the lock; two compiles that miss on the same file at once both
+// load it, and the last one to finish is kept.
+class DxcIncludeCache : public IDxcIncludeCache {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  struct Entry {
+    CComPtr<IDxcBlobUtf8> Blob;
+    bool HasStamp;
+    UINT64 Stamp;
+  };
+  sys::RWMutex m_lock;
+  std::unordered_map<std::wstring, Entry> m_files;
+
+  // Different spellings of the separator resolve to the same file.
+  static std::wstring GetKey(LPCWSTR pFilename) {
+    std::wstring key(pFilename);
+    for (wchar_t &c : key) {
+      if (c == L'\\')
+        c = L'/';
+    }
+    return key;
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcIncludeCache)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeCache>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(IDxcIncludeHandler *pHandler,
+                                       LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    if (pHandler == nullptr || pFilename == nullptr ||
+        ppIncludeSource == nullptr)
+      return E_INVALIDARG;
+    *ppIncludeSource = nullptr;
+
+    // Cached blobs outlive the compile that loaded them, so they must not
+    // come from the compile's allocator.
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      Entry entry;
+      entry.HasStamp = false;
+      entry.Stamp = 0;
+      CComPtr<IDxcIncludeStamp> pStamp;
+      if (SUCCEEDED(pHandler->QueryInterface(&pStamp)))
+        entry.HasStamp = pStamp->GetSourceStamp(pFilename, &entry.Stamp) == S_OK;
+
+      std::wstring key = GetKey(pFilename);
+      {
+        sys::ScopedReader L(m_lock);
+        auto it = m_files.find(key);
+        if (it != m_files.end() && it->second.HasStamp == entry.HasStamp &&
+            it->second.Stamp == entry.Stamp)
+          return it->second.Blob.QueryInterface(ppIncludeSource);
+      }
+
+      // Failed loads are not remembered, so each compile reports its own error.
+      CComPtr<IDxcBlob> pBlob;
+      IFR(pHandler->LoadSource(pFilename, &pBlob));
+      if (!pBlob)
+        return S_OK;
+      IFR(DxcGetBlobAsUtf8(pBlob, m_pMalloc, &entry.Blob));
+      IFR(entry.Blob.QueryInterface(ppIncludeSource));
+
+      sys::ScopedWriter L(m_lock);
+      m_files[key] = std::move(entry);
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT STDMETHODCALLTYPE Invalidate(LPCWSTR pFilename) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      sys::ScopedWriter L(m_lock);
+      if (pFilename == nullptr)
+        m_files.clear();
+      else
+        m_files.erase(GetKey(pFilename));
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+class DxcCachedIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeCache> m_pCache;
+  CComPtr<IDxcIncludeHandler> m_pInner;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcCachedIncludeHandler)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  void Init(IDxcIncludeCache *pCache, IDxcIncludeHandler *pInner) {
+    m_pCache = pCache;
+    m_pInner = pInner;
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    return m_pCache->LoadSource(m_pInner, pFilename, ppIncludeSource);
+  }
+};
+
+} // namespace
+
+HRESULT CreateIncludeCache(IMalloc *pMalloc, IDxcIncludeCache **ppCache) {
+  if (ppCache == nullptr)
+    return E_INVALIDARG;
+  *ppCache = nullptr;
+  CComPtr<DxcIncludeCache> pCache = DxcIncludeCache::Alloc(pMalloc);
+  IFROOM(pCache.p);
+  *ppCache = pCache.Detach();
+  return S_OK;
+}
+
+HRESULT CreateCachedIncludeHandler(IMalloc *pMalloc, IDxcIncludeCache *pCache,
+                                   IDxcIncludeHandler *pInner,
+                                   IDxcIncludeHandler **ppHandler) {
+  if (pCache == nullptr || pInner == nullptr || ppHandler == nullptr)
+    return E_INVALIDARG;
+  *ppHandler = nullptr;
+  CComPtr<DxcCachedIncludeHandler> pHandler =
+      DxcCachedIncludeHandler::Alloc(pMalloc);
+  IFROOM(pHandler.p);
+  pHandler->Init(pCache, pInner);
+  *ppHandler = pHandler.Detach();
+  return S_OK;
+}
+
+} // namespace dxcutil
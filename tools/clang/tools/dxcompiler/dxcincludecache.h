@@ -0,0 +1,30 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcincludecache.h                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the include cache shared between compiles.                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+
+namespace dxcutil {
+
+HRESULT CreateIncludeCache(_In_ IMalloc *pMalloc,
+                           _COM_Outptr_ IDxcIncludeCache **ppCache);
+
+// Creates a handler for a single compile that loads every file through
+// pCache, falling back to pInner on a miss.
+HRESULT CreateCachedIncludeHandler(_In_ IMalloc *pMalloc,
+                                   _In_ IDxcIncludeCache *pCache,
+                                   _In_ IDxcIncludeHandler *pInner,
+                                   _COM_Outptr_ IDxcIncludeHandler **ppHandler);
+
+} // namespace dxcutil
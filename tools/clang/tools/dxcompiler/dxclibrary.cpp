@@ -16,11 +16,13 @@
 #include "llvm/Support/MSFileSystem.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/DxcThreadPool.h"
 
 #include "dxc/dxcapi.internal.h"
 #include "dxc/dxctools.h"
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/DXIL/DxilPDB.h"
+#include "dxcshaderarchive.h"
 
 #include <unordered_set>
 #include <vector>
@@ -218,7 +220,8 @@ public:
     _In_ IDxcBlob *pBlob, _COM_Outptr_ IDxcBlobEncoding **pBlobEncoding) override;
 };
 
-class DxcUtils : public IDxcUtils {
+class DxcUtils : public IDxcUtils, public IDxcShaderArchiveUtils,
+                 public IDxcTaskScheduling {
   friend class DxcLibrary;
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
@@ -229,7 +232,8 @@ public:
   DXC_MICROCOM_TM_ALLOC(DxcUtils)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    HRESULT hr = DoBasicQueryInterface<IDxcUtils>(this, iid, ppvObject);
+    HRESULT hr = DoBasicQueryInterface<IDxcUtils, IDxcShaderArchiveUtils,
+                                       IDxcTaskScheduling>(this, iid, ppvObject);
     if (FAILED(hr)) {
       return DoBasicQueryInterface<IDxcLibrary>(&m_Library, iid, ppvObject);
     }
@@ -516,6 +520,43 @@ public:
     CATCH_CPP_RETURN_HRESULT();
   }
 
+  // IDxcTaskScheduling
+  HRESULT STDMETHODCALLTYPE SetTaskExecutor(
+    _In_opt_ IDxcTaskExecutor *pExecutor) override {
+    hlsl::DxcThreadPool::SetHostExecutor(pExecutor);
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE SetMaxThreadCount(
+    _In_ UINT32 maxThreadCount) override {
+    hlsl::DxcThreadPool::SetMaxThreadCount(maxThreadCount);
+    return S_OK;
+  }
+
+  // IDxcShaderArchiveUtils
+  HRESULT STDMETHODCALLTYPE WriteShaderArchive(
+    _In_count_(count) IDxcBlob **ppContainers, _In_opt_count_(count) LPCWSTR *pNames,
+    UINT32 count, _COM_Outptr_ IDxcBlob **ppArchive) override {
+    return dxcutil::WriteShaderArchive(m_pMalloc, ppContainers, pNames, count, ppArchive);
+  }
+
+  HRESULT STDMETHODCALLTYPE OpenShaderArchive(
+    _In_z_ LPCWSTR pFileName, _COM_Outptr_ IDxcShaderArchive **ppResult) override {
+    if (ppResult == nullptr)
+      return E_POINTER;
+    *ppResult = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      CComPtr<IDxcBlobEncoding> pArchive;
+      IFR(::hlsl::DxcCreateBlobFromFileMapped(m_pMalloc, pFileName, nullptr, &pArchive));
+      return dxcutil::LoadShaderArchive(m_pMalloc, pArchive, ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  HRESULT STDMETHODCALLTYPE LoadShaderArchive(
+    _In_ IDxcBlob *pArchive, _COM_Outptr_ IDxcShaderArchive **ppResult) override {
+    return dxcutil::LoadShaderArchive(m_pMalloc, pArchive, ppResult);
+  }
 };
 
 //////////////////////////////////////////////////////////////
@@ -20,8 +20,11 @@
 #include "dxillib.h"
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include <algorithm>
+#include <map>
 
+#include "dxc/DXIL/DxilModule.h"
 #include "dxc/HLSL/DxilLinker.h"
 #include "dxc/HLSL/DxilValidation.h"
 #include "dxc/Support/Unicode.h"
@@ -43,7 +46,10 @@ using namespace llvm;
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
-class DxcLinker : public IDxcLinker, public IDxcContainerEvent {
+class DxcLinker : public IDxcLinker,
+                  public IDxcLinkerIncremental,
+                  public IDxcPipelineLinker,
+                  public IDxcContainerEvent {
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcLinker)
@@ -69,6 +75,20 @@ public:
           *ppResult // Linker output status, buffer, and errors
   ) override;
 
+  HRESULT STDMETHODCALLTYPE UpdateLibrary(_In_ LPCWSTR pLibName,
+                                          _In_ IDxcBlob *pLib) override;
+
+  HRESULT STDMETHODCALLTYPE ClearLinkCache() override {
+    DxcThreadMalloc TM(m_pMalloc);
+    m_linkCache.clear();
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE LinkStages(
+      _In_ IDxcBlob *pProducer, _In_ IDxcBlob *pConsumer,
+      _COM_Outptr_ IDxcOperationResult **ppProducerResult,
+      _COM_Outptr_ IDxcOperationResult **ppConsumerResult) override;
+
   HRESULT STDMETHODCALLTYPE RegisterDxilContainerEventHandler(
       IDxcContainerEventsHandler *pHandler, UINT64 *pCookie) override {
     DxcThreadMalloc TM(m_pMalloc);
@@ -88,13 +108,16 @@ public:
   }
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcLinker>(this, riid, ppvObject);
+    return DoBasicQueryInterface<IDxcLinker, IDxcLinkerIncremental,
+                                 IDxcPipelineLinker>(this, riid, ppvObject);
   }
 
   void Initialize() {
     UINT32 valMajor, valMinor;
     dxcutil::GetValidatorVersion(&valMajor, &valMinor);
     m_pLinker.reset(DxilLinker::CreateLinker(m_Ctx, valMajor, valMinor));
+    m_valMajor = valMajor;
+    m_valMinor = valMinor;
   }
 
   ~DxcLinker() {
@@ -103,13 +126,82 @@ public:
   }
 
 private:
+  // An entry linked earlier, and the functions it was linked from.
+  struct LinkCacheEntry {
+    CComPtr<IDxcBlob> pContainer;
+    CComPtr<IStream> pDiagStream;
+    std::vector<DxilLinkDependency> Dependencies;
+  };
+
+  HRESULT LoadLib(IDxcBlob *pBlob, std::unique_ptr<llvm::Module> &pModule,
+                  std::unique_ptr<llvm::Module> &pDebugModule,
+                  llvm::StringMap<uint64_t> &functionHashes);
+
   DXC_MICROCOM_TM_REF_FIELDS()
   LLVMContext m_Ctx;
   std::unique_ptr<DxilLinker> m_pLinker;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
-  std::vector<CComPtr<IDxcBlob>> m_blobs; // Keep blobs live for lazy load.
+  // Keep blobs live for lazy load, by library name.
+  llvm::StringMap<CComPtr<IDxcBlob>> m_blobs;
+  // Validator version the linker currently targets.
+  unsigned m_valMajor = 0, m_valMinor = 0;
+  // Keyed on the validator version and every argument to Link.
+  std::map<std::wstring, LinkCacheEntry> m_linkCache;
 };
 
+// Reads the function hash part of a library container, if it has a well
+// formed one; a library without one is linked without merging.
+static void ReadFunctionHashes(IDxcBlob *pBlob,
+                               llvm::StringMap<uint64_t> &functionHashes) {
+  const DxilContainerHeader *pContainer = IsDxilContainerLike(
+      pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+  if (!pContainer ||
+      !IsValidDxilContainer(pContainer, pBlob->GetBufferSize()))
+    return;
+  const DxilPartHeader *pPart =
+      GetDxilPartByType(pContainer, DFCC_FunctionHashes);
+  if (!pPart || pPart->PartSize < sizeof(DxilFunctionHashHeader))
+    return;
+  const char *pData = GetDxilPartData(pPart);
+  const DxilFunctionHashHeader *pHeader =
+      reinterpret_cast<const DxilFunctionHashHeader *>(pData);
+  uint64_t entriesEnd = sizeof(DxilFunctionHashHeader) +
+                        (uint64_t)pHeader->FunctionCount *
+                            sizeof(DxilFunctionHashEntry);
+  if (entriesEnd > pPart->PartSize)
+    return;
+  const DxilFunctionHashEntry *pEntries =
+      reinterpret_cast<const DxilFunctionHashEntry *>(pHeader + 1);
+  llvm::StringMap<uint64_t> hashes;
+  for (uint32_t i = 0; i < pHeader->FunctionCount; ++i) {
+    const DxilFunctionHashEntry &entry = pEntries[i];
+    if ((uint64_t)entry.NameOffset + entry.NameLength >= pPart->PartSize)
+      return;
+    hashes[llvm::StringRef(pData + entry.NameOffset, entry.NameLength)] =
+        entry.Hash;
+  }
+  functionHashes = std::move(hashes);
+}
+
+HRESULT DxcLinker::LoadLib(IDxcBlob *pBlob,
+                           std::unique_ptr<llvm::Module> &pModule,
+                           std::unique_ptr<llvm::Module> &pDebugModule,
+                           llvm::StringMap<uint64_t> &functionHashes) {
+  CComPtr<IMalloc> pMalloc;
+  CComPtr<AbstractMemoryStream> pDiagStream;
+
+  IFT(CoGetMalloc(1, &pMalloc));
+  IFT(CreateMemoryStream(pMalloc, &pDiagStream));
+
+  raw_stream_ostream DiagStream(pDiagStream);
+
+  IFR(ValidateLoadModuleFromContainerLazy(
+      pBlob->GetBufferPointer(), pBlob->GetBufferSize(), pModule,
+      pDebugModule, m_Ctx, m_Ctx, DiagStream));
+  ReadFunctionHashes(pBlob, functionHashes);
+  return S_OK;
+}
+
 HRESULT
 DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
                            _In_ IDxcBlob *pBlob       // Library to add.
@@ -126,22 +218,13 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
 
   try {
     std::unique_ptr<llvm::Module> pModule, pDebugModule;
-
-    CComPtr<IMalloc> pMalloc;
-    CComPtr<AbstractMemoryStream> pDiagStream;
-
-    IFT(CoGetMalloc(1, &pMalloc));
-    IFT(CreateMemoryStream(pMalloc, &pDiagStream));
-
-    raw_stream_ostream DiagStream(pDiagStream);
-
-    IFR(ValidateLoadModuleFromContainerLazy(
-        pBlob->GetBufferPointer(), pBlob->GetBufferSize(), pModule,
-        pDebugModule, m_Ctx, m_Ctx, DiagStream));
+    llvm::StringMap<uint64_t> functionHashes;
+    IFR(LoadLib(pBlob, pModule, pDebugModule, functionHashes));
 
     if (m_pLinker->RegisterLib(pUtf8LibName.m_psz, std::move(pModule),
                                std::move(pDebugModule))) {
-      m_blobs.emplace_back(pBlob);
+      m_pLinker->SetLibFunctionHashes(pUtf8LibName.m_psz, functionHashes);
+      m_blobs[pUtf8LibName.m_psz] = pBlob;
       return S_OK;
     } else {
       return E_INVALIDARG;
@@ -151,6 +234,46 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
   }
 }
 
+HRESULT STDMETHODCALLTYPE
+DxcLinker::UpdateLibrary(_In_ LPCWSTR pLibName, // Name of the library.
+                         _In_ IDxcBlob *pBlob    // New library blob.
+) {
+  if (!pLibName || !pBlob)
+    return E_INVALIDARG;
+  DXASSERT(m_pLinker.get(), "else Initialize() not called or failed silently");
+  DxcThreadMalloc TM(m_pMalloc);
+  std::string libName;
+  HRESULT hr = S_OK;
+  try {
+    libName = CW2A(pLibName, CP_UTF8).m_psz;
+    if (!m_pLinker->HasLibNameRegistered(libName))
+      return E_INVALIDARG;
+
+    // Load the new library first, so that a bad blob leaves the old one.
+    std::unique_ptr<llvm::Module> pModule, pDebugModule;
+    llvm::StringMap<uint64_t> functionHashes;
+    IFR(LoadLib(pBlob, pModule, pDebugModule, functionHashes));
+
+    // Cached entries are not dropped; Link checks their functions against
+    // the new library.
+    m_pLinker->UnregisterLib(libName);
+    if (m_pLinker->RegisterLib(libName, std::move(pModule),
+                               std::move(pDebugModule))) {
+      m_pLinker->SetLibFunctionHashes(libName, functionHashes);
+      m_blobs[libName] = pBlob;
+      return S_OK;
+    }
+    hr = E_INVALIDARG;
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+
+  // The old library may already be gone; keep the blobs in step with what
+  // is registered.
+  if (!libName.empty() && !m_pLinker->HasLibNameRegistered(libName))
+    m_blobs.erase(libName);
+  return hr;
+}
+
 // Links the shader and produces a shader blob that the Direct3D runtime can
 // use.
 HRESULT STDMETHODCALLTYPE DxcLinker::Link(
@@ -215,6 +338,8 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
     if (opts.ValVerMajor != UINT32_MAX) {
       m_pLinker->SetValidatorVersion(opts.ValVerMajor, opts.ValVerMinor);
+      m_valMajor = opts.ValVerMajor;
+      m_valMinor = opts.ValVerMinor;
     }
 
     bool needsValidation = !opts.DisableValidation;
@@ -235,11 +360,61 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
     dxilutil::ExportMap exportMap;
     bSuccess = exportMap.ParseExports(opts.Exports, DiagStream);
+    if (bSuccess && !opts.ExportsFile.empty()) {
+      CA2W pUtf16ExportsFile(opts.ExportsFile.str().c_str(), CP_UTF8);
+      CComHeapPtr<char> pExportList;
+      DWORD exportListSize = 0;
+      try {
+        ReadBinaryFile(pUtf16ExportsFile, (void **)&pExportList,
+                       &exportListSize);
+        bSuccess = exportMap.ParseExportList(
+            StringRef(pExportList, exportListSize), DiagStream);
+      } catch (const hlsl::Exception &) {
+        DiagStream << "Cannot read -exports-file '" << opts.ExportsFile
+                   << "'.";
+        bSuccess = false;
+      }
+    }
+    m_pLinker->SetSpecializations(opts.Specializations);
+
+    // An events handler may rewrite the container, and an export list file
+    // may change between links, so those links are always redone.
+    std::wstring cacheKey;
+    bool bCacheable = bSuccess && m_pDxcContainerEventsHandler == nullptr &&
+                      opts.ExportsFile.empty();
+    if (bCacheable) {
+      cacheKey = std::to_wstring(m_valMajor) + L'.' +
+                 std::to_wstring(m_valMinor) + L'\0';
+      cacheKey += pEntryName ? pEntryName : L"";
+      cacheKey += L'\0';
+      cacheKey += pTargetProfile;
+      for (unsigned i = 0; i < libCount; i++) {
+        cacheKey += L'\0';
+        cacheKey += pLibNames[i];
+      }
+      cacheKey += L'\1';
+      for (unsigned i = 0; i < argCount; i++) {
+        cacheKey += pArguments[i];
+        cacheKey += L'\0';
+      }
+      auto it = m_linkCache.find(cacheKey);
+      if (it != m_linkCache.end()) {
+        if (m_pLinker->IsLinkCurrent(it->second.Dependencies)) {
+          dxcutil::CreateOperationResultFromOutputs(
+              it->second.pContainer, it->second.pDiagStream, warnings,
+              /*hasErrorOccurred*/ false, ppResult);
+          return S_OK;
+        }
+        m_linkCache.erase(it);
+      }
+    }
 
     bool hasErrorOccurred = !bSuccess;
     if (bSuccess) {
+      std::vector<DxilLinkDependency> Dependencies;
       std::unique_ptr<Module> pM = m_pLinker->Link(
-          opts.EntryPoint, pUtf8TargetProfile.m_psz, exportMap);
+          opts.EntryPoint, pUtf8TargetProfile.m_psz, exportMap,
+          bCacheable ? &Dependencies : nullptr);
       if (pM) {
         const IntrusiveRefCntPtr<clang::DiagnosticIDs> Diags(
             new clang::DiagnosticIDs);
@@ -266,6 +441,16 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
         if (opts.DebugNameForSource) {
           SerializeFlags |= SerializeDxilFlags::DebugNameDependOnSource;
         }
+        // A linked library is linked again in turn.
+        if (opts.IsLibraryProfile()) {
+          SerializeFlags |= SerializeDxilFlags::IncludeFunctionHashPart;
+        }
+        if (opts.FastShaderHash) {
+          SerializeFlags |= SerializeDxilFlags::FastShaderHash;
+        }
+        if (opts.CompressDebug) {
+          SerializeFlags |= SerializeDxilFlags::CompressDebugInfoPart;
+        }
         // Validation.
         HRESULT valHR = S_OK;
         dxcutil::AssembleInputs inputs(
@@ -292,6 +477,14 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
         hasErrorOccurred = Diag.hasErrorOccurred();
 
+        // Only entries are tracked; library links have no dependencies.
+        if (SUCCEEDED(valHR) && !hasErrorOccurred && !Dependencies.empty()) {
+          LinkCacheEntry &Entry = m_linkCache[cacheKey];
+          Entry.pContainer = pOutputBlob;
+          Entry.pDiagStream = pDiagStream;
+          Entry.Dependencies = std::move(Dependencies);
+        }
+
       } else {
         hasErrorOccurred = true;
       }
@@ -305,6 +498,105 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
   return hr;
 }
 
+// Loads a stage's module from its container, keeping its root signature so
+// that it is serialized again.
+static HRESULT LoadStage(IDxcBlob *pBlob, std::unique_ptr<llvm::Module> &pModule,
+                         LLVMContext &Ctx, raw_ostream &DiagStream) {
+  std::unique_ptr<llvm::Module> pDebugModule;
+  IFR(ValidateLoadModuleFromContainer(pBlob->GetBufferPointer(),
+                                      pBlob->GetBufferSize(), pModule,
+                                      pDebugModule, Ctx, Ctx, DiagStream));
+  const DxilContainerHeader *pContainer = IsDxilContainerLike(
+      pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+  const DxilPartHeader *pPart =
+      pContainer ? GetDxilPartByType(pContainer, DFCC_RootSignature) : nullptr;
+  if (pPart) {
+    const uint8_t *pData = (const uint8_t *)GetDxilPartData(pPart);
+    std::vector<uint8_t> RootSignature(pData, pData + pPart->PartSize);
+    pModule->GetOrCreateDxilModule().ResetSerializedRootSignature(
+        RootSignature);
+  }
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcLinker::LinkStages(
+    _In_ IDxcBlob *pProducer, _In_ IDxcBlob *pConsumer,
+    _COM_Outptr_ IDxcOperationResult **ppProducerResult,
+    _COM_Outptr_ IDxcOperationResult **ppConsumerResult) {
+  if (!pProducer || !pConsumer || !ppProducerResult || !ppConsumerResult)
+    return E_INVALIDARG;
+  *ppProducerResult = nullptr;
+  *ppConsumerResult = nullptr;
+  DxcThreadMalloc TM(m_pMalloc);
+
+  HRESULT hr = S_OK;
+  try {
+    CComPtr<IMalloc> pMalloc;
+    CComPtr<AbstractMemoryStream> pDiagStream;
+    IFT(CoGetMalloc(1, &pMalloc));
+    IFT(CreateMemoryStream(pMalloc, &pDiagStream));
+    raw_stream_ostream DiagStream(pDiagStream);
+
+    // The stages are loaded into their own context, so that nothing is left
+    // behind in the one shared with registered libraries.
+    LLVMContext Ctx;
+    llvm::DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+    PrintDiagnosticContext DiagContext(DiagPrinter);
+    Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
+                             &DiagContext, true);
+
+    std::unique_ptr<llvm::Module> pModules[2];
+    CComPtr<IDxcBlob> pOutputBlobs[2];
+    bool hasErrorOccurred =
+        FAILED(LoadStage(pProducer, pModules[0], Ctx, DiagStream)) ||
+        FAILED(LoadStage(pConsumer, pModules[1], Ctx, DiagStream)) ||
+        !LinkPipelineStages(*pModules[0], *pModules[1]) ||
+        DiagContext.HasErrors();
+
+    if (!hasErrorOccurred) {
+      const IntrusiveRefCntPtr<clang::DiagnosticIDs> Diags(
+          new clang::DiagnosticIDs);
+      IntrusiveRefCntPtr<clang::DiagnosticOptions> DiagOpts =
+          new clang::DiagnosticOptions();
+      clang::TextDiagnosticPrinter *DiagClient =
+          new clang::TextDiagnosticPrinter(DiagStream, &*DiagOpts);
+      clang::DiagnosticsEngine Diag(Diags, &*DiagOpts, DiagClient);
+
+      for (unsigned i = 0; i < 2 && !hasErrorOccurred; ++i) {
+        CComPtr<AbstractMemoryStream> pOutputStream;
+        IFT(CreateMemoryStream(pMalloc, &pOutputStream));
+        raw_stream_ostream outStream(pOutputStream.p);
+        WriteBitcodeToFile(pModules[i].get(), outStream);
+        outStream.flush();
+
+        // Debug info no longer matches the relinked code, so it is dropped.
+        dxcutil::AssembleInputs inputs(
+            std::move(pModules[i]), pOutputBlobs[i], pMalloc,
+            SerializeDxilFlags::None, pOutputStream, /*bDebugInfo*/ false,
+            StringRef(), &Diag);
+        HRESULT valHR = dxcutil::ValidateAndAssembleToContainer(inputs);
+        hasErrorOccurred = FAILED(valHR) || Diag.hasErrorOccurred();
+      }
+    }
+
+    DiagStream.flush();
+    CComPtr<IStream> pStream = pDiagStream;
+    std::string warnings;
+    if (hasErrorOccurred) {
+      pOutputBlobs[0].Release();
+      pOutputBlobs[1].Release();
+    }
+    dxcutil::CreateOperationResultFromOutputs(pOutputBlobs[0], pStream,
+                                              warnings, hasErrorOccurred,
+                                              ppProducerResult);
+    dxcutil::CreateOperationResultFromOutputs(pOutputBlobs[1], pStream,
+                                              warnings, hasErrorOccurred,
+                                              ppConsumerResult);
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+  return hr;
+}
+
 HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv) {
   *ppv = nullptr;
   try {
@@ -19,12 +19,15 @@
 #include "clang/Lex/HLSLMacroExpander.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Frontend/Utils.h"
 #include "clang/Sema/SemaHLSL.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/ADT/StringExtras.h"
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/CodeGen/CodeGenAction.h"
 #include "llvm/IR/LLVMContext.h"
 #include "dxc/Support/WinIncludes.h"
+#include "dxc/HLSL/DxilShaderStatistics.h"
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include "dxcutil.h"
@@ -42,13 +45,24 @@
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/Support/DxcLangExtensionsHelper.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/DxcCompileDeadline.h"
+#include "dxc/Support/DxcSourceStore.h"
 #ifdef _WIN32
 #include "dxcetw.h"
 #endif
 #include "dxillib.h"
 #include "dxcompileradapter.h"
+#include "dxccompilecache.h"
+#include "dxcbatchcompile.h"
+#include "dxcincludecache.h"
+#include "dxctimeprofile.h"
+#include "dxccancellation.h"
+#include "dxcasynccompile.h"
+#include "dxccontextpool.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include <algorithm>
 #include <cfloat>
+#include <thread>
 
 // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
@@ -102,6 +116,37 @@ static void CreateOperationResultFromOutputs(
                                    ppResult);
 }
 
+// Adds the files that the debug info refers to by digest to the store; these
+// are the files CodeGen would otherwise embed, other than the main file.
+// Returns false, after reporting an error, if a file could not be added.
+static bool AddIncludedSourcesToStore(CompilerInstance &compiler,
+                                      IDxcSourceStore *pStore) {
+  const std::string &MainFileName = compiler.getCodeGenOpts().MainFileName;
+  SourceManager &SM = compiler.getSourceManager();
+  for (SourceManager::fileinfo_iterator it = SM.fileinfo_begin(),
+                                        end = SM.fileinfo_end();
+       it != end; ++it) {
+    if (!it->first->isValid() || it->second->IsSystemFile ||
+        MainFileName.compare(it->first->getName()) == 0)
+      continue;
+    StringRef Contents = it->second->getRawBuffer()->getBuffer();
+    CComPtr<IDxcBlobEncoding> pSource;
+    IFT(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(
+        Contents.data(), (UINT32)Contents.size(), CP_UTF8, &pSource));
+    HRESULT hr = pStore->AddSource(pSource);
+    if (FAILED(hr)) {
+      DiagnosticsEngine &Diags = compiler.getDiagnostics();
+      unsigned ID = Diags.getCustomDiagID(
+          DiagnosticsEngine::Error,
+          "cannot add '%0' to the source store (error 0x%1)");
+      Diags.Report(ID) << it->first->getName()
+                       << llvm::utohexstr((uint32_t)hr);
+      return false;
+    }
+  }
+  return true;
+}
+
 static bool ShouldPartBeIncludedInPDB(UINT32 FourCC) {
   switch (FourCC) {
   case hlsl::DFCC_ShaderDebugName:
@@ -111,7 +156,7 @@ static bool ShouldPartBeIncludedInPDB(UINT32 FourCC) {
   return false;
 }
 
-static HRESULT CreateContainerForPDB(IMalloc *pMalloc, IDxcBlob *pOldContainer, IDxcBlob *pDebugBlob, IDxcBlob **ppNewContaner) {
+static HRESULT CreateContainerForPDB(IMalloc *pMalloc, IDxcBlob *pOldContainer, IDxcBlob *pDebugBlob, bool bCompressDebug, IDxcBlob **ppNewContaner) {
   // If the pContainer is not a valid container, give up.
   if (!hlsl::IsValidDxilContainer((hlsl::DxilContainerHeader *)pOldContainer->GetBufferPointer(), pOldContainer->GetBufferSize()))
     return E_FAIL;
@@ -178,30 +223,60 @@ static HRESULT CreateContainerForPDB(IMalloc *pMalloc, IDxcBlob *pOldContainer,
     UINT32 uPaddingSize = 0;
     UINT32 uPartSize = AlignByDword(sizeof(hlsl::DxilProgramHeader) + pDebugBlob->GetBufferSize(), &uPaddingSize);
 
-    OffsetTable.push_back(uTotalPartsSize);
-    uTotalPartsSize += uPartSize + sizeof(hlsl::DxilPartHeader);
-
-    Part NewPart(
-      hlsl::DFCC_ShaderDebugInfoDXIL,
-      uPartSize,
-      [uPartSize, ProgramHeader, pDebugBlob, uPaddingSize](IStream *pStream) {
-        hlsl::DxilProgramHeader Header = *ProgramHeader;
-        Header.BitcodeHeader.BitcodeSize = pDebugBlob->GetBufferSize();
-        Header.BitcodeHeader.BitcodeOffset = sizeof(hlsl::DxilBitcodeHeader);
-        Header.SizeInUint32 = uPartSize / sizeof(UINT32);
-
-        ULONG uBytesWritten = 0;
-        IFR(pStream->Write(&Header, sizeof(Header), &uBytesWritten));
-        IFR(pStream->Write(pDebugBlob->GetBufferPointer(), pDebugBlob->GetBufferSize(), &uBytesWritten));
-        if(uPaddingSize) {
-          UINT32 uPadding = 0;
-          assert(uPaddingSize <= sizeof(uPadding) && "Padding size calculation is wrong.");
-          IFR(pStream->Write(&uPadding, uPaddingSize, &uBytesWritten));
+    hlsl::DxilProgramHeader Header = *ProgramHeader;
+    Header.BitcodeHeader.BitcodeSize = pDebugBlob->GetBufferSize();
+    Header.BitcodeHeader.BitcodeOffset = sizeof(hlsl::DxilBitcodeHeader);
+    Header.SizeInUint32 = uPartSize / sizeof(UINT32);
+
+    // A compressed part is built whole up front, as its size depends on it.
+    std::shared_ptr<std::vector<char>> pCompressedPart;
+    if (bCompressDebug) {
+      std::vector<char> DebugPart(uPartSize, 0);
+      memcpy(DebugPart.data(), &Header, sizeof(Header));
+      memcpy(DebugPart.data() + sizeof(Header), pDebugBlob->GetBufferPointer(),
+             pDebugBlob->GetBufferSize());
+      pCompressedPart = std::make_shared<std::vector<char>>();
+      if (!hlsl::CompressDxilDebugPartData(DebugPart.data(), uPartSize,
+                                           *pCompressedPart))
+        pCompressedPart.reset();
+    }
+
+    if (pCompressedPart) {
+      UINT32 uCompressedSize = (UINT32)pCompressedPart->size();
+      OffsetTable.push_back(uTotalPartsSize);
+      uTotalPartsSize += uCompressedSize + sizeof(hlsl::DxilPartHeader);
+
+      Part NewPart(
+        hlsl::DFCC_CompressedShaderDebugInfoDXIL,
+        uCompressedSize,
+        [pCompressedPart, uCompressedSize](IStream *pStream) {
+          ULONG uBytesWritten = 0;
+          IFR(pStream->Write(pCompressedPart->data(), uCompressedSize, &uBytesWritten));
+          return S_OK;
         }
-        return S_OK;
-      }
-    );
-    PartWriters.push_back(NewPart);
+      );
+      PartWriters.push_back(NewPart);
+    } else {
+      OffsetTable.push_back(uTotalPartsSize);
+      uTotalPartsSize += uPartSize + sizeof(hlsl::DxilPartHeader);
+
+      Part NewPart(
+        hlsl::DFCC_ShaderDebugInfoDXIL,
+        uPartSize,
+        [Header, pDebugBlob, uPaddingSize](IStream *pStream) {
+          ULONG uBytesWritten = 0;
+          IFR(pStream->Write(&Header, sizeof(Header), &uBytesWritten));
+          IFR(pStream->Write(pDebugBlob->GetBufferPointer(), pDebugBlob->GetBufferSize(), &uBytesWritten));
+          if(uPaddingSize) {
+            UINT32 uPadding = 0;
+            assert(uPaddingSize <= sizeof(uPadding) && "Padding size calculation is wrong.");
+            IFR(pStream->Write(&uPadding, uPaddingSize, &uBytesWritten));
+          }
+          return S_OK;
+        }
+      );
+      PartWriters.push_back(NewPart);
+    }
   }
 
   // Offset the offset table by the offset table itself
@@ -220,6 +295,7 @@ static HRESULT CreateContainerForPDB(IMalloc *pMalloc, IDxcBlob *pOldContainer,
   ULONG uSizeWritten = 0;
   CComPtr<hlsl::AbstractMemoryStream> pStrippedContainerStream;
   IFR(hlsl::CreateMemoryStream(pMalloc, &pStrippedContainerStream));
+  IFR(pStrippedContainerStream->Reserve(NewDxilHeader.ContainerSizeInBytes));
   IFR(pStrippedContainerStream->Write(&NewDxilHeader, sizeof(NewDxilHeader), &uSizeWritten));
 
   // Write offset table
@@ -376,6 +452,41 @@ public:
   }
 };
 
+// Collects the files a compile reads, for -M and -MD. Headers found through
+// -I are system headers to clang, but are as much a part of the build.
+class DxcDependencyCollector : public DependencyCollector {
+public:
+  bool needSystemDependencies() override { return true; }
+  bool sawDependency(StringRef Filename, bool FromModule, bool IsSystem,
+                     bool IsModuleFile, bool IsMissing) override {
+    return !IsMissing &&
+           DependencyCollector::sawDependency(Filename, FromModule, IsSystem,
+                                              IsModuleFile, IsMissing);
+  }
+};
+
+static void WriteMakeDependencyPath(raw_ostream &OS, StringRef Path) {
+  for (char C : Path) {
+    if (C == ' ' || C == '#')
+      OS << '\\';
+    else if (C == '$')
+      OS << '$';
+    OS << C;
+  }
+}
+
+// Writes a make rule, which ninja reads as a depfile as well.
+static void WriteMakeDependencies(raw_ostream &OS, StringRef Target,
+                                  ArrayRef<std::string> Files) {
+  WriteMakeDependencyPath(OS, Target);
+  OS << ':';
+  for (const std::string &File : Files) {
+    OS << " \\\n  ";
+    WriteMakeDependencyPath(OS, File);
+  }
+  OS << '\n';
+}
+
 static void CreateDefineStrings(
     _In_count_(defineCount) const DxcDefine *pDefines,
     UINT defineCount,
@@ -391,9 +502,59 @@ static void CreateDefineStrings(
   }
 }
 
+// Copies every output of pSource into new blobs on the thread allocator, so
+// that nothing in the copy refers to memory owned by pSource's allocators.
+static HRESULT CopyResultOutputs(_In_ IDxcResult *pSource,
+                                 _COM_Outptr_ IDxcResult **ppCopy) {
+  *ppCopy = nullptr;
+  HRESULT status;
+  IFR(pSource->GetStatus(&status));
+  std::vector<DxcOutputObject> outputs;
+  for (unsigned i = DXC_OUT_NONE + 1; i <= kNumDxcOutputTypes; ++i) {
+    DXC_OUT_KIND kind = (DXC_OUT_KIND)i;
+    if (!pSource->HasOutput(kind))
+      continue;
+    CComPtr<IDxcBlob> pBlob;
+    CComPtr<IDxcBlobUtf16> pName;
+    IFR(pSource->GetOutput(kind, IID_PPV_ARGS(&pBlob), &pName));
+    DxcOutputObject output;
+    output.kind = kind;
+    if (pBlob) {
+      CComPtr<IDxcBlobEncoding> pEncoding;
+      BOOL known = FALSE;
+      UINT32 codePage = 0;
+      if (SUCCEEDED(pBlob.QueryInterface(&pEncoding)))
+        IFR(pEncoding->GetEncoding(&known, &codePage));
+      CComPtr<IDxcBlobEncoding> pCopy;
+      IFR(hlsl::DxcCreateBlob(pBlob->GetBufferPointer(), pBlob->GetBufferSize(),
+                              false, true, known != FALSE, codePage, nullptr,
+                              &pCopy));
+      output.object = pCopy;
+    }
+    if (pName) {
+      CComPtr<IDxcBlobEncoding> pNameCopy;
+      IFR(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(
+          pName->GetBufferPointer(), (UINT32)pName->GetBufferSize(),
+          DXC_CP_UTF16, &pNameCopy));
+      IFR(pNameCopy.QueryInterface(&output.name));
+    }
+    outputs.emplace_back(std::move(output));
+  }
+  return DxcResult::Create(status, pSource->PrimaryOutput(), outputs, ppCopy);
+}
+
 class DxcCompiler : public IDxcCompiler3,
                     public IDxcLangExtensions,
                     public IDxcContainerEvent,
+                    public IDxcCompileCache,
+                    public IDxcCompilerBatch,
+                    public IDxcCompilerMultiEntry,
+                    public IDxcCompilerPermutations,
+                    public IDxcCompilerIncludeCache,
+                    public IDxcCompilerCancellation,
+                    public IDxcCompilerAsync,
+                    public IDxcSourceStoreSupport,
+                    public IDxcCompilerContextPool,
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
                     public IDxcVersionInfo2
 #else
@@ -404,10 +565,123 @@ private:
   DXC_MICROCOM_TM_REF_FIELDS()
   DxcLangExtensionsHelper m_langExtensionsHelper;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
+  CComPtr<IDxcCompileCacheStore> m_pCacheStore;
+  CComPtr<IDxcIncludeCache> m_pIncludeCache;
+  CComPtr<IDxcSourceStore> m_pSourceStore;
+  dxcutil::DxcContextPool m_contextPool;
   DxcCompilerAdapter m_DxcCompilerAdapter;
+  // Runs CompileAsync calls without an executor. Each of those compiles
+  // holds a reference to the compiler, so none is left when it is destroyed.
+  std::mutex m_asyncPoolLock;
+  std::unique_ptr<hlsl::DxcThreadPool> m_pAsyncPool;
+
+  // Compiles that bypass the cache: non-codegen modes, and anything whose
+  // output depends on state that is not part of the cache key.
+  bool IsCacheableCompile(const hlsl::options::DxcOpts &opts) {
+    return opts.Preprocess.empty() && !opts.AstDump && !opts.OptDump &&
+           !opts.TimeReport && !opts.MemoryReport &&
+           !opts.CompileDeadlineFallback && !opts.ParallelVerify &&
+           !opts.OutputDependencies &&
+           opts.ExportsFile.empty() && opts.ProfileUseFile.empty() &&
+           !opts.DisplayIncludeProcess && opts.SourceStore.empty() &&
+           m_pSourceStore == nullptr &&
+           m_pDxcContainerEventsHandler == nullptr &&
+           m_langExtensionsHelper.GetIntrinsicTables().empty() &&
+           m_langExtensionsHelper.GetSemanticDefines().empty() &&
+           m_langExtensionsHelper.GetDefines().empty();
+  }
+
+  // Looks the compile up in the cache store, compiling and storing the result
+  // on a miss. Returns S_FALSE without a result when the compile is not
+  // cacheable, so the caller can compile normally.
+  HRESULT CompileWithCache(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ REFIID riid, _Out_ LPVOID *ppResult) {
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      int argCountInt;
+      IFT(UIntToInt(argCount, &argCountInt));
+      hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
+      hlsl::options::DxcOpts opts;
+      bool finished = false;
+      CComPtr<AbstractMemoryStream> pOptionErrorStream;
+      CComPtr<IDxcOperationResult> pOptionResult;
+      IFT(CreateMemoryStream(m_pMalloc, &pOptionErrorStream));
+      dxcutil::ReadOptsAndValidate(mainArgs, opts, pOptionErrorStream, &pOptionResult, finished);
+      if (finished || !IsCacheableCompile(opts))
+        return S_FALSE;
+
+      // Preprocess through the recorder to learn the includes of this
+      // compile; the real compile below replays them from the recorder.
+      CComPtr<dxcutil::DxcRecordingIncludeHandler> pRecorder =
+        dxcutil::DxcRecordingIncludeHandler::Alloc(m_pMalloc);
+      IFROOM(pRecorder.p);
+      pRecorder->Init(pIncludeHandler);
+
+      std::vector<LPCWSTR> PreprocessArgs;
+      PreprocessArgs.reserve(argCount + 2);
+      PreprocessArgs.assign(pArguments, pArguments + argCount);
+      PreprocessArgs.push_back(L"-P");
+      PreprocessArgs.push_back(L"preprocessed.hlsl");
+      CComPtr<IDxcResult> pPreprocessResult;
+      IFT(CompileUncached(pSource, PreprocessArgs.data(), PreprocessArgs.size(),
+                          pRecorder, IID_PPV_ARGS(&pPreprocessResult)));
+      HRESULT status;
+      IFT(pPreprocessResult->GetStatus(&status));
+      CComPtr<IDxcBlob> pPreprocessed;
+      if (FAILED(status) ||
+          FAILED(pPreprocessResult->GetOutput(DXC_OUT_HLSL, IID_PPV_ARGS(&pPreprocessed), nullptr))) {
+        // Let the real compile report the errors.
+        return CompileUncached(pSource, pArguments, argCount, pRecorder, riid, ppResult);
+      }
+
+      unsigned valMajor = opts.ValVerMajor, valMinor = opts.ValVerMinor;
+      if (valMajor == UINT_MAX)
+        dxcutil::GetValidatorVersion(&valMajor, &valMinor);
+      dxcutil::CompileCacheKey key;
+      dxcutil::ComputeCompileCacheKey(opts, valMajor, valMinor, pSource,
+                                      pPreprocessed, *pRecorder, key);
+      DxcBuffer keyBuffer = { key, sizeof(key), 0 };
+
+      CComPtr<IDxcBlob> pCachedValue;
+      if (m_pCacheStore->Lookup(&keyBuffer, &pCachedValue) == S_OK && pCachedValue) {
+        CComPtr<IDxcResult> pCachedResult;
+        if (SUCCEEDED(dxcutil::DeserializeCompileResult(pCachedValue, &pCachedResult)))
+          return pCachedResult->QueryInterface(riid, ppResult);
+      }
+
+      CComPtr<IDxcResult> pResult;
+      IFT(CompileUncached(pSource, pArguments, argCount, pRecorder, IID_PPV_ARGS(&pResult)));
+      IFT(pResult->GetStatus(&status));
+      if (SUCCEEDED(status)) {
+        // Failing to store only costs a later miss, so errors are ignored.
+        CComPtr<IDxcBlob> pValue;
+        if (SUCCEEDED(dxcutil::SerializeCompileResult(pResult, &pValue)))
+          m_pCacheStore->Store(&keyBuffer, pValue);
+      }
+      return pResult->QueryInterface(riid, ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
 
 public:
   DxcCompiler(IMalloc *pMalloc) : m_dwRef(0), m_pMalloc(pMalloc), m_DxcCompilerAdapter(this, pMalloc) {}
+  ~DxcCompiler() {
+    // The last reference may be released by an async compile, on a thread of
+    // the pool, which can't join itself; the pool is then torn down on a
+    // thread of its own once that compile has returned.
+    if (m_pAsyncPool && m_pAsyncPool->IsRunningTask()) {
+      hlsl::DxcThreadPool *pPool = m_pAsyncPool.release();
+      try {
+        std::thread([pPool]() { delete pPool; }).detach();
+      } catch (...) {
+        // Without a thread the pool is leaked rather than deadlocked.
+      }
+    }
+  }
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_ALLOC(DxcCompiler)
   DXC_LANGEXTENSIONS_HELPER_IMPL(m_langExtensionsHelper)
@@ -429,6 +703,15 @@ public:
       IDxcCompiler3,
       IDxcLangExtensions,
       IDxcContainerEvent,
+      IDxcCompileCache,
+      IDxcCompilerBatch,
+      IDxcCompilerMultiEntry,
+      IDxcCompilerPermutations,
+      IDxcCompilerIncludeCache,
+      IDxcCompilerCancellation,
+      IDxcCompilerAsync,
+      IDxcSourceStoreSupport,
+      IDxcCompilerContextPool,
       IDxcVersionInfo
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
       ,IDxcVersionInfo2
@@ -458,6 +741,364 @@ public:
 
     *ppResult = nullptr;
 
+    // Route includes through the include cache first, so the compile cache
+    // below still sees the contents of every file.
+    CComPtr<IDxcIncludeHandler> pCachedIncludeHandler;
+    if (m_pIncludeCache && pIncludeHandler) {
+      DxcThreadMalloc TM(m_pMalloc);
+      IFR(dxcutil::CreateCachedIncludeHandler(m_pMalloc, m_pIncludeCache,
+                                              pIncludeHandler,
+                                              &pCachedIncludeHandler));
+      pIncludeHandler = pCachedIncludeHandler;
+    }
+
+    if (m_pCacheStore) {
+      HRESULT hr = CompileWithCache(pSource, pArguments, argCount,
+                                    pIncludeHandler, riid, ppResult);
+      if (hr != S_FALSE)
+        return hr;
+    }
+    return CompileUncached(pSource, pArguments, argCount, pIncludeHandler,
+                           riid, ppResult);
+  }
+
+  // IDxcCompileCache
+  HRESULT STDMETHODCALLTYPE SetStore(_In_opt_ IDxcCompileCacheStore *pStore) override {
+    m_pCacheStore = pStore;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE CreateMemoryStore(
+      _In_ UINT64 maxSizeInBytes,
+      _COM_Outptr_ IDxcCompileCacheStore **ppStore) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    return dxcutil::CreateMemoryCompileCacheStore(m_pMalloc, maxSizeInBytes, ppStore);
+  }
+  HRESULT STDMETHODCALLTYPE CreateDirectoryStore(
+      _In_z_ LPCWSTR pDirectory,
+      _COM_Outptr_ IDxcCompileCacheStore **ppStore) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    return dxcutil::CreateDirectoryCompileCacheStore(m_pMalloc, pDirectory, ppStore);
+  }
+
+  // IDxcCompilerIncludeCache
+  HRESULT STDMETHODCALLTYPE SetIncludeCache(_In_opt_ IDxcIncludeCache *pCache) override {
+    m_pIncludeCache = pCache;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE CreateIncludeCache(
+      _COM_Outptr_ IDxcIncludeCache **ppCache) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    return dxcutil::CreateIncludeCache(m_pMalloc, ppCache);
+  }
+
+  // IDxcSourceStoreSupport
+  HRESULT STDMETHODCALLTYPE SetSourceStore(_In_opt_ IDxcSourceStore *pStore) override {
+    m_pSourceStore = pStore;
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE CreateDirectorySourceStore(
+      _In_z_ LPCWSTR pDirectory,
+      _COM_Outptr_ IDxcSourceStore **ppStore) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    return hlsl::CreateDirectorySourceStore(m_pMalloc, pDirectory, ppStore);
+  }
+
+  // IDxcCompilerContextPool
+  HRESULT STDMETHODCALLTYPE SetContextPoolSize(UINT32 MaxIdleContexts) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    m_contextPool.SetSize(MaxIdleContexts);
+    return S_OK;
+  }
+
+  // IDxcCompilerCancellation
+  HRESULT STDMETHODCALLTYPE CreateCancellationToken(
+      _COM_Outptr_ IDxcCancellationToken **ppToken) override {
+    DxcThreadMalloc TM(m_pMalloc);
+    return dxcutil::CreateCancellationToken(m_pMalloc, ppToken);
+  }
+  HRESULT STDMETHODCALLTYPE CompileCancellable(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_opt_ IDxcCancellationToken *pToken,
+    _In_ REFIID riid, _Out_ LPVOID *ppResult) override {
+    // Every deadline the compile installs on this thread ends with this one.
+    DxcCompileDeadline cancellation(0, pToken);
+    return Compile(pSource, pArguments, argCount, pIncludeHandler, riid,
+                   ppResult);
+  }
+
+  // IDxcCompilerAsync
+  HRESULT STDMETHODCALLTYPE CompileAsync(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_opt_ IDxcTaskExecutor *pExecutor,
+    _COM_Outptr_ IDxcAsyncResult **ppAsync) override {
+    if (pSource == nullptr || (argCount > 0 && pArguments == nullptr) ||
+        ppAsync == nullptr)
+      return E_INVALIDARG;
+    *ppAsync = nullptr;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      hlsl::DxcThreadPool *pPool = nullptr;
+      if (pExecutor == nullptr) {
+        std::lock_guard<std::mutex> Lock(m_asyncPoolLock);
+        if (!m_pAsyncPool)
+          m_pAsyncPool.reset(new hlsl::DxcThreadPool());
+        pPool = m_pAsyncPool.get();
+      }
+      return dxcutil::StartCompileAsync(m_pMalloc, this, pSource, pArguments,
+                                        argCount, pIncludeHandler, pExecutor,
+                                        pPool, ppAsync);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  // IDxcCompilerBatch
+  HRESULT STDMETHODCALLTYPE CompileBatch(
+    _In_count_(jobCount) const DxcCompileJob *pJobs,
+    _In_ UINT32 jobCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ UINT32 threadCount,
+    _In_ IDxcCompileBatchCallback *pCallback) override {
+    if ((jobCount > 0 && pJobs == nullptr) || pCallback == nullptr)
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < jobCount; ++i) {
+      if (pJobs[i].pSource == nullptr ||
+          (pJobs[i].argCount > 0 && pJobs[i].pArguments == nullptr))
+        return E_INVALIDARG;
+    }
+    return dxcutil::RunCompileBatch(m_pMalloc, this, pJobs, jobCount,
+                                    pIncludeHandler, threadCount, pCallback);
+  }
+
+  // IDxcCompilerMultiEntry
+  HRESULT STDMETHODCALLTYPE CompileEntryPoints(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_count_(entryPointCount) const DxcEntryPoint *pEntryPoints,
+    _In_ UINT32 entryPointCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ UINT32 threadCount,
+    _Out_writes_(entryPointCount) IDxcResult **ppResults) override {
+    if (pSource == nullptr || (argCount > 0 && pArguments == nullptr) ||
+        (entryPointCount > 0 && (pEntryPoints == nullptr || ppResults == nullptr)))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < entryPointCount; ++i) {
+      if (pEntryPoints[i].pName == nullptr ||
+          pEntryPoints[i].pTargetProfile == nullptr)
+        return E_INVALIDARG;
+    }
+    return dxcutil::RunCompileEntryPoints(m_pMalloc, this, pSource, pArguments,
+                                          argCount, pEntryPoints,
+                                          entryPointCount, pIncludeHandler,
+                                          threadCount, ppResults);
+  }
+
+  // IDxcCompilerPermutations
+  HRESULT STDMETHODCALLTYPE CompilePermutations(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_count_(permutationCount) const DxcPermutation *pPermutations,
+    _In_ UINT32 permutationCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ UINT32 threadCount,
+    _Out_writes_(permutationCount) IDxcResult **ppResults) override {
+    if (pSource == nullptr || (argCount > 0 && pArguments == nullptr) ||
+        (permutationCount > 0 && (pPermutations == nullptr || ppResults == nullptr)))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < permutationCount; ++i) {
+      const DxcPermutation &Permutation = pPermutations[i];
+      if (Permutation.defineCount > 0 && Permutation.pDefines == nullptr)
+        return E_INVALIDARG;
+      for (UINT32 d = 0; d < Permutation.defineCount; ++d) {
+        if (Permutation.pDefines[d].Name == nullptr)
+          return E_INVALIDARG;
+      }
+    }
+    return dxcutil::RunCompilePermutations(m_pMalloc, this, pSource, pArguments,
+                                           argCount, pPermutations,
+                                           permutationCount, pIncludeHandler,
+                                           threadCount, ppResults);
+  }
+
+  // Runs the compile with every allocation on this thread served from a new
+  // arena, then copies the outputs out, so that the arena is released in one
+  // step when the compile ends instead of piece by piece.
+  HRESULT CompileInArena(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ REFIID riid, _Out_ LPVOID *ppResult
+  ) {
+    CComPtr<IMalloc> pArena;
+    IFR(DxcCreateArenaMalloc(m_pMalloc, &pArena));
+    CComPtr<IDxcResult> pArenaResult;
+    IFR(CompileUncached(pSource, pArguments, argCount, pIncludeHandler,
+                        IID_PPV_ARGS(&pArenaResult), pArena));
+    CComPtr<IDxcResult> pResult;
+    IFR(CopyResultOutputs(pArenaResult, &pResult));
+    return pResult->QueryInterface(riid, ppResult);
+  }
+
+  // Returns a result that reports a compile abandoned with e, or the
+  // failure to create one.
+  static HRESULT CreateErrorResult(hlsl::Exception &e, _In_ REFIID riid,
+                                   _Out_ LPVOID *ppResult) {
+    // The validator reports these through its HRESULT alone.
+    if (e.hr == DXC_E_COMPILE_DEADLINE_EXCEEDED && e.msg.empty())
+      e.msg = "Compilation did not finish within its deadline.";
+    else if (e.hr == DXC_E_COMPILE_CANCELLED && e.msg.empty())
+      e.msg = "Compilation was cancelled.";
+    else if (e.hr == DXC_E_COMPILE_MEMORY_LIMIT_EXCEEDED && e.msg.empty())
+      e.msg = "Compilation needed more memory than -memory-limit allows.";
+    CComPtr<IDxcResult> pResult;
+    if (SUCCEEDED(DxcResult::Create(e.hr, DXC_OUT_NONE, {
+            DxcOutputObject::ErrorOutput(CP_UTF8,
+              e.msg.c_str(), e.msg.size())
+          }, &pResult)) &&
+        SUCCEEDED(pResult->QueryInterface(riid, ppResult))) {
+      return S_OK;
+    }
+    return e.hr;
+  }
+
+  // How a compile under -compile-deadline-fallback is being attempted.
+  enum class DeadlineAttempt {
+    First,     // Not yet attempted; try it with fallback.
+    Requested, // At the requested optimization level, without fallback.
+    Fallback,  // At -Od, after the requested level ran out of time.
+  };
+
+  // Compiles as requested, and if that runs out of time, compiles again at
+  // -Od under a new deadline. Optimization passes are the bulk of the time
+  // in slow compiles, so the retry usually fits where the first did not.
+  HRESULT CompileWithDeadlineFallback(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ REFIID riid, _Out_ LPVOID *ppResult,
+    _In_opt_ IMalloc *pArena
+  ) {
+    CComPtr<IDxcResult> pResult;
+    IFR(CompileUncached(pSource, pArguments, argCount, pIncludeHandler,
+                        IID_PPV_ARGS(&pResult), pArena,
+                        DeadlineAttempt::Requested));
+    HRESULT status;
+    IFR(pResult->GetStatus(&status));
+    if (status != DXC_E_COMPILE_DEADLINE_EXCEEDED)
+      return pResult->QueryInterface(riid, ppResult);
+
+    std::vector<LPCWSTR> FallbackArgs;
+    FallbackArgs.reserve(argCount + 1);
+    FallbackArgs.assign(pArguments, pArguments + argCount);
+    FallbackArgs.push_back(L"-Od");
+    pResult.Release();
+    IFR(CompileUncached(pSource, FallbackArgs.data(), FallbackArgs.size(),
+                        pIncludeHandler, IID_PPV_ARGS(&pResult), pArena,
+                        DeadlineAttempt::Fallback));
+    return pResult->QueryInterface(riid, ppResult);
+  }
+
+  // Describes the first difference in the outputs that must not depend on
+  // the thread count, or returns an empty string if there is none.
+  static std::string GetParallelOutputMismatch(IDxcResult *pSerial,
+                                               IDxcResult *pParallel) {
+    HRESULT serialStatus, parallelStatus;
+    IFT(pSerial->GetStatus(&serialStatus));
+    IFT(pParallel->GetStatus(&parallelStatus));
+    if (serialStatus != parallelStatus)
+      return "the compile status differs";
+    const std::pair<DXC_OUT_KIND, const char *> Kinds[] = {
+      { DXC_OUT_OBJECT, "container" },
+      { DXC_OUT_SHADER_HASH, "shader hash" },
+    };
+    for (const auto &Kind : Kinds) {
+      CComPtr<IDxcBlob> pSerialBlob, pParallelBlob;
+      if (pSerial->HasOutput(Kind.first))
+        IFT(pSerial->GetOutput(Kind.first, IID_PPV_ARGS(&pSerialBlob), nullptr));
+      if (pParallel->HasOutput(Kind.first))
+        IFT(pParallel->GetOutput(Kind.first, IID_PPV_ARGS(&pParallelBlob), nullptr));
+      if (!pSerialBlob && !pParallelBlob)
+        continue;
+      if (!pSerialBlob || !pParallelBlob)
+        return std::string("only one compile produced a ") + Kind.second;
+      StringRef SerialBytes((const char *)pSerialBlob->GetBufferPointer(),
+                            pSerialBlob->GetBufferSize());
+      StringRef ParallelBytes((const char *)pParallelBlob->GetBufferPointer(),
+                              pParallelBlob->GetBufferSize());
+      if (SerialBytes == ParallelBytes)
+        continue;
+      size_t Offset = 0;
+      while (Offset < SerialBytes.size() && Offset < ParallelBytes.size() &&
+             SerialBytes[Offset] == ParallelBytes[Offset])
+        ++Offset;
+      return (Twine("the ") + Kind.second + " differs from byte " +
+              Twine(Offset) + " (" + Twine(SerialBytes.size()) +
+              " bytes with one thread, " + Twine(ParallelBytes.size()) +
+              " with several)").str();
+    }
+    return std::string();
+  }
+
+  // Compiles with every parallel stage limited to one thread, then again
+  // with the default thread count, and returns the second result only if
+  // the outputs are identical. Caches keyed on the output rely on the thread
+  // count never changing it.
+  HRESULT CompileWithParallelVerify(
+    _In_ const DxcBuffer *pSource,
+    _In_opt_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _In_ REFIID riid, _Out_ LPVOID *ppResult,
+    _In_opt_ IMalloc *pArena
+  ) {
+    CComPtr<IDxcResult> pSerial;
+    {
+      hlsl::DxcThreadCountLimit SerialLimit(1);
+      IFR(CompileUncached(pSource, pArguments, argCount, pIncludeHandler,
+                          IID_PPV_ARGS(&pSerial), pArena,
+                          DeadlineAttempt::First,
+                          /*bParallelVerifyAttempt*/ true));
+    }
+    CComPtr<IDxcResult> pParallel;
+    IFR(CompileUncached(pSource, pArguments, argCount, pIncludeHandler,
+                        IID_PPV_ARGS(&pParallel), pArena,
+                        DeadlineAttempt::First,
+                        /*bParallelVerifyAttempt*/ true));
+    try {
+      std::string Mismatch = GetParallelOutputMismatch(pSerial, pParallel);
+      if (Mismatch.empty())
+        return pParallel->QueryInterface(riid, ppResult);
+      hlsl::Exception e(DXC_E_PARALLEL_OUTPUT_MISMATCH,
+                        "Compiling with one thread and with several gave "
+                        "different output: " + Mismatch + ".");
+      return CreateErrorResult(e, riid, ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  // Compile without consulting the cache. With pArena, all allocations on
+  // this thread come from the arena for the duration of the compile.
+  HRESULT CompileUncached(
+    _In_ const DxcBuffer *pSource,                // Source text to compile
+    _In_opt_count_(argCount) LPCWSTR *pArguments, // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _In_ REFIID riid, _Out_ LPVOID *ppResult,     // IDxcResult: status, buffer, and errors
+    _In_opt_ IMalloc *pArena = nullptr,
+    DeadlineAttempt deadlineAttempt = DeadlineAttempt::First,
+    bool bParallelVerifyAttempt = false
+  ) {
+    *ppResult = nullptr;
+
     HRESULT hr = S_OK;
     CComPtr<IDxcBlobUtf8> utf8Source;
     CComPtr<AbstractMemoryStream> pOutputStream;
@@ -465,7 +1106,10 @@ public:
     bool bCompileStarted = false;
     bool bPreprocessStarted = false;
     DxilShaderHash ShaderHashContent;
-    DxcThreadMalloc TM(m_pMalloc);
+    DxcThreadMalloc TM(pArena ? pArena : m_pMalloc.p);
+    // Counts the allocations of the compile; kept here so that running out
+    // of the memory limit can be told apart from running out of memory.
+    CComPtr<dxcutil::DxcCountingMalloc> pCountingMalloc;
 
     try {
       DefaultFPEnvScope fpEnvScope;
@@ -494,6 +1138,32 @@ public:
         }
       }
 
+      if (opts.CompileArena && pArena == nullptr) {
+        hr = CompileInArena(pSource, pArguments, argCount, pIncludeHandler, riid, ppResult);
+        goto Cleanup;
+      }
+      if (opts.ParallelVerify && !bParallelVerifyAttempt &&
+          deadlineAttempt == DeadlineAttempt::First) {
+        hr = CompileWithParallelVerify(pSource, pArguments, argCount,
+                                       pIncludeHandler, riid, ppResult,
+                                       pArena);
+        goto Cleanup;
+      }
+      if (opts.CompileDeadlineFallback && !opts.DisableOptimizations &&
+          deadlineAttempt == DeadlineAttempt::First) {
+        hr = CompileWithDeadlineFallback(pSource, pArguments, argCount,
+                                         pIncludeHandler, riid, ppResult,
+                                         pArena);
+        goto Cleanup;
+      }
+      if (deadlineAttempt == DeadlineAttempt::Fallback) {
+        w << "warning: compilation did not finish within -compile-deadline "
+          << opts.CompileDeadline << " ms; compiled with -Od instead.\n";
+      }
+      // Long-running passes check this and abandon the compile once it has
+      // passed.
+      DxcCompileDeadline deadline(opts.CompileDeadline);
+
       bool isPreprocessing = !opts.Preprocess.empty();
       if (isPreprocessing) {
         DxcEtw_DXCompilerPreprocess_Start();
@@ -507,6 +1177,25 @@ public:
       IFT(pResult->SetEncoding(opts.DefaultTextCodePage));
       DxcOutputObject primaryOutput;
 
+      // With -ftime-report, -fmemory-report or -memory-limit, allocations go
+      // through a counting allocator until the compile ends, and with
+      // -ftime-report every pass run on this thread is observed as well.
+      IMalloc *pCompileMalloc = DxcGetThreadMallocNoRef();
+      std::unique_ptr<dxcutil::DxcTimeProfile> pProfile;
+      if (opts.TimeReport || opts.MemoryReport || opts.MemoryLimit) {
+        pCountingMalloc = dxcutil::DxcCountingMalloc::Alloc(pCompileMalloc);
+        IFROOM(pCountingMalloc.p);
+        if (opts.MemoryReport)
+          pCountingMalloc->TrackLiveBytes();
+        if (opts.MemoryLimit)
+          pCountingMalloc->SetLimit((uint64_t)opts.MemoryLimit << 20);
+      }
+      if (opts.TimeReport)
+        pProfile.reset(new dxcutil::DxcTimeProfile(pCountingMalloc));
+      DxcThreadMalloc TMProfile(pCountingMalloc ? pCountingMalloc.p : pCompileMalloc);
+      // Installed after the profile, so that it sees the passes first.
+      dxcutil::DxcDeadlinePassObserver deadlineObserver;
+
       // Formerly API values.
       const char *pUtf8SourceName = opts.InputFile.empty() ? "hlsl.hlsl" : opts.InputFile.data();
       CA2W pUtf16SourceName(pUtf8SourceName, CP_UTF8);
@@ -569,14 +1258,24 @@ public:
         primaryOutput.kind = DXC_OUT_TEXT;
       else if (isPreprocessing)
         primaryOutput.kind = DXC_OUT_HLSL;
+      else if (opts.DependenciesOnly) {
+        primaryOutput.kind = DXC_OUT_DEPENDENCIES;
+        IFT(primaryOutput.SetName(opts.DependencyFile));
+      }
 
       IFT(pResult->SetOutputName(DXC_OUT_REFLECTION, opts.OutputReflectionFile));
       IFT(pResult->SetOutputName(DXC_OUT_SHADER_HASH, opts.OutputShaderHashFile));
+      IFT(pResult->SetOutputName(DXC_OUT_SHADER_STATISTICS, opts.OutputStatisticsFile));
       IFT(pResult->SetOutputName(DXC_OUT_ERRORS, opts.OutputWarningsFile));
       IFT(pResult->SetOutputName(DXC_OUT_ROOT_SIGNATURE, opts.OutputRootSigFile));
 
       if (opts.DisplayIncludeProcess)
         msfPtr->EnableDisplayIncludeProcess();
+      if (!opts.PchHeader.empty()) {
+        CA2W pUtf16PchHeader(opts.PchHeader.data(), CP_UTF8);
+        CA2W pUtf16PchFile(opts.PchFile.data(), CP_UTF8);
+        msfPtr->SetPrecompiledHeader(pUtf16PchHeader, pUtf16PchFile);
+      }
 
       IFT(msfPtr->RegisterOutputStream(L"output.bc", pOutputStream));
       IFT(msfPtr->CreateStdStreams(m_pMalloc));
@@ -590,13 +1289,30 @@ public:
 
       // Setup a compiler instance.
       raw_stream_ostream outStream(pOutputStream.p);
-      llvm::LLVMContext llvmContext; // LLVMContext should outlive CompilerInstance
+      // LLVMContext should outlive CompilerInstance. Pooled contexts are
+      // only used when allocations come from the compiler's own malloc.
+      dxcutil::DxcContextPool::Lease contextLease =
+          m_contextPool.Acquire(DxcGetThreadMallocNoRef() == m_pMalloc.p);
+      llvm::LLVMContext &llvmContext = contextLease.get();
       CompilerInstance compiler;
       std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
           llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
       SetupCompilerForCompile(compiler, &m_langExtensionsHelper, pUtf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
       msfPtr->SetupForCompilerInstance(compiler);
 
+      // With a source store, debug info refers to included files by digest.
+      CComPtr<IDxcSourceStore> pSourceStore = m_pSourceStore;
+      if (!opts.SourceStore.empty()) {
+        pSourceStore.Release();
+        CA2W pUtf16SourceStore(opts.SourceStore.str().c_str(), CP_UTF8);
+        IFT(hlsl::CreateDirectorySourceStore(m_pMalloc, pUtf16SourceStore,
+                                             &pSourceStore));
+      }
+      if (compiler.getCodeGenOpts().getDebugInfo() !=
+          CodeGenOptions::FullDebugInfo)
+        pSourceStore.Release();
+      compiler.getCodeGenOpts().HLSLSourceReferences = pSourceStore != nullptr;
+
       // The clang entry point (cc1_main) would now create a compiler invocation
       // from arguments, but depending on the Preprocess option, we either compile
       // to LLVM bitcode and then package that into a DXBC blob, or preprocess to
@@ -610,6 +1326,12 @@ public:
       compiler.WriteDefaultOutputDirectly = true;
       compiler.setOutStream(&outStream);
 
+      std::shared_ptr<DxcDependencyCollector> dependencies;
+      if (opts.OutputDependencies) {
+        dependencies = std::make_shared<DxcDependencyCollector>();
+        compiler.addDependencyCollector(dependencies);
+      }
+
       unsigned rootSigMajor = 0;
       unsigned rootSigMinor = 0;
       // NOTE: this calls the validation component from dxil.dll; the built-in
@@ -627,7 +1349,9 @@ public:
         PPOutOpts.ShowLineMarkers = 1;    // Show \#line markers.
         PPOutOpts.UseLineDirectives = 1;  // Use \#line instead of GCC-style \# N.
         PPOutOpts.ShowMacroComments = 0;  // Show comments, even in macros.
-        PPOutOpts.ShowMacros = 0;         // Print macro definitions.
+        // A precompiled header keeps its macro definitions, so that it can
+        // replace the header in later compiles.
+        PPOutOpts.ShowMacros = opts.PchCreate; // Print macro definitions.
         PPOutOpts.RewriteIncludes = 0;    // Preprocess include directives only.
 
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
@@ -637,6 +1361,15 @@ public:
           action.EndSourceFile();
         }
         outStream.flush();
+      } else if (opts.DependenciesOnly) {
+        // Lexing is all it takes to follow the includes; the tokens are
+        // dropped as they are read.
+        FrontendInputFile file(pUtf8SourceName, IK_HLSL);
+        clang::PreprocessOnlyAction action;
+        if (action.BeginSourceFile(compiler, file)) {
+          action.Execute();
+          action.EndSourceFile();
+        }
       } else {
         compiler.getLangOpts().HLSLEntryFunction =
           compiler.getCodeGenOpts().HLSLEntryFunction = pUtf8EntryPoint;
@@ -733,7 +1466,7 @@ public:
       }
       // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
-      else if (!isPreprocessing && opts.GenSPIRV) {
+      else if (!isPreprocessing && !opts.DependenciesOnly && opts.GenSPIRV) {
         // Since SpirvOptions is passed to the SPIR-V CodeGen as a whole
         // structure, we need to copy a few non-spirv-specific options into the
         // structure.
@@ -741,35 +1474,67 @@ public:
         opts.SpirvOptions.codeGenHighLevel = opts.CodeGenHighLevel;
         opts.SpirvOptions.defaultRowMajor = opts.DefaultRowMajor;
         opts.SpirvOptions.disableValidation = opts.DisableValidation;
+        opts.SpirvOptions.poolTools = DxcGetThreadMallocNoRef() == m_pMalloc.p;
         // Store a string representation of command line options.
         if (opts.DebugInfo)
           for (auto opt : mainArgs.getArrayRef())
             opts.SpirvOptions.clOptions += " " + std::string(opt);
 
         compiler.getCodeGenOpts().SpirvOptions = opts.SpirvOptions;
-        clang::EmitSpirvAction action;
+        // Reflection data is produced from what the SPIR-V backend assigned,
+        // so loaders need not parse the module for it.
+        std::string reflection;
+        const bool wantReflection = !opts.OutputReflectionFile.empty() ||
+                                    opts.SpirvOptions.enableReflect;
+        clang::EmitSpirvAction action(wantReflection ? &reflection : nullptr);
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
         action.BeginSourceFile(compiler, file);
         action.Execute();
         action.EndSourceFile();
         outStream.flush();
+        if (!reflection.empty()) {
+          IFT(pResult->SetOutputString(DXC_OUT_SPIRV_REFLECTION,
+                                       reflection.c_str(), reflection.size()));
+          IFT(pResult->SetOutputName(DXC_OUT_SPIRV_REFLECTION,
+                                     opts.OutputReflectionFile));
+        }
       }
 #endif
       // SPIRV change ends
-      else if (!isPreprocessing) {
+      else if (!isPreprocessing && !opts.DependenciesOnly) {
         EmitBCAction action(&llvmContext);
+        // The AST and Sema of a large shader take more memory than anything
+        // after them, so they are freed by EndSourceFile before the passes
+        // run.
+        action.setDeferBackendOutput(true);
         FrontendInputFile file(pUtf8SourceName, IK_HLSL);
         bool compileOK;
-        if (action.BeginSourceFile(compiler, file)) {
-          action.Execute();
-          action.EndSourceFile();
-          compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+        {
+          // Parsing, Sema and IR generation are interleaved by clang, so they
+          // are one phase.
+          dxcutil::DxcTimeProfile::Phase Phase(pProfile.get(), "frontend");
+          if (action.BeginSourceFile(compiler, file)) {
+            action.Execute();
+            action.EndSourceFile();
+            compileOK = !compiler.getDiagnostics().hasErrorOccurred();
+          }
+          else {
+            compileOK = false;
+          }
         }
-        else {
-          compileOK = false;
+        // Diagnostics from here on only need the source manager.
+        compiler.setPreprocessor(nullptr);
+        if (compileOK) {
+          // The HL and DXIL passes are reported individually.
+          dxcutil::DxcTimeProfile::Phase Phase(pProfile.get(), "backend");
+          action.EmitDeferredBackendOutput(compiler);
+          compileOK = !compiler.getDiagnostics().hasErrorOccurred();
         }
         outStream.flush();
 
+        if (compileOK && pSourceStore)
+          compileOK = AddIncludedSourcesToStore(compiler, pSourceStore);
+
         SerializeDxilFlags SerializeFlags = SerializeDxilFlags::None;
         if (opts.EmbedPDBName()) {
           SerializeFlags |= SerializeDxilFlags::IncludeDebugNamePart;
@@ -797,6 +1562,18 @@ public:
         if (opts.StripRootSignature) {
           SerializeFlags |= SerializeDxilFlags::StripRootSignature;
         }
+        if (opts.IsLibraryProfile()) {
+          SerializeFlags |= SerializeDxilFlags::IncludeFunctionHashPart;
+        }
+        if (opts.FastShaderHash) {
+          SerializeFlags |= SerializeDxilFlags::FastShaderHash;
+        }
+        if (opts.LineTable) {
+          SerializeFlags |= SerializeDxilFlags::IncludeLineTablePart;
+        }
+        if (opts.CompressDebug) {
+          SerializeFlags |= SerializeDxilFlags::CompressDebugInfoPart;
+        }
 
         // Don't do work to put in a container if an error has occurred
         // Do not create a container when there is only a a high-level representation in the module.
@@ -807,11 +1584,24 @@ public:
           IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pReflectionStream));
           IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pRootSigStream));
 
+          // Statistics are of the module as compiled, before it is
+          // serialized.
+          std::unique_ptr<llvm::Module> pModule = action.takeModule();
+          if (!opts.OutputStatisticsFile.empty()) {
+            std::string stats;
+            raw_string_ostream statsOS(stats);
+            hlsl::WriteShaderStatistics(*pModule, statsOS);
+            statsOS.flush();
+            IFT(pResult->SetOutputString(DXC_OUT_SHADER_STATISTICS,
+                                         stats.c_str(), stats.size()));
+          }
+
           dxcutil::AssembleInputs inputs(
-                action.takeModule(), pOutputBlob, m_pMalloc, SerializeFlags,
+                std::move(pModule), pOutputBlob, m_pMalloc, SerializeFlags,
                 pOutputStream, opts.IsDebugInfoEnabled(),
                 opts.GetPDBName(), &compiler.getDiagnostics(),
                 &ShaderHashContent, pReflectionStream, pRootSigStream);
+          inputs.pProfile = pProfile.get();
           if (needsValidation) {
             valHR = dxcutil::ValidateAndAssembleToContainer(inputs);
           } else {
@@ -862,6 +1652,47 @@ public:
         } // compileOK && !opts.CodeGenHighLevel
       }
 
+      if (dependencies) {
+        StringRef target = !opts.DependencyTarget.empty()
+                               ? opts.DependencyTarget
+                               : !opts.OutputObject.empty()
+                                     ? opts.OutputObject
+                                     : StringRef(pUtf8SourceName);
+        if (opts.DependenciesOnly) {
+          WriteMakeDependencies(outStream, target,
+                                dependencies->getDependencies());
+          outStream.flush();
+        } else {
+          std::string rule;
+          raw_string_ostream ruleOS(rule);
+          WriteMakeDependencies(ruleOS, target,
+                                dependencies->getDependencies());
+          ruleOS.flush();
+          IFT(pResult->SetOutputString(DXC_OUT_DEPENDENCIES, rule.c_str(),
+                                       rule.size()));
+          IFT(pResult->SetOutputName(DXC_OUT_DEPENDENCIES,
+                                     opts.DependencyFile));
+        }
+      }
+
+      if (pProfile) {
+        std::string report;
+        raw_string_ostream reportOS(report);
+        pProfile->WriteJson(reportOS);
+        reportOS.flush();
+        IFT(pResult->SetOutputString(DXC_OUT_TIME_REPORT, report.c_str(), report.size()));
+      }
+      if (opts.MemoryReport) {
+        std::string report;
+        raw_string_ostream reportOS(report);
+        reportOS << "{\n  \"allocBytes\": " << pCountingMalloc->GetAllocatedBytes()
+                 << ",\n  \"peakBytes\": " << pCountingMalloc->GetPeakBytes()
+                 << ",\n  \"limitBytes\": " << ((uint64_t)opts.MemoryLimit << 20)
+                 << "\n}\n";
+        reportOS.flush();
+        IFT(pResult->SetOutputString(DXC_OUT_MEMORY_REPORT, report.c_str(), report.size()));
+      }
+
       // Add std err to warnings.
       msfPtr->WriteStdErrToStream(w);
       CComPtr<IStream> pErrorStream;
@@ -889,7 +1720,7 @@ public:
           CComPtr<IDxcBlob> pDebugBlob;
           IFT(pOutputStream.QueryInterface(&pDebugBlob));
           CComPtr<IDxcBlob> pStrippedContainer;
-          IFT(CreateContainerForPDB(m_pMalloc, pOutputBlob, pDebugBlob, &pStrippedContainer));
+          IFT(CreateContainerForPDB(m_pMalloc, pOutputBlob, pDebugBlob, opts.CompressDebug, &pStrippedContainer));
           pDebugBlob.Release();
           IFT(hlsl::pdb::WriteDxilPDB(m_pMalloc, pStrippedContainer, ShaderHashContent.Digest, &pDebugBlob));
           IFT(pResult->SetOutputObject(DXC_OUT_PDB, pDebugBlob));
@@ -904,17 +1735,16 @@ public:
       hr = S_OK;
     } catch (std::bad_alloc &) {
       hr = E_OUTOFMEMORY;
+      if (pCountingMalloc && pCountingMalloc->IsLimitExceeded()) {
+        hlsl::Exception e(DXC_E_COMPILE_MEMORY_LIMIT_EXCEEDED);
+        hr = CreateErrorResult(e, riid, ppResult);
+      }
     } catch (hlsl::Exception &e) {
       _Analysis_assume_(DXC_FAILED(e.hr));
-      CComPtr<IDxcResult> pResult;
-      hr = e.hr;
-      if (SUCCEEDED(DxcResult::Create(e.hr, DXC_OUT_NONE, {
-              DxcOutputObject::ErrorOutput(CP_UTF8,
-                e.msg.c_str(), e.msg.size())
-            }, &pResult)) &&
-          SUCCEEDED(pResult->QueryInterface(riid, ppResult))) {
-        hr = S_OK;
-      }
+      // Code that catches the allocation failure reports it as its own.
+      if (pCountingMalloc && pCountingMalloc->IsLimitExceeded())
+        e = hlsl::Exception(DXC_E_COMPILE_MEMORY_LIMIT_EXCEEDED);
+      hr = CreateErrorResult(e, riid, ppResult);
     } catch (...) {
       hr = E_FAIL;
     }
@@ -955,17 +1785,36 @@ public:
       ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
       IFTLLVM(pts.error_code());
 
-      std::string StreamStr;
-      raw_string_ostream Stream(StreamStr);
-
-      CComPtr<IDxcBlobEncoding> pProgram;
-      IFT(hlsl::DxcCreateBlob(pObject->Ptr, pObject->Size, true, false, false, 0, nullptr, &pProgram))
-      IFC(dxcutil::Disassemble(pProgram, Stream));
+      dxcutil::CompileCacheKey key;
+      DxcBuffer keyBuffer = { key, sizeof(key), 0 };
+      if (m_pCacheStore) {
+        dxcutil::ComputeDisassemblyCacheKey(pObject, key);
+        CComPtr<IDxcBlob> pCachedValue;
+        if (m_pCacheStore->Lookup(&keyBuffer, &pCachedValue) == S_OK && pCachedValue) {
+          if (FAILED(dxcutil::DeserializeCompileResult(pCachedValue, &pResult)))
+            pResult.Release();
+        }
+      }
 
-      IFT(DxcResult::Create(S_OK, DXC_OUT_DISASSEMBLY, {
-          DxcOutputObject::StringOutput(DXC_OUT_DISASSEMBLY,
-            CP_UTF8, StreamStr.c_str(), StreamStr.size(), DxcOutNoName)
-        }, &pResult));
+      if (!pResult) {
+        std::string StreamStr;
+        raw_string_ostream Stream(StreamStr);
+
+        CComPtr<IDxcBlobEncoding> pProgram;
+        IFT(hlsl::DxcCreateBlob(pObject->Ptr, pObject->Size, true, false, false, 0, nullptr, &pProgram))
+        IFC(dxcutil::Disassemble(pProgram, Stream));
+
+        IFT(DxcResult::Create(S_OK, DXC_OUT_DISASSEMBLY, {
+            DxcOutputObject::StringOutput(DXC_OUT_DISASSEMBLY,
+              CP_UTF8, StreamStr.c_str(), StreamStr.size(), DxcOutNoName)
+          }, &pResult));
+        if (m_pCacheStore) {
+          // Failing to store only costs a later miss, so errors are ignored.
+          CComPtr<IDxcBlob> pValue;
+          if (SUCCEEDED(dxcutil::SerializeCompileResult(pResult, &pValue)))
+            m_pCacheStore->Store(&keyBuffer, pValue);
+        }
+      }
       IFT(pResult->QueryInterface(riid, ppResult));
 
       return S_OK;
@@ -1028,6 +1877,15 @@ public:
       // DebugPass, DebugCompilationDir, DwarfDebugFlags, SplitDwarfFile
     }
 
+    // The execution profile is keyed by source line, so it needs at least
+    // line tables; these are stripped from the container as usual.
+    if (!Opts.ProfileUseFile.empty()) {
+      CodeGenOptions &CGOpts = compiler.getCodeGenOpts();
+      CGOpts.SampleProfileFile = Opts.ProfileUseFile;
+      if (CGOpts.getDebugInfo() == CodeGenOptions::NoDebugInfo)
+        CGOpts.setDebugInfo(CodeGenOptions::DebugLineTablesOnly);
+    }
+
     clang::PreprocessorOptions &PPOpts(compiler.getPreprocessorOpts());
     for (size_t i = 0; i < defines.size(); ++i) {
       PPOpts.addMacroDef(defines[i]);
@@ -1108,6 +1966,18 @@ public:
     compiler.getCodeGenOpts().HLSLHighLevel = Opts.CodeGenHighLevel;
     compiler.getCodeGenOpts().HLSLResMayAlias = Opts.ResMayAlias;
     compiler.getCodeGenOpts().ScanLimit = Opts.ScanLimit;
+    compiler.getCodeGenOpts().HLSLAuto16BitPrecision = Opts.Auto16BitPrecision;
+    compiler.getCodeGenOpts().HLSLPadGroupShared = Opts.PadGroupShared;
+    compiler.getCodeGenOpts().HLSLMinimizeMeshOutputs = Opts.MinimizeMeshOutputs;
+    compiler.getCodeGenOpts().HLSLReportLoopHandles = Opts.ReportLoopHandles;
+    compiler.getCodeGenOpts().HLSLFastTrig = Opts.FastTrig;
+    compiler.getCodeGenOpts().HLSLWaveAggregateAtomics = Opts.WaveAggregateAtomics;
+    compiler.getCodeGenOpts().HLSLHoistUniform = Opts.HoistUniform;
+    compiler.getCodeGenOpts().HLSLMaxLiveScalars = Opts.MaxLiveScalars;
+    if (Opts.FPContract == "fast")
+      compiler.getCodeGenOpts().HLSLFPContract = clang::CodeGenOptions::FPC_Fast;
+    else if (Opts.FPContract == "on")
+      compiler.getCodeGenOpts().HLSLFPContract = clang::CodeGenOptions::FPC_On;
     compiler.getCodeGenOpts().HLSLAllResourcesBound = Opts.AllResourcesBound;
     compiler.getCodeGenOpts().HLSLDefaultRowMajor = Opts.DefaultRowMajor;
     compiler.getCodeGenOpts().HLSLPreferControlFlow = Opts.PreferFlowControl;
@@ -1122,6 +1992,8 @@ public:
       compiler.getCodeGenOpts().HLSLSignaturePackingStrategy = (unsigned)DXIL::PackingStrategy::PrefixStable;
     else if (Opts.PackOptimized)
       compiler.getCodeGenOpts().HLSLSignaturePackingStrategy = (unsigned)DXIL::PackingStrategy::Optimized;
+    else if (Opts.PackOptimal)
+      compiler.getCodeGenOpts().HLSLSignaturePackingStrategy = (unsigned)DXIL::PackingStrategy::Optimal;
     else
       compiler.getCodeGenOpts().HLSLSignaturePackingStrategy = (unsigned)DXIL::PackingStrategy::Default;
 
@@ -1151,6 +2023,7 @@ public:
 
     // processed export names from -exports option:
     compiler.getCodeGenOpts().HLSLLibraryExports = Opts.Exports;
+    compiler.getCodeGenOpts().HLSLLibraryExportsFile = Opts.ExportsFile;
 
     // only export shader functions for library
     compiler.getCodeGenOpts().ExportShadersOnly = Opts.ExportShadersOnly;
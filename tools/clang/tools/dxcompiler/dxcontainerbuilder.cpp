@@ -20,29 +20,58 @@
 #include "dxillib.h"
 
 #include <algorithm>
+#include <string>
+#include <vector>
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 
 using namespace hlsl;
 
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
-class DxcContainerBuilder : public IDxcContainerBuilder {
+class DxcContainerBuilder : public IDxcContainerBuilder,
+                            public IDxcContainerPackageBuilder,
+                            public IDxcContainerInPlaceBuilder,
+                            public IDxcValidationCache {
 public:
   HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pDxilContainerHeader) override; // Loads DxilContainer to the builder
   HRESULT STDMETHODCALLTYPE AddPart(_In_ UINT32 fourCC, _In_ IDxcBlob *pSource) override; // Add the given part with fourCC
   HRESULT STDMETHODCALLTYPE RemovePart(_In_ UINT32 fourCC) override;                // Remove the part with fourCC
   HRESULT STDMETHODCALLTYPE SerializeContainer(_Out_ IDxcOperationResult **ppResult) override; // Builds a container of the given container builder state
 
+  // IDxcContainerPackageBuilder
+  HRESULT STDMETHODCALLTYPE AddContainerToPackage(_In_ IDxcBlob *pContainer) override;
+  HRESULT STDMETHODCALLTYPE SerializePackage(_COM_Outptr_ IDxcBlob **ppResult) override;
+  HRESULT STDMETHODCALLTYPE LoadPackage(_In_ IDxcBlob *pPackage,
+                                        _COM_Outptr_ IDxcContainerPackage **ppResult) override;
+
+  // IDxcContainerInPlaceBuilder
+  HRESULT STDMETHODCALLTYPE SetPartInPlace(_Inout_updates_bytes_(capacity) void *pContainer,
+                                           _In_ UINT32 capacity, _In_ UINT32 fourCC,
+                                           _In_reads_bytes_opt_(dataSize) const void *pData,
+                                           _In_ UINT32 dataSize,
+                                           _Out_ UINT32 *pContainerSize) override;
+
+  // IDxcValidationCache
+  HRESULT STDMETHODCALLTYPE SetStore(_In_opt_ IDxcCompileCacheStore *pStore) override {
+    m_pValidationCacheStore = pStore;
+    return S_OK;
+  }
+
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcContainerBuilder)
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcContainerBuilder>(this, riid, ppvObject);
+    return DoBasicQueryInterface<IDxcContainerBuilder,
+                                 IDxcContainerPackageBuilder,
+                                 IDxcContainerInPlaceBuilder,
+                                 IDxcValidationCache>(this, riid, ppvObject);
   }
 
   void Init(const char *warning) {
     m_warning = warning;
     m_RequireValidation = false;
+    m_Modified = false;
   }
 
 private:
@@ -60,6 +89,23 @@ private:
   CComPtr<IDxcBlob> m_pContainer; 
   const char *m_warning;
   bool m_RequireValidation;
+  bool m_Modified; // Parts were added or removed since Load.
+  CComPtr<IDxcCompileCacheStore> m_pValidationCacheStore;
+
+  // Package state: distinct root signatures, the index of each by digest,
+  // and the containers with their root signature parts replaced.
+  std::vector<std::string> m_packageRootSignatures;
+  llvm::StringMap<uint32_t> m_packageRootSignatureIndex;
+  std::vector<std::string> m_packageContainers;
+
+  static bool IsAddablePart(UINT32 fourCC) {
+    // Only allow adding private data, debug info name and root signature for now
+    return fourCC == DxilFourCC::DFCC_RootSignature ||
+           fourCC == DxilFourCC::DFCC_ShaderDebugName ||
+           fourCC == DxilFourCC::DFCC_PrivateData;
+  }
+  HRESULT ValidateRootSignature(IDxcBlob *pContainer,
+                                IDxcBlobUtf8 **ppErrors);
 
   UINT32 ComputeContainerSize();
   HRESULT UpdateContainerHeader(AbstractMemoryStream *pStream, uint32_t containerSize);
@@ -98,17 +144,13 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::AddPart(_In_ UINT32 fourCC, _In_
     IFTBOOL(pSource != nullptr && !IsDxilContainerLike(pSource->GetBufferPointer(),
       pSource->GetBufferSize()),
       E_INVALIDARG);
-    // Only allow adding private data, debug info name and root signature for now
-    IFTBOOL(
-        fourCC == DxilFourCC::DFCC_RootSignature || 
-        fourCC == DxilFourCC::DFCC_ShaderDebugName ||
-        fourCC == DxilFourCC::DFCC_PrivateData, 
-      E_INVALIDARG);
+    IFTBOOL(IsAddablePart(fourCC), E_INVALIDARG);
     PartList::iterator it = std::find_if(m_parts.begin(), m_parts.end(), [&](DxilPart part) {
       return part.m_fourCC == fourCC;
     });
     IFTBOOL(it == m_parts.end(), DXC_E_DUPLICATE_PART);
     m_parts.emplace_back(DxilPart(fourCC, pSource));
+    m_Modified = true;
     if (fourCC == DxilFourCC::DFCC_RootSignature) {
       m_RequireValidation = true;
     }
@@ -121,16 +163,19 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::RemovePart(_In_ UINT32 fourCC) {
   DxcThreadMalloc TM(m_pMalloc);
   try {
     IFTBOOL(fourCC == DxilFourCC::DFCC_ShaderDebugInfoDXIL ||
+                fourCC == DxilFourCC::DFCC_CompressedShaderDebugInfoDXIL ||
                 fourCC == DxilFourCC::DFCC_ShaderDebugName ||
                 fourCC == DxilFourCC::DFCC_RootSignature ||
                 fourCC == DxilFourCC::DFCC_PrivateData ||
-                fourCC == DxilFourCC::DFCC_ShaderStatistics,
-            E_INVALIDARG); // You can only remove debug info, debug info name, rootsignature, or private data blob
+                fourCC == DxilFourCC::DFCC_ShaderStatistics ||
+                fourCC == DxilFourCC::DFCC_LineTable,
+            E_INVALIDARG); // You can only remove debug info, debug info name, rootsignature, private data blob, or line table
     PartList::iterator it =
       std::find_if(m_parts.begin(), m_parts.end(),
         [&](DxilPart part) { return part.m_fourCC == fourCC; });
     IFTBOOL(it != m_parts.end(), DXC_E_MISSING_PART);
     m_parts.erase(it);
+    m_Modified = true;
     return S_OK;
   }
   CATCH_CPP_RETURN_HRESULT();
@@ -139,38 +184,34 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::RemovePart(_In_ UINT32 fourCC) {
 HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializeContainer(_Out_ IDxcOperationResult **ppResult) {
   DxcThreadMalloc TM(m_pMalloc);
   try {
-    // Allocate memory for new dxil container.
-    uint32_t ContainerSize = ComputeContainerSize();
-    CComPtr<AbstractMemoryStream> pMemoryStream;
     CComPtr<IDxcBlob> pResult;
-    IFT(CreateMemoryStream(m_pMalloc, &pMemoryStream));
-    IFT(pMemoryStream->QueryInterface(&pResult));
-    IFT(pMemoryStream->Reserve(ContainerSize))
-    
-    // Update Dxil Container
-    IFT(UpdateContainerHeader(pMemoryStream, ContainerSize));
-
-    // Update offset Table
-    IFT(UpdateOffsetTable(pMemoryStream));
-    
-    // Update Parts
-    IFT(UpdateParts(pMemoryStream));
+    if (m_pContainer && !m_Modified &&
+        m_pContainer->GetBufferSize() ==
+          ((const DxilContainerHeader *)m_pContainer->GetBufferPointer())->ContainerSizeInBytes) {
+      // Nothing changed since Load, so the loaded container is the result.
+      pResult = m_pContainer;
+    } else {
+      // Allocate memory for new dxil container.
+      uint32_t ContainerSize = ComputeContainerSize();
+      CComPtr<AbstractMemoryStream> pMemoryStream;
+      IFT(CreateMemoryStream(m_pMalloc, &pMemoryStream));
+      IFT(pMemoryStream->QueryInterface(&pResult));
+      IFT(pMemoryStream->Reserve(ContainerSize))
+
+      // Update Dxil Container
+      IFT(UpdateContainerHeader(pMemoryStream, ContainerSize));
+
+      // Update offset Table
+      IFT(UpdateOffsetTable(pMemoryStream));
+
+      // Update Parts
+      IFT(UpdateParts(pMemoryStream));
+    }
 
     CComPtr<IDxcBlobUtf8> pValErrorUtf8;
     HRESULT valHR = S_OK;
-    if (m_RequireValidation) {
-      CComPtr<IDxcValidator> pValidator;
-      IFT(CreateDxcValidator(IID_PPV_ARGS(&pValidator)));
-      CComPtr<IDxcOperationResult> pValidationResult;
-      IFT(pValidator->Validate(pResult, DxcValidatorFlags_RootSignatureOnly, &pValidationResult));
-      IFT(pValidationResult->GetStatus(&valHR));
-      if (FAILED(valHR)) {
-        CComPtr<IDxcBlobEncoding> pValError;
-        IFT(pValidationResult->GetErrorBuffer(&pValError));
-        if (pValError->GetBufferPointer() && pValError->GetBufferSize())
-          IFT(hlsl::DxcGetBlobAsUtf8(pValError, m_pMalloc, &pValErrorUtf8));
-      }
-    }
+    if (m_RequireValidation)
+      valHR = ValidateRootSignature(pResult, &pValErrorUtf8);
     // Combine existing warnings and errors from validation
     CComPtr<IDxcBlobEncoding> pErrorBlob;
     CDxcMallocHeapPtr<char> errorHeap(m_pMalloc);
@@ -202,6 +243,84 @@ HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializeContainer(_Out_ IDxcOper
   CATCH_CPP_RETURN_HRESULT();
 }
 
+HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SetPartInPlace(
+    _Inout_updates_bytes_(capacity) void *pContainer, _In_ UINT32 capacity,
+    _In_ UINT32 fourCC, _In_reads_bytes_opt_(dataSize) const void *pData,
+    _In_ UINT32 dataSize, _Out_ UINT32 *pContainerSize) {
+  if (pContainerSize == nullptr)
+    return E_POINTER;
+  *pContainerSize = 0;
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    IFTBOOL(IsAddablePart(fourCC) && (pData != nullptr || dataSize == 0) &&
+            !IsDxilContainerLike(pData, dataSize),
+            E_INVALIDARG);
+    DxilContainerHeader *pHeader = IsDxilContainerLike(pContainer, capacity);
+    IFTBOOL(pHeader && IsValidDxilContainer(pHeader, capacity) &&
+            IsContiguousDxilContainer(pHeader),
+            DXC_E_CONTAINER_INVALID);
+
+    // A root signature that does not match the shader must not be left
+    // behind, so keep what it replaces.
+    std::string original;
+    if (fourCC == DxilFourCC::DFCC_RootSignature)
+      original.assign((const char *)pHeader, pHeader->ContainerSizeInBytes);
+
+    UINT32 newSize;
+    if (!SetDxilContainerPartInPlace(pHeader, capacity, fourCC, pData,
+                                     dataSize, newSize)) {
+      *pContainerSize = newSize;
+      return newSize > DxilContainerMaxSize
+                 ? E_OUTOFMEMORY
+                 : HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+    }
+
+    if (fourCC == DxilFourCC::DFCC_RootSignature) {
+      HRESULT valHR;
+      try {
+        CComPtr<IDxcBlobEncoding> pUpdated;
+        IFT(DxcCreateBlobWithEncodingFromPinned(pContainer, newSize, CP_ACP,
+                                                &pUpdated));
+        CComPtr<IDxcBlobUtf8> pErrors;
+        valHR = ValidateRootSignature(pUpdated, &pErrors);
+      } catch (...) {
+        memcpy(pContainer, original.data(), original.size());
+        throw;
+      }
+      if (FAILED(valHR)) {
+        memcpy(pContainer, original.data(), original.size());
+        *pContainerSize = (UINT32)original.size();
+        return valHR;
+      }
+    }
+    *pContainerSize = newSize;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT DxcContainerBuilder::ValidateRootSignature(IDxcBlob *pContainer,
+                                                   IDxcBlobUtf8 **ppErrors) {
+  CComPtr<IDxcValidator> pValidator;
+  IFT(CreateDxcValidator(IID_PPV_ARGS(&pValidator)));
+  if (m_pValidationCacheStore) {
+    CComPtr<IDxcValidationCache> pCache;
+    IFT(pValidator.QueryInterface(&pCache));
+    IFT(pCache->SetStore(m_pValidationCacheStore));
+  }
+  CComPtr<IDxcOperationResult> pValidationResult;
+  IFT(pValidator->Validate(pContainer, DxcValidatorFlags_RootSignatureOnly, &pValidationResult));
+  HRESULT valHR;
+  IFT(pValidationResult->GetStatus(&valHR));
+  if (FAILED(valHR)) {
+    CComPtr<IDxcBlobEncoding> pValError;
+    IFT(pValidationResult->GetErrorBuffer(&pValError));
+    if (pValError->GetBufferPointer() && pValError->GetBufferSize())
+      IFT(hlsl::DxcGetBlobAsUtf8(pValError, m_pMalloc, ppErrors));
+  }
+  return valHR;
+}
+
 UINT32 DxcContainerBuilder::ComputeContainerSize() {
   UINT32 partsSize = 0;
   for (DxilPart part : m_parts) {
@@ -247,6 +366,215 @@ HRESULT DxcContainerBuilder::UpdateParts(AbstractMemoryStream *pStream) {
   return S_OK;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Container packages.
+
+static uint32_t AlignPackageOffset(uint64_t offset) {
+  return (uint32_t)((offset + 3) & ~(uint64_t)3);
+}
+
+HRESULT STDMETHODCALLTYPE DxcContainerBuilder::AddContainerToPackage(_In_ IDxcBlob *pContainer) {
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    IFTBOOL(pContainer != nullptr, E_INVALIDARG);
+    const DxilContainerHeader *pHeader = IsDxilContainerLike(
+        pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+    IFTBOOL(pHeader && IsValidDxilContainer(pHeader, pContainer->GetBufferSize()),
+            DXC_E_CONTAINER_INVALID);
+
+    std::string packed;
+    uint32_t rsIndex = pHeader->PartCount;
+    for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+      IFTBOOL(GetDxilContainerPart(pHeader, i)->PartFourCC != DFCC_RootSignatureRef,
+              DXC_E_CONTAINER_INVALID);
+      if (GetDxilContainerPart(pHeader, i)->PartFourCC == DFCC_RootSignature)
+        rsIndex = i;
+    }
+    if (rsIndex != pHeader->PartCount && IsContiguousDxilContainer(pHeader)) {
+      const DxilPartHeader *pRSPart = GetDxilContainerPart(pHeader, rsIndex);
+      DxilContainerHash digest;
+      ComputeFastShaderHash(GetDxilPartData(pRSPart), pRSPart->PartSize, digest.Digest);
+      std::string rs(GetDxilPartData(pRSPart), pRSPart->PartSize);
+
+      llvm::StringRef key((const char *)digest.Digest, sizeof(digest.Digest));
+      auto it = m_packageRootSignatureIndex.find(key);
+      if (it == m_packageRootSignatureIndex.end()) {
+        m_packageRootSignatureIndex[key] = (uint32_t)m_packageRootSignatures.size();
+        m_packageRootSignatures.emplace_back(std::move(rs));
+        IFTBOOL(RebuildDxilContainer(pHeader, rsIndex, DFCC_RootSignatureRef,
+                                     &digest, sizeof(digest), packed),
+                DXC_E_CONTAINER_INVALID);
+      } else if (m_packageRootSignatures[it->second] == rs) {
+        IFTBOOL(RebuildDxilContainer(pHeader, rsIndex, DFCC_RootSignatureRef,
+                                     &digest, sizeof(digest), packed),
+                DXC_E_CONTAINER_INVALID);
+      }
+      // Otherwise the digests collide, and the container is kept whole.
+    }
+    if (packed.empty())
+      packed.assign((const char *)pHeader, pHeader->ContainerSizeInBytes);
+    m_packageContainers.emplace_back(std::move(packed));
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT STDMETHODCALLTYPE DxcContainerBuilder::SerializePackage(_COM_Outptr_ IDxcBlob **ppResult) {
+  if (ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    uint32_t rsCount = (uint32_t)m_packageRootSignatures.size();
+    uint32_t containerCount = (uint32_t)m_packageContainers.size();
+    std::vector<uint32_t> offsets;
+    offsets.reserve(rsCount + containerCount);
+    uint64_t size = sizeof(DxilContainerPackageHeader) +
+                    sizeof(uint32_t) * ((uint64_t)rsCount + containerCount);
+    for (const std::string &rs : m_packageRootSignatures) {
+      size = AlignPackageOffset(size);
+      offsets.push_back((uint32_t)size);
+      size += sizeof(DxilPackageRootSignatureHeader) + rs.size();
+    }
+    for (const std::string &container : m_packageContainers) {
+      size = AlignPackageOffset(size);
+      offsets.push_back((uint32_t)size);
+      size += container.size();
+    }
+    IFTBOOL(size <= UINT32_MAX, E_OUTOFMEMORY);
+
+    CComPtr<AbstractMemoryStream> pStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pStream));
+    IFT(pStream->Reserve((ULONG)size));
+    DxilContainerPackageHeader header = {};
+    header.HeaderFourCC = DFCC_ContainerPackage;
+    header.Version.Major = DxilContainerVersionMajor;
+    header.Version.Minor = DxilContainerVersionMinor;
+    header.PackageSizeInBytes = (uint32_t)size;
+    header.RootSignatureCount = rsCount;
+    header.ContainerCount = containerCount;
+    ULONG cbWritten;
+    IFT(pStream->Write(&header, sizeof(header), &cbWritten));
+    IFT(pStream->Write(offsets.data(), sizeof(uint32_t) * offsets.size(), &cbWritten));
+
+    static const uint8_t padding[3] = {};
+    auto pad = [&]() {
+      uint64_t position = pStream->GetPosition();
+      if (AlignPackageOffset(position) != position)
+        IFT(pStream->Write(padding, (ULONG)(AlignPackageOffset(position) - position), &cbWritten));
+    };
+    for (const std::string &rs : m_packageRootSignatures) {
+      pad();
+      DxilPackageRootSignatureHeader rsHeader;
+      ComputeFastShaderHash(rs.data(), rs.size(), rsHeader.Digest.Digest);
+      rsHeader.Size = (uint32_t)rs.size();
+      IFT(pStream->Write(&rsHeader, sizeof(rsHeader), &cbWritten));
+      IFT(pStream->Write(rs.data(), rs.size(), &cbWritten));
+    }
+    for (const std::string &container : m_packageContainers) {
+      pad();
+      IFT(pStream->Write(container.data(), container.size(), &cbWritten));
+    }
+    DXASSERT_NOMSG(pStream->GetPosition() == size);
+    return pStream->QueryInterface(ppResult);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+class DxcContainerPackage : public IDxcContainerPackage {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcBlob> m_pPackage;
+  const DxilContainerPackageHeader *m_pHeader = nullptr;
+  llvm::StringMap<const DxilPackageRootSignatureHeader *> m_rootSignatures;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcContainerPackage)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcContainerPackage>(this, riid, ppvObject);
+  }
+
+  void Init(IDxcBlob *pPackage) {
+    m_pHeader = IsValidDxilContainerPackage(pPackage->GetBufferPointer(),
+                                            pPackage->GetBufferSize());
+    IFTBOOL(m_pHeader, DXC_E_CONTAINER_INVALID);
+    m_pPackage = pPackage;
+    for (uint32_t i = 0; i < m_pHeader->RootSignatureCount; ++i) {
+      const DxilPackageRootSignatureHeader *pRS = GetDxilPackageRootSignature(m_pHeader, i);
+      m_rootSignatures[llvm::StringRef((const char *)pRS->Digest.Digest,
+                                       sizeof(pRS->Digest.Digest))] = pRS;
+    }
+  }
+
+  HRESULT STDMETHODCALLTYPE GetContainerCount(_Out_ UINT32 *pResult) override {
+    if (pResult == nullptr)
+      return E_POINTER;
+    *pResult = m_pHeader->ContainerCount;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetContainer(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) override {
+    if (ppResult == nullptr)
+      return E_POINTER;
+    *ppResult = nullptr;
+    if (idx >= m_pHeader->ContainerCount)
+      return E_BOUNDS;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      const DxilContainerHeader *pHeader = GetDxilPackageContainer(m_pHeader, idx);
+      uint32_t refIndex = pHeader->PartCount;
+      for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+        if (GetDxilContainerPart(pHeader, i)->PartFourCC == DFCC_RootSignatureRef)
+          refIndex = i;
+      }
+      if (refIndex == pHeader->PartCount) {
+        // Nothing to expand; share the package's bytes.
+        return DxcCreateBlobFromBlob(
+            m_pPackage,
+            (UINT32)((const uint8_t *)pHeader - (const uint8_t *)m_pHeader),
+            pHeader->ContainerSizeInBytes, ppResult);
+      }
+
+      const DxilPartHeader *pRef = GetDxilContainerPart(pHeader, refIndex);
+      IFTBOOL(pRef->PartSize == sizeof(DxilContainerHash), DXC_E_CONTAINER_INVALID);
+      auto it = m_rootSignatures.find(
+          llvm::StringRef(GetDxilPartData(pRef), sizeof(DxilContainerHash)));
+      IFTBOOL(it != m_rootSignatures.end(), DXC_E_MISSING_PART);
+      const DxilPackageRootSignatureHeader *pRS = it->second;
+      std::string expanded;
+      IFTBOOL(RebuildDxilContainer(pHeader, refIndex, DFCC_RootSignature,
+                                   pRS + 1, pRS->Size, expanded),
+              DXC_E_CONTAINER_INVALID);
+
+      CComPtr<AbstractMemoryStream> pStream;
+      IFT(CreateMemoryStream(m_pMalloc, &pStream));
+      ULONG cbWritten;
+      IFT(pStream->Write(expanded.data(), expanded.size(), &cbWritten));
+      return pStream->QueryInterface(ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+HRESULT STDMETHODCALLTYPE DxcContainerBuilder::LoadPackage(
+    _In_ IDxcBlob *pPackage, _COM_Outptr_ IDxcContainerPackage **ppResult) {
+  if (ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+  if (pPackage == nullptr)
+    return E_INVALIDARG;
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    CComPtr<DxcContainerPackage> pResult = DxcContainerPackage::Alloc(m_pMalloc);
+    IFTBOOL(pResult.p != nullptr, E_OUTOFMEMORY);
+    pResult->Init(pPackage);
+    *ppResult = pResult.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 HRESULT CreateDxcContainerBuilder(_In_ REFIID riid, _Out_ LPVOID *ppv) {
   // Call dxil.dll's containerbuilder 
   *ppv = nullptr;
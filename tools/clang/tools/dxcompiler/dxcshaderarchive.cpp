@@ -0,0 +1,412 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcshaderarchive.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Writes and reads shader archives.                                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxcshaderarchive.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/ErrorCodes.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace hlsl;
+
+namespace {
+
+struct ArchiveItem {
+  DxilShaderHash ShaderHash;
+  std::string Name;
+  bool HasName;
+  std::string Container;
+};
+
+static uint32_t AlignArchiveOffset(uint64_t offset, uint32_t alignment) {
+  return (uint32_t)((offset + alignment - 1) & ~(uint64_t)(alignment - 1));
+}
+
+static llvm::StringRef DigestKey(const DxilContainerHash &digest) {
+  return llvm::StringRef((const char *)digest.Digest, sizeof(digest.Digest));
+}
+
+static bool LessByDigest(const DxilShaderHash &A, const DxilShaderHash &B) {
+  return memcmp(A.Digest, B.Digest, sizeof(A.Digest)) < 0;
+}
+
+// Gets the name of the container from its debug name part, if it has one.
+static bool GetDebugName(const DxilContainerHeader *pHeader, std::string &name) {
+  const DxilPartHeader *pPart = GetDxilPartByType(pHeader, DFCC_ShaderDebugName);
+  if (!pPart || pPart->PartSize < MinDxilShaderDebugNameSize)
+    return false;
+  const DxilShaderDebugName *pDebugName =
+      (const DxilShaderDebugName *)GetDxilPartData(pPart);
+  if (sizeof(DxilShaderDebugName) + pDebugName->NameLength >= pPart->PartSize)
+    return false;
+  name.assign((const char *)(pDebugName + 1), pDebugName->NameLength);
+  return true;
+}
+
+class DxcShaderArchive : public IDxcShaderArchive {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcBlob> m_pArchive;
+  const DxilShaderArchiveHeader *m_pHeader = nullptr;
+  llvm::StringMap<const DxilPackageRootSignatureHeader *> m_rootSignatures;
+
+  const uint8_t *GetBase() const {
+    return reinterpret_cast<const uint8_t *>(m_pHeader);
+  }
+  const DxilShaderArchiveEntry *GetEntries() const {
+    return reinterpret_cast<const DxilShaderArchiveEntry *>(
+        GetBase() + m_pHeader->EntriesOffset);
+  }
+  const DxilShaderArchiveName *GetNames() const {
+    return reinterpret_cast<const DxilShaderArchiveName *>(
+        GetBase() + m_pHeader->NameIndexOffset);
+  }
+  const char *GetString(uint32_t offset) const {
+    return reinterpret_cast<const char *>(GetBase() +
+                                          m_pHeader->StringPoolOffset + offset);
+  }
+
+  // Returns the container of the entry, expanding its root signature
+  // reference if it has one.
+  HRESULT GetEntryContainer(const DxilShaderArchiveEntry &entry,
+                            IDxcBlob **ppResult) {
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      const DxilContainerHeader *pHeader =
+          reinterpret_cast<const DxilContainerHeader *>(GetBase() +
+                                                        entry.ContainerOffset);
+      IFTBOOL(IsValidDxilContainer(pHeader, entry.ContainerSize),
+              DXC_E_CONTAINER_INVALID);
+      uint32_t refIndex = pHeader->PartCount;
+      for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+        if (GetDxilContainerPart(pHeader, i)->PartFourCC == DFCC_RootSignatureRef)
+          refIndex = i;
+      }
+      if (refIndex == pHeader->PartCount) {
+        return DxcCreateBlobFromBlob(m_pArchive, entry.ContainerOffset,
+                                     pHeader->ContainerSizeInBytes, ppResult);
+      }
+
+      const DxilPartHeader *pRef = GetDxilContainerPart(pHeader, refIndex);
+      IFTBOOL(pRef->PartSize == sizeof(DxilContainerHash), DXC_E_CONTAINER_INVALID);
+      auto it = m_rootSignatures.find(
+          llvm::StringRef(GetDxilPartData(pRef), sizeof(DxilContainerHash)));
+      IFTBOOL(it != m_rootSignatures.end(), DXC_E_MISSING_PART);
+      std::string expanded;
+      IFTBOOL(RebuildDxilContainer(pHeader, refIndex, DFCC_RootSignature,
+                                   it->second + 1, it->second->Size, expanded),
+              DXC_E_CONTAINER_INVALID);
+
+      CComPtr<AbstractMemoryStream> pStream;
+      IFT(CreateMemoryStream(m_pMalloc, &pStream));
+      ULONG cbWritten;
+      IFT(pStream->Write(expanded.data(), expanded.size(), &cbWritten));
+      return pStream->QueryInterface(ppResult);
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcShaderArchive)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcShaderArchive>(this, riid, ppvObject);
+  }
+
+  void Init(IDxcBlob *pArchive) {
+    m_pHeader = IsValidDxilShaderArchive(pArchive->GetBufferPointer(),
+                                         pArchive->GetBufferSize());
+    IFTBOOL(m_pHeader, DXC_E_CONTAINER_INVALID);
+    m_pArchive = pArchive;
+    const uint32_t *pRSOffsets = reinterpret_cast<const uint32_t *>(
+        GetBase() + m_pHeader->RootSignaturesOffset);
+    for (uint32_t i = 0; i < m_pHeader->RootSignatureCount; ++i) {
+      const DxilPackageRootSignatureHeader *pRS =
+          reinterpret_cast<const DxilPackageRootSignatureHeader *>(
+              GetBase() + pRSOffsets[i]);
+      m_rootSignatures[DigestKey(pRS->Digest)] = pRS;
+    }
+  }
+
+  HRESULT STDMETHODCALLTYPE GetContainerCount(_Out_ UINT32 *pResult) override {
+    if (pResult == nullptr)
+      return E_POINTER;
+    *pResult = m_pHeader->EntryCount;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetContainer(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) override {
+    if (ppResult == nullptr)
+      return E_POINTER;
+    *ppResult = nullptr;
+    if (idx >= m_pHeader->EntryCount)
+      return E_BOUNDS;
+    return GetEntryContainer(GetEntries()[idx], ppResult);
+  }
+
+  HRESULT STDMETHODCALLTYPE FindContainerByHash(
+      _In_ const DxcShaderHash *pHash,
+      _COM_Outptr_result_maybenull_ IDxcBlob **ppResult) override {
+    if (ppResult == nullptr)
+      return E_POINTER;
+    *ppResult = nullptr;
+    if (pHash == nullptr)
+      return E_INVALIDARG;
+    DxilShaderHash key;
+    key.Flags = pHash->Flags;
+    static_assert(sizeof(key.Digest) == sizeof(pHash->HashDigest),
+                  "otherwise digest sizes differ");
+    memcpy(key.Digest, pHash->HashDigest, sizeof(key.Digest));
+    const DxilShaderArchiveEntry *pBegin = GetEntries();
+    const DxilShaderArchiveEntry *pEnd = pBegin + m_pHeader->EntryCount;
+    const DxilShaderArchiveEntry *pFound = std::lower_bound(
+        pBegin, pEnd, key,
+        [](const DxilShaderArchiveEntry &E, const DxilShaderHash &H) {
+          return LessByDigest(E.ShaderHash, H);
+        });
+    if (pFound == pEnd || LessByDigest(key, pFound->ShaderHash))
+      return S_FALSE;
+    return GetEntryContainer(*pFound, ppResult);
+  }
+
+  HRESULT STDMETHODCALLTYPE FindContainerByName(
+      _In_z_ LPCWSTR pName,
+      _COM_Outptr_result_maybenull_ IDxcBlob **ppResult) override {
+    if (ppResult == nullptr)
+      return E_POINTER;
+    *ppResult = nullptr;
+    if (pName == nullptr)
+      return E_INVALIDARG;
+    DxcThreadMalloc TM(m_pMalloc);
+    std::string name;
+    if (!Unicode::UTF16ToUTF8String(pName, &name))
+      return E_INVALIDARG;
+    uint64_t hash = ComputeShaderArchiveNameHash(name.data(), name.size());
+    const DxilShaderArchiveName *pBegin = GetNames();
+    const DxilShaderArchiveName *pEnd = pBegin + m_pHeader->NameIndexCount;
+    const DxilShaderArchiveName *pFound = std::lower_bound(
+        pBegin, pEnd, hash, [](const DxilShaderArchiveName &N, uint64_t H) {
+          return N.NameHash < H;
+        });
+    for (; pFound != pEnd && pFound->NameHash == hash; ++pFound) {
+      const DxilShaderArchiveEntry &entry = GetEntries()[pFound->EntryIndex];
+      if (name == GetString(entry.NameOffset))
+        return GetEntryContainer(entry, ppResult);
+    }
+    return S_FALSE;
+  }
+};
+
+} // namespace
+
+namespace dxcutil {
+
+HRESULT WriteShaderArchive(IMalloc *pMalloc, IDxcBlob **ppContainers,
+                           LPCWSTR *pNames, UINT32 count,
+                           IDxcBlob **ppArchive) {
+  if (ppArchive == nullptr)
+    return E_POINTER;
+  *ppArchive = nullptr;
+  if (ppContainers == nullptr && count != 0)
+    return E_INVALIDARG;
+  DxcThreadMalloc TM(pMalloc);
+  try {
+    std::vector<ArchiveItem> items(count);
+    std::vector<std::string> rootSignatures;
+    llvm::StringMap<uint32_t> rootSignatureIndex;
+    for (UINT32 i = 0; i < count; ++i) {
+      IDxcBlob *pContainer = ppContainers[i];
+      IFTBOOL(pContainer != nullptr, E_INVALIDARG);
+      const DxilContainerHeader *pHeader = IsDxilContainerLike(
+          pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+      IFTBOOL(pHeader && IsValidDxilContainer(pHeader, pContainer->GetBufferSize()),
+              DXC_E_CONTAINER_INVALID);
+      ArchiveItem &item = items[i];
+
+      memset(&item.ShaderHash, 0, sizeof(item.ShaderHash));
+      const DxilPartHeader *pHashPart = GetDxilPartByType(pHeader, DFCC_ShaderHash);
+      if (pHashPart && pHashPart->PartSize >= sizeof(DxilShaderHash))
+        memcpy(&item.ShaderHash, GetDxilPartData(pHashPart), sizeof(DxilShaderHash));
+
+      if (pNames && pNames[i]) {
+        IFTBOOL(Unicode::UTF16ToUTF8String(pNames[i], &item.Name), E_INVALIDARG);
+        item.HasName = true;
+      } else {
+        item.HasName = GetDebugName(pHeader, item.Name);
+      }
+
+      // Pool the root signature as a container package does.
+      uint32_t rsIndex = pHeader->PartCount;
+      for (uint32_t p = 0; p < pHeader->PartCount; ++p) {
+        uint32_t fourCC = GetDxilContainerPart(pHeader, p)->PartFourCC;
+        IFTBOOL(fourCC != DFCC_RootSignatureRef, DXC_E_CONTAINER_INVALID);
+        if (fourCC == DFCC_RootSignature)
+          rsIndex = p;
+      }
+      if (rsIndex != pHeader->PartCount && IsContiguousDxilContainer(pHeader)) {
+        const DxilPartHeader *pRSPart = GetDxilContainerPart(pHeader, rsIndex);
+        DxilContainerHash digest;
+        ComputeFastShaderHash(GetDxilPartData(pRSPart), pRSPart->PartSize, digest.Digest);
+        std::string rs(GetDxilPartData(pRSPart), pRSPart->PartSize);
+        auto it = rootSignatureIndex.find(DigestKey(digest));
+        bool pooled = true;
+        if (it == rootSignatureIndex.end()) {
+          rootSignatureIndex[DigestKey(digest)] = (uint32_t)rootSignatures.size();
+          rootSignatures.emplace_back(std::move(rs));
+        } else {
+          pooled = rootSignatures[it->second] == rs;
+        }
+        if (pooled)
+          IFTBOOL(RebuildDxilContainer(pHeader, rsIndex, DFCC_RootSignatureRef,
+                                       &digest, sizeof(digest), item.Container),
+                  DXC_E_CONTAINER_INVALID);
+      }
+      if (item.Container.empty())
+        item.Container.assign((const char *)pHeader, pHeader->ContainerSizeInBytes);
+    }
+
+    std::stable_sort(items.begin(), items.end(),
+                     [](const ArchiveItem &A, const ArchiveItem &B) {
+                       return LessByDigest(A.ShaderHash, B.ShaderHash);
+                     });
+
+    // Pool the names and index them by hash.
+    std::string strings;
+    llvm::StringMap<uint32_t> stringOffsets;
+    std::vector<DxilShaderArchiveEntry> entries(count);
+    std::vector<DxilShaderArchiveName> names;
+    for (UINT32 i = 0; i < count; ++i) {
+      entries[i].ShaderHash = items[i].ShaderHash;
+      entries[i].NameOffset = UINT32_MAX;
+      if (!items[i].HasName)
+        continue;
+      auto inserted = stringOffsets.insert(
+          std::make_pair(items[i].Name, (uint32_t)strings.size()));
+      if (inserted.second) {
+        strings.append(items[i].Name);
+        strings.push_back('\0');
+      }
+      entries[i].NameOffset = inserted.first->second;
+      DxilShaderArchiveName name;
+      name.NameHash = ComputeShaderArchiveNameHash(items[i].Name.data(),
+                                                   items[i].Name.size());
+      name.EntryIndex = i;
+      name.Reserved = 0;
+      names.push_back(name);
+    }
+    std::stable_sort(names.begin(), names.end(),
+                     [](const DxilShaderArchiveName &A, const DxilShaderArchiveName &B) {
+                       return A.NameHash < B.NameHash;
+                     });
+
+    // Lay out the archive: header, index, strings, root signatures, and then
+    // the containers on their own alignment.
+    DxilShaderArchiveHeader header = {};
+    header.HeaderFourCC = DFCC_ShaderArchive;
+    header.Version.Major = DxilContainerVersionMajor;
+    header.Version.Minor = DxilContainerVersionMinor;
+    header.EntryCount = count;
+    header.NameIndexCount = (uint32_t)names.size();
+    header.StringPoolSize = (uint32_t)strings.size();
+    header.RootSignatureCount = (uint32_t)rootSignatures.size();
+    uint64_t size = sizeof(DxilShaderArchiveHeader);
+    header.EntriesOffset = (uint32_t)size;
+    size += sizeof(DxilShaderArchiveEntry) * (uint64_t)count;
+    size = AlignArchiveOffset(size, 8);
+    header.NameIndexOffset = (uint32_t)size;
+    size += sizeof(DxilShaderArchiveName) * (uint64_t)names.size();
+    header.StringPoolOffset = (uint32_t)size;
+    size += strings.size();
+    size = AlignArchiveOffset(size, 4);
+    header.RootSignaturesOffset = (uint32_t)size;
+    size += sizeof(uint32_t) * (uint64_t)rootSignatures.size();
+    std::vector<uint32_t> rsOffsets;
+    for (const std::string &rs : rootSignatures) {
+      size = AlignArchiveOffset(size, 4);
+      rsOffsets.push_back((uint32_t)size);
+      size += sizeof(DxilPackageRootSignatureHeader) + rs.size();
+    }
+    for (UINT32 i = 0; i < count; ++i) {
+      size = AlignArchiveOffset(size, DxilShaderArchiveAlignment);
+      entries[i].ContainerOffset = (uint32_t)size;
+      entries[i].ContainerSize = (uint32_t)items[i].Container.size();
+      size += items[i].Container.size();
+      IFTBOOL(size <= UINT32_MAX, E_OUTOFMEMORY);
+    }
+    IFTBOOL(size <= UINT32_MAX, E_OUTOFMEMORY);
+    header.ArchiveSizeInBytes = (uint32_t)size;
+
+    CComPtr<AbstractMemoryStream> pStream;
+    IFT(CreateMemoryStream(pMalloc, &pStream));
+    IFT(pStream->Reserve((ULONG)size));
+    ULONG cbWritten;
+    static const uint8_t padding[DxilShaderArchiveAlignment] = {};
+    auto write = [&](const void *pData, size_t dataSize) {
+      IFT(pStream->Write(pData, (ULONG)dataSize, &cbWritten));
+    };
+    auto padTo = [&](uint32_t offset) {
+      uint64_t position = pStream->GetPosition();
+      DXASSERT_NOMSG(position <= offset && offset - position < sizeof(padding));
+      write(padding, (size_t)(offset - position));
+    };
+    write(&header, sizeof(header));
+    write(entries.data(), sizeof(DxilShaderArchiveEntry) * entries.size());
+    padTo(header.NameIndexOffset);
+    write(names.data(), sizeof(DxilShaderArchiveName) * names.size());
+    write(strings.data(), strings.size());
+    padTo(header.RootSignaturesOffset);
+    write(rsOffsets.data(), sizeof(uint32_t) * rsOffsets.size());
+    for (size_t i = 0; i < rootSignatures.size(); ++i) {
+      padTo(rsOffsets[i]);
+      DxilPackageRootSignatureHeader rsHeader;
+      ComputeFastShaderHash(rootSignatures[i].data(), rootSignatures[i].size(),
+                            rsHeader.Digest.Digest);
+      rsHeader.Size = (uint32_t)rootSignatures[i].size();
+      write(&rsHeader, sizeof(rsHeader));
+      write(rootSignatures[i].data(), rootSignatures[i].size());
+    }
+    for (UINT32 i = 0; i < count; ++i) {
+      padTo(entries[i].ContainerOffset);
+      write(items[i].Container.data(), items[i].Container.size());
+    }
+    DXASSERT_NOMSG(pStream->GetPosition() == size);
+    return pStream->QueryInterface(ppArchive);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT LoadShaderArchive(IMalloc *pMalloc, IDxcBlob *pArchive,
+                          IDxcShaderArchive **ppResult) {
+  if (ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+  if (pArchive == nullptr)
+    return E_INVALIDARG;
+  DxcThreadMalloc TM(pMalloc);
+  try {
+    CComPtr<DxcShaderArchive> pResult = DxcShaderArchive::Alloc(pMalloc);
+    IFTBOOL(pResult.p != nullptr, E_OUTOFMEMORY);
+    pResult->Init(pArchive);
+    *ppResult = pResult.Detach();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+} // namespace dxcutil
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcshaderarchive.h                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the shader archive support used by DxcUtils.                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/dxcapi.h"
+
+namespace dxcutil {
+
+HRESULT WriteShaderArchive(_In_ IMalloc *pMalloc,
+                           _In_count_(count) IDxcBlob **ppContainers,
+                           _In_opt_count_(count) LPCWSTR *pNames,
+                           UINT32 count, _COM_Outptr_ IDxcBlob **ppArchive);
+
+HRESULT LoadShaderArchive(_In_ IMalloc *pMalloc, _In_ IDxcBlob *pArchive,
+                          _COM_Outptr_ IDxcShaderArchive **ppResult);
+
+} // namespace dxcutil
@@ -0,0 +1,302 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxctimeprofile.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the -ftime-report phase and pass profiler used by DxcCompiler. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxctimeprofile.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/PassInfo.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace dxcutil {
+
+///////////////////////////////////////////////////////////////////////////////
+// DxcCountingMalloc
+
+void *STDMETHODCALLTYPE DxcCountingMalloc::Alloc(SIZE_T cb) {
+  if (WouldExceedLimit((int64_t)cb))
+    return nullptr;
+  void *p = m_pMalloc->Alloc(cb);
+  if (p) {
+    m_allocatedBytes += cb;
+    RecordSize(p, cb);
+    AddLive((int64_t)cb);
+  }
+  return p;
+}
+
+void *STDMETHODCALLTYPE DxcCountingMalloc::Realloc(void *pv, SIZE_T cb) {
+  int64_t priorSize = pv ? (int64_t)TakeSize(pv) : 0;
+  if (WouldExceedLimit((int64_t)cb - priorSize)) {
+    RecordSize(pv, (SIZE_T)priorSize);
+    return nullptr;
+  }
+  void *p = m_pMalloc->Realloc(pv, cb);
+  if (p) {
+    m_allocatedBytes += cb;
+    RecordSize(p, cb);
+    AddLive((int64_t)cb - priorSize);
+  } else {
+    RecordSize(pv, (SIZE_T)priorSize);
+  }
+  return p;
+}
+
+void STDMETHODCALLTYPE DxcCountingMalloc::Free(void *pv) {
+  if (pv)
+    AddLive(-(int64_t)TakeSize(pv));
+  m_pMalloc->Free(pv);
+}
+
+bool DxcCountingMalloc::WouldExceedLimit(int64_t delta) {
+  if (m_limitBytes == 0 || delta <= 0 || m_liveBytes + delta <= m_limitBytes)
+    return false;
+  m_limitExceeded = true;
+  return true;
+}
+
+#ifdef _WIN32
+void DxcCountingMalloc::TrackLiveBytes() {}
+
+bool DxcCountingMalloc::TracksLiveBytes() const { return true; }
+
+void DxcCountingMalloc::RecordSize(void *pv, SIZE_T cb) {}
+
+SIZE_T DxcCountingMalloc::TakeSize(void *pv) { return m_pMalloc->GetSize(pv); }
+#else
+void DxcCountingMalloc::TrackLiveBytes() { m_trackSizes = true; }
+
+bool DxcCountingMalloc::TracksLiveBytes() const { return m_trackSizes; }
+
+void DxcCountingMalloc::RecordSize(void *pv, SIZE_T cb) {
+  if (!m_trackSizes || !pv)
+    return;
+  std::lock_guard<std::mutex> lock(m_sizesLock);
+  m_sizes[pv] = cb;
+}
+
+SIZE_T DxcCountingMalloc::TakeSize(void *pv) {
+  if (!m_trackSizes)
+    return 0;
+  std::lock_guard<std::mutex> lock(m_sizesLock);
+  // Blocks allocated before this allocator was installed are not known.
+  auto it = m_sizes.find(pv);
+  if (it == m_sizes.end())
+    return 0;
+  SIZE_T cb = it->second;
+  m_sizes.erase(it);
+  return cb;
+}
+#endif
+
+void DxcCountingMalloc::SetLimit(uint64_t Bytes) {
+  TrackLiveBytes();
+  m_limitBytes = (int64_t)Bytes;
+}
+
+void DxcCountingMalloc::AddLive(int64_t delta) {
+  MergePeak(m_liveBytes += delta);
+}
+
+void DxcCountingMalloc::MergePeak(int64_t peak) {
+  int64_t current = m_peakBytes;
+  while (peak > current && !m_peakBytes.compare_exchange_weak(current, peak))
+    ;
+}
+
+int64_t DxcCountingMalloc::ResetPeak() {
+  return m_peakBytes.exchange(m_liveBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DxcTimeProfile
+
+const uint64_t DxcTimeProfile::kNoCount;
+
+static uint64_t CountInstructions(const Function &F) {
+  uint64_t count = 0;
+  for (const BasicBlock &BB : F)
+    count += BB.size();
+  return count;
+}
+
+static uint64_t CountInstructions(const Module &M) {
+  uint64_t count = 0;
+  for (const Function &F : M)
+    count += CountInstructions(F);
+  return count;
+}
+
+DxcTimeProfile::Phase::Phase(DxcTimeProfile *pProfile, const char *pName,
+                             const Module *pModuleBefore)
+    : m_span(pName), m_pProfile(pProfile), m_index(0) {
+  if (!m_pProfile)
+    return;
+  Record R;
+  R.Name = pName;
+  R.Kind = RecordKind::Phase;
+  R.Depth = m_pProfile->m_active.size();
+  m_index = m_pProfile->m_records.size();
+  m_pProfile->m_records.emplace_back(std::move(R));
+  m_pProfile->Begin(m_index, pModuleBefore ? CountInstructions(*pModuleBefore)
+                                           : kNoCount);
+}
+
+DxcTimeProfile::Phase::~Phase() {
+  if (!m_pProfile)
+    return;
+  m_pProfile->End(m_index, m_pModuleAfter ? CountInstructions(*m_pModuleAfter)
+                                          : kNoCount);
+}
+
+DxcTimeProfile::DxcTimeProfile(DxcCountingMalloc *pMalloc)
+    : m_pMalloc(pMalloc) {
+  m_pPriorObserver = legacy::setThreadPassRunObserver(this);
+  m_pPriorValidationObserver = SetThreadValidationObserver(this);
+}
+
+DxcTimeProfile::~DxcTimeProfile() {
+  SetThreadValidationObserver(m_pPriorValidationObserver);
+  legacy::setThreadPassRunObserver(m_pPriorObserver);
+}
+
+void DxcTimeProfile::AddCount(uint64_t &total, uint64_t count) {
+  if (count == kNoCount)
+    return;
+  total = total == kNoCount ? count : total + count;
+}
+
+void DxcTimeProfile::Begin(unsigned index, uint64_t instrBefore) {
+  Record &R = m_records[index];
+  ++R.Runs;
+  AddCount(R.InstrBefore, instrBefore);
+  ActiveRun Run;
+  Run.Index = index;
+  Run.AllocStart = m_pMalloc->GetAllocatedBytes();
+  Run.LiveStart = m_pMalloc->GetLiveBytes();
+  Run.OuterPeak = m_pMalloc->ResetPeak();
+  // Read the clock last so the bookkeeping above is not charged to the run.
+  Run.Start = Clock::now();
+  m_active.push_back(Run);
+}
+
+void DxcTimeProfile::End(unsigned index, uint64_t instrAfter) {
+  Clock::time_point Stop = Clock::now();
+  DXASSERT_NOMSG(!m_active.empty() && m_active.back().Index == index);
+  ActiveRun Run = m_active.back();
+  m_active.pop_back();
+  Record &R = m_records[index];
+  R.Wall += Stop - Run.Start;
+  R.AllocBytes += m_pMalloc->GetAllocatedBytes() - Run.AllocStart;
+  int64_t peak = m_pMalloc->GetPeakBytes();
+  R.PeakBytes = std::max(R.PeakBytes, peak - Run.LiveStart);
+  m_pMalloc->MergePeak(Run.OuterPeak);
+  AddCount(R.InstrAfter, instrAfter);
+}
+
+void DxcTimeProfile::beforePass(Pass *P, Module &M, Function *F) {
+  // Key on the pass identity as well as the instance, in case a pass is
+  // freed and a different one is later allocated at the same address.
+  std::pair<const void *, const void *> Key(P, P->getPassID());
+  auto it = m_passIndex.find(Key);
+  if (it == m_passIndex.end()) {
+    Record R;
+    R.Name = P->getPassName();
+    if (const PassInfo *PI = Pass::lookupPassInfo(P->getPassID()))
+      R.Argument = PI->getPassArgument();
+    if (P->getAsPMDataManager())
+      R.Kind = RecordKind::PassManager;
+    else
+      R.Kind = F ? RecordKind::FunctionPass : RecordKind::ModulePass;
+    R.Depth = m_active.size();
+    it = m_passIndex.insert(std::make_pair(Key, (unsigned)m_records.size())).first;
+    m_records.emplace_back(std::move(R));
+  }
+  Begin(it->second, F ? CountInstructions(*F) : CountInstructions(M));
+}
+
+void DxcTimeProfile::afterPass(Pass *P, Module &M, Function *F) {
+  std::pair<const void *, const void *> Key(P, P->getPassID());
+  auto it = m_passIndex.find(Key);
+  DXASSERT_NOMSG(it != m_passIndex.end());
+  End(it->second, F ? CountInstructions(*F) : CountInstructions(M));
+}
+
+void DxcTimeProfile::beforeRuleGroup(const char *pName) {
+  auto it = m_ruleGroupIndex.find(pName);
+  if (it == m_ruleGroupIndex.end()) {
+    Record R;
+    R.Name = pName;
+    R.Kind = RecordKind::RuleGroup;
+    R.Depth = m_active.size();
+    it = m_ruleGroupIndex.insert(std::make_pair(pName, (unsigned)m_records.size())).first;
+    m_records.emplace_back(std::move(R));
+  }
+  Begin(it->second, kNoCount);
+}
+
+void DxcTimeProfile::afterRuleGroup(const char *pName) {
+  auto it = m_ruleGroupIndex.find(pName);
+  DXASSERT_NOMSG(it != m_ruleGroupIndex.end());
+  End(it->second, kNoCount);
+}
+
+static void WriteJsonString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char c : Str) {
+    if (c == '"' || c == '\\')
+      OS << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      OS << format("\\u%04x", (unsigned)c);
+    else
+      OS << c;
+  }
+  OS << '"';
+}
+
+void DxcTimeProfile::WriteJson(raw_ostream &OS) const {
+  static const char *KindNames[] = { "phase", "module", "function", "manager",
+                                     "rules" };
+  OS << "{\n  \"version\": 1,\n  \"tracksLiveBytes\": "
+     << (m_pMalloc->TracksLiveBytes() ? "true" : "false")
+     << ",\n  \"records\": [";
+  bool first = true;
+  for (const Record &R : m_records) {
+    OS << (first ? "\n" : ",\n") << "    {\"name\": ";
+    first = false;
+    WriteJsonString(OS, R.Name);
+    if (!R.Argument.empty()) {
+      OS << ", \"arg\": ";
+      WriteJsonString(OS, R.Argument);
+    }
+    OS << ", \"kind\": \"" << KindNames[(unsigned)R.Kind] << '"'
+       << ", \"depth\": " << R.Depth
+       << ", \"runs\": " << R.Runs
+       << ", \"wallUs\": "
+       << (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(R.Wall).count();
+    if (R.InstrBefore != kNoCount)
+      OS << ", \"instrBefore\": " << R.InstrBefore;
+    if (R.InstrAfter != kNoCount)
+      OS << ", \"instrAfter\": " << R.InstrAfter;
+    OS << ", \"allocBytes\": " << R.AllocBytes;
+    if (m_pMalloc->TracksLiveBytes())
+      OS << ", \"peakBytes\": " << R.PeakBytes;
+    OS << '}';
+  }
+  OS << "\n  ]\n}\n";
+}
+
+} // namespace dxcutil
@@ -0,0 +1,204 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxctimeprofile.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the -ftime-report phase and pass profiler used by DxcCompiler.   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/HLSL/DxilValidation.h"
+#include "dxc/Support/DxcTrace.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class Function;
+class Module;
+class raw_ostream;
+}
+
+namespace dxcutil {
+
+// IMalloc that forwards to another allocator and counts the bytes that go
+// through it, optionally refusing allocations past a limit. Freed bytes are
+// counted through the block sizes the inner allocator reports on Windows.
+// Elsewhere the allocator has to record the size of every block, which is
+// only done once TrackLiveBytes is called; until then live and peak bytes
+// are not tracked.
+class DxcCountingMalloc : public IMalloc {
+private:
+#ifndef _WIN32
+  // Allocates from the C runtime, so that recording a block does not
+  // allocate through this allocator again.
+  template <typename T> struct CrtAllocator {
+    typedef T value_type;
+    CrtAllocator() {}
+    template <typename U> CrtAllocator(const CrtAllocator<U> &) {}
+    T *allocate(size_t n) {
+      void *p = std::malloc(n * sizeof(T));
+      if (!p)
+        throw std::bad_alloc();
+      return (T *)p;
+    }
+    void deallocate(T *p, size_t) { std::free(p); }
+    bool operator==(const CrtAllocator &) const { return true; }
+    bool operator!=(const CrtAllocator &) const { return false; }
+  };
+  typedef std::unordered_map<void *, SIZE_T, std::hash<void *>,
+                             std::equal_to<void *>,
+                             CrtAllocator<std::pair<void *const, SIZE_T>>>
+      BlockSizeMap;
+#endif
+
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::atomic<uint64_t> m_allocatedBytes;
+  std::atomic<int64_t> m_liveBytes;
+  std::atomic<int64_t> m_peakBytes;
+  int64_t m_limitBytes = 0;
+  std::atomic<bool> m_limitExceeded;
+#ifndef _WIN32
+  bool m_trackSizes = false;
+  std::mutex m_sizesLock;
+  BlockSizeMap m_sizes;
+#endif
+
+  void AddLive(int64_t delta);
+  bool WouldExceedLimit(int64_t delta);
+  void RecordSize(void *pv, SIZE_T cb);
+  SIZE_T TakeSize(void *pv);
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_ALLOC(DxcCountingMalloc)
+  DxcCountingMalloc(IMalloc *pMalloc)
+      : m_dwRef(0), m_pMalloc(pMalloc), m_allocatedBytes(0), m_liveBytes(0),
+        m_peakBytes(0), m_limitExceeded(false) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+
+  void *STDMETHODCALLTYPE Alloc(_In_ SIZE_T cb) override;
+  void *STDMETHODCALLTYPE Realloc(_In_opt_ void *pv, _In_ SIZE_T cb) override;
+  void STDMETHODCALLTYPE Free(_In_opt_ void *pv) override;
+#ifdef _WIN32
+  SIZE_T STDMETHODCALLTYPE GetSize(_In_opt_ void *pv) override {
+    return m_pMalloc->GetSize(pv);
+  }
+  int STDMETHODCALLTYPE DidAlloc(_In_opt_ void *pv) override {
+    return m_pMalloc->DidAlloc(pv);
+  }
+  void STDMETHODCALLTYPE HeapMinimize(void) override {
+    m_pMalloc->HeapMinimize();
+  }
+#endif
+
+  // Both must be called before anything is allocated through this.
+  void TrackLiveBytes();
+  // Refuses allocations that would take the live bytes past Bytes, and
+  // remembers that it did. Tracks live bytes.
+  void SetLimit(uint64_t Bytes);
+
+  bool TracksLiveBytes() const;
+  bool IsLimitExceeded() const { return m_limitExceeded; }
+  uint64_t GetAllocatedBytes() const { return m_allocatedBytes; }
+  int64_t GetLiveBytes() const { return m_liveBytes; }
+  int64_t GetPeakBytes() const { return m_peakBytes; }
+  // Restarts peak tracking at the current live size and returns the prior
+  // peak, so a nested interval can be measured and then merged back.
+  int64_t ResetPeak();
+  void MergePeak(int64_t peak);
+};
+
+// Records wall time, allocator traffic and instruction counts for the
+// phases of a compile and for every pass the legacy pass managers run on
+// this thread while it is alive, and writes them out as JSON. Validation
+// run by the compile is broken down by rule group.
+class DxcTimeProfile : public llvm::legacy::PassRunObserver,
+                       public hlsl::ValidationObserver {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Measures one compile phase for as long as it is in scope, and traces it
+  // when DXC_TRACE_FILE is set. A null profile only skips the measurement,
+  // so call sites need no conditionals.
+  class Phase {
+  public:
+    Phase(DxcTimeProfile *pProfile, const char *pName,
+          const llvm::Module *pModuleBefore = nullptr);
+    ~Phase();
+    void SetModuleAfter(const llvm::Module *pModule) { m_pModuleAfter = pModule; }
+
+  private:
+    hlsl::DxcTraceSpan m_span;
+    DxcTimeProfile *m_pProfile;
+    unsigned m_index;
+    const llvm::Module *m_pModuleAfter = nullptr;
+  };
+
+  explicit DxcTimeProfile(DxcCountingMalloc *pMalloc);
+  ~DxcTimeProfile() override;
+
+  void beforePass(llvm::Pass *P, llvm::Module &M, llvm::Function *F) override;
+  void afterPass(llvm::Pass *P, llvm::Module &M, llvm::Function *F) override;
+
+  void beforeRuleGroup(const char *pName) override;
+  void afterRuleGroup(const char *pName) override;
+
+  void WriteJson(llvm::raw_ostream &OS) const;
+
+private:
+  static const uint64_t kNoCount = ~0ULL;
+
+  enum class RecordKind { Phase, ModulePass, FunctionPass, PassManager,
+                          RuleGroup };
+  struct Record {
+    std::string Name;
+    std::string Argument;
+    RecordKind Kind;
+    unsigned Depth;
+    unsigned Runs = 0;
+    Clock::duration Wall = Clock::duration::zero();
+    uint64_t InstrBefore = kNoCount;
+    uint64_t InstrAfter = kNoCount;
+    uint64_t AllocBytes = 0;
+    int64_t PeakBytes = 0;
+  };
+  struct ActiveRun {
+    unsigned Index;
+    Clock::time_point Start;
+    uint64_t AllocStart;
+    int64_t LiveStart;
+    int64_t OuterPeak;
+  };
+
+  void Begin(unsigned index, uint64_t instrBefore);
+  void End(unsigned index, uint64_t instrAfter);
+  static void AddCount(uint64_t &total, uint64_t count);
+
+  CComPtr<DxcCountingMalloc> m_pMalloc;
+  llvm::legacy::PassRunObserver *m_pPriorObserver;
+  hlsl::ValidationObserver *m_pPriorValidationObserver;
+  std::vector<Record> m_records;
+  llvm::DenseMap<std::pair<const void *, const void *>, unsigned> m_passIndex;
+  llvm::StringMap<unsigned> m_ruleGroupIndex;
+  std::vector<ActiveRun> m_active;
+};
+
+} // namespace dxcutil
@@ -12,9 +12,11 @@
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/DxilContainer/DxilContainerAssembler.h"
 #include "dxc/Support/Global.h"
+#include "dxc/Support/DxcCompileDeadline.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/dxcapi.h"
 #include "dxcutil.h"
+#include "dxctimeprofile.h"
 #include "dxillib.h"
 #include "clang/Basic/Diagnostic.h"
 #include "llvm/Bitcode/ReaderWriter.h"
@@ -24,7 +26,6 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Transforms/Utils/Cloning.h"
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/DXIL/DxilModule.h"
@@ -45,6 +46,8 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
                              _In_ llvm::Module *pDebugModule,
                              _In_ IDxcBlob *pShader, UINT32 Flags,
                              _In_ IDxcOperationResult **ppResult);
+// Identifies this build to IDxcModuleValidator implementations.
+uint64_t GetValidatorModuleBuildKey();
 
 namespace {
 // AssembleToContainer helper functions.
@@ -61,6 +64,20 @@ bool CreateValidator(CComPtr<IDxcValidator> &pValidator) {
   return bInternalValidator;
 }
 
+// Loads the module with debug info that the compiler wrote out before the
+// container was assembled, so validation errors can point at the source.
+std::unique_ptr<llvm::Module>
+LoadModuleWithDebugInfo(AbstractMemoryStream *pModuleBitcode,
+                        LLVMContext &Ctx) {
+  StringRef Bitcode((const char *)pModuleBitcode->GetPtr(),
+                    pModuleBitcode->GetPtrSize());
+  ErrorOr<std::unique_ptr<Module>> M =
+      parseBitcodeFile(MemoryBufferRef(Bitcode, ""), Ctx);
+  if (!M)
+    return nullptr;
+  return std::move(M.get());
+}
+
 } // namespace
 
 namespace dxcutil {
@@ -107,6 +124,7 @@ void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor) {
 }
 
 void AssembleToContainer(AssembleInputs &inputs) {
+  DxcTimeProfile::Phase Phase(inputs.pProfile, "container", inputs.pM.get());
   CComPtr<AbstractMemoryStream> pContainerStream;
   IFT(CreateMemoryStream(inputs.pMalloc, &pContainerStream));
   SerializeDxilContainerForModule(&inputs.pM->GetOrCreateDxilModule(),
@@ -143,10 +161,6 @@ void ReadOptsAndValidate(hlsl::options::MainArgs &mainArgs,
 HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
   HRESULT valHR = S_OK;
 
-  // If we have debug info, this will be a clone of the module before debug info is stripped.
-  // This is used with internal validator to provide more useful error messages.
-  std::unique_ptr<llvm::Module> llvmModuleWithDebugInfo;
-
   CComPtr<IDxcValidator> pValidator;
   bool bInternalValidator = CreateValidator(pValidator);
   // Warning on internal Validator
@@ -159,14 +173,6 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
                                "signed for use in release environments.\r\n");
       inputs.pDiag->Report(diagID);
     }
-    // If using the internal validator, we'll use the modules directly.
-    // In this case, we'll want to make a clone to avoid
-    // SerializeDxilContainerForModule stripping all the debug info. The debug
-    // info will be stripped from the orginal module, but preserved in the cloned
-    // module.
-    if (inputs.bDebugInfo) {
-      llvmModuleWithDebugInfo.reset(llvm::CloneModule(inputs.pM.get()));
-    }
   }
 
   // Verify validator version can validate this module
@@ -189,18 +195,58 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
     return E_FAIL;
   }
 
+  // Validators from dxil.dll do not know the function hash part.
+  if (!bInternalValidator)
+    inputs.SerializeFlags &= ~SerializeDxilFlags::IncludeFunctionHashPart;
+
   AssembleToContainer(inputs);
 
+  // A stale compile should not pay for validation.
+  hlsl::CheckCompileDeadline();
   CComPtr<IDxcOperationResult> pValResult;
-  // Important: in-place edit is required so the blob is reused and thus
-  // dxil.dll can be released.
-  if (bInternalValidator) {
-    IFT(RunInternalValidator(pValidator, inputs.pM.get(),
-                             llvmModuleWithDebugInfo.get(), inputs.pOutputContainerBlob,
-                             DxcValidatorFlags_InPlaceEdit, &pValResult));
-  } else {
-    IFT(pValidator->Validate(inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
-                             &pValResult));
+  {
+    DxcTimeProfile::Phase Phase(inputs.pProfile, "validation");
+    // Important: in-place edit is required so the blob is reused and thus
+    // dxil.dll can be released.
+    if (bInternalValidator) {
+      // The internal validator uses the module directly, after
+      // SerializeDxilContainerForModule has stripped its debug info. The
+      // bitcode the compiler wrote still has it, so rather than cloning the
+      // module up front, it is only loaded to report the errors at their
+      // source locations if validation fails.
+      IFT(RunInternalValidator(pValidator, inputs.pM.get(), nullptr,
+                               inputs.pOutputContainerBlob,
+                               DxcValidatorFlags_InPlaceEdit, &pValResult));
+      IFT(pValResult->GetStatus(&valHR));
+      if (FAILED(valHR) && inputs.bDebugInfo) {
+        LLVMContext DebugContext;
+        std::unique_ptr<llvm::Module> llvmModuleWithDebugInfo =
+            LoadModuleWithDebugInfo(inputs.pModuleBitcode, DebugContext);
+        if (llvmModuleWithDebugInfo) {
+          pValResult.Release();
+          IFT(RunInternalValidator(pValidator, inputs.pM.get(),
+                                   llvmModuleWithDebugInfo.get(),
+                                   inputs.pOutputContainerBlob,
+                                   DxcValidatorFlags_InPlaceEdit, &pValResult));
+        }
+      }
+    } else {
+      // A dxil.dll built from the same sources can use the module as is
+      // rather than parsing the bitcode that was just written.
+      HRESULT moduleHR = E_NOTIMPL;
+      CComPtr<IDxcModuleValidator> pModuleValidator;
+      if (SUCCEEDED(pValidator.QueryInterface(&pModuleValidator))) {
+        moduleHR = pModuleValidator->ValidateWithModule(
+            inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
+            GetValidatorModuleBuildKey(), inputs.pM.get(), &pValResult);
+      }
+      if (moduleHR == E_NOTIMPL) {
+        IFT(pValidator->Validate(inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
+                                 &pValResult));
+      } else {
+        IFT(moduleHR);
+      }
+    }
   }
   IFT(pValResult->GetStatus(&valHR));
   if (inputs.pDiag) {
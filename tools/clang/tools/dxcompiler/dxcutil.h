@@ -39,6 +39,7 @@ class DxcOpts;
 } // namespace hlsl
 
 namespace dxcutil {
+class DxcTimeProfile;
 struct AssembleInputs {
   AssembleInputs(std::unique_ptr<llvm::Module> &&pM,
                  CComPtr<IDxcBlob> &pOutputContainerBlob,
@@ -62,6 +63,7 @@ struct AssembleInputs {
   hlsl::DxilShaderHash *pShaderHashOut = nullptr;
   hlsl::AbstractMemoryStream *pReflectionOut = nullptr;
   hlsl::AbstractMemoryStream *pRootSigOut = nullptr;
+  DxcTimeProfile *pProfile = nullptr; // -ftime-report phases, if requested
 };
 HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs);
 HRESULT ValidateRootSignatureInContainer(
@@ -11,6 +11,7 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 
 #include "dxc/Support/WinIncludes.h"
@@ -20,10 +21,12 @@
 #include "dxc/Support/Global.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
+#include "dxccompilecache.h"
 
 #ifdef _WIN32
 #include "dxcetw.h"
@@ -36,6 +39,45 @@
 using namespace llvm;
 using namespace hlsl;
 
+// Identifies the build that llvm::Module objects passed to
+// IDxcModuleValidator come from, or returns 0 if the build is unknown.
+uint64_t GetValidatorModuleBuildKey() {
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+  static const uint64_t Key = []() {
+    MD5 Hasher;
+    const char *Hash = clang::getGitCommitHash();
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)Hash, strlen(Hash)));
+    uint32_t Layout[] = { clang::getGitCommitCount(),
+                          (uint32_t)sizeof(llvm::Module),
+                          (uint32_t)sizeof(llvm::LLVMContext),
+                          (uint32_t)sizeof(void *),
+#ifdef NDEBUG
+                          1,
+#else
+                          0,
+#endif
+#ifdef _MSC_VER
+                          _MSC_FULL_VER,
+#else
+                          0,
+#endif
+                        };
+    Hasher.update(ArrayRef<uint8_t>((const uint8_t *)Layout, sizeof(Layout)));
+#ifdef __VERSION__
+    Hasher.update(__VERSION__);
+#endif
+    MD5::MD5Result Result;
+    Hasher.final(Result);
+    uint64_t Key;
+    memcpy(&Key, Result, sizeof(Key));
+    return Key ? Key : 1;
+  }();
+  return Key;
+#else
+  return 0;
+#endif // SUPPORT_QUERY_GIT_COMMIT_INFO
+}
+
 // Utility class for setting and restoring the diagnostic context so we may capture errors/warnings
 struct DiagRestore {
   LLVMContext &Ctx;
@@ -53,7 +95,57 @@ struct DiagRestore {
   }
 };
 
+// Status and recorded errors of a structured validation.
+class DxcValidationResult : public IDxcValidationResult {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  HRESULT m_status;
+  std::vector<ValidationError> m_errors;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcValidationResult)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcValidationResult>(this, iid, ppvObject);
+  }
+
+  void Init(HRESULT status, std::vector<ValidationError> &&errors) {
+    m_status = status;
+    m_errors = std::move(errors);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetStatus(_Out_ HRESULT *pStatus) override {
+    if (pStatus == nullptr)
+      return E_INVALIDARG;
+    *pStatus = m_status;
+    return S_OK;
+  }
+
+  UINT32 STDMETHODCALLTYPE GetErrorCount() override {
+    return (UINT32)m_errors.size();
+  }
+
+  HRESULT STDMETHODCALLTYPE GetError(_In_ UINT32 Index,
+                                     _Out_ DxcValidationError *pError) override {
+    if (pError == nullptr || Index >= m_errors.size())
+      return E_INVALIDARG;
+    const ValidationError &Error = m_errors[Index];
+    pError->Rule = (UINT32)Error.Rule;
+    pError->pFunctionName =
+        Error.Function.empty() ? nullptr : Error.Function.c_str();
+    pError->InstructionIndex = Error.InstructionIndex;
+    pError->pFileName = Error.File.empty() ? nullptr : Error.File.c_str();
+    pError->Line = Error.Line;
+    pError->Column = Error.Column;
+    return S_OK;
+  }
+};
+
 class DxcValidator : public IDxcValidator,
+                     public IDxcStructuredValidator,
+                     public IDxcModuleValidator,
+                     public IDxcValidationCache,
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
                      public IDxcVersionInfo2
 #else
@@ -62,13 +154,20 @@ class DxcValidator : public IDxcValidator,
 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcCompileCacheStore> m_pCacheStore;
+
+  // Returns true if the cache store records that pShader passed with Flags.
+  // Key is set whenever there is a store, to record a later pass.
+  bool IsKnownValid(_In_ IDxcBlob *pShader, _In_ UINT32 Flags,
+                    dxcutil::CompileCacheKey &Key);
 
   HRESULT RunValidation(
     _In_ IDxcBlob *pShader,                       // Shader to validate.
     _In_ UINT32 Flags,                            // Validation flags.
     _In_ llvm::Module *pModule,                   // Module to validate, if available.
     _In_ llvm::Module *pDebugModule,              // Debug module to validate, if available
-    _In_ AbstractMemoryStream *pDiagStream);
+    _In_ AbstractMemoryStream *pDiagStream,
+    const ValidationOptions &Options = ValidationOptions());
 
   HRESULT RunRootSignatureValidation(
     _In_ IDxcBlob *pShader,                       // Shader to validate.
@@ -79,7 +178,9 @@ public:
   DXC_MICROCOM_TM_CTOR(DxcValidator)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcValidator, IDxcVersionInfo>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcValidator, IDxcStructuredValidator,
+                                 IDxcModuleValidator, IDxcValidationCache,
+                                 IDxcVersionInfo>(this, iid, ppvObject);
   }
 
   // For internal use only.
@@ -98,6 +199,30 @@ public:
     _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
     ) override;
 
+  // IDxcStructuredValidator
+  HRESULT STDMETHODCALLTYPE ValidateStructured(
+    _In_ IDxcBlob *pShader,                       // Shader to validate.
+    _In_ UINT32 Flags,                            // Validation flags.
+    _In_ UINT32 MaxErrors,                        // Errors to find before stopping, or 0 for all.
+    _COM_Outptr_ IDxcValidationResult **ppResult  // Validation status and errors
+    ) override;
+
+  // IDxcModuleValidator
+  HRESULT STDMETHODCALLTYPE ValidateWithModule(
+    _In_ IDxcBlob *pShader,                       // Shader to validate.
+    _In_ UINT32 Flags,                            // Validation flags.
+    _In_ UINT64 BuildKey,                         // Build key of the caller that created pModule.
+    _In_ void *pModule,                           // Module the shader was written from.
+    _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
+    ) override;
+
+  // IDxcValidationCache
+  HRESULT STDMETHODCALLTYPE SetStore(
+    _In_opt_ IDxcCompileCacheStore *pStore) override {
+    m_pCacheStore = pStore;
+    return S_OK;
+  }
+
   // IDxcVersionInfo
   HRESULT STDMETHODCALLTYPE GetVersion(_Out_ UINT32 *pMajor, _Out_ UINT32 *pMinor) override;
   HRESULT STDMETHODCALLTYPE GetFlags(_Out_ UINT32 *pFlags) override;
@@ -122,6 +247,73 @@ HRESULT STDMETHODCALLTYPE DxcValidator::Validate(
   return ValidateWithOptModules(pShader, Flags, nullptr, nullptr, ppResult);
 }
 
+HRESULT STDMETHODCALLTYPE DxcValidator::ValidateStructured(
+  _In_ IDxcBlob *pShader,                       // Shader to validate.
+  _In_ UINT32 Flags,                            // Validation flags.
+  _In_ UINT32 MaxErrors,                        // Errors to find before stopping, or 0 for all.
+  _COM_Outptr_ IDxcValidationResult **ppResult  // Validation status and errors
+) {
+  DxcThreadMalloc TM(m_pMalloc);
+  if (pShader == nullptr || ppResult == nullptr || Flags & ~DxcValidatorFlags_ValidMask)
+    return E_INVALIDARG;
+  // Root signature validation does not report rules.
+  if (Flags & DxcValidatorFlags_RootSignatureOnly)
+    return E_INVALIDARG;
+  if ((Flags & DxcValidatorFlags_ModuleOnly) && (Flags & DxcValidatorFlags_InPlaceEdit))
+    return E_INVALIDARG;
+  *ppResult = nullptr;
+  HRESULT hr = S_OK;
+  HRESULT validationStatus = S_OK;
+  DxcEtw_DxcValidation_Start();
+  try {
+    // Text from load failures and the like is not part of the result.
+    CComPtr<AbstractMemoryStream> pDiagStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pDiagStream));
+
+    std::vector<ValidationError> Errors;
+    dxcutil::CompileCacheKey Key;
+    if (!IsKnownValid(pShader, Flags, Key)) {
+      ValidationOptions Options;
+      Options.MaxErrors = MaxErrors;
+      Options.pErrors = &Errors;
+      validationStatus = RunValidation(pShader, Flags, nullptr, nullptr,
+                                       pDiagStream, Options);
+      if (m_pCacheStore && SUCCEEDED(validationStatus))
+        dxcutil::StoreValidationVerdict(m_pCacheStore, Key);
+    }
+
+    CComPtr<DxcValidationResult> pResult = DxcValidationResult::Alloc(m_pMalloc);
+    IFROOM(pResult.p);
+    pResult->Init(validationStatus, std::move(Errors));
+    *ppResult = pResult.Detach();
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+
+  DxcEtw_DxcValidation_Stop(SUCCEEDED(hr) ? validationStatus : hr);
+  return hr;
+}
+
+HRESULT STDMETHODCALLTYPE DxcValidator::ValidateWithModule(
+  _In_ IDxcBlob *pShader,                       // Shader to validate.
+  _In_ UINT32 Flags,                            // Validation flags.
+  _In_ UINT64 BuildKey,                         // Build key of the caller that created pModule.
+  _In_ void *pModule,                           // Module the shader was written from.
+  _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
+) {
+  DxcThreadMalloc TM(m_pMalloc);
+  if (pShader == nullptr || pModule == nullptr || ppResult == nullptr ||
+      Flags & ~DxcValidatorFlags_ValidMask)
+    return E_INVALIDARG;
+  if (Flags & (DxcValidatorFlags_ModuleOnly | DxcValidatorFlags_RootSignatureOnly))
+    return E_INVALIDARG;
+  // A module from any other build may have a different layout.
+  UINT64 Key = GetValidatorModuleBuildKey();
+  if (Key == 0 || Key != BuildKey)
+    return E_NOTIMPL;
+  return ValidateWithOptModules(pShader, Flags, (llvm::Module *)pModule,
+                                nullptr, ppResult);
+}
+
 HRESULT DxcValidator::ValidateWithOptModules(
   _In_ IDxcBlob *pShader,                       // Shader to validate.
   _In_ UINT32 Flags,                            // Validation flags.
@@ -138,13 +330,23 @@ HRESULT DxcValidator::ValidateWithOptModules(
     CComPtr<AbstractMemoryStream> pDiagStream;
     IFT(CreateMemoryStream(m_pMalloc, &pDiagStream));
 
+    // A module comes with a freshly written container, which is not worth
+    // looking up.
+    dxcutil::CompileCacheKey Key;
+    bool bKnownValid = !pModule && IsKnownValid(pShader, Flags, Key);
+
     // Run validation may throw, but that indicates an inability to validate,
     // not that the validation failed (eg out of memory).
-    if (Flags & DxcValidatorFlags_RootSignatureOnly) {
+    if (bKnownValid) {
+      validationStatus = S_OK;
+    } else if (Flags & DxcValidatorFlags_RootSignatureOnly) {
       validationStatus = RunRootSignatureValidation(pShader, pDiagStream);
     } else {
       validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule, pDiagStream);
     }
+    if (!pModule && !bKnownValid && m_pCacheStore &&
+        SUCCEEDED(validationStatus))
+      dxcutil::StoreValidationVerdict(m_pCacheStore, Key);
     if (FAILED(validationStatus)) {
       std::string msg("Validation failed.\n");
       ULONG cbWritten;
@@ -165,6 +367,16 @@ HRESULT DxcValidator::ValidateWithOptModules(
   return hr;
 }
 
+bool DxcValidator::IsKnownValid(_In_ IDxcBlob *pShader, _In_ UINT32 Flags,
+                                dxcutil::CompileCacheKey &Key) {
+  if (!m_pCacheStore)
+    return false;
+  UINT32 ValMajor, ValMinor;
+  GetValidationVersion(&ValMajor, &ValMinor);
+  dxcutil::ComputeValidationCacheKey(pShader, Flags, ValMajor, ValMinor, Key);
+  return dxcutil::LookupValidationVerdict(m_pCacheStore, Key);
+}
+
 HRESULT STDMETHODCALLTYPE DxcValidator::GetVersion(_Out_ UINT32 *pMajor, _Out_ UINT32 *pMinor) {
   if (pMajor == nullptr || pMinor == nullptr)
     return E_INVALIDARG;
@@ -206,7 +418,8 @@ HRESULT DxcValidator::RunValidation(
   _In_ UINT32 Flags,                            // Validation flags.
   _In_ llvm::Module *pModule,                   // Module to validate, if available.
   _In_ llvm::Module *pDebugModule,              // Debug module to validate, if available
-  _In_ AbstractMemoryStream *pDiagStream) {
+  _In_ AbstractMemoryStream *pDiagStream,
+  const ValidationOptions &Options) {
 
   // Run validation may throw, but that indicates an inability to validate,
   // not that the validation failed (eg out of memory). That is indicated
@@ -223,9 +436,9 @@ HRESULT DxcValidator::RunValidation(
   if (!pModule) {
     DXASSERT_NOMSG(pDebugModule == nullptr);
     if (Flags & DxcValidatorFlags_ModuleOnly) {
-      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream, Options);
     } else {
-      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream, Options);
     }
   }
 
@@ -233,11 +446,11 @@ HRESULT DxcValidator::RunValidation(
   PrintDiagnosticContext DiagContext(DiagPrinter);
   DiagRestore DR(pModule->getContext(), &DiagContext);
 
-  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule));
+  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule, Options));
   if (!(Flags & DxcValidatorFlags_ModuleOnly)) {
     IFR(ValidateDxilContainerParts(pModule, pDebugModule,
                       IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()),
-                      (uint32_t)pShader->GetBufferSize()));
+                      (uint32_t)pShader->GetBufferSize(), Options));
   }
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
@@ -266,19 +479,18 @@ HRESULT DxcValidator::RunRootSignatureValidation(
     IFRBOOL(pPSVPart, DXC_E_MISSING_PART);
   }
   try {
-    RootSignatureHandle RSH;
-    RSH.LoadSerialized((const uint8_t*)GetDxilPartData(pRSPart), pRSPart->PartSize);
-    RSH.Deserialize();
     raw_stream_ostream DiagStream(pDiagStream);
     if (pProgramHeader) {
-      IFRBOOL(VerifyRootSignatureWithShaderPSV(RSH.GetDesc(),
-                                               GetVersionShaderType(pProgramHeader->ProgramVersion),
-                                               GetDxilPartData(pPSVPart),
-                                               pPSVPart->PartSize,
-                                               DiagStream),
+      IFRBOOL(VerifySerializedRootSignatureWithShaderPSV(GetDxilPartData(pRSPart),
+                                                         pRSPart->PartSize,
+                                                         GetVersionShaderType(pProgramHeader->ProgramVersion),
+                                                         GetDxilPartData(pPSVPart),
+                                                         pPSVPart->PartSize,
+                                                         DiagStream),
               DXC_E_INCORRECT_ROOT_SIGNATURE);
     } else {
-      IFRBOOL(VerifyRootSignature(RSH.GetDesc(), DiagStream, false),
+      IFRBOOL(VerifySerializedRootSignature(GetDxilPartData(pRSPart),
+                                            pRSPart->PartSize, DiagStream),
               DXC_E_INCORRECT_ROOT_SIGNATURE);
     }
   } catch(...) {
@@ -13,12 +13,18 @@
 #include "dxc/Support/Global.h" // For DXASSERT
 #include "dxc/Support/dxcapi.use.h"
 #include "llvm/Support/Mutex.h"
+#include <atomic>
 
 using namespace dxc;
 
 static DxcDllSupport g_DllSupport;
 static HRESULT g_DllLibResult = S_OK;
 
+// Whether loading dxil.dll has been attempted. Once it is set,
+// g_DllLibResult and g_DllSupport no longer change until cleanup, so
+// callers read them without taking the lock.
+static std::atomic<bool> g_DllLibLoadAttempted(false);
+
 static llvm::sys::Mutex *cs = nullptr;
 
 // Check if we can successfully get IDxcValidator from dxil.dll
@@ -28,6 +34,7 @@ HRESULT DxilLibInitialize() {
 #if LLVM_ON_WIN32
   cs->lock();
   g_DllLibResult = g_DllSupport.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+  g_DllLibLoadAttempted.store(true, std::memory_order_release);
   cs->unlock();
 #endif
   return S_OK;
@@ -44,6 +51,7 @@ HRESULT DxilLibCleanup(DxilLibCleanUpType type) {
   else {
     hr = E_INVALIDARG;
   }
+  g_DllLibLoadAttempted.store(false, std::memory_order_release);
   delete cs;
   cs = nullptr;
   return hr;
@@ -54,16 +62,18 @@ HRESULT DxilLibCleanup(DxilLibCleanUpType type) {
 // have multiple attempts to load dxil.dll
 bool DxilLibIsEnabled() {
 #if LLVM_ON_WIN32
-  cs->lock();
-  if (SUCCEEDED(g_DllLibResult)) {
-    if (!g_DllSupport.IsEnabled()) {
-      g_DllLibResult = g_DllSupport.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+  if (!g_DllLibLoadAttempted.load(std::memory_order_acquire)) {
+    cs->lock();
+    if (!g_DllLibLoadAttempted.load(std::memory_order_relaxed)) {
+      if (SUCCEEDED(g_DllLibResult) && !g_DllSupport.IsEnabled()) {
+        g_DllLibResult = g_DllSupport.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+      }
+      g_DllLibLoadAttempted.store(true, std::memory_order_release);
     }
+    cs->unlock();
   }
-  cs->unlock();
   return SUCCEEDED(g_DllLibResult);
 #else
-  g_DllLibResult = (HRESULT)-1;
   return false;
 #endif
 }
@@ -72,10 +82,10 @@ bool DxilLibIsEnabled() {
 HRESULT DxilLibCreateInstance(_In_ REFCLSID rclsid, _In_ REFIID riid, _In_ IUnknown **ppInterface) {
   DXASSERT_NOMSG(ppInterface != nullptr);
   HRESULT hr = E_FAIL;
+  // DxcCreateInstance of dxil.dll is thread-safe, and the library stays
+  // loaded until cleanup, so no lock is needed here.
   if (DxilLibIsEnabled()) {
-    cs->lock();
     hr = g_DllSupport.CreateInstance(rclsid, riid, ppInterface);
-    cs->unlock();
   }
   return hr;
 }
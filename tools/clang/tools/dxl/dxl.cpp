@@ -15,14 +15,18 @@
 
 #include "dxc/dxcapi.h"
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/DxilContainer/DxilContainer.h"
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support//MSFileSystem.h"
 #include "llvm/Support/FileSystem.h"
 #include <dia2.h>
 #include <intsafe.h>
+#include <atomic>
+#include <mutex>
 
 using namespace llvm;
 using namespace llvm::opt;
@@ -47,72 +51,223 @@ static cl::opt<std::string> OutputFilename("Fo",
                                            cl::desc("Override output filename"),
                                            cl::value_desc("filename"));
 
+static cl::opt<std::string>
+    TargetsFile("targets",
+                cl::desc("Link each '<entry> <profile> [<output>]' line of "
+                         "<file> instead of -E, -T and -Fo"),
+                cl::value_desc("file"));
+
+static cl::opt<unsigned>
+    ThreadCount("j",
+                cl::desc("Number of threads linking -targets (default: one "
+                         "per hardware thread)"),
+                cl::init(0));
+
+// One entry to link and the file to write it to.
+struct DxlTarget {
+  std::string Entry;
+  std::string Profile;
+  std::string Output;
+  HRESULT Status = E_ABORT;
+  std::string Errors;
+};
 
 class DxlContext {
 
 private:
   DxcDllSupport &m_dxcSupport;
+  std::vector<std::wstring> m_libNames;
+  std::vector<LPCWSTR> m_libNamePtrs;
+  std::vector<CComPtr<IDxcBlobEncoding>> m_libs;
+
   template <typename TInterface>
   HRESULT CreateInstance(REFCLSID clsid, _Outptr_ TInterface **pResult) {
     return m_dxcSupport.CreateInstance(clsid, pResult);
   }
 
+  void ReadLibraries();
+  void ReadTargets(std::vector<DxlTarget> &Targets);
+  void CreateLinker(_Outptr_ IDxcLinker **ppLinker);
+  void LinkTarget(IDxcLinker *pLinker, DxlTarget &Target);
+
 public:
   DxlContext(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {}
 
   int Link();
+  int LinkTargets();
 };
 
-int DxlContext::Link() {
-  std::string entry = EntryName;
-  std::string profile = TargetProfile;
-
-  CComPtr<IDxcLinker> pLinker;
-  IFT(CreateInstance(CLSID_DxcLinker, &pLinker));
-
+// Libraries are read once and shared by every linker.
+void DxlContext::ReadLibraries() {
   StringRef InputFilesRef(InputFiles);
   SmallVector<StringRef, 2> InputFileList;
   InputFilesRef.split(InputFileList, ";");
 
-  std::vector<std::wstring> wInputFiles;
-  wInputFiles.reserve(InputFileList.size());
-  std::vector<LPCWSTR> wpInputFiles;
-  wpInputFiles.reserve(InputFileList.size());
+  m_libNames.reserve(InputFileList.size());
   for (auto &file : InputFileList) {
-    wInputFiles.emplace_back(StringRefUtf16(file.str()));
-    wpInputFiles.emplace_back(wInputFiles.back().c_str());
+    m_libNames.emplace_back(StringRefUtf16(file.str()));
+    m_libNamePtrs.emplace_back(m_libNames.back().c_str());
     CComPtr<IDxcBlobEncoding> pLib;
-    ReadFileIntoBlob(m_dxcSupport, wInputFiles.back().c_str(), &pLib);
-    IFT(pLinker->RegisterLibrary(wInputFiles.back().c_str(), pLib));
+    ReadFileIntoBlob(m_dxcSupport, m_libNames.back().c_str(), &pLib);
+    m_libs.emplace_back(pLib);
+  }
+}
+
+void DxlContext::ReadTargets(std::vector<DxlTarget> &Targets) {
+  CComPtr<IDxcBlobEncoding> pTargets;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(TargetsFile), &pTargets);
+  StringRef Text((const char *)pTargets->GetBufferPointer(),
+                 pTargets->GetBufferSize());
+  if (Text.startswith("\xEF\xBB\xBF"))
+    Text = Text.drop_front(3);
+
+  unsigned lineNumber = 0;
+  while (!Text.empty()) {
+    std::pair<StringRef, StringRef> Split = Text.split('\n');
+    Text = Split.second;
+    ++lineNumber;
+    StringRef Line = Split.first.trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+    SmallVector<StringRef, 3> Fields;
+    SplitString(Line, Fields);
+    if (Fields.size() < 2 || Fields.size() > 3) {
+      throw ::hlsl::Exception(E_INVALIDARG,
+                              TargetsFile + "(" + std::to_string(lineNumber) +
+                                  "): expected <entry> <profile> [<output>]");
+    }
+    DxlTarget Target;
+    Target.Entry = Fields[0];
+    Target.Profile = Fields[1];
+    Target.Output = Fields.size() == 3 ? Fields[2].str() : Target.Entry + ".dxbc";
+    Targets.emplace_back(std::move(Target));
   }
+}
 
+// Linkers keep the modules they parse in their own LLVMContext, so a linker
+// is used by one thread at a time.
+void DxlContext::CreateLinker(_Outptr_ IDxcLinker **ppLinker) {
+  CComPtr<IDxcLinker> pLinker;
+  IFT(CreateInstance(CLSID_DxcLinker, &pLinker));
+  for (size_t i = 0; i < m_libs.size(); ++i)
+    IFT(pLinker->RegisterLibrary(m_libNamePtrs[i], m_libs[i]));
+  *ppLinker = pLinker.Detach();
+}
+
+void DxlContext::LinkTarget(IDxcLinker *pLinker, DxlTarget &Target) {
   CComPtr<IDxcOperationResult> pLinkResult;
 
-  IFT(pLinker->Link(StringRefUtf16(entry), StringRefUtf16(profile),
-                wpInputFiles.data(), wpInputFiles.size(), nullptr, 0,
+  IFT(pLinker->Link(StringRefUtf16(Target.Entry), StringRefUtf16(Target.Profile),
+                m_libNamePtrs.data(), m_libNamePtrs.size(), nullptr, 0,
                 &pLinkResult));
 
-  HRESULT status;
-  IFT(pLinkResult->GetStatus(&status));
-  if (SUCCEEDED(status)) {
+  IFT(pLinkResult->GetStatus(&Target.Status));
+  if (SUCCEEDED(Target.Status)) {
     CComPtr<IDxcBlob> pContainer;
     IFT(pLinkResult->GetResult(&pContainer));
     if (pContainer.p != nullptr) {
-      // Infer the output filename if needed.
-      if (OutputFilename.empty()) {
-        OutputFilename = EntryName + ".dxbc";
-      }
-      WriteBlobToFile(pContainer, StringRefUtf16(OutputFilename), DXC_CP_UTF8); // TODO: Support DefaultTextCodePage
+      WriteBlobToFile(pContainer, StringRefUtf16(Target.Output), DXC_CP_UTF8); // TODO: Support DefaultTextCodePage
     }
   } else {
     CComPtr<IDxcBlobEncoding> pErrors;
     IFT(pLinkResult->GetErrorBuffer(&pErrors));
     if (pErrors != nullptr) {
-      printf("Link failed:\n%s",
-             static_cast<char *>(pErrors->GetBufferPointer()));
+      Target.Errors.assign(static_cast<char *>(pErrors->GetBufferPointer()),
+                           pErrors->GetBufferSize());
     }
   }
-  return status;
+}
+
+int DxlContext::Link() {
+  ReadLibraries();
+
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+
+  DxlTarget Target;
+  Target.Entry = EntryName;
+  Target.Profile = TargetProfile;
+  // Infer the output filename if needed.
+  Target.Output =
+      OutputFilename.empty() ? EntryName + ".dxbc" : OutputFilename;
+  LinkTarget(pLinker, Target);
+  if (FAILED(Target.Status) && !Target.Errors.empty()) {
+    printf("Link failed:\n%s", Target.Errors.c_str());
+  }
+  return Target.Status;
+}
+
+// Links every target of -targets in one process. Each thread registers the
+// libraries with a linker of its own once, then takes targets from a shared
+// counter, so libraries are parsed once per thread rather than per target.
+int DxlContext::LinkTargets() {
+  std::vector<DxlTarget> Targets;
+  ReadTargets(Targets);
+  ReadLibraries();
+
+  unsigned threadCount = ThreadCount;
+  if (threadCount == 0)
+    threadCount = hlsl::DxcThreadPool::GetDefaultThreadCount();
+  if (threadCount > Targets.size())
+    threadCount = (unsigned)Targets.size();
+
+  std::atomic<size_t> nextTarget(0);
+  std::mutex consoleLock;
+  if (threadCount != 0) {
+    // Pools inside the DLL do not see this pool's limits, so cap them to an
+    // even share of the threads to keep nested work from oversubscribing.
+    SetDllMaxThreadCount(m_dxcSupport,
+                         hlsl::DxcThreadPool::GetTaskThreadLimit(threadCount));
+    hlsl::DxcThreadPool Pool(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t) {
+      Pool.Async([&]() {
+        DxcThreadMalloc TM(nullptr);
+        CComPtr<IDxcLinker> pLinker;
+        HRESULT linkerStatus = S_OK;
+        std::string linkerErrors;
+        try {
+          CreateLinker(&pLinker);
+        } catch (const ::hlsl::Exception &e) {
+          linkerStatus = e.hr;
+          linkerErrors = e.msg;
+        } catch (std::bad_alloc &) {
+          linkerStatus = E_OUTOFMEMORY;
+        }
+        for (size_t i = nextTarget++; i < Targets.size(); i = nextTarget++) {
+          DxlTarget &Target = Targets[i];
+          if (FAILED(linkerStatus)) {
+            Target.Status = linkerStatus;
+            Target.Errors = linkerErrors;
+          } else {
+            try {
+              LinkTarget(pLinker, Target);
+            } catch (const ::hlsl::Exception &e) {
+              Target.Status = e.hr;
+              Target.Errors = e.msg;
+            } catch (std::bad_alloc &) {
+              Target.Status = E_OUTOFMEMORY;
+            }
+          }
+          std::lock_guard<std::mutex> L(consoleLock);
+          if (SUCCEEDED(Target.Status)) {
+            printf("%s (%s): %s\n", Target.Entry.c_str(),
+                   Target.Profile.c_str(), Target.Output.c_str());
+          } else {
+            printf("%s (%s): link failed - error code 0x%08x.\n%s",
+                   Target.Entry.c_str(), Target.Profile.c_str(),
+                   (unsigned)Target.Status, Target.Errors.c_str());
+          }
+        }
+      });
+    }
+    Pool.Wait();
+  }
+
+  for (const DxlTarget &Target : Targets) {
+    if (FAILED(Target.Status))
+      return 1;
+  }
+  return 0;
 }
 
 using namespace hlsl::options;
@@ -150,7 +305,7 @@ int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
     DxlContext context(dxcSupport);
 
     pStage = "Linking";
-    retVal = context.Link();
+    retVal = TargetsFile.empty() ? context.Link() : context.LinkTargets();
   } catch (const ::hlsl::Exception &hlslException) {
     try {
       const char *msg = hlslException.what();
@@ -23,9 +23,12 @@
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/microcom.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include <comdef.h>
+#include <atomic>
 #include <iostream>
 #include <limits>
+#include <mutex>
 
 #include "llvm/Support/FileSystem.h"
 
@@ -47,6 +50,7 @@ enum class ProgramAction {
   PrintPasses,
   PrintPassesWithDetails,
   RunOptimizer,
+  RunScript,
 };
 
 const wchar_t *STDIN_FILE_NAME = L"-";
@@ -193,10 +197,172 @@ static void ReadFileOpts(LPCWSTR pPassFileName, IDxcBlobEncoding **ppPassOpts, s
   pPassOpts->QueryInterface(ppPassOpts);
 }
 
+// One line of a -script file: the passes to run over an input, and where to
+// write the result.
+struct OptStep {
+  std::wstring OutFileName;
+  std::vector<std::wstring> Passes;
+};
+
+// The steps of a script that read the same input, which is parsed once.
+struct OptInput {
+  std::wstring InFileName;
+  std::vector<OptStep> Steps;
+  unsigned FailedSteps = 0;
+};
+
+static void ReadScript(LPCWSTR pScriptFileName, std::vector<OptInput> &inputs) {
+  CComPtr<IDxcBlob> pScriptBlob;
+  CComPtr<IDxcBlobUtf16> pScript;
+  BlobFromFile(pScriptFileName, &pScriptBlob);
+  IFT(hlsl::DxcGetBlobAsUtf16(pScriptBlob, hlsl::GetGlobalHeapMalloc(), &pScript));
+  std::wstring text(pScript->GetStringPointer(), pScript->GetStringLength());
+
+  size_t lineStart = 0;
+  while (lineStart < text.size()) {
+    size_t lineEnd = text.find_first_of(L"\r\n", lineStart);
+    if (lineEnd == std::wstring::npos)
+      lineEnd = text.size();
+    std::vector<std::wstring> fields;
+    size_t pos = lineStart;
+    for (;;) {
+      size_t fieldStart = text.find_first_not_of(L" \t", pos);
+      if (fieldStart == std::wstring::npos || fieldStart >= lineEnd)
+        break;
+      size_t fieldEnd = text.find_first_of(L" \t\r\n", fieldStart);
+      if (fieldEnd == std::wstring::npos || fieldEnd > lineEnd)
+        fieldEnd = lineEnd;
+      fields.emplace_back(text, fieldStart, fieldEnd - fieldStart);
+      pos = fieldEnd;
+    }
+    lineStart = lineEnd + 1;
+
+    // Skip empty lines and comments.
+    if (fields.empty() || fields[0][0] == L'#')
+      continue;
+    if (fields.size() < 2) {
+      std::string line = Unicode::UTF16ToUTF8StringOrThrow(fields[0].c_str());
+      throw hlsl::Exception(E_INVALIDARG,
+                            "Script step '" + line + "' has no output file.");
+    }
+    OptInput *pInput = nullptr;
+    for (OptInput &input : inputs) {
+      if (input.InFileName == fields[0]) {
+        pInput = &input;
+        break;
+      }
+    }
+    if (!pInput) {
+      inputs.emplace_back();
+      pInput = &inputs.back();
+      pInput->InFileName = fields[0];
+    }
+    pInput->Steps.emplace_back();
+    OptStep &step = pInput->Steps.back();
+    step.OutFileName = fields[1];
+    step.Passes.assign(fields.begin() + 2, fields.end());
+  }
+}
+
+// Runs each step of Input over its own copy of the module, which is parsed
+// once for all of them.
+static void RunInputSteps(IDxcOptimizer2 *pOptimizer, OptInput &input,
+                          std::mutex &consoleLock) {
+  CComPtr<IDxcBlob> pBlob;
+  CComPtr<IDxcOptimizerSession> pSession;
+  HRESULT loadStatus = S_OK;
+  try {
+    BlobFromFile(input.InFileName.c_str(), &pBlob);
+    loadStatus = pOptimizer->CreateSession(pBlob, &pSession);
+  } catch (const hlsl::Exception &e) {
+    loadStatus = e.hr;
+  } catch (std::bad_alloc &) {
+    loadStatus = E_OUTOFMEMORY;
+  }
+
+  for (OptStep &step : input.Steps) {
+    HRESULT status = loadStatus;
+    CComPtr<IDxcBlobEncoding> pOutputText;
+    try {
+      if (SUCCEEDED(status)) {
+        std::vector<LPCWSTR> passes;
+        for (const std::wstring &pass : step.Passes)
+          passes.push_back(pass.c_str());
+        CComPtr<IDxcOptimizerSession> pStepSession;
+        IFT(pSession->Clone(&pStepSession));
+        IFT(pStepSession->Run(passes.data(), (UINT32)passes.size(),
+                              &pOutputText));
+        if (!isStdIn(step.OutFileName.c_str())) {
+          CComPtr<IDxcBlob> pOutputModule;
+          IFT(pStepSession->GetModule(&pOutputModule));
+          dxc::WriteBlobToFile(pOutputModule, step.OutFileName.c_str(),
+                               DXC_CP_UTF8);
+        }
+      }
+    } catch (const hlsl::Exception &e) {
+      status = e.hr;
+    } catch (std::bad_alloc &) {
+      status = E_OUTOFMEMORY;
+    }
+
+    std::lock_guard<std::mutex> L(consoleLock);
+    if (SUCCEEDED(status)) {
+      wprintf(L"%s -> %s\n", input.InFileName.c_str(),
+              step.OutFileName.c_str());
+      if (pOutputText)
+        PrintOptOutput(nullptr, nullptr, pOutputText);
+    } else {
+      ++input.FailedSteps;
+      wprintf(L"%s -> %s: failed - error code 0x%08x.\n",
+              input.InFileName.c_str(), step.OutFileName.c_str(),
+              (unsigned)status);
+    }
+  }
+}
+
+// Runs every step of a script. Inputs are independent and run in parallel;
+// the steps on one input run in order, each from the module as read.
+static int RunScript(IDxcOptimizer *pOptimizer, LPCWSTR pScriptFileName,
+                     unsigned threadCount) {
+  std::vector<OptInput> inputs;
+  ReadScript(pScriptFileName, inputs);
+  CComPtr<IDxcOptimizer2> pOptimizer2;
+  IFT(pOptimizer->QueryInterface(&pOptimizer2));
+
+  if (threadCount == 0)
+    threadCount = hlsl::DxcThreadPool::GetDefaultThreadCount();
+  if (threadCount > inputs.size())
+    threadCount = (unsigned)inputs.size();
+
+  std::atomic<size_t> nextInput(0);
+  std::mutex consoleLock;
+  if (threadCount != 0) {
+    // Pools inside the DLL do not see this pool's limits, so cap them to an
+    // even share of the threads to keep nested work from oversubscribing.
+    dxc::SetDllMaxThreadCount(
+        g_DxcSupport, hlsl::DxcThreadPool::GetTaskThreadLimit(threadCount));
+    hlsl::DxcThreadPool Pool(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t) {
+      Pool.Async([&]() {
+        for (size_t i = nextInput++; i < inputs.size(); i = nextInput++)
+          RunInputSteps(pOptimizer2, inputs[i], consoleLock);
+      });
+    }
+    Pool.Wait();
+  }
+
+  for (const OptInput &input : inputs) {
+    if (input.FailedSteps)
+      return 1;
+  }
+  return 0;
+}
+
 static void PrintHelp() {
   wprintf(L"%s",
     L"Performs optimizations on a bitcode file by running a sequence of passes.\n\n"
-    L"dxopt [-? | -passes | -pass-details | -pf [PASS-FILE] | [-o=OUT-FILE] | IN-FILE OPT-ARGUMENTS ...]\n\n"
+    L"dxopt [-? | -passes | -pass-details | -pf [PASS-FILE] | [-o=OUT-FILE] | IN-FILE OPT-ARGUMENTS ...]\n"
+    L"dxopt -script SCRIPT-FILE [-threads=N]\n\n"
     L"Arguments:\n"
     L"  -?  Displays this help message\n"
     L"  -passes        Displays a list of pass names\n"
@@ -205,6 +371,12 @@ static void PrintHelp() {
     L"  -o=OUT-FILE    Output file for processed module\n"
     L"  IN-FILE        File with with bitcode to optimize\n"
     L"  OPT-ARGUMENTS  One or more passes to run in sequence\n"
+    L"  -script SCRIPT-FILE\n"
+    L"                 Runs each line of the file, IN-FILE OUT-FILE OPT-ARGUMENTS,\n"
+    L"                 or OUT-FILE - to only trace. Each input is parsed once and\n"
+    L"                 every step on it starts from the module as read; inputs\n"
+    L"                 run in parallel, so no input may be another step's output\n"
+    L"  -threads=N     Threads for -script; one per hardware thread by default\n"
     L"\n"
     L"Text that is traced during optimization is written to the standard output.\n"
   );
@@ -226,6 +398,8 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     LPCWSTR externalLib = nullptr;
     LPCWSTR externalFn = nullptr;
     LPCWSTR passFileName = nullptr;
+    LPCWSTR scriptFileName = nullptr;
+    unsigned threadCount = 0;
     const wchar_t **optArgs = nullptr;
     UINT32 optArgCount = 0;
 
@@ -268,6 +442,18 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
       else if (wcsistarts(arg, L"-o=")) {
         outFileName = argv_[argIdx] + 3;
       }
+      else if (wcsieqopt(arg, L"script")) {
+        ++argIdx;
+        if (argIdx == argc) {
+          PrintHelp();
+          return 1;
+        }
+        action = ProgramAction::RunScript;
+        scriptFileName = argv_[argIdx];
+      }
+      else if (wcsistarts(arg, L"-threads=")) {
+        threadCount = wcstoul(argv_[argIdx] + 9, nullptr, 10);
+      }
       else {
         action = ProgramAction::RunOptimizer;
         // See if arg is file input specifier.
@@ -329,6 +515,10 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
       IFT(pOptimizer->RunOptimizer(pBlob, optArgs, optArgCount, &pOutputModule, &pOutputText));
       PrintOptOutput(outFileName, pOutputModule, pOutputText);
       break;
+    case ProgramAction::RunScript:
+      pStage = "Script processing";
+      retVal = RunScript(pOptimizer, scriptFileName, threadCount);
+      break;
     }
   } catch (const ::hlsl::Exception &hlslException) {
     try {
@@ -135,6 +135,14 @@ private:
 
   // Only used for test purposes when exports aren't explicitly listed
   std::unique_ptr<DxrFallbackCompiler::IntToFuncNameMap> m_pCachedMap;
+
+  // Transformed shaders from earlier Compile calls, reused by later pipelines
+  // that share them.
+  DxrFallbackStateFunctionCache m_stateFunctionCache;
+
+  // Patched shaders from earlier PatchShaderBindingTables calls, reused by
+  // later state objects that bind them the same way.
+  DxilShaderRecordPatchCache m_shaderRecordPatchCache;
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
     DXC_MICROCOM_TM_CTOR(DxcDxrFallbackCompiler)
@@ -328,6 +336,10 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::RenameAndLink(
                 std::move(M), pResultBlob, TM.GetInstalledAllocator(), SerializeDxilFlags::None,
                 pOutputStream);
             dxcutil::AssembleToContainer(inputs);
+            m_shaderRecordPatchCache.insert(
+                patchRequest, pShaderInfo, bindings,
+                StringRef((const char *)pResultBlob->GetBufferPointer(),
+                          pResultBlob->GetBufferSize()));
         }
 
         DiagStream.flush();
@@ -356,6 +368,22 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::PatchShaderBindingTables(
     LLVMContext context;
     try
     {
+        DxilShaderRecordPatchCache::Request patchRequest;
+        std::string patched;
+        if (m_shaderRecordPatchCache.lookup(
+                StringRef((const char *)pShaderBytecode->pData, pShaderBytecode->Size),
+                pShaderInfo, patchRequest, patched))
+        {
+            CComPtr<IDxcBlob> pResultBlob;
+            IFT(DxcCreateBlobOnHeapCopy(patched.data(), patched.size(), &pResultBlob));
+            CComPtr<AbstractMemoryStream> pDiagStream;
+            IFT(CreateMemoryStream(TM.GetInstalledAllocator(), &pDiagStream));
+            CComPtr<IStream> pStream = pDiagStream;
+            std::string warnings;
+            dxcutil::CreateOperationResultFromOutputs(pResultBlob, pStream, warnings, false, ppResult);
+            return S_OK;
+        }
+
         CComPtr<IDxcBlobEncoding> pShaderBlob;
         hlsl::DxcCreateBlobWithEncodingFromPinned(pShaderBytecode->pData, pShaderBytecode->Size, CP_ACP, &pShaderBlob);
 
@@ -389,8 +417,15 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::PatchShaderBindingTables(
         char dxilPatchShaderRecordString[32];
         StringCchPrintf(dxilPatchShaderRecordString, _countof(dxilPatchShaderRecordString),
             "%p", pShaderInfo);
-        auto passOption = PassOption("root-signature", dxilPatchShaderRecordString);
-        PassOptions options(passOption);
+        std::vector<DxilShaderRecordBinding> bindings;
+        char dxilPatchBindingsString[32];
+        StringCchPrintf(dxilPatchBindingsString, _countof(dxilPatchBindingsString),
+            "%p", &bindings);
+        PassOption passOptions[] = {
+            PassOption("root-signature", dxilPatchShaderRecordString),
+            PassOption("bindings", dxilPatchBindingsString)
+        };
+        PassOptions options(passOptions);
         patchShaderRecordBindingsPass->applyOptions(options);
 
         legacy::PassManager FPM;
@@ -695,6 +730,8 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Compile(
     std::vector<unsigned int> shaderStackSizes;
     DxrFallbackCompiler compiler(M.get(), shaderNames, maxAttributeSize, 0, m_findCalledShaders);
     compiler.setDebugOutputLevel(m_debugOutput);
+    compiler.setStateFunctionCache(&m_stateFunctionCache);
+    compiler.setThreadCount(0);
     compiler.compile(shaderEntryStateIds, shaderStackSizes, m_pCachedMap.get());
     if (m_debugOutput)
     {
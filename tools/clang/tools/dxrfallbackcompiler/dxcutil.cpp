@@ -24,7 +24,6 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Transforms/Utils/Cloning.h"
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/DXIL/DxilModule.h"
@@ -61,6 +60,20 @@ bool CreateValidator(CComPtr<IDxcValidator> &pValidator) {
   return bInternalValidator;
 }
 
+// Loads the module with debug info that the compiler wrote out before the
+// container was assembled, so validation errors can point at the source.
+std::unique_ptr<llvm::Module>
+LoadModuleWithDebugInfo(AbstractMemoryStream *pModuleBitcode,
+                        LLVMContext &Ctx) {
+  StringRef Bitcode((const char *)pModuleBitcode->GetPtr(),
+                    pModuleBitcode->GetPtrSize());
+  ErrorOr<std::unique_ptr<Module>> M =
+      parseBitcodeFile(MemoryBufferRef(Bitcode, ""), Ctx);
+  if (!M)
+    return nullptr;
+  return std::move(M.get());
+}
+
 } // namespace
 
 namespace dxcutil {
@@ -143,10 +156,6 @@ void ReadOptsAndValidate(hlsl::options::MainArgs &mainArgs,
 HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
   HRESULT valHR = S_OK;
 
-  // If we have debug info, this will be a clone of the module before debug info is stripped.
-  // This is used with internal validator to provide more useful error messages.
-  std::unique_ptr<llvm::Module> llvmModuleWithDebugInfo;
-
   CComPtr<IDxcValidator> pValidator;
   bool bInternalValidator = CreateValidator(pValidator);
   // Warning on internal Validator
@@ -161,14 +170,6 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
       inputs.pDiag->Report(diagID);
     }
 #endif
-    // If using the internal validator, we'll use the modules directly.
-    // In this case, we'll want to make a clone to avoid
-    // SerializeDxilContainerForModule stripping all the debug info. The debug
-    // info will be stripped from the orginal module, but preserved in the cloned
-    // module.
-    if (inputs.bDebugInfo) {
-      llvmModuleWithDebugInfo.reset(llvm::CloneModule(inputs.pM.get()));
-    }
   }
 
   // Verify validator version can validate this module
@@ -199,9 +200,24 @@ HRESULT ValidateAndAssembleToContainer(AssembleInputs &inputs) {
   // Important: in-place edit is required so the blob is reused and thus
   // dxil.dll can be released.
   if (bInternalValidator) {
-    IFT(RunInternalValidator(pValidator, inputs.pM.get(),
-                             llvmModuleWithDebugInfo.get(), inputs.pOutputContainerBlob,
+    // The stripped module is validated first; the debug module is only
+    // loaded from the written bitcode to locate errors if that fails.
+    IFT(RunInternalValidator(pValidator, inputs.pM.get(), nullptr,
+                             inputs.pOutputContainerBlob,
                              DxcValidatorFlags_InPlaceEdit, &pValResult));
+    IFT(pValResult->GetStatus(&valHR));
+    if (FAILED(valHR) && inputs.bDebugInfo && inputs.pModuleBitcode) {
+      LLVMContext DebugContext;
+      std::unique_ptr<llvm::Module> llvmModuleWithDebugInfo =
+          LoadModuleWithDebugInfo(inputs.pModuleBitcode, DebugContext);
+      if (llvmModuleWithDebugInfo) {
+        pValResult.Release();
+        IFT(RunInternalValidator(pValidator, inputs.pM.get(),
+                                 llvmModuleWithDebugInfo.get(),
+                                 inputs.pOutputContainerBlob,
+                                 DxcValidatorFlags_InPlaceEdit, &pValResult));
+      }
+    }
   } else {
     IFT(pValidator->Validate(inputs.pOutputContainerBlob, DxcValidatorFlags_InPlaceEdit,
                              &pValResult));
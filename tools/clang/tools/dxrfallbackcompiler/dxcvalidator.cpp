@@ -226,15 +226,13 @@ HRESULT DxcValidator::RunRootSignatureValidation(
   const DxilPartHeader *pRSPart = GetDxilPartByType(pDxilContainer, DFCC_RootSignature);
   IFRBOOL(pPSVPart && pRSPart, DXC_E_MISSING_PART);
   try {
-    RootSignatureHandle RSH;
-    RSH.LoadSerialized((const uint8_t*)GetDxilPartData(pRSPart), pRSPart->PartSize);
-    RSH.Deserialize();
     raw_stream_ostream DiagStream(pDiagStream);
-    IFRBOOL(VerifyRootSignatureWithShaderPSV(RSH.GetDesc(),
-                                             GetVersionShaderType(pProgramHeader->ProgramVersion),
-                                             GetDxilPartData(pPSVPart),
-                                             pPSVPart->PartSize,
-                                             DiagStream),
+    IFRBOOL(VerifySerializedRootSignatureWithShaderPSV(GetDxilPartData(pRSPart),
+                                                       pRSPart->PartSize,
+                                                       GetVersionShaderType(pProgramHeader->ProgramVersion),
+                                                       GetDxilPartData(pPSVPart),
+                                                       pPSVPart->PartSize,
+                                                       DiagStream),
       DXC_E_INCORRECT_ROOT_SIGNATURE);
   } catch(...) {
     return DXC_E_IR_VERIFICATION_FAILED;
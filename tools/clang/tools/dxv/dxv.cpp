@@ -16,78 +16,351 @@
 #include "dxc/dxcapi.h"
 #include "dxc/dxcapi.internal.h"
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/DxilContainer/DxilContainer.h"
 
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
 
 using namespace dxc;
 using namespace llvm;
 using namespace llvm::opt;
 using namespace hlsl::options;
 
+static cl::list<std::string>
+InputFilenames(cl::Positional,
+               cl::desc("<input dxil files, directories or wildcards>"),
+               cl::ZeroOrMore);
+
 static cl::opt<std::string>
-InputFilename(cl::Positional, cl::desc("<input dxil file>"), cl::init("-"));
+ManifestFilename("manifest", cl::desc("Validate the inputs listed one per line in <file>"),
+                 cl::value_desc("file"));
+
+static cl::opt<unsigned>
+ThreadCount("j", cl::desc("Number of validation threads (default: one per hardware thread)"),
+            cl::init(0));
+
+static cl::opt<std::string>
+SummaryFilename("summary", cl::desc("Write a JSON summary of the results to <file>"),
+                cl::value_desc("file"));
+
+static cl::opt<bool>
+InPlace("in-place", cl::desc("Write containers signed by the validator back to their files"),
+        cl::init(false));
+
+// Result of validating one input.
+struct DxvResult {
+  std::string File;
+  HRESULT Status = E_ABORT;
+  std::string Diagnostics;
+};
 
 class DxvContext {
 private:
   DxcDllSupport &m_dxcSupport;
+  std::vector<std::string> m_inputs;
+
+  void AddInput(StringRef Input);
+  void ReadManifest(StringRef Manifest);
+  void ValidateFile(IDxcAssembler *pAssembler, IDxcValidator *pValidator,
+                    DxvResult &Result);
+  void WriteSummary(llvm::raw_ostream &OS, const std::vector<DxvResult> &Results);
 public:
   DxvContext(DxcDllSupport &dxcSupport)
       : m_dxcSupport(dxcSupport) {}
 
+  bool IsBatch() const;
   void Validate();
+  int ValidateBatch();
 };
 
-void DxvContext::Validate() {
-  CComPtr<IDxcOperationResult> pCompileResult;
+static std::string GetErrorText(IDxcOperationResult *pResult) {
+  CComPtr<IDxcBlobEncoding> text;
+  IFT(pResult->GetErrorBuffer(&text));
+  if (!text)
+    return std::string();
+  return std::string((const char *)text->GetBufferPointer(),
+                     text->GetBufferSize());
+}
 
-  {
-    CComPtr<IDxcBlobEncoding> pSource;
-    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+// Matches a file name against a pattern with '*' and '?' wildcards.
+static bool MatchWildcard(StringRef Pattern, StringRef Name) {
+  if (Pattern.empty())
+    return Name.empty();
+  if (Pattern[0] == '*') {
+    for (size_t i = 0; i <= Name.size(); ++i)
+      if (MatchWildcard(Pattern.drop_front(), Name.drop_front(i)))
+        return true;
+    return false;
+  }
+  if (Name.empty() || (Pattern[0] != '?' && Pattern[0] != Name[0]))
+    return false;
+  return MatchWildcard(Pattern.drop_front(), Name.drop_front());
+}
 
-    CComPtr<IDxcAssembler> pAssembler;
-    CComPtr<IDxcOperationResult> pAsmResult;
+// Files taken from a directory: compiled containers and DXIL assembly.
+static bool IsValidatorInput(StringRef Path) {
+  StringRef Ext = sys::path::extension(Path);
+  return Ext.equals_lower(".cso") || Ext.equals_lower(".dxil") ||
+         Ext.equals_lower(".dxo") || Ext.equals_lower(".ll");
+}
+
+// Adds a file, every validator input under a directory, or the files in a
+// directory whose names match a wildcard.
+void DxvContext::AddInput(StringRef Input) {
+  StringRef Name = sys::path::filename(Input);
+  if (Name.find_first_of("*?") != StringRef::npos) {
+    StringRef Dir = sys::path::parent_path(Input);
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Dir.empty() ? "." : Dir, EC), End;
+         It != End && !EC; It.increment(EC)) {
+      bool bIsFile = false;
+      if (!sys::fs::is_regular_file(It->path(), bIsFile) && bIsFile &&
+          MatchWildcard(Name, sys::path::filename(It->path())))
+        m_inputs.push_back(It->path());
+    }
+    if (EC)
+      throw ::hlsl::Exception(E_FAIL, "cannot read directory " + Dir.str());
+    return;
+  }
+  if (sys::fs::is_directory(Input)) {
+    std::error_code EC;
+    for (sys::fs::recursive_directory_iterator It(Input, EC), End;
+         It != End && !EC; It.increment(EC)) {
+      bool bIsFile = false;
+      if (!sys::fs::is_regular_file(It->path(), bIsFile) && bIsFile &&
+          IsValidatorInput(It->path()))
+        m_inputs.push_back(It->path());
+    }
+    if (EC)
+      throw ::hlsl::Exception(E_FAIL, "cannot read directory " + Input.str());
+    return;
+  }
+  m_inputs.push_back(Input);
+}
+
+void DxvContext::ReadManifest(StringRef Manifest) {
+  CComPtr<IDxcBlobEncoding> pManifest;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(Manifest), &pManifest);
+  StringRef Text((const char *)pManifest->GetBufferPointer(),
+                 pManifest->GetBufferSize());
+  if (Text.startswith("\xEF\xBB\xBF"))
+    Text = Text.drop_front(3);
+  while (!Text.empty()) {
+    std::pair<StringRef, StringRef> Split = Text.split('\n');
+    Text = Split.second;
+    StringRef Line = Split.first.trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+    AddInput(Line);
+  }
+}
 
-    CComPtr<IDxcBlob> pContainerBlob;
-    HRESULT resultStatus;
+bool DxvContext::IsBatch() const {
+  if (!ManifestFilename.empty() || !SummaryFilename.empty() ||
+      InputFilenames.size() > 1)
+    return true;
+  if (InputFilenames.empty())
+    return false;
+  StringRef Input = InputFilenames[0];
+  return sys::path::filename(Input).find_first_of("*?") != StringRef::npos ||
+         sys::fs::is_directory(Input);
+}
+
+// Validates one input. Containers are mapped and validated where they are,
+// so a container signed by the validator is written back to its file with
+// -in-place; other inputs are assembled first.
+void DxvContext::ValidateFile(IDxcAssembler *pAssembler,
+                              IDxcValidator *pValidator, DxvResult &Result) {
+  CComPtr<IDxcBlob> pContainerBlob;
+  if (Result.File != "-") {
+    CComPtr<IDxcBlob> pMapped;
+    IFT_Data(hlsl::DxcCreateWritableBlobFromFileMapped(
+                 hlsl::GetGlobalHeapMalloc(), StringRefUtf16(Result.File),
+                 InPlace ? hlsl::MappedFileAccess::WriteBack
+                         : hlsl::MappedFileAccess::CopyOnWrite,
+                 &pMapped),
+             StringRefUtf16(Result.File));
+    const uint32_t *pFourCC = (const uint32_t *)pMapped->GetBufferPointer();
+    if (pMapped->GetBufferSize() >= sizeof(hlsl::DxilContainerHeader) &&
+        *pFourCC == hlsl::DFCC_Container)
+      pContainerBlob = pMapped;
+  }
 
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  if (!pContainerBlob) {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pAsmResult;
+    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(Result.File), &pSource);
     IFT(pAssembler->AssembleToContainer(pSource, &pAsmResult));
-    IFT(pAsmResult->GetStatus(&resultStatus));
-    if (FAILED(resultStatus)) {
-      CComPtr<IDxcBlobEncoding> text;
-      IFT(pAsmResult->GetErrorBuffer(&text));
-      const char *pStart = (const char *)text->GetBufferPointer();
-      std::string msg(pStart);
-      IFTMSG(resultStatus, msg);
+    IFT(pAsmResult->GetStatus(&Result.Status));
+    if (FAILED(Result.Status)) {
+      Result.Diagnostics = GetErrorText(pAsmResult);
       return;
     }
     IFT(pAsmResult->GetResult(&pContainerBlob));
+  }
 
-    CComPtr<IDxcValidator> pValidator;
-    CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcOperationResult> pResult;
+  IFT(pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+  IFT(pResult->GetStatus(&Result.Status));
+  if (FAILED(Result.Status))
+    Result.Diagnostics = GetErrorText(pResult);
+}
 
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
-    IFT(pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+void DxvContext::Validate() {
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcValidator> pValidator;
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+
+  DxvResult Result;
+  Result.File = InputFilenames.empty() ? "-" : InputFilenames[0];
+  ValidateFile(pAssembler, pValidator, Result);
+  if (FAILED(Result.Status)) {
+    IFTMSG(Result.Status, Result.Diagnostics);
+  } else {
+    printf("Validation succeed.");
+  }
+}
 
-    HRESULT status;
-    IFT(pResult->GetStatus(&status));
+static void WriteJsonString(llvm::raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char c : Str) {
+    if (c == '"' || c == '\\')
+      OS << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      OS << format("\\u%04x", (unsigned)c);
+    else
+      OS << c;
+  }
+  OS << '"';
+}
 
-    if (FAILED(status)) {
-      CComPtr<IDxcBlobEncoding> text;
-      IFT(pResult->GetErrorBuffer(&text));
-      const char *pStart = (const char *)text->GetBufferPointer();
-      std::string msg(pStart);
-      IFTMSG(status, msg);
-    } else {
-      printf("Validation succeed.");
+void DxvContext::WriteSummary(llvm::raw_ostream &OS,
+                              const std::vector<DxvResult> &Results) {
+  unsigned failed = 0;
+  OS << "{\n  \"files\": [";
+  for (size_t i = 0; i < Results.size(); ++i) {
+    const DxvResult &R = Results[i];
+    if (FAILED(R.Status))
+      ++failed;
+    OS << (i ? ",\n" : "\n") << "    {\"file\": ";
+    WriteJsonString(OS, R.File);
+    OS << ", \"status\": \"" << (SUCCEEDED(R.Status) ? "succeeded" : "failed")
+       << "\", \"hr\": \"" << format("0x%08x", (unsigned)R.Status)
+       << "\", \"diagnostics\": ";
+    WriteJsonString(OS, R.Diagnostics);
+    OS << '}';
+  }
+  OS << "\n  ],\n  \"succeeded\": " << (unsigned)Results.size() - failed
+     << ",\n  \"failed\": " << failed << "\n}\n";
+}
+
+// Validates every input on a pool of threads. Each thread creates its own
+// assembler and validator once, then takes inputs from a shared counter.
+int DxvContext::ValidateBatch() {
+  if (!ManifestFilename.empty())
+    ReadManifest(ManifestFilename);
+  for (const std::string &Input : InputFilenames)
+    AddInput(Input);
+
+  std::vector<DxvResult> Results(m_inputs.size());
+  for (size_t i = 0; i < m_inputs.size(); ++i)
+    Results[i].File = m_inputs[i];
+
+  unsigned threadCount = ThreadCount;
+  if (threadCount == 0)
+    threadCount = hlsl::DxcThreadPool::GetDefaultThreadCount();
+  if (threadCount > Results.size())
+    threadCount = (unsigned)Results.size();
+
+  std::atomic<size_t> nextInput(0);
+  std::mutex consoleLock;
+  if (threadCount != 0) {
+    // Pools inside the DLL do not see this pool's limits, so cap them to an
+    // even share of the threads to keep nested work from oversubscribing.
+    SetDllMaxThreadCount(m_dxcSupport,
+                         hlsl::DxcThreadPool::GetTaskThreadLimit(threadCount));
+    hlsl::DxcThreadPool Pool(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t) {
+      Pool.Async([&]() {
+        DxcThreadMalloc TM(nullptr);
+        CComPtr<IDxcAssembler> pAssembler;
+        CComPtr<IDxcValidator> pValidator;
+        HRESULT hr = m_dxcSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler);
+        if (SUCCEEDED(hr))
+          hr = m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator);
+        for (size_t i = nextInput++; i < Results.size(); i = nextInput++) {
+          DxvResult &R = Results[i];
+          if (FAILED(hr)) {
+            R.Status = hr;
+            continue;
+          }
+          try {
+            ValidateFile(pAssembler, pValidator, R);
+          } catch (const ::hlsl::Exception &e) {
+            R.Status = e.hr;
+            R.Diagnostics = e.msg;
+          } catch (std::bad_alloc &) {
+            R.Status = E_OUTOFMEMORY;
+          }
+          if (FAILED(R.Status)) {
+            std::lock_guard<std::mutex> L(consoleLock);
+            printf("%s: validation failed - error code 0x%08x.\n",
+                   R.File.c_str(), (unsigned)R.Status);
+          }
+        }
+      });
     }
+    Pool.Wait();
   }
+
+  std::string summary;
+  llvm::raw_string_ostream summaryStream(summary);
+  WriteSummary(summaryStream, Results);
+  summaryStream.flush();
+  if (!SummaryFilename.empty()) {
+    CComPtr<IDxcBlobEncoding> pSummary;
+    IFT(hlsl::DxcCreateBlobWithEncodingOnHeapCopy(summary.data(), summary.size(),
+                                                  CP_UTF8, &pSummary));
+    WriteBlobToFile(pSummary, StringRefUtf16(SummaryFilename), DXC_CP_UTF8);
+  }
+
+  unsigned failed = 0;
+  for (const DxvResult &R : Results)
+    if (FAILED(R.Status))
+      ++failed;
+  printf("%u file(s) validated, %u failed.\n", (unsigned)Results.size(), failed);
+  return failed ? 1 : 0;
 }
 
 int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
   const char *pStage = "Operation";
+  int retVal = 0;
+  if (llvm::sys::fs::SetupPerThreadFileSystem())
+    return 1;
+  llvm::sys::fs::AutoCleanupPerThreadFileSystem auto_cleanup_fs;
+  if (FAILED(DxcInitThreadMalloc())) return 1;
+  DxcSetThreadMallocToDefault();
   try {
+    llvm::sys::fs::MSFileSystem *msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
     pStage = "Argument processing";
 
     // Parse command line options.
@@ -98,7 +371,10 @@ int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
 
     DxvContext context(dxcSupport);
     pStage = "Validation";
-    context.Validate();
+    if (context.IsBatch())
+      retVal = context.ValidateBatch();
+    else
+      context.Validate();
   } catch (const ::hlsl::Exception &hlslException) {
     try {
       const char *msg = hlslException.what();
@@ -124,5 +400,5 @@ int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
     return 1;
   }
 
-  return 0;
+  return retVal;
 }
@@ -3056,6 +3056,10 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
   bool IncludeBriefCommentsInCodeCompletion
     = options & CXTranslationUnit_IncludeBriefCommentsInCodeCompletion;
   bool SkipFunctionBodies = options & CXTranslationUnit_SkipFunctionBodies;
+  // HLSL Change Starts - allow skipping only bodies outside the main file
+  bool SkipIncludedFunctionBodies =
+      options & CXTranslationUnit_SkipIncludedFunctionBodies;
+  // HLSL Change Ends
   bool ForSerialization = options & CXTranslationUnit_ForSerialization;
 
   // Configure the diagnostics.
@@ -3131,7 +3135,8 @@ static void clang_parseTranslationUnit_Impl(void *UserData) {
       CacheCodeCompletionResults, IncludeBriefCommentsInCodeCompletion,
       /*AllowPCHWithCompilerErrors=*/true, SkipFunctionBodies,
       /*UserFilesAreVolatile=*/true, ForSerialization, &ErrUnit,
-      CXXIdx->HlslLangExtensions)); // HLSL Change - add language extensions
+      CXXIdx->HlslLangExtensions, // HLSL Change - add language extensions
+      SkipIncludedFunctionBodies)); // HLSL Change
 
   // Early failures in LoadFromCommandLine may return with ErrUnit unset.
   if (!Unit && !ErrUnit) {
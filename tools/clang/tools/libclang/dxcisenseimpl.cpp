@@ -1098,6 +1098,8 @@ DxcIndex::DxcIndex() : m_index(0), m_options(DxcGlobalOpt_None)
 
 DxcIndex::~DxcIndex()
 {
+    // Finish queued parses while the index they use is still alive.
+    m_worker.reset();
     if (m_index)
     {
         clang_disposeIndex(m_index);
@@ -1166,7 +1168,99 @@ HRESULT DxcIndex::ParseTranslationUnit(
   if (m_index == 0) return E_FAIL;
 
   DxcThreadMalloc TM(m_pMalloc);
+  return ParseTranslationUnitImpl(source_filename, command_line_args,
+                                  num_command_line_args, unsaved_files,
+                                  num_unsaved_files, options, pTranslationUnit);
+}
+
+_Use_decl_annotations_
+HRESULT DxcIndex::ParseTranslationUnitAsync(
+  const char *source_filename,
+  const char * const *command_line_args,
+  int num_command_line_args,
+  IDxcUnsavedFile** unsaved_files,
+  unsigned num_unsaved_files,
+  DxcTranslationUnitFlags options,
+  IDxcParseCallback* pCallback)
+{
+  if (source_filename == nullptr || pCallback == nullptr) return E_INVALIDARG;
+  if (num_command_line_args > 0 && command_line_args == nullptr) return E_INVALIDARG;
+  if (num_unsaved_files > 0 && unsaved_files == nullptr) return E_INVALIDARG;
+  if (m_index == 0) return E_FAIL;
+
+  DxcThreadMalloc TM(m_pMalloc);
+  try
+  {
+    // Capture everything the caller owns; unsaved files are immutable, so
+    // holding a reference is enough.
+    std::string fileName(source_filename);
+    std::vector<std::string> args;
+    for (int i = 0; i < num_command_line_args; ++i)
+      args.push_back(command_line_args[i]);
+    std::vector<CComPtr<IDxcUnsavedFile>> unsaved(unsaved_files,
+                                                  unsaved_files + num_unsaved_files);
+    CComPtr<IDxcParseCallback> callback(pCallback);
+
+    std::lock_guard<std::mutex> lock(m_workerLock);
+    if (!m_worker)
+      m_worker.reset(new hlsl::DxcThreadPool(1));
+    // The index waits for its worker before it is destroyed, so the task
+    // need not hold a reference to it.
+    m_worker->Async([this, fileName, args, unsaved, options, callback]() {
+      DxcThreadMalloc TM(m_pMalloc);
+      CComPtr<IDxcTranslationUnit> tu;
+      HRESULT hr;
+      try
+      {
+        std::vector<const char *> argPtrs;
+        for (const std::string &arg : args)
+          argPtrs.push_back(arg.c_str());
+        std::vector<IDxcUnsavedFile *> unsavedPtrs;
+        for (const CComPtr<IDxcUnsavedFile> &file : unsaved)
+          unsavedPtrs.push_back(file.p);
+        hr = ParseTranslationUnitImpl(
+          fileName.c_str(), argPtrs.data(), (int)argPtrs.size(),
+          unsavedPtrs.data(), (unsigned)unsavedPtrs.size(), options, &tu);
+      }
+      catch (...)
+      {
+        hr = E_FAIL;
+      }
+      // The pool drops exceptions; failures are reported through the callback.
+      callback->OnParseComplete(hr, SUCCEEDED(hr) ? tu.p : nullptr);
+    });
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
 
+HRESULT DxcIndex::WaitForPendingParses()
+{
+  try
+  {
+    // The worker is only destroyed with the index, so it can be waited on
+    // without the lock; callbacks may then queue further parses.
+    hlsl::DxcThreadPool *worker;
+    {
+      std::lock_guard<std::mutex> lock(m_workerLock);
+      worker = m_worker.get();
+    }
+    if (worker)
+      worker->Wait();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT DxcIndex::ParseTranslationUnitImpl(
+  const char *source_filename,
+  const char * const *command_line_args,
+  int num_command_line_args,
+  IDxcUnsavedFile** unsaved_files,
+  unsigned num_unsaved_files,
+  DxcTranslationUnitFlags options,
+  IDxcTranslationUnit** pTranslationUnit)
+{
   CXUnsavedFile* files;
   HRESULT hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &files);
   if (FAILED(hr)) return hr;
@@ -1668,10 +1762,22 @@ HRESULT DxcTranslationUnit::Reparse(
   DxcThreadMalloc TM(m_pMalloc);
   hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
   if (FAILED(hr)) return hr;
-  int reparseResult = clang_reparseTranslationUnit(
-    m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
-  CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
-  return reparseResult == 0 ? S_OK : E_FAIL;
+  try
+  {
+    // Included files are re-read on reparse, so they need the same file
+    // system that the initial parse used.
+    ::llvm::sys::fs::MSFileSystem* msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+    int reparseResult = clang_reparseTranslationUnit(
+      m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
+    CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
+    return reparseResult == 0 ? S_OK : E_FAIL;
+  }
+  CATCH_CPP_RETURN_HRESULT();
 }
 
 _Use_decl_annotations_
@@ -2241,6 +2347,7 @@ C_ASSERT((int)DxcCursor_FirstExtraDecl == (int)CXCursor_FirstExtraDecl);
 C_ASSERT((int)DxcCursor_LastExtraDecl == (int)CXCursor_LastExtraDecl);
 
 C_ASSERT((int)DxcTranslationUnitFlags_UseCallerThread == (int)CXTranslationUnit_UseCallerThread);
+C_ASSERT((int)DxcTranslationUnitFlags_SkipIncludedFunctionBodies == (int)CXTranslationUnit_SkipIncludedFunctionBodies);
 
 C_ASSERT((int)DxcCodeCompleteFlags_IncludeMacros == (int)CXCodeComplete_IncludeMacros);
 C_ASSERT((int)DxcCodeCompleteFlags_IncludeCodePatterns == (int)CXCodeComplete_IncludeCodePatterns);
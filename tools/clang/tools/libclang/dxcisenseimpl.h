@@ -17,6 +17,9 @@
 #include "dxc/dxcapi.internal.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/DxcLangExtensionsHelper.h"
+#include "dxc/Support/DxcThreadPool.h"
+#include <memory>
+#include <mutex>
 
 // Forward declarations.
 class DxcCursor;
@@ -157,18 +160,30 @@ public:
   HRESULT STDMETHODCALLTYPE GetStackItem(unsigned index, _Outptr_result_nullonfailure_ IDxcSourceLocation **pResult) override;
 };
 
-class DxcIndex : public IDxcIndex
+class DxcIndex : public IDxcIndex2
 {
 private:
     DXC_MICROCOM_TM_REF_FIELDS()
     CXIndex m_index;
     DxcGlobalOptions m_options;
     hlsl::DxcLangExtensionsHelper m_langHelper;
+    // Single worker for asynchronous parses, created on first use.
+    std::mutex m_workerLock;
+    std::unique_ptr<hlsl::DxcThreadPool> m_worker;
+
+    HRESULT ParseTranslationUnitImpl(
+      const char *source_filename,
+      const char * const *command_line_args,
+      int num_command_line_args,
+      IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      DxcTranslationUnitFlags options,
+      IDxcTranslationUnit** pTranslationUnit);
 public:
     DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override
     {
-      return DoBasicQueryInterface<IDxcIndex>(this, iid, ppvObject);
+      return DoBasicQueryInterface<IDxcIndex, IDxcIndex2>(this, iid, ppvObject);
     }
 
     DxcIndex();
@@ -186,6 +201,15 @@ public:
       unsigned num_unsaved_files,
       DxcTranslationUnitFlags options,
       _Outptr_result_nullonfailure_ IDxcTranslationUnit** pTranslationUnit) override;
+    HRESULT STDMETHODCALLTYPE ParseTranslationUnitAsync(
+      _In_z_ const char *source_filename,
+      _In_count_(num_command_line_args) const char * const *command_line_args,
+      int num_command_line_args,
+      _In_count_(num_unsaved_files) IDxcUnsavedFile** unsaved_files,
+      unsigned num_unsaved_files,
+      DxcTranslationUnitFlags options,
+      _In_ IDxcParseCallback* pCallback) override;
+    HRESULT STDMETHODCALLTYPE WaitForPendingParses() override;
 };
 
 class DxcIntelliSense : public IDxcIntelliSense, public IDxcLangExtensions {
@@ -43,6 +43,8 @@
 #include "dxc/Support/dxcfilesystem.h"
 #include "dxc/Support/HLSLOptions.h"
 
+#include <unordered_map>
+
 #define CP_UTF16 1200
 
 using namespace llvm;
@@ -63,35 +65,203 @@ public:
   }
 };
 
-class VarReferenceVisitor : public RecursiveASTVisitor<VarReferenceVisitor> {
+// Collects the functions and variables a declaration refers to directly.
+class DeclReferenceVisitor : public RecursiveASTVisitor<DeclReferenceVisitor> {
 private:
-  SmallPtrSetImpl<VarDecl*>& m_unusedGlobals;
-  SmallPtrSetImpl<FunctionDecl*>& m_visitedFunctions;
-  SmallVectorImpl<FunctionDecl*>& m_pendingFunctions;
+  SmallVectorImpl<FunctionDecl*>& m_functions;
+  SmallVectorImpl<VarDecl*>& m_vars;
 public:
-  VarReferenceVisitor(
-    SmallPtrSetImpl<VarDecl*>& unusedGlobals,
-    SmallPtrSetImpl<FunctionDecl*>& visitedFunctions,
-    SmallVectorImpl<FunctionDecl*>& pendingFunctions) :
-    m_unusedGlobals(unusedGlobals),
-    m_visitedFunctions(visitedFunctions),
-    m_pendingFunctions(pendingFunctions) {
+  DeclReferenceVisitor(
+    SmallVectorImpl<FunctionDecl*>& functions,
+    SmallVectorImpl<VarDecl*>& vars) :
+    m_functions(functions),
+    m_vars(vars) {
   }
 
   bool VisitDeclRefExpr(DeclRefExpr* ref) {
     ValueDecl* valueDecl = ref->getDecl();
     if (FunctionDecl* fnDecl = dyn_cast_or_null<FunctionDecl>(valueDecl)) {
-      if (!m_visitedFunctions.count(fnDecl)) {
-        m_pendingFunctions.push_back(fnDecl);
-      }
+      m_functions.push_back(fnDecl);
     }
     else if (VarDecl* varDecl = dyn_cast_or_null<VarDecl>(valueDecl)) {
-      m_unusedGlobals.erase(varDecl);
+      m_vars.push_back(varDecl);
     }
     return true;
   }
+
+  bool VisitMemberExpr(MemberExpr* ref) {
+    if (CXXMethodDecl* methodDecl = dyn_cast_or_null<CXXMethodDecl>(ref->getMemberDecl())) {
+      m_functions.push_back(methodDecl);
+    }
+    return true;
+  }
+};
+
+static FunctionDecl *GetDefinitionOrSelf(FunctionDecl *fnDecl) {
+  const FunctionDecl *definition = nullptr;
+  if (fnDecl->isDefined(definition))
+    return const_cast<FunctionDecl*>(definition);
+  return fnDecl;
+}
+
+// Finds the file-scope variables and functions that are not reachable from
+// an entry point. The references of each function are collected at most
+// once, so one parsed translation unit can serve many entry points.
+class UnusedDeclFinder {
+public:
+  explicit UnusedDeclFinder(TranslationUnitDecl *tu);
+  // Returns S_FALSE if there are no unused globals, in which case nothing is
+  // worth removing and unusedDecls is left empty.
+  HRESULT Find(LPCSTR pEntryPoint, raw_ostream &w,
+               SmallVectorImpl<Decl*> &unusedDecls);
+
+private:
+  struct References {
+    SmallVector<FunctionDecl*, 8> Functions;
+    SmallVector<VarDecl*, 8> Vars;
+  };
+  const References &GetReferences(FunctionDecl *fnDecl);
+
+  TranslationUnitDecl *m_tu;
+  // Global variables that are not in cbuffers, and functions with bodies.
+  SmallVector<VarDecl*, 128> m_globals;
+  SmallVector<FunctionDecl*, 128> m_functions;
+  DenseMap<RecordDecl*, unsigned> m_anonymousRecordRefCounts;
+  std::unordered_map<FunctionDecl*, References> m_references;
 };
 
+UnusedDeclFinder::UnusedDeclFinder(TranslationUnitDecl *tu) : m_tu(tu) {
+  for (Decl *tuDecl : tu->decls()) {
+    if (tuDecl->isImplicit()) continue;
+
+    VarDecl* varDecl = dyn_cast_or_null<VarDecl>(tuDecl);
+    if (varDecl != nullptr && varDecl->getFormalLinkage() == clang::Linkage::InternalLinkage) {
+      m_globals.push_back(varDecl);
+      if (const RecordType *recordType = varDecl->getType()->getAs<RecordType>()) {
+        RecordDecl *recordDecl = recordType->getDecl();
+        if (recordDecl && recordDecl->getName().empty()) {
+          m_anonymousRecordRefCounts[recordDecl]++; // Zero initialized if non-existing
+        }
+      }
+      continue;
+    }
+
+    FunctionDecl* fnDecl = dyn_cast_or_null<FunctionDecl>(tuDecl);
+    if (fnDecl != nullptr) {
+      if (fnDecl->doesThisDeclarationHaveABody()) {
+        m_functions.push_back(fnDecl);
+      }
+    }
+  }
+}
+
+const UnusedDeclFinder::References &
+UnusedDeclFinder::GetReferences(FunctionDecl *fnDecl) {
+  auto it = m_references.find(fnDecl);
+  if (it != m_references.end())
+    return it->second;
+  References &refs = m_references[fnDecl];
+  DeclReferenceVisitor visitor(refs.Functions, refs.Vars);
+  visitor.TraverseDecl(fnDecl);
+  // Follow calls through prototypes to the body.
+  for (FunctionDecl *&callee : refs.Functions)
+    callee = GetDefinitionOrSelf(callee);
+  return refs;
+}
+
+HRESULT UnusedDeclFinder::Find(LPCSTR pEntryPoint, raw_ostream &w,
+                               SmallVectorImpl<Decl*> &unusedDecls) {
+  ASTContext& C = m_tu->getASTContext();
+
+  w << "//found " << m_globals.size() << " globals as candidates for removal\n";
+  w << "//found " << m_functions.size() << " functions as candidates for removal\n";
+
+  DeclContext::lookup_result l = m_tu->lookup(DeclarationName(&C.Idents.get(StringRef(pEntryPoint))));
+  if (l.empty()) {
+    w << "//entry point not found\n";
+    return E_FAIL;
+  }
+
+  w << "//entry point found\n";
+  NamedDecl *entryDecl = l.front();
+  FunctionDecl *entryFnDecl = dyn_cast_or_null<FunctionDecl>(entryDecl);
+  if (entryFnDecl == nullptr) {
+    w << "//entry point found but is not a function declaration\n";
+    return E_FAIL;
+  }
+  entryFnDecl = GetDefinitionOrSelf(entryFnDecl);
+
+  // Traverse reachable functions and variables.
+  SmallPtrSet<FunctionDecl*, 128> visitedFunctions;
+  SmallPtrSet<VarDecl*, 128> usedVars;
+  SmallVector<FunctionDecl*, 32> pendingFunctions;
+  pendingFunctions.push_back(entryFnDecl);
+  while (!pendingFunctions.empty()) {
+    FunctionDecl* pendingDecl = pendingFunctions.pop_back_val();
+    if (!visitedFunctions.insert(pendingDecl).second)
+      continue;
+    const References &refs = GetReferences(pendingDecl);
+    usedVars.insert(refs.Vars.begin(), refs.Vars.end());
+    for (FunctionDecl *callee : refs.Functions) {
+      if (!visitedFunctions.count(callee))
+        pendingFunctions.push_back(callee);
+    }
+  }
+
+  SmallVector<VarDecl*, 128> unusedGlobals;
+  for (VarDecl *global : m_globals) {
+    if (!usedVars.count(global))
+      unusedGlobals.push_back(global);
+  }
+
+  // Don't bother doing work if there are no globals to remove.
+  if (unusedGlobals.empty()) {
+    return S_FALSE;
+  }
+
+  w << "//found " << unusedGlobals.size() << " globals to remove\n";
+
+  // Don't remove visited functions.
+  size_t unusedFunctionCount = 0;
+  for (FunctionDecl *fnDecl : m_functions) {
+    if (!visitedFunctions.count(fnDecl)) {
+      unusedDecls.push_back(fnDecl);
+      ++unusedFunctionCount;
+    }
+  }
+  w << "//found " << unusedFunctionCount << " functions to remove\n";
+
+  DenseMap<RecordDecl*, unsigned> anonymousRecordRefCounts(m_anonymousRecordRefCounts);
+  for (VarDecl *unusedGlobal : unusedGlobals) {
+    if (const RecordType *recordTy = unusedGlobal->getType()->getAs<RecordType>()) {
+      RecordDecl *recordDecl = recordTy->getDecl();
+      if (recordDecl && recordDecl->getName().empty()) {
+        // Anonymous structs can only be referenced by the variable they declare.
+        // If we've removed all declared variables of such a struct, remove it too,
+        // because anonymous structs without variable declarations in global scope are illegal.
+        auto recordRefCountIter = anonymousRecordRefCounts.find(recordDecl);
+        DXASSERT_NOMSG(recordRefCountIter != anonymousRecordRefCounts.end() && recordRefCountIter->second > 0);
+        recordRefCountIter->second--;
+        if (recordRefCountIter->second == 0) {
+          unusedDecls.push_back(recordDecl);
+        }
+      }
+    }
+
+    unusedDecls.push_back(unusedGlobal);
+  }
+
+  return S_OK;
+}
+
+// Removing declarations from a DeclContext one at a time costs a walk of
+// its whole decl list each, so unused declarations are hidden from the
+// printer instead, the same way implicit declarations are.
+static void SetDeclsHidden(ArrayRef<Decl*> decls, bool hidden) {
+  for (Decl *D : decls)
+    D->setImplicit(hidden);
+}
+
 static void raw_string_ostream_to_CoString(raw_string_ostream &o, _Outptr_result_z_ LPSTR *pResult) {
   std::string& s = o.str(); // .str() will flush automatically
   *pResult = (LPSTR)CoTaskMemAlloc(s.size() + 1);
@@ -412,122 +582,38 @@ void PrintTranslationUnitWithTranslatedUniformParams(
 static HRESULT DoRewriteUnused( TranslationUnitDecl *tu,
                                 LPCSTR pEntryPoint,
                                 raw_ostream &w) {
-  ASTContext& C = tu->getASTContext();
-
-  // Gather all global variables that are not in cbuffers and all functions.
-  SmallPtrSet<VarDecl*, 128> unusedGlobals;
-  DenseMap<RecordDecl*, unsigned> anonymousRecordRefCounts;
-  SmallPtrSet<FunctionDecl*, 128> unusedFunctions;
-  for (Decl *tuDecl : tu->decls()) {
-    if (tuDecl->isImplicit()) continue;
-
-    VarDecl* varDecl = dyn_cast_or_null<VarDecl>(tuDecl);
-    if (varDecl != nullptr && varDecl->getFormalLinkage() == clang::Linkage::InternalLinkage) {
-      unusedGlobals.insert(varDecl);
-      if (const RecordType *recordType = varDecl->getType()->getAs<RecordType>()) {
-        RecordDecl *recordDecl = recordType->getDecl();
-        if (recordDecl && recordDecl->getName().empty()) {
-          anonymousRecordRefCounts[recordDecl]++; // Zero initialized if non-existing
-        }
-      }
-      continue;
-    }
-
-    FunctionDecl* fnDecl = dyn_cast_or_null<FunctionDecl>(tuDecl);
-    if (fnDecl != nullptr) {
-      if (fnDecl->doesThisDeclarationHaveABody()) {
-        unusedFunctions.insert(fnDecl);
-      }
-    }
-  }
-
-  w << "//found " << unusedGlobals.size() << " globals as candidates for removal\n";
-  w << "//found " << unusedFunctions.size() << " functions as candidates for removal\n";
-
-  DeclContext::lookup_result l = tu->lookup(DeclarationName(&C.Idents.get(StringRef(pEntryPoint))));
-  if (l.empty()) {
-    w << "//entry point not found\n";
-    return E_FAIL;
-  }
-
-  w << "//entry point found\n";
-  NamedDecl *entryDecl = l.front();
-  FunctionDecl *entryFnDecl = dyn_cast_or_null<FunctionDecl>(entryDecl);
-  if (entryFnDecl == nullptr) {
-    w << "//entry point found but is not a function declaration\n";
-    return E_FAIL;
-  }
-
-  // Traverse reachable functions and variables.
-  SmallPtrSet<FunctionDecl*, 128> visitedFunctions;
-  SmallVector<FunctionDecl*, 32> pendingFunctions;
-  VarReferenceVisitor visitor(unusedGlobals, visitedFunctions, pendingFunctions);
-  pendingFunctions.push_back(entryFnDecl);
-  while (!pendingFunctions.empty() && !unusedGlobals.empty()) {
-    FunctionDecl* pendingDecl = pendingFunctions.pop_back_val();
-    visitedFunctions.insert(pendingDecl);
-    visitor.TraverseDecl(pendingDecl);
-  }
-
-  // Don't bother doing work if there are no globals to remove.
-  if (unusedGlobals.empty()) {
-    return S_FALSE;
-  }
-
-  w << "//found " << unusedGlobals.size() << " globals to remove\n";
-
-  // Don't remove visited functions.
-  for (FunctionDecl *visitedFn : visitedFunctions) {
-    unusedFunctions.erase(visitedFn);
-  }
-  w << "//found " << unusedFunctions.size() << " functions to remove\n";
-
-  // Remove all unused variables and functions.
-  for (VarDecl *unusedGlobal : unusedGlobals) {
-    if (const RecordType *recordTy = unusedGlobal->getType()->getAs<RecordType>()) {
-      RecordDecl *recordDecl = recordTy->getDecl();
-      if (recordDecl && recordDecl->getName().empty()) {
-        // Anonymous structs can only be referenced by the variable they declare.
-        // If we've removed all declared variables of such a struct, remove it too,
-        // because anonymous structs without variable declarations in global scope are illegal.
-        auto recordRefCountIter = anonymousRecordRefCounts.find(recordDecl);
-        DXASSERT_NOMSG(recordRefCountIter != anonymousRecordRefCounts.end() && recordRefCountIter->second > 0);
-        recordRefCountIter->second--;
-        if (recordRefCountIter->second == 0) {
-          tu->removeDecl(recordDecl);
-          anonymousRecordRefCounts.erase(recordRefCountIter);
-        }
-      }
-    }
-
-    tu->removeDecl(unusedGlobal);
-  }
-
-  for (FunctionDecl *unusedFn : unusedFunctions) {
-    tu->removeDecl(unusedFn);
-  }
+  SmallVector<Decl*, 128> unusedDecls;
+  HRESULT hr = UnusedDeclFinder(tu).Find(pEntryPoint, w, unusedDecls);
+  if (hr == S_OK)
+    SetDeclsHidden(unusedDecls, true);
 
   // Flush and return results.
   w.flush();
-  return S_OK;
+  return hr;
 }
 
+struct RewriteUnusedResult {
+  HRESULT Status = S_OK;
+  std::string Warnings;
+  std::string Rewrite;
+};
+
+// Parses the source once and removes unused globals for each entry point.
 static
 HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
                      _In_ LPCSTR pFileName,
                      _In_ ASTUnit::RemappedFile *pRemap,
-                     _In_ LPCSTR pEntryPoint,
+                     ArrayRef<LPCSTR> entryPoints,
                      _In_ LPCSTR pDefines,
-                     std::string &warnings,
-                     std::string &result) {
+                     std::vector<RewriteUnusedResult> &results) {
 
-  raw_string_ostream o(result);
-  raw_string_ostream w(warnings);
+  std::string parseWarnings;
+  raw_string_ostream pw(parseWarnings);
 
   // Setup a compiler instance.
   CompilerInstance compiler;
   std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
-      llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
+      llvm::make_unique<TextDiagnosticPrinter>(pw, &compiler.getDiagnosticOpts());
 
   hlsl::options::DxcOpts opts;
   opts.HLSLVersion = 2015;
@@ -541,28 +627,51 @@ HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
   ASTContext& C = compiler.getASTContext();
   TranslationUnitDecl *tu = C.getTranslationUnitDecl();
 
-  if (compiler.getDiagnosticClient().getNumErrors() > 0)
+  results.resize(entryPoints.size());
+  if (compiler.getDiagnosticClient().getNumErrors() > 0) {
+    pw.flush();
+    for (RewriteUnusedResult &result : results) {
+      result.Status = E_FAIL;
+      result.Warnings = parseWarnings;
+    }
     return E_FAIL;
+  }
 
-  HRESULT hr = DoRewriteUnused(tu, pEntryPoint, w);
-  if (FAILED(hr))
-    return hr;
+  std::string semanticDefines;
+  raw_string_ostream sd(semanticDefines);
+  WriteSemanticDefines(compiler, pHelper, sd);
+  sd.flush();
+  pw.flush();
 
-  if (hr == S_FALSE) {
-    w << "//no unused globals found - no work to be done\n";
-    StringRef contents = C.getSourceManager().getBufferData(C.getSourceManager().getMainFileID());
-    o << contents;
-  } else {
-    PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
-    p.Indentation = 1;
-    tu->print(o, p);
-  }
+  UnusedDeclFinder finder(tu);
+  PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
+  p.Indentation = 1;
 
-  WriteSemanticDefines(compiler, pHelper, o);
+  for (size_t i = 0; i < entryPoints.size(); ++i) {
+    RewriteUnusedResult &result = results[i];
+    raw_string_ostream o(result.Rewrite);
+    raw_string_ostream w(result.Warnings);
+    w << parseWarnings;
 
-  // Flush and return results.
-  o.flush();
-  w.flush();
+    SmallVector<Decl*, 128> unusedDecls;
+    HRESULT hr = finder.Find(entryPoints[i], w, unusedDecls);
+    if (FAILED(hr)) {
+      result.Status = hr;
+      continue;
+    }
+
+    if (hr == S_FALSE) {
+      w << "//no unused globals found - no work to be done\n";
+      StringRef contents = C.getSourceManager().getBufferData(C.getSourceManager().getMainFileID());
+      o << contents;
+    } else {
+      SetDeclsHidden(unusedDecls, true);
+      tu->print(o, p);
+      SetDeclsHidden(unusedDecls, false);
+    }
+
+    o << semanticDefines;
+  }
 
   return S_OK;
 }
@@ -692,7 +801,7 @@ HRESULT DoSimpleReWrite(_In_ DxcLangExtensionsHelper *pHelper,
   return S_OK;
 }
 
-class DxcRewriter : public IDxcRewriter2, public IDxcLangExtensions {
+class DxcRewriter : public IDxcRewriter3, public IDxcLangExtensions {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   DxcLangExtensionsHelper m_langExtensionsHelper;
@@ -702,7 +811,7 @@ public:
   DXC_LANGEXTENSIONS_HELPER_IMPL(m_langExtensionsHelper)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcRewriter2, IDxcRewriter, IDxcLangExtensions>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcRewriter3, IDxcRewriter2, IDxcRewriter, IDxcLangExtensions>(this, iid, ppvObject);
   }
 
   HRESULT STDMETHODCALLTYPE RemoveUnusedGlobals(_In_ IDxcBlobEncoding *pSource,
@@ -711,11 +820,28 @@ public:
                                                 _In_ UINT32 defineCount,
                                                 _COM_Outptr_ IDxcOperationResult **ppResult) override
   {
-    
-    if (pSource == nullptr || ppResult == nullptr || (defineCount > 0 && pDefines == nullptr))
+    if (pEntryPoint == nullptr || ppResult == nullptr)
       return E_INVALIDARG;
 
-    *ppResult = nullptr;
+    return RemoveUnusedGlobalsForEntryPoints(pSource, &pEntryPoint, 1,
+                                             pDefines, defineCount, ppResult);
+  }
+
+  HRESULT STDMETHODCALLTYPE RemoveUnusedGlobalsForEntryPoints(
+      _In_ IDxcBlobEncoding *pSource,
+      _In_count_(entryPointCount) LPCWSTR *pEntryPoints,
+      _In_ UINT32 entryPointCount,
+      _In_count_(defineCount) DxcDefine *pDefines,
+      _In_ UINT32 defineCount,
+      _Out_writes_(entryPointCount) IDxcOperationResult **ppResults) override
+  {
+    if (pSource == nullptr || ppResults == nullptr ||
+        (entryPointCount > 0 && pEntryPoints == nullptr) ||
+        (defineCount > 0 && pDefines == nullptr))
+      return E_INVALIDARG;
+
+    for (UINT32 i = 0; i < entryPointCount; ++i)
+      ppResults[i] = nullptr;
 
     DxcThreadMalloc TM(m_pMalloc);
 
@@ -735,21 +861,34 @@ public:
       std::unique_ptr<llvm::MemoryBuffer> pBuffer(llvm::MemoryBuffer::getMemBufferCopy(Data, fakeName));
       std::unique_ptr<ASTUnit::RemappedFile> pRemap(new ASTUnit::RemappedFile(fakeName, pBuffer.release()));
 
-      CW2A utf8EntryPoint(pEntryPoint, CP_UTF8);
+      std::vector<std::string> utf8EntryPoints;
+      for (UINT32 i = 0; i < entryPointCount; ++i) {
+        CW2A utf8EntryPoint(pEntryPoints[i], CP_UTF8);
+        utf8EntryPoints.emplace_back(utf8EntryPoint.m_psz);
+      }
+      std::vector<LPCSTR> entryPoints;
+      for (const std::string &entryPoint : utf8EntryPoints)
+        entryPoints.push_back(entryPoint.c_str());
       std::string definesStr = DefinesToString(pDefines, defineCount);
 
-      std::string errors;
-      std::string rewrite;
+      std::vector<RewriteUnusedResult> results;
       LPCWSTR pOutputName = nullptr;  // TODO: Fill this in
-      HRESULT status = DoRewriteUnused(
-          &m_langExtensionsHelper, fakeName, pRemap.get(), utf8EntryPoint,
-          defineCount > 0 ? definesStr.c_str() : nullptr, errors, rewrite);
-      return DxcResult::Create(status, DXC_OUT_HLSL, {
-          DxcOutputObject::StringOutput(DXC_OUT_HLSL, CP_UTF8,  // TODO: Support DefaultTextCodePage
-            rewrite.c_str(), pOutputName),
-          DxcOutputObject::ErrorOutput(CP_UTF8,   // TODO Support DefaultTextCodePage
-            errors.c_str())
-        }, ppResult);
+      DoRewriteUnused(&m_langExtensionsHelper, fakeName, pRemap.get(),
+                      entryPoints, defineCount > 0 ? definesStr.c_str() : nullptr,
+                      results);
+
+      std::vector<CComPtr<IDxcOperationResult>> operationResults(entryPointCount);
+      for (UINT32 i = 0; i < entryPointCount; ++i) {
+        IFT(DxcResult::Create(results[i].Status, DXC_OUT_HLSL, {
+            DxcOutputObject::StringOutput(DXC_OUT_HLSL, CP_UTF8,  // TODO: Support DefaultTextCodePage
+              results[i].Rewrite.c_str(), pOutputName),
+            DxcOutputObject::ErrorOutput(CP_UTF8,   // TODO Support DefaultTextCodePage
+              results[i].Warnings.c_str())
+          }, &operationResults[i]));
+      }
+      for (UINT32 i = 0; i < entryPointCount; ++i)
+        ppResults[i] = operationResults[i].Detach();
+      return S_OK;
     }
     CATCH_CPP_RETURN_HRESULT();
   }
@@ -7,14 +7,25 @@
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/dxcdxrfallbackcompiler.h"
 #include "dxc/support/dxcapi.use.h"
-
+#include "dxc/DXIL/DxilConstants.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilUtil.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxrFallback/DxrFallbackCompiler.h"
+#include "dxc/HLSL/DxilLinker.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "defaultTestFilePath.h"
 #include "ShaderTester.h"
+#include "LiveValues.h"
 #undef IGNORE
 #undef OPAQUE
 #include "testFiles/testTraversal.h"
@@ -308,6 +319,194 @@ public:
   }
 };
 
+// Runs DxrFallbackCompiler in process, without a device, to check that
+// settings which should not change the compiled module do not.
+class FallbackCompilerTester : public Tester
+{
+public:
+  struct Result
+  {
+    std::string text;
+    std::vector<int> stateIds;
+    std::vector<unsigned int> stackSizes;
+
+    bool operator==(const Result& other) const
+    {
+      return text == other.text && stateIds == other.stateIds && stackSizes == other.stackSizes;
+    }
+  };
+
+  FallbackCompilerTester(const std::string& path)
+    : Tester("", path)
+  {}
+
+  // Compiles the way DxcDxrFallbackCompiler::Compile does, returning the
+  // module with its functions and globals in name order.
+  bool compile(const std::vector<std::string>& shaderNames, DxrFallbackStateFunctionCache* cache, unsigned threadCount, Result& result)
+  {
+    LLVMContext context;
+    std::unique_ptr<DxilLinker> linker(DxilLinker::CreateLinker(context, DXIL::kDxilMajor, DXIL::kDxilMinor));
+    for (size_t i = 0; i < m_inputBlobs.size(); ++i)
+    {
+      std::unique_ptr<Module> lib = loadModule(context, m_inputBlobs[i]);
+      if (!lib)
+        return false;
+      lib->GetOrCreateDxilModule();
+      linker->RegisterLib(std::to_string(i), std::move(lib), nullptr);
+      linker->AttachLib(std::to_string(i));
+    }
+    dxilutil::ExportMap exportMap;
+    std::unique_ptr<Module> M = linker->Link("", "lib_6_3", exportMap);
+    if (!M)
+      return false;
+
+    DxrFallbackCompiler compiler(M.get(), shaderNames, 32, 0);
+    compiler.setStateFunctionCache(cache);
+    compiler.setThreadCount(threadCount);
+    compiler.compile(result.stateIds, result.stackSizes, nullptr);
+
+    std::vector<std::string> parts;
+    for (Function& F : *M)
+    {
+      parts.emplace_back();
+      raw_string_ostream OS(parts.back());
+      F.print(OS);
+    }
+    for (GlobalVariable& GV : M->globals())
+    {
+      parts.emplace_back();
+      raw_string_ostream OS(parts.back());
+      GV.print(OS);
+    }
+    std::sort(parts.begin(), parts.end());
+    result.text.clear();
+    for (auto& part : parts)
+      result.text += part + "\n";
+    return true;
+  }
+
+  // Returns the number of failures.
+  int runCacheTest(const std::vector<std::string>& shaderNames)
+  {
+    std::cout << "state function cache\n";
+    DxrFallbackStateFunctionCache cache;
+    Result uncached, first, second;
+    if (!compile(shaderNames, nullptr, 1, uncached) || !compile(shaderNames, &cache, 1, first))
+      return report(false);
+    unsigned firstHits = cache.getHitCount();
+    if (!compile(shaderNames, &cache, 1, second))
+      return report(false);
+    // The first compile fills the cache, the second links every shader from
+    // it, and neither changes the result.
+    return report(firstHits == 0 && cache.getHitCount() > 0 && first == uncached && second == uncached);
+  }
+
+  // Returns the number of failures.
+  int runParallelTest(const std::vector<std::string>& shaderNames)
+  {
+    std::cout << "parallel state function transform\n";
+    Result serial, parallel;
+    if (!compile(shaderNames, nullptr, 1, serial) || !compile(shaderNames, nullptr, 4, parallel))
+      return report(false);
+    return report(serial == parallel);
+  }
+
+private:
+  static std::unique_ptr<Module> loadModule(LLVMContext& context, IDxcBlob* pContainer)
+  {
+    const DxilContainerHeader* pHeader = IsDxilContainerLike(pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+    if (!pHeader || !IsValidDxilContainer(pHeader, pContainer->GetBufferSize()))
+      return nullptr;
+    const DxilPartHeader* pPart = GetDxilPartByType(pHeader, DFCC_DXIL);
+    if (!pPart)
+      return nullptr;
+    const DxilProgramHeader* pProgram = reinterpret_cast<const DxilProgramHeader*>(GetDxilPartData(pPart));
+    const char* pIL = nullptr;
+    uint32_t ILLength = 0;
+    GetDxilProgramBitcode(pProgram, &pIL, &ILLength);
+    std::string diagStr;
+    return dxilutil::LoadModuleFromBitcode(StringRef(pIL, ILLength), context, diagStr);
+  }
+
+  static int report(bool passed)
+  {
+    std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+    return passed ? 0 : 1;
+  }
+};
+
+// Checks that allocas moved to the stack frame share bytes exactly when
+// their contents are never needed at the same time. Returns the number of
+// failures.
+int runStackSlotTest()
+{
+  std::cout << "alloca stack slots\n";
+  // %a is needed in entry and first, %b only in second, so they can share.
+  // %c is needed from entry to second and overlaps both. %d would fit with
+  // %a, but its address escapes.
+  const char* text =
+    "declare void @g(i32*)\n"
+    "define void @f() {\n"
+    "entry:\n"
+    "  %a = alloca [4 x i32]\n"
+    "  %b = alloca [4 x i32]\n"
+    "  %c = alloca [4 x i32]\n"
+    "  %d = alloca [4 x i32]\n"
+    "  %pa = getelementptr [4 x i32], [4 x i32]* %a, i32 0, i32 0\n"
+    "  store i32 1, i32* %pa\n"
+    "  %pc = getelementptr [4 x i32], [4 x i32]* %c, i32 0, i32 0\n"
+    "  store i32 3, i32* %pc\n"
+    "  br label %first\n"
+    "first:\n"
+    "  %va = load i32, i32* %pa\n"
+    "  br label %second\n"
+    "second:\n"
+    "  %pb = getelementptr [4 x i32], [4 x i32]* %b, i32 0, i32 0\n"
+    "  store i32 %va, i32* %pb\n"
+    "  %vc = load i32, i32* %pc\n"
+    "  store i32 %vc, i32* %pb\n"
+    "  %pd = getelementptr [4 x i32], [4 x i32]* %d, i32 0, i32 0\n"
+    "  call void @g(i32* %pd)\n"
+    "  ret void\n"
+    "}\n";
+  LLVMContext context;
+  SMDiagnostic err;
+  std::unique_ptr<Module> M = parseAssemblyString(text, err, context);
+  if (!M)
+  {
+    err.print("runStackSlotTest", errs());
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
+  std::map<std::string, AllocaInst*> allocas;
+  std::vector<AllocaInst*> allocaList;
+  for (Instruction& I : M->getFunction("f")->getEntryBlock())
+  {
+    if (AllocaInst* AI = dyn_cast<AllocaInst>(&I))
+    {
+      allocas[AI->getName()] = AI;
+      allocaList.push_back(AI);
+    }
+  }
+  DenseMap<AllocaInst*, uint64_t> offsets;
+  uint64_t end = assignAllocaStackSlots(allocaList, M->getDataLayout(), 0, offsets);
+
+  const uint64_t size = 16;
+  auto overlaps = [&](const char* x, const char* y)
+  {
+    uint64_t ox = offsets[allocas[x]], oy = offsets[allocas[y]];
+    return ox < oy + size && oy < ox + size;
+  };
+  bool passed = offsets.size() == 4 &&
+    offsets[allocas["a"]] == offsets[allocas["b"]] &&
+    !overlaps("a", "c") && !overlaps("b", "c") &&
+    !overlaps("a", "d") && !overlaps("b", "d") && !overlaps("c", "d") &&
+    end == 3 * size;
+  std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+  return passed ? 0 : 1;
+}
+
 int asint(float v)
 {
   return *(int*)&v;
@@ -850,6 +1049,17 @@ int main(int argc, const char* argv[])
       std::cout << "Testing on device " << deviceName << std::endl;
 
     int numFailed = 0;
+    numFailed += runStackSlotTest();
+
+    if (1)
+    {
+      FallbackCompilerTester tester(basePath);
+      tester.setFiles({ "testShader5.hlsl" });
+      const std::vector<std::string> shaderNames = { "raygen", "ch1", "ch2", "miss1", "miss2", "Fallback_TraceRay" };
+      numFailed += tester.runCacheTest(shaderNames);
+      numFailed += tester.runParallelTest(shaderNames);
+    }
+
     if (1)
     {
       RtCompilerTester tester(deviceName, basePath);
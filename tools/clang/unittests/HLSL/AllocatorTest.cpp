@@ -547,6 +547,7 @@ public:
   TEST_METHOD(Intersections)
   TEST_METHOD(GapFilling)
   TEST_METHOD(Allocate)
+  TEST_METHOD(RepeatedAllocate)
 
   void InitScenarios() {
     struct P {
@@ -766,3 +767,35 @@ TEST_F(AllocatorTest, Allocate) {
     TestSizesFn();
   }
 }
+
+TEST_F(AllocatorTest, RepeatedAllocate) {
+  WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
+  static const unsigned MaxAllocations = 64;
+  for (auto &&scenario : m_Scenarios) {
+    // Allocating the same size over and over fills the gaps in order, even
+    // as earlier gaps become too small.
+    for (unsigned sizeLess1 : { 0u, 1u, 4u }) {
+      Allocator alloc(scenario.Min, scenario.Max);
+      VERIFY_IS_TRUE(scenario.InsertSpans(alloc));
+      ElementVector elements;
+      elements.reserve(MaxAllocations);
+      for (auto &gap : scenario.gaps[1]) {
+        for (unsigned start = gap.start;
+             elements.size() < MaxAllocations && start >= gap.start &&
+             start <= gap.end && gap.end - start >= sizeLess1;
+             start += sizeLess1 + 1) {
+          elements.emplace_back(UINT_MAX, start, start + sizeLess1);
+          unsigned pos = 0xFEFEFEFE;
+          VERIFY_IS_TRUE(alloc.Allocate(&elements.back(), sizeLess1 + 1, pos));
+          VERIFY_ARE_EQUAL(start, pos);
+        }
+      }
+      if (elements.size() < MaxAllocations) {
+        // Every gap that fits is used, so the next allocation fails.
+        Element e(UINT_MAX, 0, 0);
+        unsigned pos = 0xFEFEFEFE;
+        VERIFY_IS_FALSE(alloc.Allocate(&e, sizeLess1 + 1, pos));
+      }
+    }
+  }
+}
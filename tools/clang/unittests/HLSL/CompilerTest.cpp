@@ -20,7 +20,11 @@
 #include <cassert>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 #include <cfloat>
+#include <thread>
+#include <chrono>
+#include <mutex>
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/dxcapi.h"
@@ -37,6 +41,8 @@
 #include "llvm/Support/raw_os_ostream.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/DxcSourceStore.h"
+#include "dxc/Support/DxcThreadPool.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/Support/Unicode.h"
@@ -168,6 +174,7 @@ public:
     UINT32 codePage;
     LoadSourceCallResult() : hr(E_FAIL), codePage(0) { }
     LoadSourceCallResult(const char *pSource, UINT32 codePage = CP_UTF8) : hr(S_OK), source(pSource), codePage(codePage) { }
+    LoadSourceCallResult(const std::string &source, UINT32 codePage = CP_UTF8) : hr(S_OK), source(source), codePage(codePage) { }
   };
   std::vector<LoadSourceCallResult> CallResults;
   size_t callIndex;
@@ -206,6 +213,7 @@ public:
 
   TEST_METHOD(CompileWhenDebugThenDIPresent)
   TEST_METHOD(CompileDebugLines)
+  TEST_METHOD(CompileDebugLinesFromThreads)
   TEST_METHOD(CompileDebugPDB)
   TEST_METHOD(CompileDebugDisasmPDB)
 
@@ -221,6 +229,11 @@ public:
 
   TEST_METHOD(CompileWhenIncludeThenLoadInvoked)
   TEST_METHOD(CompileWhenIncludeThenLoadUsed)
+  TEST_METHOD(CompileWhenIncludeSameFileByTwoPathsThenLoadOnce)
+  TEST_METHOD(CompileWhenMThenDependencyRule)
+  TEST_METHOD(CompileWhenMDThenDependencyOutput)
+  TEST_METHOD(CompileWhenFstatsThenStatisticsOutput)
+  TEST_METHOD(CompileWhenExportsFileThenRenameExports)
   TEST_METHOD(CompileWhenIncludeAbsoluteThenLoadAbsolute)
   TEST_METHOD(CompileWhenIncludeLocalThenLoadRelative)
   TEST_METHOD(CompileWhenIncludeSystemThenLoadNotRelative)
@@ -229,8 +242,34 @@ public:
   TEST_METHOD(CompileWhenIncludeMissingThenFail)
   TEST_METHOD(CompileWhenIncludeHasPathThenOK)
   TEST_METHOD(CompileWhenIncludeEmptyThenOK)
+  TEST_METHOD(CompileWhenCacheStoreSetThenIdenticalCompileHits)
+  TEST_METHOD(CompileWhenCacheStoreSetThenProfileChangeMisses)
+  TEST_METHOD(CompileWhenSourceStoreSetThenIncludesAreStored)
+  TEST_METHOD(CompileWhenSourceStoreDirectoryMissingThenCreated)
+  TEST_METHOD(BridgeCompileWhenCachedThenResultsAreCopies)
+  TEST_METHOD(DisassembleWhenCacheStoreSetThenSecondCallHits)
+  TEST_METHOD(CompileBatchWhenSharedSourceThenAllJobsComplete)
+  TEST_METHOD(CompileBatchWhenTaskExecutorSetThenRunsOnExecutor)
+  TEST_METHOD(ThreadPoolWhenNestedThenHonoursCreatorLimit)
+  TEST_METHOD(CompileEntryPointsWhenManyEntriesThenResultPerEntry)
+  TEST_METHOD(CompilePermutationsWhenDefinesDifferThenResultPerPermutation)
+  TEST_METHOD(CompileWhenIncludeCacheSharedThenHandlerCalledOnce)
+  TEST_METHOD(CompileWhenPrecompiledHeaderThenHeaderReplaced)
 
   TEST_METHOD(CompileWhenODumpThenPassConfig)
+  TEST_METHOD(CompileWhenTimeReportThenPhasesAndPassesReturned)
+  TEST_METHOD(CompileWhenArenaThenSameOutputs)
+  TEST_METHOD(CompileWhenContextPoolThenSameOutputs)
+  TEST_METHOD(CompileWhenDeadlineExceededThenDistinctStatus)
+  TEST_METHOD(CompileWhenCancelledThenDistinctStatus)
+  TEST_METHOD(CompileAsyncWhenExecutorGivenThenRunsOnExecutor)
+  TEST_METHOD(CompileAsyncWhenCallbackReleasesCompilerThenCompilerFreed)
+  TEST_METHOD(CompileWhenMemoryLimitExceededThenDistinctStatus)
+  TEST_METHOD(CompileWhenParallelVerifyThenSameOutputs)
+  TEST_METHOD(CompileWhenArenaAndParallelVerifyThenSameOutputs)
+#ifdef ENABLE_SPIRV_CODEGEN
+  TEST_METHOD(CompileWhenSpirvWithFreThenSpirvReflection)
+#endif
   TEST_METHOD(CompileWhenODumpThenOptimizerMatch)
   TEST_METHOD(CompileWhenVdThenProducesDxilContainer)
 
@@ -243,6 +282,7 @@ public:
     // such as in ~raw_string_ostream(), where it flushes, then eats bad_alloc(), if thrown.
     TEST_METHOD_PROPERTY(L"Ignore", L"true")
   END_TEST_METHOD()
+  TEST_METHOD(ValidateWhenNoMemThenRootSignatureNotCachedInvalid)
 #endif
   TEST_METHOD(CompileWhenShaderModelMismatchAttributeThenFail)
   TEST_METHOD(CompileBadHlslThenFail)
@@ -259,6 +299,7 @@ public:
 
   TEST_METHOD(DiaLoadBadBitcodeThenFail)
   TEST_METHOD(DiaLoadDebugThenOK)
+  TEST_METHOD(DiaLoadDebugTwiceThenOK)
   TEST_METHOD(DiaTableIndexThenOK)
   TEST_METHOD(DiaLoadDebugSubrangeNegativeThenOK)
   TEST_METHOD(DiaLoadRelocatedBitcode)
@@ -281,6 +322,7 @@ public:
   TEST_METHOD(CodeGenRootSigProfile)
   TEST_METHOD(CodeGenRootSigProfile2)
   TEST_METHOD(CodeGenRootSigProfile5)
+  TEST_METHOD(CodeGenRootSigProfile6)
   TEST_METHOD(PreprocessWhenValidThenOK)
   TEST_METHOD(LibGVStore)
   TEST_METHOD(PreprocessWhenExpandTokenPastingOperandThenAccept)
@@ -1216,6 +1258,62 @@ TEST_F(CompilerTest, CompileDebugLines) {
   VERIFY_SUCCEEDED(pFile->get_fileName(&pName));
   VERIFY_ARE_EQUAL_WSTR(pName, L"source.hlsl");
 }
+
+TEST_F(CompilerTest, CompileDebugLinesFromThreads) {
+  CComPtr<IDiaDataSource> pDiaSource;
+  VERIFY_SUCCEEDED(CreateDiaSourceForCompile(
+    "float main(float pos : A) : SV_Target {\r\n"
+    "  float x = abs(pos);\r\n"
+    "  float y = sin(pos);\r\n"
+    "  float z = x + y;\r\n"
+    "  return z;\r\n"
+    "}", &pDiaSource));
+
+  const uint32_t numExpectedVAs = 18;
+  const uint32_t numExpectedLineEntries = 6;
+  const unsigned numThreads = 4;
+
+  // All threads query the same new session, so they race to build its
+  // indexes and symbols.
+  CComPtr<IDiaSession> pSession;
+  VERIFY_SUCCEEDED(pDiaSource->openSession(&pSession));
+  CComPtr<IDiaEnumTables> pTables;
+  VERIFY_SUCCEEDED(pSession->getEnumTables(&pTables));
+
+  std::vector<HRESULT> results(numThreads, S_OK);
+  std::vector<std::vector<LineNumber>> lines(numThreads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      HRESULT &hr = results[t];
+      for (uint32_t i = 0; i < numExpectedVAs && SUCCEEDED(hr); ++i) {
+        CComPtr<IDiaEnumLineNumbers> pEnumLineNumbers;
+        hr = pSession->findLinesByRVA(i, 1, &pEnumLineNumbers);
+        if (SUCCEEDED(hr)) {
+          std::vector<LineNumber> found = ReadLineNumbers(pEnumLineNumbers);
+          lines[t].insert(lines[t].end(), found.begin(), found.end());
+        }
+      }
+      CComPtr<IDiaSymbol> pGlobalScope;
+      if (SUCCEEDED(hr))
+        hr = pSession->get_globalScope(&pGlobalScope);
+      CComPtr<IDiaSourceFile> pFile;
+      if (SUCCEEDED(hr))
+        hr = pSession->findFileById(0, &pFile);
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+
+  for (unsigned t = 0; t < numThreads; ++t) {
+    VERIFY_SUCCEEDED(results[t]);
+    VERIFY_ARE_EQUAL(lines[t].size(), numExpectedLineEntries);
+    for (uint32_t i = 0; i < numExpectedLineEntries; ++i) {
+      VERIFY_ARE_EQUAL(lines[t][i].line, lines[0][i].line);
+      VERIFY_ARE_EQUAL(lines[t][i].rva, lines[0][i].rva);
+    }
+  }
+}
 #endif // _WIN32 - exclude dia stuff
 
 TEST_F(CompilerTest, CompileWhenDefinesThenApplied) {
@@ -1649,6 +1747,158 @@ TEST_F(CompilerTest, CompileWhenIncludeThenLoadUsed) {
   VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
 }
 
+TEST_F(CompilerTest, CompileWhenIncludeSameFileByTwoPathsThenLoadOnce) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"inc/helper.h\"\r\n"
+    "#include \"./inc/helper.h\"\r\n"
+    "float4 main() : SV_Target { S s = { 0 }; return s.f; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#pragma once\nstruct S { float f; };");
+
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", nullptr, 0, nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_ARE_EQUAL_WSTR(L"./inc/helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenMThenDependencyRule) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pOperationResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return ZERO; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+
+  LPCWSTR Args[] = { L"-M", L"-MT", L"out.dxo" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, pInclude, &pOperationResult));
+  VerifyOperationSucceeded(pOperationResult);
+
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pOperationResult.QueryInterface(&pResult));
+  VERIFY_ARE_EQUAL(DXC_OUT_DEPENDENCIES, pResult->PrimaryOutput());
+  CComPtr<IDxcBlob> pRule;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pRule));
+  std::string rule = BlobToUtf8(pRule);
+  VERIFY_ARE_EQUAL(0u, rule.find("out.dxo:"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, rule.find("source.hlsl"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, rule.find("helper.h"));
+}
+
+TEST_F(CompilerTest, CompileWhenMDThenDependencyOutput) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pOperationResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return ZERO; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0");
+
+  LPCWSTR Args[] = { L"-MD", L"-MF", L"source.d" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, pInclude, &pOperationResult));
+  VerifyOperationSucceeded(pOperationResult);
+
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pOperationResult.QueryInterface(&pResult));
+  VERIFY_ARE_EQUAL(DXC_OUT_OBJECT, pResult->PrimaryOutput());
+  CComPtr<IDxcBlob> pRule;
+  CComPtr<IDxcBlobUtf16> pName;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_DEPENDENCIES,
+                                      IID_PPV_ARGS(&pRule), &pName));
+  VERIFY_ARE_EQUAL_WSTR(L"source.d", pName->GetStringPointer());
+  std::string rule = BlobToUtf8(pRule);
+  VERIFY_ARE_EQUAL(0u, rule.find("source.hlsl:"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, rule.find("helper.h"));
+}
+
+TEST_F(CompilerTest, CompileWhenFstatsThenStatisticsOutput) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pOperationResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "Texture2D T; SamplerState S;\r\n"
+    "float4 main(float2 uv : TEXCOORD) : SV_Target {\r\n"
+    "  float4 c = 0;\r\n"
+    "  [loop] for (int i = 0; i < 4; ++i)\r\n"
+    "    c += T.Sample(S, uv * i);\r\n"
+    "  return c;\r\n"
+    "}", &pSource);
+
+  LPCWSTR Args[] = { L"-Fstats", L"source.json" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pOperationResult));
+  VerifyOperationSucceeded(pOperationResult);
+
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pOperationResult.QueryInterface(&pResult));
+  CComPtr<IDxcBlob> pStats;
+  CComPtr<IDxcBlobUtf16> pName;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_SHADER_STATISTICS,
+                                      IID_PPV_ARGS(&pStats), &pName));
+  VERIFY_ARE_EQUAL_WSTR(L"source.json", pName->GetStringPointer());
+  std::string stats = BlobToUtf8(pStats);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, stats.find("\"name\": \"main\""));
+  // The sample runs once for each of the four trips of the loop.
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, stats.find("\"texture\": 4,"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, stats.find("\"unknownTripLoops\": 0,"));
+}
+
+TEST_F(CompilerTest, CompileWhenExportsFileThenRenameExports) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "export float foo(float x) { return x * 2; }\r\n"
+    "export float bar(float x) { return x + 1; }\r\n"
+    "export float baz(float x) { return x - 1; }", &pSource);
+
+  // foo is exported as renamed_foo and cloned_foo, bar as itself.
+  const char ExportList[] = "foo\0renamed_foo\0cloned_foo\0\0bar\0\0";
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(
+      std::string(ExportList, sizeof(ExportList) - 1));
+
+  LPCWSTR Args[] = { L"-exports-file", L"exports.bin" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"",
+    L"lib_6_3", Args, _countof(Args), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  CComPtr<IDxcBlobEncoding> pDisassembleBlob;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembleBlob));
+  std::string disassembly = BlobToUtf8(pDisassembleBlob);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, disassembly.find("?renamed_foo@@"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, disassembly.find("?cloned_foo@@"));
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, disassembly.find("?bar@@"));
+  VERIFY_ARE_EQUAL(std::string::npos, disassembly.find("?foo@@"));
+  VERIFY_ARE_EQUAL(std::string::npos, disassembly.find("?baz@@"));
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeAbsoluteThenLoadAbsolute) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -1856,6 +2106,688 @@ TEST_F(CompilerTest, CompileWhenIncludeEmptyThenOK) {
   VERIFY_ARE_EQUAL_WSTR(L"./empty.h;", pInclude->GetAllFileNames().c_str());
 }
 
+// Cache store that counts the lookups which found a value and the stores.
+class TestCacheStore : public IDxcCompileCacheStore {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::map<std::string, CComPtr<IDxcBlob>> m_values;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestCacheStore() : m_dwRef(0) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileCacheStore>(this, iid, ppvObject);
+  }
+
+  UINT32 HitCount = 0;
+  UINT32 StoreCount = 0;
+
+  HRESULT STDMETHODCALLTYPE Lookup(const DxcBuffer *pKey, IDxcBlob **ppValue) override {
+    auto it = m_values.find(std::string((const char *)pKey->Ptr, pKey->Size));
+    if (it == m_values.end()) {
+      *ppValue = nullptr;
+      return S_FALSE;
+    }
+    ++HitCount;
+    return it->second.p->QueryInterface(ppValue);
+  }
+  HRESULT STDMETHODCALLTYPE Store(const DxcBuffer *pKey, IDxcBlob *pValue) override {
+    ++StoreCount;
+    m_values[std::string((const char *)pKey->Ptr, pKey->Size)] = pValue;
+    return S_OK;
+  }
+};
+
+TEST_F(CompilerTest, CompileWhenCacheStoreSetThenIdenticalCompileHits) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompileCache> pCache;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCache));
+  CComPtr<TestCacheStore> pStore = new TestCacheStore();
+  VERIFY_SUCCEEDED(pCache->SetStore(pStore));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  auto compileWithInclude = [&](const char *pInclude, IDxcBlob **ppObject,
+                                std::wstring &fileNames) {
+    CComPtr<TestIncludeHandler> pHandler = new TestIncludeHandler(m_dllSupport);
+    pHandler->CallResults.emplace_back(pInclude);
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", nullptr, 0, nullptr, 0, pHandler, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppObject));
+    fileNames = pHandler->GetAllFileNames();
+  };
+
+  CComPtr<IDxcBlob> pFirst, pSecond, pChanged;
+  std::wstring fileNames;
+  compileWithInclude("#define VALUE 1", &pFirst, fileNames);
+  // The include is loaded once and replayed for the real compile.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", fileNames.c_str());
+  VERIFY_ARE_EQUAL(0u, pStore->HitCount);
+  VERIFY_ARE_EQUAL(1u, pStore->StoreCount);
+  // The identical compile is served from the store and not stored again.
+  compileWithInclude("#define VALUE 1", &pSecond, fileNames);
+  VERIFY_ARE_EQUAL(1u, pStore->HitCount);
+  VERIFY_ARE_EQUAL(1u, pStore->StoreCount);
+  VERIFY_ARE_EQUAL(pFirst->GetBufferSize(), pSecond->GetBufferSize());
+  VERIFY_IS_TRUE(0 == memcmp(pFirst->GetBufferPointer(),
+                             pSecond->GetBufferPointer(),
+                             pFirst->GetBufferSize()));
+
+  // Changing the include contents changes the key.
+  compileWithInclude("#define VALUE 2", &pChanged, fileNames);
+  VERIFY_ARE_EQUAL(1u, pStore->HitCount);
+  VERIFY_ARE_EQUAL(2u, pStore->StoreCount);
+  VERIFY_IS_FALSE(pFirst->GetBufferSize() == pChanged->GetBufferSize() &&
+                  0 == memcmp(pFirst->GetBufferPointer(),
+                              pChanged->GetBufferPointer(),
+                              pFirst->GetBufferSize()));
+}
+
+TEST_F(CompilerTest, CompileWhenCacheStoreSetThenProfileChangeMisses) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompileCache> pCache;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCache));
+  CComPtr<TestCacheStore> pStore = new TestCacheStore();
+  VERIFY_SUCCEEDED(pCache->SetStore(pStore));
+  CreateBlobFromText(
+    "float c;\r\n"
+    "float main(float2 a:A) : SV_Target {\r\n"
+    "  float x = a.x;\r\n"
+    "  if (c > 2)\r\n"
+    "    x = x * 3;\r\n"
+    "  return x;\r\n"
+    "}", &pSource);
+
+  // The profile is read by the backend, after the cache key is computed.
+  auto compileWithProfile = [&](const char *pProfile, IDxcBlob **ppObject) {
+    CComPtr<TestIncludeHandler> pHandler = new TestIncludeHandler(m_dllSupport);
+    pHandler->CallResults.emplace_back(pProfile);
+    LPCWSTR args[] = { L"-profile-use", L"profile.prof" };
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", args, _countof(args), nullptr, 0, pHandler, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppObject));
+  };
+
+  CComPtr<IDxcBlob> pTaken, pNotTaken, pUncached;
+  compileWithProfile("main:3000:1000\n1: 1000\n2: 1000\n3: 1000\n4: 1000\n",
+                     &pTaken);
+  compileWithProfile("main:3000:1000\n1: 1000\n2: 1000\n4: 1000\n",
+                     &pNotTaken);
+  VERIFY_ARE_EQUAL(0u, pStore->HitCount);
+
+  // The second compile must match one made without the cache.
+  VERIFY_SUCCEEDED(pCache->SetStore(nullptr));
+  compileWithProfile("main:3000:1000\n1: 1000\n2: 1000\n4: 1000\n",
+                     &pUncached);
+  VERIFY_ARE_EQUAL(pUncached->GetBufferSize(), pNotTaken->GetBufferSize());
+  VERIFY_IS_TRUE(0 == memcmp(pUncached->GetBufferPointer(),
+                             pNotTaken->GetBufferPointer(),
+                             pUncached->GetBufferSize()));
+}
+
+// Source store that keeps sources in memory, keyed by digest.
+class TestSourceStore : public IDxcSourceStore {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  dxc::DxcDllSupport &m_dllSupport;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestSourceStore(dxc::DxcDllSupport &dllSupport)
+      : m_dwRef(0), m_dllSupport(dllSupport) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcSourceStore, IDxcIncludeHandler>(
+        this, iid, ppvObject);
+  }
+
+  std::map<std::wstring, std::string> Sources;
+  UINT32 LoadCount = 0;
+
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    *ppIncludeSource = nullptr;
+    auto it = Sources.find(pFilename);
+    if (it == Sources.end())
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    ++LoadCount;
+    MultiByteStringToBlob(m_dllSupport, it->second, CP_UTF8, ppIncludeSource);
+    return S_OK;
+  }
+  HRESULT STDMETHODCALLTYPE AddSource(IDxcBlob *pSource) override {
+    std::string text((const char *)pSource->GetBufferPointer(),
+                     pSource->GetBufferSize());
+    CA2W digest(hlsl::ComputeSourceDigest(text).c_str(), CP_UTF8);
+    Sources[digest.m_psz] = text;
+    return S_OK;
+  }
+};
+
+TEST_F(CompilerTest, CompileWhenSourceStoreSetThenIncludesAreStored) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler2> pCompiler2;
+  CComPtr<IDxcSourceStoreSupport> pStoreSupport;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pPdbBlob;
+  WCHAR *pDebugName = nullptr;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler2));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pStoreSupport));
+  CComPtr<TestSourceStore> pStore = new TestSourceStore(m_dllSupport);
+  VERIFY_SUCCEEDED(pStoreSupport->SetSourceStore(pStore));
+
+  const char *pHeader = "float4 Scale(float4 v) { return v * 2; }\r\n";
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  return Scale(pos);\r\n"
+    "}", &pSource);
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(pHeader);
+  LPCWSTR args[] = { L"/Zi" };
+  VERIFY_SUCCEEDED(pCompiler2->CompileWithDebug(pSource, L"source.hlsl",
+    L"main", L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult,
+    &pDebugName, &pPdbBlob));
+  VerifyOperationSucceeded(pResult);
+
+  // Only the include is stored; the main file stays embedded.
+  CA2W digest(hlsl::ComputeSourceDigest(pHeader).c_str(), CP_UTF8);
+  VERIFY_ARE_EQUAL(1u, (unsigned)pStore->Sources.size());
+  VERIFY_ARE_EQUAL(1u, (unsigned)pStore->Sources.count(digest.m_psz));
+
+#ifdef _WIN32 // - exclude dia stuff
+  // DIA reads the include back through its store. Without one, the include
+  // has no content, and only the main file can be read.
+  auto getFileContent = [&](IDxcSourceStore *pDiaStore) {
+    CComPtr<IDxcLibrary> pLib;
+    CComPtr<IStream> pPdbStream;
+    CComPtr<IDiaDataSource> pDiaSource;
+    CComPtr<IDxcSourceStoreSupport> pDiaStoreSupport;
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLib));
+    VERIFY_SUCCEEDED(pLib->CreateStreamFromBlobReadOnly(pPdbBlob, &pPdbStream));
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcDiaDataSource, &pDiaSource));
+    VERIFY_SUCCEEDED(pDiaSource.QueryInterface(&pDiaStoreSupport));
+    VERIFY_SUCCEEDED(pDiaStoreSupport->SetSourceStore(pDiaStore));
+    VERIFY_SUCCEEDED(pDiaSource->loadDataFromIStream(pPdbStream));
+    return GetDebugFileContent(pDiaSource);
+  };
+  std::wstring withStore = getFileContent(pStore);
+  VERIFY_IS_NOT_NULL(wcsstr(withStore.c_str(), L"float4 Scale(float4 v)"));
+  VERIFY_IS_NOT_NULL(wcsstr(withStore.c_str(), L"return Scale(pos);"));
+  VERIFY_IS_GREATER_THAN(pStore->LoadCount, 0u);
+  std::wstring withoutStore = getFileContent(nullptr);
+  VERIFY_IS_NULL(wcsstr(withoutStore.c_str(), L"float4 Scale(float4 v)"));
+  VERIFY_IS_NOT_NULL(wcsstr(withoutStore.c_str(), L"return Scale(pos);"));
+#endif // _WIN32 - exclude dia stuff
+}
+
+TEST_F(CompilerTest, CompileWhenSourceStoreDirectoryMissingThenCreated) {
+  ::llvm::sys::fs::MSFileSystem *msfPtr;
+  VERIFY_SUCCEEDED(CreateMSFileSystemForDisk(&msfPtr));
+  std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  IFTLLVM(pts.error_code());
+
+  // The store goes in a directory below a new, empty one.
+  llvm::SmallString<128> root;
+  VERIFY_IS_FALSE(
+      (bool)llvm::sys::fs::createUniqueDirectory("dxc-source-store", root));
+  llvm::SmallString<128> storeDir(root);
+  llvm::sys::path::append(storeDir, "store");
+  CA2W storeDirW(storeDir.c_str(), CP_UTF8);
+
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  const char *pHeader = "float4 Scale(float4 v) { return v * 2; }\r\n";
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+    "  return Scale(pos);\r\n"
+    "}", &pSource);
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(pHeader);
+  LPCWSTR args[] = { L"/Zi", L"-Qsource_store", storeDirW.m_psz };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+
+  // The compile created the directory and stored the include in it.
+  CComPtr<IDxcSourceStoreSupport> pStoreSupport;
+  CComPtr<IDxcSourceStore> pStore;
+  CComPtr<IDxcBlob> pStored;
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pStoreSupport));
+  VERIFY_SUCCEEDED(
+      pStoreSupport->CreateDirectorySourceStore(storeDirW, &pStore));
+  std::string digest = hlsl::ComputeSourceDigest(pHeader);
+  CA2W digestW(digest.c_str(), CP_UTF8);
+  VERIFY_SUCCEEDED(pStore->LoadSource(digestW, &pStored));
+  VERIFY_ARE_EQUAL(std::string(pHeader),
+                   std::string((const char *)pStored->GetBufferPointer(),
+                               pStored->GetBufferSize()));
+
+  llvm::SmallString<128> storedFile(storeDir);
+  llvm::sys::path::append(storedFile, digest);
+  llvm::sys::fs::remove(storedFile.str());
+  llvm::sys::fs::remove(storeDir.str());
+  llvm::sys::fs::remove(root.str());
+}
+
+TEST_F(CompilerTest, BridgeCompileWhenCachedThenResultsAreCopies) {
+#ifdef _WIN32 // - the D3DCompile bridge is only built on Windows
+  // Read when the bridge first compiles.
+  SetEnvironmentVariableW(L"D3DCOMPILER_DXC_BRIDGE_CACHE_MB", L"1");
+  HMODULE hBridge = LoadLibraryW(L"d3dcompiler_dxc_bridge.dll");
+  SetEnvironmentVariableW(L"D3DCOMPILER_DXC_BRIDGE_CACHE_MB", nullptr);
+  if (hBridge == NULL) {
+    WEX::Logging::Log::Comment(L"d3dcompiler_dxc_bridge.dll not found - skipping test");
+    return;
+  }
+  // ID3DBlob and IDxcBlob have the same layout.
+  typedef HRESULT(WINAPI * BridgeCompileFn)(
+      LPCVOID, SIZE_T, LPCSTR, const void *, void *, LPCSTR, LPCSTR, UINT,
+      UINT, IDxcBlob **, IDxcBlob **);
+  BridgeCompileFn pCompile =
+      (BridgeCompileFn)GetProcAddress(hBridge, "D3DCompile");
+  VERIFY_IS_NOT_NULL(pCompile);
+
+  const char Source[] = "float4 main() : SV_Target { return 1; }";
+  auto compile = [&](IDxcBlob **ppCode) {
+    VERIFY_SUCCEEDED(pCompile(Source, sizeof(Source) - 1, "source.hlsl",
+                              nullptr, nullptr, "main", "ps_6_0", 0, 0,
+                              ppCode, nullptr));
+  };
+  // The first compile stores its result, the second is served from the
+  // cache. Each caller may overwrite its blob without changing the other's
+  // or what the cache returns next.
+  CComPtr<IDxcBlob> pMiss, pHit, pAgain;
+  compile(&pMiss);
+  std::vector<char> expected((char *)pMiss->GetBufferPointer(),
+                             (char *)pMiss->GetBufferPointer() +
+                                 pMiss->GetBufferSize());
+  memset(pMiss->GetBufferPointer(), 0xcc, pMiss->GetBufferSize());
+  compile(&pHit);
+  VERIFY_ARE_EQUAL(expected.size(), pHit->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(expected.data(), pHit->GetBufferPointer(),
+                             expected.size()));
+  memset(pHit->GetBufferPointer(), 0xdd, pHit->GetBufferSize());
+  compile(&pAgain);
+  VERIFY_ARE_EQUAL(0, memcmp(expected.data(), pAgain->GetBufferPointer(),
+                             expected.size()));
+  pMiss.Release();
+  pHit.Release();
+  pAgain.Release();
+  FreeLibrary(hBridge);
+#endif // _WIN32 - the D3DCompile bridge is only built on Windows
+}
+
+TEST_F(CompilerTest, DisassembleWhenCacheStoreSetThenSecondCallHits) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler3> pCompiler3;
+  CComPtr<IDxcCompileCache> pCache;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcOperationResult> pCompileResult;
+  CComPtr<IDxcBlob> pProgram;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 1; }", &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", nullptr, 0, nullptr, 0, nullptr, &pCompileResult));
+  VERIFY_SUCCEEDED(pCompileResult->GetResult(&pProgram));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler3));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCache));
+  CComPtr<TestCacheStore> pStore = new TestCacheStore();
+  VERIFY_SUCCEEDED(pCache->SetStore(pStore));
+
+  DxcBuffer Object = { pProgram->GetBufferPointer(), pProgram->GetBufferSize(), 0 };
+  std::string Text[2];
+  for (std::string &T : Text) {
+    CComPtr<IDxcResult> pResult;
+    CComPtr<IDxcBlobUtf8> pDisassembly;
+    VERIFY_SUCCEEDED(pCompiler3->Disassemble(&Object, IID_PPV_ARGS(&pResult)));
+    VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_DISASSEMBLY,
+                                        IID_PPV_ARGS(&pDisassembly), nullptr));
+    T = pDisassembly->GetStringPointer();
+  }
+  VERIFY_ARE_EQUAL(1u, pStore->HitCount);
+  VERIFY_ARE_EQUAL(Text[0], Text[1]);
+  VERIFY_IS_TRUE(Text[0].find("define void @main()") != std::string::npos);
+}
+
+class TestBatchCallback : public IDxcCompileBatchCallback {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestBatchCallback(UINT32 jobCount) : m_dwRef(0), Results(jobCount) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileBatchCallback>(this, iid, ppvObject);
+  }
+
+  std::vector<CComPtr<IDxcResult>> Results;
+  UINT32 CallCount = 0;
+
+  HRESULT STDMETHODCALLTYPE OnCompileComplete(UINT32 jobIndex,
+                                              IDxcResult *pResult) override {
+    ++CallCount;
+    if (jobIndex >= Results.size() || Results[jobIndex])
+      return E_UNEXPECTED;
+    Results[jobIndex] = pResult;
+    return S_OK;
+  }
+};
+
+TEST_F(CompilerTest, CompileBatchWhenSharedSourceThenAllJobsComplete) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pBatch));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE * SCALE; }", &pSource);
+  DxcBuffer Source = { pSource->GetBufferPointer(), pSource->GetBufferSize(), CP_UTF8 };
+
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define SCALE 2");
+
+  LPCWSTR Defines[] = { L"VALUE=1", L"VALUE=2", L"VALUE=3", L"VALUE=4" };
+  const UINT32 JobCount = _countof(Defines);
+  std::vector<std::vector<LPCWSTR>> Args(JobCount);
+  std::vector<DxcCompileJob> Jobs(JobCount);
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    Args[i] = { L"-E", L"main", L"-T", L"ps_6_0", L"-D", Defines[i] };
+    Jobs[i].pSource = &Source;
+    Jobs[i].pArguments = Args[i].data();
+    Jobs[i].argCount = (UINT32)Args[i].size();
+  }
+
+  CComPtr<TestBatchCallback> pCallback = new TestBatchCallback(JobCount);
+  VERIFY_SUCCEEDED(pBatch->CompileBatch(Jobs.data(), JobCount, pInclude, 2,
+                                        pCallback));
+  VERIFY_ARE_EQUAL(JobCount, pCallback->CallCount);
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    VERIFY_IS_NOT_NULL(pCallback->Results[i].p);
+    VerifyOperationSucceeded(pCallback->Results[i]);
+  }
+  // Every job shares the include, so the handler sees it only once.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+// Runs every task on the thread that schedules it, or drops it.
+class InlineTaskExecutor : public IDxcTaskExecutor {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  InlineTaskExecutor(bool bDrop) : m_dwRef(0), Drop(bDrop) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcTaskExecutor>(this, iid, ppvObject);
+  }
+
+  bool Drop;
+  std::atomic<UINT32> ScheduleCount{0};
+
+  HRESULT STDMETHODCALLTYPE Schedule(IDxcTask *pTask) override {
+    ++ScheduleCount;
+    if (!Drop)
+      pTask->Run();
+    return S_OK;
+  }
+};
+
+TEST_F(CompilerTest, CompileBatchWhenTaskExecutorSetThenRunsOnExecutor) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerBatch> pBatch;
+  CComPtr<IDxcUtils> pUtils;
+  CComPtr<IDxcTaskScheduling> pScheduling;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pBatch));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcUtils, &pUtils));
+  VERIFY_SUCCEEDED(pUtils.QueryInterface(&pScheduling));
+
+  const char Source[] = "float4 main() : SV_Target { return VALUE; }";
+  DxcBuffer Buffer = { Source, sizeof(Source) - 1, DXC_CP_UTF8 };
+  LPCWSTR Defines[] = { L"VALUE=1", L"VALUE=2", L"VALUE=3", L"VALUE=4" };
+  const UINT32 JobCount = _countof(Defines);
+  std::vector<std::vector<LPCWSTR>> Args(JobCount);
+  std::vector<DxcCompileJob> Jobs(JobCount);
+  for (UINT32 i = 0; i < JobCount; ++i) {
+    Args[i] = { L"-T", L"ps_6_0", L"-D", Defines[i] };
+    Jobs[i].pSource = &Buffer;
+    Jobs[i].pArguments = Args[i].data();
+    Jobs[i].argCount = (UINT32)Args[i].size();
+  }
+  auto compileBatch = [&]() {
+    CComPtr<TestBatchCallback> pCallback = new TestBatchCallback(JobCount);
+    VERIFY_SUCCEEDED(pBatch->CompileBatch(Jobs.data(), JobCount, nullptr, 2,
+                                          pCallback));
+    VERIFY_ARE_EQUAL(JobCount, pCallback->CallCount);
+    for (UINT32 i = 0; i < JobCount; ++i)
+      VerifyOperationSucceeded(pCallback->Results[i]);
+  };
+
+  // Tasks run by the host, and tasks the host drops, which the waiting
+  // thread runs itself.
+  for (bool bDrop : { false, true }) {
+    CComPtr<InlineTaskExecutor> pExecutor = new InlineTaskExecutor(bDrop);
+    VERIFY_SUCCEEDED(pScheduling->SetTaskExecutor(pExecutor));
+    compileBatch();
+    VERIFY_SUCCEEDED(pScheduling->SetTaskExecutor(nullptr));
+    VERIFY_IS_TRUE(pExecutor->ScheduleCount > 0);
+  }
+
+  // A thread limit still lets every job complete on DXC's own threads.
+  VERIFY_SUCCEEDED(pScheduling->SetMaxThreadCount(1));
+  compileBatch();
+  VERIFY_SUCCEEDED(pScheduling->SetMaxThreadCount(0));
+}
+
+TEST_F(CompilerTest, ThreadPoolWhenNestedThenHonoursCreatorLimit) {
+  // Pools created by the tasks of a pool share the threads its creator may
+  // use, so nesting never starts more threads than the creator's limit.
+  for (unsigned limit : { 1u, 2u, 4u }) {
+    hlsl::DxcThreadCountLimit Limit(limit);
+    hlsl::DxcThreadPool Outer;
+    VERIFY_IS_TRUE(Outer.GetThreadCount() <= limit);
+    std::mutex Lock;
+    std::vector<unsigned> innerCounts, nestedCounts;
+    for (unsigned i = 0; i < 8; ++i) {
+      Outer.Async([&]() {
+        hlsl::DxcThreadPool Inner;
+        unsigned nestedCount = 0;
+        Inner.Async([&]() {
+          hlsl::DxcThreadPool Nested;
+          nestedCount = Nested.GetThreadCount();
+        });
+        VERIFY_SUCCEEDED(Inner.Wait());
+        std::unique_lock<std::mutex> L(Lock);
+        innerCounts.push_back(Inner.GetThreadCount());
+        nestedCounts.push_back(nestedCount);
+      });
+    }
+    VERIFY_SUCCEEDED(Outer.Wait());
+    VERIFY_ARE_EQUAL(8u, innerCounts.size());
+    for (size_t i = 0; i < innerCounts.size(); ++i) {
+      VERIFY_IS_TRUE(Outer.GetThreadCount() * innerCounts[i] <= limit);
+      VERIFY_IS_TRUE(Outer.GetThreadCount() * innerCounts[i] *
+                     nestedCounts[i] <= limit);
+    }
+  }
+}
+
+TEST_F(CompilerTest, CompileEntryPointsWhenManyEntriesThenResultPerEntry) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerMultiEntry> pMultiEntry;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pMultiEntry));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 VSMain(float4 pos : POSITION) : SV_Position { return pos * SCALE; }\r\n"
+    "float4 PSMain() : SV_Target { return SCALE; }\r\n"
+    "float4 PSOther() : SV_Target { return SCALE * 2; }", &pSource);
+  DxcBuffer Source = { pSource->GetBufferPointer(), pSource->GetBufferSize(), CP_UTF8 };
+
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define SCALE 2");
+
+  LPCWSTR Args[] = { L"-O3" };
+  DxcEntryPoint EntryPoints[] = {
+    { L"VSMain", L"vs_6_0" },
+    { L"PSMain", L"ps_6_0" },
+    { L"PSOther", L"ps_6_0" },
+    { L"Missing", L"ps_6_0" },
+  };
+  const UINT32 EntryCount = _countof(EntryPoints);
+  IDxcResult *pResults[EntryCount];
+  VERIFY_SUCCEEDED(pMultiEntry->CompileEntryPoints(
+    &Source, Args, _countof(Args), EntryPoints, EntryCount, pInclude, 2,
+    pResults));
+  std::vector<CComPtr<IDxcResult>> Results(EntryCount);
+  for (UINT32 i = 0; i < EntryCount; ++i)
+    Results[i].Attach(pResults[i]);
+
+  for (UINT32 i = 0; i < EntryCount - 1; ++i) {
+    VERIFY_IS_NOT_NULL(Results[i].p);
+    VerifyOperationSucceeded(Results[i]);
+  }
+  HRESULT Status;
+  VERIFY_SUCCEEDED(Results[EntryCount - 1]->GetStatus(&Status));
+  VERIFY_FAILED(Status);
+  // Every entry point shares the include, so the handler sees it only once.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompilePermutationsWhenDefinesDifferThenResultPerPermutation) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerPermutations> pPermutations;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pPermutations));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target {\r\n"
+    "#if USE_FOG\r\n"
+    "  return SCALE * FOG_DENSITY;\r\n"
+    "#else\r\n"
+    "  return SCALE;\r\n"
+    "#endif\r\n"
+    "}", &pSource);
+  DxcBuffer Source = { pSource->GetBufferPointer(), pSource->GetBufferSize(), CP_UTF8 };
+
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define SCALE 2");
+
+  LPCWSTR Args[] = { L"-E", L"main", L"-T", L"ps_6_0", L"-D", L"USE_FOG=0" };
+  DxcDefine FogDefines[] = { { L"USE_FOG", L"1" }, { L"FOG_DENSITY", L"0.5" } };
+  DxcDefine BrokenDefines[] = { { L"USE_FOG", nullptr } };
+  DxcPermutation Permutations[] = {
+    { nullptr, 0 },
+    { FogDefines, _countof(FogDefines) },
+    { BrokenDefines, _countof(BrokenDefines) },
+  };
+  const UINT32 PermutationCount = _countof(Permutations);
+  IDxcResult *pResults[PermutationCount];
+  VERIFY_SUCCEEDED(pPermutations->CompilePermutations(
+    &Source, Args, _countof(Args), Permutations, PermutationCount, pInclude, 2,
+    pResults));
+  std::vector<CComPtr<IDxcResult>> Results(PermutationCount);
+  for (UINT32 i = 0; i < PermutationCount; ++i)
+    Results[i].Attach(pResults[i]);
+
+  VerifyOperationSucceeded(Results[0]);
+  VerifyOperationSucceeded(Results[1]);
+  // USE_FOG without FOG_DENSITY leaves an undeclared identifier.
+  HRESULT Status;
+  VERIFY_SUCCEEDED(Results[2]->GetStatus(&Status));
+  VERIFY_FAILED(Status);
+  // Every permutation shares the include, so the handler sees it only once.
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenIncludeCacheSharedThenHandlerCalledOnce) {
+  CComPtr<IDxcCompiler> pFirst, pSecond;
+  CComPtr<IDxcCompilerIncludeCache> pFirstCache, pSecondCache;
+  CComPtr<IDxcIncludeCache> pCache;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pFirst));
+  VERIFY_SUCCEEDED(CreateCompiler(&pSecond));
+  VERIFY_SUCCEEDED(pFirst.QueryInterface(&pFirstCache));
+  VERIFY_SUCCEEDED(pSecond.QueryInterface(&pSecondCache));
+  VERIFY_SUCCEEDED(pFirstCache->CreateIncludeCache(&pCache));
+  VERIFY_SUCCEEDED(pFirstCache->SetIncludeCache(pCache));
+  VERIFY_SUCCEEDED(pSecondCache->SetIncludeCache(pCache));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define VALUE 1");
+  pInclude->CallResults.emplace_back("#define VALUE 2");
+  auto compile = [&](IDxcCompiler *pCompiler) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", nullptr, 0, nullptr, 0, pInclude, &pResult));
+    VerifyOperationSucceeded(pResult);
+  };
+
+  compile(pFirst);
+  compile(pSecond);
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+
+  VERIFY_SUCCEEDED(pCache->Invalidate(L"./helper.h"));
+  compile(pSecond);
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;./helper.h;",
+                        pInclude->GetAllFileNames().c_str());
+}
+
+TEST_F(CompilerTest, CompileWhenPrecompiledHeaderThenHeaderReplaced) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pHeader, pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#define SCALE 2\r\n"
+    "float Scale(float x) { return x * SCALE; }", &pHeader);
+  CreateBlobFromText(
+    "#include \"common.hlsli\"\r\n"
+    "float4 main() : SV_Target { return Scale(SCALE); }", &pSource);
+
+  // -Yc keeps the macro definitions in the preprocessed header.
+  LPCWSTR CreateArgs[] = { L"-Yc", L"-Fp", L"common.pch" };
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pHeader, L"common.hlsli", L"main",
+    L"ps_6_0", CreateArgs, _countof(CreateArgs), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pPch;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pPch));
+  std::string pch((const char *)pPch->GetBufferPointer(), pPch->GetBufferSize());
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, pch.find("#define SCALE 2"));
+
+  // -Yu loads the -Fp file in place of the header.
+  CComPtr<TestIncludeHandler> pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back(pch.c_str());
+  LPCWSTR UseArgs[] = { L"-Yu", L"common.hlsli", L"-Fp", L"common.pch" };
+  pResult.Release();
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", UseArgs, _countof(UseArgs), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_ARE_EQUAL_WSTR(L"./common.pch;", pInclude->GetAllFileNames().c_str());
+}
+
 static const char EmptyCompute[] = "[numthreads(8,8,1)] void main() { }";
 
 TEST_F(CompilerTest, CompileWhenODumpThenPassConfig) {
@@ -1877,6 +2809,486 @@ TEST_F(CompilerTest, CompileWhenODumpThenPassConfig) {
   VERIFY_ARE_NOT_EQUAL(wstring::npos, passes.find(L"inline"));
 }
 
+TEST_F(CompilerTest, CompileWhenTimeReportThenPhasesAndPassesReturned) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  LPCWSTR Args[] = { L"-ftime-report" };
+
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcResult> pResultV2;
+  VERIFY_SUCCEEDED(pResult->QueryInterface(&pResultV2));
+  VERIFY_IS_TRUE(pResultV2->HasOutput(DXC_OUT_TIME_REPORT));
+  CComPtr<IDxcBlobEncoding> pReport;
+  VERIFY_SUCCEEDED(pResultV2->GetOutput(DXC_OUT_TIME_REPORT, IID_PPV_ARGS(&pReport), nullptr));
+  wstring report = BlobToUtf16(pReport);
+  VERIFY_ARE_NOT_EQUAL(wstring::npos, report.find(L"\"name\": \"frontend\""));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos, report.find(L"\"name\": \"validation\""));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos, report.find(L"\"name\": \"container\""));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos, report.find(L"\"arg\": \"dxilgen\""));
+  // Only the validator built into the compiler reports its rule groups.
+  if (m_ver.m_InternalValidator) {
+    VERIFY_ARE_NOT_EQUAL(wstring::npos,
+                         report.find(L"\"name\": \"functions\", \"kind\": \"rules\""));
+    VERIFY_ARE_NOT_EQUAL(wstring::npos,
+                         report.find(L"\"name\": \"container parts\", \"kind\": \"rules\""));
+  }
+
+  // Without the flag, no report is produced.
+  pResult.Release();
+  pResultV2.Release();
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", nullptr, 0, nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->QueryInterface(&pResultV2));
+  VERIFY_IS_FALSE(pResultV2->HasOutput(DXC_OUT_TIME_REPORT));
+}
+
+TEST_F(CompilerTest, CompileWhenArenaThenSameOutputs) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "float4 main(float4 a : A) : SV_Target { return a * 2; }", &pSource);
+
+  auto compile = [&](LPCWSTR *pArgs, UINT32 argCount, IDxcBlob **ppObject,
+                     std::wstring &disassembly) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", pArgs, argCount, nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppObject));
+    CComPtr<IDxcBlobEncoding> pText;
+    VERIFY_SUCCEEDED(pCompiler->Disassemble(*ppObject, &pText));
+    disassembly = BlobToUtf16(pText);
+  };
+
+  LPCWSTR ArenaArgs[] = { L"-fcompile-arena" };
+  CComPtr<IDxcBlob> pDefault, pArena;
+  std::wstring defaultText, arenaText;
+  compile(nullptr, 0, &pDefault, defaultText);
+  compile(ArenaArgs, _countof(ArenaArgs), &pArena, arenaText);
+  // The outputs outlive the arena, so reading them here checks that they
+  // were copied out before it was released.
+  VERIFY_ARE_EQUAL_WSTR(defaultText.c_str(), arenaText.c_str());
+  VERIFY_ARE_EQUAL(pDefault->GetBufferSize(), pArena->GetBufferSize());
+}
+
+TEST_F(CompilerTest, CompileWhenContextPoolThenSameOutputs) {
+  CComPtr<IDxcCompiler> pFresh, pPooled;
+  CComPtr<IDxcCompilerContextPool> pPool;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pFresh));
+  VERIFY_SUCCEEDED(CreateCompiler(&pPooled));
+  VERIFY_SUCCEEDED(pPooled.QueryInterface(&pPool));
+  VERIFY_SUCCEEDED(pPool->SetContextPoolSize(1));
+  // Named struct and resource types are what a reused context could
+  // rename.
+  CreateBlobFromText(
+    "struct S { float4 a; uint b; };\n"
+    "StructuredBuffer<S> buf;\n"
+    "Texture2D<float4> tex;\n"
+    "float4 main(uint i : I) : SV_Target {\n"
+    "  return buf[i].a * buf[i].b + tex.Load(int3(i, 0, 0));\n"
+    "}\n", &pSource);
+
+  auto compile = [&](IDxcCompiler *pCompiler, LPCWSTR *pArgs,
+                     UINT32 argCount, IDxcBlob **ppObject) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", pArgs, argCount, nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppObject));
+  };
+  auto verifySame = [](IDxcBlob *pExpected, IDxcBlob *pActual) {
+    VERIFY_ARE_EQUAL(pExpected->GetBufferSize(), pActual->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pExpected->GetBufferPointer(),
+                               pActual->GetBufferPointer(),
+                               pExpected->GetBufferSize()));
+  };
+
+  CComPtr<IDxcBlob> pExpected;
+  compile(pFresh, nullptr, 0, &pExpected);
+  // The second and third compiles reuse the context of the one before.
+  for (int i = 0; i < 3; ++i) {
+    CComPtr<IDxcBlob> pObject;
+    compile(pPooled, nullptr, 0, &pObject);
+    verifySame(pExpected, pObject);
+  }
+  // Compiles with their own malloc bypass the pool and match as well.
+  LPCWSTR ArenaArgs[] = { L"-fcompile-arena" };
+  LPCWSTR LimitArgs[] = { L"-memory-limit", L"1024" };
+  CComPtr<IDxcBlob> pArena, pLimit, pAfter;
+  compile(pPooled, ArenaArgs, _countof(ArenaArgs), &pArena);
+  verifySame(pExpected, pArena);
+  compile(pPooled, LimitArgs, _countof(LimitArgs), &pLimit);
+  verifySame(pExpected, pLimit);
+  compile(pPooled, nullptr, 0, &pAfter);
+  verifySame(pExpected, pAfter);
+}
+
+TEST_F(CompilerTest, CompileWhenDeadlineExceededThenDistinctStatus) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  // Unrolling this takes far longer than a millisecond.
+  CreateBlobFromText(
+    "float4 main(float4 a : A) : SV_Target {\n"
+    "  float4 r = 0;\n"
+    "  [unroll] for (int i = 0; i < 1000; ++i) r += sin(a * i);\n"
+    "  return r;\n"
+    "}", &pSource);
+
+  auto compileStatus = [&](LPCWSTR *pArgs, UINT32 argCount) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"ps_6_0", pArgs, argCount, nullptr, 0, nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    return status;
+  };
+
+  LPCWSTR ShortArgs[] = { L"-compile-deadline", L"1" };
+  VERIFY_ARE_EQUAL(DXC_E_COMPILE_DEADLINE_EXCEEDED,
+                   compileStatus(ShortArgs, _countof(ShortArgs)));
+  // The -Od retry still has to unroll the loop, so it runs out of time too.
+  LPCWSTR FallbackArgs[] = { L"-compile-deadline", L"1",
+                             L"-compile-deadline-fallback" };
+  VERIFY_ARE_EQUAL(DXC_E_COMPILE_DEADLINE_EXCEEDED,
+                   compileStatus(FallbackArgs, _countof(FallbackArgs)));
+  LPCWSTR LongArgs[] = { L"-compile-deadline", L"600000" };
+  VERIFY_SUCCEEDED(compileStatus(LongArgs, _countof(LongArgs)));
+}
+
+TEST_F(CompilerTest, CompileWhenCancelledThenDistinctStatus) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerCancellation> pCancellation;
+  CComPtr<IDxcCancellationToken> pToken;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCancellation));
+  VERIFY_SUCCEEDED(pCancellation->CreateCancellationToken(&pToken));
+  VERIFY_IS_FALSE(pToken->IsCancelled());
+
+  const char Source[] =
+    "float4 main(float4 a : A) : SV_Target { return a * 2; }";
+  DxcBuffer Buffer = { Source, sizeof(Source) - 1, DXC_CP_UTF8 };
+  LPCWSTR Args[] = { L"-T", L"ps_6_0" };
+  auto compileStatus = [&]() {
+    CComPtr<IDxcResult> pResult;
+    VERIFY_SUCCEEDED(pCancellation->CompileCancellable(
+      &Buffer, Args, _countof(Args), nullptr, pToken, IID_PPV_ARGS(&pResult)));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    return status;
+  };
+
+  VERIFY_SUCCEEDED(compileStatus());
+  VERIFY_SUCCEEDED(pToken->Cancel());
+  VERIFY_IS_TRUE(pToken->IsCancelled());
+  VERIFY_ARE_EQUAL(DXC_E_COMPILE_CANCELLED, compileStatus());
+}
+
+class TestTaskExecutor : public IDxcTaskExecutor {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestTaskExecutor() : m_dwRef(0) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcTaskExecutor>(this, iid, ppvObject);
+  }
+
+  std::vector<CComPtr<IDxcTask>> Tasks;
+
+  HRESULT STDMETHODCALLTYPE Schedule(IDxcTask *pTask) override {
+    Tasks.emplace_back(pTask);
+    return S_OK;
+  }
+};
+
+class TestAsyncCompileCallback : public IDxcAsyncCompileCallback {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  TestAsyncCompileCallback() : m_dwRef(0) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcAsyncCompileCallback>(this, iid, ppvObject);
+  }
+
+  UINT32 CallCount = 0;
+
+  void STDMETHODCALLTYPE OnCompileComplete(IDxcAsyncResult *pAsync) override {
+    if (pAsync->IsComplete())
+      ++CallCount;
+  }
+};
+
+TEST_F(CompilerTest, CompileAsyncWhenExecutorGivenThenRunsOnExecutor) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerAsync> pCompilerAsync;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompilerAsync));
+
+  const char Source[] =
+    "float4 main(float4 a : A) : SV_Target { return a * 2; }";
+  DxcBuffer Buffer = { Source, sizeof(Source) - 1, DXC_CP_UTF8 };
+  LPCWSTR Args[] = { L"-T", L"ps_6_0" };
+  auto asyncStatus = [&](IDxcAsyncResult *pAsync) {
+    CComPtr<IDxcResult> pResult;
+    VERIFY_SUCCEEDED(pAsync->GetResult(IID_PPV_ARGS(&pResult)));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    return status;
+  };
+
+  // Nothing runs until the host runs the task.
+  CComPtr<TestTaskExecutor> pExecutor = new TestTaskExecutor();
+  CComPtr<TestAsyncCompileCallback> pCallback = new TestAsyncCompileCallback();
+  CComPtr<IDxcAsyncResult> pAsync;
+  VERIFY_SUCCEEDED(pCompilerAsync->CompileAsync(
+    &Buffer, Args, _countof(Args), nullptr, pExecutor, &pAsync));
+  VERIFY_ARE_EQUAL(1u, (unsigned)pExecutor->Tasks.size());
+  VERIFY_IS_FALSE(pAsync->IsComplete());
+  VERIFY_ARE_EQUAL(S_FALSE, pAsync->Wait(0));
+  VERIFY_SUCCEEDED(pAsync->AddCompletionCallback(pCallback));
+  pExecutor->Tasks[0]->Run();
+  VERIFY_IS_TRUE(pAsync->IsComplete());
+  VERIFY_ARE_EQUAL(1u, pCallback->CallCount);
+  VERIFY_SUCCEEDED(asyncStatus(pAsync));
+
+  // Callbacks added after completion are called right away.
+  VERIFY_SUCCEEDED(pAsync->AddCompletionCallback(pCallback));
+  VERIFY_ARE_EQUAL(2u, pCallback->CallCount);
+
+  // A task the executor drops cancels its compile.
+  pAsync.Release();
+  pExecutor->Tasks.clear();
+  VERIFY_SUCCEEDED(pCompilerAsync->CompileAsync(
+    &Buffer, Args, _countof(Args), nullptr, pExecutor, &pAsync));
+  pExecutor->Tasks.clear();
+  VERIFY_IS_TRUE(pAsync->IsComplete());
+  VERIFY_ARE_EQUAL(DXC_E_COMPILE_CANCELLED, asyncStatus(pAsync));
+
+  // Without an executor the compile runs on the compiler's own threads.
+  pAsync.Release();
+  VERIFY_SUCCEEDED(pCompilerAsync->CompileAsync(
+    &Buffer, Args, _countof(Args), nullptr, nullptr, &pAsync));
+  VERIFY_ARE_EQUAL(S_OK, pAsync->Wait(0xFFFFFFFF));
+  VERIFY_SUCCEEDED(asyncStatus(pAsync));
+}
+
+// Drops the last reference to the compiler when the compile completes.
+class ReleasingAsyncCompileCallback : public IDxcAsyncCompileCallback {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  ReleasingAsyncCompileCallback() : m_dwRef(0) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcAsyncCompileCallback>(this, iid, ppvObject);
+  }
+
+  CComPtr<IUnknown> pCompiler;
+
+  void STDMETHODCALLTYPE OnCompileComplete(IDxcAsyncResult *) override {
+    pCompiler.Release();
+  }
+};
+
+TEST_F(CompilerTest, CompileAsyncWhenCallbackReleasesCompilerThenCompilerFreed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompilerAsync> pCompilerAsync;
+  CComPtr<IDxcCompileCache> pCache;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompilerAsync));
+  // The compiler holds the store until it is destroyed, so the store's
+  // reference count tells when that has happened.
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCache));
+  CComPtr<TestCacheStore> pStore = new TestCacheStore();
+  VERIFY_SUCCEEDED(pCache->SetStore(pStore));
+  pCache.Release();
+
+  const char Source[] =
+    "float4 main(float4 a : A) : SV_Target { return a * 2; }";
+  DxcBuffer Buffer = { Source, sizeof(Source) - 1, DXC_CP_UTF8 };
+  LPCWSTR Args[] = { L"-T", L"ps_6_0" };
+  CComPtr<ReleasingAsyncCompileCallback> pCallback =
+    new ReleasingAsyncCompileCallback();
+  pCallback->pCompiler = pCompiler;
+  CComPtr<IDxcAsyncResult> pAsync;
+  VERIFY_SUCCEEDED(pCompilerAsync->CompileAsync(
+    &Buffer, Args, _countof(Args), nullptr, nullptr, &pAsync));
+  VERIFY_SUCCEEDED(pAsync->AddCompletionCallback(pCallback));
+  pCompilerAsync.Release();
+  pCompiler.Release();
+
+  // The compiler goes away on a thread of its own pool; that must neither
+  // deadlock nor free the compiler before the compile has returned.
+  VERIFY_ARE_EQUAL(S_OK, pAsync->Wait(0xFFFFFFFF));
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pAsync->GetResult(IID_PPV_ARGS(&pResult)));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  ULONG storeRefs = 0;
+  for (int i = 0; i < 1000; ++i) {
+    pStore.p->AddRef();
+    storeRefs = pStore.p->Release();
+    if (storeRefs == 1)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  VERIFY_ARE_EQUAL(1u, storeRefs);
+}
+
+TEST_F(CompilerTest, CompileWhenMemoryLimitExceededThenDistinctStatus) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  auto compile = [&](LPCWSTR *pArgs, UINT32 argCount,
+                     IDxcResult **ppResult) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+      L"cs_6_0", pArgs, argCount, nullptr, 0, nullptr, &pResult));
+    VERIFY_SUCCEEDED(pResult->QueryInterface(ppResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    return status;
+  };
+
+  // Setting up the front end alone takes more than a megabyte.
+  LPCWSTR LowArgs[] = { L"-memory-limit", L"1" };
+  CComPtr<IDxcResult> pResult;
+  VERIFY_ARE_EQUAL(DXC_E_COMPILE_MEMORY_LIMIT_EXCEEDED,
+                   compile(LowArgs, _countof(LowArgs), &pResult));
+
+  LPCWSTR HighArgs[] = { L"-memory-limit", L"4096", L"-fmemory-report" };
+  pResult.Release();
+  VERIFY_SUCCEEDED(compile(HighArgs, _countof(HighArgs), &pResult));
+  VERIFY_IS_TRUE(pResult->HasOutput(DXC_OUT_MEMORY_REPORT));
+  CComPtr<IDxcBlobEncoding> pReport;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_MEMORY_REPORT,
+                                      IID_PPV_ARGS(&pReport), nullptr));
+  wstring report = BlobToUtf16(pReport);
+  VERIFY_ARE_NOT_EQUAL(wstring::npos, report.find(L"\"peakBytes\": "));
+  VERIFY_ARE_EQUAL(wstring::npos, report.find(L"\"peakBytes\": 0"));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos,
+                       report.find(L"\"limitBytes\": 4294967296"));
+}
+
+TEST_F(CompilerTest, CompileWhenParallelVerifyThenSameOutputs) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler3> pCompiler3;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler3));
+
+  // Enough functions to take the parallel validation and bitcode paths.
+  std::string Source;
+  for (int i = 0; i < 80; ++i)
+    Source += "export float f" + std::to_string(i) + "(float a) { return a * " +
+              std::to_string(i) + "; }\n";
+  DxcBuffer Buffer = { Source.data(), Source.size(), DXC_CP_UTF8 };
+  LPCWSTR Args[] = { L"-T", L"lib_6_3", L"-parallel-verify" };
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler3->Compile(&Buffer, Args, _countof(Args), nullptr,
+                                       IID_PPV_ARGS(&pResult)));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_IS_TRUE(pResult->HasOutput(DXC_OUT_OBJECT));
+  VERIFY_IS_TRUE(pResult->HasOutput(DXC_OUT_SHADER_HASH));
+}
+
+TEST_F(CompilerTest, CompileWhenArenaAndParallelVerifyThenSameOutputs) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler3> pCompiler3;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler3));
+
+  // The validation workers allocate from the arena at the same time.
+  std::string Source;
+  for (int i = 0; i < 80; ++i)
+    Source += "export float f" + std::to_string(i) + "(float a) { return a * " +
+              std::to_string(i) + "; }\n";
+  DxcBuffer Buffer = { Source.data(), Source.size(), DXC_CP_UTF8 };
+
+  auto compile = [&](LPCWSTR *pArgs, UINT32 argCount, IDxcBlob **ppObject) {
+    CComPtr<IDxcResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler3->Compile(&Buffer, pArgs, argCount, nullptr,
+                                         IID_PPV_ARGS(&pResult)));
+    VerifyOperationSucceeded(pResult);
+    VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(ppObject),
+                                        nullptr));
+  };
+
+  LPCWSTR Args[] = { L"-T", L"lib_6_3", L"-parallel-verify" };
+  LPCWSTR ArenaArgs[] = { L"-T", L"lib_6_3", L"-parallel-verify",
+                          L"-fcompile-arena" };
+  CComPtr<IDxcBlob> pDefault, pArena;
+  compile(Args, _countof(Args), &pDefault);
+  compile(ArenaArgs, _countof(ArenaArgs), &pArena);
+  VERIFY_ARE_EQUAL(pDefault->GetBufferSize(), pArena->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(pDefault->GetBufferPointer(),
+                             pArena->GetBufferPointer(),
+                             pDefault->GetBufferSize()));
+}
+
+#ifdef ENABLE_SPIRV_CODEGEN
+
+TEST_F(CompilerTest, CompileWhenSpirvWithFreThenSpirvReflection) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pOperationResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "[[vk::constant_id(3)]] const int kCount = 4;\n"
+    "[[vk::binding(2, 1)]] Texture2D tex;\n"
+    "SamplerState samp;\n"
+    "float4 main(float2 uv : TEXCOORD0) : SV_Target {\n"
+    "  return tex.Sample(samp, uv) * kCount;\n"
+    "}\n", &pSource);
+
+  LPCWSTR Args[] = { L"-spirv", L"-Fre", L"reflection.json" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pOperationResult));
+  VerifyOperationSucceeded(pOperationResult);
+
+  CComPtr<IDxcResult> pResult;
+  VERIFY_SUCCEEDED(pOperationResult.QueryInterface(&pResult));
+  VERIFY_IS_TRUE(pResult->HasOutput(DXC_OUT_SPIRV_REFLECTION));
+  CComPtr<IDxcBlobEncoding> pReflection;
+  CComPtr<IDxcBlobUtf16> pName;
+  VERIFY_SUCCEEDED(pResult->GetOutput(DXC_OUT_SPIRV_REFLECTION,
+                                      IID_PPV_ARGS(&pReflection), &pName));
+  VERIFY_ARE_EQUAL_WSTR(L"reflection.json", pName->GetStringPointer());
+  wstring reflection = BlobToUtf16(pReflection);
+  VERIFY_ARE_NOT_EQUAL(wstring::npos,
+    reflection.find(L"{\"name\": \"tex\", \"set\": 1, \"binding\": 2, "
+                    L"\"count\": 1}"));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos,
+    reflection.find(L"{\"name\": \"samp\", \"set\": 0, \"binding\": 0, "
+                    L"\"count\": 1}"));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos,
+    reflection.find(L"{\"semantic\": \"TEXCOORD0\", \"location\": 0}"));
+  VERIFY_ARE_NOT_EQUAL(wstring::npos,
+    reflection.find(L"{\"name\": \"kCount\", \"id\": 3}"));
+}
+#endif
+
 TEST_F(CompilerTest, CompileWhenVdThenProducesDxilContainer) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2209,6 +3621,79 @@ TEST_F(CompilerTest, CompileWhenNoMemThenOOM) {
     VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
   }
 }
+
+// Validating a root signature keeps it in a process-wide cache. Running out
+// of memory while verifying it must not leave it cached as invalid, and the
+// cache must not hold memory from the validator's allocator.
+TEST_F(CompilerTest, ValidateWhenNoMemThenRootSignatureNotCachedInvalid) {
+  WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
+  VERIFY_IS_TRUE(m_dllSupport.HasCreateWithMalloc());
+
+  // Each root signature is new to the cache, so that every validation
+  // verifies one.
+  UINT space = 0;
+  auto compileWithNewRootSignature = [&](IDxcBlob **ppProgram) {
+    std::string source =
+        "[RootSignature(\"CBV(b0, space=" + std::to_string(++space) +
+        ")\")]\n[numthreads(1, 1, 1)] void main() {}\n";
+    CComPtr<IDxcCompiler> pCompiler;
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    LPCWSTR args[] = {L"-Vd"};
+    VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+    CreateBlobFromText(source.c_str(), &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"cs_6_0", args, _countof(args),
+                                        nullptr, 0, nullptr, &pResult));
+    HRESULT hrStatus;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&hrStatus));
+    VERIFY_SUCCEEDED(hrStatus);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppProgram));
+  };
+  auto validate = [&](IMalloc *pMalloc, IDxcBlob *pProgram) {
+    CComPtr<IDxcValidator> pValidator;
+    CComPtr<IDxcOperationResult> pResult;
+    HRESULT hr = pMalloc ? m_dllSupport.CreateInstance2(pMalloc, CLSID_DxcValidator, &pValidator)
+                         : m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator);
+    if (SUCCEEDED(hr))
+      hr = pValidator->Validate(pProgram, DxcValidatorFlags_Default, &pResult);
+    if (SUCCEEDED(hr))
+      pResult->GetStatus(&hr);
+    return hr;
+  };
+
+  InstrumentedHeapMalloc InstrMalloc;
+  InstrMalloc.ResetHeap();
+  ULONG initialRefCount = InstrMalloc.GetRefCount();
+  CComPtr<IDxcBlob> pProgram;
+  compileWithNewRootSignature(&pProgram);
+  VERIFY_SUCCEEDED(validate(&InstrMalloc, pProgram));
+  ULONG allocCount = InstrMalloc.GetAllocCount();
+  if (InstrMalloc.GetSize() != 0) {
+    WEX::Logging::Log::Comment(L"Memory leak(s) detected");
+    InstrMalloc.DumpLeaks();
+    VERIFY_IS_TRUE(0 == InstrMalloc.GetSize());
+  }
+  VERIFY_ARE_EQUAL(initialRefCount, InstrMalloc.GetRefCount());
+
+  if (m_ver.SkipOutOfMemoryTest()) return;
+
+  // Fail each allocation in turn; validating the same container again with
+  // enough memory must succeed.
+  for (ULONG i = 0; i < allocCount; ++i) {
+    pProgram.Release();
+    compileWithNewRootSignature(&pProgram);
+    InstrMalloc.ResetCounts();
+    InstrMalloc.ResetHeap();
+    InstrMalloc.SetFailAlloc(i + 1);
+    validate(&InstrMalloc, pProgram);
+    InstrMalloc.SetFailAlloc(0);
+    if (FAILED(validate(nullptr, pProgram))) {
+      WEX::Logging::Log::Comment(FormatToWString(L"Root signature cached as invalid, allocCount = %d", i).data());
+      VERIFY_FAIL();
+    }
+  }
+}
 #endif
 
 TEST_F(CompilerTest, CompileWhenShaderModelMismatchAttributeThenFail) {
@@ -2781,6 +4266,42 @@ TEST_F(CompilerTest, DiaLoadDebugThenOK) {
   CompileTestAndLoadDia(m_dllSupport, nullptr);
 }
 
+TEST_F(CompilerTest, DiaLoadDebugTwiceThenOK) {
+  // The second data source shares the module parsed for the first one.
+  CComPtr<IDxcBlob> pDebugContent;
+  CComPtr<IDxcLibrary> pLib;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLib));
+  CompileAndGetDebugPart(m_dllSupport, EmptyCompute, L"cs_6_0", &pDebugContent);
+
+  CComPtr<IDiaSession> pDiaSessions[2];
+  for (CComPtr<IDiaSession> &pDiaSession : pDiaSessions) {
+    CComPtr<IStream> pStream;
+    CComPtr<IDiaDataSource> pDiaSource;
+    VERIFY_SUCCEEDED(pLib->CreateStreamFromBlobReadOnly(pDebugContent, &pStream));
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcDiaDataSource, &pDiaSource));
+    VERIFY_SUCCEEDED(pDiaSource->loadDataFromIStream(pStream));
+    VERIFY_SUCCEEDED(pDiaSource->openSession(&pDiaSession));
+  }
+
+  // Both sessions see the same symbols, and closing the first leaves the
+  // second usable.
+  CComPtr<IDiaSymbol> pGlobalScopes[2];
+  CComBSTR names[2];
+  for (int i = 0; i < 2; ++i) {
+    VERIFY_SUCCEEDED(pDiaSessions[i]->get_globalScope(&pGlobalScopes[i]));
+    VERIFY_SUCCEEDED(pGlobalScopes[i]->get_name(&names[i]));
+  }
+  VERIFY_IS_TRUE(names[0] == names[1]);
+  pGlobalScopes[0].Release();
+  pDiaSessions[0].Release();
+
+  CComPtr<IDiaEnumTables> pEnumTables;
+  VERIFY_SUCCEEDED(pDiaSessions[1]->getEnumTables(&pEnumTables));
+  LONG count;
+  VERIFY_SUCCEEDED(pEnumTables->get_Count(&count));
+  VERIFY_IS_TRUE(count > 0);
+}
+
 TEST_F(CompilerTest, DiaTableIndexThenOK) {
   CComPtr<IDiaDataSource> pDiaSource;
   CComPtr<IDiaSession> pDiaSession;
@@ -3059,6 +4580,11 @@ TEST_F(CompilerTest, CodeGenRootSigProfile5) {
   CodeGenTest(L"rootSigProfile5.hlsl");
 }
 
+TEST_F(CompilerTest, CodeGenRootSigProfile6) {
+  if (m_ver.SkipDxilVersion(1, 5)) return;
+  CodeGenTest(L"rootSigProfile6.hlsl");
+}
+
 TEST_F(CompilerTest, LibGVStore) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -18,6 +18,31 @@
 #endif
 #include "dxc/Test/HlslTestUtils.h"
 #include "dxc/Support/microcom.h"
+#include <mutex>
+#include <vector>
+
+// Records the results of asynchronous parses.
+class TestParseCallback : public IDxcParseCallback {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::mutex m_lock;
+public:
+  std::vector<HRESULT> Statuses;
+  std::vector<CComPtr<IDxcTranslationUnit>> Results;
+
+  TestParseCallback() : m_dwRef(0) {}
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcParseCallback>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE OnParseComplete(HRESULT status, IDxcTranslationUnit *pTU) override {
+    std::lock_guard<std::mutex> lock(m_lock);
+    Statuses.push_back(status);
+    Results.push_back(pTU);
+    return S_OK;
+  }
+};
 
 
 #ifdef _WIN32
@@ -108,6 +133,7 @@ protected:
 
   TEST_METHOD(InclusionWhenMissingThenError)
   TEST_METHOD(InclusionWhenValidThenAvailable)
+  TEST_METHOD(InclusionWhenSkipIncludedBodiesThenMainBodyParsed)
 
   TEST_METHOD(TUWhenGetFileMissingThenFail)
   TEST_METHOD(TUWhenGetFilePresentThenOK)
@@ -117,6 +143,7 @@ protected:
   TEST_METHOD(TUWhenRegionInactiveThenEndIsBeforeEndifHash)
   TEST_METHOD(TUWhenRegionInactiveThenStartIsAtIfdefEol)
   TEST_METHOD(TUWhenUnsaveFileThenOK)
+  TEST_METHOD(TUWhenParsedAsyncThenEarlierResultUsable)
 
   TEST_METHOD(QualifiedNameClass)
   TEST_METHOD(QualifiedNameVariable)
@@ -270,6 +297,75 @@ TEST_F(DXIntellisenseTest, InclusionWhenValidThenAvailable) {
   }
 }
 
+TEST_F(DXIntellisenseTest, InclusionWhenSkipIncludedBodiesThenMainBodyParsed) {
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcUnsavedFile> unsaved[2];
+  CComPtr<IDxcTranslationUnit> TU;
+  // Both bodies reference an undeclared identifier; only the one in the main
+  // file should be diagnosed.
+  const char main_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return bar() + undeclared_main; }";
+  const char fixed_text[] = "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return bar(); }";
+  const char unsaved_text[] = "float4 bar() { return undeclared_inc; }";
+  unsigned diagCount;
+  VERIFY_SUCCEEDED(CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", unsaved_text, strlen(unsaved_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_text, strlen(main_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(index->ParseTranslationUnit("file.hlsl", nullptr, 0, &unsaved[0].p, 2,
+    (DxcTranslationUnitFlags)(DxcTranslationUnitFlags_UseCallerThread |
+                              DxcTranslationUnitFlags_SkipIncludedFunctionBodies), &TU));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(1U, diagCount);
+
+  // Reparsing keeps the option and picks up the edited main file.
+  unsaved[1].Release();
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", fixed_text, strlen(fixed_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0U, diagCount);
+}
+
+
+TEST_F(DXIntellisenseTest, TUWhenParsedAsyncThenEarlierResultUsable) {
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcIndex2> index2;
+  CComPtr<IDxcUnsavedFile> unsaved[2];
+  CComPtr<TestParseCallback> callback = new TestParseCallback();
+  const char first_text[] = "float4 g_global;";
+  const char second_text[] = "float4 g_global; error";
+  unsigned diagCount;
+  VERIFY_SUCCEEDED(CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+  VERIFY_SUCCEEDED(index.QueryInterface(&index2));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", first_text, strlen(first_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", second_text, strlen(second_text), &unsaved[1]));
+
+  VERIFY_SUCCEEDED(index2->ParseTranslationUnitAsync("file.hlsl", nullptr, 0, &unsaved[0].p, 1,
+    DxcTranslationUnitFlags_None, callback));
+  VERIFY_SUCCEEDED(index2->WaitForPendingParses());
+  VERIFY_ARE_EQUAL(1U, (unsigned)callback->Results.size());
+  VERIFY_SUCCEEDED(callback->Statuses[0]);
+  CComPtr<IDxcTranslationUnit> first = callback->Results[0];
+  VERIFY_IS_NOT_NULL(first.p);
+
+  // Query the first result while the next parse may be running.
+  VERIFY_SUCCEEDED(index2->ParseTranslationUnitAsync("file.hlsl", nullptr, 0, &unsaved[1].p, 1,
+    DxcTranslationUnitFlags_None, callback));
+  CComPtr<IDxcCursor> cursor;
+  VERIFY_SUCCEEDED(first->GetCursor(&cursor));
+  VERIFY_SUCCEEDED(first->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(0U, diagCount);
+  VERIFY_SUCCEEDED(index2->WaitForPendingParses());
+
+  VERIFY_ARE_EQUAL(2U, (unsigned)callback->Results.size());
+  VERIFY_SUCCEEDED(callback->Statuses[1]);
+  VERIFY_IS_NOT_NULL(callback->Results[1].p);
+  VERIFY_IS_TRUE(callback->Results[1].p != first.p);
+  VERIFY_SUCCEEDED(callback->Results[1]->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_NOT_EQUAL(0U, diagCount);
+}
 
 TEST_F(DXIntellisenseTest, TUWhenGetFileMissingThenFail) {
   const char program[] = "int i;";
@@ -40,6 +40,7 @@
 #endif
 #endif
 
+#include "llvm/Support/Compression.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -51,6 +52,8 @@
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/HLSLOptions.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilContainerView.h"
+#include "dxc/DxilContainer/DxilLineTable.h"
 #include "dxc/DxilContainer/DxilRuntimeReflection.h"
 #include "dxc/DxilContainer/DxilPipelineStateValidation.h"
 #include "dxc/DXIL/DxilShaderFlags.h"
@@ -97,11 +100,20 @@ public:
   TEST_METHOD(CompileAS_CheckPSV0)
   TEST_METHOD(CompileWhenOkThenCheckRDAT)
   TEST_METHOD(CompileWhenOkThenCheckRDAT2)
+  TEST_METHOD(CompileWhenOkThenFindRDATFunctionByName)
+  TEST_METHOD(CompileWhenOkThenFindRDATExportAssociations)
   TEST_METHOD(CompileWhenOkThenCheckReflection1)
   TEST_METHOD(DxcUtils_CreateReflection)
   TEST_METHOD(CompileWhenOKThenIncludesFeatureInfo)
   TEST_METHOD(CompileWhenOKThenIncludesSignatures)
   TEST_METHOD(CompileWhenSigSquareThenIncludeSplit)
+  TEST_METHOD(ContainerPackageWhenSharedRootSignatureThenStoredOnce)
+  TEST_METHOD(ContainerInPlaceWhenPartSetThenOnlyTailMoves)
+  TEST_METHOD(ShaderArchiveWhenWrittenThenFindsContainers)
+  TEST_METHOD(ContainerViewWhenValidThenFindsPSV)
+  TEST_METHOD(CompileWhenSemanticRepeatsThenPSVSharesName)
+  TEST_METHOD(LineTableWhenRequestedThenMapsInstructions)
+  TEST_METHOD(CompressedDebugWhenRequestedThenUncompressesToSamePart)
   TEST_METHOD(DisassemblyWhenMissingThenFails)
   TEST_METHOD(DisassemblyWhenBCInvalidThenFails)
   TEST_METHOD(DisassemblyWhenInvalidThenFails)
@@ -113,6 +125,8 @@ public:
   BEGIN_TEST_METHOD(ReflectionMatchesDXBC_Full)
     TEST_METHOD_PROPERTY(L"Priority", L"1")
   END_TEST_METHOD()
+  TEST_METHOD(ReflectionBatchWhenTypesMatchThenShared)
+  TEST_METHOD(ReflectionWhenValidatorOlderThenUsageMatches)
 
   dxc::DxcDllSupport m_dllSupport;
   VersionSupportInfo m_ver;
@@ -638,6 +652,15 @@ TEST_F(DxilContainerTest, CompileWhenDebugSourceThenSourceMatters) {
 
   // Source hash and bin hash should be different
   VERIFY_IS_FALSE(0 == strcmp(binHash1Zss.c_str(), binHash1.c_str()));
+
+  // The fast hash is deterministic, differs from MD5, and ignores the same
+  // source differences.
+  LPCWSTR ZsbFast[] = { L"/Zsb", L"/Qfast_hash" };
+  std::string fastHash1 = CompileToShaderHash(program1, L"main", L"ps_6_0", ZsbFast, _countof(ZsbFast));
+  std::string fastHash2 = CompileToShaderHash(program2, L"main", L"ps_6_0", ZsbFast, _countof(ZsbFast));
+  VERIFY_IS_FALSE(fastHash1.empty());
+  VERIFY_ARE_EQUAL_STR(fastHash1.c_str(), fastHash2.c_str());
+  VERIFY_IS_FALSE(0 == strcmp(fastHash1.c_str(), binHash2.c_str()));
 }
 #endif // _WIN32
 
@@ -1087,6 +1110,108 @@ TEST_F(DxilContainerTest, CompileWhenOkThenCheckRDAT2) {
   IFTBOOLMSG(blobFound, E_FAIL, "failed to find RDAT blob after compiling");
 }
 
+TEST_F(DxilContainerTest, CompileWhenOkThenFindRDATFunctionByName) {
+  if (m_ver.SkipDxilVersion(1, 6)) return;
+  const char *shader =
+      "RWByteAddressBuffer buf;"
+      "export float zeta(float x) { return x * 2; }"
+      "export float alpha(float x) { buf.Store(0, asuint(x)); return x; }"
+      "export float mid(float x) { return zeta(x) + alpha(x); }"
+      "[shader(\"raygeneration\")] void RayGenMain() { buf.Store(4, 1); }";
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcOperationResult> pResult;
+  HRESULT status;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(shader, &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"hlsl.hlsl", L"",
+                                      L"lib_6_3", nullptr, 0, nullptr, 0,
+                                      nullptr, &pResult));
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  const hlsl::DxilPartHeader *pPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DxilFourCC::DFCC_RuntimeData);
+  VERIFY_IS_NOT_NULL(pPart);
+
+  using namespace hlsl::RDAT;
+  DxilRuntimeData context(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  FunctionTableReader *funcTableReader = context.GetFunctionTableReader();
+  VERIFY_IS_TRUE(funcTableReader->GetNumFunctions() >= 4);
+  for (uint32_t i = 0; i < funcTableReader->GetNumFunctions(); ++i) {
+    FunctionReader expected = funcTableReader->GetItem(i);
+    FunctionReader found = funcTableReader->FindFunction(expected.GetName());
+    VERIFY_ARE_EQUAL_STR(expected.GetName(), found.GetName());
+    VERIFY_ARE_EQUAL_STR(expected.GetUnmangledName(), found.GetUnmangledName());
+  }
+  FunctionReader missing = funcTableReader->FindFunction("\01?missing@@YAMM@Z");
+  VERIFY_ARE_EQUAL_STR("", missing.GetName());
+}
+
+TEST_F(DxilContainerTest, CompileWhenOkThenFindRDATExportAssociations) {
+  if (m_ver.SkipDxilVersion(1, 6)) return;
+  const char *shader =
+      "GlobalRootSignature grs = {\"CBV(b0)\"};"
+      "LocalRootSignature lrs = {\"UAV(u0), RootFlags(LOCAL_ROOT_SIGNATURE)\"};"
+      "RaytracingShaderConfig rsc = { 128, 64 };"
+      "SubobjectToExportsAssociation sea = { \"lrs\", \"b;a\" };"
+      "SubobjectToExportsAssociation sea2 = { \"rsc\", \"a\" };"
+      "SubobjectToExportsAssociation sea3 = { \"external\", \"a;c\" };"
+      "SubobjectToExportsAssociation sea4 = { \"grs\", \"\" };"
+      "[shader(\"raygeneration\")] void a() {}";
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcOperationResult> pResult;
+  HRESULT status;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(shader, &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"hlsl.hlsl", L"",
+                                      L"lib_6_3", nullptr, 0, nullptr, 0,
+                                      nullptr, &pResult));
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  const hlsl::DxilPartHeader *pPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DxilFourCC::DFCC_RuntimeData);
+  VERIFY_IS_NOT_NULL(pPart);
+
+  using namespace hlsl::RDAT;
+  DxilRuntimeData context(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  SubobjectTableReader *pSubobjects = context.GetSubobjectTableReader();
+  uint32_t first, count;
+  VERIFY_IS_TRUE(pSubobjects->FindExportAssociations("a", first, count));
+  VERIFY_ARE_EQUAL(3u, count);
+  VERIFY_ARE_EQUAL_STR("sea", pSubobjects->GetExportAssociation(first).GetName());
+  VERIFY_ARE_EQUAL_STR("lrs",
+      pSubobjects->GetExportAssociatedSubobject(first).GetName());
+  VERIFY_ARE_EQUAL_STR("sea2",
+      pSubobjects->GetExportAssociation(first + 1).GetName());
+  VERIFY_ARE_EQUAL_STR("rsc",
+      pSubobjects->GetExportAssociatedSubobject(first + 1).GetName());
+  VERIFY_ARE_EQUAL_STR("sea3",
+      pSubobjects->GetExportAssociation(first + 2).GetName());
+  VERIFY_ARE_EQUAL_STR("",
+      pSubobjects->GetExportAssociatedSubobject(first + 2).GetName());
+
+  VERIFY_IS_TRUE(pSubobjects->FindExportAssociations("b", first, count));
+  VERIFY_ARE_EQUAL(1u, count);
+  VERIFY_ARE_EQUAL_STR("sea", pSubobjects->GetExportAssociation(first).GetName());
+  VERIFY_IS_TRUE(pSubobjects->FindExportAssociations("missing", first, count));
+  VERIFY_ARE_EQUAL(0u, count);
+}
+
 static uint32_t EncodedVersion_lib_6_3 = hlsl::EncodeVersion(hlsl::DXIL::ShaderKind::Library, 6, 3);
 static uint32_t EncodedVersion_vs_6_3 = hlsl::EncodeVersion(hlsl::DXIL::ShaderKind::Vertex, 6, 3);
 
@@ -1583,6 +1708,342 @@ TEST_F(DxilContainerTest, DisassemblyWhenBCInvalidThenFails) {
   VERIFY_FAILED(pCompiler->Disassemble(pProgram, &pDisassembly));
 }
 
+TEST_F(DxilContainerTest, ContainerPackageWhenSharedRootSignatureThenStoredOnce) {
+  const char *programs[] = {
+    "#define RS \"RootConstants(num32BitConstants=4, b0)\"\n"
+    "cbuffer C : register(b0) { float4 c; };\n"
+    "[RootSignature(RS)] float4 main() : SV_Target { return c; }",
+    "#define RS \"RootConstants(num32BitConstants=4, b0)\"\n"
+    "cbuffer C : register(b0) { float4 c; };\n"
+    "[RootSignature(RS)] float4 main() : SV_Target { return c * 2; }",
+    "float4 main() : SV_Target { return 1; }",
+  };
+  const UINT32 containerCount = _countof(programs);
+
+  CComPtr<IDxcContainerBuilder> pBuilder;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerBuilder, &pBuilder));
+  CComPtr<IDxcContainerPackageBuilder> pPackageBuilder;
+  if (pBuilder.QueryInterface(&pPackageBuilder) == E_NOINTERFACE)
+    return; // Container builder from an older dxil.dll.
+
+  CComPtr<IDxcBlob> pContainers[containerCount];
+  for (UINT32 i = 0; i < containerCount; ++i) {
+    CompileToProgram(programs[i], L"main", L"ps_6_0", nullptr, 0, &pContainers[i]);
+    VERIFY_SUCCEEDED(pPackageBuilder->AddContainerToPackage(pContainers[i]));
+  }
+
+  CComPtr<IDxcBlob> pPackage;
+  VERIFY_SUCCEEDED(pPackageBuilder->SerializePackage(&pPackage));
+  const hlsl::DxilContainerPackageHeader *pHeader =
+      hlsl::IsValidDxilContainerPackage(pPackage->GetBufferPointer(),
+                                        pPackage->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  VERIFY_ARE_EQUAL(1u, pHeader->RootSignatureCount);
+  VERIFY_ARE_EQUAL(containerCount, pHeader->ContainerCount);
+
+  CComPtr<IDxcContainerPackage> pLoaded;
+  VERIFY_SUCCEEDED(pPackageBuilder->LoadPackage(pPackage, &pLoaded));
+  UINT32 count = 0;
+  VERIFY_SUCCEEDED(pLoaded->GetContainerCount(&count));
+  VERIFY_ARE_EQUAL(containerCount, count);
+  for (UINT32 i = 0; i < containerCount; ++i) {
+    CComPtr<IDxcBlob> pExpanded;
+    VERIFY_SUCCEEDED(pLoaded->GetContainer(i, &pExpanded));
+    VERIFY_ARE_EQUAL(pContainers[i]->GetBufferSize(), pExpanded->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pContainers[i]->GetBufferPointer(),
+                               pExpanded->GetBufferPointer(),
+                               pExpanded->GetBufferSize()));
+  }
+  CComPtr<IDxcBlob> pMissing;
+  VERIFY_FAILED(pLoaded->GetContainer(containerCount, &pMissing));
+}
+
+TEST_F(DxilContainerTest, ContainerInPlaceWhenPartSetThenOnlyTailMoves) {
+  CComPtr<IDxcContainerBuilder> pBuilder;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerBuilder, &pBuilder));
+  CComPtr<IDxcContainerInPlaceBuilder> pInPlace;
+  if (pBuilder.QueryInterface(&pInPlace) == E_NOINTERFACE)
+    return; // Container builder from an older dxil.dll.
+
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram("float4 main() : SV_Target { return 1; }", L"main",
+                   L"ps_6_0", nullptr, 0, &pProgram);
+  UINT32 size = (UINT32)pProgram->GetBufferSize();
+  std::vector<char> container((const char *)pProgram->GetBufferPointer(),
+                              (const char *)pProgram->GetBufferPointer() + size);
+  auto GetPrivateData = [&]() {
+    const hlsl::DxilContainerHeader *pHeader =
+        hlsl::IsDxilContainerLike(container.data(), container.size());
+    VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(pHeader, container.size()));
+    VERIFY_IS_TRUE(hlsl::IsContiguousDxilContainer(pHeader));
+    const hlsl::DxilPartHeader *pPart =
+        hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_PrivateData);
+    VERIFY_IS_NOT_NULL(pPart);
+    return std::string(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  };
+
+  // Too small a buffer reports the size needed and leaves it unchanged.
+  const char first[] = "private";
+  UINT32 newSize = 0;
+  VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER),
+                   pInPlace->SetPartInPlace(container.data(), size,
+                                            hlsl::DFCC_PrivateData, first,
+                                            sizeof(first), &newSize));
+  VERIFY_ARE_EQUAL(size + sizeof(UINT32) + sizeof(hlsl::DxilPartHeader) +
+                       sizeof(first), newSize);
+  VERIFY_ARE_EQUAL(0, memcmp(container.data(), pProgram->GetBufferPointer(), size));
+
+  container.resize(newSize + 64);
+  VERIFY_SUCCEEDED(pInPlace->SetPartInPlace(container.data(), (UINT32)container.size(),
+                                            hlsl::DFCC_PrivateData, first,
+                                            sizeof(first), &newSize));
+  VERIFY_ARE_EQUAL(std::string(first, sizeof(first)), GetPrivateData());
+
+  // Replacing the part keeps the parts before it where they were.
+  const char second[] = "larger private data";
+  UINT32 replacedSize = 0;
+  VERIFY_SUCCEEDED(pInPlace->SetPartInPlace(container.data(), (UINT32)container.size(),
+                                            hlsl::DFCC_PrivateData, second,
+                                            sizeof(second), &replacedSize));
+  VERIFY_ARE_EQUAL(newSize - sizeof(first) + sizeof(second), replacedSize);
+  VERIFY_ARE_EQUAL(std::string(second, sizeof(second)), GetPrivateData());
+
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pInPlace->SetPartInPlace(container.data(), (UINT32)container.size(),
+                                            hlsl::DFCC_DXIL, second,
+                                            sizeof(second), &newSize));
+}
+
+TEST_F(DxilContainerTest, ShaderArchiveWhenWrittenThenFindsContainers) {
+  const char *programs[] = {
+    "#define RS \"RootConstants(num32BitConstants=4, b0)\"\n"
+    "cbuffer C : register(b0) { float4 c; };\n"
+    "[RootSignature(RS)] float4 main() : SV_Target { return c; }",
+    "#define RS \"RootConstants(num32BitConstants=4, b0)\"\n"
+    "cbuffer C : register(b0) { float4 c; };\n"
+    "[RootSignature(RS)] float4 main() : SV_Target { return c * 2; }",
+    "float4 main() : SV_Target { return 1; }",
+  };
+  LPCWSTR names[] = { L"first", nullptr, L"third" };
+  const UINT32 containerCount = _countof(programs);
+
+  CComPtr<IDxcUtils> pUtils;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcUtils, &pUtils));
+  CComPtr<IDxcShaderArchiveUtils> pArchiveUtils;
+  VERIFY_SUCCEEDED(pUtils.QueryInterface(&pArchiveUtils));
+
+  CComPtr<IDxcBlob> pContainers[containerCount];
+  IDxcBlob *ppContainers[containerCount];
+  for (UINT32 i = 0; i < containerCount; ++i) {
+    CompileToProgram(programs[i], L"main", L"ps_6_0", nullptr, 0, &pContainers[i]);
+    ppContainers[i] = pContainers[i];
+  }
+  CComPtr<IDxcBlob> pArchiveBlob;
+  VERIFY_SUCCEEDED(pArchiveUtils->WriteShaderArchive(ppContainers, names,
+                                                     containerCount, &pArchiveBlob));
+  const hlsl::DxilShaderArchiveHeader *pHeader =
+      hlsl::IsValidDxilShaderArchive(pArchiveBlob->GetBufferPointer(),
+                                     pArchiveBlob->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  VERIFY_ARE_EQUAL(1u, pHeader->RootSignatureCount);
+  VERIFY_ARE_EQUAL(2u, pHeader->NameIndexCount);
+
+  CComPtr<IDxcShaderArchive> pArchive;
+  VERIFY_SUCCEEDED(pArchiveUtils->LoadShaderArchive(pArchiveBlob, &pArchive));
+  UINT32 count = 0;
+  VERIFY_SUCCEEDED(pArchive->GetContainerCount(&count));
+  VERIFY_ARE_EQUAL(containerCount, count);
+
+  auto VerifySame = [](IDxcBlob *pExpected, IDxcBlob *pActual) {
+    VERIFY_IS_NOT_NULL(pActual);
+    VERIFY_ARE_EQUAL(pExpected->GetBufferSize(), pActual->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pExpected->GetBufferPointer(),
+                               pActual->GetBufferPointer(),
+                               pActual->GetBufferSize()));
+  };
+  for (UINT32 i = 0; i < containerCount; ++i) {
+    void *pHashData = nullptr;
+    UINT32 hashSize = 0;
+    DxcBuffer buffer = { pContainers[i]->GetBufferPointer(),
+                         pContainers[i]->GetBufferSize(), 0 };
+    VERIFY_SUCCEEDED(pUtils->GetDxilContainerPart(&buffer, DXC_PART_SHADER_HASH,
+                                                  &pHashData, &hashSize));
+    VERIFY_ARE_EQUAL(sizeof(DxcShaderHash), hashSize);
+    CComPtr<IDxcBlob> pFound;
+    VERIFY_ARE_EQUAL(S_OK, pArchive->FindContainerByHash(
+                               (const DxcShaderHash *)pHashData, &pFound));
+    VerifySame(pContainers[i], pFound);
+  }
+
+  CComPtr<IDxcBlob> pByName;
+  VERIFY_ARE_EQUAL(S_OK, pArchive->FindContainerByName(L"third", &pByName));
+  VerifySame(pContainers[2], pByName);
+  CComPtr<IDxcBlob> pMissing;
+  VERIFY_ARE_EQUAL(S_FALSE, pArchive->FindContainerByName(L"second", &pMissing));
+  VERIFY_IS_NULL(pMissing.p);
+}
+
+TEST_F(DxilContainerTest, ContainerViewWhenValidThenFindsPSV) {
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram("float4 main(float4 pos : SV_Position) : SV_Target { return pos; }",
+                   L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  const void *pData = pProgram->GetBufferPointer();
+  uint32_t size = (uint32_t)pProgram->GetBufferSize();
+
+  hlsl::DxilContainerView view;
+  VERIFY_IS_TRUE(view.Init(pData, size));
+  const hlsl::DxilContainerHeader *pHeader =
+      (const hlsl::DxilContainerHeader *)pData;
+  VERIFY_ARE_EQUAL(pHeader->PartCount, view.GetPartCount());
+  for (uint32_t i = 0; i < view.GetPartCount(); ++i) {
+    const hlsl::DxilPartHeader *pPart = hlsl::GetDxilContainerPart(pHeader, i);
+    VERIFY_ARE_EQUAL(i, view.FindPartIndex(pPart->PartFourCC));
+  }
+
+  DxilPipelineStateValidation PSV;
+  VERIFY_IS_TRUE(view.InitPSV(PSV));
+  VERIFY_ARE_EQUAL(PSVShaderKind::Pixel, PSV.GetShaderKind());
+  VERIFY_ARE_EQUAL(1u, PSV.GetSigInputElements());
+
+  // Truncated data and a part running past the end are both rejected.
+  VERIFY_IS_FALSE(view.Init(pData, size - 1));
+  VERIFY_IS_FALSE(view.IsValid());
+  VERIFY_IS_FALSE(view.FindPart(hlsl::DFCC_PipelineStateValidation, nullptr, nullptr));
+  std::vector<uint8_t> copy((const uint8_t *)pData, (const uint8_t *)pData + size);
+  hlsl::DxilPartHeader *pLast = hlsl::GetDxilContainerPart(
+      (hlsl::DxilContainerHeader *)copy.data(), pHeader->PartCount - 1);
+  pLast->PartSize += 4;
+  VERIFY_IS_FALSE(view.Init(copy.data(), copy.size()));
+}
+
+TEST_F(DxilContainerTest, CompileWhenSemanticRepeatsThenPSVSharesName) {
+  if (m_ver.SkipDxilVersion(1, 6)) return;
+  // Different interpolation modes keep the TEXCOORD rows in separate
+  // signature elements that share one semantic name.
+  const char *source =
+      "struct PSIn { float4 pos : SV_Position; float2 uv : TEXCOORD0;\n"
+      "  nointerpolation uint id : TEXCOORD1; float3 n : NORMAL; };\n"
+      "float4 main(PSIn i) : SV_Target { return float4(i.uv, i.n.x, i.id); }\n";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(source, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+
+  hlsl::DxilContainerView view;
+  VERIFY_IS_TRUE(view.Init(pProgram->GetBufferPointer(),
+                           (uint32_t)pProgram->GetBufferSize()));
+  DxilPipelineStateValidation PSV;
+  VERIFY_IS_TRUE(view.InitPSV(PSV));
+  std::vector<uint32_t> texcoordOffsets;
+  for (uint32_t i = 0; i < PSV.GetSigInputElements(); ++i) {
+    PSVSignatureElement0 *pElement0 = PSV.GetInputElement0(i);
+    PSVSignatureElement element = PSV.GetSignatureElement(pElement0);
+    if (strcmp(element.GetSemanticName(), "TEXCOORD") == 0)
+      texcoordOffsets.push_back(pElement0->SemanticName);
+  }
+  VERIFY_ARE_EQUAL(2u, (uint32_t)texcoordOffsets.size());
+  VERIFY_ARE_EQUAL(texcoordOffsets[0], texcoordOffsets[1]);
+}
+
+TEST_F(DxilContainerTest, LineTableWhenRequestedThenMapsInstructions) {
+  const char *source = "float4 main(float4 pos : SV_Position) : SV_Target {\n"
+                       "  float4 v = pos * 3;\n"
+                       "  return v + 1;\n"
+                       "}\n";
+  LPCWSTR args[] = { L"/Zi", L"/Qline_table" };
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(source, L"main", L"ps_6_0", args, _countof(args), &pProgram);
+
+  hlsl::DxilContainerView view;
+  VERIFY_IS_TRUE(view.Init(pProgram->GetBufferPointer(),
+                           (uint32_t)pProgram->GetBufferSize()));
+  const void *pData = nullptr;
+  uint32_t size = 0;
+  VERIFY_IS_TRUE(view.FindPart(hlsl::DFCC_LineTable, &pData, &size));
+
+  hlsl::DxilLineTableReader table;
+  VERIFY_IS_TRUE(table.Init(pData, size));
+  VERIFY_ARE_EQUAL(1u, table.GetFileCount());
+  VERIFY_IS_TRUE(table.GetRowCount() >= 2);
+
+  // Every located instruction is in the shader body, and both of its
+  // statements are there.
+  bool sawLine2 = false, sawLine3 = false;
+  hlsl::DxilSourceLocation loc;
+  for (uint32_t i = 0; i < 64; ++i) {
+    if (!table.Lookup(i, loc))
+      continue;
+    VERIFY_IS_TRUE(loc.Line >= 1 && loc.Line <= 3);
+    VERIFY_ARE_EQUAL(0, strcmp(loc.FileName, table.GetFileName(0)));
+    sawLine2 |= loc.Line == 2;
+    sawLine3 |= loc.Line == 3;
+  }
+  VERIFY_IS_TRUE(sawLine2);
+  VERIFY_IS_TRUE(sawLine3);
+
+  // The part is only written on request.
+  CComPtr<IDxcBlob> pPlain;
+  LPCWSTR debugArgs[] = { L"/Zi" };
+  CompileToProgram(source, L"main", L"ps_6_0", debugArgs, _countof(debugArgs),
+                   &pPlain);
+  VERIFY_IS_TRUE(view.Init(pPlain->GetBufferPointer(),
+                           (uint32_t)pPlain->GetBufferSize()));
+  VERIFY_IS_FALSE(view.FindPart(hlsl::DFCC_LineTable, nullptr, nullptr));
+}
+
+TEST_F(DxilContainerTest, CompressedDebugWhenRequestedThenUncompressesToSamePart) {
+  if (!llvm::zlib::isAvailable()) {
+    WEX::Logging::Log::Comment(L"zlib is not available - skipping test");
+    WEX::Logging::Log::Result(WEX::Logging::TestResults::Skipped);
+    return;
+  }
+  const char *source = "float4 main(float4 pos : SV_Position) : SV_Target {\n"
+                       "  return pos * 3 + 1;\n"
+                       "}\n";
+  LPCWSTR plainArgs[] = { L"/Zi", L"/Qembed_debug" };
+  LPCWSTR compressedArgs[] = { L"/Zi", L"/Qembed_debug", L"/Qcompress_debug" };
+  CComPtr<IDxcBlob> pPlain, pCompressed;
+  CompileToProgram(source, L"main", L"ps_6_0", plainArgs, _countof(plainArgs),
+                   &pPlain);
+  CompileToProgram(source, L"main", L"ps_6_0", compressedArgs,
+                   _countof(compressedArgs), &pCompressed);
+
+  const hlsl::DxilContainerHeader *pPlainHeader = hlsl::IsDxilContainerLike(
+      pPlain->GetBufferPointer(), pPlain->GetBufferSize());
+  const hlsl::DxilContainerHeader *pCompressedHeader = hlsl::IsDxilContainerLike(
+      pCompressed->GetBufferPointer(), pCompressed->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pPlainHeader);
+  VERIFY_IS_NOT_NULL(pCompressedHeader);
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(pCompressedHeader,
+                                         hlsl::DFCC_ShaderDebugInfoDXIL));
+  const hlsl::DxilPartHeader *pPlainPart =
+      hlsl::GetDxilPartByType(pPlainHeader, hlsl::DFCC_ShaderDebugInfoDXIL);
+  const hlsl::DxilPartHeader *pCompressedPart = hlsl::GetDxilPartByType(
+      pCompressedHeader, hlsl::DFCC_CompressedShaderDebugInfoDXIL);
+  VERIFY_IS_NOT_NULL(pPlainPart);
+  VERIFY_IS_NOT_NULL(pCompressedPart);
+  VERIFY_IS_TRUE(pCompressedPart->PartSize < pPlainPart->PartSize);
+
+  // Uncompressed, the part is the one written without compression.
+  std::vector<char> storage;
+  const hlsl::DxilProgramHeader *pProgramHeader =
+      hlsl::GetDxilDebugProgramHeader(pCompressedHeader, storage);
+  VERIFY_IS_NOT_NULL(pProgramHeader);
+  VERIFY_ARE_EQUAL(pPlainPart->PartSize,
+                   pProgramHeader->SizeInUint32 * sizeof(uint32_t));
+  VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPlainPart), pProgramHeader,
+                             pPlainPart->PartSize));
+
+  // The shader hash does not cover the debug part.
+  const hlsl::DxilPartHeader *pPlainHash =
+      hlsl::GetDxilPartByType(pPlainHeader, hlsl::DFCC_ShaderHash);
+  const hlsl::DxilPartHeader *pCompressedHash =
+      hlsl::GetDxilPartByType(pCompressedHeader, hlsl::DFCC_ShaderHash);
+  VERIFY_IS_NOT_NULL(pPlainHash);
+  VERIFY_IS_NOT_NULL(pCompressedHash);
+  VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPlainHash),
+                             hlsl::GetDxilPartData(pCompressedHash),
+                             sizeof(hlsl::DxilShaderHash)));
+}
+
 TEST_F(DxilContainerTest, DisassemblyWhenMissingThenFails) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcBlobEncoding> pSource;
@@ -1829,6 +2290,113 @@ TEST_F(DxilContainerTest, ReflectionMatchesDXBC_Full) {
     }
   }
 }
+
+TEST_F(DxilContainerTest, ReflectionBatchWhenTypesMatchThenShared) {
+  const char *Shaders[] = {
+    "struct Light { float3 pos; float range; float4 color; };\n"
+    "cbuffer Lights { Light light; float scale; };\n"
+    "float4 main() : SV_Target { return light.color * scale; }",
+    "struct Light { float3 pos; float range; float4 color; };\n"
+    "cbuffer Lights { Light light; float scale; };\n"
+    "float4 main(float3 p : P) : SV_Target {\n"
+    "  return light.color * (light.range - length(p - light.pos)); }",
+  };
+  CComPtr<IDxcBlob> pPrograms[2];
+  for (unsigned i = 0; i < 2; ++i)
+    CompileToProgram(Shaders[i], L"main", L"ps_6_0", nullptr, 0, &pPrograms[i]);
+
+  CComPtr<IDxcContainerReflection> pContainerReflection;
+  CComPtr<IDxcContainerReflectionBatch> pBatch;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection, &pContainerReflection));
+  VERIFY_SUCCEEDED(pContainerReflection.QueryInterface(&pBatch));
+
+  IDxcBlob *pBlobs[] = { pPrograms[0], pPrograms[1] };
+  void *pReflections[2] = {};
+  HRESULT results[2] = {};
+  VERIFY_SUCCEEDED(pBatch->GetReflections(2, pBlobs, 0,
+                                          __uuidof(ID3D12ShaderReflection),
+                                          pReflections, results));
+  CComPtr<ID3D12ShaderReflection> pReflection[2];
+  for (unsigned i = 0; i < 2; ++i) {
+    VERIFY_SUCCEEDED(results[i]);
+    pReflection[i].Attach((ID3D12ShaderReflection *)pReflections[i]);
+  }
+
+  // The variable types are shared, and read the same as on their own.
+  ID3D12ShaderReflectionType *pTypes[2];
+  for (unsigned i = 0; i < 2; ++i) {
+    ID3D12ShaderReflectionConstantBuffer *pCB =
+        pReflection[i]->GetConstantBufferByName("Lights");
+    pTypes[i] = pCB->GetVariableByName("light")->GetType();
+  }
+  VERIFY_ARE_EQUAL(pTypes[0], pTypes[1]);
+
+  CComPtr<ID3D12ShaderReflection> pSingle;
+  CreateReflectionFromBlob(pPrograms[1], &pSingle);
+  ID3D12ShaderReflectionType *pSingleType =
+      pSingle->GetConstantBufferByName("Lights")->GetVariableByName("light")->GetType();
+  D3D12_SHADER_TYPE_DESC BatchDesc, SingleDesc;
+  VERIFY_SUCCEEDED(pTypes[1]->GetDesc(&BatchDesc));
+  VERIFY_SUCCEEDED(pSingleType->GetDesc(&SingleDesc));
+  VERIFY_ARE_EQUAL(BatchDesc.Members, SingleDesc.Members);
+  VERIFY_ARE_EQUAL(std::string(BatchDesc.Name), std::string(SingleDesc.Name));
+  for (UINT i = 0; i < SingleDesc.Members; ++i) {
+    VERIFY_ARE_EQUAL(std::string(pTypes[1]->GetMemberTypeName(i)),
+                     std::string(pSingleType->GetMemberTypeName(i)));
+  }
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenValidatorOlderThenUsageMatches) {
+  if (m_ver.SkipDxilVersion(1, 5)) return;
+
+  // Containers for validator 1.5 and later keep usage in metadata and are
+  // reflected without reading function bodies; older ones have their bodies
+  // materialized so usage can be found from instructions. Both must agree.
+  const char *Shader =
+    "cbuffer CB : register(b0) { float4 used; float4 unused; };\n"
+    "Texture2D tex : register(t0);\n"
+    "SamplerState samp : register(s0);\n"
+    "float4 main(float4 uv : TEXCOORD0, float4 extra : TEXCOORD1,\n"
+    "            out float4 depth : SV_Target1) : SV_Target0 {\n"
+    "  depth = 0;\n"
+    "  return used * tex.Sample(samp, uv.xy) + extra.x;\n"
+    "}";
+  LPCWSTR OldArgs[] = { L"-validator-version", L"1.4" };
+  CComPtr<IDxcBlob> pLazy, pMaterialized;
+  CompileToProgram(Shader, L"main", L"ps_6_0", nullptr, 0, &pLazy);
+  CompileToProgram(Shader, L"main", L"ps_6_0", OldArgs, _countof(OldArgs),
+                   &pMaterialized);
+
+  CComPtr<ID3D12ShaderReflection> pLazyReflection, pMaterializedReflection;
+  CreateReflectionFromBlob(pLazy, &pLazyReflection);
+  CreateReflectionFromBlob(pMaterialized, &pMaterializedReflection);
+  CompareReflection(pLazyReflection, pMaterializedReflection);
+
+  for (ID3D12ShaderReflection *pReflection :
+       { pLazyReflection.p, pMaterializedReflection.p }) {
+    ID3D12ShaderReflectionConstantBuffer *pCB =
+        pReflection->GetConstantBufferByName("CB");
+    D3D12_SHADER_VARIABLE_DESC UsedDesc, UnusedDesc;
+    VERIFY_SUCCEEDED(pCB->GetVariableByName("used")->GetDesc(&UsedDesc));
+    VERIFY_SUCCEEDED(pCB->GetVariableByName("unused")->GetDesc(&UnusedDesc));
+    VERIFY_ARE_EQUAL(D3D_SVF_USED, UsedDesc.uFlags & D3D_SVF_USED);
+    VERIFY_ARE_EQUAL(0u, UnusedDesc.uFlags & D3D_SVF_USED);
+  }
+
+  // The input masks are compared exactly, which CompareReflection leaves out
+  // because DXBC reports them differently.
+  D3D12_SHADER_DESC Desc;
+  VERIFY_SUCCEEDED(pLazyReflection->GetDesc(&Desc));
+  for (UINT i = 0; i < Desc.InputParameters; ++i) {
+    D3D12_SIGNATURE_PARAMETER_DESC LazyDesc, MaterializedDesc;
+    VERIFY_SUCCEEDED(pLazyReflection->GetInputParameterDesc(i, &LazyDesc));
+    VERIFY_SUCCEEDED(
+        pMaterializedReflection->GetInputParameterDesc(i, &MaterializedDesc));
+    VERIFY_ARE_EQUAL(LazyDesc.SemanticIndex, MaterializedDesc.SemanticIndex);
+    VERIFY_ARE_EQUAL(LazyDesc.Mask, MaterializedDesc.Mask);
+    VERIFY_ARE_EQUAL(LazyDesc.ReadWriteMask, MaterializedDesc.ReadWriteMask);
+  }
+}
 #endif // _WIN32 - Reflection unsupported
 
 TEST_F(DxilContainerTest, ValidateFromLL_Abs2) {
@@ -305,6 +305,11 @@ public:
     TEST_METHOD_PROPERTY(L"Priority", L"2") // Remove this line once warp supports this feature in Shader Model 6.3
   END_TEST_METHOD()
 
+  // Not a correctness test; times a shader op given by runtime parameters.
+  BEGIN_TEST_METHOD(ShaderOpPerfTest)
+    TEST_METHOD_PROPERTY(L"Priority", L"2")
+  END_TEST_METHOD()
+
   BEGIN_TEST_METHOD(WaveIntrinsicsActiveIntTest)
     TEST_METHOD_PROPERTY(L"DataSource", L"Table:ShaderOpArithTable.xml#WaveIntrinsicsActiveIntTable")
   END_TEST_METHOD()
@@ -2325,6 +2330,140 @@ RunShaderOpTest(ID3D12Device *pDevice, dxc::DxcDllSupport &support,
   return RunShaderOpTestAfterParse(pDevice, support, pName, pInitCallback, ShaderOpSet);
 }
 
+// Returns whether a target profile such as "cs_6_2" is at least major.minor.
+static bool IsTargetAtLeast(LPCSTR pTarget, unsigned major, unsigned minor) {
+  unsigned targetMajor = 0, targetMinor = 0;
+  LPCSTR pVersion = pTarget ? strchr(pTarget, '_') : nullptr;
+  if (!pVersion || 2 != sscanf_s(pVersion, "_%u_%u", &targetMajor, &targetMinor))
+    return false;
+  return targetMajor > major || (targetMajor == major && targetMinor >= minor);
+}
+
+struct ShaderOpPerfResult {
+  double Median;
+  double Min;
+};
+
+// Runs the named shader op with ConfigArgs appended to every shader's
+// arguments, and returns its GPU time over the given number of repetitions.
+static ShaderOpPerfResult
+RunShaderOpPerf(ID3D12Device *pDevice, dxc::DxcDllSupport &support,
+                IStream *pStream, LPCSTR pName, LPCSTR pConfigArgs,
+                UINT repetitions) {
+  std::shared_ptr<st::ShaderOpSet> ShaderOpSet =
+      std::make_shared<st::ShaderOpSet>();
+  st::ParseShaderOpSetFromStream(pStream, ShaderOpSet.get());
+  st::ShaderOp *pShaderOp = ShaderOpSet->GetShaderOp(pName);
+  VERIFY_IS_NOT_NULL(pShaderOp);
+  for (st::ShaderOpShader &S : pShaderOp->Shaders) {
+    std::string args = S.Arguments ? S.Arguments : "";
+    args += " ";
+    args += pConfigArgs;
+    S.Arguments = pShaderOp->Strings.insert(args.c_str());
+  }
+
+  st::ShaderOpTest test;
+  test.SetDxcSupport(&support);
+  test.SetDevice(pDevice);
+  test.SetTimedRepetitions(repetitions);
+  test.RunShaderOp(pShaderOp);
+
+  std::vector<double> times;
+  test.GetTimings(times);
+  std::sort(times.begin(), times.end());
+  ShaderOpPerfResult result;
+  result.Median = times[times.size() / 2];
+  result.Min = times.front();
+  return result;
+}
+
+// Times a shader op across compiler settings, optionally against a baseline
+// compiler. Runtime parameters:
+//   PerfShaderOp     - name of the shader op to time (required)
+//   PerfShaderOpFile - ShaderOp XML file in the HLSL data directory
+//                      (default ShaderOpArith.xml)
+//   PerfRepetitions  - timed Draw/Dispatch repetitions (default 100)
+//   PerfBaselineDxc  - path to a baseline dxcompiler.dll
+// Timings on WARP measure the CPU rasterizer, so use a hardware Adapter.
+TEST_F(ExecutionTest, ShaderOpPerfTest) {
+  WEX::TestExecution::SetVerifyOutput verifySettings(
+      WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
+  using WEX::TestExecution::RuntimeParameters;
+  WEX::Common::String OpName, FileName, Repetitions, BaselinePath;
+  if (FAILED(RuntimeParameters::TryGetValue(L"PerfShaderOp", OpName)) ||
+      OpName.IsEmpty()) {
+    LogCommentFmt(L"Set PerfShaderOp to the shader op to time.");
+    WEX::Logging::Log::Result(WEX::Logging::TestResults::Skipped);
+    return;
+  }
+  if (FAILED(RuntimeParameters::TryGetValue(L"PerfShaderOpFile", FileName)) ||
+      FileName.IsEmpty())
+    FileName = L"ShaderOpArith.xml";
+  UINT repetitions = 100;
+  if (SUCCEEDED(RuntimeParameters::TryGetValue(L"PerfRepetitions", Repetitions)) &&
+      _wtoi(Repetitions) > 0)
+    repetitions = (UINT)_wtoi(Repetitions);
+
+  dxc::DxcDllSupport baseline;
+  bool hasBaseline =
+      SUCCEEDED(RuntimeParameters::TryGetValue(L"PerfBaselineDxc", BaselinePath)) &&
+      !BaselinePath.IsEmpty();
+  if (hasBaseline)
+    VERIFY_SUCCEEDED(baseline.InitializeForDll(BaselinePath, "DxcCreateInstance"));
+
+  CComPtr<ID3D12Device> pDevice;
+  if (!CreateDevice(&pDevice))
+    return;
+  if (GetTestParamUseWARP(UseWarpByDefault()))
+    LogCommentFmt(L"Warning: timing on WARP does not reflect GPU performance.");
+
+  CW2A opName(OpName, CP_UTF8);
+  CComPtr<IStream> pStream;
+  ReadHlslDataIntoNewStream(FileName, &pStream);
+  std::shared_ptr<st::ShaderOpSet> ShaderOpSet =
+      std::make_shared<st::ShaderOpSet>();
+  st::ParseShaderOpSetFromStream(pStream, ShaderOpSet.get());
+  st::ShaderOp *pShaderOp = ShaderOpSet->GetShaderOp(opName);
+  VERIFY_IS_NOT_NULL(pShaderOp);
+  bool supports16Bit = true;
+  for (st::ShaderOpShader &S : pShaderOp->Shaders)
+    supports16Bit &= IsTargetAtLeast(S.Target, 6, 2);
+
+  static const struct {
+    LPCSTR Args;
+    bool Needs16Bit;
+  } Configs[] = {
+    { "-O0", false },
+    { "-O1", false },
+    { "-O2", false },
+    { "-O3", false },
+    { "-O3 -enable-16bit-types", true },
+    { "-O3 -pack-prefix-stable", false },
+    { "-O3 -pack-optimized", false },
+  };
+  LogCommentFmt(L"%S: GPU time per repetition over %u repetitions",
+                opName.m_psz, repetitions);
+  for (const auto &Config : Configs) {
+    if (Config.Needs16Bit && !supports16Bit)
+      continue;
+    LARGE_INTEGER zero = {};
+    VERIFY_SUCCEEDED(pStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    ShaderOpPerfResult current = RunShaderOpPerf(
+        pDevice, m_support, pStream, opName, Config.Args, repetitions);
+    if (!hasBaseline) {
+      LogCommentFmt(L"  %-26S median %10.2f us  min %10.2f us", Config.Args,
+                    current.Median, current.Min);
+      continue;
+    }
+    VERIFY_SUCCEEDED(pStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    ShaderOpPerfResult base = RunShaderOpPerf(
+        pDevice, baseline, pStream, opName, Config.Args, repetitions);
+    LogCommentFmt(L"  %-26S median %10.2f us  baseline %10.2f us  (%+.1f%%)",
+                  Config.Args, current.Median, base.Median,
+                  (current.Median - base.Median) * 100.0 / base.Median);
+  }
+}
+
 TEST_F(ExecutionTest, OutOfBoundsTest) {
   WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
   CComPtr<IStream> pStream;
@@ -22,6 +22,17 @@
 #include "dxc/Test/HlslTestUtils.h"
 #include "dxc/Test/DxcTestUtils.h"
 #include "dxc/dxcapi.h"
+#include "dxc/DXIL/DxilConstants.h"
+#include "dxc/HLSL/DxilLinker.h"
+#include "dxc/HLSL/DxilValidation.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace std;
 using namespace hlsl;
@@ -62,6 +73,12 @@ public:
   TEST_METHOD(RunLinkToLibWithNoExports);
   TEST_METHOD(RunLinkWithPotentialIntrinsicNameCollisions);
   TEST_METHOD(RunLinkWithValidatorVersion);
+  TEST_METHOD(RunLinkIncremental);
+  TEST_METHOD(RunLinkMergeIdentical);
+  TEST_METHOD(RunLinkSpecialize);
+  TEST_METHOD(RunLinkPipelineStages);
+  TEST_METHOD(RunLinkParallel);
+  TEST_METHOD(RunLinkBlockAddress);
 
 
   dxc::DxcDllSupport m_dllSupport;
@@ -662,3 +679,344 @@ TEST_F(LinkerTest, RunLinkWithValidatorVersion) {
        {"!dx.valver = !{(![0-9]+)}.*\n\\1 = !{i32 1, i32 3}"},
        {}, {L"-validator-version", L"1.3"}, /*regex*/ true);
 }
+
+TEST_F(LinkerTest, RunLinkIncremental) {
+  CComPtr<IDxcBlob> pResLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  CComPtr<IDxcLinkerIncremental> pIncremental;
+  VERIFY_SUCCEEDED(pLinker.QueryInterface(&pIncremental));
+
+  LPCWSTR libNames[] = { L"res", L"entry" };
+  RegisterDxcModule(libNames[0], pResLib, pLinker);
+  RegisterDxcModule(libNames[1], pEntryLib, pLinker);
+
+  auto LinkEntry = [&](IDxcBlob **ppProgram) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pLinker->Link(L"entry", L"cs_6_0", libNames,
+                                   _countof(libNames), nullptr, 0, &pResult));
+    CheckOperationSucceeded(pResult, ppProgram);
+  };
+
+  CComPtr<IDxcBlob> pFirst, pSecond, pThird, pFourth, pFifth;
+  LinkEntry(&pFirst);
+  LinkEntry(&pSecond);
+  VERIFY_ARE_EQUAL(pFirst.p, pSecond.p);
+
+  // The same functions from a new blob leave the entry current.
+  CComPtr<IDxcBlob> pResLib2;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib2);
+  VERIFY_SUCCEEDED(pIncremental->UpdateLibrary(libNames[0], pResLib2));
+  LinkEntry(&pThird);
+  VERIFY_ARE_EQUAL(pFirst.p, pThird.p);
+
+  // Debug info changes every function of the entry library.
+  CComPtr<IDxcBlob> pEntryLib2;
+  LPCWSTR debugOptions[] = { L"-Zi", L"-Qembed_debug" };
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib2,
+             debugOptions);
+  VERIFY_SUCCEEDED(pIncremental->UpdateLibrary(libNames[1], pEntryLib2));
+  LinkEntry(&pFourth);
+  VERIFY_ARE_NOT_EQUAL(pFirst.p, pFourth.p);
+
+  VERIFY_SUCCEEDED(pIncremental->ClearLinkCache());
+  LinkEntry(&pFifth);
+  VERIFY_ARE_NOT_EQUAL(pFourth.p, pFifth.p);
+
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pIncremental->UpdateLibrary(L"missing", pResLib));
+}
+
+TEST_F(LinkerTest, RunLinkMergeIdentical) {
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_merge_entry.hlsl", &pEntryLib);
+  CComPtr<IDxcBlob> pLib1;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_merge1.hlsl", &pLib1);
+  CComPtr<IDxcBlob> pLib2;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_merge2.hlsl", &pLib2);
+
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  LPCWSTR libNames[] = { L"entry", L"lib1", L"lib2" };
+  RegisterDxcModule(libNames[0], pEntryLib, pLinker);
+  RegisterDxcModule(libNames[1], pLib1, pLinker);
+  RegisterDxcModule(libNames[2], pLib2, pLinker);
+
+  // Both calls are linked to one copy of the identical bodies.
+  Link(L"main", L"cs_6_0", pLinker, libNames,
+       { "fadd fast float", "fmul fast float" }, {});
+
+  // Exports are kept apart in a library.
+  Link(L"", L"lib_6_3", pLinker, libNames,
+       { "define float @\"\\01?add_one@@YAMM@Z\"(float",
+         "define float @\"\\01?plus_one@@YAMM@Z\"(float" }, {});
+
+  // Internal helpers are not inlined into an entry, so only a library shows
+  // whether they merged: the two identical ones are linked as a single
+  // definition, and the one that differs in a constant keeps its own.
+  CComPtr<IDxcBlob> pInternal1, pInternal2, pInternal3;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_merge_internal1.hlsl", &pInternal1);
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_merge_internal2.hlsl", &pInternal2);
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_merge_internal3.hlsl", &pInternal3);
+  LPCWSTR internalNames[] = { L"internal1", L"internal2", L"internal3" };
+  RegisterDxcModule(internalNames[0], pInternal1, pLinker);
+  RegisterDxcModule(internalNames[1], pInternal2, pLinker);
+  RegisterDxcModule(internalNames[2], pInternal3, pLinker);
+
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pLinker->Link(L"", L"lib_6_3", internalNames,
+                                 _countof(internalNames), nullptr, 0,
+                                 &pResult));
+  CComPtr<IDxcBlob> pProgram;
+  CheckOperationSucceeded(pResult, &pProgram);
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+  std::string IR = BlobToUtf8(pDisassembly);
+  auto count = [&IR](const char *pText) {
+    unsigned n = 0;
+    for (size_t pos = IR.find(pText); pos != std::string::npos;
+         pos = IR.find(pText, pos + 1))
+      ++n;
+    return n;
+  };
+  VERIFY_ARE_EQUAL(3u, count("define float @"));
+  VERIFY_ARE_EQUAL(2u, count("define internal float @"));
+  VERIFY_ARE_EQUAL(1u, count("define internal float @\"\\01?quadruple_impl@@YAMM@Z\""));
+  const char *pScaleCall =
+      count("define internal float @\"\\01?scale_impl@@YAMM@Z\"")
+          ? "call float @\"\\01?scale_impl@@YAMM@Z\""
+          : "call float @\"\\01?triple_impl@@YAMM@Z\"";
+  VERIFY_ARE_EQUAL(2u, count(pScaleCall));
+}
+
+TEST_F(LinkerTest, RunLinkSpecialize) {
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\lib_specialize.hlsl", &pEntryLib);
+
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  LPCWSTR libName = L"entry";
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+
+  // Every switch folded: the constant buffer and the dead branch are gone.
+  LPCWSTR allArgs[] = { L"-specialize", L"UseScale=false",
+                        L"-specialize", L"$Globals.Mode=2",
+                        L"-specialize", L"Scale=0.5" };
+  Link(L"main", L"cs_6_0", pLinker, { libName },
+       { "@dx.op.unary.f32(i32 24" }, { "cbufferLoadLegacy", "fmul" }, allArgs);
+
+  // Unspecialized fields are still loaded.
+  LPCWSTR someArgs[] = { L"-specialize", L"UseScale=true",
+                         L"-specialize", L"Mode=0" };
+  Link(L"main", L"cs_6_0", pLinker, { libName },
+       { "cbufferLoadLegacy", "fmul" }, { "@dx.op.unary.f32(i32 24" },
+       someArgs);
+
+  LPCWSTR missingArgs[] = { L"-specialize", L"Missing=1" };
+  LinkCheckMsg(L"main", L"cs_6_0", pLinker, { libName },
+               { "Cannot find 32-bit scalar constant buffer field to specialize: Missing" },
+               missingArgs);
+
+  LPCWSTR badValueArgs[] = { L"-specialize", L"Mode=two" };
+  LinkCheckMsg(L"main", L"cs_6_0", pLinker, { libName },
+               { "Invalid value for specialized field Mode: two" },
+               badValueArgs);
+}
+
+TEST_F(LinkerTest, RunLinkPipelineStages) {
+  CComPtr<IDxcBlob> pVS, pPS;
+  CompileLib(L"..\\CodeGenHLSL\\linker\\pipeline_vs.hlsl", &pVS, {}, L"vs_6_0");
+  CompileLib(L"..\\CodeGenHLSL\\linker\\pipeline_ps.hlsl", &pPS, {}, L"ps_6_0");
+
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  CComPtr<IDxcPipelineLinker> pPipelineLinker;
+  VERIFY_SUCCEEDED(pLinker.QueryInterface(&pPipelineLinker));
+
+  CComPtr<IDxcOperationResult> pVSResult, pPSResult;
+  VERIFY_SUCCEEDED(
+      pPipelineLinker->LinkStages(pVS, pPS, &pVSResult, &pPSResult));
+  CComPtr<IDxcBlob> pLinkedVS, pLinkedPS;
+  CheckOperationSucceeded(pVSResult, &pLinkedVS);
+  CheckOperationSucceeded(pPSResult, &pLinkedPS);
+
+  // COLOR is gone from both stages, with the sin that only fed it, and
+  // TEXCOORD moved up into its row.
+  LPCSTR linkedChecks[] = { "; TEXCOORD                 0   xy          1" };
+  LPCSTR removedChecks[] = { "; COLOR", "@dx.op.unary.f32(i32 13" };
+  std::string VSIR = DisassembleProgram(m_dllSupport, pLinkedVS);
+  CheckMsgs(VSIR.c_str(), VSIR.size(), linkedChecks, 1, false);
+  CheckNotMsgs(VSIR.c_str(), VSIR.size(), removedChecks, 2, false);
+  std::string PSIR = DisassembleProgram(m_dllSupport, pLinkedPS);
+  CheckMsgs(PSIR.c_str(), PSIR.size(), linkedChecks, 1, false);
+  CheckNotMsgs(PSIR.c_str(), PSIR.size(), removedChecks, 1, false);
+
+  // Only a vertex or domain shader can feed the pixel shader.
+  CComPtr<IDxcOperationResult> pBadVSResult, pBadPSResult;
+  VERIFY_SUCCEEDED(
+      pPipelineLinker->LinkStages(pPS, pPS, &pBadVSResult, &pBadPSResult));
+  CheckOperationResultMsgs(pBadVSResult,
+                           { "Only a vertex or domain shader followed by a pixel shader" },
+                           false, false);
+}
+
+TEST_F(LinkerTest, RunLinkParallel) {
+  CComPtr<IDxcBlob> pResLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
+
+  LLVMContext Ctx;
+  std::string SerialDiags;
+  raw_string_ostream DiagStream(SerialDiags);
+  DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+  PrintDiagnosticContext DiagContext(DiagPrinter);
+  Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
+                           &DiagContext, true);
+
+  std::unique_ptr<DxilLinker> pLinker(
+      DxilLinker::CreateLinker(Ctx, DXIL::kDxilMajor, DXIL::kDxilMinor));
+  auto RegisterLib = [&](StringRef Name, IDxcBlob *pBlob) {
+    std::unique_ptr<Module> pModule, pDebugModule;
+    VERIFY_SUCCEEDED(ValidateLoadModuleFromContainerLazy(
+        pBlob->GetBufferPointer(), pBlob->GetBufferSize(), pModule,
+        pDebugModule, Ctx, Ctx, DiagStream));
+    VERIFY_IS_TRUE(pLinker->RegisterLib(Name, std::move(pModule),
+                                        std::move(pDebugModule)));
+    VERIFY_IS_TRUE(pLinker->AttachLib(Name));
+  };
+  RegisterLib("res", pResLib);
+  RegisterLib("entry", pEntryLib);
+
+  // Two links that succeed and two that fail, so a failure in one job shows
+  // up in its own result and leaves the others alone.
+  std::vector<DxilLinkRequest> Requests(4);
+  Requests[0].Entry = "entry";
+  Requests[0].Profile = "cs_6_0";
+  Requests[1].Profile = "lib_6_3";
+  Requests[2].Entry = "missing";
+  Requests[2].Profile = "cs_6_0";
+  Requests[3].Entry = "entry";
+  Requests[3].Profile = "cs_6_0";
+  Requests[3].Specializations.push_back("Missing=1");
+
+  std::vector<DxilLinkResult> Results;
+  pLinker->LinkParallel(Requests, 2, Results);
+  VERIFY_ARE_EQUAL(Requests.size(), Results.size());
+
+  auto Print = [](Module &M) {
+    std::string Text;
+    raw_string_ostream OS(Text);
+    M.print(OS, nullptr);
+    return OS.str();
+  };
+
+  // Each request linked on its own gives the same module, or the same
+  // errors.
+  for (size_t i = 0; i < Requests.size(); ++i) {
+    SerialDiags.clear();
+    pLinker->SetSpecializations(Requests[i].Specializations);
+    dxilutil::ExportMap exportMap;
+    std::unique_ptr<Module> pSerial =
+        pLinker->Link(Requests[i].Entry, Requests[i].Profile, exportMap);
+    DiagStream.flush();
+
+    const DxilLinkResult &Result = Results[i];
+    VERIFY_ARE_EQUAL(!pSerial, Result.HasErrors);
+    VERIFY_ARE_EQUAL(!pSerial, !Result.Module);
+    if (pSerial) {
+      VERIFY_ARE_EQUAL(Print(*pSerial), Print(*Result.Module));
+    } else {
+      VERIFY_IS_FALSE(Result.Diagnostics.empty());
+      VERIFY_ARE_EQUAL(SerialDiags, Result.Diagnostics);
+    }
+  }
+  VERIFY_IS_TRUE(Results[0].Module && Results[1].Module);
+  VERIFY_IS_TRUE(Results[2].Diagnostics.find(
+                     "Cannot find definition of function missing") !=
+                 std::string::npos);
+  VERIFY_IS_TRUE(
+      Results[3].Diagnostics.find(
+          "Cannot find 32-bit scalar constant buffer field to specialize: Missing") !=
+      std::string::npos);
+}
+
+TEST_F(LinkerTest, RunLinkBlockAddress) {
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_cs_entry.hlsl", &pEntryLib);
+
+  LLVMContext Ctx;
+  std::string Diags;
+  raw_string_ostream DiagStream(Diags);
+  DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+  PrintDiagnosticContext DiagContext(DiagPrinter);
+  Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
+                           &DiagContext, true);
+
+  std::unique_ptr<Module> pModule, pDebugModule;
+  VERIFY_SUCCEEDED(ValidateLoadModuleFromContainerLazy(
+      pEntryLib->GetBufferPointer(), pEntryLib->GetBufferSize(), pModule,
+      pDebugModule, Ctx, Ctx, DiagStream));
+
+  // ba_target is cloned before ba_user, which takes the address of one of
+  // its blocks; the linker drops ba_target's other blocks from its value
+  // map once it is cloned, but must keep that one.
+  //   define void @ba_target(i8*) {
+  //   entry:
+  //     br label %target
+  //   target:
+  //     ret void
+  //   }
+  //   define void @ba_user() {
+  //     call void @ba_target(i8* blockaddress(@ba_target, %target))
+  //     ret void
+  //   }
+  Type *VoidTy = Type::getVoidTy(Ctx);
+  Type *I8PtrTy = Type::getInt8PtrTy(Ctx);
+  Function *TargetF = Function::Create(
+      FunctionType::get(VoidTy, { I8PtrTy }, false),
+      GlobalValue::ExternalLinkage, "ba_target", pModule.get());
+  BasicBlock *TargetEntry = BasicBlock::Create(Ctx, "entry", TargetF);
+  BasicBlock *TargetBlock = BasicBlock::Create(Ctx, "target", TargetF);
+  BranchInst::Create(TargetBlock, TargetEntry);
+  ReturnInst::Create(Ctx, TargetBlock);
+  Function *UserF = Function::Create(FunctionType::get(VoidTy, false),
+                                     GlobalValue::ExternalLinkage, "ba_user",
+                                     pModule.get());
+  IRBuilder<> Builder(BasicBlock::Create(Ctx, "entry", UserF));
+  Builder.CreateCall(TargetF, { BlockAddress::get(TargetF, TargetBlock) });
+  Builder.CreateRetVoid();
+
+  std::unique_ptr<DxilLinker> pLinker(
+      DxilLinker::CreateLinker(Ctx, DXIL::kDxilMajor, DXIL::kDxilMinor));
+  VERIFY_IS_TRUE(pLinker->RegisterLib("entry", std::move(pModule),
+                                      std::move(pDebugModule)));
+  VERIFY_IS_TRUE(pLinker->AttachLib("entry"));
+
+  dxilutil::ExportMap exportMap;
+  std::unique_ptr<Module> pLinked = pLinker->Link("", "lib_6_3", exportMap);
+  DiagStream.flush();
+  VERIFY_IS_TRUE(pLinked != nullptr);
+  VERIFY_IS_FALSE(verifyModule(*pLinked, &DiagStream));
+  DiagStream.flush();
+  VERIFY_IS_TRUE(Diags.empty());
+
+  // The linked blockaddress names the linked copy of the block.
+  Function *NewTarget = pLinked->getFunction("ba_target");
+  Function *NewUser = pLinked->getFunction("ba_user");
+  VERIFY_IS_TRUE(NewTarget && NewUser && !NewUser->isDeclaration());
+  BlockAddress *BA = nullptr;
+  for (Instruction &I : NewUser->getEntryBlock()) {
+    if (CallInst *CI = dyn_cast<CallInst>(&I))
+      BA = dyn_cast<BlockAddress>(CI->getArgOperand(0));
+  }
+  VERIFY_IS_TRUE(BA != nullptr);
+  VERIFY_ARE_EQUAL(NewTarget, BA->getFunction());
+  VERIFY_ARE_EQUAL(NewTarget, BA->getBasicBlock()->getParent());
+  VERIFY_IS_TRUE(BA->getBasicBlock()->hasAddressTaken());
+}
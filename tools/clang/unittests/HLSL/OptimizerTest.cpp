@@ -66,6 +66,8 @@ public:
   TEST_METHOD(OptimizerWhenSlice2ThenOK)
   TEST_METHOD(OptimizerWhenSlice3ThenOK)
   TEST_METHOD(OptimizerWhenSliceWithIntermediateOptionsThenOK)
+  TEST_METHOD(OptimizerSessionWhenRunTwiceThenMatchesRunOptimizer)
+  TEST_METHOD(OptimizerSessionWhenRunVariantsThenMatchesRunOptimizer)
 
   void OptimizerWhenSliceNThenOK(int optLevel);
   void OptimizerWhenSliceNThenOK(int optLevel, LPCSTR pText, LPCWSTR pTarget, llvm::ArrayRef<LPCWSTR> args = {});
@@ -120,6 +122,133 @@ TEST_F(OptimizerTest, OptimizerWhenSliceWithIntermediateOptionsThenOK) {
   OptimizerWhenSliceNThenOK(1, SampleProgram, L"ps_6_0", { L"-flegacy-resource-reservation" });
 }
 
+TEST_F(OptimizerTest, OptimizerSessionWhenRunTwiceThenMatchesRunOptimizer) {
+  LPCSTR SampleProgram =
+    "float4 main(float4 pos : SV_Position, bool b : B) : SV_Target {\r\n"
+    "  float4 r = pos;\r\n"
+    "  if (b) r = r * 2;\r\n"
+    "  return r;\r\n"
+    "}";
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOptimizer2> pOptimizer;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pHighLevelBlob;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+  Utf8ToBlob(m_dllSupport, SampleProgram, &pSource);
+  LPCWSTR highLevelArgs[] = { L"/fcgl" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main", L"ps_6_0",
+    highLevelArgs, _countof(highLevelArgs), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pHighLevelBlob));
+
+  LPCWSTR firstPasses[] = { L"-mem2reg" };
+  LPCWSTR secondPasses[] = { L"-simplifycfg", L"-S" };
+  LPCWSTR printOnly[] = { L"-S" };
+
+  // Round-trip through bitcode between the two runs.
+  CComPtr<IDxcBlob> pFirstModule;
+  CComPtr<IDxcBlobEncoding> pFirstText;
+  CComPtr<IDxcBlobEncoding> pExpectedText;
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pHighLevelBlob, firstPasses,
+    _countof(firstPasses), &pFirstModule, nullptr));
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pFirstModule, printOnly,
+    _countof(printOnly), nullptr, &pFirstText));
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pFirstModule, secondPasses,
+    _countof(secondPasses), nullptr, &pExpectedText));
+
+  // Keep the module in a session instead, forking it after the first run.
+  CComPtr<IDxcOptimizerSession> pSession;
+  CComPtr<IDxcOptimizerSession> pClone;
+  CComPtr<IDxcBlobEncoding> pSessionText;
+  CComPtr<IDxcBlobEncoding> pCloneText;
+  VERIFY_SUCCEEDED(pOptimizer->CreateSession(pHighLevelBlob, &pSession));
+  VERIFY_SUCCEEDED(pSession->Run(firstPasses, _countof(firstPasses), nullptr));
+  VERIFY_SUCCEEDED(pSession->Clone(&pClone));
+  VERIFY_SUCCEEDED(pSession->Run(secondPasses, _countof(secondPasses), &pSessionText));
+  VERIFY_ARE_EQUAL_STR(BlobToUtf8(pExpectedText).c_str(),
+                       BlobToUtf8(pSessionText).c_str());
+
+  // The clone is unaffected by the second run.
+  VERIFY_SUCCEEDED(pClone->Run(printOnly, _countof(printOnly), &pCloneText));
+  VERIFY_ARE_EQUAL_STR(BlobToUtf8(pFirstText).c_str(),
+                       BlobToUtf8(pCloneText).c_str());
+
+  // The module written by the session can be loaded again.
+  CComPtr<IDxcBlob> pSessionModule;
+  CComPtr<IDxcBlobEncoding> pReloadedText;
+  VERIFY_SUCCEEDED(pSession->GetModule(&pSessionModule));
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pSessionModule, printOnly,
+    _countof(printOnly), nullptr, &pReloadedText));
+  VERIFY_IS_TRUE(0 < BlobToUtf8(pReloadedText).size());
+}
+
+TEST_F(OptimizerTest, OptimizerSessionWhenRunVariantsThenMatchesRunOptimizer) {
+  LPCSTR SampleProgram =
+    "float4 main(float4 pos : SV_Position, bool b : B) : SV_Target {\r\n"
+    "  float4 r = pos;\r\n"
+    "  if (b) r = r * 2;\r\n"
+    "  return r;\r\n"
+    "}";
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOptimizer2> pOptimizer;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pHighLevelBlob;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+  Utf8ToBlob(m_dllSupport, SampleProgram, &pSource);
+  LPCWSTR highLevelArgs[] = { L"/fcgl" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main", L"ps_6_0",
+    highLevelArgs, _countof(highLevelArgs), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pHighLevelBlob));
+
+  LPCWSTR firstPasses[] = { L"-mem2reg", L"-S" };
+  LPCWSTR secondPasses[] = { L"-simplifycfg", L"-S" };
+  LPCWSTR badPasses[] = { L"-no-such-pass" };
+  DxcOptimizerVariant variants[] = {
+    { firstPasses, _countof(firstPasses) },
+    { secondPasses, _countof(secondPasses) },
+  };
+
+  CComPtr<IDxcOptimizerSession> pSession;
+  CComPtr<IDxcOptimizerSession2> pSession2;
+  VERIFY_SUCCEEDED(pOptimizer->CreateSession(pHighLevelBlob, &pSession));
+  VERIFY_SUCCEEDED(pSession.QueryInterface(&pSession2));
+
+  IDxcBlob *pModules[_countof(variants)] = {};
+  IDxcBlobEncoding *pTexts[_countof(variants)] = {};
+  VERIFY_SUCCEEDED(pSession2->RunVariants(variants, _countof(variants),
+                                          pModules, pTexts));
+  for (UINT32 i = 0; i < _countof(variants); ++i) {
+    CComPtr<IDxcBlob> pModule;
+    CComPtr<IDxcBlobEncoding> pText;
+    CComPtr<IDxcBlobEncoding> pExpectedText;
+    pModule.Attach(pModules[i]);
+    pText.Attach(pTexts[i]);
+    VERIFY_IS_NOT_NULL(pModule.p);
+    VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pHighLevelBlob,
+      variants[i].pOptions, variants[i].OptionCount, nullptr, &pExpectedText));
+    VERIFY_ARE_EQUAL_STR(BlobToUtf8(pExpectedText).c_str(),
+                         BlobToUtf8(pText).c_str());
+  }
+
+  // A failing variant reports its error without affecting the others.
+  variants[1].pOptions = badPasses;
+  variants[1].OptionCount = _countof(badPasses);
+  IDxcBlob *pMixedModules[_countof(variants)] = {};
+  VERIFY_FAILED(pSession2->RunVariants(variants, _countof(variants),
+                                       pMixedModules, nullptr));
+  CComPtr<IDxcBlob> pGoodModule;
+  pGoodModule.Attach(pMixedModules[0]);
+  VERIFY_IS_NOT_NULL(pGoodModule.p);
+  VERIFY_IS_NULL(pMixedModules[1]);
+}
+
 void OptimizerTest::OptimizerWhenSliceNThenOK(int optLevel) {
   LPCSTR SampleProgram =
     "Texture2D g_Tex;\r\n"
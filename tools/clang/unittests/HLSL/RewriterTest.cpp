@@ -87,6 +87,7 @@ public:
   TEST_METHOD(RunNoStatic);
   TEST_METHOD(RunKeepUserMacro);
   TEST_METHOD(RunExtractUniforms);
+  TEST_METHOD(RunRemoveUnusedGlobalsForEntryPoints);
   TEST_METHOD(RunRewriterFails)
 
   dxc::DxcDllSupport m_dllSupport;
@@ -687,6 +688,62 @@ void FloatFunc(uint3 id : SV_DispatchThreadID) {\n\
 ") == 0);
 }
 
+TEST_F(RewriterTest, RunRemoveUnusedGlobalsForEntryPoints) {
+  CComPtr<IDxcRewriter> pRewriter;
+  CComPtr<IDxcRewriter3> pRewriter3;
+  VERIFY_SUCCEEDED(CreateRewriter(&pRewriter));
+  VERIFY_SUCCEEDED(pRewriter->QueryInterface(&pRewriter3));
+
+  const char source[] =
+    "static float gA = 1;\n"
+    "static float gB = 2;\n"
+    "float GetA() { return gA; }\n"
+    "float GetB() { return gB; }\n"
+    "float4 mainA() : SV_Target { return GetA(); }\n"
+    "float4 mainB() : SV_Target { return GetB(); }\n";
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobPinned(source, sizeof(source) - 1, CP_UTF8, &pSource);
+
+  // One parse serves every entry point; each gets its own result.
+  LPCWSTR entryPoints[] = { L"mainA", L"mainB", L"missing" };
+  IDxcOperationResult *pResults[_countof(entryPoints)];
+  VERIFY_SUCCEEDED(pRewriter3->RemoveUnusedGlobalsForEntryPoints(
+      pSource, entryPoints, _countof(entryPoints), nullptr, 0, pResults));
+  CComPtr<IDxcOperationResult> pResultA, pResultB, pResultMissing;
+  pResultA.Attach(pResults[0]);
+  pResultB.Attach(pResults[1]);
+  pResultMissing.Attach(pResults[2]);
+
+  HRESULT hrStatus;
+  VERIFY_SUCCEEDED(pResultA->GetStatus(&hrStatus));
+  VERIFY_SUCCEEDED(hrStatus);
+  CComPtr<IDxcBlob> pRewriteA;
+  VERIFY_SUCCEEDED(pResultA->GetResult(&pRewriteA));
+  std::string rewriteA = BlobToUtf8(pRewriteA);
+  VERIFY_IS_TRUE(rewriteA.find("gA") != std::string::npos);
+  VERIFY_IS_TRUE(rewriteA.find("GetA") != std::string::npos);
+  VERIFY_IS_TRUE(rewriteA.find("gB") == std::string::npos);
+  VERIFY_IS_TRUE(rewriteA.find("GetB") == std::string::npos);
+  VERIFY_IS_TRUE(rewriteA.find("mainB") == std::string::npos);
+
+  // Declarations hidden for the first entry point are back for the second.
+  VERIFY_SUCCEEDED(pResultB->GetStatus(&hrStatus));
+  VERIFY_SUCCEEDED(hrStatus);
+  CComPtr<IDxcBlob> pRewriteB;
+  VERIFY_SUCCEEDED(pResultB->GetResult(&pRewriteB));
+  std::string rewriteB = BlobToUtf8(pRewriteB);
+  VERIFY_IS_TRUE(rewriteB.find("gB") != std::string::npos);
+  VERIFY_IS_TRUE(rewriteB.find("GetB") != std::string::npos);
+  VERIFY_IS_TRUE(rewriteB.find("gA") == std::string::npos);
+  VERIFY_IS_TRUE(rewriteB.find("mainA") == std::string::npos);
+
+  VERIFY_SUCCEEDED(pResultMissing->GetStatus(&hrStatus));
+  VERIFY_FAILED(hrStatus);
+  CComPtr<IDxcBlobEncoding> pErrors;
+  VERIFY_SUCCEEDED(pResultMissing->GetErrorBuffer(&pErrors));
+  VERIFY_IS_TRUE(BlobToUtf8(pErrors).find("entry point not found") != std::string::npos);
+}
+
 TEST_F(RewriterTest, RunRewriterFails) {
   CComPtr<IDxcRewriter> pRewriter;
   CComPtr<IDxcRewriter2> pRewriter2;
@@ -350,6 +350,13 @@ void ShaderOpTest::CreateDescriptorHeaps() {
   queryHeapDesc.Count = 1;
   queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS;
   CHECK_HR(m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_pQueryHeap)));
+
+  // Create a begin/end timestamp pair per timed repetition.
+  if (m_TimedRepetitions) {
+    queryHeapDesc.Count = m_TimedRepetitions * 2;
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    CHECK_HR(m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_pTimestampHeap)));
+  }
 }
 
 void ShaderOpTest::CreateDevice() {
@@ -601,6 +608,16 @@ void ShaderOpTest::CreateResources() {
       IID_PPV_ARGS(&m_pQueryBuffer)));
     SetObjectName(m_pQueryBuffer, "Query Pipeline Readback Buffer");
   }
+  if (m_TimedRepetitions) {
+    CComPtr<ID3D12Resource> pReadbackResource;
+    CD3DX12_HEAP_PROPERTIES readback(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC readbackDesc(CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * m_TimedRepetitions * 2));
+    CHECK_HR(m_pDevice->CreateCommittedResource(
+      &readback, D3D12_HEAP_FLAG_NONE, &readbackDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+      IID_PPV_ARGS(&m_pTimestampBuffer)));
+    SetObjectName(m_pTimestampBuffer, "Query Timestamp Readback Buffer");
+  }
 
   CHECK_HR(pList->Close());
   ExecuteCommandList(ResCommandList.Queue, pList);
@@ -741,6 +758,21 @@ void ShaderOpTest::GetPipelineStats(D3D12_QUERY_DATA_PIPELINE_STATISTICS *pStats
   memcpy(pStats, M.data(), sizeof(*pStats));
 }
 
+void ShaderOpTest::GetTimings(std::vector<double> &Microseconds) {
+  Microseconds.clear();
+  if (!m_TimedRepetitions)
+    return;
+  UINT64 frequency;
+  CHECK_HR(m_CommandList.Queue->GetTimestampFrequency(&frequency));
+  MappedData M;
+  M.reset(m_pTimestampBuffer, sizeof(UINT64) * m_TimedRepetitions * 2);
+  const UINT64 *pTimestamps = (const UINT64 *)M.data();
+  for (UINT i = 0; i < m_TimedRepetitions; ++i) {
+    UINT64 ticks = pTimestamps[i * 2 + 1] - pTimestamps[i * 2];
+    Microseconds.push_back((double)ticks * 1000000.0 / (double)frequency);
+  }
+}
+
 void ShaderOpTest::GetReadBackData(LPCSTR pResourceName, MappedData *pData) {
   pResourceName = m_pShaderOp->Strings.insert(pResourceName); // Unique
   ShaderOpResourceData &D = m_ResourceData.at(pResourceName);
@@ -763,15 +795,37 @@ static void SetDescriptorHeaps(ID3D12GraphicsCommandList *pList,
     pList->SetDescriptorHeaps((UINT)localHeaps.size(), localHeaps.data());
 }
 
+void ShaderOpTest::BeginTimedRepetition(ID3D12GraphicsCommandList *pList,
+                                        UINT Index) {
+  if (m_TimedRepetitions)
+    pList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, Index * 2);
+}
+
+void ShaderOpTest::EndTimedRepetition(ID3D12GraphicsCommandList *pList,
+                                      UINT Index) {
+  if (m_TimedRepetitions)
+    pList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, Index * 2 + 1);
+}
+
 void ShaderOpTest::RunCommandList() {
   ID3D12GraphicsCommandList *pList = m_CommandList.List.p;
+  UINT repetitions = m_TimedRepetitions ? m_TimedRepetitions : 1;
   if (m_pShaderOp->IsCompute()) {
     pList->SetPipelineState(m_pPSO);
     pList->SetComputeRootSignature(m_pRootSignature);
     SetDescriptorHeaps(pList, m_DescriptorHeaps);
     SetRootValues(pList, m_pShaderOp->IsCompute());
-    pList->Dispatch(m_pShaderOp->DispatchX, m_pShaderOp->DispatchY,
-                    m_pShaderOp->DispatchZ);
+    for (UINT i = 0; i < repetitions; ++i) {
+      if (i > 0) {
+        // Keep repetitions from overlapping so each is timed on its own.
+        D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+        pList->ResourceBarrier(1, &barrier);
+      }
+      BeginTimedRepetition(pList, i);
+      pList->Dispatch(m_pShaderOp->DispatchX, m_pShaderOp->DispatchY,
+                      m_pShaderOp->DispatchZ);
+      EndTimedRepetition(pList, i);
+    }
   } else {
     pList->SetPipelineState(m_pPSO);
     pList->SetGraphicsRootSignature(m_pRootSignature);
@@ -841,11 +895,19 @@ void ShaderOpTest::RunCommandList() {
     UINT vertexCountPerInstance = vertexCount / instanceCount;
 
     pList->BeginQuery(m_pQueryHeap, D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0);
-    pList->DrawInstanced(vertexCountPerInstance, instanceCount, 0, 0);
+    for (UINT i = 0; i < repetitions; ++i) {
+      BeginTimedRepetition(pList, i);
+      pList->DrawInstanced(vertexCountPerInstance, instanceCount, 0, 0);
+      EndTimedRepetition(pList, i);
+    }
     pList->EndQuery(m_pQueryHeap, D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0);
     pList->ResolveQueryData(m_pQueryHeap, D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
                             0, 1, m_pQueryBuffer, 0);
   }
+  if (m_TimedRepetitions) {
+    pList->ResolveQueryData(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 0,
+                            m_TimedRepetitions * 2, m_pTimestampBuffer, 0);
+  }
   CHECK_HR(pList->Close());
   ExecuteCommandList(m_CommandList.Queue, pList);
   WaitForSignal(m_CommandList.Queue, m_pFence, m_hFence, m_FenceValue++);
@@ -941,6 +1003,10 @@ void ShaderOpTest::SetInitCallback(TInitCallbackFn InitCallbackFn) {
   m_InitCallbackFn = InitCallbackFn;
 }
 
+void ShaderOpTest::SetTimedRepetitions(UINT Count) {
+  m_TimedRepetitions = Count;
+}
+
 void ShaderOpTest::SetupRenderTarget(ShaderOp *pShaderOp, ID3D12Device *pDevice,
                                      ID3D12CommandQueue *pCommandQueue,
                                      ID3D12Resource *pRenderTarget) {
@@ -241,11 +241,18 @@ public:
   typedef std::function<void(LPCSTR Name, std::vector<BYTE> &Data, ShaderOp *pShaderOp)> TInitCallbackFn;
   void GetPipelineStats(D3D12_QUERY_DATA_PIPELINE_STATISTICS *pStats);
   void GetReadBackData(LPCSTR pResourceName, MappedData *pData);
+  // Returns the GPU time of each timed repetition, in microseconds.
+  void GetTimings(std::vector<double> &Microseconds);
   void RunShaderOp(ShaderOp *pShaderOp);
   void RunShaderOp(std::shared_ptr<ShaderOp> pShaderOp);
   void SetDevice(ID3D12Device* pDevice);
   void SetDxcSupport(dxc::DxcDllSupport *pDxcSupport);
   void SetInitCallback(TInitCallbackFn InitCallbackFn);
+  // Repeats the Draw/Dispatch call Count times, bracketing each repetition
+  // with timestamp queries. Zero, the default, runs it once without timing.
+  // Repetitions share resources, so read back data is only meaningful for
+  // idempotent operations.
+  void SetTimedRepetitions(UINT Count);
   void SetupRenderTarget(ShaderOp *pShaderOp, ID3D12Device *pDevice,
                          ID3D12CommandQueue *pCommandQueue,
                          ID3D12Resource *pRenderTarget);
@@ -271,6 +278,9 @@ private:
   CComPtr<ID3D12RootSignature> m_pRootSignature;
   CComPtr<ID3D12QueryHeap> m_pQueryHeap;
   CComPtr<ID3D12Resource> m_pQueryBuffer;
+  CComPtr<ID3D12QueryHeap> m_pTimestampHeap;
+  CComPtr<ID3D12Resource> m_pTimestampBuffer;
+  UINT m_TimedRepetitions = 0;
   dxc::DxcDllSupport *m_pDxcSupport = nullptr;
   CommandListRefs m_CommandList;
   HANDLE m_hFence;
@@ -283,6 +293,7 @@ private:
   std::vector<ID3D12DescriptorHeap *> m_DescriptorHeaps;
   std::shared_ptr<ShaderOp> m_OrigShaderOp;
   TInitCallbackFn m_InitCallbackFn = nullptr;
+  void BeginTimedRepetition(ID3D12GraphicsCommandList *pList, UINT Index);
   void CopyBackResources();
   void CreateCommandList();
   void CreateDescriptorHeaps();
@@ -291,6 +302,7 @@ private:
   void CreateResources();
   void CreateRootSignature();
   void CreateShaders();
+  void EndTimedRepetition(ID3D12GraphicsCommandList *pList, UINT Index);
   void RunCommandList();
   void SetRootValues(ID3D12GraphicsCommandList *pList, bool isCompute);
 };
@@ -20,6 +20,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/DxilContainer/DxilContainerAssembler.h"
+#include "dxc/HLSL/DxilValidation.h"
 
 #ifdef _WIN32
 #include <atlbase.h>
@@ -110,6 +111,10 @@ public:
   TEST_METHOD(InfiniteDdxDdy)
   TEST_METHOD(IDivByZero)
   TEST_METHOD(UDivByZero)
+  TEST_METHOD(UDivByZeroInLargeLibrary)
+  TEST_METHOD(StructuredResultStopsAtMaxErrors)
+  TEST_METHOD(ModuleValidatorWhenBuildKeyDiffersThenNotImpl)
+  TEST_METHOD(ValidationCacheWhenContainerPassedThenSecondValidationHits)
   TEST_METHOD(UnusedMetadata)
   TEST_METHOD(MemoryOutOfBound)
   TEST_METHOD(LocalRes2)
@@ -1464,6 +1469,153 @@ TEST_F(ValidationTest, UDivByZero) {
       /*bRegex*/true);
 }
 
+TEST_F(ValidationTest, UDivByZeroInLargeLibrary) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  // Enough functions for their bodies to be validated in parallel.
+  std::string source;
+  for (unsigned i = 0; i < 128; ++i) {
+    source += "export uint F" + std::to_string(i) +
+              "(uint a, uint b) { return a / b + " + std::to_string(i) +
+              "; }\n";
+  }
+  RewriteAssemblyCheckMsg(
+    source.c_str(), "lib_6_3",
+    { "udiv i32 ([^,]+), %[^\n]+", "udiv i32 ([^,]+), %[^\n]+" },
+    { "udiv i32 \\1, 0", "udiv i32 \\1, 0" },
+    { "No unsigned integer division by zero",
+      "No unsigned integer division by zero" },
+    /*bRegex*/true);
+}
+
+TEST_F(ValidationTest, StructuredResultStopsAtMaxErrors) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  if (!m_ver.m_InternalValidator) {
+    WEX::Logging::Log::Comment(L"Test skipped; structured results need the internal validator.");
+    return;
+  }
+  CComPtr<IDxcBlobEncoding> pSource;
+  Utf8ToBlob(m_dllSupport,
+    "export uint F0(uint a, uint b) { return a / b; }\n"
+    "export uint F1(uint a, uint b) { return a / b + 1; }\n", &pSource);
+  CComPtr<IDxcBlob> pText;
+  if (!RewriteAssemblyToText(pSource, "lib_6_3", nullptr, 0, nullptr, 0,
+        { "udiv i32 ([^,]+), %[^\n]+", "udiv i32 ([^,]+), %[^\n]+" },
+        { "udiv i32 \\1, 0", "udiv i32 \\1, 0" }, &pText, /*bRegex*/true))
+    return;
+
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcOperationResult> pAssembleResult;
+  CComPtr<IDxcBlob> pContainer;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  VERIFY_SUCCEEDED(pAssembler->AssembleToContainer(pText, &pAssembleResult));
+  VERIFY_SUCCEEDED(pAssembleResult->GetResult(&pContainer));
+
+  CComPtr<IDxcStructuredValidator> pValidator;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+
+  for (UINT32 maxErrors : { 0u, 1u }) {
+    CComPtr<IDxcValidationResult> pResult;
+    VERIFY_SUCCEEDED(pValidator->ValidateStructured(
+        pContainer, DxcValidatorFlags_Default, maxErrors, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_ARE_EQUAL(DXC_E_IR_VERIFICATION_FAILED, status);
+    VERIFY_ARE_EQUAL(maxErrors ? 1u : 2u, pResult->GetErrorCount());
+
+    DxcValidationError error;
+    VERIFY_SUCCEEDED(pResult->GetError(0, &error));
+    VERIFY_ARE_EQUAL((UINT32)hlsl::ValidationRule::InstrNoUDivByZero, error.Rule);
+    VERIFY_IS_NOT_NULL(error.pFunctionName);
+    VERIFY_IS_TRUE(strstr(error.pFunctionName, "F0") != nullptr);
+    VERIFY_ARE_NOT_EQUAL(UINT32_MAX, error.InstructionIndex);
+    VERIFY_FAILED(pResult->GetError(pResult->GetErrorCount(), &error));
+  }
+}
+
+TEST_F(ValidationTest, ModuleValidatorWhenBuildKeyDiffersThenNotImpl) {
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcModuleValidator> pModuleValidator;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+  if (FAILED(pValidator.QueryInterface(&pModuleValidator))) {
+    WEX::Logging::Log::Comment(L"Test skipped; validator does not accept modules.");
+    return;
+  }
+
+  CComPtr<IDxcBlob> pContainer;
+  CompileSource("float4 main() : SV_Target { return 1; }", "ps_6_0", &pContainer);
+  // The module is never looked at when the key does not match, so any
+  // non-null pointer will do.
+  int NotAModule = 0;
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_ARE_EQUAL(E_NOTIMPL, pModuleValidator->ValidateWithModule(
+      pContainer, DxcValidatorFlags_Default, 0, &NotAModule, &pResult));
+  VERIFY_ARE_EQUAL(E_INVALIDARG, pModuleValidator->ValidateWithModule(
+      pContainer, DxcValidatorFlags_Default, 0, nullptr, &pResult));
+}
+
+// Cache store that counts the lookups which found a value.
+class ValidationTestCacheStore : public IDxcCompileCacheStore {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  std::map<std::string, CComPtr<IDxcBlob>> m_values;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  ValidationTestCacheStore() : m_dwRef(0) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** ppvObject) override {
+    return DoBasicQueryInterface<IDxcCompileCacheStore>(this, iid, ppvObject);
+  }
+
+  UINT32 HitCount = 0;
+  size_t size() const { return m_values.size(); }
+
+  HRESULT STDMETHODCALLTYPE Lookup(const DxcBuffer *pKey, IDxcBlob **ppValue) override {
+    auto it = m_values.find(std::string((const char *)pKey->Ptr, pKey->Size));
+    if (it == m_values.end()) {
+      *ppValue = nullptr;
+      return S_FALSE;
+    }
+    ++HitCount;
+    return it->second.p->QueryInterface(ppValue);
+  }
+  HRESULT STDMETHODCALLTYPE Store(const DxcBuffer *pKey, IDxcBlob *pValue) override {
+    m_values[std::string((const char *)pKey->Ptr, pKey->Size)] = pValue;
+    return S_OK;
+  }
+};
+
+TEST_F(ValidationTest, ValidationCacheWhenContainerPassedThenSecondValidationHits) {
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcValidationCache> pCache;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+  if (FAILED(pValidator.QueryInterface(&pCache))) {
+    WEX::Logging::Log::Comment(L"Test skipped; validator does not cache verdicts.");
+    return;
+  }
+  CComPtr<ValidationTestCacheStore> pStore = new ValidationTestCacheStore();
+  VERIFY_SUCCEEDED(pCache->SetStore(pStore));
+
+  CComPtr<IDxcBlob> pContainer;
+  CompileSource("float4 main() : SV_Target { return 1; }", "ps_6_0", &pContainer);
+  for (unsigned i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pValidator->Validate(pContainer, DxcValidatorFlags_Default, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+  }
+  VERIFY_ARE_EQUAL(1u, pStore->HitCount);
+  VERIFY_ARE_EQUAL(1u, pStore->size());
+
+  // Failures are not recorded: the container has no root signature.
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pValidator->Validate(
+      pContainer, DxcValidatorFlags_RootSignatureOnly, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_FAILED(status);
+  VERIFY_ARE_EQUAL(1u, pStore->HitCount);
+  VERIFY_ARE_EQUAL(1u, pStore->size());
+}
+
 TEST_F(ValidationTest, UnusedMetadata) {
   RewriteAssemblyCheckMsg(L"..\\DXILValidation\\loop2.hlsl", "ps_6_0",
                           ", !llvm.loop ",
@@ -38,6 +38,7 @@ public:
   TEST_METHOD(RunArrayLength)
   TEST_METHOD(RunAttributes)
   TEST_METHOD(RunBuiltinTypesNoInheritance)
+  TEST_METHOD(RunBuiltinTypesLookup)
   TEST_METHOD(RunConstExpr)
   TEST_METHOD(RunConstAssign)
   TEST_METHOD(RunConstDefault)
@@ -158,6 +159,10 @@ TEST_F(VerifierTest, RunBuiltinTypesNoInheritance) {
   CheckVerifiesHLSL(L"builtin-types-no-inheritance.hlsl");
 }
 
+TEST_F(VerifierTest, RunBuiltinTypesLookup) {
+  CheckVerifiesHLSL(L"builtin-types-lookup.hlsl");
+}
+
 TEST_F(VerifierTest, RunConstExpr) {
   CheckVerifiesHLSL(L"const-expr.hlsl");
 }
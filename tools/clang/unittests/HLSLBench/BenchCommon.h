@@ -0,0 +1,30 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// BenchCommon.h                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Declares helpers shared by the compiler micro-benchmarks.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+#include <vector>
+
+namespace hlslbench {
+
+// Returns the compiler loaded by main, or null if it could not be loaded;
+// benchmarks that need it should skip themselves in that case.
+dxc::DxcDllSupport *GetDxcSupport();
+
+// Compiles pSource with the given arguments and returns the result, or
+// returns a failure if the compiler is missing or the compile fails.
+HRESULT Compile(const char *pSource, const std::vector<LPCWSTR> &args,
+                IDxcIncludeHandler *pIncludeHandler, IDxcResult **ppResult);
+
+} // namespace hlslbench
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// BenchMain.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the compiler micro-benchmarks.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BenchCommon.h"
+#include "dxc/Support/Global.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "benchmark/benchmark.h"
+#include <memory>
+
+namespace hlslbench {
+
+static dxc::DxcDllSupport *g_pDxcSupport = nullptr;
+
+dxc::DxcDllSupport *GetDxcSupport() { return g_pDxcSupport; }
+
+HRESULT Compile(const char *pSource, const std::vector<LPCWSTR> &args,
+                IDxcIncludeHandler *pIncludeHandler, IDxcResult **ppResult) {
+  if (!g_pDxcSupport)
+    return E_NOTIMPL;
+  CComPtr<IDxcCompiler3> pCompiler;
+  IFR(g_pDxcSupport->CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  DxcBuffer source;
+  source.Ptr = pSource;
+  source.Size = strlen(pSource);
+  source.Encoding = DXC_CP_UTF8;
+  IFR(pCompiler->Compile(&source, const_cast<LPCWSTR *>(args.data()),
+                         (UINT32)args.size(), pIncludeHandler,
+                         IID_PPV_ARGS(ppResult)));
+  HRESULT status;
+  IFR((*ppResult)->GetStatus(&status));
+  return status;
+}
+
+} // namespace hlslbench
+
+int main(int argc, char **argv) {
+  if (llvm::sys::fs::SetupPerThreadFileSystem())
+    return 1;
+  llvm::sys::fs::AutoCleanupPerThreadFileSystem auto_cleanup_fs;
+  if (FAILED(DxcInitThreadMalloc()))
+    return 1;
+  DxcSetThreadMallocToDefault();
+
+  // Benchmarks run on this thread, so one file system serves all of them.
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (FAILED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+  if (pts.error_code())
+    return 1;
+
+  dxc::DxcDllSupport dxcSupport;
+  if (SUCCEEDED(dxcSupport.Initialize()))
+    hlslbench::g_pDxcSupport = &dxcSupport;
+  else
+    fprintf(stderr, "warning: dxcompiler could not be loaded; compiler benchmarks are skipped\n");
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+
+  hlslbench::g_pDxcSupport = nullptr;
+  DxcClearThreadMalloc();
+  DxcCleanupThreadMalloc();
+  return 0;
+}
@@ -0,0 +1,241 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// CompilerBench.cpp                                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Micro-benchmarks for components reached through the compiler API.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BenchCommon.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilRuntimeReflection.h"
+#include "dxc/dxcisense.h"
+#include "benchmark/benchmark.h"
+#include <string>
+#include <vector>
+
+using namespace hlsl;
+using namespace hlslbench;
+
+namespace {
+
+// Source for a library with Count exported functions, each using a
+// resource, so RDAT has function, resource and index rows.
+std::string GetLibrarySource(unsigned Count) {
+  std::string Source;
+  for (unsigned i = 0; i < Count; ++i) {
+    std::string N = std::to_string(i);
+    Source += "RWByteAddressBuffer buf" + N + ";\n"
+              "export float f" + N + "(float x) {\n"
+              "  buf" + N + ".Store(0, asuint(x));\n"
+              "  return x * " + N + ";\n}\n";
+  }
+  return Source;
+}
+
+const char kReflectedShader[] =
+  "cbuffer Constants { float4x4 World; float4x4 ViewProj; float4 Tint; };\n"
+  "Texture2D<float4> Albedo : register(t0);\n"
+  "Texture2D<float4> Normal : register(t1);\n"
+  "SamplerState Linear : register(s0);\n"
+  "struct PSIn { float4 pos : SV_Position; float2 uv : TEXCOORD0; float3 n : NORMAL; };\n"
+  "float4 main(PSIn i) : SV_Target {\n"
+  "  float3 n = normalize(mul((float3x3)World, i.n + Normal.Sample(Linear, i.uv).xyz));\n"
+  "  return Albedo.Sample(Linear, i.uv) * Tint * saturate(dot(n, float3(0, 1, 0)));\n"
+  "}\n";
+
+HRESULT CompileToContainer(const char *pSource, const std::vector<LPCWSTR> &Args,
+                           IDxcBlob **ppContainer) {
+  CComPtr<IDxcResult> pResult;
+  IFR(Compile(pSource, Args, nullptr, &pResult));
+  return pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(ppContainer), nullptr);
+}
+
+// Opening a container for reflection, as tools and runtimes do per shader.
+void BM_ContainerReflectionLoad(benchmark::State &state) {
+  CComPtr<IDxcBlob> pContainer;
+  if (FAILED(CompileToContainer(kReflectedShader, { L"-E", L"main", L"-T", L"ps_6_0" },
+                                &pContainer))) {
+    state.SkipWithError("compiler unavailable or compile failed");
+    return;
+  }
+  while (state.KeepRunning()) {
+    CComPtr<IDxcContainerReflection> pReflection;
+    GetDxcSupport()->CreateInstance(CLSID_DxcContainerReflection, &pReflection);
+    pReflection->Load(pContainer);
+    UINT32 Index = 0;
+    pReflection->FindFirstPartKind(DFCC_DXIL, &Index);
+#ifdef _WIN32
+    CComPtr<ID3D12ShaderReflection> pShaderReflection;
+    pReflection->GetPartReflection(Index, IID_PPV_ARGS(&pShaderReflection));
+    benchmark::DoNotOptimize(pShaderReflection.p);
+#else
+    benchmark::DoNotOptimize(Index);
+#endif
+  }
+}
+BENCHMARK(BM_ContainerReflectionLoad);
+
+// Walking every function of a library's runtime data and its resources.
+void BM_RdatTableIteration(benchmark::State &state) {
+  unsigned Count = (unsigned)state.range(0);
+  std::string Source = GetLibrarySource(Count);
+  CComPtr<IDxcBlob> pContainer;
+  if (FAILED(CompileToContainer(Source.c_str(), { L"-T", L"lib_6_3" }, &pContainer))) {
+    state.SkipWithError("compiler unavailable or compile failed");
+    return;
+  }
+  const DxilContainerHeader *pHeader =
+      IsDxilContainerLike(pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+  const DxilPartHeader *pPart =
+      pHeader ? GetDxilPartByType(pHeader, DFCC_RuntimeData) : nullptr;
+  if (!pPart) {
+    state.SkipWithError("no RDAT part");
+    return;
+  }
+  while (state.KeepRunning()) {
+    DxilRuntimeData Data(GetDxilPartData(pPart), pPart->PartSize);
+    FunctionTableReader *pFunctions = Data.GetFunctionTableReader();
+    size_t Total = 0;
+    for (uint32_t i = 0; i < pFunctions->GetNumFunctions(); ++i) {
+      FunctionReader Function = pFunctions->GetItem(i);
+      Total += strlen(Function.GetUnmangledName());
+      for (uint32_t r = 0; r < Function.GetNumResources(); ++r)
+        Total += Function.GetResource(r).GetID();
+    }
+    benchmark::DoNotOptimize(Total);
+  }
+  state.SetItemsProcessed(state.iterations() * Count);
+}
+BENCHMARK(BM_RdatTableIteration)->Arg(16)->Arg(256);
+
+// Looking up every function of a library's runtime data by mangled name.
+void BM_RdatFindFunction(benchmark::State &state) {
+  unsigned Count = (unsigned)state.range(0);
+  std::string Source = GetLibrarySource(Count);
+  CComPtr<IDxcBlob> pContainer;
+  if (FAILED(CompileToContainer(Source.c_str(), { L"-T", L"lib_6_3" }, &pContainer))) {
+    state.SkipWithError("compiler unavailable or compile failed");
+    return;
+  }
+  const DxilContainerHeader *pHeader =
+      IsDxilContainerLike(pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+  const DxilPartHeader *pPart =
+      pHeader ? GetDxilPartByType(pHeader, DFCC_RuntimeData) : nullptr;
+  if (!pPart) {
+    state.SkipWithError("no RDAT part");
+    return;
+  }
+  DxilRuntimeData Data(GetDxilPartData(pPart), pPart->PartSize);
+  FunctionTableReader *pFunctions = Data.GetFunctionTableReader();
+  std::vector<std::string> Names;
+  for (uint32_t i = 0; i < pFunctions->GetNumFunctions(); ++i)
+    Names.push_back(pFunctions->GetItem(i).GetName());
+  while (state.KeepRunning()) {
+    for (const std::string &Name : Names)
+      benchmark::DoNotOptimize(pFunctions->FindFunction(Name.c_str()).GetName());
+  }
+  state.SetItemsProcessed(state.iterations() * Names.size());
+}
+BENCHMARK(BM_RdatFindFunction)->Arg(16)->Arg(256);
+
+// Sema of a body made only of intrinsic calls over many argument types,
+// which is dominated by intrinsic lookup and overload resolution.
+void BM_IntrinsicLookup(benchmark::State &state) {
+  static const char *Types[] = { "float", "float2", "float3", "float4",
+                                 "half", "half3", "int", "int4", "uint2" };
+  static const char *Calls[] = { "abs(v)", "saturate(v)", "max(v, v)",
+                                 "lerp(v, v, v)", "clamp(v, v, v)", "sign(v)",
+                                 "dot(v, v)", "any(v)", "min(v, v)" };
+  std::string Source;
+  unsigned Count = 0;
+  for (const char *Ty : Types) {
+    Source += std::string("void test_") + Ty + "(" + Ty + " v) {\n";
+    for (unsigned r = 0; r < 8; ++r) {
+      for (const char *Call : Calls) {
+        Source += std::string("  ") + Call + ";\n";
+        ++Count;
+      }
+    }
+    Source += "}\n";
+  }
+
+  dxc::DxcDllSupport *pSupport = GetDxcSupport();
+  CComPtr<IDxcIntelliSense> pIsense;
+  CComPtr<IDxcIndex> pIndex;
+  CComPtr<IDxcUnsavedFile> pUnsaved;
+  if (!pSupport ||
+      FAILED(pSupport->CreateInstance(CLSID_DxcIntelliSense, &pIsense)) ||
+      FAILED(pIsense->CreateIndex(&pIndex)) ||
+      FAILED(pIsense->CreateUnsavedFile("bench.hlsl", Source.c_str(),
+                                        (unsigned)Source.size(), &pUnsaved))) {
+    state.SkipWithError("IntelliSense unavailable");
+    return;
+  }
+  while (state.KeepRunning()) {
+    CComPtr<IDxcTranslationUnit> pTU;
+    pIndex->ParseTranslationUnit("bench.hlsl", nullptr, 0, &pUnsaved.p, 1,
+                                 DxcTranslationUnitFlags_UseCallerThread, &pTU);
+    benchmark::DoNotOptimize(pTU.p);
+  }
+  state.SetItemsProcessed(state.iterations() * Count);
+}
+BENCHMARK(BM_IntrinsicLookup);
+
+// Serves every include from memory so that only the compiler's own include
+// resolution is measured.
+class MemoryIncludeHandler : public IDxcIncludeHandler {
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  CComPtr<IDxcBlob> m_pHeader;
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  MemoryIncludeHandler(IDxcBlob *pHeader) : m_dwRef(0), m_pHeader(pHeader) {}
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+  HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename,
+                                       IDxcBlob **ppIncludeSource) override {
+    *ppIncludeSource = m_pHeader;
+    m_pHeader.p->AddRef();
+    return S_OK;
+  }
+};
+
+// Preprocessing a file that includes state.range(0) distinct headers, which
+// goes through the compiler's argument file system for each one.
+void BM_IncludeResolution(benchmark::State &state) {
+  unsigned Count = (unsigned)state.range(0);
+  std::string Source;
+  for (unsigned i = 0; i < Count; ++i)
+    Source += "#include \"inc/header" + std::to_string(i) + ".hlsli\"\n";
+  Source += "float4 main() : SV_Target { return BENCH_HEADER; }\n";
+  const char Header[] = "// shared header\n#define BENCH_HEADER 1\n";
+
+  dxc::DxcDllSupport *pSupport = GetDxcSupport();
+  CComPtr<IDxcUtils> pUtils;
+  CComPtr<IDxcBlobEncoding> pHeaderBlob;
+  if (!pSupport ||
+      FAILED(pSupport->CreateInstance(CLSID_DxcUtils, &pUtils)) ||
+      FAILED(pUtils->CreateBlob(Header, sizeof(Header) - 1, DXC_CP_UTF8, &pHeaderBlob))) {
+    state.SkipWithError("compiler unavailable");
+    return;
+  }
+  CComPtr<MemoryIncludeHandler> pHandler = new MemoryIncludeHandler(pHeaderBlob);
+  std::vector<LPCWSTR> Args = { L"-P", L"bench.i" };
+  while (state.KeepRunning()) {
+    CComPtr<IDxcResult> pResult;
+    if (FAILED(Compile(Source.c_str(), Args, pHandler, &pResult))) {
+      state.SkipWithError("preprocessing failed");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Count);
+}
+BENCHMARK(BM_IncludeResolution)->Arg(16)->Arg(128);
+
+} // namespace
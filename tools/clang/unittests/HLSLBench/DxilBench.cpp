@@ -0,0 +1,148 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilBench.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Micro-benchmarks for DXIL components that run without the compiler DLL.   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/HLSL/DxilSignatureAllocator.h"
+#include "dxc/HLSL/DxilSpanAllocator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#include "benchmark/benchmark.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace hlsl;
+using namespace llvm;
+
+namespace {
+
+// Every legal (opcode, overload) pair, in opcode order.
+std::vector<std::pair<OP::OpCode, Type *>> GetLegalOverloads(LLVMContext &Ctx) {
+  Type *Overloads[] = {
+    Type::getVoidTy(Ctx),  Type::getHalfTy(Ctx),  Type::getFloatTy(Ctx),
+    Type::getDoubleTy(Ctx), Type::getInt1Ty(Ctx), Type::getInt8Ty(Ctx),
+    Type::getInt16Ty(Ctx), Type::getInt32Ty(Ctx), Type::getInt64Ty(Ctx),
+  };
+  std::vector<std::pair<OP::OpCode, Type *>> Result;
+  for (unsigned i = 0; i < (unsigned)OP::OpCode::NumOpCodes; ++i) {
+    OP::OpCode OpCode = (OP::OpCode)i;
+    for (Type *Ty : Overloads) {
+      if (OP::IsOverloadLegal(OpCode, Ty))
+        Result.emplace_back(OpCode, Ty);
+    }
+  }
+  return Result;
+}
+
+// Lookups of functions that already exist, as during lowering.
+void BM_OpGetOpFuncCached(benchmark::State &state) {
+  LLVMContext Ctx;
+  Module M("bench", Ctx);
+  OP Op(Ctx, &M);
+  std::vector<std::pair<OP::OpCode, Type *>> Overloads = GetLegalOverloads(Ctx);
+  for (const auto &Entry : Overloads)
+    Op.GetOpFunc(Entry.first, Entry.second);
+  while (state.KeepRunning()) {
+    for (const auto &Entry : Overloads)
+      benchmark::DoNotOptimize(Op.GetOpFunc(Entry.first, Entry.second));
+  }
+  state.SetItemsProcessed(state.iterations() * Overloads.size());
+}
+BENCHMARK(BM_OpGetOpFuncCached);
+
+// First lookups, which create the function declarations.
+void BM_OpGetOpFuncCreate(benchmark::State &state) {
+  LLVMContext Ctx;
+  std::vector<std::pair<OP::OpCode, Type *>> Overloads = GetLegalOverloads(Ctx);
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::unique_ptr<Module> M(new Module("bench", Ctx));
+    std::unique_ptr<OP> Op(new OP(Ctx, M.get()));
+    state.ResumeTiming();
+    for (const auto &Entry : Overloads)
+      benchmark::DoNotOptimize(Op->GetOpFunc(Entry.first, Entry.second));
+    state.PauseTiming();
+    Op.reset();
+    M.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * Overloads.size());
+}
+BENCHMARK(BM_OpGetOpFuncCreate);
+
+// A signature of state.range(0) elements with a mix of sizes and
+// interpolation modes, like a large vertex shader output.
+void BM_SignaturePackOptimized(benchmark::State &state) {
+  static const DXIL::InterpolationMode Modes[] = {
+    DXIL::InterpolationMode::Linear, DXIL::InterpolationMode::Constant,
+    DXIL::InterpolationMode::LinearNoperspective,
+    DXIL::InterpolationMode::LinearCentroid,
+  };
+  unsigned Count = (unsigned)state.range(0);
+  std::vector<DxilSignatureAllocator::DummyElement> Elements;
+  for (unsigned i = 0; i < Count; ++i) {
+    DxilSignatureAllocator::DummyElement E(i);
+    E.rows = 1 + (i % 7 == 0 ? 2 : 0);
+    E.cols = 1 + (i * 3) % 4;
+    E.interpolation = Modes[(i / 3) % _countof(Modes)];
+    E.dataBitWidth = DXIL::SignatureDataWidth::Bits32;
+    Elements.push_back(E);
+  }
+  std::vector<DxilSignatureAllocator::PackElement *> Pointers;
+  for (auto &E : Elements)
+    Pointers.push_back(&E);
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    for (auto &E : Elements)
+      E.ClearLocation();
+    DxilSignatureAllocator Allocator(32, false);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(Allocator.PackOptimized(Pointers, 0, 32));
+  }
+  state.SetItemsProcessed(state.iterations() * Count);
+}
+BENCHMARK(BM_SignaturePackOptimized)->Arg(8)->Arg(32)->Arg(64);
+
+// Register allocation for state.range(0) resources of mixed array sizes.
+void BM_SpanAllocatorAllocate(benchmark::State &state) {
+  unsigned Count = (unsigned)state.range(0);
+  std::vector<int> Resources(Count);
+  while (state.KeepRunning()) {
+    SpanAllocator<unsigned, int> Allocator(0, UINT_MAX - 1);
+    for (unsigned i = 0; i < Count; ++i) {
+      unsigned Pos;
+      benchmark::DoNotOptimize(Allocator.Allocate(&Resources[i], 1 + i % 5, Pos));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Count);
+}
+BENCHMARK(BM_SpanAllocatorAllocate)->Arg(16)->Arg(256)->Arg(4096);
+
+// Explicit bindings with gaps, then allocation into the gaps.
+void BM_SpanAllocatorInsertThenAllocate(benchmark::State &state) {
+  unsigned Count = (unsigned)state.range(0);
+  std::vector<int> Resources(Count * 2);
+  while (state.KeepRunning()) {
+    SpanAllocator<unsigned, int> Allocator(0, UINT_MAX - 1);
+    for (unsigned i = 0; i < Count; ++i)
+      benchmark::DoNotOptimize(Allocator.Insert(&Resources[i], i * 4, i * 4 + 1));
+    for (unsigned i = 0; i < Count; ++i) {
+      unsigned Pos;
+      benchmark::DoNotOptimize(Allocator.Allocate(&Resources[Count + i], 2, Pos));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * Count * 2);
+}
+BENCHMARK(BM_SpanAllocatorInsertThenAllocate)->Arg(16)->Arg(256)->Arg(4096);
+
+} // namespace
@@ -157,6 +157,7 @@ FileRunCommandResult FileRunCommandPart::ReadOptsForDxc(
   if (inputPos == nullptr)
     return FileRunCommandResult::Error("Only supported pattern includes input file as argument");
   args.erase(inputPos - args.c_str(), strlen("%s"));
+  SubstituteFilenameVars(args);
 
   llvm::StringRef argsRef = args;
   llvm::SmallVector<llvm::StringRef, 8> splitArgs;
@@ -677,6 +678,13 @@ void FileRunCommandPart::SubstituteFilenameVars(std::string &args) {
   while ((pos = args.find("%b")) != std::string::npos) {
     args.replace(pos, 2, baseFileName.c_str());
   }
+  // replace %S with the directory of the command file
+  std::string dirName = CW2A(CommandFileName);
+  pos = dirName.find_last_of("\\/");
+  dirName = pos == std::string::npos ? "." : dirName.substr(0, pos);
+  while ((pos = args.find("%S")) != std::string::npos) {
+    args.replace(pos, 2, dirName.c_str());
+  }
 }
 
 #if _WIN32
@@ -1423,6 +1423,9 @@ TEST_F(FileTest, SpirvOptOconfigInvalidFlag) {
   runFileTest("spirv.opt.invalid-flag.cl.oconfig.hlsl", Expect::Failure);
 }
 TEST_F(FileTest, SpirvOptOconfig) { runFileTest("spirv.opt.cl.oconfig.hlsl"); }
+TEST_F(FileTest, SpirvOptPruneFileVars) {
+  runFileTest("spirv.opt.prune-file-vars.hlsl");
+}
 
 // For shader stage input/output interface
 // For semantic SV_Position, SV_ClipDistance, SV_CullDistance
@@ -1500,6 +1503,9 @@ TEST_F(FileTest, SpirvLegalizationStructuredBufferInStruct) {
   setBeforeHLSLLegalization();
   runFileTest("spirv.legal.sbuffer.struct.hlsl");
 }
+TEST_F(FileTest, SpirvLegalizationInvalidOpcode) {
+  runFileTest("spirv.legal.invalid-opcode.hlsl");
+}
 TEST_F(FileTest, SpirvLegalizationConstantBuffer) {
   runFileTest("spirv.legal.cbuffer.hlsl");
 }
@@ -1586,6 +1592,10 @@ TEST_F(FileTest, SpirvDebugControlLine) {
   useVulkan1p1();
   runFileTest("spirv.debug.ctrl.line.hlsl");
 }
+TEST_F(FileTest, SpirvDebugControlCompact) {
+  useVulkan1p1();
+  runFileTest("spirv.debug.ctrl.compact.hlsl");
+}
 TEST_F(FileTest, SpirvDebugControlTool) {
   useVulkan1p1();
   runFileTest("spirv.debug.ctrl.tool.hlsl");
@@ -0,0 +1,89 @@
+//===- DxilValueCacheTest.cpp - DxilValueCache tests ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/DxilValueCache.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class DxilValueCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    SMDiagnostic Error;
+    M = parseAssemblyString("define i32 @test(i32 %x) {\n"
+                            "entry:\n"
+                            "  %a = add i32 1, 2\n"
+                            "  %b = mul i32 %a, 2\n"
+                            "  ret i32 %b\n"
+                            "}\n",
+                            Error, Context);
+    ASSERT_TRUE(M != nullptr);
+    for (Instruction &I : inst_range(M->getFunction("test")))
+      Insts[I.getName()] = &I;
+  }
+
+  ConstantInt *GetConstInt(Value *V) {
+    return dyn_cast_or_null<ConstantInt>(DVC.GetConstValue(V));
+  }
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+  StringMap<Instruction *> Insts;
+  DxilValueCache DVC;
+};
+
+TEST_F(DxilValueCacheTest, InvalidateAfterReplaceRecomputesUsers) {
+  Instruction *A = Insts["a"], *B = Insts["b"];
+  ASSERT_TRUE(GetConstInt(B) != nullptr);
+  EXPECT_EQ(6u, GetConstInt(B)->getZExtValue());
+
+  // Replace the cached %a with a value that does not fold. The handle on %a
+  // drops its own entry, but %b still holds the result computed from it.
+  Argument *X = &*M->getFunction("test")->arg_begin();
+  Instruction *C = BinaryOperator::CreateMul(X, X, "c", A);
+  A->replaceAllUsesWith(C);
+  A->eraseFromParent();
+
+  DVC.Invalidate(C);
+  EXPECT_EQ(nullptr, DVC.GetConstValue(B));
+  EXPECT_EQ(nullptr, DVC.GetConstValue(C));
+}
+
+TEST_F(DxilValueCacheTest, InvalidateAfterEraseDropsErasedValue) {
+  Instruction *A = Insts["a"], *B = Insts["b"];
+  ASSERT_TRUE(GetConstInt(B) != nullptr);
+
+  // Erase the cached %b and invalidate what it was computed from.
+  ReturnInst *Ret = cast<ReturnInst>(B->getNextNode());
+  Ret->setOperand(0, A);
+  B->eraseFromParent();
+  DVC.Invalidate(A);
+
+  ASSERT_TRUE(GetConstInt(A) != nullptr);
+  EXPECT_EQ(3u, GetConstInt(A)->getZExtValue());
+
+  // A new instruction, which may take the place of %b in memory, does not
+  // pick up its result.
+  Argument *X = &*M->getFunction("test")->arg_begin();
+  Instruction *N = BinaryOperator::CreateMul(X, A, "n", Ret);
+  EXPECT_EQ(nullptr, DVC.GetConstValue(N));
+}
+
+} // namespace
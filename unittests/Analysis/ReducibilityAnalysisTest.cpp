@@ -0,0 +1,114 @@
+//===- ReducibilityAnalysisTest.cpp - Reducibility tests ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/ReducibilityAnalysis.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+bool IsTestReducible(const char *Assembly) {
+  LLVMContext Context;
+  SMDiagnostic Error;
+  std::unique_ptr<Module> M = parseAssemblyString(Assembly, Error, Context);
+  EXPECT_TRUE(M != nullptr);
+  if (!M)
+    return false;
+  return IsReducible(*M->getFunction("test"), IrreducibilityAction::Ignore);
+}
+
+TEST(ReducibilityAnalysisTest, NestedLoopsAreReducible) {
+  EXPECT_TRUE(IsTestReducible(
+      "define void @test(i1 %c) {\n"
+      "entry:\n"
+      "  br label %outer\n"
+      "outer:\n"
+      "  br label %inner\n"
+      "inner:\n"
+      "  br i1 %c, label %inner, label %latch\n"
+      "latch:\n"
+      "  br i1 %c, label %outer, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n"));
+}
+
+TEST(ReducibilityAnalysisTest, LoopWithTwoEntriesIsIrreducible) {
+  EXPECT_FALSE(IsTestReducible(
+      "define void @test(i1 %c) {\n"
+      "entry:\n"
+      "  br i1 %c, label %a, label %b\n"
+      "a:\n"
+      "  br i1 %c, label %b, label %exit\n"
+      "b:\n"
+      "  br i1 %c, label %a, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n"));
+}
+
+TEST(ReducibilityAnalysisTest, SwitchIntoLoopBodyIsIrreducible) {
+  // The switch enters the loop both at its header and in the middle.
+  EXPECT_FALSE(IsTestReducible(
+      "define void @test(i32 %i, i1 %c) {\n"
+      "entry:\n"
+      "  switch i32 %i, label %exit [ i32 0, label %head\n"
+      "                              i32 1, label %body\n"
+      "                              i32 2, label %head ]\n"
+      "head:\n"
+      "  br label %body\n"
+      "body:\n"
+      "  br i1 %c, label %head, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n"));
+}
+
+TEST(ReducibilityAnalysisTest, SwitchInLoopIsReducible) {
+  EXPECT_TRUE(IsTestReducible(
+      "define void @test(i32 %i, i1 %c) {\n"
+      "entry:\n"
+      "  br label %head\n"
+      "head:\n"
+      "  switch i32 %i, label %latch [ i32 0, label %case0\n"
+      "                               i32 1, label %case1 ]\n"
+      "case0:\n"
+      "  br label %case1\n"
+      "case1:\n"
+      "  br i1 %c, label %head, label %latch\n"
+      "latch:\n"
+      "  br i1 %c, label %head, label %exit\n"
+      "exit:\n"
+      "  ret void\n"
+      "}\n"));
+}
+
+TEST(ReducibilityAnalysisTest, UnreachableLoopWithTwoEntries) {
+  // Unreachable blocks are judged by the T1-T2 test, which removes them with
+  // the edges into the loop.
+  EXPECT_TRUE(IsTestReducible(
+      "define void @test(i1 %c) {\n"
+      "entry:\n"
+      "  ret void\n"
+      "dead:\n"
+      "  br i1 %c, label %a, label %b\n"
+      "a:\n"
+      "  br label %b\n"
+      "b:\n"
+      "  br label %a\n"
+      "}\n"));
+}
+
+} // end anonymous namespace
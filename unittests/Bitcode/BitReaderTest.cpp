@@ -273,4 +273,57 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddrInFunctionAfter) {
   EXPECT_FALSE(verifyModule(*M, &dbgs()));
 }
 
+// HLSL Change Begin - function bodies written in chunks match the serial
+// writer byte for byte.
+TEST(BitReaderTest, ChunkedFunctionBodiesMatchSerialOutput) {
+  std::unique_ptr<Module> M = parseAssembly(
+      "@g = global i32 0\n"
+      "define i32 @a(i32 %x) {\n"
+      "  %y = add i32 %x, 7\n"
+      "  ret i32 %y\n"
+      "}\n"
+      "declare void @d()\n"
+      "define void @b() {\n"
+      "  call void @d()\n"
+      "  store i32 3, i32* @g\n"
+      "  ret void\n"
+      "}\n"
+      "define i32 @c(i32 %x) {\n"
+      "entry:\n"
+      "  %v = call i32 @a(i32 %x)\n"
+      "  br label %exit\n"
+      "exit:\n"
+      "  %w = load i32, i32* @g\n"
+      "  %r = mul i32 %v, %w\n"
+      "  ret i32 %r\n"
+      "}\n");
+
+  for (bool PreserveUseListOrder : {false, true}) {
+    SmallString<1024> Serial;
+    {
+      raw_svector_ostream OS(Serial);
+      WriteBitcodeToFile(M.get(), OS, PreserveUseListOrder);
+    }
+
+    for (unsigned NumChunks : {1u, 2u, 5u}) {
+      unsigned TasksRun = 0;
+      SmallString<1024> Chunked;
+      {
+        raw_svector_ostream OS(Chunked);
+        WriteBitcodeToFile(
+            M.get(), OS, PreserveUseListOrder, NumChunks,
+            [&](unsigned NumTasks, const std::function<void(unsigned)> &Task) {
+              // Run them backwards so that nothing relies on task order.
+              for (unsigned i = NumTasks; i-- > 0;)
+                Task(i);
+              TasksRun += NumTasks;
+            });
+      }
+      EXPECT_EQ(std::min(NumChunks, 3u), TasksRun);
+      EXPECT_EQ(Serial.str(), Chunked.str());
+    }
+  }
+}
+// HLSL Change End
+
 } // end namespace
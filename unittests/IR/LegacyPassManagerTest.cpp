@@ -334,6 +334,74 @@ namespace llvm {
       EXPECT_EQ(1, mDNM->run);
     }
 
+    // HLSL Change Begin - idempotent function passes are skipped on functions
+    // no pass has changed since their last run.
+    struct FIdempotent : public FunctionPass {
+    public:
+      static char ID;
+      static SmallVector<unsigned, 4> seenSizes;
+      FIdempotent() : FunctionPass(ID) { }
+      bool isIdempotent() const override { return true; }
+      bool runOnFunction(Function &F) override {
+        seenSizes.push_back(F.getEntryBlock().size());
+        return false;
+      }
+      void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.setPreservesAll();
+      }
+    };
+    char FIdempotent::ID=0;
+    SmallVector<unsigned, 4> FIdempotent::seenSizes;
+
+    // Adds an alloca to the entry block.
+    struct FAddAlloca : public FunctionPass {
+    public:
+      static char ID;
+      FAddAlloca() : FunctionPass(ID) { }
+      bool runOnFunction(Function &F) override {
+        new AllocaInst(Type::getInt32Ty(F.getContext()), "",
+                       &*F.getEntryBlock().begin());
+        return true;
+      }
+    };
+    char FAddAlloca::ID=0;
+
+    struct FNoChange : public FunctionPass {
+    public:
+      static char ID;
+      FNoChange() : FunctionPass(ID) { }
+      bool runOnFunction(Function &F) override { return false; }
+      void getAnalysisUsage(AnalysisUsage &AU) const override {
+        AU.setPreservesAll();
+      }
+    };
+    char FNoChange::ID=0;
+
+    TEST(PassManager, IdempotentReRun) {
+      LLVMContext Context;
+      Module M("test-idempotent", Context);
+      Function *F = Function::Create(
+          FunctionType::get(Type::getVoidTy(Context), false),
+          GlobalValue::ExternalLinkage, "f", &M);
+      ReturnInst::Create(Context, BasicBlock::Create(Context, "entry", F));
+
+      FIdempotent::seenSizes.clear();
+      legacy::PassManager Passes;
+      Passes.add(new FIdempotent());
+      Passes.add(new FIdempotent()); // skipped, nothing changed
+      Passes.add(new FAddAlloca());
+      Passes.add(new FIdempotent()); // runs on the changed function
+      Passes.add(new FNoChange());
+      Passes.add(new FIdempotent()); // skipped, FNoChange changed nothing
+      Passes.run(M);
+
+      ASSERT_EQ(2u, FIdempotent::seenSizes.size());
+      EXPECT_EQ(1u, FIdempotent::seenSizes[0]);
+      EXPECT_EQ(2u, FIdempotent::seenSizes[1]);
+      EXPECT_EQ(2u, F->getEntryBlock().size());
+    }
+    // HLSL Change End
+
     Module* makeLLVMModule();
 
     template<typename T>
@@ -9,6 +9,7 @@
 
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "gtest/gtest.h"
 using namespace llvm;
 
@@ -27,4 +28,25 @@ TEST(TypesTest, StructType) {
   EXPECT_FALSE(Struct->hasName());
 }
 
+// HLSL Change - Begin
+TEST(TypesTest, ResetForReuseFreesNames) {
+  LLVMContext C;
+  StructType *First = StructType::create(C, "Foo");
+  StructType::create(C, "Foo");
+  unsigned Kind = C.getMDKindID("dx.test");
+  {
+    Module M("m", C);
+    EXPECT_FALSE(C.resetForReuse());
+  }
+  EXPECT_TRUE(C.resetForReuse());
+  EXPECT_FALSE(First->hasName());
+  EXPECT_FALSE(C.findMDKindID("dx.test", &Kind));
+
+  // Names and kinds come out as in a new context.
+  EXPECT_EQ("Foo", StructType::create(C, "Foo")->getName());
+  EXPECT_EQ("Foo.0", StructType::create(C, "Foo")->getName());
+  EXPECT_EQ(Kind, C.getMDKindID("dx.test"));
+}
+// HLSL Change - End
+
 }  // end anonymous namespace
@@ -175,4 +175,24 @@ TEST(ValueTest, printSlots) {
 #undef CHECK_PRINT_AS_OPERAND
 }
 
+// HLSL Change Begin
+TEST(ValueTest, DxilOpFollowsName) {
+  LLVMContext C;
+  Module M("m", C);
+  FunctionType *FTy = FunctionType::get(Type::getVoidTy(C), false);
+  Function *Op = Function::Create(FTy, GlobalValue::ExternalLinkage,
+                                  "dx.op.barrier", &M);
+  Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage, "f", &M);
+  EXPECT_TRUE(Op->isDxilOp());
+  EXPECT_FALSE(F->isDxilOp());
+
+  F->takeName(Op);
+  EXPECT_TRUE(F->isDxilOp());
+  EXPECT_FALSE(Op->isDxilOp());
+
+  F->setName("g");
+  EXPECT_FALSE(F->isDxilOp());
+}
+// HLSL Change End
+
 } // end anonymous namespace
@@ -7,6 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
@@ -24,4 +25,59 @@ TEST(ValueMapperTest, MapMetadataUnresolved) {
   EXPECT_EQ(T.get(), MapMetadata(T.get(), VM, RF_NoModuleLevelChanges));
 }
 
+// HLSL Change Begin
+// Builds the uniqued cycle A = !{B, Leaf}, B = !{A}.
+static MDTuple *getUniquedCycle(LLVMContext &Context, Metadata *Leaf) {
+  TempMDTuple T = MDTuple::getTemporary(Context, None);
+  MDTuple *A = MDTuple::get(Context, {T.get(), Leaf});
+  MDTuple *B = MDTuple::get(Context, A);
+  T->replaceAllUsesWith(B);
+  A->resolveCycles();
+  return A;
+}
+
+TEST(ValueMapperTest, MapMetadataUnchangedUniquedCycle) {
+  LLVMContext Context;
+  MDTuple *A = getUniquedCycle(Context, MDString::get(Context, "leaf"));
+  auto *B = cast<MDTuple>(A->getOperand(0));
+  ASSERT_TRUE(A->isUniqued() && A->isResolved());
+  ASSERT_TRUE(B->isUniqued() && B->isResolved());
+
+  ValueToValueMapTy VM;
+  EXPECT_EQ(A, MapMetadata(A, VM));
+  EXPECT_EQ(A, VM.MD()[A].get());
+  EXPECT_EQ(B, VM.MD()[B].get());
+  EXPECT_EQ(B, MapMetadata(B, VM));
+}
+
+TEST(ValueMapperTest, MapMetadataUniquedCycleWithChangedLeaf) {
+  LLVMContext Context;
+  Type *I32 = Type::getInt32Ty(Context);
+  Constant *Old = ConstantInt::get(I32, 1);
+  Constant *New = ConstantInt::get(I32, 2);
+  MDTuple *A = getUniquedCycle(Context, ConstantAsMetadata::get(Old));
+  auto *B = cast<MDTuple>(A->getOperand(0));
+
+  ValueToValueMapTy VM;
+  VM[Old] = New;
+  auto *NewA = dyn_cast<MDTuple>(MapMetadata(A, VM));
+  ASSERT_TRUE(NewA);
+  EXPECT_NE(A, NewA);
+  EXPECT_TRUE(NewA->isUniqued() && NewA->isResolved());
+  EXPECT_EQ(ConstantAsMetadata::get(New), NewA->getOperand(1));
+
+  // The whole cycle is recreated around the new leaf.
+  auto *NewB = dyn_cast<MDTuple>(NewA->getOperand(0));
+  ASSERT_TRUE(NewB);
+  EXPECT_NE(B, NewB);
+  EXPECT_TRUE(NewB->isUniqued() && NewB->isResolved());
+  EXPECT_EQ(NewA, NewB->getOperand(0));
+  EXPECT_EQ(NewB, VM.MD()[B].get());
+
+  // The original cycle is left alone.
+  EXPECT_EQ(B, A->getOperand(0));
+  EXPECT_EQ(ConstantAsMetadata::get(Old), A->getOperand(1));
+}
+// HLSL Change End
+
 }
@@ -1947,15 +1947,20 @@ class db_dxil(object):
         add_pass('hlsl-dxil-remove-discards', 'DxilRemoveDiscards', 'HLSL DXIL Remove all discard instructions', [])
         add_pass('hlsl-dxil-force-early-z', 'DxilForceEarlyZ', 'HLSL DXIL Force the early Z global flag, if shader has no discard calls', [])
         add_pass('hlsl-dxil-pix-meshshader-output-instrumentation', 'DxilPIXMeshShaderOutputInstrumentation', 'DXIL mesh shader output instrumentation for PIX', [
-            {'n':'UAVSize','t':'int','c':1}])
+            {'n':'UAVSize','t':'int','c':1},
+            {'n':'sampleRate','t':'int','c':1,'d':'If non-zero, instrument one in this many thread groups'}])
         add_pass('hlsl-dxil-pix-shader-access-instrumentation', 'DxilShaderAccessTracking', 'HLSL DXIL shader access tracking for PIX', [
             {'n':'config','t':'int','c':1},
-            {'n':'checkForDynamicIndexing','t':'bool','c':1}])
+            {'n':'checkForDynamicIndexing','t':'bool','c':1},
+            {'n':'waveAggregate','t':'bool','c':1,'d':'Write each access once per wave when all lanes hit the same slot'}])
+        add_pass('hlsl-dxil-pix-block-counters', 'DxilBlockCounters', 'DXIL basic block counters for PIX', [])
         add_pass('hlsl-dxil-debug-instrumentation', 'DxilDebugInstrumentation', 'HLSL DXIL debug instrumentation for PIX', [
             {'n':'UAVSize','t':'int','c':1},
             {'n':'parameter0','t':'int','c':1},
             {'n':'parameter1','t':'int','c':1},
-            {'n':'parameter2','t':'int','c':1}])
+            {'n':'parameter2','t':'int','c':1},
+            {'n':'compact','t':'bool','c':1,'d':'Write the compact trace format, which the PIX trace decoder expands'},
+            {'n':'sampleRate','t':'int','c':1,'d':'If non-zero, ignore the parameters and instrument one in this many invocations'}])
         add_pass('dxil-annotate-with-virtual-regs', 'DxilAnnotateWithVirtualRegister', 'Annotates each instruction in the DXIL module with a virtual register number', [])
         add_pass('dxil-dbg-value-to-dbg-declare', 'DxilDbgValueToDbgDeclare', 'Converts llvm.dbg.value uses to llvm.dbg.declare.', [])
         add_pass('hlsl-dxil-reduce-msaa-to-single', 'DxilReduceMSAAToSingleSample', 'HLSL DXIL Reduce all MSAA reads to single-sample reads', [])
@@ -1984,6 +1989,16 @@ class db_dxil(object):
         add_pass('hlsl-dxil-precise', 'DxilPrecisePropagatePass', 'DXIL precise attribute propagate', [])
         add_pass('dxil-legalize-sample-offset', 'DxilLegalizeSampleOffsetPass', 'DXIL legalize sample offset', [])
         add_pass('dxil-gvn-hoist', 'DxilSimpleGVNHoist', 'DXIL simple gvn hoist', [])
+        add_pass('dxil-cbuffer-load-coalesce', 'DxilCBufferLoadCoalesce', 'DXIL coalesce constant buffer loads', [])
+        add_pass('dxil-vectorize-buffer-accesses', 'DxilVectorizeBufferAccesses', 'DXIL vectorize buffer accesses', [])
+        add_pass('dxil-hoist-uniform', 'DxilHoistUniform', 'DXIL hoist uniform values', [])
+        add_pass('dxil-wave-aggregate-atomics', 'DxilWaveAggregateAtomics', 'DXIL wave aggregate atomics', [])
+        add_pass('dxil-contract-mad', 'DxilContractMad', 'DXIL contract multiplies and adds into mad', [])
+        add_pass('dxil-hoist-handles', 'DxilHoistHandles', 'DXIL hoist resource handles', [])
+        add_pass('dxil-rematerialize', 'DxilRematerialize', 'DXIL rematerialize cheap values', [])
+        add_pass('dxil-narrow-precision', 'DxilNarrowPrecision', 'DXIL narrow precision', [])
+        add_pass('dxil-pad-groupshared', 'DxilPadGroupShared', 'DXIL pad groupshared arrays', [])
+        add_pass('dxil-minimize-mesh-outputs', 'DxilMinimizeMeshOutputs', 'DXIL minimize mesh outputs', [])
         add_pass('hlsl-hlensure', 'HLEnsureMetadata', 'HLSL High-Level Metadata Ensure', [])
         add_pass('multi-dim-one-dim', 'MultiDimArrayToOneDimArray', 'Flatten multi-dim array into one-dim array', [])
         add_pass('resource-handle', 'ResourceToHandle', 'Lower resource into handle', [])
@@ -191,6 +191,14 @@ set testname=Strip Root Signature from compiled object
 call :run dxc.exe smoke.cso /dumpbin /Qstrip_rootsignature /Fo norootsignature.cso
 call :check_file norootsignature.cso
 if %Failed% neq 0 goto :failed
+set testname=Strip reflection from compiled object
+call :run dxc.exe smoke.cso /dumpbin /Qstrip_reflect /Fo noreflect.cso
+call :check_file noreflect.cso
+if %Failed% neq 0 goto :failed
+call :run dxc.exe -dumpbin noreflect.cso
+call :check_file log find-not "i32 6, !\"g\""
+call :check_file noreflect.cso del
+if %Failed% neq 0 goto :failed
 set testname=Extract rootsignature from compiled object
 call :run dxc.exe smoke.cso /dumpbin /extractrootsignature /Fo rootsig.cso
 call :check_file rootsig.cso
@@ -353,6 +361,20 @@ call :check_file smoke.opt.bc del
 call :check_file smoke.opt.prn.txt find MODULE-PRINT del
 if %Failed% neq 0 goto :failed
 
+set testname=Test dxopt -script
+echo # One step that runs and one whose input is missing> dxopt-script.txt
+echo smoke.hl.ll script-opt.bc -mem2reg>> dxopt-script.txt
+echo not-there.ll script-missing.bc -mem2reg>> dxopt-script.txt
+set testcmd=dxopt.exe -script dxopt-script.txt -threads=2
+%testcmd% 1>testcmd.log 2>&1
+rem A failed step fails the script with 1, after the other steps are written.
+if %errorlevel% neq 1 call :set_failed
+call :check_file script-opt.bc del
+call :check_file_not script-missing.bc del
+call :check_file testcmd.log find "smoke.hl.ll -> script-opt.bc" find "not-there.ll -> script-missing.bc: failed" del
+call :check_file dxopt-script.txt del
+if %Failed% neq 0 goto :failed
+
 set testname=Smoke test for dxc_batch command line
 call :run dxc_batch.exe -lib-link -multi-thread "%testfiles%\batch_cmds2.txt"
 if %Failed% neq 0 goto :failed
@@ -361,6 +383,44 @@ if %Failed% neq 0 goto :failed
 call :run dxc_batch.exe -multi-thread "%testfiles%\batch_cmds.txt"
 if %Failed% neq 0 goto :failed
 
+set testname=Test dxc -batch
+echo # Two jobs that compile and two that fail> batch-jobs.txt
+echo -T ps_6_0 "%testfiles%\smoke.hlsl" -Fo batch-ps.cso>> batch-jobs.txt
+echo -T ps_6_0 -E missing "%testfiles%\smoke.hlsl" -Fo batch-missing.cso>> batch-jobs.txt
+echo -T ps_6_0 -D DX12 "%testfiles%\smoke.hlsl" -Fo batch-rs.cso>> batch-jobs.txt
+echo -T ps_6_0 "%testfiles%\not-there.hlsl" -Fo batch-nofile.cso>> batch-jobs.txt
+set testcmd=dxc.exe -batch batch-jobs.txt -batch-threads 2 -batch-report batch-report.json
+%testcmd% 1>testcmd.log 2>&1
+rem A failed job fails the batch with 1, after the other jobs are written.
+if %errorlevel% neq 1 call :set_failed
+call :check_file batch-ps.cso del
+call :check_file batch-rs.cso del
+call :check_file_not batch-missing.cso del
+call :check_file_not batch-nofile.cso del
+call :check_file batch-report.json find "missing entry point definition" find-opt -r "batch-ps.cso.*status.: .succeeded" find-opt -r "batch-missing.cso.*status.: .failed" find-opt -r "batch-nofile.cso.*status.: .failed" find-opt -r "succeeded.: 2" find-opt -r "failed.: 2" del
+if %Failed% neq 0 goto :failed
+echo -T ps_6_0 "%testfiles%\smoke.hlsl" -Fo batch-ps.cso> batch-jobs.txt
+echo -T vs_6_0 -D semantic=SV_Position "%testfiles%\smoke.hlsl" -Fo batch-vs.cso>> batch-jobs.txt
+call :run dxc.exe -batch batch-jobs.txt -batch-report batch-report.json
+call :check_file batch-ps.cso del
+call :check_file batch-vs.cso del
+call :check_file batch-report.json find-opt -r "succeeded.: 2" find-opt -r "failed.: 0" del
+if %Failed% neq 0 goto :failed
+
+set testname=Test DXC_TRACE_FILE
+del dxc-trace.*.json 1>nul 2>nul
+set DXC_TRACE_FILE=%CD%\dxc-trace.json
+call :run dxc.exe /T ps_6_0 "%testfiles%\smoke.hlsl" /Fo smoke-trace.cso
+call :run dxc.exe /T ps_6_0 "%testfiles%\smoke.hlsl" /Fo smoke-trace.cso
+set DXC_TRACE_FILE=
+rem Each process writes a trace of its own, named with its process ID.
+set testcmd=dir /b dxc-trace.*.json
+dir /b dxc-trace.*.json 2>nul | find /c ".json" | find "2" 1>nul
+if %errorlevel% neq 0 call :set_failed
+call :check_file dxc-trace.*.json find "codegen" find "pass-pipeline" del
+call :check_file smoke-trace.cso del
+if %Failed% neq 0 goto :failed
+
 set testname=Smoke test for dxl command line
 call :run dxc.exe -T lib_6_x "%testfiles%\lib_entry4.hlsl" -Fo lib_entry4.dxbc
 call :check_file lib_entry4.dxbc
@@ -369,11 +429,65 @@ call :run dxc.exe -T lib_6_x "%testfiles%\lib_res_match.hlsl" -Fo lib_res_match.
 call :check_file lib_res_match.dxbc
 if %Failed% neq 0 goto :failed
 call :run dxl.exe -T ps_6_0 lib_res_match.dxbc;lib_entry4.dxbc -Fo res_match_entry.dxbc
+if %Failed% neq 0 goto :failed
+
+set testname=Test dxl -targets
+echo # One target that links and one whose entry is missing> dxl-targets.txt
+echo main ps_6_0 targets-main.dxbc>> dxl-targets.txt
+echo missing ps_6_0 targets-missing.dxbc>> dxl-targets.txt
+set testcmd=dxl.exe -targets dxl-targets.txt -j 2 lib_res_match.dxbc;lib_entry4.dxbc
+%testcmd% 1>testcmd.log 2>&1
+rem A failed target fails the run with 1, after the other targets are written.
+if %errorlevel% neq 1 call :set_failed
+call :check_file targets-main.dxbc del
+call :check_file_not targets-missing.dxbc del
+call :check_file testcmd.log find "main (ps_6_0): targets-main.dxbc" find "missing (ps_6_0): link failed" del
+call :check_file dxl-targets.txt del
 call :check_file lib_entry4.dxbc del
 call :check_file lib_res_match.dxbc del
 call :check_file res_match_entry.dxbc del
 if %Failed% neq 0 goto :failed
 
+set testname=Test dxv -manifest
+call :run dxc.exe -T ps_6_0 "%testfiles%\smoke.hlsl" -Fo dxv-ok.cso
+if %Failed% neq 0 goto :failed
+echo not a shader> dxv-bad.ll
+echo # One container that validates and one input that does not assemble> dxv-manifest.txt
+echo dxv-ok.cso>> dxv-manifest.txt
+echo dxv-bad.ll>> dxv-manifest.txt
+set testcmd=dxv.exe -manifest dxv-manifest.txt -j 2 -summary dxv-summary.json
+%testcmd% 1>testcmd.log 2>&1
+rem A failed input fails the run with 1, after the other inputs are validated.
+if %errorlevel% neq 1 call :set_failed
+call :check_file dxv-summary.json find-opt -r "dxv-ok.cso.*status.: .succeeded" find-opt -r "dxv-bad.ll.*status.: .failed" find-opt -r "succeeded.: 1" find-opt -r "failed.: 1" del
+call :check_file dxv-ok.cso del
+call :check_file dxv-bad.ll del
+call :check_file dxv-manifest.txt del
+if %Failed% neq 0 goto :failed
+
+set testname=Test dxc compile server
+start "" /b dxc.exe -server hcttest-dxc-server 1>nul 2>nul
+rem The server compiles once before it listens, so retry until it answers.
+set testcmd=dxc.exe -connect hcttest-dxc-server /T ps_6_0 "%testfiles%\smoke.hlsl" /Fo smoke.server.cso
+set server_ready=0
+for /l %%i in (1,1,30) do (
+  if !server_ready! equ 0 (
+    !testcmd! 1>nul 2>nul
+    if !errorlevel! equ 0 (
+      set server_ready=1
+    ) else (
+      ping -n 2 127.0.0.1 1>nul
+    )
+  )
+)
+if %server_ready% neq 1 call :set_failed
+rem A second server must not take over the pipe of the first one.
+if %Failed% equ 0 call :run-fail dxc.exe -server hcttest-dxc-server
+powershell -NoProfile -Command "Get-CimInstance Win32_Process | Where-Object { $_.CommandLine -like '*-server hcttest-dxc-server*' } | ForEach-Object { Stop-Process -Id $_.ProcessId -Force }" 1>nul 2>nul
+if %Failed% neq 0 goto :failed
+call :check_file smoke.server.cso del
+if %Failed% neq 0 goto :failed
+
 set testname=Test for denorm options
 call :run dxc.exe "%testfiles%\smoke.hlsl" /Tps_6_2 /denorm preserve
 if %Failed% neq 0 goto :failed